@@ -70,6 +70,7 @@ ConnectionConfig& ConnectionConfig::operator=(const ConnectionConfig& other)
   bool requestShapeUpdates;
   bool ignoreShapeUpdates;
   int localCursor;
+  SocketProfile socketProfile;
 
   {
     AutoLock lockOther(&other.m_cs);
@@ -90,6 +91,7 @@ ConnectionConfig& ConnectionConfig::operator=(const ConnectionConfig& other)
     requestShapeUpdates = other.m_requestShapeUpdates;
     ignoreShapeUpdates = other.m_ignoreShapeUpdates;
     localCursor = other.m_localCursor;
+    socketProfile = other.m_socketProfile;
   }
 
   {
@@ -111,6 +113,7 @@ ConnectionConfig& ConnectionConfig::operator=(const ConnectionConfig& other)
     m_requestShapeUpdates = requestShapeUpdates;
     m_ignoreShapeUpdates = ignoreShapeUpdates;
     m_localCursor = localCursor;
+    m_socketProfile = socketProfile;
   }
   return *this;
 }
@@ -381,6 +384,18 @@ int ConnectionConfig::getLocalCursorShape()
   return m_localCursor;
 }
 
+void ConnectionConfig::setSocketProfile(const SocketProfile *profile)
+{
+  AutoLock l(&m_cs);
+  m_socketProfile = *profile;
+}
+
+void ConnectionConfig::getSocketProfile(SocketProfile *profile)
+{
+  AutoLock l(&m_cs);
+  *profile = m_socketProfile;
+}
+
 bool ConnectionConfig::saveToStorage(SettingsManager *sm) const
 {
   AutoLock l(&m_cs);
@@ -410,6 +425,11 @@ bool ConnectionConfig::saveToStorage(SettingsManager *sm) const
 
   TEST_FAIL(sm->setInt(_T("local_cursor_shape"),   m_localCursor), saveAllOk);
 
+  TEST_FAIL(sm->setInt(_T("socket_sndbuf"),        m_socketProfile.sendBufferSize), saveAllOk);
+  TEST_FAIL(sm->setInt(_T("socket_rcvbuf"),        m_socketProfile.receiveBufferSize), saveAllOk);
+  TEST_FAIL(sm->setBoolean(_T("socket_nodelay"),   m_socketProfile.noDelay), saveAllOk);
+  TEST_FAIL(sm->setUINT(_T("socket_keepalive"),    m_socketProfile.keepAliveTime), saveAllOk);
+
   return saveAllOk;
 }
 
@@ -450,6 +470,11 @@ bool ConnectionConfig::loadFromStorage(SettingsManager *sm)
 
   TEST_FAIL(sm->getInt(_T("local_cursor_shape"),   &m_localCursor), loadAllOk);
 
+  TEST_FAIL(sm->getInt(_T("socket_sndbuf"),        &m_socketProfile.sendBufferSize), loadAllOk);
+  TEST_FAIL(sm->getInt(_T("socket_rcvbuf"),        &m_socketProfile.receiveBufferSize), loadAllOk);
+  TEST_FAIL(sm->getBoolean(_T("socket_nodelay"),   &m_socketProfile.noDelay), loadAllOk);
+  TEST_FAIL(sm->getUINT(_T("socket_keepalive"),    &m_socketProfile.keepAliveTime), loadAllOk);
+
   return loadAllOk;
 }
 
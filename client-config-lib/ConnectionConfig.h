@@ -30,6 +30,7 @@
 #include "thread/LocalMutex.h"
 
 #include "rfb/EncodingDefs.h"
+#include "network/socket/SocketProfile.h"
 
 //
 // Contains options of connection configuration.
@@ -160,6 +161,11 @@ public:
   // Gets local cursor shape
   int getLocalCursorShape();
 
+  // Sets tuning of the connection socket
+  void setSocketProfile(const SocketProfile *profile);
+  // Returns tuning of the connection socket
+  void getSocketProfile(SocketProfile *profile);
+
   //
   // Serialization / deserialization methods
   //
@@ -237,6 +243,9 @@ protected:
 
   int m_localCursor;
 
+  // Tuning of the connection socket
+  SocketProfile m_socketProfile;
+
   // Critical section
   mutable LocalMutex m_cs;
 };
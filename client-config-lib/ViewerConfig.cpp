@@ -35,7 +35,7 @@
 
 ViewerConfig::ViewerConfig(const TCHAR registryPath[])
 : m_logLevel(0), m_listenPort(5500), m_historyLimit(32),
-  m_showToolbar(true), m_promptOnFullscreen(true),
+  m_showToolbar(true), m_promptOnFullscreen(true), m_qualityScaling(false),
   m_conHistory(&m_conHistoryKey, m_historyLimit),
   m_logger(0)
 {
@@ -79,6 +79,8 @@ bool ViewerConfig::loadFromStorage(SettingsManager *storage)
     loadAllOk = false;
   }
 
+  TEST_FAIL(storage->getBoolean(_T("QualityScaling"), &m_qualityScaling), loadAllOk);
+
   return loadAllOk;
 }
 
@@ -91,6 +93,7 @@ bool ViewerConfig::saveToStorage(SettingsManager *storage) const
   TEST_FAIL(storage->setInt(_T("HistoryLimit"), m_historyLimit), saveAllOk);
   TEST_FAIL(storage->setBoolean(_T("NoToolbar"), m_showToolbar), saveAllOk);
   TEST_FAIL(storage->setBoolean(_T("SkipFullScreenPrompt"), !m_promptOnFullscreen), saveAllOk);
+  TEST_FAIL(storage->setBoolean(_T("QualityScaling"), m_qualityScaling), saveAllOk);
 
   return saveAllOk;
 }
@@ -196,6 +199,18 @@ bool ViewerConfig::isPromptOnFullscreenEnabled() const
   return m_promptOnFullscreen;
 }
 
+void ViewerConfig::enableQualityScaling(bool enabled)
+{
+  AutoLock l(&m_cs);
+  m_qualityScaling = enabled;
+}
+
+bool ViewerConfig::isQualityScalingEnabled() const
+{
+  AutoLock l(&m_cs);
+  return m_qualityScaling;
+}
+
 const TCHAR *ViewerConfig::getPathToLogFile() const
 {
   AutoLock l(&m_cs);
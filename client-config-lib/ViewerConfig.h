@@ -91,6 +91,11 @@ public:
   // Returns "prompt on fullscreen flag"
   bool isPromptOnFullscreenEnabled() const;
 
+  // Sets "quality scaling" flag
+  void enableQualityScaling(bool enabled);
+  // Returns "quality scaling" flag
+  bool isQualityScalingEnabled() const;
+
   // Returns path to log file if file is avaliable to write,
   // returns NULL otherwise
   const TCHAR *getPathToLogFile() const;
@@ -111,6 +116,9 @@ protected:
   // If set then app must show promt dialog when viewer window
   // become fullscreen
   bool m_promptOnFullscreen;
+  // If set then scaled image is drawn with halftone stretching,
+  // otherwise with faster color-on-color stretching
+  bool m_qualityScaling;
   // Log file
   StringStorage m_pathToLogFile;
   StringStorage m_logName;
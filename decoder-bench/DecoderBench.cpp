@@ -0,0 +1,93 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DecoderBench.h"
+#include "viewer-core/SessionPlayer.h"
+#include "log-writer/LogWriter.h"
+#include "thread/AutoLock.h"
+#include "win-system/DynamicLibrary.h"
+#include "zlib/zlib.h"
+
+// QueryThreadCycleTime() is not available before Windows Vista.
+typedef BOOL (WINAPI *PFNQUERYTHREADCYCLETIME)(HANDLE, PULONG64);
+
+DecodeResult::DecodeResult()
+: records(0),
+  seconds(0.0),
+  cpuCycles(0),
+  checksum(0)
+{
+}
+
+DecoderBench::DecoderBench(const TCHAR *recordingFileName)
+: m_recordingFileName(recordingFileName)
+{
+}
+
+DecoderBench::~DecoderBench()
+{
+}
+
+void DecoderBench::run(DecodeResult *result)
+{
+  *result = DecodeResult();
+
+  LogWriter logWriter(0);
+  SessionPlayer player(m_recordingFileName.getString(), &logWriter);
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  HANDLE thread = GetCurrentThread();
+  DynamicLibrary kernel(_T("kernel32.dll"));
+  PFNQUERYTHREADCYCLETIME queryThreadCycleTime =
+    (PFNQUERYTHREADCYCLETIME)kernel.getProcAddress("QueryThreadCycleTime");
+
+  LARGE_INTEGER start, end;
+  ULONG64 startCycles = 0, endCycles = 0;
+  if (queryThreadCycleTime != 0) {
+    queryThreadCycleTime(thread, &startCycles);
+  }
+  QueryPerformanceCounter(&start);
+
+  while (player.playNext()) {
+    result->records++;
+  }
+
+  QueryPerformanceCounter(&end);
+  if (queryThreadCycleTime != 0) {
+    queryThreadCycleTime(thread, &endCycles);
+  }
+  result->cpuCycles = endCycles - startCycles;
+  result->seconds = (double)(end.QuadPart - start.QuadPart) /
+                    (double)frequency.QuadPart;
+
+  AutoLock al(player.getFbLock());
+  const FrameBuffer *fb = player.getFrameBuffer();
+  uLong checksum = crc32(0, Z_NULL, 0);
+  if (fb->getBufferSize() > 0) {
+    checksum = crc32(checksum, (const Bytef *)fb->getBuffer(),
+                     (uInt)fb->getBufferSize());
+  }
+  result->checksum = checksum;
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __DECODERBENCH_H__
+#define __DECODERBENCH_H__
+
+#include "util/StringStorage.h"
+
+// Results of one benchmark run.
+struct DecodeResult
+{
+  DecodeResult();
+
+  UINT64 records;
+  // Decoding time, reading the file is included.
+  double seconds;
+  // CPU cycles of the decoding thread, 0 if not supported by the system.
+  UINT64 cpuCycles;
+  // CRC-32 of the final frame buffer, equal for two builds of the decoders
+  // only if they draw the same pixels.
+  UINT32 checksum;
+};
+
+// Plays a session recording made by the server through the decoders of the
+// viewer as fast as possible.
+class DecoderBench
+{
+public:
+  DecoderBench(const TCHAR *recordingFileName);
+  virtual ~DecoderBench();
+
+  // Plays the whole recording with fresh decoders, so that every run is
+  // independent of the others. Throws Exception on failure.
+  void run(DecodeResult *result);
+
+private:
+  StringStorage m_recordingFileName;
+};
+
+#endif // __DECODERBENCH_H__
@@ -0,0 +1,60 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DecoderBench.h"
+#include "util/Exception.h"
+#include "util/StringParser.h"
+#include <stdio.h>
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  int runs = 3;
+  if (argc < 2 || argc > 3 ||
+      (argc == 3 && (!StringParser::parseInt(argv[2], &runs) || runs <= 0))) {
+    _ftprintf(stderr, _T("Usage: decoder-bench <session recording> [<runs>]\n"));
+    return 1;
+  }
+
+  try {
+    DecoderBench bench(argv[1]);
+    _tprintf(_T("%4s %8s %9s %10s %10s %8s\n"),
+             _T("run"), _T("records"), _T("seconds"), _T("records/s"),
+             _T("Mcycles"), _T("crc32"));
+    for (int i = 0; i < runs; i++) {
+      DecodeResult result;
+      bench.run(&result);
+
+      double speed = result.seconds > 0.0 ?
+        (double)result.records / result.seconds : 0.0;
+      _tprintf(_T("%4d %8llu %9.3f %10.1f %10.1f %08x\n"),
+               i + 1, result.records, result.seconds, speed,
+               (double)result.cpuCycles / 1000000.0,
+               (unsigned int)result.checksum);
+    }
+  } catch (Exception &e) {
+    _ftprintf(stderr, _T("Error: %s\n"), e.getMessage());
+    return 1;
+  }
+  return 0;
+}
@@ -23,13 +23,120 @@
 //
 
 #include "BlockingGate.h"
+#include "ReconnectException.h"
+#include "thread/AutoLock.h"
 
 BlockingGate::BlockingGate(Channel *stream)
-: DataInputStream(stream),
-  DataOutputStream(stream)
+: DataInputStream(0),
+  DataOutputStream(0),
+  m_lockDepth(0),
+  m_ownerThreadId(0)
 {
+  m_output = new BufferedOutputStream(stream);
+  m_input = new BufferedInputStream(stream);
+  m_tunnel = new Tunnel(this);
+
+  // Change real streams of the typed streams to our tunnel.
+  m_outStream = m_tunnel;
+  m_inputStream = m_tunnel;
 }
 
 BlockingGate::~BlockingGate()
 {
+  try {
+    m_output->flush();
+  } catch (...) {
+  }
+  delete m_tunnel;
+  delete m_input;
+  delete m_output;
+}
+
+void BlockingGate::lock()
+{
+  LocalMutex::lock();
+  if (m_lockDepth++ == 0) {
+    m_ownerThreadId = GetCurrentThreadId();
+  }
+}
+
+void BlockingGate::unlock()
+{
+  if (--m_lockDepth == 0) {
+    m_ownerThreadId = 0;
+    try {
+      sendOutput();
+    } catch (...) {
+      // A broken channel fails the next operation as well, and the
+      // message is lost on reconnection anyway.
+      m_output->discard();
+    }
+  }
+  LocalMutex::unlock();
+}
+
+void BlockingGate::flush()
+{
+  AutoLock al(this);
+  sendOutput();
+}
+
+size_t BlockingGate::readInput(void *buffer, size_t len)
+{
+  // The owner is going to read the reply to what it has written.
+  if (m_lockDepth > 0 && m_ownerThreadId == GetCurrentThreadId()) {
+    sendOutput();
+  }
+  try {
+    return m_input->read(buffer, len);
+  } catch (ReconnectException &) {
+    dropBuffers();
+    throw;
+  }
+}
+
+size_t BlockingGate::writeOutput(const void *buffer, size_t len)
+{
+  try {
+    return m_output->write(buffer, len);
+  } catch (ReconnectException &) {
+    dropBuffers();
+    throw;
+  }
+}
+
+void BlockingGate::sendOutput()
+{
+  try {
+    m_output->flush();
+  } catch (ReconnectException &) {
+    dropBuffers();
+    throw;
+  }
+}
+
+void BlockingGate::dropBuffers()
+{
+  m_output->discard();
+  m_input->discard();
+}
+
+BlockingGate::Tunnel::Tunnel(BlockingGate *gate)
+: m_gate(gate)
+{
+}
+
+size_t BlockingGate::Tunnel::read(void *buffer, size_t len)
+{
+  return m_gate->readInput(buffer, len);
+}
+
+size_t BlockingGate::Tunnel::available()
+{
+  return m_gate->m_input->available();
+}
+
+size_t BlockingGate::Tunnel::write(const void *buffer, size_t len)
+{
+  return m_gate->writeOutput(buffer, len);
 }
@@ -29,13 +29,64 @@
 #include "io-lib/Channel.h"
 #include "io-lib/DataOutputStream.h"
 #include "io-lib/DataInputStream.h"
+#include "io-lib/BufferedOutputStream.h"
+#include "io-lib/BufferedInputStream.h"
 
+// Typed, lockable access to a channel between the service and the desktop
+// process.
+//
+// A message is written with the gate locked. Its data are collected in a
+// buffer and go to the channel by one write when the outermost lock is
+// released, or before the lock owner starts reading the reply. The data
+// written with no lock (replies of the dispatcher thread) are sent by
+// flush(). Reads are served from a read-ahead buffer, so a message of many
+// fields costs one or a few pipe reads. All the buffered data are dropped
+// when the channel reports a reconnection, they belong to the old
+// transport.
 class BlockingGate : public LocalMutex, public DataOutputStream,
                      public DataInputStream
 {
 public:
   BlockingGate(Channel *stream);
   virtual ~BlockingGate();
+
+  virtual void lock();
+  // Sends the message written since the outermost lock(). A failure is not
+  // reported here, the next read or flush() fails instead.
+  virtual void unlock();
+
+  // Sends the buffered data now.
+  // @throw IOException on error.
+  virtual void flush() throw(IOException);
+
+private:
+  // Sits between the typed streams and the buffers.
+  class Tunnel : public InputStream, public OutputStream
+  {
+  public:
+    Tunnel(BlockingGate *gate);
+
+    virtual size_t read(void *buffer, size_t len);
+    virtual size_t available();
+    virtual size_t write(const void *buffer, size_t len);
+
+  private:
+    BlockingGate *m_gate;
+  };
+
+  size_t readInput(void *buffer, size_t len);
+  size_t writeOutput(const void *buffer, size_t len);
+  void sendOutput();
+  void dropBuffers();
+
+  BufferedOutputStream *m_output;
+  BufferedInputStream *m_input;
+  Tunnel *m_tunnel;
+
+  // Depth of lock() calls and the thread which made them, changed with
+  // the gate locked.
+  int m_lockDepth;
+  DWORD m_ownerThreadId;
 };
 
 #endif // _BLOCKING_GATE_H_
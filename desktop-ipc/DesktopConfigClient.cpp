@@ -25,6 +25,7 @@
 #include "DesktopConfigClient.h"
 #include "thread/AutoLock.h"
 #include "ReconnectException.h"
+#include "server-config-lib/Configurator.h"
 
 DesktopConfigClient::DesktopConfigClient(BlockingGate *forwGate)
 : DesktopServerProto(forwGate)
@@ -44,6 +45,18 @@ void DesktopConfigClient::updateByNewSettings(BlockingGate *gate)
 
 bool DesktopConfigClient::isRemoteInputAllowed()
 {
+  // The answer is known here without asking the desktop process when the
+  // local input priority is off, or when the last local input it reported
+  // is still within the blocking interval.
+  ServerConfig *srvConf = Configurator::getInstance()->getServerConfig();
+  if (!srvConf->isLocalInputPriorityEnabled()) {
+    return true;
+  }
+  UINT64 interval = (UINT64)srvConf->getLocalInputPriorityTimeout() * 1000;
+  if ((DateTime::now() - m_lastInputTime).getTime() < interval) {
+    return false;
+  }
+
   bool result = false;
   try {
     AutoLock al(m_forwGate);
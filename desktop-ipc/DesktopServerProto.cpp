@@ -25,6 +25,7 @@
 #include "DesktopServerProto.h"
 #include "server-config-lib/Configurator.h"
 #include "util/Exception.h"
+#include "region/RectSerializer.h"
 
 DesktopServerProto::DesktopServerProto(BlockingGate *forwGate)
 : m_forwGate(forwGate)
@@ -159,28 +160,48 @@ void DesktopServerProto::sendRect(const Rect *rect,
 void DesktopServerProto::sendRegion(const Region *region, BlockingGate *gate)
 {
   std::vector<Rect> rects;
-  std::vector<Rect>::iterator iRect;
   region->getRectVector(&rects);
-
-  unsigned int numRects = (unsigned int)rects.size();
-  _ASSERT(numRects == rects.size());
-  gate->writeUInt32(numRects);
-
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    Rect *rect = &(*iRect);
-    sendRect(rect, gate);
-  }
+  sendRects(&rects, gate);
 }
 
 void DesktopServerProto::readRegion(Region *region, BlockingGate *gate)
 {
   region->clear();
-  unsigned int rectCount = gate->readUInt32();
-  for (unsigned int i = 0; i < rectCount; i++) {
-    Rect r = readRect(gate);
-    if (r.isValid()) {
-      region->addRect(&r);
-    }
+  std::vector<Rect> rects;
+  readRects(&rects, gate);
+  region->addRects(&rects);
+}
+
+void DesktopServerProto::sendRects(const std::vector<Rect> *rects,
+                                   BlockingGate *gate)
+{
+  std::vector<UINT8> data;
+  RectSerializer::toBytes(rects, &data);
+
+  UINT32 dataSize = (UINT32)data.size();
+  _ASSERT(dataSize == data.size());
+  gate->writeUInt32(dataSize);
+  gate->writeFully(&data.front(), data.size());
+}
+
+void DesktopServerProto::readRects(std::vector<Rect> *rects,
+                                   BlockingGate *gate)
+{
+  UINT32 dataSize = gate->readUInt32();
+  if (dataSize == 0 || dataSize > MAX_RECTS_DATA_SIZE) {
+    StringStorage errMess;
+    errMess.format(_T("Wrong size of rectangle list (%u)"), dataSize);
+    throw Exception(errMess.getString());
+  }
+  std::vector<UINT8> data(dataSize);
+  gate->readFully(&data.front(), data.size());
+
+  if (RectSerializer::fromBytes(&data.front(), data.size(), rects) != dataSize) {
+    throw Exception(_T("Wrong rectangle list"));
+  }
+  std::vector<Rect>::iterator iRect;
+  for (iRect = rects->begin(); iRect != rects->end(); iRect++) {
+    checkRectangle(&(*iRect));
   }
 }
 
@@ -315,6 +336,15 @@ void DesktopServerProto::sendConfigSettings(BlockingGate *gate)
   gate->writeUInt32(srvConf->getVideoRecognitionInterval());
   // Send socket timeout
   gate->writeUInt32(srvConf->getIdleTimeout());
+  // Send tile size of changed areas detection
+  gate->writeUInt32(srvConf->getDirtyTileSize());
+  gate->writeUInt8(srvConf->isGpuChangeDetectionEnabled());
+  gate->writeUInt8(srvConf->isVblankPacedCaptureEnabled());
+  gate->writeUInt8(srvConf->isAutoVideoDetectionEnabled());
+  StringStorage syntheticWorkload;
+  srvConf->getSyntheticWorkload(&syntheticWorkload);
+  gate->writeUTF8(syntheticWorkload.getString());
+  gate->writeUInt32(srvConf->getSyntheticWorkloadSeed());
 }
 
 void DesktopServerProto::readConfigSettings(BlockingGate *gate)
@@ -356,4 +386,13 @@ void DesktopServerProto::readConfigSettings(BlockingGate *gate)
   srvConf->setVideoRecognitionInterval(gate->readUInt32());
   // Receive socket timeout
   srvConf->setIdleTimeout(gate->readUInt32());
+  // Receive tile size of changed areas detection
+  srvConf->setDirtyTileSize(gate->readUInt32());
+  srvConf->enableGpuChangeDetection(gate->readUInt8() != 0);
+  srvConf->enableVblankPacedCapture(gate->readUInt8() != 0);
+  srvConf->enableAutoVideoDetection(gate->readUInt8() != 0);
+  StringStorage syntheticWorkload;
+  gate->readUTF8(&syntheticWorkload);
+  srvConf->setSyntheticWorkload(syntheticWorkload.getString());
+  srvConf->setSyntheticWorkloadSeed(gate->readUInt32());
 }
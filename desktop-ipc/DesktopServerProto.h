@@ -57,6 +57,13 @@ protected:
                           BlockingGate *gate);
   virtual void readRegion(Region *region,
                           BlockingGate *gate);
+  // Send and read a list of rectangles in the compact form of
+  // RectSerializer by one write and one read. The read rectangles are
+  // checked by checkRectangle().
+  virtual void sendRects(const std::vector<Rect> *rects,
+                         BlockingGate *gate);
+  virtual void readRects(std::vector<Rect> *rects,
+                         BlockingGate *gate);
 
   void sendFrameBuffer(const FrameBuffer *srcFb, const Rect *srcRect,
                        BlockingGate *gate);
@@ -84,6 +91,9 @@ protected:
   virtual void sendConfigSettings(BlockingGate *gate);
   virtual void readConfigSettings(BlockingGate *gate);
 
+  // Limit of the compact rectangle data, in bytes.
+  static const UINT32 MAX_RECTS_DATA_SIZE = 16 * 1024 * 1024;
+
   // FIXME: Remove m_forwGate from this class.
   // Forward gate will send requests
   BlockingGate *m_forwGate;
@@ -93,6 +103,11 @@ protected:
   static const UINT8 FRAME_BUFFER_INIT = 2;
   static const UINT8 SET_FULL_UPD_REQ_REGION = 3;
   static const UINT8 SET_EXCLUDING_REGION = 4;
+  static const UINT8 SET_SHARED_FRAME_BUFFER = 5;
+  static const UINT8 CAPTURE_STATS_REQ = 6;
+  static const UINT8 SET_CAPTURE_REGION = 7;
+  static const UINT8 SET_VISUAL_EFFECTS_LEVEL = 8;
+  static const UINT8 SET_CAPTURE_DEMAND = 9;
   static const UINT8 UPDATE_DETECTED = 10;
 
   static const UINT8 CLIPBOARD_CHANGED = 30;
@@ -108,6 +123,17 @@ protected:
   static const UINT8 NORMALIZE_RECT_REQ = 40;
   static const UINT8 APPLICATION_CHECK_FOCUS = 41;
   static const UINT8 DISPLAYS_COORDS_REQ = 42;
+  // A number of POINTER_POS_CHANGED and KEYBOARD_EVENT messages sent by one
+  // write and applied by one SendInput() call.
+  static const UINT8 INPUT_EVENTS = 43;
+  static const UINT8 FOREGROUND_WINDOW_COORDS_REQ = 44;
+  // Sent by the server once after an APPLICATION_REGION_REQ when the
+  // top-level windows change.
+  static const UINT8 WINDOWS_CHANGED = 45;
+  // Sent by the server after the initialization and when the display
+  // layout changes: the displays, the primary display and the position of
+  // the frame buffer on the virtual screen.
+  static const UINT8 DISPLAYS_CHANGED = 46;
 
   static const UINT8 CONFIG_RELOAD_REQ = 50;
   static const UINT8 SOFT_INPUT_ENABLING_REQ = 51;
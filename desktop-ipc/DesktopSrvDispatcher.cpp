@@ -68,6 +68,9 @@ void DesktopSrvDispatcher::execute()
         throw Exception(errMess.getString());
       }
       (*iter).second->onRequest(code, m_gate);
+      // The handlers write their replies with no lock, so the reply is
+      // buffered until this point and goes to the pipe by one write.
+      m_gate->flush();
     } catch (ReconnectException &) {
       m_log->message(_T("The DesktopServerApplication dispatcher has been reconnected"));
     } catch (Exception &e) {
@@ -0,0 +1,79 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SharedFrameBuffer.h"
+#include <time.h>
+
+SharedFrameBuffer::SharedFrameBuffer(const TCHAR *name, const Dimension *dim,
+                                     const PixelFormat *pf)
+: m_name(name),
+  m_memory(name, HEADER_SIZE + dim->area() * (pf->bitsPerPixel / 8))
+{
+  m_generation = (volatile UINT32 *)m_memory.getMemPointer();
+  m_frameBuffer.setPropertiesWithoutResize(dim, pf);
+  m_frameBuffer.setBuffer((UINT8 *)m_memory.getMemPointer() + HEADER_SIZE);
+}
+
+SharedFrameBuffer::~SharedFrameBuffer()
+{
+  // The buffer belongs to the shared memory object.
+  m_frameBuffer.setBuffer(0);
+}
+
+void SharedFrameBuffer::generateName(StringStorage *name)
+{
+  static unsigned int counter = 0;
+  srand((unsigned)time(0) ^ GetCurrentProcessId() ^ (++counter << 16));
+  name->format(_T("Global\\TvnFrameBuffer%u_"), counter);
+  for (int i = 0; i < 20; i++) {
+    name->appendChar('a' + rand() % ('z' - 'a'));
+  }
+}
+
+const TCHAR *SharedFrameBuffer::getName() const
+{
+  return m_name.getString();
+}
+
+bool SharedFrameBuffer::hasProperties(const Dimension *dim, const PixelFormat *pf) const
+{
+  Dimension ownDim = m_frameBuffer.getDimension();
+  PixelFormat ownPf = m_frameBuffer.getPixelFormat();
+  return ownDim.isEqualTo(dim) && ownPf.isEqualTo(pf);
+}
+
+FrameBuffer *SharedFrameBuffer::getFrameBuffer()
+{
+  return &m_frameBuffer;
+}
+
+UINT32 SharedFrameBuffer::nextGeneration()
+{
+  return ++(*m_generation);
+}
+
+UINT32 SharedFrameBuffer::getGeneration() const
+{
+  return *m_generation;
+}
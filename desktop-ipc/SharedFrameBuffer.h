@@ -0,0 +1,72 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SHAREDFRAMEBUFFER_H__
+#define __SHAREDFRAMEBUFFER_H__
+
+#include "win-system/SharedMemory.h"
+#include "rfb/FrameBuffer.h"
+#include "util/StringStorage.h"
+
+// SharedFrameBuffer is a frame buffer placed in a named shared memory
+// object, so the desktop server process can pass pixels to the service
+// without sending them through the pipe. The memory begins with a header
+// holding a generation number. The writer increases it every time it has
+// completed writing pixels and reports the value through the pipe, so the
+// reader can make sure it reads exactly the data that has been announced.
+class SharedFrameBuffer
+{
+public:
+  // Creates the shared memory object or opens the existing one with the
+  // specified name for a frame buffer with the specified properties.
+  // @throw Exception on an error.
+  SharedFrameBuffer(const TCHAR *name, const Dimension *dim, const PixelFormat *pf);
+  virtual ~SharedFrameBuffer();
+
+  // Generates a new unique and hard to guess name for a shared frame
+  // buffer in the global namespace.
+  static void generateName(StringStorage *name);
+
+  const TCHAR *getName() const;
+
+  // Returns true if the frame buffer has the specified properties.
+  bool hasProperties(const Dimension *dim, const PixelFormat *pf) const;
+
+  FrameBuffer *getFrameBuffer();
+
+  // Increases the generation number, returns the new value.
+  UINT32 nextGeneration();
+  UINT32 getGeneration() const;
+
+private:
+  // The header size keeps the pixels aligned.
+  static const size_t HEADER_SIZE = 64;
+
+  StringStorage m_name;
+  SharedMemory m_memory;
+  volatile UINT32 *m_generation;
+  FrameBuffer m_frameBuffer;
+};
+
+#endif // __SHAREDFRAMEBUFFER_H__
@@ -25,6 +25,8 @@
 #include "win-system/PipeClient.h"
 #include "UpdateHandlerClient.h"
 #include "ReconnectException.h"
+#include "server-config-lib/Configurator.h"
+#include "log-writer/StallWatchdog.h"
 
 UpdateHandlerClient::UpdateHandlerClient(BlockingGate *forwGate,
                                          DesktopSrvDispatcher *dispatcher,
@@ -32,6 +34,7 @@ UpdateHandlerClient::UpdateHandlerClient(BlockingGate *forwGate,
                                          LogWriter *log)
 : DesktopServerProto(forwGate),
   m_externalUpdateListener(externalUpdateListener),
+  m_sharedFb(0),
   m_log(log)
 {
   dispatcher->registerNewHandle(UPDATE_DETECTED, this);
@@ -49,6 +52,7 @@ UpdateHandlerClient::UpdateHandlerClient(BlockingGate *forwGate,
 
 UpdateHandlerClient::~UpdateHandlerClient()
 {
+  delete m_sharedFb;
 }
 
 void UpdateHandlerClient::onRequest(UINT8 reqCode, BlockingGate *backGate)
@@ -70,6 +74,8 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
 {
   updateContainer->clear();
 
+  // Includes the wait for the gate, which other requests may hold.
+  StallWatchdog::Activity ipcActivity(StallWatchdog::IPC);
   AutoLock al(m_forwGate);
 
   UpdateContainer updCont;
@@ -111,26 +117,49 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
       readFrameBuffer(&m_backupFrameBuffer, &fbRect, m_forwGate);
     }
 
+    // Check whether pixels are passed via the shared frame buffer.
+    bool pixelsShared = m_forwGate->readUInt8() != 0;
+    if (pixelsShared) {
+      UINT32 generation = m_forwGate->readUInt32();
+      if (m_sharedFb == 0 || m_sharedFb->getGeneration() != generation) {
+        // Should never happen because the server writes pixels only while
+        // replying to this request. Keep reading to stay in sync.
+        m_log->error(_T("UpdateHandlerClient: the shared frame buffer doesn't")
+                     _T(" contain the announced pixels"));
+        pixelsShared = m_sharedFb != 0;
+      }
+    }
+
     // Get video region
     m_log->debug(_T("UpdateHandlerClient: Get video region"));
     readRegion(&updCont.videoRegion, m_forwGate);
     // Get changed region
-    unsigned int countChangedRect = m_forwGate->readUInt32();
-    m_log->info(_T("UpdateHandlerClient: count changed rectangles = %u"), countChangedRect);
-    for (unsigned int i = 0; i < countChangedRect; i++) {
-      Rect r = readRect(m_forwGate);
-      updCont.changedRegion.addRect(&r);
-      readFrameBuffer(&m_backupFrameBuffer, &r, m_forwGate);
+    std::vector<Rect> rects;
+    readRects(&rects, m_forwGate);
+    m_log->info(_T("UpdateHandlerClient: count changed rectangles = %u"),
+                (unsigned int)rects.size());
+    std::vector<Rect>::iterator iRect;
+    for (iRect = rects.begin(); iRect != rects.end(); iRect++) {
+      readPixels(&(*iRect), pixelsShared, m_forwGate);
     }
+    updCont.changedRegion.addRects(&rects);
 
-    // Get "copyrect"
-    unsigned char hasCopyRect = m_forwGate->readUInt8();
-    if (hasCopyRect) {
-      m_log->info(_T("UpdateHandlerClient: has \"CopyRect\""));
-      updCont.copySrc = readPoint(m_forwGate);
-      Rect r = readRect(m_forwGate);
-      updCont.copiedRegion.addRect(&r);
-      readFrameBuffer(&m_backupFrameBuffer, &r, m_forwGate);
+    // Get "copyrect" moves
+    unsigned int countMoves = m_forwGate->readUInt32();
+    if (countMoves != 0) {
+      m_log->info(_T("UpdateHandlerClient: %u \"CopyRect\" moves"), countMoves);
+    }
+    updCont.copies.reserve(countMoves);
+    for (unsigned int i = 0; i < countMoves; i++) {
+      // The move is filled in place, copying it would copy its region.
+      updCont.copies.push_back(CopyMove());
+      CopyMove &move = updCont.copies.back();
+      move.offset = readPoint(m_forwGate);
+      readRects(&rects, m_forwGate);
+      for (iRect = rects.begin(); iRect != rects.end(); iRect++) {
+        readPixels(&(*iRect), pixelsShared, m_forwGate);
+      }
+      move.region.addRects(&rects);
     }
 
     // Get cursor position if it has been changed.
@@ -161,10 +190,17 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
       }
     }
 
+    updCont.captureTime = m_forwGate->readInt64();
+
+    // The shared frame buffer must follow the new screen properties.
+    if (updCont.screenSizeChanged) {
+      announceSharedFrameBuffer(m_forwGate);
+    }
+
   } catch (ReconnectException &) {
     m_log->info(_T("UpdateHandlerClient: ReconnectException catching in the extract function"));
   }
-  *updateContainer = updCont;
+  updateContainer->swap(&updCont);
 }
 
 void UpdateHandlerClient::setFullUpdateRequested(const Region *region)
@@ -189,11 +225,55 @@ void UpdateHandlerClient::setExcludedRegion(const Region *excludedRegion)
   }
 }
 
+void UpdateHandlerClient::setCaptureRegion(const Region *captureRegion)
+{
+  AutoLock al(m_forwGate);
+
+  try {
+    m_forwGate->writeUInt8(SET_CAPTURE_REGION);
+    m_forwGate->writeUInt8(captureRegion != 0 ? 1 : 0);
+    if (captureRegion != 0) {
+      sendRegion(captureRegion, m_forwGate);
+    }
+  } catch (ReconnectException &) {
+  }
+}
+
+void UpdateHandlerClient::setVisualEffectsLevel(int level)
+{
+  AutoLock al(m_forwGate);
+
+  try {
+    m_forwGate->writeUInt8(SET_VISUAL_EFFECTS_LEVEL);
+    m_forwGate->writeUInt8((UINT8)level);
+  } catch (ReconnectException &) {
+  }
+}
+
+void UpdateHandlerClient::setCaptureDemand(bool demanded)
+{
+  AutoLock al(m_forwGate);
+
+  try {
+    m_forwGate->writeUInt8(SET_CAPTURE_DEMAND);
+    m_forwGate->writeUInt8(demanded ? 1 : 0);
+  } catch (ReconnectException &) {
+  }
+}
+
 bool UpdateHandlerClient::checkForUpdates(Region *region)
 {
   return false;
 }
 
+void UpdateHandlerClient::getCaptureStatistics(CaptureStatistics *stats)
+{
+  AutoLock al(m_forwGate);
+
+  m_forwGate->writeUInt8(CAPTURE_STATS_REQ);
+  stats->deserialize(m_forwGate);
+}
+
 void UpdateHandlerClient::getScreenProperties(PixelFormat *pf, Dimension *dim)
 {
   AutoLock al(m_forwGate);
@@ -212,4 +292,43 @@ void UpdateHandlerClient::sendInit(BlockingGate *gate)
   Dimension dim = m_backupFrameBuffer.getDimension();
   sendDimension(&dim, gate);
   sendFrameBuffer(&m_backupFrameBuffer, &dim.getRect(), gate);
+
+  announceSharedFrameBuffer(gate);
+}
+
+void UpdateHandlerClient::announceSharedFrameBuffer(BlockingGate *gate)
+{
+  delete m_sharedFb;
+  m_sharedFb = 0;
+  if (!Configurator::getInstance()->getServerConfig()->isSharedFrameBufferEnabled()) {
+    return;
+  }
+
+  PixelFormat pf = m_backupFrameBuffer.getPixelFormat();
+  Dimension dim = m_backupFrameBuffer.getDimension();
+  try {
+    StringStorage name;
+    SharedFrameBuffer::generateName(&name);
+    m_sharedFb = new SharedFrameBuffer(name.getString(), &dim, &pf);
+  } catch (Exception &e) {
+    m_log->error(_T("UpdateHandlerClient: can't create shared frame buffer: %s"),
+                 e.getMessage());
+    return;
+  }
+
+  gate->writeUInt8(SET_SHARED_FRAME_BUFFER);
+  gate->writeUTF8(m_sharedFb->getName());
+  sendPixelFormat(&pf, gate);
+  sendDimension(&dim, gate);
+}
+
+void UpdateHandlerClient::readPixels(const Rect *dstRect, bool fromSharedFb,
+                                     BlockingGate *gate)
+{
+  if (fromSharedFb) {
+    m_backupFrameBuffer.copyFrom(dstRect, m_sharedFb->getFrameBuffer(),
+                                 dstRect->left, dstRect->top);
+  } else {
+    readFrameBuffer(&m_backupFrameBuffer, dstRect, gate);
+  }
 }
@@ -28,6 +28,7 @@
 #include "desktop/UpdateHandler.h"
 #include "DesktopServerProto.h"
 #include "DesktopSrvDispatcher.h"
+#include "SharedFrameBuffer.h"
 #include "log-writer/LogWriter.h"
 
 class UpdateHandlerClient : public UpdateHandler, public DesktopServerProto,
@@ -41,7 +42,11 @@ public:
   virtual void extract(UpdateContainer *updateContainer);
   virtual void setFullUpdateRequested(const Region *region);
   virtual void setExcludedRegion(const Region *excludedRegion);
+  virtual void setCaptureRegion(const Region *captureRegion);
+  virtual void setVisualEffectsLevel(int level);
+  virtual void setCaptureDemand(bool demanded);
   virtual bool checkForUpdates(Region *region);
+  virtual void getCaptureStatistics(CaptureStatistics *stats);
 
 protected:
   virtual void getScreenProperties(PixelFormat *pf, Dimension *dim);
@@ -50,8 +55,18 @@ protected:
   // To catch update event
   virtual void onRequest(UINT8 reqCode, BlockingGate *backGate);
 
+  // Creates a new shared frame buffer matching m_backupFrameBuffer and
+  // announces it to the server, if the shared frame buffer is enabled.
+  void announceSharedFrameBuffer(BlockingGate *gate);
+  // Reads pixels of the dstRect into m_backupFrameBuffer from the shared
+  // frame buffer or from the gate.
+  void readPixels(const Rect *dstRect, bool fromSharedFb, BlockingGate *gate);
+
   UpdateListener *m_externalUpdateListener;
 
+  // Frame buffer shared with the server, 0 if pixels are sent via the pipe.
+  SharedFrameBuffer *m_sharedFb;
+
   LogWriter *m_log;
 };
 
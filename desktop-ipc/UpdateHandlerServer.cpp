@@ -31,6 +31,7 @@ UpdateHandlerServer::UpdateHandlerServer(BlockingGate *forwGate,
 : DesktopServerProto(forwGate),
   m_extTerminationListener(extTerminationListener),
   m_log(log),
+  m_sharedFb(0),
   m_scrDriverFactory(Configurator::getInstance()->getServerConfig())
 {
   m_updateHandler = new UpdateHandlerImpl(this, &m_scrDriverFactory, log);
@@ -40,12 +41,18 @@ UpdateHandlerServer::UpdateHandlerServer(BlockingGate *forwGate,
   dispatcher->registerNewHandle(SET_FULL_UPD_REQ_REGION, this);
   dispatcher->registerNewHandle(SET_EXCLUDING_REGION, this);
   dispatcher->registerNewHandle(FRAME_BUFFER_INIT, this);
+  dispatcher->registerNewHandle(SET_SHARED_FRAME_BUFFER, this);
+  dispatcher->registerNewHandle(CAPTURE_STATS_REQ, this);
+  dispatcher->registerNewHandle(SET_CAPTURE_REGION, this);
+  dispatcher->registerNewHandle(SET_VISUAL_EFFECTS_LEVEL, this);
+  dispatcher->registerNewHandle(SET_CAPTURE_DEMAND, this);
   m_log->debug(_T("UpdateHandlerServer created"));
 }
 
 UpdateHandlerServer::~UpdateHandlerServer()
 {
   delete m_updateHandler;
+  delete m_sharedFb;
 }
 
 void UpdateHandlerServer::onUpdate()
@@ -85,6 +92,26 @@ void UpdateHandlerServer::onRequest(UINT8 reqCode, BlockingGate *backGate)
     // Init from client
     serverInit(backGate);
     break;
+  case SET_SHARED_FRAME_BUFFER:
+    m_log->debug(_T("UpdateHandlerServer, SET_SHARED_FRAME_BUFFER recieved"));
+    receiveSharedFrameBuffer(backGate);
+    break;
+  case CAPTURE_STATS_REQ:
+    m_log->debug(_T("UpdateHandlerServer, CAPTURE_STATS_REQ recieved"));
+    captureStatsReply(backGate);
+    break;
+  case SET_CAPTURE_REGION:
+    m_log->debug(_T("UpdateHandlerServer, SET_CAPTURE_REGION recieved"));
+    receiveCaptureReg(backGate);
+    break;
+  case SET_VISUAL_EFFECTS_LEVEL:
+    m_log->debug(_T("UpdateHandlerServer, SET_VISUAL_EFFECTS_LEVEL recieved"));
+    receiveVisualEffectsLevel(backGate);
+    break;
+  case SET_CAPTURE_DEMAND:
+    m_log->debug(_T("UpdateHandlerServer, SET_CAPTURE_DEMAND recieved"));
+    receiveCaptureDemand(backGate);
+    break;
   default:
     StringStorage errMess;
     errMess.format(_T("Unknown %d protocol code received from a pipe client"),
@@ -121,34 +148,52 @@ void UpdateHandlerServer::extractReply(BlockingGate *backGate)
     sendFrameBuffer(fb, &fbRect, backGate);
   }
 
+  std::vector<Rect> rects;
+  std::vector<Rect>::iterator iRect;
+  updCont.changedRegion.getRectVector(&rects);
+  std::vector<Rect> copyRects;
+  std::vector<CopyMove>::const_iterator iMove;
+
+  // Pass pixels via the shared frame buffer if possible and tell the
+  // client which generation of it holds them.
+  std::vector<Rect> pixelRects(rects);
+  for (iMove = updCont.copies.begin(); iMove != updCont.copies.end(); iMove++) {
+    iMove->getRects(&copyRects);
+    pixelRects.insert(pixelRects.end(), copyRects.begin(), copyRects.end());
+  }
+  bool pixelsShared = writeToSharedFrameBuffer(fb, &pixelRects);
+  backGate->writeUInt8(pixelsShared);
+  if (pixelsShared) {
+    backGate->writeUInt32(m_sharedFb->nextGeneration());
+  }
+
   // Send video region
   m_log->debug(_T("UpdateHandlerServer: Send video region"));
   sendRegion(&updCont.videoRegion, backGate);
   // Send changed region
-  std::vector<Rect> rects;
-  std::vector<Rect>::iterator iRect;
-  updCont.changedRegion.getRectVector(&rects);
-  unsigned int countChangedRect = (unsigned int)rects.size();
-  _ASSERT(countChangedRect == rects.size());
-  m_log->debug(_T("UpdateHandlerServer: send %u changed rectangles"), countChangedRect);
-  backGate->writeUInt32(countChangedRect);
-
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    Rect *rect = &(*iRect);
-    sendRect(rect, backGate);
-    sendFrameBuffer(fb, rect, backGate);
+  m_log->debug(_T("UpdateHandlerServer: send %u changed rectangles"),
+               (unsigned int)rects.size());
+  // The pixels of the rectangles follow the whole list.
+  sendRects(&rects, backGate);
+  if (!pixelsShared) {
+    for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
+      sendFrameBuffer(fb, &(*iRect), backGate);
+    }
   }
 
-  // Send "copyrect"
-  m_log->debug(_T("UpdateHandlerServer: Send copyrect"));
-  bool hasCopyRect = !updCont.copiedRegion.isEmpty();
-  backGate->writeUInt8(hasCopyRect);
-  if (hasCopyRect) {
-    sendPoint(&updCont.copySrc, backGate);
-    updCont.copiedRegion.getRectVector(&rects);
-    iRect = rects.begin();
-    sendRect(&(*iRect), backGate);
-    sendFrameBuffer(fb, &(*iRect), backGate);
+  // Send "copyrect" moves in the order they must be applied.
+  m_log->debug(_T("UpdateHandlerServer: Send %u copyrect moves"),
+               (unsigned int)updCont.copies.size());
+  backGate->writeUInt32((unsigned int)updCont.copies.size());
+  for (iMove = updCont.copies.begin(); iMove != updCont.copies.end(); iMove++) {
+    sendPoint(&iMove->offset, backGate);
+    iMove->getRects(&copyRects);
+    sendRects(&copyRects, backGate);
+    if (!pixelsShared) {
+      for (iRect = copyRects.begin(); iRect < copyRects.end(); iRect++) {
+        sendFrameBuffer(fb, &(*iRect), backGate);
+      }
+    }
   }
 
   // Send cursor position if it has been changed.
@@ -171,6 +216,10 @@ void UpdateHandlerServer::extractReply(BlockingGate *backGate)
       backGate->writeFully((void *)curSh->getMask(), curSh->getMaskSize());
     }
   }
+
+  // The performance counter is common for the processes, so the capture
+  // time needs no conversion.
+  backGate->writeInt64(updCont.captureTime);
   m_log->debug(_T("UpdateHandlerServer::extractReply finished"));
 }
 
@@ -181,6 +230,13 @@ void UpdateHandlerServer::screenPropReply(BlockingGate *backGate)
   sendDimension(&fb->getDimension(), backGate);
 }
 
+void UpdateHandlerServer::captureStatsReply(BlockingGate *backGate)
+{
+  CaptureStatistics stats;
+  m_updateHandler->getCaptureStatistics(&stats);
+  stats.serialize(backGate);
+}
+
 void UpdateHandlerServer::receiveFullReqReg(BlockingGate *backGate)
 {
   Region region;
@@ -195,6 +251,69 @@ void UpdateHandlerServer::receiveExcludingReg(BlockingGate *backGate)
   m_updateHandler->setExcludedRegion(&region);
 }
 
+void UpdateHandlerServer::receiveCaptureReg(BlockingGate *backGate)
+{
+  bool limited = backGate->readUInt8() != 0;
+  if (limited) {
+    Region region;
+    readRegion(&region, backGate);
+    m_updateHandler->setCaptureRegion(&region);
+  } else {
+    m_updateHandler->setCaptureRegion(0);
+  }
+}
+
+void UpdateHandlerServer::receiveVisualEffectsLevel(BlockingGate *backGate)
+{
+  m_updateHandler->setVisualEffectsLevel(backGate->readUInt8());
+}
+
+void UpdateHandlerServer::receiveCaptureDemand(BlockingGate *backGate)
+{
+  m_updateHandler->setCaptureDemand(backGate->readUInt8() != 0);
+}
+
+void UpdateHandlerServer::receiveSharedFrameBuffer(BlockingGate *backGate)
+{
+  StringStorage name;
+  backGate->readUTF8(&name);
+  PixelFormat pf;
+  readPixelFormat(&pf, backGate);
+  Dimension dim = readDimension(backGate);
+
+  delete m_sharedFb;
+  m_sharedFb = 0;
+  try {
+    m_sharedFb = new SharedFrameBuffer(name.getString(), &dim, &pf);
+    m_log->info(_T("UpdateHandlerServer: using shared frame buffer %dx%d"),
+                dim.width, dim.height);
+  } catch (Exception &e) {
+    m_log->error(_T("UpdateHandlerServer: can't open shared frame buffer: %s"),
+                 e.getMessage());
+  }
+}
+
+bool UpdateHandlerServer::writeToSharedFrameBuffer(const FrameBuffer *fb,
+                                                   const std::vector<Rect> *rects)
+{
+  if (m_sharedFb == 0) {
+    return false;
+  }
+  Dimension fbDim = fb->getDimension();
+  PixelFormat fbPf = fb->getPixelFormat();
+  if (!m_sharedFb->hasProperties(&fbDim, &fbPf)) {
+    // The client will announce a new shared frame buffer after it learns
+    // the new screen properties.
+    return false;
+  }
+  FrameBuffer *sharedFb = m_sharedFb->getFrameBuffer();
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = rects->begin(); iRect < rects->end(); iRect++) {
+    sharedFb->copyFrom(&(*iRect), fb, iRect->left, iRect->top);
+  }
+  return true;
+}
+
 void UpdateHandlerServer::serverInit(BlockingGate *backGate)
 {
   // FIXME: Use another method to initialize m_backupFrameBuffer
@@ -30,6 +30,7 @@
 #include "DesktopSrvDispatcher.h"
 #include "log-writer/LogWriter.h"
 #include "desktop/Win32ScreenDriverFactory.h"
+#include "SharedFrameBuffer.h"
 
 class UpdateHandlerServer: public DesktopServerProto, public ClientListener,
                            public UpdateListener
@@ -52,14 +53,26 @@ protected:
 
   void extractReply(BlockingGate *backGate);
   void screenPropReply(BlockingGate *backGate);
+  void captureStatsReply(BlockingGate *backGate);
   void receiveFullReqReg(BlockingGate *backGate);
   void receiveExcludingReg(BlockingGate *backGate);
+  void receiveCaptureReg(BlockingGate *backGate);
+  void receiveVisualEffectsLevel(BlockingGate *backGate);
+  void receiveCaptureDemand(BlockingGate *backGate);
+  void receiveSharedFrameBuffer(BlockingGate *backGate);
+
+  // Copies pixels of the rects to m_sharedFb if it can be used for the fb
+  // frame buffer. Returns true on success.
+  bool writeToSharedFrameBuffer(const FrameBuffer *fb, const std::vector<Rect> *rects);
 
   Win32ScreenDriverFactory m_scrDriverFactory;
 
   PixelFormat m_oldPf;
 
   UpdateHandlerImpl *m_updateHandler;
+
+  // Frame buffer shared with the client, 0 if pixels are sent via the pipe.
+  SharedFrameBuffer *m_sharedFb;
   AnEventListener *m_extTerminationListener;
 
   LogWriter *m_log;
@@ -26,15 +26,24 @@
 #include "thread/AutoLock.h"
 #include "ReconnectException.h"
 #include "util/BrokenHandleException.h"
+#include "io-lib/ByteArrayOutputStream.h"
+#include "io-lib/DataOutputStream.h"
 
 UserInputClient::UserInputClient(BlockingGate *forwGate,
                                  DesktopSrvDispatcher *dispatcher,
                                  ClipboardListener *clipboardListener)
 : DesktopServerProto(forwGate),
   m_clipboardListener(clipboardListener),
-  m_sendMouseFlags(0)
+  m_sendMouseFlags(0),
+  m_batchDepth(0),
+  m_windowsGeneration(0),
+  m_appRegionGeneration(-1),
+  m_appRegionProcId(0),
+  m_displaysValid(false)
 {
   dispatcher->registerNewHandle(CLIPBOARD_CHANGED, this);
+  dispatcher->registerNewHandle(WINDOWS_CHANGED, this);
+  dispatcher->registerNewHandle(DISPLAYS_CHANGED, this);
 }
 
 UserInputClient::~UserInputClient()
@@ -51,6 +60,12 @@ void UserInputClient::onRequest(UINT8 reqCode, BlockingGate *backGate)
       m_clipboardListener->onClipboardUpdate(&newClipboard);
     }
     break;
+  case WINDOWS_CHANGED:
+    InterlockedIncrement(&m_windowsGeneration);
+    break;
+  case DISPLAYS_CHANGED:
+    readDisplays(backGate);
+    break;
   default:
     StringStorage errMess;
     errMess.format(_T("Unknown %d protocol code received from a pipe ")
@@ -63,13 +78,45 @@ void UserInputClient::onRequest(UINT8 reqCode, BlockingGate *backGate)
 void UserInputClient::sendInit(BlockingGate *gate)
 {
   AutoLock al(gate);
+  // The desktop server may have been restarted, its changes are unknown.
+  InterlockedIncrement(&m_windowsGeneration);
+  {
+    AutoLock al(&m_displaysLock);
+    m_displaysValid = false;
+  }
   gate->writeUInt8(USER_INPUT_INIT);
   gate->writeUInt8(m_sendMouseFlags);
 }
 
+void UserInputClient::readDisplays(BlockingGate *backGate)
+{
+  std::vector<Rect> displays;
+  UINT8 number = backGate->readUInt8();
+  for (UINT8 i = 0; i < number; i++) {
+    displays.push_back(readRect(backGate));
+  }
+  Rect primaryDisplay = readRect(backGate);
+  Point fbOrigin = readPoint(backGate);
+
+  AutoLock al(&m_displaysLock);
+  m_displays.swap(displays);
+  m_primaryDisplay = primaryDisplay;
+  m_fbOrigin = fbOrigin;
+  m_displaysValid = true;
+}
+
 void UserInputClient::setMouseEvent(const Point newPos, UINT8 keyFlag)
 {
   AutoLock al(m_forwGate);
+  if (m_batchDepth > 0) {
+    InputEvent event;
+    event.isKeyboard = false;
+    event.pointerPos = newPos;
+    event.keyFlag = keyFlag;
+    addToBatch(&event);
+    m_sendMouseFlags = keyFlag;
+    return;
+  }
   try {
     // Send mouse data
     m_forwGate->writeUInt8(POINTER_POS_CHANGED);
@@ -93,6 +140,14 @@ void UserInputClient::setNewClipboard(const StringStorage *newClipboard)
 void UserInputClient::setKeyboardEvent(UINT32 keySym, bool down)
 {
   AutoLock al(m_forwGate);
+  if (m_batchDepth > 0) {
+    InputEvent event;
+    event.isKeyboard = true;
+    event.keySym = keySym;
+    event.down = down;
+    addToBatch(&event);
+    return;
+  }
   try {
     // Send keyboard data
     m_forwGate->writeUInt8(KEYBOARD_EVENT);
@@ -101,6 +156,65 @@ void UserInputClient::setKeyboardEvent(UINT32 keySym, bool down)
   }
 }
 
+void UserInputClient::beginInputBatch()
+{
+  AutoLock al(m_forwGate);
+  m_batchDepth++;
+}
+
+void UserInputClient::endInputBatch()
+{
+  AutoLock al(m_forwGate);
+  if (m_batchDepth > 0) {
+    m_batchDepth--;
+  }
+  if (m_batchDepth == 0) {
+    flushInputBatch();
+  }
+}
+
+void UserInputClient::addToBatch(const InputEvent *event)
+{
+  m_batch.push_back(*event);
+  if (m_batch.size() >= MAX_BATCH_SIZE) {
+    flushInputBatch();
+  }
+}
+
+void UserInputClient::flushInputBatch()
+{
+  AutoLock al(m_forwGate);
+  if (m_batch.empty()) {
+    return;
+  }
+
+  // The events are written as the single messages, after a common header,
+  // and the whole message goes to the pipe by one write.
+  ByteArrayOutputStream memStream;
+  DataOutputStream output(&memStream);
+  output.writeUInt8(INPUT_EVENTS);
+  output.writeUInt16((UINT16)m_batch.size());
+  for (size_t i = 0; i < m_batch.size(); i++) {
+    const InputEvent *event = &m_batch[i];
+    if (event->isKeyboard) {
+      output.writeUInt8(KEYBOARD_EVENT);
+      output.writeUInt32(event->keySym);
+      output.writeUInt8((UINT8)event->down);
+    } else {
+      output.writeUInt8(POINTER_POS_CHANGED);
+      output.writeUInt16(event->pointerPos.x);
+      output.writeUInt16(event->pointerPos.y);
+      output.writeUInt8(event->keyFlag);
+    }
+  }
+  m_batch.clear();
+
+  try {
+    m_forwGate->writeFully(memStream.toByteArray(), memStream.size());
+  } catch (ReconnectException &) {
+  }
+}
+
 void UserInputClient::getCurrentUserInfo(StringStorage *desktopName,
                                          StringStorage *userName)
 {
@@ -115,6 +229,13 @@ void UserInputClient::getCurrentUserInfo(StringStorage *desktopName,
 
 void UserInputClient::getPrimaryDisplayCoords(Rect *rect)
 {
+  {
+    AutoLock al(&m_displaysLock);
+    if (m_displaysValid) {
+      *rect = m_primaryDisplay;
+      return;
+    }
+  }
   AutoLock al(m_forwGate);
   bool success = false;
   do {
@@ -131,6 +252,18 @@ void UserInputClient::getPrimaryDisplayCoords(Rect *rect)
 void UserInputClient::getDisplayNumberCoords(Rect *rect,
                                              unsigned char dispNumber)
 {
+  {
+    AutoLock al(&m_displaysLock);
+    if (m_displaysValid) {
+      // The displays are numbered from one.
+      if (dispNumber >= 1 && dispNumber <= m_displays.size()) {
+        *rect = m_displays[dispNumber - 1];
+      } else {
+        rect->clear();
+      }
+      return;
+    }
+  }
   AutoLock al(m_forwGate);
   bool success = false;
   do {
@@ -148,6 +281,13 @@ void UserInputClient::getDisplayNumberCoords(Rect *rect,
 std::vector<Rect> UserInputClient::getDisplaysCoords()
 {
   std::vector<Rect> res;
+  {
+    AutoLock al(&m_displaysLock);
+    if (m_displaysValid) {
+      res = m_displays;
+      return res;
+    }
+  }
   AutoLock al(m_forwGate);
   bool success = false;
   unsigned char number;
@@ -171,6 +311,13 @@ std::vector<Rect> UserInputClient::getDisplaysCoords()
 
 void UserInputClient::getNormalizedRect(Rect *rect)
 {
+  {
+    AutoLock al(&m_displaysLock);
+    if (m_displaysValid) {
+      rect->move(-m_fbOrigin.x, -m_fbOrigin.y);
+      return;
+    }
+  }
   AutoLock al(m_forwGate);
   bool success = false;
   do {
@@ -210,6 +357,21 @@ void UserInputClient::getWindowCoords(HWND hwnd, Rect *rect)
   } while (!success);
 }
 
+void UserInputClient::getForegroundWindowCoords(Rect *rect)
+{
+  AutoLock al(m_forwGate);
+  bool success = false;
+  do {
+    try {
+      // Send request
+      m_forwGate->writeUInt8(FOREGROUND_WINDOW_COORDS_REQ);
+      *rect = readRect(m_forwGate);
+      success = true;
+    } catch (ReconnectException &) {
+    }
+  } while (!success);
+}
+
 HWND UserInputClient::getWindowHandleByName(const StringStorage *windowName)
 {
   AutoLock al(m_forwGate);
@@ -231,17 +393,32 @@ HWND UserInputClient::getWindowHandleByName(const StringStorage *windowName)
 void UserInputClient::getApplicationRegion(unsigned int procId, Region *region)
 {
   AutoLock al(m_forwGate);
+  // A change reported after this reading makes the region stale at once.
+  LONG generation = m_windowsGeneration;
+  if (generation == m_appRegionGeneration && procId == m_appRegionProcId) {
+    *region = m_appRegion;
+    return;
+  }
   bool success = false;
+  bool cacheable = false;
   do {
     try {
       // Send request
       m_forwGate->writeUInt8(APPLICATION_REGION_REQ);
       m_forwGate->writeUInt32(procId);
       readRegion(region, m_forwGate);
+      cacheable = m_forwGate->readUInt8() != 0;
       success = true;
     } catch (ReconnectException &) {
     }
   } while (!success);
+  if (cacheable) {
+    m_appRegion = *region;
+    m_appRegionProcId = procId;
+    m_appRegionGeneration = generation;
+  } else {
+    m_appRegionGeneration = -1;
+  }
 }
 
 bool UserInputClient::isApplicationInFocus(unsigned int procId)
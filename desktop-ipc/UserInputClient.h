@@ -31,6 +31,9 @@
 #include "util/inttypes.h"
 #include "DesktopServerProto.h"
 #include "DesktopSrvDispatcher.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
 
 class UserInputClient : public UserInput, public DesktopServerProto,
                         public ClientListener
@@ -44,15 +47,25 @@ public:
   virtual void setNewClipboard(const StringStorage *newClipboard);
   virtual void setMouseEvent(const Point newPos, UINT8 keyFlag);
   virtual void setKeyboardEvent(UINT32 keySym, bool down);
+  // The batches of several callers may overlap, the events are sent when
+  // the last of them ends.
+  virtual void beginInputBatch();
+  virtual void endInputBatch();
+  // Sends the events held back without ending the batch.
+  void flushInputBatch();
   virtual void getCurrentUserInfo(StringStorage *desktopName,
                                   StringStorage *userName);
+  // The display layout is answered with no request after the server has
+  // sent it by DISPLAYS_CHANGED.
   virtual void getPrimaryDisplayCoords(Rect *rect);
   virtual void getDisplayNumberCoords(Rect *rect,
                                       unsigned char dispNumber);
   virtual std::vector<Rect> getDisplaysCoords();
   virtual void getNormalizedRect(Rect *rect);
   virtual void getWindowCoords(HWND hwnd, Rect *rect);
+  virtual void getForegroundWindowCoords(Rect *rect);
   virtual HWND getWindowHandleByName(const StringStorage *windowName);
+  // The region is kept until the server reports a change of the windows.
   virtual void getApplicationRegion(unsigned int procId, Region *region);
   virtual bool isApplicationInFocus(unsigned int procId);
 
@@ -60,8 +73,46 @@ public:
   virtual void onRequest(UINT8 reqCode, BlockingGate *backGate);
 
 protected:
+  struct InputEvent
+  {
+    bool isKeyboard;
+    Point pointerPos;
+    UINT8 keyFlag;
+    UINT32 keySym;
+    bool down;
+  };
+
+  // Must be called with m_forwGate locked.
+  void addToBatch(const InputEvent *event);
+
+  void readDisplays(BlockingGate *backGate);
+
   UINT8 m_sendMouseFlags;
   ClipboardListener *m_clipboardListener;
+
+  // Number of the batches begun and not ended, the events are
+  // held back if it is not zero. Both are protected by m_forwGate.
+  int m_batchDepth;
+  std::vector<InputEvent> m_batch;
+
+  // Application region received for the m_appRegionGeneration window
+  // layout, protected by m_forwGate. The generation is incremented by
+  // WINDOWS_CHANGED and on reconnections.
+  volatile LONG m_windowsGeneration;
+  LONG m_appRegionGeneration;
+  unsigned int m_appRegionProcId;
+  Region m_appRegion;
+
+  // Display layout of the last DISPLAYS_CHANGED, protected by
+  // m_displaysLock. It is not valid until the first one after the
+  // initialization.
+  bool m_displaysValid;
+  std::vector<Rect> m_displays;
+  Rect m_primaryDisplay;
+  Point m_fbOrigin;
+  LocalMutex m_displaysLock;
+
+  static const size_t MAX_BATCH_SIZE = 256;
 };
 
 #endif // __USERINPUTCLIENT_H__
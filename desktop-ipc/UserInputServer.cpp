@@ -31,19 +31,23 @@ UserInputServer::UserInputServer(BlockingGate *forwGate,
                                  AnEventListener *extTerminationListener,
                                  LogWriter *log)
 : DesktopServerProto(forwGate),
+  m_windowsChangeSent(0),
   m_extTerminationListener(extTerminationListener),
   m_log(log)
 {
   bool ctrlAltDelEnabled = true;
-  m_userInput = new WindowsUserInput(this, ctrlAltDelEnabled, m_log);
+  m_userInput = new WindowsUserInput(this, ctrlAltDelEnabled, m_log, this,
+                                     this);
 
   dispatcher->registerNewHandle(POINTER_POS_CHANGED, this);
   dispatcher->registerNewHandle(CLIPBOARD_CHANGED, this);
   dispatcher->registerNewHandle(KEYBOARD_EVENT, this);
+  dispatcher->registerNewHandle(INPUT_EVENTS, this);
   dispatcher->registerNewHandle(USER_INFO_REQ, this);
   dispatcher->registerNewHandle(DESKTOP_COORDS_REQ, this);
   dispatcher->registerNewHandle(WINDOW_COORDS_REQ, this);
   dispatcher->registerNewHandle(WINDOW_HANDLE_REQ, this);
+  dispatcher->registerNewHandle(FOREGROUND_WINDOW_COORDS_REQ, this);
   dispatcher->registerNewHandle(DISPLAY_NUMBER_COORDS_REQ, this);
   dispatcher->registerNewHandle(DISPLAYS_COORDS_REQ, this);
   dispatcher->registerNewHandle(APPLICATION_REGION_REQ, this);
@@ -75,6 +79,74 @@ void UserInputServer::onClipboardUpdate(const StringStorage *newClipboard)
   }
 }
 
+void UserInputServer::onWindowsChanged()
+{
+  if (InterlockedExchange(&m_windowsChangeSent, 1) != 0) {
+    return;
+  }
+  AutoLock al(m_forwGate);
+  try {
+    m_forwGate->writeUInt8(WINDOWS_CHANGED);
+  } catch (Exception &e) {
+    m_log->error(_T("An error has been occurred while sending a")
+               _T(" WINDOWS_CHANGED message from UserInputServer: %s"),
+               e.getMessage());
+    m_extTerminationListener->onAnObjectEvent();
+  }
+}
+
+void UserInputServer::onDisplayChanged()
+{
+  sendDisplays(false);
+}
+
+void UserInputServer::sendDisplays(bool force)
+{
+  std::vector<Rect> displays = m_userInput->getDisplaysCoords();
+  if (displays.size() > 255) {
+    displays.resize(255);
+  }
+  Rect primaryDisplay;
+  m_userInput->getPrimaryDisplayCoords(&primaryDisplay);
+  // The normalized origin of the virtual screen gives the position of the
+  // frame buffer on it.
+  Rect origin;
+  m_userInput->getNormalizedRect(&origin);
+  Point fbOrigin(-origin.left, -origin.top);
+
+  AutoLock al(&m_displaysLock);
+  if (!force && fbOrigin.isEqualTo(&m_sentFbOrigin) &&
+      primaryDisplay.isEqualTo(&m_sentPrimaryDisplay) &&
+      displays.size() == m_sentDisplays.size()) {
+    bool changed = false;
+    for (size_t i = 0; i < displays.size() && !changed; i++) {
+      changed = !displays[i].isEqualTo(&m_sentDisplays[i]);
+    }
+    if (!changed) {
+      return;
+    }
+  }
+  m_sentDisplays = displays;
+  m_sentPrimaryDisplay = primaryDisplay;
+  m_sentFbOrigin = fbOrigin;
+
+  AutoLock al2(m_forwGate);
+  try {
+    m_forwGate->writeUInt8(DISPLAYS_CHANGED);
+    m_forwGate->writeUInt8((UINT8)displays.size());
+    for (size_t i = 0; i < displays.size(); i++) {
+      sendRect(&displays[i], m_forwGate);
+    }
+    sendRect(&primaryDisplay, m_forwGate);
+    sendPoint(&fbOrigin, m_forwGate);
+  } catch (Exception &e) {
+    m_log->error(_T("An error has been occurred while sending a")
+               _T(" DISPLAYS_CHANGED message from UserInputServer: %s"),
+               e.getMessage());
+    m_extTerminationListener->onAnObjectEvent();
+  }
+}
+
 void UserInputServer::onRequest(UINT8 reqCode, BlockingGate *backGate)
 {
   switch (reqCode) {
@@ -87,6 +159,9 @@ void UserInputServer::onRequest(UINT8 reqCode, BlockingGate *backGate)
   case KEYBOARD_EVENT:
     applyKeyEvent(backGate);
     break;
+  case INPUT_EVENTS:
+    applyInputEvents(backGate);
+    break;
   case USER_INFO_REQ:
     ansUserInfo(backGate);
     break;
@@ -99,6 +174,9 @@ void UserInputServer::onRequest(UINT8 reqCode, BlockingGate *backGate)
   case WINDOW_HANDLE_REQ:
     ansWindowHandle(backGate);
     break;
+  case FOREGROUND_WINDOW_COORDS_REQ:
+    ansForegroundWindowCoords(backGate);
+    break;
   case DISPLAY_NUMBER_COORDS_REQ:
     ansDisplayNumberCoords(backGate);
     break;
@@ -130,6 +208,8 @@ void UserInputServer::serverInit(BlockingGate *backGate)
 {
   UINT8 keyFlags = backGate->readUInt8();
   m_userInput->initKeyFlag(keyFlags);
+  // The client doesn't keep the layout over a reconnection.
+  sendDisplays(true);
 }
 
 void UserInputServer::applyNewPointerPos(BlockingGate *backGate)
@@ -155,6 +235,34 @@ void UserInputServer::applyKeyEvent(BlockingGate *backGate)
   m_userInput->setKeyboardEvent(keySym, down);
 }
 
+void UserInputServer::applyInputEvents(BlockingGate *backGate)
+{
+  UINT16 count = backGate->readUInt16();
+  m_userInput->beginInputBatch();
+  try {
+    for (UINT16 i = 0; i < count; i++) {
+      UINT8 code = backGate->readUInt8();
+      switch (code) {
+      case POINTER_POS_CHANGED:
+        applyNewPointerPos(backGate);
+        break;
+      case KEYBOARD_EVENT:
+        applyKeyEvent(backGate);
+        break;
+      default:
+        StringStorage errMess;
+        errMess.format(_T("Unknown %d input event code received")
+                       _T(" from a UserInputClient"), (int)code);
+        throw Exception(errMess.getString());
+      }
+    }
+  } catch (...) {
+    m_userInput->endInputBatch();
+    throw;
+  }
+  m_userInput->endInputBatch();
+}
+
 void UserInputServer::ansUserInfo(BlockingGate *backGate)
 {
   StringStorage desktopName, userName;
@@ -185,6 +293,13 @@ void UserInputServer::ansWindowCoords(BlockingGate *backGate)
   }
 }
 
+void UserInputServer::ansForegroundWindowCoords(BlockingGate *backGate)
+{
+  Rect rect;
+  m_userInput->getForegroundWindowCoords(&rect);
+  sendRect(&rect, backGate);
+}
+
 void UserInputServer::ansWindowHandle(BlockingGate *backGate)
 {
   StringStorage windowName;
@@ -225,9 +340,13 @@ void UserInputServer::ansNormalizeRect(BlockingGate *backGate)
 void UserInputServer::ansApplicationRegion(BlockingGate *backGate)
 {
   UINT32 procId = backGate->readUInt32();
+  // Cleared before the windows are enumerated, so a change during the
+  // enumeration is reported.
+  InterlockedExchange(&m_windowsChangeSent, 0);
   Region region;
   m_userInput->getApplicationRegion(procId, &region);
   sendRegion(&region, backGate);
+  backGate->writeUInt8(m_userInput->isWindowChangeReported() ? 1 : 0);
 }
 
 void UserInputServer::ansApplicationInFocus(BlockingGate *backGate)
@@ -32,9 +32,11 @@
 #include "win-system/WindowsEvent.h"
 #include "DesktopSrvDispatcher.h"
 #include "log-writer/LogWriter.h"
+#include "thread/LocalMutex.h"
 
 class UserInputServer: public DesktopServerProto, public ClientListener,
-                       public ClipboardListener
+                       public ClipboardListener, public WindowChangeListener,
+                       public DisplayChangeListener
 {
 public:
   UserInputServer(BlockingGate *forwGate,
@@ -47,13 +49,17 @@ public:
   virtual void onRequest(UINT8 reqCode, BlockingGate *backGate);
 
   virtual void onClipboardUpdate(const StringStorage *newClipboard);
+  virtual void onWindowsChanged();
+  virtual void onDisplayChanged();
 
 protected:
   virtual void applyNewPointerPos(BlockingGate *backGate);
   virtual void applyNewClipboard(BlockingGate *backGate);
   virtual void applyKeyEvent(BlockingGate *backGate);
+  virtual void applyInputEvents(BlockingGate *backGate);
   virtual void ansDesktopCoords(BlockingGate *backGate);
   virtual void ansWindowCoords(BlockingGate *backGate);
+  virtual void ansForegroundWindowCoords(BlockingGate *backGate);
   virtual void ansUserInfo(BlockingGate *backGate);
   virtual void ansWindowHandle(BlockingGate *backGate);
   virtual void ansDisplayNumberCoords(BlockingGate *backGate);
@@ -65,9 +71,22 @@ protected:
   // At first time server must get init information.
   void serverInit(BlockingGate *backGate);
 
+  // Sends DISPLAYS_CHANGED if the layout differs from the one sent last
+  // time or if forced.
+  void sendDisplays(bool force);
+
   WindowsUserInput *m_userInput;
+  // Set when WINDOWS_CHANGED has been sent and no application region has
+  // been requested since, so a window drag doesn't flood the pipe.
+  volatile LONG m_windowsChangeSent;
   AnEventListener *m_extTerminationListener;
 
+  // Display layout sent last time, protected by m_displaysLock.
+  std::vector<Rect> m_sentDisplays;
+  Rect m_sentPrimaryDisplay;
+  Point m_sentFbOrigin;
+  LocalMutex m_displaysLock;
+
   LogWriter *m_log;
 };
 
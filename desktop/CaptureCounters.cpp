@@ -0,0 +1,108 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CaptureCounters.h"
+#include "thread/AutoLock.h"
+#include "util/GetCPUtime.h"
+
+CaptureCounters CaptureCounters::s_instance;
+
+CaptureCounters::CaptureCounters()
+: m_startTime(DateTime::now())
+{
+}
+
+CaptureCounters *CaptureCounters::getInstance()
+{
+  return &s_instance;
+}
+
+void CaptureCounters::reset(const TCHAR *driverName)
+{
+  AutoLock al(&m_lock);
+  m_stats = CaptureStatistics();
+  m_stats.driverName.setString(driverName);
+  m_startTime = DateTime::now();
+}
+
+void CaptureCounters::onFrameAcquired()
+{
+  AutoLock al(&m_lock);
+  m_stats.framesAcquired++;
+}
+
+void CaptureCounters::onAcquireTimeout()
+{
+  AutoLock al(&m_lock);
+  m_stats.timeouts++;
+}
+
+void CaptureCounters::onDirtyArea(UINT64 area)
+{
+  AutoLock al(&m_lock);
+  m_stats.dirtyArea += area;
+}
+
+void CaptureCounters::onGrabPlanned(size_t requestedRects,
+                                    size_t grabbedRects,
+                                    UINT64 grabbedArea)
+{
+  AutoLock al(&m_lock);
+  m_stats.grabs++;
+  m_stats.grabRectsRequested += requestedRects;
+  m_stats.grabRectsGrabbed += grabbedRects;
+  m_stats.grabbedArea += grabbedArea;
+}
+
+void CaptureCounters::onOutputRecovered(UINT64 recoveryTime)
+{
+  AutoLock al(&m_lock);
+  m_stats.recoveries++;
+  m_stats.recoveryTime += recoveryTime;
+  if (recoveryTime > m_stats.maxRecoveryTime) {
+    m_stats.maxRecoveryTime = recoveryTime;
+  }
+}
+
+void CaptureCounters::onOutputFrame(size_t output, UINT32 adapter,
+                                    UINT64 captureTime)
+{
+  AutoLock al(&m_lock);
+  if (output >= m_stats.outputs.size()) {
+    m_stats.outputs.resize(output + 1);
+  }
+  CaptureStatistics::OutputStatistics *out = &m_stats.outputs[output];
+  out->adapter = adapter;
+  out->frames++;
+  out->captureTime += captureTime;
+}
+
+void CaptureCounters::getStatistics(CaptureStatistics *stats)
+{
+  AutoLock al(&m_lock);
+  *stats = m_stats;
+  stats->uptime = (DateTime::now() - m_startTime).getTime();
+  stats->processId = GetCurrentProcessId();
+  stats->processCpuTime = (UINT64)((getCPUTime() + getKernelTime()) * 1000000.0);
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CAPTURECOUNTERS_H__
+#define __CAPTURECOUNTERS_H__
+
+#include "CaptureStatistics.h"
+#include "thread/LocalMutex.h"
+#include "util/DateTime.h"
+
+// Process-wide counters of the screen capture. The screen drivers and the
+// update handler count their events here, so that the counting does not
+// depend on the driver in use and survives driver restarts.
+class CaptureCounters
+{
+public:
+  static CaptureCounters *getInstance();
+
+  // Sets the name of the driver and restarts the counting.
+  void reset(const TCHAR *driverName);
+
+  void onFrameAcquired();
+  void onAcquireTimeout();
+  void onDirtyArea(UINT64 area);
+  // Counts a grab planned for requestedRects rectangles and done by
+  // grabbedRects grabs of the total area.
+  void onGrabPlanned(size_t requestedRects, size_t grabbedRects,
+                     UINT64 grabbedArea);
+  // Counts an output duplicated again after the access to it has been
+  // lost, recoveryTime is in milliseconds.
+  void onOutputRecovered(UINT64 recoveryTime);
+  // Counts a frame of the output duplicated on the adapter, captureTime is
+  // the time of copying it to the frame buffer in microseconds.
+  void onOutputFrame(size_t output, UINT32 adapter, UINT64 captureTime);
+
+  void getStatistics(CaptureStatistics *stats);
+
+private:
+  CaptureCounters();
+
+  LocalMutex m_lock;
+  CaptureStatistics m_stats;
+  DateTime m_startTime;
+
+  static CaptureCounters s_instance;
+};
+
+#endif // __CAPTURECOUNTERS_H__
@@ -0,0 +1,102 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CaptureStatistics.h"
+
+CaptureStatistics::OutputStatistics::OutputStatistics()
+: adapter(0),
+  frames(0),
+  captureTime(0)
+{
+}
+
+CaptureStatistics::CaptureStatistics()
+: framesAcquired(0),
+  dirtyArea(0),
+  timeouts(0),
+  grabs(0),
+  grabRectsRequested(0),
+  grabRectsGrabbed(0),
+  grabbedArea(0),
+  recoveries(0),
+  recoveryTime(0),
+  maxRecoveryTime(0),
+  uptime(0),
+  processId(0),
+  processCpuTime(0)
+{
+}
+
+void CaptureStatistics::serialize(DataOutputStream *output)
+{
+  output->writeUTF8(driverName.getString());
+  output->writeUInt64(framesAcquired);
+  output->writeUInt64(dirtyArea);
+  output->writeUInt64(timeouts);
+  output->writeUInt64(grabs);
+  output->writeUInt64(grabRectsRequested);
+  output->writeUInt64(grabRectsGrabbed);
+  output->writeUInt64(grabbedArea);
+  output->writeUInt64(recoveries);
+  output->writeUInt64(recoveryTime);
+  output->writeUInt64(maxRecoveryTime);
+  output->writeUInt64(uptime);
+  output->writeUInt32(processId);
+  output->writeUInt64(processCpuTime);
+  output->writeUInt32((UINT32)outputs.size());
+  for (size_t i = 0; i < outputs.size(); i++) {
+    output->writeUInt32(outputs[i].adapter);
+    output->writeUInt64(outputs[i].frames);
+    output->writeUInt64(outputs[i].captureTime);
+  }
+}
+
+void CaptureStatistics::deserialize(DataInputStream *input)
+{
+  input->readUTF8(&driverName);
+  framesAcquired = input->readUInt64();
+  dirtyArea = input->readUInt64();
+  timeouts = input->readUInt64();
+  grabs = input->readUInt64();
+  grabRectsRequested = input->readUInt64();
+  grabRectsGrabbed = input->readUInt64();
+  grabbedArea = input->readUInt64();
+  recoveries = input->readUInt64();
+  recoveryTime = input->readUInt64();
+  maxRecoveryTime = input->readUInt64();
+  uptime = input->readUInt64();
+  processId = input->readUInt32();
+  processCpuTime = input->readUInt64();
+  UINT32 outputCount = input->readUInt32();
+  // Each output takes 20 bytes, so a broken count can't make a huge vector
+  // before the stream ends.
+  outputs.clear();
+  for (UINT32 i = 0; i < outputCount; i++) {
+    OutputStatistics out;
+    out.adapter = input->readUInt32();
+    out.frames = input->readUInt64();
+    out.captureTime = input->readUInt64();
+    outputs.push_back(out);
+  }
+}
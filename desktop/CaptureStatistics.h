@@ -0,0 +1,89 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CAPTURESTATISTICS_H__
+#define __CAPTURESTATISTICS_H__
+
+#include "util/CommonHeader.h"
+#include "io-lib/DataOutputStream.h"
+#include "io-lib/DataInputStream.h"
+#include <vector>
+
+// Snapshot of the screen capture counters of a desktop, counted since the
+// desktop has been created.
+class CaptureStatistics
+{
+public:
+  // Capture counters of a single output of the Win8 screen driver.
+  struct OutputStatistics
+  {
+    OutputStatistics();
+
+    // Index of the graphic adapter the output is duplicated on.
+    UINT32 adapter;
+    // Number of frames of the output and the total time in microseconds
+    // spent on copying them from the adapter to the frame buffer.
+    UINT64 frames;
+    UINT64 captureTime;
+  };
+
+  CaptureStatistics();
+
+  void serialize(DataOutputStream *output);
+  void deserialize(DataInputStream *input);
+
+  // Name of the screen driver in use.
+  StringStorage driverName;
+  // Number of frames taken from the screen by the driver.
+  UINT64 framesAcquired;
+  // Total area of the changed regions in pixels.
+  UINT64 dirtyArea;
+  // Number of waits for a new frame that have timed out.
+  UINT64 timeouts;
+  // Number of grabs planned by the grab optimization, the rectangles
+  // requested and actually grabbed in them after merging, and the total
+  // area grabbed in pixels.
+  UINT64 grabs;
+  UINT64 grabRectsRequested;
+  UINT64 grabRectsGrabbed;
+  UINT64 grabbedArea;
+  // Number of outputs recovered after the loss of the access to them
+  // without rebuilding the driver, the total and the longest time of the
+  // recoveries in milliseconds.
+  UINT64 recoveries;
+  UINT64 recoveryTime;
+  UINT64 maxRecoveryTime;
+  // Time in milliseconds the counting goes.
+  UINT64 uptime;
+  // Identifier of the process that captures the screen and the CPU time,
+  // user and kernel, it has consumed in microseconds. The process is the
+  // server itself or its desktop server helper.
+  UINT32 processId;
+  UINT64 processCpuTime;
+  // Per output counters, indexed by the output number. Empty for the
+  // drivers that don't capture outputs separately.
+  std::vector<OutputStatistics> outputs;
+};
+
+#endif // __CAPTURESTATISTICS_H__
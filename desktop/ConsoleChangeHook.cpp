@@ -0,0 +1,115 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ConsoleChangeHook.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+
+ConsoleChangeHook *ConsoleChangeHook::m_instance = 0;
+LocalMutex ConsoleChangeHook::m_instanceMutex;
+
+ConsoleChangeHook::ConsoleChangeHook(ConsoleChangeListener *listener,
+                                     LogWriter *log)
+: m_listener(listener),
+  m_isInstalled(false),
+  m_log(log)
+{
+  {
+    AutoLock al(&m_instanceMutex);
+    if (m_instance != 0) {
+      throw Exception(_T("ConsoleChangeHook instance already exists"));
+    }
+    m_instance = this;
+  }
+  resume();
+}
+
+ConsoleChangeHook::~ConsoleChangeHook()
+{
+  terminate();
+  wait();
+
+  AutoLock al(&m_instanceMutex);
+  m_instance = 0;
+}
+
+void ConsoleChangeHook::onTerminate()
+{
+  PostThreadMessage(getThreadId(), WM_QUIT, 0, 0);
+}
+
+void ConsoleChangeHook::execute()
+{
+  // The range holds the caret, the update, the layout and the application
+  // start and end events, the procedure takes the ones changing pixels.
+  HWINEVENTHOOK hook = SetWinEventHook(EVENT_CONSOLE_CARET,
+                                       EVENT_CONSOLE_END_APPLICATION,
+                                       0, winEventProc, 0, 0,
+                                       WINEVENT_OUTOFCONTEXT);
+  if (hook == 0) {
+    m_log->error(_T("Can't install the console change hook, error = %u"),
+                 GetLastError());
+    return;
+  }
+  m_isInstalled = true;
+  m_log->info(_T("Console change hook thread id = %d"), getThreadId());
+
+  // The hook procedure is called in this thread while it waits for messages.
+  MSG msg;
+  while (!isTerminating()) {
+    if (!PeekMessage(&msg, NULL, NULL, NULL, PM_REMOVE)) {
+      if (!WaitMessage()) {
+        break;
+      }
+    } else if (msg.message == WM_QUIT) {
+      break;
+    } else {
+      DispatchMessage(&msg);
+    }
+  }
+
+  m_isInstalled = false;
+  UnhookWinEvent(hook);
+}
+
+void CALLBACK ConsoleChangeHook::winEventProc(HWINEVENTHOOK hook, DWORD event,
+                                              HWND hwnd, LONG idObject,
+                                              LONG idChild, DWORD eventThread,
+                                              DWORD eventTime)
+{
+  switch (event) {
+  case EVENT_CONSOLE_CARET:
+  case EVENT_CONSOLE_UPDATE_REGION:
+  case EVENT_CONSOLE_UPDATE_SIMPLE:
+  case EVENT_CONSOLE_UPDATE_SCROLL:
+  case EVENT_CONSOLE_LAYOUT:
+    break;
+  default:
+    return;
+  }
+  // The instance cannot go away while its thread is in here.
+  if (hwnd != 0 && m_instance != 0) {
+    m_instance->m_listener->onConsoleChanged(hwnd);
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CONSOLECHANGEHOOK_H__
+#define __CONSOLECHANGEHOOK_H__
+
+#include "util/CommonHeader.h"
+#include "thread/GuiThread.h"
+#include "thread/LocalMutex.h"
+#include "log-writer/LogWriter.h"
+#include "ConsoleChangeListener.h"
+
+// Notifies the listener about the output to the console windows by an out
+// of context WinEvent hook of the console events, installed in its own
+// thread on the input desktop. The screen hooks do not see the consoles,
+// which are drawn by another process.
+//
+// Only one instance of this class may exist at a time.
+class ConsoleChangeHook : protected GuiThread
+{
+public:
+  ConsoleChangeHook(ConsoleChangeListener *listener, LogWriter *log);
+  virtual ~ConsoleChangeHook();
+
+  // Returns true while the hook is installed. Until then, or if installing
+  // has failed, the changes are not reported.
+  bool isInstalled() const { return m_isInstalled; }
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+  static void CALLBACK winEventProc(HWINEVENTHOOK hook, DWORD event,
+                                    HWND hwnd, LONG idObject, LONG idChild,
+                                    DWORD eventThread, DWORD eventTime);
+
+  static ConsoleChangeHook *m_instance;
+  static LocalMutex m_instanceMutex;
+
+  ConsoleChangeListener *m_listener;
+  volatile bool m_isInstalled;
+
+  LogWriter *m_log;
+};
+
+#endif // __CONSOLECHANGEHOOK_H__
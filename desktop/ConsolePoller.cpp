@@ -24,17 +24,29 @@
 
 #include "ConsolePoller.h"
 #include "server-config-lib/Configurator.h"
+#include "util/Exception.h"
+
+#include <algorithm>
+
+// Delay between the checks of the foreground console when the hook is not
+// there.
+const unsigned int CONSOLE_POLL_INTERVAL = 200;
+// With the hook, the checks are made on its events, the scheduled ones
+// find nothing to do.
+const unsigned int CONSOLE_IDLE_INTERVAL = 1000;
 
 ConsolePoller::ConsolePoller(UpdateKeeper *updateKeeper,
                              UpdateListener *updateListener,
+                             TaskScheduler *scheduler,
                              ScreenGrabber *screenGrabber,
                              FrameBuffer *backupFrameBuffer,
                              LocalMutex *frameBufferMutex,
                              LogWriter *log)
-: UpdateDetector(updateKeeper, updateListener),
+: ScheduledUpdateDetector(updateKeeper, updateListener, scheduler),
   m_screenGrabber(screenGrabber),
   m_backupFrameBuffer(backupFrameBuffer),
   m_frameBufferMutex(frameBufferMutex),
+  m_consoleHook(0),
   m_log(log)
 {
   m_pollingRect.setRect(0, 0, 16, 16);
@@ -42,62 +54,128 @@ ConsolePoller::ConsolePoller(UpdateKeeper *updateKeeper,
 
 ConsolePoller::~ConsolePoller()
 {
-  terminate();
-  wait();
+  stop();
+}
+
+unsigned int ConsolePoller::detect()
+{
+  if (m_consoleHook != 0 && m_consoleHook->isInstalled()) {
+    reportChangedConsoles();
+    return CONSOLE_IDLE_INTERVAL;
+  }
+  pollForegroundConsole();
+  return CONSOLE_POLL_INTERVAL;
 }
 
-void ConsolePoller::onTerminate()
+void ConsolePoller::onStart()
 {
-  m_intervalWaiter.notify();
+  try {
+    m_consoleHook = new ConsoleChangeHook(this, m_log);
+  } catch (Exception &e) {
+    m_log->error(_T("Consoles will be polled: %s"), e.getMessage());
+  }
+}
+
+void ConsolePoller::onStop()
+{
+  if (m_consoleHook != 0) {
+    delete m_consoleHook;
+    m_consoleHook = 0;
+  }
+  AutoLock al(&m_changedConsolesLock);
+  m_changedConsoles.clear();
+}
+
+void ConsolePoller::onConsoleChanged(HWND hwnd)
+{
+  // A console printing a lot sends many events, they are collected until
+  // the check they have caused.
+  bool checkPending;
+  {
+    AutoLock al(&m_changedConsolesLock);
+    checkPending = !m_changedConsoles.empty();
+    if (std::find(m_changedConsoles.begin(), m_changedConsoles.end(), hwnd) ==
+        m_changedConsoles.end()) {
+      m_changedConsoles.push_back(hwnd);
+    }
+  }
+  if (!checkPending) {
+    checkNow();
+  }
 }
 
-void ConsolePoller::execute()
+void ConsolePoller::reportChangedConsoles()
 {
-  m_log->info(_T("console poller thread id = %d"), getThreadId());
+  std::vector<HWND> consoles;
+  {
+    AutoLock al(&m_changedConsolesLock);
+    consoles.swap(m_changedConsoles);
+  }
+  Region region;
+  for (size_t i = 0; i < consoles.size(); i++) {
+    Rect conRect = getConsoleRect(consoles[i]);
+    region.addRect(&conRect);
+  }
+  if (region.isEmpty()) {
+    return;
+  }
 
+  {
+    AutoLock al(m_frameBufferMutex);
+    Rect offsetFb = m_screenGrabber->getScreenRect();
+    region.translate(-offsetFb.left, -offsetFb.top);
+    Rect fbRect = m_backupFrameBuffer->getDimension().getRect();
+    region.crop(&fbRect);
+  }
+  if (!region.isEmpty()) {
+    m_updateKeeper->addChangedRegion(&region);
+    doUpdate();
+  }
+}
+
+void ConsolePoller::pollForegroundConsole()
+{
   Rect scanRect;
   Region region;
-  while (!isTerminating()) {
-    Rect conRect = getConsoleRect();
-    if (!conRect.isEmpty()) {
-      int pollHeight = m_pollingRect.getHeight();
-      int pollWidth = m_pollingRect.getWidth();
-
-      {
-        AutoLock al(m_frameBufferMutex);
-        Rect offsetFb = m_screenGrabber->getScreenRect();
-        conRect.move(-offsetFb.left, -offsetFb.top);
-        FrameBuffer *screenFrameBuffer = m_screenGrabber->getScreenBuffer();
-        if (screenFrameBuffer->isEqualTo(m_backupFrameBuffer)) {
-          m_screenGrabber->grab(&conRect);
-          for (int iRow = conRect.top; iRow < conRect.bottom; iRow += pollHeight) {
-            for (int iCol = conRect.left; iCol < conRect.right; iCol += pollWidth) {
-              scanRect.setRect(iCol, iRow, min(iCol + pollWidth, conRect.right),
-                               min(iRow + pollHeight, conRect.bottom));
-              if (!screenFrameBuffer->cmpFrom(&scanRect, m_backupFrameBuffer,
-                                              scanRect.left, scanRect.top)) {
-                region.addRect(&scanRect);
-              }
+  Rect conRect = getConsoleRect(GetForegroundWindow());
+  if (!conRect.isEmpty()) {
+    int pollHeight = m_pollingRect.getHeight();
+    int pollWidth = m_pollingRect.getWidth();
+
+    {
+      AutoLock al(m_frameBufferMutex);
+      Rect offsetFb = m_screenGrabber->getScreenRect();
+      conRect.move(-offsetFb.left, -offsetFb.top);
+      FrameBuffer *screenFrameBuffer = m_screenGrabber->getScreenBuffer();
+      if (screenFrameBuffer->isEqualTo(m_backupFrameBuffer)) {
+        m_screenGrabber->grab(&conRect);
+        for (int iRow = conRect.top; iRow < conRect.bottom; iRow += pollHeight) {
+          for (int iCol = conRect.left; iCol < conRect.right; iCol += pollWidth) {
+            scanRect.setRect(iCol, iRow, min(iCol + pollWidth, conRect.right),
+                             min(iRow + pollHeight, conRect.bottom));
+            if (!screenFrameBuffer->cmpFrom(&scanRect, m_backupFrameBuffer,
+                                            scanRect.left, scanRect.top)) {
+              region.addRect(&scanRect);
             }
           }
         }
       }
+    }
 
-      // Send event
-      if (!region.isEmpty()) {
-        m_updateKeeper->addChangedRegion(&region);
-        doUpdate();
-      }
+    // Send event
+    if (!region.isEmpty()) {
+      m_updateKeeper->addChangedRegion(&region);
+      doUpdate();
     }
-    unsigned int pollInterval = 200;
-    m_intervalWaiter.waitForEvent(pollInterval);
   }
 }
 
-Rect ConsolePoller::getConsoleRect()
+Rect ConsolePoller::getConsoleRect(HWND hwnd)
 {
   Rect rect;
-  HWND hwnd = GetForegroundWindow();
+  if (hwnd == 0 || !IsWindowVisible(hwnd) || IsIconic(hwnd)) {
+    return rect;
+  }
 
   const TCHAR consoleClassName[] = _T("ConsoleWindowClass");
 
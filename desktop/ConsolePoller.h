@@ -25,16 +25,26 @@
 #ifndef __CONSOLEPOLLER_H__
 #define __CONSOLEPOLLER_H__
 
-#include "UpdateDetector.h"
+#include "ScheduledUpdateDetector.h"
 #include "ScreenGrabber.h"
-#include "win-system/WindowsEvent.h"
 #include "log-writer/LogWriter.h"
+#include "thread/LocalMutex.h"
+#include "ConsoleChangeHook.h"
 
-class ConsolePoller : public UpdateDetector
+#include <vector>
+
+// Detects changes of the console windows, which the screen hooks do not
+// see. The console events of a WinEvent hook tell which consoles have
+// changed, their windows are then reported as changed, and the update
+// filter finds the changed pixels and the scrolling in there. If the hook
+// cannot be installed, the console in the foreground is polled.
+class ConsolePoller : public ScheduledUpdateDetector,
+                      private ConsoleChangeListener
 {
 public:
   ConsolePoller(UpdateKeeper *updateKeeper,
                 UpdateListener *updateListener,
+                TaskScheduler *scheduler,
                 ScreenGrabber *screenGrabber,
                 FrameBuffer *backupFrameBuffer,
                 LocalMutex *frameBufferMutex,
@@ -43,17 +53,33 @@ public:
   virtual ~ConsolePoller();
 
 protected:
-  virtual void execute();
-  virtual void onTerminate();
+  virtual unsigned int detect();
+  virtual void onStart();
+  virtual void onStop();
 
 private:
-  Rect getConsoleRect();
+  virtual void onConsoleChanged(HWND hwnd);
+
+  // Reports the windows of the consoles changed since the last check.
+  void reportChangedConsoles();
+  // Compares the pixels of the foreground console with the backup frame
+  // buffer.
+  void pollForegroundConsole();
+
+  // Returns the rectangle of the window in the screen coordinates if it is
+  // a visible console window, an empty rectangle otherwise.
+  Rect getConsoleRect(HWND hwnd);
 
   ScreenGrabber *m_screenGrabber;
   FrameBuffer *m_backupFrameBuffer;
   LocalMutex *m_frameBufferMutex;
   Rect m_pollingRect;
-  WindowsEvent m_intervalWaiter;
+
+  ConsoleChangeHook *m_consoleHook;
+  // The consoles reported by the hook, and the lock of the list.
+  std::vector<HWND> m_changedConsoles;
+  LocalMutex m_changedConsolesLock;
+
   LogWriter *m_log;
 };
 
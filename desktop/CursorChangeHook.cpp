@@ -0,0 +1,120 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CursorChangeHook.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+
+CursorChangeHook *CursorChangeHook::m_instance = 0;
+LocalMutex CursorChangeHook::m_instanceMutex;
+
+CursorChangeHook::CursorChangeHook(CursorChangeListener *listener,
+                                   LogWriter *log)
+: m_listener(listener),
+  m_isInstalled(false),
+  m_log(log)
+{
+  {
+    AutoLock al(&m_instanceMutex);
+    if (m_instance != 0) {
+      throw Exception(_T("CursorChangeHook instance already exists"));
+    }
+    m_instance = this;
+  }
+  resume();
+}
+
+CursorChangeHook::~CursorChangeHook()
+{
+  terminate();
+  wait();
+
+  AutoLock al(&m_instanceMutex);
+  m_instance = 0;
+}
+
+void CursorChangeHook::onTerminate()
+{
+  PostThreadMessage(getThreadId(), WM_QUIT, 0, 0);
+}
+
+void CursorChangeHook::execute()
+{
+  // Two hooks keep the location changes, sent on every mouse move, out of
+  // the ranges.
+  HWINEVENTHOOK showHook = SetWinEventHook(EVENT_OBJECT_SHOW,
+                                           EVENT_OBJECT_HIDE,
+                                           0, winEventProc, 0, 0,
+                                           WINEVENT_OUTOFCONTEXT);
+  HWINEVENTHOOK nameHook = SetWinEventHook(EVENT_OBJECT_NAMECHANGE,
+                                           EVENT_OBJECT_NAMECHANGE,
+                                           0, winEventProc, 0, 0,
+                                           WINEVENT_OUTOFCONTEXT);
+  if (showHook == 0 || nameHook == 0) {
+    m_log->error(_T("Can't install the cursor change hook, error = %u"),
+                 GetLastError());
+    if (showHook != 0) {
+      UnhookWinEvent(showHook);
+    }
+    if (nameHook != 0) {
+      UnhookWinEvent(nameHook);
+    }
+    return;
+  }
+  m_isInstalled = true;
+  m_log->info(_T("Cursor change hook thread id = %d"), getThreadId());
+
+  // The hook procedure is called in this thread while it waits for messages.
+  MSG msg;
+  while (!isTerminating()) {
+    if (!PeekMessage(&msg, NULL, NULL, NULL, PM_REMOVE)) {
+      if (!WaitMessage()) {
+        break;
+      }
+    } else if (msg.message == WM_QUIT) {
+      break;
+    } else {
+      DispatchMessage(&msg);
+    }
+  }
+
+  m_isInstalled = false;
+  UnhookWinEvent(showHook);
+  UnhookWinEvent(nameHook);
+}
+
+void CALLBACK CursorChangeHook::winEventProc(HWINEVENTHOOK hook, DWORD event,
+                                             HWND hwnd, LONG idObject,
+                                             LONG idChild, DWORD eventThread,
+                                             DWORD eventTime)
+{
+  // The name changes of the windows and the other objects come here too.
+  if (idObject != OBJID_CURSOR) {
+    return;
+  }
+  // The instance cannot go away while its thread is in here.
+  if (m_instance != 0) {
+    m_instance->m_listener->onCursorChanged();
+  }
+}
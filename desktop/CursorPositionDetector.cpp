@@ -24,20 +24,29 @@
 
 #include "CursorPositionDetector.h"
 
+#include "util/Exception.h"
+
 const int MOUSE_SLEEP_TIME = 10;
+// Time after the last hooked move during which the position is polled with
+// MOUSE_SLEEP_TIME, the move may be applied after the check it has caused.
+const int MOUSE_MOVE_TRACKING_TIME = 100;
+// Delay between the checks while the hook reports no moves.
+const int MOUSE_IDLE_SLEEP_TIME = 500;
 
 CursorPositionDetector::CursorPositionDetector(UpdateKeeper *updateKeeper,
                              UpdateListener *updateListener,
+                             TaskScheduler *scheduler,
                              LogWriter *log)
-: UpdateDetector(updateKeeper, updateListener),
+: ScheduledUpdateDetector(updateKeeper, updateListener, scheduler),
+  m_mouseHook(0),
+  m_lastMoveTime(0),
   m_log(log)
 {
 }
 
 CursorPositionDetector::~CursorPositionDetector(void)
 {
-  terminate();
-  wait();
+  stop();
 }
 
 Point CursorPositionDetector::getCursorPos()
@@ -45,24 +54,41 @@ Point CursorPositionDetector::getCursorPos()
   return m_cursor.getCursorPos();
 }
 
-void CursorPositionDetector::onTerminate()
+unsigned int CursorPositionDetector::detect()
 {
-  m_sleepTimer.notify();
+  Point curPoint = m_cursor.getCursorPos();
+  if (!m_lastCursorPos.isEqualTo(&curPoint)) {
+    m_lastCursorPos = curPoint;
+    m_updateKeeper->setCursorPos(&m_lastCursorPos);
+    doUpdate();
+  }
+
+  if (m_mouseHook == 0 || !m_mouseHook->isInstalled() ||
+      GetTickCount() - m_lastMoveTime < MOUSE_MOVE_TRACKING_TIME) {
+    return MOUSE_SLEEP_TIME;
+  }
+  return MOUSE_IDLE_SLEEP_TIME;
 }
 
-void CursorPositionDetector::execute()
+void CursorPositionDetector::onStart()
 {
-  m_log->info(_T("mouse detector thread id = %d"), getThreadId());
-
-  Point curPoint;
+  try {
+    m_mouseHook = new MouseMoveHook(this, m_log);
+  } catch (Exception &e) {
+    m_log->error(_T("Cursor position will be polled: %s"), e.getMessage());
+  }
+}
 
-  while (!isTerminating()) {
-    curPoint = m_cursor.getCursorPos();
-    if (!m_lastCursorPos.isEqualTo(&curPoint)) {
-      m_lastCursorPos = curPoint;
-      m_updateKeeper->setCursorPos(&m_lastCursorPos);
-      doUpdate();
-    }
-    m_sleepTimer.waitForEvent(MOUSE_SLEEP_TIME);
+void CursorPositionDetector::onStop()
+{
+  if (m_mouseHook != 0) {
+    delete m_mouseHook;
+    m_mouseHook = 0;
   }
 }
+
+void CursorPositionDetector::onMouseMove()
+{
+  m_lastMoveTime = GetTickCount();
+  checkNow();
+}
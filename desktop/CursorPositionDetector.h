@@ -25,16 +25,23 @@
 #ifndef __CURSORPOSITIONDETECTOR_H__
 #define __CURSORPOSITIONDETECTOR_H__
 
-#include "UpdateDetector.h"
-#include "win-system/WindowsEvent.h"
+#include "ScheduledUpdateDetector.h"
 #include "log-writer/LogWriter.h"
 #include "win-system/WinCursor.h"
+#include "MouseMoveHook.h"
 
-class CursorPositionDetector : public UpdateDetector
+// Detects changes of the cursor position. The position is checked as soon
+// as a low-level mouse hook reports a move and then polled for a short time
+// while the mouse keeps moving. When idle, rare checks catch the moves the
+// hook does not see, such as the ones made by SetCursorPos(). If the hook
+// cannot be installed, the position is polled all the time.
+class CursorPositionDetector : public ScheduledUpdateDetector,
+                               private MouseMoveListener
 {
 public:
   CursorPositionDetector(UpdateKeeper *updateKeeper,
                 UpdateListener *updateListener,
+                TaskScheduler *scheduler,
                 LogWriter *log);
   virtual ~CursorPositionDetector(void);
 
@@ -42,13 +49,18 @@ public:
   Point getCursorPos();
 
 protected:
-  virtual void execute();
-  virtual void onTerminate();
+  virtual unsigned int detect();
+  virtual void onStart();
+  virtual void onStop();
 
 private:
+  virtual void onMouseMove();
+
   WinCursor m_cursor;
-  WindowsEvent m_sleepTimer;
   Point m_lastCursorPos;
+
+  MouseMoveHook *m_mouseHook;
+  volatile DWORD m_lastMoveTime;
   LogWriter *m_log;
 };
 
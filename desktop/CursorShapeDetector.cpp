@@ -24,45 +24,66 @@
 
 #include "CursorShapeDetector.h"
 
+#include "util/Exception.h"
+
 const int SLEEP_TIME = 100;
+// Delay between the checks while the hook reports the changes.
+const int IDLE_SLEEP_TIME = 1000;
 
 CursorShapeDetector::CursorShapeDetector(UpdateKeeper *updateKeeper,
                                        UpdateListener *updateListener,
+                                       TaskScheduler *scheduler,
                                        CursorShapeGrabber *mouseGrabber,
                                        LocalMutex *mouseGrabLocMut,
                                        LogWriter *log)
-: UpdateDetector(updateKeeper, updateListener),
+: ScheduledUpdateDetector(updateKeeper, updateListener, scheduler),
   m_mouseGrabber(mouseGrabber),
   m_mouseGrabLocMut(mouseGrabLocMut),
-  m_log(log)
+  m_log(log),
+  m_cursorHook(0)
 {
 }
 
 CursorShapeDetector::~CursorShapeDetector(void)
 {
-  terminate();
-  wait();
+  stop();
 }
 
-void CursorShapeDetector::onTerminate()
+unsigned int CursorShapeDetector::detect()
 {
-  m_sleepTimer.notify();
+  bool isCursorShapeChanged;
+  {
+    AutoLock al(m_mouseGrabLocMut);
+    isCursorShapeChanged = m_mouseGrabber->isCursorShapeChanged();
+  }
+  if (isCursorShapeChanged) {
+    m_updateKeeper->setCursorShapeChanged();
+    doUpdate();
+  }
+  if (m_cursorHook == 0 || !m_cursorHook->isInstalled()) {
+    return SLEEP_TIME;
+  }
+  return IDLE_SLEEP_TIME;
 }
 
-void CursorShapeDetector::execute()
+void CursorShapeDetector::onStart()
 {
-  m_log->info(_T("mouse shape detector thread id = %d"), getThreadId());
+  try {
+    m_cursorHook = new CursorChangeHook(this, m_log);
+  } catch (Exception &e) {
+    m_log->error(_T("Cursor shape will be polled: %s"), e.getMessage());
+  }
+}
 
-  while (!isTerminating()) {
-    bool isCursorShapeChanged;
-    {
-      AutoLock al(m_mouseGrabLocMut);
-      isCursorShapeChanged = m_mouseGrabber->isCursorShapeChanged();
-    }
-    if (isCursorShapeChanged) {
-      m_updateKeeper->setCursorShapeChanged();
-      doUpdate();
-    }
-    m_sleepTimer.waitForEvent(SLEEP_TIME);
+void CursorShapeDetector::onStop()
+{
+  if (m_cursorHook != 0) {
+    delete m_cursorHook;
+    m_cursorHook = 0;
   }
 }
+
+void CursorShapeDetector::onCursorChanged()
+{
+  checkNow();
+}
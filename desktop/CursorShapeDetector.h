@@ -27,29 +27,40 @@
 
 #include "UpdateKeeper.h"
 #include "CursorShapeGrabber.h"
-#include "UpdateDetector.h"
-#include "win-system/WindowsEvent.h"
+#include "ScheduledUpdateDetector.h"
 #include "log-writer/LogWriter.h"
+#include "CursorChangeHook.h"
 
-class CursorShapeDetector : public UpdateDetector
+// Detects changes of the cursor shape. The cursor is checked when a
+// WinEvent hook reports a change of the cursor object, the rare scheduled
+// checks only catch the changes the system does not report. If the hook
+// cannot be installed, the cursor is polled.
+class CursorShapeDetector : public ScheduledUpdateDetector,
+                            private CursorChangeListener
 {
 public:
   CursorShapeDetector(UpdateKeeper *updateKeeper,
                      UpdateListener *updateListener,
+                     TaskScheduler *scheduler,
                      CursorShapeGrabber *mouseGrabber,
                      LocalMutex *mouseGrabLocMut,
                      LogWriter *log);
   virtual ~CursorShapeDetector();
 
 protected:
-  virtual void execute();
-  virtual void onTerminate();
+  virtual unsigned int detect();
+  virtual void onStart();
+  virtual void onStop();
 
   CursorShapeGrabber *m_mouseGrabber;
   LocalMutex *m_mouseGrabLocMut;
-  WindowsEvent m_sleepTimer;
 
   LogWriter *m_log;
+
+private:
+  virtual void onCursorChanged();
+
+  CursorChangeHook *m_cursorHook;
 };
 
 #endif // __CURSORHAPEDETECTOR_H__
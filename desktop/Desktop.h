@@ -31,6 +31,7 @@
 #include "rfb/PixelFormat.h"
 #include "rfb/FrameBuffer.h"
 #include "fb-update-sender/UpdateRequestListener.h"
+#include "CaptureStatistics.h"
 #include <vector>
 
 // This class is a public interface to a desktop.
@@ -54,6 +55,9 @@ public:
                                       unsigned char dispNumber) = 0;
   virtual std::vector<Rect> getDisplaysCoords() = 0;
   virtual void getWindowCoords(HWND hwnd, Rect *rect) = 0;
+  // Sets rect to the frame buffer coordinates of the foreground window,
+  // empty if there is no foreground window.
+  virtual void getForegroundWindowCoords(Rect *rect) = 0;
   virtual HWND getWindowHandleByName(const StringStorage *windowName) = 0;
 
   virtual void getApplicationRegion(unsigned int procId, Region *region) = 0;
@@ -61,8 +65,15 @@ public:
 
   virtual void setKeyboardEvent(UINT32 keySym, bool down) = 0;
   virtual void setMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask) = 0;
+  // The keyboard and mouse events set between these calls may be injected
+  // together by endInputBatch(), in the same order.
+  virtual void beginInputBatch() = 0;
+  virtual void endInputBatch() = 0;
   virtual void setNewClipText(const StringStorage *newClipboard) = 0;
 
+  // Fills stats with the screen capture counters of the desktop.
+  virtual void getCaptureStatistics(CaptureStatistics *stats) = 0;
+
   // Updates external frame buffer pixels only for the region from view port
   // located at the place in a central frame buffer.
   // If view port is out of central frame buffer bounds the function will return false.
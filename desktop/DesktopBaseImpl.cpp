@@ -23,6 +23,7 @@
 //
 
 #include "DesktopBaseImpl.h"
+#include "VisualEffectsUtil.h"
 #include "util/BrokenHandleException.h"
 
 DesktopBaseImpl::DesktopBaseImpl(ClipboardListener *extClipListener,
@@ -34,6 +35,9 @@ DesktopBaseImpl::DesktopBaseImpl(ClipboardListener *extClipListener,
   m_extClipListener(extClipListener),
   m_userInput(0),
   m_updateHandler(0),
+  m_captureRegionEnabled(false),
+  m_visualEffectsLevel(VisualEffectsUtil::LEVEL_FULL),
+  m_captureDemanded(true),
   m_log(log)
 {
 }
@@ -140,6 +144,18 @@ void DesktopBaseImpl::getWindowCoords(HWND hwnd, Rect *rect)
   }
 }
 
+void DesktopBaseImpl::getForegroundWindowCoords(Rect *rect)
+{
+  _ASSERT(m_userInput != 0);
+  _ASSERT(m_extDeskTermListener != 0);
+  try {
+    m_userInput->getForegroundWindowCoords(rect);
+  } catch (Exception &e) {
+    m_log->error(_T("Exception in DesktopBaseImpl::getForegroundWindowCoords: %s"), e.getMessage());
+    m_extDeskTermListener->onAbnormalDesktopTerminate();
+  }
+}
+
 HWND DesktopBaseImpl::getWindowHandleByName(const StringStorage *windowName)
 {
   _ASSERT(m_userInput != 0);
@@ -185,7 +201,7 @@ bool DesktopBaseImpl::isRemoteInputAllowed()
 {
   m_log->debug(_T("checking remote input allowing"));
 
-  bool enabled = !Configurator::getInstance()->getServerConfig()->isBlockingRemoteInput();
+  bool enabled = !Configurator::getConfigSnapshot()->isBlockingRemoteInput();
   enabled = enabled && !isRemoteInputTempBlocked();
   return enabled;
 }
@@ -223,6 +239,32 @@ void DesktopBaseImpl::setMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask)
   }
 }
 
+void DesktopBaseImpl::beginInputBatch()
+{
+  _ASSERT(m_userInput != 0);
+  _ASSERT(m_extDeskTermListener != 0);
+
+  try {
+    m_userInput->beginInputBatch();
+  } catch (Exception &e) {
+    m_log->error(_T("Exception in DesktopBaseImpl::beginInputBatch %s"), e.getMessage());
+    m_extDeskTermListener->onAbnormalDesktopTerminate();
+  }
+}
+
+void DesktopBaseImpl::endInputBatch()
+{
+  _ASSERT(m_userInput != 0);
+  _ASSERT(m_extDeskTermListener != 0);
+
+  try {
+    m_userInput->endInputBatch();
+  } catch (Exception &e) {
+    m_log->error(_T("Exception in DesktopBaseImpl::endInputBatch %s"), e.getMessage());
+    m_extDeskTermListener->onAbnormalDesktopTerminate();
+  }
+}
+
 void DesktopBaseImpl::setNewClipText(const StringStorage *newClipboard)
 {
   _ASSERT(m_userInput != 0);
@@ -242,18 +284,42 @@ void DesktopBaseImpl::setNewClipText(const StringStorage *newClipboard)
   }
 }
 
+void DesktopBaseImpl::getCaptureStatistics(CaptureStatistics *stats)
+{
+  _ASSERT(m_updateHandler != 0);
+  _ASSERT(m_extDeskTermListener != 0);
+  try {
+    m_updateHandler->getCaptureStatistics(stats);
+  } catch (Exception &e) {
+    m_log->error(_T("Exception in DesktopBaseImpl::getCaptureStatistics: %s"), e.getMessage());
+    m_extDeskTermListener->onAbnormalDesktopTerminate();
+  }
+}
+
 void DesktopBaseImpl::sendUpdate()
 {
   _ASSERT(m_updateHandler != 0);
   _ASSERT(m_extDeskTermListener != 0);
   _ASSERT(m_extUpdSendingListener != 0);
 
-  if (!m_extUpdSendingListener->isReadyToSend()) {
+  // While nobody is ready the screen is not grabbed, the next update
+  // request wakes this thread up and resumes the capture.
+  bool ready = m_extUpdSendingListener->isReadyToSend();
+  try {
+    updateCaptureDemand(ready);
+  } catch (Exception &e) {
+    m_log->info(_T("WinDesktop::sendUpdate() failed with error:%s"),
+               e.getMessage());
+    m_extDeskTermListener->onAbnormalDesktopTerminate();
+  }
+  if (!ready) {
     m_log->detail(_T("nobody is ready for updates"));
     return;
   }
   UpdateContainer updCont;
   try {
+    updateCaptureRegion();
+    updateVisualEffectsLevel();
     if (!m_fullReqRegion.isEmpty()) {
       m_log->detail(_T("set full update request to UpdateHandler"));
       m_updateHandler->setFullUpdateRequested(&m_fullReqRegion);
@@ -279,6 +345,47 @@ void DesktopBaseImpl::sendUpdate()
   }
 }
 
+void DesktopBaseImpl::updateCaptureRegion()
+{
+  Dimension fbDim = m_updateHandler->getFrameBufferDimension();
+  Region captureRegion;
+  bool limited = m_extUpdSendingListener->getCaptureRegion(&fbDim,
+                                                           &captureRegion);
+  if (limited == m_captureRegionEnabled &&
+      (!limited || captureRegion.equals(&m_captureRegion))) {
+    return;
+  }
+  m_captureRegionEnabled = limited;
+  m_captureRegion = captureRegion;
+  if (limited) {
+    Rect bounds = captureRegion.getBounds();
+    m_log->debug(_T("Capture limited to %d rectangles within (%d,%d) %dx%d"),
+                 (int)captureRegion.getCount(), bounds.left, bounds.top,
+                 bounds.getWidth(), bounds.getHeight());
+    m_updateHandler->setCaptureRegion(&captureRegion);
+  } else {
+    m_log->debug(_T("Capture of the whole screen"));
+    m_updateHandler->setCaptureRegion(0);
+  }
+}
+
+void DesktopBaseImpl::updateVisualEffectsLevel()
+{
+  int level = m_extUpdSendingListener->getVisualEffectsLevel();
+  if (level != m_visualEffectsLevel) {
+    m_visualEffectsLevel = level;
+    m_updateHandler->setVisualEffectsLevel(level);
+  }
+}
+
+void DesktopBaseImpl::updateCaptureDemand(bool demanded)
+{
+  if (demanded != m_captureDemanded) {
+    m_captureDemanded = demanded;
+    m_updateHandler->setCaptureDemand(demanded);
+  }
+}
+
 void DesktopBaseImpl::onUpdate()
 {
   m_log->detail(_T("update detected"));
@@ -60,14 +60,19 @@ public:
   virtual std::vector<Rect> getDisplaysCoords();
   virtual void getNormalizedRect(Rect *rect);
   virtual void getWindowCoords(HWND hwnd, Rect *rect);
+  virtual void getForegroundWindowCoords(Rect *rect);
   virtual HWND getWindowHandleByName(const StringStorage *windowName);
   virtual void getApplicationRegion(unsigned int procId, Region *region);
   virtual bool isApplicationInFocus(unsigned int procId);
 
   virtual void setKeyboardEvent(UINT32 keySym, bool down);
   virtual void setMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask);
+  virtual void beginInputBatch();
+  virtual void endInputBatch();
   virtual void setNewClipText(const StringStorage *newClipboard);
 
+  virtual void getCaptureStatistics(CaptureStatistics *stats);
+
 protected:
   // Calling when at least one update has been detected.
   virtual void onUpdate();
@@ -90,9 +95,30 @@ protected:
 
   void sendUpdate();
 
+  // Asks the listener for the region watched by the clients and passes it
+  // to the update handler if it has changed.
+  void updateCaptureRegion();
+  // Asks the listener for the visual effects level and passes it to the
+  // update handler if it has changed.
+  void updateVisualEffectsLevel();
+  // Passes to the update handler whether some client is ready for updates
+  // if it has changed.
+  void updateCaptureDemand(bool demanded);
+
   Region m_fullReqRegion;
   LocalMutex m_reqRegMutex;
 
+  // Capture region last passed to the update handler, used only by the
+  // thread sending updates.
+  Region m_captureRegion;
+  bool m_captureRegionEnabled;
+  // Visual effects level last passed to the update handler, used only by
+  // the thread sending updates.
+  int m_visualEffectsLevel;
+  // Capture demand last passed to the update handler, used only by the
+  // thread sending updates.
+  bool m_captureDemanded;
+
   UpdateHandler *m_updateHandler;
 
   // A derived class thread control.
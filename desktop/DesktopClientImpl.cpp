@@ -30,6 +30,7 @@
 #include "SasUserInput.h"
 #include "WindowsUserInput.h"
 #include "DesktopConfigLocal.h"
+#include "thread/AutoLock.h"
 
 DesktopClientImpl::DesktopClientImpl(ClipboardListener *extClipListener,
                        UpdateSendingListener *extUpdSendingListener,
@@ -45,6 +46,7 @@ DesktopClientImpl::DesktopClientImpl(ClipboardListener *extClipListener,
   m_userInputClient(0),
   m_deskConf(0),
   m_gateKicker(0),
+  m_switchPending(false),
   m_log(log)
 {
   m_log->info(_T("Creating DesktopClientImpl"));
@@ -158,6 +160,11 @@ void DesktopClientImpl::onAnObjectEvent()
 
 void DesktopClientImpl::onReconnect(Channel *newChannelTo, Channel *newChannelFrom)
 {
+  {
+    AutoLock al(&m_switchLock);
+    m_switchPending = m_deskServWatcher->getLastExitTime(&m_switchStartTime);
+  }
+
   BlockingGate gate(newChannelTo);
   if (m_deskConf) {
     m_log->info(_T("try update remote configuration from the ")
@@ -179,6 +186,20 @@ void DesktopClientImpl::onReconnect(Channel *newChannelTo, Channel *newChannelFr
   m_srvToClChan->replaceChannel(newChannelFrom);
 }
 
+void DesktopClientImpl::onUpdate()
+{
+  {
+    AutoLock al(&m_switchLock);
+    if (m_switchPending) {
+      m_switchPending = false;
+      m_log->message(_T("First update from the new desktop server has come")
+                     _T(" in %u ms after the switch"),
+                     (unsigned int)(DateTime::now() - m_switchStartTime).getTime());
+    }
+  }
+  DesktopBaseImpl::onUpdate();
+}
+
 void DesktopClientImpl::onTerminate()
 {
   m_newUpdateEvent.notify();
@@ -60,6 +60,8 @@ private:
   // Interface functions
   virtual void onAnObjectEvent();
   virtual void onReconnect(Channel *newChannelTo, Channel *newChannelFrom);
+  // Reports the time to the first update after a desktop server switch.
+  virtual void onUpdate();
 
   void freeResource();
   void closeDesktopServerTransport();
@@ -81,6 +83,13 @@ private:
 
   DesktopConfigClient *m_deskConf;
 
+  // Set from a switch to a new desktop server, which has started when the
+  // previous one has exited, to the first update from it. Protected by
+  // m_switchLock.
+  bool m_switchPending;
+  DateTime m_switchStartTime;
+  LocalMutex m_switchLock;
+
   LogWriter *m_log;
 };
 
@@ -33,12 +33,21 @@
 #include "win-system/WinStaLibrary.h"
 #include "win-system/WinHandles.h"
 #include "win-system/SharedMemory.h"
+#include "thread/AutoLock.h"
 
 #include <time.h>
 
 DesktopServerWatcher::DesktopServerWatcher(ReconnectionListener *recListener, LogWriter *log)
-: m_recListener(recListener),
+: m_pipeFactory(512 * 1024, log),
   m_process(0),
+  m_sharedMemory(0),
+  m_standbyProcess(0),
+  m_standbySharedMemory(0),
+  m_hasStandby(false),
+  m_standbySessionId(0),
+  m_connectRdpSession(false),
+  m_hasExited(false),
+  m_recListener(recListener),
   m_log(log)
 {
   // Desktop server folder.
@@ -51,8 +60,9 @@ DesktopServerWatcher::DesktopServerWatcher(ReconnectionListener *recListener, Lo
   path.format(_T("\"%s\""), currentModulePath.getString());
 
   try {
-    bool connectRdpSession = Configurator::getInstance()->getServerConfig()->getConnectToRdpFlag();
-    m_process = new CurrentConsoleProcess(m_log, connectRdpSession, path.getString());
+    m_connectRdpSession = Configurator::getInstance()->getServerConfig()->getConnectToRdpFlag();
+    m_process = new CurrentConsoleProcess(m_log, m_connectRdpSession, path.getString());
+    m_standbyProcess = new CurrentConsoleProcess(m_log, m_connectRdpSession, path.getString());
   } catch (...) {
     if (m_process) delete m_process;
     throw;
@@ -63,96 +73,229 @@ DesktopServerWatcher::~DesktopServerWatcher()
 {
   terminate();
   wait();
+  discardStandby();
+  delete m_standbyProcess;
   delete m_process;
+  if (m_sharedMemory) delete m_sharedMemory;
 }
 
-void DesktopServerWatcher::execute()
+bool DesktopServerWatcher::getLastExitTime(DateTime *exitTime)
 {
-  AnonymousPipeFactory pipeFactory(512 * 1024, m_log);
+  *exitTime = m_lastExitTime;
+  return m_hasExited;
+}
 
-  AnonymousPipe *ownSidePipeChanTo, *otherSidePipeChanTo,
-                *ownSidePipeChanFrom, *otherSidePipeChanFrom;
+void DesktopServerWatcher::execute()
+{
+  // The names of the shared memory must differ for the desktop servers
+  // started within a second.
+  srand((unsigned)time(0));
 
   while (!isTerminating()) {
     try {
-      StringStorage shMemName(_T("Global\\"));
-      srand((unsigned)time(0));
-      for (int i = 0; i < 20; i++) {
-        shMemName.appendChar('a' + rand() % ('z' - 'a'));
+      bool fromStandby = isStandbyUsable();
+      SharedMemory *sharedMemory;
+      if (fromStandby) {
+        AutoLock al(&m_processLock);
+        CurrentConsoleProcess *process = m_process;
+        m_process = m_standbyProcess;
+        m_standbyProcess = process;
+        sharedMemory = m_standbySharedMemory;
+        m_standbySharedMemory = 0;
+        m_hasStandby = false;
+      } else {
+        discardStandby();
+        sharedMemory = prepareLaunch(m_process, false);
+        try {
+          start();
+        } catch (...) {
+          delete sharedMemory;
+          throw;
+        }
+      }
+      if (m_sharedMemory) delete m_sharedMemory;
+      m_sharedMemory = sharedMemory;
+
+      attach(m_process, m_sharedMemory);
+      if (m_hasExited) {
+        m_log->message(_T("Desktop server is attached in %u ms after the previous")
+                       _T(" one has exited (%s)"),
+                       (unsigned int)(DateTime::now() - m_lastExitTime).getTime(),
+                       fromStandby ? _T("standby process") : _T("new process"));
       }
-      SharedMemory sharedMemory(shMemName.getString(), 72);
-      UINT64 *mem = (UINT64 *)sharedMemory.getMemPointer();
 
-      // Sets memory ready flag to false.
-      mem[0] = 0;
+      launchStandby();
 
-      ownSidePipeChanTo = otherSidePipeChanTo =
-      ownSidePipeChanFrom = otherSidePipeChanFrom = 0;
+      m_process->waitForExit();
+      m_lastExitTime = DateTime::now();
+      m_hasExited = true;
+    } catch (Exception &e) {
+      m_log->error(_T("DesktopServerWatcher has failed with error: %s"), e.getMessage());
+      Sleep(1000);
+    }
+  }
+}
 
-      pipeFactory.generatePipes(&ownSidePipeChanTo, false,
+SharedMemory *DesktopServerWatcher::prepareLaunch(Process *process, bool standby)
+{
+  StringStorage shMemName(_T("Global\\"));
+  for (int i = 0; i < 20; i++) {
+    shMemName.appendChar('a' + rand() % ('z' - 'a'));
+  }
+  SharedMemory *sharedMemory = new SharedMemory(shMemName.getString(), 72);
+  UINT64 *mem = (UINT64 *)sharedMemory->getMemPointer();
+
+  // Sets memory ready flag to false.
+  mem[0] = 0;
+  // A standby process waits for the handles while this process runs.
+  mem[7] = standby ? GetCurrentProcessId() : 0;
+
+  // TightVNC server log directory.
+  StringStorage logDir;
+  Configurator::getInstance()->getServerConfig()->getLogFileDir(&logDir);
+
+  // Arguments that must be passed to desktop server application.
+  StringStorage args;
+  args.format(_T("-desktopserver -logdir \"%s\" -loglevel %d -shmemname %s"),
+              logDir.getString(),
+              Configurator::getInstance()->getServerConfig()->getLogLevel(),
+              shMemName.getString());
+
+  process->setArguments(args.getString());
+  return sharedMemory;
+}
+
+void DesktopServerWatcher::attach(Process *process, SharedMemory *sharedMemory)
+{
+  UINT64 *mem = (UINT64 *)sharedMemory->getMemPointer();
+
+  AnonymousPipe *ownSidePipeChanTo, *otherSidePipeChanTo,
+                *ownSidePipeChanFrom, *otherSidePipeChanFrom;
+  ownSidePipeChanTo = otherSidePipeChanTo =
+  ownSidePipeChanFrom = otherSidePipeChanFrom = 0;
+
+  try {
+    m_pipeFactory.generatePipes(&ownSidePipeChanTo, false,
                                 &otherSidePipeChanTo, false);
-      pipeFactory.generatePipes(&ownSidePipeChanFrom, false,
+    m_pipeFactory.generatePipes(&ownSidePipeChanFrom, false,
                                 &otherSidePipeChanFrom, false);
 
-      // TightVNC server log directory.
-      StringStorage logDir;
-      Configurator::getInstance()->getServerConfig()->getLogFileDir(&logDir);
-
-      // Arguments that must be passed to desktop server application.
-      StringStorage args;
-      args.format(_T("-desktopserver -logdir \"%s\" -loglevel %d -shmemname %s"),
-                  logDir.getString(),
-                  Configurator::getInstance()->getServerConfig()->getLogLevel(),
-                  shMemName.getString());
-
-      m_process->setArguments(args.getString());
-      start();
-
-      // Prepare other side pipe handles for other side
-      m_log->debug(_T("DesktopServerWatcher::execute(): assigning handles"));
-      otherSidePipeChanTo->assignHandlesFor(m_process->getProcessHandle(), false);
-      otherSidePipeChanFrom->assignHandlesFor(m_process->getProcessHandle(), false);
-
-      // Transfer other side handles by the memory channel
-      mem[1] = (UINT64)otherSidePipeChanTo->getWriteHandle();
-      mem[2] = (UINT64)otherSidePipeChanTo->getReadHandle();
-      mem[3] = (UINT64)otherSidePipeChanTo->getMaxPortionSize();
-      mem[4] = (UINT64)otherSidePipeChanFrom->getWriteHandle();
-      mem[5] = (UINT64)otherSidePipeChanFrom->getReadHandle();
-      mem[6] = (UINT64)otherSidePipeChanFrom->getMaxPortionSize();
-
-      // Sets memory ready flag to true.
-      mem[0] = 1;
-
-      // Destroying other side objects
-      delete otherSidePipeChanTo;
-      m_log->debug(_T("DesktopServerWatcher::execute(): Destroyed otherSidePipeChanTo"));
-      otherSidePipeChanTo = 0;
-      delete otherSidePipeChanFrom;
-      m_log->debug(_T("DesktopServerWatcher::execute(): Destroyed otherSidePipeChanFrom"));
-      otherSidePipeChanFrom = 0;
-
-      m_log->debug(_T("DesktopServerWatcher::execute(): Try to call onReconnect()"));
-      m_recListener->onReconnect(ownSidePipeChanTo, ownSidePipeChanFrom);
+    // Prepare other side pipe handles for other side
+    m_log->debug(_T("DesktopServerWatcher::execute(): assigning handles"));
+    otherSidePipeChanTo->assignHandlesFor(process->getProcessHandle(), false);
+    otherSidePipeChanFrom->assignHandlesFor(process->getProcessHandle(), false);
+
+    // Transfer other side handles by the memory channel
+    mem[1] = (UINT64)otherSidePipeChanTo->getWriteHandle();
+    mem[2] = (UINT64)otherSidePipeChanTo->getReadHandle();
+    mem[3] = (UINT64)otherSidePipeChanTo->getMaxPortionSize();
+    mem[4] = (UINT64)otherSidePipeChanFrom->getWriteHandle();
+    mem[5] = (UINT64)otherSidePipeChanFrom->getReadHandle();
+    mem[6] = (UINT64)otherSidePipeChanFrom->getMaxPortionSize();
+
+    // Sets memory ready flag to true.
+    mem[0] = 1;
+
+    // Destroying other side objects
+    delete otherSidePipeChanTo;
+    m_log->debug(_T("DesktopServerWatcher::execute(): Destroyed otherSidePipeChanTo"));
+    otherSidePipeChanTo = 0;
+    delete otherSidePipeChanFrom;
+    m_log->debug(_T("DesktopServerWatcher::execute(): Destroyed otherSidePipeChanFrom"));
+    otherSidePipeChanFrom = 0;
+
+    m_log->debug(_T("DesktopServerWatcher::execute(): Try to call onReconnect()"));
+    m_recListener->onReconnect(ownSidePipeChanTo, ownSidePipeChanFrom);
+  } catch (...) {
+    // A potentional memory leak. 
+    // A potential crash. The channels can be used (see onReconnect()) after these destroyings.
+    if (ownSidePipeChanTo) delete ownSidePipeChanTo;
+    if (otherSidePipeChanTo) delete otherSidePipeChanTo;
+    if (ownSidePipeChanFrom) delete ownSidePipeChanFrom;
+    if (otherSidePipeChanFrom) delete otherSidePipeChanFrom;
+    throw;
+  }
+}
 
-      m_process->waitForExit();
+void DesktopServerWatcher::launchStandby()
+{
+  bool isRdp;
+  DWORD sessionId = getTargetSessionId(&isRdp);
+  // The desktop servers of RDP sessions may run with the token of the
+  // user, which depends on the state of the session.
+  if (isRdp || isTerminating()) {
+    return;
+  }
 
-    } catch (Exception &e) {
-      // A potentional memory leak. 
-      // A potential crash. The channels can be used (see onReconnect()) after these destroyings.
-      if (ownSidePipeChanTo) delete ownSidePipeChanTo;
-      if (otherSidePipeChanTo) delete otherSidePipeChanTo;
-      if (ownSidePipeChanFrom) delete ownSidePipeChanFrom;
-      if (otherSidePipeChanFrom) delete otherSidePipeChanFrom;
-      m_log->error(_T("DesktopServerWatcher has failed with error: %s"), e.getMessage());
-      Sleep(1000);
+  SharedMemory *sharedMemory = prepareLaunch(m_standbyProcess, true);
+  try {
+    m_standbyProcess->start();
+  } catch (Exception &e) {
+    m_log->info(_T("Cannot start standby desktop server: %s"), e.getMessage());
+    delete sharedMemory;
+    return;
+  }
+  m_standbySharedMemory = sharedMemory;
+  m_standbySessionId = sessionId;
+  m_hasStandby = true;
+  m_log->info(_T("Standby desktop server is started in session %u"),
+              (unsigned int)sessionId);
+}
+
+void DesktopServerWatcher::discardStandby()
+{
+  if (!m_hasStandby) {
+    return;
+  }
+  m_hasStandby = false;
+  try {
+    m_standbyProcess->kill();
+  } catch (Exception &e) {
+    m_log->debug(_T("Cannot kill standby desktop server: %s"), e.getMessage());
+  }
+  delete m_standbySharedMemory;
+  m_standbySharedMemory = 0;
+}
+
+bool DesktopServerWatcher::isStandbyUsable()
+{
+  if (!m_hasStandby) {
+    return false;
+  }
+  bool isRdp;
+  if (getTargetSessionId(&isRdp) != m_standbySessionId || isRdp) {
+    m_log->info(_T("Session has been changed, the standby desktop server")
+                _T(" is not used"));
+    return false;
+  }
+  if (WaitForSingleObject(m_standbyProcess->getProcessHandle(), 0) != WAIT_TIMEOUT) {
+    m_log->error(_T("Standby desktop server has exited"));
+    m_hasStandby = false;
+    return false;
+  }
+  return true;
+}
+
+DWORD DesktopServerWatcher::getTargetSessionId(bool *isRdp)
+{
+  // The same choice as WTS::duplicateCurrentProcessUserToken() makes.
+  *isRdp = false;
+  if (m_connectRdpSession) {
+    DWORD rdpSessionId = WTS::getRdpSessionId(m_log);
+    if (rdpSessionId != 0) {
+      *isRdp = true;
+      return rdpSessionId;
     }
   }
+  return WTS::getActiveConsoleSessionId(m_log);
 }
 
 void DesktopServerWatcher::onTerminate()
 {
+  // The standby process may take the place before the wait starts.
+  AutoLock al(&m_processLock);
   m_process->stopWait();
+  m_standbyProcess->stopWait();
 }
 
 void DesktopServerWatcher::start()
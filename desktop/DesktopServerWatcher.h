@@ -26,7 +26,11 @@
 #define __DESKTOPSERVERWATCHER_H__
 
 #include "thread/Thread.h"
-#include "win-system/Process.h"
+#include "thread/LocalMutex.h"
+#include "win-system/CurrentConsoleProcess.h"
+#include "win-system/SharedMemory.h"
+#include "win-system/AnonymousPipeFactory.h"
+#include "util/DateTime.h"
 #include "log-writer/LogWriter.h"
 #include "desktop-ipc/ReconnectionListener.h"
 
@@ -37,6 +41,13 @@
  *   Thread in infinity loop executes (and waits until it dies) desktop
  *   server application.
  *   It will break only if thread will be terminated.
+ *
+ *   While a desktop server runs, a standby one is started in the same
+ *   console session. It loads the configuration and waits for the pipe
+ *   handles, the desktop capture starts only when it gets them. When the
+ *   running desktop server exits on a desktop change (or fails), the
+ *   standby one takes its place at once. After a session change the
+ *   standby process is in a wrong session and a new one is started.
  */
 class DesktopServerWatcher : public Thread
 {
@@ -44,6 +55,11 @@ public:
   DesktopServerWatcher(ReconnectionListener *recListener, LogWriter *log);
   virtual ~DesktopServerWatcher();
 
+  // Returns the time the previous desktop server has exited at, false if
+  // the current one is the first. Should be called from
+  // ReconnectionListener::onReconnect().
+  bool getLastExitTime(DateTime *exitTime);
+
 protected:
   virtual void execute();
   virtual void onTerminate();
@@ -55,7 +71,43 @@ protected:
   // @throws SystemException on fail.
   void doXPTrick();
 
-  Process *m_process;
+  // Sets the arguments of process and returns the shared memory it gets
+  // the pipe handles by. A standby process waits for them as long as this
+  // process runs, the other ones for a few seconds.
+  SharedMemory *prepareLaunch(Process *process, bool standby);
+  // Passes new pipes to the process by the shared memory and gives the own
+  // sides of them to m_recListener.
+  void attach(Process *process, SharedMemory *sharedMemory);
+
+  // Starts the standby process in the console session, if the desktop
+  // servers are started there. The XP trick is never done for it.
+  void launchStandby();
+  // Kills the standby process if it is running.
+  void discardStandby();
+  // Returns true if the standby process runs in the session a new desktop
+  // server would be started in.
+  bool isStandbyUsable();
+  // Returns the session the desktop servers are started in and sets isRdp
+  // to true if it is an RDP session.
+  DWORD getTargetSessionId(bool *isRdp);
+
+  AnonymousPipeFactory m_pipeFactory;
+
+  // The running desktop server and the standby one, swapped when the
+  // standby process takes the place. Their pointers are protected by
+  // m_processLock.
+  CurrentConsoleProcess *m_process;
+  SharedMemory *m_sharedMemory;
+  CurrentConsoleProcess *m_standbyProcess;
+  SharedMemory *m_standbySharedMemory;
+  bool m_hasStandby;
+  DWORD m_standbySessionId;
+  LocalMutex m_processLock;
+
+  bool m_connectRdpSession;
+  bool m_hasExited;
+  DateTime m_lastExitTime;
+
   ReconnectionListener *m_recListener;
 
   LogWriter *m_log;
@@ -0,0 +1,276 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DirtyTileDetector.h"
+#include "util/CpuFeatures.h"
+#include "util/CommonHeader.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+DirtyTileDetector::DirtyTileDetector(int tileSize)
+: m_tileSize(DEFAULT_TILE_SIZE),
+  m_rowDiffers(rowDiffersPlain)
+{
+  setTileSize(tileSize);
+  if (CpuFeatures::hasAvx2()) {
+    m_rowDiffers = rowDiffersAvx2;
+  } else if (CpuFeatures::hasSse2()) {
+    m_rowDiffers = rowDiffersSse2;
+  }
+}
+
+DirtyTileDetector::~DirtyTileDetector()
+{
+}
+
+void DirtyTileDetector::setTileSize(int tileSize)
+{
+  m_tileSize = max(MIN_TILE_SIZE, min(tileSize, MAX_TILE_SIZE));
+}
+
+int DirtyTileDetector::getTileSize() const
+{
+  return m_tileSize;
+}
+
+void DirtyTileDetector::detect(const Rect *rect, const FrameBuffer *oldFb,
+                               const FrameBuffer *newFb,
+                               std::vector<Rect> *dirtyRects)
+{
+  if (rect->getWidth() <= 0 || rect->getHeight() <= 0) {
+    return;
+  }
+
+  const int bytesPerPixel = oldFb->getBytesPerPixel();
+  const int bytesPerRow = oldFb->getBytesPerRow();
+  const UINT8 *oldBuffer = (const UINT8 *)oldFb->getBuffer();
+  const UINT8 *newBuffer = (const UINT8 *)newFb->getBuffer();
+
+  // Tile columns covering the rectangle, aligned to the frame buffer grid.
+  const int firstColumnX = rect->left - rect->left % m_tileSize;
+  const int columnCount = (rect->right - firstColumnX + m_tileSize - 1) / m_tileSize;
+  m_dirtyMap.resize(columnCount);
+
+  int tileTop = rect->top;
+  while (tileTop < rect->bottom) {
+    const int tileBottom = min(tileTop - tileTop % m_tileSize + m_tileSize,
+                               rect->bottom);
+
+    // Build the dirty map of this tile row.
+    for (int column = 0; column < columnCount; column++) {
+      const int tileLeft = max(firstColumnX + column * m_tileSize, rect->left);
+      const int tileRight = min(firstColumnX + (column + 1) * m_tileSize,
+                                rect->right);
+      const size_t offset = tileTop * bytesPerRow + tileLeft * bytesPerPixel;
+      m_dirtyMap[column] = getFirstChangedRow(oldBuffer + offset,
+                                              newBuffer + offset,
+                                              bytesPerRow,
+                                              (tileRight - tileLeft) * bytesPerPixel,
+                                              tileTop, tileBottom);
+    }
+
+    // Merge adjacent dirty tiles into rectangles.
+    int column = 0;
+    while (column < columnCount) {
+      if (m_dirtyMap[column] == -1) {
+        column++;
+        continue;
+      }
+      Rect dirtyRect;
+      dirtyRect.left = max(firstColumnX + column * m_tileSize, rect->left);
+      dirtyRect.top = m_dirtyMap[column];
+      dirtyRect.bottom = tileBottom;
+      for (; column < columnCount && m_dirtyMap[column] != -1; column++) {
+        dirtyRect.top = min(dirtyRect.top, m_dirtyMap[column]);
+      }
+      dirtyRect.right = min(firstColumnX + column * m_tileSize, rect->right);
+      dirtyRects->push_back(dirtyRect);
+    }
+
+    tileTop = tileBottom;
+  }
+}
+
+void DirtyTileDetector::detectAndCopy(const Rect *rect, FrameBuffer *oldFb,
+                                      const FrameBuffer *newFb,
+                                      std::vector<Rect> *changedRects)
+{
+  if (rect->getWidth() <= 0 || rect->getHeight() <= 0) {
+    return;
+  }
+
+  const int bytesPerPixel = oldFb->getBytesPerPixel();
+  const int bytesPerRow = oldFb->getBytesPerRow();
+  UINT8 *oldBuffer = (UINT8 *)oldFb->getBuffer();
+  const UINT8 *newBuffer = (const UINT8 *)newFb->getBuffer();
+
+  const int firstColumnX = rect->left - rect->left % m_tileSize;
+  const int columnCount = (rect->right - firstColumnX + m_tileSize - 1) / m_tileSize;
+  m_changeMap.resize(columnCount);
+
+  int tileTop = rect->top;
+  while (tileTop < rect->bottom) {
+    const int tileBottom = min(tileTop - tileTop % m_tileSize + m_tileSize,
+                               rect->bottom);
+
+    for (int column = 0; column < columnCount; column++) {
+      const int tileLeft = max(firstColumnX + column * m_tileSize, rect->left);
+      const int tileRight = min(firstColumnX + (column + 1) * m_tileSize,
+                                rect->right);
+      const size_t offset = tileTop * bytesPerRow + tileLeft * bytesPerPixel;
+      Rect *tileChange = &m_changeMap[column];
+      copyChangedRows(oldBuffer + offset, newBuffer + offset, bytesPerRow,
+                      bytesPerPixel, tileRight - tileLeft,
+                      tileBottom - tileTop, tileChange);
+      tileChange->move(tileLeft, tileTop);
+    }
+
+    // The bounding rectangle of the changed pixels of adjacent changed
+    // tiles.
+    int column = 0;
+    while (column < columnCount) {
+      if (m_changeMap[column].isEmpty()) {
+        column++;
+        continue;
+      }
+      Rect changedRect = m_changeMap[column];
+      for (; column < columnCount && !m_changeMap[column].isEmpty(); column++) {
+        const Rect *tileChange = &m_changeMap[column];
+        changedRect.left = min(changedRect.left, tileChange->left);
+        changedRect.top = min(changedRect.top, tileChange->top);
+        changedRect.right = max(changedRect.right, tileChange->right);
+        changedRect.bottom = max(changedRect.bottom, tileChange->bottom);
+      }
+      changedRects->push_back(changedRect);
+    }
+
+    tileTop = tileBottom;
+  }
+}
+
+void DirtyTileDetector::copyChangedRows(UINT8 *oldPtr, const UINT8 *newPtr,
+                                        int bytesPerRow, int bytesPerPixel,
+                                        int width, int height,
+                                        Rect *tileChange) const
+{
+  const size_t bytesPerTileRow = width * bytesPerPixel;
+  // Byte bounds of the changed pixels found so far, the side scans of the
+  // next rows stop at them.
+  int leftByte = (int)bytesPerTileRow;
+  int rightByte = -1;
+  int top = -1;
+  int bottom = -1;
+  for (int y = 0; y < height; y++) {
+    if (m_rowDiffers(oldPtr, newPtr, bytesPerTileRow)) {
+      for (int i = 0; i < leftByte; i++) {
+        if (oldPtr[i] != newPtr[i]) {
+          leftByte = i;
+          break;
+        }
+      }
+      for (int i = (int)bytesPerTileRow - 1; i > rightByte; i--) {
+        if (oldPtr[i] != newPtr[i]) {
+          rightByte = i;
+          break;
+        }
+      }
+      memcpy(oldPtr, newPtr, bytesPerTileRow);
+      if (top == -1) {
+        top = y;
+      }
+      bottom = y + 1;
+    }
+    oldPtr += bytesPerRow;
+    newPtr += bytesPerRow;
+  }
+  if (top == -1) {
+    tileChange->clear();
+    return;
+  }
+  tileChange->setRect(leftByte / bytesPerPixel, top,
+                      rightByte / bytesPerPixel + 1, bottom);
+}
+
+int DirtyTileDetector::getFirstChangedRow(const UINT8 *oldPtr,
+                                          const UINT8 *newPtr,
+                                          int bytesPerRow,
+                                          size_t bytesPerTileRow,
+                                          int top, int bottom) const
+{
+  for (int y = top; y < bottom; y++) {
+    if (m_rowDiffers(oldPtr, newPtr, bytesPerTileRow)) {
+      return y;
+    }
+    oldPtr += bytesPerRow;
+    newPtr += bytesPerRow;
+  }
+  return -1;
+}
+
+bool DirtyTileDetector::rowDiffersPlain(const UINT8 *a, const UINT8 *b,
+                                        size_t length)
+{
+  return memcmp(a, b, length) != 0;
+}
+
+bool DirtyTileDetector::rowDiffersSse2(const UINT8 *a, const UINT8 *b,
+                                       size_t length)
+{
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m128i diff0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                  _mm_loadu_si128((const __m128i *)(b + i)));
+    __m128i diff1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                  _mm_loadu_si128((const __m128i *)(b + i + 16)));
+    __m128i diff = _mm_or_si128(diff0, diff1);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+      return true;
+    }
+  }
+  return i < length && memcmp(a + i, b + i, length - i) != 0;
+}
+
+bool DirtyTileDetector::rowDiffersAvx2(const UINT8 *a, const UINT8 *b,
+                                       size_t length)
+{
+  bool differs = false;
+  size_t i = 0;
+  for (; i + 64 <= length; i += 64) {
+    __m256i diff0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                     _mm256_loadu_si256((const __m256i *)(b + i)));
+    __m256i diff1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i + 32)),
+                                     _mm256_loadu_si256((const __m256i *)(b + i + 32)));
+    __m256i diff = _mm256_or_si256(diff0, diff1);
+    if (!_mm256_testz_si256(diff, diff)) {
+      differs = true;
+      break;
+    }
+  }
+  _mm256_zeroupper();
+  if (differs) {
+    return true;
+  }
+  return rowDiffersSse2(a + i, b + i, length - i);
+}
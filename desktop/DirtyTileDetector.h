@@ -0,0 +1,102 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __DIRTYTILEDETECTOR_H__
+#define __DIRTYTILEDETECTOR_H__
+
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+#include "util/inttypes.h"
+#include <vector>
+
+// DirtyTileDetector compares two frame buffers of the same properties tile
+// by tile and reports the changed tiles. Tiles are aligned to the frame
+// buffer grid, so results do not depend on how the checked region was
+// split into rectangles. Each tile is compared row by row with SSE2 or AVX2
+// instructions (when supported by the processor) and the comparison stops
+// at the first differing row. detectAndCopy() also brings the changed
+// tiles of the old buffer up to date in the same pass.
+class DirtyTileDetector
+{
+public:
+  static const int DEFAULT_TILE_SIZE = 64;
+  static const int MIN_TILE_SIZE = 8;
+  static const int MAX_TILE_SIZE = 256;
+
+  DirtyTileDetector(int tileSize = DEFAULT_TILE_SIZE);
+  ~DirtyTileDetector();
+
+  // Sets the tile edge length in pixels. Values out of the
+  // [MIN_TILE_SIZE, MAX_TILE_SIZE] range are clamped.
+  void setTileSize(int tileSize);
+  int getTileSize() const;
+
+  // Compares the rect area of oldFb and newFb and appends to dirtyRects
+  // the changed tiles (clipped by rect) with adjacent changed tiles of the
+  // same tile row merged into one rectangle. The top of every rectangle is
+  // the first changed scan line of its tiles.
+  void detect(const Rect *rect, const FrameBuffer *oldFb,
+              const FrameBuffer *newFb, std::vector<Rect> *dirtyRects);
+
+  // Compares the rect area of oldFb and newFb and copies the changed scan
+  // lines of every tile from newFb to oldFb while they are in the cache,
+  // so the area is streamed through once. Appends to changedRects the
+  // changed tiles of each tile row merged as by detect() and then trimmed
+  // to the bounds of the changed pixels.
+  void detectAndCopy(const Rect *rect, FrameBuffer *oldFb,
+                     const FrameBuffer *newFb, std::vector<Rect> *changedRects);
+
+private:
+  typedef bool (*RowDiffersFunc)(const UINT8 *a, const UINT8 *b,
+                                 size_t length);
+
+  // Returns the first scan line of the tile that differs in the two
+  // buffers or -1 if the tile has not been changed.
+  int getFirstChangedRow(const UINT8 *oldPtr, const UINT8 *newPtr,
+                         int bytesPerRow, size_t bytesPerTileRow,
+                         int top, int bottom) const;
+
+  // Copies the changed scan lines of the tile from newPtr to oldPtr.
+  // Returns the bounds of the changed pixels relative to the tile origin
+  // in tileChange, an empty rectangle if the tile has not been changed.
+  void copyChangedRows(UINT8 *oldPtr, const UINT8 *newPtr, int bytesPerRow,
+                       int bytesPerPixel, int width, int height,
+                       Rect *tileChange) const;
+
+  static bool rowDiffersPlain(const UINT8 *a, const UINT8 *b, size_t length);
+  static bool rowDiffersSse2(const UINT8 *a, const UINT8 *b, size_t length);
+  static bool rowDiffersAvx2(const UINT8 *a, const UINT8 *b, size_t length);
+
+  int m_tileSize;
+  RowDiffersFunc m_rowDiffers;
+
+  // First changed scan line of each tile of the current tile row, or -1
+  // for unchanged tiles.
+  std::vector<int> m_dirtyMap;
+  // Changed pixels of each tile of the current tile row for
+  // detectAndCopy().
+  std::vector<Rect> m_changeMap;
+};
+
+#endif // __DIRTYTILEDETECTOR_H__
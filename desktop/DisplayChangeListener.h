@@ -0,0 +1,37 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __DISPLAYCHANGELISTENER_H__
+#define __DISPLAYCHANGELISTENER_H__
+
+class DisplayChangeListener
+{
+public:
+  // Called when a display has been added, removed, moved, resized or
+  // rotated. It is called by the thread of the watcher and must return
+  // quickly.
+  virtual void onDisplayChanged() = 0;
+};
+
+#endif // __DISPLAYCHANGELISTENER_H__
@@ -0,0 +1,133 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DisplayChangeWatcher.h"
+#include "win-system/WindowsDisplays.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+#include "tvnserver-app/NamingDefs.h"
+
+DisplayChangeWatcher *DisplayChangeWatcher::m_instance = 0;
+LocalMutex DisplayChangeWatcher::m_instanceMutex;
+
+DisplayChangeWatcher::DisplayChangeWatcher(DisplayChangeListener *listener,
+                                           LogWriter *log)
+: m_window(GetModuleHandle(0), NamingDefs::DISPLAY_CHANGE_WINDOW_CLASS_NAME),
+  m_listener(listener),
+  m_log(log)
+{
+  {
+    AutoLock al(&m_instanceMutex);
+    if (m_instance != 0) {
+      throw Exception(_T("DisplayChangeWatcher instance already exists"));
+    }
+    m_instance = this;
+  }
+  resume();
+}
+
+DisplayChangeWatcher::~DisplayChangeWatcher()
+{
+  {
+    AutoLock al(&m_instanceMutex);
+    m_instance = 0;
+  }
+  terminate();
+  wait();
+}
+
+void DisplayChangeWatcher::reportChange()
+{
+  WindowsDisplays::invalidate();
+
+  AutoLock al(&m_instanceMutex);
+  if (m_instance != 0 && m_instance->m_window.getHWND() != 0) {
+    PostMessage(m_instance->m_window.getHWND(), WM_CHANGE_REPORTED, 0, 0);
+  }
+}
+
+void DisplayChangeWatcher::onTerminate()
+{
+  PostThreadMessage(getThreadId(), WM_QUIT, 0, 0);
+}
+
+void DisplayChangeWatcher::execute()
+{
+  if (isTerminating()) {
+    return;
+  }
+  if (!m_window.createWindow(this)) {
+    m_log->error(_T("Can't create the display change window, error = %u;")
+                 _T(" the display layout will be enumerated periodically"),
+                 GetLastError());
+    return;
+  }
+  // A change between the last enumeration and the creation of the window
+  // is not seen otherwise.
+  WindowsDisplays::invalidate();
+  WindowsDisplays::setChangeReported(true);
+  m_log->info(_T("Display change watcher thread id = %d"), getThreadId());
+
+  MSG msg;
+  while (!isTerminating()) {
+    BOOL result = GetMessage(&msg, 0, 0, 0);
+    if (result == 0) {
+      break;
+    }
+    if (result == -1) {
+      m_log->error(_T("Display change watcher thread has failed"));
+      break;
+    }
+    DispatchMessage(&msg);
+  }
+
+  WindowsDisplays::setChangeReported(false);
+  m_window.destroyWindow();
+}
+
+bool DisplayChangeWatcher::processMessage(UINT message,
+                                          WPARAM wParam,
+                                          LPARAM lParam)
+{
+  switch (message) {
+  case WM_DISPLAYCHANGE:
+    m_log->debug(_T("The display layout has been changed"));
+    WindowsDisplays::invalidate();
+    onDisplayChanged();
+    break;
+  case WM_CHANGE_REPORTED:
+    onDisplayChanged();
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+void DisplayChangeWatcher::onDisplayChanged()
+{
+  if (m_listener != 0) {
+    m_listener->onDisplayChanged();
+  }
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __DISPLAYCHANGEWATCHER_H__
+#define __DISPLAYCHANGEWATCHER_H__
+
+#include "util/CommonHeader.h"
+#include "thread/GuiThread.h"
+#include "thread/LocalMutex.h"
+#include "gui/MessageWindow.h"
+#include "log-writer/LogWriter.h"
+#include "DisplayChangeListener.h"
+
+// Receives WM_DISPLAYCHANGE by a hidden window in its own thread, makes
+// the WindowsDisplays enumerate the displays again and notifies the
+// listener. While the watcher runs, the display layout is kept until the
+// next change.
+//
+// Only one instance of this class may exist at a time.
+class DisplayChangeWatcher : protected GuiThread, private WindowMessageHandler
+{
+public:
+  DisplayChangeWatcher(DisplayChangeListener *listener, LogWriter *log);
+  virtual ~DisplayChangeWatcher();
+
+  // Reports a change found other than by WM_DISPLAYCHANGE, for example by
+  // a screen driver after a desktop switch, when the window of the watcher
+  // may have missed the broadcast. May be called by any thread and when no
+  // watcher exists.
+  static void reportChange();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+  virtual bool processMessage(UINT message, WPARAM wParam, LPARAM lParam);
+
+  void onDisplayChanged();
+
+  static DisplayChangeWatcher *m_instance;
+  static LocalMutex m_instanceMutex;
+
+  // Posted to the window by reportChange().
+  static const UINT WM_CHANGE_REPORTED = WM_USER + 1;
+
+  MessageWindow m_window;
+  DisplayChangeListener *m_listener;
+
+  LogWriter *m_log;
+};
+
+#endif // __DISPLAYCHANGEWATCHER_H__
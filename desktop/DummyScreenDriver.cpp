@@ -23,12 +23,22 @@
 //
 
 #include "DummyScreenDriver.h"
+#include "CaptureCounters.h"
+#include "thread/AutoLock.h"
 
-DummyScreenDriver::DummyScreenDriver(UpdateKeeper *updateKeeper, UpdateListener *updateListener, Dimension dim, unsigned int interval, LogWriter *log)
+DummyScreenDriver::DummyScreenDriver(UpdateKeeper *updateKeeper,
+                                     UpdateListener *updateListener,
+                                     LocalMutex *fbLocalMutex,
+                                     SyntheticWorkload::Scenario scenario,
+                                     UINT32 seed,
+                                     LogWriter *log)
   : m_updateListener(updateListener),
   m_updateKeeper(updateKeeper),
-  m_interval(interval)
+  m_fbLocalMutex(fbLocalMutex),
+  m_workload(scenario, seed),
+  m_log(log)
 {
+  Dimension dim(SCREEN_WIDTH, SCREEN_HEIGHT);
   PixelFormat pixelFormat;
   pixelFormat.initBigEndianByNative();
   pixelFormat.bitsPerPixel = 32;
@@ -39,7 +49,9 @@ DummyScreenDriver::DummyScreenDriver(UpdateKeeper *updateKeeper, UpdateListener
   pixelFormat.greenShift = 8;
   pixelFormat.blueShift = 0;
   m_workFrameBuffer.setProperties(&dim, &pixelFormat);
+  m_workload.start(&m_workFrameBuffer);
   m_detectionEnabled = false;
+  m_log->info(_T("Synthetic workload started with the seed %u"), seed);
   resume();
 }
 
@@ -57,30 +69,33 @@ void DummyScreenDriver::onTerminate()
 void DummyScreenDriver::execute()
 {
   while (!isTerminating()) {
-    m_sleeper.waitForEvent(m_interval);
-    if (!isTerminating()) {
-      try {
-        Dimension dim = m_workFrameBuffer.getDimension();
-        int w = dim.width;
-        int h = dim.height;
-        int x = rand() % (w / 50) + (w / 50);
-        int y = rand() % (h / 50) + (h / 50);
-
-        Rect r(x, y);
-        r.move(rand() % w, rand() % h);
-        int m = 0xffffff / RAND_MAX;
-        UINT32 color = rand() * m + rand() % m;
-        Rect tmp(w,h);
-        Region reg(tmp);
-        if (m_detectionEnabled) {
-          m_workFrameBuffer.fillRect(&r, color);
-          m_updateKeeper->addChangedRegion(&reg);
-          m_updateListener->onUpdate();
-        }
-      }
-      catch (...) {
+    m_sleeper.waitForEvent(FRAME_INTERVAL);
+    if (isTerminating() || !m_detectionEnabled) {
+      continue;
+    }
+    Region changedRegion;
+    Rect copyRect;
+    Point copySrc;
+    LARGE_INTEGER captureTime;
+    {
+      AutoLock al(m_fbLocalMutex);
+      m_workload.nextFrame(&m_workFrameBuffer, &changedRegion,
+                           &copyRect, &copySrc);
+    }
+    QueryPerformanceCounter(&captureTime);
+    if (changedRegion.isEmpty() && copyRect.isEmpty()) {
+      continue;
+    }
+    CaptureCounters::getInstance()->onFrameAcquired();
+    {
+      AutoLock al(m_updateKeeper);
+      if (!copyRect.isEmpty()) {
+        m_updateKeeper->addCopyRect(&copyRect, &copySrc);
       }
+      m_updateKeeper->addChangedRegion(&changedRegion);
+      m_updateKeeper->setCaptureTime(captureTime.QuadPart);
     }
+    m_updateListener->onUpdate();
   }
 }
 
@@ -100,6 +115,12 @@ Dimension DummyScreenDriver::getScreenDimension()
   return m_workFrameBuffer.getDimension();
 }
 
+Point DummyScreenDriver::getCursorPosition()
+{
+  AutoLock al(m_fbLocalMutex);
+  return m_workload.getCursorPosition();
+}
+
 bool DummyScreenDriver::grabFb(const Rect *rect)
 {
   return true;
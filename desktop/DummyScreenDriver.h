@@ -28,14 +28,27 @@
 #include "log-writer/LogWriter.h"
 #include "UpdateKeeper.h"
 #include "UpdateListener.h"
+#include "SyntheticWorkload.h"
 #include "thread/Thread.h"
+#include "thread/LocalMutex.h"
 #include "win-system/WindowsEvent.h"
 
-
+// Screen driver showing a synthetic desktop instead of the real one. The
+// frames of the workload scenario are drawn at the refresh rate of a
+// 60 Hz display into the screen buffer under the frame buffer mutex and
+// their changes, moves included, are reported like a real driver does.
 class DummyScreenDriver : public ScreenDriver, Thread
 {
 public:
-  DummyScreenDriver(UpdateKeeper *updateKeeper, UpdateListener *updateListener, Dimension dim, unsigned int interval, LogWriter *log);
+  // Size of the synthetic screen and the time between its frames in ms.
+  static const int SCREEN_WIDTH = 1920;
+  static const int SCREEN_HEIGHT = 1080;
+  static const unsigned int FRAME_INTERVAL = 16;
+
+  DummyScreenDriver(UpdateKeeper *updateKeeper, UpdateListener *updateListener,
+                    LocalMutex *fbLocalMutex,
+                    SyntheticWorkload::Scenario scenario, UINT32 seed,
+                    LogWriter *log);
   virtual ~DummyScreenDriver();
 
   // Starts screen update detection if it not started yet.
@@ -52,7 +65,7 @@ public:
   virtual bool applyNewScreenProperties();
   bool grabCursorShape(const PixelFormat *pf) { return true; };
   const CursorShape *getCursorShape() { return &m_cursorShape; };
-  Point getCursorPosition() { return Point(); };
+  virtual Point getCursorPosition();
 
   void getCopiedRegion(Rect *copyRect, Point *source) { return; };
   Region getVideoRegion() { return Region(); };
@@ -66,9 +79,11 @@ private:
   CursorShape m_cursorShape;
   UpdateKeeper * m_updateKeeper;
   UpdateListener * m_updateListener;
+  LocalMutex *m_fbLocalMutex;
+  SyntheticWorkload m_workload;
   WindowsEvent m_sleeper;
-  unsigned int m_interval;
   bool m_detectionEnabled;
+  LogWriter *m_log;
 
 };
 
@@ -0,0 +1,136 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "FrameExchange.h"
+#include "thread/AutoLock.h"
+
+FrameExchange::Reader::Reader(FrameExchange *exchange)
+: m_exchange(exchange),
+  m_index(exchange->acquire())
+{
+}
+
+FrameExchange::Reader::~Reader()
+{
+  m_exchange->release(m_index);
+}
+
+const FrameBuffer *FrameExchange::Reader::getFrameBuffer() const
+{
+  // The published frame is immutable while it has readers.
+  return &m_exchange->m_frames[m_index].frameBuffer;
+}
+
+UINT32 FrameExchange::Reader::getGeneration() const
+{
+  return m_exchange->m_frames[m_index].generation;
+}
+
+FrameExchange::FrameExchange()
+: m_published(0),
+  m_generation(0)
+{
+}
+
+FrameExchange::~FrameExchange()
+{
+}
+
+void FrameExchange::publish(const FrameBuffer *srcFb, const Region *changedRegion)
+{
+  {
+    AutoLock al(&m_lock);
+    for (int i = 0; i < FRAME_COUNT; i++) {
+      m_frames[i].pendingRegion.add(changedRegion);
+    }
+  }
+
+  int back = -1;
+  Region pendingRegion;
+  while (back < 0) {
+    {
+      AutoLock al(&m_lock);
+      back = findBackFrame();
+      if (back >= 0) {
+        pendingRegion = m_frames[back].pendingRegion;
+        m_frames[back].pendingRegion.clear();
+      }
+    }
+    if (back < 0) {
+      // Every frame is either published or still read by a sender of
+      // an older generation. Readers hold frames only while copying.
+      m_frameReleased.waitForEvent(10);
+    }
+  }
+
+  // The back frame is neither published nor read, so it can be filled
+  // without the lock.
+  Frame *frame = &m_frames[back];
+  if (!frame->frameBuffer.isEqualTo(srcFb)) {
+    frame->frameBuffer.clone(srcFb);
+  } else {
+    std::vector<Rect> rects;
+    std::vector<Rect>::iterator iRect;
+    pendingRegion.getRectVector(&rects);
+    for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
+      frame->frameBuffer.copyFrom(&(*iRect), srcFb, iRect->left, iRect->top);
+    }
+  }
+
+  AutoLock al(&m_lock);
+  frame->generation = ++m_generation;
+  m_published = back;
+}
+
+UINT32 FrameExchange::getGeneration()
+{
+  AutoLock al(&m_lock);
+  return m_generation;
+}
+
+int FrameExchange::acquire()
+{
+  AutoLock al(&m_lock);
+  m_frames[m_published].readers++;
+  return m_published;
+}
+
+void FrameExchange::release(int index)
+{
+  {
+    AutoLock al(&m_lock);
+    m_frames[index].readers--;
+  }
+  m_frameReleased.notify();
+}
+
+int FrameExchange::findBackFrame() const
+{
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    if (i != m_published && m_frames[i].readers == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,107 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __FRAMEEXCHANGE_H__
+#define __FRAMEEXCHANGE_H__
+
+#include "rfb/FrameBuffer.h"
+#include "region/Region.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/inttypes.h"
+
+// FrameExchange hands complete frames from the capture side to the update
+// senders without making the senders wait for grabbing. It keeps three
+// frame buffers: the published one that the readers copy from, the back
+// one that the writer fills and a spare one that may still be read by a
+// slow reader of a previous generation. A published frame is never changed
+// until all its readers have released it.
+//
+// The writer keeps, for every buffer, the region changed since the buffer
+// was filled last time, so a buffer is brought up to date by copying only
+// this region.
+class FrameExchange
+{
+public:
+  static const int FRAME_COUNT = 3;
+
+  // Keeps the currently published frame acquired for the object lifetime.
+  class Reader
+  {
+  public:
+    Reader(FrameExchange *exchange);
+    ~Reader();
+
+    const FrameBuffer *getFrameBuffer() const;
+    // Returns the generation number of the acquired frame.
+    UINT32 getGeneration() const;
+
+  private:
+    FrameExchange *m_exchange;
+    int m_index;
+  };
+
+  FrameExchange();
+  virtual ~FrameExchange();
+
+  // Makes a new frame with content of srcFb published. The changedRegion
+  // must cover all the pixels of srcFb changed since the previous publish()
+  // call. If srcFb properties differ from the back buffer properties the
+  // whole srcFb is copied. The function may wait until a reader releases
+  // one of the frames. Must be invoked from one thread only.
+  void publish(const FrameBuffer *srcFb, const Region *changedRegion);
+
+  // Returns the generation number of the published frame. It is
+  // incremented on each publish() call, zero means nothing has been
+  // published yet.
+  UINT32 getGeneration();
+
+private:
+  int acquire();
+  void release(int index);
+
+  // Returns the index of a frame that is neither published nor read
+  // or -1 if there is no such frame.
+  int findBackFrame() const;
+
+  struct Frame
+  {
+    Frame() : readers(0), generation(0) {}
+
+    FrameBuffer frameBuffer;
+    Region pendingRegion;
+    int readers;
+    UINT32 generation;
+  };
+
+  Frame m_frames[FRAME_COUNT];
+  int m_published;
+  UINT32 m_generation;
+  LocalMutex m_lock;
+
+  // Notified when a reader releases a frame.
+  WindowsEvent m_frameReleased;
+};
+
+#endif // __FRAMEEXCHANGE_H__
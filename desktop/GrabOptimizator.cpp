@@ -23,13 +23,23 @@
 //
 
 #include "GrabOptimizator.h"
+#include "CaptureCounters.h"
 #include "util/Exception.h"
 
+const double GrabOptimizator::SAMPLE_DECAY = 0.95;
+
 GrabOptimizator::GrabOptimizator(LogWriter *log)
-: m_gSum(0),
-  m_wholeTSum(0),
+: m_grabber(0),
   m_wholeS(0),
-  m_timer(1000 * 60 * 30),
+  m_sumNN(0),
+  m_sumNS(0),
+  m_sumSS(0),
+  m_sumNT(0),
+  m_sumST(0),
+  m_samples(0),
+  m_g(0),
+  m_pixelT(0),
+  m_triedFragments(false),
   m_log(log)
 {
 }
@@ -40,239 +50,145 @@ GrabOptimizator::~GrabOptimizator()
 
 bool GrabOptimizator::grab(const Region *grabRegion, ScreenDriver *grabber)
 {
-  // The optimization based on the assumption: Tgrab ~= Sgrab/Vgrab + g*N,
-  // where Tgrab - is grab time,
-  // Sgrab - is grab area,
-  // Vgrab - is a grab velocity,
-  // N - is number of rectangles to grab,
-  // g - overhead time costs adding on each grabbed rectangle.
   std::vector<Rect> rects;
   grabRegion->getRectVector(&rects);
   Rect boundsRect = grabRegion->getBounds();
-  int boundsRectS = boundsRect.area();
-  size_t n = rects.size();
+  size_t requestedCount = rects.size();
 
-  if (n == 0 || boundsRectS == 0) {
+  if (requestedCount == 0 || boundsRect.area() == 0) {
     return true;
   }
 
-  refreshStatistic(grabber);
-
-  if (getOptimizationAvailable(grabber)) {
-    _ASSERT(m_wholeTElements.size() != 0);
-    _ASSERT(m_gElements.size() != 0);
+  checkDriver(grabber);
 
-    // Get estimated time for grab by each rectangle.
-    int fragS = getArea(&rects);
-    double avgWholeT = (double)m_wholeTSum / m_wholeTElements.size();
-    double boundsRectT = avgWholeT *
-                         boundsRectS / m_wholeS; // Estimated time to
-                                                 // grab by one rectangle
-    double grabF = (double)avgWholeT / m_wholeS; // Grab frequency
-    double avgG = m_gSum / m_gElements.size();
-    double estimatedFragTime = fragS * grabF + avgG * n;
-    boundsRectT += avgG;
-
-    if (boundsRectT <= estimatedFragTime) {
-      __int64 realBoundsRectTime = grabOneRect(&boundsRect, grabber);
-      m_log->debug(_T("Bounds rectangle grab has been preferred:")
-                 _T(" bounds rectangle time = %d,")
-                 _T(" estimated fragment time = %d,")
-                 _T(" estimated bounds rect time = %d"),
-                 (int)realBoundsRectTime, (int)estimatedFragTime,
-                 (int)boundsRectT);
-      // TEST:
-      //m_log->debug(_T("Test: fragment grab time = %d"),
-      //           (int)grabFragments(&rects, grabber));
-    } else {
-      __int64 realFragTime = grabFragments(&rects, grabber);
-      m_log->debug(_T("Fragment grab has been preferred:")
-                 _T(" fragment time = %d, estimated fragment time = %d,")
-                 _T(" estimated bounds rect time = %d"),
-                 (int)realFragTime, (int)estimatedFragTime, (int)boundsRectT);
-      // TEST:
-      //m_log->debug(_T("Test: bounds rectangle time = %d"),
-      //           (int)grabOneRect(&boundsRect, grabber));
+  std::vector<Rect> plan;
+  if (isModelReady()) {
+    plan = rects;
+    if (plan.size() <= MAX_MERGED_RECTS) {
+      mergeRects(&plan);
     }
+    double planT = estimateTime(plan.size(), getArea(&plan));
+    double boundsT = estimateTime(1, boundsRect.area());
+    if (boundsT <= planT) {
+      plan.clear();
+      plan.push_back(boundsRect);
+    }
+    m_log->debug(_T("Grab planned: %d rectangles of %d requested,")
+                 _T(" estimated time = %d, bounds rectangle time = %d"),
+                 (int)plan.size(), (int)requestedCount,
+                 (int)planT, (int)boundsT);
   } else {
-    bool itIsEnoughForWholeStats = isEnoughForWholeStats(&boundsRect);
-    bool itIsEnoughForFragmentsStats = isAlikeToFragments(&rects);
-
-    if (itIsEnoughForWholeStats && !isAvailableWholeStats()) {
-      grabOneRect(&boundsRect, grabber);
-
-    } else if (itIsEnoughForFragmentsStats && !isAvailableFragmentStats()) {
-      grabFragments(&rects, grabber);
-
-    } else if (isAlikeToWhole(&rects)) {
-      grabOneRect(&boundsRect, grabber);
-
+    // Collect measurements of both shapes.
+    m_triedFragments = !m_triedFragments;
+    if (m_triedFragments && requestedCount > 1) {
+      plan = rects;
     } else {
-      // Grab as is
-      grabFragments(&rects, grabber);
+      plan.push_back(boundsRect);
     }
   }
+
+  grabRects(&plan, grabber);
+  CaptureCounters::getInstance()->onGrabPlanned(requestedCount, plan.size(),
+                                                (UINT64)getArea(&plan));
   return true;
 }
 
-bool GrabOptimizator::getOptimizationAvailable(ScreenDriver *grabber)
+void GrabOptimizator::checkDriver(ScreenDriver *grabber)
 {
   int sCurrent = grabber->getScreenBuffer()->getDimension().area();
-  if (m_wholeS != sCurrent) {
+  if (m_grabber != grabber || m_wholeS != sCurrent) {
     // Reset all coefficients, and calculate it again.
+    m_grabber = grabber;
     m_wholeS = sCurrent;
-    m_wholeTSum = 0;
-    m_wholeTElements.clear();
-
-    m_gSum = 0;
-    m_gElements.clear();
+    m_sumNN = m_sumNS = m_sumSS = m_sumNT = m_sumST = 0;
+    m_samples = 0;
+    m_g = m_pixelT = 0;
   }
-
-  return isAvailableWholeStats() && isAvailableFragmentStats();
 }
 
-bool GrabOptimizator::isAvailableWholeStats()
+bool GrabOptimizator::isModelReady() const
 {
-  return m_wholeTElements.size() >= MIN_ELEMENTS_SIZE;
+  return m_samples >= MIN_SAMPLES && m_pixelT > 0;
 }
 
-bool GrabOptimizator::isAvailableFragmentStats()
+double GrabOptimizator::estimateTime(size_t n, double area) const
 {
-  return m_gElements.size() >= MIN_ELEMENTS_SIZE;
+  return m_g * n + m_pixelT * area;
 }
 
-bool GrabOptimizator::getWholeTCompleted()
+void GrabOptimizator::mergeRects(std::vector<Rect> *rects) const
 {
-  return m_wholeTElements.size() >= MAX_ELEMENTS_SIZE;
-}
-
-bool GrabOptimizator::getGCompleted()
-{
-  return m_gElements.size() >= MAX_ELEMENTS_SIZE;
-}
-
-void GrabOptimizator::refreshStatistic(ScreenDriver *grabber)
-{
-  if (m_timer.isElapsed() && getOptimizationAvailable(grabber)) {
-    m_log->debug(_T("The log statistics before refreshing:"));
-    logStatistic();
-
-    removeFirstWholeTElement();
-    removeFirstElementsFromFragmentStats();
-
-    m_timer.reset();
-    m_log->debug(_T("The log statistics after refreshing:"));
-    logStatistic();
-  }
-}
-
-int GrabOptimizator::getArea(const std::vector<Rect> *rects)
-{
-  int result = 0;
-  for (size_t i = 0; i < rects->size(); i++) {
-    result += (*rects)[i].area();
-  }
-  return result;
-}
-
-bool GrabOptimizator::isAlikeToWhole(const std::vector<Rect> *rects)
-{
-  int area = getArea(rects);
-  if (area < 1) {
-    return false;
-  }
-  return m_wholeS / area <= 9; // area >= 10%
-}
-
-bool GrabOptimizator::isEnoughForWholeStats(const Rect *rect)
-{
-  int area = rect->area();
-  if (area < 1) {
-    return false;
-  }
-  return m_wholeS / rect->area() <= 9; // area >= 10%
-}
-
-bool GrabOptimizator::isAlikeToFragments(const std::vector<Rect> *rects)
-{
-  return rects->size() >= 10;
-}
-
-__int64 GrabOptimizator::grabWhole(ScreenDriver *grabber)
-{
-  // FIXME: WARNING!!! The microsoft API usage!!!
-  LARGE_INTEGER timeBegin, timeEnd;
-  bool timerResult1 = QueryPerformanceCounter(&timeBegin) != 0;
-
-  if (!grabber->grabFb()) {
-    throw Exception(_T("Grabber failed. Is it not ready?"));
-  }
-
-  bool timerResult2 = QueryPerformanceCounter(&timeEnd) != 0;
-
-  if (timerResult1 && timerResult2) {
-    return timeEnd.QuadPart - timeBegin.QuadPart;
-  } else {
-    return -1;
+  // Greedily merge the pair with the largest estimated saving: one grab
+  // call less against the pixels of the bounds not covered by the pair.
+  // The rectangles of a region do not overlap, so the areas just add up.
+  // Cutting the overlapped rectangles may add pieces, so the number of
+  // merges is limited by the original number of rectangles.
+  for (size_t merges = rects->size(); merges > 0 && rects->size() > 1; merges--) {
+    double bestSaving = 0;
+    size_t bestI = 0, bestJ = 0;
+    for (size_t i = 0; i < rects->size(); i++) {
+      for (size_t j = i + 1; j < rects->size(); j++) {
+        Rect merged = (*rects)[i].unionRect(&(*rects)[j]);
+        double addedArea = (double)merged.area() - (*rects)[i].area() -
+                           (*rects)[j].area();
+        double saving = m_g - m_pixelT * addedArea;
+        if (saving > bestSaving) {
+          bestSaving = saving;
+          bestI = i;
+          bestJ = j;
+        }
+      }
+    }
+    if (bestSaving <= 0) {
+      break;
+    }
+    Rect merged = (*rects)[bestI].unionRect(&(*rects)[bestJ]);
+    rects->erase(rects->begin() + bestJ);
+    (*rects)[bestI] = merged;
+    // Drop the rectangles the merged one covers now and cut the ones it
+    // overlaps, so that the planned rectangles stay disjoint.
+    Region rest;
+    for (size_t k = 0; k < rects->size(); k++) {
+      if (k != bestI) {
+        rest.addRect(&(*rects)[k]);
+      }
+    }
+    Region mergedRegion(merged);
+    rest.subtract(&mergedRegion);
+    rest.getRectVector(rects);
+    rects->push_back(merged);
   }
 }
 
-__int64 GrabOptimizator::grabOneRect(const Rect *rect,
-                                     ScreenDriver *grabber)
+void GrabOptimizator::addSample(size_t n, double area, double t)
 {
-  int rectS = rect->area();
-  _ASSERT(rectS != 0);
-  // FIXME: WARNING!!! The microsoft API usage!!!
-  LARGE_INTEGER timeBegin, timeEnd;
-  bool timerResult1 = QueryPerformanceCounter(&timeBegin) != 0;
+  m_sumNN = m_sumNN * SAMPLE_DECAY + (double)n * n;
+  m_sumNS = m_sumNS * SAMPLE_DECAY + n * area;
+  m_sumSS = m_sumSS * SAMPLE_DECAY + area * area;
+  m_sumNT = m_sumNT * SAMPLE_DECAY + n * t;
+  m_sumST = m_sumST * SAMPLE_DECAY + area * t;
+  m_samples++;
 
-  if (!grabber->grabFb(rect)) {
-    throw Exception(_T("Grabber failed. Is it not ready?"));
+  double det = m_sumNN * m_sumSS - m_sumNS * m_sumNS;
+  if (det <= m_sumNN * m_sumSS * 1e-9) {
+    // All the measurements have the same shape, the fit is not defined.
+    return;
   }
-
-  bool timerResult2 = QueryPerformanceCounter(&timeEnd) != 0;
-
-  if (timerResult1 && timerResult2) {
-    __int64 realOneRectTime = timeEnd.QuadPart - timeBegin.QuadPart;
-    if (isEnoughForWholeStats(rect)) {
-      // Scale the time as the whole grabbing.
-      double wholeT = (double)realOneRectTime * m_wholeS / rectS;
-      addWholeTElement(wholeT);
-      logStatistic();
-    }
-    return realOneRectTime;
-  } else {
-    return -1;
+  double g = (m_sumNT * m_sumSS - m_sumST * m_sumNS) / det;
+  double pixelT = (m_sumST * m_sumNN - m_sumNT * m_sumNS) / det;
+  // Measurement noise may give a negative overhead, which is meaningless.
+  if (g < 0) {
+    g = 0;
+    pixelT = m_sumST / m_sumSS;
   }
-}
-
-void GrabOptimizator::addWholeTElement(double wholeT)
-{
-  m_wholeTElements.push_back(wholeT);
-  m_wholeTSum += wholeT;
-  m_timer.reset();
-
-  removeObsoleteWholeTElements();
-}
-
-void GrabOptimizator::removeObsoleteWholeTElements()
-{
-  while (m_wholeTElements.size() > MAX_ELEMENTS_SIZE) {
-    removeFirstWholeTElement();
-    m_timer.reset();
+  if (pixelT > 0) {
+    m_g = g;
+    m_pixelT = pixelT;
   }
 }
 
-void GrabOptimizator::removeFirstWholeTElement()
-{
-  std::list<double>::iterator iter = m_wholeTElements.begin();
-  double wholeT = *iter;
-  m_wholeTSum -= wholeT;
-  m_wholeTElements.erase(iter);
-}
-
-__int64 GrabOptimizator::grabFragments(const std::vector<Rect> *rects,
-                                       ScreenDriver *grabber)
+__int64 GrabOptimizator::grabRects(const std::vector<Rect> *rects,
+                                   ScreenDriver *grabber)
 {
   // FIXME: WARNING!!! The microsoft API usage!!!
   LARGE_INTEGER timeBegin, timeEnd;
@@ -288,87 +204,27 @@ __int64 GrabOptimizator::grabFragments(const std::vector<Rect> *rects,
   bool timerResult2 = QueryPerformanceCounter(&timeEnd) != 0;
 
   if (timerResult1 && timerResult2) {
-    __int64 fragT = timeEnd.QuadPart - timeBegin.QuadPart;
-
-    // To update the statistic wholeT must be calculated at least once.
-    if (isAlikeToFragments(rects) &&
-        m_wholeTElements.size() > 0) {
-      int s = getArea(rects);
-      size_t n = rects->size();
-      double g = (fragT -
-                  (double)m_wholeTSum / m_wholeTElements.size()
-                  * s / m_wholeS) / n;
-      addFragmentStats(g);
-
-      logStatistic();
-    }
-
-    return fragT;
+    __int64 grabT = timeEnd.QuadPart - timeBegin.QuadPart;
+    addSample(rects->size(), getArea(rects), (double)grabT);
+    logStatistic();
+    return grabT;
   } else {
     return -1;
   }
 }
 
-void GrabOptimizator::addFragmentStats(double g)
-{
-  m_gElements.push_back(g);
-  m_gSum += g;
-  m_timer.reset();
-
-  removeObsoleteFragmentStats();
-}
-
-void GrabOptimizator::removeObsoleteFragmentStats()
+double GrabOptimizator::getArea(const std::vector<Rect> *rects)
 {
-  while (m_gElements.size() > MAX_ELEMENTS_SIZE) {
-    removeFirstElementsFromFragmentStats();
-    m_timer.reset();
+  double result = 0;
+  for (size_t i = 0; i < rects->size(); i++) {
+    result += (*rects)[i].area();
   }
-}
-
-void GrabOptimizator::removeFirstElementsFromFragmentStats()
-{
-  std::list<double>::iterator iterG = m_gElements.begin();
-  double g = *iterG;
-  m_gSum -= g;
-  m_gElements.erase(iterG);
+  return result;
 }
 
 void GrabOptimizator::logStatistic()
 {
-  m_log->debug(_T("GrabOptimizator::m_wholeS : %d"),
-             m_wholeS);
-
-  StringStorage value;
-  StringStorage statString;
-  for (std::list<double>::iterator iter = m_wholeTElements.begin();
-       iter != m_wholeTElements.end();
-       iter++) {
-    value.format(_T(" %.2f;"), *iter);
-    statString.appendString(value.getString());
-  }
-  double avgWholeT = m_wholeTElements.size() != 0 ?
-                     m_wholeTSum / m_wholeTElements.size() : 0;
-  m_log->debug(_T("GrabOptimizator::m_wholeT average: %.2f;")
-             _T(" GrabOptimizator::m_wholeTSum: %.2f;")
-             _T(" GrabOptimizator::m_wholeTElements: %s"),
-             avgWholeT,
-             m_wholeTSum,
-             statString.getString());
-
-  statString.setString(_T(""));
-  for (std::list<double>::iterator iter = m_gElements.begin();
-       iter != m_gElements.end();
-       iter++) {
-    value.format(_T(" %.2f;"), *iter);
-    statString.appendString(value.getString());
-  }
-  double avgG = m_gElements.size() != 0 ?
-                m_gSum / m_gElements.size() : 0;
-  m_log->debug(_T("GrabOptimizator::m_g average: %.2f;")
-             _T(" GrabOptimizator::m_gSum: %.2f;")
-             _T(" GrabOptimizator::m_gElements: %s;"),
-             avgG,
-             m_gSum,
-             statString.getString());
+  m_log->debug(_T("GrabOptimizator: %d samples, call overhead = %.2f,")
+               _T(" whole screen time = %.2f"),
+               m_samples, m_g, m_pixelT * m_wholeS);
 }
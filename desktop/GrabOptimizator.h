@@ -27,13 +27,26 @@
 
 #include "ScreenDriver.h"
 #include "region/Region.h"
-#include "util/DemandTimer.h"
 #include "log-writer/LogWriter.h"
 #include <vector>
-#include <list>
 
 // This class provides the screen grabbing by an optimal way.
-// The class determines an optimal way by oneself dynamically.
+//
+// The grab time of a screen driver is modelled as Tgrab = g*N + Sgrab/Vgrab,
+// where N is the number of rectangles grabbed, g is the overhead time of one
+// grab call, Sgrab is the grabbed area and Vgrab is the grab velocity. The
+// coefficients are fitted by least squares to the measured grabs, with
+// older measurements fading out so that the model follows the load of the
+// machine.
+//
+// Once the model is known, the grab is planned: nearby rectangles are
+// merged while the pixels added by merging cost less than the grab calls
+// saved, and the plan is compared with grabbing the bounds of the whole
+// region. Until then, both ways are tried in turn to collect measurements
+// of different shapes.
+//
+// The model belongs to one screen driver; it is restarted if the driver or
+// its screen size changes.
 class GrabOptimizator
 {
 public:
@@ -43,57 +56,58 @@ public:
   bool grab(const Region *grabRegion, ScreenDriver *grabber);
 
 private:
-  // Returns true when the m_wholeTElements is comletly calculated.
-  bool getWholeTCompleted();
+  // Restarts the model if the driver or its screen size has changed.
+  void checkDriver(ScreenDriver *grabber);
 
-  // Returns true when the m_gElements is comletly calculated.
-  bool getGCompleted();
+  // Returns true if the model coefficients can be used for planning.
+  bool isModelReady() const;
 
-  // Returns true if all needed coefficients is calculated to use
-  // the grab optimization.
-  bool getOptimizationAvailable(ScreenDriver *grabber);
-  bool isAvailableWholeStats();
-  bool isAvailableFragmentStats();
+  // Returns the estimated time of grabbing rectangles of the total area by
+  // the given number of calls.
+  double estimateTime(size_t n, double area) const;
 
-  // Removes a part of the statistic to made it available to a refresh.
-  void refreshStatistic(ScreenDriver *grabber);
+  // Merges the rectangles while merging is estimated to be cheaper.
+  void mergeRects(std::vector<Rect> *rects) const;
 
-  // Returns absolute sum area of rectangle vector.
-  int getArea(const std::vector<Rect> *rects);
+  // Adds a measurement of grabbing n rectangles of the total area in time t
+  // to the model.
+  void addSample(size_t n, double area, double t);
+
+  // Grabs the rectangles and adds the measurement to the model.
+  __int64 grabRects(const std::vector<Rect> *rects, ScreenDriver *grabber);
 
-  // If the grab region is alike to whole desktop the function return true.
-  bool isAlikeToWhole(const std::vector<Rect> *rects);
-  bool isEnoughForWholeStats(const Rect *rect);
-  // If the grab region is alike to separate fragments the function
-  // return true.
-  bool isAlikeToFragments(const std::vector<Rect> *rects);
+  // Returns absolute sum area of rectangle vector.
+  static double getArea(const std::vector<Rect> *rects);
 
   // This functions store to the log all statistic data.
   void logStatistic();
 
-  static const size_t MIN_ELEMENTS_SIZE = 3;
-  static const size_t MAX_ELEMENTS_SIZE = 10;
-
-  __int64 grabWhole(ScreenDriver *grabber);
-  __int64 grabOneRect(const Rect *rect, ScreenDriver *grabber);
-  __int64 grabFragments(const std::vector<Rect> *rects, ScreenDriver *grabber);
-
-  void addWholeTElement(double wholeT);
-  void removeObsoleteWholeTElements();
-  void removeFirstWholeTElement();
-
-  void addFragmentStats(double g);
-  void removeObsoleteFragmentStats();
-  void removeFirstElementsFromFragmentStats();
+  // The weight the previous measurements keep on adding a new one.
+  static const double SAMPLE_DECAY;
+  // Number of measurements needed before the model is used.
+  static const int MIN_SAMPLES = 6;
+  // Regions of more rectangles are not merged, only the bounds and the
+  // fragments are compared, as the merging takes quadratic time.
+  static const size_t MAX_MERGED_RECTS = 64;
 
+  ScreenDriver *m_grabber;
   int m_wholeS;
-  std::list<double> m_wholeTElements;
-  double m_wholeTSum;
-
-  std::list<double> m_gElements;
-  double m_gSum;
 
-  DemandTimer m_timer;
+  // Weighted sums of the least squares fit of t = g*n + s/v.
+  double m_sumNN;
+  double m_sumNS;
+  double m_sumSS;
+  double m_sumNT;
+  double m_sumST;
+  int m_samples;
+
+  // Fitted overhead time of a grab call and time of grabbing a pixel, in
+  // performance counter ticks.
+  double m_g;
+  double m_pixelT;
+
+  // Way tried last while the model is not ready.
+  bool m_triedFragments;
 
   LogWriter *m_log;
 };
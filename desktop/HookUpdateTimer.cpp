@@ -24,34 +24,28 @@
 
 #include "HookUpdateTimer.h"
 
-HookUpdateTimer::HookUpdateTimer(UpdateListener *updateListener)
-: m_updateListener(updateListener)
-{
-  resume();
-}
+// Delay from a hook message to the update notification, the messages
+// coming in the meantime are gathered into the same update.
+const unsigned int UPDATE_DELAY = 100;
 
-HookUpdateTimer::~HookUpdateTimer()
+HookUpdateTimer::HookUpdateTimer(UpdateListener *updateListener,
+                                 TaskScheduler *scheduler)
+: m_scheduler(scheduler),
+  m_updateListener(updateListener)
 {
-  terminate();
-  wait();
 }
 
-void HookUpdateTimer::onTerminate()
+HookUpdateTimer::~HookUpdateTimer()
 {
-  m_updateWaiter.notify();
-  m_timer.notify();
+  m_scheduler->cancel(this);
 }
 
-void HookUpdateTimer::execute()
+void HookUpdateTimer::run()
 {
-  while (!isTerminating()) {
-    m_updateWaiter.waitForEvent();
-    m_timer.waitForEvent(100);
-    m_updateListener->onUpdate();
-  }
+  m_updateListener->onUpdate();
 }
 
 void HookUpdateTimer::sear()
 {
-  m_updateWaiter.notify();
+  m_scheduler->postDelayed(this, UPDATE_DELAY);
 }
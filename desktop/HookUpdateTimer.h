@@ -25,20 +25,20 @@
 #ifndef __HOOKUPDATETIMER_H__
 #define __HOOKUPDATETIMER_H__
 
-#include "thread/Thread.h"
+#include "thread/TaskScheduler.h"
 #include "UpdateListener.h"
-#include "win-system/WindowsEvent.h"
 
 // This class is a timer that after calling the sear() function
 // wait a time interval after that it notifies to an update listener
 // for update/updates catching. It's should to help the HooksupdateDetector
 // to wait an time interval because the HooksupdateDetector can't wait
 // directly by sleep. Usage of this class is questionable.
-class HookUpdateTimer : public Thread
+class HookUpdateTimer : public Task
 {
 public:
   // @param updateListener - pointer to an UpdateListener object
-  HookUpdateTimer(UpdateListener *updateListener);
+  // @param scheduler - scheduler running the timer
+  HookUpdateTimer(UpdateListener *updateListener, TaskScheduler *scheduler);
   virtual ~HookUpdateTimer();
 
   // This function start a timer after that will calling onUpdate()
@@ -46,11 +46,9 @@ public:
   void sear();
 
 protected:
-  virtual void execute();
-  virtual void onTerminate();
+  virtual void run();
 
-  WindowsEvent m_updateWaiter;
-  WindowsEvent m_timer;
+  TaskScheduler *m_scheduler;
   UpdateListener *m_updateListener;
 };
 
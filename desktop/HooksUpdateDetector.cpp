@@ -26,15 +26,21 @@
 #include "tvnserver-app/NamingDefs.h"
 #include "HooksUpdateDetector.h"
 #include "region/Rect.h"
+#include "region/Region.h"
+#include <vector>
 #include "win-system/UipiControl.h"
 #include "win-system/Environment.h"
 
 HooksUpdateDetector::HooksUpdateDetector(UpdateKeeper *updateKeeper,
-                                         UpdateListener *updateListener, LogWriter *log)
+                                         UpdateListener *updateListener,
+                                         TaskScheduler *scheduler,
+                                         LogWriter *log)
 : UpdateDetector(updateKeeper, updateListener),
-  m_updateTimer(updateListener),
+  m_updateTimer(updateListener, scheduler),
   m_targetWin(0),
   m_hookInstaller(0),
+  m_rectRingMemory(0),
+  m_rectRing(0),
   m_log(log)
 {
 #ifndef _WIN64
@@ -64,6 +70,9 @@ HooksUpdateDetector::~HooksUpdateDetector()
   if (m_targetWin != 0) {
     delete m_targetWin;
   }
+  if (m_rectRingMemory != 0) {
+    delete m_rectRingMemory;
+  }
 }
 
 void HooksUpdateDetector::onTerminate()
@@ -104,6 +113,51 @@ void HooksUpdateDetector::terminate32Loader()
   }
 }
 
+void HooksUpdateDetector::createRectRing()
+{
+  StringStorage name;
+  name.format(HookDefinitions::HOOK_RECT_RING_NAME_FORMAT,
+              (unsigned int)(size_t)m_targetWin->getHWND());
+  try {
+    m_rectRingMemory = new SharedMemory(name.getString(), sizeof(HookRectRing));
+    m_rectRing = (HookRectRing *)m_rectRingMemory->getMemPointer();
+    m_rectRing->init();
+    m_log->debug(_T("Screenhook rectangle ring %s has been created"),
+                 name.getString());
+  } catch (Exception &e) {
+    m_log->error(_T("Can't create the screenhook rectangle ring: %s"),
+                 e.getMessage());
+  }
+}
+
+void HooksUpdateDetector::drainRectRing()
+{
+  if (m_rectRing == 0) {
+    return;
+  }
+  // Allow writers to post the next wake-up before reading anything, so a
+  // rectangle published after the loop below ends is never left unnoticed.
+  m_rectRing->clearWakeUp();
+
+  std::vector<Rect> rects;
+  INT16 left, top, right, bottom;
+  do {
+    while (m_rectRing->pop(&left, &top, &right, &bottom)) {
+      Rect rect(left, top, right, bottom);
+      if (!rect.isEmpty() && rect.isValid()) {
+        rects.push_back(rect);
+      }
+    }
+  } while (m_rectRing->skipAbandonedSlot());
+
+  if (!rects.empty()) {
+    Region changedRegion;
+    changedRegion.addRects(&rects);
+    m_updateKeeper->addChangedRegion(&changedRegion);
+    m_updateTimer.sear();
+  }
+}
+
 void HooksUpdateDetector::broadcastMessage(UINT message)
 {
   HWND hwndFound = FindWindowEx(HWND_MESSAGE, 0, 0, 0);
@@ -123,10 +177,16 @@ void HooksUpdateDetector::execute()
               m_targetWin->getHWND());
   }
 
+  if (!isTerminating() && m_targetWin != 0) {
+    createRectRing();
+  }
+
   try {
     UipiControl uipiControl(m_log);
     uipiControl.allowMessage(HookDefinitions::SPEC_IPC_CODE,
                              m_targetWin->getHWND());
+    uipiControl.allowMessage(HookDefinitions::BATCH_IPC_CODE,
+                             m_targetWin->getHWND());
   } catch (Exception &e) {
     terminate();
     m_log->error(e.getMessage());
@@ -159,7 +219,9 @@ void HooksUpdateDetector::execute()
   MSG msg;
   while (!isTerminating()) {
     if (PeekMessage(&msg, m_targetWin->getHWND(), 0, 0, PM_REMOVE) != 0) {
-      if (msg.message == HookDefinitions::SPEC_IPC_CODE) {
+      if (msg.message == HookDefinitions::BATCH_IPC_CODE) {
+        drainRectRing();
+      } else if (msg.message == HookDefinitions::SPEC_IPC_CODE) {
         Rect rect((INT16)(msg.wParam >> 16), (INT16)(msg.wParam & 0xffff),
                   (INT16)(msg.lParam >> 16), (INT16)(msg.lParam & 0xffff));
         if (!rect.isEmpty() && rect.isValid()) {
@@ -31,13 +31,16 @@
 #include "gui/MessageWindow.h"
 #include "HookUpdateTimer.h"
 #include "win-system/Process.h"
+#include "win-system/SharedMemory.h"
+#include "screen-hooks/HookRectRing.h"
 #include "log-writer/LogWriter.h"
 
 class HooksUpdateDetector : public UpdateDetector
 {
 public:
   HooksUpdateDetector(UpdateKeeper *updateKeeper,
-                      UpdateListener *updateListener, LogWriter *log);
+                      UpdateListener *updateListener,
+                      TaskScheduler *scheduler, LogWriter *log);
   virtual ~HooksUpdateDetector();
 
 protected:
@@ -47,6 +50,12 @@ protected:
   void start32Loader();
   void terminate32Loader();
 
+  // Creates the shared rectangle ring for the target window. On failure the
+  // hook library falls back to a message per rectangle.
+  void createRectRing();
+  // Moves all the published rectangles from the ring to the update keeper.
+  void drainRectRing();
+
   WindowsEvent m_initWaiter;
 
   HookInstaller *m_hookInstaller;
@@ -54,6 +63,9 @@ protected:
   HookUpdateTimer m_updateTimer;
   Process m_hookLoader32;
 
+  SharedMemory *m_rectRingMemory;
+  HookRectRing *m_rectRing;
+
 private:
   void broadcastMessage(UINT message);
 
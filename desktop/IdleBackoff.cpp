@@ -0,0 +1,105 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "IdleBackoff.h"
+#include "thread/AutoLock.h"
+
+#include <algorithm>
+
+IdleBackoff::IdleBackoff(UpdateListener *updateListener,
+                         TaskScheduler *scheduler)
+: m_updateListener(updateListener),
+  m_scheduler(scheduler),
+  m_lastActivityTime(GetTickCount()),
+  m_isIdle(false)
+{
+}
+
+IdleBackoff::~IdleBackoff()
+{
+}
+
+void IdleBackoff::addDetector(Task *detector)
+{
+  AutoLock al(&m_lock);
+  if (std::find(m_detectors.begin(), m_detectors.end(), detector) ==
+      m_detectors.end()) {
+    m_detectors.push_back(detector);
+  }
+}
+
+void IdleBackoff::removeDetector(Task *detector)
+{
+  AutoLock al(&m_lock);
+  std::vector<Task *>::iterator iter = std::find(m_detectors.begin(),
+                                                 m_detectors.end(),
+                                                 detector);
+  if (iter != m_detectors.end()) {
+    m_detectors.erase(iter);
+  }
+}
+
+unsigned int IdleBackoff::scaleDelay(unsigned int delayMillis)
+{
+  AutoLock al(&m_lock);
+  DWORD idleTime = GetTickCount() - m_lastActivityTime;
+  if (idleTime < IDLE_TIME) {
+    return delayMillis;
+  }
+  unsigned int factor = 2;
+  for (DWORD t = 2 * IDLE_TIME; t <= idleTime && factor < MAX_FACTOR;
+       t += IDLE_TIME) {
+    factor *= 2;
+  }
+  UINT64 scaledDelay = (UINT64)delayMillis * factor;
+  if (scaledDelay > MAX_IDLE_DELAY) {
+    scaledDelay = MAX_IDLE_DELAY;
+  }
+  if (scaledDelay <= delayMillis) {
+    return delayMillis;
+  }
+  m_isIdle = true;
+  return (unsigned int)scaledDelay;
+}
+
+void IdleBackoff::onActivity()
+{
+  AutoLock al(&m_lock);
+  m_lastActivityTime = GetTickCount();
+  if (m_isIdle) {
+    m_isIdle = false;
+    // The long idle delays are cut short by checking at once. The detectors
+    // are posted under the lock, so that none is posted after its removal.
+    for (std::vector<Task *>::iterator iter = m_detectors.begin();
+         iter != m_detectors.end(); iter++) {
+      m_scheduler->post(*iter);
+    }
+  }
+}
+
+void IdleBackoff::onUpdate()
+{
+  onActivity();
+  m_updateListener->onUpdate();
+}
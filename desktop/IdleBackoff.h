@@ -0,0 +1,80 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __IDLEBACKOFF_H__
+#define __IDLEBACKOFF_H__
+
+#include "UpdateListener.h"
+#include "thread/TaskScheduler.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
+
+// IdleBackoff coordinates the periodic detectors sharing a scheduler while
+// the desktop is static. It is put between the detectors and the real
+// update listener, so that it sees every found change. Once nothing has
+// changed for IDLE_TIME milliseconds, the delays of the detectors are
+// doubled every IDLE_TIME milliseconds, up to MAX_FACTOR times and not
+// longer than MAX_IDLE_DELAY. The first change found by any detector or
+// hook ends the idle mode and makes all the backed off detectors check at
+// once, so only the first change after a long idle period can be noticed
+// late.
+class IdleBackoff : public UpdateListener
+{
+public:
+  // Updates are passed to updateListener, the detectors are woken up by
+  // scheduler.
+  IdleBackoff(UpdateListener *updateListener, TaskScheduler *scheduler);
+  virtual ~IdleBackoff();
+
+  // Detectors must be added before they are posted to the scheduler for the
+  // first time and removed before they are canceled.
+  void addDetector(Task *detector);
+  void removeDetector(Task *detector);
+
+  // Returns the delay to the next check of a detector which would wait
+  // delayMillis milliseconds on a busy desktop.
+  unsigned int scaleDelay(unsigned int delayMillis);
+
+  // Should be called on a change found without an update notification.
+  void onActivity();
+
+  virtual void onUpdate();
+
+  static const unsigned int IDLE_TIME = 5000;
+  static const unsigned int MAX_FACTOR = 16;
+  static const unsigned int MAX_IDLE_DELAY = 4000;
+
+private:
+  UpdateListener *m_updateListener;
+  TaskScheduler *m_scheduler;
+
+  LocalMutex m_lock;
+  std::vector<Task *> m_detectors;
+  DWORD m_lastActivityTime;
+  // Set once a delay has been scaled up, until the next change.
+  bool m_isIdle;
+};
+
+#endif // __IDLEBACKOFF_H__
@@ -425,21 +425,21 @@ void MirrorDriverClient::execute()
 
   m_initListener.notify();
 
+  // GetMessage() sleeps until a message arrives, WM_QUIT posted by
+  // onTerminate() ends the loop.
   MSG msg;
   while (!isTerminating()) {
-    if (PeekMessage(&msg, m_propertyChangeListenerWindow.getHWND(),
-                    0, 0, PM_REMOVE) != 0) {
-      if (msg.message == WM_DISPLAYCHANGE) {
-        m_isDisplayChanged = true;
-      } else {
-        DispatchMessage(&msg);
-      }
+    BOOL result = GetMessage(&msg, 0, 0, 0);
+    if (result == 0) {
+      break;
+    }
+    if (result == -1) {
+      m_log->error(_T("Mirror driver client thread has failed"));
+      terminate();
+    } else if (msg.message == WM_DISPLAYCHANGE) {
+      m_isDisplayChanged = true;
     } else {
-      if (WaitMessage() == 0) {
-        m_log->error(_T("Mirror driver client thread has failed"));
-        terminate();
-      }
+      DispatchMessage(&msg);
     }
-    Thread::yield();
   }
 }
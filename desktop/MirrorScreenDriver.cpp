@@ -24,6 +24,7 @@
 
 #include "MirrorScreenDriver.h"
 #include "util/Exception.h"
+#include "CaptureCounters.h"
 
 MirrorScreenDriver::MirrorScreenDriver(UpdateKeeper *updateKeeper,
                                        UpdateListener *updateListener,
@@ -33,6 +34,8 @@ MirrorScreenDriver::MirrorScreenDriver(UpdateKeeper *updateKeeper,
                  updateListener),
   m_fbMutex(fbLocalMutex),
   m_lastCounter(0),
+  m_tileColumns(0),
+  m_tileRows(0),
   m_log(log)
 {
   m_mirrorClient = new MirrorDriverClient(m_log);
@@ -156,39 +159,106 @@ void MirrorScreenDriver::startUpdateSearching()
 void MirrorScreenDriver::execute()
 {
   Region changedRegion;
-  Rect changedRect;
-  unsigned long currentCounter = 0;
 
   while (!isTerminating()) {
-    m_updateTimeout.waitForEvent(20);
+    m_updateTimeout.waitForEvent(CHECK_INTERVAL);
 
     {
       AutoLock al(m_fbMutex);
-      if (m_mirrorClient != 0) {
-        CHANGES_BUF *changesBuf = m_mirrorClient->getChangesBuf();
-        if (changesBuf != 0) {
-          currentCounter = changesBuf->counter;
-          for (unsigned long i = m_lastCounter; i != currentCounter;
-               i++, i%= MAXCHANGES_BUF) {
-            changedRect.fromWindowsRect(&changesBuf->pointrect[i].rect);
-            if (changedRect.isValid()) {
-              changedRegion.addRect(&changedRect);
-            }
-          }
-
-          m_updateKeeper->addChangedRegion(&changedRegion);
-          m_lastCounter = currentCounter;
-        }
-      }
+      readChanges(&changedRegion);
     }
 
     if (!changedRegion.isEmpty()) {
+      m_updateKeeper->addChangedRegion(&changedRegion);
       doUpdate();
       changedRegion.clear();
     }
   }
 }
 
+void MirrorScreenDriver::readChanges(Region *changedRegion)
+{
+  if (m_mirrorClient == 0) {
+    return;
+  }
+  CHANGES_BUF *changesBuf = m_mirrorClient->getChangesBuf();
+  if (changesBuf == 0) {
+    return;
+  }
+  unsigned long currentCounter = changesBuf->counter;
+  if (currentCounter == m_lastCounter) {
+    return;
+  }
+  CaptureCounters::getInstance()->onFrameAcquired();
+
+  Dimension dim = m_frameBuffer.getDimension();
+  int columns = (dim.width + COALESCE_TILE_SIZE - 1) / COALESCE_TILE_SIZE;
+  int rows = (dim.height + COALESCE_TILE_SIZE - 1) / COALESCE_TILE_SIZE;
+  if (columns != m_tileColumns || rows != m_tileRows) {
+    m_tileColumns = columns;
+    m_tileRows = rows;
+    m_changedTiles.assign(columns * rows, 0);
+  }
+
+  // A busy desktop records thousands of small changes between two checks,
+  // marking tiles makes the region building independent of their number.
+  Rect fbRect = dim.getRect();
+  Rect changedRect;
+  bool anyChanged = false;
+  for (unsigned long i = m_lastCounter; i != currentCounter;
+       i++, i %= MAXCHANGES_BUF) {
+    changedRect.fromWindowsRect(&changesBuf->pointrect[i].rect);
+    if (changedRect.isValid()) {
+      Rect clipped = changedRect.intersection(&fbRect);
+      if (!clipped.isEmpty()) {
+        markTiles(&clipped);
+        anyChanged = true;
+      }
+    }
+  }
+  m_lastCounter = currentCounter;
+  if (!anyChanged) {
+    return;
+  }
+
+  // Join runs of changed tiles of each tile row into rectangles.
+  m_changedRects.clear();
+  for (int iRow = 0; iRow < m_tileRows; iRow++) {
+    char *row = &m_changedTiles[iRow * m_tileColumns];
+    int iCol = 0;
+    while (iCol < m_tileColumns) {
+      if (row[iCol] == 0) {
+        iCol++;
+        continue;
+      }
+      int first = iCol;
+      while (iCol < m_tileColumns && row[iCol] != 0) {
+        row[iCol] = 0;
+        iCol++;
+      }
+      int right = iCol * COALESCE_TILE_SIZE;
+      int bottom = (iRow + 1) * COALESCE_TILE_SIZE;
+      m_changedRects.push_back(Rect(first * COALESCE_TILE_SIZE,
+                                    iRow * COALESCE_TILE_SIZE,
+                                    right < dim.width ? right : dim.width,
+                                    bottom < dim.height ? bottom : dim.height));
+    }
+  }
+  changedRegion->addRects(&m_changedRects);
+}
+
+void MirrorScreenDriver::markTiles(const Rect *rect)
+{
+  int firstColumn = rect->left / COALESCE_TILE_SIZE;
+  int lastColumn = (rect->right - 1) / COALESCE_TILE_SIZE;
+  int firstRow = rect->top / COALESCE_TILE_SIZE;
+  int lastRow = (rect->bottom - 1) / COALESCE_TILE_SIZE;
+  for (int iRow = firstRow; iRow <= lastRow; iRow++) {
+    memset(&m_changedTiles[iRow * m_tileColumns + firstColumn], 1,
+           lastColumn - firstColumn + 1);
+  }
+}
+
 void MirrorScreenDriver::onTerminate()
 {
   m_updateTimeout.notify();
@@ -32,6 +32,8 @@
 #include "win-system/WindowsEvent.h"
 #include "UpdateDetector.h"
 
+#include <vector>
+
 class MirrorScreenDriver : public UpdateDetector
 {
 public:
@@ -64,8 +66,27 @@ private:
   virtual void execute();
   virtual void onTerminate();
 
+  // Drains the driver change ring since the last call and adds the changes
+  // to changedRegion coalesced on a grid of COALESCE_TILE_SIZE tiles.
+  // Must be called with m_fbMutex locked.
+  void readChanges(Region *changedRegion);
+
+  // Marks the tiles covered by the rect, it must lie inside the frame buffer.
+  void markTiles(const Rect *rect);
+
+  // The driver does not signal changes, the change ring counter is checked
+  // with this interval in milliseconds.
+  static const unsigned int CHECK_INTERVAL = 20;
+  static const int COALESCE_TILE_SIZE = 32;
+
   MirrorDriverClient *m_mirrorClient;
   unsigned long m_lastCounter;
+
+  // Changed tiles of the current batch, one byte per tile row by row.
+  std::vector<char> m_changedTiles;
+  int m_tileColumns;
+  int m_tileRows;
+  std::vector<Rect> m_changedRects;
   FrameBuffer m_frameBuffer;
   // TO THINK: One may use a self mutex here, because do not
   // use external objects here.
@@ -0,0 +1,104 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "MouseMoveHook.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+
+HHOOK MouseMoveHook::m_hMouseHook = 0;
+MouseMoveHook *MouseMoveHook::m_instance = 0;
+LocalMutex MouseMoveHook::m_instanceMutex;
+
+MouseMoveHook::MouseMoveHook(MouseMoveListener *listener, LogWriter *log)
+: m_listener(listener),
+  m_isInstalled(false),
+  m_log(log)
+{
+  {
+    AutoLock al(&m_instanceMutex);
+    if (m_instance != 0) {
+      throw Exception(_T("MouseMoveHook instance already exists"));
+    }
+    m_instance = this;
+  }
+  resume();
+}
+
+MouseMoveHook::~MouseMoveHook()
+{
+  terminate();
+  wait();
+
+  AutoLock al(&m_instanceMutex);
+  m_instance = 0;
+}
+
+void MouseMoveHook::onTerminate()
+{
+  PostThreadMessage(getThreadId(), WM_QUIT, 0, 0);
+}
+
+void MouseMoveHook::execute()
+{
+  HINSTANCE hinst = GetModuleHandle(0);
+  m_hMouseHook = SetWindowsHookEx(WH_MOUSE_LL,
+                                  (HOOKPROC)lowLevelMouseProc,
+                                  hinst, 0L);
+  if (m_hMouseHook == 0) {
+    m_log->error(_T("Can't install the mouse move hook, error = %u"),
+                 GetLastError());
+    return;
+  }
+  m_isInstalled = true;
+  m_log->info(_T("Mouse move hook thread id = %d"), getThreadId());
+
+  // The hook procedure is called in this thread while it waits for messages.
+  MSG msg;
+  while (!isTerminating()) {
+    if (!PeekMessage(&msg, NULL, NULL, NULL, PM_REMOVE)) {
+      if (!WaitMessage()) {
+        break;
+      }
+    } else if (msg.message == WM_QUIT) {
+      break;
+    } else {
+      DispatchMessage(&msg);
+    }
+  }
+
+  m_isInstalled = false;
+  UnhookWindowsHookEx(m_hMouseHook);
+  m_hMouseHook = 0;
+}
+
+LRESULT CALLBACK MouseMoveHook::lowLevelMouseProc(int nCode,
+                                                  WPARAM wParam,
+                                                  LPARAM lParam)
+{
+  // The instance cannot go away while its thread is in here.
+  if (nCode == HC_ACTION && wParam == WM_MOUSEMOVE && m_instance != 0) {
+    m_instance->m_listener->onMouseMove();
+  }
+  return CallNextHookEx(m_hMouseHook, nCode, wParam, lParam);
+}
@@ -25,90 +25,131 @@
 #include "util/CommonHeader.h"
 #include "Poller.h"
 #include "region/Region.h"
+#include "util/Exception.h"
 #include "server-config-lib/Configurator.h"
+#include "log-writer/FrameTrace.h"
+#include "log-writer/ZoneProfiler.h"
+#include "log-writer/StallWatchdog.h"
+#include "CaptureCounters.h"
 
 Poller::Poller(UpdateKeeper *updateKeeper,
                UpdateListener *updateListener,
+               TaskScheduler *scheduler,
+               ScreenDriver *screenDriver,
                ScreenGrabber *screenGrabber,
                FrameBuffer *backupFrameBuffer,
                LocalMutex *frameBufferCriticalSection,
                LogWriter *log)
-: UpdateDetector(updateKeeper, updateListener),
+: ScheduledUpdateDetector(updateKeeper, updateListener, scheduler),
+  m_screenDriver(screenDriver),
   m_screenGrabber(screenGrabber),
   m_backupFrameBuffer(backupFrameBuffer),
   m_fbMutex(frameBufferCriticalSection),
+  m_grabOptimizator(log),
   m_log(log)
 {
-  m_pollingRect.setRect(0, 0, 16, 16);
 }
 
 Poller::~Poller()
 {
-  terminate();
-  wait();
+  stop();
 }
 
-void Poller::onTerminate()
+void Poller::onStart()
 {
-  m_intervalWaiter.notify();
+  AutoLock al(m_fbMutex);
+  FrameBuffer *screenFrameBuffer = m_screenGrabber->getScreenBuffer();
+  Rect fullScreenRect(screenFrameBuffer->getDimension().getRect());
+  m_updateKeeper->addChangedRect(&fullScreenRect);
 }
 
-void Poller::execute()
+unsigned int Poller::detect()
 {
-  m_log->info(_T("poller thread id = %d"), getThreadId());
-
-  FrameBuffer *screenFrameBuffer;
+  Region region;
 
   {
     AutoLock al(m_fbMutex);
-    screenFrameBuffer = m_screenGrabber->getScreenBuffer();
-    Rect fullScreenRect(screenFrameBuffer->getDimension().getRect());
-    m_updateKeeper->addChangedRect(&fullScreenRect);
-  }
 
-  while (!isTerminating()) {
-    Region region;
+    FrameBuffer *screenFrameBuffer = m_screenGrabber->getScreenBuffer();
+    if (!screenFrameBuffer->isEqualTo(m_backupFrameBuffer)) {
+      m_updateKeeper->setScreenSizeChanged();
+    } else {
+      try {
+        poll(screenFrameBuffer, &region);
+      } catch (Exception &e) {
+        m_log->error(_T("Polling failed: %s"), e.getMessage());
+      }
+      m_updateKeeper->addChangedRegion(&region);
+    }
+  } // AutoLock
 
-    {
-      AutoLock al(m_fbMutex);
+  // Send event
+  if (!region.isEmpty()) {
+    doUpdate();
+  }
 
-      screenFrameBuffer = m_screenGrabber->getScreenBuffer();
-      if (!screenFrameBuffer->isEqualTo(m_backupFrameBuffer)) {
-        m_updateKeeper->setScreenSizeChanged();
-      } else {
-        m_log->info(_T("grabbing screen for polling"));
-        m_screenGrabber->grab();
-        m_log->info(_T("end of grabbing screen for polling"));
+  return Configurator::getConfigSnapshot()->getPollingInterval();
+}
+
+void Poller::poll(FrameBuffer *screenFrameBuffer, Region *region)
+{
+  Dimension screenDim = screenFrameBuffer->getDimension();
+  if (!screenDim.isEqualTo(&m_heatmapDim)) {
+    m_heatmap.reset(&screenDim);
+    m_heatmapDim = screenDim;
+  }
+  m_heatmap.nextPass();
 
-        // Polling
-        int pollingWidth = m_pollingRect.getWidth();
-        int pollingHeight = m_pollingRect.getHeight();
-        int screenWidth = screenFrameBuffer->getDimension().width;
-        int screenHeight = screenFrameBuffer->getDimension().height;
+  // The tiles watched by no client are not polled, they are checked again
+  // when the capture region grows.
+  Region captureRegion;
+  bool limited = m_updateKeeper->getCaptureRegion(&captureRegion);
 
-        Rect scanRect;
-        for (int iRow = 0; iRow < screenHeight; iRow += pollingHeight) {
-          for (int iCol = 0; iCol < screenWidth; iCol += pollingWidth) {
-            scanRect.setRect(iCol, iRow, min(iCol + pollingWidth, screenWidth),
-                             min(iRow + pollingHeight, screenHeight));
-            if (!screenFrameBuffer->cmpFrom(&scanRect, m_backupFrameBuffer,
-                                            scanRect.left, scanRect.top)) {
-              region.addRect(&scanRect);
-            }
+  int columns = m_heatmap.getColumns();
+  int rows = m_heatmap.getRows();
+  Region grabRegion;
+  m_dueTiles.clear();
+  for (int iRow = 0; iRow < rows; iRow++) {
+    for (int iCol = 0; iCol < columns; iCol++) {
+      if (m_heatmap.isDue(iCol, iRow)) {
+        Rect tileRect = m_heatmap.getTileRect(iCol, iRow);
+        if (limited) {
+          Region tileRegion(tileRect);
+          tileRegion.intersect(&captureRegion);
+          if (tileRegion.isEmpty()) {
+            continue;
           }
         }
-
-        m_updateKeeper->addChangedRegion(&region);
+        grabRegion.addRect(&tileRect);
+        m_dueTiles.push_back(iRow * columns + iCol);
       }
-    } // AutoLock
-
-    // Send event
-    if (!region.isEmpty()) {
-      doUpdate();
     }
+  }
+  if (m_dueTiles.empty()) {
+    return;
+  }
 
-    unsigned int pollInterval = Configurator::getInstance()->
-                                getServerConfig()->getPollingInterval();
-    m_intervalWaiter.waitForEvent(pollInterval);
+  {
+    FrameTrace::Span captureSpan(FrameTrace::CAPTURE);
+    ZoneProfiler::Scope captureZone(ZoneProfiler::CAPTURE);
+    StallWatchdog::Activity captureActivity(StallWatchdog::CAPTURE);
+    m_log->info(_T("grabbing %d of %d tiles for polling"),
+                (int)m_dueTiles.size(), columns * rows);
+    m_grabOptimizator.grab(&grabRegion, m_screenDriver);
+    CaptureCounters::getInstance()->onFrameAcquired();
+    m_log->info(_T("end of grabbing screen for polling"));
+  }
+
+  std::vector<int>::const_iterator iTile;
+  for (iTile = m_dueTiles.begin(); iTile != m_dueTiles.end(); iTile++) {
+    int iCol = *iTile % columns;
+    int iRow = *iTile / columns;
+    Rect scanRect = m_heatmap.getTileRect(iCol, iRow);
+    bool changed = !screenFrameBuffer->cmpFrom(&scanRect, m_backupFrameBuffer,
+                                               scanRect.left, scanRect.top);
+    if (changed) {
+      region->addRect(&scanRect);
+    }
+    m_heatmap.onPolled(iCol, iRow, changed);
   }
 }
@@ -25,20 +25,32 @@
 #ifndef __POLLER_H__
 #define __POLLER_H__
 
-#include "UpdateDetector.h"
+#include "ScheduledUpdateDetector.h"
 #include "ScreenGrabber.h"
+#include "ScreenDriver.h"
+#include "GrabOptimizator.h"
+#include "PollingHeatmap.h"
 #include "rfb/FrameBuffer.h"
 #include "region/Rect.h"
-#include "win-system/WindowsEvent.h"
 #include "log-writer/LogWriter.h"
 
+#include <vector>
+
 #define DEFAULT_SLEEP_TIME 1000
 
-class Poller : public UpdateDetector
+// Poller detects the screen changes missed by other detectors by comparing
+// screen tiles with the backup frame buffer at the polling interval. Only
+// the tiles due according to m_heatmap are grabbed and compared in a pass,
+// so static parts of the screen cost little.
+class Poller : public ScheduledUpdateDetector
 {
 public:
+  // screenDriver is used to grab the polled tiles with the grab
+  // optimization, it must grab via screenGrabber.
   Poller(UpdateKeeper *updateKeeper,
          UpdateListener *updateListener,
+         TaskScheduler *scheduler,
+         ScreenDriver *screenDriver,
          ScreenGrabber *screenGrabber,
          FrameBuffer *backupFrameBuffer,
          LocalMutex *frameBufferCriticalSection,
@@ -47,15 +59,24 @@ public:
   virtual ~Poller();
 
 protected:
-  virtual void execute();
-  virtual void onTerminate();
+  virtual void onStart();
+  virtual unsigned int detect();
 
 private:
+  // Polls the due tiles and adds the changed ones to region. Must be called
+  // with m_fbMutex locked.
+  void poll(FrameBuffer *screenFrameBuffer, Region *region);
+
+  ScreenDriver *m_screenDriver;
   ScreenGrabber *m_screenGrabber;
   FrameBuffer *m_backupFrameBuffer;
   LocalMutex *m_fbMutex;
-  Rect m_pollingRect;
-  WindowsEvent m_intervalWaiter;
+
+  PollingHeatmap m_heatmap;
+  Dimension m_heatmapDim;
+  // Indices of the tiles polled in the current pass.
+  std::vector<int> m_dueTiles;
+  GrabOptimizator m_grabOptimizator;
 
   LogWriter *m_log;
 };
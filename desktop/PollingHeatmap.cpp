@@ -0,0 +1,119 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PollingHeatmap.h"
+
+PollingHeatmap::PollingHeatmap()
+: m_columns(0),
+  m_rows(0),
+  m_pass(0)
+{
+}
+
+PollingHeatmap::~PollingHeatmap()
+{
+}
+
+void PollingHeatmap::reset(const Dimension *screenDim)
+{
+  m_screenDim = *screenDim;
+  m_columns = (screenDim->width + TILE_SIZE - 1) / TILE_SIZE;
+  m_rows = (screenDim->height + TILE_SIZE - 1) / TILE_SIZE;
+  m_heat.assign(m_columns * m_rows, 0);
+  m_pass = 0;
+}
+
+void PollingHeatmap::nextPass()
+{
+  m_pass++;
+}
+
+int PollingHeatmap::getColumns() const
+{
+  return m_columns;
+}
+
+int PollingHeatmap::getRows() const
+{
+  return m_rows;
+}
+
+bool PollingHeatmap::isDue(int column, int row) const
+{
+  int heat = m_heat[row * m_columns + column];
+  if (heat >= HOT_HEAT) {
+    return true;
+  }
+  unsigned int period = heat >= WARM_HEAT ? WARM_PERIOD : COLD_PERIOD;
+  // Stagger the tiles so that neighbouring ones are polled in different
+  // passes.
+  unsigned int phase = (unsigned int)(row * 3 + column);
+  return (m_pass + phase) % period == 0;
+}
+
+Rect PollingHeatmap::getTileRect(int column, int row) const
+{
+  int left = column * TILE_SIZE;
+  int top = row * TILE_SIZE;
+  int right = left + TILE_SIZE;
+  int bottom = top + TILE_SIZE;
+  return Rect(left, top,
+              right < m_screenDim.width ? right : m_screenDim.width,
+              bottom < m_screenDim.height ? bottom : m_screenDim.height);
+}
+
+void PollingHeatmap::onPolled(int column, int row, bool changed)
+{
+  UINT8 *heat = &m_heat[row * m_columns + column];
+  if (changed) {
+    int newHeat = *heat + CHANGE_HEAT;
+    *heat = (UINT8)(newHeat < MAX_HEAT ? newHeat : MAX_HEAT);
+    if (column > 0) {
+      warm(column - 1, row);
+    }
+    if (column < m_columns - 1) {
+      warm(column + 1, row);
+    }
+    if (row > 0) {
+      warm(column, row - 1);
+    }
+    if (row < m_rows - 1) {
+      warm(column, row + 1);
+    }
+  } else {
+    *heat -= *heat >> 3;
+    if (*heat < WARM_HEAT && *heat != 0) {
+      // Let the tile go cold instead of staying just below the threshold.
+      *heat = 0;
+    }
+  }
+}
+
+void PollingHeatmap::warm(int column, int row)
+{
+  UINT8 *heat = &m_heat[row * m_columns + column];
+  if (*heat < WARM_HEAT * 2) {
+    *heat = WARM_HEAT * 2;
+  }
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __POLLINGHEATMAP_H__
+#define __POLLINGHEATMAP_H__
+
+#include <vector>
+
+#include "region/Dimension.h"
+#include "region/Rect.h"
+#include "util/inttypes.h"
+
+// PollingHeatmap keeps the recent change frequency of every screen tile and
+// decides which tiles are polled in a polling pass. A tile heats up each
+// time it is found changed and cools down each time it is found unchanged.
+// Hot tiles (clocks, tickers, video) are polled every pass, warm ones every
+// WARM_PERIOD passes and cold ones every COLD_PERIOD passes. The passes of
+// cold tiles are staggered, so that each pass polls about the same number
+// of them. A changed tile also warms its neighbours, as changes tend to
+// spread, e.g. when a window is moved.
+//
+// The class is not thread-safe, it's used by the poller thread only.
+class PollingHeatmap
+{
+public:
+  PollingHeatmap();
+  virtual ~PollingHeatmap();
+
+  // Forgets all the heat and sets the screen dimension.
+  void reset(const Dimension *screenDim);
+
+  // Starts the next polling pass.
+  void nextPass();
+
+  // Returns the number of tiles in a row and in a column.
+  int getColumns() const;
+  int getRows() const;
+
+  // Returns true if the tile must be polled in the current pass.
+  bool isDue(int column, int row) const;
+
+  // Returns the screen rectangle of the tile.
+  Rect getTileRect(int column, int row) const;
+
+  // Should be called with the result of polling a due tile.
+  void onPolled(int column, int row, bool changed);
+
+  static const int TILE_SIZE = 16;
+
+private:
+  void warm(int column, int row);
+
+  Dimension m_screenDim;
+  int m_columns;
+  int m_rows;
+  std::vector<UINT8> m_heat;
+  unsigned int m_pass;
+
+  // Heat added on a change and the thresholds of hot and warm tiles. The
+  // heat decays by 1/8 on each unchanged poll, so a tile changed once stays
+  // warm for about 16 polls.
+  static const int CHANGE_HEAT = 64;
+  static const int HOT_HEAT = 48;
+  static const int WARM_HEAT = 8;
+  static const int MAX_HEAT = 255;
+  static const unsigned int WARM_PERIOD = 2;
+  static const unsigned int COLD_PERIOD = 8;
+};
+
+#endif // __POLLINGHEATMAP_H__
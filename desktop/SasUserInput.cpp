@@ -81,6 +81,8 @@ void SasUserInput::setKeyboardEvent(UINT32 keySym, bool down)
     DWORD sessionId = WTS::getActiveConsoleSessionId(m_log);
     bool isRdp = WTS::SessionIsRdpSession(sessionId, m_log);
     if (!isRdp) {
+      // The combination must follow the events held back.
+      m_client->flushInputBatch();
       Environment::simulateCtrlAltDelUnderVista(m_log);
       return;
     }
@@ -88,6 +90,16 @@ void SasUserInput::setKeyboardEvent(UINT32 keySym, bool down)
   m_client->setKeyboardEvent(keySym, down);
 }
 
+void SasUserInput::beginInputBatch()
+{
+  m_client->beginInputBatch();
+}
+
+void SasUserInput::endInputBatch()
+{
+  m_client->endInputBatch();
+}
+
 void SasUserInput::getCurrentUserInfo(StringStorage *desktopName,
                                          StringStorage *userName)
 {
@@ -120,6 +132,11 @@ void SasUserInput::getWindowCoords(HWND hwnd, Rect *rect)
   m_client->getWindowCoords(hwnd, rect);
 }
 
+void SasUserInput::getForegroundWindowCoords(Rect *rect)
+{
+  m_client->getForegroundWindowCoords(rect);
+}
+
 HWND SasUserInput::getWindowHandleByName(const StringStorage *windowName)
 {
   return m_client->getWindowHandleByName(windowName);
@@ -40,6 +40,8 @@ public:
   virtual void setNewClipboard(const StringStorage *newClipboard);
   virtual void setMouseEvent(const Point newPos, UINT8 keyFlag);
   virtual void setKeyboardEvent(UINT32 keySym, bool down);
+  virtual void beginInputBatch();
+  virtual void endInputBatch();
   virtual void getCurrentUserInfo(StringStorage *desktopName,
                                   StringStorage *userName);
   virtual void getPrimaryDisplayCoords(Rect *rect);
@@ -48,6 +50,7 @@ public:
   virtual std::vector<Rect> getDisplaysCoords();
   virtual void getNormalizedRect(Rect *rect);
   virtual void getWindowCoords(HWND hwnd, Rect *rect);
+  virtual void getForegroundWindowCoords(Rect *rect);
   virtual HWND getWindowHandleByName(const StringStorage *windowName);
   virtual void getApplicationRegion(unsigned int procId, Region *region);
   virtual bool isApplicationInFocus(unsigned int procId);
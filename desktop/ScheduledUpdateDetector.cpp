@@ -0,0 +1,100 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ScheduledUpdateDetector.h"
+#include "thread/AutoLock.h"
+
+ScheduledUpdateDetector::ScheduledUpdateDetector(UpdateKeeper *updateKeeper,
+                                                 UpdateListener *updateListener,
+                                                 TaskScheduler *scheduler)
+: m_updateKeeper(updateKeeper),
+  m_updateListener(updateListener),
+  m_scheduler(scheduler),
+  m_idleBackoff(0),
+  m_isStarted(false),
+  m_captureDemanded(true)
+{
+}
+
+ScheduledUpdateDetector::~ScheduledUpdateDetector()
+{
+  // The derived destructors must have stopped the detector already, this
+  // only protects the scheduler from a destroyed task.
+  stop();
+}
+
+void ScheduledUpdateDetector::start()
+{
+  if (!m_isStarted) {
+    m_isStarted = true;
+    onStart();
+    if (m_idleBackoff != 0) {
+      m_idleBackoff->addDetector(this);
+    }
+    m_scheduler->post(this);
+  }
+}
+
+void ScheduledUpdateDetector::stop()
+{
+  if (m_isStarted) {
+    {
+      AutoLock al(&m_stateLock);
+      m_isStarted = false;
+    }
+    onStop();
+    if (m_idleBackoff != 0) {
+      m_idleBackoff->removeDetector(this);
+    }
+    m_scheduler->cancel(this);
+  }
+}
+
+void ScheduledUpdateDetector::setIdleBackoff(IdleBackoff *idleBackoff)
+{
+  m_idleBackoff = idleBackoff;
+}
+
+void ScheduledUpdateDetector::setCaptureDemand(bool demanded)
+{
+  AutoLock al(&m_stateLock);
+  bool resumed = demanded && !m_captureDemanded;
+  m_captureDemanded = demanded;
+  if (resumed && m_isStarted) {
+    m_scheduler->post(this);
+  }
+}
+
+void ScheduledUpdateDetector::run()
+{
+  if (!m_captureDemanded) {
+    // Not rescheduled, setCaptureDemand() posts the task again.
+    return;
+  }
+  unsigned int delay = detect();
+  if (m_idleBackoff != 0) {
+    delay = m_idleBackoff->scaleDelay(delay);
+  }
+  m_scheduler->postDelayed(this, delay);
+}
@@ -0,0 +1,98 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SCHEDULEDUPDATEDETECTOR_H__
+#define __SCHEDULEDUPDATEDETECTOR_H__
+
+#include "UpdateKeeper.h"
+#include "UpdateListener.h"
+#include "IdleBackoff.h"
+#include "thread/TaskScheduler.h"
+#include "thread/LocalMutex.h"
+
+// Update detector that checks for changes periodically as a task of a
+// scheduler shared with other detectors, instead of sleeping in its own
+// thread between the checks.
+class ScheduledUpdateDetector : public Task
+{
+public:
+  ScheduledUpdateDetector(UpdateKeeper *updateKeeper,
+                          UpdateListener *updateListener,
+                          TaskScheduler *scheduler);
+  virtual ~ScheduledUpdateDetector();
+
+  // Starts the detection, the first check is done at once.
+  void start();
+  // Stops the detection and waits for the running check to complete.
+  void stop();
+
+  // Makes the delays between the checks grow while the desktop is static.
+  // Must be called before start(), the idle backoff must outlive the
+  // detector.
+  void setIdleBackoff(IdleBackoff *idleBackoff);
+
+  // While the capture is not demanded, the checks are not scheduled. The
+  // first check is done at once when the demand returns.
+  void setCaptureDemand(bool demanded);
+
+protected:
+  // Checks for changes once and returns the delay to the next check, in
+  // milliseconds.
+  virtual unsigned int detect() = 0;
+
+  // Called by start() before the first check.
+  virtual void onStart() {}
+  // Called by stop() before the pending check is canceled, so that no
+  // event source calls checkNow() after that.
+  virtual void onStop() {}
+
+  // Makes the next check as soon as possible, for the detectors that learn
+  // about changes from events.
+  void checkNow()
+  {
+    m_scheduler->post(this);
+  }
+
+  void doUpdate()
+  {
+    if (m_updateListener) {
+      m_updateListener->onUpdate();
+    }
+  }
+
+  UpdateKeeper *m_updateKeeper;
+  UpdateListener *m_updateListener;
+
+private:
+  virtual void run();
+
+  TaskScheduler *m_scheduler;
+  IdleBackoff *m_idleBackoff;
+  volatile bool m_isStarted;
+  volatile bool m_captureDemanded;
+  // Serializes the posting on the demand with the stopping.
+  LocalMutex m_stateLock;
+};
+
+#endif // __SCHEDULEDUPDATEDETECTOR_H__
@@ -94,6 +94,12 @@ public:
   // by concrete implementation.
   // Implementions will not ensure that this function is thread safety.
   virtual Region getVideoRegion() = 0;
+
+  // Tells whether some client can accept updates now. While the capture is
+  // not demanded, the drivers may stop grabbing the screen and keep only
+  // the knowledge of what has changed, they must catch up when the demand
+  // returns. The default implementation captures all the time.
+  virtual void setCaptureDemand(bool demanded) {}
 };
 
 #endif // __SCREENDRIVER_H__
@@ -0,0 +1,245 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ScrollDetector.h"
+#include "zlib/zlib.h"
+#include <string.h>
+
+ScrollDetector::ScrollDetector()
+{
+}
+
+ScrollDetector::~ScrollDetector()
+{
+}
+
+bool ScrollDetector::detect(const FrameBuffer *prevFb,
+                            const FrameBuffer *curFb,
+                            const Rect *area, Rect *copyRect, Point *source)
+{
+  if (area->getWidth() < MIN_AREA_SIZE || area->getHeight() < MIN_AREA_SIZE) {
+    return false;
+  }
+  return detectVertical(prevFb, curFb, area, copyRect, source) ||
+         detectHorizontal(prevFb, curFb, area, copyRect, source);
+}
+
+bool ScrollDetector::detectVertical(const FrameBuffer *prevFb,
+                                    const FrameBuffer *curFb,
+                                    const Rect *area,
+                                    Rect *copyRect, Point *source)
+{
+  // Scroll bars and margins often do not move with the content, so only
+  // the middle half of the area votes.
+  int quarter = area->getWidth() / 4;
+  Rect band(area->left + quarter, area->top,
+            area->right - quarter, area->bottom);
+  hashRows(prevFb, &band, &m_prevHashes);
+  hashRows(curFb, &band, &m_curHashes);
+  int dy = findShift(&m_prevHashes, &m_curHashes);
+  if (dy == 0) {
+    return false;
+  }
+
+  // Find the longest run of band rows shifted by dy, the source rows must
+  // be within the area too.
+  int top = max(area->top, area->top + dy);
+  int bottom = min(area->bottom, area->bottom + dy);
+  int bestTop = 0, bestBottom = 0;
+  int runTop = top;
+  for (int y = top; y <= bottom; y++) {
+    Rect row(band.left, y, band.right, y + 1);
+    if (y == bottom || !areasEqual(prevFb, curFb, &row, 0, dy)) {
+      if (y - runTop > bestBottom - bestTop) {
+        bestTop = runTop;
+        bestBottom = y;
+      }
+      runTop = y + 1;
+    }
+  }
+  if (bestBottom - bestTop < MIN_COPY_SIZE) {
+    return false;
+  }
+
+  // Widen the run to the columns shifted along with the band.
+  Rect run(band.left, bestTop, band.right, bestBottom);
+  for (; run.left > area->left; run.left--) {
+    Rect column(run.left - 1, run.top, run.left, run.bottom);
+    if (!areasEqual(prevFb, curFb, &column, 0, dy)) {
+      break;
+    }
+  }
+  for (; run.right < area->right; run.right++) {
+    Rect column(run.right, run.top, run.right + 1, run.bottom);
+    if (!areasEqual(prevFb, curFb, &column, 0, dy)) {
+      break;
+    }
+  }
+
+  *copyRect = run;
+  source->setPoint(run.left, run.top - dy);
+  return true;
+}
+
+bool ScrollDetector::detectHorizontal(const FrameBuffer *prevFb,
+                                      const FrameBuffer *curFb,
+                                      const Rect *area,
+                                      Rect *copyRect, Point *source)
+{
+  int quarter = area->getHeight() / 4;
+  Rect band(area->left, area->top + quarter,
+            area->right, area->bottom - quarter);
+  hashColumns(prevFb, &band, &m_prevHashes);
+  hashColumns(curFb, &band, &m_curHashes);
+  int dx = findShift(&m_prevHashes, &m_curHashes);
+  if (dx == 0) {
+    return false;
+  }
+
+  int left = max(area->left, area->left + dx);
+  int right = min(area->right, area->right + dx);
+  int bestLeft = 0, bestRight = 0;
+  int runLeft = left;
+  for (int x = left; x <= right; x++) {
+    Rect column(x, band.top, x + 1, band.bottom);
+    if (x == right || !areasEqual(prevFb, curFb, &column, dx, 0)) {
+      if (x - runLeft > bestRight - bestLeft) {
+        bestLeft = runLeft;
+        bestRight = x;
+      }
+      runLeft = x + 1;
+    }
+  }
+  if (bestRight - bestLeft < MIN_COPY_SIZE) {
+    return false;
+  }
+
+  Rect run(bestLeft, band.top, bestRight, band.bottom);
+  for (; run.top > area->top; run.top--) {
+    Rect row(run.left, run.top - 1, run.right, run.top);
+    if (!areasEqual(prevFb, curFb, &row, dx, 0)) {
+      break;
+    }
+  }
+  for (; run.bottom < area->bottom; run.bottom++) {
+    Rect row(run.left, run.bottom, run.right, run.bottom + 1);
+    if (!areasEqual(prevFb, curFb, &row, dx, 0)) {
+      break;
+    }
+  }
+
+  *copyRect = run;
+  source->setPoint(run.left - dx, run.top);
+  return true;
+}
+
+void ScrollDetector::hashRows(const FrameBuffer *fb, const Rect *band,
+                              std::vector<UINT32> *hashes)
+{
+  hashes->resize(band->getHeight());
+  size_t lineSize = band->getWidth() * fb->getBytesPerPixel();
+  int stride = fb->getBytesPerRow();
+  const Bytef *line = (const Bytef *)fb->getBufferPtr(band->left, band->top);
+  for (int i = 0; i < band->getHeight(); i++, line += stride) {
+    (*hashes)[i] = (UINT32)adler32(adler32(0L, Z_NULL, 0), line,
+                                   (uInt)lineSize);
+  }
+}
+
+void ScrollDetector::hashColumns(const FrameBuffer *fb, const Rect *band,
+                                 std::vector<UINT32> *hashes)
+{
+  // Columns are hashed a row at a time to walk the memory sequentially.
+  hashes->assign(band->getWidth(), 0);
+  size_t pixelSize = fb->getBytesPerPixel();
+  int stride = fb->getBytesPerRow();
+  const UINT8 *line = (const UINT8 *)fb->getBufferPtr(band->left, band->top);
+  for (int y = band->top; y < band->bottom; y++, line += stride) {
+    const UINT8 *pixel = line;
+    for (int i = 0; i < band->getWidth(); i++) {
+      UINT32 value = 0;
+      memcpy(&value, pixel, pixelSize);
+      (*hashes)[i] = ((*hashes)[i] * 31 + value) ^ ((*hashes)[i] >> 27);
+      pixel += pixelSize;
+    }
+  }
+}
+
+int ScrollDetector::findShift(const std::vector<UINT32> *prevHashes,
+                              const std::vector<UINT32> *curHashes)
+{
+  // Repeated items (plain backgrounds, empty lines) cannot tell the shift.
+  m_prevIndex.clear();
+  for (size_t i = 0; i < prevHashes->size(); i++) {
+    std::map<UINT32, int>::iterator it = m_prevIndex.find((*prevHashes)[i]);
+    if (it == m_prevIndex.end()) {
+      m_prevIndex[(*prevHashes)[i]] = (int)i;
+    } else {
+      it->second = -1;
+    }
+  }
+
+  m_votes.clear();
+  for (size_t i = 0; i < curHashes->size(); i++) {
+    UINT32 hash = (*curHashes)[i];
+    if (hash == (*prevHashes)[i]) {
+      continue;
+    }
+    std::map<UINT32, int>::const_iterator it = m_prevIndex.find(hash);
+    if (it != m_prevIndex.end() && it->second >= 0) {
+      m_votes[(int)i - it->second]++;
+    }
+  }
+
+  int bestShift = 0;
+  int bestVotes = MIN_VOTES - 1;
+  std::map<int, int>::const_iterator it;
+  for (it = m_votes.begin(); it != m_votes.end(); it++) {
+    if (it->second > bestVotes) {
+      bestShift = it->first;
+      bestVotes = it->second;
+    }
+  }
+  return bestShift;
+}
+
+bool ScrollDetector::areasEqual(const FrameBuffer *prevFb,
+                                const FrameBuffer *curFb,
+                                const Rect *rect, int dx, int dy)
+{
+  size_t lineSize = rect->getWidth() * curFb->getBytesPerPixel();
+  int stride = curFb->getBytesPerRow();
+  const UINT8 *prevLine = (const UINT8 *)prevFb->getBufferPtr(rect->left - dx,
+                                                              rect->top - dy);
+  const UINT8 *curLine = (const UINT8 *)curFb->getBufferPtr(rect->left,
+                                                            rect->top);
+  for (int y = rect->top; y < rect->bottom; y++) {
+    if (memcmp(prevLine, curLine, lineSize) != 0) {
+      return false;
+    }
+    prevLine += stride;
+    curLine += stride;
+  }
+  return true;
+}
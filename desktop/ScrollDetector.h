@@ -0,0 +1,96 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SCROLLDETECTOR_H__
+#define __SCROLLDETECTOR_H__
+
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+#include "region/Point.h"
+#include "util/inttypes.h"
+#include <map>
+#include <vector>
+
+// ScrollDetector finds scrolled content by comparing the previous and the
+// current frame buffer, so that scrolling can be sent as CopyRect without
+// any help from hooks or the screen driver.
+//
+// Checksums of the rows (or columns) of the middle band of the checked
+// area are computed in both frame buffers. Each changed row of the current
+// buffer that has a unique match among the rows of the previous one votes
+// for the shift between them, and the shift with the most votes wins. Rows
+// are then compared exactly to find the longest run of the area that was
+// shifted, and the run is widened to the columns shifted along with it.
+class ScrollDetector
+{
+public:
+  ScrollDetector();
+  ~ScrollDetector();
+
+  // Looks for a part of the area of curFb which equals to a part of prevFb
+  // shifted vertically or horizontally within the area. Both frame buffers
+  // must have the same properties. On success, returns true, the part of
+  // curFb in copyRect and the top-left corner of its source in prevFb in
+  // source.
+  bool detect(const FrameBuffer *prevFb, const FrameBuffer *curFb,
+              const Rect *area, Rect *copyRect, Point *source);
+
+  // Areas smaller than this in any dimension are not checked.
+  static const int MIN_AREA_SIZE = 64;
+
+private:
+  bool detectVertical(const FrameBuffer *prevFb, const FrameBuffer *curFb,
+                      const Rect *area, Rect *copyRect, Point *source);
+  bool detectHorizontal(const FrameBuffer *prevFb, const FrameBuffer *curFb,
+                        const Rect *area, Rect *copyRect, Point *source);
+
+  // Compute checksums of the rows (columns) of band.
+  static void hashRows(const FrameBuffer *fb, const Rect *band,
+                       std::vector<UINT32> *hashes);
+  static void hashColumns(const FrameBuffer *fb, const Rect *band,
+                          std::vector<UINT32> *hashes);
+
+  // Returns the shift voted by most of the changed items of curHashes, or
+  // 0 if there are not enough votes.
+  int findShift(const std::vector<UINT32> *prevHashes,
+                const std::vector<UINT32> *curHashes);
+
+  // Returns true if the rect area of curFb equals to the area of prevFb
+  // located (dx, dy) pixels before it.
+  static bool areasEqual(const FrameBuffer *prevFb, const FrameBuffer *curFb,
+                         const Rect *rect, int dx, int dy);
+
+  // Minimum number of votes for a shift.
+  static const int MIN_VOTES = 8;
+  // Scrolled parts smaller than this in any dimension are not reported.
+  static const int MIN_COPY_SIZE = 32;
+
+  std::vector<UINT32> m_prevHashes;
+  std::vector<UINT32> m_curHashes;
+  // Index of the previous checksums, -1 for checksums met more than once.
+  std::map<UINT32, int> m_prevIndex;
+  std::map<int, int> m_votes;
+};
+
+#endif // __SCROLLDETECTOR_H__
@@ -0,0 +1,416 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SyntheticWorkload.h"
+
+#include <vector>
+
+// Character cell of the text and the window frame.
+static const int CHAR_WIDTH = 8;
+static const int LINE_HEIGHT = 16;
+static const int BORDER_WIDTH = 2;
+static const int TITLE_HEIGHT = 24;
+
+// Frames between the steps of the scenarios.
+static const UINT32 SCROLL_PERIOD = 2;
+static const UINT32 TYPING_PERIOD = 4;
+static const UINT32 PHOTO_PERIOD = 60;
+static const UINT32 MIXED_PERIOD = 600;
+
+static const UINT32 BORDER_COLOR = 0x404040;
+static const UINT32 TITLE_COLOR = 0x1f4e99;
+static const UINT32 WINDOW_COLOR = 0xffffff;
+static const UINT32 TEXT_COLOR = 0x101010;
+
+static const TCHAR *const SCENARIO_NAMES[] = {
+  _T("scroll"), _T("drag"), _T("video"), _T("typing"), _T("photo"), _T("mixed")
+};
+static const int SCENARIO_COUNT = sizeof(SCENARIO_NAMES) / sizeof(SCENARIO_NAMES[0]);
+
+static inline UINT32 rgb(UINT32 r, UINT32 g, UINT32 b)
+{
+  return ((r & 0xff) << 16) | ((g & 0xff) << 8) | (b & 0xff);
+}
+
+// Interpolates the corner colors for the fractions fx and fy of 256.
+static inline UINT32 mixCorners(const UINT32 corners[4], UINT32 fx, UINT32 fy)
+{
+  UINT32 color = 0;
+  for (int shift = 0; shift <= 16; shift += 8) {
+    UINT32 top = ((corners[0] >> shift) & 0xff) * (256 - fx) +
+                 ((corners[1] >> shift) & 0xff) * fx;
+    UINT32 bottom = ((corners[2] >> shift) & 0xff) * (256 - fx) +
+                    ((corners[3] >> shift) & 0xff) * fx;
+    color |= (((top * (256 - fy) + bottom * fy) >> 16) & 0xff) << shift;
+  }
+  return color;
+}
+
+bool SyntheticWorkload::parseScenario(const TCHAR *name, Scenario *scenario)
+{
+  for (int i = 0; i < SCENARIO_COUNT; i++) {
+    if (_tcsicmp(name, SCENARIO_NAMES[i]) == 0) {
+      *scenario = (Scenario)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+SyntheticWorkload::SyntheticWorkload(Scenario scenario, UINT32 seed)
+: m_scenario(scenario),
+  m_current(scenario),
+  m_seed(seed),
+  m_random(seed),
+  m_frame(0),
+  m_dx(0),
+  m_dy(0)
+{
+}
+
+SyntheticWorkload::~SyntheticWorkload()
+{
+}
+
+void SyntheticWorkload::start(FrameBuffer *fb)
+{
+  // Zero is the only state the generator can't leave.
+  m_random = m_seed != 0 ? m_seed : 0x9e3779b9;
+  m_frame = 0;
+  m_current = m_scenario == MIXED ? SCROLLING_TEXT : m_scenario;
+  Region changed;
+  startScenario(fb, &changed);
+}
+
+void SyntheticWorkload::nextFrame(FrameBuffer *fb, Region *changed,
+                                  Rect *copyRect, Point *copySrc)
+{
+  changed->clear();
+  copyRect->clear();
+  m_frame++;
+
+  if (m_scenario == MIXED && m_frame % MIXED_PERIOD == 0) {
+    m_current = (Scenario)((m_current + 1) % MIXED);
+    startScenario(fb, changed);
+    return;
+  }
+
+  switch (m_current) {
+  case SCROLLING_TEXT:
+    scrollText(fb, changed, copyRect, copySrc);
+    break;
+  case WINDOW_DRAG:
+    dragWindow(fb, changed, copyRect, copySrc);
+    break;
+  case VIDEO_NOISE:
+    playVideo(fb, changed);
+    break;
+  case TYPING:
+    typeText(fb, changed);
+    break;
+  case PHOTO_CHANGES:
+    changePhoto(fb, changed);
+    break;
+  }
+}
+
+Point SyntheticWorkload::getCursorPosition() const
+{
+  return m_cursor;
+}
+
+void SyntheticWorkload::startScenario(FrameBuffer *fb, Region *changed)
+{
+  Dimension dim = fb->getDimension();
+  Rect screen(dim.width, dim.height);
+  drawBackground(fb, &screen);
+  changed->addRect(&screen);
+
+  switch (m_current) {
+  case SCROLLING_TEXT:
+  case TYPING:
+    m_window.setRect(dim.width / 6, dim.height / 8,
+                     dim.width * 5 / 6, dim.height * 7 / 8);
+    m_client = drawWindow(fb, &m_window);
+    if (m_current == SCROLLING_TEXT) {
+      for (int y = m_client.top; y + LINE_HEIGHT <= m_client.bottom;
+           y += LINE_HEIGHT) {
+        drawTextLine(fb, m_client.left, y, m_client.getWidth());
+      }
+    }
+    m_caret.setPoint(m_client.left, m_client.top);
+    m_cursor.setPoint(m_client.right - CHAR_WIDTH, m_client.top + LINE_HEIGHT);
+    break;
+  case WINDOW_DRAG:
+    {
+      int width = min(640, dim.width / 2);
+      int height = min(480, dim.height / 2);
+      m_window.setRect(0, 0, width, height);
+      m_window.move(nextRandom(dim.width - width),
+                    nextRandom(dim.height - height));
+      m_client = drawWindow(fb, &m_window);
+      for (int y = m_client.top; y + LINE_HEIGHT <= m_client.bottom;
+           y += LINE_HEIGHT) {
+        drawTextLine(fb, m_client.left, y, m_client.getWidth());
+      }
+      m_dx = 4 + nextRandom(9);
+      m_dy = 3 + nextRandom(7);
+      if (nextRandom(2) != 0) {
+        m_dx = -m_dx;
+      }
+      if (nextRandom(2) != 0) {
+        m_dy = -m_dy;
+      }
+      m_cursor.setPoint(m_window.left + width / 2,
+                        m_window.top + BORDER_WIDTH + TITLE_HEIGHT / 2);
+    }
+    break;
+  case VIDEO_NOISE:
+    {
+      int width = min(640, dim.width);
+      int height = min(width * 9 / 16, dim.height);
+      m_window.setRect(0, 0, width, height);
+      m_window.move((dim.width - width) / 2, (dim.height - height) / 2);
+      drawNoise(fb, &m_window);
+      m_cursor.setPoint(dim.width - 1, dim.height - 1);
+    }
+    break;
+  case PHOTO_CHANGES:
+    drawPhoto(fb);
+    m_cursor.setPoint(dim.width / 2, dim.height / 2);
+    break;
+  }
+}
+
+void SyntheticWorkload::scrollText(FrameBuffer *fb, Region *changed,
+                                   Rect *copyRect, Point *copySrc)
+{
+  if (m_frame % SCROLL_PERIOD != 0) {
+    return;
+  }
+  Rect moved(m_client.left, m_client.top,
+             m_client.right, m_client.bottom - LINE_HEIGHT);
+  if (moved.isEmpty()) {
+    return;
+  }
+  fb->move(&moved, m_client.left, m_client.top + LINE_HEIGHT);
+  *copyRect = moved;
+  copySrc->setPoint(m_client.left, m_client.top + LINE_HEIGHT);
+
+  Rect line(m_client.left, moved.bottom, m_client.right, m_client.bottom);
+  fb->fillRect(&line, WINDOW_COLOR);
+  drawTextLine(fb, line.left, line.top, line.getWidth());
+  changed->addRect(&line);
+}
+
+void SyntheticWorkload::dragWindow(FrameBuffer *fb, Region *changed,
+                                   Rect *copyRect, Point *copySrc)
+{
+  Dimension dim = fb->getDimension();
+  Rect old(m_window);
+  int width = old.getWidth();
+  int height = old.getHeight();
+
+  int x = old.left + m_dx;
+  if (x < 0 || x + width > dim.width) {
+    m_dx = -m_dx;
+    x = max(0, min(old.left + m_dx, dim.width - width));
+  }
+  int y = old.top + m_dy;
+  if (y < 0 || y + height > dim.height) {
+    m_dy = -m_dy;
+    y = max(0, min(old.top + m_dy, dim.height - height));
+  }
+  m_window.setLocation(x, y);
+  m_client.move(x - old.left, y - old.top);
+
+  fb->move(&m_window, old.left, old.top);
+  *copyRect = m_window;
+  copySrc->setPoint(old.left, old.top);
+
+  Region exposed(old);
+  Region covered(m_window);
+  exposed.subtract(&covered);
+  std::vector<Rect> rects;
+  exposed.getRectVector(&rects);
+  for (size_t i = 0; i < rects.size(); i++) {
+    drawBackground(fb, &rects[i]);
+  }
+  changed->add(&exposed);
+
+  m_cursor.setPoint(m_window.left + width / 2,
+                    m_window.top + BORDER_WIDTH + TITLE_HEIGHT / 2);
+}
+
+void SyntheticWorkload::playVideo(FrameBuffer *fb, Region *changed)
+{
+  drawNoise(fb, &m_window);
+  changed->addRect(&m_window);
+}
+
+void SyntheticWorkload::typeText(FrameBuffer *fb, Region *changed)
+{
+  if (m_frame % TYPING_PERIOD != 0) {
+    return;
+  }
+  if (m_caret.y + LINE_HEIGHT > m_client.bottom) {
+    fb->fillRect(&m_client, WINDOW_COLOR);
+    changed->addRect(&m_client);
+    m_caret.setPoint(m_client.left, m_client.top);
+    return;
+  }
+
+  // A space one time in six, a new line one time in forty.
+  if (nextRandom(6) != 0) {
+    Rect cell(m_caret.x, m_caret.y,
+              m_caret.x + CHAR_WIDTH, m_caret.y + LINE_HEIGHT);
+    drawGlyph(fb, cell.left, cell.top);
+    changed->addRect(&cell);
+  }
+  m_caret.x += CHAR_WIDTH;
+  if (nextRandom(40) == 0 || m_caret.x + CHAR_WIDTH > m_client.right) {
+    m_caret.setPoint(m_client.left, m_caret.y + LINE_HEIGHT);
+  }
+}
+
+void SyntheticWorkload::changePhoto(FrameBuffer *fb, Region *changed)
+{
+  if (m_frame % PHOTO_PERIOD != 0) {
+    return;
+  }
+  drawPhoto(fb);
+  Dimension dim = fb->getDimension();
+  Rect screen(dim.width, dim.height);
+  changed->addRect(&screen);
+}
+
+void SyntheticWorkload::drawBackground(FrameBuffer *fb, const Rect *rect)
+{
+  Dimension dim = fb->getDimension();
+  size_t stride = fb->getBytesPerRow();
+  UINT8 *row = (UINT8 *)fb->getBufferPtr(rect->left, rect->top);
+  for (int y = rect->top; y < rect->bottom; y++, row += stride) {
+    UINT32 *pixel = (UINT32 *)row;
+    UINT32 red = 0x20 + y * 0x40 / dim.height;
+    for (int x = rect->left; x < rect->right; x++) {
+      *pixel++ = rgb(red, 0x50 + (((x + y) >> 4) & 0x1f),
+                     0x90 + x * 0x40 / dim.width);
+    }
+  }
+}
+
+Rect SyntheticWorkload::drawWindow(FrameBuffer *fb, const Rect *rect)
+{
+  fb->fillRect(rect, BORDER_COLOR);
+  Rect title(rect->left + BORDER_WIDTH, rect->top + BORDER_WIDTH,
+             rect->right - BORDER_WIDTH, rect->top + BORDER_WIDTH + TITLE_HEIGHT);
+  fb->fillRect(&title, TITLE_COLOR);
+  Rect client(rect->left + BORDER_WIDTH, title.bottom,
+              rect->right - BORDER_WIDTH, rect->bottom - BORDER_WIDTH);
+  fb->fillRect(&client, WINDOW_COLOR);
+  return client;
+}
+
+void SyntheticWorkload::drawTextLine(FrameBuffer *fb, int x, int y, int width)
+{
+  int columns = width / CHAR_WIDTH;
+  int length = columns / 2 + nextRandom(columns / 2 + 1);
+  for (int i = 0; i < length; i++) {
+    if (nextRandom(6) != 0) {
+      drawGlyph(fb, x + i * CHAR_WIDTH, y);
+    }
+  }
+}
+
+void SyntheticWorkload::drawGlyph(FrameBuffer *fb, int x, int y)
+{
+  // 5x6 random dots of 1x2 pixels each, inside the 8x16 cell.
+  UINT32 bits = nextRandom();
+  size_t stride = fb->getBytesPerRow();
+  UINT8 *row = (UINT8 *)fb->getBufferPtr(x + 1, y + 2);
+  for (int i = 0; i < 6; i++, row += 2 * stride) {
+    UINT32 *upper = (UINT32 *)row;
+    UINT32 *lower = (UINT32 *)(row + stride);
+    for (int j = 0; j < 5; j++) {
+      if (bits & (1 << (i * 5 + j))) {
+        upper[j] = TEXT_COLOR;
+        lower[j] = TEXT_COLOR;
+      }
+    }
+  }
+}
+
+void SyntheticWorkload::drawNoise(FrameBuffer *fb, const Rect *rect)
+{
+  // Smoothly drifting colors with a grain changing in every frame, which
+  // gives neither the tile cache nor the encoders anything to reuse.
+  size_t stride = fb->getBytesPerRow();
+  UINT8 *row = (UINT8 *)fb->getBufferPtr(rect->left, rect->top);
+  for (int y = rect->top; y < rect->bottom; y++, row += stride) {
+    UINT32 *pixel = (UINT32 *)row;
+    for (int x = rect->left; x < rect->right; x++) {
+      UINT32 base = rgb(((x >> 2) + m_frame) & 0xbf,
+                        ((y >> 2) + m_frame * 2) & 0xbf,
+                        (((x + y) >> 3) + m_frame * 3) & 0xbf);
+      *pixel++ = base + (nextRandom() & 0x3f3f3f);
+    }
+  }
+}
+
+void SyntheticWorkload::drawPhoto(FrameBuffer *fb)
+{
+  Dimension dim = fb->getDimension();
+  UINT32 corners[4];
+  for (int i = 0; i < 4; i++) {
+    corners[i] = nextRandom() & 0xffffff;
+  }
+  size_t stride = fb->getBytesPerRow();
+  UINT8 *row = (UINT8 *)fb->getBufferPtr(0, 0);
+  for (int y = 0; y < dim.height; y++, row += stride) {
+    UINT32 *pixel = (UINT32 *)row;
+    UINT32 fy = (UINT32)y * 256 / dim.height;
+    for (int x = 0; x < dim.width; x++) {
+      UINT32 fx = (UINT32)x * 256 / dim.width;
+      // The grain keeps the picture from being a plain gradient.
+      UINT32 color = mixCorners(corners, fx, fy);
+      *pixel++ = color ^ (nextRandom() & 0x070707);
+    }
+  }
+}
+
+UINT32 SyntheticWorkload::nextRandom()
+{
+  m_random ^= m_random << 13;
+  m_random ^= m_random >> 17;
+  m_random ^= m_random << 5;
+  return m_random;
+}
+
+int SyntheticWorkload::nextRandom(int range)
+{
+  if (range <= 0) {
+    return 0;
+  }
+  return (int)(nextRandom() % (UINT32)range);
+}
@@ -0,0 +1,124 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SYNTHETICWORKLOAD_H__
+#define __SYNTHETICWORKLOAD_H__
+
+#include "util/CommonHeader.h"
+#include "region/Region.h"
+#include "region/Point.h"
+#include "rfb/FrameBuffer.h"
+
+// Draws a scripted desktop activity into a 32-bit frame buffer (red at
+// bits 16-23, green at 8-15 and blue at 0-7), frame by frame. All the
+// randomness comes from a generator seeded by the caller, so the same
+// scenario and seed always give the same frames and the same reported
+// changes, whatever the frame buffer is read by.
+class SyntheticWorkload
+{
+public:
+  enum Scenario
+  {
+    // A text window scrolling a line up every other frame.
+    SCROLLING_TEXT,
+    // A window dragged across the desktop, reported as a copy.
+    WINDOW_DRAG,
+    // A 16:9 region redrawn with noisy blocks every frame.
+    VIDEO_NOISE,
+    // A character typed into a text window every few frames.
+    TYPING,
+    // The whole screen replaced with a new picture once a second.
+    PHOTO_CHANGES,
+    // All the above, each for ten seconds in turn.
+    MIXED
+  };
+
+  // Converts the scenario name ("scroll", "drag", "video", "typing",
+  // "photo" or "mixed", case insensitive) into the scenario. Returns false
+  // if the name is unknown.
+  static bool parseScenario(const TCHAR *name, Scenario *scenario);
+
+  SyntheticWorkload(Scenario scenario, UINT32 seed);
+  virtual ~SyntheticWorkload();
+
+  // Restarts the sequence drawing its first frame over the whole frame
+  // buffer.
+  void start(FrameBuffer *fb);
+
+  // Draws the next frame. If a part of the screen has been moved, copyRect
+  // gets the destination of the move and copySrc its source, otherwise
+  // copyRect is empty. The move is done before any drawing, the changed
+  // region gets what has been drawn.
+  void nextFrame(FrameBuffer *fb, Region *changed,
+                 Rect *copyRect, Point *copySrc);
+
+  // Returns where the scripted pointer is.
+  Point getCursorPosition() const;
+
+private:
+  void startScenario(FrameBuffer *fb, Region *changed);
+
+  void scrollText(FrameBuffer *fb, Region *changed,
+                  Rect *copyRect, Point *copySrc);
+  void dragWindow(FrameBuffer *fb, Region *changed,
+                  Rect *copyRect, Point *copySrc);
+  void playVideo(FrameBuffer *fb, Region *changed);
+  void typeText(FrameBuffer *fb, Region *changed);
+  void changePhoto(FrameBuffer *fb, Region *changed);
+
+  // Draws the wallpaper, which depends on the coordinates only so any
+  // exposed part of it can be redrawn.
+  void drawBackground(FrameBuffer *fb, const Rect *rect);
+  // Draws an empty window with a title bar and returns its client area.
+  Rect drawWindow(FrameBuffer *fb, const Rect *rect);
+  // Draws a line of random text at most of the given width.
+  void drawTextLine(FrameBuffer *fb, int x, int y, int width);
+  // Draws a random glyph into the character cell.
+  void drawGlyph(FrameBuffer *fb, int x, int y);
+  void drawNoise(FrameBuffer *fb, const Rect *rect);
+  void drawPhoto(FrameBuffer *fb);
+
+  // The xorshift generator, reproducible on any platform unlike rand().
+  UINT32 nextRandom();
+  int nextRandom(int range);
+
+  Scenario m_scenario;
+  // Scenario in progress, changes in turn for MIXED.
+  Scenario m_current;
+  UINT32 m_seed;
+  UINT32 m_random;
+  UINT32 m_frame;
+
+  // Window of the text scenarios or the dragged one, its client area and
+  // the drag velocity.
+  Rect m_window;
+  Rect m_client;
+  int m_dx;
+  int m_dy;
+  // Next character cell of the typed text.
+  Point m_caret;
+  Point m_cursor;
+};
+
+#endif // __SYNTHETICWORKLOAD_H__
@@ -24,6 +24,36 @@
 
 #include "UpdateContainer.h"
 
+#include <algorithm>
+
+// Sorts rectangles of a region so that the source of each of them is
+// not overwritten by the preceding ones, see CopyMove::getRects().
+class CopyOrder
+{
+public:
+  CopyOrder(const Point *offset) : m_offset(*offset) {}
+
+  bool operator()(const Rect &a, const Rect &b) const
+  {
+    // Rectangles copied from below go from the top, and vice versa.
+    // Rectangles of the same band are ordered by the horizontal offset the
+    // same way.
+    if (a.top != b.top) {
+      return m_offset.y >= 0 ? a.top < b.top : a.top > b.top;
+    }
+    return m_offset.x >= 0 ? a.left < b.left : a.left > b.left;
+  }
+
+private:
+  Point m_offset;
+};
+
+void CopyMove::getRects(std::vector<Rect> *rects) const
+{
+  region.getRectVector(rects);
+  std::sort(rects->begin(), rects->end(), CopyOrder(&offset));
+}
+
 UpdateContainer::UpdateContainer()
 {
   clear();
@@ -35,36 +65,116 @@ UpdateContainer::~UpdateContainer(void)
 
 void UpdateContainer::clear()
 {
-  copiedRegion.clear();
+  copies.clear();
   changedRegion.clear();
   videoRegion.clear();
   screenSizeChanged = false;
   cursorPosChanged = false;
   cursorShapeChanged = false;
-  copySrc.clear();
   cursorPos.clear();
+  captureTime = 0;
 }
 
 UpdateContainer& UpdateContainer::operator=(const UpdateContainer& src)
 {
-  copiedRegion        = src.copiedRegion;
+  copies              = src.copies;
   changedRegion       = src.changedRegion;
   videoRegion         = src.videoRegion;
   screenSizeChanged   = src.screenSizeChanged;
   cursorPosChanged    = src.cursorPosChanged;
   cursorShapeChanged  = src.cursorShapeChanged;
-  copySrc             = src.copySrc;
   cursorPos           = src.cursorPos;
+  captureTime         = src.captureTime;
 
   return *this;
 }
 
+void UpdateContainer::swap(UpdateContainer *other)
+{
+  copies.swap(other->copies);
+  changedRegion.swap(&other->changedRegion);
+  videoRegion.swap(&other->videoRegion);
+  std::swap(screenSizeChanged, other->screenSizeChanged);
+  std::swap(cursorPosChanged, other->cursorPosChanged);
+  std::swap(cursorShapeChanged, other->cursorShapeChanged);
+  std::swap(cursorPos, other->cursorPos);
+  std::swap(captureTime, other->captureTime);
+}
+
+void UpdateContainer::addCaptureTime(INT64 time)
+{
+  if (time != 0 && (captureTime == 0 || time < captureTime)) {
+    captureTime = time;
+  }
+}
+
 bool UpdateContainer::isEmpty() const
 {
-  return copiedRegion.isEmpty() &&
+  return copies.empty() &&
          changedRegion.isEmpty() &&
          videoRegion.isEmpty() &&
          !screenSizeChanged &&
          !cursorPosChanged &&
          !cursorShapeChanged;
 }
+
+Region UpdateContainer::getCopiedRegion() const
+{
+  Region copiedRegion;
+  std::vector<CopyMove>::const_iterator it;
+  for (it = copies.begin(); it != copies.end(); it++) {
+    copiedRegion.add(&it->region);
+  }
+  return copiedRegion;
+}
+
+void UpdateContainer::convertCopiesToChanges()
+{
+  std::vector<CopyMove>::const_iterator it;
+  for (it = copies.begin(); it != copies.end(); it++) {
+    changedRegion.add(&it->region);
+  }
+  copies.clear();
+}
+
+bool UpdateContainer::copiesInside(const Region *region) const
+{
+  std::vector<CopyMove>::const_iterator it;
+  for (it = copies.begin(); it != copies.end(); it++) {
+    Region outside = it->region;
+    Region source = it->region;
+    source.translate(it->offset.x, it->offset.y);
+    outside.add(&source);
+    outside.subtract(region);
+    if (!outside.isEmpty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void UpdateContainer::cropCopies(const Rect *rect)
+{
+  std::vector<CopyMove>::iterator it;
+  for (it = copies.begin(); it != copies.end(); ) {
+    it->region.crop(rect);
+    if (it->region.isEmpty()) {
+      it = copies.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void UpdateContainer::subtractFromCopies(const Region *region)
+{
+  std::vector<CopyMove>::iterator it;
+  for (it = copies.begin(); it != copies.end(); ) {
+    it->region.subtract(region);
+    if (it->region.isEmpty()) {
+      it = copies.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
@@ -27,6 +27,22 @@
 
 #include "region/Region.h"
 #include "region/Point.h"
+#include "util/inttypes.h"
+
+#include <vector>
+
+// One CopyRect operation: the pixels of region are copied from the same
+// area shifted by offset.
+struct CopyMove
+{
+  Region region;
+  Point offset;
+
+  // Returns the rectangles of region in the order they can be copied one
+  // by one, so that no rectangle is copied from pixels overwritten by the
+  // previous ones.
+  void getRects(std::vector<Rect> *rects) const;
+};
 
 class UpdateContainer
 {
@@ -37,17 +53,47 @@ public:
   UpdateContainer(const UpdateContainer& updateContainer) { *this = updateContainer; }
   UpdateContainer &operator=(const UpdateContainer& src);
 
-  Region copiedRegion;
+  // CopyRect operations in the order they must be applied. A move may
+  // copy pixels produced by the previous ones. The changed region is to be
+  // applied after all of them.
+  std::vector<CopyMove> copies;
   Region changedRegion;
   Region videoRegion;
   bool screenSizeChanged;
   bool cursorPosChanged;
   bool cursorShapeChanged;
-  Point copySrc;
   Point cursorPos;
+  // QueryPerformanceCounter() time the oldest change of the container has
+  // been captured (or presented, if the screen driver knows it) at, 0 if
+  // unknown. The counter is common for all processes of the system.
+  INT64 captureTime;
 
   void clear();
   bool isEmpty() const;
+
+  // Exchanges the contents with another container without copying the
+  // regions. Used to hand the updates over instead of the assignment.
+  void swap(UpdateContainer *other);
+
+  // Keeps the earlier of the own and the given capture times, zeros are
+  // ignored.
+  void addCaptureTime(INT64 time);
+
+  // Returns the union of the destination regions of all the moves.
+  Region getCopiedRegion() const;
+
+  // Replaces the moves with changes of their destinations, which is always
+  // correct but costs sending the pixels.
+  void convertCopiesToChanges();
+
+  // Returns true if the sources and the destinations of all the moves lie
+  // inside the region.
+  bool copiesInside(const Region *region) const;
+
+  // Removes the parts of the move destinations outside the rectangle (or
+  // inside the region), and the moves becoming empty.
+  void cropCopies(const Rect *rect);
+  void subtractFromCopies(const Region *region);
 };
 
 #endif // __UPDATECONTAINER_H__
@@ -24,16 +24,17 @@
 
 #include "UpdateFilter.h"
 #include "util/CommonHeader.h"
-
-static const int BLOCK_SIZE = 32;
+#include "log-writer/ZoneProfiler.h"
 
 UpdateFilter::UpdateFilter(ScreenDriver *screenDriver,
                            FrameBuffer *frameBuffer,
                            LocalMutex *frameBufferCriticalSection,
+                           int tileSize,
                            LogWriter *log)
 : m_screenDriver(screenDriver),
   m_frameBuffer(frameBuffer),
   m_fbMutex(frameBufferCriticalSection),
+  m_tileDetector(tileSize),
   m_grabOptimizator(log),
   m_log(log)
 {
@@ -57,7 +58,8 @@ void UpdateFilter::filter(UpdateContainer *updateContainer)
   }
 
   Region toCheck = updateContainer->changedRegion;
-  toCheck.add(&updateContainer->copiedRegion);
+  Region copiedRegion = updateContainer->getCopiedRegion();
+  toCheck.add(&copiedRegion);
   toCheck.add(&updateContainer->videoRegion);
 
   std::vector<Rect> rects;
@@ -65,245 +67,80 @@ void UpdateFilter::filter(UpdateContainer *updateContainer)
 
   // Reproduce CopyRect operations in m_frameBuffer.
   m_log->debug(_T("UpdateFilter::filter : Reproduce CopyRect operations in m_frameBuffer"));
-  updateContainer->copiedRegion.getRectVector(&rects);
-  Point *src = &updateContainer->copySrc;
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    m_frameBuffer->move(&(*iRect), src->x, src->y);
+  std::vector<CopyMove>::const_iterator iMove;
+  for (iMove = updateContainer->copies.begin();
+       iMove != updateContainer->copies.end(); iMove++) {
+    iMove->getRects(&rects);
+    for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
+      m_frameBuffer->move(&(*iRect), iRect->left + iMove->offset.x,
+                          iRect->top + iMove->offset.y);
+    }
   }
 
 
   toCheck.getRectVector(&rects);
   // Grabbing
   m_log->debug(_T("grabbing region, %d rectangles"), (int)rects.size());
-  ProcessorTimes pt1 = m_log->checkPoint(_T("grabbing region"));
   try {
+    ZoneProfiler::Scope captureZone(ZoneProfiler::CAPTURE);
     m_grabOptimizator.grab(&toCheck, m_screenDriver);
   } catch (...) {
     return;
   }
-  ProcessorTimes pt2 = m_log->checkPoint(_T("end of grabbing region"));
 
   toCheck.getRectVector(&rects);
-  double area = 0.0;
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    area += (*iRect).area();
-  }
-  area /= 1000000.0; // in millions of pixels
-  double dt = pt2.wall.getTime(); // in milliseconds
-  m_log->debug(_T("Before grabbing region %f processor Mcycles, %f process time, %f kernel time, %f wall clock time "), 
-    pt1.cycle / 1000000., pt1.process, pt1.kernel, pt1.wall.getTime());
-  m_log->debug(_T("After grabbing region Mpoint grabbed: %f for %f processor Mcycles. %f ms"), 
-    area, pt2.cycle/1000000., dt);
-  m_log->debug(_T("After grabbing region %f process time, %f kernel time, %f wall clock time"), pt2.process, pt2.kernel, dt);
-
   m_log->debug(_T("end of grabbing region"));
 
-  // Filtering
-  pt1 = m_log->checkPoint(_T("filtering changed"));
-  updateContainer->changedRegion.clear();
-  Rect *rect;
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    rect = &(*iRect);
-    getChangedRegion(&updateContainer->changedRegion, rect);
-  }
+  detectScrolling(updateContainer);
 
-  // Copy actually changed pixels into m_frameBuffer.
-  updateContainer->changedRegion.getRectVector(&rects);
+  // Filtering, the actually changed pixels are copied into m_frameBuffer
+  // in the same pass.
+  ZoneProfiler::Scope filterZone(ZoneProfiler::FILTER);
+  updateContainer->changedRegion.clear();
   for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    rect = &(*iRect);
-    m_frameBuffer->copyFrom(rect, screenFrameBuffer, rect->left, rect->top);
-  }
-  pt2 = m_log->checkPoint(_T("after filtering changed"));
-  dt = pt2.wall.getTime(); // in milliseconds
-  m_log->debug(_T("Before filtering changed %f processor Mcycles, %f process time, %f kernel time, %f wall clock time "),
-    pt1.cycle / 1000000., pt1.process, pt1.kernel, pt1.wall.getTime());
-  m_log->debug(_T("After filtering changed Mpoint filtered: %f for %f processor Mcycles. %f ms"),
-    area, pt2.cycle / 1000000., dt);
-  m_log->debug(_T("After filtering changed %f process time, %f kernel time, %f wall clock time"), pt2.process, pt2.kernel, dt);
-}
-
-void UpdateFilter::getChangedRegion(Region *rgn, const Rect *rect)
-{
-  
-  const UINT bytesPerPixel = m_frameBuffer->getBytesPerPixel();
-  const int bytes_per_scanline = (rect->right - rect->left) * bytesPerPixel;
-
-  const int bytesPerRow = m_frameBuffer->getBytesPerRow();
-  const int offset = rect->top * bytesPerRow + rect->left * bytesPerPixel;
-  unsigned char *o_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  unsigned char *n_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-
-  Rect new_rect = rect;
-
-  // Fast processing for small rectangles
-  if ( rect->right - rect->left <= BLOCK_SIZE &&
-       rect->bottom - rect->top <= BLOCK_SIZE ) {
-      for (int y = rect->top; y < rect->bottom; y++) {
-        if (memcmp(o_ptr, n_ptr, bytes_per_scanline) != 0) {
-          new_rect.top = y;
-          updateChangedSubRect(rgn, &new_rect);
-          break;
-        }
-        o_ptr += bytesPerRow;
-        n_ptr += bytesPerRow;
-      }
-      return;
-  }
-
-  // Process bigger rectangles
-  new_rect.top = -1;
-  for (int y = rect->top; y < rect->bottom; y++) {
-    if (memcmp(o_ptr, n_ptr, bytes_per_scanline) != 0) {
-      if (new_rect.top == -1) {
-        new_rect.top = y;
-      }
-      // Skip a number of lines after a non-matched one
-      int n = BLOCK_SIZE / 2 - 1;
-      y += n;
-      o_ptr += n * bytesPerRow;
-      n_ptr += n * bytesPerRow;
-    } else {
-      if (new_rect.top != -1) {
-        new_rect.bottom = y;
-        updateChangedRect(rgn, &new_rect);
-        new_rect.top = -1;
-      }
+    m_dirtyRects.clear();
+    m_tileDetector.detectAndCopy(&(*iRect), m_frameBuffer, screenFrameBuffer,
+                                 &m_dirtyRects);
+    std::vector<Rect>::iterator iDirty;
+    for (iDirty = m_dirtyRects.begin(); iDirty < m_dirtyRects.end(); iDirty++) {
+      updateContainer->changedRegion.addRect(&(*iDirty));
     }
-    o_ptr += bytesPerRow;
-    n_ptr += bytesPerRow;
-  }
-  if (new_rect.top != -1) {
-    new_rect.bottom = rect->bottom;
-    updateChangedRect(rgn, &new_rect);
   }
 }
 
-void UpdateFilter::updateChangedRect(Region *rgn, const Rect *rect)
+void UpdateFilter::detectScrolling(UpdateContainer *updateContainer)
 {
-  // Pass small rectangles directly to updateChangedSubRect
-  if ( rect->right - rect->left <= BLOCK_SIZE &&
-       rect->bottom - rect->top <= BLOCK_SIZE ) {
-      updateChangedSubRect(rgn, rect);
-      return;
-  }
-
-  const UINT bytesPerPixel = m_frameBuffer->getBytesPerPixel();
-
-  Rect new_rect;
-  int x, y, ay;
-
-  // Scan down the rectangle
-  const int bytesPerRow = m_frameBuffer->getBytesPerRow();
-  const int offset = rect->top * bytesPerRow + rect->left * bytesPerPixel;
-  unsigned char *o_topleft_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  unsigned char *n_topleft_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-
-  for (y = rect->top; y < rect->bottom; y += BLOCK_SIZE)
-  {
-    // Work out way down the bitmap
-    unsigned char *o_row_ptr = o_topleft_ptr;
-    unsigned char *n_row_ptr = n_topleft_ptr;
-
-    const int blockbottom = min(y + BLOCK_SIZE, rect->bottom);
-    new_rect.bottom = blockbottom;
-    new_rect.left = -1;
-
-    for (x = rect->left; x < rect->right; x += BLOCK_SIZE)
-    {
-      // Work our way across the row
-      unsigned char *n_block_ptr = n_row_ptr;
-      unsigned char *o_block_ptr = o_row_ptr;
-
-      const UINT blockright = min(x + BLOCK_SIZE, rect->right);
-      const UINT bytesPerBlockRow = (blockright-x) * bytesPerPixel;
-
-      // Scan this block
-      for (ay = y; ay < blockbottom; ay++) {
-        if (memcmp(n_block_ptr, o_block_ptr, bytesPerBlockRow) != 0)
-          break;
-        n_block_ptr += bytesPerRow;
-        o_block_ptr += bytesPerRow;
-      }
-      if (ay < blockbottom) {
-        // There were changes, so this block will need to be updated
-        if (new_rect.left == -1) {
-          new_rect.left = x;
-          new_rect.top = ay;
-        } else if (ay < new_rect.top) {
-          new_rect.top = ay;
-        }
-      } else {
-        // No changes in this block, process previous changed blocks if any
-        if (new_rect.left != -1) {
-          new_rect.right = x;
-          updateChangedSubRect(rgn, &new_rect);
-          new_rect.left = -1;
-        }
-      }
-
-      o_row_ptr += bytesPerBlockRow;
-      n_row_ptr += bytesPerBlockRow;
-    }
-
-    if (new_rect.left != -1) {
-      new_rect.right = rect->right;
-      updateChangedSubRect(rgn, &new_rect);
-    }
-
-    o_topleft_ptr += bytesPerRow * BLOCK_SIZE;
-    n_topleft_ptr += bytesPerRow * BLOCK_SIZE;
-  }
-}
-
-void UpdateFilter::updateChangedSubRect(Region *rgn, const Rect *rect)
-{
-  const UINT bytesPerPixel = m_frameBuffer->getBytesPerPixel();
-  int bytes_in_row = (rect->right - rect->left) * bytesPerPixel;
-  int y, i;
-
-  // Exclude unchanged scan lines at the bottom
-  const int bytesPerRow = m_frameBuffer->getBytesPerRow();
-  int offset = (rect->bottom - 1) * bytesPerRow + rect->left * bytesPerPixel;
-  unsigned char *o_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  unsigned char *n_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-  Rect final_rect = rect;
-  final_rect.bottom = rect->top + 1;
-  for (y = rect->bottom - 1; y > rect->top; y--) {
-    if (memcmp(o_ptr, n_ptr, bytes_in_row) != 0) {
-      final_rect.bottom = y + 1;
-      break;
-    }
-    n_ptr -= bytesPerRow;
-    o_ptr -= bytesPerRow;
-  }
-
-  // Exclude unchanged pixels at left and right sides
-  offset = final_rect.top * bytesPerRow + final_rect.left * bytesPerPixel;
-  o_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  n_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-  int left_delta = bytes_in_row - 1;
-  int right_delta = 0;
-  for (y = final_rect.top; y < final_rect.bottom; y++) {
-    for (i = 0; i < bytes_in_row - 1; i++) {
-      if (n_ptr[i] != o_ptr[i]) {
-        if (i < left_delta)
-          left_delta = i;
-        break;
+  // Check the biggest changed rectangles, scrolling usually repaints the
+  // whole scrolled area at once.
+  std::vector<Rect> rects;
+  updateContainer->changedRegion.getRectVector(&rects);
+  std::vector<Rect>::iterator iRect;
+  for (int i = 0; i < MAX_SCROLL_AREAS && !rects.empty(); i++) {
+    std::vector<Rect>::iterator biggest = rects.begin();
+    for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
+      if (iRect->area() > biggest->area()) {
+        biggest = iRect;
       }
     }
-    for (i = bytes_in_row - 1; i > 0; i--) {
-      if (n_ptr[i] != o_ptr[i]) {
-        if (i > right_delta)
-          right_delta = i;
-        break;
-      }
+    Rect area = *biggest;
+    rects.erase(biggest);
+
+    Rect copyRect;
+    Point source;
+    if (!m_scrollDetector.detect(m_frameBuffer, m_screenDriver->getScreenBuffer(),
+                                 &area, &copyRect, &source)) {
+      continue;
     }
-    n_ptr += bytesPerRow;
-    o_ptr += bytesPerRow;
+    m_log->debug(_T("Scrolling detected: (%d,%d) %dx%d from (%d,%d)"),
+                 copyRect.left, copyRect.top,
+                 copyRect.getWidth(), copyRect.getHeight(),
+                 source.x, source.y);
+    // Reproduce the move in m_frameBuffer, so that only the uncovered part
+    // of the area will be found changed.
+    m_frameBuffer->move(&copyRect, source.x, source.y);
+    CopyMove move;
+    move.region.addRect(&copyRect);
+    move.offset.setPoint(source.x - copyRect.left, source.y - copyRect.top);
+    updateContainer->copies.push_back(move);
   }
-  final_rect.right = final_rect.left + right_delta / bytesPerPixel + 1;
-  final_rect.left += left_delta / bytesPerPixel;
-
-  // Update the rectangle
-  rgn->addRect(&final_rect);
 }
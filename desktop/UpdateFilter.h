@@ -31,6 +31,8 @@
 #include "thread/LocalMutex.h"
 #include "UpdateContainer.h"
 #include "GrabOptimizator.h"
+#include "DirtyTileDetector.h"
+#include "ScrollDetector.h"
 
 class UpdateFilter
 {
@@ -38,15 +40,19 @@ public:
   UpdateFilter(ScreenDriver *screenDriver,
                FrameBuffer *frameBuffer,
                LocalMutex *frameBufferCriticalSection,
+               int tileSize,
                LogWriter *log);
   ~UpdateFilter();
 
   void filter(UpdateContainer *updateContainer);
 
 private:
-  void getChangedRegion(Region *rgn, const Rect *rect);
-  void updateChangedRect(Region *rgn, const Rect *rect);
-  void updateChangedSubRect(Region *rgn, const Rect *rect);
+  // Finds scrolled content in the changed region and turns it into a
+  // CopyRect operation (see ScrollDetector).
+  void detectScrolling(UpdateContainer *updateContainer);
+
+  // Maximum number of changed rectangles checked for scrolling per update.
+  static const int MAX_SCROLL_AREAS = 4;
 
   // This function update the screen grabber frame buffer.
   // If success the function returns the true.
@@ -58,6 +64,9 @@ private:
   FrameBuffer *m_frameBuffer;
   LocalMutex *m_fbMutex;
   GrabOptimizator m_grabOptimizator;
+  DirtyTileDetector m_tileDetector;
+  ScrollDetector m_scrollDetector;
+  std::vector<Rect> m_dirtyRects;
 
   LogWriter *m_log;
 };
@@ -25,6 +25,7 @@
 #include "UpdateHandler.h"
 
 UpdateHandler::UpdateHandler()
+: m_fbLocMut(_T("UpdateHandler::m_fbLocMut"))
 {
 }
 
@@ -45,7 +46,7 @@ bool UpdateHandler::updateExternalFrameBuffer(FrameBuffer *fb, const Region *reg
   return updateExternalFrameBuffer(fb, &m_backupFrameBuffer, region, viewPort);
 }
 
-bool UpdateHandler::updateExternalFrameBuffer(FrameBuffer *dstFb, FrameBuffer *srcFb,
+bool UpdateHandler::updateExternalFrameBuffer(FrameBuffer *dstFb, const FrameBuffer *srcFb,
                                               const Region *region,
                                               const Rect *viewPort)
 {
@@ -57,7 +58,13 @@ bool UpdateHandler::updateExternalFrameBuffer(FrameBuffer *dstFb, FrameBuffer *s
 
   if (!dstPf.isEqualTo(&srcPf) || !dstFbDim.isEqualTo(&Dimension(&resultViewPort)) ||
       !resultViewPort.isEqualTo(viewPort)) {
-    dstFb->setProperties(&resultViewPort, &srcPf);
+    // The pixels kept at their places are valid unless the caller refreshes
+    // the whole frame buffer anyway.
+    if (dstPf.isEqualTo(&srcPf)) {
+      dstFb->resizeKeepingContents(&Dimension(&resultViewPort));
+    } else {
+      dstFb->setProperties(&resultViewPort, &srcPf);
+    }
     return false;
   }
 
@@ -35,6 +35,7 @@
 #include "UpdateListener.h"
 #include "UpdateDetector.h"
 #include "CopyRectDetector.h"
+#include "CaptureStatistics.h"
 #include "desktop-ipc/BlockingGate.h"
 
 class UpdateHandler
@@ -61,7 +62,7 @@ public:
 
   // This function unconventionally set to update pending of the frame buffer
   // in the next time call of the extract() function. All found changes
-  // saves to the changedRegion and copiedRegion.
+  // saves to the changedRegion and copies.
   virtual void setFullUpdateRequested(const Region *region) = 0;
 
   // Checking a region for updates.
@@ -71,9 +72,24 @@ public:
   virtual bool checkForUpdates(Region *region) = 0;
 
   // Set a region excluded from the region that updates detects.
-  // excludedRegion will never be present in changedRegion or copiedRegion.
+  // excludedRegion will never be present in changedRegion or copies.
   virtual void setExcludedRegion(const Region *excludedRegion) = 0;
 
+  // Limits the screen grabbing and the comparing to the region watched by
+  // the clients, a null pointer means the whole screen.
+  virtual void setCaptureRegion(const Region *captureRegion) = 0;
+
+  // Turns off the visual effects of the VisualEffectsUtil level and
+  // restores the other ones.
+  virtual void setVisualEffectsLevel(int level) = 0;
+
+  // Pauses the screen grabbing while no client can accept updates and
+  // resumes it when demanded is true again.
+  virtual void setCaptureDemand(bool demanded) = 0;
+
+  // Fills stats with the screen capture counters.
+  virtual void getCaptureStatistics(CaptureStatistics *stats) = 0;
+
   // The function provides access to FrameBuffer data.
   // The data usage be able until next extract() function call.
   // Return:
@@ -101,7 +117,7 @@ public:
     return m_backupFrameBuffer.getPixelFormat();
   }
 
-  void initFrameBuffer(const FrameBuffer *newFb);
+  virtual void initFrameBuffer(const FrameBuffer *newFb);
 
   virtual bool updateExternalFrameBuffer(FrameBuffer *fb, const Region *region,
                                          const Rect *viewPort);
@@ -111,7 +127,7 @@ public:
   virtual void sendInit(BlockingGate *gate) {}
 
 protected:
-  virtual bool updateExternalFrameBuffer(FrameBuffer *dstFb, FrameBuffer *srcFb,
+  virtual bool updateExternalFrameBuffer(FrameBuffer *dstFb, const FrameBuffer *srcFb,
                                          const Region *region,
                                          const Rect *viewPort);
 
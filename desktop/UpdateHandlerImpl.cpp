@@ -23,13 +23,21 @@
 //
 
 #include "UpdateHandlerImpl.h"
+#include "server-config-lib/Configurator.h"
+#include "log-writer/FrameTrace.h"
+#include "log-writer/StallWatchdog.h"
+#include "CaptureCounters.h"
+#include "DisplayChangeWatcher.h"
 
 UpdateHandlerImpl::UpdateHandlerImpl(UpdateListener *externalUpdateListener, ScreenDriverFactory *scrDriverFactory,
                                      LogWriter *log)
 : m_externalUpdateListener(externalUpdateListener),
   m_fullUpdateRequested(false),
-  m_log(log)
+  m_log(log),
+  m_visualEffects(log)
 {
+  FrameTrace::getInstance()->setEnabled(
+    Configurator::getInstance()->getServerConfig()->isFrameTraceEnabled());
   m_screenDriver = scrDriverFactory->createScreenDriver(&m_updateKeeper,
                                                         this,
                                                         &m_backupFrameBuffer,
@@ -39,13 +47,20 @@ UpdateHandlerImpl::UpdateHandlerImpl(UpdateListener *externalUpdateListener, Scr
   m_updateKeeper.setBorderRect(&m_screenDriver->getScreenDimension().getRect());
   m_updateFilter = new UpdateFilter(m_screenDriver,
                                     &m_backupFrameBuffer,
-                                    &m_fbLocMut, log);
+                                    &m_fbLocMut,
+                                    Configurator::getInstance()->getServerConfig()->getDirtyTileSize(),
+                                    log);
+
+  // Senders must see valid frame buffer properties from the beginning,
+  // the content will be published with the first full screen update.
+  m_absoluteRect = m_backupFrameBuffer.getDimension().getRect();
+  Region fullRegion(m_absoluteRect);
+  publishFrame(&fullRegion);
 
   // At this point all common resources will be covered the mutex for changes.
   m_screenDriver->executeDetection();
 
   // Force first update with full screen grab
-  m_absoluteRect = m_backupFrameBuffer.getDimension().getRect();
   m_updateKeeper.addChangedRect(&m_absoluteRect);
   doUpdate();
 }
@@ -53,12 +68,24 @@ UpdateHandlerImpl::UpdateHandlerImpl(UpdateListener *externalUpdateListener, Scr
 UpdateHandlerImpl::~UpdateHandlerImpl()
 {
   m_screenDriver->terminateDetection();
+  if (FrameTrace::getInstance()->isEnabled()) {
+    StringStorage logDir;
+    Configurator::getInstance()->getServerConfig()->getLogFileDir(&logDir);
+    FrameTrace::getInstance()->exportToDir(logDir.getString());
+  }
   delete m_updateFilter;
   delete m_screenDriver;
 }
 
+void UpdateHandlerImpl::getCaptureStatistics(CaptureStatistics *stats)
+{
+  CaptureCounters::getInstance()->getStatistics(stats);
+}
+
 void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
 {
+  FrameTrace::Span extractSpan(FrameTrace::EXTRACT);
+  StallWatchdog::Activity extractActivity(StallWatchdog::EXTRACT);
   Rect copyRect;
   Point copySrc;
   m_log->debug(_T("UpdateHandlerImpl: getCopiedRegion"));
@@ -79,9 +106,33 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
   Region fbRect(getFrameBufferDimension().getRect());
   m_log->debug(_T("UpdateHandlerImpl: intersect"));
   updateContainer->videoRegion.intersect(&fbRect);
+  Region captureRegion;
+  if (m_updateKeeper.getCaptureRegion(&captureRegion)) {
+    updateContainer->videoRegion.intersect(&captureRegion);
+  }
   
   m_log->debug(_T("UpdateHandlerImpl::extract : filter updates"));
-  m_updateFilter->filter(updateContainer);
+  {
+    FrameTrace::Span filterSpan(FrameTrace::FILTER);
+    m_updateFilter->filter(updateContainer);
+  }
+  std::vector<Rect> changedRects;
+  updateContainer->changedRegion.getRectVector(&changedRects);
+  CaptureCounters::getInstance()->onDirtyArea(Rect::totalArea(changedRects));
+
+  // The detector needs the really changed pixels, so it goes after the
+  // filter, and its region is used since this update.
+  if (Configurator::getConfigSnapshot()->isAutoVideoDetectionEnabled()) {
+    m_videoDetector.onChanges(&updateContainer->changedRegion,
+                              &m_backupFrameBuffer);
+    Region autoVideoRegion;
+    m_videoDetector.getVideoRegion(&autoVideoRegion);
+    autoVideoRegion.intersect(&fbRect);
+    if (m_updateKeeper.getCaptureRegion(&captureRegion)) {
+      autoVideoRegion.intersect(&captureRegion);
+    }
+    updateContainer->videoRegion.add(&autoVideoRegion);
+  }
 
   if (!m_absoluteRect.isEmpty()) {
     updateContainer->changedRegion.addRect(&m_screenDriver->getScreenBuffer()->
@@ -97,6 +148,9 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
     Dimension newDimension = m_screenDriver->getScreenDimension();
     if (m_screenDriver->getScreenSizeChanged() || !currentDimension.isEqualTo(&newDimension)) {
       updateContainer->screenSizeChanged = true;
+      // The capture follows the input desktop, the window of the watcher
+      // may have missed the change.
+      DisplayChangeWatcher::reportChange();
     }
     m_log->debug(_T("UpdateHandlerImpl::extract: old dims: (%d,%d), new dims: (%d,%d)"), 
       currentDimension.width,
@@ -105,18 +159,36 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
       newDimension.height);
     m_log->debug(_T("UpdateHandlerImpl::extract : applyNewScreenProperties()"));
     applyNewScreenProperties();
+    const FrameBuffer *screenBuffer = m_screenDriver->getScreenBuffer();
+    bool keepPixels = m_backupFrameBuffer.getPixelFormat().isEqualTo(
+      &screenBuffer->getPixelFormat());
     {
       // Only this place the class provides frame buffer changings, and then why it
       // must be under the mutex. Getters for the backup frame buffer in here (at this function)
       // can work without the mutex, but other getters for the frame buffer in other places
       // may be invoked from other threads and then it shall cover by the mutex.
       AutoLock al(&m_fbLocMut);
-      m_backupFrameBuffer.clone(m_screenDriver->getScreenBuffer());
+      if (keepPixels) {
+        keepPixels = m_backupFrameBuffer.resizeKeepingContents(
+          &screenBuffer->getDimension());
+      }
+      if (!keepPixels) {
+        m_backupFrameBuffer.clone(screenBuffer);
+      }
     }
     updateContainer->changedRegion.clear();
-    updateContainer->copiedRegion.clear();
-    m_absoluteRect = m_backupFrameBuffer.getDimension().getRect();
-    m_updateKeeper.setBorderRect(&m_absoluteRect);
+    updateContainer->copies.clear();
+    Rect screenRect = m_backupFrameBuffer.getDimension().getRect();
+    m_updateKeeper.setBorderRect(&screenRect);
+    if (keepPixels) {
+      // A resize usually leaves most of the picture in place (docking,
+      // an RDP console resize), so the whole screen goes through the filter
+      // with the next grab and only the differing pixels are reported.
+      m_updateKeeper.addChangedRect(&screenRect);
+      doUpdate();
+    } else {
+      m_absoluteRect = screenRect;
+    }
   }
 
   // Cursor position must always be present.
@@ -135,9 +207,35 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
 
     m_fullUpdateRequested = false;
   }
+
+  // The backup frame buffer is changed only by the filter (moves of the
+  // copies and the changed pixels) or cloned entirely when screen
+  // properties have been changed, then m_absoluteRect is not empty.
+  Region publishRegion = updateContainer->changedRegion;
+  Region copiedRegion = updateContainer->getCopiedRegion();
+  publishRegion.add(&copiedRegion);
+  publishRegion.addRect(&m_absoluteRect);
+  publishFrame(&publishRegion);
   m_log->debug(_T("UpdateHandlerImpl::extract finished"));
 }
 
+void UpdateHandlerImpl::publishFrame(const Region *changedRegion)
+{
+  // Only the current thread changes m_backupFrameBuffer, so reading it here
+  // does not require m_fbLocMut.
+  m_frameExchange.publish(&m_backupFrameBuffer, changedRegion);
+  m_log->debug(_T("UpdateHandlerImpl: published frame generation %u"),
+               (unsigned int)m_frameExchange.getGeneration());
+}
+
+bool UpdateHandlerImpl::updateExternalFrameBuffer(FrameBuffer *fb, const Region *region,
+                                                  const Rect *viewPort)
+{
+  FrameExchange::Reader frame(&m_frameExchange);
+  return UpdateHandler::updateExternalFrameBuffer(fb, frame.getFrameBuffer(),
+                                                  region, viewPort);
+}
+
 void UpdateHandlerImpl::applyNewScreenProperties()
 {
   int applyTryCount = 3;
@@ -156,6 +254,27 @@ void UpdateHandlerImpl::applyNewScreenProperties()
   }
 }
 
+void UpdateHandlerImpl::initFrameBuffer(const FrameBuffer *newFb)
+{
+  UpdateHandler::initFrameBuffer(newFb);
+
+  // Other properties will be handled by the extract() function as a screen
+  // properties change.
+  if (m_absoluteRect.isEmpty() ||
+      !m_backupFrameBuffer.isEqualTo(m_screenDriver->getScreenBuffer())) {
+    return;
+  }
+  m_log->info(_T("UpdateHandlerImpl: the frame buffer of the clients is")
+              _T(" taken, only changed tiles will be sent"));
+  Region fullRegion(m_absoluteRect);
+  m_absoluteRect.clear();
+  publishFrame(&fullRegion);
+  // The full screen rect is still in the update keeper, so the next grab
+  // goes through the tile filter.
+  m_updateKeeper.addChangedRegion(&fullRegion);
+  doUpdate();
+}
+
 void UpdateHandlerImpl::setFullUpdateRequested(const Region *region)
 {
   m_updateKeeper.addChangedRegion(region);
@@ -177,9 +296,7 @@ void UpdateHandlerImpl::terminateDetectors()
 
 void UpdateHandlerImpl::onUpdate()
 {
-  UpdateContainer updCont;
-  m_updateKeeper.getUpdateContainer(&updCont);
-  if (!updCont.isEmpty()) {
+  if (!m_updateKeeper.isEmpty()) {
     doUpdate();
   }
 }
@@ -193,3 +310,37 @@ void UpdateHandlerImpl::setExcludedRegion(const Region *excludedRegion)
 {
   m_updateKeeper.setExcludedRegion(excludedRegion);
 }
+
+void UpdateHandlerImpl::setVisualEffectsLevel(int level)
+{
+  m_visualEffects.setLevel(level);
+}
+
+void UpdateHandlerImpl::setCaptureDemand(bool demanded)
+{
+  m_log->debug(demanded ? _T("Screen capture is resumed")
+                        : _T("Screen capture is paused, no client is ready"));
+  m_screenDriver->setCaptureDemand(demanded);
+}
+
+void UpdateHandlerImpl::setCaptureRegion(const Region *captureRegion)
+{
+  Region prevRegion;
+  bool wasLimited = m_updateKeeper.getCaptureRegion(&prevRegion);
+  m_updateKeeper.setCaptureRegion(captureRegion);
+  if (!wasLimited) {
+    return;
+  }
+  // The pixels out of the previous capture region have not been watched
+  // and must be checked again.
+  Region newRegion;
+  if (captureRegion != 0) {
+    newRegion = *captureRegion;
+  } else {
+    newRegion.addRect(&getFrameBufferDimension().getRect());
+  }
+  newRegion.subtract(&prevRegion);
+  if (!newRegion.isEmpty()) {
+    m_updateKeeper.addChangedRegion(&newRegion);
+  }
+}
@@ -28,6 +28,9 @@
 #include "UpdateHandler.h"
 #include "ScreenDriver.h"
 #include "ScreenDriverFactory.h"
+#include "FrameExchange.h"
+#include "VisualEffectsUtil.h"
+#include "VideoRegionDetector.h"
 
 // This class contain a base architecture implementation of the UpdateHandler class.
 class UpdateHandlerImpl : public UpdateHandler, public UpdateListener
@@ -42,6 +45,22 @@ public:
   bool checkForUpdates(Region *region);
 
   virtual void setExcludedRegion(const Region *excludedRegion);
+  virtual void setCaptureRegion(const Region *captureRegion);
+  virtual void setVisualEffectsLevel(int level);
+  virtual void setCaptureDemand(bool demanded);
+
+  virtual void getCaptureStatistics(CaptureStatistics *stats);
+
+  // Takes the frame buffer that clients already have (sent by the service
+  // after a desktop switch or a restart of this process). If it matches the
+  // screen, the first full screen grab is compared with it tile by tile and
+  // only the really changed pixels are reported instead of the whole screen.
+  virtual void initFrameBuffer(const FrameBuffer *newFb);
+
+  // Copies the region from the last published frame, so the copying never
+  // waits for the screen grabbing that is done under m_fbLocMut.
+  virtual bool updateExternalFrameBuffer(FrameBuffer *fb, const Region *region,
+                                         const Rect *viewPort);
 
 private:
   virtual void executeDetectors();
@@ -58,15 +77,25 @@ private:
 
   void applyNewScreenProperties();
 
+  // Publishes m_backupFrameBuffer for the update senders. The
+  // changedRegion must cover all pixels of m_backupFrameBuffer changed
+  // since the previous call.
+  void publishFrame(const Region *changedRegion);
+
   UpdateKeeper m_updateKeeper;
   ScreenDriver *m_screenDriver;
   UpdateFilter *m_updateFilter;
+  FrameExchange m_frameExchange;
+  VideoRegionDetector m_videoDetector;
   UpdateListener *m_externalUpdateListener;
 
   Rect m_absoluteRect;
 
   LogWriter *m_log;
 
+  // Declared after m_log, the effects are restored on the destruction.
+  VisualEffectsUtil m_visualEffects;
+
   bool m_fullUpdateRequested;
 };
 
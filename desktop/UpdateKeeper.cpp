@@ -24,11 +24,19 @@
 
 #include "UpdateKeeper.h"
 
+static INT64 getCurrentCaptureTime()
+{
+  LARGE_INTEGER now;
+  return QueryPerformanceCounter(&now) ? now.QuadPart : 0;
+}
+
 UpdateKeeper::UpdateKeeper()
+: m_captureRegionEnabled(false)
 {
 }
 
 UpdateKeeper::UpdateKeeper(const Rect *borderRect)
+: m_captureRegionEnabled(false)
 {
   m_borderRect.setRect(borderRect);
 }
@@ -41,9 +49,10 @@ void UpdateKeeper::addChangedRegion(const Region *changedRegion)
 {
   AutoLock al(&m_updContLocMut);
 
-  // FIXME: Calling subtract() function is correct if use
-  // copy region instead of copy rectangle.
-  //m_updateContainer.copiedRegion.subtract(changedRegion);
+  if (m_updateContainer.captureTime == 0 && !changedRegion->isEmpty()) {
+    m_updateContainer.captureTime = getCurrentCaptureTime();
+  }
+  // Changed pixels are sent after the moves, so the moves stay valid.
   m_updateContainer.changedRegion.add(changedRegion);
   m_updateContainer.changedRegion.crop(&m_borderRect);
 }
@@ -56,78 +65,69 @@ void UpdateKeeper::addChangedRect(const Rect *changedRect)
 
 void UpdateKeeper::addCopyRect(const Rect *copyRect, const Point *src)
 {
-  AutoLock al(&m_updContLocMut);
-
   if (copyRect->isEmpty()) {
     return;
   }
+  Region copyRegion(copyRect);
+  Point offset(src->x - copyRect->left, src->y - copyRect->top);
+  addCopyRegion(&copyRegion, &offset);
+}
 
-  Region *changedRegion = &m_updateContainer.changedRegion;
-  Region *copiedRegion = &m_updateContainer.copiedRegion;
-  Point *copySrc = &m_updateContainer.copySrc;
-  Rect dstCopyRect(copyRect);
-
-  // Create copy of copyRect in the source coordinates.
-  Rect srcCopyRect(copyRect);
-  srcCopyRect.setLocation(src->x, src->y);
-
-  // Clipping dstCopyRect
-  dstCopyRect = dstCopyRect.intersection(&m_borderRect);
-  // Correcting source coordinates
-  srcCopyRect.left    += dstCopyRect.left - copyRect->left;
-  srcCopyRect.top     += dstCopyRect.top - copyRect->top;
-  srcCopyRect.right   += dstCopyRect.right - copyRect->right;
-  srcCopyRect.bottom  += dstCopyRect.bottom - copyRect->bottom;
-  // Clipping srcCopyRect
-  Rect dummySrcCopyRect(&srcCopyRect);
-  srcCopyRect = srcCopyRect.intersection(&m_borderRect);
-  // Correcting destination coordinates
-  dstCopyRect.left    += srcCopyRect.left - dummySrcCopyRect.left;
-  dstCopyRect.top     += srcCopyRect.top - dummySrcCopyRect.top;
-  dstCopyRect.right   += srcCopyRect.right - dummySrcCopyRect.right;
-  dstCopyRect.bottom  += srcCopyRect.bottom - dummySrcCopyRect.bottom;
-
-  if (dstCopyRect.isEmpty()) {
+void UpdateKeeper::addCopyRegion(const Region *copyRegion, const Point *offset)
+{
+  AutoLock al(&m_updContLocMut);
+
+  if (copyRegion->isEmpty() || (offset->x == 0 && offset->y == 0)) {
     return;
   }
 
-  copySrc->x = srcCopyRect.left;
-  copySrc->y = srcCopyRect.top;
+  Region *changedRegion = &m_updateContainer.changedRegion;
 
-  // Adding difference between clipped dstCopyRect and original copyRect
+  // Only pixels with both the source and the destination inside the border
+  // can be copied.
+  Region dstRegion = *copyRegion;
+  dstRegion.crop(&m_borderRect);
+  Region srcInBorder(&m_borderRect);
+  srcInBorder.translate(-offset->x, -offset->y);
+  dstRegion.intersect(&srcInBorder);
+
+  // Adding difference between clipped dstRegion and original copyRegion
   // to changedRegion. Because without update detectors this information
   // loses irretrievably.
-  Region diff(copyRect);
-  Region dstCopyRegion(&dstCopyRect);
-  diff.subtract(&dstCopyRegion);
+  Region diff = *copyRegion;
+  diff.subtract(&dstRegion);
   addChangedRegion(&diff);
 
-  // Old copiedRegion must be added to changedRegion - (?)
-  if (!copiedRegion->isEmpty()) {
-    changedRegion->add(copiedRegion);
-    copiedRegion->clear();
-    addChangedRect(copyRect);
+  if (dstRegion.isEmpty()) {
     return;
   }
 
-  copiedRegion->clear();
-  copiedRegion->addRect(&dstCopyRect);
-
-  // copiedRegion must be substracted from changedRegion
-  changedRegion->subtract(copiedRegion);
+  // Too many moves cost more than they save, and make the regions
+  // fragmented.
+  if (m_updateContainer.copies.size() >= MAX_COPIES) {
+    m_updateContainer.convertCopiesToChanges();
+  }
 
-  // Create region that is intersection of changedRegion and srcCopyRect.
-  Region addonChangedRegion(&srcCopyRect);
+  // The client will copy the changed pixels of the source before they are
+  // updated, so they must be updated at the destination as well. Other
+  // pixels of the destination come with the copy.
+  Region addonChangedRegion = dstRegion;
+  addonChangedRegion.translate(offset->x, offset->y);
   addonChangedRegion.intersect(changedRegion);
-
-  // Move addonChangedRegion and add it to changedRegion.
-  addonChangedRegion.translate(dstCopyRect.left - copySrc->x,
-                               dstCopyRect.top - copySrc->y);
+  addonChangedRegion.translate(-offset->x, -offset->y);
+  changedRegion->subtract(&dstRegion);
   changedRegion->add(&addonChangedRegion);
 
+  if (m_updateContainer.captureTime == 0) {
+    m_updateContainer.captureTime = getCurrentCaptureTime();
+  }
+  CopyMove move;
+  move.region = dstRegion;
+  move.offset = *offset;
+  m_updateContainer.copies.push_back(move);
+
   // Clipping regions
   m_updateContainer.changedRegion.crop(&m_borderRect);
-  m_updateContainer.copiedRegion.crop(&m_borderRect);
 }
 
 void UpdateKeeper::setBorderRect(const Rect *borderRect)
@@ -161,19 +161,27 @@ void UpdateKeeper::setCursorShapeChanged()
   m_updateContainer.cursorShapeChanged = true;
 }
 
+void UpdateKeeper::setCaptureTime(INT64 time)
+{
+  AutoLock al(&m_updContLocMut);
+  m_updateContainer.addCaptureTime(time);
+}
+
 void UpdateKeeper::addUpdateContainer(const UpdateContainer *updateContainer)
 {
   AutoLock al(&m_updContLocMut);
 
-  // FIXME: Use addCopyRegion instead of addCopyRect
-  // Add copied region
-  std::vector<Rect> rects;
-  std::vector<Rect>::iterator iRect;
-  updateContainer->copiedRegion.getRectVector(&rects);
-  size_t numRects = rects.size();
-  if (numRects > 0) {
-    iRect = rects.begin();
-    addCopyRect(&(*iRect), &updateContainer->copySrc);
+  // The changes keep the time they have been captured at.
+  if (!updateContainer->changedRegion.isEmpty() ||
+      !updateContainer->copies.empty()) {
+    m_updateContainer.addCaptureTime(updateContainer->captureTime);
+  }
+
+  // Add the moves in their order.
+  std::vector<CopyMove>::const_iterator iMove;
+  for (iMove = updateContainer->copies.begin();
+       iMove != updateContainer->copies.end(); iMove++) {
+    addCopyRegion(&iMove->region, &iMove->offset);
   }
 
   // Add changed region
@@ -186,7 +194,6 @@ void UpdateKeeper::addUpdateContainer(const UpdateContainer *updateContainer)
   if (updateContainer->screenSizeChanged) {
     setScreenSizeChanged();
   }
-  setCursorPos(&updateContainer->cursorPos);
   if (updateContainer->cursorPosChanged) {
     setCursorPos(&updateContainer->cursorPos);
   }
@@ -201,21 +208,28 @@ void UpdateKeeper::getUpdateContainer(UpdateContainer *updCont)
   *updCont = m_updateContainer;
 }
 
-bool UpdateKeeper::checkForUpdates(const Region *region)
+bool UpdateKeeper::isEmpty()
 {
-  UpdateContainer updateContainer;
-  getUpdateContainer(&updateContainer);
+  AutoLock al(&m_updContLocMut);
+  return m_updateContainer.isEmpty();
+}
 
-  Region resultRegion = updateContainer.changedRegion;
-  resultRegion.add(&updateContainer.copiedRegion);
+bool UpdateKeeper::checkForUpdates(const Region *region)
+{
+  Region resultRegion;
+  {
+    AutoLock al(&m_updContLocMut);
+    if (m_updateContainer.cursorPosChanged ||
+        m_updateContainer.cursorShapeChanged ||
+        m_updateContainer.screenSizeChanged) {
+      return true;
+    }
+    resultRegion = m_updateContainer.getCopiedRegion();
+    resultRegion.add(&m_updateContainer.changedRegion);
+  }
   resultRegion.intersect(region);
 
-  bool result = updateContainer.cursorPosChanged ||
-                updateContainer.cursorShapeChanged ||
-                updateContainer.screenSizeChanged ||
-                !resultRegion.isEmpty();
-
-  return result;
+  return !resultRegion.isEmpty();
 }
 
 void UpdateKeeper::extract(UpdateContainer *updateContainer)
@@ -225,15 +239,28 @@ void UpdateKeeper::extract(UpdateContainer *updateContainer)
 
     // Clipping regions
     m_updateContainer.changedRegion.crop(&m_borderRect);
-    m_updateContainer.copiedRegion.crop(&m_borderRect);
+    m_updateContainer.cropCopies(&m_borderRect);
 
-    *updateContainer = m_updateContainer;
+    // The updates are handed over, the previous content of the caller's
+    // container is dropped with the clear().
+    updateContainer->swap(&m_updateContainer);
     m_updateContainer.clear();
   }
   {
     AutoLock al(&m_exclRegLocMut);
     updateContainer->changedRegion.subtract(&m_excludedRegion);
-    updateContainer->copiedRegion.subtract(&m_excludedRegion);
+    updateContainer->subtractFromCopies(&m_excludedRegion);
+  }
+  {
+    AutoLock al(&m_captRegLocMut);
+    if (m_captureRegionEnabled) {
+      // A move from or to the pixels not captured cannot be reproduced in
+      // the backup frame buffer, and the moves depend on each other.
+      if (!updateContainer->copiesInside(&m_captureRegion)) {
+        updateContainer->convertCopiesToChanges();
+      }
+      updateContainer->changedRegion.intersect(&m_captureRegion);
+    }
   }
 }
 
@@ -247,3 +274,25 @@ void UpdateKeeper::setExcludedRegion(const Region *excludedRegion)
     m_excludedRegion = *excludedRegion;
   }
 }
+
+void UpdateKeeper::setCaptureRegion(const Region *captureRegion)
+{
+  AutoLock al(&m_captRegLocMut);
+
+  m_captureRegionEnabled = captureRegion != 0;
+  if (captureRegion == 0) {
+    m_captureRegion.clear();
+  } else {
+    m_captureRegion = *captureRegion;
+  }
+}
+
+bool UpdateKeeper::getCaptureRegion(Region *captureRegion)
+{
+  AutoLock al(&m_captRegLocMut);
+
+  if (m_captureRegionEnabled) {
+    *captureRegion = m_captureRegion;
+  }
+  return m_captureRegionEnabled;
+}
@@ -56,7 +56,12 @@ public:
     addChangedRect(&m_borderRect);
   }
 
+  // Adds a move of copyRect from the src point. The move is applied after
+  // the moves added before, the changed region is corrected so that the
+  // result of all the moves and the changes stays right.
   void addCopyRect(const Rect *copyRect, const Point *src);
+  // Adds a move of copyRegion from the same region shifted by offset.
+  void addCopyRegion(const Region *copyRegion, const Point *offset);
 
   void setBorderRect(const Rect *borderRect);
 
@@ -64,21 +69,42 @@ public:
   void setCursorPosChanged();
   void setCursorPos(const Point *curPos);
   void setCursorShapeChanged();
+  // Sets the capture time of the updates if it is earlier than the time
+  // they have, see UpdateContainer::captureTime. The changes added without
+  // the time get the current time.
+  void setCaptureTime(INT64 time);
 
   void setExcludedRegion(const Region *excludedRegion);
 
+  // Limits the extracted updates to the capture region, the pixels out of
+  // it are watched by no client. A null pointer means the whole screen.
+  void setCaptureRegion(const Region *captureRegion);
+  // Copies the capture region to captureRegion and returns true, or returns
+  // false if the whole screen is captured.
+  bool getCaptureRegion(Region *captureRegion);
+
   void addUpdateContainer(const UpdateContainer *updateContainer);
   void getUpdateContainer(UpdateContainer *updCont);
+  // Returns true if there are no updates, without copying them.
+  bool isEmpty();
   bool checkForUpdates(const Region *region);
 
   void extract(UpdateContainer *updateContainer);
 
 private:
+  // Maximum number of moves kept, the older moves are converted to changes
+  // when a new one does not fit.
+  static const size_t MAX_COPIES = 16;
+
   Rect m_borderRect;
 
   Region m_excludedRegion;
   LocalMutex m_exclRegLocMut;
 
+  Region m_captureRegion;
+  bool m_captureRegionEnabled;
+  LocalMutex m_captRegLocMut;
+
   UpdateContainer m_updateContainer;
   LocalMutex m_updContLocMut;
 };
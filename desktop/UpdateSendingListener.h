@@ -27,6 +27,7 @@
 
 #include "rfb/CursorShape.h"
 #include "rfb/FrameBuffer.h"
+#include "region/Region.h"
 #include "UpdateContainer.h"
 
 class UpdateSendingListener
@@ -36,6 +37,12 @@ public:
   virtual void onSendUpdate(const UpdateContainer *updateContainer,
                             const CursorShape *cursorShape) = 0;
   virtual bool isReadyToSend() = 0;
+  // Puts to captureRegion the union of the frame buffer parts watched by
+  // the clients. Returns false if the whole frame buffer must be captured.
+  virtual bool getCaptureRegion(const Dimension *fbDimension,
+                                Region *captureRegion) = 0;
+  // Returns the VisualEffectsUtil level needed by the slowest client.
+  virtual int getVisualEffectsLevel() = 0;
 };
 
 #endif // __UPDATESENDINGLISTENER_H__
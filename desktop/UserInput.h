@@ -49,6 +49,10 @@ public:
   // the rfb protocol.
   virtual void setMouseEvent(const Point newPos, UINT8 keyFlag) = 0;
   virtual void setKeyboardEvent(UINT32 keySym, bool down) = 0;
+  // The mouse and keyboard events set between these calls may be held back
+  // and applied together by endInputBatch(), in the same order.
+  virtual void beginInputBatch() {}
+  virtual void endInputBatch() {}
   virtual void getCurrentUserInfo(StringStorage *desktopName,
                                   StringStorage *userName) = 0;
 
@@ -59,6 +63,9 @@ public:
   virtual void getNormalizedRect(Rect *rect) = 0;
 
   virtual void getWindowCoords(HWND hwnd, Rect *rect) = 0;
+  // Sets rect to the coordinates of the foreground window, empty if there
+  // is no foreground window.
+  virtual void getForegroundWindowCoords(Rect *rect) = 0;
   virtual HWND getWindowHandleByName(const StringStorage *windowName) = 0;
 
   virtual void getApplicationRegion(unsigned int procId, Region *region) = 0;
@@ -0,0 +1,285 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "VideoRegionDetector.h"
+
+#include <math.h>
+
+const double VideoRegionDetector::MIN_ENTROPY = 2.5;
+
+VideoRegionDetector::VideoRegionDetector()
+: m_columns(0),
+  m_rows(0),
+  m_passes(0),
+  m_extractions(0),
+  m_windowStart(DateTime::now())
+{
+}
+
+VideoRegionDetector::~VideoRegionDetector()
+{
+}
+
+void VideoRegionDetector::reset(const Dimension *screenDim)
+{
+  m_screenDim = *screenDim;
+  m_columns = (screenDim->width + TILE_SIZE - 1) / TILE_SIZE;
+  m_rows = (screenDim->height + TILE_SIZE - 1) / TILE_SIZE;
+  m_changeCounts.assign(m_columns * m_rows, 0);
+  m_hot.assign(m_columns * m_rows, false);
+  m_lastCounted.assign(m_columns * m_rows, 0);
+  m_extractions = 0;
+  m_windowChanges.clear();
+  m_passes = 0;
+  m_windowStart = DateTime::now();
+  m_tracks.clear();
+  m_videoRegion.clear();
+}
+
+void VideoRegionDetector::onChanges(const Region *changedRegion,
+                                    const FrameBuffer *fb)
+{
+  Dimension screenDim = fb->getDimension();
+  if (!screenDim.isEqualTo(&m_screenDim)) {
+    reset(&screenDim);
+  }
+
+  std::vector<Rect> rects;
+  changedRegion->getRectVector(&rects);
+  // A tile is counted once per extraction however many rects touch it.
+  m_extractions++;
+  for (std::vector<Rect>::const_iterator iRect = rects.begin();
+       iRect != rects.end(); iRect++) {
+    int firstColumn = iRect->left / TILE_SIZE;
+    int lastColumn = (iRect->right - 1) / TILE_SIZE;
+    int firstRow = iRect->top / TILE_SIZE;
+    int lastRow = (iRect->bottom - 1) / TILE_SIZE;
+    for (int iRow = firstRow; iRow <= lastRow && iRow < m_rows; iRow++) {
+      for (int iCol = firstColumn; iCol <= lastColumn && iCol < m_columns; iCol++) {
+        int index = iRow * m_columns + iCol;
+        if (m_lastCounted[index] != m_extractions &&
+            m_changeCounts[index] < 0xffff) {
+          m_lastCounted[index] = m_extractions;
+          m_changeCounts[index]++;
+        }
+      }
+    }
+  }
+  m_windowChanges.add(changedRegion);
+  m_passes++;
+
+  unsigned int elapsed = (unsigned int)(DateTime::now() - m_windowStart).getTime();
+  if (elapsed >= WINDOW_TIME) {
+    finishWindow(fb, elapsed);
+    m_changeCounts.assign(m_changeCounts.size(), 0);
+    m_windowChanges.clear();
+    m_passes = 0;
+    m_windowStart = DateTime::now();
+  }
+}
+
+void VideoRegionDetector::getVideoRegion(Region *videoRegion) const
+{
+  *videoRegion = m_videoRegion;
+}
+
+void VideoRegionDetector::finishWindow(const FrameBuffer *fb, unsigned int elapsed)
+{
+  for (size_t i = 0; i < m_changeCounts.size(); i++) {
+    unsigned int count = m_changeCounts[i];
+    m_hot[i] = count * 1000 >= MIN_FPS * elapsed ||
+               (m_passes >= MIN_PASSES && count * 4 >= m_passes * 3);
+  }
+
+  std::vector<Rect> found;
+  for (int iRow = 0; iRow < m_rows; iRow++) {
+    for (int iCol = 0; iCol < m_columns; iCol++) {
+      if (m_hot[iRow * m_columns + iCol]) {
+        Rect rect = takeGroup(iCol, iRow, fb);
+        if (!rect.isEmpty()) {
+          found.push_back(rect);
+        }
+      }
+    }
+  }
+  updateTracks(&found);
+}
+
+Rect VideoRegionDetector::takeGroup(int column, int row, const FrameBuffer *fb)
+{
+  // Flood fill of the hot tiles, the taken ones are cleared.
+  std::vector<int> stack(1, row * m_columns + column);
+  m_hot[row * m_columns + column] = false;
+  int minColumn = column, maxColumn = column;
+  int minRow = row, maxRow = row;
+  int tileCount = 0;
+  double entropySum = 0.0;
+  while (!stack.empty()) {
+    int index = stack.back();
+    stack.pop_back();
+    int iCol = index % m_columns;
+    int iRow = index / m_columns;
+    tileCount++;
+    Rect tileRect = getTileRect(iCol, iRow);
+    entropySum += getTileEntropy(fb, &tileRect);
+    if (iCol < minColumn) minColumn = iCol;
+    if (iCol > maxColumn) maxColumn = iCol;
+    if (iRow < minRow) minRow = iRow;
+    if (iRow > maxRow) maxRow = iRow;
+
+    const int neighbours[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+    for (int i = 0; i < 4; i++) {
+      int nCol = iCol + neighbours[i][0];
+      int nRow = iRow + neighbours[i][1];
+      if (nCol >= 0 && nCol < m_columns && nRow >= 0 && nRow < m_rows &&
+          m_hot[nRow * m_columns + nCol]) {
+        m_hot[nRow * m_columns + nCol] = false;
+        stack.push_back(nRow * m_columns + nCol);
+      }
+    }
+  }
+
+  int boxTiles = (maxColumn - minColumn + 1) * (maxRow - minRow + 1);
+  if (tileCount * 100 < boxTiles * MIN_DENSITY ||
+      entropySum / tileCount < MIN_ENTROPY) {
+    return Rect();
+  }
+  // The changed pixels give the exact bounds, the tiles are coarser.
+  Rect lastTile = getTileRect(maxColumn, maxRow);
+  Rect box = getTileRect(minColumn, minRow).unionRect(&lastTile);
+  Region changes(box);
+  changes.intersect(&m_windowChanges);
+  Rect bounds = changes.getBounds();
+  if (bounds.getWidth() < MIN_WIDTH || bounds.getHeight() < MIN_HEIGHT) {
+    return Rect();
+  }
+  return bounds;
+}
+
+void VideoRegionDetector::updateTracks(const std::vector<Rect> *rects)
+{
+  std::vector<bool> matched(m_tracks.size(), false);
+  for (std::vector<Rect>::const_iterator iRect = rects->begin();
+       iRect != rects->end(); iRect++) {
+    bool isNew = true;
+    for (size_t i = 0; i < m_tracks.size(); i++) {
+      if (!matched[i] && overlaps(&m_tracks[i].rect, &(*iRect))) {
+        matched[i] = true;
+        m_tracks[i].rect = *iRect;
+        m_tracks[i].found++;
+        m_tracks[i].missed = 0;
+        if (m_tracks[i].found >= ENTER_WINDOWS) {
+          m_tracks[i].active = true;
+        }
+        isNew = false;
+        break;
+      }
+    }
+    if (isNew) {
+      Track track;
+      track.rect = *iRect;
+      track.found = 1;
+      track.missed = 0;
+      track.active = ENTER_WINDOWS <= 1;
+      m_tracks.push_back(track);
+      matched.push_back(true);
+    }
+  }
+
+  std::vector<Track> tracks;
+  m_videoRegion.clear();
+  for (size_t i = 0; i < m_tracks.size(); i++) {
+    Track track = m_tracks[i];
+    if (!matched[i]) {
+      track.found = 0;
+      track.missed++;
+      // A candidate is forgotten at once, a video after LEAVE_WINDOWS.
+      if (!track.active || track.missed >= LEAVE_WINDOWS) {
+        continue;
+      }
+    }
+    if (track.active) {
+      m_videoRegion.addRect(&track.rect);
+    }
+    tracks.push_back(track);
+  }
+  m_tracks.swap(tracks);
+}
+
+double VideoRegionDetector::getTileEntropy(const FrameBuffer *fb, const Rect *tileRect)
+{
+  // Brightness of every fourth pixel in both directions, 16 levels.
+  const PixelFormat &pf = fb->getPixelFormat();
+  int bytesPerPixel = fb->getBytesPerPixel();
+  int histogram[16] = { 0 };
+  int samples = 0;
+  for (int y = tileRect->top; y < tileRect->bottom; y += 4) {
+    const UINT8 *row = (const UINT8 *)fb->getBufferPtr(tileRect->left, y);
+    for (int x = tileRect->left; x < tileRect->right; x += 4) {
+      const UINT8 *pixel = row + (x - tileRect->left) * bytesPerPixel;
+      UINT32 value;
+      switch (bytesPerPixel) {
+      case 1:
+        value = *pixel;
+        break;
+      case 2:
+        value = *(const UINT16 *)pixel;
+        break;
+      default:
+        value = *(const UINT32 *)pixel;
+        break;
+      }
+      unsigned int r = ((value >> pf.redShift) & pf.redMax) * 255 / (pf.redMax ? pf.redMax : 1);
+      unsigned int g = ((value >> pf.greenShift) & pf.greenMax) * 255 / (pf.greenMax ? pf.greenMax : 1);
+      unsigned int b = ((value >> pf.blueShift) & pf.blueMax) * 255 / (pf.blueMax ? pf.blueMax : 1);
+      unsigned int luma = (r * 2 + g * 5 + b) >> 3;
+      histogram[luma >> 4]++;
+      samples++;
+    }
+  }
+  double entropy = 0.0;
+  for (int i = 0; i < 16; i++) {
+    if (histogram[i] != 0) {
+      double p = (double)histogram[i] / samples;
+      entropy -= p * log(p);
+    }
+  }
+  return entropy / log(2.0);
+}
+
+Rect VideoRegionDetector::getTileRect(int column, int row) const
+{
+  Rect rect(column * TILE_SIZE, row * TILE_SIZE,
+            (column + 1) * TILE_SIZE, (row + 1) * TILE_SIZE);
+  Rect screenRect = m_screenDim.getRect();
+  return rect.intersection(&screenRect);
+}
+
+bool VideoRegionDetector::overlaps(const Rect *a, const Rect *b)
+{
+  // A video that moved a little or changed its size is the same video.
+  int common = a->intersection(b).area();
+  int smaller = a->area() < b->area() ? a->area() : b->area();
+  return common * 2 >= smaller;
+}
@@ -0,0 +1,122 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __VIDEOREGIONDETECTOR_H__
+#define __VIDEOREGIONDETECTOR_H__
+
+#include <vector>
+
+#include "region/Region.h"
+#include "rfb/FrameBuffer.h"
+#include "util/DateTime.h"
+#include "util/inttypes.h"
+
+// VideoRegionDetector finds video on the screen without configuration. It
+// counts how often every screen tile changes in the extracted updates and,
+// once per WINDOW_TIME, looks for groups of tiles changing at a video frame
+// rate. A group becomes a video rectangle if it is large and dense enough
+// and its pixels look like a picture rather than text (by the entropy of
+// their brightness). A rectangle must be found in ENTER_WINDOWS windows in
+// a row to be reported and is kept until it is missed in LEAVE_WINDOWS
+// windows in a row, so the video region doesn't flicker.
+//
+// The class is not thread-safe, it's used by the thread extracting updates.
+class VideoRegionDetector
+{
+public:
+  VideoRegionDetector();
+  virtual ~VideoRegionDetector();
+
+  // Accounts the changes of one extraction. The fb frame buffer must
+  // contain the pixels after the changes.
+  void onChanges(const Region *changedRegion, const FrameBuffer *fb);
+
+  // Returns the detected video rectangles.
+  void getVideoRegion(Region *videoRegion) const;
+
+  static const int TILE_SIZE = 32;
+
+private:
+  struct Track
+  {
+    Rect rect;
+    // Windows in a row the rectangle has been found or missed in.
+    int found;
+    int missed;
+    bool active;
+  };
+
+  void reset(const Dimension *screenDim);
+
+  // Finds the video rectangles by the counters of the ended window and
+  // updates the tracks with them.
+  void finishWindow(const FrameBuffer *fb, unsigned int elapsed);
+  // Collects the tile group the tile belongs to and returns its
+  // rectangle in pixels or an empty rect if it doesn't look like video.
+  Rect takeGroup(int column, int row, const FrameBuffer *fb);
+  void updateTracks(const std::vector<Rect> *rects);
+
+  // Returns the entropy of the brightness of sampled tile pixels in bits,
+  // from 0 to 4.
+  static double getTileEntropy(const FrameBuffer *fb, const Rect *tileRect);
+
+  Rect getTileRect(int column, int row) const;
+
+  static bool overlaps(const Rect *a, const Rect *b);
+
+  Dimension m_screenDim;
+  int m_columns;
+  int m_rows;
+
+  // Extractions of the window each tile has changed in.
+  std::vector<UINT16> m_changeCounts;
+  // Number of the last extraction counted for each tile.
+  std::vector<UINT32> m_lastCounted;
+  UINT32 m_extractions;
+  // Set for the tiles changing fast enough in the ended window.
+  std::vector<bool> m_hot;
+  // Changes of the window, for the exact bounds of the video.
+  Region m_windowChanges;
+  unsigned int m_passes;
+  DateTime m_windowStart;
+
+  std::vector<Track> m_tracks;
+  Region m_videoRegion;
+
+  static const unsigned int WINDOW_TIME = 1000;
+  // A tile is hot if it changes this many times a second, or in 3 of 4
+  // extractions when there are at least MIN_PASSES of them, so video is
+  // found for clients receiving fewer frames too.
+  static const unsigned int MIN_FPS = 10;
+  static const unsigned int MIN_PASSES = 4;
+  static const int MIN_WIDTH = 128;
+  static const int MIN_HEIGHT = 96;
+  // Hot tiles of a group in percents of the tiles of its bounding box.
+  static const int MIN_DENSITY = 60;
+  static const double MIN_ENTROPY;
+  static const int ENTER_WINDOWS = 2;
+  static const int LEAVE_WINDOWS = 3;
+};
+
+#endif // __VIDEOREGIONDETECTOR_H__
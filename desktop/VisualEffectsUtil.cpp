@@ -0,0 +1,206 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "VisualEffectsUtil.h"
+#include "win-system/AutoImpersonator.h"
+#include "util/Exception.h"
+
+VisualEffectsUtil::VisualEffectsUtil(LogWriter *log)
+: m_savedMinAnimate(0),
+  m_isMinAnimateChanged(false),
+  m_level(LEVEL_FULL),
+  m_log(log)
+{
+  addSetting(LEVEL_REDUCED, SPI_GETCLIENTAREAANIMATION,
+             SPI_SETCLIENTAREAANIMATION, false);
+  addSetting(LEVEL_REDUCED, SPI_GETMENUANIMATION, SPI_SETMENUANIMATION, false);
+  addSetting(LEVEL_REDUCED, SPI_GETCOMBOBOXANIMATION,
+             SPI_SETCOMBOBOXANIMATION, false);
+  addSetting(LEVEL_REDUCED, SPI_GETLISTBOXSMOOTHSCROLLING,
+             SPI_SETLISTBOXSMOOTHSCROLLING, false);
+  addSetting(LEVEL_REDUCED, SPI_GETTOOLTIPANIMATION,
+             SPI_SETTOOLTIPANIMATION, false);
+  addSetting(LEVEL_REDUCED, SPI_GETSELECTIONFADE, SPI_SETSELECTIONFADE, false);
+  addSetting(LEVEL_REDUCED, SPI_GETDROPSHADOW, SPI_SETDROPSHADOW, false);
+  addSetting(LEVEL_REDUCED, SPI_GETCURSORSHADOW, SPI_SETCURSORSHADOW, false);
+  addSetting(LEVEL_REDUCED, SPI_GETDRAGFULLWINDOWS, SPI_SETDRAGFULLWINDOWS,
+             true);
+  addSetting(LEVEL_MINIMAL, SPI_GETFONTSMOOTHING, SPI_SETFONTSMOOTHING, true);
+}
+
+VisualEffectsUtil::~VisualEffectsUtil()
+{
+  if (m_level != LEVEL_FULL) {
+    applyLevel(LEVEL_FULL);
+  }
+}
+
+void VisualEffectsUtil::addSetting(int level, UINT getAction, UINT setAction,
+                                   bool byUiParam)
+{
+  Setting setting;
+  setting.level = level;
+  setting.getAction = getAction;
+  setting.setAction = setAction;
+  setting.byUiParam = byUiParam;
+  setting.savedValue = FALSE;
+  setting.isChanged = false;
+  m_settings.push_back(setting);
+}
+
+void VisualEffectsUtil::setLevel(int level)
+{
+  if (level < LEVEL_FULL) {
+    level = LEVEL_FULL;
+  } else if (level > LEVEL_MINIMAL) {
+    level = LEVEL_MINIMAL;
+  }
+  if (level != m_level) {
+    applyLevel(level);
+  }
+}
+
+void VisualEffectsUtil::applyLevel(int level)
+{
+  m_log->info(_T("Changing the visual effects level from %d to %d"),
+              m_level, level);
+  try {
+    Impersonator imp(m_log);
+    AutoImpersonator ai(&imp, m_log);
+
+    int failures = 0;
+    for (std::vector<Setting>::iterator iter = m_settings.begin();
+         iter != m_settings.end(); iter++) {
+      bool success = true;
+      if (level >= iter->level) {
+        success = turnOff(&*iter);
+      } else {
+        success = restore(&*iter);
+      }
+      if (!success) {
+        failures++;
+      }
+    }
+    bool success = level >= LEVEL_REDUCED ? turnOffMinAnimate()
+                                          : restoreMinAnimate();
+    if (!success) {
+      failures++;
+    }
+    if (failures != 0) {
+      m_log->error(_T("Can't change %d of the visual effects settings"),
+                   failures);
+    }
+  } catch (Exception &e) {
+    m_log->error(_T("Can't change the visual effects: %s"), e.getMessage());
+  }
+  // The level is changed even on the failures, they aren't retried.
+  m_level = level;
+}
+
+bool VisualEffectsUtil::turnOff(Setting *setting)
+{
+  if (setting->isChanged) {
+    return true;
+  }
+  BOOL value = FALSE;
+  if (SystemParametersInfo(setting->getAction, 0, &value, 0) == 0) {
+    return false;
+  }
+  if (!value) {
+    // It is off already, nothing to restore.
+    return true;
+  }
+  if (!setValue(setting, FALSE)) {
+    return false;
+  }
+  setting->savedValue = value;
+  setting->isChanged = true;
+  return true;
+}
+
+bool VisualEffectsUtil::restore(Setting *setting)
+{
+  if (!setting->isChanged) {
+    return true;
+  }
+  setting->isChanged = false;
+  return setValue(setting, setting->savedValue);
+}
+
+bool VisualEffectsUtil::setValue(const Setting *setting, BOOL value)
+{
+  BOOL result;
+  if (setting->byUiParam) {
+    result = SystemParametersInfo(setting->setAction, value, 0, 0);
+  } else {
+    result = SystemParametersInfo(setting->setAction, 0,
+                                  (PVOID)(INT_PTR)value, 0);
+  }
+  if (result == 0) {
+    return false;
+  }
+  // SPIF_SENDCHANGE would wait for every top-level window, so the change is
+  // only posted to them.
+  SendNotifyMessage(HWND_BROADCAST, WM_SETTINGCHANGE, setting->setAction, 0);
+  return true;
+}
+
+bool VisualEffectsUtil::turnOffMinAnimate()
+{
+  if (m_isMinAnimateChanged) {
+    return true;
+  }
+  ANIMATIONINFO info;
+  info.cbSize = sizeof(info);
+  if (SystemParametersInfo(SPI_GETANIMATION, sizeof(info), &info, 0) == 0) {
+    return false;
+  }
+  if (info.iMinAnimate == 0) {
+    return true;
+  }
+  m_savedMinAnimate = info.iMinAnimate;
+  info.iMinAnimate = 0;
+  if (SystemParametersInfo(SPI_SETANIMATION, sizeof(info), &info, 0) == 0) {
+    return false;
+  }
+  SendNotifyMessage(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETANIMATION, 0);
+  m_isMinAnimateChanged = true;
+  return true;
+}
+
+bool VisualEffectsUtil::restoreMinAnimate()
+{
+  if (!m_isMinAnimateChanged) {
+    return true;
+  }
+  m_isMinAnimateChanged = false;
+  ANIMATIONINFO info;
+  info.cbSize = sizeof(info);
+  info.iMinAnimate = m_savedMinAnimate;
+  if (SystemParametersInfo(SPI_SETANIMATION, sizeof(info), &info, 0) == 0) {
+    return false;
+  }
+  SendNotifyMessage(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETANIMATION, 0);
+  return true;
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __VISUALEFFECTSUTIL_H__
+#define __VISUALEFFECTSUTIL_H__
+
+#include "log-writer/LogWriter.h"
+
+#include <vector>
+
+// Turns off the visual effects which inflate the changed regions and spoil
+// the palette encodings while clients are connected, and restores them.
+// The settings are changed for the current session only, they are not
+// saved to the user profile, so they come back after a logoff even if the
+// server fails to restore them.
+class VisualEffectsUtil
+{
+public:
+  // Nothing is turned off.
+  static const int LEVEL_FULL = 0;
+  // Window, menu and list animations, window contents while dragging,
+  // drop shadows and fading are turned off.
+  static const int LEVEL_REDUCED = 1;
+  // Font smoothing is turned off as well.
+  static const int LEVEL_MINIMAL = 2;
+
+  VisualEffectsUtil(LogWriter *log);
+  // Restores all the changed settings.
+  virtual ~VisualEffectsUtil();
+
+  // Turns off the effects of the level and restores the other ones.
+  void setLevel(int level);
+
+private:
+  // A boolean setting, FALSE turns the effect off.
+  struct Setting
+  {
+    // Level from which the setting is turned off.
+    int level;
+    UINT getAction;
+    UINT setAction;
+    // The set action takes the value via uiParam if true, otherwise via
+    // pvParam, the get actions always fill a BOOL at pvParam.
+    bool byUiParam;
+
+    // Original value, valid if isChanged.
+    BOOL savedValue;
+    bool isChanged;
+  };
+
+  void addSetting(int level, UINT getAction, UINT setAction, bool byUiParam);
+
+  // Changes the settings with the impersonated user, logs the failures.
+  void applyLevel(int level);
+  bool turnOff(Setting *setting);
+  bool restore(Setting *setting);
+  bool setValue(const Setting *setting, BOOL value);
+
+  // The classic minimize and maximize animation has its own structure and
+  // is handled separately from the boolean settings.
+  bool turnOffMinAnimate();
+  bool restoreMinAnimate();
+
+  std::vector<Setting> m_settings;
+  int m_savedMinAnimate;
+  bool m_isMinAnimateChanged;
+
+  int m_level;
+
+  LogWriter *m_log;
+};
+
+#endif // __VISUALEFFECTSUTIL_H__
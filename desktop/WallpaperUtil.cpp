@@ -58,9 +58,13 @@ void WallpaperUtil::updateWallpaper()
   try {
     ServerConfig *srvConf = Configurator::getInstance()->getServerConfig();
     if (srvConf->isRemovingDesktopWallpaperEnabled()) {
-      disableWallpaper();
-      m_wasDisabled = true;
-      m_log->info(_T("Wallpaper was successfully disabled"));
+      // Disabling it again would save the empty path instead of the user's
+      // one, which then could not be restored.
+      if (!m_wasDisabled) {
+        disableWallpaper();
+        m_wasDisabled = true;
+        m_log->info(_T("Wallpaper was successfully disabled"));
+      }
     } else {
       if (m_wasDisabled) {
         restoreWallpaper();
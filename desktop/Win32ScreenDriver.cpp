@@ -30,10 +30,14 @@ Win32ScreenDriver::Win32ScreenDriver(UpdateKeeper *updateKeeper,
                                      FrameBuffer *fb,
                                      LocalMutex *fbLocalMutex, LogWriter *log)
 : Win32ScreenDriverBaseImpl(updateKeeper, updateListener, fbLocalMutex, log),
-  m_poller(updateKeeper, updateListener, &m_screenGrabber, fb, fbLocalMutex, log),
-  m_consolePoller(updateKeeper, updateListener, &m_screenGrabber, fb, fbLocalMutex, log),
-  m_hooks(updateKeeper, updateListener, log)
+  m_poller(updateKeeper, getIdleBackoff(), getDetectionScheduler(), this,
+           &m_screenGrabber, fb, fbLocalMutex, log),
+  m_consolePoller(updateKeeper, getIdleBackoff(), getDetectionScheduler(),
+                  &m_screenGrabber, fb, fbLocalMutex, log),
+  m_hooks(updateKeeper, getIdleBackoff(), getDetectionScheduler(), log)
 {
+  m_poller.setIdleBackoff(getIdleBackoff());
+  m_consolePoller.setIdleBackoff(getIdleBackoff());
   // At this point the screen driver has valid screen properties (provides by screen grabber).
 }
 
@@ -45,24 +49,28 @@ Win32ScreenDriver::~Win32ScreenDriver()
 void Win32ScreenDriver::executeDetection()
 {
   Win32ScreenDriverBaseImpl::executeDetection();
-  m_poller.resume();
-  m_consolePoller.resume();
+  m_poller.start();
+  m_consolePoller.start();
   m_hooks.resume();
 }
 
 void Win32ScreenDriver::terminateDetection()
 {
-  m_poller.terminate();
-  m_consolePoller.terminate();
   m_hooks.terminate();
 
+  m_poller.stop();
+  m_consolePoller.stop();
   Win32ScreenDriverBaseImpl::terminateDetection();
 
-  m_poller.wait();
-  m_consolePoller.wait();
   m_hooks.wait();
 }
 
+void Win32ScreenDriver::setCaptureDemand(bool demanded)
+{
+  m_poller.setCaptureDemand(demanded);
+  m_consolePoller.setCaptureDemand(demanded);
+}
+
 Dimension Win32ScreenDriver::getScreenDimension()
 {
   AutoLock al(getFbMutex());
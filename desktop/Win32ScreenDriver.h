@@ -53,6 +53,9 @@ public:
   virtual bool getScreenSizeChanged();
   virtual bool applyNewScreenProperties();
 
+  // Pauses the polling, the hooks keep only collecting the changed region.
+  virtual void setCaptureDemand(bool demanded);
+
 private:
   // This class provides thread safed coordinations between the backup frame buffer and
   // the following objects.
@@ -31,9 +31,14 @@ Win32ScreenDriverBaseImpl::Win32ScreenDriverBaseImpl(UpdateKeeper *updateKeeper,
                                                  LogWriter *log)
 : WinVideoRegionUpdaterImpl(log),
   m_fbLocalMutex(fbLocalMutex),
-  m_cursorPosDetector(updateKeeper, updateListener, log),
-  m_curShapeDetector(updateKeeper, updateListener, &m_curShapeGrabber, fbLocalMutex, log)
+  m_detectionScheduler(DETECTION_THREADS, true),
+  m_idleBackoff(updateListener, &m_detectionScheduler),
+  m_cursorPosDetector(updateKeeper, &m_idleBackoff, &m_detectionScheduler, log),
+  m_curShapeDetector(updateKeeper, &m_idleBackoff, &m_detectionScheduler,
+                     &m_curShapeGrabber, fbLocalMutex, log)
 {
+  m_cursorPosDetector.setIdleBackoff(&m_idleBackoff);
+  m_curShapeDetector.setIdleBackoff(&m_idleBackoff);
 }
 
 Win32ScreenDriverBaseImpl::~Win32ScreenDriverBaseImpl()
@@ -43,17 +48,14 @@ Win32ScreenDriverBaseImpl::~Win32ScreenDriverBaseImpl()
 
 void Win32ScreenDriverBaseImpl::executeDetection()
 {
-  m_cursorPosDetector.resume();
-  m_curShapeDetector.resume();
+  m_cursorPosDetector.start();
+  m_curShapeDetector.start();
 }
 
 void Win32ScreenDriverBaseImpl::terminateDetection()
 {
-  m_cursorPosDetector.terminate();
-  m_curShapeDetector.terminate();
-
-  m_cursorPosDetector.wait();
-  m_curShapeDetector.wait();
+  m_cursorPosDetector.stop();
+  m_curShapeDetector.stop();
 }
 
 LocalMutex *Win32ScreenDriverBaseImpl::getFbMutex()
@@ -61,6 +63,16 @@ LocalMutex *Win32ScreenDriverBaseImpl::getFbMutex()
   return m_fbLocalMutex;
 }
 
+TaskScheduler *Win32ScreenDriverBaseImpl::getDetectionScheduler()
+{
+  return &m_detectionScheduler;
+}
+
+IdleBackoff *Win32ScreenDriverBaseImpl::getIdleBackoff()
+{
+  return &m_idleBackoff;
+}
+
 bool Win32ScreenDriverBaseImpl::grabCursorShape(const PixelFormat *pf)
 {
   // Grabbing under the mutex avoid us from grab void cursor shape in time when the
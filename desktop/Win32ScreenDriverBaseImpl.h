@@ -31,6 +31,7 @@
 #include "CursorShapeDetector.h"
 #include "WindowsCursorShapeGrabber.h"
 #include "CopyRectDetector.h"
+#include "IdleBackoff.h"
 
 // This class implements "grabbers" and "detectors" which is not couple with screen frame buffer.
 class Win32ScreenDriverBaseImpl : public WinVideoRegionUpdaterImpl
@@ -57,9 +58,24 @@ public:
 protected:
   LocalMutex *getFbMutex();
 
+  // Returns the scheduler running the periodic detectors.
+  TaskScheduler *getDetectionScheduler();
+
+  // Returns the update listener the detectors must notify, it slows the
+  // periodic detectors down while the desktop is static.
+  IdleBackoff *getIdleBackoff();
+
 private:
+  // Number of threads shared by the periodic detectors, enough to keep the
+  // cursor detection going while the screen is polled.
+  static const unsigned int DETECTION_THREADS = 2;
+
   LocalMutex *m_fbLocalMutex;
 
+  // Declared before the detectors, so that it outlives them.
+  TaskScheduler m_detectionScheduler;
+  IdleBackoff m_idleBackoff;
+
   CursorPositionDetector m_cursorPosDetector;
   WindowsCursorShapeGrabber m_curShapeGrabber;
   CursorShapeDetector m_curShapeDetector;
@@ -26,6 +26,8 @@
 #include "Win32MirrorScreenDriver.h"
 #include "Win32ScreenDriver.h"
 #include "Win8ScreenDriver.h"
+#include "DummyScreenDriver.h"
+#include "CaptureCounters.h"
 
 Win32ScreenDriverFactory::Win32ScreenDriverFactory(ServerConfig *srvConf)
 : m_srvConf(srvConf)
@@ -43,11 +45,31 @@ createScreenDriver(UpdateKeeper *updateKeeper,
                    LocalMutex *fbLocalMutex,
                    LogWriter *log)
 {
+  // A synthetic workload replaces the screen completely, so it goes first.
+  StringStorage workloadName;
+  m_srvConf->getSyntheticWorkload(&workloadName);
+  if (!workloadName.isEmpty()) {
+    SyntheticWorkload::Scenario scenario;
+    if (SyntheticWorkload::parseScenario(workloadName.getString(), &scenario)) {
+      log->info(_T("Using the synthetic workload \"%s\" instead of the screen"),
+                workloadName.getString());
+      CaptureCounters::getInstance()->reset(_T("Synthetic workload"));
+      return new DummyScreenDriver(updateKeeper, updateListener, fbLocalMutex,
+                                   scenario,
+                                   m_srvConf->getSyntheticWorkloadSeed(), log);
+    }
+    log->error(_T("Unknown synthetic workload \"%s\", using the screen"),
+               workloadName.getString());
+  }
+
   // Try to use Win8 duplication API firstly because it's in preference to other methods.
   if (isD3DAllowed()) {
     log->info(_T("D3D driver usage is allowed, try to start it..."));
     try {
-      return new Win8ScreenDriver(updateKeeper, updateListener, fbLocalMutex, log);
+      ScreenDriver *driver = new Win8ScreenDriver(updateKeeper, updateListener,
+                                                  fbLocalMutex, log);
+      CaptureCounters::getInstance()->reset(_T("Desktop Duplication"));
+      return driver;
     } catch (Exception &e) {
       log->error(_T("The Win8 duplication api can't be used: %s"),
                  e.getMessage());
@@ -60,8 +82,10 @@ createScreenDriver(UpdateKeeper *updateKeeper,
   if (isMirrorDriverAllowed()) {
     log->info(_T("Mirror driver usage is allowed, try to start it..."));
     try {
-      return createMirrorScreenDriver(updateKeeper, updateListener,
-                                      fbLocalMutex, log);
+      ScreenDriver *driver = createMirrorScreenDriver(updateKeeper, updateListener,
+                                                      fbLocalMutex, log);
+      CaptureCounters::getInstance()->reset(_T("Mirror driver"));
+      return driver;
     } catch (Exception &e) {
       log->error(_T("The mirror driver factory has failed: %s"),
                  e.getMessage());
@@ -70,6 +94,7 @@ createScreenDriver(UpdateKeeper *updateKeeper,
     log->info(_T("Mirror driver usage is disallowed"));
   }
   log->info(_T("Using the standart screen driver"));
+  CaptureCounters::getInstance()->reset(_T("Polling and hooks"));
   return createStandardScreenDriver(updateKeeper,
                                     updateListener,
                                     fb,
@@ -29,6 +29,14 @@
 #include "WinDxgiAcquiredFrame.h"
 #include "WinD3D11Texture2D.h"
 #include "WinAutoMapDxgiSurface.h"
+#include "server-config-lib/Configurator.h"
+#include "log-writer/FrameTrace.h"
+#include "log-writer/ZoneProfiler.h"
+#include "log-writer/StallWatchdog.h"
+#include "CaptureCounters.h"
+#include "DisplayChangeWatcher.h"
+#include "IdleBackoff.h"
+#include "thread/SchedulingPolicy.h"
 
 #include "Win8DeskDuplicationThread.h"
 
@@ -39,29 +47,53 @@ Win8DeskDuplication::Win8DeskDuplication(FrameBuffer *targetFb,
                                                      LocalMutex *cursorMutex,
                                                      Win8DuplicationListener *duplListener,
                                                      std::vector<WinDxgiOutput> &dxgiOutput,
+                                                     size_t firstOutputIndex,
+                                                     WinDxgiAdapter *dxgiAdapter,
+                                                     UINT adapterIndex,
                                                      LogWriter *log)
 : m_targetFb(targetFb),
   m_targetRects(targetRect),
   m_targetCurShape(targetCurShape),
   m_cursorTimeStamp(cursorTimeStamp),
   m_cursorMutex(cursorMutex),
+  m_firstOutputIndex(firstOutputIndex),
+  m_adapterIndex(adapterIndex),
+  m_presentTime(0),
+  m_vblankPaced(false),
   m_duplListener(duplListener),
-  m_device(log),
+  m_device(dxgiAdapter->getDxgiAdapter(), log),
   m_hasCriticalError(false),
   m_hasRecoverableError(false),
   m_log(log)
 {
   m_log->debug(_T("Creating Win8DeskDuplication for %d outputs"), dxgiOutput.size());
+  bool gpuChangeDetection = Configurator::getInstance()->getServerConfig()->isGpuChangeDetectionEnabled();
+  m_vblankPaced = Configurator::getInstance()->getServerConfig()->isVblankPacedCaptureEnabled();
   for (size_t i = 0; i < dxgiOutput.size(); i++) {
     m_dxgiOutput1.push_back(&dxgiOutput[i]);
     m_outDupl.push_back(WinDxgiOutputDuplication(&m_dxgiOutput1[i], &m_device));
     m_rotations.push_back(dxgiOutput[i].getRotation());
+    m_desktopCoords.push_back(dxgiOutput[i].getDesktopCoordinates());
     m_stageTextures2D.push_back(WinCustomD3D11Texture2D(m_device.getDevice(),
       (UINT)targetRect[i].getWidth(),
       (UINT)targetRect[i].getHeight(),
       m_rotations[i]));
+    WinD3D11TileDiff *tileDiff = 0;
+    if (gpuChangeDetection) {
+      try {
+        tileDiff = new WinD3D11TileDiff(&m_device,
+                                        m_stageTextures2D[i].getDesc()->Width,
+                                        m_stageTextures2D[i].getDesc()->Height,
+                                        m_log);
+      } catch (Exception &e) {
+        m_log->error(_T("GPU change detection is not available: %s"), e.getMessage());
+      }
+    }
+    m_tileDiffs.push_back(tileDiff);
   }
+  m_pendingRegions.resize(m_outDupl.size());
   m_log->debug(_T("Win8DeskDuplication created"));
+  SchedulingPolicy::apply(this, SchedulingPolicy::ROLE_CAPTURE);
   resume();
 }
 
@@ -70,6 +102,9 @@ Win8DeskDuplication::~Win8DeskDuplication()
   m_log->debug(_T("deleting Win8DeskDuplication"));
   terminate();
   wait();
+  for (size_t i = 0; i < m_tileDiffs.size(); i++) {
+    delete m_tileDiffs[i];
+  }
 }
 
 bool Win8DeskDuplication::isValid()
@@ -79,38 +114,93 @@ bool Win8DeskDuplication::isValid()
 
 void Win8DeskDuplication::execute()
 {
-  const int ACQUIRE_TIMEOUT = 20;
+  // Several outputs are polled in turn with a short timeout. A single output
+  // is waited for much longer because nothing else depends on this thread,
+  // so an idle output doesn't wake the thread up needlessly. When no frame
+  // comes for IdleBackoff::IDLE_TIME, the timeout is doubled every pass up
+  // to MAX_IDLE_FACTOR times, the first frame restores it.
+  const int ACQUIRE_TIMEOUT = m_outDupl.size() > 1 ? 20 : 250;
+  const int MAX_IDLE_FACTOR = m_outDupl.size() > 1 ? 8 : 2;
+  const bool pollOutputs = m_outDupl.size() > 1;
+  LARGE_INTEGER frequency;
+  if (!QueryPerformanceFrequency(&frequency)) {
+    frequency.QuadPart = 0;
+  }
+  int acquireTimeout = ACQUIRE_TIMEOUT;
+  DateTime lastFrameTime = DateTime::now();
+  bool frameAcquired = false;
   try {
     std::vector<int> timeouts;
     std::vector<DateTime> begins;
     timeouts.resize(m_outDupl.size());
     begins.resize(m_outDupl.size());
     while (!isTerminating() && isValid()) {
+      // The demand is read once per pass so all frames of the pass are
+      // handled the same way.
+      bool demanded = m_duplListener->isCaptureDemanded();
+      if (m_vblankPaced && frameAcquired && demanded) {
+        // Frames composed within one refresh are taken as one frame right
+        // after the vertical blank, so the frames are evenly paced.
+        HRESULT hr = m_dxgiOutput1[0].getDxgiOutput1()->WaitForVBlank();
+        if (FAILED(hr)) {
+          m_log->error(_T("Can't wait for the vertical blank (%x), the capture")
+                       _T(" is not paced anymore"), (int)hr);
+          m_vblankPaced = false;
+        }
+      }
+      frameAcquired = false;
+      int timeout = acquireTimeout;
+      if (hasPendingRegions() && timeout > PENDING_ACQUIRE_TIMEOUT) {
+        timeout = PENDING_ACQUIRE_TIMEOUT;
+      }
       for (size_t i = 0; i < m_outDupl.size(); i++) {
-        {
+        try {
+          if (demanded && !m_pendingRegions[i].isEmpty()) {
+            flushPendingRegion(i);
+          }
           begins[i] = DateTime::now();
-          WinDxgiAcquiredFrame acquiredFrame(&m_outDupl[i], ACQUIRE_TIMEOUT);
+          StallWatchdog::Activity captureActivity(StallWatchdog::CAPTURE);
+          WinDxgiAcquiredFrame acquiredFrame(&m_outDupl[i], timeout);
 		      if (acquiredFrame.wasTimeOut()) {
 			      timeouts[i]++;
+			      CaptureCounters::getInstance()->onAcquireTimeout();
 			      m_log->debug(_T("Timeout on acquire frame for output: %d"), i);
-			      Thread::yield();
+			      if (pollOutputs) {
+			        Thread::yield();
+			      }
 			      continue;
           }
           else {
             DXGI_OUTDUPL_FRAME_INFO *info = acquiredFrame.getFrameInfo();
             int accum_frames = info->AccumulatedFrames;
             double dt = (double)(DateTime::now() - begins[i]).getTime(); // in milliseconds
-            m_log->debug(_T("Acquire frame for output: %d for %f ms, accumulated %d frames"), i, dt + ACQUIRE_TIMEOUT * timeouts[i], accum_frames);
+            m_log->debug(_T("Acquire frame for output: %d for %f ms, accumulated %d frames"), i, dt + timeout * timeouts[i], accum_frames);
             timeouts[i] = 0;
+            frameAcquired = true;
+            m_presentTime = info->LastPresentTime.QuadPart;
+            lastFrameTime = DateTime::now();
+            acquireTimeout = ACQUIRE_TIMEOUT;
+            CaptureCounters::getInstance()->onFrameAcquired();
+            FrameTrace::Span captureSpan(FrameTrace::CAPTURE);
+            ZoneProfiler::Scope captureZone(ZoneProfiler::CAPTURE);
             WinD3D11Texture2D acquiredDesktopImage(acquiredFrame.getDxgiResource());
 
             // Get metadata
             if (info->TotalMetadataBufferSize) {
+              LARGE_INTEGER captureBegin, captureEnd;
+              QueryPerformanceCounter(&captureBegin);
               size_t moveCount = m_outDupl[i].getFrameMoveRects(&m_moveRects);
               size_t dirtyCount = m_outDupl[i].getFrameDirtyRects(&m_dirtyRects);
 
-              processMoveRects(moveCount, i);
-              processDirtyRects(dirtyCount, &acquiredDesktopImage, i);
+              processMoveRects(moveCount, &acquiredDesktopImage, i, demanded);
+              processDirtyRects(dirtyCount, &acquiredDesktopImage, i, demanded);
+              QueryPerformanceCounter(&captureEnd);
+              UINT64 captureTime = frequency.QuadPart != 0 ?
+                (UINT64)((captureEnd.QuadPart - captureBegin.QuadPart) * 1000000 /
+                         frequency.QuadPart) : 0;
+              CaptureCounters::getInstance()->onOutputFrame(m_firstOutputIndex + i,
+                                                            m_adapterIndex,
+                                                            captureTime);
             }
 
             // Check cursor pointer for updates.
@@ -121,8 +211,20 @@ void Win8DeskDuplication::execute()
               m_log->debug(_T("Error on cursor processing: %s, (%x)"), e.getMessage(), (int)e.getErrorCode());
             } // Cursor
           }
+        } catch (WinDxRecoverableException &e) {
+          m_log->info(_T("Duplication of output %d is lost: %s, (%x)"),
+                      (int)i, e.getMessage(), (int)e.getErrorCode());
+          if (!recoverOutput(i)) {
+            throw;
+          }
         }
-        Thread::yield();
+        if (pollOutputs) {
+          Thread::yield();
+        }
+      }
+      if (acquireTimeout < ACQUIRE_TIMEOUT * MAX_IDLE_FACTOR &&
+          (DateTime::now() - lastFrameTime).getTime() >= IdleBackoff::IDLE_TIME) {
+        acquireTimeout *= 2;
       }
     }
     // FIXME: remove it all, catch exceptions in Win8ScreenDriverImpl
@@ -158,12 +260,51 @@ void Win8DeskDuplication::setRecoverableError(const TCHAR *reason)
   m_duplListener->onRecoverableError(reason);
 }
 
+bool Win8DeskDuplication::recoverOutput(size_t out)
+{
+  DateTime start = DateTime::now();
+  while (!isTerminating()) {
+    try {
+      m_outDupl[out].recreate(&m_dxgiOutput1[out], &m_device);
+
+      // A mode change keeps the access lost until the output is duplicated
+      // again, then it may turn out to be of another geometry.
+      DXGI_OUTPUT_DESC desc;
+      HRESULT hr = m_dxgiOutput1[out].getDxgiOutput1()->GetDesc(&desc);
+      if (FAILED(hr) || !desc.AttachedToDesktop ||
+          desc.Rotation != m_rotations[out] ||
+          !Rect(&desc.DesktopCoordinates).isEqualTo(&m_desktopCoords[out])) {
+        m_log->info(_T("Output %d has changed, it can't be recovered alone"), (int)out);
+        DisplayChangeWatcher::reportChange();
+        return false;
+      }
+
+      UINT64 recoveryTime = (DateTime::now() - start).getTime();
+      CaptureCounters::getInstance()->onOutputRecovered(recoveryTime);
+      m_log->info(_T("Duplication of output %d is recovered in %u ms"),
+                  (int)out, (unsigned int)recoveryTime);
+      return true;
+    } catch (WinDxRecoverableException &e) {
+      if ((DateTime::now() - start).getTime() >= RECOVERY_TIMEOUT) {
+        m_log->info(_T("Output %d is not recovered for %u ms: %s, (%x)"),
+                    (int)out, RECOVERY_TIMEOUT, e.getMessage(),
+                    (int)e.getErrorCode());
+        return false;
+      }
+    }
+    sleep(RECOVERY_RETRY_INTERVAL);
+  }
+  return false;
+}
+
 Dimension Win8DeskDuplication::getStageDimension(size_t out) const
 {
   return Dimension(m_stageTextures2D[out].getDesc()->Width, m_stageTextures2D[out].getDesc()->Height);
 }
 
-void Win8DeskDuplication::processMoveRects(size_t moveCount, size_t out)
+void Win8DeskDuplication::processMoveRects(size_t moveCount,
+                                           WinD3D11Texture2D *acquiredDesktopImage,
+                                           size_t out, bool demanded)
 {
   _ASSERT(moveCount <= m_moveRects.size());
   Rect destinationRect;
@@ -176,6 +317,22 @@ void Win8DeskDuplication::processMoveRects(size_t moveCount, size_t out)
     sourceRect = destinationRect;
     POINT srcPoint = m_moveRects[iRect].SourcePoint;
     sourceRect.setLocation(srcPoint.x, srcPoint.y);
+    if (m_tileDiffs[out] != 0) {
+      m_tileDiffs[out]->moveRect(&destinationRect, srcPoint.x, srcPoint.y);
+    }
+    if (!demanded) {
+      // The frame buffer is not moved because its source pixels may be
+      // pending, the destination is read back as changed instead.
+      Rect stageRect = getStageDimension(out).getRect();
+      Rect pendingRect = destinationRect.intersection(&stageRect);
+      if (!pendingRect.isEmpty()) {
+        m_device.copySubresourceRegion(m_stageTextures2D[out].getTexture(),
+          pendingRect.left, pendingRect.top,
+          acquiredDesktopImage->getTexture(), &pendingRect, 0, 1);
+        m_pendingRegions[out].addRect(&pendingRect);
+      }
+      continue;
+    }
     rotateRectInsideStage(&destinationRect, &getStageDimension(out), rotation);
     rotateRectInsideStage(&sourceRect, &getStageDimension(out), rotation);
     // Translate the rect and point to the frame buffer coordinates.
@@ -185,13 +342,13 @@ void Win8DeskDuplication::processMoveRects(size_t moveCount, size_t out)
     int y = sourceRect.top;
     m_targetFb->move(&destinationRect, x, y);
 
-    m_duplListener->onCopyRect(&destinationRect, x, y);
+    m_duplListener->onCopyRect(&destinationRect, x, y, m_presentTime);
   }
 }
 
 void Win8DeskDuplication::processDirtyRects(size_t dirtyCount,
                                                   WinD3D11Texture2D *acquiredDesktopImage, 
-                                                  size_t out)
+                                                  size_t out, bool demanded)
 {
   _ASSERT(dirtyCount <= m_dirtyRects.size());
 
@@ -201,8 +358,7 @@ void Win8DeskDuplication::processDirtyRects(size_t dirtyCount,
   Dimension stageDim = getStageDimension(out);
   Rect stageRect = stageDim.getRect();
 
-  DXGI_MODE_ROTATION rotation = m_rotations[out];
-
+  m_stageRects.clear();
   for (size_t iRect = 0; iRect < dirtyCount; iRect++) {
     dirtyRect.fromWindowsRect(&m_dirtyRects[iRect]);
 
@@ -218,22 +374,61 @@ void Win8DeskDuplication::processDirtyRects(size_t dirtyCount,
       throw Exception(errMess.getString());
       */
     }
+    m_stageRects.push_back(dirtyRect);
+  }
+
+  // Leave only really changed tiles of the dirty rects to read them back.
+  if (m_tileDiffs[out] != 0) {
+    m_tileDiffs[out]->filterDirtyRects(acquiredDesktopImage->getTexture(), &m_stageRects);
+  }
+
+  if (!m_stageRects.empty()) {
+    // Copy all dirty rects of the frame to the staging texture first and
+    // then map the texture once, so the GPU to CPU synchronization is done
+    // once per frame instead of once per rect.
     ID3D11Texture2D *texture = m_stageTextures2D[out].getTexture();
-    m_device.copySubresourceRegion(texture, dirtyRect.left, dirtyRect.top,
-      acquiredDesktopImage->getTexture(), &dirtyRect, 0, 1);
+    std::vector<Rect>::iterator iStageRect;
+    for (iStageRect = m_stageRects.begin(); iStageRect < m_stageRects.end(); iStageRect++) {
+      m_device.copySubresourceRegion(texture, iStageRect->left, iStageRect->top,
+        acquiredDesktopImage->getTexture(), &(*iStageRect), 0, 1);
+    }
+
+    if (!demanded) {
+      // Nobody waits for the pixels, they are read back when demanded.
+      m_pendingRegions[out].addRects(&m_stageRects);
+    } else {
+      readStagedRects(&m_stageRects, out, &changedRegion);
+    }
+  }
+
+  if (demanded) {
+    m_duplListener->onFrameBufferUpdate(&changedRegion, m_presentTime);
+  }
+}
+
+void Win8DeskDuplication::readStagedRects(const std::vector<Rect> *stageRects,
+                                          size_t out, Region *changedRegion)
+{
+  Dimension stageDim = getStageDimension(out);
+  DXGI_MODE_ROTATION rotation = m_rotations[out];
+  Rect dirtyRect;
+  ID3D11Texture2D *texture = m_stageTextures2D[out].getTexture();
+  WinDxgiSurface surface(texture);
+  WinAutoMapDxgiSurface autoMapSurface(&surface, DXGI_MAP_READ);
 
-    WinDxgiSurface surface(texture);
-    WinAutoMapDxgiSurface autoMapSurface(&surface, DXGI_MAP_READ);
+  Dimension bufferDim(static_cast<int> (autoMapSurface.getStride() / 4), stageDim.height);
+  m_auxiliaryFrameBuffer.setPropertiesWithoutResize(&bufferDim, &m_targetFb->getPixelFormat());
+  m_auxiliaryFrameBuffer.setBuffer(autoMapSurface.getBuffer());
 
+  std::vector<Rect>::const_iterator iStageRect;
+  for (iStageRect = stageRects->begin(); iStageRect < stageRects->end(); iStageRect++) {
+    dirtyRect = *iStageRect;
     Rect dstRect(dirtyRect);
     rotateRectInsideStage(&dstRect, &stageDim, rotation);
     // Translate the rect to the frame buffer coordinates.
     dstRect.move(m_targetRects[out].left, m_targetRects[out].top);
     m_log->debug(_T("Destination dirty rect = %d, %d, %dx%d"), dstRect.left, dstRect.top, dstRect.getWidth(), dstRect.getHeight());
 
-    stageDim.width = static_cast<int> (autoMapSurface.getStride() / 4);
-    m_auxiliaryFrameBuffer.setPropertiesWithoutResize(&stageDim, &m_targetFb->getPixelFormat());
-    m_auxiliaryFrameBuffer.setBuffer(autoMapSurface.getBuffer());
     switch (rotation)
     {
       case DXGI_MODE_ROTATION_UNSPECIFIED:
@@ -258,12 +453,33 @@ void Win8DeskDuplication::processDirtyRects(size_t dirtyCount,
         break;
       }
     }
-    m_auxiliaryFrameBuffer.setBuffer(0);
 
-    changedRegion.addRect(&dstRect);
+    changedRegion->addRect(&dstRect);
   }
+  m_auxiliaryFrameBuffer.setBuffer(0);
+}
+
+void Win8DeskDuplication::flushPendingRegion(size_t out)
+{
+  std::vector<Rect> pendingRects;
+  m_pendingRegions[out].getRectVector(&pendingRects);
+  m_log->debug(_T("Reading back %d rects changed on output %d while the capture was paused"),
+               (int)pendingRects.size(), (int)out);
+  Region changedRegion;
+  readStagedRects(&pendingRects, out, &changedRegion);
+  m_pendingRegions[out].clear();
+  // The pixels have waited for the demand, they are taken as captured now.
+  m_duplListener->onFrameBufferUpdate(&changedRegion, 0);
+}
 
-  m_duplListener->onFrameBufferUpdate(&changedRegion);
+bool Win8DeskDuplication::hasPendingRegions() const
+{
+  for (size_t i = 0; i < m_pendingRegions.size(); i++) {
+    if (!m_pendingRegions[i].isEmpty()) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void Win8DeskDuplication::rotateRectInsideStage(Rect *toTranspose,
@@ -313,7 +529,7 @@ void Win8DeskDuplication::processCursor(const DXGI_OUTDUPL_FRAME_INFO *info, siz
     bool visibleChanged = m_targetCurShape->getIsVisible() != newVisibility;
     if (visibleChanged) {
 	  m_log->debug(newVisibility ? _T("Cursor became visible") : _T("Cursor became not visible"));
-      m_targetCurShape->setVisibility(newVisibility, out);
+      m_targetCurShape->setVisibility(newVisibility, (int)(m_firstOutputIndex + out));
       m_duplListener->onCursorShapeChanged();
     }
 
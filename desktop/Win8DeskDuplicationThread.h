@@ -34,12 +34,18 @@
 
 #include "WinCustomD3D11Texture2D.h"
 #include "WinDxgiOutputDuplication.h"
+#include "WinD3D11TileDiff.h"
+#include "WinDxgiAdapter.h"
 
 class Win8DeskDuplication : public GuiThread
 {
 public:
   // The WinDxgiOutput *dxgiOutput passed object can be destroyed right after the constructor calling.
-  // The WinD3D11Device *device passed object can be destroyed right after the constructor calling.
+  // The device of the thread is created on the dxgiAdapter the outputs belong to, the adapter
+  // can be destroyed right after the constructor calling. The adapterIndex is reported in the
+  // capture statistics of the outputs.
+  // The firstOutputIndex is the number of the first passed output among outputs of all
+  // duplication threads, it identifies the outputs for the cursor shape visibility.
   Win8DeskDuplication(FrameBuffer *targetFb,
                             std::vector<Rect> &targetRect,
                             Win8CursorShape *targetCurShape,
@@ -47,6 +53,9 @@ public:
                             LocalMutex *cursorMutex,
                             Win8DuplicationListener *duplListener,
                             std::vector<WinDxgiOutput> &dxgiOutput,
+                            size_t firstOutputIndex,
+                            WinDxgiAdapter *dxgiAdapter,
+                            UINT adapterIndex,
                             LogWriter *log);
   virtual ~Win8DeskDuplication();
 
@@ -58,12 +67,32 @@ private:
   void setCriticalError(const TCHAR *reason);
   void setRecoverableError(const TCHAR *reason);
 
-  void processMoveRects(size_t moveCount, size_t out);
+  // If demanded is false, the changed rects are only copied to the
+  // staging texture and added to the pending region of the output.
+  void processMoveRects(size_t moveCount,
+                        WinD3D11Texture2D *acquiredDesktopImage,
+                        size_t out, bool demanded);
   void processDirtyRects(size_t dirtyCount,
                          WinD3D11Texture2D *acquiredDesktopImage,
-                         size_t out);
+                         size_t out, bool demanded);
+  // Maps the staging texture of the output and copies the stageRects from
+  // it to the target frame buffer, adding them to changedRegion in the
+  // frame buffer coordinates.
+  void readStagedRects(const std::vector<Rect> *stageRects, size_t out,
+                       Region *changedRegion);
+  // Reads back the pending region of the output and reports it to the
+  // listener.
+  void flushPendingRegion(size_t out);
+  bool hasPendingRegions() const;
   void processCursor(const DXGI_OUTDUPL_FRAME_INFO *info, size_t out);
 
+  // Duplicates the output again after the access to it has been lost (a UAC
+  // prompt, a fullscreen application), keeping the device and the frame
+  // buffer with the last good frame. Returns false if the output has
+  // changed its place, size or rotation or the duplication is not possible
+  // for RECOVERY_TIMEOUT, then the whole driver has to be rebuilt.
+  bool recoverOutput(size_t out);
+
   Dimension getStageDimension(size_t out) const;
 
   void rotateRectInsideStage(Rect *toTranspose, const Dimension *stageDim, DXGI_MODE_ROTATION rotation);
@@ -76,6 +105,15 @@ private:
   LocalMutex *m_cursorMutex;
 
   std::vector<DXGI_MODE_ROTATION> m_rotations;
+  // Desktop coordinates of the outputs, as they were at the creation time.
+  std::vector<Rect> m_desktopCoords;
+  size_t m_firstOutputIndex;
+  UINT m_adapterIndex;
+  // Present time of the frame being processed, 0 if unknown.
+  INT64 m_presentTime;
+  // The next frame is acquired after the vertical blank following the
+  // previous one, see ServerConfig::isVblankPacedCaptureEnabled().
+  bool m_vblankPaced;
 
   Win8DuplicationListener *m_duplListener;
 
@@ -92,11 +130,28 @@ private:
   // Use this variables as class fields to avoid frequency memory allocations.
   std::vector<RECT> m_dirtyRects;
   std::vector<DXGI_OUTDUPL_MOVE_RECT> m_moveRects;
+  // Dirty rects of the current frame clipped by the stage rect.
+  std::vector<Rect> m_stageRects;
 
   std::vector<WinCustomD3D11Texture2D> m_stageTextures2D;
+  // GPU change detection per output, 0 for outputs where it is disabled
+  // or not supported.
+  std::vector<WinD3D11TileDiff *> m_tileDiffs;
   FrameBuffer m_auxiliaryFrameBuffer;
 
+  // Per output, the stage rects copied to the staging texture while the
+  // capture was not demanded and not read back yet.
+  std::vector<Region> m_pendingRegions;
+
   LogWriter *m_log;
+
+  // Time in milliseconds an output is tried to be duplicated again, and the
+  // interval between the tries.
+  static const unsigned int RECOVERY_TIMEOUT = 5000;
+  static const unsigned int RECOVERY_RETRY_INTERVAL = 50;
+  // Acquire timeout while some pixels are pending, so they are read back
+  // soon after the demand returns.
+  static const int PENDING_ACQUIRE_TIMEOUT = 50;
 };
 
 #endif // __WIN8DESKDUPLICATIONTHREAD_H__
@@ -26,18 +26,25 @@
 #define __WIN8DUPLICATIONLISTENER_H__
 
 #include "region/Region.h"
+#include "util/inttypes.h"
 
 class Win8DuplicationListener
 {
 public:
-  // changedRegion in target FrameBuffer coordinates.
-  virtual void onFrameBufferUpdate(const Region *changedRegion) = 0;
+  // changedRegion in target FrameBuffer coordinates. The presentTime is the
+  // QueryPerformanceCounter() time the frame has been presented at, 0 if
+  // unknown.
+  virtual void onFrameBufferUpdate(const Region *changedRegion, INT64 presentTime) = 0;
   // dstRect, srcX, srcY in target FrameBuffer coordinates.
-  virtual void onCopyRect(const Rect *dstRect, int srcX, int srcY) = 0;
+  virtual void onCopyRect(const Rect *dstRect, int srcX, int srcY, INT64 presentTime) = 0;
 
   virtual void onCursorPositionChanged(int x, int y) = 0;
   virtual void onCursorShapeChanged() = 0;
 
+  // Returns false while no client can accept updates, the pixels of the
+  // frames are not read back to the frame buffer in this time.
+  virtual bool isCaptureDemanded() = 0;
+
   // Calls when an error occurred which can be recover by object recreating.
   virtual void onRecoverableError(const TCHAR *reason) = 0;
   // Calls when an error occurred which can't be recover by object recreating.
@@ -34,7 +34,8 @@ Win8ScreenDriver::Win8ScreenDriver(UpdateKeeper *updateKeeper,
   m_fbLocalMutex(fbLocalMutex),
   m_updateKeeper(updateKeeper),
   m_updateListener(updateListener),
-  m_detectionEnabled(false)
+  m_detectionEnabled(false),
+  m_captureDemanded(true)
 {
   m_log->debug(_T("Win8ScreenDriver creating new Win8ScreenDriverImpl"));
   AutoLock al(&m_drvImplMutex);
@@ -108,7 +109,8 @@ bool Win8ScreenDriver::applyNewScreenProperties()
     }
     m_log->debug(_T("Applying new screen properties, creating new Win8ScreenDriverImpl"));
     Win8ScreenDriverImpl *drvImpl =
-      new Win8ScreenDriverImpl(m_log, m_updateKeeper, m_fbLocalMutex, m_updateListener, m_detectionEnabled);
+      new Win8ScreenDriverImpl(m_log, m_updateKeeper, m_fbLocalMutex, m_updateListener, m_detectionEnabled,
+                               m_captureDemanded);
     m_drvImpl = drvImpl;
   } catch (Exception &e) {
     m_log->error(_T("Can't apply new screen properties: %s"), e.getMessage());
@@ -135,6 +137,15 @@ Point Win8ScreenDriver::getCursorPosition()
   return m_drvImpl->getCursorPosition();
 }
 
+void Win8ScreenDriver::setCaptureDemand(bool demanded)
+{
+  AutoLock al(&m_drvImplMutex);
+  m_captureDemanded = demanded;
+  if (m_drvImpl != 0) {
+    m_drvImpl->setCaptureDemand(demanded);
+  }
+}
+
 void Win8ScreenDriver::getCopiedRegion(Rect *copyRect, Point *source)
 {
   AutoLock al(m_fbLocalMutex);
@@ -70,6 +70,10 @@ public:
 
   virtual void getCopiedRegion(Rect *copyRect, Point *source);
 
+  // The duplication keeps acquiring the frames but reads back no pixels
+  // while the capture is not demanded.
+  virtual void setCaptureDemand(bool demanded);
+
 private:
   LogWriter *m_log;
   LocalMutex *m_fbLocalMutex;
@@ -84,6 +88,8 @@ private:
   CursorShape m_cursorShape;
 
   bool m_detectionEnabled;
+  // Passed to the implementation recreated by applyNewScreenProperties().
+  bool m_captureDemanded;
 };
 
 #endif // __WIN8SCREENDRIVER_H__
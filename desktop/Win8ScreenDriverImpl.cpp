@@ -30,6 +30,7 @@
 #include "win-system/Screen.h"
 
 #include "WinDxgiOutput.h"
+#include "WinDxgiFactory.h"
 
 // The header including of this cpp file must be at last place to avoid build conflicts.
 #include "Win8ScreenDriverImpl.h"
@@ -37,14 +38,16 @@
 Win8ScreenDriverImpl::Win8ScreenDriverImpl(LogWriter *log, UpdateKeeper *updateKeeper,
                                            LocalMutex *fbLocalMutex,
                                            UpdateListener *updateListener,
-                                           bool detectionEnabled)
+                                           bool detectionEnabled,
+                                           bool captureDemanded)
 : m_updateKeeper(updateKeeper),
   m_updateListener(updateListener),
   m_log(log),
   m_curTimeStamp(0),
   m_hasCriticalError(false),
   m_hasRecoverableError(false),
-  m_detectionEnabled(detectionEnabled)
+  m_detectionEnabled(detectionEnabled),
+  m_captureDemanded(captureDemanded)
 {
   resume();
   m_log->debug(_T("Win8ScreenDriverImpl:: waiting for DXGI init"));
@@ -101,36 +104,49 @@ FrameBuffer *Win8ScreenDriverImpl::getScreenBuffer()
 
 void Win8ScreenDriverImpl::initDxgi()
 {
-  m_log->debug(_T("Creating of D3D11Device"));
-  WinD3D11Device d3D11Device(m_log);
-  m_log->debug(_T("Quering Interface for IDXGIDevice"));
-  WinDxgiDevice dxgiDevice(&d3D11Device);
-  m_log->debug(_T("Getting Parent for IDXGIAdapter"));
-  WinDxgiAdapter dxgiAdapter(&dxgiDevice);
+  // An output can be duplicated only by a device of its own adapter, so
+  // outputs of all adapters (hybrid graphics, several video cards) are
+  // enumerated and every output gets a device on its adapter later.
+  m_log->debug(_T("Creating of IDXGIFactory1"));
+  WinDxgiFactory dxgiFactory;
 
   Region virtDeskRegion;
   m_log->debug(_T("Try to enumerate dxgi outputs"));
   std::vector<WinDxgiOutput> dxgiOutputArray;
+  std::vector<UINT> adapterIndexArray;
   std::vector<Rect> deskCoordArray;
-  UINT iOutput = 0;
+  UINT iAdapter = 0;
   try {
-    for (iOutput = 0; iOutput < 65535; iOutput++) {
-      WinDxgiOutput dxgiOutput(&dxgiAdapter, iOutput);
-      if (dxgiOutput.isAttachedtoDesktop()) {
-        dxgiOutputArray.push_back(dxgiOutput);
-        Rect deskCoord = dxgiOutput.getDesktopCoordinates();
-        deskCoordArray.push_back(deskCoord);
-        virtDeskRegion.addRect(&deskCoord);
+    for (iAdapter = 0; iAdapter < 65535; iAdapter++) {
+      WinDxgiAdapter dxgiAdapter(&dxgiFactory, iAdapter);
+      StringStorage adapterName;
+      dxgiAdapter.getDescription(&adapterName);
+      m_log->debug(_T("Dxgi adapter %u: %s"), iAdapter, adapterName.getString());
+      UINT iOutput = 0;
+      try {
+        for (iOutput = 0; iOutput < 65535; iOutput++) {
+          WinDxgiOutput dxgiOutput(&dxgiAdapter, iOutput);
+          if (dxgiOutput.isAttachedtoDesktop()) {
+            dxgiOutputArray.push_back(dxgiOutput);
+            adapterIndexArray.push_back(iAdapter);
+            Rect deskCoord = dxgiOutput.getDesktopCoordinates();
+            deskCoordArray.push_back(deskCoord);
+            virtDeskRegion.addRect(&deskCoord);
+          }
+        }
+      } catch (WinDxRecoverableException &) {
+        m_log->debug(_T("Reached the end of dxgi output list of adapter %u with iOutput = %u"),
+                     iAdapter, iOutput);
+        // End of output list.
       }
     }
   } catch (WinDxRecoverableException &) {
-    m_log->debug(_T("Reached the end of dxgi output list with iOutput = %u"), iOutput);
-    // End of output list.
+    m_log->debug(_T("Reached the end of dxgi adapter list with iAdapter = %u"), iAdapter);
+    // End of adapter list.
   }
   m_log->debug(_T("We have %d dxgi output(s) connected"), dxgiOutputArray.size());
 
-  // Check that all outputs for the virtual screen are found (in case two or more
-  // hardware graphic interfaces are used). It's better to avoid using buggy
+  // Check that all outputs for the virtual screen are found. It's better to avoid using buggy
   // Desktop Duplication API here rather than getting the wrong framebuffer.
   Screen screen;
   if (screen.getVisibleMonitorCount() != dxgiOutputArray.size()) {
@@ -149,17 +165,29 @@ void Win8ScreenDriverImpl::initDxgi()
   if (threadsNum > 12) threadsNum = 12;
   DWORD millis = 1 << threadsNum; // delay up to 4 seconds if there are threads waiting to delete
   sleep(millis);
-  Thread * thread = new Win8DeskDuplication(&m_frameBuffer,
-    deskCoordArray,
-    &m_win8CursorShape,
-    &m_curTimeStamp,
-    &m_cursorMutex,
-    this,
-    dxgiOutputArray,
-    m_log);
-  DWORD id = thread->getThreadId();
-  m_log->debug(_T("Created a new Win8DeskDuplication with ID: (%d)"), id);
-  m_deskDuplThreadBundle.addThread(thread);
+  // Every output is duplicated by its own thread, so waiting for a frame
+  // of an idle output doesn't delay updates of the other outputs. The
+  // threads copy the pixels from their adapters to the common frame buffer.
+  for (size_t iDxgiOutput = 0; iDxgiOutput < dxgiOutputArray.size(); iDxgiOutput++) {
+    std::vector<Rect> outputCoord(1, deskCoordArray[iDxgiOutput]);
+    std::vector<WinDxgiOutput> output(1, dxgiOutputArray[iDxgiOutput]);
+    WinDxgiAdapter dxgiAdapter(&dxgiFactory, adapterIndexArray[iDxgiOutput]);
+    Thread * thread = new Win8DeskDuplication(&m_frameBuffer,
+      outputCoord,
+      &m_win8CursorShape,
+      &m_curTimeStamp,
+      &m_cursorMutex,
+      this,
+      output,
+      iDxgiOutput,
+      &dxgiAdapter,
+      adapterIndexArray[iDxgiOutput],
+      m_log);
+    DWORD id = thread->getThreadId();
+    m_log->debug(_T("Created a new Win8DeskDuplication with ID: (%d) for output %d of adapter %u"),
+                 id, (int)iDxgiOutput, adapterIndexArray[iDxgiOutput]);
+    m_deskDuplThreadBundle.addThread(thread);
+  }
 }
 
 void Win8ScreenDriverImpl::execute()
@@ -201,19 +229,31 @@ void Win8ScreenDriverImpl::onTerminate()
   m_errorEvent.notify();
 }
 
-void Win8ScreenDriverImpl::onFrameBufferUpdate(const Region *changedRegion)
+void Win8ScreenDriverImpl::onFrameBufferUpdate(const Region *changedRegion,
+                                               INT64 presentTime)
 {
   if (m_detectionEnabled) {
-    m_updateKeeper->addChangedRegion(changedRegion);
+    {
+      AutoLock al(m_updateKeeper);
+      m_updateKeeper->addChangedRegion(changedRegion);
+      if (!changedRegion->isEmpty()) {
+        m_updateKeeper->setCaptureTime(presentTime);
+      }
+    }
     m_updateListener->onUpdate();
   }
 }
 
-void Win8ScreenDriverImpl::onCopyRect(const Rect *dstRect, int srcX, int srcY)
+void Win8ScreenDriverImpl::onCopyRect(const Rect *dstRect, int srcX, int srcY,
+                                      INT64 presentTime)
 {
   if (m_detectionEnabled) {
     Point srcPoint(srcX, srcY);
-    m_updateKeeper->addCopyRect(dstRect, &srcPoint);
+    {
+      AutoLock al(m_updateKeeper);
+      m_updateKeeper->addCopyRect(dstRect, &srcPoint);
+      m_updateKeeper->setCaptureTime(presentTime);
+    }
     m_updateListener->onUpdate();
   }
 }
@@ -235,6 +275,11 @@ void Win8ScreenDriverImpl::onCursorShapeChanged()
   m_updateListener->onUpdate();
 }
 
+bool Win8ScreenDriverImpl::isCaptureDemanded()
+{
+  return m_captureDemanded;
+}
+
 void Win8ScreenDriverImpl::onRecoverableError(const TCHAR *reason)
 {
   m_log->error(_T("Win8ScreenDriverImpl catch an recoverable error with reason: %s"), reason);
@@ -270,6 +315,11 @@ void Win8ScreenDriverImpl::updateCursorShape(CursorShape *dst)
   dst->clone(m_win8CursorShape.getCursorShape());
 }
 
+void Win8ScreenDriverImpl::setCaptureDemand(bool demanded)
+{
+  m_captureDemanded = demanded;
+}
+
 Point Win8ScreenDriverImpl::getCursorPosition()
 {
   AutoLock al(&m_cursorMutex);
@@ -43,7 +43,8 @@ class Win8ScreenDriverImpl : private GuiThread, private Win8DuplicationListener
 public:
   Win8ScreenDriverImpl(LogWriter *log, UpdateKeeper *updateKeeper,
                        LocalMutex *fbLocalMutex,
-                       UpdateListener *updateListener, bool detectionEnabled = false);
+                       UpdateListener *updateListener, bool detectionEnabled = false,
+                       bool captureDemanded = true);
   virtual ~Win8ScreenDriverImpl();
 
   void executeDetection();
@@ -55,6 +56,7 @@ public:
 
   // Updates destination (*dst) cursor shape properties and data.
   void updateCursorShape(CursorShape *dst);
+  void setCaptureDemand(bool demanded);
   Point getCursorPosition();
 
   bool isValid();
@@ -65,10 +67,11 @@ protected:
 
 private:
   // Implementions of the Win8DuplicationListener listener functions.
-  virtual void onFrameBufferUpdate(const Region *changedRegion);
-  virtual void onCopyRect(const Rect *dstRect, int srcX, int srcY);
+  virtual void onFrameBufferUpdate(const Region *changedRegion, INT64 presentTime);
+  virtual void onCopyRect(const Rect *dstRect, int srcX, int srcY, INT64 presentTime);
   virtual void onCursorPositionChanged(int x, int y);
   virtual void onCursorShapeChanged();
+  virtual bool isCaptureDemanded();
   virtual void onRecoverableError(const TCHAR *reason);
   virtual void onCriticalError(const TCHAR *reason);
 
@@ -102,6 +105,8 @@ private:
   UpdateKeeper *m_updateKeeper;
   UpdateListener *m_updateListener;
   bool m_detectionEnabled;
+  // Read by the duplication threads.
+  volatile bool m_captureDemanded;
 };
 
 #endif // __WIN8SCREENDRIVERIMPL_H__
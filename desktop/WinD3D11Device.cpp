@@ -45,6 +45,20 @@ WinD3D11Device::WinD3D11Device(LogWriter *log)
   m_context(0),
   m_d3d11Lib(_T("d3d11.dll")),
   m_log(log)
+{
+  create(0);
+}
+
+WinD3D11Device::WinD3D11Device(IDXGIAdapter *adapter, LogWriter *log)
+: m_device(0),
+  m_context(0),
+  m_d3d11Lib(_T("d3d11.dll")),
+  m_log(log)
+{
+  create(adapter);
+}
+
+void WinD3D11Device::create(IDXGIAdapter *adapter)
 {
   D3D11CreateDeviceFunType d3d11CreateDevice;
   d3d11CreateDevice = (D3D11CreateDeviceFunType)m_d3d11Lib.getProcAddress("D3D11CreateDevice");
@@ -52,10 +66,11 @@ WinD3D11Device::WinD3D11Device(LogWriter *log)
     throw Exception(_T("Unable to load the D3D11CreateDevice() function"));
   }
 
-  // Driver types supported
+  // Driver types supported. A device for an explicit adapter must be created
+  // with the unknown driver type.
   D3D_DRIVER_TYPE driverTypes[] =
   {
-    D3D_DRIVER_TYPE_HARDWARE
+    adapter != 0 ? D3D_DRIVER_TYPE_UNKNOWN : D3D_DRIVER_TYPE_HARDWARE
   };
   UINT driverTypeCount = ARRAYSIZE(driverTypes);
 
@@ -75,7 +90,7 @@ WinD3D11Device::WinD3D11Device(LogWriter *log)
   HRESULT hr;
   for (UINT iDriverType = 0; iDriverType < driverTypeCount; ++iDriverType) {
     m_log->debug(_T("Creating of (%u) driverType device"), iDriverType);
-    hr = d3d11CreateDevice(0,
+    hr = d3d11CreateDevice(adapter,
                            driverTypes[iDriverType],
                            0,
                            0,
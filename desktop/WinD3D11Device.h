@@ -38,6 +38,9 @@ public:
   // Creates new device and context of first found.
   WinD3D11Device();
   WinD3D11Device(LogWriter *log);
+  // Creates new device and context on the adapter, so outputs of the adapter
+  // can be duplicated without copies between adapters.
+  WinD3D11Device(IDXGIAdapter *adapter, LogWriter *log);
   // Copy references and increase count for winD3D11Device's internal handles. So the
   // source winD3D11Device object can be destroyed while this object will use.
   WinD3D11Device(const WinD3D11Device &src);
@@ -57,6 +60,8 @@ public:
                              UINT front, UINT back);
 private:
   void copy(const WinD3D11Device &src);
+  // Creates the device on the adapter or on the default one if adapter is 0.
+  void create(IDXGIAdapter *adapter);
 
   DynamicLibrary m_d3d11Lib;
   ID3D11Device *m_device;
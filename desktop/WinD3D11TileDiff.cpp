@@ -0,0 +1,328 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "WinDxRecoverableException.h"
+
+// The header including of this cpp file must be at last place to avoid build conflicts.
+#include "WinD3D11TileDiff.h"
+#include <d3dcompiler.h>
+
+typedef HRESULT (WINAPI *D3DCompileFunType)(
+  LPCVOID pSrcData,
+  SIZE_T SrcDataSize,
+  LPCSTR pSourceName,
+  CONST D3D_SHADER_MACRO *pDefines,
+  ID3DInclude *pInclude,
+  LPCSTR pEntrypoint,
+  LPCSTR pTarget,
+  UINT Flags1,
+  UINT Flags2,
+  ID3DBlob **ppCode,
+  ID3DBlob **ppErrorMsgs);
+
+// Every thread group checks one tile, every thread of the group checks
+// each eighth pixel of the tile in both directions.
+static const char TILE_DIFF_SHADER[] =
+  "Texture2D<float4> currentFrame : register(t0);\n"
+  "Texture2D<float4> previousFrame : register(t1);\n"
+  "RWBuffer<uint> tileMask : register(u0);\n"
+  "cbuffer Params : register(b0)\n"
+  "{\n"
+  "  uint tileSize;\n"
+  "  uint tilesPerRow;\n"
+  "  uint firstTileX;\n"
+  "  uint firstTileY;\n"
+  "  uint width;\n"
+  "  uint height;\n"
+  "  uint2 padding;\n"
+  "};\n"
+  "[numthreads(8, 8, 1)]\n"
+  "void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)\n"
+  "{\n"
+  "  uint tileX = firstTileX + groupId.x;\n"
+  "  uint tileY = firstTileY + groupId.y;\n"
+  "  uint right = min((tileX + 1) * tileSize, width);\n"
+  "  uint bottom = min((tileY + 1) * tileSize, height);\n"
+  "  bool changed = false;\n"
+  "  for (uint y = tileY * tileSize + threadId.y; y < bottom && !changed; y += 8) {\n"
+  "    for (uint x = tileX * tileSize + threadId.x; x < right; x += 8) {\n"
+  "      if (any(currentFrame.Load(int3(x, y, 0)) != previousFrame.Load(int3(x, y, 0)))) {\n"
+  "        changed = true;\n"
+  "        break;\n"
+  "      }\n"
+  "    }\n"
+  "  }\n"
+  "  if (changed) {\n"
+  "    tileMask[tileY * tilesPerRow + tileX] = 1;\n"
+  "  }\n"
+  "}\n";
+
+WinD3D11TileDiff::WinD3D11TileDiff(WinD3D11Device *device, UINT width, UINT height,
+                                   LogWriter *log)
+: m_device(device),
+  m_width(width),
+  m_height(height),
+  m_tilesPerRow((width + TILE_SIZE - 1) / TILE_SIZE),
+  m_tileRows((height + TILE_SIZE - 1) / TILE_SIZE),
+  m_compilerLib(_T("d3dcompiler_47.dll")),
+  m_shader(0),
+  m_currentFrame(0),
+  m_previousFrame(0),
+  m_currentFrameView(0),
+  m_previousFrameView(0),
+  m_tileMask(0),
+  m_tileMaskView(0),
+  m_tileMaskStaging(0),
+  m_params(0),
+  m_log(log)
+{
+  if (m_device->getDevice()->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0) {
+    throw Exception(_T("The D3D11 device does not support compute shaders"));
+  }
+  try {
+    createShader();
+    createResources();
+  } catch (...) {
+    release();
+    throw;
+  }
+  m_tileFlags.resize(m_tilesPerRow * m_tileRows);
+  m_log->debug(_T("WinD3D11TileDiff created for %ux%u frames"), m_width, m_height);
+}
+
+WinD3D11TileDiff::~WinD3D11TileDiff()
+{
+  release();
+}
+
+void WinD3D11TileDiff::createShader()
+{
+  D3DCompileFunType d3dCompile;
+  d3dCompile = (D3DCompileFunType)m_compilerLib.getProcAddress("D3DCompile");
+  if (d3dCompile == 0) {
+    throw Exception(_T("Unable to load the D3DCompile() function"));
+  }
+
+  ID3DBlob *code = 0;
+  ID3DBlob *errors = 0;
+  HRESULT hr = d3dCompile(TILE_DIFF_SHADER, sizeof(TILE_DIFF_SHADER) - 1,
+                          "TileDiff", 0, 0, "main", "cs_5_0",
+                          D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &code, &errors);
+  if (errors != 0) {
+    errors->Release();
+  }
+  if (FAILED(hr) || code == 0) {
+    throw WinDxRecoverableException(_T("Can't compile the tile diff shader"), hr);
+  }
+  hr = m_device->getDevice()->CreateComputeShader(code->GetBufferPointer(),
+                                                  code->GetBufferSize(),
+                                                  0, &m_shader);
+  code->Release();
+  if (FAILED(hr)) {
+    throw WinDxRecoverableException(_T("Can't CreateComputeShader()"), hr);
+  }
+}
+
+void WinD3D11TileDiff::createResources()
+{
+  ID3D11Device *device = m_device->getDevice();
+  HRESULT hr;
+
+  D3D11_TEXTURE2D_DESC frameDesc;
+  memset(&frameDesc, 0, sizeof(frameDesc));
+  frameDesc.Width = m_width;
+  frameDesc.Height = m_height;
+  frameDesc.MipLevels = 1;
+  frameDesc.ArraySize = 1;
+  frameDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+  frameDesc.SampleDesc.Count = 1;
+  frameDesc.Usage = D3D11_USAGE_DEFAULT;
+  frameDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  if (FAILED(hr = device->CreateTexture2D(&frameDesc, 0, &m_currentFrame)) ||
+      FAILED(hr = device->CreateTexture2D(&frameDesc, 0, &m_previousFrame))) {
+    throw WinDxRecoverableException(_T("Can't CreateTexture2D() for the tile diff"), hr);
+  }
+  if (FAILED(hr = device->CreateShaderResourceView(m_currentFrame, 0, &m_currentFrameView)) ||
+      FAILED(hr = device->CreateShaderResourceView(m_previousFrame, 0, &m_previousFrameView))) {
+    throw WinDxRecoverableException(_T("Can't CreateShaderResourceView()"), hr);
+  }
+
+  UINT tileCount = m_tilesPerRow * m_tileRows;
+  D3D11_BUFFER_DESC maskDesc;
+  memset(&maskDesc, 0, sizeof(maskDesc));
+  maskDesc.ByteWidth = tileCount * sizeof(UINT);
+  maskDesc.Usage = D3D11_USAGE_DEFAULT;
+  maskDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+  if (FAILED(hr = device->CreateBuffer(&maskDesc, 0, &m_tileMask))) {
+    throw WinDxRecoverableException(_T("Can't CreateBuffer() for the tile mask"), hr);
+  }
+  D3D11_UNORDERED_ACCESS_VIEW_DESC maskViewDesc;
+  memset(&maskViewDesc, 0, sizeof(maskViewDesc));
+  maskViewDesc.Format = DXGI_FORMAT_R32_UINT;
+  maskViewDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+  maskViewDesc.Buffer.NumElements = tileCount;
+  if (FAILED(hr = device->CreateUnorderedAccessView(m_tileMask, &maskViewDesc, &m_tileMaskView))) {
+    throw WinDxRecoverableException(_T("Can't CreateUnorderedAccessView()"), hr);
+  }
+
+  maskDesc.Usage = D3D11_USAGE_STAGING;
+  maskDesc.BindFlags = 0;
+  maskDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+  if (FAILED(hr = device->CreateBuffer(&maskDesc, 0, &m_tileMaskStaging))) {
+    throw WinDxRecoverableException(_T("Can't CreateBuffer() for the tile mask readback"), hr);
+  }
+
+  D3D11_BUFFER_DESC paramsDesc;
+  memset(&paramsDesc, 0, sizeof(paramsDesc));
+  paramsDesc.ByteWidth = sizeof(ShaderParams);
+  paramsDesc.Usage = D3D11_USAGE_DEFAULT;
+  paramsDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+  if (FAILED(hr = device->CreateBuffer(&paramsDesc, 0, &m_params))) {
+    throw WinDxRecoverableException(_T("Can't CreateBuffer() for the shader parameters"), hr);
+  }
+}
+
+void WinD3D11TileDiff::release()
+{
+  if (m_params != 0) { m_params->Release(); m_params = 0; }
+  if (m_tileMaskStaging != 0) { m_tileMaskStaging->Release(); m_tileMaskStaging = 0; }
+  if (m_tileMaskView != 0) { m_tileMaskView->Release(); m_tileMaskView = 0; }
+  if (m_tileMask != 0) { m_tileMask->Release(); m_tileMask = 0; }
+  if (m_previousFrameView != 0) { m_previousFrameView->Release(); m_previousFrameView = 0; }
+  if (m_currentFrameView != 0) { m_currentFrameView->Release(); m_currentFrameView = 0; }
+  if (m_previousFrame != 0) { m_previousFrame->Release(); m_previousFrame = 0; }
+  if (m_currentFrame != 0) { m_currentFrame->Release(); m_currentFrame = 0; }
+  if (m_shader != 0) { m_shader->Release(); m_shader = 0; }
+}
+
+void WinD3D11TileDiff::moveRect(const Rect *dstRect, int srcX, int srcY)
+{
+  // A texture region can't be copied to an overlapping region of the same
+  // texture, so the current frame copy is used as an intermediate buffer.
+  // Both copies are equal outside of dirty rects, so it stays consistent.
+  Rect srcRect(dstRect);
+  srcRect.setLocation(srcX, srcY);
+  m_device->copySubresourceRegion(m_currentFrame, dstRect->left, dstRect->top,
+                                  m_previousFrame, &srcRect, 0, 1);
+  m_device->copySubresourceRegion(m_previousFrame, dstRect->left, dstRect->top,
+                                  m_currentFrame, dstRect, 0, 1);
+}
+
+void WinD3D11TileDiff::filterDirtyRects(ID3D11Texture2D *frame, std::vector<Rect> *dirtyRects)
+{
+  if (dirtyRects->empty()) {
+    return;
+  }
+  ID3D11DeviceContext *context = m_device->getContext();
+
+  // Copy the dirty parts of the new frame and find the tiles to check.
+  std::vector<Rect>::iterator iRect;
+  Rect bounds = dirtyRects->front();
+  for (iRect = dirtyRects->begin(); iRect < dirtyRects->end(); iRect++) {
+    m_device->copySubresourceRegion(m_currentFrame, iRect->left, iRect->top,
+                                    frame, &(*iRect), 0, 1);
+    bounds.left = min(bounds.left, iRect->left);
+    bounds.top = min(bounds.top, iRect->top);
+    bounds.right = max(bounds.right, iRect->right);
+    bounds.bottom = max(bounds.bottom, iRect->bottom);
+  }
+  if (bounds.isEmpty()) {
+    return;
+  }
+
+  ShaderParams params;
+  memset(&params, 0, sizeof(params));
+  params.tileSize = TILE_SIZE;
+  params.tilesPerRow = m_tilesPerRow;
+  params.firstTileX = bounds.left / TILE_SIZE;
+  params.firstTileY = bounds.top / TILE_SIZE;
+  params.width = m_width;
+  params.height = m_height;
+  UINT tileCountX = (bounds.right + TILE_SIZE - 1) / TILE_SIZE - params.firstTileX;
+  UINT tileCountY = (bounds.bottom + TILE_SIZE - 1) / TILE_SIZE - params.firstTileY;
+  context->UpdateSubresource(m_params, 0, 0, &params, 0, 0);
+
+  const UINT zeros[4] = { 0, 0, 0, 0 };
+  context->ClearUnorderedAccessViewUint(m_tileMaskView, zeros);
+
+  ID3D11ShaderResourceView *views[2] = { m_currentFrameView, m_previousFrameView };
+  context->CSSetShader(m_shader, 0, 0);
+  context->CSSetShaderResources(0, 2, views);
+  context->CSSetUnorderedAccessViews(0, 1, &m_tileMaskView, 0);
+  context->CSSetConstantBuffers(0, 1, &m_params);
+  context->Dispatch(tileCountX, tileCountY, 1);
+
+  // Unbind the resources to be able to copy to the frame textures.
+  ID3D11ShaderResourceView *nullViews[2] = { 0, 0 };
+  ID3D11UnorderedAccessView *nullUav = 0;
+  context->CSSetShaderResources(0, 2, nullViews);
+  context->CSSetUnorderedAccessViews(0, 1, &nullUav, 0);
+  context->CSSetShader(0, 0, 0);
+
+  // Now the new frame becomes the previous one.
+  for (iRect = dirtyRects->begin(); iRect < dirtyRects->end(); iRect++) {
+    m_device->copySubresourceRegion(m_previousFrame, iRect->left, iRect->top,
+                                    m_currentFrame, &(*iRect), 0, 1);
+  }
+
+  context->CopyResource(m_tileMaskStaging, m_tileMask);
+  D3D11_MAPPED_SUBRESOURCE mapped;
+  HRESULT hr = context->Map(m_tileMaskStaging, 0, D3D11_MAP_READ, 0, &mapped);
+  if (FAILED(hr)) {
+    throw WinDxRecoverableException(_T("Can't Map() the tile mask"), hr);
+  }
+  memcpy(&m_tileFlags.front(), mapped.pData, m_tileFlags.size() * sizeof(UINT));
+  context->Unmap(m_tileMaskStaging, 0);
+
+  // Replace the dirty rects by runs of changed tiles inside of them.
+  m_changedRects.clear();
+  for (iRect = dirtyRects->begin(); iRect < dirtyRects->end(); iRect++) {
+    if (iRect->isEmpty()) {
+      continue;
+    }
+    UINT firstColumn = iRect->left / TILE_SIZE;
+    UINT endColumn = (iRect->right + TILE_SIZE - 1) / TILE_SIZE;
+    UINT endRow = (iRect->bottom + TILE_SIZE - 1) / TILE_SIZE;
+    for (UINT row = iRect->top / TILE_SIZE; row < endRow; row++) {
+      const UINT *rowFlags = &m_tileFlags[row * m_tilesPerRow];
+      UINT column = firstColumn;
+      while (column < endColumn) {
+        if (rowFlags[column] == 0) {
+          column++;
+          continue;
+        }
+        Rect tiles;
+        tiles.left = column * TILE_SIZE;
+        tiles.top = row * TILE_SIZE;
+        tiles.bottom = tiles.top + TILE_SIZE;
+        while (column < endColumn && rowFlags[column] != 0) {
+          column++;
+        }
+        tiles.right = column * TILE_SIZE;
+        m_changedRects.push_back(tiles.intersection(&(*iRect)));
+      }
+    }
+  }
+  dirtyRects->swap(m_changedRects);
+}
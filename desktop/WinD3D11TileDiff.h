@@ -0,0 +1,105 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __WIND3D11TILEDIFF_H__
+#define __WIND3D11TILEDIFF_H__
+
+#include "region/Rect.h"
+#include "win-system/DynamicLibrary.h"
+#include "log-writer/LogWriter.h"
+#include "WinD3D11Device.h"
+
+#include <vector>
+
+// The WinD3D11TileDiff class finds changed parts of duplicated frames on the
+// GPU. It keeps a copy of the previous frame in video memory and a compute
+// shader compares the new frame with it, producing one flag per tile. Only
+// the flags are read back, so the CPU reads pixels of really changed tiles
+// instead of the whole (often coarse) dirty rects reported by DXGI.
+class WinD3D11TileDiff
+{
+public:
+  static const UINT TILE_SIZE = 32;
+
+  // Throws Exception if the device does not support compute shaders or
+  // the shader compiler can not be loaded.
+  WinD3D11TileDiff(WinD3D11Device *device, UINT width, UINT height,
+                   LogWriter *log);
+  virtual ~WinD3D11TileDiff();
+
+  // Reproduces a move rect of the frame in the previous frame copy.
+  void moveRect(const Rect *dstRect, int srcX, int srcY);
+
+  // Compares the dirtyRects parts of frame with the previous frame and
+  // replaces dirtyRects by the changed tiles clipped by the dirty rects.
+  // The previous frame copy is updated by the dirty rects.
+  void filterDirtyRects(ID3D11Texture2D *frame, std::vector<Rect> *dirtyRects);
+
+private:
+  // Not copyable.
+  WinD3D11TileDiff(const WinD3D11TileDiff &);
+  WinD3D11TileDiff &operator = (const WinD3D11TileDiff &);
+
+  void createShader();
+  void createResources();
+  void release();
+
+  struct ShaderParams
+  {
+    UINT tileSize;
+    UINT tilesPerRow;
+    UINT firstTileX;
+    UINT firstTileY;
+    UINT width;
+    UINT height;
+    UINT padding[2];
+  };
+
+  WinD3D11Device *m_device;
+  UINT m_width;
+  UINT m_height;
+  UINT m_tilesPerRow;
+  UINT m_tileRows;
+
+  DynamicLibrary m_compilerLib;
+  ID3D11ComputeShader *m_shader;
+
+  ID3D11Texture2D *m_currentFrame;
+  ID3D11Texture2D *m_previousFrame;
+  ID3D11ShaderResourceView *m_currentFrameView;
+  ID3D11ShaderResourceView *m_previousFrameView;
+
+  ID3D11Buffer *m_tileMask;
+  ID3D11UnorderedAccessView *m_tileMaskView;
+  ID3D11Buffer *m_tileMaskStaging;
+  ID3D11Buffer *m_params;
+
+  // Use this variables as class fields to avoid frequency memory allocations.
+  std::vector<UINT> m_tileFlags;
+  std::vector<Rect> m_changedRects;
+
+  LogWriter *m_log;
+};
+
+#endif // __WIND3D11TILEDIFF_H__
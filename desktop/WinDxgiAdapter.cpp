@@ -24,6 +24,7 @@
 
 #include "WinDxCriticalException.h"
 #include "WinDxRecoverableException.h"
+#include "util/UnicodeStringStorage.h"
 
 // The header including of this cpp file must be at last place to avoid build conflicts.
 #include "WinDxgiAdapter.h"
@@ -37,6 +38,14 @@ WinDxgiAdapter::WinDxgiAdapter(WinDxgiDevice *winDxgiDevice)
   }
 }
 
+WinDxgiAdapter::WinDxgiAdapter(WinDxgiFactory *dxgiFactory, UINT iAdapter)
+: m_dxgiAdapter(0)
+{
+  IDXGIAdapter1 *dxgiAdapter1 = 0;
+  dxgiFactory->getDxgiAdapter(iAdapter, &dxgiAdapter1);
+  m_dxgiAdapter = dxgiAdapter1;
+}
+
 WinDxgiAdapter::~WinDxgiAdapter()
 {
   if (m_dxgiAdapter != 0) {
@@ -45,6 +54,22 @@ WinDxgiAdapter::~WinDxgiAdapter()
   }
 }
 
+IDXGIAdapter *WinDxgiAdapter::getDxgiAdapter()
+{
+  return m_dxgiAdapter;
+}
+
+void WinDxgiAdapter::getDescription(StringStorage *out)
+{
+  DXGI_ADAPTER_DESC desc;
+  HRESULT hr = m_dxgiAdapter->GetDesc(&desc);
+  if (FAILED(hr)) {
+    throw WinDxCriticalException(_T("Can't IDXGIAdapter::GetDesc()"), hr);
+  }
+  UnicodeStringStorage uniString(desc.Description);
+  uniString.toStringStorage(out);
+}
+
 void WinDxgiAdapter::getDxgiOutput(UINT iOutput, IDXGIOutput **iDxgiOutput)
 {
   HRESULT hr = m_dxgiAdapter->EnumOutputs(iOutput, iDxgiOutput);
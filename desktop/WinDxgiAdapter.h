@@ -26,6 +26,7 @@
 #define __WINDXGIADAPTER_H__
 
 #include "WinDxgiDevice.h"
+#include "WinDxgiFactory.h"
 
 #include <d3d11.h>
 #include <DXGI1_2.h>
@@ -34,8 +35,15 @@ class WinDxgiAdapter
 {
 public:
   WinDxgiAdapter(WinDxgiDevice *winDxgiDevice);
+  // Gets the iAdapter adapter of the factory, throws the same exceptions as
+  // the WinDxgiFactory::getDxgiAdapter() function.
+  WinDxgiAdapter(WinDxgiFactory *dxgiFactory, UINT iAdapter);
   virtual ~WinDxgiAdapter();
 
+  IDXGIAdapter *getDxgiAdapter();
+
+  void getDescription(StringStorage *out);
+
   // This function try to get output for iOutput from the adapter.
   // Throws the WinDxRecoverableException exception if output not found,
   // and throws WinDxCriticalException on other errors.
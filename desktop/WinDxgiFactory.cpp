@@ -0,0 +1,66 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "WinDxCriticalException.h"
+#include "WinDxRecoverableException.h"
+
+// The header including of this cpp file must be at last place to avoid build conflicts.
+#include "WinDxgiFactory.h"
+
+typedef HRESULT (WINAPI *CreateDXGIFactory1FunType)(REFIID riid, void **ppFactory);
+
+WinDxgiFactory::WinDxgiFactory()
+: m_dxgiLib(_T("dxgi.dll")),
+  m_dxgiFactory(0)
+{
+  CreateDXGIFactory1FunType createDxgiFactory1;
+  createDxgiFactory1 = (CreateDXGIFactory1FunType)m_dxgiLib.getProcAddress("CreateDXGIFactory1");
+  if (createDxgiFactory1 == 0) {
+    throw WinDxCriticalException(_T("Unable to load the CreateDXGIFactory1() function"), E_NOTIMPL);
+  }
+  HRESULT hr = createDxgiFactory1(__uuidof(IDXGIFactory1), reinterpret_cast<void**>(&m_dxgiFactory));
+  if (FAILED(hr)) {
+    throw WinDxCriticalException(_T("Can't CreateDXGIFactory1()"), hr);
+  }
+}
+
+WinDxgiFactory::~WinDxgiFactory()
+{
+  if (m_dxgiFactory != 0) {
+    m_dxgiFactory->Release();
+    m_dxgiFactory = 0;
+  }
+}
+
+void WinDxgiFactory::getDxgiAdapter(UINT iAdapter, IDXGIAdapter1 **dxgiAdapter)
+{
+  HRESULT hr = m_dxgiFactory->EnumAdapters1(iAdapter, dxgiAdapter);
+  if (hr == DXGI_ERROR_NOT_FOUND) {
+    StringStorage errMess;
+    errMess.format(_T("IDXGIAdapter1 not found for iAdapter = %u"), iAdapter);
+    throw WinDxRecoverableException(errMess.getString(), hr);
+  } else if (FAILED(hr)) {
+    throw WinDxCriticalException(_T("Can't IDXGIFactory1::EnumAdapters1()"), hr);
+  }
+}
@@ -0,0 +1,52 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __WINDXGIFACTORY_H__
+#define __WINDXGIFACTORY_H__
+
+#include "win-system/DynamicLibrary.h"
+
+#include <d3d11.h>
+#include <DXGI1_2.h>
+
+// Enumerates the graphic adapters of the system, so every output can be
+// duplicated with a device created on its own adapter.
+class WinDxgiFactory
+{
+public:
+  // Throws WinDxCriticalException if the factory can't be created.
+  WinDxgiFactory();
+  virtual ~WinDxgiFactory();
+
+  // This function try to get adapter for iAdapter. Throws the
+  // WinDxRecoverableException exception if adapter not found, and throws
+  // WinDxCriticalException on other errors.
+  void getDxgiAdapter(UINT iAdapter, IDXGIAdapter1 **dxgiAdapter);
+
+private:
+  DynamicLibrary m_dxgiLib;
+  IDXGIFactory1 *m_dxgiFactory;
+};
+
+#endif // __WINDXGIFACTORY_H__
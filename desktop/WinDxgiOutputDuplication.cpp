@@ -32,6 +32,11 @@
 
 WinDxgiOutputDuplication::WinDxgiOutputDuplication(WinDxgiOutput1 *dxgiOutput, WinD3D11Device *d3D11Device)
 : m_outDupl(0)
+{
+  duplicate(dxgiOutput, d3D11Device);
+}
+
+void WinDxgiOutputDuplication::duplicate(WinDxgiOutput1 *dxgiOutput, WinD3D11Device *d3D11Device)
 {
   HRESULT hr = dxgiOutput->getDxgiOutput1()->DuplicateOutput(d3D11Device->getDevice(), &m_outDupl);
   if (FAILED(hr)) {
@@ -53,6 +58,11 @@ WinDxgiOutputDuplication::WinDxgiOutputDuplication(const WinDxgiOutputDuplicatio
 }
 
 WinDxgiOutputDuplication::~WinDxgiOutputDuplication()
+{
+  release();
+}
+
+void WinDxgiOutputDuplication::release()
 {
   if (m_outDupl != 0) {
     m_outDupl->Release();
@@ -60,6 +70,13 @@ WinDxgiOutputDuplication::~WinDxgiOutputDuplication()
   }
 }
 
+void WinDxgiOutputDuplication::recreate(WinDxgiOutput1 *dxgiOutput, WinD3D11Device *d3D11Device)
+{
+  // An output can be duplicated only once, the old interface must go first.
+  release();
+  duplicate(dxgiOutput, d3D11Device);
+}
+
 
 WinDxgiOutputDuplication &WinDxgiOutputDuplication::operator = (WinDxgiOutputDuplication const &src)
 {
@@ -71,7 +88,9 @@ void WinDxgiOutputDuplication::copy(const WinDxgiOutputDuplication &src)
 {
   if (this != &src) {
     m_outDupl = src.m_outDupl;
-    m_outDupl->AddRef();
+    if (m_outDupl != 0) {
+      m_outDupl->AddRef();
+    }
   }
 }
 
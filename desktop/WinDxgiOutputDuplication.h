@@ -45,6 +45,11 @@ public:
   // this object destructor has been called.
   IDXGIOutputDuplication *getDxgiOutputDuplication();
 
+  // Releases the duplication interface and duplicates the output again on
+  // the same device, which is what the lost access needs. Throws the same
+  // exceptions as the constructor, the object has no interface then.
+  void recreate(WinDxgiOutput1 *dxgiOutput, WinD3D11Device *d3D11Device);
+
   // Throws WinDxException on an error.
   // Returns count of got "move" rects.
   // Also, the function resize the moveRects vector if it's needed.
@@ -61,6 +66,8 @@ public:
 
 private:
   void copy(const WinDxgiOutputDuplication &src);
+  void duplicate(WinDxgiOutput1 *dxgiOutput, WinD3D11Device *d3D11Device);
+  void release();
 
   IDXGIOutputDuplication *m_outDupl;
 };
@@ -60,8 +60,7 @@ void WinVideoRegionUpdaterImpl::execute()
 }
 
 unsigned int WinVideoRegionUpdaterImpl::getInterval() {
-  ServerConfig *srvConf = Configurator::getInstance()->getServerConfig();
-  return srvConf->getVideoRecognitionInterval();
+  return Configurator::getConfigSnapshot()->getVideoRecognitionInterval();
 }
 
 Region WinVideoRegionUpdaterImpl::getVideoRegion()
@@ -0,0 +1,137 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "WindowChangeHook.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+
+WindowChangeHook *WindowChangeHook::m_instance = 0;
+LocalMutex WindowChangeHook::m_instanceMutex;
+
+WindowChangeHook::WindowChangeHook(WindowChangeListener *listener, LogWriter *log)
+: m_listener(listener),
+  m_isInstalled(false),
+  m_log(log)
+{
+  {
+    AutoLock al(&m_instanceMutex);
+    if (m_instance != 0) {
+      throw Exception(_T("WindowChangeHook instance already exists"));
+    }
+    m_instance = this;
+  }
+  resume();
+}
+
+WindowChangeHook::~WindowChangeHook()
+{
+  terminate();
+  wait();
+
+  AutoLock al(&m_instanceMutex);
+  m_instance = 0;
+}
+
+void WindowChangeHook::onTerminate()
+{
+  PostThreadMessage(getThreadId(), WM_QUIT, 0, 0);
+}
+
+void WindowChangeHook::execute()
+{
+  // The system events from the foreground change to the end of
+  // minimizing and the object events from creation to location changes,
+  // the others of the ranges are skipped by the procedure.
+  HWINEVENTHOOK systemHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND,
+                                             EVENT_SYSTEM_MINIMIZEEND,
+                                             0, winEventProc, 0, 0,
+                                             WINEVENT_OUTOFCONTEXT);
+  HWINEVENTHOOK objectHook = SetWinEventHook(EVENT_OBJECT_CREATE,
+                                             EVENT_OBJECT_LOCATIONCHANGE,
+                                             0, winEventProc, 0, 0,
+                                             WINEVENT_OUTOFCONTEXT);
+  if (systemHook == 0 || objectHook == 0) {
+    m_log->error(_T("Can't install the window change hook, error = %u"),
+                 GetLastError());
+    if (systemHook != 0) {
+      UnhookWinEvent(systemHook);
+    }
+    if (objectHook != 0) {
+      UnhookWinEvent(objectHook);
+    }
+    return;
+  }
+  m_isInstalled = true;
+  m_log->info(_T("Window change hook thread id = %d"), getThreadId());
+
+  // The hook procedure is called in this thread while it waits for messages.
+  MSG msg;
+  while (!isTerminating()) {
+    if (!PeekMessage(&msg, NULL, NULL, NULL, PM_REMOVE)) {
+      if (!WaitMessage()) {
+        break;
+      }
+    } else if (msg.message == WM_QUIT) {
+      break;
+    } else {
+      DispatchMessage(&msg);
+    }
+  }
+
+  m_isInstalled = false;
+  UnhookWinEvent(systemHook);
+  UnhookWinEvent(objectHook);
+}
+
+void CALLBACK WindowChangeHook::winEventProc(HWINEVENTHOOK hook, DWORD event,
+                                             HWND hwnd, LONG idObject,
+                                             LONG idChild, DWORD eventThread,
+                                             DWORD eventTime)
+{
+  switch (event) {
+  case EVENT_SYSTEM_FOREGROUND:
+  case EVENT_SYSTEM_MOVESIZEEND:
+  case EVENT_SYSTEM_MINIMIZESTART:
+  case EVENT_SYSTEM_MINIMIZEEND:
+  case EVENT_OBJECT_CREATE:
+  case EVENT_OBJECT_DESTROY:
+  case EVENT_OBJECT_SHOW:
+  case EVENT_OBJECT_HIDE:
+  case EVENT_OBJECT_REORDER:
+  case EVENT_OBJECT_LOCATIONCHANGE:
+    break;
+  default:
+    return;
+  }
+  // The carets, cursors and child windows change much more often than the
+  // top-level windows and don't matter.
+  if (hwnd == 0 || idObject != OBJID_WINDOW || idChild != CHILDID_SELF ||
+      GetAncestor(hwnd, GA_PARENT) != GetDesktopWindow()) {
+    return;
+  }
+  // The instance cannot go away while its thread is in here.
+  if (m_instance != 0) {
+    m_instance->m_listener->onWindowsChanged();
+  }
+}
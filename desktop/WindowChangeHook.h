@@ -0,0 +1,66 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __WINDOWCHANGEHOOK_H__
+#define __WINDOWCHANGEHOOK_H__
+
+#include "util/CommonHeader.h"
+#include "thread/GuiThread.h"
+#include "thread/LocalMutex.h"
+#include "log-writer/LogWriter.h"
+#include "WindowChangeListener.h"
+
+// Notifies the listener about geometry and z-order changes of top-level
+// windows by an out of context WinEvent hook installed in its own thread
+// on the input desktop, so the window layout has not to be polled.
+//
+// Only one instance of this class may exist at a time.
+class WindowChangeHook : protected GuiThread
+{
+public:
+  WindowChangeHook(WindowChangeListener *listener, LogWriter *log);
+  virtual ~WindowChangeHook();
+
+  // Returns true while the hook is installed. Until then, or if installing
+  // has failed, the changes are not reported.
+  bool isInstalled() const { return m_isInstalled; }
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+  static void CALLBACK winEventProc(HWINEVENTHOOK hook, DWORD event,
+                                    HWND hwnd, LONG idObject, LONG idChild,
+                                    DWORD eventThread, DWORD eventTime);
+
+  static WindowChangeHook *m_instance;
+  static LocalMutex m_instanceMutex;
+
+  WindowChangeListener *m_listener;
+  volatile bool m_isInstalled;
+
+  LogWriter *m_log;
+};
+
+#endif // __WINDOWCHANGEHOOK_H__
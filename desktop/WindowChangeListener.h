@@ -0,0 +1,37 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __WINDOWCHANGELISTENER_H__
+#define __WINDOWCHANGELISTENER_H__
+
+class WindowChangeListener
+{
+public:
+  // Called when a top-level window of the input desktop has been created,
+  // destroyed, shown, hidden, moved, resized or brought to the front. It
+  // is called by the thread of the hook and must return quickly.
+  virtual void onWindowsChanged() = 0;
+};
+
+#endif // __WINDOWCHANGELISTENER_H__
@@ -32,6 +32,7 @@ WindowsCursorShapeGrabber::WindowsCursorShapeGrabber(void)
 
 WindowsCursorShapeGrabber::~WindowsCursorShapeGrabber(void)
 {
+  clearCache();
 }
 
 bool WindowsCursorShapeGrabber::isCursorShapeChanged()
@@ -122,6 +123,12 @@ bool WindowsCursorShapeGrabber::grabPixels(const PixelFormat *pixelFormat)
     return false;
   }
 
+  if (findCachedShape(hCursor, &maskBuff, pixelFormat)) {
+    return true;
+  }
+  // The mask is converted in place below.
+  std::vector<char> windowsMask(maskBuff);
+
   // Get cursor pixels
   HDC screenDC = GetDC(0);
   if (screenDC == NULL) {
@@ -183,9 +190,71 @@ bool WindowsCursorShapeGrabber::grabPixels(const PixelFormat *pixelFormat)
   DeleteDC(destDC);
   DeleteDC(screenDC);
 
+  if (result) {
+    cacheShape(hCursor, &windowsMask);
+  }
   return result;
 }
 
+bool WindowsCursorShapeGrabber::findCachedShape(HCURSOR hCursor,
+                                                const std::vector<char> *windowsMask,
+                                                const PixelFormat *pixelFormat)
+{
+  Point hotSpot = m_cursorShape.getHotSpot();
+  Dimension dim = m_cursorShape.getDimension();
+  std::list<CachedCursor>::iterator iCached;
+  for (iCached = m_cache.begin(); iCached != m_cache.end(); iCached++) {
+    if (iCached->hCursor != hCursor) {
+      continue;
+    }
+    const CursorShape *shape = iCached->shape;
+    PixelFormat shapePf = shape->getPixelFormat();
+    Point shapeHotSpot = shape->getHotSpot();
+    Dimension shapeDim = shape->getDimension();
+    if (iCached->windowsMask != *windowsMask ||
+        !shapePf.isEqualTo(pixelFormat) ||
+        !shapeHotSpot.isEqualTo(&hotSpot) || !shapeDim.isEqualTo(&dim)) {
+      // The handle belongs to another cursor now.
+      delete iCached->shape;
+      m_cache.erase(iCached);
+      return false;
+    }
+    if (!m_cursorShape.clone(shape)) {
+      return false;
+    }
+    m_cache.splice(m_cache.begin(), m_cache, iCached);
+    return true;
+  }
+  return false;
+}
+
+void WindowsCursorShapeGrabber::cacheShape(HCURSOR hCursor,
+                                           const std::vector<char> *windowsMask)
+{
+  CachedCursor cached;
+  cached.hCursor = hCursor;
+  cached.windowsMask = *windowsMask;
+  cached.shape = new CursorShape;
+  if (!cached.shape->clone(&m_cursorShape)) {
+    delete cached.shape;
+    return;
+  }
+  m_cache.push_front(cached);
+  if (m_cache.size() > CACHE_SIZE) {
+    delete m_cache.back().shape;
+    m_cache.pop_back();
+  }
+}
+
+void WindowsCursorShapeGrabber::clearCache()
+{
+  std::list<CachedCursor>::iterator iCached;
+  for (iCached = m_cache.begin(); iCached != m_cache.end(); iCached++) {
+    delete iCached->shape;
+  }
+  m_cache.clear();
+}
+
 HCURSOR WindowsCursorShapeGrabber::getHCursor()
 {
   CURSORINFO cursorInfo;
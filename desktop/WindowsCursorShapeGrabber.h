@@ -29,6 +29,11 @@
 #include "util/CommonHeader.h"
 #include "win-system/Screen.h"
 
+#include <list>
+
+// Grabs the shape of the current cursor. The recently grabbed shapes are
+// cached by the cursor handle, so switching between the usual cursors
+// costs only the reading of the mask bitmap.
 class WindowsCursorShapeGrabber : public CursorShapeGrabber
 {
 public:
@@ -44,8 +49,29 @@ private:
 
   HCURSOR getHCursor();
 
+  // A grabbed shape with the Windows mask of the cursor, which tells if the
+  // handle has been reused by another cursor.
+  struct CachedCursor
+  {
+    HCURSOR hCursor;
+    std::vector<char> windowsMask;
+    CursorShape *shape;
+  };
+
+  // Puts the cached shape of the cursor into m_cursorShape if the cursor
+  // has been grabbed before with the same mask and properties.
+  bool findCachedShape(HCURSOR hCursor, const std::vector<char> *windowsMask,
+                       const PixelFormat *pixelFormat);
+  // Caches m_cursorShape, dropping the least recently used shape.
+  void cacheShape(HCURSOR hCursor, const std::vector<char> *windowsMask);
+  void clearCache();
+
+  static const size_t CACHE_SIZE = 16;
+
   HCURSOR m_lastHCursor;
   Screen m_screen;
+  // The most recently used shapes first.
+  std::list<CachedCursor> m_cache;
 };
 
 #endif // __WINDOWSMOUSEGRABBER_H__
@@ -27,7 +27,6 @@
 WindowsScreenGrabber::WindowsScreenGrabber(void)
 : m_destDC(NULL), m_screenDC(NULL), m_hbmDIB(NULL), m_hbmOld(NULL)
 {
-  m_serverConfig = Configurator::getInstance()->getServerConfig();
   setWorkRectDefault();
   resume();
   m_hasStartedSignal.waitForEvent();
@@ -213,7 +212,7 @@ bool WindowsScreenGrabber::grabByDIBSection(const Rect *rect)
   }
 
   DWORD bitBltFlag;
-  if (m_serverConfig->getGrabTransparentWindowsFlag()) {
+  if (Configurator::getConfigSnapshot()->getGrabTransparentWindowsFlag()) {
     bitBltFlag = SRCCOPY | CAPTUREBLT;
   } else {
     bitBltFlag = SRCCOPY;
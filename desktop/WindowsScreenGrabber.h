@@ -104,7 +104,6 @@ protected:
 
 private:
   Dimension m_dibSectionDim;
-  ServerConfig *m_serverConfig;
 
   Screen m_screen;
 };
@@ -28,26 +28,67 @@
 #include "win-system/Keyboard.h"
 #include "gui/WindowFinder.h"
 #include "util/BrokenHandleException.h"
+#include "util/Exception.h"
+#include "thread/AutoLock.h"
 
 WindowsUserInput::WindowsUserInput(ClipboardListener *clipboardListener,
                                    bool ctrlAltDelEnabled,
-                                   LogWriter *log)
+                                   LogWriter *log,
+                                   WindowChangeListener *windowChangeListener,
+                                   DisplayChangeListener *displayChangeListener)
 : m_prevKeyFlag(0),
   m_inputInjector(ctrlAltDelEnabled, log),
+  m_windowChangeHook(0),
+  m_windowChangeListener(windowChangeListener),
+  m_displayChangeWatcher(0),
+  m_displayChangeListener(displayChangeListener),
+  m_windowsGeneration(0),
+  m_appRegionGeneration(-1),
+  m_appRegionProcId(0),
   m_log(log)
 {
   m_clipboard = new WindowsClipboard(clipboardListener, m_log);
+  try {
+    m_windowChangeHook = new WindowChangeHook(this, m_log);
+  } catch (Exception &e) {
+    m_log->error(_T("Application regions will not be cached: %s"),
+                 e.getMessage());
+  }
+  try {
+    m_displayChangeWatcher = new DisplayChangeWatcher(this, m_log);
+  } catch (Exception &e) {
+    m_log->error(_T("Display changes will not be watched: %s"),
+                 e.getMessage());
+  }
 }
 
 WindowsUserInput::~WindowsUserInput(void)
 {
+  delete m_displayChangeWatcher;
+  delete m_windowChangeHook;
   delete m_clipboard;
 }
 
+void WindowsUserInput::onWindowsChanged()
+{
+  InterlockedIncrement(&m_windowsGeneration);
+  if (m_windowChangeListener != 0) {
+    m_windowChangeListener->onWindowsChanged();
+  }
+}
+
+void WindowsUserInput::onDisplayChanged()
+{
+  if (m_displayChangeListener != 0) {
+    m_displayChangeListener->onDisplayChanged();
+  }
+}
+
 // FIXME: refactor this horror.
 void WindowsUserInput::setMouseEvent(const Point newPos, UINT8 keyFlag)
 {
 	m_log->debug(_T("setMouseEvent (%d,%d):%d"), newPos.x, newPos.x, keyFlag);
+  AutoLock al(&m_injectorLock);
   if (GetSystemMetrics(SM_SWAPBUTTON))
   {
     // read values of first and third bytes..
@@ -128,8 +169,11 @@ void WindowsUserInput::setMouseEvent(const Point newPos, UINT8 keyFlag)
   input.mi.dx = x;
   input.mi.dy = y;
   input.mi.mouseData = mouseWheelValue;
-  SendInput(1, &input, sizeof(INPUT));
-  DWORD error = GetLastError();
+  try {
+    m_inputInjector.injectInput(&input);
+  } catch (Exception &e) {
+    m_log->debug(_T("Exception while processing mouse event: %s"), e.getMessage());
+  }
 }
 
 void WindowsUserInput::setNewClipboard(const StringStorage *newClipboard)
@@ -148,6 +192,7 @@ void WindowsUserInput::setKeyboardEvent(UINT32 keySym, bool down)
     bool release = !down;
     bool extended;
 
+    AutoLock al(&m_injectorLock);
     if (m_keyMap.keySymToVirtualCode(keySym, &vkCode, &extended)) {
       m_inputInjector.injectKeyEvent(vkCode, release, extended);
     } else if (m_keyMap.keySymToUnicodeChar(keySym, &ch)) {
@@ -162,6 +207,22 @@ void WindowsUserInput::setKeyboardEvent(UINT32 keySym, bool down)
   }
 }
 
+void WindowsUserInput::beginInputBatch()
+{
+  AutoLock al(&m_injectorLock);
+  m_inputInjector.beginBatch();
+}
+
+void WindowsUserInput::endInputBatch()
+{
+  AutoLock al(&m_injectorLock);
+  try {
+    m_inputInjector.endBatch();
+  } catch (Exception &e) {
+    m_log->error(_T("Exception while injecting input events: %s"), e.getMessage());
+  }
+}
+
 void WindowsUserInput::getCurrentUserInfo(StringStorage *desktopName,
                                           StringStorage *userName)
 {
@@ -175,12 +236,7 @@ void WindowsUserInput::getCurrentUserInfo(StringStorage *desktopName,
 
 void WindowsUserInput::getPrimaryDisplayCoords(Rect *rect)
 {
-  rect->left = 0;
-  rect->top = 0;
-  rect->right = GetSystemMetrics(SM_CXSCREEN);
-  rect->bottom = GetSystemMetrics(SM_CYSCREEN);
-  rect->move(-GetSystemMetrics(SM_XVIRTUALSCREEN),
-             -GetSystemMetrics(SM_YVIRTUALSCREEN));
+  m_winDisplays.getPrimaryDisplayCoords(rect);
 }
 
 void WindowsUserInput::getDisplayNumberCoords(Rect *rect,
@@ -201,8 +257,7 @@ void WindowsUserInput::getNormalizedRect(Rect *rect)
 
 void WindowsUserInput::toFbCoordinates(Rect *rect)
 {
-  rect->move(-GetSystemMetrics(SM_XVIRTUALSCREEN),
-             -GetSystemMetrics(SM_YVIRTUALSCREEN));
+  m_winDisplays.toFbCoordinates(rect);
 }
 
 void WindowsUserInput::getWindowCoords(HWND hwnd, Rect *rect)
@@ -220,12 +275,49 @@ void WindowsUserInput::getWindowCoords(HWND hwnd, Rect *rect)
   }
 }
 
+void WindowsUserInput::getForegroundWindowCoords(Rect *rect)
+{
+  rect->clear();
+  HWND hwnd = GetForegroundWindow();
+  RECT winRect;
+  if (hwnd != 0 && GetWindowRect(hwnd, &winRect)) {
+    rect->fromWindowsRect(&winRect);
+    rect->move(-GetSystemMetrics(SM_XVIRTUALSCREEN),
+               -GetSystemMetrics(SM_YVIRTUALSCREEN));
+  }
+}
+
 HWND WindowsUserInput::getWindowHandleByName(const StringStorage *windowName)
 {
   return WindowFinder::findFirstWindowByName(*windowName);
 }
 
+bool WindowsUserInput::isWindowChangeReported() const
+{
+  return m_windowChangeHook != 0 && m_windowChangeHook->isInstalled();
+}
+
 void WindowsUserInput::getApplicationRegion(unsigned int procId, Region *region)
+{
+  bool useCache = isWindowChangeReported();
+  // The generation is read before the windows are enumerated, so a change
+  // during the enumeration makes the result stale at once.
+  LONG generation = m_windowsGeneration;
+  AutoLock al(&m_appRegionLock);
+  if (useCache && generation == m_appRegionGeneration &&
+      procId == m_appRegionProcId) {
+    *region = m_appRegion;
+    return;
+  }
+  computeApplicationRegion(procId, region);
+  if (useCache) {
+    m_appRegion = *region;
+    m_appRegionProcId = procId;
+    m_appRegionGeneration = generation;
+  }
+}
+
+void WindowsUserInput::computeApplicationRegion(unsigned int procId, Region *region)
 {
   region->clear();
   HWND hForegr = GetWindow(GetForegroundWindow(), GW_HWNDLAST);
@@ -27,22 +27,34 @@
 
 #include "UserInput.h"
 #include "WindowsClipboard.h"
+#include "WindowChangeHook.h"
+#include "DisplayChangeWatcher.h"
 #include "util/Keymap.h"
 #include "win-system/InputInjector.h"
 #include "win-system/WindowsDisplays.h"
 #include "log-writer/LogWriter.h"
+#include "thread/LocalMutex.h"
 
-class WindowsUserInput : public UserInput
+class WindowsUserInput : public UserInput, private WindowChangeListener,
+                         private DisplayChangeListener
 {
 public:
+  // If windowChangeListener is not zero, it's notified about the changes
+  // of the top-level windows, which change the application regions.
+  // If displayChangeListener is not zero, it's notified about the changes
+  // of the display layout.
   WindowsUserInput(ClipboardListener *clipboardListener,
                    bool ctrlAltDelEnabled,
-                   LogWriter *log);
+                   LogWriter *log,
+                   WindowChangeListener *windowChangeListener = 0,
+                   DisplayChangeListener *displayChangeListener = 0);
   virtual ~WindowsUserInput(void);
 
   virtual void setNewClipboard(const StringStorage *newClipboard);
   virtual void setMouseEvent(const Point newPos, UINT8 keyFlag);
   virtual void setKeyboardEvent(UINT32 keySym, bool down);
+  virtual void beginInputBatch();
+  virtual void endInputBatch();
 
   virtual void getCurrentUserInfo(StringStorage *desktopName,
                                   StringStorage *userName);
@@ -52,23 +64,52 @@ public:
   virtual void getNormalizedRect(Rect *rect);
   virtual void getPrimaryDisplayCoords(Rect *rect);
   virtual void getWindowCoords(HWND hwnd, Rect *rect);
+  virtual void getForegroundWindowCoords(Rect *rect);
   virtual HWND getWindowHandleByName(const StringStorage *windowName);
+  // The region is kept until the top-level windows change, if the window
+  // change hook is installed.
   virtual void getApplicationRegion(unsigned int procId, Region *region);
   virtual bool isApplicationInFocus(unsigned int procId);
 
+  // Returns true if the changes of the windows are reported, so the
+  // application regions may be kept until the next report.
+  bool isWindowChangeReported() const;
+
   virtual void initKeyFlag(UINT8 initValue) { m_prevKeyFlag = initValue; }
 
 protected:
   void toFbCoordinates(Rect *rect);
 
+  virtual void onWindowsChanged();
+  virtual void onDisplayChanged();
+  void computeApplicationRegion(unsigned int procId, Region *region);
+
   WindowsClipboard *m_clipboard;
   WindowsDisplays m_winDisplays;
 
   Keymap m_keyMap;
   InputInjector m_inputInjector;
+  // Serializes the input of several clients, as the injector holds
+  // the modifier states and the batch.
+  LocalMutex m_injectorLock;
 
   UINT8 m_prevKeyFlag;
 
+  // Application region of the m_appRegionGeneration window layout,
+  // protected by m_appRegionLock. The generation is incremented by the
+  // thread of the hook.
+  WindowChangeHook *m_windowChangeHook;
+  WindowChangeListener *m_windowChangeListener;
+  volatile LONG m_windowsGeneration;
+  LONG m_appRegionGeneration;
+  unsigned int m_appRegionProcId;
+  Region m_appRegion;
+  LocalMutex m_appRegionLock;
+
+  // Keeps the display layout of m_winDisplays until the next change.
+  DisplayChangeWatcher *m_displayChangeWatcher;
+  DisplayChangeListener *m_displayChangeListener;
+
   LogWriter *m_log;
 };
 
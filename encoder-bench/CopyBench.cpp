@@ -0,0 +1,262 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CopyBench.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "desktop/DirtyTileDetector.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Screen sizes measured by the benchmark.
+static const int SIZES[][2] = {
+  { 1920, 1080 },
+  { 2560, 1440 },
+  { 3840, 2160 }
+};
+
+// Frame buffers of the given size in the usual 32-bit format, filled with
+// something other than zeros.
+static void initFrameBuffers(int width, int height,
+                             FrameBuffer *dst, FrameBuffer *src)
+{
+  PixelFormat pf = StandardPixelFormatFactory::create32bppPixelFormat();
+  Dimension dim(width, height);
+  dst->setProperties(&dim, &pf);
+  src->setProperties(&dim, &pf);
+  memset(dst->getBuffer(), 0x11, dst->getBufferSize());
+  memset(src->getBuffer(), 0x5a, src->getBufferSize());
+}
+
+static double getMilliseconds(const LARGE_INTEGER *start,
+                              const LARGE_INTEGER *end)
+{
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  return (double)(end->QuadPart - start->QuadPart) * 1000.0 /
+         (double)frequency.QuadPart;
+}
+
+double CopyBench::measureMemcpy(int width, int height)
+{
+  FrameBuffer dst, src;
+  initFrameBuffers(width, height, &dst, &src);
+  int stride = dst.getBytesPerRow();
+
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  for (int i = 0; i < ITERATIONS; i++) {
+    UINT8 *pdst = (UINT8 *)dst.getBuffer();
+    const UINT8 *psrc = (const UINT8 *)src.getBuffer();
+    for (int y = 0; y < height; y++, pdst += stride, psrc += stride) {
+      memcpy(pdst, psrc, stride);
+    }
+  }
+  QueryPerformanceCounter(&end);
+  return getMilliseconds(&start, &end) / ITERATIONS;
+}
+
+double CopyBench::measureCopyFrom(int width, int height)
+{
+  FrameBuffer dst, src;
+  initFrameBuffers(width, height, &dst, &src);
+
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  for (int i = 0; i < ITERATIONS; i++) {
+    dst.copyFrom(&src, 0, 0);
+  }
+  QueryPerformanceCounter(&end);
+  return getMilliseconds(&start, &end) / ITERATIONS;
+}
+
+double CopyBench::measureMove(int width, int height)
+{
+  FrameBuffer dst, src;
+  initFrameBuffers(width, height, &dst, &src);
+  // Scrolling up by a few lines moves almost the whole frame.
+  Rect dstRect(0, 0, width, height - 16);
+
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  for (int i = 0; i < ITERATIONS; i++) {
+    dst.move(&dstRect, 0, 16);
+  }
+  QueryPerformanceCounter(&end);
+  return getMilliseconds(&start, &end) / ITERATIONS;
+}
+
+double CopyBench::measureDiff(int width, int height)
+{
+  FrameBuffer oldFb, newFb;
+  initFrameBuffers(width, height, &oldFb, &newFb);
+  // Equal frames are the worst case, every row of every tile is compared.
+  oldFb.copyFrom(&newFb, 0, 0);
+  Rect rect(0, 0, width, height);
+  DirtyTileDetector detector;
+  std::vector<Rect> dirtyRects;
+
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  for (int i = 0; i < ITERATIONS; i++) {
+    dirtyRects.clear();
+    detector.detect(&rect, &oldFb, &newFb, &dirtyRects);
+  }
+  QueryPerformanceCounter(&end);
+  return getMilliseconds(&start, &end) / ITERATIONS;
+}
+
+void CopyBench::initChangedFrames(int width, int height,
+                                  FrameBuffer *frame0, FrameBuffer *frame1)
+{
+  initFrameBuffers(width, height, frame0, frame1);
+  frame1->copyFrom(frame0, 0, 0);
+  for (int y = 0; y < height; y++) {
+    UINT32 *row = (UINT32 *)frame1->getBufferPtr(0, y);
+    for (int x = y % 8; x < width; x += 8) {
+      row[x] ^= 0xffffff;
+    }
+  }
+}
+
+void CopyBench::trimChangedRect(const FrameBuffer *oldFb,
+                                const FrameBuffer *newFb, Rect *rect)
+{
+  const int bytesPerPixel = oldFb->getBytesPerPixel();
+  const int bytesInRow = rect->getWidth() * bytesPerPixel;
+  int bottom = rect->top + 1;
+  for (int y = rect->bottom - 1; y > rect->top; y--) {
+    if (memcmp(oldFb->getBufferPtr(rect->left, y),
+               newFb->getBufferPtr(rect->left, y), bytesInRow) != 0) {
+      bottom = y + 1;
+      break;
+    }
+  }
+  int leftDelta = bytesInRow - 1;
+  int rightDelta = 0;
+  for (int y = rect->top; y < bottom; y++) {
+    const UINT8 *oldPtr = (const UINT8 *)oldFb->getBufferPtr(rect->left, y);
+    const UINT8 *newPtr = (const UINT8 *)newFb->getBufferPtr(rect->left, y);
+    for (int i = 0; i < bytesInRow - 1; i++) {
+      if (oldPtr[i] != newPtr[i]) {
+        leftDelta = min(leftDelta, i);
+        break;
+      }
+    }
+    for (int i = bytesInRow - 1; i > 0; i--) {
+      if (oldPtr[i] != newPtr[i]) {
+        rightDelta = max(rightDelta, i);
+        break;
+      }
+    }
+  }
+  rect->bottom = bottom;
+  rect->right = rect->left + rightDelta / bytesPerPixel + 1;
+  rect->left += leftDelta / bytesPerPixel;
+}
+
+double CopyBench::measureDiffThenCopy(int width, int height)
+{
+  FrameBuffer oldFb, frames[2];
+  initChangedFrames(width, height, &frames[0], &frames[1]);
+  PixelFormat pf = frames[0].getPixelFormat();
+  Dimension dim(width, height);
+  oldFb.setProperties(&dim, &pf);
+  oldFb.copyFrom(&frames[0], 0, 0);
+  Rect rect(0, 0, width, height);
+  DirtyTileDetector detector;
+  std::vector<Rect> dirtyRects;
+
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  for (int i = 0; i < ITERATIONS; i++) {
+    // Every iteration brings oldFb to the other frame.
+    const FrameBuffer *newFb = &frames[(i + 1) % 2];
+    dirtyRects.clear();
+    detector.detect(&rect, &oldFb, newFb, &dirtyRects);
+    std::vector<Rect>::iterator iRect;
+    for (iRect = dirtyRects.begin(); iRect < dirtyRects.end(); iRect++) {
+      trimChangedRect(&oldFb, newFb, &(*iRect));
+    }
+    for (iRect = dirtyRects.begin(); iRect < dirtyRects.end(); iRect++) {
+      oldFb.copyFrom(&(*iRect), newFb, iRect->left, iRect->top);
+    }
+  }
+  QueryPerformanceCounter(&end);
+  return getMilliseconds(&start, &end) / ITERATIONS;
+}
+
+double CopyBench::measureDiffAndCopy(int width, int height)
+{
+  FrameBuffer oldFb, frames[2];
+  initChangedFrames(width, height, &frames[0], &frames[1]);
+  PixelFormat pf = frames[0].getPixelFormat();
+  Dimension dim(width, height);
+  oldFb.setProperties(&dim, &pf);
+  oldFb.copyFrom(&frames[0], 0, 0);
+  Rect rect(0, 0, width, height);
+  DirtyTileDetector detector;
+  std::vector<Rect> changedRects;
+
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  for (int i = 0; i < ITERATIONS; i++) {
+    changedRects.clear();
+    detector.detectAndCopy(&rect, &oldFb, &frames[(i + 1) % 2],
+                           &changedRects);
+  }
+  QueryPerformanceCounter(&end);
+  return getMilliseconds(&start, &end) / ITERATIONS;
+}
+
+void CopyBench::run()
+{
+  _tprintf(_T("%-10s %8s %12s %12s %12s %12s %10s\n"),
+           _T("size"), _T("MB"), _T("memcpy ms"), _T("copyFrom ms"),
+           _T("move ms"), _T("diff ms"), _T("GB/s"));
+  _tprintf(_T("%-10s %8s %12s %12s %10s\n"),
+           _T(""), _T(""), _T("2 passes ms"), _T("1 pass ms"), _T("saved %"));
+  size_t count = sizeof(SIZES) / sizeof(SIZES[0]);
+  for (size_t i = 0; i < count; i++) {
+    int width = SIZES[i][0];
+    int height = SIZES[i][1];
+    double megabytes = (double)width * height * 4 / (1024.0 * 1024.0);
+    double memcpyTime = measureMemcpy(width, height);
+    double copyFromTime = measureCopyFrom(width, height);
+    double moveTime = measureMove(width, height);
+    double diffTime = measureDiff(width, height);
+    double speed = copyFromTime > 0.0 ?
+      megabytes / 1024.0 / (copyFromTime / 1000.0) : 0.0;
+    _tprintf(_T("%4dx%-5d %8.1f %12.2f %12.2f %12.2f %12.2f %10.2f\n"),
+             width, height, megabytes, memcpyTime, copyFromTime, moveTime,
+             diffTime, speed);
+    double twoPassTime = measureDiffThenCopy(width, height);
+    double onePassTime = measureDiffAndCopy(width, height);
+    double saved = twoPassTime > 0.0 ?
+      (twoPassTime - onePassTime) * 100.0 / twoPassTime : 0.0;
+    _tprintf(_T("%-10s %8s %12.2f %12.2f %10.1f\n"),
+             _T(""), _T(""), twoPassTime, onePassTime, saved);
+  }
+}
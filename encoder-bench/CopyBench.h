@@ -0,0 +1,64 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __COPYBENCH_H__
+#define __COPYBENCH_H__
+
+#include "util/CommonHeader.h"
+#include "rfb/FrameBuffer.h"
+
+// Measures full-frame copies of FrameBuffer (copyFrom() and a vertical
+// move() as done for scrolling) on common screen sizes and compares them
+// with the plain row-by-row memcpy() the frame buffer used before. The
+// comparison of two equal frames by DirtyTileDetector is measured too, as
+// is the filtering of a changed frame done in two passes (comparison and
+// trimming, then copying) and in the single pass of detectAndCopy().
+class CopyBench
+{
+public:
+  // Prints a table with one line per screen size to the standard output.
+  static void run();
+
+private:
+  // Returns the average time of one copy in milliseconds.
+  static double measureMemcpy(int width, int height);
+  static double measureCopyFrom(int width, int height);
+  static double measureMove(int width, int height);
+  static double measureDiff(int width, int height);
+  static double measureDiffThenCopy(int width, int height);
+  static double measureDiffAndCopy(int width, int height);
+
+  // Fills the frame buffers with two frames which differ in one pixel of
+  // every eight, so that every row of every tile is changed.
+  static void initChangedFrames(int width, int height,
+                                FrameBuffer *frame0, FrameBuffer *frame1);
+  // Trims the rectangle to the changed pixels as UpdateFilter did before
+  // the single pass filtering.
+  static void trimChangedRect(const FrameBuffer *oldFb,
+                              const FrameBuffer *newFb, Rect *rect);
+
+  static const int ITERATIONS = 50;
+};
+
+#endif // __COPYBENCH_H__
@@ -0,0 +1,267 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncoderBench.h"
+#include "fb-update-sender/UpdateTraceReader.h"
+#include "fb-update-sender/RectMerger.h"
+#include "rfb-sconn/EncoderStore.h"
+#include "rfb-sconn/EncodeOptions.h"
+#include "rfb-sconn/TightEncoder.h"
+#include "rfb/EncodingDefs.h"
+#include "region/Region.h"
+#include "util/StringParser.h"
+#include "util/Exception.h"
+#include "win-system/DynamicLibrary.h"
+#include "zlib/zlib.h"
+
+struct EncodingName
+{
+  const TCHAR *name;
+  int code;
+  bool gridSplit;
+};
+
+static const EncodingName ENCODING_NAMES[] = {
+  { _T("raw"), EncodingDefs::RAW, false },
+  { _T("rre"), EncodingDefs::RRE, false },
+  { _T("corre"), EncodingDefs::CORRE, false },
+  { _T("hextile"), EncodingDefs::HEXTILE, false },
+  { _T("zrle"), EncodingDefs::ZRLE, false },
+  { _T("tight"), EncodingDefs::TIGHT, false },
+  { _T("tightgrid"), EncodingDefs::TIGHT, true }
+};
+
+static const size_t NUM_ENCODING_NAMES =
+  sizeof(ENCODING_NAMES) / sizeof(ENCODING_NAMES[0]);
+
+// QueryThreadCycleTime() is not available before Windows Vista.
+typedef BOOL (WINAPI *PFNQUERYTHREADCYCLETIME)(HANDLE, PULONG64);
+
+BenchOptions::BenchOptions()
+: encoding(EncodingDefs::RAW),
+  compressionLevel(-1),
+  qualityLevel(-1),
+  gridSplit(false)
+{
+}
+
+bool BenchOptions::parse(const TCHAR *str)
+{
+  StringStorage optionsString(str);
+  size_t count = 0;
+  optionsString.split(_T(":"), NULL, &count);
+  if (count == 0 || count > 3) {
+    return false;
+  }
+  std::vector<StringStorage> parts(count);
+  optionsString.split(_T(":"), &parts.front(), &count);
+  size_t i;
+  for (i = 0; i < NUM_ENCODING_NAMES; i++) {
+    if (parts[0].isEqualTo(ENCODING_NAMES[i].name)) {
+      encoding = ENCODING_NAMES[i].code;
+      gridSplit = ENCODING_NAMES[i].gridSplit;
+      break;
+    }
+  }
+  if (i == NUM_ENCODING_NAMES) {
+    return false;
+  }
+  int levels[2] = { -1, -1 };
+  for (i = 1; i < parts.size(); i++) {
+    if (!StringParser::parseInt(parts[i].getString(), &levels[i - 1]) ||
+        levels[i - 1] < 0 || levels[i - 1] > 9) {
+      return false;
+    }
+  }
+  compressionLevel = levels[0];
+  qualityLevel = levels[1];
+  return true;
+}
+
+void BenchOptions::toString(StringStorage *str) const
+{
+  const TCHAR *name = _T("?");
+  for (size_t i = 0; i < NUM_ENCODING_NAMES; i++) {
+    if (ENCODING_NAMES[i].code == encoding &&
+        ENCODING_NAMES[i].gridSplit == gridSplit) {
+      name = ENCODING_NAMES[i].name;
+    }
+  }
+  str->setString(name);
+  if (compressionLevel >= 0 || qualityLevel >= 0) {
+    StringStorage levels;
+    levels.format(_T(":%d"), compressionLevel);
+    str->appendString(levels.getString());
+  }
+  if (qualityLevel >= 0) {
+    StringStorage levels;
+    levels.format(_T(":%d"), qualityLevel);
+    str->appendString(levels.getString());
+  }
+}
+
+BenchResult::BenchResult()
+: frames(0),
+  rawBytes(0),
+  encodedBytes(0),
+  rects(0),
+  seconds(0.0),
+  cpuCycles(0),
+  checksum(0)
+{
+}
+
+CountingOutputStream::CountingOutputStream()
+: m_totalWritten(0),
+  m_checksum(crc32(0, Z_NULL, 0))
+{
+}
+
+CountingOutputStream::~CountingOutputStream()
+{
+}
+
+size_t CountingOutputStream::write(const void *buffer, size_t len)
+{
+  m_totalWritten += len;
+  m_checksum = crc32(m_checksum, (const Bytef *)buffer, (uInt)len);
+  return len;
+}
+
+UINT64 CountingOutputStream::getTotalWritten() const
+{
+  return m_totalWritten;
+}
+
+UINT32 CountingOutputStream::getChecksum() const
+{
+  return m_checksum;
+}
+
+EncoderBench::EncoderBench(const TCHAR *traceFileName)
+: m_traceFileName(traceFileName)
+{
+}
+
+EncoderBench::~EncoderBench()
+{
+}
+
+void EncoderBench::run(const BenchOptions *options, BenchResult *result)
+{
+  *result = BenchResult();
+
+  std::vector<int> encodings;
+  encodings.push_back(options->encoding);
+  if (options->compressionLevel >= 0) {
+    encodings.push_back(PseudoEncDefs::COMPR_LEVEL_0 +
+                        options->compressionLevel);
+  }
+  if (options->qualityLevel >= 0) {
+    encodings.push_back(PseudoEncDefs::QUALITY_LEVEL_0 +
+                        options->qualityLevel);
+  }
+  EncodeOptions encodeOptions;
+  encodeOptions.setEncodings(&encodings);
+
+  CountingOutputStream counter;
+  DataOutputStream output(&counter);
+  PixelConverter pixelConverter;
+  EncoderStore encoders(&pixelConverter, &output);
+  encoders.selectEncoder(options->encoding);
+  Encoder *encoder = encoders.getEncoder();
+  if (options->encoding == EncodingDefs::TIGHT) {
+    ((TightEncoder *)encoder)->setSolidAreaSearch(!options->gridSplit);
+  }
+
+  UpdateTraceReader reader(m_traceFileName.getString());
+  FrameBuffer frameBuffer;
+  Region changedRegion;
+  std::vector<CopyMove> copies;
+  std::vector<Rect> baseRects;
+  std::vector<Rect> rects;
+  std::vector<Rect> moveRects;
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  LONGLONG ticks = 0;
+  HANDLE thread = GetCurrentThread();
+  DynamicLibrary kernel(_T("kernel32.dll"));
+  PFNQUERYTHREADCYCLETIME queryThreadCycleTime =
+    (PFNQUERYTHREADCYCLETIME)kernel.getProcAddress("QueryThreadCycleTime");
+
+  while (reader.readFrame(&frameBuffer, &changedRegion, &copies)) {
+    // The client is assumed to use the pixel format of the server.
+    PixelFormat pf = frameBuffer.getPixelFormat();
+
+    LARGE_INTEGER start, end;
+    ULONG64 startCycles = 0, endCycles = 0;
+    if (queryThreadCycleTime != 0) {
+      queryThreadCycleTime(thread, &startCycles);
+    }
+    QueryPerformanceCounter(&start);
+
+    pixelConverter.setPixelFormats(&pf, &pf);
+    size_t numRects = 0;
+    std::vector<CopyMove>::const_iterator iMove;
+    for (iMove = copies.begin(); iMove != copies.end(); iMove++) {
+      iMove->getRects(&moveRects);
+      numRects += moveRects.size();
+    }
+    size_t numCopyRects = numRects;
+
+    rects.clear();
+    changedRegion.getRectVector(&baseRects);
+    UINT64 rectsMerged = 0;
+    UINT64 pixelsAdded = 0;
+    RectMerger::merge(&baseRects, encoder->getRectOverhead(&encodeOptions),
+                      &rectsMerged, &pixelsAdded);
+    std::vector<Rect>::iterator iRect;
+    for (iRect = baseRects.begin(); iRect != baseRects.end(); iRect++) {
+      encoder->splitRectangle(&*iRect, &rects, &frameBuffer, &encodeOptions);
+    }
+    for (iRect = rects.begin(); iRect != rects.end(); iRect++) {
+      encoder->sendRectangle(&*iRect, &frameBuffer, &encodeOptions);
+    }
+    numRects += rects.size();
+
+    QueryPerformanceCounter(&end);
+    if (queryThreadCycleTime != 0) {
+      queryThreadCycleTime(thread, &endCycles);
+    }
+    ticks += end.QuadPart - start.QuadPart;
+    result->cpuCycles += endCycles - startCycles;
+
+    result->frames++;
+    result->rects += numRects;
+    result->rawBytes += (UINT64)Rect::totalArea(&baseRects) *
+                        frameBuffer.getBytesPerPixel();
+    result->encodedBytes += UPDATE_HEADER_SIZE +
+                            numCopyRects * COPYRECT_SIZE +
+                            rects.size() * RECT_HEADER_SIZE;
+  }
+  result->encodedBytes += counter.getTotalWritten();
+  result->checksum = counter.getChecksum();
+  result->seconds = (double)ticks / (double)frequency.QuadPart;
+}
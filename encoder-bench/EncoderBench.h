@@ -0,0 +1,112 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __ENCODERBENCH_H__
+#define __ENCODERBENCH_H__
+
+#include "util/StringStorage.h"
+#include "rfb/PixelFormat.h"
+#include "io-lib/OutputStream.h"
+
+#include <vector>
+
+// Encoding and its options measured by one benchmark run.
+struct BenchOptions
+{
+  BenchOptions();
+
+  // Parses "<encoding>[:<compression>[:<quality>]]", where encoding is one
+  // of raw, rre, corre, hextile, zrle, tight and tightgrid (Tight without
+  // the solid area search). Returns false on a wrong string.
+  bool parse(const TCHAR *str);
+  void toString(StringStorage *str) const;
+
+  int encoding;
+  // Pseudo-encoding levels requested by the client, -1 if not requested.
+  int compressionLevel;
+  int qualityLevel;
+  // Tight splits the rectangles by size only.
+  bool gridSplit;
+};
+
+// Results of one benchmark run.
+struct BenchResult
+{
+  BenchResult();
+
+  UINT64 frames;
+  // Size of the changed pixels in the client pixel format.
+  UINT64 rawBytes;
+  // Size of the updates as would be sent to the client.
+  UINT64 encodedBytes;
+  UINT64 rects;
+  // Encoding time, trace reading is not included.
+  double seconds;
+  // CPU cycles of the encoding thread, 0 if not supported by the system.
+  UINT64 cpuCycles;
+  // CRC-32 of the encoded data, equal for two builds of an encoder only if
+  // they produce the same bytes.
+  UINT32 checksum;
+};
+
+// Output stream which only counts the bytes written to it and computes
+// their checksum.
+class CountingOutputStream : public OutputStream
+{
+public:
+  CountingOutputStream();
+  virtual ~CountingOutputStream();
+
+  virtual size_t write(const void *buffer, size_t len);
+
+  UINT64 getTotalWritten() const;
+  UINT32 getChecksum() const;
+
+private:
+  UINT64 m_totalWritten;
+  UINT32 m_checksum;
+};
+
+// Replays an update trace recorded by the server through the encoders the
+// same way UpdateSender does, writing the result to nowhere.
+class EncoderBench
+{
+public:
+  EncoderBench(const TCHAR *traceFileName);
+  virtual ~EncoderBench();
+
+  // Runs the whole trace through a fresh encoder with the options, so that
+  // every run is independent of the others. Throws Exception on failure.
+  void run(const BenchOptions *options, BenchResult *result);
+
+private:
+  // Sizes of the RFB framing around the encoded data, in bytes.
+  static const size_t UPDATE_HEADER_SIZE = 4;
+  static const size_t RECT_HEADER_SIZE = 12;
+  static const size_t COPYRECT_SIZE = RECT_HEADER_SIZE + 4;
+
+  StringStorage m_traceFileName;
+};
+
+#endif // __ENCODERBENCH_H__
@@ -0,0 +1,121 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncoderBench.h"
+#include "CopyBench.h"
+#include "util/Exception.h"
+#include "util/LargePages.h"
+#include <stdio.h>
+
+// Option sets measured when none is given on the command line.
+static const TCHAR *const DEFAULT_OPTIONS[] = {
+  _T("raw"),
+  _T("rre"),
+  _T("corre"),
+  _T("hextile"),
+  _T("zrle"),
+  _T("tight:1"),
+  _T("tight:6"),
+  _T("tightgrid:6"),
+  _T("tight:9"),
+  _T("tight:6:5"),
+  _T("tight:6:8")
+};
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  // The frame buffers of both runs, with and without the switch, are
+  // compared to see the effect of large pages.
+  if (argc >= 2 && _tcscmp(argv[1], _T("-largepages")) == 0) {
+    StringStorage error;
+    if (!LargePages::enable(&error)) {
+      _ftprintf(stderr, _T("Cannot use large pages: %s\n"), error.getString());
+      return 1;
+    }
+    _tprintf(_T("Frame buffers use large pages of %u KB\n"),
+             (unsigned int)(LargePages::getPageSize() / 1024));
+    argc--;
+    argv++;
+  }
+  if (argc < 2) {
+    _ftprintf(stderr, _T("Usage: encoder-bench [-largepages] <trace file>")
+                      _T(" [<encoding>[:<compression>[:<quality>]] ...]\n")
+                      _T("       encoder-bench [-largepages] -copy\n"));
+    return 1;
+  }
+  if (_tcscmp(argv[1], _T("-copy")) == 0) {
+    CopyBench::run();
+    return 0;
+  }
+
+  std::vector<BenchOptions> optionSets;
+  if (argc == 2) {
+    size_t count = sizeof(DEFAULT_OPTIONS) / sizeof(DEFAULT_OPTIONS[0]);
+    for (size_t i = 0; i < count; i++) {
+      BenchOptions options;
+      options.parse(DEFAULT_OPTIONS[i]);
+      optionSets.push_back(options);
+    }
+  }
+  for (int i = 2; i < argc; i++) {
+    BenchOptions options;
+    if (!options.parse(argv[i])) {
+      _ftprintf(stderr, _T("Wrong encoding options: %s\n"), argv[i]);
+      return 1;
+    }
+    optionSets.push_back(options);
+  }
+
+  try {
+    EncoderBench bench(argv[1]);
+    _tprintf(_T("%-12s %8s %10s %10s %7s %9s %11s %10s %8s\n"),
+             _T("options"), _T("frames"), _T("raw MB"), _T("sent MB"),
+             _T("ratio"), _T("MB/s"), _T("bytes/frame"), _T("Mcycles"),
+             _T("crc32"));
+    std::vector<BenchOptions>::const_iterator iOptions;
+    for (iOptions = optionSets.begin(); iOptions != optionSets.end();
+         iOptions++) {
+      BenchResult result;
+      bench.run(&*iOptions, &result);
+
+      StringStorage name;
+      iOptions->toString(&name);
+      double rawMB = (double)result.rawBytes / (1024.0 * 1024.0);
+      double sentMB = (double)result.encodedBytes / (1024.0 * 1024.0);
+      double ratio = result.encodedBytes != 0 ?
+        (double)result.rawBytes / (double)result.encodedBytes : 0.0;
+      double speed = result.seconds > 0.0 ? rawMB / result.seconds : 0.0;
+      double bytesPerFrame = result.frames != 0 ?
+        (double)result.encodedBytes / (double)result.frames : 0.0;
+      _tprintf(_T("%-12s %8llu %10.2f %10.2f %7.2f %9.1f %11.0f %10.1f %08x\n"),
+               name.getString(), result.frames, rawMB, sentMB, ratio, speed,
+               bytesPerFrame, (double)result.cpuCycles / 1000000.0,
+               (unsigned int)result.checksum);
+    }
+  } catch (Exception &e) {
+    _ftprintf(stderr, _T("Error: %s\n"), e.getMessage());
+    return 1;
+  }
+  return 0;
+}
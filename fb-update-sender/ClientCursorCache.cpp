@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ClientCursorCache.h"
+
+ClientCursorCache::ClientCursorCache()
+: m_slots(NUM_SLOTS),
+  m_resetClient(true)
+{
+}
+
+ClientCursorCache::~ClientCursorCache()
+{
+}
+
+void ClientCursorCache::reset()
+{
+  m_lru.clear();
+  m_slotsByChecksum.clear();
+  m_resetClient = true;
+}
+
+UINT8 ClientCursorCache::lookUp(UINT64 checksum, const PixelFormat *clientPf,
+                                UINT16 *slot)
+{
+  if (!m_clientPf.isEqualTo(clientPf)) {
+    reset();
+    m_clientPf = *clientPf;
+  }
+  UINT8 flags = m_resetClient ? RESET_CACHE : 0;
+  m_resetClient = false;
+
+  std::map<UINT64, int>::iterator found = m_slotsByChecksum.find(checksum);
+  if (found != m_slotsByChecksum.end()) {
+    *slot = (UINT16)found->second;
+    m_lru.splice(m_lru.begin(), m_lru, m_slots[found->second].lruPos);
+    return OP_HIT | flags;
+  }
+
+  int index;
+  if (m_lru.size() < (size_t)NUM_SLOTS) {
+    index = (int)m_lru.size();
+    m_lru.push_front(index);
+  } else {
+    index = m_lru.back();
+    m_slotsByChecksum.erase(m_slots[index].checksum);
+    m_lru.splice(m_lru.begin(), m_lru, --m_lru.end());
+  }
+  m_slots[index].checksum = checksum;
+  m_slots[index].lruPos = m_lru.begin();
+  m_slotsByChecksum[checksum] = index;
+  *slot = (UINT16)index;
+  return OP_STORE | flags;
+}
@@ -0,0 +1,87 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CLIENTCURSORCACHE_H__
+#define __CLIENTCURSORCACHE_H__
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "rfb/PixelFormat.h"
+#include "util/inttypes.h"
+
+//
+// ClientCursorCache keeps track of the cursor shapes cached by a client
+// supporting the cursor cache pseudo-encoding. The client keeps NUM_SLOTS
+// shapes, the server decides which shape goes to which slot replacing the
+// least recently used one, like in the tile cache encoding.
+//
+// The pseudo-rectangle of the encoding carries the hot spot and the
+// dimension of the shape like a rich cursor one, followed by an 8-bit
+// operation code and a 16-bit slot number. OP_HIT tells the client to use
+// the shape of the slot. OP_STORE is followed by the rich cursor pixels and
+// mask, the client uses the shape and saves it to the slot. The RESET_CACHE
+// flag tells the client to empty all the slots before the operation.
+//
+class ClientCursorCache
+{
+public:
+  ClientCursorCache();
+  virtual ~ClientCursorCache();
+
+  // Finds the shape with the checksum in the client slots, allocating
+  // a slot if it is not there. Returns the operation code to send, with the
+  // RESET_CACHE flag if needed, and sets slot. The client slots keep the
+  // shapes in the pixel format they have been sent in, so the cache starts
+  // over when clientPf changes.
+  UINT8 lookUp(UINT64 checksum, const PixelFormat *clientPf, UINT16 *slot);
+
+  // Forgets all the cached shapes and makes the client do the same with the
+  // next operation.
+  void reset();
+
+  static const int NUM_SLOTS = 32;
+
+  static const UINT8 OP_HIT = 0;
+  static const UINT8 OP_STORE = 1;
+  static const UINT8 RESET_CACHE = 0x80;
+
+protected:
+  struct Slot
+  {
+    UINT64 checksum;
+    std::list<int>::iterator lruPos;
+  };
+
+  std::vector<Slot> m_slots;
+  // Used slots from the most recently used one.
+  std::list<int> m_lru;
+  std::map<UINT64, int> m_slotsByChecksum;
+
+  PixelFormat m_clientPf;
+  bool m_resetClient;
+};
+
+#endif // __CLIENTCURSORCACHE_H__
@@ -0,0 +1,304 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CongestionController.h"
+#include "thread/AutoLock.h"
+#include "rfb-sconn/JpegCompressor.h"
+
+// Adaptation steps: JPEG quality caps of normal rectangles and of video
+// regions, chroma subsampling of normal rectangles, minimum compression
+// level and minimum delay between updates in milliseconds. Colored text
+// suffers from subsampled chroma at any quality, so the chroma resolution
+// is lowered only after the quality.
+static const int MAX_JPEG_QUALITY[] = { 9, 8, 6, 5, 3, 1 };
+static const int MAX_VIDEO_JPEG_QUALITY[] = { 9, 6, 5, 4, 2, 1 };
+static const int JPEG_SUBSAMPLING[] = {
+  JpegCompressor::SUBSAMPLING_444,
+  JpegCompressor::SUBSAMPLING_444,
+  JpegCompressor::SUBSAMPLING_422,
+  JpegCompressor::SUBSAMPLING_422,
+  JpegCompressor::SUBSAMPLING_420,
+  JpegCompressor::SUBSAMPLING_420
+};
+static const int MIN_COMPRESSION_LEVEL[] = { 0, 2, 6, 6, 9, 9 };
+static const unsigned int MIN_SEND_DELAY[] = { 0, 0, 20, 50, 100, 200 };
+static const int NUM_STEPS = sizeof(MIN_SEND_DELAY) / sizeof(MIN_SEND_DELAY[0]);
+
+// The queueing delay above which the path is considered congested and below
+// which it is considered free, in milliseconds.
+static const unsigned int CONGESTED_DELAY = 150;
+static const unsigned int FREE_DELAY = 50;
+// Number of free samples in a row required to step up the quality.
+static const int GOOD_SAMPLES_TO_STEP_UP = 8;
+// Number of samples after which the minimum round trip time is restarted.
+static const unsigned int MIN_RTT_LIFETIME = 500;
+
+// Client load in percent of the reporting period.
+static const unsigned int CLIENT_BUSY_LOAD = 80;
+static const unsigned int CLIENT_FREE_LOAD = 50;
+static const int GOOD_REPORTS_TO_STEP_UP = 3;
+
+CongestionController::CongestionController(bool adaptive)
+: m_adaptive(adaptive),
+  m_updateInFlight(false),
+  m_lastUpdateSize(0),
+  m_minRtt(0),
+  m_smoothedRtt(0),
+  m_minRttAge(0),
+  m_throughput(0),
+  m_rateLimit(0),
+  m_step(0),
+  m_goodSamples(0),
+  m_clientStep(0),
+  m_goodReports(0)
+{
+}
+
+CongestionController::~CongestionController()
+{
+}
+
+bool CongestionController::isAdaptive() const
+{
+  return m_adaptive;
+}
+
+void CongestionController::setRateLimit(unsigned int bytesPerSecond)
+{
+  AutoLock al(&m_lock);
+  m_rateLimit = bytesPerSecond;
+}
+
+void CongestionController::onUpdateSent(size_t dataSize, size_t queuedSize)
+{
+  AutoLock al(&m_lock);
+  m_lastUpdateTime = DateTime::now();
+  m_lastUpdateSize = dataSize;
+  m_updateInFlight = true;
+
+  // The previous updates still queued locally have not been taken by the
+  // path yet. The time to drain them is a queueing delay known right now,
+  // long before the round trip of this update ends, so it can only tell
+  // about congestion: the quality is stepped up by the round trip samples.
+  unsigned int linkRate = getLinkRate();
+  if (linkRate != 0 && queuedSize > dataSize) {
+    unsigned int queueDelay =
+      (unsigned int)((UINT64)(queuedSize - dataSize) * 1000 / linkRate);
+    if (queueDelay > CONGESTED_DELAY) {
+      updateStep(queueDelay);
+    }
+  }
+}
+
+void CongestionController::onUpdateRequested()
+{
+  AutoLock al(&m_lock);
+  if (!m_updateInFlight) {
+    return;
+  }
+  m_updateInFlight = false;
+
+  unsigned int rtt = (unsigned int)(DateTime::now() - m_lastUpdateTime).getTime();
+  addSample(rtt, m_lastUpdateSize);
+}
+
+void CongestionController::onUpdateAcknowledged(const DateTime *sendTime,
+                                                size_t dataSize)
+{
+  AutoLock al(&m_lock);
+  m_updateInFlight = false;
+  DateTime sentAt = *sendTime;
+  addSample((unsigned int)(DateTime::now() - sentAt).getTime(), dataSize);
+}
+
+size_t CongestionController::getPushWindow()
+{
+  AutoLock al(&m_lock);
+  if (getStep() > 0) {
+    return 1;
+  }
+  // Two updates in flight hide the round trip until anything is known.
+  if (m_throughput == 0 || m_minRtt == 0 || m_lastUpdateSize == 0) {
+    return 2;
+  }
+  // The bandwidth-delay product in updates, the one being sent included.
+  UINT64 pathSize = (UINT64)m_throughput * m_minRtt / 1000;
+  UINT64 window = 1 + pathSize / m_lastUpdateSize;
+  if (window < 2) {
+    return 2;
+  }
+  return window < MAX_PUSH_WINDOW ? (size_t)window : MAX_PUSH_WINDOW;
+}
+
+void CongestionController::addSample(unsigned int rtt, size_t dataSize)
+{
+  if (rtt == 0) {
+    rtt = 1;
+  }
+  if (m_minRtt == 0 || rtt < m_minRtt || m_minRttAge >= MIN_RTT_LIFETIME) {
+    m_minRtt = rtt;
+    m_minRttAge = 0;
+  }
+  m_minRttAge++;
+  m_smoothedRtt = m_smoothedRtt == 0 ? rtt : (m_smoothedRtt * 7 + rtt) / 8;
+
+  // Small updates say nothing about the available bandwidth.
+  if (dataSize >= 16 * 1024) {
+    unsigned int throughput = (unsigned int)(dataSize * 1000 / rtt);
+    m_throughput = m_throughput == 0 ? throughput : (m_throughput * 3 + throughput) / 4;
+  }
+
+  updateStep(m_smoothedRtt > m_minRtt ? m_smoothedRtt - m_minRtt : 0);
+}
+
+void CongestionController::updateStep(unsigned int queueingDelay)
+{
+  if (!isAdapting()) {
+    return;
+  }
+  if (queueingDelay > CONGESTED_DELAY) {
+    m_goodSamples = 0;
+    if (m_step < NUM_STEPS - 1) {
+      m_step++;
+      // Let the smoothed time come down before the next step.
+      m_smoothedRtt = m_minRtt + FREE_DELAY;
+    }
+  } else if (queueingDelay < FREE_DELAY) {
+    if (++m_goodSamples >= GOOD_SAMPLES_TO_STEP_UP && m_step > 0) {
+      m_step--;
+      m_goodSamples = 0;
+    }
+  }
+}
+
+void CongestionController::onClientLoad(unsigned int load, bool framesDropped)
+{
+  AutoLock al(&m_lock);
+  if (!isAdapting()) {
+    return;
+  }
+  if (load > CLIENT_BUSY_LOAD || framesDropped) {
+    m_goodReports = 0;
+    if (m_clientStep < NUM_STEPS - 1) {
+      m_clientStep++;
+    }
+  } else if (load < CLIENT_FREE_LOAD) {
+    if (++m_goodReports >= GOOD_REPORTS_TO_STEP_UP && m_clientStep > 0) {
+      m_clientStep--;
+      m_goodReports = 0;
+    }
+  }
+}
+
+bool CongestionController::isClientOverloaded()
+{
+  AutoLock al(&m_lock);
+  return isAdapting() && m_clientStep > 0;
+}
+
+bool CongestionController::isAdapting() const
+{
+  // The updates of a limited client are adapted to the limit in any case,
+  // otherwise they would be queued for seconds.
+  return m_adaptive || m_rateLimit != 0;
+}
+
+unsigned int CongestionController::getLinkRate() const
+{
+  if (m_rateLimit != 0 && (m_throughput == 0 || m_rateLimit < m_throughput)) {
+    return m_rateLimit;
+  }
+  return m_throughput;
+}
+
+int CongestionController::getStep() const
+{
+  if (!isAdapting()) {
+    return 0;
+  }
+  return max(m_step, m_clientStep);
+}
+
+unsigned int CongestionController::getSendDelay()
+{
+  AutoLock al(&m_lock);
+  int step = getStep();
+  if (step == 0) {
+    return 0;
+  }
+  unsigned int delay = MIN_SEND_DELAY[step];
+  // Do not send faster than the last update can leave the link.
+  unsigned int linkRate = getLinkRate();
+  if (linkRate != 0) {
+    delay = max(delay, (unsigned int)((UINT64)m_lastUpdateSize * 1000 / linkRate));
+  }
+  unsigned int elapsed = (unsigned int)(DateTime::now() - m_lastUpdateTime).getTime();
+  return elapsed < delay ? delay - elapsed : 0;
+}
+
+void CongestionController::adjustEncodeOptions(EncodeOptions *encodeOptions,
+                                               bool video)
+{
+  AutoLock al(&m_lock);
+  int step = getStep();
+  encodeOptions->setJpegSubsampling(video ? JpegCompressor::SUBSAMPLING_420 :
+                                            JPEG_SUBSAMPLING[step]);
+  if (step == 0) {
+    return;
+  }
+  if (encodeOptions->jpegEnabled()) {
+    int quality = encodeOptions->getJpegQualityLevel();
+    int maxQuality = video ? MAX_VIDEO_JPEG_QUALITY[step] :
+                             MAX_JPEG_QUALITY[step];
+    encodeOptions->setJpegQualityLevel(min(quality, maxQuality));
+  }
+  int compression = encodeOptions->getCompressionLevel();
+  if (compression < MIN_COMPRESSION_LEVEL[step]) {
+    encodeOptions->setCompressionLevel(MIN_COMPRESSION_LEVEL[step]);
+  }
+}
+
+bool CongestionController::isCongested()
+{
+  AutoLock al(&m_lock);
+  return getStep() > 0;
+}
+
+unsigned int CongestionController::getRoundTripTime()
+{
+  AutoLock al(&m_lock);
+  return m_smoothedRtt;
+}
+
+unsigned int CongestionController::getQueueingDelay()
+{
+  AutoLock al(&m_lock);
+  return m_smoothedRtt > m_minRtt ? m_smoothedRtt - m_minRtt : 0;
+}
+
+unsigned int CongestionController::getThroughput()
+{
+  AutoLock al(&m_lock);
+  return m_throughput;
+}
@@ -0,0 +1,163 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CONGESTIONCONTROLLER_H__
+#define __CONGESTIONCONTROLLER_H__
+
+#include "util/DateTime.h"
+#include "thread/LocalMutex.h"
+#include "rfb-sconn/EncodeOptions.h"
+
+// CongestionController estimates the state of the network path to a client
+// and adapts the frame rate and encoding levels of updates to it.
+//
+// The round trip time is measured from the moment a framebuffer update has
+// been flushed to the moment the next update request arrives: RFB clients
+// request the next update only after having received and decoded the
+// previous one, so the time grows with queueing in the network. The growth
+// of this time above the minimum seen (the queueing delay) and the send
+// throughput drive an adaptation step. Each step lowers the JPEG quality,
+// raises the compression level and adds a delay between updates.
+//
+// With continuous updates, the client does not request updates and the
+// round trip time is measured with fences instead: each pushed update is
+// followed by a fence, which the client answers after having processed the
+// update. The number of updates pushed and not answered yet is limited to
+// what the path can hold according to the estimates.
+//
+// In the static mode nothing is adapted, updates are sent whenever the
+// client requests them, as before.
+class CongestionController
+{
+public:
+  CongestionController(bool adaptive);
+  virtual ~CongestionController();
+
+  bool isAdaptive() const;
+
+  // Sets the rate in bytes per second the output is paced to, 0 if it is
+  // not limited. The updates are adapted to the lower of the limit and the
+  // measured throughput.
+  void setRateLimit(unsigned int bytesPerSecond);
+
+  // Should be called by the sender thread after an update of dataSize bytes
+  // has been written and flushed. queuedSize is the number of bytes still
+  // queued for sending at that moment, the update included.
+  void onUpdateSent(size_t dataSize, size_t queuedSize = 0);
+
+  // Should be called on receiving an update request from the client. May be
+  // called from any thread.
+  void onUpdateRequested();
+
+  // Should be called on receiving the answer to a fence that followed an
+  // update of dataSize bytes sent at sendTime. May be called from any thread.
+  void onUpdateAcknowledged(const DateTime *sendTime, size_t dataSize);
+
+  // Returns the number of pushed updates of about lastUpdateSize bytes that
+  // may be unanswered at a time, from 1 if the path is congested to
+  // MAX_PUSH_WINDOW if it is free and has a large bandwidth-delay product.
+  size_t getPushWindow();
+
+  static const size_t MAX_PUSH_WINDOW = 8;
+
+  // Should be called on receiving the decoding feedback of the client. load
+  // is the part of the reported period, in percent, the client has spent
+  // decoding or presenting the updates, framesDropped is true if some of
+  // the decoded updates have never been presented. A client which cannot
+  // keep up gets the same adaptation steps as a congested path.
+  void onClientLoad(unsigned int load, bool framesDropped);
+
+  // Returns true if the client has been reported too slow for the updates.
+  bool isClientOverloaded();
+
+  // Returns the time in milliseconds the sender should wait before sending
+  // the next update, 0 if it can be sent immediately.
+  unsigned int getSendDelay();
+
+  // Caps the JPEG quality and raises the compression level of
+  // encodeOptions according to the current adaptation step, and chooses
+  // the chroma subsampling of JPEG data. Video regions (video is true) get
+  // a lower quality cap and 4:2:0, normal lossy rectangles keep the full
+  // chroma resolution until the path gets congested. Levels not enabled by
+  // the client are not enabled here.
+  void adjustEncodeOptions(EncodeOptions *encodeOptions, bool video);
+
+  // Returns true if the updates are currently adapted to congestion, i.e.
+  // there is no spare bandwidth or the client cannot keep up.
+  bool isCongested();
+
+  // Smoothed estimates, 0 if unknown yet.
+  unsigned int getRoundTripTime();
+  unsigned int getThroughput(); // in bytes per second
+  // Growth of the round trip time above the minimum seen.
+  unsigned int getQueueingDelay();
+
+private:
+  // Adds the round trip time of an update of dataSize bytes to the
+  // estimates. Should be called with m_lock held.
+  void addSample(unsigned int rtt, size_t dataSize);
+  void updateStep(unsigned int queueingDelay);
+  // Returns true if the updates are adapted, which is the case when the
+  // adaptation is enabled or the output is limited. Should be called with
+  // m_lock held.
+  bool isAdapting() const;
+  // Returns the rate the updates leave at, 0 if unknown. Should be called
+  // with m_lock held.
+  unsigned int getLinkRate() const;
+  // Returns the adaptation step for the path and the client together.
+  // Should be called with m_lock held.
+  int getStep() const;
+
+  bool m_adaptive;
+
+  // Time and size of the last update waiting for the next request.
+  bool m_updateInFlight;
+  DateTime m_lastUpdateTime;
+  size_t m_lastUpdateSize;
+
+  // Round trip times in milliseconds.
+  unsigned int m_minRtt;
+  unsigned int m_smoothedRtt;
+  // Number of samples used to track the minimum round trip time. The
+  // minimum is restarted periodically to follow route changes.
+  unsigned int m_minRttAge;
+  // Throughput in bytes per second.
+  unsigned int m_throughput;
+  // Bandwidth limit in bytes per second, 0 means no limit.
+  unsigned int m_rateLimit;
+
+  // Current adaptation step, 0 means the full quality.
+  int m_step;
+  // Number of samples without congestion in a row.
+  int m_goodSamples;
+
+  // Adaptation step for the decoding cost of the client and the number of
+  // reports of a free client in a row.
+  int m_clientStep;
+  int m_goodReports;
+
+  LocalMutex m_lock;
+};
+
+#endif // __CONGESTIONCONTROLLER_H__
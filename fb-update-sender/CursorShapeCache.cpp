@@ -0,0 +1,113 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CursorShapeCache.h"
+#include "thread/AutoLock.h"
+
+#include "zlib/zlib.h"
+
+CursorShapeCache CursorShapeCache::s_instance;
+
+CursorShapeCache::CursorShapeCache()
+{
+}
+
+CursorShapeCache *CursorShapeCache::getInstance()
+{
+  return &s_instance;
+}
+
+UINT64 CursorShapeCache::calcChecksum(const CursorShape *shape)
+{
+  // Two independent checksums make accidental collisions negligible, like
+  // in TileCacheEncoder.
+  uLong crc = crc32(0L, Z_NULL, 0);
+  uLong adler = adler32(0L, Z_NULL, 0);
+
+  // The server pixel format is a part of the key to the conversions too.
+  Point hotSpot = shape->getHotSpot();
+  Dimension dim = shape->getDimension();
+  PixelFormat pf = shape->getPixelFormat();
+  INT32 header[8] = { hotSpot.x, hotSpot.y, dim.width, dim.height,
+                      pf.bitsPerPixel, pf.redMax << 16 | pf.greenMax,
+                      pf.blueMax << 16 | pf.redShift,
+                      pf.greenShift << 16 | pf.blueShift };
+  crc = crc32(crc, (const Bytef *)header, sizeof(header));
+  adler = adler32(adler, (const Bytef *)header, sizeof(header));
+
+  const FrameBuffer *pixels = shape->getPixels();
+  if (pixels->getBufferSize() != 0) {
+    crc = crc32(crc, (const Bytef *)pixels->getBuffer(),
+                (uInt)pixels->getBufferSize());
+    adler = adler32(adler, (const Bytef *)pixels->getBuffer(),
+                    (uInt)pixels->getBufferSize());
+  }
+  if (shape->getMaskSize() != 0) {
+    crc = crc32(crc, (const Bytef *)shape->getMask(), (uInt)shape->getMaskSize());
+    adler = adler32(adler, (const Bytef *)shape->getMask(),
+                    (uInt)shape->getMaskSize());
+  }
+  return ((UINT64)(UINT32)crc << 32) | (UINT32)adler;
+}
+
+bool CursorShapeCache::find(UINT64 checksum, const PixelFormat *pf,
+                            std::vector<char> *pixels)
+{
+  AutoLock al(&m_lock);
+  std::list<Entry>::iterator it;
+  for (it = m_entries.begin(); it != m_entries.end(); it++) {
+    if (it->checksum == checksum && it->pf.isEqualTo(pf)) {
+      *pixels = it->pixels;
+      m_entries.splice(m_entries.begin(), m_entries, it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void CursorShapeCache::store(UINT64 checksum, const FrameBuffer *converted)
+{
+  PixelFormat pf = converted->getPixelFormat();
+  const char *buffer = (const char *)converted->getBuffer();
+  size_t size = converted->getBufferSize();
+
+  AutoLock al(&m_lock);
+  std::list<Entry>::iterator it;
+  for (it = m_entries.begin(); it != m_entries.end(); it++) {
+    if (it->checksum == checksum && it->pf.isEqualTo(&pf)) {
+      // Another client has converted the same shape meanwhile.
+      return;
+    }
+  }
+  m_entries.push_front(Entry());
+  Entry *entry = &m_entries.front();
+  entry->checksum = checksum;
+  entry->pf = pf;
+  if (size != 0) {
+    entry->pixels.assign(buffer, buffer + size);
+  }
+  if (m_entries.size() > MAX_ENTRIES) {
+    m_entries.pop_back();
+  }
+}
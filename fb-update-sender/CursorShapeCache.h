@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CURSORSHAPECACHE_H__
+#define __CURSORSHAPECACHE_H__
+
+#include <list>
+#include <vector>
+
+#include "rfb/CursorShape.h"
+#include "thread/LocalMutex.h"
+#include "util/inttypes.h"
+
+// Process-wide cache of cursor shapes converted to client pixel formats.
+// Every client with the same pixel format gets the pixels converted once,
+// so a cursor flipping between a few shapes is not converted on each
+// change by each client. The least recently used conversions are dropped.
+class CursorShapeCache
+{
+public:
+  static CursorShapeCache *getInstance();
+
+  // Returns the checksum of the shape, its hot spot, dimension, pixel
+  // format, pixels and mask. Shapes with equal checksums are treated as the
+  // same shape.
+  static UINT64 calcChecksum(const CursorShape *shape);
+
+  // Copies to pixels the shape with the checksum converted to pf and
+  // returns true, or returns false if there is no such conversion.
+  bool find(UINT64 checksum, const PixelFormat *pf, std::vector<char> *pixels);
+
+  // Stores the converted pixels of the shape with the checksum.
+  void store(UINT64 checksum, const FrameBuffer *converted);
+
+  static const size_t MAX_ENTRIES = 64;
+
+private:
+  CursorShapeCache();
+
+  struct Entry
+  {
+    UINT64 checksum;
+    PixelFormat pf;
+    std::vector<char> pixels;
+  };
+
+  LocalMutex m_lock;
+  // From the most recently used entry.
+  std::list<Entry> m_entries;
+
+  static CursorShapeCache s_instance;
+};
+
+#endif // __CURSORSHAPECACHE_H__
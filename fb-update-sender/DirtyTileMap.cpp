@@ -0,0 +1,122 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DirtyTileMap.h"
+#include "thread/AutoLock.h"
+
+DirtyTileMap::DirtyTileMap()
+: m_columns(0),
+  m_rows(0),
+  m_generation(0)
+{
+}
+
+DirtyTileMap::~DirtyTileMap()
+{
+}
+
+void DirtyTileMap::markChanged(const Region *changedRegion)
+{
+  std::vector<Rect> rects;
+  changedRegion->getRectVector(&rects);
+  if (rects.empty()) {
+    return;
+  }
+
+  AutoLock al(&m_lock);
+  m_generation++;
+  for (std::vector<Rect>::iterator iRect = rects.begin();
+       iRect != rects.end(); iRect++) {
+    if (iRect->isEmpty() || iRect->left < 0 || iRect->top < 0) {
+      continue;
+    }
+    int firstCol = iRect->left / TILE_SIZE;
+    int firstRow = iRect->top / TILE_SIZE;
+    int endCol = (iRect->right + TILE_SIZE - 1) / TILE_SIZE;
+    int endRow = (iRect->bottom + TILE_SIZE - 1) / TILE_SIZE;
+    grow(endCol, endRow);
+    for (int row = firstRow; row < endRow; row++) {
+      UINT64 *tile = &m_tiles[row * m_columns + firstCol];
+      for (int col = firstCol; col < endCol; col++, tile++) {
+        *tile = m_generation;
+      }
+    }
+  }
+}
+
+void DirtyTileMap::takeChangedSince(UINT64 *generation, Region *changedRegion)
+{
+  std::vector<Rect> rects;
+  {
+    AutoLock al(&m_lock);
+    if (*generation == m_generation) {
+      return;
+    }
+    UINT64 since = *generation;
+    *generation = m_generation;
+
+    // Join the changed tiles of each row into runs.
+    for (int row = 0; row < m_rows; row++) {
+      const UINT64 *tile = &m_tiles[row * m_columns];
+      int col = 0;
+      while (col < m_columns) {
+        if (tile[col] <= since) {
+          col++;
+          continue;
+        }
+        int firstCol = col;
+        while (col < m_columns && tile[col] > since) {
+          col++;
+        }
+        rects.push_back(Rect(firstCol * TILE_SIZE, row * TILE_SIZE,
+                             col * TILE_SIZE, (row + 1) * TILE_SIZE));
+      }
+    }
+  }
+  changedRegion->addRects(&rects);
+}
+
+UINT64 DirtyTileMap::getGeneration()
+{
+  AutoLock al(&m_lock);
+  return m_generation;
+}
+
+void DirtyTileMap::grow(int columns, int rows)
+{
+  if (columns <= m_columns && rows <= m_rows) {
+    return;
+  }
+  int newColumns = max(columns, m_columns);
+  int newRows = max(rows, m_rows);
+  std::vector<UINT64> tiles(newColumns * newRows, 0);
+  for (int row = 0; row < m_rows; row++) {
+    for (int col = 0; col < m_columns; col++) {
+      tiles[row * newColumns + col] = m_tiles[row * m_columns + col];
+    }
+  }
+  m_tiles.swap(tiles);
+  m_columns = newColumns;
+  m_rows = newRows;
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __DIRTYTILEMAP_H__
+#define __DIRTYTILEMAP_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "region/Region.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
+
+// DirtyTileMap keeps, for every tile of the frame buffer, the generation of
+// its last change. It is shared between all the clients so that a captured
+// change is recorded once instead of being merged into the UpdateKeeper of
+// every client. Each client remembers the generation it has taken the
+// changes up to and gets everything changed after it in a single pass over
+// the map, however many generations it is behind.
+//
+// The changes are kept with the tile precision.
+class DirtyTileMap
+{
+public:
+  static const int TILE_SIZE = 16;
+
+  DirtyTileMap();
+  virtual ~DirtyTileMap();
+
+  // Marks the tiles touched by changedRegion with a new generation. The
+  // region is in frame buffer coordinates, the map grows to cover it.
+  void markChanged(const Region *changedRegion);
+
+  // Adds to changedRegion the tiles changed after *generation and sets
+  // *generation to the current generation.
+  void takeChangedSince(UINT64 *generation, Region *changedRegion);
+
+  UINT64 getGeneration();
+
+private:
+  // Grows the map to at least the given size in tiles, the new tiles are
+  // unchanged. Must be called with m_lock locked.
+  void grow(int columns, int rows);
+
+  std::vector<UINT64> m_tiles;
+  int m_columns;
+  int m_rows;
+  UINT64 m_generation;
+  LocalMutex m_lock;
+
+  // Do not allow copying objects.
+  DirtyTileMap(const DirtyTileMap &other);
+  DirtyTileMap &operator=(const DirtyTileMap &other);
+};
+
+#endif // __DIRTYTILEMAP_H__
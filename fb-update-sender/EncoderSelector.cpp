@@ -0,0 +1,185 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncoderSelector.h"
+#include "rfb/EncodingDefs.h"
+
+// The encodings compared by the trials.
+static const int CANDIDATES[] = {
+  EncodingDefs::TIGHT,
+  EncodingDefs::ZRLE,
+  EncodingDefs::HEXTILE,
+  EncodingDefs::RAW
+};
+static const size_t NUM_CANDIDATES = sizeof(CANDIDATES) / sizeof(CANDIDATES[0]);
+
+EncoderSelector::EncoderSelector(PixelConverter *pixelConverter)
+: m_sink(0),
+  m_output(&m_sink),
+  m_encoders(pixelConverter, &m_output),
+  m_trialRun(false),
+  m_encoding(-1),
+  m_challenger(-1),
+  m_challengerTrials(0)
+{
+  QueryPerformanceFrequency(&m_perfFrequency);
+}
+
+EncoderSelector::~EncoderSelector()
+{
+}
+
+int EncoderSelector::getEncoding(const EncodeOptions *options) const
+{
+  if (options->jpegEnabled() &&
+      options->encodingEnabled(EncodingDefs::TIGHT)) {
+    return EncodingDefs::TIGHT;
+  }
+  if (m_encoding == -1 || !options->encodingEnabled(m_encoding)) {
+    return options->getPreferredEncoding();
+  }
+  return m_encoding;
+}
+
+bool EncoderSelector::isTrialDue() const
+{
+  return !m_trialRun ||
+         (DateTime::now() - m_lastTrialTime).getTime() >= TRIAL_INTERVAL;
+}
+
+bool EncoderSelector::trial(const Region *region, const FrameBuffer *frameBuffer,
+                            const EncodeOptions *options, unsigned int throughput)
+{
+  std::vector<Rect> samples;
+  takeSamples(region, &samples);
+  if (samples.size() < MIN_SAMPLE_TILES) {
+    // Too small an update says little, the next one is tried.
+    return false;
+  }
+  m_trialRun = true;
+  m_lastTrialTime = DateTime::now();
+  if (throughput == 0) {
+    throughput = DEFAULT_THROUGHPUT;
+  }
+
+  EncodeOptions losslessOptions = *options;
+  losslessOptions.disableJpeg();
+  int current = getEncoding(options);
+  double currentCost = -1;
+  int best = -1;
+  double bestCost = 0;
+  for (size_t i = 0; i < NUM_CANDIDATES; i++) {
+    int code = CANDIDATES[i];
+    if (!options->encodingEnabled(code)) {
+      continue;
+    }
+    m_encoders.selectEncoder(code);
+    double cost = measure(m_encoders.getEncoder(), &samples, frameBuffer,
+                          &losslessOptions, throughput);
+    if (code == current) {
+      currentCost = cost;
+    }
+    if (best == -1 || cost < bestCost) {
+      best = code;
+      bestCost = cost;
+    }
+  }
+
+  if (best == -1 || best == current || currentCost < 0 ||
+      bestCost * 100 > currentCost * SWITCH_PERCENT) {
+    m_challenger = -1;
+    m_challengerTrials = 0;
+    return false;
+  }
+  if (best != m_challenger) {
+    m_challenger = best;
+    m_challengerTrials = 0;
+  }
+  if (++m_challengerTrials < SWITCH_TRIALS) {
+    return false;
+  }
+  m_encoding = best;
+  m_challenger = -1;
+  m_challengerTrials = 0;
+  return true;
+}
+
+size_t EncoderSelector::getScratchSize() const
+{
+  return m_encoders.getScratchSize();
+}
+
+void EncoderSelector::releaseScratch()
+{
+  m_encoders.releaseScratch();
+}
+
+void EncoderSelector::takeSamples(const Region *region,
+                                  std::vector<Rect> *samples) const
+{
+  std::vector<Rect> tiles;
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  for (size_t i = 0; i < rects.size(); i++) {
+    const Rect *r = &rects[i];
+    for (int y = r->top; y + SAMPLE_TILE_SIZE <= r->bottom;
+         y += SAMPLE_TILE_SIZE) {
+      for (int x = r->left; x + SAMPLE_TILE_SIZE <= r->right;
+           x += SAMPLE_TILE_SIZE) {
+        tiles.push_back(Rect(x, y, x + SAMPLE_TILE_SIZE, y + SAMPLE_TILE_SIZE));
+      }
+    }
+  }
+  // Tiles spread over the region tell more than the tiles of one corner.
+  size_t step = max(tiles.size() / MAX_SAMPLE_TILES, (size_t)1);
+  samples->clear();
+  for (size_t i = 0; i < tiles.size() && samples->size() < MAX_SAMPLE_TILES;
+       i += step) {
+    samples->push_back(tiles[i]);
+  }
+}
+
+double EncoderSelector::measure(Encoder *encoder, const std::vector<Rect> *samples,
+                                const FrameBuffer *frameBuffer,
+                                const EncodeOptions *options,
+                                unsigned int throughput)
+{
+  UINT64 bytesBefore = m_sink.getTotalWritten();
+  LARGE_INTEGER start, stop;
+  QueryPerformanceCounter(&start);
+  std::vector<Rect> rects;
+  for (size_t i = 0; i < samples->size(); i++) {
+    rects.clear();
+    encoder->splitRectangle(&(*samples)[i], &rects, frameBuffer, options);
+    for (size_t j = 0; j < rects.size(); j++) {
+      encoder->sendRectangle(&rects[j], frameBuffer, options);
+    }
+  }
+  QueryPerformanceCounter(&stop);
+  UINT64 bytes = m_sink.getTotalWritten() - bytesBefore;
+  double encodeTime = (double)(stop.QuadPart - start.QuadPart) * 1000000 /
+                      m_perfFrequency.QuadPart;
+  double sendTime = (double)bytes * 1000000 / throughput;
+  return encodeTime + sendTime;
+}
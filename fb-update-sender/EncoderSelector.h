@@ -0,0 +1,116 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __ENCODERSELECTOR_H__
+#define __ENCODERSELECTOR_H__
+
+#include "io-lib/RecordingOutputStream.h"
+#include "io-lib/DataOutputStream.h"
+#include "rfb-sconn/EncoderStore.h"
+#include "rfb-sconn/EncodeOptions.h"
+#include "region/Region.h"
+#include "util/DateTime.h"
+
+// EncoderSelector chooses the encoding of a client among the ones it has
+// enabled, instead of taking the first one of its list. Many viewers list
+// ZRLE, Hextile and Tight and put one of them first by default.
+//
+// From time to time, sample tiles of an update are encoded by each of the
+// candidate encoders of the selector, which write to nowhere. The cost of
+// a candidate is its time of encoding plus the time its data takes on the
+// link at the measured throughput. The current encoding is replaced only
+// by the one costing clearly less in a few trials in a row, so that the
+// choice does not flap between close candidates.
+//
+// Only lossless encodings are compared. While the client wants JPEG, Tight
+// is kept if it is enabled, the other encodings cannot send lossy.
+class EncoderSelector
+{
+public:
+  // The candidate encoders convert the pixels by pixelConverter, which must
+  // be set up for the updates passed to trial().
+  EncoderSelector(PixelConverter *pixelConverter);
+  virtual ~EncoderSelector();
+
+  // Returns the encoding to use with the options, either the last one
+  // chosen or, if it has not been chosen yet or is not enabled any more,
+  // the preferred one of the client.
+  int getEncoding(const EncodeOptions *options) const;
+
+  // Returns true if it is time to run trial() again.
+  bool isTrialDue() const;
+
+  // Encodes sample tiles of the region of frameBuffer with the candidates
+  // enabled in options and updates the choice. The throughput of the link
+  // is in bytes per second, 0 if unknown. Returns true if the choice has
+  // changed.
+  bool trial(const Region *region, const FrameBuffer *frameBuffer,
+             const EncodeOptions *options, unsigned int throughput);
+
+  size_t getScratchSize() const;
+  void releaseScratch();
+
+protected:
+  // Collects up to MAX_SAMPLE_TILES tiles of the region spread over it.
+  void takeSamples(const Region *region, std::vector<Rect> *samples) const;
+
+  // Returns the cost of the sample tiles with the encoder in microseconds.
+  double measure(Encoder *encoder, const std::vector<Rect> *samples,
+                 const FrameBuffer *frameBuffer,
+                 const EncodeOptions *options, unsigned int throughput);
+
+  static const int SAMPLE_TILE_SIZE = 64;
+  static const size_t MIN_SAMPLE_TILES = 4;
+  static const size_t MAX_SAMPLE_TILES = 16;
+  // Milliseconds between the trials.
+  static const unsigned int TRIAL_INTERVAL = 10000;
+  // A candidate replaces the current encoding if it costs less than
+  // SWITCH_PERCENT percent of it in SWITCH_TRIALS trials in a row.
+  static const int SWITCH_PERCENT = 80;
+  static const int SWITCH_TRIALS = 2;
+  // Throughput assumed while the link has not been measured yet.
+  static const unsigned int DEFAULT_THROUGHPUT = 1024 * 1024;
+
+  RecordingOutputStream m_sink;
+  DataOutputStream m_output;
+  EncoderStore m_encoders;
+
+  LARGE_INTEGER m_perfFrequency;
+  DateTime m_lastTrialTime;
+  bool m_trialRun;
+
+  // The chosen encoding, -1 before the first choice.
+  int m_encoding;
+  // The candidate cheaper than m_encoding in the last trials, and the
+  // number of these trials.
+  int m_challenger;
+  int m_challengerTrials;
+
+private:
+  // Do not allow copying objects.
+  EncoderSelector(const EncoderSelector &other);
+  EncoderSelector &operator=(const EncoderSelector &other);
+};
+
+#endif // __ENCODERSELECTOR_H__
@@ -0,0 +1,111 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncodingWorker.h"
+#include "EncodingWorkerPool.h"
+#include "util/Exception.h"
+#include "thread/SchedulingPolicy.h"
+
+EncodingWorker::EncodingWorker(EncodingWorkerPool *pool, DWORD_PTR affinity)
+: m_pool(pool),
+  m_recorder(0),
+  m_output(&m_recorder),
+  m_enbox(&m_pixelConverter, &m_output)
+{
+  SchedulingPolicy::apply(this, SchedulingPolicy::ROLE_ENCODER);
+  if (affinity != 0) {
+    setAffinity(affinity);
+  }
+  resume();
+}
+
+EncodingWorker::~EncodingWorker()
+{
+  terminate();
+  wait();
+}
+
+void EncodingWorker::startBatch()
+{
+  m_startEvent.notify();
+}
+
+size_t EncodingWorker::getScratchSize() const
+{
+  return m_enbox.getScratchSize() + m_pixelConverter.getBufferSize();
+}
+
+void EncodingWorker::releaseScratch()
+{
+  m_enbox.releaseScratch();
+  m_pixelConverter.releaseBuffer();
+}
+
+void EncodingWorker::onTerminate()
+{
+  m_startEvent.notify();
+}
+
+void EncodingWorker::execute()
+{
+  while (!isTerminating()) {
+    m_startEvent.waitForEvent();
+    if (!isTerminating()) {
+      processBatch();
+    }
+  }
+}
+
+void EncodingWorker::processBatch()
+{
+  const FrameBuffer *frameBuffer = m_pool->m_frameBuffer;
+  const EncodeOptions *encodeOptions = m_pool->m_encodeOptions;
+  try {
+    m_pixelConverter.setPixelFormats(&m_pool->m_dstPf,
+                                     &frameBuffer->getPixelFormat());
+
+    Encoder *encoder;
+    m_enbox.selectEncoder(m_pool->m_encType);
+    if (m_pool->m_video) {
+      m_enbox.validateJpegEncoder();
+      encoder = m_enbox.getJpegEncoder();
+    } else {
+      encoder = m_enbox.getEncoder();
+    }
+    encoder->setStateless(true);
+
+    size_t index;
+    while (m_pool->takeJob(&index)) {
+      m_recorder.startRecording();
+      encoder->sendRectangle(&m_pool->m_rects->at(index), frameBuffer,
+                             encodeOptions);
+      m_recorder.stopRecording();
+      m_pool->m_results->at(index) = *m_recorder.getRecord();
+    }
+    m_pool->onWorkerDone(0);
+  } catch (Exception &e) {
+    m_recorder.stopRecording();
+    m_pool->onWorkerDone(e.getMessage());
+  }
+}
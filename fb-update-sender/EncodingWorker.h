@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __ENCODINGWORKER_H__
+#define __ENCODINGWORKER_H__
+
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "io-lib/RecordingOutputStream.h"
+#include "io-lib/DataOutputStream.h"
+#include "rfb/PixelConverter.h"
+#include "rfb-sconn/EncoderStore.h"
+
+class EncodingWorkerPool;
+
+// EncodingWorker is a thread of EncodingWorkerPool. It owns its own set of
+// encoders and a PixelConverter, takes rectangles of the current batch from
+// the pool one by one and encodes each of them into a separate buffer. The
+// encoders are used in the stateless mode, so the data of each rectangle can
+// be sent to the client in any combination with the data produced by other
+// workers.
+class EncodingWorker : public Thread
+{
+public:
+  // The worker is kept on the processors of the affinity mask, 0 means any.
+  EncodingWorker(EncodingWorkerPool *pool, DWORD_PTR affinity);
+  virtual ~EncodingWorker();
+
+  // Wakes the worker up to process the current batch of the pool.
+  void startBatch();
+
+  // Returns the size of the scratch buffers of the worker encoders and the
+  // pixel converter, and frees them. Must not be called during a batch.
+  size_t getScratchSize() const;
+  void releaseScratch();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+  // Encodes rectangles of the current batch until there are no more
+  // rectangles left, then reports to the pool.
+  void processBatch();
+
+  EncodingWorkerPool *m_pool;
+  WindowsEvent m_startEvent;
+
+  PixelConverter m_pixelConverter;
+  RecordingOutputStream m_recorder;
+  DataOutputStream m_output;
+  EncoderStore m_enbox;
+};
+
+#endif // __ENCODINGWORKER_H__
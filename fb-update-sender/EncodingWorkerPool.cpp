@@ -0,0 +1,146 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncodingWorkerPool.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+#include "thread/SchedulingPolicy.h"
+
+EncodingWorkerPool::EncodingWorkerPool(unsigned int numThreads)
+: m_encType(0),
+  m_video(false),
+  m_rects(0),
+  m_frameBuffer(0),
+  m_encodeOptions(0),
+  m_results(0),
+  m_nextJob(0),
+  m_numRunning(0),
+  m_failed(false)
+{
+  if (numThreads == 0) {
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    numThreads = sysInfo.dwNumberOfProcessors;
+  }
+  if (numThreads == 0) {
+    numThreads = 1;
+  }
+  // The workers share the cache lines of the frame buffer and of the
+  // results, so they are kept together.
+  DWORD_PTR affinity = SchedulingPolicy::takeEncoderAffinity(numThreads);
+  for (unsigned int i = 0; i < numThreads; i++) {
+    m_workers.push_back(new EncodingWorker(this, affinity));
+  }
+}
+
+EncodingWorkerPool::~EncodingWorkerPool()
+{
+  std::vector<EncodingWorker *>::iterator i;
+  for (i = m_workers.begin(); i != m_workers.end(); i++) {
+    delete *i;
+  }
+}
+
+size_t EncodingWorkerPool::getNumThreads() const
+{
+  return m_workers.size();
+}
+
+size_t EncodingWorkerPool::getScratchSize() const
+{
+  size_t size = 0;
+  for (size_t i = 0; i < m_workers.size(); i++) {
+    size += m_workers[i]->getScratchSize();
+  }
+  return size;
+}
+
+void EncodingWorkerPool::releaseScratch()
+{
+  for (size_t i = 0; i < m_workers.size(); i++) {
+    m_workers[i]->releaseScratch();
+  }
+}
+
+void EncodingWorkerPool::encode(int encType, bool video,
+                                const std::vector<Rect> *rects,
+                                const FrameBuffer *frameBuffer,
+                                const EncodeOptions *encodeOptions,
+                                const PixelFormat *dstPf,
+                                std::vector<std::vector<char> > *results)
+{
+  results->clear();
+  results->resize(rects->size());
+  if (rects->empty()) {
+    return;
+  }
+
+  {
+    AutoLock al(&m_lock);
+    m_encType = encType;
+    m_video = video;
+    m_rects = rects;
+    m_frameBuffer = frameBuffer;
+    m_encodeOptions = encodeOptions;
+    m_dstPf = *dstPf;
+    m_results = results;
+
+    m_nextJob = 0;
+    m_numRunning = m_workers.size();
+    m_failed = false;
+  }
+
+  std::vector<EncodingWorker *>::iterator i;
+  for (i = m_workers.begin(); i != m_workers.end(); i++) {
+    (*i)->startBatch();
+  }
+  m_doneEvent.waitForEvent();
+
+  AutoLock al(&m_lock);
+  if (m_failed) {
+    throw Exception(_T("%s"), m_errorMessage.getString());
+  }
+}
+
+bool EncodingWorkerPool::takeJob(size_t *index)
+{
+  AutoLock al(&m_lock);
+  if (m_failed || m_nextJob >= m_rects->size()) {
+    return false;
+  }
+  *index = m_nextJob++;
+  return true;
+}
+
+void EncodingWorkerPool::onWorkerDone(const TCHAR *errorMessage)
+{
+  AutoLock al(&m_lock);
+  if (errorMessage != 0 && !m_failed) {
+    m_failed = true;
+    m_errorMessage.setString(errorMessage);
+  }
+  if (--m_numRunning == 0) {
+    m_doneEvent.notify();
+  }
+}
@@ -0,0 +1,110 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __ENCODINGWORKERPOOL_H__
+#define __ENCODINGWORKERPOOL_H__
+
+#include <vector>
+
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/StringStorage.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb-sconn/EncodeOptions.h"
+#include "EncodingWorker.h"
+
+// EncodingWorkerPool encodes a list of rectangles using several threads. Each
+// rectangle is encoded into a separate buffer, so the caller can send the
+// results in the original order. Only encoders supporting the stateless mode
+// (see Encoder::isStateless()) can be used via the pool.
+class EncodingWorkerPool
+{
+  friend class EncodingWorker;
+
+public:
+  // Creates numThreads worker threads. If numThreads is 0, the number of
+  // processors in the system will be used.
+  EncodingWorkerPool(unsigned int numThreads);
+  virtual ~EncodingWorkerPool();
+
+  size_t getNumThreads() const;
+
+  // Returns the total scratch size of the workers and frees their scratch
+  // buffers, see EncodingWorker::releaseScratch(). Must not be called
+  // during encode().
+  size_t getScratchSize() const;
+  void releaseScratch();
+
+  // Encodes rects taken from frameBuffer with the encoder of the encType type
+  // (or with JpegEncoder if video is true) for a client with the dstPf pixel
+  // format. On return, the results vector has the same size as rects and
+  // each of its elements contains the encoded data of the corresponding
+  // rectangle (without the rectangle header). The function returns when all
+  // the rectangles are encoded. It must not be called from different
+  // threads at the same time.
+  // Throws Exception if any of the workers failed.
+  void encode(int encType, bool video,
+              const std::vector<Rect> *rects,
+              const FrameBuffer *frameBuffer,
+              const EncodeOptions *encodeOptions,
+              const PixelFormat *dstPf,
+              std::vector<std::vector<char> > *results);
+
+protected:
+  // Functions called by workers. takeJob() returns false if there are no
+  // more rectangles to encode in the current batch, otherwise it sets index
+  // to the index of the rectangle the worker should encode. onWorkerDone()
+  // should be called by each worker once it has finished the batch,
+  // errorMessage should be 0 on success.
+  bool takeJob(size_t *index);
+  void onWorkerDone(const TCHAR *errorMessage);
+
+  std::vector<EncodingWorker *> m_workers;
+
+  // Parameters of the current batch.
+  int m_encType;
+  bool m_video;
+  const std::vector<Rect> *m_rects;
+  const FrameBuffer *m_frameBuffer;
+  const EncodeOptions *m_encodeOptions;
+  PixelFormat m_dstPf;
+  std::vector<std::vector<char> > *m_results;
+
+  // State of the current batch, protected by m_lock.
+  size_t m_nextJob;
+  size_t m_numRunning;
+  bool m_failed;
+  StringStorage m_errorMessage;
+  LocalMutex m_lock;
+
+  // Notified when the last worker has finished the batch.
+  WindowsEvent m_doneEvent;
+
+private:
+  // Do not allow copying objects.
+  EncodingWorkerPool(const EncodingWorkerPool &other);
+  EncodingWorkerPool &operator=(const EncodingWorkerPool &other);
+};
+
+#endif // __ENCODINGWORKERPOOL_H__
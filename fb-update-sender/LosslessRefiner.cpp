@@ -0,0 +1,144 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LosslessRefiner.h"
+
+#include <vector>
+
+LosslessRefiner::LosslessRefiner()
+{
+}
+
+LosslessRefiner::~LosslessRefiner()
+{
+}
+
+void LosslessRefiner::onUpdate(const Region *changed, const Region *lossy)
+{
+  // Changed pixels are not static any more, the lossless ones need no
+  // refinement at all.
+  std::list<Pending>::iterator it;
+  for (it = m_pending.begin(); it != m_pending.end(); ) {
+    it->region.subtract(changed);
+    if (it->region.isEmpty()) {
+      it = m_pending.erase(it);
+    } else {
+      it++;
+    }
+  }
+  m_ready.subtract(changed);
+
+  if (lossy->isEmpty()) {
+    return;
+  }
+  DateTime now = DateTime::now();
+  if (!m_pending.empty() &&
+      (now - m_pending.back().time).getTime() < MERGE_TIME) {
+    m_pending.back().region.add(lossy);
+    m_pending.back().time = now;
+    return;
+  }
+  if (m_pending.size() >= MAX_PENDING) {
+    // Combine the two oldest regions, the combination is static since the
+    // newer of them.
+    std::list<Pending>::iterator second = m_pending.begin();
+    second++;
+    second->region.add(&m_pending.front().region);
+    m_pending.pop_front();
+  }
+  Pending pending;
+  pending.time = now;
+  pending.region = *lossy;
+  m_pending.push_back(pending);
+}
+
+void LosslessRefiner::crop(const Rect *rect)
+{
+  std::list<Pending>::iterator it;
+  for (it = m_pending.begin(); it != m_pending.end(); it++) {
+    it->region.crop(rect);
+  }
+  m_ready.crop(rect);
+}
+
+void LosslessRefiner::clear()
+{
+  m_pending.clear();
+  m_ready.clear();
+}
+
+bool LosslessRefiner::hasPending() const
+{
+  return !m_pending.empty() || !m_ready.isEmpty();
+}
+
+unsigned int LosslessRefiner::getTimeToRefinement()
+{
+  collectReady();
+  if (!m_ready.isEmpty()) {
+    return 0;
+  }
+  if (m_pending.empty()) {
+    return INFINITE_TIME;
+  }
+  UINT64 age = (DateTime::now() - m_pending.front().time).getTime();
+  return age >= STATIC_TIME ? 0 : STATIC_TIME - (unsigned int)age;
+}
+
+Region LosslessRefiner::takeRefinement(int maxArea)
+{
+  collectReady();
+  return takePartFromRegion(&m_ready, maxArea);
+}
+
+void LosslessRefiner::collectReady()
+{
+  DateTime now = DateTime::now();
+  while (!m_pending.empty() &&
+         (now - m_pending.front().time).getTime() >= STATIC_TIME) {
+    m_ready.add(&m_pending.front().region);
+    m_pending.pop_front();
+  }
+}
+
+Region LosslessRefiner::takePartFromRegion(Region *reg, int area)
+{
+  Region out;
+  std::vector<Rect> rects;
+  reg->getRectVector(&rects);
+  // process region rects form last one, I hope it can reduce allocation number for region structure
+  for (int i = rects.size() - 1; i >= 0 && area > 0; i-- ) {
+    Rect r = rects[i];
+    int a = r.area();
+    if (a > area) {
+      r.setWidth(r.getWidth() * area / a + 1);
+      a = r.area();
+    }
+    area -= a;
+    Region t(r);
+    reg->subtract(&t);
+    out.add(&t);
+  }
+  return out;
+}
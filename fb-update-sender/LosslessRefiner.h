@@ -0,0 +1,99 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __LOSSLESSREFINER_H__
+#define __LOSSLESSREFINER_H__
+
+#include <list>
+
+#include "region/Region.h"
+#include "util/DateTime.h"
+
+// LosslessRefiner keeps track of the pixels sent to a client with lossy
+// encodings (JPEG or H.264) and schedules sending them again losslessly.
+// The pixels become eligible for the refinement only after they have not
+// changed for STATIC_TIME milliseconds, so that nothing is refined while
+// it is still in motion.
+//
+// The class is not thread-safe, it's used by the update sender thread only.
+class LosslessRefiner
+{
+public:
+  LosslessRefiner();
+  virtual ~LosslessRefiner();
+
+  // Should be called for every update with the region of all the pixels
+  // sent in it, and the part of that region sent with lossy encodings.
+  void onUpdate(const Region *changed, const Region *lossy);
+
+  // Forgets the pixels outside the rectangle, e.g. after a screen resize.
+  void crop(const Rect *rect);
+
+  // Forgets everything, e.g. if lossy encodings are no more in use.
+  void clear();
+
+  // Returns true if there are lossy pixels waiting for the refinement.
+  bool hasPending() const;
+
+  // Returns the time in milliseconds until the next pixels become eligible
+  // for the refinement, 0 if there are eligible pixels already and
+  // INFINITE_TIME if there is nothing to refine.
+  unsigned int getTimeToRefinement();
+
+  // Returns a part of eligible pixels with the total area no more than
+  // maxArea, and considers it refined.
+  Region takeRefinement(int maxArea);
+
+  static const unsigned int INFINITE_TIME = 0xFFFFFFFF;
+
+private:
+  // Moves the pixels static for long enough to m_ready.
+  void collectReady();
+
+  // Returns part of region with total area no more than area and removes
+  // this part from the source region.
+  static Region takePartFromRegion(Region *reg, int area);
+
+  // Pixels sent lossy in the updates of a short period, with the time of
+  // the last of those updates.
+  struct Pending
+  {
+    DateTime time;
+    Region region;
+  };
+
+  // Pending regions, from the oldest to the newest one.
+  std::list<Pending> m_pending;
+  // Lossy pixels which have been static for long enough.
+  Region m_ready;
+
+  // Time in milliseconds the pixels must stay unchanged to be refined.
+  static const unsigned int STATIC_TIME = 500;
+  // Updates closer in time than this are combined to one pending region.
+  static const unsigned int MERGE_TIME = 100;
+  // Maximum number of pending regions.
+  static const size_t MAX_PENDING = 16;
+};
+
+#endif // __LOSSLESSREFINER_H__
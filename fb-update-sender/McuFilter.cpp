@@ -0,0 +1,160 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "McuFilter.h"
+
+#include <string.h>
+
+McuFilter::McuFilter()
+: m_columns(0)
+{
+}
+
+McuFilter::~McuFilter()
+{
+}
+
+void McuFilter::alignToGrid(Region *region, const Rect *bounds)
+{
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  Region aligned;
+  for (std::vector<Rect>::iterator i = rects.begin(); i != rects.end(); i++) {
+    Rect rect(i->left / MCU_SIZE * MCU_SIZE,
+              i->top / MCU_SIZE * MCU_SIZE,
+              (i->right + MCU_SIZE - 1) / MCU_SIZE * MCU_SIZE,
+              (i->bottom + MCU_SIZE - 1) / MCU_SIZE * MCU_SIZE);
+    rect = rect.intersection(bounds);
+    aligned.addRect(&rect);
+  }
+  *region = aligned;
+}
+
+size_t McuFilter::filter(Region *region, const FrameBuffer *frameBuffer)
+{
+  Dimension dim = frameBuffer->getDimension();
+  PixelFormat pf = frameBuffer->getPixelFormat();
+  if (!m_sent.getDimension().isEqualTo(&dim) ||
+      !m_sent.getPixelFormat().isEqualTo(&pf)) {
+    // Everything is sent this time, onSent() stores it.
+    m_sent.setProperties(&dim, &pf);
+    m_columns = (dim.width + MCU_SIZE - 1) / MCU_SIZE;
+    int rows = (dim.height + MCU_SIZE - 1) / MCU_SIZE;
+    m_known.assign(m_columns * rows, false);
+    return 0;
+  }
+
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  Region changed;
+  size_t skipped = 0;
+  for (std::vector<Rect>::iterator i = rects.begin(); i != rects.end(); i++) {
+    int firstColumn = i->left / MCU_SIZE;
+    int lastColumn = (i->right - 1) / MCU_SIZE;
+    for (int row = i->top / MCU_SIZE; row <= (i->bottom - 1) / MCU_SIZE; row++) {
+      Rect mcuRow(i->left, max(row * MCU_SIZE, i->top),
+                  i->right, min((row + 1) * MCU_SIZE, i->bottom));
+      // The changed MCUs next to each other go as one rectangle.
+      int runStart = -1;
+      for (int column = firstColumn; column <= lastColumn + 1; column++) {
+        bool isChanged = column <= lastColumn &&
+                         !isUnchanged(column, row, frameBuffer);
+        if (column <= lastColumn && !isChanged) {
+          skipped++;
+        }
+        if (isChanged && runStart < 0) {
+          runStart = column;
+        } else if (!isChanged && runStart >= 0) {
+          Rect run(max(runStart * MCU_SIZE, i->left), mcuRow.top,
+                   min(column * MCU_SIZE, i->right), mcuRow.bottom);
+          changed.addRect(&run);
+          runStart = -1;
+        }
+      }
+    }
+  }
+  *region = changed;
+  return skipped;
+}
+
+bool McuFilter::isUnchanged(int column, int row,
+                            const FrameBuffer *frameBuffer) const
+{
+  if (!m_known[row * m_columns + column]) {
+    return false;
+  }
+  Dimension dim = m_sent.getDimension();
+  int left = column * MCU_SIZE;
+  int top = row * MCU_SIZE;
+  int width = min(MCU_SIZE, dim.width - left);
+  int height = min(MCU_SIZE, dim.height - top);
+  size_t rowSize = width * m_sent.getBytesPerPixel();
+  for (int y = top; y < top + height; y++) {
+    if (memcmp(m_sent.getBufferPtr(left, y),
+               frameBuffer->getBufferPtr(left, y), rowSize) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void McuFilter::onSent(const Region *region, const FrameBuffer *frameBuffer)
+{
+  Dimension dim = frameBuffer->getDimension();
+  PixelFormat pf = frameBuffer->getPixelFormat();
+  if (m_known.empty() || !m_sent.getDimension().isEqualTo(&dim) ||
+      !m_sent.getPixelFormat().isEqualTo(&pf)) {
+    return;
+  }
+
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  for (std::vector<Rect>::iterator i = rects.begin(); i != rects.end(); i++) {
+    m_sent.copyFrom(&*i, frameBuffer, i->left, i->top);
+    // A partly sent MCU is known only if the rest of it was known.
+    for (int row = i->top / MCU_SIZE; row <= (i->bottom - 1) / MCU_SIZE; row++) {
+      for (int column = i->left / MCU_SIZE; column <= (i->right - 1) / MCU_SIZE;
+           column++) {
+        Rect mcu(column * MCU_SIZE, row * MCU_SIZE,
+                 min((column + 1) * MCU_SIZE, dim.width),
+                 min((row + 1) * MCU_SIZE, dim.height));
+        if (i->isFullyContainRect(&mcu)) {
+          m_known[row * m_columns + column] = true;
+        }
+      }
+    }
+  }
+}
+
+void McuFilter::reset()
+{
+  m_sent.setDimension(&Dimension());
+  m_known.clear();
+  m_columns = 0;
+}
+
+size_t McuFilter::getMemorySize() const
+{
+  return m_sent.getBufferSize() + m_known.capacity() / 8;
+}
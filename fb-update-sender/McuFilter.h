@@ -0,0 +1,82 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __MCUFILTER_H__
+#define __MCUFILTER_H__
+
+#include "rfb/FrameBuffer.h"
+#include "region/Region.h"
+
+#include <vector>
+
+// McuFilter keeps a copy of the pixels last sent to a client and removes
+// from a video region the MCUs (the 16x16 blocks of JPEG on the grid of
+// the frame buffer) which have not changed since they were sent. The video
+// region goes out as a whole with every update, so without the filter
+// a caret blinking over a video window costs the whole window.
+//
+// The copy is only kept while there is video to filter, reset() frees it.
+class McuFilter
+{
+public:
+  static const int MCU_SIZE = 16;
+
+  McuFilter();
+  virtual ~McuFilter();
+
+  // Expands the rectangles of the region to the MCU grid, within bounds.
+  static void alignToGrid(Region *region, const Rect *bounds);
+
+  // Removes from the region the MCUs of frameBuffer equal to the ones
+  // stored by onSent(). The region should be aligned to the grid, other
+  // MCUs are only checked inside the region. Returns the number of MCUs
+  // removed.
+  size_t filter(Region *region, const FrameBuffer *frameBuffer);
+
+  // Stores the pixels of frameBuffer sent to the client in the region, if
+  // the copy is kept and has the same properties. Must be called for all
+  // changes of the client frame buffer, both filtered and not.
+  void onSent(const Region *region, const FrameBuffer *frameBuffer);
+
+  // Forgets the sent pixels, e.g. after a change of the frame buffer the
+  // coordinates refer to.
+  void reset();
+
+  size_t getMemorySize() const;
+
+private:
+  // Returns true if the MCU of the grid (column, row) is known and equal.
+  bool isUnchanged(int column, int row, const FrameBuffer *frameBuffer) const;
+
+  FrameBuffer m_sent;
+  // One flag per MCU, true if m_sent holds what the client has there.
+  std::vector<bool> m_known;
+  int m_columns;
+
+  // Do not allow copying objects.
+  McuFilter(const McuFilter &other);
+  McuFilter &operator=(const McuFilter &other);
+};
+
+#endif // __MCUFILTER_H__
@@ -0,0 +1,348 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "MulticastSender.h"
+#include "rfb/MsgDefs.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+#include "zlib/zlib.h"
+
+MulticastSender::MulticastSender(LogWriter *log)
+: m_port(0),
+  m_socket(0),
+  m_streamId(GetTickCount()),
+  m_numReceivers(0),
+  m_copyIsStale(true),
+  m_history(HISTORY_SIZE),
+  m_historyStreamId(0),
+  m_firstHistorySeq(0),
+  m_nextSeq(0),
+  m_lastSendTime(0),
+  m_log(log)
+{
+  m_datagram.resize(MulticastDefs::MAX_DATAGRAM_SIZE);
+}
+
+MulticastSender::~MulticastSender()
+{
+  if (m_socket != 0) {
+    terminate();
+    wait();
+    delete m_socket;
+  }
+}
+
+void MulticastSender::start(const TCHAR *group, unsigned short port,
+                            unsigned int bandwidth)
+{
+  _ASSERT(m_socket == 0);
+
+  SocketAddressIPv4 groupAddress = SocketAddressIPv4::resolve(group, port);
+  UINT32 address = ntohl(groupAddress.getSockAddr().sin_addr.s_addr);
+  if ((address >> 28) != 0xE) {
+    throw Exception(_T("%s is not a multicast address"), group);
+  }
+
+  DatagramSocketIPv4 *socket = new DatagramSocketIPv4();
+  try {
+    socket->setMulticastTtl(MULTICAST_TTL);
+    socket->connect(groupAddress);
+  } catch (...) {
+    delete socket;
+    throw;
+  }
+  m_groupAddress = groupAddress;
+  m_port = port;
+  m_socket = socket;
+  m_bandwidth.setRate(bandwidth);
+
+  m_log->message(_T("Sending the screen to the multicast group %s:%u"),
+                 group, (unsigned int)port);
+  resume();
+}
+
+bool MulticastSender::isStarted() const
+{
+  return m_socket != 0;
+}
+
+void MulticastSender::getGroup(UINT32 *address, UINT16 *port) const
+{
+  *address = m_groupAddress.getSockAddr().sin_addr.s_addr;
+  *port = m_port;
+}
+
+void MulticastSender::addReceiver()
+{
+  AutoLock al(&m_fbLock);
+  m_numReceivers++;
+}
+
+void MulticastSender::removeReceiver()
+{
+  AutoLock al(&m_fbLock);
+  _ASSERT(m_numReceivers > 0);
+  m_numReceivers--;
+  if (m_numReceivers == 0) {
+    m_copyIsStale = true;
+    m_changedRegion.clear();
+  }
+}
+
+void MulticastSender::onUpdate(Desktop *desktop,
+                               const UpdateContainer *updateContainer)
+{
+  AutoLock al(&m_fbLock);
+  if (m_numReceivers == 0) {
+    return;
+  }
+
+  // The moved pixels go as changed ones, there are no moves in the stream.
+  Region changes = updateContainer->getCopiedRegion();
+  changes.add(&updateContainer->changedRegion);
+  changes.add(&updateContainer->videoRegion);
+
+  Dimension fbDim;
+  PixelFormat pf;
+  desktop->getFrameBufferProperties(&fbDim, &pf);
+  Rect fbRect = fbDim.getRect();
+  Region wholeScreen(fbRect);
+  Dimension prevDim = m_frameBuffer.getDimension();
+
+  const Region *copiedRegion = m_copyIsStale ? &wholeScreen : &changes;
+  if (!desktop->updateExternalFrameBuffer(&m_frameBuffer, copiedRegion, &fbRect)) {
+    // The frame buffer has been made for the new size or format.
+    desktop->updateExternalFrameBuffer(&m_frameBuffer, &wholeScreen, &fbRect);
+  }
+  m_copyIsStale = false;
+
+  if (!m_frameBuffer.getDimension().isEqualTo(&prevDim)) {
+    // The clients get the new screen by their connections, the stream of
+    // the old size ends.
+    m_streamId++;
+    m_changedRegion.clear();
+  } else {
+    changes.crop(&fbRect);
+    m_changedRegion.add(&changes);
+  }
+  m_changesEvent.notify();
+}
+
+bool MulticastSender::getLostRegion(UINT32 streamId, UINT32 firstSeq,
+                                    UINT16 count, Region *region)
+{
+  AutoLock al(&m_historyLock);
+  if (count == 0 || streamId != m_historyStreamId ||
+      (INT32)(firstSeq - m_firstHistorySeq) < 0 ||
+      (INT32)(firstSeq + count - m_nextSeq) > 0) {
+    return false;
+  }
+  for (UINT32 i = 0; i < count; i++) {
+    region->addRect(&m_history[(firstSeq + i) % HISTORY_SIZE]);
+  }
+  return true;
+}
+
+void MulticastSender::onTerminate()
+{
+  m_changesEvent.notify();
+}
+
+void MulticastSender::execute()
+{
+  while (!isTerminating()) {
+    m_changesEvent.waitForEvent(MulticastDefs::HEARTBEAT_INTERVAL);
+    if (isTerminating()) {
+      break;
+    }
+    Region changedRegion;
+    UINT32 streamId;
+    bool hasReceivers;
+    {
+      AutoLock al(&m_fbLock);
+      changedRegion = m_changedRegion;
+      m_changedRegion.clear();
+      streamId = m_streamId;
+      hasReceivers = m_numReceivers > 0;
+    }
+    if (!hasReceivers) {
+      continue;
+    }
+    try {
+      if (!changedRegion.isEmpty()) {
+        sendRegion(&changedRegion, streamId);
+      }
+      // Besides keeping the clients aware of the stream, the heartbeat lets
+      // them know of the lost tiles at the end of an update.
+      if (GetTickCount() - m_lastSendTime >= MulticastDefs::HEARTBEAT_INTERVAL) {
+        sendHeartbeat();
+      }
+    } catch (Exception &e) {
+      m_log->error(_T("Cannot send to the multicast group: %s"), e.getMessage());
+    }
+  }
+}
+
+bool MulticastSender::sendRegion(const Region *region, UINT32 streamId)
+{
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  for (std::vector<Rect>::iterator it = rects.begin(); it != rects.end(); it++) {
+    for (int top = it->top; top < it->bottom; top += TILE_SIZE) {
+      for (int left = it->left; left < it->right; left += TILE_SIZE) {
+        Rect tile(left, top,
+                  min(left + TILE_SIZE, it->right),
+                  min(top + TILE_SIZE, it->bottom));
+        if (isTerminating() || !sendRect(&tile, streamId)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool MulticastSender::sendRect(const Rect *rect, UINT32 streamId)
+{
+  Dimension fbDim;
+  {
+    AutoLock al(&m_fbLock);
+    if (streamId != m_streamId) {
+      return false;
+    }
+    fbDim = m_frameBuffer.getDimension();
+    PixelFormat pf = m_frameBuffer.getPixelFormat();
+    if (!pf.isEqualTo(&m_tilePf)) {
+      PixelFormat wirePf = StandardPixelFormatFactory::create32bppPixelFormat();
+      m_pixelConverter.setPixelFormats(&wirePf, &pf);
+      m_tilePf = pf;
+    }
+    m_tileFb.setProperties(&Dimension(rect), &pf);
+    m_tileFb.copyFrom(&m_frameBuffer, rect->left, rect->top);
+  }
+
+  int width = rect->getWidth();
+  int height = rect->getHeight();
+  Rect tileRect(width, height);
+  const FrameBuffer *wireFb = m_pixelConverter.convert(&tileRect, &m_tileFb);
+  size_t rowSize = width * 4;
+  m_pixels.resize(rowSize * height);
+  for (int y = 0; y < height; y++) {
+    memcpy(&m_pixels[y * rowSize], wireFb->getBufferPtr(0, y), rowSize);
+  }
+
+  const size_t dataOffset = MulticastDefs::HEADER_SIZE + MulticastDefs::TILE_HEADER_SIZE;
+  uLongf compressedSize = (uLongf)(m_datagram.size() - dataOffset);
+  int result = compress2((Bytef *)&m_datagram[dataOffset], &compressedSize,
+                         (const Bytef *)&m_pixels.front(), (uLong)m_pixels.size(),
+                         ZLIB_LEVEL);
+  if (result == Z_BUF_ERROR &&
+      (width > MIN_TILE_SIZE || height > MIN_TILE_SIZE)) {
+    Rect first = *rect;
+    Rect second = *rect;
+    if (height >= width) {
+      first.bottom = second.top = rect->top + height / 2;
+    } else {
+      first.right = second.left = rect->left + width / 2;
+    }
+    return sendRect(&first, streamId) && sendRect(&second, streamId);
+  }
+  if (result != Z_OK) {
+    throw Exception(_T("Cannot compress a tile of the multicast stream (%d)"), result);
+  }
+
+  UINT32 seq;
+  {
+    AutoLock al(&m_historyLock);
+    if (streamId != m_historyStreamId) {
+      m_historyStreamId = streamId;
+      m_firstHistorySeq = m_nextSeq;
+    }
+    seq = m_nextSeq++;
+    m_history[seq % HISTORY_SIZE] = *rect;
+    if (m_nextSeq - m_firstHistorySeq > HISTORY_SIZE) {
+      m_firstHistorySeq = m_nextSeq - (UINT32)HISTORY_SIZE;
+    }
+  }
+  putHeader(streamId, seq, &fbDim, MulticastDefs::TILE);
+  char *tileHeader = &m_datagram[MulticastDefs::HEADER_SIZE];
+  putUInt16(tileHeader, (UINT16)rect->left);
+  putUInt16(tileHeader + 2, (UINT16)rect->top);
+  putUInt16(tileHeader + 4, (UINT16)width);
+  putUInt16(tileHeader + 6, (UINT16)height);
+  sendDatagram(dataOffset + compressedSize);
+  return true;
+}
+
+void MulticastSender::sendHeartbeat()
+{
+  UINT32 streamId;
+  Dimension fbDim;
+  {
+    AutoLock al(&m_fbLock);
+    streamId = m_streamId;
+    fbDim = m_frameBuffer.getDimension();
+  }
+  UINT32 seq;
+  {
+    AutoLock al(&m_historyLock);
+    seq = m_nextSeq;
+  }
+  putHeader(streamId, seq, &fbDim, MulticastDefs::HEARTBEAT);
+  sendDatagram(MulticastDefs::HEADER_SIZE);
+}
+
+void MulticastSender::putHeader(UINT32 streamId, UINT32 seq,
+                                const Dimension *dim, UINT8 kind)
+{
+  char *header = &m_datagram.front();
+  putUInt32(header, MulticastDefs::MAGIC);
+  putUInt32(header + 4, streamId);
+  putUInt32(header + 8, seq);
+  putUInt16(header + 12, (UINT16)dim->width);
+  putUInt16(header + 14, (UINT16)dim->height);
+  header[16] = (char)kind;
+}
+
+void MulticastSender::sendDatagram(size_t size)
+{
+  m_bandwidth.consume(size);
+  // A datagram which does not fit into the send buffer is lost like one
+  // lost by the network, the clients ask for it.
+  m_socket->send(&m_datagram.front(), (int)size);
+  m_lastSendTime = GetTickCount();
+}
+
+void MulticastSender::putUInt16(char *p, UINT16 value)
+{
+  p[0] = (char)(value >> 8);
+  p[1] = (char)value;
+}
+
+void MulticastSender::putUInt32(char *p, UINT32 value)
+{
+  putUInt16(p, (UINT16)(value >> 16));
+  putUInt16(p + 2, (UINT16)value);
+}
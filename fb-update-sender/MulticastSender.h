@@ -0,0 +1,154 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __MULTICASTSENDER_H__
+#define __MULTICASTSENDER_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "desktop/Desktop.h"
+#include "desktop/UpdateContainer.h"
+#include "network/TokenBucket.h"
+#include "network/socket/DatagramSocketIPv4.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelConverter.h"
+#include "region/Region.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "log-writer/LogWriter.h"
+
+#include <vector>
+
+// MulticastSender sends the screen to a multicast group, so that the
+// clients in a local network get each change once for all of them instead
+// of by each connection (see MulticastDefs for the datagrams).
+//
+// The changed pixels are copied from the desktop as the updates come, and
+// the thread of the stream sends them in tiles compressed each on its own,
+// so that a lost datagram loses nothing else. The rectangles of the last
+// HISTORY_SIZE tiles are kept for the clients asking for the lost ones by
+// their connections.
+//
+// The tiles are sent only while some client is interested in the stream.
+class MulticastSender : private Thread
+{
+public:
+  MulticastSender(LogWriter *log);
+  virtual ~MulticastSender();
+
+  // Starts the stream to the group, with the bandwidth limit in bytes per
+  // second, 0 for no limit.
+  // @throw Exception if the group is not valid or the socket cannot be
+  // made.
+  void start(const TCHAR *group, unsigned short port, unsigned int bandwidth);
+  bool isStarted() const;
+
+  // Puts the address of the group, in network byte order, and the port.
+  void getGroup(UINT32 *address, UINT16 *port) const;
+
+  // A client is interested in the stream from addReceiver() to
+  // removeReceiver().
+  void addReceiver();
+  void removeReceiver();
+
+  // Copies the pixels changed by the update from the desktop to be sent,
+  // while some client is interested. Called by the thread of the desktop.
+  void onUpdate(Desktop *desktop, const UpdateContainer *updateContainer);
+
+  // Adds to region the rectangles of count tiles of the stream starting
+  // from firstSeq. Returns false if the stream has changed since or the
+  // tiles are not known any more, then the whole screen is due.
+  bool getLostRegion(UINT32 streamId, UINT32 firstSeq, UINT16 count,
+                     Region *region);
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // Sends the region of the stream in tiles. Returns false if the stream
+  // has changed meanwhile, its whole screen is sent then.
+  bool sendRegion(const Region *region, UINT32 streamId);
+  // Sends the rectangle in one datagram, or in halves if it does not fit.
+  // Returns false if the stream has changed.
+  bool sendRect(const Rect *rect, UINT32 streamId);
+  void sendHeartbeat();
+  // Fills the header common to the datagrams in m_datagram.
+  void putHeader(UINT32 streamId, UINT32 seq, const Dimension *dim,
+                 UINT8 kind);
+  void sendDatagram(size_t size);
+
+  static void putUInt16(char *p, UINT16 value);
+  static void putUInt32(char *p, UINT32 value);
+
+  SocketAddressIPv4 m_groupAddress;
+  UINT16 m_port;
+  DatagramSocketIPv4 *m_socket;
+  TokenBucket m_bandwidth;
+
+  // The copy of the screen, its changes not sent yet, the id of the stream
+  // and the number of the interested clients, locked by m_fbLock. The copy
+  // is not kept while nobody is interested, it is made anew by the first
+  // update after that.
+  LocalMutex m_fbLock;
+  FrameBuffer m_frameBuffer;
+  Region m_changedRegion;
+  UINT32 m_streamId;
+  unsigned int m_numReceivers;
+  bool m_copyIsStale;
+  WindowsEvent m_changesEvent;
+
+  // Rectangles of the tiles by their sequence numbers modulo HISTORY_SIZE,
+  // the ones from m_firstHistorySeq to m_nextSeq are of m_historyStreamId.
+  LocalMutex m_historyLock;
+  std::vector<Rect> m_history;
+  UINT32 m_historyStreamId;
+  UINT32 m_firstHistorySeq;
+  UINT32 m_nextSeq;
+
+  // Used by the thread of the stream only.
+  FrameBuffer m_tileFb;
+  PixelFormat m_tilePf;
+  PixelConverter m_pixelConverter;
+  std::vector<char> m_pixels;
+  std::vector<char> m_datagram;
+  DWORD m_lastSendTime;
+
+  LogWriter *m_log;
+
+  static const size_t HISTORY_SIZE = 16384;
+  static const int TILE_SIZE = 64;
+  // A tile of this size fits into a datagram uncompressed.
+  static const int MIN_TILE_SIZE = 8;
+  static const int ZLIB_LEVEL = 1;
+  // The stream stays in the local network.
+  static const int MULTICAST_TTL = 1;
+
+  // Do not allow copying objects.
+  MulticastSender(const MulticastSender &other);
+  MulticastSender &operator=(const MulticastSender &other);
+};
+
+#endif // __MULTICASTSENDER_H__
@@ -0,0 +1,145 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "OutputScheduler.h"
+
+OutputScheduler::OutputScheduler()
+: m_viewPortArea(0),
+  m_nextOutput(0),
+  m_hasRefreshed(false)
+{
+}
+
+OutputScheduler::~OutputScheduler()
+{
+}
+
+bool OutputScheduler::isOutdated() const
+{
+  return !m_hasRefreshed ||
+         (DateTime::now() - m_lastRefresh).getTime() >= REFRESH_INTERVAL;
+}
+
+void OutputScheduler::setOutputs(const std::vector<Rect> *outputs,
+                                 const Rect *viewPort)
+{
+  m_lastRefresh = DateTime::now();
+  m_hasRefreshed = true;
+
+  Rect clientRect(viewPort->getWidth(), viewPort->getHeight());
+  m_viewPortArea = clientRect.area();
+
+  m_outputs.clear();
+  Region covered;
+  for (size_t i = 0; i < outputs->size(); i++) {
+    Rect r = (*outputs)[i];
+    r.move(-viewPort->left, -viewPort->top);
+    r = r.intersection(&clientRect);
+    Region output(r);
+    output.subtract(&covered);
+    if (!output.isEmpty()) {
+      covered.add(&output);
+      m_outputs.push_back(output);
+    }
+  }
+  if (m_nextOutput >= m_outputs.size()) {
+    m_nextOutput = 0;
+  }
+}
+
+void OutputScheduler::schedule(Region *changed, Region *deferred)
+{
+  deferred->clear();
+  size_t count = m_outputs.size();
+  if (count < 2) {
+    return;
+  }
+  int budget = m_viewPortArea / (int)count;
+  if (getArea(changed) <= budget) {
+    return;
+  }
+
+  // The pixels outside all the outputs are always sent.
+  Region result = *changed;
+  m_parts.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    m_parts[i] = *changed;
+    m_parts[i].intersect(&m_outputs[i]);
+    result.subtract(&m_outputs[i]);
+  }
+
+  // Equal shares first.
+  int share = budget / (int)count;
+  int unused = budget;
+  for (size_t i = 0; i < count; i++) {
+    Region part = takePart(&m_parts[i], share);
+    unused -= getArea(&part);
+    result.add(&part);
+  }
+  // The unused budget goes round-robin to the outputs with more changes.
+  for (size_t n = 0; n < count && unused > 0; n++) {
+    size_t i = (m_nextOutput + n) % count;
+    if (m_parts[i].isEmpty()) {
+      continue;
+    }
+    Region part = takePart(&m_parts[i], unused);
+    unused -= getArea(&part);
+    result.add(&part);
+  }
+  m_nextOutput = (m_nextOutput + 1) % count;
+
+  for (size_t i = 0; i < count; i++) {
+    deferred->add(&m_parts[i]);
+  }
+  *changed = result;
+}
+
+Region OutputScheduler::takePart(Region *reg, int area)
+{
+  Region out;
+  std::vector<Rect> rects;
+  reg->getRectVector(&rects);
+  for (size_t i = 0; i < rects.size() && area > 0; i++) {
+    Rect r = rects[i];
+    int a = r.area();
+    if (a > area) {
+      // Whole rows only, at least one.
+      int rows = area / r.getWidth();
+      r.setHeight(rows > 0 ? rows : 1);
+      a = r.area();
+    }
+    area -= a;
+    Region t(r);
+    reg->subtract(&t);
+    out.add(&t);
+  }
+  return out;
+}
+
+int OutputScheduler::getArea(const Region *reg)
+{
+  std::vector<Rect> rects;
+  reg->getRectVector(&rects);
+  return Rect::totalArea(rects);
+}
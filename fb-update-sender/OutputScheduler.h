@@ -0,0 +1,81 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __OUTPUTSCHEDULER_H__
+#define __OUTPUTSCHEDULER_H__
+
+#include <vector>
+
+#include "region/Region.h"
+#include "util/DateTime.h"
+
+// OutputScheduler splits the changed region of an update by the monitors
+// (outputs) of the desktop, so that a busy output cannot delay the updates
+// of the other ones. When the changes of the update exceed the budget of
+// one average output, each output gets an equal share of the budget, the
+// unused part of the shares goes to the other outputs in round-robin order
+// and the rest of the changes is deferred to the next updates.
+//
+// The class is not thread-safe, it's used by the update sender thread only.
+class OutputScheduler
+{
+public:
+  OutputScheduler();
+  virtual ~OutputScheduler();
+
+  // Returns true if the output rectangles should be queried again.
+  bool isOutdated() const;
+
+  // Sets the outputs in the screen coordinates. The outputs are translated
+  // to the coordinates of the view port and cropped by it, the parts
+  // shared by several (mirrored) outputs belong to the first of them.
+  void setOutputs(const std::vector<Rect> *outputs, const Rect *viewPort);
+
+  // Leaves in the changed region the part to be sent in this update and
+  // puts the rest to the deferred region. Nothing is deferred if there
+  // are less than two outputs.
+  void schedule(Region *changed, Region *deferred);
+
+  // Outputs are queried again no more often than once per this interval
+  // (in milliseconds) unless the view port changes.
+  static const unsigned int REFRESH_INTERVAL = 3000;
+
+private:
+  // Returns part of the region with the area no more than the given one
+  // and removes it from the region. The part is taken from the top.
+  static Region takePart(Region *reg, int area);
+
+  static int getArea(const Region *reg);
+
+  std::vector<Region> m_outputs;
+  // Changes of each output, reused from update to update.
+  std::vector<Region> m_parts;
+  int m_viewPortArea;
+  // The output which gets the unused budget first in the next update.
+  size_t m_nextOutput;
+  DateTime m_lastRefresh;
+  bool m_hasRefreshed;
+};
+
+#endif // __OUTPUTSCHEDULER_H__
@@ -0,0 +1,85 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RectMerger.h"
+
+void RectMerger::merge(std::vector<Rect> *rects, size_t overhead,
+                       UINT64 *rectsMerged, UINT64 *pixelsAdded)
+{
+  if (overhead == 0 || rects->size() < 2 || rects->size() > MAX_RECTS) {
+    return;
+  }
+  std::vector<Rect> &list = *rects;
+  size_t i = 0;
+  while (i < list.size()) {
+    bool merged = false;
+    for (size_t j = i + 1; j < list.size() && j <= i + MERGE_WINDOW; j++) {
+      Rect bounds = list[i].unionRect(&list[j]);
+      // The rectangles inside the bounding box are merged with it.
+      UINT64 covered = 0;
+      size_t numInside = 0;
+      bool crossed = false;
+      for (size_t k = 0; k < list.size(); k++) {
+        if (bounds.intersection(&list[k]).isEmpty()) {
+          continue;
+        }
+        if (!bounds.isFullyContainRect(&list[k])) {
+          crossed = true;
+          break;
+        }
+        covered += list[k].area();
+        numInside++;
+      }
+      if (crossed) {
+        continue;
+      }
+      UINT64 added = (UINT64)bounds.area() - covered;
+      if (added > (UINT64)overhead * (numInside - 1)) {
+        continue;
+      }
+
+      // Put the bounding box in place of the first rectangle, drop the
+      // others inside it and try to merge the box further.
+      size_t dst = 0;
+      size_t newIndex = 0;
+      for (size_t k = 0; k < list.size(); k++) {
+        if (k == i) {
+          newIndex = dst;
+          list[dst++] = bounds;
+        } else if (bounds.intersection(&list[k]).isEmpty()) {
+          list[dst++] = list[k];
+        }
+      }
+      list.resize(dst);
+      *rectsMerged += numInside - 1;
+      *pixelsAdded += added;
+      i = newIndex;
+      merged = true;
+      break;
+    }
+    if (!merged) {
+      i++;
+    }
+  }
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RECTMERGER_H__
+#define __RECTMERGER_H__
+
+#include "region/Rect.h"
+#include "util/inttypes.h"
+
+#include <vector>
+
+// RectMerger simplifies the list of rectangles of an update region before
+// it is given to the encoder. Neighbouring rectangles are replaced by their
+// bounding box when the unchanged pixels it adds are fewer than the
+// rectangles saved, each valued by the overhead of the encoder (see
+// Encoder::getRectOverhead()). A bounding box crossing another rectangle is
+// not used, so the resulting rectangles never overlap.
+class RectMerger
+{
+public:
+  // Merges the rectangles in place. overhead is the number of unchanged
+  // pixels worth sending to save one rectangle, 0 leaves the list as is.
+  // The number of removed rectangles and of the added pixels are added to
+  // rectsMerged and pixelsAdded.
+  static void merge(std::vector<Rect> *rects, size_t overhead,
+                    UINT64 *rectsMerged, UINT64 *pixelsAdded);
+
+private:
+  // Each rectangle is tried with this number of the rectangles following
+  // it in the list, which go in the order of the region bands, so the
+  // neighbours are near.
+  static const size_t MERGE_WINDOW = 8;
+  // Longer lists are left as is, the check of a bounding box against all
+  // the rectangles would cost more than it saves.
+  static const size_t MAX_RECTS = 512;
+};
+
+#endif // __RECTMERGER_H__
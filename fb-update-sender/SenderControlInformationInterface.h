@@ -30,6 +30,20 @@ class SenderControlInformationInterface
 {
 public:
   virtual void onGetViewPort(Rect *viewRect, bool *shareApp, Region *shareAppRegion) = 0;
+  // Called by the sender thread with new estimates of the round trip time
+  // in milliseconds and the throughput in bytes per second.
+  virtual void onNetworkEstimate(unsigned int roundTripTime,
+                                 unsigned int throughput) = 0;
+  // Called by the sender thread before it encodes an update. Returns true
+  // as soon as data can be written to the client without blocking, false
+  // if the output is still full after timeoutMillis milliseconds.
+  virtual bool waitForOutputSpace(unsigned int timeoutMillis) = 0;
+  // Returns the number of bytes written by the sender thread and still
+  // queued for sending to the client.
+  virtual size_t getOutputQueueSize() = 0;
+  // Returns the rate in bytes per second the output to the client is
+  // limited to, 0 if it is not limited.
+  virtual unsigned int getRateLimit() = 0;
 };
 
 #endif // __SENDERCONTROLINFORMATIONINTERFACE_H__
@@ -0,0 +1,139 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SessionRecorder.h"
+
+SessionRecorder::SessionRecorder(const TCHAR *fileName)
+: m_file(fileName, F_WRITE, FM_CREATE),
+  m_bufOutput(&m_file),
+  m_output(&m_bufOutput),
+  m_indexFile(getIndexFileName(fileName).getString(), F_WRITE, FM_CREATE),
+  m_indexOutput(&m_indexFile),
+  m_offset(SessionRecordingDefs::FILE_HEADER_SIZE),
+  m_startTime(DateTime::now()),
+  m_lastKeyFrameTime(DateTime::now()),
+  m_hasFormat(false)
+{
+  m_output.writeUInt32(SessionRecordingDefs::MAGIC);
+  m_output.writeUInt32(SessionRecordingDefs::VERSION);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+  try {
+    m_bufOutput.flush();
+  } catch (Exception &) {
+  }
+}
+
+void SessionRecorder::writeUpdate(const Dimension *clientDim,
+                                  const PixelFormat *clientPf,
+                                  const std::vector<char> *messages)
+{
+  if (!m_hasFormat || !m_clientDim.isEqualTo(clientDim) ||
+      !m_clientPf.isEqualTo(clientPf)) {
+    m_hasFormat = true;
+    m_clientDim = *clientDim;
+    m_clientPf = *clientPf;
+
+    writeRecordHeader(SessionRecordingDefs::FORMAT, 20);
+    m_output.writeUInt16((UINT16)clientDim->width);
+    m_output.writeUInt16((UINT16)clientDim->height);
+    m_output.writeUInt8((UINT8)clientPf->bitsPerPixel);
+    m_output.writeUInt8((UINT8)clientPf->colorDepth);
+    m_output.writeUInt8(clientPf->bigEndian ? 1 : 0);
+    m_output.writeUInt8(1); // true color
+    m_output.writeUInt16(clientPf->redMax);
+    m_output.writeUInt16(clientPf->greenMax);
+    m_output.writeUInt16(clientPf->blueMax);
+    m_output.writeUInt8((UINT8)clientPf->redShift);
+    m_output.writeUInt8((UINT8)clientPf->greenShift);
+    m_output.writeUInt8((UINT8)clientPf->blueShift);
+    m_output.writeUInt8(0); // padding
+    m_output.writeUInt16(0);
+  }
+
+  if (messages->empty()) {
+    return;
+  }
+  writeRecordHeader(SessionRecordingDefs::UPDATE, messages->size());
+  m_output.writeFully(&messages->front(), messages->size());
+}
+
+bool SessionRecorder::isKeyFrameDue() const
+{
+  return (DateTime::now() - m_lastKeyFrameTime).getTime() >= KEYFRAME_INTERVAL;
+}
+
+void SessionRecorder::writeKeyFrame(const FrameBuffer *clientFb)
+{
+  m_lastKeyFrameTime = DateTime::now();
+  UINT64 offset = m_offset;
+  UINT64 time = getTime();
+
+  // The recording stores packed rows, the frame buffer may have padded ones.
+  Dimension dim = clientFb->getDimension();
+  size_t rowSize = dim.width * clientFb->getBytesPerPixel();
+  writeRecordHeader(SessionRecordingDefs::KEYFRAME,
+                    4 + rowSize * dim.height);
+  m_output.writeUInt16((UINT16)dim.width);
+  m_output.writeUInt16((UINT16)dim.height);
+  if (clientFb->isPacked()) {
+    m_output.writeFully(clientFb->getBuffer(), clientFb->getBufferSize());
+  } else {
+    for (int y = 0; y < dim.height; y++) {
+      m_output.writeFully(clientFb->getBufferPtr(0, y), rowSize);
+    }
+  }
+
+  // The index entry may be written only after the keyframe is on the disk.
+  m_bufOutput.flush();
+  m_indexOutput.writeUInt64(time);
+  m_indexOutput.writeUInt64(offset);
+}
+
+void SessionRecorder::skipKeyFrame()
+{
+  m_lastKeyFrameTime = DateTime::now();
+}
+
+void SessionRecorder::writeRecordHeader(UINT8 type, size_t length)
+{
+  m_output.writeUInt8(type);
+  m_output.writeUInt32((UINT32)length);
+  m_output.writeUInt64(getTime());
+  m_offset += SessionRecordingDefs::RECORD_HEADER_SIZE + length;
+}
+
+StringStorage SessionRecorder::getIndexFileName(const TCHAR *fileName)
+{
+  StringStorage indexFileName(fileName);
+  indexFileName.appendString(SessionRecordingDefs::INDEX_SUFFIX);
+  return indexFileName;
+}
+
+UINT64 SessionRecorder::getTime() const
+{
+  return (DateTime::now() - m_startTime).getTime();
+}
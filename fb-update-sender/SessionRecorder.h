@@ -0,0 +1,91 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SESSIONRECORDER_H__
+#define __SESSIONRECORDER_H__
+
+#include "rfb/FrameBuffer.h"
+#include "rfb/SessionRecordingDefs.h"
+#include "file-lib/WinFileChannel.h"
+#include "io-lib/BufferedOutputStream.h"
+#include "io-lib/DataOutputStream.h"
+#include "util/DateTime.h"
+
+#include <vector>
+
+// Records the RFB stream sent to a client, as it is encoded for the client,
+// with periodic keyframes and their index, see SessionRecordingDefs.
+class SessionRecorder
+{
+public:
+  // Creates the recording and its index, throws Exception on failure.
+  SessionRecorder(const TCHAR *fileName);
+  // Flushes the recording, errors are ignored.
+  virtual ~SessionRecorder();
+
+  // Appends the server messages of one update. clientDim and clientPf
+  // describe the client framebuffer after the update, a format record is
+  // written before the messages if they have changed.
+  void writeUpdate(const Dimension *clientDim,
+                   const PixelFormat *clientPf,
+                   const std::vector<char> *messages) throw(IOException);
+
+  // Returns true if it is time for the next keyframe.
+  bool isKeyFrameDue() const;
+
+  // Appends the keyframe of the client framebuffer, in the client pixel
+  // format, and its index entry. The caller must make sure that the next
+  // updates do not depend on the data sent before.
+  void writeKeyFrame(const FrameBuffer *clientFb) throw(IOException);
+
+  // Postpones the keyframe which is due for the next interval.
+  void skipKeyFrame();
+
+  // Interval between keyframes in milliseconds.
+  static const unsigned int KEYFRAME_INTERVAL = 10000;
+
+private:
+  void writeRecordHeader(UINT8 type, size_t length) throw(IOException);
+  UINT64 getTime() const;
+  static StringStorage getIndexFileName(const TCHAR *fileName);
+
+  WinFileChannel m_file;
+  BufferedOutputStream m_bufOutput;
+  DataOutputStream m_output;
+
+  WinFileChannel m_indexFile;
+  DataOutputStream m_indexOutput;
+
+  // Offset of the next record.
+  UINT64 m_offset;
+
+  DateTime m_startTime;
+  DateTime m_lastKeyFrameTime;
+
+  bool m_hasFormat;
+  Dimension m_clientDim;
+  PixelFormat m_clientPf;
+};
+
+#endif // __SESSIONRECORDER_H__
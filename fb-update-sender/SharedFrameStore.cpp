@@ -0,0 +1,284 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SharedFrameStore.h"
+#include "rfb/PixelDownscaler.h"
+#include "thread/AutoLock.h"
+
+SharedFrameStore::Reader::Reader(SharedFrameStore *store)
+: m_store(store),
+  m_frameBuffer(0)
+{
+}
+
+SharedFrameStore::Reader::~Reader()
+{
+  if (m_frameBuffer != 0) {
+    m_store->release(m_frameBuffer);
+  }
+}
+
+bool SharedFrameStore::Reader::isEnabled() const
+{
+  return m_store != 0;
+}
+
+bool SharedFrameStore::Reader::acquire(Desktop *desktop, const Rect *viewPort,
+                                       int scale)
+{
+  _ASSERT(m_store != 0 && m_frameBuffer == 0);
+  bool success;
+  m_frameBuffer = m_store->acquire(desktop, viewPort, scale, &success);
+  return success;
+}
+
+FrameBuffer *SharedFrameStore::Reader::getFrameBuffer() const
+{
+  return m_frameBuffer;
+}
+
+SharedFrameStore::SharedFrameStore()
+: m_budget(0),
+  m_scratchSize(0)
+{
+}
+
+SharedFrameStore::~SharedFrameStore()
+{
+  for (std::list<Frame *>::iterator i = m_frames.begin(); i != m_frames.end(); i++) {
+    _ASSERT((*i)->readers == 0);
+    delete *i;
+  }
+}
+
+void SharedFrameStore::setBudget(UINT64 budget)
+{
+  AutoLock al(&m_lock);
+  m_budget = budget;
+}
+
+void SharedFrameStore::markChanged(const UpdateContainer *updateContainer)
+{
+  Region changedRegion = updateContainer->changedRegion;
+  Region copiedRegion = updateContainer->getCopiedRegion();
+  changedRegion.add(&copiedRegion);
+  changedRegion.add(&updateContainer->videoRegion);
+  m_changes.markChanged(&changedRegion);
+}
+
+void SharedFrameStore::onScratchSizeChanged(size_t oldSize, size_t newSize)
+{
+  AutoLock al(&m_lock);
+  _ASSERT(m_scratchSize >= oldSize);
+  m_scratchSize = m_scratchSize - oldSize + newSize;
+}
+
+bool SharedFrameStore::isOverBudget()
+{
+  AutoLock al(&m_lock);
+  return m_budget != 0 && getUsage() > m_budget;
+}
+
+FrameBuffer *SharedFrameStore::acquire(Desktop *desktop, const Rect *viewPort,
+                                       int scale, bool *success)
+{
+  Dimension dim;
+  PixelFormat pf;
+  desktop->getFrameBufferProperties(&dim, &pf);
+
+  AutoLock al(&m_lock);
+  freeSpareFrames();
+
+  Frame *frame = acquireFrame(desktop, viewPort, scale, &pf, success);
+  return &frame->frameBuffer;
+}
+
+SharedFrameStore::Frame *SharedFrameStore::acquireFrame(Desktop *desktop,
+                                                        const Rect *viewPort,
+                                                        int scale,
+                                                        const PixelFormat *pf,
+                                                        bool *success)
+{
+  Frame *current = 0;
+  Frame *spare = 0;
+  for (std::list<Frame *>::iterator i = m_frames.begin(); i != m_frames.end(); i++) {
+    Frame *frame = *i;
+    if (!frame->viewPort.isEqualTo(viewPort) || frame->scale != scale ||
+        !frame->pixelFormat.isEqualTo(pf)) {
+      continue;
+    }
+    if (frame->current) {
+      current = frame;
+    } else if (frame->readers == 0 &&
+               (spare == 0 || frame->generation > spare->generation)) {
+      // The most recent spare frame has the least to copy.
+      spare = frame;
+    }
+  }
+
+  Frame *frame = current;
+  if (current == 0 ||
+      (current->readers != 0 &&
+       (!current->filled || current->generation != m_changes.getGeneration()))) {
+    // The current frame is read and outdated, so it is left to its readers.
+    if (spare != 0) {
+      frame = spare;
+    } else {
+      frame = new Frame;
+      frame->viewPort = *viewPort;
+      frame->scale = scale;
+      frame->pixelFormat = *pf;
+      m_frames.push_back(frame);
+    }
+    if (current != 0) {
+      current->current = false;
+    }
+    frame->current = true;
+  }
+
+  *success = scale == 1 ? update(frame, desktop) : updateScaled(frame, desktop);
+  frame->readers++;
+  frame->lastUse = DateTime::now();
+  return frame;
+}
+
+void SharedFrameStore::release(FrameBuffer *frameBuffer)
+{
+  AutoLock al(&m_lock);
+  for (std::list<Frame *>::iterator i = m_frames.begin(); i != m_frames.end(); i++) {
+    if (&(*i)->frameBuffer == frameBuffer) {
+      releaseFrame(*i);
+      break;
+    }
+  }
+  freeSpareFrames();
+}
+
+void SharedFrameStore::releaseFrame(Frame *frame)
+{
+  _ASSERT(frame->readers > 0);
+  frame->readers--;
+  frame->lastUse = DateTime::now();
+}
+
+bool SharedFrameStore::update(Frame *frame, Desktop *desktop)
+{
+  Rect viewRect = Dimension(&frame->viewPort).getRect();
+  Region changedRegion;
+  if (frame->filled) {
+    m_changes.takeChangedSince(&frame->generation, &changedRegion);
+    changedRegion.translate(-frame->viewPort.left, -frame->viewPort.top);
+    changedRegion.crop(&viewRect);
+  } else {
+    // Later changes are taken with the next update, the pixels copied now
+    // may already have them.
+    frame->generation = m_changes.getGeneration();
+    changedRegion.addRect(&viewRect);
+  }
+  if (changedRegion.isEmpty()) {
+    return true;
+  }
+  bool success = desktop->updateExternalFrameBuffer(&frame->frameBuffer,
+                                                    &changedRegion,
+                                                    &frame->viewPort);
+  // The frame properties have been changed for the current screen, nothing
+  // has been copied.
+  frame->filled = success;
+  return success;
+}
+
+bool SharedFrameStore::updateScaled(Frame *frame, Desktop *desktop)
+{
+  Dimension viewDim(&frame->viewPort);
+  Dimension scaledDim(viewDim.width / frame->scale, viewDim.height / frame->scale);
+  Region changedRegion;
+  if (frame->filled) {
+    // The changes are taken before the source is brought up to date, so
+    // that it has all of them.
+    m_changes.takeChangedSince(&frame->generation, &changedRegion);
+    changedRegion.translate(-frame->viewPort.left, -frame->viewPort.top);
+    changedRegion.crop(&viewDim.getRect());
+  } else {
+    frame->generation = m_changes.getGeneration();
+    changedRegion.addRect(&viewDim.getRect());
+  }
+  if (changedRegion.isEmpty()) {
+    return true;
+  }
+
+  bool success;
+  Frame *source = acquireFrame(desktop, &frame->viewPort, 1,
+                               &frame->pixelFormat, &success);
+  if (success) {
+    if (!frame->filled) {
+      frame->frameBuffer.setProperties(&scaledDim, &frame->pixelFormat);
+    }
+    // Every scaled pixel touched by a change is made again. The source
+    // pixels out of the last whole blocks are left out.
+    Rect scaledRect = scaledDim.getRect();
+    std::vector<Rect> rects;
+    changedRegion.getRectVector(&rects);
+    for (std::vector<Rect>::iterator i = rects.begin(); i != rects.end(); i++) {
+      Rect rect(i->left / frame->scale, i->top / frame->scale,
+                (i->right + frame->scale - 1) / frame->scale,
+                (i->bottom + frame->scale - 1) / frame->scale);
+      rect = rect.intersection(&scaledRect);
+      PixelDownscaler::downscale(&source->frameBuffer, &frame->frameBuffer,
+                                 &rect, frame->scale);
+    }
+  }
+  releaseFrame(source);
+  frame->filled = success;
+  return success;
+}
+
+void SharedFrameStore::freeSpareFrames()
+{
+  bool overBudget = m_budget != 0 && getUsage() > m_budget;
+  DateTime now = DateTime::now();
+  std::list<Frame *>::iterator i = m_frames.begin();
+  while (i != m_frames.end()) {
+    Frame *frame = *i;
+    // The current frame is only freed when no client has read it for a
+    // while, otherwise it would be made again with the next update.
+    bool unused = (now - frame->lastUse).getTime() >= SPARE_TIMEOUT;
+    if (frame->readers == 0 && (unused || (!frame->current && overBudget))) {
+      delete frame;
+      i = m_frames.erase(i);
+      overBudget = m_budget != 0 && getUsage() > m_budget;
+    } else {
+      i++;
+    }
+  }
+}
+
+UINT64 SharedFrameStore::getUsage() const
+{
+  UINT64 usage = m_scratchSize;
+  for (std::list<Frame *>::const_iterator i = m_frames.begin();
+       i != m_frames.end(); i++) {
+    usage += (*i)->frameBuffer.getBufferSize();
+  }
+  return usage;
+}
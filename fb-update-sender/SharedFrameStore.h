@@ -0,0 +1,164 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SHAREDFRAMESTORE_H__
+#define __SHAREDFRAMESTORE_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "util/DateTime.h"
+#include "rfb/FrameBuffer.h"
+#include "desktop/Desktop.h"
+#include "desktop/UpdateContainer.h"
+#include "thread/LocalMutex.h"
+#include "DirtyTileMap.h"
+
+#include <list>
+
+// SharedFrameStore keeps the frame buffers of the clients which do not
+// write into their frame buffers (do not paint the cursor or black out the
+// unshared areas), so that all the clients of the same view port and
+// pixel format read one copy of the screen instead of keeping their own.
+//
+// A frame is never changed while it is read. If it must be brought up to
+// date while another client still encodes from it, a spare frame of the
+// same view port takes its place, or a new one is made. A frame remembers
+// the generation of the changes it has been updated with, so it is brought
+// up to date by copying only the tiles changed since then, whichever
+// client makes it current.
+//
+// Frames may also be scaled down, for the clients that ask the server to
+// scale the screen. A scaled frame is made from the full size frame of the
+// same view port, so the screen is copied and scaled once for all the
+// clients of the same view port and scale, while the full size frame is
+// shared with the other clients as usual.
+//
+// The store also accounts the memory used by the frames and the encoder
+// scratch buffers of the clients against a budget. Spare frames are freed
+// and the clients give back their idle scratch buffers while the budget
+// is exceeded.
+class SharedFrameStore
+{
+public:
+  // Holds a frame read for the object lifetime.
+  class Reader
+  {
+  public:
+    // The store may be 0, the reader never acquires a frame then.
+    Reader(SharedFrameStore *store);
+    ~Reader();
+
+    bool isEnabled() const;
+
+    // Acquires the current frame of the view port brought up to date,
+    // scaled down by the factor (1 or one of the PixelDownscaler factors).
+    // Returns false if the view port does not match the frame buffer of
+    // the desktop, the frame properties are changed then, as on changing
+    // of the screen size.
+    bool acquire(Desktop *desktop, const Rect *viewPort, int scale = 1);
+
+    // Returns 0 if no frame has been acquired. The pixels must not be
+    // changed by the caller.
+    FrameBuffer *getFrameBuffer() const;
+
+  private:
+    SharedFrameStore *m_store;
+    FrameBuffer *m_frameBuffer;
+  };
+
+  // Frames unused for this time are freed, in milliseconds.
+  static const unsigned int SPARE_TIMEOUT = 10000;
+
+  SharedFrameStore();
+  virtual ~SharedFrameStore();
+
+  // Sets the memory budget in bytes, 0 means no limit.
+  void setBudget(UINT64 budget);
+
+  // Records the pixels changed by the update, in frame buffer coordinates.
+  // Must be called before the update is passed to the clients.
+  void markChanged(const UpdateContainer *updateContainer);
+
+  // Changes the size of the scratch buffers accounted for a client from
+  // oldSize to newSize bytes.
+  void onScratchSizeChanged(size_t oldSize, size_t newSize);
+
+  // Returns true if the frames and the scratch buffers use more memory
+  // than the budget.
+  bool isOverBudget();
+
+private:
+  struct Frame
+  {
+    Frame() : scale(1), readers(0), generation(0), filled(false), current(false) {}
+
+    FrameBuffer frameBuffer;
+    Rect viewPort;
+    int scale;
+    PixelFormat pixelFormat;
+    int readers;
+    UINT64 generation;
+    // False until the whole view port has been copied.
+    bool filled;
+    // True for the frame given to the new readers of the view port.
+    bool current;
+    DateTime lastUse;
+  };
+
+  FrameBuffer *acquire(Desktop *desktop, const Rect *viewPort, int scale,
+                       bool *success);
+  void release(FrameBuffer *frameBuffer);
+
+  // Finds or makes the frame to read and brings it up to date. Must be
+  // called with m_lock locked, the frame must be released with
+  // releaseFrame().
+  Frame *acquireFrame(Desktop *desktop, const Rect *viewPort, int scale,
+                      const PixelFormat *pf, bool *success);
+  void releaseFrame(Frame *frame);
+
+  // Copies to the frame the pixels changed since it has been updated last
+  // time. Must be called with m_lock locked.
+  bool update(Frame *frame, Desktop *desktop);
+  // The same for the scaled frames, the pixels are scaled from the full
+  // size frame of the view port.
+  bool updateScaled(Frame *frame, Desktop *desktop);
+
+  // Frees the frames unused for SPARE_TIMEOUT and, when the budget is
+  // exceeded, all the spare frames. Must be called with m_lock locked.
+  void freeSpareFrames();
+
+  UINT64 getUsage() const;
+
+  std::list<Frame *> m_frames;
+  DirtyTileMap m_changes;
+  UINT64 m_budget;
+  UINT64 m_scratchSize;
+  LocalMutex m_lock;
+
+  // Do not allow copying objects.
+  SharedFrameStore(const SharedFrameStore &other);
+  SharedFrameStore &operator=(const SharedFrameStore &other);
+};
+
+#endif // __SHAREDFRAMESTORE_H__
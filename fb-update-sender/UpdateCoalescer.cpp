@@ -0,0 +1,96 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "UpdateCoalescer.h"
+
+#include "thread/AutoLock.h"
+
+UpdateCoalescer::UpdateCoalescer()
+: m_changesPending(false),
+  m_firstChangeTime(0),
+  m_lastChangeTime(0),
+  m_smoothedGap(0)
+{
+  QueryPerformanceFrequency(&m_frequency);
+}
+
+UpdateCoalescer::~UpdateCoalescer()
+{
+}
+
+UINT64 UpdateCoalescer::getMicroseconds() const
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return (UINT64)counter.QuadPart * 1000000 / (UINT64)m_frequency.QuadPart;
+}
+
+void UpdateCoalescer::onChange()
+{
+  UINT64 now = getMicroseconds();
+
+  AutoLock al(&m_lock);
+  UINT64 gap = now - m_lastChangeTime;
+  if (m_lastChangeTime != 0 && gap < MAX_RELATED_GAP * 1000) {
+    if (m_smoothedGap == 0) {
+      m_smoothedGap = gap;
+    } else {
+      m_smoothedGap = (m_smoothedGap * 3 + gap) / 4;
+    }
+  }
+  m_lastChangeTime = now;
+  if (!m_changesPending) {
+    m_changesPending = true;
+    m_firstChangeTime = now;
+  }
+}
+
+unsigned int UpdateCoalescer::getWaitTime(unsigned int rtt)
+{
+  if (rtt > MAX_RTT) {
+    return 0;
+  }
+  UINT64 now = getMicroseconds();
+
+  AutoLock al(&m_lock);
+  if (!m_changesPending || m_smoothedGap == 0) {
+    return 0;
+  }
+  UINT64 sinceFirst = now - m_firstChangeTime;
+  UINT64 sinceLast = now - m_lastChangeTime;
+  UINT64 burstEnd = min(m_smoothedGap * 2, (UINT64)LATENCY_BUDGET * 1000);
+  if (sinceFirst >= LATENCY_BUDGET * 1000 || sinceLast >= burstEnd) {
+    return 0;
+  }
+  UINT64 waitTime = min(burstEnd - sinceLast,
+                        LATENCY_BUDGET * 1000 - sinceFirst);
+  // Round up, so that the sender does not wake up too early.
+  return (unsigned int)((waitTime + 999) / 1000);
+}
+
+void UpdateCoalescer::onUpdateTaken()
+{
+  AutoLock al(&m_lock);
+  m_changesPending = false;
+}
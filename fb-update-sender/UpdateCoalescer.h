@@ -0,0 +1,81 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __UPDATECOALESCER_H__
+#define __UPDATECOALESCER_H__
+
+#include "util/CommonHeader.h"
+#include "thread/LocalMutex.h"
+
+// UpdateCoalescer decides how long the update sender waits after a change
+// for the related ones, so that e.g. the caret and the glyph of a
+// keystroke, found by different detectors a few milliseconds apart, go in
+// one update rather than in two.
+//
+// The gaps between the changes closer than MAX_RELATED_GAP are smoothed;
+// a burst of changes is considered over when no change has come for twice
+// the smoothed gap. The wait never exceeds LATENCY_BUDGET milliseconds
+// from the first change of the update, and there is no wait on paths with
+// the round trip time above MAX_RTT, where the client waits for the
+// updates long enough anyway.
+class UpdateCoalescer
+{
+public:
+  UpdateCoalescer();
+  virtual ~UpdateCoalescer();
+
+  // Should be called on each new change. May be called from any thread.
+  void onChange();
+
+  // Returns the time in milliseconds to wait for more changes before
+  // sending an update, 0 if it should be sent now. rtt is the round trip
+  // time to the client in milliseconds, 0 if unknown.
+  unsigned int getWaitTime(unsigned int rtt);
+
+  // Should be called by the sender thread when it takes the changes for
+  // an update.
+  void onUpdateTaken();
+
+  static const unsigned int MAX_RELATED_GAP = 16;
+  static const unsigned int LATENCY_BUDGET = 8;
+  static const unsigned int MAX_RTT = 100;
+
+private:
+  // Returns the current time in microseconds.
+  UINT64 getMicroseconds() const;
+
+  LARGE_INTEGER m_frequency;
+
+  // Times of the first change since the last update and of the last
+  // change, in microseconds.
+  bool m_changesPending;
+  UINT64 m_firstChangeTime;
+  UINT64 m_lastChangeTime;
+  // Smoothed gap between related changes in microseconds, 0 if unknown.
+  UINT64 m_smoothedGap;
+
+  LocalMutex m_lock;
+};
+
+#endif // __UPDATECOALESCER_H__
@@ -0,0 +1,78 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+#include "UpdateScratch.h"
+
+UpdateScratch::UpdateScratch()
+{
+  m_lists[0] = &normalRects;
+  m_lists[1] = &losslessRects;
+  m_lists[2] = &videoRects;
+  m_lists[3] = &copyRects;
+  m_lists[4] = &moveRects;
+  m_lists[5] = &cacheHitRects;
+  m_lists[6] = &cacheStoreRects;
+  m_lists[7] = &baseRects;
+  m_lists[8] = &backgroundRects;
+  reset();
+}
+
+UpdateScratch::~UpdateScratch()
+{
+}
+
+void UpdateScratch::reset()
+{
+  for (int i = 0; i < NUM_LISTS; i++) {
+    m_lists[i]->clear();
+    m_capacities[i] = m_lists[i]->capacity();
+  }
+}
+
+size_t UpdateScratch::getSize() const
+{
+  size_t size = 0;
+  for (int i = 0; i < NUM_LISTS; i++) {
+    size += m_lists[i]->capacity() * sizeof(Rect);
+  }
+  return size;
+}
+
+void UpdateScratch::release()
+{
+  for (int i = 0; i < NUM_LISTS; i++) {
+    std::vector<Rect>().swap(*m_lists[i]);
+    m_capacities[i] = 0;
+  }
+}
+
+int UpdateScratch::getGrowCount() const
+{
+  int count = 0;
+  for (int i = 0; i < NUM_LISTS; i++) {
+    if (m_lists[i]->capacity() != m_capacities[i]) {
+      count++;
+    }
+  }
+  return count;
+}
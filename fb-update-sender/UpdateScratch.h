@@ -0,0 +1,72 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+#ifndef __UPDATESCRATCH_H__
+#define __UPDATESCRATCH_H__
+
+#include <vector>
+
+#include "region/Rect.h"
+
+// UpdateScratch holds the temporary rectangle lists built by the update
+// sender for each framebuffer update. The lists are emptied, but not
+// freed, at the beginning of every update, so that after a few updates
+// they have grown to their working size and no longer touch the heap.
+//
+// The class is not thread-safe, it's used by the update sender thread only.
+class UpdateScratch
+{
+public:
+  UpdateScratch();
+  virtual ~UpdateScratch();
+
+  // Empties all the lists keeping their storage.
+  void reset();
+
+  // Returns the number of lists which had to reallocate their storage
+  // since the last reset().
+  int getGrowCount() const;
+
+  // Returns the number of bytes allocated by the lists and frees them.
+  size_t getSize() const;
+  void release();
+
+  std::vector<Rect> normalRects;
+  std::vector<Rect> losslessRects;
+  std::vector<Rect> videoRects;
+  std::vector<Rect> copyRects;
+  std::vector<Rect> moveRects;
+  std::vector<Rect> cacheHitRects;
+  std::vector<Rect> cacheStoreRects;
+  std::vector<Rect> baseRects;
+  std::vector<Rect> backgroundRects;
+
+private:
+  static const int NUM_LISTS = 9;
+
+  std::vector<Rect> *m_lists[NUM_LISTS];
+  // Storage sizes of the lists at the last reset().
+  size_t m_capacities[NUM_LISTS];
+};
+
+#endif // __UPDATESCRATCH_H__
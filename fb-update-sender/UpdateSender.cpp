@@ -30,13 +30,55 @@
 #include <algorithm>
 #include "util/inttypes.h"
 #include "util/Exception.h"
+#include "util/MemAccount.h"
 #include "UpdSenderMsgDefs.h"
+#include "CursorShapeCache.h"
+#include "rfb/PixelDownscaler.h"
+#include "rfb/TileHasher.h"
 #include "rfb-sconn/ClipboardExchange.h"
+#include "rfb-sconn/JpegCompressor.h"
+#include "log-writer/FrameTrace.h"
+#include "log-writer/ZoneProfiler.h"
+#include "log-writer/StallWatchdog.h"
+#include "thread/SchedulingPolicy.h"
+#include "RectMerger.h"
+
+// Returns the profiler zone of the encoder with the code.
+static ZoneProfiler::Zone getEncodeZone(int encoding)
+{
+  switch (encoding) {
+  case EncodingDefs::RAW:
+    return ZoneProfiler::ENCODE_RAW;
+  case EncodingDefs::RRE:
+  case EncodingDefs::CORRE:
+    return ZoneProfiler::ENCODE_RRE;
+  case EncodingDefs::HEXTILE:
+    return ZoneProfiler::ENCODE_HEXTILE;
+  case EncodingDefs::ZRLE:
+    return ZoneProfiler::ENCODE_ZRLE;
+  case EncodingDefs::TIGHT:
+    return ZoneProfiler::ENCODE_TIGHT;
+  default:
+    return ZoneProfiler::ENCODE_OTHER;
+  }
+}
 
 UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
                            UpdateRequestListener *updReqListener,
                            SenderControlInformationInterface *senderControlInformation,
-                           RfbOutputGate *output, int id,
+                           RfbOutputGate *output,
+                           EncodedRectCache *rectCache,
+                           DirtyTileMap *dirtyTiles,
+                           SharedFrameStore *frameStore,
+                           MulticastSender *multicast,
+                           unsigned int numEncoderThreads,
+                           bool adaptiveQuality,
+                           bool interactiveFirst,
+                           bool previewFirstFrame,
+                           bool autoEncoding,
+                           const TCHAR *traceFileName,
+                           const TCHAR *recordingFileName,
+                           int id,
                            Desktop *desktop,
                            LogWriter *log)
 : m_updReqListener(updReqListener),
@@ -45,17 +87,92 @@ UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
   m_busy(false),
   m_incrUpdIsReq(false),
   m_fullUpdIsReq(false),
+  m_continuousUpdates(false),
+  m_continuousAnnounced(false),
+  m_continuousEndPending(false),
+  m_fenceAnnounced(false),
+  m_transportZlibStarted(false),
+  m_resyncTileSize(0),
+  m_avoidH264(false),
+  m_cursorCacheLost(false),
   m_setColorMapEntr(false),
+  m_traceFrameId(0),
+  m_traceWriter(0),
+  m_sessionRecorder(0),
   m_output(output),
-  m_enbox(&m_pixelConverter, m_output),
+  m_recorder(output),
+  m_encoderOutput(&m_recorder),
+  m_rectCache(rectCache),
+  m_dirtyTiles(dirtyTiles),
+  m_dirtyTilesGeneration(0),
+  m_multicast(multicast),
+  m_multicastInterested(false),
+  m_multicastReception(false),
+  m_frameStore(frameStore),
+  m_frameShared(false),
+  m_scratchSize(0),
+  m_encodingPool(0),
+  m_encoderSelector(0),
+  m_stagingCache(MAX_STAGED_SIZE),
+  m_stagingPool(0),
+  m_numStaged(0),
+  m_congestion(adaptiveQuality),
+  m_interactiveFirst(interactiveFirst),
+  m_previewFirstFrame(previewFirstFrame),
+  m_previewSent(false),
+  m_outputWasBlocked(false),
+  m_enbox(&m_pixelConverter, &m_encoderOutput),
   m_id(id),
+  m_updatesPending(false),
+  m_startTime(DateTime::now()),
+  m_probeSeq(0),
+  m_networkLatency(0),
   m_videoFrozen(false),
+  m_scale(1),
   m_shareOnlyApp(false),
+  m_viewPortMut(_T("UpdateSender::m_viewPortMut")),
   m_log(log),
   m_cursorUpdates(log)
 {
   // FIXME: argument must be defined
   m_updateKeeper = new UpdateKeeper(&Rect());
+  // The first update is the full one, older changes are not needed.
+  if (m_dirtyTiles != 0) {
+    m_dirtyTilesGeneration = m_dirtyTiles->getGeneration();
+  }
+  QueryPerformanceFrequency(&m_perfFrequency);
+  m_stagingCache.setEnabled(true);
+
+  if (numEncoderThreads != 1) {
+    m_encodingPool = new EncodingWorkerPool(numEncoderThreads);
+    m_log->info(_T("Using %d encoding threads for client #%d"),
+                (int)m_encodingPool->getNumThreads(), m_id);
+  }
+
+  if (autoEncoding) {
+    m_encoderSelector = new EncoderSelector(&m_pixelConverter);
+  }
+
+  if (traceFileName != 0) {
+    try {
+      m_traceWriter = new UpdateTraceWriter(traceFileName);
+      m_log->info(_T("Recording updates for client #%d to %s"),
+                  m_id, traceFileName);
+    } catch (Exception &e) {
+      m_log->error(_T("Cannot record updates to %s: %s"),
+                   traceFileName, e.getMessage());
+    }
+  }
+  if (recordingFileName != 0) {
+    try {
+      m_sessionRecorder = new SessionRecorder(recordingFileName);
+      m_log->info(_T("Recording the session of client #%d to %s"),
+                  m_id, recordingFileName);
+    } catch (Exception &e) {
+      m_log->error(_T("Cannot record the session to %s: %s"),
+                   recordingFileName, e.getMessage());
+    }
+  }
 
   // Capabilities
   codeRegtor->addEncCap(EncodingDefs::COPYRECT,          VendorDefs::STANDARD,
@@ -64,6 +181,10 @@ UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
                         EncodingDefs::SIG_HEXTILE);
   codeRegtor->addEncCap(EncodingDefs::TIGHT,             VendorDefs::TIGHTVNC,
                         EncodingDefs::SIG_TIGHT);
+  codeRegtor->addEncCap(EncodingDefs::H264,              VendorDefs::STANDARD,
+                        EncodingDefs::SIG_H264);
+  codeRegtor->addEncCap(EncodingDefs::TILE_CACHE,        VendorDefs::STANDARD,
+                        EncodingDefs::SIG_TILE_CACHE);
   codeRegtor->addEncCap(PseudoEncDefs::COMPR_LEVEL_0,    VendorDefs::TIGHTVNC,
                         PseudoEncDefs::SIG_COMPR_LEVEL);
   codeRegtor->addEncCap(PseudoEncDefs::QUALITY_LEVEL_0,  VendorDefs::TIGHTVNC,
@@ -72,21 +193,63 @@ UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
                         PseudoEncDefs::SIG_RICH_CURSOR);
   codeRegtor->addEncCap(PseudoEncDefs::POINTER_POS,      VendorDefs::TIGHTVNC,
                         PseudoEncDefs::SIG_POINTER_POS);
+  codeRegtor->addEncCap(PseudoEncDefs::CURSOR_CACHE,     VendorDefs::TIGHTVNC,
+                        PseudoEncDefs::SIG_CURSOR_CACHE);
   codeRegtor->addEncCap(PseudoEncDefs::DESKTOP_SIZE, VendorDefs::TIGHTVNC,
                         PseudoEncDefs::SIG_DESKTOP_SIZE);
   codeRegtor->addEncCap(PseudoEncDefs::DESKTOP_CONFIGURATION, VendorDefs::TIGHTVNC,
                         PseudoEncDefs::SIG_DESKTOP_CONFIGURATION);
+  // The scaled pixels are made by the store of shared frames.
+  if (m_frameStore != 0) {
+    codeRegtor->addEncCap(PseudoEncDefs::SERVER_SCALE_1_2, VendorDefs::TIGHTVNC,
+                          PseudoEncDefs::SIG_SERVER_SCALE);
+  }
+  codeRegtor->addEncCap(PseudoEncDefs::TRANSPORT_ZLIB, VendorDefs::TIGHTVNC,
+                        PseudoEncDefs::SIG_TRANSPORT_ZLIB);
+  codeRegtor->addEncCap(PseudoEncDefs::KEEP_FB_ON_RESIZE, VendorDefs::TIGHTVNC,
+                        PseudoEncDefs::SIG_KEEP_FB_ON_RESIZE);
+  codeRegtor->addEncCap(PseudoEncDefs::LAST_RECT, VendorDefs::TIGHTVNC,
+                        PseudoEncDefs::SIG_LAST_RECT);
+  codeRegtor->addEncCap(PseudoEncDefs::LATENCY_PROBE, VendorDefs::TIGHTVNC,
+                        PseudoEncDefs::SIG_LATENCY_PROBE);
 
   codeRegtor->addClToSrvCap(UpdSenderClientMsgDefs::RFB_VIDEO_FREEZE,
                             VendorDefs::TIGHTVNC,
                             UpdSenderClientMsgDefs::RFB_VIDEO_FREEZE_SIG);
+  codeRegtor->addClToSrvCap(ClientMsgDefs::TILE_HASHES, VendorDefs::TIGHTVNC,
+                            TileHashesDefs::TILE_HASHES_SIG);
+  codeRegtor->addClToSrvCap(ClientMsgDefs::DECODE_FEEDBACK, VendorDefs::TIGHTVNC,
+                            DecodeFeedbackDefs::DECODE_FEEDBACK_SIG);
+  codeRegtor->addClToSrvCap(ClientMsgDefs::LATENCY_REPORT, VendorDefs::TIGHTVNC,
+                            LatencyProbeDefs::LATENCY_REPORT_SIG);
+  if (m_multicast != 0) {
+    codeRegtor->addClToSrvCap(ClientMsgDefs::ENABLE_MULTICAST, VendorDefs::TIGHTVNC,
+                              MulticastDefs::ENABLE_MULTICAST_SIG);
+    codeRegtor->addClToSrvCap(ClientMsgDefs::MULTICAST_RECEPTION, VendorDefs::TIGHTVNC,
+                              MulticastDefs::MULTICAST_RECEPTION_SIG);
+    codeRegtor->addClToSrvCap(ClientMsgDefs::MULTICAST_REPAIR, VendorDefs::TIGHTVNC,
+                              MulticastDefs::MULTICAST_REPAIR_SIG);
+    codeRegtor->addSrvToClCap(ServerMsgDefs::MULTICAST_GROUP, VendorDefs::TIGHTVNC,
+                              MulticastDefs::MULTICAST_GROUP_SIG);
+  }
 
   // Request codes
   codeRegtor->regCode(UpdSenderClientMsgDefs::RFB_VIDEO_FREEZE, this);
   codeRegtor->regCode(ClientMsgDefs::FB_UPDATE_REQUEST, this);
   codeRegtor->regCode(ClientMsgDefs::SET_PIXEL_FORMAT, this);
   codeRegtor->regCode(ClientMsgDefs::SET_ENCODINGS, this);
+  codeRegtor->regCode(ClientMsgDefs::ENABLE_CONTINUOUS_UPDATES, this);
+  codeRegtor->regCode(ClientMsgDefs::CLIENT_FENCE, this);
+  codeRegtor->regCode(ClientMsgDefs::TILE_HASHES, this);
+  codeRegtor->regCode(ClientMsgDefs::DECODE_FEEDBACK, this);
+  codeRegtor->regCode(ClientMsgDefs::LATENCY_REPORT, this);
+  if (m_multicast != 0) {
+    codeRegtor->regCode(ClientMsgDefs::ENABLE_MULTICAST, this);
+    codeRegtor->regCode(ClientMsgDefs::MULTICAST_RECEPTION, this);
+    codeRegtor->regCode(ClientMsgDefs::MULTICAST_REPAIR, this);
+  }
 
+  SchedulingPolicy::apply(this, SchedulingPolicy::ROLE_SENDER);
   resume();
 }
 
@@ -94,7 +257,29 @@ UpdateSender::~UpdateSender()
 {
   terminate();
   wait();
+  if (m_multicastInterested) {
+    m_multicast->removeReceiver();
+  }
+  MemAccount::resized(MEM_ENCODER_SCRATCH, m_scratchSize, 0);
+  if (m_frameStore != 0) {
+    m_frameStore->onScratchSizeChanged(m_scratchSize, 0);
+  }
   delete m_updateKeeper;
+  if (m_encodingPool != 0) {
+    delete m_encodingPool;
+  }
+  if (m_encoderSelector != 0) {
+    delete m_encoderSelector;
+  }
+  if (m_stagingPool != 0) {
+    delete m_stagingPool;
+  }
+  if (m_traceWriter != 0) {
+    delete m_traceWriter;
+  }
+  if (m_sessionRecorder != 0) {
+    delete m_sessionRecorder;
+  }
 }
 
 void UpdateSender::onTerminate()
@@ -118,6 +303,30 @@ void UpdateSender::onRequest(UINT32 reqCode, RfbInputGate *input)
   case UpdSenderClientMsgDefs::RFB_VIDEO_FREEZE:
     readVideoFreeze(input);
     break;
+  case ClientMsgDefs::ENABLE_CONTINUOUS_UPDATES:
+    readEnableContinuousUpdates(input);
+    break;
+  case ClientMsgDefs::CLIENT_FENCE:
+    readFence(input);
+    break;
+  case ClientMsgDefs::TILE_HASHES:
+    readTileHashes(input);
+    break;
+  case ClientMsgDefs::DECODE_FEEDBACK:
+    readDecodeFeedback(input);
+    break;
+  case ClientMsgDefs::LATENCY_REPORT:
+    readLatencyReport(input);
+    break;
+  case ClientMsgDefs::ENABLE_MULTICAST:
+    readEnableMulticast(input);
+    break;
+  case ClientMsgDefs::MULTICAST_RECEPTION:
+    readMulticastReception(input);
+    break;
+  case ClientMsgDefs::MULTICAST_REPAIR:
+    readMulticastRepair(input);
+    break;
   default:
     StringStorage errMess;
     errMess.format(_T("Unknown %d protocol code received"), (int)reqCode);
@@ -131,7 +340,7 @@ void UpdateSender::init(const Dimension *viewPortDimension,
 {
   setClientPixelFormat(pf, false);
   {
-    AutoLock al(&m_viewPortMut);
+    AutoWriteLock al(&m_viewPortMut);
     m_clientDim = *viewPortDimension;
   }
   m_lastViewPortDim = *viewPortDimension;
@@ -142,7 +351,19 @@ void UpdateSender::newUpdates(const UpdateContainer *updateContainer,
                               const CursorShape *cursorShape)
 {
   m_log->debug(_T("New updates passed to client #%d"), m_id);
+  // The moves must be applied to all the changes made before them.
+  if (!updateContainer->copies.empty()) {
+    takeDirtyTiles();
+  }
   addUpdateContainer(updateContainer);
+  m_coalescer.onChange();
+  {
+    AutoLock al(&m_statsLock);
+    if (m_updatesPending) {
+      m_stats.coalescedUpdates++;
+    }
+    m_updatesPending = true;
+  }
 
   m_cursorUpdates.updateCursorShape(cursorShape);
   {
@@ -158,15 +379,48 @@ void UpdateSender::addUpdateContainer(const UpdateContainer *updateContainer)
   UpdateContainer updCont = *updateContainer;
 
   Rect viewPort = getViewPort();
+  int scale = getScale();
 
   updCont.videoRegion.translate(-viewPort.left, -viewPort.top);
   updCont.changedRegion.translate(-viewPort.left, -viewPort.top);
-  updCont.copiedRegion.translate(-viewPort.left, -viewPort.top);
-  updCont.copySrc.move(-viewPort.left, -viewPort.top);
+  std::vector<CopyMove>::iterator iMove;
+  for (iMove = updCont.copies.begin(); iMove != updCont.copies.end(); iMove++) {
+    iMove->region.translate(-viewPort.left, -viewPort.top);
+  }
+  if (receivesMulticast()) {
+    // The changed pixels come by the multicast stream.
+    updCont.changedRegion.clear();
+    updCont.videoRegion.clear();
+    updCont.copies.clear();
+  }
+  if (scale > 1) {
+    // Moves and video are not kept for a scaled screen, the scaled pixels
+    // touched by them are sent as normal changes.
+    updCont.convertCopiesToChanges();
+    updCont.changedRegion.add(&updCont.videoRegion);
+    updCont.videoRegion.clear();
+    scaleDownRegion(&updCont.changedRegion, scale);
+  }
 
   m_updateKeeper->addUpdateContainer(&updCont);
 }
 
+void UpdateSender::takeDirtyTiles()
+{
+  if (m_dirtyTiles == 0) {
+    return;
+  }
+  AutoLock al(&m_dirtyTilesLock);
+  Region changedRegion;
+  m_dirtyTiles->takeChangedSince(&m_dirtyTilesGeneration, &changedRegion);
+  if (!changedRegion.isEmpty() && !receivesMulticast()) {
+    Rect viewPort = getViewPort();
+    changedRegion.translate(-viewPort.left, -viewPort.top);
+    scaleDownRegion(&changedRegion, getScale());
+    m_updateKeeper->addChangedRegion(&changedRegion);
+  }
+}
+
 void UpdateSender::blockCursorPosSending()
 {
   m_cursorUpdates.blockCursorPosSending();
@@ -174,14 +428,20 @@ void UpdateSender::blockCursorPosSending()
 
 Rect UpdateSender::getViewPort()
 {
-  AutoLock al(&m_viewPortMut);
+  AutoReadLock al(&m_viewPortMut);
   return m_viewPort;
 }
 
+int UpdateSender::getScale()
+{
+  AutoReadLock al(&m_viewPortMut);
+  return m_scale;
+}
+
 bool UpdateSender::clientIsReady()
 {
   AutoLock al(&m_reqRectLocMut);
-  return (m_incrUpdIsReq || m_fullUpdIsReq) && !m_busy;
+  return (m_incrUpdIsReq || m_fullUpdIsReq || m_continuousUpdates) && !m_busy;
 }
 
 void UpdateSender::sendRectHeader(const Rect *rect, INT32 encodingType)
@@ -204,6 +464,75 @@ void UpdateSender::sendRectHeader(UINT16 x, UINT16 y, UINT16 w, UINT16 h,
   m_output->writeInt32(encodingType);
 }
 
+void UpdateSender::sendLatencyProbe(const UpdateContainer *updCont,
+                                    const LARGE_INTEGER *frameStart)
+{
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  UINT64 frequency = (UINT64)m_perfFrequency.QuadPart;
+  PendingProbe probe;
+  probe.sendTime = now.QuadPart;
+  probe.captureKnown = updCont->captureTime != 0 &&
+                       updCont->captureTime <= frameStart->QuadPart;
+  probe.captureTime = probe.captureKnown ?
+    (UINT32)((UINT64)(frameStart->QuadPart - updCont->captureTime) * 1000000 /
+             frequency) : 0;
+  probe.encodeTime =
+    (UINT32)((UINT64)(now.QuadPart - frameStart->QuadPart) * 1000000 / frequency);
+
+  UINT32 seq;
+  UINT32 networkLatency;
+  {
+    AutoLock al(&m_statsLock);
+    seq = m_probeSeq++;
+    networkLatency = m_networkLatency;
+    m_pendingProbes[seq] = probe;
+    // A client may drop the reports, the oldest probes are forgotten.
+    if (m_pendingProbes.size() > LatencyProbeDefs::MAX_PENDING_PROBES) {
+      m_pendingProbes.erase(m_pendingProbes.begin());
+    }
+  }
+
+  sendRectHeader(0, 0, 0, 0, PseudoEncDefs::LATENCY_PROBE);
+  m_output->writeUInt32(seq);
+  m_output->writeUInt32(probe.captureTime);
+  m_output->writeUInt32(probe.encodeTime);
+  m_output->writeUInt32(networkLatency);
+}
+
+void UpdateSender::sendFbUpdateHeader(UINT16 numRects)
+{
+  m_output->writeUInt8(ServerMsgDefs::FB_UPDATE); // message type
+  m_output->writeUInt8(0); // padding
+  m_output->writeUInt16(numRects);
+}
+
+void UpdateSender::sendLeadingRectangles(const UpdateContainer *updCont,
+                                         const PixelFormat *clientPixelFormat,
+                                         const CursorShape *cursorShape,
+                                         TileCacheEncoder *tileCache,
+                                         const std::vector<Rect> *cacheHitRects,
+                                         const FrameBuffer *frameBuffer,
+                                         const EncodeOptions *encodeOptions)
+{
+  if (updCont->cursorPosChanged) {
+    sendCursorPosUpdate();
+  }
+  if (updCont->cursorShapeChanged) {
+    m_log->debug(_T("Sending cursor shape update"));
+    sendCursorShapeUpdate(clientPixelFormat, cursorShape,
+                          encodeOptions->cursorCacheEnabled());
+  }
+  if (!updCont->copies.empty()) {
+    m_log->debug(_T("Sending CopyRect rectangles"));
+    sendCopyRect(&updCont->copies);
+  }
+  if (tileCache != 0) {
+    m_log->debug(_T("Sending tile cache hits"));
+    sendRectangles(tileCache, cacheHitRects, frameBuffer, encodeOptions);
+  }
+}
+
 void UpdateSender::sendNewFBSize(Dimension *dim, bool extended)
 {
   // Header
@@ -220,6 +549,10 @@ void UpdateSender::sendNewFBSize(Dimension *dim, bool extended)
     if (screens.size() > 255) {
       screens.resize(255);
     }
+    int scale = getScale();
+    for (size_t i = 0; i < screens.size() && scale > 1; i++) {
+      screens[i] = scaleDownRect(&screens[i], scale);
+    }
     sendRectHeader(&r, PseudoEncDefs::DESKTOP_CONFIGURATION);
 
     m_output->writeUInt8((UINT8)screens.size()); // number-of-screens
@@ -263,21 +596,45 @@ void UpdateSender::sendFbInClientDim(const EncodeOptions *encodeOptions,
 }
 
 void UpdateSender::sendCursorShapeUpdate(const PixelFormat *fmt,
-                                         const CursorShape *cursorShape)
+                                         const CursorShape *cursorShape,
+                                         bool useCache)
 {
   // Send pseudo-rectangle.
   Point hotSpot = cursorShape->getHotSpot();
   Dimension dim = cursorShape->getDimension();
-  sendRectHeader(hotSpot.x, hotSpot.y, dim.width, dim.height,
-                 PseudoEncDefs::RICH_CURSOR);
+  UINT64 checksum = CursorShapeCache::calcChecksum(cursorShape);
+  if (useCache) {
+    UINT16 slot;
+    UINT8 operation = m_clientCursorCache.lookUp(checksum, fmt, &slot);
+    sendRectHeader(hotSpot.x, hotSpot.y, dim.width, dim.height,
+                   PseudoEncDefs::CURSOR_CACHE);
+    m_output->writeUInt8(operation);
+    m_output->writeUInt16(slot);
+    if ((operation & ~ClientCursorCache::RESET_CACHE) == ClientCursorCache::OP_HIT) {
+      m_log->debug(_T("Cursor shape is cached by the client in slot %d"), (int)slot);
+      return;
+    }
+  } else {
+    sendRectHeader(hotSpot.x, hotSpot.y, dim.width, dim.height,
+                   PseudoEncDefs::RICH_CURSOR);
+  }
 
-  FrameBuffer fbConverted;
-  fbConverted.setProperties(&dim, fmt);
-  m_pixelConverter.convert(&dim.getRect(), &fbConverted,
-                           cursorShape->getPixels());
+  // The converted pixels are shared by all the clients of the pixel format.
+  std::vector<char> pixels;
+  CursorShapeCache *shapeCache = CursorShapeCache::getInstance();
+  if (!shapeCache->find(checksum, fmt, &pixels)) {
+    FrameBuffer fbConverted;
+    Rect shapeRect = dim.getRect();
+    fbConverted.setProperties(&dim, fmt);
+    m_pixelConverter.convert(&shapeRect, &fbConverted,
+                             cursorShape->getPixels());
+    shapeCache->store(checksum, &fbConverted);
+    const char *buffer = (const char *)fbConverted.getBuffer();
+    pixels.assign(buffer, buffer + fbConverted.getBufferSize());
+  }
 
-  if (fbConverted.getBufferSize()) {
-    m_output->writeFully(fbConverted.getBuffer(), fbConverted.getBufferSize());
+  if (!pixels.empty()) {
+    m_output->writeFully(&pixels.front(), pixels.size());
   }
   if (cursorShape->getMaskSize()) {
     m_output->writeFully(cursorShape->getMask(), cursorShape->getMaskSize());
@@ -291,20 +648,50 @@ void UpdateSender::sendCursorPosUpdate()
   sendRectHeader(pos.x, pos.y, 0, 0, PseudoEncDefs::POINTER_POS);
 }
 
-void UpdateSender::sendCopyRect(const std::vector<Rect> *rects, const Point *source)
+void UpdateSender::sendCopyRect(const std::vector<CopyMove> *copies)
 {
+  std::vector<CopyMove>::const_iterator iMove;
+  std::vector<Rect> &rects = m_scratch.moveRects;
   std::vector<Rect>::const_iterator iRect;
 
-  for (iRect = rects->begin(); iRect != rects->end(); iRect++) {
-    const Rect *rect = &(*iRect);
+  for (iMove = copies->begin(); iMove != copies->end(); iMove++) {
+    iMove->getRects(&rects);
+    for (iRect = rects.begin(); iRect != rects.end(); iRect++) {
+      const Rect *rect = &(*iRect);
+
+      sendRectHeader(rect, EncodingDefs::COPYRECT);
 
-    sendRectHeader(rect, EncodingDefs::COPYRECT);
+      // Send copyRect data
+      m_output->writeUInt16(rect->left + iMove->offset.x);
+      m_output->writeUInt16(rect->top + iMove->offset.y);
+    }
+    AutoLock al(&m_statsLock);
+    m_stats.rectsSent += rects.size();
+    m_stats.copyRectsSent += rects.size();
+    m_stats.addEncodingBytes(EncodingDefs::COPYRECT, rects.size() * COPYRECT_SIZE);
+  }
+}
 
-    // Send copyRect data
-    // FIXME: Each dest rect should have own source point
-    m_output->writeUInt16(source->x);
-    m_output->writeUInt16(source->y);
+void UpdateSender::getStatistics(UpdateStatistics *stats)
+{
+  {
+    AutoLock al(&m_statsLock);
+    *stats = m_stats;
+    stats->uptime = (DateTime::now() - m_startTime).getTime();
+    stats->latencyReports = m_stageLatency[LatencyProbeDefs::STAGE_PRESENT].getCount();
+    for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+      for (size_t i = 0; i < UpdateStatistics::LATENCY_PERCENTILE_COUNT; i++) {
+        stats->stageLatency[stage][i] = m_stageLatency[stage].getPercentile(
+          UpdateStatistics::LATENCY_PERCENTILES[i]);
+      }
+    }
   }
+  stats->roundTripTime = m_congestion.getRoundTripTime();
+  stats->queueingDelay = m_congestion.getQueueingDelay();
+  stats->throughput = m_congestion.getThroughput();
+  m_output->getCompressionStats(&stats->transportBytesIn,
+                                &stats->transportBytesOut,
+                                &stats->transportDeflateTime);
 }
 
 void UpdateSender::sendPalette(PixelFormat *pf)
@@ -324,58 +711,125 @@ void UpdateSender::sendUpdate()
 {
   m_log->debug(_T("Entered to the sendUpdate() function"));
 
-//  m_log->checkPoint(_T("1 sendUpdate() begins"));
 
   // Check requested regions and immediately return if the client did not
   // request anything.
   Region requestedFullReg, requestedIncrReg;
   bool incrUpdIsReq, fullUpdIsReq;
   DateTime reqTimePoint;
-  if (!extractReqRegions(&requestedIncrReg, &requestedFullReg,
-                         &incrUpdIsReq, &fullUpdIsReq,
-                         &reqTimePoint)) {
+  bool isRequested = extractReqRegions(&requestedIncrReg, &requestedFullReg,
+                                       &incrUpdIsReq, &fullUpdIsReq,
+                                       &reqTimePoint);
+  // The continuous updates area is requested implicitly, so it is not
+  // restored to the requested regions when there is nothing to send.
+  Region clientIncrReg = requestedIncrReg;
+  bool clientIncrUpdIsReq = incrUpdIsReq;
+  Region continuousReg;
+  bool continuousUpdates = extractContinuousRegion(&continuousReg);
+  if (continuousUpdates) {
+    requestedIncrReg.add(&continuousReg);
+    incrUpdIsReq = true;
+    if (!isRequested) {
+      reqTimePoint = DateTime::now();
+    }
+  }
+  if (!isRequested && !continuousUpdates) {
     m_log->debug(_T("No request, exiting from the sendUpdate()"));
+    preEncode();
     return;
   }
   m_log->debug(_T("Time between request and a point after extractReqRegions (in milliseconds): %u"),
     (unsigned int)(DateTime::now() - reqTimePoint).getTime());
   m_log->debug(_T("A request has been made, continuing"));
+  m_traceFrameId = FrameTrace::getInstance()->nextFrameId();
+  FrameTrace::Span updateSpan(FrameTrace::UPDATE, m_traceFrameId);
+  LARGE_INTEGER frameStart;
+  QueryPerformanceCounter(&frameStart);
   m_log->debug(_T("The incremental region has %d rectangles"),
              (int)requestedIncrReg.getCount());
   m_log->debug(_T("The full region has %d rectangles"),
              (int)requestedFullReg.getCount());
 
+  m_scratch.reset();
+
   UpdateContainer updCont;
   extractUpdates(&updCont);
 
   EncodeOptions encodeOptions;
   selectEncoder(&encodeOptions);
-  EncodeOptions losslessEncodeOptions;
-  bool losslessEnabled = encodeOptions.jpegEnabled();
-  if (losslessEnabled) {
-    selectEncoder(&losslessEncodeOptions);
-    losslessEncodeOptions.disableJpeg();
-  }
+  encodeOptions.setRoi(m_interactiveFirst, ROI_QUALITY_DROP);
+  // Video regions and normal lossy rectangles get their own JPEG quality
+  // and chroma subsampling.
+  EncodeOptions videoEncodeOptions = encodeOptions;
+  m_congestion.adjustEncodeOptions(&encodeOptions, false);
+  m_congestion.adjustEncodeOptions(&videoEncodeOptions, true);
+  // Pixels sent lossy are refined later with JPEG disabled.
+  EncodeOptions losslessEncodeOptions = encodeOptions;
+  losslessEncodeOptions.disableJpeg();
 
   // Viewport calculating
   Rect viewPort;
   bool shareOnlyApp;
   Region prevShareAppRegion;
   Region shareAppRegion;
+  Rect prevViewPort = getViewPort();
   bool viewPortChanged = updateViewPort(&viewPort, &shareOnlyApp, &prevShareAppRegion,
                                         &shareAppRegion);
-
-  updateFrameBuffer(&updCont, shareOnlyApp, &prevShareAppRegion, &shareAppRegion);
+  int scale;
+  bool scaleChanged = updateScale(&encodeOptions, shareOnlyApp, &scale);
+  if (scaleChanged) {
+    viewPortChanged = true;
+  }
+  // A client keeping its pixels across desktop resizes is sent only the
+  // changed and the newly exposed ones, if its pixels stay at their places.
+  bool keepClientPixels = encodeOptions.keepFbOnResizeEnabled() &&
+                          (encodeOptions.desktopSizeEnabled() ||
+                           encodeOptions.desktopConfigurationEnabled()) &&
+                          !scaleChanged && !shareOnlyApp &&
+                          prevViewPort.left == viewPort.left &&
+                          prevViewPort.top == viewPort.top;
+
+  // The clients which write nothing to their frame buffer (the cursor is
+  // drawn by the viewer and the whole view port is shared) read the frame
+  // shared with the other clients of the same view port. It must not be
+  // changed here. Scaled screens are always read from the shared frames,
+  // without the cursor.
+  bool frameSharable = m_frameStore != 0 && !shareOnlyApp &&
+                       (scale > 1 ||
+                        (encodeOptions.richCursorEnabled() &&
+                         encodeOptions.pointerPosEnabled()));
+  SharedFrameStore::Reader sharedFrame(frameSharable ? m_frameStore : 0);
+  updateFrameBuffer(&updCont, shareOnlyApp, &prevShareAppRegion, &shareAppRegion,
+                    &sharedFrame, scale);
   FrameBuffer *frameBuffer = &m_frameBuffer;
+  if (sharedFrame.getFrameBuffer() != 0) {
+    frameBuffer = sharedFrame.getFrameBuffer();
+  }
+  if (scale > 1) {
+    // From here on, the view port is in the coordinates of the scaled
+    // screen. The interactive regions are not looked for on it.
+    viewPort = Rect(viewPort.left / scale, viewPort.top / scale,
+                    viewPort.left / scale + viewPort.getWidth() / scale,
+                    viewPort.top / scale + viewPort.getHeight() / scale);
+    encodeOptions.setRoi(false, 0);
+  }
 
   AutoLock l(m_output);
+  UINT64 encodedSizeBefore = m_recorder.getTotalWritten();
+  if (m_sessionRecorder != 0) {
+    m_output->startRecording();
+  }
+  // A keyframe may follow only an update after which the client framebuffer
+  // has the pixels of our one.
+  bool keyFramePossible = false;
 
   Dimension clientDim, lastViewPortDim;
   {
-    AutoLock al(&m_viewPortMut);
+    AutoReadLock al(&m_viewPortMut);
     clientDim = m_clientDim;
     lastViewPortDim = m_lastViewPortDim;
   }
+  Dimension prevViewPortDim = lastViewPortDim;
 
   // If client does not support the desktop resizing then view port dimension
   // must be no more than client dimension.
@@ -391,9 +845,13 @@ void UpdateSender::sendUpdate()
     updCont.screenSizeChanged = true;
   }
   if (dimensionChanged || viewPortChanged) {
-    updCont.copiedRegion.clear();
+    m_mcuFilter.reset();
+    if (keepClientPixels) {
+      updCont.convertCopiesToChanges();
+    }
+    updCont.copies.clear();
 
-    AutoLock al(&m_viewPortMut);
+    AutoWriteLock al(&m_viewPortMut);
     m_lastViewPortDim.setDim(&viewPort);
     lastViewPortDim = m_lastViewPortDim;
     if (encodeOptions.desktopSizeEnabled() || encodeOptions.desktopConfigurationEnabled()) {
@@ -402,9 +860,16 @@ void UpdateSender::sendUpdate()
     } 
     m_updateKeeper->setBorderRect(&lastViewPortDim.getRect());
     updCont.changedRegion.crop(&lastViewPortDim.getRect());
-    // Dazzle changedRegion
-    updCont.changedRegion.addRect(&lastViewPortDim.getRect());
-    m_updateKeeper->dazzleChangedReg();
+    if (keepClientPixels) {
+      Region exposedRegion(lastViewPortDim.getRect());
+      Region prevRegion(prevViewPortDim.getRect());
+      exposedRegion.subtract(&prevRegion);
+      updCont.changedRegion.add(&exposedRegion);
+    } else {
+      // Dazzle changedRegion
+      updCont.changedRegion.addRect(&lastViewPortDim.getRect());
+      m_updateKeeper->dazzleChangedReg();
+    }
 	m_updateKeeper->setCursorPosChanged();
 	m_updateKeeper->setCursorShapeChanged();
   }
@@ -439,26 +904,41 @@ void UpdateSender::sendUpdate()
       sendFbInClientDim(&encodeOptions, frameBuffer, &clientDim,
                         &frameBuffer->getPixelFormat());
     }
-    // FIXME: "Dazzle" does not seem like a good word here.
-    m_log->debug(_T("Dazzle changed region"));
-    m_updateKeeper->dazzleChangedReg();
+    if (keepClientPixels) {
+      // The rest of this update follows the new size.
+      m_log->debug(_T("The client keeps its pixels, sending changes only"));
+      Region keptChanges = updCont.changedRegion;
+      keptChanges.add(&updCont.videoRegion);
+      keptChanges.add(&requestedFullReg);
+      m_updateKeeper->addChangedRegion(&keptChanges);
+    } else {
+      // FIXME: "Dazzle" does not seem like a good word here.
+      m_log->debug(_T("Dazzle changed region"));
+      m_updateKeeper->dazzleChangedReg();
+    }
 	  m_updateKeeper->setCursorPosChanged();
   } else {
     m_log->debug(_T("Processing normal updates"));
+    keyFramePossible = true;
     CursorShape cursorShape;
-    m_cursorUpdates.update(&encodeOptions,
-                           &updCont,
-                           !requestedFullReg.isEmpty(),
-                           &viewPort,
-                           shareOnlyApp,
-                           &shareAppRegion,
-                           frameBuffer,
-                           &cursorShape);
+    if (scale > 1) {
+      // There is no pointer to show on a scaled screen.
+      updCont.cursorPosChanged = false;
+      updCont.cursorShapeChanged = false;
+    } else {
+      m_cursorUpdates.update(&encodeOptions,
+                             &updCont,
+                             !requestedFullReg.isEmpty(),
+                             &viewPort,
+                             shareOnlyApp,
+                             &shareAppRegion,
+                             frameBuffer,
+                             &cursorShape);
+    }
 
     if (!encodeOptions.copyRectEnabled() || getVideoFrozen()) {
       m_log->debug(_T("CopyRect is disabled, converting to normal updates"));
-      updCont.changedRegion.add(&updCont.copiedRegion);
-      updCont.copiedRegion.clear();
+      updCont.convertCopiesToChanges();
     }
 
     updCont.changedRegion.add(&m_prevVideoRegion); // This line updates rid video places when
@@ -477,11 +957,14 @@ void UpdateSender::sendUpdate()
     updCont.changedRegion.crop(&frameBufferRect);
     shareAppRegion.crop(&frameBufferRect);
     prevShareAppRegion.crop(&frameBufferRect);
-    m_losslessClean.crop(&frameBufferRect);
-
-    // If Tight encoding is not supported by the client, convert video updates
-    // to normal updates so that the preferred encoding will be used.
-    if (!encodeOptions.encodingEnabled(EncodingDefs::TIGHT)) {
+    m_refiner.crop(&frameBufferRect);
+    m_previewRegion.crop(&frameBufferRect);
+
+    // If neither Tight nor H.264 encoding is supported by the client, convert
+    // video updates to normal updates so that the preferred encoding will be
+    // used.
+    if (!encodeOptions.encodingEnabled(EncodingDefs::TIGHT) &&
+        !encodeOptions.encodingEnabled(EncodingDefs::H264)) {
       updCont.changedRegion.add(&updCont.videoRegion);
       updCont.videoRegion.clear();
     }
@@ -492,6 +975,12 @@ void UpdateSender::sendUpdate()
     Region videoRegion = updCont.videoRegion;
     Region changedRegion = updCont.changedRegion;
 
+    // The tiles a reconnected client has already are not resent. Outside
+    // of the shared application the pixels are painted black below, so
+    // the tiles cannot be compared there.
+    skipResyncedTiles(shareOnlyApp ? 0 : frameBuffer, &changedRegion,
+                      &videoRegion);
+
     if (shareOnlyApp) {
       Region newOpeningAppRegion = shareAppRegion;
       newOpeningAppRegion.subtract(&prevShareAppRegion);
@@ -506,54 +995,259 @@ void UpdateSender::sendUpdate()
       paintBlack(frameBuffer, &blackRegion);
     }
 
-    if (losslessEnabled) {
-      m_losslessDirty.add(changedRegion);
-      m_losslessClean.subtract(&changedRegion);
+    // A monitor with many changes must not delay the others, the changes
+    // over the fair share of each monitor go with the next updates.
+    if (dimensionChanged || viewPortChanged || m_outputScheduler.isOutdated()) {
+      std::vector<Rect> outputs = m_desktop->getDisplaysCoords();
+      for (size_t i = 0; i < outputs.size() && scale > 1; i++) {
+        outputs[i] = scaleDownRect(&outputs[i], scale);
+      }
+      m_outputScheduler.setOutputs(&outputs, &viewPort);
+    }
+    Region deferredRegion;
+    m_outputScheduler.schedule(&changedRegion, &deferredRegion);
+    if (m_interactiveFirst && scale == 1 &&
+        (m_outputWasBlocked || m_congestion.isCongested())) {
+      takeInteractiveRegion(&changedRegion, &deferredRegion, &viewPort);
+    }
+    if (!deferredRegion.isEmpty()) {
+      m_log->debug(_T("%d rectangles deferred to the next update"),
+                   (int)deferredRegion.getCount());
+      keyFramePossible = false;
+      m_updateKeeper->addChangedRegion(&deferredRegion);
+      m_newUpdatesEvent.notify();
+    }
+
+    // Send the video region as H.264 frames if the client supports that.
+    // A frame covers the bounding box of the region, the parts of the region
+    // that do not fit into the frame go with the normal updates.
+    Encoder *videoEncoder = 0;
+    if (!videoRegion.isEmpty() && !m_avoidH264 &&
+        encodeOptions.encodingEnabled(EncodingDefs::H264)) {
+      m_enbox.validateH264Encoder();
+      H264Encoder *h264Encoder = m_enbox.getH264Encoder();
+      Rect videoBounds = videoRegion.getBounds();
+      if (h264Encoder != 0 && h264Encoder->prepare(&videoBounds, frameBuffer)) {
+        Rect frameRect = h264Encoder->getFrameRect();
+        Region frameRegion(frameRect);
+        videoRegion.subtract(&frameRegion);
+        changedRegion.add(&videoRegion);
+        videoRegion = frameRegion;
+        videoEncoder = h264Encoder;
+      }
+    }
+    if (videoEncoder == 0 && !encodeOptions.encodingEnabled(EncodingDefs::TIGHT)) {
+      changedRegion.add(&videoRegion);
+      videoRegion.clear();
+    }
+
+    // The JPEG video region goes out whole with each update. Aligned to the
+    // MCU grid, its blocks equal to the ones the client has are left out.
+    bool mcuFilterUsed = videoEncoder == 0 && !videoRegion.isEmpty();
+    if (mcuFilterUsed) {
+      Region requestedRegion = requestedIncrReg;
+      requestedRegion.add(&requestedFullReg);
+      McuFilter::alignToGrid(&videoRegion, &frameBufferRect);
+      videoRegion.intersect(&requestedRegion);
+      changedRegion.subtract(&videoRegion);
+      size_t mcusSkipped = m_mcuFilter.filter(&videoRegion, frameBuffer);
+      if (mcusSkipped != 0) {
+        AutoLock al(&m_statsLock);
+        m_stats.mcusSkipped += mcusSkipped;
+      }
+    } else {
+      m_mcuFilter.reset();
+    }
+
+    // The first full update goes out as a coarse JPEG preview, all of it,
+    // so the client shows the screen at once. The following updates resend
+    // it at the normal quality.
+    bool preview = false;
+    Encoder *normalEncoder = m_enbox.getEncoder();
+    if (m_previewFirstFrame && !m_previewSent && !requestedFullReg.isEmpty()) {
+      m_previewSent = true;
+      if (encodeOptions.jpegEnabled()) {
+        preview = true;
+        encodeOptions.setJpegQualityLevel(PREVIEW_QUALITY);
+        encodeOptions.setJpegSubsampling(JpegCompressor::SUBSAMPLING_420);
+        m_enbox.validateJpegEncoder();
+        normalEncoder = m_enbox.getJpegEncoder();
+        m_log->info(_T("Sending a preview of the screen to client #%d"), m_id);
+      }
+    }
+
+    // Resend losslessly the pixels which went out lossy and have been static
+    // for a while. Nothing is refined while the network is congested or the
+    // preview is not resent yet. Along with other changes, no more than 1/100
+    // part of the framebuffer is refined per update (at 20 fps full screen
+    // will be sent in 5 sec), more is refined if there is nothing else to
+    // send.
+    Region sentRegion = changedRegion;
+    sentRegion.add(&videoRegion);
+    if (preview) {
+      m_previewRegion = changedRegion;
+    } else {
+      m_previewRegion.subtract(&sentRegion);
+    }
+    Region lossyRegion;
+    if (encodeOptions.jpegEnabled()) {
+      lossyRegion = changedRegion;
+    }
+    if (videoEncoder != 0 || encodeOptions.jpegEnabled()) {
+      lossyRegion.add(&videoRegion);
+    }
+    m_refiner.onUpdate(&sentRegion, &lossyRegion);
+
+    Region losslessRegion;
+    if (!m_congestion.isCongested() && m_previewRegion.isEmpty()) {
+      int screenArea = frameBufferRect.area();
+      int refineArea = sentRegion.isEmpty() ? screenArea / IDLE_REFINE_PARTS
+                                            : screenArea / REFINE_PARTS;
+      losslessRegion = m_refiner.takeRefinement(refineArea);
+    }
+
+    // The next part of the preview goes with the next update as a change.
+    if (!m_previewRegion.isEmpty()) {
+      Region previewSlice;
+      takePreviewSlice(frameBufferRect.area() / PREVIEW_REFINE_PARTS, scale,
+                       &previewSlice);
+      m_updateKeeper->addChangedRegion(&previewSlice);
+      m_newUpdatesEvent.notify();
     }
-    // Add some lossless data to every update but no more than 1/100 part of framebuffer.
-    // So at 20 fps full screen will be sent in 5 sec.
-    int screenArea = frameBufferRect.area();
-    Region losslessRegion = takePartFromRegion(&m_losslessClean, screenArea / 100);
-    if (losslessEnabled) {
-      if (losslessRegion.isEmpty()) {
-        m_losslessClean.set(&m_losslessDirty);
-        m_losslessDirty.clear();
+
+    // Tiles cached by the client are sent as references to its cache, other
+    // full tiles are stored in the cache after they have been sent.
+    TileCacheEncoder *tileCache = 0;
+    std::vector<Rect> &cacheHitRects = m_scratch.cacheHitRects;
+    std::vector<Rect> &cacheStoreRects = m_scratch.cacheStoreRects;
+    if (encodeOptions.encodingEnabled(EncodingDefs::TILE_CACHE)) {
+      m_enbox.validateTileCacheEncoder();
+      tileCache = m_enbox.getTileCacheEncoder();
+      // The preview pixels are not to be reused by the client.
+      if (!preview) {
+        tileCache->lookUp(&changedRegion, frameBuffer,
+                          !encodeOptions.jpegEnabled(),
+                          &cacheHitRects, &cacheStoreRects);
       }
+      tileCache->lookUp(&losslessRegion, frameBuffer, true,
+                        &cacheHitRects, &cacheStoreRects);
+      m_log->debug(_T("Tile cache: %d hits, %d tiles to store"),
+                   (int)cacheHitRects.size(), (int)cacheStoreRects.size());
+    } else if (m_enbox.getTileCacheEncoder() != 0) {
+      m_enbox.getTileCacheEncoder()->reset();
     }
 
     //
     // At this point, we've got final regions in changedRegion and videoRegion.
     //
 
+    if (mcuFilterUsed) {
+      Region clientChangedRegion = changedRegion;
+      clientChangedRegion.add(&videoRegion);
+      clientChangedRegion.add(&losslessRegion);
+      clientChangedRegion.addRects(&cacheHitRects);
+      clientChangedRegion.addRects(&cacheStoreRects);
+      std::vector<CopyMove>::const_iterator iMove;
+      for (iMove = updCont.copies.begin(); iMove != updCont.copies.end(); iMove++) {
+        clientChangedRegion.add(&iMove->region);
+      }
+      m_mcuFilter.onSent(&clientChangedRegion, frameBuffer);
+    }
+
+    if (m_traceWriter != 0) {
+      Region tracedRegion = changedRegion;
+      tracedRegion.add(&videoRegion);
+      try {
+        m_traceWriter->writeFrame(frameBuffer, &tracedRegion, &updCont.copies);
+      } catch (Exception &e) {
+        m_log->error(_T("Cannot record the update, recording stopped: %s"),
+                     e.getMessage());
+        delete m_traceWriter;
+        m_traceWriter = 0;
+      }
+    }
+
+    // With LastRect, the header and the rectangles needing no encoding go
+    // out before the regions are split, and each list of the encoded
+    // rectangles is flushed as soon as it is sent.
+    bool streamRects = encodeOptions.lastRectEnabled();
+    bool headerSent = false;
+    if (streamRects &&
+        (!changedRegion.isEmpty() || !losslessRegion.isEmpty() ||
+         !videoRegion.isEmpty() || !updCont.copies.empty() ||
+         !cacheHitRects.empty() || !cacheStoreRects.empty() ||
+         updCont.cursorPosChanged || updCont.cursorShapeChanged)) {
+      m_log->debug(_T("Sending FramebufferUpdate message header")
+                   _T(" with streamed rectangles"));
+      sendFbUpdateHeader(PseudoEncDefs::LAST_RECT_COUNT);
+      sendLeadingRectangles(&updCont, &clientPixelFormat, &cursorShape,
+                            tileCache, &cacheHitRects, frameBuffer,
+                            &encodeOptions);
+      m_output->flush();
+      headerSent = true;
+    }
+
     // Convert changedRegion to the final list of rectangles.
     m_log->debug(_T("Number of normal rectangles before splitting: %d"),
                changedRegion.getCount());
-    std::vector<Rect> normalRects;
-    splitRegion(m_enbox.getEncoder(), &changedRegion, &normalRects,
+    std::vector<Rect> &normalRects = m_scratch.normalRects;
+    splitRegion(normalEncoder, &changedRegion, &normalRects,
                 frameBuffer, &encodeOptions);
+    if (preview && m_encodingPool != 0) {
+      splitIntoBands(&normalRects, m_encodingPool->getNumThreads());
+    }
+
+    // The rectangles out of the region of interest go after the other
+    // ones, with a lower quality if they are lossy anyway.
+    std::vector<Rect> &backgroundRects = m_scratch.backgroundRects;
+    EncodeOptions backgroundEncodeOptions = encodeOptions;
+    if (encodeOptions.roiEnabled()) {
+      Region interestRegion;
+      getInteractiveRegion(&viewPort, &interestRegion);
+      separateBackground(&normalRects, &interestRegion, &backgroundRects);
+      if (encodeOptions.jpegEnabled()) {
+        int quality = encodeOptions.getJpegQualityLevel() -
+                      encodeOptions.getRoiQualityDrop();
+        backgroundEncodeOptions.setJpegQualityLevel(max(quality, 0));
+      }
+    }
 
     // Convert losslessRegion to the final list of rectangles.
-    std::vector<Rect> losslessRects;
-    if (losslessEnabled && !losslessRegion.isEmpty()) {
+    std::vector<Rect> &losslessRects = m_scratch.losslessRects;
+    if (!losslessRegion.isEmpty()) {
       m_log->debug(_T("Number of lossless rectangles before splitting: %d"),
         losslessRegion.getCount());
       splitRegion(m_enbox.getEncoder(), &losslessRegion, &losslessRects,
         frameBuffer, &losslessEncodeOptions);
     }
     // Do the same for the videoRegion.
-    std::vector<Rect> videoRects;
+    std::vector<Rect> &videoRects = m_scratch.videoRects;
     if (!videoRegion.isEmpty()) {
       m_log->debug(_T("Video region is not empty"));
-      m_enbox.validateJpegEncoder(); // make sure JpegEncoder is allocated
-      splitRegion(m_enbox.getJpegEncoder(), &videoRegion, &videoRects,
-                  frameBuffer, &encodeOptions);
+      if (videoEncoder == 0) {
+        m_enbox.validateJpegEncoder(); // make sure JpegEncoder is allocated
+        videoEncoder = m_enbox.getJpegEncoder();
+      }
+      splitRegion(videoEncoder, &videoRegion, &videoRects,
+                  frameBuffer, &videoEncodeOptions);
+      // A JPEG rectangle is compressed by one thread, a whole video frame
+      // would keep the others idle.
+      if (videoEncoder == m_enbox.getJpegEncoder() && m_encodingPool != 0) {
+        splitIntoBands(&videoRects, m_encodingPool->getNumThreads());
+      }
     }
 
-    // Get the final list of CopyRect rectangles.
-    std::vector<Rect> copyRects;
-    updCont.copiedRegion.getRectVector(&copyRects);
+    // Get the final list of CopyRect rectangles, all moves together.
+    std::vector<Rect> &copyRects = m_scratch.copyRects;
+    std::vector<CopyMove>::const_iterator iMove;
+    for (iMove = updCont.copies.begin(); iMove != updCont.copies.end(); iMove++) {
+      std::vector<Rect> &moveRects = m_scratch.moveRects;
+      iMove->getRects(&moveRects);
+      copyRects.insert(copyRects.end(), moveRects.begin(), moveRects.end());
+    }
 
     m_log->debug(_T("Number of normal rectangles: %d"), normalRects.size());
+    m_log->debug(_T("Number of background rectangles: %d"), backgroundRects.size());
     m_log->debug(_T("Number of lossless rectangles: %d"), losslessRects.size());
     m_log->debug(_T("Number of video rectangles: %d"), videoRects.size());
     m_log->debug(_T("Number of CopyRect rectangles: %d"), copyRects.size());
@@ -566,81 +1260,222 @@ void UpdateSender::sendUpdate()
       m_log->debug(_T("Area of CopyRect rectangles: %d"), calcAreas(copyRects));
     }
 
-    // Calculate the total number of rectangles and pseudo-rectangles.
-    size_t numTotalRects =
-      normalRects.size() + losslessRects.size() + videoRects.size() + copyRects.size();
-
-    if (updCont.cursorPosChanged) {
-      numTotalRects++;
-      m_log->debug(_T("Adding a pseudo-rectangle for cursor position update"));
-    }
-    if (updCont.cursorShapeChanged) {
-      numTotalRects++;
-      m_log->debug(_T("Adding a pseudo-rectangle for cursor shape update"));
-    }
-    m_log->detail(_T("Total number of rectangles and pseudo-rectangles: %d"),
-               numTotalRects);
-
-    // FIXME: Handle this better, e.g. send first 65534 rectangles.
-    _ASSERT(numTotalRects <= 65534);
-
-    if (numTotalRects != 0) {
-      m_log->debug(_T("Sending FramebufferUpdate message header"));
-      m_output->writeUInt8(ServerMsgDefs::FB_UPDATE); // message type
-      m_output->writeUInt8(0); // padding
-      m_output->writeUInt16((UINT16)numTotalRects);
+    if (!streamRects) {
+      // Calculate the total number of rectangles and pseudo-rectangles.
+      size_t numTotalRects =
+        normalRects.size() + backgroundRects.size() + losslessRects.size() +
+        videoRects.size() + copyRects.size() +
+        cacheHitRects.size() + cacheStoreRects.size();
 
       if (updCont.cursorPosChanged) {
-        sendCursorPosUpdate();
+        numTotalRects++;
+        m_log->debug(_T("Adding a pseudo-rectangle for cursor position update"));
       }
       if (updCont.cursorShapeChanged) {
-        m_log->debug(_T("Sending cursor shape update"));
-        sendCursorShapeUpdate(&clientPixelFormat,
-                              &cursorShape);
+        numTotalRects++;
+        m_log->debug(_T("Adding a pseudo-rectangle for cursor shape update"));
+      }
+      // The probe goes only with the updates having something else.
+      if (numTotalRects != 0 && encodeOptions.latencyProbeEnabled()) {
+        numTotalRects++;
       }
-      if (copyRects.size() > 0) {
-        m_log->debug(_T("Sending CopyRect rectangles"));
-        sendCopyRect(&copyRects, &updCont.copySrc);
+      m_log->detail(_T("Total number of rectangles and pseudo-rectangles: %d"),
+                 numTotalRects);
+
+      // Only the clients without LastRect are limited by the count field.
+      _ASSERT(numTotalRects <= 65534);
+
+      if (numTotalRects != 0) {
+        m_log->debug(_T("Sending FramebufferUpdate message header"));
+        sendFbUpdateHeader((UINT16)numTotalRects);
+        sendLeadingRectangles(&updCont, &clientPixelFormat, &cursorShape,
+                              tileCache, &cacheHitRects, frameBuffer,
+                              &encodeOptions);
+        headerSent = true;
       }
+    }
 
+    if (headerSent) {
       m_log->debug(_T("Time between request and a point before send and coding (in milliseconds): %u"),
                  (unsigned int)(DateTime::now() - reqTimePoint).getTime());
       m_log->debug(_T("Sending video rectangles"));
-      sendRectangles(m_enbox.getJpegEncoder(), &videoRects, frameBuffer, &encodeOptions);
+      sendRectangles(videoEncoder, &videoRects, frameBuffer, &videoEncodeOptions);
+      if (streamRects && !videoRects.empty()) {
+        m_output->flush();
+      }
       m_log->debug(_T("Sending normal rectangles"));
-      double area = Rect::totalArea(normalRects) / 1000000.; //in millions of pixels
-      ProcessorTimes pt1 = m_log->checkPoint(_T("Before Sending normal rectangles"));
-
-      sendRectangles(m_enbox.getEncoder(), &normalRects, frameBuffer, &encodeOptions);
+      sendRectangles(normalEncoder, &normalRects, frameBuffer, &encodeOptions);
+      if (streamRects && !normalRects.empty()) {
+        m_output->flush();
+      }
+      sendRectangles(normalEncoder, &backgroundRects, frameBuffer,
+                     &backgroundEncodeOptions);
+      if (streamRects && !backgroundRects.empty()) {
+        m_output->flush();
+      }
 
       sendRectangles(m_enbox.getEncoder(), &losslessRects, frameBuffer, &losslessEncodeOptions);
 
-      ProcessorTimes pt2 = m_log->checkPoint(_T("After Sending normal rectangles"));
-      m_log->debug(_T("Before Sending normal rectangles %f processor Mcycles, %f process time, %f kernel time, %f wall clock time"), 
-        pt1.cycle / 1000000., pt1.process, pt1.kernel, (double)(pt1.wall.getTime()));
-      double dt = (double)(pt2.wall.getTime());
-      m_log->debug(_T("After Sending normal rectangles Mpoint encoded and send: %f for %f processor Mcycles"), 
-        area, pt2.cycle/1000000.);
-      m_log->debug(_T("After Sending normal rectangles %f process time, %f kernel time, %f wall clock time"), pt2.process, pt2.kernel, dt);
+      // The client stores the tiles it has just received.
+      if (tileCache != 0) {
+        sendRectangles(tileCache, &cacheStoreRects, frameBuffer, &encodeOptions);
+      }
+      if (encodeOptions.latencyProbeEnabled()) {
+        sendLatencyProbe(&updCont, &frameStart);
+      }
+      if (streamRects) {
+        sendRectHeader(0, 0, 0, 0, PseudoEncDefs::LAST_RECT);
+      }
+
+      if (m_log->isDebug() &&
+          m_enbox.getEncoder()->getCode() == EncodingDefs::TIGHT) {
+        TightEncoder *tight = (TightEncoder *)m_enbox.getEncoder();
+        m_log->debug(_T("Tight tiles classified (total): %u text, %u photo, %u static"),
+          tight->getTileCount(TileClassifier::TILE_TEXT),
+          tight->getTileCount(TileClassifier::TILE_PHOTO),
+          tight->getTileCount(TileClassifier::TILE_STATIC));
+        m_log->debug(_T("Tight rectangles sent (total): %u solid, %u mono, %u indexed, %u full color, %u gradient, %u jpeg"),
+          tight->getPathCount(TightEncoder::PATH_SOLID),
+          tight->getPathCount(TightEncoder::PATH_MONO),
+          tight->getPathCount(TightEncoder::PATH_INDEXED),
+          tight->getPathCount(TightEncoder::PATH_FULL_COLOR),
+          tight->getPathCount(TightEncoder::PATH_GRADIENT),
+          tight->getPathCount(TightEncoder::PATH_JPEG));
+        m_log->debug(_T("Tight palettes (total): %u cached, %u built"),
+          tight->getPaletteHitCount(),
+          tight->getPaletteMissCount());
+        m_log->debug(_T("Tight zlib level/strategy: %d/%d raw, %d/%d mono,")
+                     _T(" %d/%d indexed, %d/%d gradient, %u switches"),
+          tight->getStreamLevel(TightEncoder::ZLIB_STREAM_RAW),
+          tight->getStreamStrategy(TightEncoder::ZLIB_STREAM_RAW),
+          tight->getStreamLevel(TightEncoder::ZLIB_STREAM_MONO),
+          tight->getStreamStrategy(TightEncoder::ZLIB_STREAM_MONO),
+          tight->getStreamLevel(TightEncoder::ZLIB_STREAM_IDX),
+          tight->getStreamStrategy(TightEncoder::ZLIB_STREAM_IDX),
+          tight->getStreamLevel(TightEncoder::ZLIB_STREAM_GRADIENT),
+          tight->getStreamStrategy(TightEncoder::ZLIB_STREAM_GRADIENT),
+          tight->getStreamSwitchCount());
+      }
 
       m_log->info(_T("Time between request and answer is (in milliseconds): %u"),
                  (unsigned int)(DateTime::now() - reqTimePoint).getTime());
+
+      // The trial encoding goes after the update has been sent, it does
+      // not delay it.
+      if (!preview && m_encoderSelector != 0 && m_encoderSelector->isTrialDue() &&
+          m_encoderSelector->trial(&changedRegion, frameBuffer, &encodeOptions,
+                                   m_congestion.getThroughput())) {
+        m_log->info(_T("Encoding %d has been chosen for client #%d"),
+                    m_encoderSelector->getEncoding(&encodeOptions), m_id);
+      }
     } else {
       m_log->debug(_T("Nothing to send, restoring requested regions"));
       AutoLock al(&m_reqRectLocMut);
       m_requestedFullReg.add(&requestedFullReg);
-      m_requestedIncrReg.add(&requestedIncrReg);
-      m_incrUpdIsReq = incrUpdIsReq;
+      m_requestedIncrReg.add(&clientIncrReg);
+      m_incrUpdIsReq = clientIncrUpdIsReq;
       m_fullUpdIsReq = fullUpdIsReq;
     }
-    m_cursorUpdates.restoreFrameBuffer(frameBuffer);
-
+    if (!m_frameShared) {
+      m_cursorUpdates.restoreFrameBuffer(frameBuffer);
+    }
   }
 
   m_log->debug(_T("Flushing output"));
-//  m_log->checkPoint(_T("4 before flush"));
-  m_output->flush();
-//  m_log->checkPoint(_T("5 sendUpdate() end"));
+  {
+    FrameTrace::Span flushSpan(FrameTrace::FLUSH, m_traceFrameId);
+    ZoneProfiler::Scope flushZone(ZoneProfiler::FLUSH);
+    StallWatchdog::Activity sendActivity(StallWatchdog::SEND);
+    m_output->flush();
+  }
+  if (m_sessionRecorder != 0) {
+    m_output->stopRecording();
+    recordSession(frameBuffer, &clientDim, &clientPixelFormat,
+                  keyFramePossible);
+  }
+  m_log->debug(_T("Rectangle lists reallocated in this update: %d"),
+               m_scratch.getGrowCount());
+  m_lastUpdateTime = DateTime::now();
+  // The staged rectangles have been sent or have changed by now.
+  if (m_numStaged != 0) {
+    m_stagingCache.clear();
+    m_numStaged = 0;
+  }
+  accountScratch();
+  UINT64 encodedSize = m_recorder.getTotalWritten() - encodedSizeBefore;
+  updateSpan.setBytes(encodedSize);
+  LARGE_INTEGER frameEnd;
+  QueryPerformanceCounter(&frameEnd);
+  UINT64 frameTime = (UINT64)(frameEnd.QuadPart - frameStart.QuadPart) *
+                     1000000 / (UINT64)m_perfFrequency.QuadPart;
+  // The capture time comes from the same counter, possibly of the desktop
+  // server process.
+  bool latencyKnown = encodedSize != 0 && updCont.captureTime != 0 &&
+                      updCont.captureTime <= frameEnd.QuadPart;
+  UINT64 captureLatency = latencyKnown ?
+    (UINT64)(frameEnd.QuadPart - updCont.captureTime) * 1000000 /
+    (UINT64)m_perfFrequency.QuadPart : 0;
+  {
+    AutoLock al(&m_statsLock);
+    m_stats.updatesSent++;
+    m_stats.bytesSent += encodedSize;
+    m_stats.frameTime += frameTime;
+    m_stats.frameTimeSquares += frameTime * frameTime;
+    if (latencyKnown) {
+      m_stats.latencyUpdates++;
+      m_stats.captureLatency += captureLatency;
+      m_stats.captureLatencySquares += captureLatency * captureLatency;
+    }
+  }
+  if (encodedSize != 0) {
+    m_congestion.setRateLimit(m_senderControlInformation->getRateLimit());
+    m_congestion.onUpdateSent((size_t)encodedSize,
+                              m_senderControlInformation->getOutputQueueSize());
+    unsigned int roundTripTime = m_congestion.getRoundTripTime();
+    unsigned int throughput = m_congestion.getThroughput();
+    m_log->debug(_T("Round trip time is %u ms, throughput is %u bytes per second"),
+                 roundTripTime, throughput);
+    if (roundTripTime != 0 && throughput != 0) {
+      m_senderControlInformation->onNetworkEstimate(roundTripTime, throughput);
+    }
+    // Pushed updates are followed by fences to measure the round trip and
+    // to pace the next pushes.
+    if (continuousUpdates && encodeOptions.fenceEnabled()) {
+      std::vector<char> payload;
+      sendFence(FenceDefs::REQUEST | FenceDefs::BLOCK_BEFORE, &payload,
+                (size_t)encodedSize);
+    }
+  }
+}
+
+void UpdateSender::recordSession(const FrameBuffer *frameBuffer,
+                                 const Dimension *clientDim,
+                                 const PixelFormat *clientPf,
+                                 bool keyFramePossible)
+{
+  try {
+    m_sessionRecorder->writeUpdate(clientDim, clientPf, m_output->getRecord());
+    if (keyFramePossible && m_sessionRecorder->isKeyFrameDue() &&
+        frameBuffer->getDimension().isEqualTo(clientDim)) {
+      if (m_enbox.restartStreams()) {
+        // The cursor shapes cached before the keyframe are unknown to
+        // a player seeking to it.
+        m_clientCursorCache.reset();
+        Rect fbRect = frameBuffer->getDimension().getRect();
+        const FrameBuffer *clientFb = m_pixelConverter.convert(&fbRect,
+                                                               frameBuffer);
+        m_sessionRecorder->writeKeyFrame(clientFb);
+      } else {
+        m_log->debug(_T("The encoders cannot restart, keyframe skipped"));
+        m_sessionRecorder->skipKeyFrame();
+      }
+    }
+  } catch (Exception &e) {
+    m_log->error(_T("Cannot record the session, recording stopped: %s"),
+                 e.getMessage());
+    delete m_sessionRecorder;
+    m_sessionRecorder = 0;
+  }
 }
 
 void UpdateSender::paintBlack(FrameBuffer *frameBuffer, const Region *blackRegion)
@@ -652,14 +1487,172 @@ void UpdateSender::paintBlack(FrameBuffer *frameBuffer, const Region *blackRegio
   }
 }
 
+void UpdateSender::preEncode()
+{
+  if (m_congestion.getRoundTripTime() < PRE_ENCODE_MIN_RTT ||
+      getScale() != 1) {
+    return;
+  }
+  // A changing view port is resent as a whole.
+  Rect viewPort = getViewPort();
+  Rect newViewPort;
+  bool shareApp;
+  Region shareAppRegion;
+  m_senderControlInformation->onGetViewPort(&newViewPort, &shareApp,
+                                            &shareAppRegion);
+  if (shareApp || !newViewPort.isEqualTo(&viewPort)) {
+    return;
+  }
+  UpdateContainer updCont;
+  takeDirtyTiles();
+  m_updateKeeper->getUpdateContainer(&updCont);
+  // The video goes as it is at the moment of sending, the moves change
+  // the pixels of the client.
+  Region changedRegion = updCont.changedRegion;
+  changedRegion.subtract(&updCont.videoRegion);
+  Region copiedRegion = updCont.getCopiedRegion();
+  changedRegion.subtract(&copiedRegion);
+  if (updCont.screenSizeChanged || changedRegion.isEmpty()) {
+    return;
+  }
+
+  EncodeOptions encodeOptions;
+  selectEncoder(&encodeOptions);
+  m_congestion.adjustEncodeOptions(&encodeOptions, false);
+  Encoder *encoder = m_enbox.getEncoder();
+  if (encoder->getCode() == EncodingDefs::H264) {
+    return;
+  }
+
+  if (!m_desktop->updateExternalFrameBuffer(&m_stagingFrame, &changedRegion,
+                                            &viewPort)) {
+    // The frame has been resized to the view port, its pixels are taken
+    // with the next changes.
+    return;
+  }
+  Rect frameRect = m_stagingFrame.getDimension().getRect();
+  changedRegion.crop(&frameRect);
+
+  PixelFormat clientPf;
+  {
+    AutoLock al(&m_newPixelFormatLocker);
+    clientPf = m_newPixelFormat;
+  }
+  // The same split and the same levels as the next update will choose for
+  // the same region, the rectangles out of the region of interest with
+  // their lower quality.
+  encodeOptions.setRoi(m_interactiveFirst, ROI_QUALITY_DROP);
+  std::vector<Rect> rects;
+  splitRegion(encoder, &changedRegion, &rects, &m_stagingFrame, &encodeOptions);
+  std::vector<Rect> backgroundRects;
+  EncodeOptions backgroundEncodeOptions = encodeOptions;
+  if (encodeOptions.roiEnabled()) {
+    Region interestRegion;
+    getInteractiveRegion(&viewPort, &interestRegion);
+    separateBackground(&rects, &interestRegion, &backgroundRects);
+    if (encodeOptions.jpegEnabled()) {
+      int quality = encodeOptions.getJpegQualityLevel() -
+                    encodeOptions.getRoiQualityDrop();
+      backgroundEncodeOptions.setJpegQualityLevel(max(quality, 0));
+    }
+  }
+
+  m_stagingCache.nextGeneration();
+  try {
+    stageRectangles(encoder, &rects, &encodeOptions, &clientPf);
+    stageRectangles(encoder, &backgroundRects, &backgroundEncodeOptions,
+                    &clientPf);
+  } catch (Exception &e) {
+    // The update encodes everything itself then.
+    m_log->error(_T("Cannot encode the changes ahead for client #%d: %s"),
+                 m_id, e.getMessage());
+    m_stagingCache.clear();
+    m_numStaged = 0;
+  }
+  accountScratch();
+}
+
+void UpdateSender::stageRectangles(Encoder *encoder,
+                                   const std::vector<Rect> *rects,
+                                   const EncodeOptions *encodeOptions,
+                                   const PixelFormat *clientPf)
+{
+  // The rectangles staged before with the same pixels are not encoded
+  // again.
+  std::vector<Rect> newRects;
+  std::vector<EncodedRectCache::Key> keys;
+  std::vector<Rect>::const_iterator i;
+  for (i = rects->begin(); i != rects->end(); i++) {
+    EncodedRectCache::Key key = getRectKey(encoder, &*i, &m_stagingFrame,
+                                           encodeOptions, clientPf);
+    if (!m_stagingCache.lookup(&key, 0)) {
+      newRects.push_back(*i);
+      keys.push_back(key);
+    }
+  }
+  if (newRects.empty()) {
+    return;
+  }
+
+  EncodingWorkerPool *pool = m_encodingPool;
+  if (pool == 0) {
+    if (m_stagingPool == 0) {
+      m_stagingPool = new EncodingWorkerPool(1);
+    }
+    pool = m_stagingPool;
+  }
+  std::vector<std::vector<char> > encoded;
+  pool->encode(encoder->getCode(), false, &newRects, &m_stagingFrame,
+               encodeOptions, clientPf, &encoded);
+  for (size_t j = 0; j < newRects.size(); j++) {
+    if (!encoded[j].empty()) {
+      m_stagingCache.store(&keys[j], &encoded[j].front(), encoded[j].size());
+    }
+  }
+  m_numStaged += newRects.size();
+  m_log->debug(_T("Encoded %d rectangles ahead for client #%d"),
+               (int)newRects.size(), m_id);
+  AutoLock al(&m_statsLock);
+  m_stats.rectsPreEncoded += newRects.size();
+}
+
+EncodedRectCache::Key UpdateSender::getRectKey(const Encoder *encoder,
+                                               const Rect *rect,
+                                               const FrameBuffer *frameBuffer,
+                                               const EncodeOptions *encodeOptions,
+                                               const PixelFormat *clientPf)
+{
+  // Encoding levels affect only Tight output. JpegEncoder works via the same
+  // TightEncoder but forces JPEG, so its output is distinguished as lossy.
+  int code = encoder->getCode();
+  bool isTight = code == EncodingDefs::TIGHT;
+  bool lossy = isTight && encoder == m_enbox.getJpegEncoder() &&
+               encodeOptions->jpegEnabled();
+  int comprLevel = isTight ? encodeOptions->getCompressionLevel() : -1;
+  int jpegLevel = isTight ? encodeOptions->getJpegQualityLevel() : -1;
+  int subsampling = isTight ? encodeOptions->getJpegSubsampling() : -1;
+  return EncodedRectCache::Key(rect, frameBuffer, clientPf, code, lossy,
+                               comprLevel, jpegLevel, subsampling);
+}
+
 void UpdateSender::splitRegion(Encoder *encoder,
                                const Region *region,
                                std::vector<Rect> *rects,
                                const FrameBuffer *frameBuffer,
                                const EncodeOptions *encodeOptions)
 {
-  std::vector<Rect> baseRects;
+  ZoneProfiler::Scope splitZone(ZoneProfiler::SPLIT);
+  std::vector<Rect> &baseRects = m_scratch.baseRects;
   region->getRectVector(&baseRects);
+  UINT64 rectsMerged = 0;
+  UINT64 pixelsAdded = 0;
+  RectMerger::merge(&baseRects, encoder->getRectOverhead(encodeOptions),
+                    &rectsMerged, &pixelsAdded);
+  if (rectsMerged != 0) {
+    AutoLock al(&m_statsLock);
+    m_stats.rectsMerged += rectsMerged;
+    m_stats.mergedPixels += pixelsAdded;
+  }
   std::vector<Rect>::iterator i;
   for (i = baseRects.begin(); i != baseRects.end(); i++) {
     encoder->splitRectangle(&*i, rects, frameBuffer, encodeOptions);
@@ -671,45 +1664,395 @@ void UpdateSender::sendRectangles(Encoder *encoder,
                                   const FrameBuffer *frameBuffer,
                                   const EncodeOptions *encodeOptions)
 {
-  std::vector<Rect>::const_iterator i;
-  for (i = rects->begin(); i != rects->end(); i++) {
-    sendRectHeader(&*i, encoder->getCode());
-    encoder->sendRectangle(&*i, frameBuffer, encodeOptions);
+  // Note that the encoder may be not allocated if there is nothing to send.
+  if (rects->empty()) {
+    return;
+  }
+  FrameTrace::Span encodeSpan(FrameTrace::ENCODE, m_traceFrameId);
+  ZoneProfiler::Scope encodeZone(getEncodeZone(encoder->getCode()));
+  StallWatchdog::Activity encodeActivity(StallWatchdog::ENCODE);
+  UINT64 sizeBefore = m_recorder.getTotalWritten();
+  LARGE_INTEGER encodeStart;
+  QueryPerformanceCounter(&encodeStart);
+
+  // Data shared with other clients, encoded ahead or produced by other
+  // threads must not depend on what has been sent to this client before,
+  // so switch the encoder to the stateless mode while the caches or the
+  // encoding threads are in use.
+  bool useCache = (m_rectCache != 0 && m_rectCache->isEnabled()) ||
+                  m_numStaged != 0;
+  bool useThreads = !useCache && m_encodingPool != 0 && rects->size() > 1;
+  encoder->setStateless(useCache || useThreads);
+  if (!encoder->isStateless()) {
+    useCache = useThreads = false;
   }
-}
-
-void UpdateSender::execute()
-{
-  m_log->info(_T("Starting update sender thread for client #%d"), m_id);
 
-  while(!isTerminating()) {
-    m_newUpdatesEvent.waitForEvent();
-    {
-      AutoLock al(&m_reqRectLocMut);
-      m_busy = true;
-    }
-    m_log->debug(_T("Update sender thread of client #%d is awake"), m_id);
-    if (!isTerminating()) {
-      try {
-        m_log->debug(_T("UpdateSender::Trying to call the sendUpdate() function"));
-        sendUpdate();
-        m_log->debug(_T("The sendUpdate() function has finished"));
-        {
-          AutoLock al(&m_reqRectLocMut);
-          m_busy = false;
+  if (useThreads) {
+    sendRectanglesInParallel(encoder, rects, frameBuffer, encodeOptions);
+  } else {
+    size_t numCached = 0;
+    std::vector<Rect>::const_iterator i;
+    for (i = rects->begin(); i != rects->end(); i++) {
+      sendRectHeader(&*i, encoder->getCode());
+      if (useCache) {
+        if (sendCachedRectangle(encoder, &*i, frameBuffer, encodeOptions)) {
+          numCached++;
         }
-      } catch(Exception &e) {
-        m_log->interror(_T("The update sender thread caught an error and will")
-                   _T(" be terminated: %s"), e.getMessage());
-        Thread::terminate();
+      } else {
+        encoder->sendRectangle(&*i, frameBuffer, encodeOptions);
       }
     }
+    if (useCache) {
+      m_log->debug(_T("Rectangles taken from the caches: %d of %d"),
+                   (int)numCached, (int)rects->size());
+    }
+  }
+
+  UINT64 encodedSize = m_recorder.getTotalWritten() - sizeBefore;
+  encodeSpan.setBytes(encodedSize);
+  LARGE_INTEGER encodeEnd;
+  QueryPerformanceCounter(&encodeEnd);
+  UINT64 encodeTime = (UINT64)(encodeEnd.QuadPart - encodeStart.QuadPart) *
+                      1000000 / (UINT64)m_perfFrequency.QuadPart;
+  {
+    AutoLock al(&m_statsLock);
+    m_stats.encodeTime += encodeTime;
+    m_stats.rectsSent += rects->size();
+    m_stats.addEncodingBytes(encoder->getCode(), encodedSize);
   }
 }
 
-void UpdateSender::readUpdateRequest(RfbInputGate *io)
+void UpdateSender::sendRectanglesInParallel(Encoder *encoder,
+                                            const std::vector<Rect> *rects,
+                                            const FrameBuffer *frameBuffer,
+                                            const EncodeOptions *encodeOptions)
 {
-  // Read the rest of the message:
+  bool video = encoder == m_enbox.getJpegEncoder();
+  PixelFormat clientPf = m_pixelConverter.getDstPixelFormat();
+  std::vector<std::vector<char> > encoded;
+
+  m_encodingPool->encode(encoder->getCode(), video, rects, frameBuffer,
+                         encodeOptions, &clientPf, &encoded);
+  m_log->debug(_T("Parallel encoding of %d rectangles by %d threads"),
+               (int)rects->size(), (int)m_encodingPool->getNumThreads());
+
+  for (size_t i = 0; i < rects->size(); i++) {
+    sendRectHeader(&rects->at(i), encoder->getCode());
+    if (!encoded[i].empty()) {
+      m_encoderOutput.writeFully(&encoded[i].front(), encoded[i].size());
+    }
+  }
+}
+
+bool UpdateSender::sendCachedRectangle(Encoder *encoder,
+                                       const Rect *rect,
+                                       const FrameBuffer *frameBuffer,
+                                       const EncodeOptions *encodeOptions)
+{
+  PixelFormat clientPf = m_pixelConverter.getDstPixelFormat();
+  EncodedRectCache::Key key = getRectKey(encoder, rect, frameBuffer,
+                                         encodeOptions, &clientPf);
+
+  std::vector<char> data;
+  if (m_numStaged != 0 && m_stagingCache.lookup(&key, &data)) {
+    m_encoderOutput.writeFully(&data.front(), data.size());
+    AutoLock al(&m_statsLock);
+    m_stats.preEncodedRectsSent++;
+    return true;
+  }
+  if (m_rectCache == 0 || !m_rectCache->isEnabled()) {
+    encoder->sendRectangle(rect, frameBuffer, encodeOptions);
+    return false;
+  }
+  if (m_rectCache->lookup(&key, &data)) {
+    m_encoderOutput.writeFully(&data.front(), data.size());
+    return true;
+  }
+
+  m_recorder.startRecording();
+  try {
+    encoder->sendRectangle(rect, frameBuffer, encodeOptions);
+  } catch (...) {
+    m_recorder.stopRecording();
+    throw;
+  }
+  m_recorder.stopRecording();
+
+  const std::vector<char> *record = m_recorder.getRecord();
+  if (!record->empty()) {
+    m_rectCache->store(&key, &record->front(), record->size());
+  }
+  return false;
+}
+
+void UpdateSender::execute()
+{
+  m_log->info(_T("Starting update sender thread for client #%d"), m_id);
+
+  while(!isTerminating()) {
+    // Wake up by time if there are lossy pixels to refine, no new updates
+    // may come. The scratch buffers are checked for being idle by time too.
+    unsigned int waitTime = m_refiner.getTimeToRefinement();
+    if (waitTime != LosslessRefiner::INFINITE_TIME) {
+      waitTime = max(waitTime, REFINE_CHECK_INTERVAL);
+    }
+    if (m_scratchSize != 0) {
+      waitTime = min(waitTime, SCRATCH_IDLE_TIME);
+    }
+    if (waitTime == LosslessRefiner::INFINITE_TIME) {
+      m_newUpdatesEvent.waitForEvent();
+    } else {
+      m_newUpdatesEvent.waitForEvent(waitTime);
+    }
+    releaseIdleScratch();
+    // Let the changes related to the first one join it, the ones coming
+    // meanwhile are counted as coalesced.
+    waitForRelatedChanges();
+    m_coalescer.onUpdateTaken();
+    {
+      AutoLock al(&m_statsLock);
+      m_updatesPending = false;
+    }
+    {
+      AutoLock al(&m_reqRectLocMut);
+      m_busy = true;
+    }
+    m_log->debug(_T("Update sender thread of client #%d is awake"), m_id);
+    if (isPushWindowFull() && !isTerminating()) {
+      // The answer to a fence wakes the thread up again.
+      m_log->debug(_T("Client #%d has not processed the pushed updates yet"), m_id);
+      AutoLock al(&m_reqRectLocMut);
+      m_busy = false;
+      continue;
+    }
+    // Let updates accumulate while the network path is congested.
+    unsigned int sendDelay = m_congestion.getSendDelay();
+    if (sendDelay != 0 && !isTerminating()) {
+      m_log->debug(_T("Delaying update for client #%d by %u ms"), m_id, sendDelay);
+      sleep(sendDelay);
+    }
+    if (!isTerminating()) {
+      try {
+        // Encode nothing while the output is full. The changes keep
+        // merging in the update keeper meanwhile, and the update is made of
+        // the pixels captured once the output has drained rather than of
+        // the ones stale by the time a blocked write would take them.
+        m_outputWasBlocked = waitForOutputSpace();
+        sendEndOfContinuousUpdates();
+        m_log->debug(_T("UpdateSender::Trying to call the sendUpdate() function"));
+        sendUpdate();
+        m_log->debug(_T("The sendUpdate() function has finished"));
+        {
+          AutoLock al(&m_reqRectLocMut);
+          m_busy = false;
+        }
+      } catch(Exception &e) {
+        m_log->interror(_T("The update sender thread caught an error and will")
+                   _T(" be terminated: %s"), e.getMessage());
+        Thread::terminate();
+      }
+    }
+  }
+}
+
+void UpdateSender::waitForRelatedChanges()
+{
+  {
+    AutoLock al(&m_reqRectLocMut);
+    if (!m_incrUpdIsReq && !m_fullUpdIsReq && !m_continuousUpdates) {
+      return;
+    }
+  }
+  // The updates accumulate anyway while they are delayed for congestion.
+  if (m_congestion.getSendDelay() != 0) {
+    return;
+  }
+  unsigned int rtt = m_congestion.getRoundTripTime();
+  unsigned int waitTime;
+  while (!isTerminating() && (waitTime = m_coalescer.getWaitTime(rtt)) != 0) {
+    m_newUpdatesEvent.waitForEvent(waitTime);
+  }
+}
+
+size_t UpdateSender::getScratchSize() const
+{
+  size_t size = m_enbox.getScratchSize() + m_pixelConverter.getBufferSize() +
+                m_scratch.getSize();
+  if (m_encodingPool != 0) {
+    size += m_encodingPool->getScratchSize();
+  }
+  if (m_stagingPool != 0) {
+    size += m_stagingPool->getScratchSize();
+  }
+  if (m_encoderSelector != 0) {
+    size += m_encoderSelector->getScratchSize();
+  }
+  size += m_stagingFrame.getBufferSize();
+  size += m_mcuFilter.getMemorySize();
+  return size;
+}
+
+void UpdateSender::accountScratch()
+{
+  size_t scratchSize = getScratchSize();
+  MemAccount::resized(MEM_ENCODER_SCRATCH, m_scratchSize, scratchSize);
+  if (m_frameStore != 0) {
+    m_frameStore->onScratchSizeChanged(m_scratchSize, scratchSize);
+  }
+  m_scratchSize = scratchSize;
+}
+
+void UpdateSender::releaseIdleScratch()
+{
+  if (m_frameStore == 0 || m_scratchSize == 0 ||
+      (DateTime::now() - m_lastUpdateTime).getTime() < SCRATCH_IDLE_TIME ||
+      !m_frameStore->isOverBudget()) {
+    return;
+  }
+  m_log->debug(_T("Memory budget is exceeded, freeing %u bytes of idle")
+               _T(" scratch buffers of client #%d"),
+               (unsigned int)m_scratchSize, m_id);
+  m_enbox.releaseScratch();
+  m_pixelConverter.releaseBuffer();
+  m_scratch.release();
+  if (m_encodingPool != 0) {
+    m_encodingPool->releaseScratch();
+  }
+  if (m_stagingPool != 0) {
+    m_stagingPool->releaseScratch();
+  }
+  if (m_encoderSelector != 0) {
+    m_encoderSelector->releaseScratch();
+  }
+  m_stagingFrame.setDimension(&Dimension());
+  m_stagingCache.clear();
+  m_numStaged = 0;
+  m_mcuFilter.reset();
+  accountScratch();
+}
+
+bool UpdateSender::waitForOutputSpace()
+{
+  bool blocked = false;
+  while (!isTerminating() &&
+         !m_senderControlInformation->waitForOutputSpace(OUTPUT_CHECK_INTERVAL)) {
+    if (!blocked) {
+      m_log->debug(_T("Output of client #%d is full, encoding is suspended"), m_id);
+      blocked = true;
+    }
+  }
+  return blocked;
+}
+
+void UpdateSender::getInteractiveRegion(const Rect *viewPort, Region *region)
+{
+  DateTime now = DateTime::now();
+  if ((now - m_foregroundTime).getTime() >= FOREGROUND_REFRESH_INTERVAL) {
+    m_desktop->getForegroundWindowCoords(&m_foregroundRect);
+    m_foregroundTime = now;
+  }
+
+  // The pointer position is in the view port coordinates already.
+  Point pointer = m_cursorUpdates.getCurPos();
+  Rect pointerRect(pointer.x - POINTER_AREA_RADIUS,
+                   pointer.y - POINTER_AREA_RADIUS,
+                   pointer.x + POINTER_AREA_RADIUS,
+                   pointer.y + POINTER_AREA_RADIUS);
+  Rect foregroundRect = m_foregroundRect;
+  foregroundRect.move(-viewPort->left, -viewPort->top);
+
+  region->clear();
+  region->addRect(&pointerRect);
+  if (!foregroundRect.isEmpty()) {
+    region->addRect(&foregroundRect);
+  }
+}
+
+void UpdateSender::takePreviewSlice(int maxArea, int scale, Region *slice)
+{
+  // The pointer position is in the view port coordinates, not scaled.
+  Point pointer = m_cursorUpdates.getCurPos();
+  pointer.x /= scale;
+  pointer.y /= scale;
+  Rect bounds = m_previewRegion.getBounds();
+  // The square around the pointer grows until it has enough of the region.
+  std::vector<Rect> sliceRects;
+  for (int radius = POINTER_AREA_RADIUS; ; radius *= 2) {
+    Rect square(pointer.x - radius, pointer.y - radius,
+                pointer.x + radius, pointer.y + radius);
+    *slice = m_previewRegion;
+    slice->crop(&square);
+    slice->getRectVector(&sliceRects);
+    if (calcAreas(sliceRects) >= maxArea ||
+        square.intersection(&bounds).isEqualTo(&bounds)) {
+      break;
+    }
+  }
+}
+
+void UpdateSender::takeInteractiveRegion(Region *changedRegion,
+                                         Region *deferredRegion,
+                                         const Rect *viewPort)
+{
+  Region interactiveRegion;
+  getInteractiveRegion(viewPort, &interactiveRegion);
+  interactiveRegion.intersect(changedRegion);
+  if (interactiveRegion.isEmpty()) {
+    return;
+  }
+  Region rest = *changedRegion;
+  rest.subtract(&interactiveRegion);
+  deferredRegion->add(&rest);
+  *changedRegion = interactiveRegion;
+}
+
+void UpdateSender::separateBackground(std::vector<Rect> *rects,
+                                      const Region *interestRegion,
+                                      std::vector<Rect> *backgroundRects)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < rects->size(); i++) {
+    Rect &rect = (*rects)[i];
+    Region rectRegion(&rect);
+    rectRegion.intersect(interestRegion);
+    if (rectRegion.isEmpty()) {
+      backgroundRects->push_back(rect);
+    } else {
+      (*rects)[kept++] = rect;
+    }
+  }
+  rects->resize(kept);
+}
+
+void UpdateSender::splitIntoBands(std::vector<Rect> *rects, size_t numBands)
+{
+  size_t count = rects->size();
+  for (size_t i = 0; i < count; i++) {
+    Rect rect = (*rects)[i];
+    int height = rect.getHeight();
+    size_t maxBands = min((size_t)(rect.area() / MIN_BAND_AREA),
+                          (size_t)(height / BAND_ALIGNMENT));
+    size_t bands = min(numBands, maxBands);
+    if (bands < 2) {
+      continue;
+    }
+    int bandHeight = (height + (int)bands - 1) / (int)bands;
+    bandHeight = (bandHeight + BAND_ALIGNMENT - 1) / BAND_ALIGNMENT *
+                 BAND_ALIGNMENT;
+    Rect band = rect;
+    band.bottom = rect.top + bandHeight;
+    (*rects)[i] = band;
+    for (int top = band.bottom; top < rect.bottom; top += bandHeight) {
+      band.top = top;
+      band.bottom = min(top + bandHeight, rect.bottom);
+      rects->push_back(band);
+    }
+  }
+}
+
+void UpdateSender::readUpdateRequest(RfbInputGate *io)
+{
+  // Read the rest of the message:
   bool incremental = io->readUInt8() != 0;
   Rect reqRect;
   reqRect.left = io->readUInt16();
@@ -717,6 +2060,8 @@ void UpdateSender::readUpdateRequest(RfbInputGate *io)
   reqRect.setWidth(io->readUInt16());
   reqRect.setHeight(io->readUInt16());
 
+  m_congestion.onUpdateRequested();
+
   Region combinedReqRegions;
   {
     AutoLock al(&m_reqRectLocMut);
@@ -740,6 +2085,7 @@ void UpdateSender::readUpdateRequest(RfbInputGate *io)
 
   _ASSERT(m_updReqListener != 0);
 
+  takeDirtyTiles();
   bool alreadyHasUpdates = m_updateKeeper->checkForUpdates(&combinedReqRegions);
   if (alreadyHasUpdates) {
     // We should initiaite send update to avoid it skipping on no updates from a desktop
@@ -815,8 +2161,62 @@ void UpdateSender::readSetEncodings(RfbInputGate *io)
     list.push_back(code);
   }
 
-  AutoLock lock(&m_newEncodeOptionsLocker);
-  m_newEncodeOptions.setEncodings(&list);
+  bool continuousUpdatesEnabled, fenceEnabled;
+  bool transportZlibWanted;
+  int transportZlibLevel;
+  {
+    AutoLock lock(&m_newEncodeOptionsLocker);
+    m_newEncodeOptions.setEncodings(&list);
+    if (!m_newEncodeOptions.cursorCacheEnabled()) {
+      m_cursorCacheLost = true;
+    }
+    continuousUpdatesEnabled = m_newEncodeOptions.continuousUpdatesEnabled();
+    fenceEnabled = m_newEncodeOptions.fenceEnabled();
+    // The transport compression is for the encodings which do not compress
+    // by themselves, compressing Tight or ZRLE data again is a waste of CPU.
+    int preferred = m_newEncodeOptions.getPreferredEncoding();
+    transportZlibWanted = m_newEncodeOptions.transportZlibEnabled() &&
+                          (preferred == EncodingDefs::RAW ||
+                           preferred == EncodingDefs::RRE ||
+                           preferred == EncodingDefs::CORRE ||
+                           preferred == EncodingDefs::HEXTILE);
+    transportZlibLevel = m_newEncodeOptions.getCompressionLevel(
+      TransportZlibDefs::DEFAULT_LEVEL);
+  }
+
+  // The extensions are announced to the client once, by the messages of
+  // the extensions themselves.
+  if (continuousUpdatesEnabled) {
+    AutoLock al(&m_reqRectLocMut);
+    if (!m_continuousAnnounced) {
+      m_continuousAnnounced = true;
+      m_continuousEndPending = true;
+      m_newUpdatesEvent.notify();
+    }
+  }
+  if (fenceEnabled) {
+    bool announce;
+    {
+      AutoLock al(&m_reqRectLocMut);
+      announce = !m_fenceAnnounced;
+      m_fenceAnnounced = true;
+    }
+    if (announce) {
+      std::vector<char> payload;
+      sendFence(FenceDefs::REQUEST, &payload, 0);
+    }
+  }
+  if (transportZlibWanted) {
+    bool start;
+    {
+      AutoLock al(&m_reqRectLocMut);
+      start = !m_transportZlibStarted;
+      m_transportZlibStarted = true;
+    }
+    if (start) {
+      startTransportZlib(max(transportZlibLevel, 1));
+    }
+  }
 }
 
 void UpdateSender::setVideoFrozen(bool value)
@@ -836,6 +2236,405 @@ void UpdateSender::readVideoFreeze(RfbInputGate *io)
   setVideoFrozen(io->readUInt8() != 0);
 }
 
+void UpdateSender::readEnableContinuousUpdates(RfbInputGate *io)
+{
+  bool enable = io->readUInt8() != 0;
+  Rect reqRect;
+  reqRect.left = io->readUInt16();
+  reqRect.top = io->readUInt16();
+  reqRect.setWidth(io->readUInt16());
+  reqRect.setHeight(io->readUInt16());
+
+  {
+    AutoLock al(&m_reqRectLocMut);
+    if (!m_continuousAnnounced) {
+      throw Exception(_T("Continuous updates have not been announced"));
+    }
+    m_continuousUpdates = enable;
+    if (enable) {
+      m_continuousRect = reqRect;
+    } else {
+      m_continuousEndPending = true;
+    }
+  }
+
+  m_log->info(_T("continuous updates %s (%d, %d, %dx%d) by client (client #%d)"),
+              enable ? _T("enabled") : _T("disabled"),
+              reqRect.left, reqRect.top,
+              reqRect.getWidth(), reqRect.getHeight(), m_id);
+
+  m_newUpdatesEvent.notify();
+  if (enable) {
+    m_updReqListener->onUpdateRequest(&reqRect, true);
+  }
+}
+
+void UpdateSender::readFence(RfbInputGate *io)
+{
+  // Read padding
+  io->readUInt16();
+  io->readUInt8();
+
+  UINT32 flags = io->readUInt32();
+  UINT8 length = io->readUInt8();
+  if (length > FenceDefs::MAX_PAYLOAD_LENGTH) {
+    throw Exception(_T("Too long fence payload"));
+  }
+  std::vector<char> payload(length);
+  if (length != 0) {
+    io->readFully(&payload.front(), length);
+  }
+
+  if ((flags & FenceDefs::REQUEST) != 0) {
+    // The client messages are processed in order and the answer is sent right
+    // away, which is all BlockBefore and BlockAfter require. SyncNext is not
+    // supported.
+    sendFence(flags & (FenceDefs::BLOCK_BEFORE | FenceDefs::BLOCK_AFTER),
+              &payload, 0);
+    return;
+  }
+
+  PendingFence fence;
+  {
+    AutoLock al(&m_reqRectLocMut);
+    if (m_pendingFences.empty()) {
+      m_log->debug(_T("Unexpected fence answer from client #%d"), m_id);
+      return;
+    }
+    fence = m_pendingFences.front();
+    m_pendingFences.pop_front();
+  }
+  m_congestion.onUpdateAcknowledged(&fence.sendTime, fence.dataSize);
+  m_newUpdatesEvent.notify();
+}
+
+void UpdateSender::readTileHashes(RfbInputGate *io)
+{
+  UINT16 tileSize = io->readUInt16();
+  UINT16 width = io->readUInt16();
+  UINT16 height = io->readUInt16();
+  Dimension dim(width, height);
+  UINT32 numTiles = io->readUInt32();
+  if (tileSize < TileHashesDefs::MIN_TILE_SIZE ||
+      tileSize > TileHashesDefs::MAX_TILE_SIZE ||
+      numTiles > TileHashesDefs::MAX_TILES ||
+      numTiles != TileHasher::getNumTiles(&dim, tileSize)) {
+    throw Exception(_T("Invalid TileHashes message"));
+  }
+  std::vector<UINT64> hashes(numTiles);
+  for (UINT32 i = 0; i < numTiles; i++) {
+    hashes[i] = io->readUInt64();
+  }
+
+  m_log->info(_T("Client #%d has %u tiles of %dx%d pixels to resynchronize"),
+              m_id, (unsigned int)numTiles, (int)tileSize, (int)tileSize);
+
+  {
+    AutoLock al(&m_resyncLock);
+    m_resyncHashes.swap(hashes);
+    m_resyncDim = dim;
+    m_resyncTileSize = tileSize;
+  }
+  // The whole screen is due, except for the tiles having the same hashes.
+  Region resyncRegion(dim.getRect());
+  m_updateKeeper->addChangedRegion(&resyncRegion);
+}
+
+void UpdateSender::readDecodeFeedback(RfbInputGate *io)
+{
+  UINT32 period = io->readUInt32();
+  UINT32 decodeTime = io->readUInt32();
+  UINT32 renderTime = io->readUInt32();
+  UINT32 framesShown = io->readUInt32();
+  UINT32 framesDropped = io->readUInt32();
+  UINT8 numEncodings = io->readUInt8();
+  if (numEncodings > DecodeFeedbackDefs::MAX_ENCODINGS) {
+    throw Exception(_T("Invalid DecodeFeedback message"));
+  }
+  // Decoding time per thousand pixels, in microseconds.
+  UINT64 h264Cost = 0;
+  UINT64 tightCost = 0;
+  for (UINT8 i = 0; i < numEncodings; i++) {
+    INT32 encodingType = io->readInt32();
+    io->readUInt32(); // number of rectangles
+    UINT32 kiloPixels = io->readUInt32();
+    UINT32 encodingTime = io->readUInt32();
+    // Too few pixels say nothing about the cost of an encoding.
+    if (kiloPixels < MIN_FEEDBACK_KILOPIXELS) {
+      continue;
+    }
+    if (encodingType == EncodingDefs::H264) {
+      h264Cost = encodingTime / kiloPixels;
+    } else if (encodingType == EncodingDefs::TIGHT) {
+      tightCost = encodingTime / kiloPixels;
+    }
+  }
+  if (period == 0) {
+    return;
+  }
+
+  // The decoding and the presenting run on their own threads of the client,
+  // the slower one limits the frame rate.
+  UINT64 busyTime = max(decodeTime, renderTime);
+  unsigned int load = (unsigned int)min(busyTime / 10 / period, (UINT64)1000);
+  bool dropped = framesDropped * 10 > framesShown + framesDropped;
+  m_log->debug(_T("Client #%d load is %u%%, %u of %u frames dropped"),
+               m_id, load, (unsigned int)framesDropped,
+               (unsigned int)(framesShown + framesDropped));
+  m_congestion.onClientLoad(load, dropped);
+
+  if (!m_avoidH264 && h264Cost != 0 && tightCost != 0 &&
+      h264Cost > tightCost * 3 / 2 && m_congestion.isClientOverloaded()) {
+    m_log->info(_T("Client #%d decodes H.264 too slowly (%u us against %u us")
+                _T(" per thousand pixels), video goes with Tight"),
+                m_id, (unsigned int)h264Cost, (unsigned int)tightCost);
+    m_avoidH264 = true;
+  }
+}
+
+void UpdateSender::readLatencyReport(RfbInputGate *io)
+{
+  UINT32 seq = io->readUInt32();
+  UINT32 decodeTime = io->readUInt32();
+  UINT32 presentTime = io->readUInt32();
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+
+  AutoLock al(&m_statsLock);
+  std::map<UINT32, PendingProbe>::iterator it = m_pendingProbes.find(seq);
+  if (it == m_pendingProbes.end()) {
+    return;
+  }
+  PendingProbe probe = it->second;
+  // The reports come in order, the probes before this one are lost.
+  m_pendingProbes.erase(m_pendingProbes.begin(), ++it);
+
+  // The clocks of the client are not comparable to ours, the network time
+  // is half of the round trip the client has not spent on presenting.
+  UINT64 roundTrip = (UINT64)(now.QuadPart - probe.sendTime) * 1000000 /
+                     (UINT64)m_perfFrequency.QuadPart;
+  m_networkLatency = roundTrip > presentTime ?
+                     (UINT32)((roundTrip - presentTime) / 2) : 0;
+  if (probe.captureKnown) {
+    m_stageLatency[LatencyProbeDefs::STAGE_CAPTURE].add(probe.captureTime);
+  }
+  m_stageLatency[LatencyProbeDefs::STAGE_ENCODE].add(probe.encodeTime);
+  m_stageLatency[LatencyProbeDefs::STAGE_NETWORK].add(m_networkLatency);
+  m_stageLatency[LatencyProbeDefs::STAGE_DECODE].add(decodeTime);
+  m_stageLatency[LatencyProbeDefs::STAGE_PRESENT].add(presentTime);
+}
+
+void UpdateSender::readEnableMulticast(RfbInputGate *io)
+{
+  {
+    AutoLock al(&m_multicastLock);
+    if (!m_multicastInterested) {
+      m_multicast->addReceiver();
+      m_multicastInterested = true;
+    }
+  }
+  UINT32 address;
+  UINT16 port;
+  m_multicast->getGroup(&address, &port);
+
+  AutoLock l(m_output);
+  m_output->writeUInt32(ServerMsgDefs::MULTICAST_GROUP);
+  m_output->writeUInt32(address);
+  m_output->writeUInt16(port);
+  m_output->flush();
+}
+
+void UpdateSender::readMulticastReception(RfbInputGate *io)
+{
+  bool receiving = io->readUInt8() != 0;
+  if (!receiving) {
+    // The stream goes on, the client may get it again.
+    endMulticastReception();
+    return;
+  }
+
+  Dimension desktopDim;
+  PixelFormat desktopPf;
+  m_desktop->getFrameBufferProperties(&desktopDim, &desktopPf);
+  Rect screenRect = desktopDim.getRect();
+
+  // The view port lock is taken first, as when the view port changes.
+  AutoReadLock vl(&m_viewPortMut);
+  AutoLock al(&m_multicastLock);
+  if (!m_multicastInterested) {
+    m_multicast->addReceiver();
+    m_multicastInterested = true;
+  }
+  if (m_multicastReception) {
+    return;
+  }
+  // The stream has the whole screen without scaling.
+  if (m_scale != 1 || m_shareOnlyApp || !m_viewPort.isEqualTo(&screenRect)) {
+    m_log->info(_T("Client #%d receives the multicast stream, but its view")
+                _T(" is not the whole screen"), m_id);
+    return;
+  }
+  m_log->info(_T("Client #%d gets the changes by the multicast stream"), m_id);
+  m_multicastReception = true;
+}
+
+void UpdateSender::readMulticastRepair(RfbInputGate *io)
+{
+  UINT32 streamId = io->readUInt32();
+  UINT32 firstSeq = io->readUInt32();
+  UINT16 count = io->readUInt16();
+
+  Region lostRegion;
+  if (!m_multicast->getLostRegion(streamId, firstSeq, count, &lostRegion)) {
+    Dimension desktopDim;
+    PixelFormat desktopPf;
+    m_desktop->getFrameBufferProperties(&desktopDim, &desktopPf);
+    Rect screenRect = desktopDim.getRect();
+    lostRegion.addRect(&screenRect);
+  }
+  m_log->debug(_T("Client #%d repairs %u multicast tiles from %u"),
+               m_id, (unsigned int)count, (unsigned int)firstSeq);
+
+  Rect viewPort = getViewPort();
+  lostRegion.translate(-viewPort.left, -viewPort.top);
+  scaleDownRegion(&lostRegion, getScale());
+  m_updateKeeper->addChangedRegion(&lostRegion);
+  m_newUpdatesEvent.notify();
+}
+
+bool UpdateSender::receivesMulticast()
+{
+  AutoLock al(&m_multicastLock);
+  return m_multicastReception;
+}
+
+void UpdateSender::endMulticastReception()
+{
+  {
+    AutoLock al(&m_multicastLock);
+    if (!m_multicastReception) {
+      return;
+    }
+    m_multicastReception = false;
+  }
+  m_log->info(_T("Client #%d gets the changes by its connection"), m_id);
+  // The changes missed since the stream was left are sent by the
+  // connection.
+  Dimension desktopDim;
+  PixelFormat desktopPf;
+  m_desktop->getFrameBufferProperties(&desktopDim, &desktopPf);
+  Region screenRegion(desktopDim.getRect());
+  m_updateKeeper->addChangedRegion(&screenRegion);
+  m_newUpdatesEvent.notify();
+}
+
+void UpdateSender::sendEndOfContinuousUpdates()
+{
+  {
+    AutoLock al(&m_reqRectLocMut);
+    if (!m_continuousEndPending) {
+      return;
+    }
+    m_continuousEndPending = false;
+  }
+  m_log->debug(_T("Sending EndOfContinuousUpdates to client #%d"), m_id);
+  AutoLock l(m_output);
+  m_output->writeUInt8(ServerMsgDefs::END_OF_CONTINUOUS_UPDATES);
+  m_output->flush();
+}
+
+void UpdateSender::sendFence(UINT32 flags, const std::vector<char> *payload,
+                             size_t dataSize)
+{
+  AutoLock l(m_output);
+  m_output->writeUInt8(ServerMsgDefs::SERVER_FENCE);
+  m_output->writeUInt16(0); // padding
+  m_output->writeUInt8(0);
+  m_output->writeUInt32(flags);
+  m_output->writeUInt8((UINT8)payload->size());
+  if (!payload->empty()) {
+    m_output->writeFully(&payload->front(), payload->size());
+  }
+  m_output->flush();
+
+  if ((flags & FenceDefs::REQUEST) != 0) {
+    PendingFence fence;
+    fence.sendTime = DateTime::now();
+    fence.dataSize = dataSize;
+    AutoLock al(&m_reqRectLocMut);
+    m_pendingFences.push_back(fence);
+  }
+}
+
+void UpdateSender::startTransportZlib(int level)
+{
+  AutoLock l(m_output);
+  m_output->writeUInt32(ServerMsgDefs::TRANSPORT_ZLIB);
+  m_output->startCompression(level);
+  m_output->flush();
+  m_log->info(_T("Transport compression started, zlib level %d"), level);
+}
+
+bool UpdateSender::isPushWindowFull()
+{
+  size_t pendingFences;
+  {
+    AutoLock al(&m_reqRectLocMut);
+    if (!m_continuousUpdates) {
+      return false;
+    }
+    pendingFences = m_pendingFences.size();
+  }
+  return pendingFences >= m_congestion.getPushWindow();
+}
+
+void UpdateSender::skipResyncedTiles(const FrameBuffer *frameBuffer,
+                                     Region *changedRegion,
+                                     Region *videoRegion)
+{
+  std::vector<UINT64> hashes;
+  Dimension dim;
+  int tileSize;
+  {
+    AutoLock al(&m_resyncLock);
+    if (m_resyncHashes.empty()) {
+      return;
+    }
+    hashes.swap(m_resyncHashes);
+    dim = m_resyncDim;
+    tileSize = m_resyncTileSize;
+  }
+  if (frameBuffer == 0 || frameBuffer->getDimension() != dim) {
+    m_log->info(_T("Tile hashes of client #%d do not match the screen,")
+                _T(" sending the whole screen"), m_id);
+    return;
+  }
+
+  Region dueRegion = *changedRegion;
+  dueRegion.add(videoRegion);
+  Region sameRegion;
+  size_t numSame = 0;
+  for (size_t i = 0; i < hashes.size(); i++) {
+    Rect tileRect = TileHasher::getTileRect(&dim, tileSize, i);
+    Region tileRegion(tileRect);
+    tileRegion.intersect(&dueRegion);
+    if (tileRegion.isEmpty()) {
+      continue;
+    }
+    // The client hashed the pixels in its own format.
+    const FrameBuffer *clientPixels = m_pixelConverter.convert(&tileRect,
+                                                               frameBuffer);
+    if (TileHasher::hashRect(clientPixels, &tileRect) == hashes[i]) {
+      sameRegion.addRect(&tileRect);
+      numSame++;
+    }
+  }
+  changedRegion->subtract(&sameRegion);
+  videoRegion->subtract(&sameRegion);
+  m_log->info(_T("%u of %u tiles are up to date on client #%d"),
+              (unsigned int)numSame, (unsigned int)hashes.size(), m_id);
+}
+
 bool UpdateSender::extractReqRegions(Region *incrReqReg,
                                      Region *fullReqReg,
                                      bool *incrUpdIsReq,
@@ -859,8 +2658,20 @@ bool UpdateSender::extractReqRegions(Region *incrReqReg,
   return *incrUpdIsReq || *fullUpdIsReq;
 }
 
+bool UpdateSender::extractContinuousRegion(Region *continuousReg)
+{
+  AutoLock al(&m_reqRectLocMut);
+
+  continuousReg->clear();
+  if (m_continuousUpdates) {
+    continuousReg->addRect(&m_continuousRect);
+  }
+  return m_continuousUpdates;
+}
+
 void UpdateSender::extractUpdates(UpdateContainer *updCont)
 {
+  takeDirtyTiles();
   m_updateKeeper->extract(updCont);
 }
 
@@ -888,29 +2699,31 @@ void UpdateSender::cropUpdContForReqRegions(UpdateContainer *updCont,
 void UpdateSender::inscribeCopiedRegionToReqRegion(UpdateContainer *updCont,
                                                    const Region *requestRegion)
 {
-  // Test copied region. If it is fully inside in the requested region then
-  // there is no to change. Otherwise, simply decline copied region.
-  if (!updCont->copiedRegion.isEmpty()) {
-    Region dstCopiedRegion = updCont->copiedRegion;
-    dstCopiedRegion.subtract(requestRegion);
-
-    bool copiedRegionFullyInscribed = dstCopiedRegion.isEmpty();
-    if (copiedRegionFullyInscribed) {
-      // Then see the same at source coordinates.
-      Region copiedRegion = updCont->copiedRegion;
-      Rect dstBounds = copiedRegion.getBounds();
-      int dx = updCont->copySrc.x - dstBounds.left;
-      int dy = updCont->copySrc.y - dstBounds.top;
-      copiedRegion.translate(dx, dy);
-      copiedRegion.subtract(requestRegion);
-      copiedRegionFullyInscribed = copiedRegion.isEmpty();
+  // Keep the moves whose destination and source are fully inside the
+  // requested region. Moves are applied in order, so the first move that
+  // does not fit is declined together with all the following ones.
+  std::vector<CopyMove> *copies = &updCont->copies;
+  size_t numInscribed = 0;
+  for (; numInscribed < copies->size(); numInscribed++) {
+    const CopyMove *move = &(*copies)[numInscribed];
+    Region dstRegion = move->region;
+    dstRegion.subtract(requestRegion);
+    if (!dstRegion.isEmpty()) {
+      break;
     }
-    if (!copiedRegionFullyInscribed) {
-      // Convert copied region to changed region.
-      updCont->changedRegion.add(&updCont->copiedRegion);
-      updCont->copiedRegion.clear();
+    // Then see the same at source coordinates.
+    Region srcRegion = move->region;
+    srcRegion.translate(move->offset.x, move->offset.y);
+    srcRegion.subtract(requestRegion);
+    if (!srcRegion.isEmpty()) {
+      break;
     }
   }
+  // Convert the declined moves to changed region.
+  for (size_t i = numInscribed; i < copies->size(); i++) {
+    updCont->changedRegion.add(&(*copies)[i].region);
+  }
+  copies->resize(numInscribed);
 }
 
 void UpdateSender::selectEncoder(EncodeOptions *encodeOptions)
@@ -920,22 +2733,52 @@ void UpdateSender::selectEncoder(EncodeOptions *encodeOptions)
   {
     AutoLock lock(&m_newEncodeOptionsLocker);
     *encodeOptions = m_newEncodeOptions;
+    if (m_cursorCacheLost) {
+      m_clientCursorCache.reset();
+      m_cursorCacheLost = false;
+    }
   }
   // Make sure the encoder object corresponds to the preferred encoding
-  // requested in the most recent SetEncodings client message.
+  // requested in the most recent SetEncodings client message, or to the one
+  // chosen among the enabled encodings.
+  if (m_encoderSelector != 0) {
+    encodeOptions->setPreferredEncoding(m_encoderSelector->getEncoding(encodeOptions));
+  }
   m_enbox.selectEncoder(encodeOptions->getPreferredEncoding());
 }
 
 void UpdateSender::updateFrameBuffer(UpdateContainer *updCont,
                                      bool shareOnlyApp, const Region *prevSharedRegion,
-                                     const Region *shareAppRegion)
+                                     const Region *shareAppRegion,
+                                     SharedFrameStore::Reader *sharedFrame,
+                                     int scale)
 {
   Rect viewPort = getViewPort();
 
+  if (sharedFrame->isEnabled()) {
+    // The store keeps the shared frame up to date, the own copy is not
+    // needed while it is used.
+    updCont->screenSizeChanged = !sharedFrame->acquire(m_desktop, &viewPort, scale) ||
+                                 updCont->screenSizeChanged;
+    if (!m_frameShared) {
+      m_frameBuffer.setDimension(&Dimension());
+      m_frameShared = true;
+    }
+    return;
+  }
+  if (m_frameShared) {
+    // The own copy starts with the pixels of the shared frame, it has no
+    // changes the client has not been told about.
+    SharedFrameStore::Reader lastFrame(m_frameStore);
+    if (lastFrame.acquire(m_desktop, &viewPort)) {
+      m_frameBuffer.clone(lastFrame.getFrameBuffer());
+    }
+    m_frameShared = false;
+  }
+
   Region newOpeningPixels;
   if (shareOnlyApp) {
-    updCont->changedRegion.add(&updCont->copiedRegion);
-    updCont->copiedRegion.clear();
+    updCont->convertCopiesToChanges();
     m_appRegion = *shareAppRegion;
     newOpeningPixels = m_appRegion;
     newOpeningPixels.subtract(&m_prevAppRegion);
@@ -949,7 +2792,8 @@ void UpdateSender::updateFrameBuffer(UpdateContainer *updCont,
 
   // Frame buffers synchronizing
   Region changedAndCopyRgns = updCont->changedRegion;
-  changedAndCopyRgns.add(&updCont->copiedRegion);
+  Region copiedRegion = updCont->getCopiedRegion();
+  changedAndCopyRgns.add(&copiedRegion);
   changedAndCopyRgns.add(&updCont->videoRegion);
   changedAndCopyRgns.addRect(&m_cursorUpdates.getBackgroundRect());
   {
@@ -967,7 +2811,7 @@ bool UpdateSender::updateViewPort(Rect *outNewViewPort, bool *shareApp, Region *
   Rect newViewPort;
   m_senderControlInformation->onGetViewPort(&newViewPort, shareApp, newShareAppRegion);
 
-  AutoLock al(&m_viewPortMut);
+  AutoWriteLock al(&m_viewPortMut);
   bool viewPortChanged = !m_viewPort.isEqualTo(&newViewPort);
   if (viewPortChanged) {
     m_viewPort = newViewPort;
@@ -977,34 +2821,64 @@ bool UpdateSender::updateViewPort(Rect *outNewViewPort, bool *shareApp, Region *
   // Emulating share app mode changes as view port changes.
   viewPortChanged = viewPortChanged || shareAppModeChanged;
 
+  // The multicast stream has the whole screen, so it is of no use for
+  // another view port.
+  if (viewPortChanged || *shareApp) {
+    endMulticastReception();
+  }
+
   *outNewViewPort = newViewPort;
   return viewPortChanged;
 }
 
-// Returns part of region with total area no more than area
-// and removes this part form source reg
-Region UpdateSender::takePartFromRegion(Region *reg, int area)
+bool UpdateSender::updateScale(const EncodeOptions *encodeOptions,
+                               bool shareOnlyApp, int *scale)
 {
-  Region out;
+  // The scaled frames are made by the frame store, and the client must
+  // accept the new size of its frame buffer.
+  *scale = encodeOptions->getScaleFactor();
+  if (m_frameStore == 0 || shareOnlyApp ||
+      !PixelDownscaler::isValidFactor(*scale) ||
+      (!encodeOptions->desktopSizeEnabled() &&
+       !encodeOptions->desktopConfigurationEnabled())) {
+    *scale = 1;
+  }
+
+  AutoWriteLock al(&m_viewPortMut);
+  if (*scale == m_scale) {
+    return false;
+  }
+  m_log->info(_T("Client #%d frame buffer is scaled down by %d"), m_id, *scale);
+  m_scale = *scale;
+  endMulticastReception();
+  return true;
+}
+
+Rect UpdateSender::scaleDownRect(const Rect *rect, int scale)
+{
+  // Floor of the negative coordinates too.
+  int left = rect->left >= 0 ? rect->left / scale : -((-rect->left + scale - 1) / scale);
+  int top = rect->top >= 0 ? rect->top / scale : -((-rect->top + scale - 1) / scale);
+  int right = rect->right >= 0 ? (rect->right + scale - 1) / scale : -(-rect->right / scale);
+  int bottom = rect->bottom >= 0 ? (rect->bottom + scale - 1) / scale : -(-rect->bottom / scale);
+  return Rect(left, top, right, bottom);
+}
+
+void UpdateSender::scaleDownRegion(Region *region, int scale)
+{
+  if (scale <= 1 || region->isEmpty()) {
+    return;
+  }
   std::vector<Rect> rects;
-  reg->getRectVector(&rects);
-  // process region rects form last one, I hope it can reduce allocation number for region structure
-  for (int i = rects.size() - 1; i >= 0 && area > 0; i-- ) {
-    Rect r = rects[i];
-    int a = r.area();
-    if (a > area) {
-      r.setWidth(r.getWidth() * area / a + 1);
-      a = r.area();
-    }
-    area -= a;
-    Region t(r);
-    reg->subtract(&t);
-    out.add(&t);
+  region->getRectVector(&rects);
+  region->clear();
+  for (std::vector<Rect>::iterator i = rects.begin(); i != rects.end(); i++) {
+    Rect scaled = scaleDownRect(&(*i), scale);
+    region->addRect(&scaled);
   }
-  return out;
 }
 
-int UpdateSender::calcAreas(std::vector<Rect> rects)
+int UpdateSender::calcAreas(const std::vector<Rect> &rects)
 {
   int sum = 0;
   for (size_t i = 0; i < rects.size(); i++) {
@@ -26,6 +26,8 @@
 #define __UPDATESENDER_H__
 
 #include "thread/AutoLock.h"
+#include "thread/AutoReadLock.h"
+#include "thread/AutoWriteLock.h"
 #include "thread/Thread.h"
 #include "desktop/UpdateKeeper.h"
 #include "UpdateRequestListener.h"
@@ -37,22 +39,80 @@
 #include "rfb-sconn/HextileEncoder.h"
 #include "rfb-sconn/JpegEncoder.h"
 #include "rfb-sconn/EncoderStore.h"
+#include "rfb-sconn/EncodedRectCache.h"
+#include "DirtyTileMap.h"
+#include "SharedFrameStore.h"
+#include "MulticastSender.h"
+#include "io-lib/RecordingOutputStream.h"
+#include "EncodingWorkerPool.h"
+#include "EncoderSelector.h"
+#include "CongestionController.h"
+#include "UpdateCoalescer.h"
+#include "LosslessRefiner.h"
+#include "McuFilter.h"
+#include "OutputScheduler.h"
+#include "UpdateScratch.h"
+#include "UpdateStatistics.h"
+#include "UpdateTraceWriter.h"
+#include "SessionRecorder.h"
 #include "rfb-sconn/RfbCodeRegistrator.h"
 #include "util/DateTime.h"
+#include "util/LatencyHistogram.h"
 #include "CursorUpdates.h"
+#include "ClientCursorCache.h"
 #include "SenderControlInformationInterface.h"
 #include "log-writer/LogWriter.h"
 
+#include <deque>
+
 class UpdateSender : public Thread, public RfbDispatcherListener
 {
 public:
   // updReqListener - pointer to the out listener for retranslate
   // update reqest to out.
+  // rectCache - pointer to the encoded rectangle cache shared between all
+  // the clients, may be 0.
+  // dirtyTiles - pointer to the map of changed tiles shared between all
+  // the clients, may be 0 if the changed regions come with the updates.
+  // frameStore - pointer to the store of frame buffers shared between the
+  // clients and of their memory budget, 0 if each client keeps its own
+  // frame buffer.
+  // multicast - pointer to the multicast stream of the screen shared
+  // between the clients, 0 if there is no stream.
+  // numEncoderThreads - number of threads encoding rectangles, 1 means
+  // encoding on the sender thread, 0 means the number of processors.
+  // adaptiveQuality - adapt frame rate and encoding levels to the network
+  // congestion, otherwise send updates as the client requests them.
+  // interactiveFirst - send the rectangles around the pointer and the
+  // foreground window first and the other ones at a lower quality; when the
+  // output is blocked or the path is congested, defer the other ones to the
+  // next updates.
+  // previewFirstFrame - send the first full update of the connection as a
+  // coarse JPEG preview and then resend it at the normal quality in parts,
+  // starting around the pointer (see m_previewRegion).
+  // autoEncoding - choose the encoding among the ones the client supports
+  // by trial encoding of the updates (see EncoderSelector), otherwise use
+  // the preferred one of the client.
+  // traceFileName - name of the file to record the sent updates to for the
+  // encoder benchmark, 0 if the updates should not be recorded.
+  // recordingFileName - name of the file to record the session to as it is
+  // sent to the client, 0 if the session should not be recorded.
   // FIXME: Document all the arguments properly.
   UpdateSender(RfbCodeRegistrator *codeRegtor,
                UpdateRequestListener *updReqListener,
                SenderControlInformationInterface *senderControlInformation,
                RfbOutputGate *output,
+               EncodedRectCache *rectCache,
+               DirtyTileMap *dirtyTiles,
+               SharedFrameStore *frameStore,
+               MulticastSender *multicast,
+               unsigned int numEncoderThreads,
+               bool adaptiveQuality,
+               bool interactiveFirst,
+               bool previewFirstFrame,
+               bool autoEncoding,
+               const TCHAR *traceFileName,
+               const TCHAR *recordingFileName,
                int id, Desktop *desktop, LogWriter *log);
   virtual ~UpdateSender();
 
@@ -75,10 +135,19 @@ public:
   // Returns a rectangle for current ViewPort
   Rect getViewPort();
 
+  // Returns the factor the frame buffer of the client is scaled down by
+  // (see EncodeOptions::getScaleFactor()), 1 if it is not scaled. The
+  // pointer coordinates of the client must be multiplied by it.
+  int getScale();
+
   // Check requsted regions to determine if the client is ready.
   // Return true if the client is ready, false otherwise.
   bool clientIsReady();
 
+  // Fills stats with the counters of this connection. May be called from
+  // any thread.
+  void getStatistics(UpdateStatistics *stats);
+
 protected:
   // Listener function which implements RfbDispatcherListener. It will be
   // called on receiving client messages if we registered as a handler for
@@ -90,12 +159,30 @@ protected:
   void readSetPixelFormat(RfbInputGate *io);
   void readSetEncodings(RfbInputGate *io);
   void readVideoFreeze(RfbInputGate *io);
+  void readEnableContinuousUpdates(RfbInputGate *io);
+  void readFence(RfbInputGate *io);
+  void readTileHashes(RfbInputGate *io);
+  void readDecodeFeedback(RfbInputGate *io);
+  void readLatencyReport(RfbInputGate *io);
+  void readEnableMulticast(RfbInputGate *io);
+  void readMulticastReception(RfbInputGate *io);
+  void readMulticastRepair(RfbInputGate *io);
+
+  // Returns true if the client receives the changes by the multicast
+  // stream, so they are not to be sent to it.
+  bool receivesMulticast();
+  // The client gets the changes by its connection again.
+  void endMulticastReception();
 
   // The addUpdateContainer() function adds all updates from the first
   // updateContainer parameter to the own UpdateContainer object.
   // This function may asynchronously be called from any threads.
   void addUpdateContainer(const UpdateContainer *updateContainer);
 
+  // Moves the tiles changed since the previous call from the shared tile
+  // map to the update keeper. May be called from any thread.
+  void takeDirtyTiles();
+
   // The sender thread.
   virtual void execute();
   virtual void onTerminate();
@@ -114,6 +201,27 @@ protected:
   // of the function parameter.
   void sendUpdate();
 
+  // Encodes the pending changes into m_stagingCache while the client has
+  // not requested the next update yet. The next update takes the staged
+  // data of the rectangles whose pixels have not changed since then and
+  // encodes only the other ones. Does nothing on fast links, for scaled
+  // or shared application view ports and with encoders which cannot work
+  // statelessly.
+  void preEncode();
+  // Encodes the rectangles of m_stagingFrame which are not staged yet and
+  // puts them to m_stagingCache.
+  void stageRectangles(Encoder *encoder,
+                       const std::vector<Rect> *rects,
+                       const EncodeOptions *encodeOptions,
+                       const PixelFormat *clientPf);
+  // Returns the key of the rectangle encoded by the encoder, in
+  // m_stagingCache or in m_rectCache.
+  EncodedRectCache::Key getRectKey(const Encoder *encoder,
+                                   const Rect *rect,
+                                   const FrameBuffer *frameBuffer,
+                                   const EncodeOptions *encodeOptions,
+                                   const PixelFormat *clientPf);
+
   // sendUpdate() auxiliary functions.
   // Returns true if an update has been requested.
   bool extractReqRegions(Region *incrReqReg,
@@ -121,6 +229,8 @@ protected:
                          bool *incrUpdIsReq,
                          bool *fullUpdIsReq,
                          DateTime *reqTimePoint);
+  // Returns true and the area of continuous updates if they are enabled.
+  bool extractContinuousRegion(Region *continuousReg);
   void extractUpdates(UpdateContainer *updCont);
   void cropUpdContForReqRegions(UpdateContainer *updCont,
                                 const Region *incrReqReg,
@@ -130,14 +240,25 @@ protected:
 
   void selectEncoder(EncodeOptions *encodeOptions);
 
-  // Updates pixels in the internal frame buffer.
+  // Updates pixels in the internal frame buffer, or acquires the shared
+  // frame by sharedFrame if it is enabled.
   void updateFrameBuffer(UpdateContainer *updCont,
                          bool shareOnlyApp, const Region *prevSharedRegion,
-                         const Region *shareAppRegion);
+                         const Region *shareAppRegion,
+                         SharedFrameStore::Reader *sharedFrame, int scale);
   // Updates internal view port rectangle.
   // Returns true if view port has been changed during the operation.
   bool updateViewPort(Rect *outNewViewPort, bool *shareApp, Region *prevShareAppRegion,
                       Region *newShareAppRegion);
+  // Chooses the scale of the client frame buffer for the update. Returns
+  // true if it has been changed, the frame buffer of the client is resized
+  // then, as on view port changes.
+  bool updateScale(const EncodeOptions *encodeOptions, bool shareOnlyApp,
+                   int *scale);
+
+  // Scales a rectangle down by the factor, to the pixels that it touches.
+  static Rect scaleDownRect(const Rect *rect, int scale);
+  static void scaleDownRegion(Region *region, int scale);
 
   // The sendPalette() function sends pallete after a set color map request
   // by a client.
@@ -148,18 +269,54 @@ protected:
   void setClientPixelFormat(const PixelFormat *pf,
                             bool clrMapEntries);
 
+  // Writes the LatencyProbe pseudo-rectangle of the update started at
+  // frameStart and remembers it until the client reports on it.
+  void sendLatencyProbe(const UpdateContainer *updCont,
+                        const LARGE_INTEGER *frameStart);
+
   void sendRectHeader(const Rect *rect, INT32 encodingType);
   void sendRectHeader(UINT16 x, UINT16 y, UINT16 w, UINT16 h,
                       INT32 encodingType);
+  // Writes the FramebufferUpdate message header, numRects may be
+  // PseudoEncDefs::LAST_RECT_COUNT.
+  void sendFbUpdateHeader(UINT16 numRects);
+  // Sends the rectangles which go first in an update and need no encoding
+  // of the changed pixels: the cursor, CopyRect and the tile cache hits.
+  void sendLeadingRectangles(const UpdateContainer *updCont,
+                             const PixelFormat *clientPixelFormat,
+                             const CursorShape *cursorShape,
+                             TileCacheEncoder *tileCache,
+                             const std::vector<Rect> *cacheHitRects,
+                             const FrameBuffer *frameBuffer,
+                             const EncodeOptions *encodeOptions);
   void sendNewFBSize(Dimension *dim, bool extended);
   void sendFbInClientDim(const EncodeOptions *encodeOptions,
                          const FrameBuffer *fb,
                          const Dimension *dim,
                          const PixelFormat *pf);
+  // Sends the shape as a rich cursor or, if useCache is true, as a cursor
+  // cache pseudo-rectangle.
   void sendCursorShapeUpdate(const PixelFormat *fmt,
-                             const CursorShape *cursorShape);
+                             const CursorShape *cursorShape,
+                             bool useCache);
   void sendCursorPosUpdate();
-  void sendCopyRect(const std::vector<Rect> *rects, const Point *source);
+  // Sends EndOfContinuousUpdates if it is pending, from the sender thread,
+  // so that no continuous update follows it.
+  void sendEndOfContinuousUpdates();
+  // Sends a fence and, if it is a request, remembers it as answering
+  // an update of dataSize bytes. Locks m_output.
+  void sendFence(UINT32 flags, const std::vector<char> *payload,
+                 size_t dataSize);
+  // Sends TransportZlib and compresses all the following output.
+  void startTransportZlib(int level);
+  // Returns true if as many pushed updates as the network path can hold
+  // wait for their fences to be answered.
+  bool isPushWindowFull();
+  // Waits while m_coalescer expects more changes related to the pending
+  // ones, if the client waits for an update.
+  void waitForRelatedChanges();
+  // Sends the CopyRect rectangles of all the moves in order.
+  void sendCopyRect(const std::vector<CopyMove> *copies);
 
   // Encode and send a list of rectangles via the specified encoder.
   void sendRectangles(Encoder *encoder,
@@ -167,6 +324,24 @@ protected:
                       const FrameBuffer *frameBuffer,
                       const EncodeOptions *encodeOptions);
 
+  // Send one rectangle via the specified encoder using the rectangles
+  // encoded ahead and the shared cache of encoded rectangles: take the data
+  // staged by preEncode() or the data of another client which has already
+  // encoded the same rectangle, otherwise encode it and store the result in
+  // the shared cache. Returns true if the cached data has been used.
+  bool sendCachedRectangle(Encoder *encoder,
+                           const Rect *rect,
+                           const FrameBuffer *frameBuffer,
+                           const EncodeOptions *encodeOptions);
+
+  // Encode a list of rectangles concurrently via m_encodingPool, using the
+  // encoder of the same type as the specified one in the stateless mode, and
+  // send the results in the original order.
+  void sendRectanglesInParallel(Encoder *encoder,
+                                const std::vector<Rect> *rects,
+                                const FrameBuffer *frameBuffer,
+                                const EncodeOptions *encodeOptions);
+
   // This function paints black region in framebuffer.
   void paintBlack(FrameBuffer *frameBuffer, const Region *blackRegion);
 
@@ -180,11 +355,16 @@ protected:
                    const FrameBuffer *frameBuffer,
                    const EncodeOptions *encodeOptions);
 
-  // Returns part of region with total area not much more than area
-  // and removes this part form source reg
-  Region takePartFromRegion(Region *reg, int area);
+  // Appends the data sent by the last update to the session recording,
+  // followed by a keyframe if it is due and the client framebuffer matches
+  // frameBuffer. Stops recording on errors.
+  void recordSession(const FrameBuffer *frameBuffer,
+                     const Dimension *clientDim,
+                     const PixelFormat *clientPf,
+                     bool keyFramePossible);
+
   // calculate total area of rects in pixels
-  int calcAreas(std::vector<Rect> rects);
+  int calcAreas(const std::vector<Rect> &rects);
 
   LogWriter *m_log;
 
@@ -198,17 +378,57 @@ protected:
   bool m_busy;
   // Property for perfomance measurements. It uses with the regions mutex.
   DateTime m_requestTimePoint;
+
+  // Continuous updates of m_continuousRect are sent without requests while
+  // m_continuousUpdates is set. EndOfContinuousUpdates is sent to announce
+  // the extension and to confirm that the updates are disabled. Protected
+  // by m_reqRectLocMut.
+  bool m_continuousUpdates;
+  Rect m_continuousRect;
+  bool m_continuousAnnounced;
+  bool m_continuousEndPending;
+
+  // Fence requests sent to the client and not answered yet, in the order
+  // of sending. Changed with m_output locked, which keeps the order, and
+  // protected by m_reqRectLocMut.
+  struct PendingFence
+  {
+    DateTime sendTime;
+    size_t dataSize;
+  };
+  std::deque<PendingFence> m_pendingFences;
+  bool m_fenceAnnounced;
+  // The transport compression is started once and never stopped. Protected
+  // by m_reqRectLocMut.
+  bool m_transportZlibStarted;
   LocalMutex m_reqRectLocMut;
 
+  // Tile hashes of the pixels the client already has, received in the
+  // TileHashes message and used by the next update. Protected by
+  // m_resyncLock.
+  std::vector<UINT64> m_resyncHashes;
+  Dimension m_resyncDim;
+  int m_resyncTileSize;
+  LocalMutex m_resyncLock;
+
+  // Set once the client has reported decoding H.264 frames at a higher cost
+  // per pixel than Tight while being too slow for the updates, the video
+  // regions are sent with Tight from then on.
+  volatile bool m_avoidH264;
+
   SenderControlInformationInterface *m_senderControlInformation;
 
   Rect m_viewPort;
+  // The client frame buffer is the view port scaled down by this factor.
+  // The updates are kept scaled in m_updateKeeper.
+  int m_scale;
   Dimension m_clientDim;
   Dimension m_lastViewPortDim;
   bool m_shareOnlyApp;
   Region m_appRegion;
   Region m_prevAppRegion;
-  LocalMutex m_viewPortMut;
+  // Read by each update, written when the view port changes.
+  ReadWriteMutex m_viewPortMut;
 
   UpdateKeeper *m_updateKeeper;
 
@@ -216,6 +436,8 @@ protected:
   Desktop *m_desktop;
 
   CursorUpdates m_cursorUpdates;
+  // Used from the sender thread only.
+  ClientCursorCache m_clientCursorCache;
 
   // EncodeOptions class maintain the configuration of encoders and
   // pseudo-encoders read from the SetEncodings client message.
@@ -227,6 +449,9 @@ protected:
   // framebuffer update.
   EncodeOptions m_newEncodeOptions;
   LocalMutex m_newEncodeOptionsLocker;
+  // Set when the client has disabled the cursor cache and so may have
+  // dropped its slots. Protected by m_newEncodeOptionsLocker.
+  bool m_cursorCacheLost;
 
   // Pixel format requested by the RFB client. It may be changed at any time
   // but all change and read operations must be synchronized with
@@ -249,12 +474,178 @@ protected:
   LocalMutex m_vidFreezeLocMut;
 
 
-  Region m_losslessDirty;
-  Region m_losslessClean;
+  // Pixels sent lossy, to be sent again losslessly once they are static.
+  LosslessRefiner m_refiner;
+  // Parts of the framebuffer refined per update with other changes, and
+  // per update without them.
+  static const int REFINE_PARTS = 100;
+  static const int IDLE_REFINE_PARTS = 8;
+  // Pixels the client has only from the preview of the first full update,
+  // resent at the normal quality by parts of 1/PREVIEW_REFINE_PARTS of the
+  // framebuffer per update. Pixels sent otherwise drop out of it.
+  bool m_previewFirstFrame;
+  bool m_previewSent;
+  Region m_previewRegion;
+  static const int PREVIEW_REFINE_PARTS = 4;
+  // JPEG quality level of the preview.
+  static const int PREVIEW_QUALITY = 1;
+  // Returns the part of m_previewRegion closest to the pointer, with the
+  // area about maxArea or the whole region if it is smaller.
+  void takePreviewSlice(int maxArea, int scale, Region *slice);
+
+  // Minimum interval in milliseconds between checks for pixels to refine.
+  static const unsigned int REFINE_CHECK_INTERVAL = 100;
+  // Size of a CopyRect rectangle with its header, in bytes.
+  static const size_t COPYRECT_SIZE = 16;
+
+  // Leaves the unchanged MCUs out of the JPEG video region.
+  McuFilter m_mcuFilter;
+
+  // Shares the updates fairly between the monitors of the desktop.
+  OutputScheduler m_outputScheduler;
+
+  // Waits until the output to the client has room for data. Returns true if
+  // the output has been full.
+  bool waitForOutputSpace();
+  // Sets region to the area around the pointer and the foreground window,
+  // in the view port coordinates.
+  void getInteractiveRegion(const Rect *viewPort, Region *region);
+  // Leaves in changedRegion its part around the pointer and the foreground
+  // window and puts the rest to deferredRegion. Nothing is deferred if the
+  // changes do not touch that area.
+  void takeInteractiveRegion(Region *changedRegion, Region *deferredRegion,
+                             const Rect *viewPort);
+  // Moves the rectangles not touching interestRegion from rects to
+  // backgroundRects, keeping the order.
+  static void separateBackground(std::vector<Rect> *rects,
+                                 const Region *interestRegion,
+                                 std::vector<Rect> *backgroundRects);
+  // Cuts the big rectangles into up to numBands horizontal bands of at
+  // least MIN_BAND_AREA pixels, so that the encoding threads compress a
+  // big video rectangle together. The bands start at multiples of
+  // BAND_ALIGNMENT rows from the top of the rectangle, on the boundaries of
+  // the JPEG blocks. The new bands are appended.
+  static void splitIntoBands(std::vector<Rect> *rects, size_t numBands);
+  static const int MIN_BAND_AREA = 64 * 1024;
+  static const int BAND_ALIGNMENT = 16;
+  // Removes from the regions the tiles which the client reported to have
+  // with the same pixels as frameBuffer. The hashes are used once.
+  void skipResyncedTiles(const FrameBuffer *frameBuffer,
+                         Region *changedRegion, Region *videoRegion);
+
+  // Period of checks of a full output, in milliseconds.
+  static const unsigned int OUTPUT_CHECK_INTERVAL = 50;
+  // Half size of the square around the pointer sent first.
+  static const int POINTER_AREA_RADIUS = 128;
+  // The foreground window is queried no more often than once per this
+  // interval, in milliseconds.
+  static const unsigned int FOREGROUND_REFRESH_INTERVAL = 500;
+  // JPEG quality levels the rectangles out of the region of interest lose.
+  static const int ROI_QUALITY_DROP = 3;
+
+  // Returns the size of the buffers the encoders of the client keep
+  // between updates.
+  size_t getScratchSize() const;
+  // Passes the current scratch size to m_frameStore.
+  void accountScratch();
+  // Frees the scratch buffers if no update has been sent for
+  // SCRATCH_IDLE_TIME and the memory budget is exceeded.
+  void releaseIdleScratch();
+
+  // Time without updates after which the scratch buffers are idle, in
+  // milliseconds.
+  static const unsigned int SCRATCH_IDLE_TIME = 2000;
+
+  bool m_interactiveFirst;
+  // The output has been full before the current update.
+  bool m_outputWasBlocked;
+  // Foreground window in the frame buffer coordinates.
+  Rect m_foregroundRect;
+  DateTime m_foregroundTime;
+
+  // Rectangle lists of the current update, reused from update to update.
+  UpdateScratch m_scratch;
+
+  // Identifier of the current update in the frame trace.
+  UINT32 m_traceFrameId;
+
+  // Records the sent updates, 0 if they are not recorded. Used only by the
+  // sender thread after construction.
+  UpdateTraceWriter *m_traceWriter;
+
+  // Records the session, 0 if it is not recorded. Used only by the sender
+  // thread after construction.
+  SessionRecorder *m_sessionRecorder;
 
   // Output stream.
   RfbOutputGate *m_output;
 
+  // Encoders write to m_encoderOutput which passes the data to m_output via
+  // m_recorder, so that encoded rectangles can be captured for m_rectCache.
+  RecordingOutputStream m_recorder;
+  DataOutputStream m_encoderOutput;
+
+  // Cache of encoded rectangles shared between all the clients, may be 0.
+  EncodedRectCache *m_rectCache;
+
+  // Changed tiles shared between all the clients, may be 0. The changes up
+  // to m_dirtyTilesGeneration are in m_updateKeeper already.
+  DirtyTileMap *m_dirtyTiles;
+  UINT64 m_dirtyTilesGeneration;
+  LocalMutex m_dirtyTilesLock;
+
+  // Multicast stream of the screen, may be 0. The client is counted as
+  // interested in it while m_multicastInterested is set, and gets the
+  // changes by the stream while m_multicastReception is set. Both are
+  // protected by m_multicastLock.
+  MulticastSender *m_multicast;
+  bool m_multicastInterested;
+  bool m_multicastReception;
+  LocalMutex m_multicastLock;
+
+  // Frame buffers shared between the clients, may be 0. m_frameBuffer is
+  // empty while m_frameShared is set and the shared frame is used instead.
+  // m_scratchSize is the size of the scratch buffers accounted in the
+  // store. Used only by the sender thread after construction.
+  SharedFrameStore *m_frameStore;
+  bool m_frameShared;
+  size_t m_scratchSize;
+  DateTime m_lastUpdateTime;
+
+  // Worker threads encoding rectangles in parallel, 0 if rectangles should
+  // be encoded on the sender thread.
+  EncodingWorkerPool *m_encodingPool;
+
+  // Chooses the encoding by trial encoding, 0 if the preferred encoding of
+  // the client is used.
+  EncoderSelector *m_encoderSelector;
+
+  // Rectangles encoded ahead of the next update request by preEncode(),
+  // from the pixels copied to m_stagingFrame. m_stagingPool encodes them
+  // if there is no m_encodingPool. m_numStaged is the number of the
+  // rectangles encoded since the last update. Used only by the sender
+  // thread after construction.
+  EncodedRectCache m_stagingCache;
+  FrameBuffer m_stagingFrame;
+  EncodingWorkerPool *m_stagingPool;
+  size_t m_numStaged;
+  // Round trip time in milliseconds from which the changes are encoded
+  // ahead, the stateless encoding is not worth it on faster links.
+  static const unsigned int PRE_ENCODE_MIN_RTT = 30;
+  // Limit of the staged data, in bytes.
+  static const size_t MAX_STAGED_SIZE = 8 * 1024 * 1024;
+  // Number of pixels, in thousands, an encoding must have in a
+  // DecodeFeedback report for its cost to be taken into account.
+  static const UINT32 MIN_FEEDBACK_KILOPIXELS = 500;
+
+  // Measures the round trip time and throughput to the client and adapts
+  // the updates to them.
+  CongestionController m_congestion;
+
+  // Holds the update back for a few milliseconds after a change, so that
+  // the related changes found shortly after it go in the same update.
+  UpdateCoalescer m_coalescer;
+
   // PixelConverter can convert from one pixel format to another using fast
   // table lookups. It should be used only in the sender thread.
   PixelConverter m_pixelConverter;
@@ -267,6 +658,31 @@ protected:
   // Information
   // FIXME: Document this properly.
   int m_id;
+
+  // Counters of the connection, protected by m_statsLock.
+  UpdateStatistics m_stats;
+  // New updates have been passed and the sender has not woken up yet.
+  bool m_updatesPending;
+  DateTime m_startTime;
+  LocalMutex m_statsLock;
+  LARGE_INTEGER m_perfFrequency;
+
+  // LatencyProbe pseudo-rectangles sent and not reported by the client yet,
+  // by their sequence numbers. The send time is a performance counter
+  // value, the other times are in microseconds. Protected by m_statsLock,
+  // as well as the other latency members.
+  struct PendingProbe
+  {
+    INT64 sendTime;
+    bool captureKnown;
+    UINT32 captureTime;
+    UINT32 encodeTime;
+  };
+  std::map<UINT32, PendingProbe> m_pendingProbes;
+  UINT32 m_probeSeq;
+  // The latest one-way network time estimate, in microseconds, 0 if none.
+  UINT32 m_networkLatency;
+  LatencyHistogram m_stageLatency[LatencyProbeDefs::STAGE_COUNT];
 };
 
 #endif // __UPDATESENDER_H__
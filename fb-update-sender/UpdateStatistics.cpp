@@ -0,0 +1,140 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "UpdateStatistics.h"
+#include <string.h>
+
+const unsigned int UpdateStatistics::LATENCY_PERCENTILES[] = { 50, 95, 99 };
+
+UpdateStatistics::UpdateStatistics()
+: uptime(0),
+  updatesSent(0),
+  bytesSent(0),
+  encodeTime(0),
+  frameTime(0),
+  frameTimeSquares(0),
+  latencyUpdates(0),
+  captureLatency(0),
+  captureLatencySquares(0),
+  latencyReports(0),
+  rectsSent(0),
+  copyRectsSent(0),
+  rectsMerged(0),
+  mergedPixels(0),
+  mcusSkipped(0),
+  coalescedUpdates(0),
+  roundTripTime(0),
+  queueingDelay(0),
+  throughput(0),
+  transportBytesIn(0),
+  transportBytesOut(0),
+  transportDeflateTime(0),
+  rectsPreEncoded(0),
+  preEncodedRectsSent(0)
+{
+  memset(stageLatency, 0, sizeof(stageLatency));
+}
+
+void UpdateStatistics::addEncodingBytes(INT32 encoding, UINT64 bytes)
+{
+  bytesPerEncoding[encoding] += bytes;
+}
+
+void UpdateStatistics::serialize(DataOutputStream *output)
+{
+  output->writeUInt64(uptime);
+  output->writeUInt64(updatesSent);
+  output->writeUInt64(bytesSent);
+  output->writeUInt64(encodeTime);
+  output->writeUInt64(rectsSent);
+  output->writeUInt64(copyRectsSent);
+  output->writeUInt64(coalescedUpdates);
+  output->writeUInt32(roundTripTime);
+  output->writeUInt32(queueingDelay);
+  output->writeUInt32(throughput);
+  output->writeUInt64(transportBytesIn);
+  output->writeUInt64(transportBytesOut);
+  output->writeUInt64(transportDeflateTime);
+  output->writeUInt64(rectsPreEncoded);
+  output->writeUInt64(preEncodedRectsSent);
+  output->writeUInt64(frameTime);
+  output->writeUInt64(frameTimeSquares);
+  output->writeUInt64(rectsMerged);
+  output->writeUInt64(mergedPixels);
+  output->writeUInt64(mcusSkipped);
+  output->writeUInt64(latencyUpdates);
+  output->writeUInt64(captureLatency);
+  output->writeUInt64(captureLatencySquares);
+  output->writeUInt64(latencyReports);
+  for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+    for (size_t i = 0; i < LATENCY_PERCENTILE_COUNT; i++) {
+      output->writeUInt32(stageLatency[stage][i]);
+    }
+  }
+  output->writeUInt32((UINT32)bytesPerEncoding.size());
+  std::map<INT32, UINT64>::const_iterator i;
+  for (i = bytesPerEncoding.begin(); i != bytesPerEncoding.end(); i++) {
+    output->writeInt32(i->first);
+    output->writeUInt64(i->second);
+  }
+}
+
+void UpdateStatistics::deserialize(DataInputStream *input)
+{
+  uptime = input->readUInt64();
+  updatesSent = input->readUInt64();
+  bytesSent = input->readUInt64();
+  encodeTime = input->readUInt64();
+  rectsSent = input->readUInt64();
+  copyRectsSent = input->readUInt64();
+  coalescedUpdates = input->readUInt64();
+  roundTripTime = input->readUInt32();
+  queueingDelay = input->readUInt32();
+  throughput = input->readUInt32();
+  transportBytesIn = input->readUInt64();
+  transportBytesOut = input->readUInt64();
+  transportDeflateTime = input->readUInt64();
+  rectsPreEncoded = input->readUInt64();
+  preEncodedRectsSent = input->readUInt64();
+  frameTime = input->readUInt64();
+  frameTimeSquares = input->readUInt64();
+  rectsMerged = input->readUInt64();
+  mergedPixels = input->readUInt64();
+  mcusSkipped = input->readUInt64();
+  latencyUpdates = input->readUInt64();
+  captureLatency = input->readUInt64();
+  captureLatencySquares = input->readUInt64();
+  latencyReports = input->readUInt64();
+  for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+    for (size_t i = 0; i < LATENCY_PERCENTILE_COUNT; i++) {
+      stageLatency[stage][i] = input->readUInt32();
+    }
+  }
+  bytesPerEncoding.clear();
+  UINT32 count = input->readUInt32();
+  for (UINT32 i = 0; i < count; i++) {
+    INT32 encoding = input->readInt32();
+    bytesPerEncoding[encoding] = input->readUInt64();
+  }
+}
@@ -0,0 +1,107 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __UPDATESTATISTICS_H__
+#define __UPDATESTATISTICS_H__
+
+#include "util/CommonHeader.h"
+#include "io-lib/DataOutputStream.h"
+#include "io-lib/DataInputStream.h"
+#include "rfb/MsgDefs.h"
+
+#include <map>
+
+// Snapshot of the update sending counters of a client connection, counted
+// since the connection has been established. Rates are left to the reader:
+// it divides the difference of two snapshots by the difference of their
+// uptimes.
+class UpdateStatistics
+{
+public:
+  UpdateStatistics();
+
+  void addEncodingBytes(INT32 encoding, UINT64 bytes);
+
+  void serialize(DataOutputStream *output);
+  void deserialize(DataInputStream *input);
+
+  // Time in milliseconds the counting goes.
+  UINT64 uptime;
+  // Number of framebuffer updates sent.
+  UINT64 updatesSent;
+  // Encoded rectangle data sent, in bytes.
+  UINT64 bytesSent;
+  // Time spent on encoding, in microseconds.
+  UINT64 encodeTime;
+  // Sum and sum of squares of the times, in microseconds, from taking the
+  // changes of an update to flushing it, to get the mean frame time and
+  // its variance.
+  UINT64 frameTime;
+  UINT64 frameTimeSquares;
+  // Number of updates with a known capture time of their changes, and the
+  // sum and the sum of squares of the times, in microseconds, from the
+  // capture (or the presentation) of the oldest change to flushing the
+  // update.
+  UINT64 latencyUpdates;
+  UINT64 captureLatency;
+  UINT64 captureLatencySquares;
+  // Number of LatencyProbe reports of the client and the percentiles (see
+  // LATENCY_PERCENTILES) of each stage of the latency, in microseconds,
+  // indexed by LatencyProbeDefs::STAGE_*.
+  static const size_t LATENCY_PERCENTILE_COUNT = 3;
+  static const unsigned int LATENCY_PERCENTILES[LATENCY_PERCENTILE_COUNT];
+  UINT64 latencyReports;
+  UINT32 stageLatency[LatencyProbeDefs::STAGE_COUNT][LATENCY_PERCENTILE_COUNT];
+  // Number of rectangles sent, CopyRect ones included.
+  UINT64 rectsSent;
+  UINT64 copyRectsSent;
+  // Number of rectangles saved by merging neighbours before encoding and
+  // the unchanged pixels the merged rectangles have added, see RectMerger.
+  UINT64 rectsMerged;
+  UINT64 mergedPixels;
+  // Number of unchanged MCUs left out of the JPEG video region.
+  UINT64 mcusSkipped;
+  // Number of screen changes merged into an update that has not been
+  // picked up by the sender yet.
+  UINT64 coalescedUpdates;
+  // Congestion estimates in milliseconds and bytes per second, 0 if
+  // unknown yet. The queueing delay is the growth of the round trip time
+  // above the minimum, i.e. the time data waits in the network queues.
+  UINT32 roundTripTime;
+  UINT32 queueingDelay;
+  UINT32 throughput;
+  // Transport compression counters, zeros if it is off: bytes given to the
+  // compressor, compressed bytes and the compression time in microseconds.
+  UINT64 transportBytesIn;
+  UINT64 transportBytesOut;
+  UINT64 transportDeflateTime;
+  // Number of rectangles encoded ahead of the update requests and number
+  // of them sent, unchanged, with the next updates.
+  UINT64 rectsPreEncoded;
+  UINT64 preEncodedRectsSent;
+  // Bytes sent by each encoding type.
+  std::map<INT32, UINT64> bytesPerEncoding;
+};
+
+#endif // __UPDATESTATISTICS_H__
@@ -0,0 +1,138 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "UpdateTraceReader.h"
+#include "file-lib/EOFException.h"
+#include "util/Exception.h"
+#include "region/RectSerializer.h"
+
+UpdateTraceReader::UpdateTraceReader(const TCHAR *fileName)
+: m_file(fileName, F_READ, FM_OPEN),
+  m_bufInput(&m_file),
+  m_input(&m_bufInput)
+{
+  if (m_input.readUInt32() != UpdateTraceWriter::MAGIC) {
+    throw Exception(_T("The file is not an update trace"));
+  }
+  if (m_input.readUInt32() != UpdateTraceWriter::VERSION) {
+    throw Exception(_T("Unsupported version of the update trace"));
+  }
+}
+
+UpdateTraceReader::~UpdateTraceReader()
+{
+}
+
+bool UpdateTraceReader::readFrame(FrameBuffer *frameBuffer,
+                                  Region *changedRegion,
+                                  std::vector<CopyMove> *copies)
+{
+  UINT8 type;
+  try {
+    type = m_input.readUInt8();
+  } catch (EOFException &) {
+    return false;
+  }
+  if (type == UpdateTraceWriter::END) {
+    return false;
+  }
+  if (type != UpdateTraceWriter::FRAME) {
+    throw IOException(_T("Unknown record type in the update trace"));
+  }
+
+  UINT8 flags = m_input.readUInt8();
+  if ((flags & UpdateTraceWriter::PROPERTIES_CHANGED) != 0) {
+    Dimension dim;
+    dim.width = m_input.readUInt16();
+    dim.height = m_input.readUInt16();
+    PixelFormat pf;
+    pf.bitsPerPixel = m_input.readUInt16();
+    pf.colorDepth = m_input.readUInt16();
+    pf.redMax = m_input.readUInt16();
+    pf.greenMax = m_input.readUInt16();
+    pf.blueMax = m_input.readUInt16();
+    pf.redShift = m_input.readUInt16();
+    pf.greenShift = m_input.readUInt16();
+    pf.blueShift = m_input.readUInt16();
+    pf.bigEndian = m_input.readUInt8() != 0;
+    if (pf.bitsPerPixel != 8 && pf.bitsPerPixel != 16 &&
+        pf.bitsPerPixel != 32) {
+      throw IOException(_T("Wrong pixel format in the update trace"));
+    }
+    if (!frameBuffer->setProperties(&dim, &pf)) {
+      throw IOException(_T("Cannot allocate the framebuffer for the update trace"));
+    }
+  }
+  Rect fbRect = frameBuffer->getDimension().getRect();
+
+  UINT32 numCopies = m_input.readUInt32();
+  copies->resize(numCopies);
+  for (UINT32 i = 0; i < numCopies; i++) {
+    CopyMove *move = &(*copies)[i];
+    move->offset.x = m_input.readInt32();
+    move->offset.y = m_input.readInt32();
+    readRects(&m_rects);
+    move->region.clear();
+    move->region.addRects(&m_rects);
+  }
+
+  readRects(&m_rects);
+  changedRegion->clear();
+  changedRegion->addRects(&m_rects);
+
+  readRects(&m_rects);
+  size_t bytesPerPixel = frameBuffer->getBytesPerPixel();
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = m_rects.begin(); iRect != m_rects.end(); iRect++) {
+    Rect rect = *iRect;
+    if (rect.isEmpty() || !fbRect.intersection(&rect).isEqualTo(&rect)) {
+      throw IOException(_T("Wrong rectangle in the update trace"));
+    }
+    size_t rowSize = rect.getWidth() * bytesPerPixel;
+    for (int y = rect.top; y < rect.bottom; y++) {
+      m_input.readFully(frameBuffer->getBufferPtr(rect.left, y), rowSize);
+    }
+  }
+  return true;
+}
+
+void UpdateTraceReader::readRects(std::vector<Rect> *rects)
+{
+  UINT32 dataSize = m_input.readUInt32();
+  if (dataSize == 0 || dataSize > MAX_RECT_DATA_SIZE) {
+    throw IOException(_T("Wrong rectangle list in the update trace"));
+  }
+  m_rectData.resize(dataSize);
+  m_input.readFully(&m_rectData.front(), m_rectData.size());
+  size_t usedSize;
+  try {
+    usedSize = RectSerializer::fromBytes(&m_rectData.front(),
+                                         m_rectData.size(), rects);
+  } catch (Exception &e) {
+    throw IOException(e.getMessage());
+  }
+  if (usedSize != dataSize) {
+    throw IOException(_T("Wrong rectangle list in the update trace"));
+  }
+}
@@ -0,0 +1,63 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __UPDATETRACEREADER_H__
+#define __UPDATETRACEREADER_H__
+
+#include "UpdateTraceWriter.h"
+#include "io-lib/BufferedInputStream.h"
+#include "io-lib/DataInputStream.h"
+
+// Reads the updates recorded by UpdateTraceWriter.
+class UpdateTraceReader
+{
+public:
+  // Opens the trace file, throws Exception if it cannot be opened or is not
+  // a trace of the supported version.
+  UpdateTraceReader(const TCHAR *fileName);
+  virtual ~UpdateTraceReader();
+
+  // Reads the next update: applies its pixels and properties to
+  // frameBuffer, which must be the same for all the calls, and fills
+  // changedRegion and copies. Returns false at the end of the trace. A trace
+  // truncated at a record boundary, as left by a killed server, ends there.
+  bool readFrame(FrameBuffer *frameBuffer,
+                 Region *changedRegion,
+                 std::vector<CopyMove> *copies) throw(IOException);
+
+private:
+  void readRects(std::vector<Rect> *rects) throw(IOException);
+
+  WinFileChannel m_file;
+  BufferedInputStream m_bufInput;
+  DataInputStream m_input;
+
+  std::vector<Rect> m_rects;
+  std::vector<UINT8> m_rectData;
+
+  // Limit of a rectangle list, in bytes.
+  static const UINT32 MAX_RECT_DATA_SIZE = 64 * 1024 * 1024;
+};
+
+#endif // __UPDATETRACEREADER_H__
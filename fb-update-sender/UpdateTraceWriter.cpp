@@ -0,0 +1,117 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "UpdateTraceWriter.h"
+#include "region/RectSerializer.h"
+
+UpdateTraceWriter::UpdateTraceWriter(const TCHAR *fileName)
+: m_file(fileName, F_WRITE, FM_CREATE),
+  m_bufOutput(&m_file),
+  m_output(&m_bufOutput),
+  m_hasProperties(false)
+{
+  m_output.writeUInt32(MAGIC);
+  m_output.writeUInt32(VERSION);
+}
+
+UpdateTraceWriter::~UpdateTraceWriter()
+{
+  try {
+    m_output.writeUInt8(END);
+    m_bufOutput.flush();
+  } catch (Exception &) {
+  }
+}
+
+void UpdateTraceWriter::writeFrame(const FrameBuffer *frameBuffer,
+                                   const Region *changedRegion,
+                                   const std::vector<CopyMove> *copies)
+{
+  Dimension dim = frameBuffer->getDimension();
+  PixelFormat pf = frameBuffer->getPixelFormat();
+  bool propertiesChanged = !m_hasProperties ||
+                           !m_dimension.isEqualTo(&dim) ||
+                           !m_pixelFormat.isEqualTo(&pf);
+  m_hasProperties = true;
+  m_dimension = dim;
+  m_pixelFormat = pf;
+
+  m_output.writeUInt8(FRAME);
+  m_output.writeUInt8(propertiesChanged ? PROPERTIES_CHANGED : 0);
+  if (propertiesChanged) {
+    m_output.writeUInt16((UINT16)dim.width);
+    m_output.writeUInt16((UINT16)dim.height);
+    m_output.writeUInt16(pf.bitsPerPixel);
+    m_output.writeUInt16(pf.colorDepth);
+    m_output.writeUInt16(pf.redMax);
+    m_output.writeUInt16(pf.greenMax);
+    m_output.writeUInt16(pf.blueMax);
+    m_output.writeUInt16(pf.redShift);
+    m_output.writeUInt16(pf.greenShift);
+    m_output.writeUInt16(pf.blueShift);
+    m_output.writeUInt8(pf.bigEndian ? 1 : 0);
+  }
+
+  Region pixelRegion;
+  if (propertiesChanged) {
+    Rect fbRect = dim.getRect();
+    pixelRegion.addRect(&fbRect);
+  } else {
+    pixelRegion = *changedRegion;
+  }
+
+  m_output.writeUInt32((UINT32)copies->size());
+  std::vector<CopyMove>::const_iterator iMove;
+  for (iMove = copies->begin(); iMove != copies->end(); iMove++) {
+    m_output.writeInt32(iMove->offset.x);
+    m_output.writeInt32(iMove->offset.y);
+    iMove->region.getRectVector(&m_rects);
+    writeRects(&m_rects);
+    pixelRegion.add(&iMove->region);
+  }
+
+  changedRegion->getRectVector(&m_rects);
+  writeRects(&m_rects);
+
+  // Rows of the pixel rectangles go one after another, the writer and the
+  // reader agree on the rectangles by the list written before them.
+  pixelRegion.getRectVector(&m_rects);
+  writeRects(&m_rects);
+  size_t bytesPerPixel = frameBuffer->getBytesPerPixel();
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = m_rects.begin(); iRect != m_rects.end(); iRect++) {
+    size_t rowSize = iRect->getWidth() * bytesPerPixel;
+    for (int y = iRect->top; y < iRect->bottom; y++) {
+      m_output.writeFully(frameBuffer->getBufferPtr(iRect->left, y), rowSize);
+    }
+  }
+}
+
+void UpdateTraceWriter::writeRects(const std::vector<Rect> *rects)
+{
+  m_rectData.clear();
+  RectSerializer::toBytes(rects, &m_rectData);
+  m_output.writeUInt32((UINT32)m_rectData.size());
+  m_output.writeFully(&m_rectData.front(), m_rectData.size());
+}
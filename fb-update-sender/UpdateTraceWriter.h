@@ -0,0 +1,85 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __UPDATETRACEWRITER_H__
+#define __UPDATETRACEWRITER_H__
+
+#include "rfb/FrameBuffer.h"
+#include "desktop/UpdateContainer.h"
+#include "file-lib/WinFileChannel.h"
+#include "io-lib/BufferedOutputStream.h"
+#include "io-lib/DataOutputStream.h"
+
+#include <vector>
+
+// Records the updates sent to a client, so that they can be replayed later
+// through the encoders by the encoder benchmark.
+//
+// The trace starts with MAGIC and VERSION. Every update is a record of the
+// FRAME type holding the framebuffer properties if they have changed, the
+// CopyRect moves, the changed region and the pixels of the changed region
+// and of the move destinations, the whole framebuffer after the properties
+// have changed. The END record terminates the trace. Rectangle lists are
+// written in the compact form of RectSerializer, after their size in bytes.
+class UpdateTraceWriter
+{
+public:
+  // Creates the trace file, throws Exception on failure.
+  UpdateTraceWriter(const TCHAR *fileName);
+  // Terminates the trace, errors are ignored.
+  virtual ~UpdateTraceWriter();
+
+  // Records one update, the framebuffer must already hold its pixels.
+  void writeFrame(const FrameBuffer *frameBuffer,
+                  const Region *changedRegion,
+                  const std::vector<CopyMove> *copies) throw(IOException);
+
+  static const UINT32 MAGIC = 0x43525455; // "UTRC"
+  static const UINT32 VERSION = 2;
+
+  // Record types.
+  static const UINT8 END = 0;
+  static const UINT8 FRAME = 1;
+
+  // Flags of a frame record.
+  static const UINT8 PROPERTIES_CHANGED = 1;
+
+private:
+  void writeRects(const std::vector<Rect> *rects) throw(IOException);
+
+  WinFileChannel m_file;
+  BufferedOutputStream m_bufOutput;
+  DataOutputStream m_output;
+
+  bool m_hasProperties;
+  Dimension m_dimension;
+  PixelFormat m_pixelFormat;
+
+  // Rectangles of the current record and their compact form, reused from
+  // record to record.
+  std::vector<Rect> m_rects;
+  std::vector<UINT8> m_rectData;
+};
+
+#endif // __UPDATETRACEWRITER_H__
@@ -0,0 +1,372 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "OverlappedFileChannel.h"
+#include "EOFException.h"
+#include "win-system/SystemException.h"
+#include "win-system/Environment.h"
+#include "util/MemAccount.h"
+
+OverlappedFileChannel::OverlappedFileChannel(const TCHAR *pathName,
+                                             DesiredAccess dAcc,
+                                             FileMode fMode,
+                                             bool sharedToRead,
+                                             bool unbuffered)
+: m_hFile(INVALID_HANDLE_VALUE),
+  m_isWriting(dAcc != F_READ),
+  m_isUnbuffered(unbuffered && dAcc == F_READ),
+  m_current(0),
+  m_position(0),
+  m_nextOffset(0),
+  m_needReadAhead(true),
+  m_isEofReached(false)
+{
+  memset(m_blocks, 0, sizeof(m_blocks));
+
+  DWORD fileFlags = FILE_FLAG_OVERLAPPED;
+  fileFlags |= m_isUnbuffered ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN;
+
+  m_winFile.open(pathName, dAcc, fMode, sharedToRead, fileFlags);
+  m_hFile = m_winFile.getHandle();
+
+  try {
+    if (fMode == FM_APPEND) {
+      m_nextOffset = getFileSize();
+    }
+
+    // Unbuffered I/O needs sector aligned buffers, virtual memory is
+    // aligned to pages.
+    for (size_t i = 0; i < QUEUE_LENGTH; i++) {
+      m_blocks[i].data = (char *)VirtualAlloc(NULL, BLOCK_SIZE,
+                                              MEM_COMMIT | MEM_RESERVE,
+                                              PAGE_READWRITE);
+      if (m_blocks[i].data == NULL) {
+        throw SystemException();
+      }
+      MemAccount::allocated(MEM_FILE_TRANSFER, BLOCK_SIZE);
+      m_blocks[i].overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+      if (m_blocks[i].overlapped.hEvent == NULL) {
+        throw SystemException();
+      }
+    }
+  } catch (...) {
+    freeBlocks();
+    m_winFile.close();
+    throw;
+  }
+}
+
+OverlappedFileChannel::~OverlappedFileChannel()
+{
+  try { close(); } catch (...) {}
+  freeBlocks();
+}
+
+void OverlappedFileChannel::seek(INT64 n)
+{
+  if (m_isWriting) {
+    flushWrites();
+  }
+
+  INT64 position = (INT64)(m_isWriting ? m_nextOffset : m_position) + n;
+  if (position < 0 || (UINT64)position > getFileSize()) {
+    throw IOException(_T("Specified file pointer position is more than file length"));
+  }
+
+  if (m_isWriting) {
+    m_nextOffset = position;
+  } else {
+    cancelReads();
+    m_position = position;
+    m_needReadAhead = true;
+  }
+}
+
+size_t OverlappedFileChannel::read(void *buffer, size_t len)
+{
+  if (m_isWriting) {
+    throw IOException(_T("The file is not opened for reading"));
+  }
+
+  if (m_needReadAhead) {
+    m_needReadAhead = false;
+    m_isEofReached = false;
+    m_current = 0;
+
+    // Unbuffered reads start from sector boundary, the bytes before
+    // the position are skipped.
+    size_t skip = m_isUnbuffered ? (size_t)(m_position % SECTOR_ALIGNMENT) : 0;
+    m_nextOffset = m_position - skip;
+
+    for (size_t i = 0; i < QUEUE_LENGTH; i++) {
+      startRead(&m_blocks[i]);
+    }
+    m_blocks[0].pos = skip;
+  }
+
+  char *out = (char *)buffer;
+  size_t total = 0;
+
+  while (total < len) {
+    Block *block = &m_blocks[m_current];
+    if (block->isPending) {
+      waitBlock(block);
+    }
+
+    if (block->pos >= block->size) {
+      // Short block is the last one.
+      if (block->size < BLOCK_SIZE) {
+        break;
+      }
+      // Reuse the block for next read-ahead.
+      startRead(block);
+      m_current = (m_current + 1) % QUEUE_LENGTH;
+      continue;
+    }
+
+    size_t portion = min(len - total, block->size - block->pos);
+    memcpy(out + total, block->data + block->pos, portion);
+    block->pos += portion;
+    total += portion;
+  }
+
+  if (total == 0 && len != 0) {
+    throw EOFException();
+  }
+
+  m_position += total;
+  return total;
+}
+
+size_t OverlappedFileChannel::write(const void *buffer, size_t len)
+{
+  if (!m_isWriting) {
+    throw IOException(_T("The file is not opened for writing"));
+  }
+
+  const char *in = (const char *)buffer;
+  size_t total = 0;
+
+  while (total < len) {
+    Block *block = &m_blocks[m_current];
+    // Wait until the previous data of the block are written.
+    if (block->isPending) {
+      waitBlock(block);
+    }
+
+    size_t portion = min(len - total, BLOCK_SIZE - block->size);
+    memcpy(block->data + block->size, in + total, portion);
+    block->size += portion;
+    total += portion;
+
+    if (block->size == BLOCK_SIZE) {
+      startWrite(block);
+      m_current = (m_current + 1) % QUEUE_LENGTH;
+    }
+  }
+  return len;
+}
+
+void OverlappedFileChannel::close()
+{
+  if (!m_winFile.isValid()) {
+    return;
+  }
+
+  try {
+    if (m_isWriting) {
+      flushWrites();
+    } else {
+      cancelReads();
+    }
+  } catch (...) {
+    m_winFile.close();
+    m_hFile = INVALID_HANDLE_VALUE;
+    throw;
+  }
+  m_winFile.close();
+  m_hFile = INVALID_HANDLE_VALUE;
+}
+
+void OverlappedFileChannel::startRead(Block *block)
+{
+  block->size = 0;
+  block->pos = 0;
+  block->isPending = false;
+
+  // Blocks after the end of file are left empty.
+  if (m_isEofReached) {
+    return;
+  }
+
+  OVERLAPPED *overlapped = &block->overlapped;
+  HANDLE event = overlapped->hEvent;
+  memset(overlapped, 0, sizeof(OVERLAPPED));
+  overlapped->hEvent = event;
+  overlapped->Offset = (DWORD)m_nextOffset;
+  overlapped->OffsetHigh = (DWORD)(m_nextOffset >> 32);
+  m_nextOffset += BLOCK_SIZE;
+
+  if (ReadFile(m_hFile, block->data, (DWORD)BLOCK_SIZE, NULL, overlapped) == 0) {
+    DWORD errCode = GetLastError();
+    if (errCode == ERROR_HANDLE_EOF) {
+      m_isEofReached = true;
+      return;
+    } else if (errCode != ERROR_IO_PENDING) {
+      throwError(errCode);
+    }
+  }
+  // The result of completed operation is taken by waitBlock() too.
+  block->isPending = true;
+}
+
+void OverlappedFileChannel::startWrite(Block *block)
+{
+  OVERLAPPED *overlapped = &block->overlapped;
+  HANDLE event = overlapped->hEvent;
+  memset(overlapped, 0, sizeof(OVERLAPPED));
+  overlapped->hEvent = event;
+  overlapped->Offset = (DWORD)m_nextOffset;
+  overlapped->OffsetHigh = (DWORD)(m_nextOffset >> 32);
+  m_nextOffset += block->size;
+
+  if (WriteFile(m_hFile, block->data, (DWORD)block->size, NULL, overlapped) == 0) {
+    DWORD errCode = GetLastError();
+    if (errCode != ERROR_IO_PENDING) {
+      block->size = 0;
+      throwError(errCode);
+    }
+  }
+  block->isPending = true;
+}
+
+void OverlappedFileChannel::waitBlock(Block *block)
+{
+  block->isPending = false;
+
+  DWORD transferred = 0;
+  if (GetOverlappedResult(m_hFile, &block->overlapped, &transferred, TRUE) == 0) {
+    DWORD errCode = GetLastError();
+    if (errCode != ERROR_HANDLE_EOF) {
+      block->size = 0;
+      throwError(errCode);
+    }
+    transferred = 0;
+  }
+
+  if (m_isWriting) {
+    bool isComplete = transferred == block->size;
+    block->size = 0;
+    if (!isComplete) {
+      throw IOException(_T("Cannot write all data to the file"));
+    }
+  } else {
+    block->size = transferred;
+    if (transferred < BLOCK_SIZE) {
+      m_isEofReached = true;
+    }
+  }
+}
+
+void OverlappedFileChannel::cancelReads()
+{
+  bool hasPending = false;
+  for (size_t i = 0; i < QUEUE_LENGTH; i++) {
+    hasPending = hasPending || m_blocks[i].isPending;
+  }
+  if (hasPending) {
+    CancelIo(m_hFile);
+  }
+
+  for (size_t i = 0; i < QUEUE_LENGTH; i++) {
+    Block *block = &m_blocks[i];
+    if (block->isPending) {
+      DWORD transferred;
+      GetOverlappedResult(m_hFile, &block->overlapped, &transferred, TRUE);
+      block->isPending = false;
+    }
+    block->size = 0;
+    block->pos = 0;
+  }
+}
+
+void OverlappedFileChannel::flushWrites()
+{
+  Block *current = &m_blocks[m_current];
+  if (!current->isPending && current->size > 0) {
+    startWrite(current);
+    m_current = (m_current + 1) % QUEUE_LENGTH;
+  }
+
+  // Wait for all blocks even if some of them failed.
+  StringStorage errorMessage;
+  bool hasError = false;
+  for (size_t i = 0; i < QUEUE_LENGTH; i++) {
+    if (m_blocks[i].isPending) {
+      try {
+        waitBlock(&m_blocks[i]);
+      } catch (IOException &e) {
+        if (!hasError) {
+          errorMessage.setString(e.getMessage());
+          hasError = true;
+        }
+      }
+    }
+  }
+  if (hasError) {
+    throw IOException(errorMessage.getString());
+  }
+}
+
+UINT64 OverlappedFileChannel::getFileSize()
+{
+  LARGE_INTEGER fileSize;
+  if (GetFileSizeEx(m_hFile, &fileSize) == 0) {
+    throwError(GetLastError());
+  }
+  return fileSize.QuadPart;
+}
+
+void OverlappedFileChannel::throwError(DWORD errCode)
+{
+  StringStorage errText;
+  SetLastError(errCode);
+  Environment::getErrStr(&errText);
+  throw IOException(errText.getString());
+}
+
+void OverlappedFileChannel::freeBlocks()
+{
+  for (size_t i = 0; i < QUEUE_LENGTH; i++) {
+    if (m_blocks[i].data != NULL) {
+      VirtualFree(m_blocks[i].data, 0, MEM_RELEASE);
+      MemAccount::freed(MEM_FILE_TRANSFER, BLOCK_SIZE);
+      m_blocks[i].data = NULL;
+    }
+    if (m_blocks[i].overlapped.hEvent != NULL) {
+      CloseHandle(m_blocks[i].overlapped.hEvent);
+      m_blocks[i].overlapped.hEvent = NULL;
+    }
+  }
+}
@@ -0,0 +1,137 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __OVERLAPPEDFILECHANNEL_H__
+#define __OVERLAPPEDFILECHANNEL_H__
+
+#include "FileChannel.h"
+#include "WinFile.h"
+
+// File channel that keeps several asynchronous (overlapped) disk operations
+// in flight, so the disk works while the caller is busy with the network.
+//
+// A channel opened for reading reads ahead the next blocks of the file.
+// A channel opened for writing collects written data to blocks and writes
+// them behind, write errors are reported by the next write(), seek() or
+// close() call.
+//
+// An unbuffered channel (only for reading) bypasses the system file cache
+// (FILE_FLAG_NO_BUFFERING), so reading of huge files does not push other
+// data out of the cache.
+//
+// The channel is sequential: data are read or written from the current
+// position only, use seek() to change it.
+class OverlappedFileChannel : public FileChannel
+{
+public:
+  // Opens or creates a file like WinFile does. Channel opened for reading
+  // (F_READ) can be read and unbuffered, other channels can be written only.
+  // @throw SystemException on fail.
+  OverlappedFileChannel(const TCHAR *pathName, DesiredAccess dAcc,
+                        FileMode fMode, bool sharedToRead = true,
+                        bool unbuffered = false);
+  virtual ~OverlappedFileChannel();
+
+  // Inherited from FileChannel.
+  virtual void seek(INT64 n);
+
+  // Inherited from Channel.
+  // Reads up to len bytes, less only at the end of file.
+  // @throw EOFException if there are no more data in the file.
+  virtual size_t read(void *buffer, size_t len);
+
+  // Inherited from Channel.
+  virtual size_t write(const void *buffer, size_t len);
+
+  // Inherited from Channel.
+  // Waits for the written data to be stored to the file.
+  virtual void close() throw(Exception);
+
+  // Current position of reading, and the file handle, for the system
+  // calls that read the file at the position themselves (such as
+  // TransmitFile()). The handle is overlapped and, if the channel is
+  // unbuffered, opened with FILE_FLAG_NO_BUFFERING. Use seek() to move
+  // past the data read so.
+  UINT64 getPosition() const { return m_position; }
+  HANDLE getHandle() const { return m_hFile; }
+  bool isUnbuffered() const { return m_isUnbuffered; }
+
+  // @throw IOException on fail.
+  UINT64 getFileSize();
+
+  // Size of one disk operation, multiple of a disk sector size.
+  static const size_t BLOCK_SIZE = 256 * 1024;
+  // Count of disk operations in flight.
+  static const size_t QUEUE_LENGTH = 4;
+  // Unbuffered file offsets are aligned to this value.
+  static const size_t SECTOR_ALIGNMENT = 4096;
+
+private:
+  struct Block
+  {
+    OVERLAPPED overlapped;
+    char *data;
+    // Count of valid (read) or collected (written) bytes.
+    size_t size;
+    // Count of bytes already given to the caller (reading only).
+    size_t pos;
+    bool isPending;
+  };
+
+  // Starts reading of the block at m_nextOffset.
+  void startRead(Block *block);
+  // Starts writing of collected block data at m_nextOffset.
+  void startWrite(Block *block);
+  // Waits for completion of the block operation.
+  // @throw IOException on fail.
+  void waitBlock(Block *block);
+  // Waits for all read-ahead blocks, throws nothing.
+  void cancelReads();
+  // Writes the collected data and waits for all blocks.
+  void flushWrites();
+
+  // @throw IOException with description of the system error.
+  void throwError(DWORD errCode);
+  void freeBlocks();
+
+  WinFile m_winFile;
+  HANDLE m_hFile;
+  bool m_isWriting;
+  bool m_isUnbuffered;
+
+  Block m_blocks[QUEUE_LENGTH];
+  // Block with the current position.
+  size_t m_current;
+
+  // Current position of reading.
+  UINT64 m_position;
+  // File offset of the next started block operation.
+  UINT64 m_nextOffset;
+  // Read-ahead is started from m_position on the next read().
+  bool m_needReadAhead;
+  // The end of file is reached by read-ahead.
+  bool m_isEofReached;
+};
+
+#endif // __OVERLAPPEDFILECHANNEL_H__
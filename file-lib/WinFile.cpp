@@ -49,7 +49,8 @@ WinFile::~WinFile()
 void WinFile::open(const TCHAR *pathToFile,
                    DesiredAccess dAcc,
                    FileMode fMode,
-                   bool shareToRead)
+                   bool shareToRead,
+                   DWORD fileFlags)
 {
   m_pathToFile.setString(pathToFile);
 
@@ -103,7 +104,7 @@ void WinFile::open(const TCHAR *pathToFile,
                        shareMode,
                        0,
                        creationDisposition,
-                       FILE_ATTRIBUTE_NORMAL,
+                       FILE_ATTRIBUTE_NORMAL | fileFlags,
                        0);
   if (!isValid()) {
     throw SystemException();
@@ -138,6 +139,11 @@ void WinFile::getPathName(StringStorage *pathName)
   *pathName = m_pathToFile;
 }
 
+HANDLE WinFile::getHandle()
+{
+  return m_hFile;
+}
+
 void WinFile::seek(INT64 n)
 {
   LARGE_INTEGER fileSize;
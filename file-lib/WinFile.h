@@ -70,8 +70,11 @@ public:
   virtual ~WinFile();
 
   // Call this function after this object creation by the default constructor.
+  // The fileFlags are FILE_FLAG_* values passed to CreateFile(), files
+  // opened with FILE_FLAG_OVERLAPPED cannot be read or written by this
+  // object.
   void open(const TCHAR *pathToFile, DesiredAccess dAcc, FileMode fMode,
-            bool shareToRead = false);
+            bool shareToRead = false, DWORD fileFlags = 0);
 
   // Closes handle to a file if handle is valid.
   void close();
@@ -90,6 +93,10 @@ public:
   // Return valid path name to a file.
   void getPathName(StringStorage *pathName);
 
+  // Returns handle of the opened file for the I/O that is not provided
+  // by this class.
+  HANDLE getHandle();
+
   // Set file pointer to specified position starting from current
   // file pointer position. Can move forward and backward.
   void seek(INT64 n);
@@ -29,7 +29,13 @@ CopyOperation::CopyOperation(LogWriter *logWriter)
   m_copyListener(0),
   m_totalBytesToCopy(0),
   m_totalBytesCopied(0),
-  m_toCopy(0)
+  m_toCopy(0),
+  m_windowSize(1),
+  m_requestsInFlight(0),
+  m_repliesToSkip(0),
+  m_recording(false),
+  m_recordUpload(false),
+  m_blockHashed(0)
 {
 }
 
@@ -41,3 +47,84 @@ void CopyOperation::setCopyProcessListener(CopyFileEventListener *listener)
 {
   m_copyListener = listener;
 }
+
+void CopyOperation::setWindowSize(UINT32 windowSize)
+{
+  m_windowSize = windowSize > 0 ? windowSize : 1;
+}
+
+void CopyOperation::dataRequestReplied()
+{
+  if (m_requestsInFlight > 0) {
+    m_requestsInFlight--;
+  }
+}
+
+void CopyOperation::abandonRequestsInFlight()
+{
+  m_repliesToSkip += m_requestsInFlight;
+  m_requestsInFlight = 0;
+}
+
+bool CopyOperation::skipAbandonedReply()
+{
+  if (m_repliesToSkip == 0) {
+    return false;
+  }
+  m_repliesToSkip--;
+  return true;
+}
+
+void CopyOperation::startRecording(bool upload, const FileInfo *sourceFileInfo,
+                                   size_t keptBlocks)
+{
+  m_recording = true;
+  m_recordUpload = upload;
+  m_recordSource.setString(m_pathToSourceFile.getString());
+  m_recordTarget.setString(m_pathToTargetFile.getString());
+  m_blockHash = XXHash64();
+  m_blockHashed = 0;
+
+  PartialTransferList::getInstance()->start(upload,
+                                            m_recordSource.getString(),
+                                            m_recordTarget.getString(),
+                                            sourceFileInfo->getSize(),
+                                            sourceFileInfo->lastModified(),
+                                            keptBlocks);
+}
+
+void CopyOperation::recordCopiedData(const void *data, size_t size)
+{
+  if (!m_recording) {
+    return;
+  }
+
+  const char *pos = (const char *)data;
+  while (size > 0) {
+    size_t portion = PartialTransferList::BLOCK_SIZE - m_blockHashed;
+    if (portion > size) {
+      portion = size;
+    }
+    m_blockHash.update(pos, portion);
+    m_blockHashed += (UINT32)portion;
+    pos += portion;
+    size -= portion;
+
+    // Only complete blocks are verified on resume
+    if (m_blockHashed == PartialTransferList::BLOCK_SIZE) {
+      PartialTransferList::getInstance()->addBlockChecksum(
+        m_recordUpload, m_recordSource.getString(), m_recordTarget.getString(),
+        PartialTransferList::getBlockChecksum(&m_blockHash));
+      m_blockHash = XXHash64();
+      m_blockHashed = 0;
+    }
+  }
+}
+
+void CopyOperation::forgetTransfer(bool upload)
+{
+  m_recording = false;
+  PartialTransferList::getInstance()->remove(upload,
+                                             m_pathToSourceFile.getString(),
+                                             m_pathToTargetFile.getString());
+}
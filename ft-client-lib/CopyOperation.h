@@ -27,6 +27,7 @@
 
 #include "FileTransferOperation.h"
 #include "CopyFileEventListener.h"
+#include "PartialTransferList.h"
 
 //
 // Abstract class that contain intersection of functionality
@@ -43,6 +44,38 @@ public:
   // Sets copy event listener
   void setCopyProcessListener(CopyFileEventListener *listener);
 
+  // Sets maximum count of data requests sent without waiting
+  // for their replies (1 by default, server must support
+  // windowed transfer for greater values).
+  void setWindowSize(UINT32 windowSize);
+
+protected:
+  // Counts reply to the oldest data request in flight
+  void dataRequestReplied();
+
+  // Marks data requests in flight as abandoned: their replies will be
+  // skipped when received
+  void abandonRequestsInFlight();
+
+  // Returns true (and counts it) if received reply must be skipped
+  // cause it's reply to abandoned request
+  bool skipAbandonedReply();
+
+  //
+  // Partial transfer helper methods.
+  //
+  // Remembers that copying of current file is started, so it can be
+  // continued if it's broken. First keptBlocks checksums of previous
+  // broken copying of the same file are kept.
+  void startRecording(bool upload, const FileInfo *sourceFileInfo,
+                      size_t keptBlocks);
+  // Adds data written to target file to block checksums of recorded
+  // copying.
+  void recordCopiedData(const void *data, size_t size);
+  // Forgets recorded copying of current file (when it's copied completely
+  // or can't be continued).
+  void forgetTransfer(bool upload);
+
 protected:
   // Information about file that currently coping
   FileInfoList *m_toCopy;
@@ -66,6 +99,22 @@ protected:
   // and how many left to copy
   UINT64 m_totalBytesToCopy;
   UINT64 m_totalBytesCopied;
+
+  // Maximum count of data requests in flight
+  UINT32 m_windowSize;
+  // Count of data requests sent but not replied yet
+  UINT32 m_requestsInFlight;
+  // Count of replies to requests that we don't need anymore
+  UINT32 m_repliesToSkip;
+
+  // True if copying of m_recordSource to m_recordTarget is recorded
+  bool m_recording;
+  bool m_recordUpload;
+  StringStorage m_recordSource;
+  StringStorage m_recordTarget;
+  // Hash of the last block written to target file and its size
+  XXHash64 m_blockHash;
+  UINT32 m_blockHashed;
 };
 
 #endif
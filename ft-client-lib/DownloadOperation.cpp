@@ -23,6 +23,7 @@
 //
 
 #include "DownloadOperation.h"
+#include "ft-common/FTMessage.h"
 
 DownloadOperation::DownloadOperation(LogWriter *logWriter,
                                      const FileInfo *filesToDownload,
@@ -33,7 +34,14 @@ DownloadOperation::DownloadOperation(LogWriter *logWriter,
   m_file(0),
   m_fos(0),
   m_fileOffset(0),
-  m_bufferSize(20000)
+  m_bytesToRequest(0),
+  m_bytesRequested(0),
+  m_endRequested(false),
+  m_treeSizeEnabled(false),
+  m_bufferSize(20000),
+  m_batchEnabled(false),
+  m_batchReplied(0),
+  m_skipBatch(false)
 {
   m_pathToSourceRoot.setString(pathToSourceRoot);
   m_pathToTargetRoot.setString(pathToTargetRoot);
@@ -57,6 +65,16 @@ DownloadOperation::~DownloadOperation()
   }
 }
 
+void DownloadOperation::setBatchTransfer(bool enabled)
+{
+  m_batchEnabled = enabled;
+}
+
+void DownloadOperation::setTreeSize(bool enabled)
+{
+  m_treeSizeEnabled = enabled;
+}
+
 void DownloadOperation::start()
 {
   m_foldersToCalcSizeLeft = 0;
@@ -129,19 +147,24 @@ void DownloadOperation::onDownloadReply(DataInputStream *input)
   }
 
   //
-  // Send first request for file data
+  // Send first requests for file data
   //
 
-  bool compression = m_replyBuffer->isCompressionSupported();
+  m_bytesRequested = 0;
+  m_endRequested = false;
 
-  m_sender->sendDownloadDataRequest((UINT32)m_bufferSize,
-                                    compression);
-  m_lastRequestTime = DateTime::now();
+  sendDataRequests();
 }
 
 void DownloadOperation::onDownloadDataReply(DataInputStream *input)
 {
+  if (skipAbandonedReply()) {
+    return ;
+  }
+  dataRequestReplied();
+
   if (isTerminating()) {
+    abandonRequestsInFlight();
     gotoNext();
     return ;
   }
@@ -151,8 +174,11 @@ void DownloadOperation::onDownloadDataReply(DataInputStream *input)
     if (!m_replyBuffer->getDownloadBuffer().empty()) {
       dos.writeFully(&m_replyBuffer->getDownloadBuffer().front(),
                      m_replyBuffer->getDownloadBufferSize());
+      recordCopiedData(&m_replyBuffer->getDownloadBuffer().front(),
+                       m_replyBuffer->getDownloadBufferSize());
     }
   } catch (IOException &ioEx) {
+    abandonRequestsInFlight();
     notifyFailedToDownload(ioEx.getMessage());
     gotoNext();
     return ;
@@ -169,11 +195,9 @@ void DownloadOperation::onDownloadDataReply(DataInputStream *input)
   }
 
   //
-  // Send next download data request
+  // Send next download data requests
   //
 
-  bool compression = m_replyBuffer->isCompressionSupported();
-  
   if ((DateTime::now() - m_lastRequestTime).getTime() > 300) {
     m_bufferSize /= 2; 
   } else {
@@ -185,12 +209,23 @@ void DownloadOperation::onDownloadDataReply(DataInputStream *input)
   if (m_bufferSize > 400000) {
     m_bufferSize = 400000;
   }
-  m_sender->sendDownloadDataRequest((UINT32)m_bufferSize, compression);
-  m_lastRequestTime = DateTime::now();
+  sendDataRequests();
 }
 
 void DownloadOperation::onDownloadEndReply(DataInputStream *input)
 {
+  if (skipAbandonedReply()) {
+    return ;
+  }
+  dataRequestReplied();
+
+  //
+  // Requests sent after this one (if file is shorter than expected)
+  // will be replied with "last request failed".
+  //
+
+  abandonRequestsInFlight();
+
   //
   // Cleanup
   //
@@ -208,11 +243,59 @@ void DownloadOperation::onDownloadEndReply(DataInputStream *input)
   delete m_file;
   m_file = NULL;
 
+  // File is downloaded completely
+  forgetTransfer(false);
+
   gotoNext();
 }
 
+void DownloadOperation::onBatchDownloadReply(DataInputStream *input)
+{
+  const std::vector<FileTransferReplyBuffer::BatchFile> *files =
+    m_replyBuffer->getBatchFiles();
+
+  for (size_t i = 0; i < files->size(); i++) {
+    const FileTransferReplyBuffer::BatchFile *batchFile = &(*files)[i];
+    if (batchFile->index >= m_batch.size()) {
+      continue;
+    }
+    m_batchReplied = max(m_batchReplied, (size_t)batchFile->index + 1);
+
+    if (!isTerminating()) {
+      writeBatchFile(batchFile);
+    }
+  }
+
+  if (m_replyBuffer->isBatchLastPage()) {
+    finishBatch();
+  }
+}
+
 void DownloadOperation::onLastRequestFailedReply(DataInputStream *input)
 {
+  if (skipAbandonedReply()) {
+    return ;
+  }
+
+  //
+  // Server cannot download files by batch, so get them one by one
+  //
+
+  if (!m_batch.empty()) {
+    StringStorage errDesc;
+    m_replyBuffer->getLastErrorMessage(&errDesc);
+
+    StringStorage message;
+    message.format(_T("Batch download is failed (%s), ")
+                   _T("files will be downloaded one by one"),
+                   errDesc.getString());
+    notifyInformation(message.getString());
+
+    m_batchEnabled = false;
+    finishBatch();
+    return ;
+  }
+
   //
   // This LRF message received from get folder size request
   // we do need to download next file
@@ -221,6 +304,10 @@ void DownloadOperation::onLastRequestFailedReply(DataInputStream *input)
   if (m_foldersToCalcSizeLeft > 0) {
     decFoldersToCalcSizeCount();
   } else {
+    // Failed request may be one of data requests in flight
+    dataRequestReplied();
+    abandonRequestsInFlight();
+
     // Logging
     StringStorage message;
 
@@ -239,6 +326,13 @@ void DownloadOperation::onDirSizeReply(DataInputStream *input)
   decFoldersToCalcSizeCount();
 }
 
+void DownloadOperation::onTreeOperationReply(DataInputStream *input)
+{
+  // Errors are folders that cannot be read, they will fail on downloading
+  m_totalBytesToCopy += m_replyBuffer->getTreeOperationResult()->totalSize;
+  decFoldersToCalcSizeCount();
+}
+
 void DownloadOperation::startDownload()
 {
   if (isTerminating()) {
@@ -272,12 +366,27 @@ void DownloadOperation::startDownload()
 
 void DownloadOperation::processFile()
 {
+  if (m_batchEnabled && !m_skipBatch && tryBatchDownload()) {
+    return ;
+  }
+  m_skipBatch = false;
+
   m_fileOffset = 0;
 
   File targetFile(m_pathToTargetFile.getString());
+  FileInfo *sourceFileInfo = m_toCopy->getFileInfo();
+
+  // Broken download of this file is continued without asking listener
+  UINT64 verifiedOffset = targetFile.exists() ? getVerifiedOffset(&targetFile) : 0;
+
+  if (verifiedOffset != 0) {
+    m_fileOffset = verifiedOffset;
 
-  if (targetFile.exists()) {
-    FileInfo *sourceFileInfo = m_toCopy->getFileInfo();
+    StringStorage message;
+    message.format(_T("Continuing download of '%s' from %I64u bytes"),
+                   m_pathToTargetFile.getString(), m_fileOffset);
+    notifyInformation(message.getString());
+  } else if (targetFile.exists()) {
     FileInfo targetFileInfo(&targetFile);
 
     //
@@ -307,10 +416,203 @@ void DownloadOperation::processFile()
     } // switch
   } // if target file exists
 
+  //
+  // Download is recorded to be continued if it's broken. Appended data
+  // is not checked by block checksums, so it can't be continued.
+  //
+
+  if (verifiedOffset != 0) {
+    startRecording(false, sourceFileInfo,
+                   (size_t)(verifiedOffset / PartialTransferList::BLOCK_SIZE));
+  } else if (m_fileOffset == 0) {
+    startRecording(false, sourceFileInfo, 0);
+  } else {
+    forgetTransfer(false);
+  }
+
+  UINT64 fileSize = m_toCopy->getFileInfo()->getSize();
+  m_bytesToRequest = fileSize > m_fileOffset ? fileSize - m_fileOffset : 0;
+
   // Send request that we want to download file
   m_sender->sendDownloadRequest(m_pathToSourceFile.getString(), m_fileOffset);
 }
 
+UINT64 DownloadOperation::getVerifiedOffset(File *targetFile)
+{
+  FileInfo *sourceFileInfo = m_toCopy->getFileInfo();
+
+  PartialTransferList::PartialTransfer transfer;
+  if (!PartialTransferList::getInstance()->find(false,
+                                                m_pathToSourceFile.getString(),
+                                                m_pathToTargetFile.getString(),
+                                                &transfer) ||
+      transfer.sourceSize != sourceFileInfo->getSize() ||
+      transfer.sourceModified != sourceFileInfo->lastModified() ||
+      targetFile->length() > transfer.sourceSize) {
+    return 0;
+  }
+
+  //
+  // Local file may be changed after download is broken, so its blocks
+  // are compared with checksums of received ones.
+  //
+
+  UINT64 offset = 0;
+  try {
+    StringStorage path;
+    targetFile->getPath(&path);
+    WinFileChannel fis(path.getString(), F_READ, FM_OPEN);
+    DataInputStream dis(&fis);
+
+    std::vector<char> block(PartialTransferList::BLOCK_SIZE);
+    for (size_t i = 0; i < transfer.blockChecksums.size(); i++) {
+      dis.readFully(&block.front(), block.size());
+
+      XXHash64 xxHash;
+      xxHash.update(&block.front(), block.size());
+      if (PartialTransferList::getBlockChecksum(&xxHash) !=
+          transfer.blockChecksums[i]) {
+        break;
+      }
+      offset += block.size();
+    }
+  } catch (IOException) {
+    // Verified part ends before end of file or read error
+  }
+  return offset;
+}
+
+bool DownloadOperation::tryBatchDownload()
+{
+  std::vector<FileInfoList *> batch;
+  std::vector<StringStorage> pathNames;
+  UINT64 batchSize = 0;
+
+  //
+  // Batch is run of small files in current folder. It ends before file
+  // that exists locally, cause the listener must decide what to do with it.
+  //
+
+  for (FileInfoList *fil = m_toCopy;
+       fil != NULL && batch.size() < BATCH_MAX_FILES;
+       fil = fil->getNext()) {
+    FileInfo *fileInfo = fil->getFileInfo();
+    if (fileInfo->isDirectory() ||
+        fileInfo->getSize() > BATCH_FILE_MAX_SIZE ||
+        batchSize + fileInfo->getSize() > BATCH_MAX_SIZE) {
+      break;
+    }
+
+    StringStorage localPath;
+    getLocalPath(fil, m_pathToTargetRoot.getString(), &localPath);
+    if (File(localPath.getString()).exists()) {
+      break;
+    }
+
+    StringStorage remotePath;
+    getRemotePath(fil, m_pathToSourceRoot.getString(), &remotePath);
+
+    batch.push_back(fil);
+    pathNames.push_back(remotePath);
+    batchSize += fileInfo->getSize();
+  }
+
+  if (batch.size() < BATCH_MIN_FILES) {
+    return false;
+  }
+
+  m_batch = batch;
+  m_batchReplied = 0;
+
+  _ASSERT((UINT32)pathNames.size() == pathNames.size());
+  m_sender->sendBatchDownloadRequest(&pathNames.front(),
+                                     (UINT32)pathNames.size(),
+                                     m_replyBuffer->isCompressionSupported());
+  return true;
+}
+
+void DownloadOperation::writeBatchFile(const FileTransferReplyBuffer::BatchFile *batchFile)
+{
+  changeFileToDownload(m_batch[batchFile->index]);
+
+  if (batchFile->status != FTMessage::BATCH_FILE_OK) {
+    notifyFailedToDownload(batchFile->errorMessage.getString());
+    return ;
+  }
+
+  File file(m_pathToTargetFile.getString());
+
+  try {
+    StringStorage path;
+    file.getPath(&path);
+
+    WinFileChannel fos(path.getString(), F_WRITE, FM_CREATE);
+    if (!batchFile->data.empty()) {
+      DataOutputStream dos(&fos);
+      dos.writeFully(&batchFile->data.front(), batchFile->data.size());
+    }
+    fos.close();
+  } catch (Exception &ioEx) {
+    notifyFailedToDownload(ioEx.getMessage());
+    return ;
+  }
+
+  if (!file.setLastModified(batchFile->lastModified)) {
+    notifyFailedToDownload(_T("Cannot set modification time"));
+  }
+
+  m_totalBytesCopied += batchFile->data.size();
+
+  if (m_copyListener != NULL) {
+    m_copyListener->dataChunkCopied(m_totalBytesCopied, m_totalBytesToCopy);
+  }
+}
+
+void DownloadOperation::finishBatch()
+{
+  std::vector<FileInfoList *> batch;
+  batch.swap(m_batch);
+
+  if (m_batchReplied < batch.size()) {
+    // Server has not packed this file, download it and the rest as usual
+    changeFileToDownload(batch[m_batchReplied]);
+    m_skipBatch = true;
+    startDownload();
+  } else {
+    changeFileToDownload(batch.back());
+    gotoNext();
+  }
+}
+
+void DownloadOperation::sendDataRequests()
+{
+  bool compression = m_replyBuffer->isCompressionSupported();
+
+  while (m_requestsInFlight < m_windowSize) {
+    UINT32 size = (UINT32)m_bufferSize;
+
+    if (m_bytesRequested < m_bytesToRequest) {
+      if (m_bytesToRequest - m_bytesRequested < (UINT64)size) {
+        size = (UINT32)(m_bytesToRequest - m_bytesRequested);
+      }
+      m_bytesRequested += size;
+    } else if (!m_endRequested || m_requestsInFlight == 0) {
+      //
+      // All expected data is requested, so this request will be
+      // replied with end of download (or with data if file has grown
+      // since its size was listed).
+      //
+      m_endRequested = true;
+    } else {
+      break;
+    }
+
+    m_sender->sendDownloadDataRequest(size, compression);
+    m_requestsInFlight++;
+  }
+  m_lastRequestTime = DateTime::now();
+}
+
 void DownloadOperation::processFolder()
 {
   File local(m_pathToTargetFile.getString());
@@ -374,6 +676,7 @@ void DownloadOperation::gotoNext()
 void DownloadOperation::tryCalcInputFilesSize()
 {
   FileInfoList *fil = m_toCopy;
+  std::vector<StringStorage> folders;
 
   while (fil != NULL) {
     if (fil->getFileInfo()->isDirectory()) {
@@ -388,13 +691,24 @@ void DownloadOperation::tryCalcInputFilesSize()
       }
       pathToFile.appendString(pathNoRoot.getString());
 
-      m_foldersToCalcSizeLeft++;
-      m_sender->sendFolderSizeRequest(pathToFile.getString());
+      if (m_treeSizeEnabled) {
+        folders.push_back(pathToFile);
+      } else {
+        m_foldersToCalcSizeLeft++;
+        m_sender->sendFolderSizeRequest(pathToFile.getString());
+      }
     } else {
       m_totalBytesToCopy += fil->getFileInfo()->getSize();
     }
     fil = fil->getNext();
   }
+
+  if (!folders.empty()) {
+    m_foldersToCalcSizeLeft = 1;
+    m_sender->sendTreeOperationRequest(FTMessage::TREE_SIZE,
+                                       &folders.front(),
+                                       (UINT32)folders.size());
+  }
 }
 
 void DownloadOperation::killOp()
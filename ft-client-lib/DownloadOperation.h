@@ -30,6 +30,8 @@
 #include "FileInfoList.h"
 #include "CopyOperation.h"
 
+#include <vector>
+
 //
 // File transfer operation class for downloading files (and file trees).
 //
@@ -56,6 +58,14 @@ public:
 
   virtual ~DownloadOperation();
 
+  // Enables download of small files by batches (server must support
+  // batch download).
+  void setBatchTransfer(bool enabled);
+
+  // Calculates size of all folders by single tree operation request
+  // (server must support tree operation requests).
+  void setTreeSize(bool enabled);
+
   //
   // Inherited from FileTransferOperation
   //
@@ -72,20 +82,41 @@ protected:
   virtual void onDownloadReply(DataInputStream *input) throw(IOException);
   virtual void onDownloadDataReply(DataInputStream *input) throw(IOException);
   virtual void onDownloadEndReply(DataInputStream *input) throw(IOException);
+  virtual void onBatchDownloadReply(DataInputStream *input) throw(IOException);
   virtual void onLastRequestFailedReply(DataInputStream *input) throw(IOException);
   virtual void onDirSizeReply(DataInputStream *input) throw(IOException);
+  virtual void onTreeOperationReply(DataInputStream *input) throw(IOException);
 
 private:
 
   // Starts download of current file (m_toCopy member)
   void startDownload() throw(IOException);
 
+  // Sends download data requests until window of requests
+  // in flight is full
+  void sendDataRequests() throw(IOException);
+
   // Starts download of file
   void processFile() throw(IOException);
 
+  // Returns offset of targetFile that current file download can be
+  // continued from: broken download of the same source file is recorded
+  // and the beginning of targetFile matches checksums of received blocks.
+  UINT64 getVerifiedOffset(File *targetFile);
+
   // Start download of folder
   void processFolder() throw(IOException);
 
+  // Requests current file and small files next to it at once.
+  // Returns false if there are too few files to batch.
+  bool tryBatchDownload() throw(IOException);
+
+  // Writes file received in batch download reply to local file system
+  void writeBatchFile(const FileTransferReplyBuffer::BatchFile *batchFile);
+
+  // Continues download after the last page of batch download reply
+  void finishBatch() throw(IOException);
+
   // Sets m_toCopy member to next file to download
   void gotoNext() throw(IOException);
 
@@ -117,14 +148,43 @@ protected:
   // Initial file offset for current download (broken downloads)
   UINT64 m_fileOffset;
 
+  // Expected count of bytes to download from m_fileOffset and count
+  // of bytes already requested
+  UINT64 m_bytesToRequest;
+  UINT64 m_bytesRequested;
+  // True if request that must be replied with end of download is sent
+  bool m_endRequested;
+
   // Helper member to know how many folders to download left
   // to get their file size
   UINT32 m_foldersToCalcSizeLeft;
+  // Size of folders is calculated by single tree operation
+  bool m_treeSizeEnabled;
 
   // request data size changes dynamicaly depends on request rate
   size_t m_bufferSize;
   DateTime m_lastRequestTime;
 
+  //
+  // Batch download members
+  //
+
+  bool m_batchEnabled;
+  // Files of batch download request in flight
+  std::vector<FileInfoList *> m_batch;
+  // Count of batch files replied (the rest ones are downloaded as usual)
+  size_t m_batchReplied;
+  // Current file is downloaded as usual even if it's small
+  bool m_skipBatch;
+
+  // Files of this size or smaller are downloaded by batches
+  static const UINT64 BATCH_FILE_MAX_SIZE = 64 * 1024;
+  // Maximal count of files and total size of one batch
+  static const size_t BATCH_MAX_FILES = 256;
+  static const UINT64 BATCH_MAX_SIZE = 4 * 1024 * 1024;
+  // Single file is downloaded as usual
+  static const size_t BATCH_MIN_FILES = 2;
+
 };
 
 #endif
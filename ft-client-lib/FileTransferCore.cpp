@@ -34,6 +34,7 @@
 
 #include "file-lib/File.h"
 #include "ft-common/FolderListener.h"
+#include "thread/AutoLock.h"
 
 FileTransferCore::FileTransferCore(LogWriter *logWriter,
                                    FileTransferRequestSender *sender,
@@ -43,7 +44,8 @@ FileTransferCore::FileTransferCore(LogWriter *logWriter,
   m_state(NOTHING_STATE),
   m_sender(sender), m_replyBuffer(replyBuffer),
   m_fileTransferListeners(ftListeners),
-  m_currentOperation(0)
+  m_currentOperation(0),
+  m_remoteFilesReceived(0)
 {
 }
 
@@ -104,10 +106,21 @@ vector<FileInfo> *FileTransferCore::getListRemoteFolder()
   return &m_remoteFilesInfo;
 }
 
+void FileTransferCore::takeRemoteFileListPage(vector<FileInfo> *page)
+{
+  AutoLock al(&m_remoteFilesPageLock);
+
+  page->insert(page->end(), m_remoteFilesPage.begin(), m_remoteFilesPage.end());
+  m_remoteFilesPage.clear();
+}
+
 void FileTransferCore::updateSupportedOperations(const vector<UINT32> *clientCaps,
                                                  const vector<UINT32> *serverCaps)
 {
   m_supportedOps = OperationSupport(*clientCaps, *serverCaps);
+
+  m_sender->setFileListPageSize(m_supportedOps.isPagedFileListSupported() ?
+                                FILE_LIST_PAGE_SIZE : 0);
 }
 
 void FileTransferCore::ftOpStarted(FileTransferOperation *sender)
@@ -171,6 +184,33 @@ void FileTransferCore::ftOpFinished(FileTransferOperation *sender)
   m_ftInterface->onFtOpFinished(m_state, 0);
 } // void
 
+void FileTransferCore::ftOpFileListPage(FileTransferOperation *sender)
+{
+  // Only file list operation shows the list to user, other operations
+  // wait for the whole list.
+  if (m_state != FILE_LIST_STATE) {
+    return;
+  }
+
+  UINT32 pageCount = m_replyBuffer->getFileListPageCount();
+  UINT32 totalCount = m_replyBuffer->getFileListTotalCount();
+
+  {
+    AutoLock al(&m_remoteFilesPageLock);
+
+    const FileInfo *page = m_replyBuffer->getFileListPage();
+    if (page != NULL) {
+      m_remoteFilesPage.insert(m_remoteFilesPage.end(), page, page + pageCount);
+    }
+    m_remoteFilesReceived += pageCount;
+  }
+
+  if (totalCount != 0) {
+    m_ftInterface->setProgress(1.0 * m_remoteFilesReceived / totalCount);
+  }
+  m_ftInterface->onFtFileListPage();
+}
+
 void FileTransferCore::ftOpErrorMessage(FileTransferOperation *sender,
                                         const TCHAR *message)
 {
@@ -224,6 +264,11 @@ void FileTransferCore::downloadOperation(const FileInfo *filesToDownload,
                                                  pathToTargetRoot,
                                                  pathToSourceRoot);
   dOp->setCopyProcessListener(this);
+  dOp->setBatchTransfer(m_supportedOps.isBatchDownloadSupported());
+  dOp->setTreeSize(m_supportedOps.isTreeOperationSupported());
+  if (m_supportedOps.isWindowedTransferSupported()) {
+    dOp->setWindowSize(TRANSFER_WINDOW_SIZE);
+  }
   executeOperation(dOp);
 }
 
@@ -240,6 +285,13 @@ void FileTransferCore::uploadOperation(const FileInfo *filesToDownload,
                                              pathToSourceRoot,
                                              pathToTargetRoot);
   uOp->setCopyProcessListener(this);
+  uOp->setDeltaTransfer(m_supportedOps.isMD5Supported() ||
+                        m_supportedOps.isChecksumSupported());
+  uOp->setFastChecksum(m_supportedOps.isChecksumSupported());
+  uOp->setTreeMkdir(m_supportedOps.isTreeOperationSupported());
+  if (m_supportedOps.isWindowedTransferSupported()) {
+    uOp->setWindowSize(TRANSFER_WINDOW_SIZE);
+  }
   executeOperation(uOp);
 }
 
@@ -258,9 +310,13 @@ void FileTransferCore::remoteFilesDeleteOperation(const FileInfo *filesInfoToDel
                                                  const TCHAR *pathToTargetRoot)
 {
   m_state = REMOVE_STATE;
-  executeOperation(new RemoteFilesDeleteOperation(m_logWriter,
-                                                  filesInfoToDelete, filesCount,
-                                                  pathToTargetRoot));
+
+  RemoteFilesDeleteOperation *rmOp = new RemoteFilesDeleteOperation(m_logWriter,
+                                                                    filesInfoToDelete,
+                                                                    filesCount,
+                                                                    pathToTargetRoot);
+  rmOp->setTreeDelete(m_supportedOps.isTreeOperationSupported());
+  executeOperation(rmOp);
 }
 
 void FileTransferCore::remoteFolderCreateOperation(FileInfo file, const TCHAR *pathToTargetRoot)
@@ -286,6 +342,14 @@ void FileTransferCore::remoteFileRenameOperation(FileInfo sourceFileInfo,
 void FileTransferCore::remoteFileListOperation(const TCHAR *pathToFile)
 {
   m_state = FILE_LIST_STATE;
+
+  {
+    AutoLock al(&m_remoteFilesPageLock);
+
+    m_remoteFilesPage.clear();
+    m_remoteFilesReceived = 0;
+  }
+
   executeOperation(new RemoteFileListOperation(m_logWriter, pathToFile));
 }
 
@@ -38,6 +38,8 @@
 
 #include "FileTransferInterface.h"
 
+#include "thread/LocalMutex.h"
+
 class FileTransferInterface;
 
 class FileTransferCore : public OperationEventListener,
@@ -66,6 +68,14 @@ public:
   vector<FileInfo> *getListLocalFolder(const TCHAR *pathToFile);
   vector<FileInfo> *getListRemoteFolder();
 
+  //
+  // Moves files of remote file list pages received since the last call
+  // to the end of page vector. Can be called from any thread while
+  // remote file list operation is executing.
+  //
+
+  void takeRemoteFileListPage(vector<FileInfo> *page);
+
   void downloadOperation(const FileInfo *filesToDownload,
                          size_t filesCount,
                          const TCHAR *pathToTargetRoot,
@@ -114,6 +124,7 @@ protected:
 
   virtual void ftOpStarted(FileTransferOperation *sender);
   virtual void ftOpFinished(FileTransferOperation *sender) throw(IOException);
+  virtual void ftOpFileListPage(FileTransferOperation *sender);
   virtual void ftOpErrorMessage(FileTransferOperation *sender, const TCHAR *message);
   virtual void ftOpInfoMessage(FileTransferOperation *sender,
                                const TCHAR *message);
@@ -161,12 +172,31 @@ protected:
 
   OperationSupport m_supportedOps;
 
+  //
+  // Count of data requests in flight for download and upload
+  // when server supports windowed transfer.
+  //
+
+  static const UINT32 TRANSFER_WINDOW_SIZE = 8;
+
+  //
+  // Count of files in one page of remote file list when server
+  // supports paged file lists.
+  //
+
+  static const UINT32 FILE_LIST_PAGE_SIZE = 256;
+
   //
   // File list request variables
   //
 
   vector <FileInfo> m_remoteFilesInfo;
 
+  // Pages of remote file list not taken by the interface yet.
+  vector <FileInfo> m_remoteFilesPage;
+  UINT32 m_remoteFilesReceived;
+  LocalMutex m_remoteFilesPageLock;
+
   //
   // Local file list variables
   //
@@ -43,11 +43,31 @@ void FileTransferEventAdapter::onFileListReply(DataInputStream *input)
   throw OperationNotPermittedException();
 }
 
+void FileTransferEventAdapter::onFileListPageReply(DataInputStream *input)
+{
+  throw OperationNotPermittedException();
+}
+
+void FileTransferEventAdapter::onBatchDownloadReply(DataInputStream *input)
+{
+  throw OperationNotPermittedException();
+}
+
 void FileTransferEventAdapter::onMd5DataReply(DataInputStream *input)
 {
   throw OperationNotPermittedException();
 }
 
+void FileTransferEventAdapter::onChecksumReply(DataInputStream *input)
+{
+  throw OperationNotPermittedException();
+}
+
+void FileTransferEventAdapter::onChecksumProgressReply(DataInputStream *input)
+{
+  throw OperationNotPermittedException();
+}
+
 void FileTransferEventAdapter::onUploadReply(DataInputStream *input)
 {
   throw OperationNotPermittedException();
@@ -98,6 +118,16 @@ void FileTransferEventAdapter::onDirSizeReply(DataInputStream *input)
   throw OperationNotPermittedException();
 }
 
+void FileTransferEventAdapter::onTreeOperationReply(DataInputStream *input)
+{
+  throw OperationNotPermittedException();
+}
+
+void FileTransferEventAdapter::onTreeOperationProgressReply(DataInputStream *input)
+{
+  throw OperationNotPermittedException();
+}
+
 void FileTransferEventAdapter::onLastRequestFailedReply(DataInputStream *input)
 {
   throw OperationNotPermittedException();
@@ -49,7 +49,11 @@ public:
 
   virtual void onCompressionSupportReply(DataInputStream *input) throw(OperationNotPermittedException);
   virtual void onFileListReply(DataInputStream *input) throw(OperationNotPermittedException);
+  virtual void onFileListPageReply(DataInputStream *input) throw(OperationNotPermittedException);
+  virtual void onBatchDownloadReply(DataInputStream *input) throw(OperationNotPermittedException);
   virtual void onMd5DataReply(DataInputStream *input) throw(OperationNotPermittedException);
+  virtual void onChecksumReply(DataInputStream *input) throw(OperationNotPermittedException);
+  virtual void onChecksumProgressReply(DataInputStream *input) throw(OperationNotPermittedException);
 
   virtual void onUploadReply(DataInputStream *input) throw(OperationNotPermittedException);
   virtual void onUploadDataReply(DataInputStream *input) throw(OperationNotPermittedException);
@@ -64,6 +68,8 @@ public:
   virtual void onMvReply(DataInputStream *input) throw(OperationNotPermittedException);
 
   virtual void onDirSizeReply(DataInputStream *input) throw(OperationNotPermittedException);
+  virtual void onTreeOperationReply(DataInputStream *input) throw(OperationNotPermittedException);
+  virtual void onTreeOperationProgressReply(DataInputStream *input) throw(OperationNotPermittedException);
   virtual void onLastRequestFailedReply(DataInputStream *input) throw(OperationNotPermittedException);
 };
 
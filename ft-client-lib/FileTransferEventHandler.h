@@ -43,7 +43,11 @@ public:
 
   virtual void onCompressionSupportReply(DataInputStream *input) = 0;
   virtual void onFileListReply(DataInputStream *input) = 0;
+  virtual void onFileListPageReply(DataInputStream *input) = 0;
+  virtual void onBatchDownloadReply(DataInputStream *input) = 0;
   virtual void onMd5DataReply(DataInputStream *input) = 0;
+  virtual void onChecksumReply(DataInputStream *input) = 0;
+  virtual void onChecksumProgressReply(DataInputStream *input) = 0;
 
   virtual void onUploadReply(DataInputStream *input) = 0;
   virtual void onUploadDataReply(DataInputStream *input) = 0;
@@ -58,6 +62,8 @@ public:
   virtual void onMvReply(DataInputStream *input) = 0;
 
   virtual void onDirSizeReply(DataInputStream *input) = 0;
+  virtual void onTreeOperationReply(DataInputStream *input) = 0;
+  virtual void onTreeOperationProgressReply(DataInputStream *input) = 0;
   virtual void onLastRequestFailedReply(DataInputStream *input) = 0;
 };
 
@@ -55,6 +55,13 @@ public:
   virtual void onFtOpStarted() = 0;
   virtual void onFtOpFinished(int state, int result) = 0;
 
+  //
+  // Called when next page of remote file list is received, the files
+  // can be taken by FileTransferCore::takeRemoteFileListPage().
+  // This function must be is not blocking, otherwise it may happen deadlock.
+  //
+  virtual void onFtFileListPage() = 0;
+
   //
   // filetransfer's operation is finished. Need update of control
   //
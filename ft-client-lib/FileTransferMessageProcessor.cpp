@@ -51,6 +51,9 @@ void FileTransferMessageProcessor::processRfbMessage(DataInputStream *input,
     case FTMessage::FILE_LIST_REPLY:
       listener->onFileListReply(input);
       break;
+    case FTMessage::FILE_LIST_PAGE_REPLY:
+      listener->onFileListPageReply(input);
+      break;
     case FTMessage::DOWNLOAD_START_REPLY:
       listener->onDownloadReply(input);
       break;
@@ -60,6 +63,9 @@ void FileTransferMessageProcessor::processRfbMessage(DataInputStream *input,
     case FTMessage::DOWNLOAD_END_REPLY:
       listener->onDownloadEndReply(input);
       break;
+    case FTMessage::FILE_BATCH_DOWNLOAD_REPLY:
+      listener->onBatchDownloadReply(input);
+      break;
     case FTMessage::UPLOAD_START_REPLY:
       listener->onUploadReply(input);
       break;
@@ -72,9 +78,21 @@ void FileTransferMessageProcessor::processRfbMessage(DataInputStream *input,
     case FTMessage::MD5_REPLY:
       listener->onMd5DataReply(input);
       break;
+    case FTMessage::CHECKSUM_REPLY:
+      listener->onChecksumReply(input);
+      break;
+    case FTMessage::CHECKSUM_PROGRESS_REPLY:
+      listener->onChecksumProgressReply(input);
+      break;
     case FTMessage::DIRSIZE_REPLY:
       listener->onDirSizeReply(input);
       break;
+    case FTMessage::TREE_OPERATION_REPLY:
+      listener->onTreeOperationReply(input);
+      break;
+    case FTMessage::TREE_OPERATION_PROGRESS_REPLY:
+      listener->onTreeOperationProgressReply(input);
+      break;
     case FTMessage::RENAME_REPLY:
       listener->onMvReply(input);
       break;
@@ -52,6 +52,23 @@ void FileTransferOperation::terminate()
   m_isTerminating = true;
 }
 
+void FileTransferOperation::onFileListPageReply(DataInputStream *input)
+{
+  if (m_replyBuffer->isFileListComplete()) {
+    onFileListReply(input);
+  } else {
+    notifyFileListPage();
+  }
+}
+
+void FileTransferOperation::onChecksumProgressReply(DataInputStream *input)
+{
+}
+
+void FileTransferOperation::onTreeOperationProgressReply(DataInputStream *input)
+{
+}
+
 bool FileTransferOperation::isTerminating()
 {
   return m_isTerminating;
@@ -79,6 +96,17 @@ void FileTransferOperation::notifyFinish()
   }
 }
 
+void FileTransferOperation::notifyFileListPage()
+{
+  AutoLock al(&m_listeners);
+
+  vector<OperationEventListener *>::iterator it;
+  for (it = m_listeners.begin(); it != m_listeners.end(); it++) {
+    OperationEventListener *l = *it;
+    l->ftOpFileListPage(this);
+  }
+}
+
 void FileTransferOperation::notifyError(const TCHAR *message)
 {
   m_logWriter->message(_T("%s\n"), message);
@@ -79,6 +79,29 @@ public:
 
   virtual void terminate();
 
+  //
+  // Handler of paged file list reply. Reply buffer collects the pages,
+  // after the last one the list is handled by onFileListReply() like
+  // ordinary file list reply, so operations do not care about the
+  // way the file list is received. Listeners are notified about
+  // every other page.
+  //
+
+  virtual void onFileListPageReply(DataInputStream *input);
+
+  //
+  // Progress of long checksum computation is informational only,
+  // operations ignore it by default.
+  //
+
+  virtual void onChecksumProgressReply(DataInputStream *input);
+
+  //
+  // Progress of tree operation is ignored by default too.
+  //
+
+  virtual void onTreeOperationProgressReply(DataInputStream *input);
+
 protected:
 
   //
@@ -103,6 +126,12 @@ protected:
 
   void notifyFinish();
 
+  //
+  // Notify all listeners that next page of file list is received.
+  //
+
+  void notifyFileListPage();
+
   //
   // Notify all listeners that was error during operation execution
   //
@@ -25,17 +25,29 @@
 #include "FileTransferReplyBuffer.h"
 #include "io-lib/ByteArrayInputStream.h"
 #include "thread/AutoLock.h"
+#include "ft-common/FTMessage.h"
 #include <crtdbg.h>
+#include <algorithm>
 
 FileTransferReplyBuffer::FileTransferReplyBuffer(LogWriter *logWriter)
 : m_logWriter(logWriter),
   m_isCompressionSupported(false),
   m_filesInfoCount(0), m_filesInfo(NULL),
+  m_lastPageOffset(0), m_fileListTotalCount(0), m_isFileListComplete(true),
   m_downloadBufferSize(0), 
   m_downloadFileFlags(0), m_downloadLastModified(0),
-  m_dirSize(0)
+  m_isBatchLastPage(true),
+  m_dirSize(0),
+  m_checksumAlgorithm(0), m_checksumProgress(0)
 {
   m_lastErrorMessage.setString(_T(""));
+  memset(m_md5Hash, 0, sizeof(m_md5Hash));
+
+  m_treeOperationResult.operation = 0;
+  m_treeOperationResult.filesCount = 0;
+  m_treeOperationResult.foldersCount = 0;
+  m_treeOperationResult.totalSize = 0;
+  m_treeOperationResult.errorsCount = 0;
 }
 
 FileTransferReplyBuffer::~FileTransferReplyBuffer()
@@ -65,6 +77,29 @@ FileInfo *FileTransferReplyBuffer::getFilesInfo()
   return m_filesInfo;
 }
 
+bool FileTransferReplyBuffer::isFileListComplete()
+{
+  return m_isFileListComplete;
+}
+
+UINT32 FileTransferReplyBuffer::getFileListTotalCount()
+{
+  return m_fileListTotalCount;
+}
+
+UINT32 FileTransferReplyBuffer::getFileListPageCount()
+{
+  return (UINT32)(m_pagedFilesInfo.size() - m_lastPageOffset);
+}
+
+const FileInfo *FileTransferReplyBuffer::getFileListPage()
+{
+  if (m_lastPageOffset >= m_pagedFilesInfo.size()) {
+    return NULL;
+  }
+  return &m_pagedFilesInfo[m_lastPageOffset];
+}
+
 UINT32 FileTransferReplyBuffer::getDownloadBufferSize()
 {
   return m_downloadBufferSize;
@@ -80,11 +115,46 @@ UINT64 FileTransferReplyBuffer::getDownloadLastModified()
   return m_downloadLastModified;
 }
 
+bool FileTransferReplyBuffer::isBatchLastPage()
+{
+  return m_isBatchLastPage;
+}
+
+const vector<FileTransferReplyBuffer::BatchFile> *FileTransferReplyBuffer::getBatchFiles()
+{
+  return &m_batchFiles;
+}
+
 UINT64 FileTransferReplyBuffer::getDirSize()
 {
   return m_dirSize;
 }
 
+const UINT8 *FileTransferReplyBuffer::getMd5Hash()
+{
+  return m_md5Hash;
+}
+
+UINT8 FileTransferReplyBuffer::getChecksumAlgorithm()
+{
+  return m_checksumAlgorithm;
+}
+
+const vector<UINT8> *FileTransferReplyBuffer::getChecksum()
+{
+  return &m_checksum;
+}
+
+UINT64 FileTransferReplyBuffer::getChecksumProgress()
+{
+  return m_checksumProgress;
+}
+
+const FileTransferReplyBuffer::TreeOperationResult *FileTransferReplyBuffer::getTreeOperationResult()
+{
+  return &m_treeOperationResult;
+}
+
 vector<UINT8> FileTransferReplyBuffer::getDownloadBuffer()
 {
   return m_downloadBuffer;
@@ -133,18 +203,7 @@ void FileTransferReplyBuffer::onFileListReply(DataInputStream *input)
       m_filesInfo = new FileInfo[m_filesInfoCount];
     }
 
-    for (UINT32 i = 0; i < m_filesInfoCount; i++) {
-      FileInfo *fileInfo = &m_filesInfo[i];
-
-      fileInfo->setSize(filesInfoReader.readUInt64());
-      fileInfo->setLastModified(filesInfoReader.readUInt64());
-      fileInfo->setFlags(filesInfoReader.readUInt16());
-
-      StringStorage t;
-      filesInfoReader.readUTF8(&t);
-
-      fileInfo->setFileName(t.getString());
-    } // for all newly created file's info
+    readFilesInfo(&filesInfoReader, m_filesInfoCount, m_filesInfo);
 
     m_logWriter->info(_T("Received file list reply: \n")
                       _T("\t files count = %d\n")
@@ -156,9 +215,106 @@ void FileTransferReplyBuffer::onFileListReply(DataInputStream *input)
   }
 }
 
+void FileTransferReplyBuffer::onFileListPageReply(DataInputStream *input)
+{
+  UINT8 pageFlags = 0;
+  UINT32 totalCount = 0;
+  UINT8 compressionLevel = 0;
+  UINT32 compressedSize = 0;
+  UINT32 uncompressedSize = 0;
+
+  vector<UINT8> buffer;
+
+  {
+    pageFlags = input->readUInt8();
+    totalCount = input->readUInt32();
+
+    compressionLevel = input->readUInt8();
+    compressedSize = input->readUInt32();
+    uncompressedSize = input->readUInt32();
+
+    buffer = readCompressedDataBlock(input,
+                                     compressedSize,
+                                     uncompressedSize,
+                                     compressionLevel);
+  }
+
+  // First page of new list.
+  if (m_isFileListComplete) {
+    m_pagedFilesInfo.clear();
+    m_isFileListComplete = false;
+  }
+  m_fileListTotalCount = totalCount;
+  m_lastPageOffset = m_pagedFilesInfo.size();
+
+  if (!buffer.empty()) {
+    ByteArrayInputStream memoryInputStream(reinterpret_cast<char *>(&buffer.front()),
+                                           uncompressedSize);
+    DataInputStream filesInfoReader(&memoryInputStream);
+
+    UINT32 pageCount = filesInfoReader.readUInt32();
+    if (pageCount != 0) {
+      m_pagedFilesInfo.resize(m_lastPageOffset + pageCount);
+      readFilesInfo(&filesInfoReader, pageCount, &m_pagedFilesInfo[m_lastPageOffset]);
+    }
+  }
+
+  if ((pageFlags & FTMessage::LAST_PAGE) == 0) {
+    return;
+  }
+
+  //
+  // Whole list is received, give it out like ordinary file list reply.
+  //
+
+  if (m_filesInfo != 0) {
+    delete[] m_filesInfo;
+    m_filesInfo = 0;
+  }
+
+  _ASSERT((UINT32)m_pagedFilesInfo.size() == m_pagedFilesInfo.size());
+  m_filesInfoCount = (UINT32)m_pagedFilesInfo.size();
+  if (m_filesInfoCount != 0) {
+    m_filesInfo = new FileInfo[m_filesInfoCount];
+    std::copy(m_pagedFilesInfo.begin(), m_pagedFilesInfo.end(), m_filesInfo);
+  }
+
+  vector<FileInfo>().swap(m_pagedFilesInfo);
+  m_lastPageOffset = 0;
+  m_isFileListComplete = true;
+
+  m_logWriter->info(_T("Received paged file list reply: \n")
+                    _T("\t files count = %d\n")
+                    _T("\t use compression = %d\n"),
+                    m_filesInfoCount, compressionLevel);
+}
+
 void FileTransferReplyBuffer::onMd5DataReply(DataInputStream *input)
 {
-  throw OperationNotSupportedException();
+  input->readFully(m_md5Hash, sizeof(m_md5Hash));
+
+  m_logWriter->info(_T("Received md5 reply\n"));
+}
+
+void FileTransferReplyBuffer::onChecksumReply(DataInputStream *input)
+{
+  m_checksumAlgorithm = input->readUInt8();
+  m_checksum.resize(input->readUInt8());
+  if (!m_checksum.empty()) {
+    input->readFully(&m_checksum.front(), m_checksum.size());
+  }
+  m_checksumProgress = 0;
+
+  m_logWriter->info(_T("Received checksum reply (algorithm = %d)\n"),
+                    m_checksumAlgorithm);
+}
+
+void FileTransferReplyBuffer::onChecksumProgressReply(DataInputStream *input)
+{
+  m_checksumProgress = input->readUInt64();
+
+  m_logWriter->info(_T("Received checksum progress reply: %I64u bytes\n"),
+                    m_checksumProgress);
 }
 
 void FileTransferReplyBuffer::onUploadReply(DataInputStream *input)
@@ -208,6 +364,66 @@ void FileTransferReplyBuffer::onDownloadEndReply(DataInputStream *input)
                     m_downloadFileFlags, m_downloadLastModified);
 }
 
+void FileTransferReplyBuffer::onBatchDownloadReply(DataInputStream *input)
+{
+  UINT8 pageFlags = 0;
+  UINT8 compressionLevel = 0;
+  UINT32 compressedSize = 0;
+  UINT32 uncompressedSize = 0;
+
+  vector<UINT8> buffer;
+
+  {
+    pageFlags = input->readUInt8();
+
+    compressionLevel = input->readUInt8();
+    compressedSize = input->readUInt32();
+    uncompressedSize = input->readUInt32();
+
+    buffer = readCompressedDataBlock(input,
+                                     compressedSize,
+                                     uncompressedSize,
+                                     compressionLevel);
+  }
+
+  m_batchFiles.clear();
+  m_isBatchLastPage = (pageFlags & FTMessage::LAST_PAGE) != 0;
+
+  if (!buffer.empty()) {
+    ByteArrayInputStream memoryInputStream(reinterpret_cast<char *>(&buffer.front()),
+                                           uncompressedSize);
+    DataInputStream filesReader(&memoryInputStream);
+
+    UINT32 filesCount = filesReader.readUInt32();
+    m_batchFiles.resize(filesCount);
+
+    for (UINT32 i = 0; i < filesCount; i++) {
+      BatchFile *file = &m_batchFiles[i];
+
+      file->index = filesReader.readUInt32();
+      file->status = filesReader.readUInt8();
+      file->lastModified = 0;
+
+      if (file->status == FTMessage::BATCH_FILE_OK) {
+        file->lastModified = filesReader.readUInt64();
+        file->data.resize(filesReader.readUInt32());
+        if (!file->data.empty()) {
+          filesReader.readFully(&file->data.front(), file->data.size());
+        }
+      } else {
+        filesReader.readUTF8(&file->errorMessage);
+      }
+    }
+  }
+
+  m_logWriter->info(_T("Received batch download reply:\n")
+                    _T("\tfiles count: %d\n")
+                    _T("\tlast page: %d\n")
+                    _T("\tuse compression: %d\n"),
+                    (UINT32)m_batchFiles.size(), m_isBatchLastPage ? 1 : 0,
+                    compressionLevel);
+}
+
 void FileTransferReplyBuffer::onMkdirReply(DataInputStream *input)
 {
   m_logWriter->info(_T("Received mkdir reply\n"));
@@ -230,15 +446,70 @@ void FileTransferReplyBuffer::onDirSizeReply(DataInputStream *input)
   m_logWriter->info(_T("Received dirsize reply\n"));
 }
 
+void FileTransferReplyBuffer::onTreeOperationReply(DataInputStream *input)
+{
+  m_treeOperationResult.operation = input->readUInt8();
+  m_treeOperationResult.filesCount = input->readUInt64();
+  m_treeOperationResult.foldersCount = input->readUInt64();
+  m_treeOperationResult.totalSize = input->readUInt64();
+  m_treeOperationResult.errorsCount = input->readUInt32();
+  input->readUTF8(&m_treeOperationResult.firstError);
+
+  m_logWriter->info(_T("Received tree operation reply:\n")
+                    _T("\t operation = %d\n")
+                    _T("\t files count = %I64u\n")
+                    _T("\t folders count = %I64u\n")
+                    _T("\t total size = %I64u\n")
+                    _T("\t errors count = %u\n"),
+                    (int)m_treeOperationResult.operation,
+                    m_treeOperationResult.filesCount,
+                    m_treeOperationResult.foldersCount,
+                    m_treeOperationResult.totalSize,
+                    m_treeOperationResult.errorsCount);
+}
+
+void FileTransferReplyBuffer::onTreeOperationProgressReply(DataInputStream *input)
+{
+  m_treeOperationResult.filesCount = input->readUInt64();
+  m_treeOperationResult.foldersCount = input->readUInt64();
+  m_treeOperationResult.totalSize = input->readUInt64();
+
+  m_logWriter->info(_T("Received tree operation progress reply: ")
+                    _T("%I64u files, %I64u folders\n"),
+                    m_treeOperationResult.filesCount,
+                    m_treeOperationResult.foldersCount);
+}
+
 void FileTransferReplyBuffer::onLastRequestFailedReply(DataInputStream *input)
 {
   input->readUTF8(&m_lastErrorMessage);
 
+  // Paged file list (if any) is broken.
+  m_isFileListComplete = true;
+
   m_logWriter->info(_T("Received last request failed reply:\n")
                     _T("\terror message: %s\n"),
                     m_lastErrorMessage.getString());
 }
 
+void FileTransferReplyBuffer::readFilesInfo(DataInputStream *input,
+                                            UINT32 count,
+                                            FileInfo *filesInfo)
+{
+  for (UINT32 i = 0; i < count; i++) {
+    FileInfo *fileInfo = &filesInfo[i];
+
+    fileInfo->setSize(input->readUInt64());
+    fileInfo->setLastModified(input->readUInt64());
+    fileInfo->setFlags(input->readUInt16());
+
+    StringStorage t;
+    input->readUTF8(&t);
+
+    fileInfo->setFileName(t.getString());
+  } // for all newly created file's info
+}
+
 vector<UINT8> FileTransferReplyBuffer::readCompressedDataBlock(DataInputStream *input,
                                                                UINT32 compressedSize,
                                                                UINT32 uncompressedSize,
@@ -39,6 +39,30 @@
 
 class FileTransferReplyBuffer : public FileTransferEventHandler
 {
+public:
+  // File received in batch download reply.
+  struct BatchFile
+  {
+    // Index of file in batch download request.
+    UINT32 index;
+    // FTMessage::BATCH_FILE_OK or FTMessage::BATCH_FILE_FAILED.
+    UINT8 status;
+    UINT64 lastModified;
+    vector<UINT8> data;
+    StringStorage errorMessage;
+  };
+
+  // Result (or progress) of tree operation.
+  struct TreeOperationResult
+  {
+    UINT8 operation;
+    UINT64 filesCount;
+    UINT64 foldersCount;
+    UINT64 totalSize;
+    UINT32 errorsCount;
+    StringStorage firstError;
+  };
+
 public:
   FileTransferReplyBuffer(LogWriter *logWriter);
   virtual ~FileTransferReplyBuffer();
@@ -50,21 +74,54 @@ public:
   UINT32 getFilesInfoCount();
   FileInfo *getFilesInfo();
 
+  //
+  // Paged file list reply. When the last page is received, the whole
+  // list is available by getFilesInfoCount() and getFilesInfo() like
+  // for ordinary file list reply.
+  //
+
+  bool isFileListComplete();
+  UINT32 getFileListTotalCount();
+  // Files of the last received page, valid until the list is complete.
+  UINT32 getFileListPageCount();
+  const FileInfo *getFileListPage();
+
   UINT32 getDownloadBufferSize();
   vector<UINT8> getDownloadBuffer();
 
   UINT8 getDownloadFileFlags();
   UINT64 getDownloadLastModified();
 
+  //
+  // Files of the last received batch download page.
+  //
+
+  bool isBatchLastPage();
+  const vector<BatchFile> *getBatchFiles();
+
   UINT64 getDirSize();
 
+  const UINT8 *getMd5Hash();
+
+  // Checksum reply data
+  UINT8 getChecksumAlgorithm();
+  const vector<UINT8> *getChecksum();
+  // Count of bytes hashed by server from last checksum progress reply
+  UINT64 getChecksumProgress();
+
+  // Tree operation reply data, counters are updated by progress replies
+  const TreeOperationResult *getTreeOperationResult();
+
   //
   // Inherited from FileTransferEventHandler abstract class
   //
 
   virtual void onCompressionSupportReply(DataInputStream *input) throw(IOException);
   virtual void onFileListReply(DataInputStream *input) throw(IOException, ZLibException);
-  virtual void onMd5DataReply(DataInputStream *input) throw(IOException, OperationNotSupportedException);
+  virtual void onFileListPageReply(DataInputStream *input) throw(IOException, ZLibException);
+  virtual void onMd5DataReply(DataInputStream *input) throw(IOException);
+  virtual void onChecksumReply(DataInputStream *input) throw(IOException);
+  virtual void onChecksumProgressReply(DataInputStream *input) throw(IOException);
 
   virtual void onUploadReply(DataInputStream *input) throw(IOException);
   virtual void onUploadDataReply(DataInputStream *input) throw(IOException);
@@ -73,12 +130,15 @@ public:
   virtual void onDownloadReply(DataInputStream *input) throw(IOException);
   virtual void onDownloadDataReply(DataInputStream *input) throw(IOException, ZLibException);
   virtual void onDownloadEndReply(DataInputStream *input) throw(IOException);
+  virtual void onBatchDownloadReply(DataInputStream *input) throw(IOException, ZLibException);
 
   virtual void onMkdirReply(DataInputStream *input) throw(IOException);
   virtual void onRmReply(DataInputStream *input) throw(IOException);
   virtual void onMvReply(DataInputStream *input) throw(IOException);
 
   virtual void onDirSizeReply(DataInputStream *input) throw(IOException);
+  virtual void onTreeOperationReply(DataInputStream *input) throw(IOException);
+  virtual void onTreeOperationProgressReply(DataInputStream *input) throw(IOException);
   virtual void onLastRequestFailedReply(DataInputStream *input) throw(IOException);
 
 private:
@@ -89,6 +149,9 @@ private:
                                         UINT8 compressionLevel)
                 throw(IOException, ZLibException);
 
+  void readFilesInfo(DataInputStream *input, UINT32 count, FileInfo *filesInfo)
+       throw(IOException);
+
 protected:
 
   //
@@ -112,6 +175,12 @@ protected:
   UINT32 m_filesInfoCount;
   FileInfo *m_filesInfo;
 
+  // File list page reply
+  vector<FileInfo> m_pagedFilesInfo;
+  size_t m_lastPageOffset;
+  UINT32 m_fileListTotalCount;
+  bool m_isFileListComplete;
+
   // Last request message failed reply
   StringStorage m_lastErrorMessage;
 
@@ -123,8 +192,23 @@ protected:
   UINT8 m_downloadFileFlags;
   UINT64 m_downloadLastModified;
 
+  // Batch download reply
+  vector<BatchFile> m_batchFiles;
+  bool m_isBatchLastPage;
+
   // Dirsize reply data
   UINT64 m_dirSize;
+
+  // Md5 reply data
+  UINT8 m_md5Hash[16];
+
+  // Checksum reply data
+  UINT8 m_checksumAlgorithm;
+  vector<UINT8> m_checksum;
+  UINT64 m_checksumProgress;
+
+  // Tree operation reply data
+  TreeOperationResult m_treeOperationResult;
 };
 
 #endif
@@ -28,7 +28,8 @@
 
 FileTransferRequestSender::FileTransferRequestSender(LogWriter *logWriter)
 : m_logWriter(logWriter),
-  m_output(0)
+  m_output(0),
+  m_fileListPageSize(0)
 {
 }
 
@@ -41,6 +42,11 @@ void FileTransferRequestSender::setOutput(RfbOutputGate *outputStream)
   m_output = outputStream;
 }
 
+void FileTransferRequestSender::setFileListPageSize(UINT32 pageSize)
+{
+  m_fileListPageSize = pageSize;
+}
+
 void FileTransferRequestSender::sendCompressionSupportRequest()
 {
   AutoLock al(m_output);
@@ -57,17 +63,25 @@ void FileTransferRequestSender::sendFileListRequest(const TCHAR *fullPath,
   AutoLock al(m_output);
 
   UINT32 messageId = FTMessage::FILE_LIST_REQUEST;
+  if (m_fileListPageSize != 0) {
+    messageId = FTMessage::FILE_LIST_PAGED_REQUEST;
+  }
   UINT8 compressionLevel = useCompression ? (UINT8)1 : (UINT8)0;
 
   m_logWriter->info(_T("Sending file list request with parameters:\n")
                     _T("\tpath = %s\n")
-                    _T("\tuse compression = %d\n"),
+                    _T("\tuse compression = %d\n")
+                    _T("\tpage size = %d\n"),
                     fullPath,
-                    useCompression ? 1 : 0);
+                    useCompression ? 1 : 0,
+                    m_fileListPageSize);
 
   m_output->writeUInt32(messageId);
   m_output->writeUInt8(compressionLevel);
   m_output->writeUTF8(fullPath);
+  if (m_fileListPageSize != 0) {
+    m_output->writeUInt32(m_fileListPageSize);
+  }
   m_output->flush();
 }
 
@@ -106,6 +120,29 @@ void FileTransferRequestSender::sendDownloadDataRequest(UINT32 size,
   m_output->flush();
 }
 
+void FileTransferRequestSender::sendBatchDownloadRequest(const StringStorage *fullPathNames,
+                                                         UINT32 count,
+                                                         bool useCompression)
+{
+  AutoLock al(m_output);
+
+  UINT8 compressionLevel = useCompression ? (UINT8)1 : (UINT8)0;
+
+  m_logWriter->info(_T("Sending batch download request with parameters:\n")
+                    _T("\tfiles count = %d\n")
+                    _T("\tuse compression = %d\n"),
+                    count,
+                    compressionLevel);
+
+  m_output->writeUInt32(FTMessage::FILE_BATCH_DOWNLOAD_REQUEST);
+  m_output->writeUInt8(compressionLevel);
+  m_output->writeUInt32(count);
+  for (UINT32 i = 0; i < count; i++) {
+    m_output->writeUTF8(fullPathNames[i].getString());
+  }
+  m_output->flush();
+}
+
 void FileTransferRequestSender::sendRmFileRequest(const TCHAR *fullPathName)
 {
   AutoLock al(m_output);
@@ -177,6 +214,7 @@ void FileTransferRequestSender::sendUploadDataRequest(const char *buffer,
                                                       UINT32 size,
                                                       bool useCompression)
 {
+  m_output->yieldToInput();
   AutoLock al(m_output);
 
   m_output->writeUInt32(FTMessage::UPLOAD_DATA_REQUEST);
@@ -233,3 +271,80 @@ void FileTransferRequestSender::sendFolderSizeRequest(const TCHAR *fullPath)
   m_output->writeUTF8(fullPath);
   m_output->flush();
 }
+
+void FileTransferRequestSender::sendMd5Request(const TCHAR *fullPathName,
+                                               UINT64 offset,
+                                               UINT64 size)
+{
+  AutoLock al(m_output);
+
+  m_logWriter->info(_T("Sending md5 request with parameters:\n")
+                    _T("\tpath = %s\n")
+                    _T("\toffset = %ld\n")
+                    _T("\tsize = %ld\n"),
+                    fullPathName,
+                    offset,
+                    size);
+
+  m_output->writeUInt32(FTMessage::MD5_REQUEST);
+  m_output->writeUTF8(fullPathName);
+  m_output->writeUInt64(offset);
+  m_output->writeUInt64(size);
+  m_output->flush();
+}
+
+void FileTransferRequestSender::sendChecksumRequest(const TCHAR *fullPathName,
+                                                    UINT64 offset,
+                                                    UINT64 size,
+                                                    UINT8 algorithm)
+{
+  AutoLock al(m_output);
+
+  m_logWriter->info(_T("Sending checksum request with parameters:\n")
+                    _T("\tpath = %s\n")
+                    _T("\toffset = %ld\n")
+                    _T("\tsize = %ld\n")
+                    _T("\talgorithm = %d\n"),
+                    fullPathName,
+                    offset,
+                    size,
+                    algorithm);
+
+  m_output->writeUInt32(FTMessage::CHECKSUM_REQUEST);
+  m_output->writeUTF8(fullPathName);
+  m_output->writeUInt64(offset);
+  m_output->writeUInt64(size);
+  m_output->writeUInt8(algorithm);
+  m_output->flush();
+}
+
+void FileTransferRequestSender::sendTreeOperationRequest(UINT8 operation,
+                                                         const StringStorage *fullPathNames,
+                                                         UINT32 count)
+{
+  AutoLock al(m_output);
+
+  m_logWriter->info(_T("Sending tree operation request with parameters:\n")
+                    _T("\toperation = %d\n")
+                    _T("\tpaths count = %u\n"),
+                    (int)operation,
+                    count);
+
+  m_output->writeUInt32(FTMessage::TREE_OPERATION_REQUEST);
+  m_output->writeUInt8(operation);
+  m_output->writeUInt32(count);
+  for (UINT32 i = 0; i < count; i++) {
+    m_output->writeUTF8(fullPathNames[i].getString());
+  }
+  m_output->flush();
+}
+
+void FileTransferRequestSender::sendTreeOperationCancelRequest()
+{
+  AutoLock al(m_output);
+
+  m_logWriter->info(_T("Sending tree operation cancel request\n"));
+
+  m_output->writeUInt32(FTMessage::TREE_OPERATION_CANCEL_REQUEST);
+  m_output->flush();
+}
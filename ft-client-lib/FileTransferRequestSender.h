@@ -28,6 +28,7 @@
 #include "util/inttypes.h"
 #include "network/RfbOutputGate.h"
 #include "io-lib/IOException.h"
+#include "util/StringStorage.h"
 
 #include "log-writer/LogWriter.h"
 
@@ -39,10 +40,19 @@ public:
 
   void setOutput(RfbOutputGate *outputStream);
 
+  //
+  // Sets count of files in one page of file list reply. If it is not
+  // zero, file lists are requested by pages (server must support it).
+  //
+
+  void setFileListPageSize(UINT32 pageSize);
+
   void sendCompressionSupportRequest() throw(IOException);
   void sendFileListRequest(const TCHAR *fullPath, bool useCompression) throw(IOException);
   void sendDownloadRequest(const TCHAR *fullPathName, UINT64 offset) throw(IOException);
   void sendDownloadDataRequest(UINT32 size, bool useCompression) throw(IOException);
+  void sendBatchDownloadRequest(const StringStorage *fullPathNames, UINT32 count,
+                                bool useCompression) throw(IOException);
   void sendRmFileRequest(const TCHAR *fullPathName) throw(IOException);
   void sendMkDirRequest(const TCHAR *fullPathName) throw(IOException);
   void sendMvFileRequest(const TCHAR *oldFileName, const TCHAR *newFileName) throw(IOException);
@@ -50,10 +60,19 @@ public:
   void sendUploadDataRequest(const char *buffer, UINT32 size, bool useCompression) throw(IOException);
   void sendUploadEndRequest(UINT8 fileFlags, UINT64 modificationTime) throw(IOException);
   void sendFolderSizeRequest(const TCHAR *fullPath) throw(IOException);
+  void sendMd5Request(const TCHAR *fullPathName, UINT64 offset, UINT64 size) throw(IOException);
+  void sendChecksumRequest(const TCHAR *fullPathName, UINT64 offset, UINT64 size,
+                           UINT8 algorithm) throw(IOException);
+  void sendTreeOperationRequest(UINT8 operation,
+                                const StringStorage *fullPathNames,
+                                UINT32 count) throw(IOException);
+  void sendTreeOperationCancelRequest() throw(IOException);
 
 protected:
   LogWriter *m_logWriter;
   RfbOutputGate *m_output;
+
+  UINT32 m_fileListPageSize;
 };
 
 #endif
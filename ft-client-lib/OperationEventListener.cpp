@@ -40,6 +40,10 @@ void OperationEventListener::ftOpFinished(FileTransferOperation *sender)
 {
 }
 
+void OperationEventListener::ftOpFileListPage(FileTransferOperation *sender)
+{
+}
+
 void OperationEventListener::ftOpErrorMessage(FileTransferOperation *sender,
                                               const TCHAR *message)
 {
@@ -45,6 +45,13 @@ public:
 
   virtual void ftOpFinished(FileTransferOperation *sender);
 
+  //
+  // Must be called by file transfer operation when next page of
+  // paged file list was received but the list is not complete yet
+  //
+
+  virtual void ftOpFileListPage(FileTransferOperation *sender);
+
   //
   // Must be called by file transfer operation when some error occured(
   // not list files from catalog, cannot open file, cannot create folder etc)
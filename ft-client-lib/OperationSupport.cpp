@@ -39,6 +39,11 @@ OperationSupport::OperationSupport()
   m_isDirSizeSupported = false;
   m_isUploadSupported = false;
   m_isDownloadSupported = false;
+  m_isWindowedTransferSupported = false;
+  m_isPagedFileListSupported = false;
+  m_isBatchDownloadSupported = false;
+  m_isChecksumSupported = false;
+  m_isTreeOperationSupported = false;
 }
 
 OperationSupport::OperationSupport(const std::vector<UINT32> &clientCodes,
@@ -80,6 +85,25 @@ OperationSupport::OperationSupport(const std::vector<UINT32> &clientCodes,
                            isSupport(serverCodes, FTMessage::DOWNLOAD_DATA_REPLY) &&
                            isSupport(serverCodes, FTMessage::DOWNLOAD_END_REPLY) &&
                            m_isFileListSupported && m_isDirSizeSupported);
+
+  m_isWindowedTransferSupported = isSupport(serverCodes, FTMessage::WINDOWED_TRANSFER);
+
+  m_isPagedFileListSupported = isSupport(clientCodes, FTMessage::FILE_LIST_PAGED_REQUEST) &&
+                               isSupport(serverCodes, FTMessage::FILE_LIST_PAGE_REPLY) &&
+                               m_isFileListSupported;
+
+  m_isBatchDownloadSupported = isSupport(clientCodes, FTMessage::FILE_BATCH_DOWNLOAD_REQUEST) &&
+                               isSupport(serverCodes, FTMessage::FILE_BATCH_DOWNLOAD_REPLY) &&
+                               m_isDownloadSupported;
+
+  m_isChecksumSupported = isSupport(clientCodes, FTMessage::CHECKSUM_REQUEST) &&
+                          isSupport(serverCodes, FTMessage::CHECKSUM_REPLY) &&
+                          isSupport(serverCodes, FTMessage::CHECKSUM_PROGRESS_REPLY);
+
+  m_isTreeOperationSupported = isSupport(clientCodes, FTMessage::TREE_OPERATION_REQUEST) &&
+                               isSupport(clientCodes, FTMessage::TREE_OPERATION_CANCEL_REQUEST) &&
+                               isSupport(serverCodes, FTMessage::TREE_OPERATION_REPLY) &&
+                               isSupport(serverCodes, FTMessage::TREE_OPERATION_PROGRESS_REPLY);
 }
 
 OperationSupport::~OperationSupport()
@@ -131,6 +155,31 @@ bool OperationSupport::isDirSizeSupported() const
   return m_isDirSizeSupported;
 }
 
+bool OperationSupport::isWindowedTransferSupported() const
+{
+  return m_isWindowedTransferSupported;
+}
+
+bool OperationSupport::isPagedFileListSupported() const
+{
+  return m_isPagedFileListSupported;
+}
+
+bool OperationSupport::isBatchDownloadSupported() const
+{
+  return m_isBatchDownloadSupported;
+}
+
+bool OperationSupport::isChecksumSupported() const
+{
+  return m_isChecksumSupported;
+}
+
+bool OperationSupport::isTreeOperationSupported() const
+{
+  return m_isTreeOperationSupported;
+}
+
 bool OperationSupport::isSupport(const std::vector<UINT32> &codes, UINT32 code)
 {
   return std::find(codes.begin(), codes.end(), code) != codes.end();
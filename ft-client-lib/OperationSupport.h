@@ -46,6 +46,11 @@ public:
   bool isCompressionSupported() const;
   bool isMD5Supported() const;
   bool isDirSizeSupported() const;
+  bool isWindowedTransferSupported() const;
+  bool isPagedFileListSupported() const;
+  bool isBatchDownloadSupported() const;
+  bool isChecksumSupported() const;
+  bool isTreeOperationSupported() const;
 
 protected:
   static bool isSupport(const std::vector<UINT32> &codes, UINT32 code);
@@ -59,6 +64,11 @@ protected:
   bool m_isCompressionSupported;
   bool m_isMD5Supported;
   bool m_isDirSizeSupported;
+  bool m_isWindowedTransferSupported;
+  bool m_isPagedFileListSupported;
+  bool m_isBatchDownloadSupported;
+  bool m_isChecksumSupported;
+  bool m_isTreeOperationSupported;
 };
 
 #endif
@@ -0,0 +1,130 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PartialTransferList.h"
+#include "thread/AutoLock.h"
+
+PartialTransferList PartialTransferList::s_instance;
+
+PartialTransferList::PartialTransferList()
+{
+}
+
+PartialTransferList *PartialTransferList::getInstance()
+{
+  return &s_instance;
+}
+
+UINT64 PartialTransferList::getBlockChecksum(XXHash64 *xxHash)
+{
+  const UINT8 *hash = xxHash->finalize().getHash();
+
+  UINT64 checksum = 0;
+  for (size_t i = 0; i < XXHash64::HASH_SIZE; i++) {
+    checksum = checksum << 8 | hash[i];
+  }
+  return checksum;
+}
+
+std::list<PartialTransferList::Entry>::iterator
+PartialTransferList::findEntry(bool upload, const TCHAR *sourcePath,
+                               const TCHAR *targetPath)
+{
+  std::list<Entry>::iterator it;
+  for (it = m_entries.begin(); it != m_entries.end(); it++) {
+    if (it->upload == upload &&
+        it->sourcePath.isEqualTo(sourcePath) &&
+        it->targetPath.isEqualTo(targetPath)) {
+      break;
+    }
+  }
+  return it;
+}
+
+bool PartialTransferList::find(bool upload, const TCHAR *sourcePath,
+                               const TCHAR *targetPath,
+                               PartialTransfer *transfer)
+{
+  AutoLock al(&m_lock);
+  std::list<Entry>::iterator it = findEntry(upload, sourcePath, targetPath);
+  if (it == m_entries.end()) {
+    return false;
+  }
+  *transfer = it->transfer;
+  return true;
+}
+
+void PartialTransferList::start(bool upload, const TCHAR *sourcePath,
+                                const TCHAR *targetPath,
+                                UINT64 sourceSize, UINT64 sourceModified,
+                                size_t keptBlocks)
+{
+  AutoLock al(&m_lock);
+  Entry entry;
+  entry.upload = upload;
+  entry.sourcePath.setString(sourcePath);
+  entry.targetPath.setString(targetPath);
+  entry.transfer.sourceSize = sourceSize;
+  entry.transfer.sourceModified = sourceModified;
+
+  std::list<Entry>::iterator it = findEntry(upload, sourcePath, targetPath);
+  if (it != m_entries.end()) {
+    if (it->transfer.sourceSize == sourceSize &&
+        it->transfer.sourceModified == sourceModified) {
+      std::vector<UINT64> *checksums = &it->transfer.blockChecksums;
+      if (keptBlocks < checksums->size()) {
+        checksums->resize(keptBlocks);
+      }
+      entry.transfer.blockChecksums.swap(*checksums);
+    }
+    m_entries.erase(it);
+  }
+
+  m_entries.push_front(entry);
+  if (m_entries.size() > MAX_ENTRIES) {
+    m_entries.pop_back();
+  }
+}
+
+void PartialTransferList::addBlockChecksum(bool upload,
+                                           const TCHAR *sourcePath,
+                                           const TCHAR *targetPath,
+                                           UINT64 checksum)
+{
+  AutoLock al(&m_lock);
+  std::list<Entry>::iterator it = findEntry(upload, sourcePath, targetPath);
+  if (it != m_entries.end()) {
+    it->transfer.blockChecksums.push_back(checksum);
+  }
+}
+
+void PartialTransferList::remove(bool upload, const TCHAR *sourcePath,
+                                 const TCHAR *targetPath)
+{
+  AutoLock al(&m_lock);
+  std::list<Entry>::iterator it = findEntry(upload, sourcePath, targetPath);
+  if (it != m_entries.end()) {
+    m_entries.erase(it);
+  }
+}
@@ -0,0 +1,101 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _PARTIAL_TRANSFER_LIST_H_
+#define _PARTIAL_TRANSFER_LIST_H_
+
+#include <list>
+#include <vector>
+
+#include "util/StringStorage.h"
+#include "util/XXHash64.h"
+#include "thread/LocalMutex.h"
+
+//
+// Process-wide list of file transfers that may be broken (by a disconnect
+// for example). The list outlives connections, so copy operation of the
+// same file started after reconnect continues it from the last verified
+// offset instead of zero.
+//
+
+class PartialTransferList
+{
+public:
+  static PartialTransferList *getInstance();
+
+  struct PartialTransfer
+  {
+    // Size and modification time of source file when transfer started
+    UINT64 sourceSize;
+    UINT64 sourceModified;
+    // Checksums of consecutive BLOCK_SIZE blocks written to target file
+    std::vector<UINT64> blockChecksums;
+  };
+
+  // Returns checksum of block hashed by xxHash (finalizes it).
+  static UINT64 getBlockChecksum(XXHash64 *xxHash);
+
+  // Copies transfer of source file to target file into transfer and
+  // returns true, or returns false if there is no such transfer.
+  bool find(bool upload, const TCHAR *sourcePath, const TCHAR *targetPath,
+            PartialTransfer *transfer);
+
+  // Adds (or replaces) transfer of source file to target file. First
+  // keptBlocks checksums of replaced transfer of the same source are kept.
+  void start(bool upload, const TCHAR *sourcePath, const TCHAR *targetPath,
+             UINT64 sourceSize, UINT64 sourceModified, size_t keptBlocks);
+
+  // Appends checksum of the next block written to target file.
+  void addBlockChecksum(bool upload, const TCHAR *sourcePath,
+                        const TCHAR *targetPath, UINT64 checksum);
+
+  // Forgets transfer (when file is copied completely).
+  void remove(bool upload, const TCHAR *sourcePath, const TCHAR *targetPath);
+
+  static const UINT32 BLOCK_SIZE = 1024 * 1024;
+  static const size_t MAX_ENTRIES = 64;
+
+private:
+  PartialTransferList();
+
+  struct Entry
+  {
+    bool upload;
+    StringStorage sourcePath;
+    StringStorage targetPath;
+    PartialTransfer transfer;
+  };
+
+  // Returns entry of transfer or m_entries.end().
+  std::list<Entry>::iterator findEntry(bool upload, const TCHAR *sourcePath,
+                                       const TCHAR *targetPath);
+
+  LocalMutex m_lock;
+  // From the most recently started transfer.
+  std::list<Entry> m_entries;
+
+  static PartialTransferList s_instance;
+};
+
+#endif
@@ -24,6 +24,10 @@
 
 #include "RemoteFilesDeleteOperation.h"
 
+#include "ft-common/FTMessage.h"
+
+#include <vector>
+
 RemoteFilesDeleteOperation::RemoteFilesDeleteOperation(LogWriter *logWriter,
                                                        const FileInfo *filesInfoToDelete,
                                                        size_t filesCount,
@@ -32,6 +36,8 @@ RemoteFilesDeleteOperation::RemoteFilesDeleteOperation(LogWriter *logWriter,
 {
   m_toDelete = new FileInfoList(filesInfoToDelete, filesCount);
   m_pathToTargetRoot.setString(pathToTargetRoot);
+  m_treeEnabled = false;
+  m_treeCancelSent = false;
 }
 
 RemoteFilesDeleteOperation::RemoteFilesDeleteOperation(LogWriter *logWriter,
@@ -41,6 +47,8 @@ RemoteFilesDeleteOperation::RemoteFilesDeleteOperation(LogWriter *logWriter,
 {
   m_toDelete = new FileInfoList(fileInfoToDelete);
   m_pathToTargetRoot.setString(pathToTargetRoot);
+  m_treeEnabled = false;
+  m_treeCancelSent = false;
 }
 
 RemoteFilesDeleteOperation::~RemoteFilesDeleteOperation()
@@ -50,15 +58,45 @@ RemoteFilesDeleteOperation::~RemoteFilesDeleteOperation()
   }
 }
 
+void RemoteFilesDeleteOperation::setTreeDelete(bool enabled)
+{
+  m_treeEnabled = enabled;
+}
+
 void RemoteFilesDeleteOperation::start()
 {
   // Notify listeners that operation have started
   notifyStart();
 
+  if (m_treeEnabled && m_toDelete != NULL) {
+    sendTreeDeleteRequest();
+    return ;
+  }
+
   // Remove first file in the list
   remove(false);
 }
 
+void RemoteFilesDeleteOperation::sendTreeDeleteRequest()
+{
+  std::vector<StringStorage> remotePaths;
+
+  for (FileInfoList *fil = m_toDelete; fil != NULL; fil = fil->getNext()) {
+    StringStorage remotePath;
+    getRemotePath(fil, m_pathToTargetRoot.getString(), &remotePath);
+    remotePaths.push_back(remotePath);
+
+    StringStorage message;
+    message.format(_T("Deleting remote '%s' %s"), remotePath.getString(),
+                   fil->getFileInfo()->isDirectory() ? _T("folder") : _T("file"));
+    notifyInformation(message.getString());
+  }
+
+  m_sender->sendTreeOperationRequest(FTMessage::TREE_DELETE,
+                                     &remotePaths.front(),
+                                     (UINT32)remotePaths.size());
+}
+
 void RemoteFilesDeleteOperation::onFileListReply(DataInputStream *input)
 {
   FileInfoList *current = m_toDelete;
@@ -94,6 +132,34 @@ void RemoteFilesDeleteOperation::onRmReply(DataInputStream *input)
   gotoNext();
 }
 
+void RemoteFilesDeleteOperation::onTreeOperationProgressReply(DataInputStream *input)
+{
+  // Server deletes files until it gets cancel request
+  if (isTerminating() && !m_treeCancelSent) {
+    m_sender->sendTreeOperationCancelRequest();
+    m_treeCancelSent = true;
+  }
+}
+
+void RemoteFilesDeleteOperation::onTreeOperationReply(DataInputStream *input)
+{
+  const FileTransferReplyBuffer::TreeOperationResult *result =
+    m_replyBuffer->getTreeOperationResult();
+
+  StringStorage message;
+  message.format(_T("Deleted %I64u remote files and %I64u folders"),
+                 result->filesCount, result->foldersCount);
+  notifyInformation(message.getString());
+
+  if (result->errorsCount > 0) {
+    message.format(_T("Error: failed to delete %u items, first error: %s"),
+                   result->errorsCount, result->firstError.getString());
+    notifyError(message.getString());
+  }
+
+  killOp();
+}
+
 void RemoteFilesDeleteOperation::onLastRequestFailedReply(DataInputStream *input)
 {
   //
@@ -103,6 +169,15 @@ void RemoteFilesDeleteOperation::onLastRequestFailedReply(DataInputStream *input
   StringStorage errorMessage;
   m_replyBuffer->getLastErrorMessage(&errorMessage);
 
+  if (m_treeEnabled) {
+    StringStorage message;
+    message.format(_T("Error: %s"), errorMessage.getString());
+    notifyError(message.getString());
+
+    killOp();
+    return ;
+  }
+
   StringStorage remotePath;
   getRemotePath(m_toDelete, m_pathToTargetRoot.getString(), &remotePath);
 
@@ -55,6 +55,14 @@ public:
 
   virtual ~RemoteFilesDeleteOperation();
 
+  //
+  // Deletes all files by single tree operation executed by server
+  // instead of walking remote tree folder by folder (server must support
+  // tree operation requests).
+  //
+
+  void setTreeDelete(bool enabled);
+
   //
   // Starts executing this delete operation
   //
@@ -67,11 +75,14 @@ public:
 
   void onFileListReply(DataInputStream *input) throw(IOException);
   void onRmReply(DataInputStream *input) throw(IOException);
+  void onTreeOperationReply(DataInputStream *input) throw(IOException);
+  void onTreeOperationProgressReply(DataInputStream *input) throw(IOException);
   void onLastRequestFailedReply(DataInputStream *input) throw(IOException);
 
 private:
 
   void remove(bool removeIfFolder) throw(IOException);
+  void sendTreeDeleteRequest() throw(IOException);
   void gotoNext() throw(IOException);
   void killOp();
 
@@ -83,6 +94,11 @@ protected:
 
   FileInfoList *m_toDelete;
   StringStorage m_pathToTargetRoot;
+
+  // Tree delete is enabled
+  bool m_treeEnabled;
+  // Tree operation cancel request is already sent
+  bool m_treeCancelSent;
 };
 
 #endif
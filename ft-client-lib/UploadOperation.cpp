@@ -27,6 +27,9 @@
 #include "ft-common/WinFilePath.h"
 #include "ft-common/FolderListener.h"
 #include "file-lib/EOFException.h"
+#include "util/md5.h"
+#include "util/XXHash64.h"
+#include "ft-common/FTMessage.h"
 
 UploadOperation::UploadOperation(LogWriter *logWriter,
                                  FileInfo fileToUpload,
@@ -34,6 +37,10 @@ UploadOperation::UploadOperation(LogWriter *logWriter,
                                  const TCHAR *pathToTargetRoot)
 : CopyOperation(logWriter),
   m_file(0), m_fis(0), m_gotoChild(false), m_gotoParent(false), m_firstUpload(true),
+  m_endOfFile(false), m_uploadPos(0), m_rangeEnd(0),
+  m_deltaEnabled(false), m_fastChecksum(false), m_verifying(false), m_verifyEnd(0),
+  m_hashRequested(0), m_hashChecked(0), m_bytesMatched(0), m_nextRange(0),
+  m_treeMkdirEnabled(false), m_creatingTree(false), m_treeCreated(false),
   m_remoteFilesInfo(0), m_remoteFilesCount(0), m_bufferSize(20000)
 {
   m_pathToSourceRoot.setString(pathToSourceRoot);
@@ -51,6 +58,10 @@ UploadOperation::UploadOperation(LogWriter *logWriter,
                                  const TCHAR *pathToTargetRoot)
 : CopyOperation(logWriter),
   m_file(0), m_fis(0), m_gotoChild(false), m_gotoParent(false), m_firstUpload(true),
+  m_endOfFile(false), m_uploadPos(0), m_rangeEnd(0),
+  m_deltaEnabled(false), m_fastChecksum(false), m_verifying(false), m_verifyEnd(0),
+  m_hashRequested(0), m_hashChecked(0), m_bytesMatched(0), m_nextRange(0),
+  m_treeMkdirEnabled(false), m_creatingTree(false), m_treeCreated(false),
   m_remoteFilesInfo(0), m_remoteFilesCount(0), m_bufferSize(20000)
 {
   m_pathToSourceRoot.setString(pathToSourceRoot);
@@ -77,6 +88,21 @@ UploadOperation::~UploadOperation()
   releaseRemoteFilesInfo();
 }
 
+void UploadOperation::setDeltaTransfer(bool enabled)
+{
+  m_deltaEnabled = enabled;
+}
+
+void UploadOperation::setFastChecksum(bool enabled)
+{
+  m_fastChecksum = enabled;
+}
+
+void UploadOperation::setTreeMkdir(bool enabled)
+{
+  m_treeMkdirEnabled = enabled;
+}
+
 void UploadOperation::start()
 {
   //
@@ -99,28 +125,109 @@ void UploadOperation::start()
   //
 
   m_firstUpload = true;
+  m_creatingTree = false;
+  m_treeCreated = false;
+
+  //
+  // Create whole remote folder tree first, file list request is sent
+  // when reply for tree operation request will be received
+  //
 
+  if (m_treeMkdirEnabled) {
+    std::vector<StringStorage> folders;
+    for (FileInfoList *fil = m_toCopy; fil != NULL; fil = fil->getNext()) {
+      if (fil->getFileInfo()->isDirectory()) {
+        StringStorage localPath;
+        StringStorage remotePath;
+        getLocalPath(fil, m_pathToSourceRoot.getString(), &localPath);
+        getRemotePath(fil, m_pathToTargetRoot.getString(), &remotePath);
+        collectFolders(localPath.getString(), remotePath.getString(), &folders);
+      }
+    }
+    if (!folders.empty() && folders.size() <= FTMessage::TREE_MAX_PATHS) {
+      m_creatingTree = true;
+      m_sender->sendTreeOperationRequest(FTMessage::TREE_MKDIR,
+                                         &folders.front(),
+                                         (UINT32)folders.size());
+      return ;
+    }
+  }
+
+  sendTargetFileListRequest();
+}
+
+void UploadOperation::sendTargetFileListRequest()
+{
   m_sender->sendFileListRequest(m_pathToTargetRoot.getString(),
                                 m_replyBuffer->isCompressionSupported());
 }
 
+void UploadOperation::collectFolders(const TCHAR *localPath,
+                                     const TCHAR *remotePath,
+                                     std::vector<StringStorage> *folders)
+{
+  if (folders->size() > FTMessage::TREE_MAX_PATHS) {
+    return ;
+  }
+  folders->push_back(remotePath);
+
+  File folder(localPath);
+  UINT32 filesCount = 0;
+  if (!folder.list(NULL, &filesCount) || filesCount == 0) {
+    return ;
+  }
+
+  std::vector<StringStorage> fileNames(filesCount);
+  folder.list(&fileNames.front(), NULL);
+
+  for (UINT32 i = 0; i < filesCount; i++) {
+    File subfolder(localPath, fileNames[i].getString());
+    if (subfolder.isDirectory()) {
+      StringStorage localSubPath;
+      StringStorage remoteSubPath;
+      subfolder.getPath(&localSubPath);
+      remoteSubPath.format(_T("%s/%s"), remotePath, fileNames[i].getString());
+      collectFolders(localSubPath.getString(), remoteSubPath.getString(), folders);
+    }
+  }
+}
+
+void UploadOperation::onTreeOperationReply(DataInputStream *input)
+{
+  m_creatingTree = false;
+  // Remote folders that are failed to create are created one by one,
+  // so errors are reported by these mkdir requests
+  m_treeCreated = m_replyBuffer->getTreeOperationResult()->errorsCount == 0;
+
+  sendTargetFileListRequest();
+}
+
 void UploadOperation::onUploadReply(DataInputStream *input)
 {
-  sendFileDataChunk();
+  sendDataChunks();
 }
 
 void UploadOperation::onUploadDataReply(DataInputStream *input)
 {
+  if (skipAbandonedReply()) {
+    return ;
+  }
+  dataRequestReplied();
+
   if (isTerminating()) {
+    abandonRequestsInFlight();
     gotoNext();
     return ;
   }
 
-  sendFileDataChunk();
+  sendDataChunks();
 }
 
 void UploadOperation::onUploadEndReply(DataInputStream *input)
 {
+  // File is uploaded completely
+  forgetTransfer(true);
+
   // Cleanup
   try { m_fis->close(); } catch (...) { }
   delete m_fis;
@@ -141,6 +248,28 @@ void UploadOperation::onMkdirReply(DataInputStream *input)
 
 void UploadOperation::onLastRequestFailedReply(DataInputStream *input)
 {
+  if (skipAbandonedReply()) {
+    return ;
+  }
+
+  // Server cannot create folder tree, create folders one by one
+  if (m_creatingTree) {
+    m_creatingTree = false;
+    m_treeCreated = false;
+    sendTargetFileListRequest();
+    return ;
+  }
+
+  // Failed request may be one of data requests in flight
+  dataRequestReplied();
+  abandonRequestsInFlight();
+
+  // Failed to compare blocks, upload whole file
+  if (m_verifying) {
+    uploadWholeFile();
+    return ;
+  }
+
   StringStorage errDesc;
 
   m_replyBuffer->getLastErrorMessage(&errDesc);
@@ -159,6 +288,89 @@ void UploadOperation::onLastRequestFailedReply(DataInputStream *input)
   gotoNext();
 }
 
+void UploadOperation::onMd5DataReply(DataInputStream *input)
+{
+  onBlockHashReply(m_replyBuffer->getMd5Hash(), 16);
+}
+
+void UploadOperation::onChecksumReply(DataInputStream *input)
+{
+  const vector<UINT8> *checksum = m_replyBuffer->getChecksum();
+  onBlockHashReply(checksum->empty() ? NULL : &checksum->front(),
+                   checksum->size());
+}
+
+void UploadOperation::onBlockHashReply(const UINT8 *remoteHash, size_t hashSize)
+{
+  if (skipAbandonedReply()) {
+    return ;
+  }
+  dataRequestReplied();
+
+  if (isTerminating()) {
+    abandonRequestsInFlight();
+    gotoNext();
+    return ;
+  }
+
+  UINT64 size = m_verifyEnd - m_hashChecked;
+  if (size > DELTA_BLOCK_SIZE) {
+    size = DELTA_BLOCK_SIZE;
+  }
+
+  bool same;
+  try {
+    same = isLocalBlockSame(m_hashChecked, (UINT32)size,
+                            remoteHash, hashSize);
+  } catch (IOException &ioEx) {
+    abandonRequestsInFlight();
+    notifyFailedToUpload(ioEx.getMessage());
+    gotoNext();
+    return ;
+  }
+
+  if (same) {
+    m_bytesMatched += size;
+    m_totalBytesCopied += size;
+
+    if (m_copyListener != NULL) {
+      m_copyListener->dataChunkCopied(m_totalBytesCopied,
+                                      m_totalBytesToCopy);
+    }
+  } else {
+    addChangedRange(m_hashChecked, m_hashChecked + size);
+  }
+  m_hashChecked += size;
+
+  if (m_hashChecked < m_verifyEnd) {
+    sendMd5Requests();
+    return ;
+  }
+
+  //
+  // All blocks are compared, upload changed ones and the tail
+  // of local file. If nothing is changed, empty range at end of
+  // file is uploaded to set modification time.
+  //
+
+  m_verifying = false;
+
+  INT64 localSize = m_file->length();
+  if (localSize > (INT64)m_verifyEnd) {
+    addChangedRange(m_verifyEnd, (UINT64)localSize);
+  }
+  if (m_changedRanges.empty()) {
+    addChangedRange(m_verifyEnd, m_verifyEnd);
+  }
+
+  StringStorage message;
+  message.format(_T("%I64u of %I64u bytes of '%s' are unchanged"),
+                 m_bytesMatched, m_verifyEnd, m_pathToTargetFile.getString());
+  notifyInformation(message.getString());
+
+  startNextRange();
+}
+
 void UploadOperation::onFileListReply(DataInputStream *input)
 {
   initRemoteFiles(m_replyBuffer->getFilesInfo(),
@@ -310,6 +522,12 @@ void UploadOperation::processFolder()
     notifyError(message.getString());
   }
 
+  // Folder is already created by tree operation
+  if (m_treeCreated) {
+    gotoNext();
+    return ;
+  }
+
   // Send request to create folder
   m_sender->sendMkDirRequest(m_pathToTargetFile.getString());
 }
@@ -329,6 +547,7 @@ void UploadOperation::processFile()
   }
 
   UINT64 initialFileOffset = 0;
+  UINT64 remoteSizeToCompare = 0;
 
   // Search if file already exists on remote machine
   for (UINT32 i = 0; i < m_remoteFilesCount; i++) {
@@ -341,6 +560,18 @@ void UploadOperation::processFile()
     // File collision, show file exist dialog
     if (_tcscmp(localFileName, remoteFileName) == 0) {
 
+      // Broken upload of this file is continued without asking listener
+      if (canContinueUpload(localFileInfo, remoteFileInfo)) {
+        remoteSizeToCompare = remoteFileInfo->getSize();
+
+        StringStorage message;
+        message.format(_T("Continuing upload of '%s', %I64u bytes ")
+                       _T("uploaded before are verified"),
+                       m_pathToSourceFile.getString(), remoteSizeToCompare);
+        notifyInformation(message.getString());
+        break;
+      }
+
       //
       // Copy listener must decide what to do with this situation
       //
@@ -351,6 +582,12 @@ void UploadOperation::processFile()
 
       switch (action) {
       case CopyFileEventListener::TFE_OVERWRITE:
+        // Remote file may be updated in place if it's not longer
+        if (m_deltaEnabled &&
+            remoteFileInfo->getSize() >= DELTA_MIN_FILE_SIZE &&
+            remoteFileInfo->getSize() <= localFileInfo->getSize()) {
+          remoteSizeToCompare = remoteFileInfo->getSize();
+        }
         break;
       case CopyFileEventListener::TFE_APPEND:
         initialFileOffset = remoteFileInfo->getSize();
@@ -385,13 +622,184 @@ void UploadOperation::processFile()
     return ;
   } // try / catch
 
+  m_endOfFile = false;
+  m_uploadPos = initialFileOffset;
+  m_rangeEnd = NO_RANGE_END;
+  m_changedRanges.clear();
+  m_nextRange = 0;
+  m_verifying = false;
+
+  //
+  // Upload is recorded to be continued if it's broken. Appended data
+  // is not verified, so it can't be continued.
+  //
+
+  if (initialFileOffset == 0) {
+    startRecording(true, m_toCopy->getFileInfo(), 0);
+  } else {
+    forgetTransfer(true);
+  }
+
+  if (remoteSizeToCompare != 0) {
+    startVerification(remoteSizeToCompare);
+    return ;
+  }
+
   bool overwrite = (initialFileOffset == 0);
 
   m_sender->sendUploadRequest(m_pathToTargetFile.getString(), overwrite,
                               initialFileOffset);
 } // void
 
-void UploadOperation::sendFileDataChunk()
+bool UploadOperation::canContinueUpload(const FileInfo *localFileInfo,
+                                        const FileInfo *remoteFileInfo)
+{
+  if (!m_deltaEnabled || remoteFileInfo->getSize() == 0 ||
+      remoteFileInfo->getSize() > localFileInfo->getSize()) {
+    return false;
+  }
+
+  PartialTransferList::PartialTransfer transfer;
+  return PartialTransferList::getInstance()->find(true,
+                                                  m_pathToSourceFile.getString(),
+                                                  m_pathToTargetFile.getString(),
+                                                  &transfer) &&
+         transfer.sourceSize == localFileInfo->getSize() &&
+         transfer.sourceModified == localFileInfo->lastModified();
+}
+
+void UploadOperation::startVerification(UINT64 remoteSize)
+{
+  m_verifying = true;
+  m_verifyEnd = remoteSize;
+  m_hashRequested = 0;
+  m_hashChecked = 0;
+  m_bytesMatched = 0;
+
+  sendMd5Requests();
+}
+
+void UploadOperation::sendMd5Requests()
+{
+  while (m_requestsInFlight < m_windowSize && m_hashRequested < m_verifyEnd) {
+    UINT64 size = m_verifyEnd - m_hashRequested;
+    if (size > DELTA_BLOCK_SIZE) {
+      size = DELTA_BLOCK_SIZE;
+    }
+    if (m_fastChecksum) {
+      m_sender->sendChecksumRequest(m_pathToTargetFile.getString(),
+                                    m_hashRequested, size,
+                                    FTMessage::CHECKSUM_XXH64);
+    } else {
+      m_sender->sendMd5Request(m_pathToTargetFile.getString(),
+                               m_hashRequested, size);
+    }
+    m_hashRequested += size;
+    m_requestsInFlight++;
+  }
+}
+
+bool UploadOperation::isLocalBlockSame(UINT64 offset, UINT32 size,
+                                       const UINT8 *remoteHash,
+                                       size_t hashSize)
+{
+  m_blockBuffer.resize(size);
+
+  m_fis->seek((INT64)offset);
+
+  UINT32 read = 0;
+  while (read < size) {
+    size_t portion = m_fis->read(&m_blockBuffer[read], size - read);
+    read += (UINT32)portion;
+  }
+
+  if (m_fastChecksum) {
+    XXHash64 xxHash;
+    if (size != 0) {
+      xxHash.update(&m_blockBuffer.front(), size);
+    }
+    xxHash.finalize();
+
+    return hashSize == XXHash64::HASH_SIZE &&
+           memcmp(xxHash.getHash(), remoteHash, hashSize) == 0;
+  }
+
+  MD5 md5;
+  if (size != 0) {
+    md5.update(&m_blockBuffer.front(), size);
+  }
+  md5.finalize();
+
+  return hashSize == 16 && memcmp(md5.getHash(), remoteHash, 16) == 0;
+}
+
+void UploadOperation::addChangedRange(UINT64 begin, UINT64 end)
+{
+  // Adjacent changed blocks are uploaded at once
+  if (!m_changedRanges.empty() && m_changedRanges.back().second == begin) {
+    m_changedRanges.back().second = end;
+  } else {
+    m_changedRanges.push_back(std::make_pair(begin, end));
+  }
+}
+
+void UploadOperation::startNextRange()
+{
+  const std::pair<UINT64, UINT64> &range = m_changedRanges[m_nextRange++];
+
+  m_fis->seek((INT64)range.first);
+  m_uploadPos = range.first;
+  m_rangeEnd = range.second;
+  m_endOfFile = false;
+
+  m_sender->sendUploadRequest(m_pathToTargetFile.getString(), false,
+                              range.first);
+}
+
+void UploadOperation::uploadWholeFile()
+{
+  m_verifying = false;
+  m_totalBytesCopied -= m_bytesMatched;
+  m_bytesMatched = 0;
+  m_changedRanges.clear();
+  m_nextRange = 0;
+
+  m_fis->seek(0);
+  m_uploadPos = 0;
+  m_rangeEnd = NO_RANGE_END;
+  m_endOfFile = false;
+
+  m_sender->sendUploadRequest(m_pathToTargetFile.getString(), true, 0);
+}
+
+void UploadOperation::sendDataChunks()
+{
+  while (!m_endOfFile && m_requestsInFlight < m_windowSize) {
+    if (!sendFileDataChunk()) {
+      return ;
+    }
+  }
+
+  if (m_endOfFile && m_requestsInFlight == 0) {
+    // Delta upload continues with next changed range
+    if (m_nextRange < m_changedRanges.size()) {
+      startNextRange();
+      return ;
+    }
+
+    m_fis->close();
+
+    UINT64 lastModified = 0;
+
+    try {
+      lastModified = m_file->lastModified();
+    } catch (IOException) { } // try / catch
+
+    m_sender->sendUploadEndRequest(0, lastModified);
+  }
+}
+
+bool UploadOperation::sendFileDataChunk()
 {
   _ASSERT(m_fis != NULL);
 
@@ -409,37 +817,43 @@ void UploadOperation::sendFileDataChunk()
   }
   m_lastRequestTime = DateTime::now();
 
-  vector<char> buffer(m_bufferSize);
+  size_t toRead = m_bufferSize;
+  if (m_rangeEnd - m_uploadPos < (UINT64)toRead) {
+    toRead = (size_t)(m_rangeEnd - m_uploadPos);
+  }
+  if (toRead == 0) {
+    // End of uploaded range
+    m_endOfFile = true;
+    return true;
+  }
+
+  vector<char> buffer(toRead);
   UINT32 read = 0;
   try {
-    size_t portion = m_fis->read(&buffer.front(), m_bufferSize);
+    size_t portion = m_fis->read(&buffer.front(), toRead);
     _ASSERT((UINT32)portion == portion);
     read = (UINT32)portion;
+    m_uploadPos += read;
   } catch (EOFException) {
 
     //
-    // End of file.
+    // End of file, end of upload will be requested
+    // when all data is replied.
     //
 
-    m_fis->close();
-
-    UINT64 lastModified = 0;
-
-    try {
-      lastModified = m_file->lastModified();
-    } catch (IOException) { } // try / catch
-
-    m_sender->sendUploadEndRequest(0, lastModified);
-    return ;
+    m_endOfFile = true;
+    return true;
 
   } catch (IOException &ioEx) {
+    abandonRequestsInFlight();
     notifyFailedToUpload(ioEx.getMessage());
     gotoNext();
-    return ;
+    return false;
   } // try / catch
 
   try {
     m_sender->sendUploadDataRequest(&buffer.front(), read, false);
+    m_requestsInFlight++;
     m_totalBytesCopied += read;
 
     // Notify listener, that data chunk is copied
@@ -450,6 +864,7 @@ void UploadOperation::sendFileDataChunk()
   } catch (IOException &ioEx) {
     throw ioEx;
   } // try / catch
+  return true;
 }
 
 void UploadOperation::gotoNext()
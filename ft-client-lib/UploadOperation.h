@@ -80,6 +80,28 @@ public:
 
   virtual ~UploadOperation();
 
+  //
+  // Enables updating of existing remote files in place: blocks of the
+  // files are compared by md5 hashes and only changed blocks are uploaded
+  // (server must support md5 requests).
+  //
+
+  void setDeltaTransfer(bool enabled);
+
+  //
+  // Compares blocks by xxh64 checksums instead of md5 hashes (server
+  // must support checksum requests).
+  //
+
+  void setFastChecksum(bool enabled);
+
+  //
+  // Creates all remote folders by single tree operation request before
+  // upload (server must support tree operation requests).
+  //
+
+  void setTreeMkdir(bool enabled);
+
   //
   // Starts upload operation
   //
@@ -98,12 +120,23 @@ public:
   virtual void onMkdirReply(DataInputStream *input) throw(IOException);
   virtual void onLastRequestFailedReply(DataInputStream *input) throw(IOException);
   virtual void onFileListReply(DataInputStream *input) throw(IOException);
+  virtual void onMd5DataReply(DataInputStream *input) throw(IOException);
+  virtual void onChecksumReply(DataInputStream *input) throw(IOException);
+  virtual void onTreeOperationReply(DataInputStream *input) throw(IOException);
 
 private:
 
   UINT64 getInputFilesSize();
   UINT64 getFileSize(const TCHAR *pathToFile);
 
+  // Adds remote paths of local folder and all its subfolders to folders
+  // (stops when there are more than FTMessage::TREE_MAX_PATHS ones).
+  void collectFolders(const TCHAR *localPath, const TCHAR *remotePath,
+                      std::vector<StringStorage> *folders);
+
+  // Sends file list request for destination folder that starts upload
+  void sendTargetFileListRequest() throw(IOException);
+
 protected:
 
   // Terminates operation execution
@@ -155,8 +188,46 @@ protected:
   // Reads data chunk from current uploading file and
   // sends it to server.
   //
+  // Returns false if reading failed and upload of next file is
+  // started.
+  //
 
-  void sendFileDataChunk() throw(IOException);
+  bool sendFileDataChunk() throw(IOException);
+
+  //
+  // Sends data chunks until window of requests in flight is full,
+  // and end of upload request when all of them are replied after
+  // end of file.
+  //
+
+  void sendDataChunks() throw(IOException);
+
+  //
+  // Delta upload helper methods.
+  //
+  // Starts comparing of blocks of current file with first remoteSize
+  // bytes of remote file.
+  void startVerification(UINT64 remoteSize) throw(IOException);
+  // Sends md5 (or checksum) requests until window of requests in flight
+  // is full.
+  void sendMd5Requests() throw(IOException);
+  // Compares next block with remote one by hash of remote block.
+  void onBlockHashReply(const UINT8 *remoteHash, size_t hashSize) throw(IOException);
+  // Returns true if hash of local block is equal to remoteHash.
+  bool isLocalBlockSame(UINT64 offset, UINT32 size,
+                        const UINT8 *remoteHash,
+                        size_t hashSize) throw(IOException);
+  // Adds range of file to upload, merging it with previous one.
+  void addChangedRange(UINT64 begin, UINT64 end);
+  // Starts upload of next changed range.
+  void startNextRange() throw(IOException);
+  // Falls back to upload of whole current file.
+  void uploadWholeFile() throw(IOException);
+  // Returns true if broken upload of current file is recorded and local
+  // file is not changed since. Then blocks of remote file are verified by
+  // remote hashes and upload continues with the mismatched ones.
+  bool canContinueUpload(const FileInfo *localFileInfo,
+                         const FileInfo *remoteFileInfo);
 
   //
   // Helper methods to control m_remoteFilesInfo, m_remoteFilesCount
@@ -192,6 +263,50 @@ protected:
   bool m_gotoParent;
   bool m_firstUpload;
 
+  // True if whole current file (or range of it) is read and sent
+  bool m_endOfFile;
+  // Position of next data to read from m_fis and end of uploaded range
+  UINT64 m_uploadPos;
+  UINT64 m_rangeEnd;
+
+  //
+  // Delta upload members
+  //
+
+  bool m_deltaEnabled;
+  // Blocks are compared by xxh64 checksums
+  bool m_fastChecksum;
+  // True while blocks of current file are compared
+  bool m_verifying;
+  // Count of remote file bytes to compare
+  UINT64 m_verifyEnd;
+  // Offsets of next block to request md5 for and of next block to compare
+  UINT64 m_hashRequested;
+  UINT64 m_hashChecked;
+  // Count of bytes found unchanged
+  UINT64 m_bytesMatched;
+  // Ranges of file [begin, end) to upload and index of next one
+  std::vector<std::pair<UINT64, UINT64> > m_changedRanges;
+  size_t m_nextRange;
+  // Buffer for local block to compare
+  std::vector<char> m_blockBuffer;
+
+  // Size of compared block
+  static const UINT32 DELTA_BLOCK_SIZE = 1024 * 1024;
+  // Smaller files are always uploaded whole
+  static const UINT64 DELTA_MIN_FILE_SIZE = 4 * 1024 * 1024;
+  static const UINT64 NO_RANGE_END = (UINT64)-1;
+
+  //
+  // Tree mkdir members
+  //
+
+  bool m_treeMkdirEnabled;
+  // True while tree operation request is in flight
+  bool m_creatingTree;
+  // All remote folders are created, mkdir requests are not needed
+  bool m_treeCreated;
+
   // request data size changes dynamicaly depends on request rate
   size_t m_bufferSize;
   DateTime m_lastRequestTime;
@@ -50,3 +50,15 @@ const char FTMessage::RENAME_REPLY_SIG[]                = "FTSFMRLY";
 const char FTMessage::DIRSIZE_REQUEST_SIG[]             = "FTCDSRST";
 const char FTMessage::DIRSIZE_REPLY_SIG[]               = "FTSDSRLY";
 const char FTMessage::LAST_REQUEST_FAILED_REPLY_SIG[]   = "FTLRFRLY";
+const char FTMessage::WINDOWED_TRANSFER_SIG[]           = "FTSWTCAP";
+const char FTMessage::FILE_LIST_PAGED_REQUEST_SIG[]     = "FTCFPRST";
+const char FTMessage::FILE_LIST_PAGE_REPLY_SIG[]        = "FTSFPRLY";
+const char FTMessage::FILE_BATCH_DOWNLOAD_REQUEST_SIG[] = "FTCBDRST";
+const char FTMessage::FILE_BATCH_DOWNLOAD_REPLY_SIG[]   = "FTSBDRLY";
+const char FTMessage::CHECKSUM_REQUEST_SIG[]            = "FTCCSRST";
+const char FTMessage::CHECKSUM_REPLY_SIG[]              = "FTSCSRLY";
+const char FTMessage::CHECKSUM_PROGRESS_REPLY_SIG[]     = "FTSCPRLY";
+const char FTMessage::TREE_OPERATION_REQUEST_SIG[]      = "FTCTORST";
+const char FTMessage::TREE_OPERATION_REPLY_SIG[]        = "FTSTORLY";
+const char FTMessage::TREE_OPERATION_PROGRESS_REPLY_SIG[] = "FTSTPRLY";
+const char FTMessage::TREE_OPERATION_CANCEL_REQUEST_SIG[] = "FTCTCRST";
@@ -233,6 +233,187 @@ public:
 
   const static UINT32 LAST_REQUEST_FAILED_REPLY = 0xFC000119;
   const static char LAST_REQUEST_FAILED_REPLY_SIG[];
+
+  const static char WINDOWED_TRANSFER_SIG[];
+  /**
+   * Server capability without a message of its own. When the server
+   * announces it, the client may send several DOWNLOAD_DATA_REQUEST or
+   * UPLOAD_DATA_REQUEST messages without waiting for their replies, the
+   * server replies to them in order.
+   *
+   * After DOWNLOAD_END_REPLY, the data requests still in flight are replied
+   * with LAST_REQUEST_FAILED_REPLY.
+   */
+  const static UINT32 WINDOWED_TRANSFER = 0xFC00011A;
+
+  const static char FILE_LIST_PAGED_REQUEST_SIG[];
+  const static char FILE_LIST_PAGE_REPLY_SIG[];
+  /**
+   * Get file list of specified folder on remote computer split to pages,
+   * so the client can show big folders before the whole list is received.
+   *
+   * @body:
+   *  UINT8 compressionLevel preffered compression level.
+   *  StringUTF8 pathToFolder absolute path to folder, file list of that needs to get.
+   *  UINT32 pageSize maximal count of files in one page (0 means server default).
+   *
+   * @reply one or more FILE_LIST_PAGE_REPLY messages on success (the last one
+   * has LAST_PAGE flag set), LAST_REQUEST_FAILED_REPLY on fail.
+   */
+  const static UINT32 FILE_LIST_PAGED_REQUEST = 0xFC00011B;
+  /*
+   * Page of file list sent in reply to FILE_LIST_PAGED_REQUEST message.
+   *
+   * @body:
+   *  UINT8 pageFlags combination of LAST_PAGE flag.
+   *  UINT32 totalCount count of files in the whole list.
+   *  @compressedBlock:
+   *    UINT32 filesCount count of files in this page.
+   *    fileInfo[filesCount] array of structures like in FILE_LIST_REPLY.
+   */
+  const static UINT32 FILE_LIST_PAGE_REPLY = 0xFC00011C;
+  // Flag of FILE_LIST_PAGE_REPLY marking the last page of the list.
+  const static UINT8 LAST_PAGE = 0x1;
+
+  const static char FILE_BATCH_DOWNLOAD_REQUEST_SIG[];
+  const static char FILE_BATCH_DOWNLOAD_REPLY_SIG[];
+  /**
+   * Download of several small files at once, the files are packed into
+   * one stream instead of start, data and end round trips for every file.
+   *
+   * @body:
+   *  UINT8 compressionLevel preffered compression level.
+   *  UINT32 filesCount count of files to download.
+   *  StringUTF8 pathToFile[filesCount] absolute paths to files.
+   *
+   * @reply one or more FILE_BATCH_DOWNLOAD_REPLY messages on success (the
+   * last one has LAST_PAGE flag set), LAST_REQUEST_FAILED_REPLY on fail.
+   *
+   * Server stops packing at the first file that is too big for the batch,
+   * so the last page may hold less files than requested. The client must
+   * download the first not replied file and the rest ones as usual.
+   */
+  const static UINT32 FILE_BATCH_DOWNLOAD_REQUEST = 0xFC00011D;
+  /*
+   * Page of files sent in reply to FILE_BATCH_DOWNLOAD_REQUEST message.
+   *
+   * @body:
+   *  UINT8 pageFlags combination of LAST_PAGE flag.
+   *  @compressedBlock:
+   *    UINT32 filesCount count of files in this page.
+   *    struct {
+   *      UINT32 index index of file in the request.
+   *      UINT8 status BATCH_FILE_OK or BATCH_FILE_FAILED.
+   *      if status is BATCH_FILE_OK:
+   *        UINT64 modTime file last modification time.
+   *        UINT32 dataSize size of file data.
+   *        UINT8 data[dataSize] file data.
+   *      if status is BATCH_FILE_FAILED:
+   *        StringUTF8 reason error description.
+   *    } batchFile[filesCount] files in order of request.
+   */
+  const static UINT32 FILE_BATCH_DOWNLOAD_REPLY = 0xFC00011E;
+  // Status of file in FILE_BATCH_DOWNLOAD_REPLY.
+  const static UINT8 BATCH_FILE_OK = 0;
+  const static UINT8 BATCH_FILE_FAILED = 1;
+
+  const static char CHECKSUM_REQUEST_SIG[];
+  const static char CHECKSUM_REPLY_SIG[];
+  const static char CHECKSUM_PROGRESS_REPLY_SIG[];
+  /**
+   * Request for checksum of file chunk computed by chosen algorithm.
+   *
+   * @body
+   *   StringUTF pathToFile absolute path to file.
+   *   UINT64 offset begin offset of file chunk in bytes.
+   *   UINT64 dataSize size of data in bytes.
+   *   UINT8 algorithm one of CHECKSUM_* values.
+   *
+   * @reply CHECKSUM_REPLY on success (it may be preceded by several
+   * CHECKSUM_PROGRESS_REPLY messages for long chunks),
+   * LAST_REQUEST_FAILED_REPLY on fail.
+   */
+  const static UINT32 CHECKSUM_REQUEST = 0xFC00011F;
+  /**
+   * Reply for CHECKSUM_REQUEST message.
+   *
+   * @body
+   *   UINT8 algorithm algorithm of checksum.
+   *   UINT8 checksumSize size of checksum in bytes.
+   *   UINT8 checksum[checksumSize] checksum of requested file chunk
+   *   (xxh64 is in big endian byte order).
+   */
+  const static UINT32 CHECKSUM_REPLY = 0xFC000120;
+  /**
+   * Progress of CHECKSUM_REQUEST processing.
+   *
+   * @body
+   *   UINT64 bytesHashed count of bytes of chunk processed so far.
+   */
+  const static UINT32 CHECKSUM_PROGRESS_REPLY = 0xFC000121;
+  // Checksum algorithms.
+  const static UINT8 CHECKSUM_MD5 = 0;
+  const static UINT8 CHECKSUM_XXH64 = 1;
+
+  const static char TREE_OPERATION_REQUEST_SIG[];
+  const static char TREE_OPERATION_REPLY_SIG[];
+  const static char TREE_OPERATION_PROGRESS_REPLY_SIG[];
+  const static char TREE_OPERATION_CANCEL_REQUEST_SIG[];
+  /**
+   * Recursive operation on several files and folder trees executed by
+   * server at once, instead of file list and remove (or mkdir) round trips
+   * for every file.
+   *
+   * @body
+   *   UINT8 operation one of TREE_* values:
+   *     TREE_DELETE deletes the files and the folders with their content,
+   *     TREE_SIZE counts the files, the folders and total size of the files,
+   *     TREE_MKDIR creates the folders with missing parent folders.
+   *   UINT32 pathsCount count of paths (TREE_MAX_PATHS at most).
+   *   StringUTF8 path[pathsCount] absolute paths to files or folders.
+   *
+   * @reply TREE_OPERATION_REPLY on success (it may be preceded by several
+   * TREE_OPERATION_PROGRESS_REPLY messages), LAST_REQUEST_FAILED_REPLY on
+   * fail or cancel.
+   *
+   * Fails of single files don't stop the operation, they are counted in
+   * the reply.
+   */
+  const static UINT32 TREE_OPERATION_REQUEST = 0xFC000122;
+  /**
+   * Reply for TREE_OPERATION_REQUEST message.
+   *
+   * @body
+   *   UINT8 operation requested operation.
+   *   UINT64 filesCount count of files deleted or counted.
+   *   UINT64 foldersCount count of folders deleted, counted or created.
+   *   UINT64 totalSize total size of files deleted or counted.
+   *   UINT32 errorsCount count of files and folders failed to process.
+   *   StringUTF8 firstError description of the first fail (empty if none).
+   */
+  const static UINT32 TREE_OPERATION_REPLY = 0xFC000123;
+  /**
+   * Progress of TREE_OPERATION_REQUEST processing, sent about every second.
+   *
+   * @body
+   *   UINT64 filesCount, UINT64 foldersCount, UINT64 totalSize like in
+   *   TREE_OPERATION_REPLY, counted so far.
+   */
+  const static UINT32 TREE_OPERATION_PROGRESS_REPLY = 0xFC000124;
+  /**
+   * Stops processing of TREE_OPERATION_REQUEST. It has no reply of its own,
+   * the stopped operation is replied with LAST_REQUEST_FAILED_REPLY (or with
+   * TREE_OPERATION_REPLY if it's already finished).
+   *
+   * @body has no body.
+   */
+  const static UINT32 TREE_OPERATION_CANCEL_REQUEST = 0xFC000125;
+  // Tree operations.
+  const static UINT8 TREE_DELETE = 0;
+  const static UINT8 TREE_SIZE = 1;
+  const static UINT8 TREE_MKDIR = 2;
+  // Maximal count of paths in TREE_OPERATION_REQUEST.
+  const static UINT32 TREE_MAX_PATHS = 65536;
 };
 
 #endif
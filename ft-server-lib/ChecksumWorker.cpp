@@ -0,0 +1,266 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ChecksumWorker.h"
+
+#include "ft-common/FTMessage.h"
+#include "thread/AutoLock.h"
+#include "util/md5.h"
+#include "util/XXHash64.h"
+
+bool ChecksumWorker::CacheKey::operator<(const CacheKey &other) const
+{
+  if (fileSize != other.fileSize) {
+    return fileSize < other.fileSize;
+  }
+  if (modTime != other.modTime) {
+    return modTime < other.modTime;
+  }
+  if (offset != other.offset) {
+    return offset < other.offset;
+  }
+  if (dataSize != other.dataSize) {
+    return dataSize < other.dataSize;
+  }
+  if (algorithm != other.algorithm) {
+    return algorithm < other.algorithm;
+  }
+  return _tcscmp(pathName.getString(), other.pathName.getString()) < 0;
+}
+
+ChecksumWorker::ChecksumWorker(RfbOutputGate *output, LogWriter *log)
+: m_output(output),
+  m_busy(false),
+  m_log(log)
+{
+  resume();
+}
+
+ChecksumWorker::~ChecksumWorker()
+{
+  terminate();
+  wait();
+
+  while (!m_jobs.empty()) {
+    deleteJob(m_jobs.front());
+    m_jobs.pop_front();
+  }
+}
+
+void ChecksumWorker::addJob(FileChannel *file, const TCHAR *pathName,
+                            UINT64 fileSize, UINT64 modTime,
+                            UINT64 offset, UINT64 dataSize,
+                            UINT8 algorithm, bool legacyReply)
+{
+  Job *job = new Job;
+  job->file = file;
+  job->key.pathName.setString(pathName);
+  job->key.fileSize = fileSize;
+  job->key.modTime = modTime;
+  job->key.offset = offset;
+  job->key.dataSize = dataSize;
+  job->key.algorithm = algorithm;
+  job->legacyReply = legacyReply;
+
+  {
+    AutoLock al(&m_jobsLock);
+    m_jobs.push_back(job);
+  }
+  m_newJobEvent.notify();
+}
+
+void ChecksumWorker::waitForIdle()
+{
+  while (isActive()) {
+    {
+      AutoLock al(&m_jobsLock);
+      if (m_jobs.empty() && !m_busy) {
+        return;
+      }
+    }
+    m_idleEvent.waitForEvent();
+  }
+}
+
+void ChecksumWorker::onTerminate()
+{
+  m_newJobEvent.notify();
+}
+
+void ChecksumWorker::execute()
+{
+  while (!isTerminating()) {
+    Job *job = NULL;
+    {
+      AutoLock al(&m_jobsLock);
+      if (!m_jobs.empty()) {
+        job = m_jobs.front();
+        m_jobs.pop_front();
+        m_busy = true;
+      }
+    }
+
+    if (job == NULL) {
+      m_newJobEvent.waitForEvent();
+      continue;
+    }
+
+    try {
+      processJob(job);
+    } catch (Exception &e) {
+      m_log->error(_T("The checksum thread cannot send reply: %s"),
+                   e.getMessage());
+    }
+    deleteJob(job);
+
+    bool idle;
+    {
+      AutoLock al(&m_jobsLock);
+      m_busy = false;
+      idle = m_jobs.empty();
+    }
+    if (idle) {
+      m_idleEvent.notify();
+    }
+  }
+
+  // Release the waiter if any.
+  m_idleEvent.notify();
+}
+
+void ChecksumWorker::processJob(Job *job)
+{
+  std::map<CacheKey, std::vector<UINT8> >::iterator cached = m_cache.find(job->key);
+  if (cached != m_cache.end()) {
+    sendReply(job, &cached->second);
+    return;
+  }
+
+  std::vector<UINT8> hash;
+  try {
+    computeChecksum(job, &hash);
+  } catch (IOException &ioEx) {
+    sendError(ioEx.getMessage());
+    return;
+  }
+
+  if (isTerminating()) {
+    return;
+  }
+
+  if (m_cache.size() >= MAX_CACHE_ENTRIES) {
+    m_cache.clear();
+  }
+  m_cache[job->key] = hash;
+
+  sendReply(job, &hash);
+}
+
+void ChecksumWorker::computeChecksum(Job *job, std::vector<UINT8> *hash)
+{
+  MD5 md5;
+  XXHash64 xxHash;
+
+  job->file->seek((INT64)job->key.offset);
+
+  UINT64 left = job->key.dataSize;
+  UINT64 bytesHashed = 0;
+  UINT64 nextProgress = PROGRESS_STEP;
+
+  std::vector<UINT8> buffer((size_t)min((UINT64)READ_BUFFER_SIZE, max(left, (UINT64)1)));
+
+  while (left > 0 && !isTerminating()) {
+    size_t toRead = (size_t)min((UINT64)buffer.size(), left);
+    size_t read = job->file->read(&buffer.front(), toRead);
+
+    if (job->key.algorithm == FTMessage::CHECKSUM_XXH64) {
+      xxHash.update(&buffer.front(), read);
+    } else {
+      md5.update(&buffer.front(), (UINT32)read);
+    }
+    left -= read;
+    bytesHashed += read;
+
+    if (!job->legacyReply && bytesHashed >= nextProgress && left > 0) {
+      sendProgress(bytesHashed);
+      nextProgress += PROGRESS_STEP;
+    }
+  }
+
+  if (job->key.algorithm == FTMessage::CHECKSUM_XXH64) {
+    xxHash.finalize();
+    hash->assign(xxHash.getHash(), xxHash.getHash() + XXHash64::HASH_SIZE);
+  } else {
+    md5.finalize();
+    hash->assign(md5.getHash(), md5.getHash() + 16);
+  }
+}
+
+void ChecksumWorker::sendProgress(UINT64 bytesHashed)
+{
+  AutoLock l(m_output);
+
+  m_output->writeUInt32(FTMessage::CHECKSUM_PROGRESS_REPLY);
+  m_output->writeUInt64(bytesHashed);
+
+  m_output->flush();
+}
+
+void ChecksumWorker::sendReply(const Job *job, const std::vector<UINT8> *hash)
+{
+  AutoLock l(m_output);
+
+  if (job->legacyReply) {
+    m_output->writeUInt32(FTMessage::MD5_REPLY);
+  } else {
+    m_output->writeUInt32(FTMessage::CHECKSUM_REPLY);
+    m_output->writeUInt8(job->key.algorithm);
+    m_output->writeUInt8((UINT8)hash->size());
+  }
+  m_output->writeFully(&hash->front(), hash->size());
+
+  m_output->flush();
+}
+
+void ChecksumWorker::sendError(const TCHAR *description)
+{
+  m_log->error(_T("last request failed: \"%s\""), description);
+
+  AutoLock l(m_output);
+
+  m_output->writeUInt32(FTMessage::LAST_REQUEST_FAILED_REPLY);
+  m_output->writeUTF8(description);
+
+  m_output->flush();
+}
+
+void ChecksumWorker::deleteJob(Job *job)
+{
+  try {
+    job->file->close();
+  } catch (...) {
+  }
+  delete job->file;
+  delete job;
+}
@@ -0,0 +1,129 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _CHECKSUM_WORKER_H_
+#define _CHECKSUM_WORKER_H_
+
+#include "util/CommonHeader.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "file-lib/FileChannel.h"
+#include "network/RfbOutputGate.h"
+#include "log-writer/LogWriter.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+/**
+ * Computes checksums of file blocks requested by MD5_REQUEST and
+ * CHECKSUM_REQUEST messages in its own thread and writes the replies,
+ * so hashing of big files does not stop the processing of other client
+ * messages.
+ *
+ * Checksums are cached by file path, size, modification time, block and
+ * algorithm, the cache is dropped when it's full.
+ *
+ * Replies are written in the order of requests. The caller must wait for
+ * the idle state before it writes any other file transfer reply.
+ */
+class ChecksumWorker : public Thread
+{
+public:
+  ChecksumWorker(RfbOutputGate *output, LogWriter *log);
+  virtual ~ChecksumWorker();
+
+  /**
+   * Queues checksum computation.
+   * @param file file opened for reading (the worker takes ownership of it).
+   * @param pathName path to the file, fileSize and modTime - its current
+   *   size and modification time, used as key of the cache.
+   * @param algorithm one of FTMessage::CHECKSUM_* values.
+   * @param legacyReply if true, MD5_REPLY is sent instead of CHECKSUM_REPLY
+   *   and no progress is reported.
+   */
+  void addJob(FileChannel *file, const TCHAR *pathName,
+              UINT64 fileSize, UINT64 modTime,
+              UINT64 offset, UINT64 dataSize,
+              UINT8 algorithm, bool legacyReply);
+
+  /**
+   * Waits until all queued checksums are replied.
+   */
+  void waitForIdle();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  struct CacheKey
+  {
+    StringStorage pathName;
+    UINT64 fileSize;
+    UINT64 modTime;
+    UINT64 offset;
+    UINT64 dataSize;
+    UINT8 algorithm;
+
+    bool operator<(const CacheKey &other) const;
+  };
+
+  struct Job
+  {
+    FileChannel *file;
+    CacheKey key;
+    bool legacyReply;
+  };
+
+  void processJob(Job *job);
+  void computeChecksum(Job *job, std::vector<UINT8> *hash);
+  void sendProgress(UINT64 bytesHashed);
+  void sendReply(const Job *job, const std::vector<UINT8> *hash);
+  void sendError(const TCHAR *description);
+
+  static void deleteJob(Job *job);
+
+  RfbOutputGate *m_output;
+
+  std::deque<Job *> m_jobs;
+  // True while the job taken from the queue is processed.
+  bool m_busy;
+  LocalMutex m_jobsLock;
+  WindowsEvent m_newJobEvent;
+  WindowsEvent m_idleEvent;
+
+  // Used by the worker thread only.
+  std::map<CacheKey, std::vector<UINT8> > m_cache;
+
+  static const size_t MAX_CACHE_ENTRIES = 4096;
+  static const size_t READ_BUFFER_SIZE = 1024 * 1024;
+  // Progress of longer blocks is reported every this count of bytes.
+  static const UINT64 PROGRESS_STEP = 64 * 1024 * 1024;
+
+  LogWriter *m_log;
+};
+
+#endif
@@ -34,7 +34,7 @@
 #include "ft-common/FTMessage.h"
 #include "ft-common/WinFilePath.h"
 #include "ft-common/FileInfo.h"
-#include "util/md5.h"
+#include "util/DateTime.h"
 #include "network/RfbOutputGate.h"
 #include "network/RfbInputGate.h"
 #include "thread/AutoLock.h"
@@ -48,10 +48,17 @@ FileTransferRequestHandler::FileTransferRequestHandler(RfbCodeRegistrator *regis
                                                        RfbOutputGate *output,
                                                        Desktop *desktop,
                                                        LogWriter *log,
-                                                       bool enabled)
+                                                       bool enabled,
+                                                       TokenBucket *bandwidth,
+                                                       FileTransmitter *transmitter)
 : m_downloadFile(NULL), m_fileInputStream(NULL),
   m_uploadFile(NULL), m_fileOutputStream(NULL),
-  m_output(output), m_enabled(enabled),
+  m_rawChunksLeft(0),
+  m_checksumWorker(output, log),
+  m_treeOperationWorker(output, log),
+  m_output(output), m_desktop(desktop), m_enabled(enabled),
+  m_bandwidth(bandwidth),
+  m_transmitter(transmitter),
   m_log(log)
 {
   m_security = new FileTransferSecurity(desktop, m_log);
@@ -74,6 +81,13 @@ FileTransferRequestHandler::FileTransferRequestHandler(RfbCodeRegistrator *regis
   registrator->addSrvToClCap(FTMessage::RENAME_REPLY, VendorDefs::TIGHTVNC, FTMessage::RENAME_REPLY_SIG);
   registrator->addSrvToClCap(FTMessage::DIRSIZE_REPLY, VendorDefs::TIGHTVNC, FTMessage::DIRSIZE_REPLY_SIG);
   registrator->addSrvToClCap(FTMessage::LAST_REQUEST_FAILED_REPLY, VendorDefs::TIGHTVNC, FTMessage::LAST_REQUEST_FAILED_REPLY_SIG);
+  registrator->addSrvToClCap(FTMessage::WINDOWED_TRANSFER, VendorDefs::TIGHTVNC, FTMessage::WINDOWED_TRANSFER_SIG);
+  registrator->addSrvToClCap(FTMessage::FILE_LIST_PAGE_REPLY, VendorDefs::TIGHTVNC, FTMessage::FILE_LIST_PAGE_REPLY_SIG);
+  registrator->addSrvToClCap(FTMessage::FILE_BATCH_DOWNLOAD_REPLY, VendorDefs::TIGHTVNC, FTMessage::FILE_BATCH_DOWNLOAD_REPLY_SIG);
+  registrator->addSrvToClCap(FTMessage::CHECKSUM_REPLY, VendorDefs::TIGHTVNC, FTMessage::CHECKSUM_REPLY_SIG);
+  registrator->addSrvToClCap(FTMessage::CHECKSUM_PROGRESS_REPLY, VendorDefs::TIGHTVNC, FTMessage::CHECKSUM_PROGRESS_REPLY_SIG);
+  registrator->addSrvToClCap(FTMessage::TREE_OPERATION_REPLY, VendorDefs::TIGHTVNC, FTMessage::TREE_OPERATION_REPLY_SIG);
+  registrator->addSrvToClCap(FTMessage::TREE_OPERATION_PROGRESS_REPLY, VendorDefs::TIGHTVNC, FTMessage::TREE_OPERATION_PROGRESS_REPLY_SIG);
 
   registrator->addClToSrvCap(FTMessage::COMPRESSION_SUPPORT_REQUEST, VendorDefs::TIGHTVNC, FTMessage::COMPRESSION_SUPPORT_REQUEST_SIG);
   registrator->addClToSrvCap(FTMessage::FILE_LIST_REQUEST, VendorDefs::TIGHTVNC, FTMessage::FILE_LIST_REQUEST_SIG);
@@ -87,6 +101,11 @@ FileTransferRequestHandler::FileTransferRequestHandler(RfbCodeRegistrator *regis
   registrator->addClToSrvCap(FTMessage::REMOVE_REQUEST, VendorDefs::TIGHTVNC, FTMessage::REMOVE_REQUEST_SIG);
   registrator->addClToSrvCap(FTMessage::RENAME_REQUEST, VendorDefs::TIGHTVNC, FTMessage::RENAME_REQUEST_SIG);
   registrator->addClToSrvCap(FTMessage::DIRSIZE_REQUEST, VendorDefs::TIGHTVNC, FTMessage::DIRSIZE_REQUEST_SIG);
+  registrator->addClToSrvCap(FTMessage::FILE_LIST_PAGED_REQUEST, VendorDefs::TIGHTVNC, FTMessage::FILE_LIST_PAGED_REQUEST_SIG);
+  registrator->addClToSrvCap(FTMessage::FILE_BATCH_DOWNLOAD_REQUEST, VendorDefs::TIGHTVNC, FTMessage::FILE_BATCH_DOWNLOAD_REQUEST_SIG);
+  registrator->addClToSrvCap(FTMessage::CHECKSUM_REQUEST, VendorDefs::TIGHTVNC, FTMessage::CHECKSUM_REQUEST_SIG);
+  registrator->addClToSrvCap(FTMessage::TREE_OPERATION_REQUEST, VendorDefs::TIGHTVNC, FTMessage::TREE_OPERATION_REQUEST_SIG);
+  registrator->addClToSrvCap(FTMessage::TREE_OPERATION_CANCEL_REQUEST, VendorDefs::TIGHTVNC, FTMessage::TREE_OPERATION_CANCEL_REQUEST_SIG);
 
   UINT32 rfbMessagesToProcess[] = {
     FTMessage::COMPRESSION_SUPPORT_REQUEST,
@@ -100,7 +119,12 @@ FileTransferRequestHandler::FileTransferRequestHandler(RfbCodeRegistrator *regis
     FTMessage::MKDIR_REQUEST,
     FTMessage::REMOVE_REQUEST,
     FTMessage::RENAME_REQUEST,
-    FTMessage::DIRSIZE_REQUEST
+    FTMessage::DIRSIZE_REQUEST,
+    FTMessage::FILE_LIST_PAGED_REQUEST,
+    FTMessage::FILE_BATCH_DOWNLOAD_REQUEST,
+    FTMessage::CHECKSUM_REQUEST,
+    FTMessage::TREE_OPERATION_REQUEST,
+    FTMessage::TREE_OPERATION_CANCEL_REQUEST
   };
 
   for (size_t i = 0; i < sizeof(rfbMessagesToProcess) / sizeof(UINT32); i++) {
@@ -136,6 +160,23 @@ void FileTransferRequestHandler::onRequest(UINT32 reqCode, RfbInputGate *backGat
 
   m_input = backGate;
 
+  //
+  // Checksums are replied by the checksum worker and tree operations by
+  // the tree operation worker, other replies must not overtake them. The
+  // cancel request has no reply, it must not wait for the operation it
+  // cancels.
+  //
+
+  bool isChecksumRequest = reqCode == FTMessage::MD5_REQUEST ||
+                           reqCode == FTMessage::CHECKSUM_REQUEST;
+  bool isCancelRequest = reqCode == FTMessage::TREE_OPERATION_CANCEL_REQUEST;
+  if (!isChecksumRequest && !isCancelRequest) {
+    m_checksumWorker.waitForIdle();
+  }
+  if (!isCancelRequest) {
+    m_treeOperationWorker.waitForIdle();
+  }
+
   try {
     switch (reqCode) {
     case FTMessage::COMPRESSION_SUPPORT_REQUEST:
@@ -144,6 +185,9 @@ void FileTransferRequestHandler::onRequest(UINT32 reqCode, RfbInputGate *backGat
     case FTMessage::FILE_LIST_REQUEST:
       fileListRequested();
       break;
+    case FTMessage::FILE_LIST_PAGED_REQUEST:
+      fileListPagedRequested();
+      break;
     case FTMessage::MKDIR_REQUEST:
       mkDirRequested();
       break;
@@ -171,11 +215,26 @@ void FileTransferRequestHandler::onRequest(UINT32 reqCode, RfbInputGate *backGat
     case FTMessage::DOWNLOAD_DATA_REQUEST:
       downloadDataRequested();
       break;
+    case FTMessage::FILE_BATCH_DOWNLOAD_REQUEST:
+      batchDownloadRequested();
+      break;
     case FTMessage::MD5_REQUEST:
       md5Requested();
       break;
+    case FTMessage::CHECKSUM_REQUEST:
+      checksumRequested();
+      break;
+    case FTMessage::TREE_OPERATION_REQUEST:
+      treeOperationRequested();
+      break;
+    case FTMessage::TREE_OPERATION_CANCEL_REQUEST:
+      treeOperationCancelRequested();
+      break;
     } // switch.
   } catch (Exception &someEx) {
+    if (isChecksumRequest) {
+      m_checksumWorker.waitForIdle();
+    }
     lastRequestFailed(someEx.getMessage());
   } // try / catch.
 
@@ -186,7 +245,7 @@ void FileTransferRequestHandler::onRequest(UINT32 reqCode, RfbInputGate *backGat
 
 bool FileTransferRequestHandler::isFileTransferEnabled()
 {
-  return m_enabled && Configurator::getInstance()->getServerConfig()->isFileTransfersEnabled();
+  return m_enabled && Configurator::getConfigSnapshot()->isFileTransfersEnabled();
 }
 
 void FileTransferRequestHandler::compressionSupportRequested()
@@ -232,79 +291,90 @@ void FileTransferRequestHandler::fileListRequested()
 
   checkAccess();
 
-  UINT8 compressionLevel = requestedCompressionLevel;
-  UINT32 compressedSize = 0;
-  UINT32 uncompressedSize = 0;
-  UINT32 filesCount = 0;
-  UINT32 filesInfoDataSize = 0;
-  const FileInfo *files = NULL;
-
   //
   // Get file list from specified folder
   //
 
-  FolderListener folderListener(fullPathName.getString());
+  const std::vector<FileInfo> *files = getFileList(fullPathName.getString());
 
-  if (!folderListener.list()) {
-    throw SystemException();
-  }
-
-  files = folderListener.getFilesInfo();
-  filesCount = folderListener.getFilesCount();
+  ByteArrayOutputStream compressedBlock;
+  packFileList(files, 0, files->size(), requestedCompressionLevel,
+               &compressedBlock);
 
   //
-  // Create buffer with "CompressedData" block inside
+  // Write data to socket
   //
 
-  ByteArrayOutputStream memStream;
-  DataOutputStream outMemStream(&memStream);
+  {
+    AutoLock l(m_output);
 
-  outMemStream.writeUInt32(filesCount);
-  for (UINT32 i = 0; i < filesCount; i++) {
-    outMemStream.writeUInt64(files[i].getSize());
-    outMemStream.writeUInt64(files[i].lastModified());
-    outMemStream.writeUInt16(files[i].getFlags());
-    outMemStream.writeUTF8(files[i].getFileName());
-  } // for
+    m_output->writeUInt32(FTMessage::FILE_LIST_REPLY);
+    m_output->writeFully(compressedBlock.toByteArray(), compressedBlock.size());
+
+    m_output->flush();
+  } // synchronized(m_output)
+} // void
 
-  _ASSERT((UINT32)memStream.size() == memStream.size());
-  uncompressedSize = (UINT32)memStream.size();
+void FileTransferRequestHandler::fileListPagedRequested()
+{
+  UINT8 requestedCompressionLevel;
+  WinFilePath fullPathName;
+  UINT32 pageSize;
 
   //
-  // Buffer for data in "CompressedData" block
+  // Read input data
   //
 
-  compressedSize = uncompressedSize;
+  {
+    requestedCompressionLevel = m_input->readUInt8();
 
-  if (compressionLevel != 0) {
-    m_deflater.setInput(memStream.toByteArray(), memStream.size());
-    m_deflater.deflate();
-    _ASSERT((UINT32)m_deflater.getOutputSize() == m_deflater.getOutputSize());
-    compressedSize = (UINT32)m_deflater.getOutputSize();
+    m_input->readUTF8(&fullPathName);
+
+    pageSize = m_input->readUInt32();
   }
 
+  m_log->message(_T("Paged file list of folder '%s' requested"),
+               fullPathName.getString());
+
+  checkAccess();
+
+  if (pageSize == 0) {
+    pageSize = DEFAULT_FILE_LIST_PAGE_SIZE;
+  }
+  pageSize = min(pageSize, MAX_FILE_LIST_PAGE_SIZE);
+
+  const std::vector<FileInfo> *files = getFileList(fullPathName.getString());
+
+  _ASSERT((UINT32)files->size() == files->size());
+  UINT32 totalCount = (UINT32)files->size();
+
   //
-  // Write data to socket
+  // Every page is written under its own lock, so other messages (frame
+  // buffer updates) are not held back until the whole list is sent.
+  // An empty folder is sent as single empty last page.
   //
 
-  {
-    AutoLock l(m_output);
+  UINT32 first = 0;
+  do {
+    UINT32 count = min(pageSize, totalCount - first);
+    UINT8 pageFlags = (first + count == totalCount) ? FTMessage::LAST_PAGE : 0;
 
-    m_output->writeUInt32(FTMessage::FILE_LIST_REPLY);
+    ByteArrayOutputStream compressedBlock;
+    packFileList(files, first, count, requestedCompressionLevel,
+                 &compressedBlock);
 
-    m_output->writeUInt8(compressionLevel);
-    m_output->writeUInt32(compressedSize);
-    m_output->writeUInt32(uncompressedSize);
+    AutoLock l(m_output);
 
-    if (compressionLevel != 0) {
-      m_output->writeFully(m_deflater.getOutput(), compressedSize);
-    } else {
-      m_output->writeFully(memStream.toByteArray(), uncompressedSize);
-    }
+    m_output->writeUInt32(FTMessage::FILE_LIST_PAGE_REPLY);
+    m_output->writeUInt8(pageFlags);
+    m_output->writeUInt32(totalCount);
+    m_output->writeFully(compressedBlock.toByteArray(), compressedBlock.size());
 
     m_output->flush();
-  } // synchronized(m_output)
-} // void
+
+    first += count;
+  } while (first < totalCount);
+}
 
 void FileTransferRequestHandler::mkDirRequested()
 {
@@ -318,6 +388,10 @@ void FileTransferRequestHandler::mkDirRequested()
 
   checkAccess();
 
+  // Changes of listed folders are also watched, but drop the cached
+  // lists at once so the next listing shows the change for sure.
+  m_folderListCache.invalidate();
+
   if (folderPath.parentPathIsRoot()) {
     throw FileTransferException(_T("Cannot create folder in root folder"));
   }
@@ -353,6 +427,8 @@ void FileTransferRequestHandler::rmFileRequested()
 
   checkAccess();
 
+  m_folderListCache.invalidate();
+
   File file(fullPathName.getString());
 
   if (!file.exists()) {
@@ -386,6 +462,8 @@ void FileTransferRequestHandler::mvFileRequested()
 
   checkAccess();
 
+  m_folderListCache.invalidate();
+
   File srcFile(oldFileName.getString());
   File dstFile(newFileName.getString());
 
@@ -449,56 +527,125 @@ void FileTransferRequestHandler::md5Requested()
 
   checkAccess();
 
-  //
-  // Action
-  //
+  queueChecksum(fullPathName.getString(), offset, dataLen,
+                FTMessage::CHECKSUM_MD5, true);
+}
 
-  MD5 md5calculator;
+void FileTransferRequestHandler::checksumRequested()
+{
+  WinFilePath fullPathName;
 
-  File file(fullPathName.getString());
+  UINT64 offset;
+  UINT64 dataLen;
+  UINT8 algorithm;
 
-  StringStorage path;
-  file.getPath(&path);
-  WinFileChannel fileInputStream(path.getString(), F_READ, FM_OPEN);
-  fileInputStream.seek(offset);
+  {
+    m_input->readUTF8(&fullPathName);
 
-  //
-  // Begin reading needed file data
-  //
+    offset = m_input->readUInt64();
+    dataLen = m_input->readUInt64();
+    algorithm = m_input->readUInt8();
+  } // end of reading block.
+
+  m_log->message(_T("checksum (%d) \"%s\" %I64u %I64u command requested"),
+                 (int)algorithm, fullPathName.getString(), offset, dataLen);
 
-  DWORD bytesToRead = 1024 * 1024;
-  UINT64 bytesToReadTotal = dataLen;
-  size_t bytesRead = 0;
-  UINT64 bytesReadTotal = 0;
+  checkAccess();
 
-  if (dataLen < (UINT64)bytesToRead) {
-    bytesToRead = (DWORD)dataLen;
+  if (algorithm != FTMessage::CHECKSUM_MD5 &&
+      algorithm != FTMessage::CHECKSUM_XXH64) {
+    throw FileTransferException(_T("Unknown checksum algorithm"));
   }
 
-  std::vector<UINT8> buffer(bytesToRead);
+  queueChecksum(fullPathName.getString(), offset, dataLen, algorithm, false);
+}
 
-  while (bytesToReadTotal > 0) {
-    bytesRead = fileInputStream.read(&buffer.front(), bytesToRead);
-    bytesReadTotal += bytesRead;
-    bytesToReadTotal -= bytesRead;
+void FileTransferRequestHandler::treeOperationRequested()
+{
+  UINT8 operation;
+  UINT32 pathsCount;
 
-    if (bytesToReadTotal < (UINT64)bytesToRead) {
-      bytesToRead = (DWORD)bytesToReadTotal;
-    }
+  {
+    operation = m_input->readUInt8();
+    pathsCount = m_input->readUInt32();
+  }
 
-    md5calculator.update(&buffer.front(), (UINT32)bytesRead);
-  } // while
+  if (pathsCount > FTMessage::TREE_MAX_PATHS) {
+    throw FileTransferException(_T("Too many paths in tree operation request"));
+  }
 
-  md5calculator.finalize();
+  std::vector<WinFilePath> pathNames(pathsCount);
+  for (UINT32 i = 0; i < pathsCount; i++) {
+    m_input->readUTF8(&pathNames[i]);
+  }
 
-  {
-    AutoLock l(m_output);
+  m_log->message(_T("tree operation %d of %u paths requested"),
+                 (int)operation, pathsCount);
 
-    m_output->writeUInt32(FTMessage::MD5_REPLY);
-    m_output->writeFully((const char *)md5calculator.getHash(), 16);
+  checkAccess();
 
-    m_output->flush();
+  if (operation != FTMessage::TREE_DELETE &&
+      operation != FTMessage::TREE_SIZE &&
+      operation != FTMessage::TREE_MKDIR) {
+    throw FileTransferException(_T("Unknown tree operation"));
   }
+
+  std::vector<StringStorage> paths(pathsCount);
+  for (UINT32 i = 0; i < pathsCount; i++) {
+    if (operation != FTMessage::TREE_SIZE && pathNames[i].parentPathIsRoot()) {
+      throw FileTransferException(_T("Cannot change root folder"));
+    }
+    paths[i].setString(pathNames[i].getString());
+  }
+
+  if (operation != FTMessage::TREE_SIZE) {
+    m_folderListCache.invalidate();
+  }
+
+  //
+  // The worker runs with the rights of this thread, so it gets its
+  // impersonation token (if the thread is not impersonated, the worker
+  // runs as the process like this thread does).
+  //
+
+  HANDLE token = 0;
+  if (!OpenThreadToken(GetCurrentThread(), TOKEN_IMPERSONATE | TOKEN_QUERY,
+                       TRUE, &token)) {
+    if (GetLastError() != ERROR_NO_TOKEN) {
+      throw SystemException();
+    }
+    token = 0;
+  }
+
+  m_treeOperationWorker.start(operation, &paths, token);
+}
+
+void FileTransferRequestHandler::treeOperationCancelRequested()
+{
+  m_log->message(_T("tree operation cancel requested"));
+
+  m_treeOperationWorker.cancel();
+}
+
+void FileTransferRequestHandler::queueChecksum(const TCHAR *pathName,
+                                               UINT64 offset, UINT64 dataSize,
+                                               UINT8 algorithm, bool legacyReply)
+{
+  //
+  // File is opened here, under impersonation of the message processing,
+  // the worker only reads it.
+  //
+
+  File file(pathName);
+
+  StringStorage path;
+  file.getPath(&path);
+
+  FileChannel *fileInputStream = new WinFileChannel(path.getString(), F_READ, FM_OPEN);
+
+  m_checksumWorker.addJob(fileInputStream, path.getString(),
+                          file.length(), file.lastModified(),
+                          offset, dataSize, algorithm, legacyReply);
 }
 
 void FileTransferRequestHandler::uploadStartRequested()
@@ -521,6 +668,8 @@ void FileTransferRequestHandler::uploadStartRequested()
 
   checkAccess();
 
+  m_folderListCache.invalidate();
+
   //
   // Closing previous upload if it was broken
   //
@@ -551,9 +700,9 @@ void FileTransferRequestHandler::uploadStartRequested()
   //
   // Trying to open file and seek to initial file position
   //
-  m_fileOutputStream = new WinFileChannel(fullPathName.getString(),
-                                          F_WRITE,
-                                          FM_OPEN);
+  m_fileOutputStream = new OverlappedFileChannel(fullPathName.getString(),
+                                                 F_WRITE,
+                                                 FM_OPEN);
   m_fileOutputStream->seek(initialOffset);
 
   //
@@ -610,6 +759,11 @@ void FileTransferRequestHandler::uploadDataRequested()
     } // if using compression
   }
 
+  // The client sends the next chunk on the reply.
+  if (m_bandwidth != 0) {
+    m_bandwidth->consume(compressedSize);
+  }
+
   {
     AutoLock l(m_output);
 
@@ -633,6 +787,8 @@ void FileTransferRequestHandler::uploadEndRequested()
 
   checkAccess();
 
+  m_folderListCache.invalidate();
+
   //
   // No active uploads at the moment.
   // Client is "bad" if send to us this message
@@ -643,12 +799,14 @@ void FileTransferRequestHandler::uploadEndRequested()
   }
 
   //
-  // Close file output stream
+  // Close file output stream, the data written behind may fail here.
   //
 
   try {
     m_fileOutputStream->close();
-  } catch (...) { }
+  } catch (IOException &ioEx) {
+    throw FileTransferException(&ioEx);
+  }
 
   //
   // Trying to set modification time
@@ -725,8 +883,17 @@ void FileTransferRequestHandler::downloadStartRequested()
   // file position.
   //
 
-  m_fileInputStream = new WinFileChannel(fullPathName.getString(), F_READ,
-                                         FM_OPEN);
+  //
+  // Disk reads ahead while the chunks are sent, huge files are read
+  // without the system cache to keep the cache for other data. The files
+  // sent by the transmitter are read by the system through the cache.
+  //
+
+  bool transmittable = m_transmitter != 0 && m_transmitter->canTransmitFiles();
+  bool unbuffered = !transmittable &&
+                    m_downloadFile->length() >= UNBUFFERED_DOWNLOAD_MIN_SIZE;
+  m_fileInputStream = new OverlappedFileChannel(fullPathName.getString(), F_READ,
+                                                FM_OPEN, true, unbuffered);
   m_fileInputStream->seek(initialOffset);
 
   {
@@ -777,6 +944,19 @@ void FileTransferRequestHandler::downloadDataRequested()
     throw FileTransferException(_T("No active download at the moment"));
   }
 
+  //
+  // Chunks that follow an incompressible one are sent as is.
+  //
+
+  if (compressionLevel != 0 && m_rawChunksLeft > 0) {
+    m_rawChunksLeft--;
+    compressionLevel = 0;
+  }
+
+  if (compressionLevel == 0 && transmitDownloadData(dataSize)) {
+    return;
+  }
+
   std::vector<char> buffer(dataSize);
 
   DWORD read = 0;
@@ -824,12 +1004,21 @@ void FileTransferRequestHandler::downloadDataRequested()
   compressedSize = read;
   uncompressedSize = read;
 
+  UINT64 deflateTime = 0;
+
   if (compressionLevel != 0) {
     if (dataSize != 0) {
+      DateTime deflateStart = DateTime::now();
       m_deflater.setInput(&buffer.front(), uncompressedSize);
       m_deflater.deflate();
       _ASSERT((UINT32)m_deflater.getOutputSize() == m_deflater.getOutputSize());
       compressedSize = (UINT32)m_deflater.getOutputSize();
+      deflateTime = (DateTime::now() - deflateStart).getTime();
+
+      if ((UINT64)compressedSize * 100 >=
+          (UINT64)uncompressedSize * MIN_COMPRESSION_GAIN_PERCENT) {
+        m_rawChunksLeft = RAW_CHUNKS_AFTER_NO_GAIN;
+      }
     }
   }
 
@@ -837,6 +1026,12 @@ void FileTransferRequestHandler::downloadDataRequested()
   // Send download data reply
   //
 
+  if (m_bandwidth != 0) {
+    m_bandwidth->consume(compressedSize);
+  }
+
+  DateTime sendStart = DateTime::now();
+
   AutoLock l(m_output);
 
   m_output->writeUInt32(FTMessage::DOWNLOAD_DATA_REPLY);
@@ -853,6 +1048,204 @@ void FileTransferRequestHandler::downloadDataRequested()
   }
 
   m_output->flush();
+
+  if (compressionLevel != 0 && dataSize != 0) {
+    adaptCompressionLevel(deflateTime, (DateTime::now() - sendStart).getTime());
+  }
+}
+
+void FileTransferRequestHandler::batchDownloadRequested()
+{
+  UINT8 requestedCompressionLevel;
+  UINT32 filesCount;
+
+  //
+  // Read input data
+  //
+
+  requestedCompressionLevel = m_input->readUInt8();
+  filesCount = m_input->readUInt32();
+
+  if (filesCount > MAX_BATCH_FILES) {
+    throw FileTransferException(_T("Too many files in batch download request"));
+  }
+
+  std::vector<WinFilePath> pathNames(filesCount);
+  for (UINT32 i = 0; i < filesCount; i++) {
+    m_input->readUTF8(&pathNames[i]);
+  }
+
+  m_log->message(_T("batch download of %d files requested"), filesCount);
+
+  checkAccess();
+
+  //
+  // Files are packed into pages, every page is written under its own lock.
+  // Errors of single files are sent to client along with the other files.
+  //
+
+  UINT32 i = 0;
+  bool stopped = false;
+
+  do {
+    ByteArrayOutputStream records;
+    DataOutputStream outRecords(&records);
+    UINT32 pageFilesCount = 0;
+
+    for (; i < filesCount && records.size() < BATCH_PAGE_SIZE; i++) {
+      File file(pathNames[i].getString());
+
+      // Big file (it may grow since it was listed) is downloaded as usual.
+      if (file.length() > MAX_BATCH_FILE_SIZE) {
+        m_log->debug(_T("batch download stopped at \"%s\": file is too big"),
+                     pathNames[i].getString());
+        stopped = true;
+        break;
+      }
+
+      std::vector<char> buffer((size_t)file.length());
+      size_t read = 0;
+      UINT64 lastModified = 0;
+
+      try {
+        WinFileChannel fis(pathNames[i].getString(), F_READ, FM_OPEN);
+        try {
+          while (read < buffer.size()) {
+            read += fis.read(&buffer[read], buffer.size() - read);
+          }
+        } catch (EOFException) {
+          // File is truncated since it was listed.
+        }
+        lastModified = file.lastModified();
+      } catch (IOException &ioEx) {
+        outRecords.writeUInt32(i);
+        outRecords.writeUInt8(FTMessage::BATCH_FILE_FAILED);
+        outRecords.writeUTF8(ioEx.getMessage());
+        pageFilesCount++;
+        continue;
+      }
+
+      _ASSERT((UINT32)read == read);
+      outRecords.writeUInt32(i);
+      outRecords.writeUInt8(FTMessage::BATCH_FILE_OK);
+      outRecords.writeUInt64(lastModified);
+      outRecords.writeUInt32((UINT32)read);
+      if (read != 0) {
+        outRecords.writeFully(&buffer.front(), read);
+      }
+      pageFilesCount++;
+    }
+
+    UINT8 pageFlags = (stopped || i == filesCount) ? FTMessage::LAST_PAGE : 0;
+    sendBatchDownloadPage(pageFlags, pageFilesCount, &records,
+                          requestedCompressionLevel);
+  } while (!stopped && i < filesCount);
+
+  m_log->message(_T("%s"), _T("batch downloading has finished\n"));
+}
+
+void FileTransferRequestHandler::sendBatchDownloadPage(UINT8 pageFlags,
+                                                       UINT32 filesCount,
+                                                       ByteArrayOutputStream *records,
+                                                       UINT8 compressionLevel)
+{
+  ByteArrayOutputStream page;
+  DataOutputStream outPage(&page);
+
+  outPage.writeUInt32(filesCount);
+  if (records->size() != 0) {
+    outPage.writeFully(records->toByteArray(), records->size());
+  }
+
+  ByteArrayOutputStream compressedBlock;
+  packCompressedBlock(&page, compressionLevel, &compressedBlock);
+
+  AutoLock l(m_output);
+
+  m_output->writeUInt32(FTMessage::FILE_BATCH_DOWNLOAD_REPLY);
+  m_output->writeUInt8(pageFlags);
+  m_output->writeFully(compressedBlock.toByteArray(), compressedBlock.size());
+
+  m_output->flush();
+}
+
+void FileTransferRequestHandler::adaptCompressionLevel(UINT64 deflateTime,
+                                                       UINT64 sendTime)
+{
+  int level = m_deflater.getLevel();
+  if (level == Z_DEFAULT_COMPRESSION) {
+    level = 6;
+  }
+
+  //
+  // Compression slower than the link wastes time, a link much slower than
+  // compression leaves time for better compression.
+  //
+
+  if (deflateTime > sendTime && level > 1) {
+    level--;
+  } else if (deflateTime * 4 < sendTime && level < 9) {
+    level++;
+  } else {
+    return;
+  }
+
+  m_deflater.setLevel(level);
+  m_log->debug(_T("File transfer compression level is changed to %d"), level);
+}
+
+bool FileTransferRequestHandler::transmitDownloadData(UINT32 dataSize)
+{
+  if (m_transmitter == 0 || dataSize == 0 ||
+      m_fileInputStream->isUnbuffered() ||
+      !m_transmitter->canTransmitFiles()) {
+    return false;
+  }
+
+  UINT64 position;
+  UINT32 size;
+  try {
+    position = m_fileInputStream->getPosition();
+    UINT64 fileSize = m_fileInputStream->getFileSize();
+    if (position >= fileSize) {
+      // The end of the file is replied by the usual way.
+      return false;
+    }
+    size = (UINT32)min((UINT64)dataSize, fileSize - position);
+  } catch (IOException &ioEx) {
+    throw FileTransferException(&ioEx);
+  }
+
+  ByteArrayOutputStream headBytes;
+  DataOutputStream head(&headBytes);
+  head.writeUInt32(FTMessage::DOWNLOAD_DATA_REPLY);
+  head.writeUInt8(0);
+  head.writeUInt32(size);
+  head.writeUInt32(size);
+
+  {
+    AutoLock l(m_output);
+
+    if (m_output->isCompressing()) {
+      return false;
+    }
+    m_output->flushThrough();
+    if (!m_transmitter->transmitFile(m_fileInputStream->getHandle(), position,
+                                     size, headBytes.toByteArray(),
+                                     headBytes.size())) {
+      return false;
+    }
+  }
+  // The data have been sent already, the next request waits instead.
+  if (m_bandwidth != 0) {
+    m_bandwidth->consume(size);
+  }
+  try {
+    m_fileInputStream->seek(size);
+  } catch (IOException &ioEx) {
+    throw FileTransferException(&ioEx);
+  }
+  return true;
 }
 
 void FileTransferRequestHandler::lastRequestFailed(StringStorage *storage)
@@ -874,6 +1267,79 @@ void FileTransferRequestHandler::lastRequestFailed(const TCHAR *description)
   }
 }
 
+const std::vector<FileInfo> *FileTransferRequestHandler::getFileList(const TCHAR *folderPath)
+{
+  // Do not show the cached lists of one user to the other one.
+  if (m_desktop != NULL) {
+    StringStorage desktopName, userName;
+    m_desktop->getCurrentUserInfo(&desktopName, &userName);
+    m_folderListCache.setOwner(userName.getString());
+  }
+
+  return m_folderListCache.getFileList(folderPath);
+}
+
+void FileTransferRequestHandler::packFileList(const std::vector<FileInfo> *files,
+                                              size_t first, size_t count,
+                                              UINT8 compressionLevel,
+                                              ByteArrayOutputStream *compressedBlock)
+{
+  //
+  // Create buffer with "CompressedData" block inside
+  //
+
+  ByteArrayOutputStream memStream;
+  DataOutputStream outMemStream(&memStream);
+
+  _ASSERT((UINT32)count == count);
+  outMemStream.writeUInt32((UINT32)count);
+  for (size_t i = first; i < first + count; i++) {
+    const FileInfo *fileInfo = &(*files)[i];
+    outMemStream.writeUInt64(fileInfo->getSize());
+    outMemStream.writeUInt64(fileInfo->lastModified());
+    outMemStream.writeUInt16(fileInfo->getFlags());
+    outMemStream.writeUTF8(fileInfo->getFileName());
+  } // for
+
+  packCompressedBlock(&memStream, compressionLevel, compressedBlock);
+}
+
+void FileTransferRequestHandler::packCompressedBlock(ByteArrayOutputStream *data,
+                                                     UINT8 compressionLevel,
+                                                     ByteArrayOutputStream *compressedBlock)
+{
+  UINT32 compressedSize = 0;
+  UINT32 uncompressedSize = 0;
+
+  _ASSERT((UINT32)data->size() == data->size());
+  uncompressedSize = (UINT32)data->size();
+
+  //
+  // Buffer for data in "CompressedData" block
+  //
+
+  compressedSize = uncompressedSize;
+
+  if (compressionLevel != 0) {
+    m_deflater.setInput(data->toByteArray(), data->size());
+    m_deflater.deflate();
+    _ASSERT((UINT32)m_deflater.getOutputSize() == m_deflater.getOutputSize());
+    compressedSize = (UINT32)m_deflater.getOutputSize();
+  }
+
+  DataOutputStream outBlock(compressedBlock);
+
+  outBlock.writeUInt8(compressionLevel);
+  outBlock.writeUInt32(compressedSize);
+  outBlock.writeUInt32(uncompressedSize);
+
+  if (compressionLevel != 0) {
+    outBlock.writeFully(m_deflater.getOutput(), compressedSize);
+  } else {
+    outBlock.writeFully(data->toByteArray(), uncompressedSize);
+  }
+}
+
 bool FileTransferRequestHandler::getDirectorySize(const TCHAR *pathname, UINT64 *dirSize)
 {
   UINT64 currentDirSize = 0;
@@ -28,14 +28,21 @@
 #include "util/inttypes.h"
 #include "network/RfbInputGate.h"
 #include "network/RfbOutputGate.h"
+#include "network/TokenBucket.h"
 #include "ft-common/FileInfo.h"
 #include "file-lib/WinFileChannel.h"
+#include "file-lib/OverlappedFileChannel.h"
 #include "util/Inflater.h"
 #include "util/Deflater.h"
+#include "io-lib/ByteArrayOutputStream.h"
 #include "desktop/Desktop.h"
 #include "rfb-sconn/RfbCodeRegistrator.h"
 #include "rfb-sconn/RfbDispatcherListener.h"
 #include "FileTransferSecurity.h"
+#include "FolderListCache.h"
+#include "FileTransmitter.h"
+#include "ChecksumWorker.h"
+#include "TreeOperationWorker.h"
 #include "log-writer/LogWriter.h"
 
 /**
@@ -54,12 +61,18 @@ public:
    *   File transfers are disabled if current desktop is winlogon.
    * @pararm enabled indicates if file transfer should be enabled or disabled
    *   (for example, it's disabled in view-only mode).
+   * @param bandwidth limit of the file data in both directions, may be 0.
+   *   The replies to the data requests are delayed to keep to it.
+   * @param transmitter sender of the uncompressed download data straight
+   *   from the files, may be 0.
    */
   FileTransferRequestHandler(RfbCodeRegistrator *registrator,
                              RfbOutputGate *output,
                              Desktop *desktop,
                              LogWriter *log,
-                             bool enabled = true);
+                             bool enabled = true,
+                             TokenBucket *bandwidth = 0,
+                             FileTransmitter *transmitter = 0);
 
   /**
    * Deletes file transfer request handler.
@@ -86,11 +99,15 @@ protected:
 
   void compressionSupportRequested();
   void fileListRequested();
+  void fileListPagedRequested();
   void mkDirRequested();
   void rmFileRequested();
   void mvFileRequested();
   void dirSizeRequested();
   void md5Requested();
+  void checksumRequested();
+  void treeOperationRequested();
+  void treeOperationCancelRequested();
 
   //
   // Upload requests handlers.
@@ -106,6 +123,7 @@ protected:
 
   void downloadStartRequested();
   void downloadDataRequested();
+  void batchDownloadRequested();
 
   //
   // Method sends "Last request failed" message with error description.
@@ -120,6 +138,54 @@ protected:
 
   bool getDirectorySize(const TCHAR *pathname, UINT64 *dirSize);
 
+  /**
+   * Returns file list of the folder from the folder cache.
+   * @throws SystemException on fail.
+   */
+  const std::vector<FileInfo> *getFileList(const TCHAR *folderPath);
+
+  /**
+   * Packs "CompressedData" block of file list message with count files
+   * beginning from first.
+   */
+  void packFileList(const std::vector<FileInfo> *files,
+                    size_t first, size_t count,
+                    UINT8 compressionLevel,
+                    ByteArrayOutputStream *compressedBlock);
+
+  /**
+   * Packs "CompressedData" block with data compressed by requested level.
+   */
+  void packCompressedBlock(ByteArrayOutputStream *data,
+                           UINT8 compressionLevel,
+                           ByteArrayOutputStream *compressedBlock);
+
+  /**
+   * Sends one page of batch download reply.
+   */
+  void sendBatchDownloadPage(UINT8 pageFlags, UINT32 filesCount,
+                             ByteArrayOutputStream *records,
+                             UINT8 compressionLevel);
+
+  /**
+   * Opens file for checksum computation and queues it to checksum worker.
+   */
+  void queueChecksum(const TCHAR *pathName, UINT64 offset, UINT64 dataSize,
+                     UINT8 algorithm, bool legacyReply);
+
+  /**
+   * Lowers or raises compression level of downloads by the time the last
+   * chunk took to compress and to send.
+   */
+  void adaptCompressionLevel(UINT64 deflateTime, UINT64 sendTime);
+
+  /**
+   * Sends the download data reply with up to dataSize uncompressed bytes
+   * of the file by m_transmitter. Returns false if the data have to be
+   * read and written instead, at the end of the file too.
+   */
+  bool transmitDownloadData(UINT32 dataSize);
+
 protected:
   /**
    * Checks if we can run file transfer now (using FileTransferSecurity).
@@ -142,14 +208,14 @@ protected:
   //
 
   File *m_downloadFile;
-  WinFileChannel *m_fileInputStream;
+  OverlappedFileChannel *m_fileInputStream;
 
   //
   // Upload operation members
   //
 
   File *m_uploadFile;
-  WinFileChannel *m_fileOutputStream;
+  FileChannel *m_fileOutputStream;
 
   //
   // Zlib encoder / decoder
@@ -158,15 +224,69 @@ protected:
   Deflater m_deflater;
   Inflater m_inflater;
 
+  // Count of next download chunks sent without compression.
+  UINT32 m_rawChunksLeft;
+
+  // Chunk compressed to this size (in percents) or more gives no gain.
+  static const UINT32 MIN_COMPRESSION_GAIN_PERCENT = 95;
+  // Count of chunks sent without compression after one without gain.
+  static const UINT32 RAW_CHUNKS_AFTER_NO_GAIN = 16;
+
+  // Files of this size or bigger are downloaded bypassing the system
+  // file cache.
+  static const UINT64 UNBUFFERED_DOWNLOAD_MIN_SIZE = 64 * 1024 * 1024;
+
+  //
+  // File lists of the last browsed folders.
+  //
+
+  FolderListCache m_folderListCache;
+
+  // Page size of paged file lists, used if the client has no preference.
+  static const UINT32 DEFAULT_FILE_LIST_PAGE_SIZE = 256;
+  // Maximal page size of paged file lists.
+  static const UINT32 MAX_FILE_LIST_PAGE_SIZE = 4096;
+
+  //
+  // Checksums of file chunks are computed in this thread.
+  //
+
+  ChecksumWorker m_checksumWorker;
+
+  //
+  // Recursive operations on folder trees are run in this thread.
+  //
+
+  TreeOperationWorker m_treeOperationWorker;
+
+  //
+  // Batch downloads limits.
+  //
+
+  // Maximal count of files in one batch download request.
+  static const UINT32 MAX_BATCH_FILES = 1024;
+  // Files bigger than this one are not packed into batch.
+  static const UINT64 MAX_BATCH_FILE_SIZE = 1024 * 1024;
+  // Batch reply page is sent when its data reaches this size.
+  static const size_t BATCH_PAGE_SIZE = 512 * 1024;
+
   //
   // Security and impersonation.
   //
 
   FileTransferSecurity *m_security;
 
+  Desktop *m_desktop;
+
   // Determinates if file transfer is enabled.
   bool m_enabled;
 
+  // Limit of the file data, may be 0.
+  TokenBucket *m_bandwidth;
+
+  // Sender of the download data straight from the files, may be 0.
+  FileTransmitter *m_transmitter;
+
   LogWriter *m_log;
 };
 
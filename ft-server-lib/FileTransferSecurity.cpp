@@ -44,7 +44,7 @@ void FileTransferSecurity::beginMessageProcessing()
 {
   Configurator* conf = Configurator::getInstance();
   bool runAsService = conf->getServiceFlag();
-  bool rdpEnabled = conf->getServerConfig()->getConnectToRdpFlag();
+  bool rdpEnabled = Configurator::getConfigSnapshot()->getConnectToRdpFlag();
 
   if (!runAsService) {
     m_hasAccess = true;
@@ -89,7 +89,7 @@ void FileTransferSecurity::throwIfAccessDenied()
 {
   if (!m_hasAccess) {
     throw Exception(_T("Access denied."));
-  } else if (!Configurator::getInstance()->getServerConfig()->isFileTransfersEnabled()) {
+  } else if (!Configurator::getConfigSnapshot()->isFileTransfersEnabled()) {
     throw Exception(_T("File transfers are disabled on server side."));
   }
 }
@@ -0,0 +1,57 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __FILETRANSMITTER_H__
+#define __FILETRANSMITTER_H__
+
+#include "util/CommonHeader.h"
+
+/**
+ * Sends file data to the client straight from the file, past the output
+ * gate and the user-space buffers of the connection.
+ */
+class FileTransmitter
+{
+public:
+  /**
+   * Returns true if the connection can take data past the output gate,
+   * it cannot when the data are transformed or paced on the way (TLS,
+   * WebSocket, bandwidth limits).
+   */
+  virtual bool canTransmitFiles() = 0;
+
+  /**
+   * Sends head and then length bytes of the file from offset after all the
+   * data written to the connection before, and waits until they have been
+   * sent. Must be called with the output gate locked and flushed through
+   * (see RfbOutputGate::flushThrough()).
+   * @return false if the data cannot be sent so, nothing has been sent
+   * then.
+   * @throws IOException on error.
+   */
+  virtual bool transmitFile(HANDLE file, UINT64 offset, UINT32 length,
+                            const void *head, size_t headLength) = 0;
+};
+
+#endif // __FILETRANSMITTER_H__
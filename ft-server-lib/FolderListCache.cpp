@@ -0,0 +1,123 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "FolderListCache.h"
+#include "ft-common/FolderListener.h"
+#include "win-system/SystemException.h"
+
+FolderListCache::FolderListCache()
+{
+}
+
+FolderListCache::~FolderListCache()
+{
+  invalidate();
+}
+
+const std::vector<FileInfo> *FolderListCache::getFileList(const TCHAR *folderPath)
+{
+  std::list<Entry *>::iterator it;
+  for (it = m_entries.begin(); it != m_entries.end(); it++) {
+    if ((*it)->folderPath.isEqualTo(folderPath)) {
+      break;
+    }
+  }
+
+  if (it != m_entries.end()) {
+    Entry *entry = *it;
+    m_entries.erase(it);
+    if (entry->changeHandle != INVALID_HANDLE_VALUE &&
+        WaitForSingleObject(entry->changeHandle, 0) == WAIT_TIMEOUT) {
+      m_entries.push_front(entry);
+      return &entry->files;
+    }
+    deleteEntry(entry);
+  }
+
+  Entry *entry = new Entry;
+  entry->folderPath.setString(folderPath);
+  entry->changeHandle = INVALID_HANDLE_VALUE;
+
+  // Start watching before the listing, so changes made during the listing
+  // are not lost.
+  if (!entry->folderPath.isEmpty()) {
+    entry->changeHandle = FindFirstChangeNotification(folderPath, FALSE,
+                                                      FILE_NOTIFY_CHANGE_FILE_NAME |
+                                                      FILE_NOTIFY_CHANGE_DIR_NAME |
+                                                      FILE_NOTIFY_CHANGE_SIZE |
+                                                      FILE_NOTIFY_CHANGE_LAST_WRITE);
+  }
+
+  try {
+    readFileList(folderPath, &entry->files);
+  } catch (...) {
+    deleteEntry(entry);
+    throw;
+  }
+
+  m_entries.push_front(entry);
+  while (m_entries.size() > MAX_ENTRIES) {
+    deleteEntry(m_entries.back());
+    m_entries.pop_back();
+  }
+  return &entry->files;
+}
+
+void FolderListCache::invalidate()
+{
+  std::list<Entry *>::iterator it;
+  for (it = m_entries.begin(); it != m_entries.end(); it++) {
+    deleteEntry(*it);
+  }
+  m_entries.clear();
+}
+
+void FolderListCache::setOwner(const TCHAR *userName)
+{
+  if (!m_owner.isEqualTo(userName)) {
+    invalidate();
+    m_owner.setString(userName);
+  }
+}
+
+void FolderListCache::readFileList(const TCHAR *folderPath,
+                                   std::vector<FileInfo> *files)
+{
+  FolderListener folderListener(folderPath);
+
+  if (!folderListener.list()) {
+    throw SystemException();
+  }
+
+  const FileInfo *filesInfo = folderListener.getFilesInfo();
+  files->assign(filesInfo, filesInfo + folderListener.getFilesCount());
+}
+
+void FolderListCache::deleteEntry(Entry *entry)
+{
+  if (entry->changeHandle != INVALID_HANDLE_VALUE) {
+    FindCloseChangeNotification(entry->changeHandle);
+  }
+  delete entry;
+}
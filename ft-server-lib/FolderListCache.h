@@ -0,0 +1,93 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _FOLDER_LIST_CACHE_H_
+#define _FOLDER_LIST_CACHE_H_
+
+#include "util/CommonHeader.h"
+#include "ft-common/FileInfo.h"
+
+#include <list>
+#include <vector>
+
+/**
+ * Keeps file lists of the last browsed folders, so repeated listings of a
+ * big folder (refreshes, going back to the parent folder) do not scan it
+ * again.
+ *
+ * Every cached folder is watched by a change notification handle, the list
+ * is read from disk again as soon as the folder is changed. The root folder
+ * (disk list) is never cached.
+ *
+ * @note the class is not thread-safe.
+ */
+class FolderListCache
+{
+public:
+  FolderListCache();
+  virtual ~FolderListCache();
+
+  /**
+   * Returns file list of the folder, from the cache if the folder has not
+   * been changed since the last listing.
+   * @param folderPath path to the folder in windows format, empty string
+   * means the root (disk list).
+   * @return pointer to the file list, valid until next call of any method
+   * of this object.
+   * @throws SystemException if the folder cannot be listed.
+   */
+  const std::vector<FileInfo> *getFileList(const TCHAR *folderPath);
+
+  /**
+   * Drops all cached lists.
+   */
+  void invalidate();
+
+  /**
+   * Drops all cached lists if the folders are browsed for the other user
+   * than before.
+   */
+  void setOwner(const TCHAR *userName);
+
+protected:
+  struct Entry
+  {
+    StringStorage folderPath;
+    // Signaled when the folder is changed, or INVALID_HANDLE_VALUE.
+    HANDLE changeHandle;
+    std::vector<FileInfo> files;
+  };
+
+  static void readFileList(const TCHAR *folderPath,
+                           std::vector<FileInfo> *files);
+  static void deleteEntry(Entry *entry);
+
+  // Most recently used entries first.
+  std::list<Entry *> m_entries;
+  StringStorage m_owner;
+
+  static const size_t MAX_ENTRIES = 8;
+};
+
+#endif
@@ -0,0 +1,402 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TreeOperationWorker.h"
+
+#include "ft-common/FTMessage.h"
+#include "thread/AutoLock.h"
+#include "win-system/SystemException.h"
+
+TreeOperationWorker::TreeOperationWorker(RfbOutputGate *output, LogWriter *log)
+: m_output(output),
+  m_operation(0),
+  m_token(0),
+  m_busy(false),
+  m_cancelled(false),
+  m_filesCount(0),
+  m_foldersCount(0),
+  m_totalSize(0),
+  m_errorsCount(0),
+  m_log(log)
+{
+  resume();
+}
+
+TreeOperationWorker::~TreeOperationWorker()
+{
+  terminate();
+  wait();
+
+  if (m_token != 0) {
+    CloseHandle(m_token);
+  }
+}
+
+void TreeOperationWorker::start(UINT8 operation,
+                                const std::vector<StringStorage> *pathNames,
+                                HANDLE token)
+{
+  {
+    AutoLock al(&m_lock);
+    _ASSERT(!m_busy);
+    m_operation = operation;
+    m_pathNames = *pathNames;
+    m_token = token;
+    m_cancelled = false;
+    m_busy = true;
+  }
+  m_startEvent.notify();
+}
+
+void TreeOperationWorker::cancel()
+{
+  AutoLock al(&m_lock);
+  if (m_busy) {
+    m_cancelled = true;
+  }
+}
+
+void TreeOperationWorker::waitForIdle()
+{
+  while (isActive()) {
+    {
+      AutoLock al(&m_lock);
+      if (!m_busy) {
+        return;
+      }
+    }
+    m_idleEvent.waitForEvent();
+  }
+}
+
+void TreeOperationWorker::onTerminate()
+{
+  m_startEvent.notify();
+}
+
+bool TreeOperationWorker::isCancelled()
+{
+  if (isTerminating()) {
+    return true;
+  }
+  AutoLock al(&m_lock);
+  return m_cancelled;
+}
+
+void TreeOperationWorker::execute()
+{
+  while (!isTerminating()) {
+    bool busy;
+    {
+      AutoLock al(&m_lock);
+      busy = m_busy;
+    }
+    if (!busy) {
+      m_startEvent.waitForEvent();
+      continue;
+    }
+
+    //
+    // The files are accessed with the rights of the requesting thread.
+    //
+
+    if (m_token == 0 || SetThreadToken(NULL, m_token)) {
+      try {
+        runOperation();
+      } catch (Exception &e) {
+        m_log->error(_T("The tree operation thread cannot send reply: %s"),
+                     e.getMessage());
+      }
+      if (m_token != 0) {
+        RevertToSelf();
+      }
+    } else {
+      SystemException e;
+      try {
+        sendError(e.getMessage());
+      } catch (Exception &) {
+      }
+    }
+
+    {
+      AutoLock al(&m_lock);
+      if (m_token != 0) {
+        CloseHandle(m_token);
+        m_token = 0;
+      }
+      m_pathNames.clear();
+      m_busy = false;
+    }
+    m_idleEvent.notify();
+  }
+
+  // Release the waiter if any.
+  m_idleEvent.notify();
+}
+
+void TreeOperationWorker::runOperation()
+{
+  m_filesCount = 0;
+  m_foldersCount = 0;
+  m_totalSize = 0;
+  m_errorsCount = 0;
+  m_firstError.setString(_T(""));
+  m_lastProgressTime = DateTime::now();
+
+  for (size_t i = 0; i < m_pathNames.size() && !isCancelled(); i++) {
+    const TCHAR *pathName = m_pathNames[i].getString();
+
+    if (m_operation == FTMessage::TREE_MKDIR) {
+      createTree(pathName);
+      continue;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesEx(pathName, GetFileExInfoStandard, &data)) {
+      addError(pathName);
+      continue;
+    }
+    UINT64 fileSize = (UINT64)data.nFileSizeHigh << 32 | data.nFileSizeLow;
+
+    if (m_operation == FTMessage::TREE_DELETE) {
+      deleteTree(pathName, data.dwFileAttributes, fileSize);
+    } else {
+      sizeTree(pathName, data.dwFileAttributes, fileSize);
+    }
+  }
+
+  if (isCancelled()) {
+    m_log->message(_T("Tree operation %d is cancelled"), (int)m_operation);
+    sendError(_T("Operation is cancelled"));
+    return;
+  }
+
+  m_log->message(_T("Tree operation %d is done: %I64u files, %I64u folders, ")
+                 _T("%I64u bytes, %u errors"), (int)m_operation,
+                 m_filesCount, m_foldersCount, m_totalSize, m_errorsCount);
+  sendReply();
+}
+
+void TreeOperationWorker::deleteTree(const TCHAR *pathName, DWORD attributes,
+                                     UINT64 fileSize)
+{
+  if ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+    if (DeleteFile(pathName)) {
+      m_filesCount++;
+      m_totalSize += fileSize;
+    } else {
+      addError(pathName);
+    }
+    sendProgressIfTime();
+    return;
+  }
+
+  //
+  // Content of folder is deleted first. Links to folders (junctions and
+  // symbolic links) are deleted without their targets.
+  //
+
+  if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+    std::vector<WIN32_FIND_DATA> children;
+    if (!listFolder(pathName, &children)) {
+      addError(pathName);
+      return;
+    }
+    for (size_t i = 0; i < children.size(); i++) {
+      if (isCancelled()) {
+        return;
+      }
+      const WIN32_FIND_DATA *child = &children[i];
+      StringStorage childPath;
+      getChildPath(pathName, child->cFileName, &childPath);
+      deleteTree(childPath.getString(), child->dwFileAttributes,
+                 (UINT64)child->nFileSizeHigh << 32 | child->nFileSizeLow);
+    }
+  }
+
+  if (RemoveDirectory(pathName)) {
+    m_foldersCount++;
+  } else {
+    addError(pathName);
+  }
+  sendProgressIfTime();
+}
+
+void TreeOperationWorker::sizeTree(const TCHAR *pathName, DWORD attributes,
+                                   UINT64 fileSize)
+{
+  if ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+    m_filesCount++;
+    m_totalSize += fileSize;
+    sendProgressIfTime();
+    return;
+  }
+
+  m_foldersCount++;
+
+  // Links are not followed, so the files are not counted twice
+  if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0) {
+    return;
+  }
+
+  std::vector<WIN32_FIND_DATA> children;
+  if (!listFolder(pathName, &children)) {
+    addError(pathName);
+    return;
+  }
+  for (size_t i = 0; i < children.size() && !isCancelled(); i++) {
+    const WIN32_FIND_DATA *child = &children[i];
+    StringStorage childPath;
+    getChildPath(pathName, child->cFileName, &childPath);
+    sizeTree(childPath.getString(), child->dwFileAttributes,
+             (UINT64)child->nFileSizeHigh << 32 | child->nFileSizeLow);
+  }
+  sendProgressIfTime();
+}
+
+void TreeOperationWorker::createTree(const TCHAR *pathName)
+{
+  DWORD attributes = GetFileAttributes(pathName);
+  if (attributes != INVALID_FILE_ATTRIBUTES) {
+    if ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+      m_errorsCount++;
+      if (m_firstError.isEmpty()) {
+        m_firstError.format(_T("'%s' is not a folder"), pathName);
+      }
+    }
+    return;
+  }
+
+  // Missing parent folders are created first (drive root always exists)
+  StringStorage parentPath(pathName);
+  size_t separator = parentPath.findLast(_T('\\'));
+  if (separator != (size_t)-1 && parentPath.findChar(_T('\\')) != separator) {
+    parentPath.truncate(parentPath.getLength() - separator);
+    if (GetFileAttributes(parentPath.getString()) == INVALID_FILE_ATTRIBUTES) {
+      createTree(parentPath.getString());
+    }
+  }
+
+  if (CreateDirectory(pathName, NULL)) {
+    m_foldersCount++;
+  } else {
+    addError(pathName);
+  }
+  sendProgressIfTime();
+}
+
+bool TreeOperationWorker::listFolder(const TCHAR *pathName,
+                                     std::vector<WIN32_FIND_DATA> *children)
+{
+  StringStorage mask;
+  getChildPath(pathName, _T("*"), &mask);
+
+  // Avoid message box on unmounted devices like File::list() does.
+  UINT savedErrorMode = SetErrorMode(SEM_FAILCRITICALERRORS);
+  WIN32_FIND_DATA findData;
+  HANDLE hFind = FindFirstFile(mask.getString(), &findData);
+  SetErrorMode(savedErrorMode);
+
+  if (hFind == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  do {
+    if (_tcscmp(findData.cFileName, _T(".")) != 0 &&
+        _tcscmp(findData.cFileName, _T("..")) != 0) {
+      children->push_back(findData);
+    }
+  } while (FindNextFile(hFind, &findData));
+
+  FindClose(hFind);
+  return true;
+}
+
+void TreeOperationWorker::getChildPath(const TCHAR *pathName,
+                                       const TCHAR *childName,
+                                       StringStorage *childPath)
+{
+  childPath->setString(pathName);
+  if (!childPath->endsWith(_T('\\'))) {
+    childPath->appendString(_T("\\"));
+  }
+  childPath->appendString(childName);
+}
+
+void TreeOperationWorker::addError(const TCHAR *pathName)
+{
+  SystemException e;
+
+  m_errorsCount++;
+  if (m_firstError.isEmpty()) {
+    m_firstError.format(_T("%s ('%s')"), e.getMessage(), pathName);
+  }
+  m_log->debug(_T("Tree operation failed on '%s': %s"), pathName,
+               e.getMessage());
+}
+
+void TreeOperationWorker::sendProgressIfTime()
+{
+  DateTime now = DateTime::now();
+  if ((now - m_lastProgressTime).getTime() < PROGRESS_INTERVAL) {
+    return;
+  }
+  m_lastProgressTime = now;
+
+  AutoLock l(m_output);
+
+  m_output->writeUInt32(FTMessage::TREE_OPERATION_PROGRESS_REPLY);
+  m_output->writeUInt64(m_filesCount);
+  m_output->writeUInt64(m_foldersCount);
+  m_output->writeUInt64(m_totalSize);
+
+  m_output->flush();
+}
+
+void TreeOperationWorker::sendReply()
+{
+  AutoLock l(m_output);
+
+  m_output->writeUInt32(FTMessage::TREE_OPERATION_REPLY);
+  m_output->writeUInt8(m_operation);
+  m_output->writeUInt64(m_filesCount);
+  m_output->writeUInt64(m_foldersCount);
+  m_output->writeUInt64(m_totalSize);
+  m_output->writeUInt32(m_errorsCount);
+  m_output->writeUTF8(m_firstError.getString());
+
+  m_output->flush();
+}
+
+void TreeOperationWorker::sendError(const TCHAR *description)
+{
+  m_log->error(_T("last request failed: \"%s\""), description);
+
+  AutoLock l(m_output);
+
+  m_output->writeUInt32(FTMessage::LAST_REQUEST_FAILED_REPLY);
+  m_output->writeUTF8(description);
+
+  m_output->flush();
+}
@@ -0,0 +1,137 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _TREE_OPERATION_WORKER_H_
+#define _TREE_OPERATION_WORKER_H_
+
+#include "util/CommonHeader.h"
+#include "util/DateTime.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "network/RfbOutputGate.h"
+#include "log-writer/LogWriter.h"
+
+#include <vector>
+
+/**
+ * Runs recursive operations requested by TREE_OPERATION_REQUEST messages
+ * (delete, size computation and creation of folder trees) in its own
+ * thread, so the client does not walk the remote tree by a request per
+ * file, and the operation can be cancelled by
+ * TREE_OPERATION_CANCEL_REQUEST while it runs.
+ *
+ * Only one operation runs at a time. The caller must wait for the idle
+ * state before it writes any other file transfer reply.
+ */
+class TreeOperationWorker : public Thread
+{
+public:
+  TreeOperationWorker(RfbOutputGate *output, LogWriter *log);
+  virtual ~TreeOperationWorker();
+
+  /**
+   * Starts the operation, the worker must be idle.
+   * @param operation one of FTMessage::TREE_* values.
+   * @param pathNames paths to the files and folders to process.
+   * @param token impersonation token of the requesting thread, the worker
+   *   takes ownership of it. If it's 0, the worker runs as the process.
+   */
+  void start(UINT8 operation, const std::vector<StringStorage> *pathNames,
+             HANDLE token);
+
+  /**
+   * Stops the running operation, it's replied with LAST_REQUEST_FAILED_REPLY.
+   * Does nothing if the worker is idle.
+   */
+  void cancel();
+
+  /**
+   * Waits until the operation is replied.
+   */
+  void waitForIdle();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  void runOperation();
+
+  void deleteTree(const TCHAR *pathName, DWORD attributes, UINT64 fileSize);
+  void sizeTree(const TCHAR *pathName, DWORD attributes, UINT64 fileSize);
+  void createTree(const TCHAR *pathName);
+
+  /**
+   * Fills children with find data of the folder content. Returns false
+   * if the folder cannot be listed.
+   */
+  static bool listFolder(const TCHAR *pathName,
+                         std::vector<WIN32_FIND_DATA> *children);
+
+  // Joins the folder path and the name of its child.
+  static void getChildPath(const TCHAR *pathName, const TCHAR *childName,
+                           StringStorage *childPath);
+
+  // Counts fail of the file or folder, the first error is sent to client.
+  void addError(const TCHAR *pathName);
+
+  bool isCancelled();
+
+  void sendProgressIfTime();
+  void sendReply();
+  void sendError(const TCHAR *description);
+
+  RfbOutputGate *m_output;
+
+  // Requested operation, set by start().
+  UINT8 m_operation;
+  std::vector<StringStorage> m_pathNames;
+  HANDLE m_token;
+
+  // True from start() until the operation is replied.
+  bool m_busy;
+  bool m_cancelled;
+  LocalMutex m_lock;
+  WindowsEvent m_startEvent;
+  WindowsEvent m_idleEvent;
+
+  //
+  // Used by the worker thread only.
+  //
+
+  UINT64 m_filesCount;
+  UINT64 m_foldersCount;
+  UINT64 m_totalSize;
+  UINT32 m_errorsCount;
+  StringStorage m_firstError;
+  DateTime m_lastProgressTime;
+
+  // Progress is reported every this count of milliseconds.
+  static const UINT64 PROGRESS_INTERVAL = 1000;
+
+  LogWriter *m_log;
+};
+
+#endif
@@ -35,7 +35,8 @@
 #endif
 
 DibFrameBuffer::DibFrameBuffer()
-: m_renderManager(0)
+: m_renderManager(0),
+  m_qualityScaling(false)
 {
 }
 
@@ -64,11 +65,23 @@ bool DibFrameBuffer::clone(const FrameBuffer *srcFrameBuffer)
 void DibFrameBuffer::setColor(UINT8 reg, UINT8 green, UINT8 blue)
 {
   m_fb.setColor(reg, green, blue);
+  Rect fbRect = m_fb.getDimension().getRect();
+  invalidate(&fbRect);
 }
 
 void DibFrameBuffer::fillRect(const Rect *dstRect, UINT32 color)
 {
   m_fb.fillRect(dstRect, color);
+  invalidate(dstRect);
+}
+
+void DibFrameBuffer::fillRects(const Rect *dstRects, const UINT32 *colors,
+                               size_t count)
+{
+  m_fb.fillRects(dstRects, colors, count);
+  for (size_t i = 0; i < count; i++) {
+    invalidate(&dstRects[i]);
+  }
 }
 
 bool DibFrameBuffer::isEqualTo(const FrameBuffer *frameBuffer)
@@ -79,23 +92,98 @@ bool DibFrameBuffer::isEqualTo(const FrameBuffer *frameBuffer)
 bool DibFrameBuffer::copyFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffer,
                               int srcX, int srcY)
 {
-  return m_fb.copyFrom(dstRect, srcFrameBuffer, srcX, srcY);
+  bool result = m_fb.copyFrom(dstRect, srcFrameBuffer, srcX, srcY);
+  invalidate(dstRect);
+  return result;
 }
 
 bool DibFrameBuffer::copyFrom(const FrameBuffer *srcFrameBuffer, int srcX, int srcY)
 {
-  return m_fb.copyFrom(srcFrameBuffer, srcX, srcY);
+  bool result = m_fb.copyFrom(srcFrameBuffer, srcX, srcY);
+  Rect fbRect = m_fb.getDimension().getRect();
+  invalidate(&fbRect);
+  return result;
 }
 
 bool DibFrameBuffer::overlay(const Rect *dstRect, const FrameBuffer *srcFrameBuffer,
                              int srcX, int srcY, const char *andMask)
 {
-  return m_fb.overlay(dstRect, srcFrameBuffer, srcX, srcY, andMask);
+  bool result = m_fb.overlay(dstRect, srcFrameBuffer, srcX, srcY, andMask);
+  invalidate(dstRect);
+  return result;
 }
 
 void DibFrameBuffer::move(const Rect *dstRect, const int srcX, const int srcY)
 {
   m_fb.move(dstRect, srcX, srcY);
+  invalidate(dstRect);
+}
+
+bool DibFrameBuffer::uploadFrom(const Rect *rect, const FrameBuffer *srcFrameBuffer)
+{
+  PixelFormat srcPf = srcFrameBuffer->getPixelFormat();
+  if (m_renderManager == 0 || rect->isEmpty() ||
+      !m_fb.getPixelFormat().isEqualTo(&srcPf) ||
+      m_fb.getBytesPerPixel() != 4) {
+    return false;
+  }
+  Rect srcRect = srcFrameBuffer->getDimension().getRect();
+  if (!srcRect.intersection(rect).isEqualTo(rect)) {
+    return false;
+  }
+  // The pixels lost with the Direct2D device are in the source, which is
+  // the whole frame buffer of the viewer core.
+  Region lost;
+  m_renderManager->takeLostRegion(&lost);
+  if (!lost.isEmpty()) {
+    lost.crop(&srcRect);
+    std::vector<Rect> lostRects;
+    lost.getRectVector(&lostRects);
+    for (size_t i = 0; i < lostRects.size(); i++) {
+      copyFrom(&lostRects[i], srcFrameBuffer, lostRects[i].left, lostRects[i].top);
+    }
+  }
+  return m_renderManager->uploadFrom(rect,
+                                     srcFrameBuffer->getBufferPtr(rect->left, rect->top),
+                                     srcFrameBuffer->getBytesPerRow());
+}
+
+bool DibFrameBuffer::moveShown(const Rect *dstRect, int srcX, int srcY)
+{
+  if (m_renderManager == 0 || dstRect->isEmpty()) {
+    return false;
+  }
+  return m_renderManager->copyRect(dstRect, srcX, srcY);
+}
+
+bool DibFrameBuffer::setOverlay(size_t layer, const FrameBuffer *image, const Rect *rect)
+{
+  if (m_renderManager == 0) {
+    return false;
+  }
+  return m_renderManager->setOverlay(layer, image, rect);
+}
+
+bool DibFrameBuffer::moveOverlay(size_t layer, int x, int y)
+{
+  if (m_renderManager == 0) {
+    return false;
+  }
+  return m_renderManager->moveOverlay(layer, x, y);
+}
+
+void DibFrameBuffer::clearOverlay(size_t layer)
+{
+  if (m_renderManager != 0) {
+    m_renderManager->clearOverlay(layer);
+  }
+}
+
+void DibFrameBuffer::invalidate(const Rect *rect)
+{
+  if (m_renderManager != 0) {
+    m_renderManager->invalidate(rect);
+  }
 }
 
 bool DibFrameBuffer::cmpFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffer,
@@ -213,6 +301,20 @@ void DibFrameBuffer::stretchFromDibSection(const Rect *srcRect, const Rect *dstR
   m_renderManager->stretchFromDibSection(srcRect, dstRect);
 }
 
+bool DibFrameBuffer::drawToDC(HDC dc, const Rect *dstRect, const Rect *srcRect)
+{
+  checkRenderManagerValid();
+  return m_renderManager->drawToDC(dc, dstRect, srcRect);
+}
+
+void DibFrameBuffer::setQualityScaling(bool enabled)
+{
+  m_qualityScaling = enabled;
+  if (m_renderManager != 0) {
+    m_renderManager->setQualityScaling(enabled);
+  }
+}
+
 bool DibFrameBuffer::setRenderMode(RenderMode mode)
 {
   checkRenderManagerValid();
@@ -238,6 +340,21 @@ void DibFrameBuffer::setProperties(const Dimension *newDim,
                                    HWND compatibleWindow)
 {
   m_fb.setPropertiesWithoutResize(newDim, pixelFormat);
+  // The renderer of the same window is kept with its mode and its device
+  // resources, only the buffer is changed.
+  if (m_renderManager != 0) {
+    m_fb.setBuffer(0);
+    try {
+      if (m_renderManager->setBufferProperties(pixelFormat, newDim, compatibleWindow)) {
+        m_fb.setBuffer(m_renderManager->getBuffer());
+        return;
+      }
+    } catch (Exception &e) {
+      LOG_DIBFB("Exception changing RenderManager: %s", e.getMessage());
+      releaseRenderManager();
+      throw;
+    }
+  }
   void *buffer = updateRenderManager(newDim, pixelFormat, compatibleWindow);
   m_fb.setBuffer(buffer);
 }
@@ -266,6 +383,7 @@ void *DibFrameBuffer::updateRenderManager(const Dimension *newDim,
   try {
     // Create new RenderManager with default GDI rendering
     m_renderManager = new RenderManager(pixelFormat, newDim, compatibleWindow, initialMode);
+    m_renderManager->setQualityScaling(m_qualityScaling);
     void* buffer = m_renderManager->getBuffer();
     
     LOG_DIBFB("RenderManager created successfully, buffer: %p", buffer);
@@ -39,6 +39,8 @@ public:
 
   virtual void setColor(UINT8 reg, UINT8 green, UINT8 blue);
   virtual void fillRect(const Rect *dstRect, UINT32 color);
+  virtual void fillRects(const Rect *dstRects, const UINT32 *colors,
+                         size_t count);
 
   virtual bool isEqualTo(const FrameBuffer *frameBuffer);
 
@@ -105,6 +107,15 @@ public:
   // This function throwing an exception on a failure.
   void stretchFromDibSection(const Rect *srcRect, const Rect *dstRect);
 
+  // Draws srcRect of this frame buffer to dstRect of the dc of a window
+  // being painted, see RenderManager::drawToDC(). Returns false if the
+  // renderer draws to the window on its own.
+  bool drawToDC(HDC dc, const Rect *dstRect, const Rect *srcRect);
+
+  // Sets the filtering of the stretched images, see
+  // RenderManager::setQualityScaling(). Kept across the renderer changes.
+  void setQualityScaling(bool enabled);
+
   // NEW FUNCTION: Set the rendering mode to use either GDI or Direct2D
   // Returns true if the mode was successfully set, false otherwise
   bool setRenderMode(RenderMode mode);
@@ -115,6 +126,24 @@ public:
   // NEW FUNCTION: handle resize
   void resize(const Rect *newSize);
 
+  // Shows the rectangle of srcFrameBuffer (at the same coordinates) without
+  // copying it to this frame buffer, if the renderer can take the pixels
+  // directly. Otherwise returns false and nothing is done.
+  bool uploadFrom(const Rect *rect, const FrameBuffer *srcFrameBuffer);
+
+  // Moves the shown rectangle from (srcX, srcY) to dstRect the way move()
+  // does, but in the renderer only, leaving this frame buffer stale there
+  // like uploadFrom(). Returns false if the renderer cannot do it, then
+  // nothing is done.
+  bool moveShown(const Rect *dstRect, int srcX, int srcY);
+
+  // Shows the image over this frame buffer at the rectangle without
+  // changing the pixels, if the renderer can blend it on its own (see
+  // RenderManager::setOverlay()). Otherwise returns false.
+  bool setOverlay(size_t layer, const FrameBuffer *image, const Rect *rect);
+  bool moveOverlay(size_t layer, int x, int y);
+  void clearOverlay(size_t layer);
+
 private:
   // This section to reduce access to some function that have been inherited from the
   // FrameBuffer class and can't to be use in here. Also, if user code will to try
@@ -141,8 +170,12 @@ private:
   // This function generates an Exception if DIB section is not initialized yet.
   void checkRenderManagerValid() const;
 
+  // Tells the render manager which part of the buffer has been changed.
+  void invalidate(const Rect *rect);
+
   FrameBuffer m_fb;
   RenderManager *m_renderManager;
+  bool m_qualityScaling;
 };
 
 #endif // __DIBFRAMEBUFFER_H__
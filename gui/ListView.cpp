@@ -301,10 +301,15 @@ void ListView::sort()
     if (!m_sortAscending) {
       sortColumnIndex = -sortColumnIndex;
     }
-    ListView_SortItems(m_hwnd, m_compareItem, sortColumnIndex);
+    sortItems(m_compareItem, sortColumnIndex);
   }
 }
 
+void ListView::sortItems(PFNLVCOMPARE compareItem, LPARAM lParamSort)
+{
+  ListView_SortItems(m_hwnd, compareItem, lParamSort);
+}
+
 void ListView::setExStyle(DWORD style)
 {
   ::SendMessage(m_hwnd, LVM_SETEXTENDEDLISTVIEWSTYLE, 0, (LPARAM)style); 
@@ -186,6 +186,13 @@ protected:
   //
   void sort();
 
+  //
+  // Reorders list view items in order defined by compareItem function.
+  // By default, the items are sorted by list view control, subclasses
+  // that keep items by themselves (virtual list views) must override it.
+  //
+  virtual void sortItems(PFNLVCOMPARE compareItem, LPARAM lParamSort);
+
 private:
   // Kind of sorting: ascending or descending
   bool m_sortAscending;
@@ -0,0 +1,139 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "HttpAsset.h"
+#include "util/XXHash64.h"
+#include "zlib/zlib.h"
+
+HttpAsset::HttpAsset()
+: m_staticBody(0),
+  m_bodySize(0)
+{
+}
+
+HttpAsset::~HttpAsset()
+{
+}
+
+void HttpAsset::setContent(const char *contentType, const void *body,
+                           size_t size, bool isStatic)
+{
+  m_contentType.setString(contentType);
+  m_bodySize = size;
+  if (isStatic) {
+    m_staticBody = (const char *)body;
+    m_ownBody.clear();
+  } else {
+    m_staticBody = 0;
+    m_ownBody.assign((const char *)body, (const char *)body + size);
+  }
+
+  XXHash64 hash;
+  hash.update(body, size);
+  const UINT8 *digest = hash.finalize().getHash();
+  AnsiStringStorage eTag("\"");
+  for (size_t i = 0; i < XXHash64::HASH_SIZE; i++) {
+    AnsiStringStorage hex;
+    hex.format("%02x", (unsigned int)digest[i]);
+    eTag.appendString(hex.getString());
+  }
+  eTag.appendString("\"");
+  m_eTag.setString(eTag.getString());
+
+  compressBody();
+}
+
+bool HttpAsset::isEmpty() const
+{
+  return m_contentType.isEmpty();
+}
+
+bool HttpAsset::hasContent(const void *body, size_t size) const
+{
+  return !isEmpty() && size == m_bodySize &&
+         (size == 0 || memcmp(getBody(), body, size) == 0);
+}
+
+const char *HttpAsset::getContentType() const
+{
+  return m_contentType.getString();
+}
+
+const char *HttpAsset::getETag() const
+{
+  return m_eTag.getString();
+}
+
+const char *HttpAsset::getBody() const
+{
+  if (m_staticBody != 0) {
+    return m_staticBody;
+  }
+  return m_ownBody.empty() ? 0 : &m_ownBody[0];
+}
+
+size_t HttpAsset::getBodySize() const
+{
+  return m_bodySize;
+}
+
+const char *HttpAsset::getGzipBody() const
+{
+  return m_gzipBody.empty() ? 0 : &m_gzipBody[0];
+}
+
+size_t HttpAsset::getGzipBodySize() const
+{
+  return m_gzipBody.size();
+}
+
+void HttpAsset::compressBody()
+{
+  m_gzipBody.clear();
+  if (m_bodySize == 0) {
+    return;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 16 added to the window bits asks zlib for the gzip wrapper.
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16,
+                   MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return;
+  }
+  std::vector<char> output(deflateBound(&stream, (uLong)m_bodySize));
+  stream.next_in = (Bytef *)getBody();
+  stream.avail_in = (uInt)m_bodySize;
+  stream.next_out = (Bytef *)&output[0];
+  stream.avail_out = (uInt)output.size();
+  int result = deflate(&stream, Z_FINISH);
+  size_t outputSize = output.size() - stream.avail_out;
+  deflateEnd(&stream);
+
+  if (result == Z_STREAM_END &&
+      outputSize * 100 <= m_bodySize * (100 - MIN_GZIP_SAVING_PERCENT)) {
+    output.resize(outputSize);
+    m_gzipBody.swap(output);
+  }
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __HTTPASSET_H__
+#define __HTTPASSET_H__
+
+#include "util/CommonHeader.h"
+#include "util/AnsiStringStorage.h"
+#include "util/inttypes.h"
+
+#include <vector>
+
+/**
+ * HTTP response body prepared once and sent to many requests: the body,
+ * its gzip variant and its entity tag.
+ *
+ * The gzip variant is kept only if it's notably smaller than the body, so
+ * already compressed content (such as a jar) is always sent as is.
+ */
+class HttpAsset
+{
+public:
+  HttpAsset();
+  virtual ~HttpAsset();
+
+  /**
+   * Sets the content and prepares its variants.
+   * @param contentType value of the Content-Type field.
+   * @param body content.
+   * @param size size of the content.
+   * @param isStatic if true, the content is not copied and must exist as
+   * long as the asset and its copies.
+   */
+  void setContent(const char *contentType, const void *body, size_t size,
+                  bool isStatic);
+
+  bool isEmpty() const;
+
+  // Returns true if the content is the same as the specified one.
+  bool hasContent(const void *body, size_t size) const;
+
+  const char *getContentType() const;
+  // Returns the entity tag, quoted.
+  const char *getETag() const;
+
+  const char *getBody() const;
+  size_t getBodySize() const;
+
+  // Returns 0 if there is no gzip variant.
+  const char *getGzipBody() const;
+  size_t getGzipBodySize() const;
+
+protected:
+  // Fills m_gzipBody if it's worth it.
+  void compressBody();
+
+  // The gzip variant must save this part of the size at least.
+  static const size_t MIN_GZIP_SAVING_PERCENT = 10;
+
+  AnsiStringStorage m_contentType;
+  AnsiStringStorage m_eTag;
+
+  const char *m_staticBody;
+  std::vector<char> m_ownBody;
+  size_t m_bodySize;
+
+  std::vector<char> m_gzipBody;
+};
+
+#endif // __HTTPASSET_H__
@@ -0,0 +1,50 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "HttpAssetCache.h"
+#include "VncViewerJarBody.h"
+#include "thread/AutoLock.h"
+
+LocalMutex HttpAssetCache::s_lock;
+HttpAsset HttpAssetCache::s_viewerJar;
+HttpAsset HttpAssetCache::s_indexPage;
+
+const HttpAsset *HttpAssetCache::getViewerJar()
+{
+  AutoLock al(&s_lock);
+  if (s_viewerJar.isEmpty()) {
+    s_viewerJar.setContent("application/java-archive", VNC_VIEWER_JAR_BODY,
+                           sizeof(VNC_VIEWER_JAR_BODY), true);
+  }
+  return &s_viewerJar;
+}
+
+void HttpAssetCache::getIndexPage(const char *page, size_t size, HttpAsset *asset)
+{
+  AutoLock al(&s_lock);
+  if (!s_indexPage.hasContent(page, size)) {
+    s_indexPage.setContent("text/html", page, size, false);
+  }
+  *asset = s_indexPage;
+}
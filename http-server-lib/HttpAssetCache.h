@@ -0,0 +1,58 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __HTTPASSETCACHE_H__
+#define __HTTPASSETCACHE_H__
+
+#include "thread/LocalMutex.h"
+
+#include "HttpAsset.h"
+
+/**
+ * Responses of the HTTP server prepared once for all the requests, so
+ * that frequent reloads of the viewer page cost neither compression nor
+ * hashing.
+ */
+class HttpAssetCache
+{
+public:
+  /**
+   * Returns the viewer jar, prepares it the first time.
+   */
+  static const HttpAsset *getViewerJar();
+
+  /**
+   * Copies the asset of the index page to the asset parameter. The last
+   * page is kept, the asset is prepared again only if the page differs
+   * from it.
+   */
+  static void getIndexPage(const char *page, size_t size, HttpAsset *asset);
+
+private:
+  static LocalMutex s_lock;
+  static HttpAsset s_viewerJar;
+  static HttpAsset s_indexPage;
+};
+
+#endif // __HTTPASSETCACHE_H__
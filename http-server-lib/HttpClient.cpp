@@ -27,15 +27,14 @@
 #include "HttpRequestHandler.h"
 
 #include "network/socket/SocketStream.h"
+#include "thread/AutoLock.h"
 
-HttpClient::HttpClient(SocketIPv4 *socket, LogWriter *log)
+HttpClient::HttpClient(SocketIPv4 *socket, WebSocketListener *webSocketListener,
+                       LogWriter *log)
 : TcpClientThread(socket),
+  m_webSocketListener(webSocketListener),
   m_log(log)
 {
-  m_stream = new SocketStream(socket);
-
-  m_dIS = new DataInputStream(m_stream);
-  m_dOS = new DataOutputStream(m_stream);
 }
 
 HttpClient::~HttpClient()
@@ -43,14 +42,16 @@ HttpClient::~HttpClient()
   if (Thread::isActive()) {
     Thread::wait();
   }
-
-  delete m_stream;
-  delete m_dOS;
-  delete m_dIS;
 }
 
-void HttpClient::execute()
+HttpClient::ConnectionState
+HttpClient::processRequest(SocketIPv4 *socket,
+                           WebSocketListener *webSocketListener,
+                           LogWriter *log)
 {
+  bool isUpgraded = false;
+  bool isKeptAlive = false;
+
   try {
 
     //
@@ -59,7 +60,7 @@ void HttpClient::execute()
 
     SocketAddressIPv4 peerAddress;
 
-    m_socket->getPeerAddr(&peerAddress);
+    socket->getPeerAddr(&peerAddress);
 
     StringStorage peerHost;
 
@@ -69,16 +70,57 @@ void HttpClient::execute()
     // Call request handler.
     //
 
-    HttpRequestHandler httpRequestHandler(m_dIS, m_dOS, m_log, peerHost.getString());
+    // The request is read unbuffered, so that nothing sent after an upgrade
+    // request is taken from the socket.
+    SocketStream stream(socket);
+    DataInputStream input(&stream);
+    DataOutputStream output(&stream);
+
+    HttpRequestHandler httpRequestHandler(&input, &output, log, peerHost.getString(),
+                                          webSocketListener != 0);
 
     httpRequestHandler.processRequest();
+
+    isUpgraded = httpRequestHandler.isWebSocketUpgraded();
+    isKeptAlive = httpRequestHandler.isKeepAlive();
   } catch (IOException &) { } // try / catch.
 
+  if (isUpgraded) {
+    webSocketListener->onWebSocketConnection(socket);
+    return CONNECTION_UPGRADED;
+  }
+  if (isKeptAlive) {
+    return CONNECTION_KEPT;
+  }
+
   try {
-    m_socket->shutdown(SD_BOTH);
+    socket->shutdown(SD_BOTH);
   } catch (...) { } // try / catch.
 
   try {
-    m_socket->close();
+    socket->close();
   } catch (...) { } // try / catch.
+
+  return CONNECTION_CLOSED;
+}
+
+void HttpClient::execute()
+{
+  ConnectionState state;
+  do {
+    state = processRequest(m_socket, m_webSocketListener, m_log);
+  } while (state == CONNECTION_KEPT && !isTerminating());
+
+  if (state == CONNECTION_UPGRADED) {
+    AutoLock al(&m_socketLock);
+    m_socket = 0;
+  }
+}
+
+void HttpClient::onTerminate()
+{
+  AutoLock al(&m_socketLock);
+  if (m_socket != 0) {
+    TcpClientThread::onTerminate();
+  }
 }
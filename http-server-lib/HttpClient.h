@@ -29,25 +29,50 @@
 
 #include "network/socket/SocketIPv4.h"
 
-#include "io-lib/Channel.h"
-#include "io-lib/DataInputStream.h"
-#include "io-lib/DataOutputStream.h"
+#include "thread/LocalMutex.h"
 #include "log-writer/LogWriter.h"
 
+#include "WebSocketListener.h"
+
 class HttpClient : public TcpClientThread
 {
 public:
-  HttpClient(SocketIPv4 *socket, LogWriter *log);
+  HttpClient(SocketIPv4 *socket, WebSocketListener *webSocketListener,
+             LogWriter *log);
   virtual ~HttpClient();
 
+  // What is left of the connection after a request.
+  enum ConnectionState {
+    // The socket has been closed.
+    CONNECTION_CLOSED,
+    // The socket is open for the next request.
+    CONNECTION_KEPT,
+    // The socket has been given to the WebSocket listener.
+    CONNECTION_UPGRADED
+  };
+
+  /**
+   * Serves one HTTP request received from the socket.
+   * @param webSocketListener listener to take the connections upgraded to
+   * WebSocket, 0 if the upgrade is not allowed.
+   */
+  static ConnectionState processRequest(SocketIPv4 *socket,
+                                        WebSocketListener *webSocketListener,
+                                        LogWriter *log);
+
+  // Time a connection may keep a thread waiting for request data, set as
+  // the receive timeout of the socket. With a network engine, connections
+  // waiting between the requests use no thread, so they are not timed out.
+  static const int KEEP_ALIVE_TIMEOUT = 15000;
+
 protected:
   virtual void execute();
+  virtual void onTerminate();
 
 protected:
-  Channel *m_stream;
-  // Wrappers around socket stream.
-  DataInputStream *m_dIS;
-  DataOutputStream *m_dOS;
+  WebSocketListener *m_webSocketListener;
+  // Protects m_socket, which is reset when the socket is given away.
+  LocalMutex m_socketLock;
 
   LogWriter *m_log;
 };
@@ -23,6 +23,7 @@
 //
 
 #include "HttpReply.h"
+#include "util/AnsiStringStorage.h"
 
 HttpReply::HttpReply(DataOutputStream *dataOutput)
 : m_dataOutput(dataOutput)
@@ -53,3 +54,69 @@ void HttpReply::send404()
 
   m_dataOutput->writeFully(HTTP_404, strlen(HTTP_404));
 }
+
+void HttpReply::send400()
+{
+  // The version is for WebSocket clients, others ignore it.
+  const char HTTP_400[] = "HTTP/1.1 400 Bad Request\r\n"
+                          "Sec-WebSocket-Version: 13\r\n"
+                          "Connection: close\r\n\r\n";
+
+  m_dataOutput->writeFully(HTTP_400, strlen(HTTP_400));
+}
+
+void HttpReply::sendAsset(const HttpAsset *asset, bool useGzip,
+                          bool notModified, bool keepAlive)
+{
+  const char *body = asset->getBody();
+  size_t bodySize = asset->getBodySize();
+  if (useGzip && asset->getGzipBody() != 0) {
+    body = asset->getGzipBody();
+    bodySize = asset->getGzipBodySize();
+  } else {
+    useGzip = false;
+  }
+
+  AnsiStringStorage header;
+  if (notModified) {
+    header.setString("HTTP/1.1 304 Not Modified\r\n");
+    bodySize = 0;
+  } else {
+    header.format("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: %s\r\n"
+                  "Content-Length: %u\r\n",
+                  asset->getContentType(), (unsigned int)bodySize);
+    if (useGzip) {
+      header.appendString("Content-Encoding: gzip\r\n");
+    }
+  }
+  AnsiStringStorage fields;
+  // The client asks whether its copy is valid every time, which costs a
+  // short 304 reply.
+  fields.format("ETag: %s\r\n"
+                "Cache-Control: no-cache\r\n"
+                "Vary: Accept-Encoding\r\n"
+                "Connection: %s\r\n\r\n",
+                asset->getETag(), keepAlive ? "keep-alive" : "close");
+  header.appendString(fields.getString());
+
+  m_dataOutput->writeFullyGather(header.getString(), header.getLength(),
+                                 body, bodySize);
+}
+
+void HttpReply::send101WebSocket(const char *acceptKey, const char *protocol)
+{
+  AnsiStringStorage reply;
+  reply.format("HTTP/1.1 101 Switching Protocols\r\n"
+               "Upgrade: websocket\r\n"
+               "Connection: Upgrade\r\n"
+               "Sec-WebSocket-Accept: %s\r\n", acceptKey);
+  if (protocol != 0) {
+    AnsiStringStorage field;
+    field.format("Sec-WebSocket-Protocol: %s\r\n", protocol);
+    reply.appendString(field.getString());
+  }
+  reply.appendString("\r\n");
+
+  m_dataOutput->writeFully(reply.getString(), reply.getLength());
+}
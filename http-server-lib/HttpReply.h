@@ -28,6 +28,8 @@
 #include "io-lib/DataOutputStream.h"
 #include "io-lib/IOException.h"
 
+#include "HttpAsset.h"
+
 class HttpReply
 {
 public:
@@ -36,6 +38,16 @@ public:
 
   void send200() throw(IOException);
   void send404() throw(IOException);
+  void send400() throw(IOException);
+  // Accepts WebSocket upgrade with the accept key, and the subprotocol if
+  // it's not 0.
+  void send101WebSocket(const char *acceptKey, const char *protocol)
+    throw(IOException);
+  // Sends the asset with one write, or 304 Not Modified if the client has
+  // it already. With keepAlive, the connection stays open for the next
+  // request.
+  void sendAsset(const HttpAsset *asset, bool useGzip, bool notModified,
+                 bool keepAlive) throw(IOException);
 
 protected:
   DataOutputStream *m_dataOutput;
@@ -59,30 +59,92 @@ ArgList *HttpRequest::getArguments() const
   return m_argList;
 }
 
+const char *HttpRequest::getField(const char *name) const
+{
+  for (size_t i = 0; i < m_fieldNames.size(); i++) {
+    if (_stricmp(m_fieldNames[i].getString(), name) == 0) {
+      return m_fieldValues[i].getString();
+    }
+  }
+  return 0;
+}
+
+bool HttpRequest::isWebSocketUpgrade() const
+{
+  const char *upgrade = getField("Upgrade");
+  return upgrade != 0 && _stricmp(upgrade, "websocket") == 0 &&
+         getField("Sec-WebSocket-Key") != 0;
+}
+
+bool HttpRequest::isKeepAlive() const
+{
+  const char *connection = getField("Connection");
+  if (connection != 0 && containsNoCase(connection, "close")) {
+    return false;
+  }
+  if (connection != 0 && containsNoCase(connection, "keep-alive")) {
+    return true;
+  }
+  return strstr(m_request, "HTTP/1.1") != 0;
+}
+
+bool HttpRequest::acceptsGzip() const
+{
+  const char *encodings = getField("Accept-Encoding");
+  return encodings != 0 && containsNoCase(encodings, "gzip");
+}
+
+bool HttpRequest::hasEntity(const char *eTag) const
+{
+  const char *tags = getField("If-None-Match");
+  return tags != 0 && (strcmp(tags, "*") == 0 || strstr(tags, eTag) != 0);
+}
+
+bool HttpRequest::containsNoCase(const char *string, const char *substring)
+{
+  size_t length = strlen(substring);
+  for (; *string != '\0'; string++) {
+    if (_strnicmp(string, substring, length) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void HttpRequest::readHeader()
 {
   readLine('\n', m_request, sizeof(m_request) - 1);
 
-  skipHeader(true);
+  readFields();
 }
 
-void HttpRequest::skipHeader(bool lastWasEndLn)
+void HttpRequest::readFields()
 {
-  char c;
+  char line[REQUEST_BUFFER_SIZE];
 
   for (;;) {
-    m_dataInput->readFully(&c, 1);
-
-    if (c == '\n') {
-      if (lastWasEndLn) {
-        break;
-      }
-      lastWasEndLn = true;
-    } else {
-      if (c >= ' ') {
-        lastWasEndLn = false;
-      }
+    readLine('\n', line, sizeof(line) - 1);
+
+    // Cut the line end and trailing spaces.
+    size_t length = strlen(line);
+    while (length > 0 && (unsigned char)line[length - 1] <= ' ') {
+      line[--length] = '\0';
+    }
+    if (length == 0) {
+      break;
+    }
+
+    char *colon = strchr(line, ':');
+    if (colon == 0 || m_fieldNames.size() >= MAX_FIELDS) {
+      continue;
+    }
+    *colon = '\0';
+    char *value = colon + 1;
+    while (*value == ' ' || *value == '\t') {
+      value++;
     }
+    m_fieldNames.push_back(AnsiStringStorage(line));
+    m_fieldValues.push_back(AnsiStringStorage(value));
   }
 }
 
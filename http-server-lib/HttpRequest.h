@@ -26,9 +26,12 @@
 #define _HTTP_REQUEST_H_
 
 #include "io-lib/DataInputStream.h"
+#include "util/AnsiStringStorage.h"
 
 #include "ArgList.h"
 
+#include <vector>
+
 class HttpRequest
 {
 public:
@@ -52,9 +55,29 @@ public:
   // Returns request arguments container.
   ArgList *getArguments() const;
 
+  // Returns value of the header field with the name (case-insensitive), or
+  // 0 if the request has no such field.
+  // Remark: method must be called after readHeader().
+  const char *getField(const char *name) const;
+
+  // Returns true if the request asks to upgrade the connection to WebSocket.
+  bool isWebSocketUpgrade() const;
+
+  // Returns true if the client wants the connection to stay open after
+  // the reply (HTTP/1.1 default, or HTTP/1.0 with keep-alive).
+  bool isKeepAlive() const;
+  // Returns true if the client accepts gzip content encoding.
+  bool acceptsGzip() const;
+  // Returns true if the client has the entity with the tag already
+  // (If-None-Match field).
+  bool hasEntity(const char *eTag) const;
+
 protected:
-  // Skips HTTP headers until end.
-  void skipHeader(bool lastWasEndLn) throw(IOException);
+  // Returns true if the string contains the substring, ignoring case.
+  static bool containsNoCase(const char *string, const char *substring);
+
+  // Reads HTTP header fields until end, keeps first MAX_FIELDS of them.
+  void readFields() throw(IOException);
   // Reads line that ends with specified character from data input stream
   // and storage it output buffer parameter.
   // If line is more than specified max size that string will be trunkated to
@@ -63,6 +86,7 @@ protected:
 
 protected:
   static const size_t REQUEST_BUFFER_SIZE = 2048;
+  static const size_t MAX_FIELDS = 64;
 
 protected:
   // Stream for reading data.
@@ -75,6 +99,9 @@ protected:
   char m_args[REQUEST_BUFFER_SIZE];
   // Arguments list.
   ArgList *m_argList;
+  // Names and values of header fields.
+  std::vector<AnsiStringStorage> m_fieldNames;
+  std::vector<AnsiStringStorage> m_fieldValues;
 };
 
 #endif
@@ -23,21 +23,24 @@
 //
 
 #include "HttpRequestHandler.h"
-#include "HttpRequest.h"
-#include "HttpReply.h"
 #include "AppletParameter.h"
-#include "VncViewerJarBody.h"
+#include "HttpAssetCache.h"
 #include "win-system/Environment.h"
 #include "server-config-lib/Configurator.h"
 #include "util/AnsiStringStorage.h"
+#include "util/Sha1.h"
 #include "tvnserver-app/NamingDefs.h"
 
 HttpRequestHandler::HttpRequestHandler(DataInputStream *dataInput,
                                        DataOutputStream *dataOutput,
                                        LogWriter *log,
-                                       const TCHAR *peerHost)
+                                       const TCHAR *peerHost,
+                                       bool webSocketAllowed)
 : m_dataInput(dataInput), m_dataOutput(dataOutput),
   m_peerHost(peerHost),
+  m_webSocketAllowed(webSocketAllowed),
+  m_webSocketUpgraded(false),
+  m_keepAlive(false),
   m_log(log)
 {
 }
@@ -46,6 +49,85 @@ HttpRequestHandler::~HttpRequestHandler()
 {
 }
 
+bool HttpRequestHandler::isWebSocketUpgraded() const
+{
+  return m_webSocketUpgraded;
+}
+
+bool HttpRequestHandler::isKeepAlive() const
+{
+  return m_keepAlive;
+}
+
+void HttpRequestHandler::sendAsset(HttpRequest *request, HttpReply *reply,
+                                   const HttpAsset *asset)
+{
+  m_keepAlive = request->isKeepAlive();
+  reply->sendAsset(asset, request->acceptsGzip(),
+                   request->hasEntity(asset->getETag()), m_keepAlive);
+}
+
+void HttpRequestHandler::processWebSocketUpgrade(HttpRequest *request,
+                                                 HttpReply *reply)
+{
+  if (!m_webSocketAllowed) {
+    reply->send404();
+    return;
+  }
+  const char *version = request->getField("Sec-WebSocket-Version");
+  if (version == 0 || strcmp(version, "13") != 0) {
+    m_log->warning(_T("unsupported WebSocket version from %s"), m_peerHost.getString());
+    reply->send400();
+    return;
+  }
+
+  AnsiStringStorage acceptKey;
+  getWebSocketAcceptKey(request->getField("Sec-WebSocket-Key"), &acceptKey);
+
+  // The frames are binary always, the subprotocol is named only if the
+  // client asks for it.
+  const char *protocols = request->getField("Sec-WebSocket-Protocol");
+  const char *protocol = 0;
+  if (protocols != 0 && strstr(protocols, "binary") != 0) {
+    protocol = "binary";
+  }
+
+  reply->send101WebSocket(acceptKey.getString(), protocol);
+  m_webSocketUpgraded = true;
+}
+
+void HttpRequestHandler::getWebSocketAcceptKey(const char *key,
+                                               AnsiStringStorage *acceptKey)
+{
+  static const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  static const char BASE64_CHARS[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  Sha1 sha1;
+  sha1.update(key, strlen(key));
+  sha1.update(WEBSOCKET_GUID, strlen(WEBSOCKET_GUID));
+  const UINT8 *hash = sha1.finalize().getHash();
+
+  // Base64 of the 20 byte hash: 27 characters and one pad.
+  char encoded[29];
+  size_t pos = 0;
+  for (size_t i = 0; i < Sha1::HASH_SIZE; i += 3) {
+    UINT32 triple = (UINT32)hash[i] << 16;
+    if (i + 1 < Sha1::HASH_SIZE) {
+      triple |= (UINT32)hash[i + 1] << 8;
+    }
+    if (i + 2 < Sha1::HASH_SIZE) {
+      triple |= hash[i + 2];
+    }
+    encoded[pos++] = BASE64_CHARS[(triple >> 18) & 0x3F];
+    encoded[pos++] = BASE64_CHARS[(triple >> 12) & 0x3F];
+    encoded[pos++] = i + 1 < Sha1::HASH_SIZE ? BASE64_CHARS[(triple >> 6) & 0x3F] : '=';
+    encoded[pos++] = i + 2 < Sha1::HASH_SIZE ? BASE64_CHARS[triple & 0x3F] : '=';
+  }
+  encoded[pos] = '\0';
+  acceptKey->setString(encoded);
+}
+
 // FIXME: Refactor this code.
 void HttpRequestHandler::processRequest()
 {
@@ -69,6 +151,11 @@ void HttpRequestHandler::processRequest()
 
   HttpReply reply(m_dataOutput);
 
+  if (httpRequest.isWebSocketUpgrade()) {
+    processWebSocketUpgrade(&httpRequest, &reply);
+    return;
+  }
+
   bool pageFound = false;
 
   //
@@ -108,9 +195,8 @@ void HttpRequestHandler::processRequest()
       } // for all arguments.
     } // if has arguments.
 
-    reply.send200();
-
     if (!isAppletArgsValid) {
+      reply.send200();
       m_dataOutput->writeFully(HttpStrings::HTTP_MSG_BADPARAMS,
                                strlen(HttpStrings::HTTP_MSG_BADPARAMS));
     } else {
@@ -126,13 +212,15 @@ void HttpRequestHandler::processRequest()
                   computerNameANSI.getString(),
                   Configurator::getInstance()->getServerConfig()->getRfbPort(),
                   paramsString.getString());
-      m_dataOutput->writeFully(page.getString(), page.getLength());
+
+      HttpAsset pageAsset;
+      HttpAssetCache::getIndexPage(page.getString(), page.getLength(), &pageAsset);
+      sendAsset(&httpRequest, &reply, &pageAsset);
     } // if applet arguments is valid.
 
     pageFound = true;
   } else if ((strcmp(httpRequest.getFilename(), "/tightvnc-jviewer.jar") == 0)) {
-    reply.send200();
-    m_dataOutput->writeFully(VNC_VIEWER_JAR_BODY, sizeof(VNC_VIEWER_JAR_BODY));
+    sendAsset(&httpRequest, &reply, HttpAssetCache::getViewerJar());
 
     pageFound = true;
   }
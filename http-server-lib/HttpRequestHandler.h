@@ -28,21 +28,48 @@
 #include "io-lib/DataInputStream.h"
 #include "io-lib/DataOutputStream.h"
 #include "log-writer/LogWriter.h"
+#include "util/AnsiStringStorage.h"
+
+#include "HttpRequest.h"
+#include "HttpReply.h"
 
 class HttpRequestHandler
 {
 public:
   HttpRequestHandler(DataInputStream *dataInput, DataOutputStream *dataOutput, LogWriter *log,
-                     const TCHAR *peerHost = 0);
+                     const TCHAR *peerHost = 0, bool webSocketAllowed = false);
   virtual ~HttpRequestHandler();
 
   // Reads HTTP request from input and sends responce to output.
   virtual void processRequest() throw(IOException);
 
+  // Returns true if the request has upgraded the connection to WebSocket,
+  // then the connection must be given to the rfb server.
+  bool isWebSocketUpgraded() const;
+
+  // Returns true if the connection stays open for the next request.
+  bool isKeepAlive() const;
+
 protected:
+  // Sends the asset, or tells the client its copy is valid.
+  void sendAsset(HttpRequest *request, HttpReply *reply, const HttpAsset *asset)
+    throw(IOException);
+
+  // Does the server side of the WebSocket opening handshake. Extensions
+  // offered by the client (e.g. permessage-deflate) are not accepted, the
+  // rfb data are compressed already.
+  void processWebSocketUpgrade(HttpRequest *request, HttpReply *reply)
+    throw(IOException);
+
+  // Computes Sec-WebSocket-Accept value for the Sec-WebSocket-Key value.
+  static void getWebSocketAcceptKey(const char *key, AnsiStringStorage *acceptKey);
+
   DataInputStream *m_dataInput;
   DataOutputStream *m_dataOutput;
   StringStorage m_peerHost;
+  bool m_webSocketAllowed;
+  bool m_webSocketUpgraded;
+  bool m_keepAlive;
 
   LogWriter *m_log;
 };
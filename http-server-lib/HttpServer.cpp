@@ -26,9 +26,68 @@
 #include "HttpClient.h"
 
 #include "thread/ZombieKiller.h"
+#include "thread/AutoLock.h"
 
-HttpServer::HttpServer(const TCHAR *bindHost, unsigned short bindPort, bool lockAddr, LogWriter *log)
+// Connection served by a worker of the network engine.
+class HttpConnection : public IocpListener
+{
+public:
+  HttpConnection(SocketIPv4 *socket, WebSocketListener *webSocketListener,
+                 LogWriter *log)
+  : m_socket(socket),
+    m_webSocketListener(webSocketListener),
+    m_session(0),
+    m_isFinished(false),
+    m_log(log)
+  {
+  }
+
+  virtual ~HttpConnection()
+  {
+    delete m_socket;
+  }
+
+  // Serves one request, the socket is watched further if the connection
+  // is kept open.
+  virtual bool onSocketReadable()
+  {
+    HttpClient::ConnectionState state =
+      HttpClient::processRequest(m_socket, m_webSocketListener, m_log);
+    if (state == HttpClient::CONNECTION_KEPT) {
+      return true;
+    }
+    if (state == HttpClient::CONNECTION_UPGRADED) {
+      AutoLock al(&m_socketLock);
+      m_socket = 0;
+    }
+    m_isFinished = true;
+    return false;
+  }
+
+  // Breaks waiting for the request.
+  void shutdown()
+  {
+    AutoLock al(&m_socketLock);
+    if (m_socket != 0) {
+      try { m_socket->shutdown(SD_BOTH); } catch (...) { }
+    }
+  }
+
+  SocketIPv4 *m_socket;
+  WebSocketListener *m_webSocketListener;
+  IocpSession *m_session;
+  volatile bool m_isFinished;
+  LocalMutex m_socketLock;
+  LogWriter *m_log;
+};
+
+HttpServer::HttpServer(const TCHAR *bindHost, unsigned short bindPort, bool lockAddr,
+                       IocpEngine *engine, WebSocketListener *webSocketListener,
+                       LogWriter *log)
 : TcpServer(bindHost, bindPort, true, lockAddr),
+  m_engine(engine),
+  m_webSocketListener(webSocketListener),
+  m_isStopping(false),
   m_log(log)
 {
   m_log->message(_T("Http server started"));
@@ -36,14 +95,64 @@ HttpServer::HttpServer(const TCHAR *bindHost, unsigned short bindPort, bool lock
 
 HttpServer::~HttpServer()
 {
+  AutoLock al(&m_connectionsLock);
+  m_isStopping = true;
+  std::list<HttpConnection *>::iterator i;
+  for (i = m_connections.begin(); i != m_connections.end(); i++) {
+    (*i)->shutdown();
+  }
+  for (i = m_connections.begin(); i != m_connections.end(); i++) {
+    m_engine->removeSocket((*i)->m_session);
+    delete *i;
+  }
+  m_connections.clear();
+
   m_log->message(_T("Http server stopped"));
 }
 
 void HttpServer::onAcceptConnection(SocketIPv4 *socket)
 {
-  TcpClientThread *clientThread = new HttpClient(socket, m_log);
+  try {
+    int timeout = HttpClient::KEEP_ALIVE_TIMEOUT;
+    socket->setSocketOptions(SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+  } catch (...) { } // try / catch.
+
+  if (m_engine == 0) {
+    TcpClientThread *clientThread = new HttpClient(socket, m_webSocketListener, m_log);
+
+    clientThread->resume();
 
-  clientThread->resume();
+    ZombieKiller::getInstance()->addZombie(clientThread);
+    return;
+  }
 
-  ZombieKiller::getInstance()->addZombie(clientThread);
+  AutoLock al(&m_connectionsLock);
+  removeFinishedConnections();
+  if (m_isStopping) {
+    delete socket;
+    return;
+  }
+  HttpConnection *connection = new HttpConnection(socket, m_webSocketListener, m_log);
+  try {
+    connection->m_session = m_engine->addSocket(socket, connection);
+  } catch (Exception &e) {
+    m_log->error(_T("Can't serve http connection: %s"), e.getMessage());
+    delete connection;
+    return;
+  }
+  m_connections.push_back(connection);
+}
+
+void HttpServer::removeFinishedConnections()
+{
+  std::list<HttpConnection *>::iterator i = m_connections.begin();
+  while (i != m_connections.end()) {
+    if ((*i)->m_isFinished) {
+      m_engine->removeSocket((*i)->m_session);
+      delete *i;
+      i = m_connections.erase(i);
+    } else {
+      i++;
+    }
+  }
 }
@@ -27,11 +27,22 @@
 
 #include "util/CommonHeader.h"
 #include "network/TcpServer.h"
+#include "network/IocpEngine.h"
+#include "thread/LocalMutex.h"
 #include "log-writer/LogWriter.h"
 
+#include "WebSocketListener.h"
+
+#include <list>
+
+class HttpConnection;
+
 /**
  * Simple tcp server that accepts connections and give management over
  * incoming connections to HttpClient class.
+ *
+ * With a network engine, the requests are read by the workers of the
+ * engine, otherwise each connection gets a HttpClient thread.
  */
 class HttpServer : public TcpServer
 {
@@ -41,11 +52,17 @@ public:
    * @param bindHost host to bind.
    * @param bindPort port bind.
    * @param lockAddr determinates if server must set exclusive address.
+   * @param engine network engine to serve the connections, or 0 to serve
+   * each by own thread. Must outlive the server.
+   * @param webSocketListener listener to take connections upgraded to
+   * WebSocket, or 0 not to allow the upgrade.
    * @throws Exception on fail.
    */
   HttpServer(const TCHAR *bindHost,
              unsigned short bindPort,
              bool lockAddr,
+             IocpEngine *engine,
+             WebSocketListener *webSocketListener,
              LogWriter *log) throw(Exception);
   /**
    * Stops http server thread and deletes http server.
@@ -55,11 +72,24 @@ public:
 protected:
   /**
    * Inherited from superclass.
-   * Give management over incoming connection to new HttpClientThread instance.
+   * Give management over incoming connection to the engine or to new
+   * HttpClient instance.
    */
   virtual void onAcceptConnection(SocketIPv4 *socket);
 
+  // Removes the connections served already from the engine.
+  // Must be called with m_connectionsLock held.
+  void removeFinishedConnections();
+
 private:
+  IocpEngine *m_engine;
+  WebSocketListener *m_webSocketListener;
+
+  // Connections watched by the engine.
+  std::list<HttpConnection *> m_connections;
+  bool m_isStopping;
+  LocalMutex m_connectionsLock;
+
   LogWriter *m_log;
 };
 
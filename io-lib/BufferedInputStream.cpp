@@ -1,15 +1,16 @@
 #include "BufferedInputStream.h"
 #include <string.h>
-#include <istream>
-#include <sstream>
-#include <algorithm>
 
-BufferedInputStream::BufferedInputStream(InputStream *input)
+BufferedInputStream::BufferedInputStream(InputStream *input,
+                                         size_t minBufferSize,
+                                         size_t maxBufferSize)
 : m_have(0),
-  INITIAL_BUFFER_SIZE(100000),
-  MAX_BUFFER_SIZE(10000000),
-  m_buffer(INITIAL_BUFFER_SIZE),
-  m_pos(0)
+  m_pos(0),
+  m_minBufferSize(minBufferSize),
+  m_maxBufferSize(maxBufferSize > minBufferSize ? maxBufferSize : minBufferSize),
+  m_bufferSize(minBufferSize),
+  m_buffer(minBufferSize),
+  m_smallReads(0)
 {
   m_input = new DataInputStream(input);
 }
@@ -22,50 +23,81 @@ size_t BufferedInputStream::available() {
   return m_have;
 }
 
+void BufferedInputStream::discard() {
+  m_have = 0;
+  m_pos = 0;
+}
 
-size_t BufferedInputStream::read(void *buffer, size_t len) {
-  char *buf = (char *)buffer;
+size_t BufferedInputStream::getBufferSize() const {
+  return m_bufferSize;
+}
 
+size_t BufferedInputStream::read(void *buffer, size_t len) {
   if (m_have == 0) {
-    m_pos = 0;
+    if (len >= m_bufferSize) {
+      try {
+        return m_input->read(buffer, len);
+      } catch (Exception &) {
+        // Some sources (see the FIXME in fillBuffer()) fail to read
+        // into a buffer that is too small for their data, try the inner
+        // buffer then.
+        if (len >= m_maxBufferSize) {
+          throw;
+        }
+      }
+    }
+    fillBuffer();
   }
 
-  if (len <= m_have) {
-    memcpy(buf, &m_buffer[m_pos], len);
-    m_have -= len;
-    m_pos += len;
-    return len;
+  size_t copied = len < m_have ? len : m_have;
+  memcpy(buffer, &m_buffer[m_pos], copied);
+  m_have -= copied;
+  m_pos += copied;
+  return copied;
+}
+
+void BufferedInputStream::readInto(void *buffer, size_t len) {
+  char *buf = (char *)buffer;
+  size_t totalRead = 0;
+  while (totalRead < len) {
+    totalRead += read(buf + totalRead, len - totalRead);
   }
-  memcpy(buf, &m_buffer[m_pos], m_have);
-  size_t copied = m_have;
+}
+
+void BufferedInputStream::fillBuffer() {
   m_pos = 0;
-  if (m_buffer.size() > INITIAL_BUFFER_SIZE) {
-    m_buffer.resize(INITIAL_BUFFER_SIZE);
-  }  
+  size_t size = m_bufferSize;
   // FIXME: available() sometimes does not work for POCO 
   // Websocket (always for secure connection).
   size_t need = m_input->available();
-  if (need > INITIAL_BUFFER_SIZE) {
-    m_buffer.resize(std::min(need, MAX_BUFFER_SIZE));
+  if (need > size) {
+    size = need < m_maxBufferSize ? need : m_maxBufferSize;
   }
+  m_buffer.resize(size);
   try {
     m_have = m_input->read(&m_buffer[0], m_buffer.size());
   }
-  catch (Exception &e) { 
-    if (m_buffer.size() == MAX_BUFFER_SIZE) {
-      throw e;
+  catch (Exception &) { 
+    if (m_buffer.size() == m_maxBufferSize) {
+      throw;
     }
-    m_buffer.resize(MAX_BUFFER_SIZE);
+    m_buffer.resize(m_maxBufferSize);
     m_have = m_input->read(&m_buffer[0], m_buffer.size());
   }
-  size_t remain = std::min(m_have, len - copied);
-  memcpy(&buf[copied], &m_buffer[0], remain);
-  copied += remain;
-  m_have -= remain;
-  m_pos += remain;
-  if (m_have == 0) {
-    m_pos = 0;
-  }
-  return copied;
+  adaptBufferSize(m_have);
 }
 
+void BufferedInputStream::adaptBufferSize(size_t bytesRead) {
+  if (bytesRead >= m_bufferSize) {
+    // The source has more data than one read can take.
+    m_smallReads = 0;
+    m_bufferSize = m_bufferSize < m_maxBufferSize / 2 ? m_bufferSize * 2 : m_maxBufferSize;
+  } else if (bytesRead < m_bufferSize / 4) {
+    if (++m_smallReads >= SHRINK_AFTER_READS) {
+      m_smallReads = 0;
+      m_bufferSize = m_bufferSize / 2 > m_minBufferSize ? m_bufferSize / 2 : m_minBufferSize;
+    }
+  } else {
+    m_smallReads = 0;
+  }
+}
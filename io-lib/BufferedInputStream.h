@@ -4,26 +4,69 @@
 #include "DataInputStream.h"
 #include <vector>
 
+/**
+ * Buffered input stream class (decorator pattern).
+ * Small reads are served from the inner buffer. Reads that are not smaller
+ * than the buffer go straight to the target buffer when nothing is
+ * buffered, so big payloads are not copied twice.
+ *
+ * The buffer size adapts to the source: it is doubled while reads fill it
+ * completely and halved after a number of reads that used less than a
+ * quarter of it, within [minBufferSize, maxBufferSize].
+ */
 class BufferedInputStream : public InputStream
 {
 public:
+  static const size_t DEFAULT_MIN_BUFFER_SIZE = 64 * 1024;
+  static const size_t DEFAULT_MAX_BUFFER_SIZE = 1024 * 1024;
 
-  BufferedInputStream(InputStream *input);
+  BufferedInputStream(InputStream *input,
+                      size_t minBufferSize = DEFAULT_MIN_BUFFER_SIZE,
+                      size_t maxBufferSize = DEFAULT_MAX_BUFFER_SIZE);
 
   virtual ~BufferedInputStream();
 
   virtual size_t read(void *buffer, size_t len);
 
+  /**
+   * Reads exactly len bytes to the buffer. Bytes that are already buffered
+   * are copied, the rest is received right into the buffer whenever it is
+   * not smaller than the inner buffer.
+   * @throws any exception of the source stream.
+   */
+  void readInto(void *buffer, size_t len);
+
   size_t available();
 
+  /**
+   * Drops the buffered data, e.g. when the source stream has been replaced
+   * and the data are not valid any more.
+   */
+  void discard();
+
+  /**
+   * Returns the current size of the inner buffer.
+   */
+  size_t getBufferSize() const;
+
 protected:
 
-  const size_t MAX_BUFFER_SIZE;
-  const size_t INITIAL_BUFFER_SIZE;
+  // Reads the source stream to the inner buffer, it must be empty.
+  void fillBuffer();
+
+  // Adapts m_bufferSize to the number of bytes got by the last fill.
+  void adaptBufferSize(size_t bytesRead);
+
+  // Number of poorly used reads after that the buffer is shrunk.
+  static const int SHRINK_AFTER_READS = 16;
 
   DataInputStream *m_input;
 
   std::vector<char> m_buffer;
+  size_t m_bufferSize;
+  size_t m_minBufferSize;
+  size_t m_maxBufferSize;
+  int m_smallReads;
 
   size_t m_have;
   size_t m_pos;
@@ -24,8 +24,16 @@
 
 #include "BufferedOutputStream.h"
 
-BufferedOutputStream::BufferedOutputStream(OutputStream *output)
-: m_dataLength(0)
+BufferedOutputStream::BufferedOutputStream(OutputStream *output,
+                                           size_t minBufferSize,
+                                           size_t maxBufferSize)
+: m_stream(output),
+  m_buffer(minBufferSize),
+  m_minBufferSize(minBufferSize),
+  m_maxBufferSize(maxBufferSize > minBufferSize ? maxBufferSize : minBufferSize),
+  m_dataLength(0),
+  m_measuredBytes(0),
+  m_measuredTime(0)
 {
   m_output = new DataOutputStream(output);
 }
@@ -40,12 +48,15 @@ BufferedOutputStream::~BufferedOutputStream()
   delete m_output;
 }
 
-size_t BufferedOutputStream::write(const void *buffer, size_t len)
+size_t BufferedOutputStream::getBufferSize() const
 {
-  if (m_dataLength + len >= sizeof(m_buffer)) {
-    flush();
+  return m_buffer.size();
+}
 
-    m_output->writeFully(buffer, len);
+size_t BufferedOutputStream::write(const void *buffer, size_t len)
+{
+  if (len >= MIN_GATHER_LENGTH || m_dataLength + len >= m_buffer.size()) {
+    writeWithBuffered(buffer, len);
   } else {
     memcpy(&m_buffer[m_dataLength], buffer, len);
 
@@ -55,9 +66,97 @@ size_t BufferedOutputStream::write(const void *buffer, size_t len)
   return len;
 }
 
+size_t BufferedOutputStream::writeRows(const void *first, size_t rowLength,
+                                       size_t stride, size_t rowCount)
+{
+  if (rowCount == 0) {
+    return 0;
+  }
+  const char *row = (const char *)first;
+  size_t len = rowLength * rowCount;
+  if (len < MIN_GATHER_LENGTH && m_dataLength + len < m_buffer.size()) {
+    for (size_t i = 0; i < rowCount; i++, row += stride) {
+      memcpy(&m_buffer[m_dataLength], row, rowLength);
+      m_dataLength += rowLength;
+    }
+    return len;
+  }
+  writeWithBuffered(row, rowLength);
+  if (rowCount == 1) {
+    return rowLength;
+  }
+  DateTime startTime = DateTime::now();
+  size_t written = m_stream->writeRows(row + stride, rowLength, stride,
+                                       rowCount - 1);
+  onWritten(written, startTime);
+  return rowLength + written;
+}
+
+void BufferedOutputStream::writeWithBuffered(const void *buffer, size_t len)
+{
+  DateTime startTime = DateTime::now();
+  const char *data = (const char *)buffer;
+  size_t bufferedSent = 0;
+  size_t dataSent = 0;
+  while (bufferedSent < m_dataLength || dataSent < len) {
+    size_t bufferedLeft = m_dataLength - bufferedSent;
+    size_t written = m_stream->writeGather(&m_buffer[bufferedSent], bufferedLeft,
+                                           data + dataSent, len - dataSent);
+    if (written <= bufferedLeft) {
+      bufferedSent += written;
+    } else {
+      bufferedSent = m_dataLength;
+      dataSent += written - bufferedLeft;
+    }
+  }
+
+  size_t total = m_dataLength + len;
+  m_dataLength = 0;
+  onWritten(total, startTime);
+}
+
 void BufferedOutputStream::flush()
 {
+  if (m_dataLength == 0) {
+    return;
+  }
+  DateTime startTime = DateTime::now();
   m_output->writeFully(&m_buffer[0], m_dataLength);
 
+  size_t total = m_dataLength;
+  m_dataLength = 0;
+  onWritten(total, startTime);
+}
+
+void BufferedOutputStream::discard()
+{
   m_dataLength = 0;
 }
+
+void BufferedOutputStream::onWritten(size_t bytes, DateTime startTime)
+{
+  m_measuredBytes += bytes;
+  UINT64 now = DateTime::now().getTime();
+  if (now > startTime.getTime()) {
+    m_measuredTime += now - startTime.getTime();
+  }
+  if (m_measuredBytes < MEASURE_BUFFERS * m_buffer.size()) {
+    return;
+  }
+
+  // Writes that never block mean the real output stream is faster than
+  // the timer resolution.
+  UINT64 bufferSize = m_maxBufferSize;
+  if (m_measuredTime != 0) {
+    bufferSize = m_measuredBytes * TARGET_WRITE_TIME / m_measuredTime;
+  }
+  if (bufferSize < m_minBufferSize) {
+    bufferSize = m_minBufferSize;
+  } else if (bufferSize > m_maxBufferSize) {
+    bufferSize = m_maxBufferSize;
+  }
+  m_buffer.resize((size_t)bufferSize);
+
+  m_measuredBytes = 0;
+  m_measuredTime = 0;
+}
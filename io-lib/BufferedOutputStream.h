@@ -27,20 +27,38 @@
 
 #include "OutputStream.h"
 #include "DataOutputStream.h"
+#include "util/DateTime.h"
+
+#include <vector>
 
 /**
  * Buffered output stream class (decorator pattern).
  * Adds bufferization feature to output stream.
- * @remark size of buffer now is fixed and equals to 1400 bytes.
+ * Small writes are collected in the inner buffer. Big writes and writes
+ * that do not fit the buffer are not copied, they are written to the real
+ * output stream together with the buffered data via
+ * OutputStream::writeGather(). Big row writes go to the real output stream
+ * as rows too (see OutputStream::writeRows()).
+ *
+ * The buffer size follows the measured throughput of the real output
+ * stream: it holds about TARGET_WRITE_TIME milliseconds of data, within
+ * [minBufferSize, maxBufferSize].
  */
 class BufferedOutputStream : public OutputStream
 {
 public:
+  static const size_t DEFAULT_MIN_BUFFER_SIZE = 64 * 1024;
+  static const size_t DEFAULT_MAX_BUFFER_SIZE = 1024 * 1024;
+
   /**
    * Creates new buffered output stream.
    * @param output real output stream.
+   * @param minBufferSize lower limit of the inner buffer size.
+   * @param maxBufferSize upper limit of the inner buffer size.
    */
-  BufferedOutputStream(OutputStream *output);
+  BufferedOutputStream(OutputStream *output,
+                       size_t minBufferSize = DEFAULT_MIN_BUFFER_SIZE,
+                       size_t maxBufferSize = DEFAULT_MAX_BUFFER_SIZE);
   virtual ~BufferedOutputStream();
 
   /**
@@ -52,6 +70,15 @@ public:
    */
   virtual size_t write(const void *buffer, size_t len) throw(IOException);
 
+  /**
+   * Copies small rows to the inner buffer. The buffered data leave
+   * together with the first row of big ones, the other rows are passed to
+   * real output stream at once.
+   * @throws IOException on error.
+   */
+  virtual size_t writeRows(const void *first, size_t rowLength,
+                           size_t stride, size_t rowCount) throw(IOException);
+
   /**
    * Writes content of inner buffer to real output stream.
    * @throws IOException on error.
@@ -59,12 +86,54 @@ public:
    */
   void flush() throw(IOException);
 
+  /**
+   * Drops the data of the inner buffer without writing it, e.g. when the
+   * real output stream has been replaced and the data are not valid any
+   * more.
+   */
+  void discard();
+
+  /**
+   * Returns the current size of the inner buffer.
+   */
+  size_t getBufferSize() const;
+
 protected:
+  /**
+   * Writes the buffered data and then the given data to real output stream
+   * without copying the given data, and empties the inner buffer.
+   * @throws IOException on error.
+   */
+  void writeWithBuffered(const void *buffer, size_t len) throw(IOException);
+
+  /**
+   * Accounts bytes written to real output stream since startTime and
+   * resizes the inner buffer when enough data have been measured.
+   * Must be called with the inner buffer empty.
+   */
+  void onWritten(size_t bytes, DateTime startTime);
+
+  // Writes of this size or bigger bypass the inner buffer.
+  static const size_t MIN_GATHER_LENGTH = 16384;
+
+  // Time in milliseconds the real output stream needs to write a full
+  // inner buffer.
+  static const unsigned int TARGET_WRITE_TIME = 20;
+
+  // The throughput is measured over this number of buffer sizes.
+  static const size_t MEASURE_BUFFERS = 4;
+
+  OutputStream *m_stream;
   DataOutputStream *m_output;
 
-  char m_buffer[100000];
+  std::vector<char> m_buffer;
+  size_t m_minBufferSize;
+  size_t m_maxBufferSize;
 
   size_t m_dataLength;
+
+  UINT64 m_measuredBytes;
+  UINT64 m_measuredTime;
 };
 
 #endif
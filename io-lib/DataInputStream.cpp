@@ -25,9 +25,13 @@
 #include "DataInputStream.h"
 #include <vector>
 #include "util/Utf8StringStorage.h"
+#include "util/Utf8Transcoder.h"
 
 #define SETBYTE(y, n) (((y) & 0xFF) << ((n) * 8))
 
+// Strings up to this size in bytes are converted in buffers on the stack.
+static const size_t SHORT_STRING_SIZE = 1024;
+
 DataInputStream::DataInputStream(InputStream *inputStream)
 : m_inputStream(inputStream)
 {
@@ -129,6 +133,25 @@ INT64 DataInputStream::readInt64()
 void DataInputStream::readUTF8(StringStorage *storage)
 {
   UINT32 sizeInBytes = readUInt32();
+#ifdef _UNICODE
+  // Most of the strings are file names, converted with no allocation.
+  if (sizeInBytes > 0 && sizeInBytes <= SHORT_STRING_SIZE) {
+    char utf8[SHORT_STRING_SIZE];
+    WCHAR uni[SHORT_STRING_SIZE + 1];
+    readFully(utf8, sizeInBytes);
+    size_t uniLength;
+    if (Utf8Transcoder::utf8ToUtf16(utf8, sizeInBytes,
+                                    uni, SHORT_STRING_SIZE, &uniLength)) {
+      uni[uniLength] = L'\0';
+      storage->setString(uni);
+    } else {
+      std::vector<char> buffer(utf8, utf8 + sizeInBytes);
+      Utf8StringStorage utf8String(&buffer);
+      utf8String.toStringStorage(storage);
+    }
+    return;
+  }
+#endif
   if (sizeInBytes > 0) {
     std::vector<char> buffer(sizeInBytes);
     readFully(&buffer.front(), sizeInBytes);
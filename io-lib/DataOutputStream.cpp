@@ -24,10 +24,15 @@
 
 #include "DataOutputStream.h"
 #include "util/Utf8StringStorage.h"
+#include "util/Utf8Transcoder.h"
 #include <vector>
 
 #define GETBYTE(x, n) (((x) >> ((n) * 8)) & 0xFF)
 
+// Strings up to this length in characters are converted in a buffer on the
+// stack.
+static const size_t SHORT_STRING_LENGTH = 512;
+
 DataOutputStream::DataOutputStream(OutputStream *outputStream)
 : m_outStream(outputStream)
 {
@@ -54,6 +59,60 @@ void DataOutputStream::writeFully(const void *buffer, size_t len)
   }
 }
 
+size_t DataOutputStream::writeGather(const void *first, size_t firstLen,
+                                     const void *second, size_t secondLen)
+{
+  return m_outStream->writeGather(first, firstLen, second, secondLen);
+}
+
+void DataOutputStream::writeFullyGather(const void *first, size_t firstLen,
+                                        const void *second, size_t secondLen)
+{
+  const char *firstData = (const char *)first;
+  const char *secondData = (const char *)second;
+  while (firstLen != 0 || secondLen != 0) {
+    size_t written = m_outStream->writeGather(firstData, firstLen,
+                                              secondData, secondLen);
+    if (written <= firstLen) {
+      firstData += written;
+      firstLen -= written;
+    } else {
+      written -= firstLen;
+      firstLen = 0;
+      secondData += written;
+      secondLen -= written;
+    }
+  }
+}
+
+size_t DataOutputStream::writeRows(const void *first, size_t rowLength,
+                                   size_t stride, size_t rowCount)
+{
+  return m_outStream->writeRows(first, rowLength, stride, rowCount);
+}
+
+void DataOutputStream::writeRowsFully(const void *first, size_t rowLength,
+                                      size_t stride, size_t rowCount)
+{
+  if (rowLength == 0) {
+    return;
+  }
+  const char *row = (const char *)first;
+  while (rowCount != 0) {
+    size_t written = m_outStream->writeRows(row, rowLength, stride, rowCount);
+    size_t rowsWritten = written / rowLength;
+    size_t rowWritten = written % rowLength;
+    row += rowsWritten * stride;
+    rowCount -= rowsWritten;
+    if (rowWritten != 0) {
+      // The rest of the partially written row goes alone.
+      writeFully(row + rowWritten, rowLength - rowWritten);
+      row += stride;
+      rowCount--;
+    }
+  }
+}
+
 void DataOutputStream::writeUInt8(UINT8 x)
 {
   writeFully((char *)&x, 1);
@@ -119,6 +178,21 @@ void DataOutputStream::writeInt64(INT64 x)
 
 void DataOutputStream::writeUTF8(const TCHAR *string)
 {
+#ifdef _UNICODE
+  // The terminating null character is sent too.
+  size_t length = _tcslen(string) + 1;
+  if (length <= SHORT_STRING_LENGTH) {
+    char utf8[SHORT_STRING_LENGTH * 3];
+    size_t utf8Size;
+    if (Utf8Transcoder::utf16ToUtf8(string, length,
+                                    utf8, sizeof(utf8), &utf8Size)) {
+      writeUInt32((UINT32)utf8Size);
+      writeFully(utf8, utf8Size);
+      return;
+    }
+  }
+#endif
+
   size_t sizeInBytes = 0;
 
   // to UTF8 string convertion
@@ -59,6 +59,40 @@ public:
    */
   void writeFully(const void *buffer, size_t len) throw(IOException);
 
+  /**
+   * Inherited from superclass.
+   * @remark just delegates call to real output stream.
+   */
+  virtual size_t writeGather(const void *first, size_t firstLen,
+                             const void *second, size_t secondLen)
+    throw(IOException);
+
+  /**
+   * Writes both buffers fully, with as few calls to the real output stream
+   * as it can take.
+   * @throws IOException on error.
+   */
+  void writeFullyGather(const void *first, size_t firstLen,
+                        const void *second, size_t secondLen)
+    throw(IOException);
+
+  /**
+   * Inherited from superclass.
+   * @remark just delegates call to real output stream.
+   */
+  virtual size_t writeRows(const void *first, size_t rowLength,
+                           size_t stride, size_t rowCount)
+    throw(IOException);
+
+  /**
+   * Writes all the rows fully, with as few calls to the real output stream
+   * as it can take.
+   * @throws IOException on error.
+   */
+  void writeRowsFully(const void *first, size_t rowLength,
+                      size_t stride, size_t rowCount)
+    throw(IOException);
+
   void writeUInt8(UINT8 x) throw(IOException);
   void writeUInt16(UINT16 x) throw(IOException);
   void writeUInt32(UINT32 x) throw(IOException);
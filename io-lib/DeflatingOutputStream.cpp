@@ -0,0 +1,127 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DeflatingOutputStream.h"
+#include "util/MemAccount.h"
+
+DeflatingOutputStream::DeflatingOutputStream(OutputStream *output, int level)
+: m_output(output),
+  m_buffer(BUFFER_SIZE),
+  m_bytesIn(0),
+  m_bytesOut(0),
+  m_deflateTicks(0)
+{
+  QueryPerformanceFrequency(&m_perfFrequency);
+
+  m_zlibStream.zalloc = MemAccount::zlibAlloc;
+  m_zlibStream.zfree = MemAccount::zlibFree;
+  m_zlibStream.opaque = Z_NULL;
+  if (deflateInit(&m_zlibStream, level) != Z_OK) {
+    throw IOException(_T("Cannot initialize the transport compression"));
+  }
+
+  m_zlibStream.next_in = 0;
+  m_zlibStream.avail_in = 0;
+}
+
+DeflatingOutputStream::~DeflatingOutputStream()
+{
+  deflateEnd(&m_zlibStream);
+}
+
+size_t DeflatingOutputStream::write(const void *buffer, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+  // avail_in is 32 bits wide, bigger buffers are written by parts.
+  const size_t maxPortion = 0x40000000;
+  unsigned int portion = (unsigned int)(len < maxPortion ? len : maxPortion);
+  m_zlibStream.next_in = (Bytef *)buffer;
+  m_zlibStream.avail_in = portion;
+  deflate(Z_NO_FLUSH);
+  m_bytesIn += portion;
+  return portion;
+}
+
+void DeflatingOutputStream::flush()
+{
+  m_zlibStream.next_in = 0;
+  m_zlibStream.avail_in = 0;
+  deflate(Z_SYNC_FLUSH);
+  m_output->flush();
+}
+
+void DeflatingOutputStream::deflate(int flushMode)
+{
+  LARGE_INTEGER start;
+  QueryPerformanceCounter(&start);
+  do {
+    m_zlibStream.next_out = (Bytef *)&m_buffer.front();
+    m_zlibStream.avail_out = (unsigned int)m_buffer.size();
+    int r = ::deflate(&m_zlibStream, flushMode);
+    if (r != Z_OK && r != Z_BUF_ERROR) {
+      throw IOException(_T("Transport compression failed"));
+    }
+    size_t produced = m_buffer.size() - m_zlibStream.avail_out;
+    if (produced != 0) {
+      // The time of writing is not the time of compression.
+      LARGE_INTEGER stop;
+      QueryPerformanceCounter(&stop);
+      m_deflateTicks += stop.QuadPart - start.QuadPart;
+      writeOutput(produced);
+      QueryPerformanceCounter(&start);
+    }
+    // A full output buffer means zlib may have more output for us.
+  } while (m_zlibStream.avail_in != 0 || m_zlibStream.avail_out == 0);
+  LARGE_INTEGER stop;
+  QueryPerformanceCounter(&stop);
+  m_deflateTicks += stop.QuadPart - start.QuadPart;
+}
+
+void DeflatingOutputStream::writeOutput(size_t len)
+{
+  const char *data = &m_buffer.front();
+  while (len != 0) {
+    size_t written = m_output->write(data, len);
+    data += written;
+    len -= written;
+  }
+  m_bytesOut += data - &m_buffer.front();
+}
+
+UINT64 DeflatingOutputStream::getBytesIn() const
+{
+  return m_bytesIn;
+}
+
+UINT64 DeflatingOutputStream::getBytesOut() const
+{
+  return m_bytesOut;
+}
+
+UINT64 DeflatingOutputStream::getDeflateTime() const
+{
+  return m_deflateTicks * 1000000 / (UINT64)m_perfFrequency.QuadPart;
+}
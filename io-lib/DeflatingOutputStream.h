@@ -0,0 +1,104 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _DEFLATING_OUTPUT_STREAM_H_
+#define _DEFLATING_OUTPUT_STREAM_H_
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "zlib/zlib.h"
+#include "OutputStream.h"
+
+#include <vector>
+
+/**
+ * Output stream which compresses all the data written to it as one zlib
+ * stream and passes the compressed data to another output stream.
+ *
+ * The stream never ends: flush() sync-flushes the compressor, so the peer
+ * can inflate all the data written so far, and then flushes the real output
+ * stream.
+ */
+class DeflatingOutputStream : public OutputStream
+{
+public:
+  /**
+   * Creates new deflating output stream.
+   * @param output real output stream.
+   * @param level zlib compression level (1..9).
+   */
+  DeflatingOutputStream(OutputStream *output, int level);
+  virtual ~DeflatingOutputStream();
+
+  /**
+   * Compresses the data. The compressed data are written to the real
+   * output stream when the inner buffer is full, or on flush().
+   * @throws IOException on error.
+   */
+  virtual size_t write(const void *buffer, size_t len) throw(IOException);
+
+  /**
+   * Writes all the compressed data and flushes the real output stream.
+   * @throws IOException on error.
+   */
+  virtual void flush() throw(IOException);
+
+  /**
+   * Returns the number of bytes written to the stream since its creation.
+   */
+  UINT64 getBytesIn() const;
+
+  /**
+   * Returns the number of compressed bytes passed to the real output stream.
+   */
+  UINT64 getBytesOut() const;
+
+  /**
+   * Returns the time spent on compression, in microseconds.
+   */
+  UINT64 getDeflateTime() const;
+
+protected:
+  static const size_t BUFFER_SIZE = 64 * 1024;
+
+  // Runs the compressor on the pending input with the flush mode of zlib
+  // until the input is consumed (and, for Z_SYNC_FLUSH, the output is
+  // complete), writing the full output buffers to the real stream.
+  void deflate(int flushMode);
+
+  // Writes the first len bytes of the output buffer to the real stream.
+  void writeOutput(size_t len);
+
+  OutputStream *m_output;
+
+  z_stream m_zlibStream;
+  std::vector<char> m_buffer;
+
+  UINT64 m_bytesIn;
+  UINT64 m_bytesOut;
+  UINT64 m_deflateTicks;
+  LARGE_INTEGER m_perfFrequency;
+};
+
+#endif
@@ -0,0 +1,107 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "InflatingInputStream.h"
+#include "util/MemAccount.h"
+
+#include <string.h>
+
+InflatingInputStream::InflatingInputStream(InputStream *input)
+: m_input(input),
+  m_inBuffer(BUFFER_SIZE),
+  m_outBuffer(BUFFER_SIZE),
+  m_have(0),
+  m_pos(0)
+{
+  m_zlibStream.zalloc = MemAccount::zlibAlloc;
+  m_zlibStream.zfree = MemAccount::zlibFree;
+  m_zlibStream.opaque = Z_NULL;
+  m_zlibStream.next_in = 0;
+  m_zlibStream.avail_in = 0;
+  if (inflateInit(&m_zlibStream) != Z_OK) {
+    throw IOException(_T("Cannot initialize the transport decompression"));
+  }
+}
+
+InflatingInputStream::~InflatingInputStream()
+{
+  inflateEnd(&m_zlibStream);
+}
+
+size_t InflatingInputStream::read(void *buffer, size_t len)
+{
+  // A sync flush block may give no data, so more input is read until some
+  // data are there.
+  while (m_have == 0) {
+    if (m_zlibStream.avail_in == 0) {
+      m_zlibStream.next_in = (Bytef *)&m_inBuffer.front();
+      m_zlibStream.avail_in = (unsigned int)m_input->read(&m_inBuffer.front(),
+                                                          m_inBuffer.size());
+    }
+    inflate();
+  }
+
+  size_t copied = len < m_have ? len : m_have;
+  memcpy(buffer, &m_outBuffer[m_pos], copied);
+  m_have -= copied;
+  m_pos += copied;
+  return copied;
+}
+
+size_t InflatingInputStream::available()
+{
+  if (m_have == 0) {
+    if (m_zlibStream.avail_in == 0) {
+      size_t sourceAvailable = m_input->available();
+      if (sourceAvailable != 0) {
+        size_t len = sourceAvailable < m_inBuffer.size() ?
+                     sourceAvailable : m_inBuffer.size();
+        m_zlibStream.next_in = (Bytef *)&m_inBuffer.front();
+        m_zlibStream.avail_in = (unsigned int)m_input->read(&m_inBuffer.front(),
+                                                            len);
+      }
+    }
+    if (m_zlibStream.avail_in != 0) {
+      inflate();
+    }
+  }
+  return m_have;
+}
+
+void InflatingInputStream::inflate()
+{
+  m_zlibStream.next_out = (Bytef *)&m_outBuffer.front();
+  m_zlibStream.avail_out = (unsigned int)m_outBuffer.size();
+
+  int r = ::inflate(&m_zlibStream, Z_SYNC_FLUSH);
+  if (r == Z_STREAM_END) {
+    throw IOException(_T("Transport compression stream has ended"));
+  }
+  if (r != Z_OK && r != Z_BUF_ERROR) {
+    throw IOException(_T("Transport compression stream is corrupted"));
+  }
+
+  m_pos = 0;
+  m_have = m_outBuffer.size() - m_zlibStream.avail_out;
+}
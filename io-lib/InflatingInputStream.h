@@ -0,0 +1,78 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _INFLATING_INPUT_STREAM_H_
+#define _INFLATING_INPUT_STREAM_H_
+
+#include "zlib/zlib.h"
+#include "InputStream.h"
+
+#include <vector>
+
+/**
+ * Input stream which reads one endless zlib stream from another input
+ * stream and returns the decompressed data. It is the reading end of
+ * DeflatingOutputStream.
+ */
+class InflatingInputStream : public InputStream
+{
+public:
+  /**
+   * Creates new inflating input stream.
+   * @param input source of the compressed data.
+   */
+  InflatingInputStream(InputStream *input);
+  virtual ~InflatingInputStream();
+
+  /**
+   * Returns decompressed data, reading the source if no decompressed data
+   * are ready.
+   * @throws IOException on corrupted or finished stream, any exception of
+   * the source stream.
+   */
+  virtual size_t read(void *buffer, size_t len);
+
+  /**
+   * Returns the number of decompressed bytes ready to be read, made of the
+   * data the source has available without waiting.
+   */
+  virtual size_t available();
+
+protected:
+  static const size_t BUFFER_SIZE = 64 * 1024;
+
+  // Decompresses the pending input to the output buffer, it must be empty.
+  void inflate();
+
+  InputStream *m_input;
+
+  z_stream m_zlibStream;
+  std::vector<char> m_inBuffer;
+  std::vector<char> m_outBuffer;
+
+  size_t m_have;
+  size_t m_pos;
+};
+
+#endif
@@ -28,6 +28,24 @@ OutputStream::~OutputStream()
 {
 }
 
+size_t OutputStream::writeGather(const void *first, size_t firstLen,
+                                 const void *second, size_t secondLen)
+{
+  if (firstLen != 0) {
+    return write(first, firstLen);
+  }
+  return write(second, secondLen);
+}
+
+size_t OutputStream::writeRows(const void *first, size_t rowLength,
+                               size_t stride, size_t rowCount)
+{
+  if (rowCount == 0) {
+    return 0;
+  }
+  return write(first, rowLength);
+}
+
 void OutputStream::flush()
 {
 }
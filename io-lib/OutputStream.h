@@ -44,6 +44,41 @@ public:
    */
   virtual size_t write(const void *buffer, size_t len) = 0;
 
+  /**
+   * Writes data from two buffers to stream, the second buffer right after
+   * the first one, with as few system calls as the stream can do it.
+   *
+   * The default implementation writes from the first non-empty buffer
+   * only, it can be overriden by subclasses which can write both at once.
+   * @param first first buffer with data to write.
+   * @param firstLen count of bytes to write from the first buffer.
+   * @param second second buffer with data to write.
+   * @param secondLen count of bytes to write from the second buffer.
+   * @return count of written bytes from both buffers together.
+   * @throws any kind of exception (depends on implementation).
+   */
+  virtual size_t writeGather(const void *first, size_t firstLen,
+                             const void *second, size_t secondLen);
+
+  /**
+   * Writes rows of equal length which lie at the same distance from each
+   * other in memory, e.g. the rows of a rectangle of a frame buffer, one
+   * right after another, without copying them together first if the
+   * stream can do that.
+   *
+   * The default implementation writes from the first row only, it can be
+   * overriden by subclasses which can write several rows at once.
+   * @param first first row.
+   * @param rowLength count of bytes to write from every row.
+   * @param stride distance in bytes from the start of a row to the next one.
+   * @param rowCount count of rows.
+   * @return count of written bytes from all the rows together, the last
+   * row may be written partially.
+   * @throws any kind of exception (depends on implementation).
+   */
+  virtual size_t writeRows(const void *first, size_t rowLength,
+                           size_t stride, size_t rowCount);
+
   /**
    * Flushes inner buffer to real output stream.
    *
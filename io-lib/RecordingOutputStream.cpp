@@ -0,0 +1,95 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RecordingOutputStream.h"
+
+RecordingOutputStream::RecordingOutputStream(OutputStream *outputStream)
+: m_outStream(outputStream), m_recording(false), m_totalWritten(0)
+{
+}
+
+RecordingOutputStream::~RecordingOutputStream()
+{
+}
+
+size_t RecordingOutputStream::write(const void *buffer, size_t len)
+{
+  size_t written = len;
+  if (m_outStream != 0) {
+    written = m_outStream->write(buffer, len);
+  }
+  m_totalWritten += written;
+  if (m_recording) {
+    const char *data = (const char *)buffer;
+    m_record.insert(m_record.end(), data, data + written);
+  }
+  return written;
+}
+
+size_t RecordingOutputStream::writeRows(const void *first, size_t rowLength,
+                                        size_t stride, size_t rowCount)
+{
+  if (m_recording) {
+    return OutputStream::writeRows(first, rowLength, stride, rowCount);
+  }
+  size_t written = rowLength * rowCount;
+  if (m_outStream != 0) {
+    written = m_outStream->writeRows(first, rowLength, stride, rowCount);
+  }
+  m_totalWritten += written;
+  return written;
+}
+
+void RecordingOutputStream::flush()
+{
+  if (m_outStream != 0) {
+    m_outStream->flush();
+  }
+}
+
+void RecordingOutputStream::setOutputStream(OutputStream *outputStream)
+{
+  m_outStream = outputStream;
+}
+
+void RecordingOutputStream::startRecording()
+{
+  m_record.clear();
+  m_recording = true;
+}
+
+void RecordingOutputStream::stopRecording()
+{
+  m_recording = false;
+}
+
+const std::vector<char> *RecordingOutputStream::getRecord() const
+{
+  return &m_record;
+}
+
+UINT64 RecordingOutputStream::getTotalWritten() const
+{
+  return m_totalWritten;
+}
@@ -0,0 +1,100 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _RECORDING_OUTPUT_STREAM_H_
+#define _RECORDING_OUTPUT_STREAM_H_
+
+#include <vector>
+
+#include "util/inttypes.h"
+#include "OutputStream.h"
+
+/**
+ * Output stream which passes all data to another output stream (if any) and
+ * keeps a copy of the data written while recording is on.
+ */
+class RecordingOutputStream : public OutputStream
+{
+public:
+  /**
+   * Creates new recording output stream.
+   * @param outputStream real output stream, or 0 if data should only be
+   * recorded.
+   */
+  RecordingOutputStream(OutputStream *outputStream);
+  virtual ~RecordingOutputStream();
+
+  /**
+   * Writes data to the real output stream, and appends it to the record
+   * if recording is on.
+   */
+  virtual size_t write(const void *buffer, size_t len);
+
+  /**
+   * Passes the rows to the real output stream at once while recording is
+   * off, the recorded rows go one by one.
+   */
+  virtual size_t writeRows(const void *first, size_t rowLength,
+                           size_t stride, size_t rowCount);
+
+  /**
+   * Flushes the real output stream.
+   */
+  virtual void flush();
+
+  /**
+   * Changes the real output stream, e.g. to a stream which wraps the old
+   * one. The record is not affected.
+   */
+  void setOutputStream(OutputStream *outputStream);
+
+  /**
+   * Clears the record and starts recording.
+   */
+  void startRecording();
+
+  /**
+   * Stops recording. The record remains available via getRecord().
+   */
+  void stopRecording();
+
+  /**
+   * Returns data recorded between the last startRecording() and
+   * stopRecording() calls.
+   */
+  const std::vector<char> *getRecord() const;
+
+  /**
+   * Returns the number of bytes written to the stream since its creation.
+   */
+  UINT64 getTotalWritten() const;
+
+protected:
+  OutputStream *m_outStream;
+  std::vector<char> m_record;
+  bool m_recording;
+  UINT64 m_totalWritten;
+};
+
+#endif
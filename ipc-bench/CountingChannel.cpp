@@ -0,0 +1,96 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CountingChannel.h"
+#include "thread/AutoLock.h"
+
+CountingChannel::Counters::Counters()
+: bytesRead(0),
+  bytesWritten(0),
+  reads(0),
+  writes(0),
+  replyTime(0)
+{
+}
+
+CountingChannel::CountingChannel(Channel *channel)
+: m_channel(channel),
+  m_lastReadTime(0)
+{
+}
+
+CountingChannel::~CountingChannel()
+{
+}
+
+size_t CountingChannel::read(void *buffer, size_t len)
+{
+  size_t count = m_channel->read(buffer, len);
+  INT64 time = now();
+  AutoLock al(&m_lock);
+  m_counters.bytesRead += count;
+  m_counters.reads++;
+  m_lastReadTime = time;
+  return count;
+}
+
+size_t CountingChannel::available()
+{
+  return m_channel->available();
+}
+
+size_t CountingChannel::write(const void *buffer, size_t len)
+{
+  {
+    INT64 time = now();
+    AutoLock al(&m_lock);
+    if (m_lastReadTime != 0) {
+      m_counters.replyTime += time - m_lastReadTime;
+      m_lastReadTime = 0;
+    }
+  }
+  size_t count = m_channel->write(buffer, len);
+  AutoLock al(&m_lock);
+  m_counters.bytesWritten += count;
+  m_counters.writes++;
+  return count;
+}
+
+void CountingChannel::close() throw(Exception)
+{
+  m_channel->close();
+}
+
+void CountingChannel::getCounters(Counters *counters)
+{
+  AutoLock al(&m_lock);
+  *counters = m_counters;
+}
+
+INT64 CountingChannel::now()
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
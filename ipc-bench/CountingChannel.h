@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __COUNTINGCHANNEL_H__
+#define __COUNTINGCHANNEL_H__
+
+#include "io-lib/Channel.h"
+#include "thread/LocalMutex.h"
+#include "util/inttypes.h"
+
+// Passes the data of another channel through and counts the calls and the
+// bytes in both directions. Every call is one read or write of the pipe
+// under it, so the calls stand for the system calls of the transport.
+class CountingChannel : public Channel
+{
+public:
+  struct Counters
+  {
+    Counters();
+
+    UINT64 bytesRead;
+    UINT64 bytesWritten;
+    UINT64 reads;
+    UINT64 writes;
+    // Sum of the QueryPerformanceCounter() ticks from the end of a read to
+    // the following write, which is the time the side has spent to prepare
+    // its replies.
+    INT64 replyTime;
+  };
+
+  // The channel is not owned.
+  CountingChannel(Channel *channel);
+  virtual ~CountingChannel();
+
+  virtual size_t read(void *buffer, size_t len);
+  virtual size_t available();
+  virtual size_t write(const void *buffer, size_t len);
+  virtual void close() throw(Exception);
+
+  // Can be called by any thread.
+  void getCounters(Counters *counters);
+
+private:
+  static INT64 now();
+
+  Channel *m_channel;
+
+  LocalMutex m_lock;
+  Counters m_counters;
+  // Time of the last read not followed by a write yet, 0 if none.
+  INT64 m_lastReadTime;
+};
+
+#endif // __COUNTINGCHANNEL_H__
@@ -0,0 +1,187 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "IpcPipeline.h"
+#include "thread/AutoLock.h"
+#include "win-system/AnonymousPipeFactory.h"
+
+// The buffer size DesktopServerWatcher creates the pipes with.
+static const unsigned int PIPE_BUFFER_SIZE = 512 * 1024;
+
+IpcPipeline::IpcPipeline(LogWriter *log)
+: m_log(log),
+  m_cliToSrvPipe(0),
+  m_srvFromCliPipe(0),
+  m_srvToCliPipe(0),
+  m_cliFromSrvPipe(0),
+  m_cliToSrvChan(0),
+  m_srvFromCliChan(0),
+  m_srvToCliChan(0),
+  m_cliFromSrvChan(0),
+  m_srvClToSrvGate(0),
+  m_srvSrvToClGate(0),
+  m_srvDispatcher(0),
+  m_updHandlerSrv(0),
+  m_uiSrv(0),
+  m_cliClToSrvGate(0),
+  m_cliSrvToClGate(0),
+  m_cliDispatcher(0),
+  m_updHandlerCli(0),
+  m_uiCli(0),
+  m_failed(false),
+  m_stopping(false)
+{
+  try {
+    AnonymousPipeFactory pipeFactory(PIPE_BUFFER_SIZE, m_log);
+    pipeFactory.generatePipes(&m_cliToSrvPipe, false, &m_srvFromCliPipe, false);
+    pipeFactory.generatePipes(&m_cliFromSrvPipe, false, &m_srvToCliPipe, false);
+
+    m_cliToSrvChan = new CountingChannel(m_cliToSrvPipe);
+    m_srvFromCliChan = new CountingChannel(m_srvFromCliPipe);
+    m_srvToCliChan = new CountingChannel(m_srvToCliPipe);
+    m_cliFromSrvChan = new CountingChannel(m_cliFromSrvPipe);
+
+    // The desktop half must be served before the service half is created,
+    // because the UpdateHandlerClient constructor queries the screen.
+    m_srvClToSrvGate = new BlockingGate(m_srvFromCliChan);
+    m_srvSrvToClGate = new BlockingGate(m_srvToCliChan);
+    m_srvDispatcher = new DesktopSrvDispatcher(m_srvClToSrvGate, this, m_log);
+    m_updHandlerSrv = new UpdateHandlerServer(m_srvSrvToClGate, m_srvDispatcher,
+                                              this, m_log);
+    m_uiSrv = new UserInputServer(m_srvSrvToClGate, m_srvDispatcher, this, m_log);
+    m_srvDispatcher->resume();
+
+    m_cliClToSrvGate = new BlockingGate(m_cliToSrvChan);
+    m_cliSrvToClGate = new BlockingGate(m_cliFromSrvChan);
+    m_cliDispatcher = new DesktopSrvDispatcher(m_cliSrvToClGate, this, m_log);
+    m_updHandlerCli = new UpdateHandlerClient(m_cliClToSrvGate, m_cliDispatcher,
+                                              this, m_log);
+    m_uiCli = new UserInputClient(m_cliClToSrvGate, m_cliDispatcher, this);
+    m_cliDispatcher->resume();
+  } catch (...) {
+    freeResources();
+    throw;
+  }
+}
+
+IpcPipeline::~IpcPipeline()
+{
+  freeResources();
+}
+
+bool IpcPipeline::waitForUpdate(DWORD milliseconds)
+{
+  return WaitForSingleObject(m_updateEvent.getHandle(), milliseconds) ==
+         WAIT_OBJECT_0;
+}
+
+bool IpcPipeline::hasFailed()
+{
+  AutoLock al(&m_stateLock);
+  return m_failed;
+}
+
+void IpcPipeline::getCounters(CountingChannel::Counters *total,
+                              INT64 *desktopReplyTime)
+{
+  CountingChannel *channels[] = {
+    m_cliToSrvChan, m_srvFromCliChan, m_srvToCliChan, m_cliFromSrvChan
+  };
+  *total = CountingChannel::Counters();
+  for (size_t i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+    CountingChannel::Counters counters;
+    channels[i]->getCounters(&counters);
+    total->bytesRead += counters.bytesRead;
+    total->bytesWritten += counters.bytesWritten;
+    total->reads += counters.reads;
+    total->writes += counters.writes;
+    total->replyTime += counters.replyTime;
+    // The requests of the service half are answered through this end.
+    if (channels[i] == m_srvFromCliChan) {
+      *desktopReplyTime = counters.replyTime;
+    }
+  }
+}
+
+void IpcPipeline::onUpdate()
+{
+  m_updateEvent.notify();
+}
+
+void IpcPipeline::onAnObjectEvent()
+{
+  AutoLock al(&m_stateLock);
+  // Closing the pipes breaks the dispatchers, which is not a failure.
+  if (!m_stopping) {
+    m_failed = true;
+    m_log->error(_T("The desktop-ipc link has failed"));
+  }
+  m_updateEvent.notify();
+}
+
+void IpcPipeline::onClipboardUpdate(const StringStorage *newClipboard)
+{
+}
+
+void IpcPipeline::freeResources()
+{
+  {
+    AutoLock al(&m_stateLock);
+    m_stopping = true;
+  }
+  AnonymousPipe *pipes[] = {
+    m_cliToSrvPipe, m_srvFromCliPipe, m_srvToCliPipe, m_cliFromSrvPipe
+  };
+  for (size_t i = 0; i < sizeof(pipes) / sizeof(pipes[0]); i++) {
+    try {
+      if (pipes[i]) pipes[i]->close();
+    } catch (Exception &e) {
+      m_log->error(_T("Cannot close a pipe: %s"), e.getMessage());
+    }
+  }
+
+  // This will stop the dispatchers, so the handlers are not called any more.
+  if (m_cliDispatcher) delete m_cliDispatcher;
+  if (m_srvDispatcher) delete m_srvDispatcher;
+
+  if (m_uiCli) delete m_uiCli;
+  if (m_updHandlerCli) delete m_updHandlerCli;
+  if (m_uiSrv) delete m_uiSrv;
+  if (m_updHandlerSrv) delete m_updHandlerSrv;
+
+  if (m_cliSrvToClGate) delete m_cliSrvToClGate;
+  if (m_cliClToSrvGate) delete m_cliClToSrvGate;
+  if (m_srvSrvToClGate) delete m_srvSrvToClGate;
+  if (m_srvClToSrvGate) delete m_srvClToSrvGate;
+
+  if (m_cliFromSrvChan) delete m_cliFromSrvChan;
+  if (m_srvToCliChan) delete m_srvToCliChan;
+  if (m_srvFromCliChan) delete m_srvFromCliChan;
+  if (m_cliToSrvChan) delete m_cliToSrvChan;
+
+  if (m_cliFromSrvPipe) delete m_cliFromSrvPipe;
+  if (m_srvToCliPipe) delete m_srvToCliPipe;
+  if (m_srvFromCliPipe) delete m_srvFromCliPipe;
+  if (m_cliToSrvPipe) delete m_cliToSrvPipe;
+}
@@ -0,0 +1,112 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __IPCPIPELINE_H__
+#define __IPCPIPELINE_H__
+
+#include "CountingChannel.h"
+
+#include "desktop/UpdateListener.h"
+#include "desktop/ClipboardListener.h"
+#include "util/AnEventListener.h"
+#include "win-system/AnonymousPipe.h"
+#include "win-system/WindowsEvent.h"
+#include "desktop-ipc/BlockingGate.h"
+#include "desktop-ipc/DesktopSrvDispatcher.h"
+#include "desktop-ipc/UpdateHandlerServer.h"
+#include "desktop-ipc/UserInputServer.h"
+#include "desktop-ipc/UpdateHandlerClient.h"
+#include "desktop-ipc/UserInputClient.h"
+#include "log-writer/LogWriter.h"
+
+// Both halves of the desktop-ipc link in one process: the desktop server
+// half as DesktopServerApplication builds it and the service half as
+// DesktopClientImpl does, joined by real anonymous pipes. Every pipe end is
+// counted, so the traffic of the link is measured as it goes through the
+// system.
+class IpcPipeline : public UpdateListener, public AnEventListener,
+                    public ClipboardListener
+{
+public:
+  // The screen driver of the desktop half is chosen by the server
+  // configuration, so it must be set before the construction.
+  // @throw Exception if the pipes cannot be created or the handshake of
+  // the halves fails.
+  IpcPipeline(LogWriter *log);
+  virtual ~IpcPipeline();
+
+  // The service half.
+  UpdateHandler *getUpdateHandler() { return m_updHandlerCli; }
+  UserInput *getUserInput() { return m_uiCli; }
+
+  // Returns true if the desktop half has reported an update within the
+  // time.
+  bool waitForUpdate(DWORD milliseconds);
+
+  bool hasFailed();
+
+  // Sums of the counters of all pipe ends, and the time the desktop half
+  // has spent to prepare its replies, in QueryPerformanceCounter() ticks.
+  void getCounters(CountingChannel::Counters *total, INT64 *desktopReplyTime);
+
+private:
+  virtual void onUpdate();
+  virtual void onAnObjectEvent();
+  virtual void onClipboardUpdate(const StringStorage *newClipboard);
+
+  void freeResources();
+
+  LogWriter *m_log;
+
+  // The pipe ends, the service half ones first.
+  AnonymousPipe *m_cliToSrvPipe;
+  AnonymousPipe *m_srvFromCliPipe;
+  AnonymousPipe *m_srvToCliPipe;
+  AnonymousPipe *m_cliFromSrvPipe;
+  CountingChannel *m_cliToSrvChan;
+  CountingChannel *m_srvFromCliChan;
+  CountingChannel *m_srvToCliChan;
+  CountingChannel *m_cliFromSrvChan;
+
+  // The desktop half.
+  BlockingGate *m_srvClToSrvGate;
+  BlockingGate *m_srvSrvToClGate;
+  DesktopSrvDispatcher *m_srvDispatcher;
+  UpdateHandlerServer *m_updHandlerSrv;
+  UserInputServer *m_uiSrv;
+
+  // The service half.
+  BlockingGate *m_cliClToSrvGate;
+  BlockingGate *m_cliSrvToClGate;
+  DesktopSrvDispatcher *m_cliDispatcher;
+  UpdateHandlerClient *m_updHandlerCli;
+  UserInputClient *m_uiCli;
+
+  WindowsEvent m_updateEvent;
+  LocalMutex m_stateLock;
+  bool m_failed;
+  bool m_stopping;
+};
+
+#endif // __IPCPIPELINE_H__
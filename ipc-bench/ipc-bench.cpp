@@ -0,0 +1,301 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "IpcPipeline.h"
+
+#include "desktop/UpdateContainer.h"
+#include "server-config-lib/Configurator.h"
+#include "util/Exception.h"
+#include "util/LatencyHistogram.h"
+#include "util/StringParser.h"
+
+#include <stdio.h>
+#include <vector>
+
+// How long the desktop half may stay silent before the run is given up,
+// in milliseconds.
+static const DWORD UPDATE_TIMEOUT = 5000;
+
+struct BenchOptions
+{
+  BenchOptions()
+  : workload(_T("mixed")),
+    seed(1),
+    duration(10),
+    sharedFrameBuffer(false),
+    inputEvents(0)
+  {
+  }
+
+  StringStorage workload;
+  UINT32 seed;
+  // Seconds.
+  unsigned int duration;
+  bool sharedFrameBuffer;
+  // Pointer events sent after every update, 0 to send none.
+  unsigned int inputEvents;
+};
+
+// Totals of the measured updates or input batches.
+struct StageTotals
+{
+  StageTotals()
+  : count(0),
+    bytes(0),
+    calls(0)
+  {
+  }
+
+  UINT64 count;
+  UINT64 bytes;
+  UINT64 calls;
+  LatencyHistogram time;
+};
+
+static void printUsage()
+{
+  _ftprintf(stderr,
+    _T("Usage: ipc-bench [options]\n")
+    _T("  -workload <name>      scroll, drag, video, typing, photo or mixed (mixed)\n")
+    _T("  -seed <number>        seed of the workload generator (1)\n")
+    _T("  -duration <seconds>   length of the run (10)\n")
+    _T("  -sharedfb             pass the pixels through the shared frame buffer\n")
+    _T("  -input <count>        pointer events sent after every update (0)\n"));
+}
+
+static bool parseOptions(int argc, TCHAR *argv[], BenchOptions *options)
+{
+  for (int i = 1; i < argc; i++) {
+    const TCHAR *option = argv[i];
+    if (_tcscmp(option, _T("-sharedfb")) == 0) {
+      options->sharedFrameBuffer = true;
+      continue;
+    }
+    // The rest of the options have a value.
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const TCHAR *value = argv[++i];
+    int number = 0;
+    bool isNumber = StringParser::parseInt(value, &number);
+    if (_tcscmp(option, _T("-workload")) == 0) {
+      options->workload.setString(value);
+    } else if (!isNumber) {
+      return false;
+    } else if (_tcscmp(option, _T("-seed")) == 0) {
+      options->seed = (UINT32)number;
+    } else if (_tcscmp(option, _T("-duration")) == 0 && number > 0) {
+      options->duration = (unsigned int)number;
+    } else if (_tcscmp(option, _T("-input")) == 0 && number >= 0) {
+      options->inputEvents = (unsigned int)number;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+static INT64 getCounter()
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
+
+static UINT32 toMicros(INT64 ticks, INT64 frequency)
+{
+  if (ticks <= 0) {
+    return 0;
+  }
+  INT64 micros = ticks * 1000000 / frequency;
+  return micros > 0xffffffff ? 0xffffffff : (UINT32)micros;
+}
+
+static double perItem(UINT64 total, UINT64 count)
+{
+  return count != 0 ? (double)total / (double)count : 0.0;
+}
+
+// Adds the traffic between the two samples to the totals.
+static void addTraffic(StageTotals *totals,
+                       const CountingChannel::Counters *before,
+                       const CountingChannel::Counters *after)
+{
+  // Every byte is written by one end and read by the other, so the written
+  // ones are the traffic of the link.
+  totals->bytes += after->bytesWritten - before->bytesWritten;
+  totals->calls += (after->reads - before->reads) +
+                   (after->writes - before->writes);
+}
+
+static void printStage(const TCHAR *name, const StageTotals *totals)
+{
+  _tprintf(_T("%-10s %8u %12.1f %8.1f %9u %9u\n"), name,
+           (unsigned int)totals->count,
+           perItem(totals->bytes, totals->count) / 1024.0,
+           perItem(totals->calls, totals->count),
+           totals->time.getPercentile(50), totals->time.getPercentile(95));
+}
+
+static void printHistogram(const TCHAR *name, const LatencyHistogram *histogram)
+{
+  _tprintf(_T("%-10s %8u %31s %9u %9u\n"), name, histogram->getCount(), _T(""),
+           histogram->getPercentile(50), histogram->getPercentile(95));
+}
+
+// Sends a batch of pointer events which keep the pointer where it is and
+// waits for the answer of a query behind them.
+static void sendInput(UserInput *userInput, unsigned int eventCount)
+{
+  POINT cursor;
+  if (!GetCursorPos(&cursor)) {
+    cursor.x = cursor.y = 0;
+  }
+  // The desktop half adds the origin of the virtual screen.
+  Point pos(cursor.x - GetSystemMetrics(SM_XVIRTUALSCREEN),
+            cursor.y - GetSystemMetrics(SM_YVIRTUALSCREEN));
+  userInput->beginInputBatch();
+  for (unsigned int i = 0; i < eventCount; i++) {
+    userInput->setMouseEvent(pos, 0);
+  }
+  userInput->endInputBatch();
+  Rect displayRect;
+  userInput->getPrimaryDisplayCoords(&displayRect);
+}
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  BenchOptions options;
+  if (!parseOptions(argc, argv, &options)) {
+    printUsage();
+    return 1;
+  }
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+
+  // The desktop half reads the screen driver settings from here.
+  Configurator configurator(false);
+  ServerConfig *config = configurator.getServerConfig();
+  config->setSyntheticWorkload(options.workload.getString());
+  config->setSyntheticWorkloadSeed(options.seed);
+  config->enableSharedFrameBuffer(options.sharedFrameBuffer);
+
+  LogWriter log(0);
+  int exitCode = 0;
+  try {
+    IpcPipeline pipeline(&log);
+    UpdateHandler *updateHandler = pipeline.getUpdateHandler();
+    updateHandler->setCaptureDemand(true);
+
+    // The first update carries the whole screen, it is not typical.
+    UpdateContainer container;
+    if (!pipeline.waitForUpdate(UPDATE_TIMEOUT) || pipeline.hasFailed()) {
+      throw Exception(_T("The desktop half has not reported any update"));
+    }
+    updateHandler->extract(&container);
+
+    StageTotals updates;
+    StageTotals inputs;
+    LatencyHistogram desktopTime;
+    LatencyHistogram linkTime;
+    LatencyHistogram captureLatency;
+    UINT64 pixels = 0;
+    UINT64 rects = 0;
+
+    CountingChannel::Counters before;
+    INT64 replyBefore = 0;
+    pipeline.getCounters(&before, &replyBefore);
+    DWORD startTime = GetTickCount();
+    DWORD duration = options.duration * 1000;
+    while (GetTickCount() - startTime < duration) {
+      if (!pipeline.waitForUpdate(UPDATE_TIMEOUT)) {
+        throw Exception(_T("The desktop half has stopped reporting updates"));
+      }
+      if (pipeline.hasFailed()) {
+        throw Exception(_T("The desktop-ipc link has failed"));
+      }
+
+      INT64 extractStart = getCounter();
+      updateHandler->extract(&container);
+      INT64 extractEnd = getCounter();
+
+      CountingChannel::Counters after;
+      INT64 replyAfter;
+      pipeline.getCounters(&after, &replyAfter);
+      updates.count++;
+      addTraffic(&updates, &before, &after);
+      updates.time.add(toMicros(extractEnd - extractStart, frequency.QuadPart));
+      INT64 desktopTicks = replyAfter - replyBefore;
+      desktopTime.add(toMicros(desktopTicks, frequency.QuadPart));
+      linkTime.add(toMicros(extractEnd - extractStart - desktopTicks,
+                            frequency.QuadPart));
+      if (container.captureTime != 0) {
+        captureLatency.add(toMicros(extractEnd - container.captureTime,
+                                    frequency.QuadPart));
+      }
+      std::vector<Rect> changedRects;
+      container.changedRegion.getRectVector(&changedRects);
+      pixels += Rect::totalArea(changedRects);
+      rects += changedRects.size();
+      before = after;
+      replyBefore = replyAfter;
+
+      if (options.inputEvents != 0) {
+        INT64 inputStart = getCounter();
+        sendInput(pipeline.getUserInput(), options.inputEvents);
+        INT64 inputEnd = getCounter();
+        pipeline.getCounters(&after, &replyAfter);
+        inputs.count++;
+        addTraffic(&inputs, &before, &after);
+        inputs.time.add(toMicros(inputEnd - inputStart, frequency.QuadPart));
+        before = after;
+        replyBefore = replyAfter;
+      }
+    }
+    DWORD elapsed = GetTickCount() - startTime;
+
+    _tprintf(_T("workload %s, seed %u, shared frame buffer %s, %.1f s\n"),
+             options.workload.getString(), (unsigned int)options.seed,
+             config->isSharedFrameBufferEnabled() ? _T("on") : _T("off"),
+             (double)elapsed / 1000.0);
+    _tprintf(_T("%.1f updates/s, %.1f rects and %.1f Kpixels per update\n\n"),
+             elapsed != 0 ? (double)updates.count * 1000.0 / (double)elapsed : 0.0,
+             perItem(rects, updates.count),
+             perItem(pixels, updates.count) / 1000.0);
+    _tprintf(_T("%-10s %8s %12s %8s %9s %9s\n"), _T("stage"), _T("count"),
+             _T("KB/item"), _T("calls"), _T("p50_us"), _T("p95_us"));
+    printStage(_T("extract"), &updates);
+    printHistogram(_T(" desktop"), &desktopTime);
+    printHistogram(_T(" link"), &linkTime);
+    printHistogram(_T("capture"), &captureLatency);
+    if (options.inputEvents != 0) {
+      printStage(_T("input"), &inputs);
+    }
+  } catch (Exception &e) {
+    _ftprintf(stderr, _T("Error: %s\n"), e.getMessage());
+    exitCode = 1;
+  }
+  return exitCode;
+}
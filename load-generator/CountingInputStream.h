@@ -1,4 +1,4 @@
-// Copyright (C) 2010,2011,2012 GlavSoft LLC.
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
 // All rights reserved.
 //
 //-------------------------------------------------------------------------
@@ -22,44 +22,31 @@
 //-------------------------------------------------------------------------
 //
 
-#ifndef __PROFILELOGGER_H__
-#define __PROFILELOGGER_H__
+#ifndef __COUNTINGINPUTSTREAM_H__
+#define __COUNTINGINPUTSTREAM_H__
 
-#include "util/DateTime.h"
-#include <vector>
-#include <map>
+#include "io-lib/InputStream.h"
 #include "thread/LocalMutex.h"
 
-
-struct ProcessorTimes {
-  double process;
-  double kernel;
-  ULONG64 cycle;
-  DateTime wall;
-};
-
-// lass for acquiring processor load metrics.
-class ProfileLogger
+// Passes the data of another stream through and counts the bytes read from
+// it, so that the traffic of a connection is measured under the buffering.
+class CountingInputStream : public InputStream
 {
 public:
-  ProfileLogger(double rate = 5.)
-  : m_dropRate(rate) 
-  {
-    m_lastDrop = DateTime::now();
-  };
+  CountingInputStream(InputStream *input);
+  virtual ~CountingInputStream();
+
+  virtual size_t read(void *buffer, size_t len);
+  virtual size_t available();
 
-  ~ProfileLogger();
-  // returns cycles and times deltas from previouse checkpoint
-  ProcessorTimes checkPoint(const TCHAR *tag);
-  std::vector<std::vector<TCHAR>> dropStat();
+  // Can be called by any thread.
+  UINT64 getBytesRead();
 
 private:
-  LocalMutex m_mapMut;
-  std::map<const TCHAR *, std::vector<ProcessorTimes>> m_checkPoints;
-  ProcessorTimes m_last;
-  double m_dropRate; // time interval in seconds to log statistics
-  DateTime m_lastDrop;
+  InputStream *m_input;
 
+  LocalMutex m_lock;
+  UINT64 m_bytesRead;
 };
 
-#endif // __PROFILELOGGER_H__
+#endif // __COUNTINGINPUTSTREAM_H__
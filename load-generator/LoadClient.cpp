@@ -0,0 +1,202 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LoadClient.h"
+
+#include "network/socket/SocketAddressIPv4.h"
+#include "network/socket/SocketProfile.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "thread/AutoLock.h"
+
+LoadClientConfig::LoadClientConfig()
+: port(5900),
+  preferredEncoding(EncodingDefs::TIGHT),
+  jpegQualityLevel(6),
+  compressionLevel(-1),
+  bitsPerPixel(32),
+  requestInterval(0),
+  requestPipeline(1),
+  skipDrawing(false)
+{
+}
+
+LoadClient::LoadClient(unsigned int id, const LoadClientConfig *config)
+: m_id(id),
+  m_config(config),
+  m_authHandler(config->password.getString()),
+  m_socketStream(&m_socket),
+  m_countingInput(&m_socketStream),
+  m_bufInput(&m_countingInput),
+  m_input(&m_bufInput),
+  m_output(&m_socketStream),
+  m_isConnected(false),
+  m_hasFailed(false)
+{
+}
+
+LoadClient::~LoadClient()
+{
+  try {
+    stop();
+  } catch (...) {
+  }
+}
+
+void LoadClient::start()
+{
+  try {
+    SocketAddressIPv4 address(m_config->host.getString(), m_config->port);
+    m_socket.connect(address);
+  } catch (Exception &e) {
+    setFailed(e.getMessage());
+    throw;
+  }
+  SocketProfile socketProfile;
+  try {
+    socketProfile.apply(&m_socket);
+  } catch (SocketException &) {
+    // The defaults of the system are good enough for the load.
+  }
+
+  m_authHandler.addAuthCapability(&m_core);
+  m_core.setPreferredEncoding(m_config->preferredEncoding);
+  m_core.setJpegQualityLevel(m_config->jpegQualityLevel);
+  m_core.setCompressionLevel(m_config->compressionLevel);
+  PixelFormat pixelFormat;
+  switch (m_config->bitsPerPixel) {
+  case 8:
+    pixelFormat = StandardPixelFormatFactory::create8bppPixelFormat();
+    break;
+  case 16:
+    pixelFormat = StandardPixelFormatFactory::create16bppPixelFormat();
+    break;
+  default:
+    pixelFormat = StandardPixelFormatFactory::create32bppPixelFormat();
+    break;
+  }
+  m_core.setPixelFormat(&pixelFormat);
+  if (m_config->requestInterval > 0) {
+    m_core.deferUpdateRequests(m_config->requestInterval);
+  }
+  m_core.setUpdateRequestPipeline(m_config->requestPipeline);
+  m_core.skipDrawing(m_config->skipDrawing);
+
+  m_core.start(&m_input, &m_output, this, true);
+}
+
+void LoadClient::stop()
+{
+  if (!m_core.wasStarted()) {
+    return;
+  }
+  m_core.stop();
+  // The core does not close a connection it has not made, the input thread
+  // is waiting for the data until then.
+  try {
+    m_socket.shutdown(SD_BOTH);
+  } catch (...) {
+  }
+  m_core.waitTermination();
+  try {
+    m_socket.close();
+  } catch (...) {
+  }
+}
+
+void LoadClient::present()
+{
+  m_core.onFramePresented();
+}
+
+unsigned int LoadClient::getId() const
+{
+  return m_id;
+}
+
+bool LoadClient::isConnected()
+{
+  AutoLock al(&m_stateLock);
+  return m_isConnected;
+}
+
+bool LoadClient::hasFailed(StringStorage *error)
+{
+  AutoLock al(&m_stateLock);
+  if (m_hasFailed) {
+    *error = m_error;
+  }
+  return m_hasFailed;
+}
+
+UINT32 LoadClient::getFbUpdates() const
+{
+  return m_core.getFbUpdatesReceived();
+}
+
+UINT64 LoadClient::getBytesReceived()
+{
+  return m_countingInput.getBytesRead();
+}
+
+UINT32 LoadClient::getLatencyReports() const
+{
+  return m_core.getLatencyReports();
+}
+
+UINT32 LoadClient::getStageLatency(int stage, unsigned int percent) const
+{
+  return m_core.getStageLatency(stage, percent);
+}
+
+void LoadClient::onConnected(RfbOutputGate *output)
+{
+  AutoLock al(&m_stateLock);
+  m_isConnected = true;
+}
+
+void LoadClient::onDisconnect(const StringStorage *message)
+{
+  setFailed(message->getString());
+}
+
+void LoadClient::onError(const Exception *exception)
+{
+  setFailed(exception->getMessage());
+}
+
+void LoadClient::onFrameBufferUpdates(const FrameBuffer *fb,
+                                      const std::vector<Rect> *updates)
+{
+}
+
+void LoadClient::setFailed(const TCHAR *error)
+{
+  AutoLock al(&m_stateLock);
+  if (!m_hasFailed) {
+    m_hasFailed = true;
+    m_error.setString(error);
+  }
+  m_isConnected = false;
+}
@@ -0,0 +1,129 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __LOADCLIENT_H__
+#define __LOADCLIENT_H__
+
+#include "CountingInputStream.h"
+#include "LoadAuthHandler.h"
+
+#include "io-lib/BufferedInputStream.h"
+#include "network/RfbInputGate.h"
+#include "network/RfbOutputGate.h"
+#include "network/socket/SocketIPv4.h"
+#include "network/socket/SocketStream.h"
+#include "thread/LocalMutex.h"
+#include "viewer-core/CoreEventsAdapter.h"
+#include "viewer-core/RemoteViewerCore.h"
+
+// Settings shared by all the simulated viewers.
+struct LoadClientConfig
+{
+  LoadClientConfig();
+
+  StringStorage host;
+  UINT16 port;
+  StringStorage password;
+  INT32 preferredEncoding;
+  // -1 disables JPEG and lets the server choose the compression level
+  // respectively, see RemoteViewerCore.
+  int jpegQualityLevel;
+  int compressionLevel;
+  // 32, 16 or 8.
+  int bitsPerPixel;
+  // Minimal interval between update requests in milliseconds, 0 requests
+  // the next update as soon as one is received.
+  int requestInterval;
+  // Number of update requests kept in flight.
+  int requestPipeline;
+  // Read the updates without decompressing pictures and copying them to
+  // the frame buffer.
+  bool skipDrawing;
+};
+
+// One simulated viewer: a RemoteViewerCore with no window, on a connection
+// of its own whose incoming traffic is counted.
+class LoadClient : public CoreEventsAdapter
+{
+public:
+  LoadClient(unsigned int id, const LoadClientConfig *config);
+  virtual ~LoadClient();
+
+  // Connects to the server and starts the protocol. Throws Exception if the
+  // server can't be reached, the protocol errors are reported by
+  // hasFailed() later.
+  void start();
+  // Closes the connection and waits for the threads of the core.
+  void stop();
+
+  // Tells the core that the updates passed to the client so far are on the
+  // screen. A headless viewer has no paint to wait for, so the generator
+  // calls it periodically; the present stage of the latency includes the
+  // period.
+  void present();
+
+  unsigned int getId() const;
+  // True from the end of the protocol initialization until the connection
+  // is lost.
+  bool isConnected();
+  // Returns true and the reason if the connection has been lost.
+  bool hasFailed(StringStorage *error);
+
+  UINT32 getFbUpdates() const;
+  UINT64 getBytesReceived();
+  UINT32 getLatencyReports() const;
+  UINT32 getStageLatency(int stage, unsigned int percent) const;
+
+protected:
+  virtual void onConnected(RfbOutputGate *output);
+  virtual void onDisconnect(const StringStorage *message);
+  virtual void onError(const Exception *exception);
+  // Overridden to take the updates at once instead of every rectangle.
+  virtual void onFrameBufferUpdates(const FrameBuffer *fb,
+                                    const std::vector<Rect> *updates);
+
+private:
+  void setFailed(const TCHAR *error);
+
+  unsigned int m_id;
+  const LoadClientConfig *m_config;
+  LoadAuthHandler m_authHandler;
+
+  // The streams are declared in the order of the stack so that the core
+  // stops before any of them is destroyed.
+  SocketIPv4 m_socket;
+  SocketStream m_socketStream;
+  CountingInputStream m_countingInput;
+  BufferedInputStream m_bufInput;
+  RfbInputGate m_input;
+  RfbOutputGate m_output;
+  RemoteViewerCore m_core;
+
+  LocalMutex m_stateLock;
+  bool m_isConnected;
+  bool m_hasFailed;
+  StringStorage m_error;
+};
+
+#endif // __LOADCLIENT_H__
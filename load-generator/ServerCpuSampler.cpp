@@ -0,0 +1,67 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ServerCpuSampler.h"
+
+#include "tvncontrol-app/ControlPipeName.h"
+#include "tvncontrol-app/TransportFactory.h"
+
+ServerCpuSampler::ServerCpuSampler(bool forService, const TCHAR *passwordFile)
+: m_log(0),
+  m_transport(0),
+  m_gate(0),
+  m_proxy(0)
+{
+  StringStorage pipeName;
+  ControlPipeName::createPipeName(forService, &pipeName, &m_log);
+  m_transport = TransportFactory::createPipeClientTransport(pipeName.getString());
+  m_gate = new ControlGate(m_transport->getIOStream());
+  m_proxy = new ControlProxy(m_gate);
+  m_proxy->setPasswordProperties(passwordFile, true, forService);
+}
+
+ServerCpuSampler::~ServerCpuSampler()
+{
+  delete m_proxy;
+  delete m_gate;
+  delete m_transport;
+}
+
+UINT64 ServerCpuSampler::getCpuTime(size_t *clientCount)
+{
+  CaptureStatistics capture;
+  RfbClientStatisticsList clients;
+  UINT64 processMemory;
+  UINT32 processId;
+  UINT64 processCpuTime;
+  MemoryStatisticsList memory;
+  bool hasCapture = m_proxy->getStatistics(&capture, &clients,
+                                           &processMemory, &processId,
+                                           &processCpuTime, &memory);
+  *clientCount = clients.size();
+  if (hasCapture && capture.processId != processId) {
+    processCpuTime += capture.processCpuTime;
+  }
+  return processCpuTime;
+}
@@ -0,0 +1,58 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SERVERCPUSAMPLER_H__
+#define __SERVERCPUSAMPLER_H__
+
+#include "log-writer/LogWriter.h"
+#include "tvncontrol-app/ControlGate.h"
+#include "tvncontrol-app/ControlProxy.h"
+#include "tvncontrol-app/Transport.h"
+
+// Reads the CPU time of the server under load through its control
+// interface, like "tvnserver -controlapp -stats" does. The screen may be
+// captured by a desktop server helper process, its time is added then.
+class ServerCpuSampler
+{
+public:
+  // Connects to the control interface of the server running as a service
+  // or as an application on this machine. The control password, if any, is
+  // read from the password file or from the configuration of the server.
+  // Throws Exception on failure.
+  ServerCpuSampler(bool forService, const TCHAR *passwordFile);
+  virtual ~ServerCpuSampler();
+
+  // Returns the CPU time, user and kernel, consumed by the processes of the
+  // server in microseconds, and the number of its clients. Throws Exception
+  // on failure.
+  UINT64 getCpuTime(size_t *clientCount);
+
+private:
+  LogWriter m_log;
+  Transport *m_transport;
+  ControlGate *m_gate;
+  ControlProxy *m_proxy;
+};
+
+#endif // __SERVERCPUSAMPLER_H__
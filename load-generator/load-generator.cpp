@@ -0,0 +1,346 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LoadClient.h"
+#include "ServerCpuSampler.h"
+
+#include "network/socket/WindowsSocket.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/MsgDefs.h"
+#include "util/Exception.h"
+#include "util/StringParser.h"
+
+#include <stdio.h>
+#include <vector>
+
+// How often the clients are told that their updates are presented, in
+// milliseconds.
+static const DWORD PRESENT_INTERVAL = 2;
+
+static const TCHAR *const STAGE_NAMES[LatencyProbeDefs::STAGE_COUNT] = {
+  _T("cap"), _T("enc"), _T("net"), _T("dec"), _T("pres")
+};
+
+struct LoadOptions
+{
+  LoadOptions()
+  : clientCount(50),
+    duration(60),
+    reportInterval(5),
+    connectDelay(20),
+    sampleServerCpu(false),
+    controlService(false)
+  {
+  }
+
+  LoadClientConfig client;
+  unsigned int clientCount;
+  // Seconds.
+  unsigned int duration;
+  unsigned int reportInterval;
+  // Milliseconds between the connections, so that the server is not hit by
+  // all the handshakes at once.
+  unsigned int connectDelay;
+  bool sampleServerCpu;
+  bool controlService;
+  StringStorage controlPasswordFile;
+};
+
+// Counters of a client at the previous report.
+struct ClientSample
+{
+  ClientSample()
+  : updates(0),
+    bytes(0)
+  {
+  }
+
+  UINT32 updates;
+  UINT64 bytes;
+};
+
+static void printUsage()
+{
+  _ftprintf(stderr,
+    _T("Usage: load-generator <host> [options]\n")
+    _T("  -port <port>          server port (5900)\n")
+    _T("  -password <password>  VNC password\n")
+    _T("  -clients <count>      number of simulated viewers (50)\n")
+    _T("  -encoding <name>      tight, zrle, hextile, rre or raw (tight)\n")
+    _T("  -jpeg <level>         JPEG quality 0..9, -1 for lossless (6)\n")
+    _T("  -compression <level>  compression level 0..9, -1 for default (-1)\n")
+    _T("  -bpp <bits>           pixel format: 32, 16 or 8 (32)\n")
+    _T("  -interval <ms>        minimal interval between update requests (0)\n")
+    _T("  -pipeline <depth>     update requests kept in flight (1)\n")
+    _T("  -skipdecode           consume updates without drawing them\n")
+    _T("  -duration <seconds>   length of the run (60)\n")
+    _T("  -report <seconds>     interval of the progress lines (5)\n")
+    _T("  -connectdelay <ms>    delay between the connections (20)\n")
+    _T("  -controlservice       sample server CPU of the service\n")
+    _T("  -controlapp           sample server CPU of the application\n")
+    _T("  -passfile <file>      control password file for the sampling\n"));
+}
+
+static bool parseEncoding(const TCHAR *name, INT32 *encoding)
+{
+  static const struct {
+    const TCHAR *name;
+    INT32 code;
+  } encodings[] = {
+    { _T("tight"), EncodingDefs::TIGHT },
+    { _T("zrle"), EncodingDefs::ZRLE },
+    { _T("hextile"), EncodingDefs::HEXTILE },
+    { _T("rre"), EncodingDefs::RRE },
+    { _T("raw"), EncodingDefs::RAW }
+  };
+  for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); i++) {
+    if (_tcsicmp(name, encodings[i].name) == 0) {
+      *encoding = encodings[i].code;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parseOptions(int argc, TCHAR *argv[], LoadOptions *options)
+{
+  if (argc < 2 || argv[1][0] == _T('-')) {
+    return false;
+  }
+  options->client.host.setString(argv[1]);
+  for (int i = 2; i < argc; i++) {
+    const TCHAR *option = argv[i];
+    if (_tcscmp(option, _T("-skipdecode")) == 0) {
+      options->client.skipDrawing = true;
+      continue;
+    }
+    if (_tcscmp(option, _T("-controlservice")) == 0 ||
+        _tcscmp(option, _T("-controlapp")) == 0) {
+      options->sampleServerCpu = true;
+      options->controlService = _tcscmp(option, _T("-controlservice")) == 0;
+      continue;
+    }
+    // The rest of the options have a value.
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const TCHAR *value = argv[++i];
+    int number = 0;
+    bool isNumber = StringParser::parseInt(value, &number);
+    if (_tcscmp(option, _T("-password")) == 0) {
+      options->client.password.setString(value);
+    } else if (_tcscmp(option, _T("-passfile")) == 0) {
+      options->controlPasswordFile.setString(value);
+    } else if (_tcscmp(option, _T("-encoding")) == 0) {
+      if (!parseEncoding(value, &options->client.preferredEncoding)) {
+        return false;
+      }
+    } else if (!isNumber) {
+      return false;
+    } else if (_tcscmp(option, _T("-port")) == 0 &&
+               number > 0 && number <= 65535) {
+      options->client.port = (UINT16)number;
+    } else if (_tcscmp(option, _T("-clients")) == 0 && number > 0) {
+      options->clientCount = (unsigned int)number;
+    } else if (_tcscmp(option, _T("-jpeg")) == 0 &&
+               number >= -1 && number <= 9) {
+      options->client.jpegQualityLevel = number;
+    } else if (_tcscmp(option, _T("-compression")) == 0 &&
+               number >= -1 && number <= 9) {
+      options->client.compressionLevel = number;
+    } else if (_tcscmp(option, _T("-bpp")) == 0 &&
+               (number == 32 || number == 16 || number == 8)) {
+      options->client.bitsPerPixel = number;
+    } else if (_tcscmp(option, _T("-interval")) == 0 && number >= 0) {
+      options->client.requestInterval = number;
+    } else if (_tcscmp(option, _T("-pipeline")) == 0 && number > 0) {
+      options->client.requestPipeline = number;
+    } else if (_tcscmp(option, _T("-duration")) == 0 && number > 0) {
+      options->duration = (unsigned int)number;
+    } else if (_tcscmp(option, _T("-report")) == 0 && number > 0) {
+      options->reportInterval = (unsigned int)number;
+    } else if (_tcscmp(option, _T("-connectdelay")) == 0 && number >= 0) {
+      options->connectDelay = (unsigned int)number;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+static double perSecond(UINT64 count, DWORD milliseconds)
+{
+  return milliseconds != 0 ? (double)count * 1000.0 / (double)milliseconds : 0.0;
+}
+
+// Prints the totals of the clients since the previous report and the share
+// of one processor the server has used meanwhile.
+static void printProgress(std::vector<LoadClient *> *clients,
+                          std::vector<ClientSample> *samples,
+                          DWORD elapsed, DWORD interval,
+                          ServerCpuSampler *sampler, UINT64 *serverCpuTime)
+{
+  unsigned int connected = 0;
+  UINT64 updates = 0;
+  UINT64 bytes = 0;
+  for (size_t i = 0; i < clients->size(); i++) {
+    LoadClient *client = (*clients)[i];
+    ClientSample *sample = &(*samples)[i];
+    if (client->isConnected()) {
+      connected++;
+    }
+    UINT32 clientUpdates = client->getFbUpdates();
+    UINT64 clientBytes = client->getBytesReceived();
+    updates += clientUpdates - sample->updates;
+    bytes += clientBytes - sample->bytes;
+    sample->updates = clientUpdates;
+    sample->bytes = clientBytes;
+  }
+
+  StringStorage serverCpu(_T("-"));
+  if (sampler != 0) {
+    try {
+      size_t serverClients;
+      UINT64 cpuTime = sampler->getCpuTime(&serverClients);
+      // The helper process may have been restarted meanwhile.
+      UINT64 used = cpuTime > *serverCpuTime ? cpuTime - *serverCpuTime : 0;
+      serverCpu.format(_T("%.1f%% (%u)"),
+                       perSecond(used, interval) / 10000.0,
+                       (unsigned int)serverClients);
+      *serverCpuTime = cpuTime;
+    } catch (Exception &e) {
+      serverCpu.format(_T("error: %s"), e.getMessage());
+    }
+  }
+  _tprintf(_T("%7.1f %9u %10.1f %12.1f  %s\n"),
+           (double)elapsed / 1000.0, connected,
+           perSecond(updates, interval),
+           perSecond(bytes, interval) / 1024.0,
+           serverCpu.getString());
+}
+
+// Prints the averages of every client over the whole run and the median
+// and 95th percentile of the latency stages, in microseconds.
+static void printSummary(std::vector<LoadClient *> *clients, DWORD elapsed)
+{
+  _tprintf(_T("\n%5s %8s %10s %8s"), _T("id"), _T("fps"), _T("KB/s"),
+           _T("probes"));
+  for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+    _tprintf(_T(" %13s"), STAGE_NAMES[stage]);
+  }
+  _tprintf(_T("  %s\n"), _T("state"));
+
+  for (size_t i = 0; i < clients->size(); i++) {
+    LoadClient *client = (*clients)[i];
+    _tprintf(_T("%5u %8.1f %10.1f %8u"), client->getId(),
+             perSecond(client->getFbUpdates(), elapsed),
+             perSecond(client->getBytesReceived(), elapsed) / 1024.0,
+             client->getLatencyReports());
+    for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+      _tprintf(_T(" %6u/%6u"), client->getStageLatency(stage, 50),
+               client->getStageLatency(stage, 95));
+    }
+    StringStorage error;
+    if (client->hasFailed(&error)) {
+      _tprintf(_T("  failed: %s\n"), error.getString());
+    } else {
+      _tprintf(_T("  %s\n"), client->isConnected() ? _T("connected")
+                                                   : _T("connecting"));
+    }
+  }
+}
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  LoadOptions options;
+  if (!parseOptions(argc, argv, &options)) {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<LoadClient *> clients;
+  ServerCpuSampler *sampler = 0;
+  int exitCode = 0;
+  timeBeginPeriod(1);
+  try {
+    WindowsSocket::startup(2, 1);
+    if (options.sampleServerCpu) {
+      sampler = new ServerCpuSampler(options.controlService,
+                                     options.controlPasswordFile.getString());
+    }
+
+    _tprintf(_T("%7s %9s %10s %12s  %s\n"), _T("time_s"), _T("connected"),
+             _T("updates/s"), _T("KB/s"), _T("server cpu (clients)"));
+    UINT64 serverCpuTime = 0;
+    if (sampler != 0) {
+      size_t serverClients;
+      serverCpuTime = sampler->getCpuTime(&serverClients);
+    }
+    std::vector<ClientSample> samples;
+    DWORD startTime = GetTickCount();
+    DWORD lastConnect = startTime;
+    DWORD lastReport = startTime;
+    DWORD duration = options.duration * 1000;
+    DWORD now = startTime;
+    while (now - startTime < duration) {
+      if (clients.size() < options.clientCount &&
+          (clients.empty() || now - lastConnect >= options.connectDelay)) {
+        LoadClient *client = new LoadClient((unsigned int)clients.size() + 1,
+                                            &options.client);
+        clients.push_back(client);
+        samples.push_back(ClientSample());
+        try {
+          client->start();
+        } catch (Exception &e) {
+          _ftprintf(stderr, _T("Client %u cannot connect: %s\n"),
+                    client->getId(), e.getMessage());
+        }
+        lastConnect = now;
+      }
+
+      for (size_t i = 0; i < clients.size(); i++) {
+        clients[i]->present();
+      }
+
+      if (now - lastReport >= options.reportInterval * 1000) {
+        printProgress(&clients, &samples, now - startTime, now - lastReport,
+                      sampler, &serverCpuTime);
+        lastReport = now;
+      }
+      Sleep(PRESENT_INTERVAL);
+      now = GetTickCount();
+    }
+    printSummary(&clients, now - startTime);
+  } catch (Exception &e) {
+    _ftprintf(stderr, _T("Error: %s\n"), e.getMessage());
+    exitCode = 1;
+  }
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    delete clients[i];
+  }
+  delete sampler;
+  timeEndPeriod(1);
+  return exitCode;
+}
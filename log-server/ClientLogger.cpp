@@ -33,6 +33,7 @@ ClientLogger::ClientLogger(const TCHAR *publicPipeName, const TCHAR *logFileName
   m_levListenChan(0),
   m_logInput(0),
   m_logOutput(0),
+  m_logRing(0),
   m_logBarrier(0),
   m_logFileName(logFileName),
   m_publicPipeName(publicPipeName)
@@ -51,6 +52,14 @@ void ClientLogger::freeResources()
   wait();
   if (m_levListenChan != 0) delete m_levListenChan;
 
+  {
+    AutoLock al(&m_logWritingMut);
+    if (m_logRing != 0) {
+      m_logRing->close();
+      delete m_logRing;
+      m_logRing = 0;
+    }
+  }
   if (m_logOutput != 0) delete m_logOutput;
   if (m_logInput != 0) delete m_logInput;
   if (m_logSendingChan != 0) delete m_logSendingChan;
@@ -74,6 +83,7 @@ void ClientLogger::connect()
     m_levListenChan = secLevelPipeClient.getChannel();
 
     m_logOutput->writeUTF8(m_logFileName.getString());
+    acceptLogRing();
 
     // Get log level by the m_levListenChan channel.
     DataInputStream m_levInput(m_levListenChan);
@@ -107,6 +117,22 @@ void ClientLogger::connect()
   resume();
 }
 
+void ClientLogger::acceptLogRing()
+{
+  m_logOutput->writeUInt32(GetCurrentProcessId());
+  if (m_logInput->readUInt8() == 0) {
+    return;
+  }
+  HANDLE memory = (HANDLE)m_logInput->readUInt64();
+  HANDLE event = (HANDLE)m_logInput->readUInt64();
+  try {
+    m_logRing = new LogRing(memory, event);
+  } catch (Exception &) {
+    CloseHandle(event);
+  }
+  m_logOutput->writeUInt8(m_logRing != 0 ? 1 : 0);
+}
+
 void ClientLogger::print(int logLevel, const TCHAR *line)
 {
   UINT32 processId = GetCurrentProcessId();
@@ -131,7 +157,10 @@ void ClientLogger::flush(unsigned int processId,
   AutoLock al(&m_logWritingMut);
 
   if (level <= getLogBarrier()) {
-    if (m_logOutput != 0) {
+    if (m_logRing != 0) {
+      // A record that doesn't fit is dropped and counted by the ring.
+      m_logRing->write(processId, threadId, dt->getTime(), level, message);
+    } else if (m_logOutput != 0) {
       try {
         m_logOutput->writeUInt32(processId);
         m_logOutput->writeUInt32(threadId);
@@ -33,6 +33,7 @@
 #include "log-writer/Logger.h"
 #include "thread/AutoLock.h"
 #include "log-writer/LogDump.h"
+#include "LogRing.h"
 
 class ClientLogger : public Logger, private Thread, public LogDump
 {
@@ -64,6 +65,9 @@ private:
 
   void freeResources();
 
+  // Accepts the log ring offered by the server, if any.
+  void acceptLogRing();
+
   virtual void execute();
 
   int getLogBarrier();
@@ -73,6 +77,9 @@ private:
   DataInputStream *m_logInput;
   DataOutputStream *m_logOutput;
   LocalMutex m_logWritingMut;
+  // If the server has given a log ring the records are written to it
+  // instead of the channel.
+  LogRing *m_logRing;
 
   Channel *m_levListenChan;
 
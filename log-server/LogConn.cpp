@@ -29,6 +29,12 @@
 #include "io-lib/DataInputStream.h"
 #include "io-lib/DataOutputStream.h"
 #include "util/DateTime.h"
+#include "win-system/WinHandles.h"
+
+// Size of the log ring data, about several thousands of usual log lines.
+static const size_t LOG_RING_SIZE = 1024 * 1024;
+// Level of the line telling that the records have been dropped.
+static const UINT8 DROPPED_RECORDS_LEVEL = 2;
 
 LogConn::LogConn(Channel *channel, LogConnAuthListener *extAuthListener,
                  LogListener *extLogListener, unsigned char logLevel)
@@ -38,7 +44,10 @@ LogConn::LogConn(Channel *channel, LogConnAuthListener *extAuthListener,
   m_logListenChannel(0),
   m_levelSendChannel(0),
   m_handle(0),
-  m_logLevel(logLevel)
+  m_logLevel(logLevel),
+  m_logRing(0),
+  m_clientProcess(0),
+  m_clientProcessId(0)
 {
   // Main work must be in other thread to return control to a LogConn caller
   resume();
@@ -54,6 +63,8 @@ LogConn::~LogConn()
   if (m_serviceChannel != 0) delete m_serviceChannel;
   if (m_logListenChannel != 0) delete m_logListenChannel;
   if (m_levelSendChannel != 0) delete m_levelSendChannel;
+  if (m_logRing != 0) delete m_logRing;
+  if (m_clientProcess != 0) CloseHandle(m_clientProcess);
 }
 
 void LogConn::onTerminate()
@@ -65,6 +76,7 @@ void LogConn::onTerminate()
       if (m_levelSendChannel != 0) m_levelSendChannel->close();
     } catch (...) {
     }
+    if (m_logRing != 0) m_logRing->wakeUp();
   }
   // If m_logListenChannel or m_levelSendChannel assigning will happen
   // after then initialization phase still is running and the channels
@@ -109,6 +121,50 @@ void LogConn::assignConnection()
   }
 }
 
+void LogConn::offerLogRing(DataInputStream *input, DataOutputStream *output)
+{
+  m_clientProcessId = input->readUInt32();
+
+  LogRing *logRing = 0;
+  HANDLE clientProcess = 0;
+  HANDLE memory = 0;
+  HANDLE event = 0;
+  try {
+    clientProcess = OpenProcess(SYNCHRONIZE | PROCESS_DUP_HANDLE, FALSE,
+                                m_clientProcessId);
+    if (clientProcess == 0) {
+      throw Exception(_T("Cannot open the client process"));
+    }
+    logRing = new LogRing(LOG_RING_SIZE);
+    memory = WinHandles::assignHandleFor(logRing->getMemoryHandle(),
+                                         clientProcess, false, false);
+    event = WinHandles::assignHandleFor(logRing->getEventHandle(),
+                                        clientProcess, false, false);
+  } catch (Exception &) {
+    // The pipe is still good for the records.
+    if (logRing != 0) delete logRing;
+    if (clientProcess != 0) CloseHandle(clientProcess);
+    output->writeUInt8(0);
+    return;
+  }
+
+  try {
+    output->writeUInt8(1);
+    output->writeUInt64((UINT64)memory);
+    output->writeUInt64((UINT64)event);
+    if (input->readUInt8() == 0) {
+      throw Exception(_T("The client has not accepted the log ring"));
+    }
+  } catch (Exception &) {
+    delete logRing;
+    CloseHandle(clientProcess);
+    throw;
+  }
+  AutoLock al(&m_channelMutex);
+  m_logRing = logRing;
+  m_clientProcess = clientProcess;
+}
+
 void LogConn::dispatch()
 {
   DataInputStream input(m_logListenChannel);
@@ -128,18 +184,55 @@ void LogConn::dispatch()
   }
 }
 
+void LogConn::dispatchLogRing()
+{
+  StringStorage logMess;
+  bool clientExited = false;
+  while (!isTerminating()) {
+    UINT32 processId, threadId;
+    UINT64 time;
+    UINT8 level;
+    while (m_logRing->read(&processId, &threadId, &time, &level, &logMess)) {
+      DateTime dt(time);
+      m_extLogListener->onLog(m_handle, processId, threadId, &dt,
+                              level, logMess.getString());
+    }
+    UINT32 droppedCount = m_logRing->takeDroppedCount();
+    if (droppedCount != 0) {
+      DateTime now = DateTime::now();
+      logMess.format(_T("%u log records have been dropped because")
+                     _T(" the log server could not keep up"), droppedCount);
+      m_extLogListener->onLog(m_handle, m_clientProcessId, 0, &now,
+                              DROPPED_RECORDS_LEVEL, logMess.getString());
+    }
+    // The records written before the exit have just been read.
+    if (clientExited || m_logRing->isClosed()) {
+      break;
+    }
+    if (!m_logRing->prepareToWait()) {
+      continue;
+    }
+    HANDLE objects[] = { m_logRing->getEventHandle(), m_clientProcess };
+    if (WaitForMultipleObjects(2, objects, FALSE, INFINITE) != WAIT_OBJECT_0) {
+      clientExited = true;
+    }
+  }
+}
+
 void LogConn::execute()
 {
   try {
     assignConnection();
     // In success go to normal phase
     DataInputStream input(m_logListenChannel);
+    DataOutputStream output(m_logListenChannel);
 
     StringStorage fileName;
     input.readUTF8(&fileName);
     m_handle = m_extAuthListener->onLogConnAuth(this,
                                                 true,
                                                 fileName.getString());
+    offerLogRing(&input, &output);
 
     m_logLevelSender.startSender(m_levelSendChannel);
     // Send first log level value
@@ -148,7 +241,11 @@ void LogConn::execute()
       m_logLevelSender.updateLevel(m_logLevel);
     }
 
-    dispatch();
+    if (m_logRing != 0) {
+      dispatchLogRing();
+    } else {
+      dispatch();
+    }
   } catch (Exception &e) {
     StringStorage errMess;
     errMess.format(_T("The log connection has failed: %s"), e.getMessage());
@@ -30,6 +30,9 @@
 #include "win-system/Pipe.h"
 #include "LogListener.h"
 #include "LogLevelSender.h"
+#include "LogRing.h"
+#include "io-lib/DataInputStream.h"
+#include "io-lib/DataOutputStream.h"
 
 class LogConnAuthListener;
 
@@ -51,7 +54,11 @@ private:
   virtual void onTerminate();
 
   void assignConnection();
+  // Offers the client a log ring instead of the pipe and switches to it if
+  // the client has accepted it.
+  void offerLogRing(DataInputStream *input, DataOutputStream *output);
   void dispatch();
+  void dispatchLogRing();
 
   LogConnAuthListener *m_extAuthListener;
   LogListener *m_extLogListener;
@@ -65,6 +72,12 @@ private:
   unsigned char m_logLevel;
   LocalMutex m_logLevelMutex;
 
+  // The log ring and the client process it is shared with, 0 if the
+  // records come through the pipe.
+  LogRing *m_logRing;
+  HANDLE m_clientProcess;
+  UINT32 m_clientProcessId;
+
   LogLevelSender m_logLevelSender;
 };
 
@@ -0,0 +1,185 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LogRing.h"
+#include "util/Exception.h"
+
+LogRing::LogRing(size_t dataSize)
+: m_memory(0, HEADER_SIZE + dataSize),
+  m_event(0),
+  m_dataSize((UINT32)dataSize)
+{
+  _ASSERT((dataSize & (dataSize - 1)) == 0);
+  m_event = CreateEvent(0, FALSE, FALSE, 0);
+  if (m_event == 0) {
+    throw Exception(_T("Cannot create an event for the log ring"));
+  }
+  init();
+  m_header->dataSize = m_dataSize;
+}
+
+LogRing::LogRing(HANDLE memory, HANDLE event)
+: m_memory(memory),
+  m_event(event)
+{
+  m_dataSize = ((Header *)m_memory.getMemPointer())->dataSize;
+  init();
+}
+
+LogRing::~LogRing()
+{
+  if (m_event != 0) {
+    CloseHandle(m_event);
+  }
+}
+
+void LogRing::init()
+{
+  m_header = (Header *)m_memory.getMemPointer();
+  m_data = (UINT8 *)m_memory.getMemPointer() + HEADER_SIZE;
+  m_maxRecordSize = m_dataSize / 4;
+}
+
+UINT8 *LogRing::getRecordPtr(UINT32 pos) const
+{
+  return m_data + (pos & (m_dataSize - 1));
+}
+
+bool LogRing::write(UINT32 processId, UINT32 threadId, UINT64 time, int level,
+                    const TCHAR *message)
+{
+  size_t charCount = _tcslen(message);
+  size_t maxCharCount = (m_maxRecordSize - sizeof(RecordHeader)) / sizeof(TCHAR);
+  if (charCount > maxCharCount) {
+    charCount = maxCharCount;
+  }
+  UINT32 size = (UINT32)(sizeof(RecordHeader) + charCount * sizeof(TCHAR));
+  size = (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+
+  UINT32 writePos = (UINT32)m_header->writePos;
+  UINT32 used = writePos - (UINT32)m_header->readPos;
+  UINT32 tail = m_dataSize - (writePos & (m_dataSize - 1));
+  // A record doesn't wrap around, the rest of the ring is skipped instead.
+  UINT32 needed = tail < size ? tail + size : size;
+  if (needed > m_dataSize - used) {
+    InterlockedIncrement(&m_header->droppedCount);
+    return false;
+  }
+  if (tail < size) {
+    ((RecordHeader *)getRecordPtr(writePos))->size = tail | WRAP_FLAG;
+    writePos += tail;
+  }
+  RecordHeader *record = (RecordHeader *)getRecordPtr(writePos);
+  record->size = size;
+  record->level = level & 0xf;
+  record->processId = processId;
+  record->threadId = threadId;
+  record->time = time;
+  record->charCount = (UINT32)charCount;
+  record->reserved = 0;
+  memcpy(record + 1, message, charCount * sizeof(TCHAR));
+  // The interlocked operations are full barriers, the record is complete
+  // before the consumer can see it.
+  InterlockedExchange(&m_header->writePos, (LONG)(writePos + size));
+
+  if (InterlockedExchange(&m_header->consumerIdle, 0) != 0) {
+    SetEvent(m_event);
+  }
+  return true;
+}
+
+void LogRing::close()
+{
+  InterlockedExchange(&m_header->closed, 1);
+  SetEvent(m_event);
+}
+
+bool LogRing::read(UINT32 *processId, UINT32 *threadId, UINT64 *time,
+                   UINT8 *level, StringStorage *message)
+{
+  UINT32 readPos = (UINT32)m_header->readPos;
+  UINT32 writePos = (UINT32)InterlockedCompareExchange(&m_header->writePos, 0, 0);
+  while (readPos != writePos) {
+    UINT32 available = writePos - readPos;
+    UINT32 tail = m_dataSize - (readPos & (m_dataSize - 1));
+    if (available > m_dataSize) {
+      throw Exception(_T("The log ring is corrupted"));
+    }
+    // Only the size of a skipped tail is written, it may be shorter than a
+    // record header.
+    UINT32 size = *(volatile UINT32 *)getRecordPtr(readPos);
+    if ((size & WRAP_FLAG) != 0) {
+      if ((size & ~WRAP_FLAG) != tail || tail > available) {
+        throw Exception(_T("The log ring is corrupted"));
+      }
+      readPos += tail;
+      InterlockedExchange(&m_header->readPos, (LONG)readPos);
+      continue;
+    }
+    if (tail < sizeof(RecordHeader)) {
+      throw Exception(_T("The log ring is corrupted"));
+    }
+    // Every field is read once, the producer could change it meanwhile.
+    RecordHeader record = *(RecordHeader *)getRecordPtr(readPos);
+    if (record.size != size || size < sizeof(RecordHeader) || size > tail ||
+        size > available || size % RECORD_ALIGNMENT != 0 ||
+        record.charCount > (record.size - sizeof(RecordHeader)) / sizeof(TCHAR)) {
+      throw Exception(_T("The log ring is corrupted"));
+    }
+    m_chars.resize(record.charCount + 1);
+    memcpy(&m_chars.front(), getRecordPtr(readPos) + sizeof(RecordHeader),
+           record.charCount * sizeof(TCHAR));
+    m_chars[record.charCount] = 0;
+    message->setString(&m_chars.front());
+    *processId = record.processId;
+    *threadId = record.threadId;
+    *time = record.time;
+    *level = (UINT8)(record.level & 0xf);
+
+    InterlockedExchange(&m_header->readPos, (LONG)(readPos + size));
+    return true;
+  }
+  return false;
+}
+
+UINT32 LogRing::takeDroppedCount()
+{
+  return (UINT32)InterlockedExchange(&m_header->droppedCount, 0);
+}
+
+bool LogRing::isClosed() const
+{
+  return m_header->closed != 0;
+}
+
+bool LogRing::prepareToWait()
+{
+  InterlockedExchange(&m_header->consumerIdle, 1);
+  return m_header->readPos == InterlockedCompareExchange(&m_header->writePos, 0, 0);
+}
+
+void LogRing::wakeUp()
+{
+  SetEvent(m_event);
+}
@@ -0,0 +1,128 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __LOGRING_H__
+#define __LOGRING_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "win-system/SharedMemory.h"
+
+#include <vector>
+
+// LogRing is a ring of log records in shared memory between one client
+// logger (the producer) and its log connection in the log server (the
+// consumer). The producer appends records without any system call and
+// signals the event only when the consumer has gone to sleep after
+// draining the ring, so it is woken up once per batch of records. If the
+// ring is full the record is dropped and counted instead of blocking the
+// producer.
+//
+// The records hold the characters as they are, both sides must be the same
+// executable, which the log server checks before it accepts a client.
+class LogRing
+{
+public:
+  // Creates a ring with an unnamed memory object and an event for the
+  // consumer. The data size must be a power of two.
+  // @throw Exception on an error.
+  LogRing(size_t dataSize);
+  // Opens the ring by the handles assigned to this process by the creator
+  // and takes the ownership of them.
+  // @throw Exception on an error, the event handle stays with the caller
+  // then.
+  LogRing(HANDLE memory, HANDLE event);
+  virtual ~LogRing();
+
+  HANDLE getMemoryHandle() const { return m_memory.getHandle(); }
+  HANDLE getEventHandle() const { return m_event; }
+
+  // Producer side. The calls must be serialized by the caller.
+  // Returns false if the record has been dropped because the ring is full.
+  bool write(UINT32 processId, UINT32 threadId, UINT64 time, int level,
+             const TCHAR *message);
+  // Tells the consumer that no more records will be written.
+  void close();
+
+  // Consumer side. The calls must be made by one thread.
+  // Returns false if the ring is empty.
+  // @throw Exception if the ring contains garbage.
+  bool read(UINT32 *processId, UINT32 *threadId, UINT64 *time,
+            UINT8 *level, StringStorage *message);
+  // Returns the count of records dropped since the previous call.
+  UINT32 takeDroppedCount();
+  bool isClosed() const;
+  // Asks the producer to signal the event on the next record. Returns
+  // false if a record has arrived meanwhile and the ring must be read
+  // before waiting.
+  bool prepareToWait();
+  // Signals the event to break the wait of the consumer.
+  void wakeUp();
+
+private:
+  struct Header
+  {
+    volatile LONG writePos;
+    volatile LONG readPos;
+    volatile LONG droppedCount;
+    volatile LONG consumerIdle;
+    volatile LONG closed;
+    UINT32 dataSize;
+  };
+
+  struct RecordHeader
+  {
+    // Size of the whole record including the alignment, or the size of the
+    // unused tail of the ring with the WRAP_FLAG.
+    UINT32 size;
+    UINT32 level;
+    UINT32 processId;
+    UINT32 threadId;
+    UINT64 time;
+    UINT32 charCount;
+    UINT32 reserved;
+  };
+
+  // The header size keeps the records aligned.
+  static const size_t HEADER_SIZE = 64;
+  static const UINT32 RECORD_ALIGNMENT = 8;
+  static const UINT32 WRAP_FLAG = 0x80000000;
+
+  void init();
+  UINT8 *getRecordPtr(UINT32 pos) const;
+
+  SharedMemory m_memory;
+  HANDLE m_event;
+  Header *m_header;
+  UINT8 *m_data;
+  // The own copy for the consumer, so it doesn't depend on the memory the
+  // producer can write to.
+  UINT32 m_dataSize;
+  // Biggest record, longer messages are truncated.
+  UINT32 m_maxRecordSize;
+
+  std::vector<TCHAR> m_chars;
+};
+
+#endif // __LOGRING_H__
@@ -23,42 +23,125 @@
 //
 
 #include "FileLogger.h"
+#include "thread/AutoLock.h"
 
 FileLogger::FileLogger(const TCHAR *logDir, const TCHAR *fileName,
                        unsigned char logLevel, bool logHeadEnabled)
-: m_fileAccount(logDir, fileName, logLevel, logHeadEnabled)
+: m_fileAccount(logDir, fileName, logLevel, logHeadEnabled),
+  m_queue(QUEUE_SIZE),
+  m_queueHead(0),
+  m_queueCount(0),
+  m_droppedCount(0)
 {
+  resume();
 }
 
 FileLogger::FileLogger(bool logHeadEnabled)
-: m_fileAccount(logHeadEnabled)
+: m_fileAccount(logHeadEnabled),
+  m_queue(QUEUE_SIZE),
+  m_queueHead(0),
+  m_queueCount(0),
+  m_droppedCount(0)
 {
+  resume();
 }
 
 FileLogger::~FileLogger()
 {
+  terminate();
+  m_queueEvent.notify();
+  wait();
+  writeQueue();
 }
 
 void FileLogger::init(const TCHAR *logDir, const TCHAR *fileName, unsigned char logLevel)
 {
+  AutoLock al(&m_writeMutex);
+  writeQueue();
   m_fileAccount.init(logDir, fileName, logLevel);
 }
 
 void FileLogger::storeHeader()
 {
+  AutoLock al(&m_writeMutex);
+  writeQueue();
   m_fileAccount.storeHeader();
 }
 
 void FileLogger::print(int logLevel, const TCHAR *line)
 {
   try {
-    UINT32 processId = GetCurrentProcessId();
-    UINT32 threadId = GetCurrentThreadId();
-    DateTime currTime = DateTime::now();
+    AutoLock al(&m_queueMutex);
 
-    m_fileAccount.print(processId, threadId, &currTime, logLevel, line);
+    if (m_queueCount == m_queue.size()) {
+      m_droppedCount++;
+      return;
+    }
+
+    LogRecord *record = &m_queue[(m_queueHead + m_queueCount) % m_queue.size()];
+    record->processId = GetCurrentProcessId();
+    record->threadId = GetCurrentThreadId();
+    record->time = DateTime::now();
+    record->level = logLevel;
+    record->line.setString(line);
+    m_queueCount++;
   } catch (...) {
   }
+  m_queueEvent.notify();
+}
+
+void FileLogger::execute()
+{
+  while (!isTerminating()) {
+    m_queueEvent.waitForEvent();
+
+    AutoLock al(&m_writeMutex);
+    writeQueue();
+  }
+}
+
+void FileLogger::writeQueue()
+{
+  LogRecord record;
+  unsigned int droppedCount = 0;
+
+  while (true) {
+    {
+      AutoLock al(&m_queueMutex);
+
+      if (m_queueCount == 0) {
+        droppedCount = m_droppedCount;
+        m_droppedCount = 0;
+        if (droppedCount == 0) {
+          break;
+        }
+      } else {
+        LogRecord *queued = &m_queue[m_queueHead];
+        record.processId = queued->processId;
+        record.threadId = queued->threadId;
+        record.time = queued->time;
+        record.level = queued->level;
+        record.line = queued->line;
+        m_queueHead = (m_queueHead + 1) % m_queue.size();
+        m_queueCount--;
+      }
+    }
+
+    try {
+      if (droppedCount != 0) {
+        StringStorage message;
+        message.format(_T("%u log lines have been dropped"), droppedCount);
+        DateTime currTime = DateTime::now();
+        m_fileAccount.print(GetCurrentProcessId(), GetCurrentThreadId(),
+                            &currTime, 1, message.getString());
+        break;
+      }
+
+      m_fileAccount.print(record.processId, record.threadId, &record.time,
+                          record.level, record.line.getString());
+    } catch (...) {
+    }
+  }
 }
 
 bool FileLogger::acceptsLevel(int logLevel)
@@ -68,5 +151,7 @@ bool FileLogger::acceptsLevel(int logLevel)
 
 void FileLogger::changeLogProps(const TCHAR *newLogDir, unsigned char newLevel)
 {
+  AutoLock al(&m_writeMutex);
+  writeQueue();
   m_fileAccount.changeLogProps(newLogDir, newLevel);
 }
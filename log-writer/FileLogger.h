@@ -27,9 +27,16 @@
 
 #include "FileAccount.h"
 #include "log-writer/Logger.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+
+#include <vector>
 
 // This class is an implementation of the Logger class to write the log into a file.
-class FileLogger : public Logger
+// Log lines are queued by the calling threads and written to the file by an own
+// thread of the logger, so logging does not wait for file writes. If the queue
+// is full, lines are dropped and the count of dropped lines is logged later.
+class FileLogger : public Logger, private Thread
 {
 public:
   // @param logDir - a valid path to directory for log file.
@@ -73,8 +80,38 @@ public:
 
   virtual bool acceptsLevel(int logLevel);
 
+protected:
+  // Writes queued lines to the file until the logger is destroyed.
+  virtual void execute();
+
 private:
+  struct LogRecord
+  {
+    unsigned int processId;
+    unsigned int threadId;
+    DateTime time;
+    int level;
+    StringStorage line;
+  };
+
+  // Writes all queued lines to the file.
+  void writeQueue();
+
   FileAccount m_fileAccount;
+
+  // Ring buffer of queued lines. Records are reused, so their strings
+  // keep the allocated memory.
+  std::vector<LogRecord> m_queue;
+  size_t m_queueHead;
+  size_t m_queueCount;
+  unsigned int m_droppedCount;
+  LocalMutex m_queueMutex;
+
+  // Serializes writing of queued lines with changes of the log file.
+  LocalMutex m_writeMutex;
+  WindowsEvent m_queueEvent;
+
+  static const size_t QUEUE_SIZE = 4096;
 };
 
 #endif // __FILELOGGER_H__
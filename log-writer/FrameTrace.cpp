@@ -0,0 +1,185 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "FrameTrace.h"
+#include "thread/AutoLock.h"
+#include "file-lib/WinFile.h"
+#include "util/AnsiStringStorage.h"
+
+FrameTrace FrameTrace::s_instance;
+
+FrameTrace::Span::Span(Stage stage, UINT32 frameId)
+: m_stage(stage),
+  m_frameId(frameId),
+  m_bytes(0),
+  m_begin(0)
+{
+  if (FrameTrace::getInstance()->isEnabled()) {
+    m_begin = FrameTrace::now();
+  }
+}
+
+FrameTrace::Span::~Span()
+{
+  if (m_begin != 0) {
+    FrameTrace::getInstance()->record(m_stage, m_begin, FrameTrace::now(),
+                                      m_frameId, m_bytes);
+  }
+}
+
+void FrameTrace::Span::setBytes(UINT64 bytes)
+{
+  m_bytes = bytes;
+}
+
+FrameTrace::FrameTrace()
+: m_nextSlot(0),
+  m_nextFrameId(0),
+  m_enabled(false)
+{
+}
+
+FrameTrace *FrameTrace::getInstance()
+{
+  return &s_instance;
+}
+
+UINT64 FrameTrace::now()
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return (UINT64)counter.QuadPart;
+}
+
+void FrameTrace::setEnabled(bool enabled)
+{
+  AutoLock al(&m_exportMutex);
+  if (enabled && m_records.empty()) {
+    m_records.resize(RING_SIZE);
+  }
+  m_enabled = enabled;
+}
+
+bool FrameTrace::isEnabled() const
+{
+  return m_enabled;
+}
+
+UINT32 FrameTrace::nextFrameId()
+{
+  return (UINT32)InterlockedIncrement(&m_nextFrameId);
+}
+
+void FrameTrace::record(Stage stage, UINT64 begin, UINT64 end,
+                        UINT32 frameId, UINT64 bytes)
+{
+  if (!m_enabled) {
+    return;
+  }
+  // The ring is never released after the enabling, so it is safe to write
+  // to it without a lock. A record being overwritten while exported is
+  // just a torn sample.
+  unsigned long slot = (unsigned long)InterlockedIncrement(&m_nextSlot) - 1;
+  Record *rec = &m_records[slot % RING_SIZE];
+  rec->begin = begin;
+  rec->end = end;
+  rec->bytes = bytes;
+  rec->threadId = GetCurrentThreadId();
+  rec->frameId = frameId;
+  rec->stage = stage;
+}
+
+const char *FrameTrace::getStageName(Stage stage)
+{
+  switch (stage) {
+  case CAPTURE:
+    return "capture";
+  case EXTRACT:
+    return "extract";
+  case FILTER:
+    return "filter";
+  case ENCODE:
+    return "encode";
+  case FLUSH:
+    return "flush";
+  case UPDATE:
+    return "update";
+  }
+  return "unknown";
+}
+
+bool FrameTrace::exportChromeTrace(const TCHAR *fileName)
+{
+  AutoLock al(&m_exportMutex);
+  if (m_records.empty()) {
+    return false;
+  }
+  unsigned long total = (unsigned long)m_nextSlot;
+  if (total == 0) {
+    return false;
+  }
+  unsigned long first = total > RING_SIZE ? total - RING_SIZE : 0;
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  double ticksPerUs = (double)frequency.QuadPart / 1000000.0;
+  DWORD pid = GetCurrentProcessId();
+
+  try {
+    WinFile file(fileName, F_WRITE, FM_CREATE);
+    AnsiStringStorage chunk("{\"traceEvents\":[\n");
+    AnsiStringStorage line;
+    for (unsigned long i = first; i != total; i++) {
+      const Record *rec = &m_records[i % RING_SIZE];
+      line.format("%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+                  "\"ts\":%.3f,\"dur\":%.3f,"
+                  "\"args\":{\"frame\":%u,\"bytes\":%llu}}\n",
+                  i == first ? "" : ",",
+                  getStageName((Stage)rec->stage),
+                  (unsigned int)pid, (unsigned int)rec->threadId,
+                  (double)rec->begin / ticksPerUs,
+                  (double)(rec->end - rec->begin) / ticksPerUs,
+                  (unsigned int)rec->frameId, rec->bytes);
+      chunk.appendString(line.getString());
+      if (chunk.getLength() > 65536) {
+        file.write(chunk.getString(), chunk.getLength());
+        chunk.setString("");
+      }
+    }
+    chunk.appendString("]}\n");
+    file.write(chunk.getString(), chunk.getLength());
+    file.flush();
+  } catch (Exception &) {
+    return false;
+  }
+  return true;
+}
+
+bool FrameTrace::exportToDir(const TCHAR *dir)
+{
+  StringStorage fileName;
+  fileName.format(_T("%s\\frametrace-%u.json"), dir,
+                  (unsigned int)GetCurrentProcessId());
+  return exportChromeTrace(fileName.getString());
+}
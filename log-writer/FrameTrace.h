@@ -0,0 +1,121 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __FRAMETRACE_H__
+#define __FRAMETRACE_H__
+
+#include "util/CommonHeader.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
+
+// Collects timed spans of the frame pipeline (capture, extract, filter,
+// encode, flush) into a fixed binary ring so that the latency of each
+// stage can be examined later without logging on the hot path.
+// Recording a span is lock free: a slot is claimed by an interlocked
+// increment and overwritten when the ring wraps. The collected spans are
+// exported as a Chrome trace event file (chrome://tracing, Perfetto).
+class FrameTrace
+{
+public:
+  enum Stage
+  {
+    CAPTURE = 0,
+    EXTRACT,
+    FILTER,
+    ENCODE,
+    FLUSH,
+    UPDATE
+  };
+
+  // Measures a span from the construction to the destruction of the object.
+  // Does nothing if tracing is disabled at the moment of the construction.
+  class Span
+  {
+  public:
+    Span(Stage stage, UINT32 frameId = 0);
+    ~Span();
+
+    // Sets the number of bytes produced within the span.
+    void setBytes(UINT64 bytes);
+
+  private:
+    Stage m_stage;
+    UINT32 m_frameId;
+    UINT64 m_bytes;
+    UINT64 m_begin;
+  };
+
+  static FrameTrace *getInstance();
+
+  // Returns the current time in performance counter ticks.
+  static UINT64 now();
+
+  // At the first enabling allocates the ring.
+  void setEnabled(bool enabled);
+  bool isEnabled() const;
+
+  // Returns a new identifier to link spans of one frame update.
+  UINT32 nextFrameId();
+
+  void record(Stage stage, UINT64 begin, UINT64 end,
+              UINT32 frameId, UINT64 bytes);
+
+  // Writes all collected spans to the file in the Chrome trace event format.
+  // @return false if there is nothing to export or the file cannot be written.
+  bool exportChromeTrace(const TCHAR *fileName);
+
+  // Exports the spans to the "frametrace-<pid>.json" file in the directory,
+  // so that traces of several processes do not overwrite each other.
+  bool exportToDir(const TCHAR *dir);
+
+private:
+  FrameTrace();
+
+  static const char *getStageName(Stage stage);
+
+  struct Record
+  {
+    UINT64 begin;
+    UINT64 end;
+    UINT64 bytes;
+    UINT32 threadId;
+    UINT32 frameId;
+    UINT32 stage;
+  };
+
+  // Must be a power of two to keep the ring consistent when the slot
+  // counter wraps.
+  static const size_t RING_SIZE = 65536;
+
+  std::vector<Record> m_records;
+  volatile LONG m_nextSlot;
+  volatile LONG m_nextFrameId;
+  volatile bool m_enabled;
+  LocalMutex m_exportMutex;
+
+  static FrameTrace s_instance;
+};
+
+#endif // __FRAMETRACE_H__
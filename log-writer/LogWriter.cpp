@@ -29,12 +29,10 @@
 LogWriter::LogWriter(Logger *logger)
 : m_logger(logger)
 {
-  m_profiler = new ProfileLogger();
 }
 
 LogWriter::~LogWriter()
 {
-  delete m_profiler;
 }
 
 void LogWriter::interror(const TCHAR *fmt, ...)
@@ -119,31 +117,25 @@ bool LogWriter::isDebug()
   return (m_logger != 0 && m_logger->acceptsLevel(LOG_DEBUG));
 }
 
-ProcessorTimes LogWriter::checkPoint(const TCHAR * tag)
-{
-  return m_profiler->checkPoint(tag);
-}
-
 #pragma warning(push)
 #pragma warning(disable:4996)
 
 void LogWriter::vprintLog(int logLevel, const TCHAR *fmt, va_list argList)
 {
   if (m_logger != 0) {
-    // Format the original string.
+    // Format the original string, short lines are formatted on the stack.
+    TCHAR shortString[SHORT_LINE_LENGTH];
+    std::vector<TCHAR> formattedString;
+    TCHAR *line = shortString;
+
     int count = _vsctprintf(fmt, argList);
-    std::vector<TCHAR> formattedString(count + 1);
-    _vstprintf(&formattedString.front(), fmt, argList);
-
-    m_logger->print(logLevel, &formattedString.front());
-// #if DROP_TIME_STAT // test code
-    std::vector<std::vector<TCHAR>> resultStrings = m_profiler->dropStat();
-    for (size_t i = 0; i < resultStrings.size(); i++) {
-      formattedString = resultStrings[i];
-      if (formattedString.size() != 0)
-        m_logger->print(9, &formattedString.front());
+    if (count >= SHORT_LINE_LENGTH) {
+      formattedString.resize(count + 1);
+      line = &formattedString.front();
     }
-// #endif
+    _vstprintf(line, fmt, argList);
+
+    m_logger->print(logLevel, line);
   }
 }
 
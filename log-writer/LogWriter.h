@@ -27,7 +27,10 @@
 
 #include "Logger.h"
 #include "util/CharDefs.h"
-#include "ProfileLogger.h"
+#include "util/DateTime.h"
+#include "thread/LocalMutex.h"
+#include <vector>
+#include <map>
 
 // This class is a high level wrap for the Logger class. It helps write log in different
 // log levels by the different functions.
@@ -66,9 +69,6 @@ public:
   // Returnd true if debug loglevel enabled.
   bool isDebug();
 
-  // Add profiler checkpoint
-  ProcessorTimes checkPoint(const TCHAR *tag);
-
 protected:
   static const int LOG_INTERR = 0;
   static const int LOG_ERR = 1;
@@ -81,8 +81,10 @@ protected:
 private:
   void vprintLog(int logLevel, const TCHAR *fmt, va_list argList);
 
+  // Lines shorter than this are formatted without heap allocation.
+  static const int SHORT_LINE_LENGTH = 512;
+
   Logger *m_logger;
-  ProfileLogger *m_profiler;
 };
 
 #endif // _LOGWRITER_H_
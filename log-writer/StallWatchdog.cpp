@@ -0,0 +1,387 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "StallWatchdog.h"
+#include "ZoneProfiler.h"
+#include "FrameTrace.h"
+#include "thread/AutoLock.h"
+#include "thread/LockProfiler.h"
+#include "file-lib/WinFile.h"
+#include "util/AnsiStringStorage.h"
+#include "util/MemAccount.h"
+#include "win-system/DynamicLibrary.h"
+#include "win-system/Environment.h"
+
+#include <vector>
+
+typedef BOOL (WINAPI *MINIDUMPWRITEDUMP)(__in  HANDLE hProcess,
+                                       __in  DWORD ProcessId,
+                                       __in  HANDLE hFile,
+                                       __in  MINIDUMP_TYPE DumpType,
+                                       __in  PMINIDUMP_EXCEPTION_INFORMATION ExceptionParam,
+                                       __in  PMINIDUMP_USER_STREAM_INFORMATION UserStreamParam,
+                                       __in  PMINIDUMP_CALLBACK_INFORMATION CallbackParam);
+
+static const TCHAR *const STAGE_NAMES[StallWatchdog::STAGE_COUNT] = {
+  _T("capture"), _T("extract"), _T("encode"), _T("send"),
+  _T("ipc"), _T("decode"), _T("present")
+};
+
+StallWatchdog::Slot StallWatchdog::s_slots[STAGE_COUNT][SLOTS_PER_STAGE];
+volatile LONG StallWatchdog::s_lastHeartbeat[STAGE_COUNT];
+volatile LONG StallWatchdog::s_unwatched[STAGE_COUNT];
+// Encoding and decoding also write to and read from the network, so they
+// wait for the other side as long as sending. A request to the other
+// process includes its own capture and extraction.
+volatile LONG StallWatchdog::s_deadlines[STAGE_COUNT] = {
+  5000, 5000, 30000, 30000, 10000, 30000, 5000
+};
+StallWatchdog::Span StallWatchdog::s_history[HISTORY_SIZE];
+volatile LONG StallWatchdog::s_nextSpan = 0;
+
+static void appendLine(StringStorage *report, const StringStorage *line)
+{
+  report->appendString(line->getString());
+  report->appendString(_T("\r\n"));
+}
+
+StallWatchdog::Activity::Activity(Stage stage)
+: m_stage(stage),
+  m_slot(-1)
+{
+  m_start = GetTickCount();
+  // 0 marks a free slot.
+  if (m_start == 0) {
+    m_start = 1;
+  }
+  Slot *slots = s_slots[stage];
+  for (int i = 0; i < SLOTS_PER_STAGE; i++) {
+    if (InterlockedCompareExchange(&slots[i].start, (LONG)m_start, 0) == 0) {
+      slots[i].threadId = (LONG)GetCurrentThreadId();
+      m_slot = i;
+      return;
+    }
+  }
+  InterlockedIncrement(&s_unwatched[stage]);
+}
+
+StallWatchdog::Activity::~Activity()
+{
+  DWORD end = GetTickCount();
+  if (m_slot >= 0) {
+    Slot *slot = &s_slots[m_stage][m_slot];
+    slot->threadId = 0;
+    InterlockedExchange(&slot->start, 0);
+  }
+  InterlockedExchange(&s_lastHeartbeat[m_stage], (LONG)end);
+
+  // The span may be read while it is written, the report tolerates it.
+  LONG index = InterlockedIncrement(&s_nextSpan) - 1;
+  Span *span = &s_history[(size_t)index & (HISTORY_SIZE - 1)];
+  span->start = m_start;
+  span->end = end;
+  span->threadId = GetCurrentThreadId();
+  span->stage = m_stage;
+}
+
+StallWatchdog::StallWatchdog(LogWriter *log)
+: m_log(log),
+  m_lastDumpTime(0),
+  m_dumpCount(0)
+{
+  memset(m_reported, 0, sizeof(m_reported));
+  resume();
+}
+
+StallWatchdog::~StallWatchdog()
+{
+  terminate();
+  wait();
+}
+
+void StallWatchdog::setDumpDir(const TCHAR *dir)
+{
+  AutoLock al(&m_dumpDirLock);
+  m_dumpDir.setString(dir);
+}
+
+const TCHAR *StallWatchdog::getStageName(Stage stage)
+{
+  return STAGE_NAMES[stage];
+}
+
+void StallWatchdog::setDeadline(Stage stage, DWORD deadline)
+{
+  InterlockedExchange(&s_deadlines[stage], (LONG)deadline);
+}
+
+DWORD StallWatchdog::getDeadline(Stage stage)
+{
+  return (DWORD)s_deadlines[stage];
+}
+
+void StallWatchdog::execute()
+{
+  while (!isTerminating()) {
+    m_timer.waitForEvent(CHECK_INTERVAL);
+    if (!isTerminating()) {
+      check();
+    }
+  }
+}
+
+void StallWatchdog::onTerminate()
+{
+  m_timer.notify();
+}
+
+void StallWatchdog::check()
+{
+  DWORD now = GetTickCount();
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    DWORD deadline = getDeadline((Stage)stage);
+    for (int i = 0; i < SLOTS_PER_STAGE; i++) {
+      Slot *slot = &s_slots[stage][i];
+      DWORD start = (DWORD)slot->start;
+      DWORD *reported = &m_reported[stage][i];
+      if (*reported != 0 && start != *reported) {
+        m_log->message(_T("The %s stage has resumed after a stall")
+                       _T(" of about %u ms"),
+                       STAGE_NAMES[stage], (unsigned int)(now - *reported));
+        *reported = 0;
+      }
+      if (start == 0 || deadline == 0 || *reported != 0) {
+        continue;
+      }
+      // The activity may have started after now was taken.
+      LONG elapsed = (LONG)(now - start);
+      if (elapsed <= (LONG)deadline) {
+        continue;
+      }
+      *reported = start;
+      DWORD threadId = (DWORD)slot->threadId;
+      m_log->error(_T("The %s stage of thread %u has stalled for %u ms"),
+                   STAGE_NAMES[stage], (unsigned int)threadId,
+                   (unsigned int)elapsed);
+      if (m_dumpCount < MAX_DUMP_COUNT &&
+          (m_dumpCount == 0 || now - m_lastDumpTime >= MIN_DUMP_INTERVAL)) {
+        m_dumpCount++;
+        m_lastDumpTime = now;
+        writeReport((Stage)stage, threadId, (DWORD)elapsed);
+      }
+    }
+  }
+}
+
+void StallWatchdog::writeReport(Stage stage, DWORD threadId, DWORD elapsed)
+{
+  StringStorage dumpDir;
+  {
+    AutoLock al(&m_dumpDirLock);
+    dumpDir = m_dumpDir;
+  }
+  if (dumpDir.isEmpty()) {
+    return;
+  }
+
+  StringStorage baseName;
+  baseName.format(_T("%s\\stall-%u-%u"), dumpDir.getString(),
+                  (unsigned int)GetCurrentProcessId(), m_dumpCount);
+  StringStorage reportName, dumpName;
+  reportName.format(_T("%s.txt"), baseName.getString());
+  dumpName.format(_T("%s.dmp"), baseName.getString());
+
+  StringStorage report;
+  describe(stage, threadId, elapsed, GetTickCount(), &report);
+  try {
+    AnsiStringStorage ansiReport(&report);
+    WinFile file(reportName.getString(), F_WRITE, FM_CREATE);
+    file.write(ansiReport.getString(), ansiReport.getLength());
+    file.flush();
+    m_log->message(_T("The stall report has been written to %s"),
+                   reportName.getString());
+  } catch (Exception &e) {
+    m_log->error(_T("Cannot write the stall report to %s: %s"),
+                 reportName.getString(), e.getMessage());
+  }
+
+  if (writeMiniDump(dumpName.getString())) {
+    m_log->message(_T("The thread stacks have been written to %s"),
+                   dumpName.getString());
+  }
+
+  FrameTrace *frameTrace = FrameTrace::getInstance();
+  if (frameTrace->isEnabled()) {
+    frameTrace->exportToDir(dumpDir.getString());
+  }
+}
+
+void StallWatchdog::describe(Stage stalledStage, DWORD threadId,
+                             DWORD elapsed, DWORD now,
+                             StringStorage *report)
+{
+  StringStorage line;
+  line.format(_T("The %s stage of thread %u has stalled for %u ms,")
+              _T(" process %u, tick count %u"),
+              STAGE_NAMES[stalledStage], (unsigned int)threadId,
+              (unsigned int)elapsed, (unsigned int)GetCurrentProcessId(),
+              (unsigned int)now);
+  appendLine(report, &line);
+
+  report->appendString(_T("\r\nActive stages:\r\n"));
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    for (int i = 0; i < SLOTS_PER_STAGE; i++) {
+      DWORD start = (DWORD)s_slots[stage][i].start;
+      if (start == 0) {
+        continue;
+      }
+      line.format(_T("  %s: thread %u for %d ms, deadline %u ms"),
+                  STAGE_NAMES[stage],
+                  (unsigned int)s_slots[stage][i].threadId,
+                  (int)(now - start),
+                  (unsigned int)getDeadline((Stage)stage));
+      appendLine(report, &line);
+    }
+  }
+
+  report->appendString(_T("\r\nLast heartbeats:\r\n"));
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    DWORD heartbeat = (DWORD)s_lastHeartbeat[stage];
+    if (heartbeat == 0) {
+      line.format(_T("  %s: never"), STAGE_NAMES[stage]);
+    } else {
+      line.format(_T("  %s: %d ms ago"), STAGE_NAMES[stage],
+                  (int)(now - heartbeat));
+    }
+    if (s_unwatched[stage] != 0) {
+      StringStorage unwatched;
+      unwatched.format(_T(", %u activities not watched"),
+                       (unsigned int)s_unwatched[stage]);
+      line.appendString(unwatched.getString());
+    }
+    appendLine(report, &line);
+  }
+
+  line.format(_T("\r\nActivities of the last %u ms")
+              _T(" (ms ago, duration in ms, stage, thread):"),
+              HISTORY_TIME);
+  appendLine(report, &line);
+  unsigned long total = (unsigned long)s_nextSpan;
+  unsigned long first = total > HISTORY_SIZE ? total - HISTORY_SIZE : 0;
+  for (unsigned long i = first; i != total; i++) {
+    Span span = s_history[i & (HISTORY_SIZE - 1)];
+    if (span.stage >= STAGE_COUNT || now - span.end > HISTORY_TIME) {
+      continue;
+    }
+    line.format(_T("  %d %u %s %u"), (int)(now - span.start),
+                (unsigned int)(span.end - span.start),
+                STAGE_NAMES[span.stage], (unsigned int)span.threadId);
+    appendLine(report, &line);
+  }
+
+  report->appendString(_T("\r\nZones since the last report:\r\n"));
+  std::vector<ZoneProfiler::ZoneStats> zoneStats;
+  ZoneProfiler::getInstance()->getStats(&zoneStats);
+  for (size_t i = 0; i < zoneStats.size(); i++) {
+    const ZoneProfiler::ZoneStats *zone = &zoneStats[i];
+    if (zone->count == 0 && zone->dropped == 0) {
+      continue;
+    }
+    line.format(_T("  %s: %u samples, %.3f ms in total, p50 %u us,")
+                _T(" p95 %u us, max %u us, %u dropped"),
+                ZoneProfiler::getZoneName((ZoneProfiler::Zone)i),
+                zone->count, (double)zone->totalTime / 1000.0,
+                zone->p50, zone->p95, zone->maxTime, zone->dropped);
+    appendLine(report, &line);
+  }
+
+  report->appendString(_T("\r\nContended locks:\r\n"));
+  std::vector<LockContention> contentions;
+  LockProfiler::getContentions(&contentions);
+  for (size_t i = 0; i < contentions.size(); i++) {
+    LockContention *contention = &contentions[i];
+    line.format(_T("  %s: %I64u contended acquisitions, waited %I64u us")
+                _T(" in total, %I64u us at most"),
+                contention->lockName.getString(),
+                contention->contentions,
+                contention->totalWaitTime,
+                contention->maxWaitTime);
+    appendLine(report, &line);
+  }
+
+  report->appendString(_T("\r\n"));
+  MemAccount::getDescription(&line);
+  appendLine(report, &line);
+}
+
+bool StallWatchdog::writeMiniDump(const TCHAR *fileName)
+{
+  DynamicLibrary dbgLib;
+  MINIDUMPWRITEDUMP miniDumpWriteDump = 0;
+  try {
+    // Try load the library from this exe module folder
+    StringStorage libName, moduleFolder;
+    Environment::getCurrentModuleFolderPath(&moduleFolder);
+    libName.format(_T("%s\\DbgHelp.dll"), moduleFolder.getString());
+
+    dbgLib.init(libName.getString());
+    miniDumpWriteDump = (MINIDUMPWRITEDUMP)
+                          dbgLib.getProcAddress("MiniDumpWriteDump");
+  } catch (...) {
+    try {
+      // Try load the library by default path
+      dbgLib.init(_T("DbgHelp.dll"));
+      miniDumpWriteDump = (MINIDUMPWRITEDUMP)
+                            dbgLib.getProcAddress("MiniDumpWriteDump");
+    } catch (Exception &e) {
+      m_log->error(_T("Cannot load DbgHelp.dll to write the thread stacks:")
+                   _T(" %s"), e.getMessage());
+      return false;
+    }
+  }
+  if (miniDumpWriteDump == 0) {
+    return false;
+  }
+
+  HANDLE hFile = CreateFile(fileName, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, 0);
+  if (hFile == INVALID_HANDLE_VALUE) {
+    m_log->error(_T("Cannot create the %s file (%u)"), fileName,
+                 (unsigned int)GetLastError());
+    return false;
+  }
+  // A normal minidump has the stacks of all threads, the process goes on
+  // after it has been written.
+  BOOL result = miniDumpWriteDump(GetCurrentProcess(),
+                                  GetCurrentProcessId(),
+                                  hFile,
+                                  MiniDumpNormal,
+                                  0, 0, 0);
+  if (result == 0) {
+    m_log->error(_T("Cannot write the thread stacks to %s (%u)"), fileName,
+                 (unsigned int)GetLastError());
+  }
+  CloseHandle(hFile);
+  return result != 0;
+}
@@ -0,0 +1,151 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __STALLWATCHDOG_H__
+#define __STALLWATCHDOG_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "LogWriter.h"
+
+// Watches the stages of the frame pipeline for stalls. A stage is marked
+// active by an Activity scope for as long as the work lasts, e.g. while
+// waiting for a frame from the driver or for a reply from the other
+// process. When one activity of a stage runs past the deadline of the
+// stage the watchdog writes a flight recorder report to the dump
+// directory without stopping the process:
+//   stall-<pid>-<n>.txt - the active stages, the last heartbeats, the
+//     activities of the last HISTORY_TIME ms and the zone, lock and
+//     memory counters;
+//   stall-<pid>-<n>.dmp - a minidump with the stacks of all threads;
+//   frametrace-<pid>.json - if the frame trace is enabled.
+// One stall is reported once, and the reports are written at most every
+// MIN_DUMP_INTERVAL ms and MAX_DUMP_COUNT times per process, the following
+// stalls are only logged.
+class StallWatchdog : private Thread
+{
+public:
+  enum Stage
+  {
+    CAPTURE = 0,
+    EXTRACT,
+    ENCODE,
+    SEND,
+    IPC,
+    DECODE,
+    PRESENT,
+    STAGE_COUNT
+  };
+
+  // Marks the stage active from the construction to the destruction and
+  // records the activity in the history. Costs a GetTickCount() call and
+  // a few interlocked operations, without locks.
+  class Activity
+  {
+  public:
+    Activity(Stage stage);
+    ~Activity();
+
+  private:
+    Stage m_stage;
+    int m_slot;
+    DWORD m_start;
+  };
+
+  StallWatchdog(LogWriter *log);
+  virtual ~StallWatchdog();
+
+  // Sets the directory the reports are written to. Nothing is written
+  // until it is set.
+  void setDumpDir(const TCHAR *dir);
+
+  static const TCHAR *getStageName(Stage stage);
+
+  // Sets the time in milliseconds an activity of the stage may last,
+  // 0 stops watching the stage.
+  static void setDeadline(Stage stage, DWORD deadline);
+  static DWORD getDeadline(Stage stage);
+
+  static const unsigned int CHECK_INTERVAL = 1000;
+  static const unsigned int HISTORY_TIME = 10000;
+  static const unsigned int MIN_DUMP_INTERVAL = 60000;
+  static const unsigned int MAX_DUMP_COUNT = 10;
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // An activity in progress. The start is 0 while the slot is free, so
+  // a slot is taken by one interlocked exchange.
+  struct Slot
+  {
+    volatile LONG start;
+    volatile LONG threadId;
+  };
+
+  // A finished activity.
+  struct Span
+  {
+    DWORD start;
+    DWORD end;
+    DWORD threadId;
+    UINT32 stage;
+  };
+
+  // The activities beyond this count are not watched but still recorded.
+  static const int SLOTS_PER_STAGE = 16;
+  // Must be a power of two to keep the history consistent when the
+  // counter wraps.
+  static const size_t HISTORY_SIZE = 4096;
+
+  void check();
+  void writeReport(Stage stage, DWORD threadId, DWORD elapsed);
+  void describe(Stage stalledStage, DWORD threadId, DWORD elapsed,
+                DWORD now, StringStorage *report);
+  bool writeMiniDump(const TCHAR *fileName);
+
+  WindowsEvent m_timer;
+  LogWriter *m_log;
+
+  LocalMutex m_dumpDirLock;
+  StringStorage m_dumpDir;
+
+  // Start of the stalled activity already reported, by slot.
+  DWORD m_reported[STAGE_COUNT][SLOTS_PER_STAGE];
+  DWORD m_lastDumpTime;
+  unsigned int m_dumpCount;
+
+  static Slot s_slots[STAGE_COUNT][SLOTS_PER_STAGE];
+  static volatile LONG s_lastHeartbeat[STAGE_COUNT];
+  static volatile LONG s_unwatched[STAGE_COUNT];
+  static volatile LONG s_deadlines[STAGE_COUNT];
+  static Span s_history[HISTORY_SIZE];
+  static volatile LONG s_nextSpan;
+};
+
+#endif // __STALLWATCHDOG_H__
@@ -0,0 +1,192 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ZoneProfiler.h"
+#include "thread/AutoLock.h"
+
+static const TCHAR *const ZONE_NAMES[ZoneProfiler::ZONE_COUNT] = {
+  _T("capture"), _T("filter"), _T("split"), _T("encode-raw"),
+  _T("encode-rre"), _T("encode-hextile"), _T("encode-zrle"),
+  _T("encode-tight"), _T("encode-other"), _T("flush"), _T("decode"),
+  _T("present")
+};
+
+ZoneProfiler ZoneProfiler::s_instance;
+
+ZoneProfiler::Scope::Scope(Zone zone)
+: m_zone(zone),
+  m_start(now())
+{
+}
+
+ZoneProfiler::Scope::~Scope()
+{
+  s_instance.record(m_zone, now() - m_start);
+}
+
+ZoneProfiler::ZoneProfiler()
+: m_tlsIndex(TlsAlloc()),
+  m_frequency(0)
+{
+  LARGE_INTEGER frequency;
+  if (QueryPerformanceFrequency(&frequency)) {
+    m_frequency = frequency.QuadPart;
+  }
+  memset(m_stats, 0, sizeof(m_stats));
+}
+
+ZoneProfiler::~ZoneProfiler()
+{
+  for (size_t i = 0; i < m_buffers.size(); i++) {
+    if (m_buffers[i]->thread != 0) {
+      CloseHandle(m_buffers[i]->thread);
+    }
+    delete m_buffers[i];
+  }
+  if (m_tlsIndex != TLS_OUT_OF_INDEXES) {
+    TlsFree(m_tlsIndex);
+  }
+}
+
+ZoneProfiler *ZoneProfiler::getInstance()
+{
+  return &s_instance;
+}
+
+const TCHAR *ZoneProfiler::getZoneName(Zone zone)
+{
+  return zone >= 0 && zone < ZONE_COUNT ? ZONE_NAMES[zone] : _T("unknown");
+}
+
+INT64 ZoneProfiler::now()
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
+
+void ZoneProfiler::record(Zone zone, INT64 ticks)
+{
+  if (m_tlsIndex == TLS_OUT_OF_INDEXES || m_frequency == 0) {
+    return;
+  }
+  ThreadBuffer *buffer = (ThreadBuffer *)TlsGetValue(m_tlsIndex);
+  if (buffer == 0) {
+    buffer = getThreadBuffer();
+  }
+  UINT32 writePos = (UINT32)buffer->writePos;
+  if (writePos - (UINT32)buffer->readPos >= BUFFER_SIZE) {
+    // Only the overloaded threads pay for the interlocked operation.
+    InterlockedIncrement(&buffer->dropped[zone]);
+    return;
+  }
+  Sample *sample = &buffer->samples[writePos & (BUFFER_SIZE - 1)];
+  sample->zone = zone;
+  sample->ticks = ticks < 0 ? 0 : ticks > 0xffffffff ? 0xffffffff : (UINT32)ticks;
+  // Volatile stores are release ones with the Microsoft compiler, so the
+  // sample is complete before the aggregating thread sees the position.
+  buffer->writePos = (LONG)(writePos + 1);
+}
+
+ZoneProfiler::ThreadBuffer *ZoneProfiler::getThreadBuffer()
+{
+  ThreadBuffer *buffer = new ThreadBuffer;
+  buffer->writePos = 0;
+  buffer->readPos = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    buffer->dropped[i] = 0;
+  }
+  buffer->thread = OpenThread(SYNCHRONIZE, FALSE, GetCurrentThreadId());
+  TlsSetValue(m_tlsIndex, buffer);
+
+  AutoLock al(&m_buffersLock);
+  m_buffers.push_back(buffer);
+  return buffer;
+}
+
+void ZoneProfiler::drain(ThreadBuffer *buffer)
+{
+  UINT32 readPos = (UINT32)buffer->readPos;
+  UINT32 writePos = (UINT32)buffer->writePos;
+  for (; readPos != writePos; readPos++) {
+    const Sample *sample = &buffer->samples[readPos & (BUFFER_SIZE - 1)];
+    UINT32 micros = (UINT32)((UINT64)sample->ticks * 1000000 / m_frequency);
+    ZoneStats *stats = &m_stats[sample->zone];
+    stats->count++;
+    stats->totalTime += micros;
+    if (micros > stats->maxTime) {
+      stats->maxTime = micros;
+    }
+    m_histograms[sample->zone].add(micros);
+  }
+  buffer->readPos = (LONG)readPos;
+
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (buffer->dropped[i] != 0) {
+      m_stats[i].dropped += (UINT32)InterlockedExchange(&buffer->dropped[i], 0);
+    }
+  }
+}
+
+void ZoneProfiler::aggregate()
+{
+  AutoLock al(&m_buffersLock);
+  std::vector<ThreadBuffer *>::iterator i = m_buffers.begin();
+  while (i != m_buffers.end()) {
+    ThreadBuffer *buffer = *i;
+    // An exited thread can't add samples after the last drain.
+    bool exited = buffer->thread != 0 &&
+                  WaitForSingleObject(buffer->thread, 0) == WAIT_OBJECT_0;
+    drain(buffer);
+    if (exited) {
+      CloseHandle(buffer->thread);
+      delete buffer;
+      i = m_buffers.erase(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void ZoneProfiler::takeStats(std::vector<ZoneStats> *stats)
+{
+  AutoLock al(&m_buffersLock);
+  getStats(stats);
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    m_histograms[i].clear();
+  }
+  memset(m_stats, 0, sizeof(m_stats));
+}
+
+void ZoneProfiler::getStats(std::vector<ZoneStats> *stats)
+{
+  AutoLock al(&m_buffersLock);
+  stats->resize(ZONE_COUNT);
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    ZoneStats *zoneStats = &(*stats)[i];
+    *zoneStats = m_stats[i];
+    zoneStats->p50 = m_histograms[i].getPercentile(50);
+    zoneStats->p95 = m_histograms[i].getPercentile(95);
+  }
+}
@@ -0,0 +1,147 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __ZONEPROFILER_H__
+#define __ZONEPROFILER_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+#include "util/LatencyHistogram.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
+
+// Always available profiler of the fixed zones of the frame pipeline.
+// A zone scope costs two QueryPerformanceCounter() calls and a store into
+// a buffer of the current thread, without locks and interlocked
+// operations. The buffers are drained by aggregate() off the hot path,
+// ZoneReporter does it once per second. If a buffer is full the sample is
+// counted as dropped instead.
+class ZoneProfiler
+{
+public:
+  enum Zone
+  {
+    CAPTURE = 0,
+    FILTER,
+    SPLIT,
+    ENCODE_RAW,
+    ENCODE_RRE,
+    ENCODE_HEXTILE,
+    ENCODE_ZRLE,
+    ENCODE_TIGHT,
+    ENCODE_OTHER,
+    FLUSH,
+    DECODE,
+    PRESENT,
+    ZONE_COUNT
+  };
+
+  // Measures the zone from the construction to the destruction.
+  class Scope
+  {
+  public:
+    Scope(Zone zone);
+    ~Scope();
+
+  private:
+    Zone m_zone;
+    INT64 m_start;
+  };
+
+  struct ZoneStats
+  {
+    UINT32 count;
+    // Samples lost because the buffer of the thread was full.
+    UINT32 dropped;
+    // In microseconds.
+    UINT64 totalTime;
+    UINT32 p50;
+    UINT32 p95;
+    UINT32 maxTime;
+  };
+
+  static ZoneProfiler *getInstance();
+
+  static const TCHAR *getZoneName(Zone zone);
+
+  // Returns the current time in performance counter ticks.
+  static INT64 now();
+
+  void record(Zone zone, INT64 ticks);
+
+  // Moves the samples of all threads to the statistics and forgets the
+  // buffers of the threads that have exited.
+  void aggregate();
+
+  // Returns the statistics aggregated since the previous call, indexed by
+  // zone, and starts new ones.
+  void takeStats(std::vector<ZoneStats> *stats);
+
+  // Returns the statistics aggregated since the previous takeStats() call
+  // without starting new ones.
+  void getStats(std::vector<ZoneStats> *stats);
+
+private:
+  ZoneProfiler();
+  ~ZoneProfiler();
+
+  struct Sample
+  {
+    UINT32 zone;
+    UINT32 ticks;
+  };
+
+  // Must be a power of two to keep the buffer consistent when the
+  // positions wrap.
+  static const size_t BUFFER_SIZE = 4096;
+
+  // Written by the owner thread and read by the aggregating one.
+  struct ThreadBuffer
+  {
+    Sample samples[BUFFER_SIZE];
+    volatile LONG writePos;
+    volatile LONG readPos;
+    volatile LONG dropped[ZONE_COUNT];
+    // Signaled when the thread exits, 0 if it cannot be opened.
+    HANDLE thread;
+  };
+
+  ThreadBuffer *getThreadBuffer();
+  // Must be called under m_buffersLock.
+  void drain(ThreadBuffer *buffer);
+
+  DWORD m_tlsIndex;
+  INT64 m_frequency;
+
+  LocalMutex m_buffersLock;
+  std::vector<ThreadBuffer *> m_buffers;
+  // Aggregated under m_buffersLock.
+  ZoneStats m_stats[ZONE_COUNT];
+  LatencyHistogram m_histograms[ZONE_COUNT];
+
+  static ZoneProfiler s_instance;
+};
+
+#endif // __ZONEPROFILER_H__
@@ -0,0 +1,81 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ZoneReporter.h"
+#include "ZoneProfiler.h"
+
+#include <vector>
+
+ZoneReporter::ZoneReporter(LogWriter *log)
+: m_log(log)
+{
+  resume();
+}
+
+ZoneReporter::~ZoneReporter()
+{
+  terminate();
+  wait();
+}
+
+void ZoneReporter::execute()
+{
+  ZoneProfiler *profiler = ZoneProfiler::getInstance();
+  DWORD lastReport = GetTickCount();
+  while (!isTerminating()) {
+    m_timer.waitForEvent(AGGREGATE_INTERVAL);
+    profiler->aggregate();
+    DWORD interval = GetTickCount() - lastReport;
+    if (interval >= REPORT_INTERVAL) {
+      report(interval);
+      lastReport += interval;
+    }
+  }
+}
+
+void ZoneReporter::onTerminate()
+{
+  m_timer.notify();
+}
+
+void ZoneReporter::report(DWORD interval)
+{
+  std::vector<ZoneProfiler::ZoneStats> stats;
+  ZoneProfiler::getInstance()->takeStats(&stats);
+  if (!m_log->isDebug()) {
+    return;
+  }
+  for (size_t i = 0; i < stats.size(); i++) {
+    const ZoneProfiler::ZoneStats *zone = &stats[i];
+    if (zone->count == 0 && zone->dropped == 0) {
+      continue;
+    }
+    m_log->debug(_T("Zone %s: %u samples in %u ms, %.3f ms in total,")
+                 _T(" p50 %u us, p95 %u us, max %u us, %u dropped"),
+                 ZoneProfiler::getZoneName((ZoneProfiler::Zone)i),
+                 zone->count, (unsigned int)interval,
+                 (double)zone->totalTime / 1000.0,
+                 zone->p50, zone->p95, zone->maxTime, zone->dropped);
+  }
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __ZONEREPORTER_H__
+#define __ZONEREPORTER_H__
+
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "LogWriter.h"
+
+// Aggregates the samples of ZoneProfiler every AGGREGATE_INTERVAL ms and
+// writes the statistics of the zones to the debug log every
+// REPORT_INTERVAL ms.
+class ZoneReporter : private Thread
+{
+public:
+  ZoneReporter(LogWriter *log);
+  virtual ~ZoneReporter();
+
+  static const unsigned int AGGREGATE_INTERVAL = 1000;
+  static const unsigned int REPORT_INTERVAL = 5000;
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  void report(DWORD interval);
+
+  WindowsEvent m_timer;
+  LogWriter *m_log;
+};
+
+#endif // __ZONEREPORTER_H__
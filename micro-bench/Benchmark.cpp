@@ -0,0 +1,55 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "Benchmark.h"
+
+volatile UINT32 Benchmark::s_sink = 0;
+
+Benchmark::Benchmark(const TCHAR *name, UINT64 bytesPerIteration)
+: m_name(name),
+  m_bytesPerIteration(bytesPerIteration)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+const TCHAR *Benchmark::getName() const
+{
+  return m_name.getString();
+}
+
+UINT64 Benchmark::getBytesPerIteration() const
+{
+  return m_bytesPerIteration;
+}
+
+void Benchmark::setUp()
+{
+}
+
+void Benchmark::tearDown()
+{
+}
@@ -0,0 +1,57 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include "util/CommonHeader.h"
+
+// A measured operation. The runner calls setUp() once, then run() with
+// the iteration counts it needs and tearDown() at the end, so only the
+// data of the running benchmark are kept in memory.
+class Benchmark
+{
+public:
+  // bytesPerIteration is the amount of pixel or stream data processed by
+  // one iteration, used for the throughput, 0 if there is none.
+  Benchmark(const TCHAR *name, UINT64 bytesPerIteration);
+  virtual ~Benchmark();
+
+  const TCHAR *getName() const;
+  UINT64 getBytesPerIteration() const;
+
+  virtual void setUp();
+  virtual void run(unsigned int iterations) = 0;
+  virtual void tearDown();
+
+protected:
+  // Results of the measured work are added to it, so that the compiler
+  // can't drop the work.
+  static volatile UINT32 s_sink;
+
+  StringStorage m_name;
+  UINT64 m_bytesPerIteration;
+};
+
+#endif // __BENCHMARK_H__
@@ -0,0 +1,131 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "BenchmarkContent.h"
+
+static const UINT32 SOLID_COLOR = 0x3a6ea5;
+static const UINT32 PAPER_COLOR = 0xffffff;
+static const UINT32 INK_COLOR = 0x202020;
+
+const TCHAR *BenchmarkContent::getName(Type type)
+{
+  switch (type) {
+  case SOLID:
+    return _T("solid");
+  case TEXT:
+    return _T("text");
+  case PHOTO:
+    return _T("photo");
+  }
+  return _T("unknown");
+}
+
+PixelFormat BenchmarkContent::getNativeFormat()
+{
+  PixelFormat pf;
+  pf.initBigEndianByNative();
+  pf.bitsPerPixel = 32;
+  pf.colorDepth = 24;
+  pf.redMax = 0xff;
+  pf.greenMax = 0xff;
+  pf.blueMax = 0xff;
+  pf.redShift = 16;
+  pf.greenShift = 8;
+  pf.blueShift = 0;
+  return pf;
+}
+
+void BenchmarkContent::fill(FrameBuffer *fb, Type type)
+{
+  UINT32 random = 0x2545f491;
+  Dimension dim = fb->getDimension();
+  Rect rect(dim.width, dim.height);
+  switch (type) {
+  case SOLID:
+    fb->fillRect(&rect, SOLID_COLOR);
+    break;
+  case TEXT:
+    fb->fillRect(&rect, PAPER_COLOR);
+    fillText(fb, &random);
+    break;
+  case PHOTO:
+    fillPhoto(fb, &random);
+    break;
+  }
+}
+
+void BenchmarkContent::fillText(FrameBuffer *fb, UINT32 *random)
+{
+  // Cells of 8x16 pixels with 5x6 dots of 1x2 pixels in them, a few
+  // spaces and lines of random length.
+  Dimension dim = fb->getDimension();
+  size_t stride = fb->getBytesPerRow();
+  for (int y = 0; y + 16 <= dim.height; y += 16) {
+    int length = (int)(nextRandom(random) % (dim.width / 8 + 1));
+    for (int x = 0; x < length * 8 && x + 8 <= dim.width; x += 8) {
+      UINT32 bits = nextRandom(random);
+      if ((bits >> 30) == 0) {
+        continue;
+      }
+      UINT8 *row = (UINT8 *)fb->getBufferPtr(x + 1, y + 2);
+      for (int i = 0; i < 6; i++, row += 2 * stride) {
+        UINT32 *upper = (UINT32 *)row;
+        UINT32 *lower = (UINT32 *)(row + stride);
+        for (int j = 0; j < 5; j++) {
+          if (bits & (1 << (i * 5 + j))) {
+            upper[j] = INK_COLOR;
+            lower[j] = INK_COLOR;
+          }
+        }
+      }
+    }
+  }
+}
+
+void BenchmarkContent::fillPhoto(FrameBuffer *fb, UINT32 *random)
+{
+  Dimension dim = fb->getDimension();
+  size_t stride = fb->getBytesPerRow();
+  UINT8 *row = (UINT8 *)fb->getBuffer();
+  for (int y = 0; y < dim.height; y++, row += stride) {
+    UINT32 *pixel = (UINT32 *)row;
+    UINT32 fy = (UINT32)y * 255 / dim.height;
+    for (int x = 0; x < dim.width; x++) {
+      UINT32 fx = (UINT32)x * 255 / dim.width;
+      UINT32 grain = nextRandom(random) & 0x0f0f0f;
+      UINT32 r = (fx + fy) / 2;
+      UINT32 g = 255 - fy;
+      UINT32 b = (fx * fy) >> 8;
+      *pixel++ = ((r << 16) | (g << 8) | b) ^ grain;
+    }
+  }
+}
+
+UINT32 BenchmarkContent::nextRandom(UINT32 *random)
+{
+  *random ^= *random << 13;
+  *random ^= *random >> 17;
+  *random ^= *random << 5;
+  return *random;
+}
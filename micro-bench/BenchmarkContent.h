@@ -0,0 +1,62 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __BENCHMARKCONTENT_H__
+#define __BENCHMARKCONTENT_H__
+
+#include "util/CommonHeader.h"
+#include "rfb/FrameBuffer.h"
+
+// Representative screen contents for the benchmarks. The same type and
+// size always give the same pixels.
+class BenchmarkContent
+{
+public:
+  enum Type
+  {
+    // One color.
+    SOLID,
+    // Dark glyphs in lines on white, like a document or a terminal.
+    TEXT,
+    // Smooth gradients with a fine grain, like a picture.
+    PHOTO
+  };
+
+  static const TCHAR *getName(Type type);
+
+  // Returns the 32-bit format with red at bits 16-23, the one of the
+  // Windows desktop.
+  static PixelFormat getNativeFormat();
+
+  // Fills a frame buffer of the native format.
+  static void fill(FrameBuffer *fb, Type type);
+
+private:
+  static void fillText(FrameBuffer *fb, UINT32 *random);
+  static void fillPhoto(FrameBuffer *fb, UINT32 *random);
+
+  static UINT32 nextRandom(UINT32 *random);
+};
+
+#endif // __BENCHMARKCONTENT_H__
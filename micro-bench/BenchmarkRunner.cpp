@@ -0,0 +1,107 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "BenchmarkRunner.h"
+
+#include <vector>
+#include <algorithm>
+
+// Limit of the calibrated iterations.
+static const unsigned int MAX_ITERATIONS = 1 << 30;
+
+BenchmarkRunner::BenchmarkRunner(const BenchmarkOptions *options)
+: m_options(*options)
+{
+  if (m_options.repetitions == 0) {
+    m_options.repetitions = 1;
+  }
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  m_frequency = (double)frequency.QuadPart;
+}
+
+BenchmarkRunner::~BenchmarkRunner()
+{
+}
+
+void BenchmarkRunner::measure(Benchmark *benchmark, BenchmarkResult *result)
+{
+  benchmark->setUp();
+  try {
+    // The first run warms up the caches and the lazily made tables.
+    timeRun(benchmark, 1);
+
+    unsigned int iterations = m_options.iterations;
+    if (iterations == 0) {
+      iterations = calibrate(benchmark);
+    }
+
+    std::vector<double> times;
+    for (unsigned int i = 0; i < m_options.repetitions; i++) {
+      times.push_back(timeRun(benchmark, iterations) * 1e9 / iterations);
+    }
+    std::sort(times.begin(), times.end());
+
+    result->iterations = iterations;
+    result->repetitions = m_options.repetitions;
+    result->minTime = times.front();
+    result->maxTime = times.back();
+    result->medianTime = times[times.size() / 2];
+    result->throughput = 0;
+    if (benchmark->getBytesPerIteration() != 0 && result->medianTime > 0) {
+      result->throughput = (double)benchmark->getBytesPerIteration() * 1e3 /
+                           result->medianTime / 1.048576;
+    }
+  } catch (...) {
+    benchmark->tearDown();
+    throw;
+  }
+  benchmark->tearDown();
+}
+
+unsigned int BenchmarkRunner::calibrate(Benchmark *benchmark)
+{
+  double minTime = m_options.minTime / 1000.0;
+  unsigned int iterations = 1;
+  for (;;) {
+    double time = timeRun(benchmark, iterations);
+    if (time >= minTime || iterations >= MAX_ITERATIONS) {
+      return iterations;
+    }
+    if (time >= minTime / 8) {
+      return (unsigned int)min((double)MAX_ITERATIONS,
+                               iterations * minTime / time + 1);
+    }
+    iterations *= 2;
+  }
+}
+
+double BenchmarkRunner::timeRun(Benchmark *benchmark, unsigned int iterations)
+{
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  benchmark->run(iterations);
+  QueryPerformanceCounter(&end);
+  return (end.QuadPart - start.QuadPart) / m_frequency;
+}
@@ -0,0 +1,83 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __BENCHMARKRUNNER_H__
+#define __BENCHMARKRUNNER_H__
+
+#include "Benchmark.h"
+
+struct BenchmarkOptions
+{
+  BenchmarkOptions()
+  : iterations(0),
+    minTime(200),
+    repetitions(5)
+  {
+  }
+
+  // Iterations of a repetition, 0 to calibrate them to minTime. A fixed
+  // count makes the runs of different builds do the same work.
+  unsigned int iterations;
+  // Milliseconds.
+  unsigned int minTime;
+  unsigned int repetitions;
+};
+
+struct BenchmarkResult
+{
+  unsigned int iterations;
+  unsigned int repetitions;
+  // Nanoseconds per iteration over the repetitions.
+  double minTime;
+  double medianTime;
+  double maxTime;
+  // Megabytes per second at the median time, 0 if the benchmark has no
+  // bytes.
+  double throughput;
+};
+
+// Measures benchmarks by repetitions of a number of iterations, taking
+// the median time as the result, which is not affected by a few
+// interrupted repetitions.
+class BenchmarkRunner
+{
+public:
+  BenchmarkRunner(const BenchmarkOptions *options);
+  virtual ~BenchmarkRunner();
+
+  void measure(Benchmark *benchmark, BenchmarkResult *result);
+
+protected:
+  // Doubles the iterations until a repetition takes minTime at least and
+  // then scales them to minTime.
+  unsigned int calibrate(Benchmark *benchmark);
+
+  // Returns the time of the iterations in seconds.
+  double timeRun(Benchmark *benchmark, unsigned int iterations);
+
+  BenchmarkOptions m_options;
+  double m_frequency;
+};
+
+#endif // __BENCHMARKRUNNER_H__
@@ -0,0 +1,831 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PrimitiveBenchmarks.h"
+#include "BenchmarkContent.h"
+
+#include "region/Region.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelConverter.h"
+#include "rfb-sconn/TightPalette.h"
+#include "util/Deflater.h"
+#include "util/Inflater.h"
+#include "util/md5.h"
+#include "util/Utf8Transcoder.h"
+#include "io-lib/BufferedOutputStream.h"
+
+struct ScreenSize
+{
+  const TCHAR *name;
+  int width;
+  int height;
+};
+
+static const ScreenSize SCREEN_SIZES[] = {
+  { _T("1080p"), 1920, 1080 },
+  { _T("4k"), 3840, 2160 }
+};
+static const size_t SCREEN_SIZE_COUNT = sizeof(SCREEN_SIZES) / sizeof(SCREEN_SIZES[0]);
+
+static const BenchmarkContent::Type CONTENT_TYPES[] = {
+  BenchmarkContent::SOLID, BenchmarkContent::TEXT, BenchmarkContent::PHOTO
+};
+static const size_t CONTENT_TYPE_COUNT = sizeof(CONTENT_TYPES) / sizeof(CONTENT_TYPES[0]);
+
+// Side of the square of pixels compressed and hashed by one iteration,
+// 1 MB of 32-bit pixels.
+static const int BLOCK_SIDE = 512;
+// Tiles of the region and palette benchmarks.
+static const int TILE_SIZE = 64;
+// Tiles of the subrectangle fill benchmark.
+static const int HEXTILE_SIZE = 16;
+
+static PixelFormat makePixelFormat(int bpp, int depth,
+                                   int redMax, int greenMax, int blueMax,
+                                   int redShift, int greenShift, int blueShift)
+{
+  PixelFormat pf;
+  pf.initBigEndianByNative();
+  pf.bitsPerPixel = bpp;
+  pf.colorDepth = depth;
+  pf.redMax = redMax;
+  pf.greenMax = greenMax;
+  pf.blueMax = blueMax;
+  pf.redShift = redShift;
+  pf.greenShift = greenShift;
+  pf.blueShift = blueShift;
+  return pf;
+}
+
+static FrameBuffer *createContent(int width, int height,
+                                  BenchmarkContent::Type type)
+{
+  Dimension dim(width, height);
+  PixelFormat pf = BenchmarkContent::getNativeFormat();
+  FrameBuffer *fb = new FrameBuffer;
+  fb->setProperties(&dim, &pf);
+  BenchmarkContent::fill(fb, type);
+  return fb;
+}
+
+//
+// Region set operations on the dirty tiles of a screen.
+//
+
+class RegionBenchmark : public Benchmark
+{
+public:
+  enum Operation { ADD, SUBTRACT, INTERSECT, RECTS };
+
+  RegionBenchmark(const TCHAR *name, Operation operation, const ScreenSize *size)
+  : Benchmark(name, 0),
+    m_operation(operation),
+    m_size(size)
+  {
+  }
+
+  virtual void setUp()
+  {
+    // A checkerboard of tiles and a sparser grid shifted by half a tile,
+    // which cut each other into many rectangles.
+    std::vector<Rect> rects;
+    for (int y = 0; y < m_size->height; y += TILE_SIZE) {
+      for (int x = 0; x < m_size->width; x += TILE_SIZE) {
+        if ((x / TILE_SIZE + y / TILE_SIZE) % 2 == 0) {
+          rects.push_back(Rect(x, y, min(x + TILE_SIZE, m_size->width),
+                               min(y + TILE_SIZE, m_size->height)));
+        }
+      }
+    }
+    m_first.clear();
+    m_first.addRects(&rects);
+    rects.clear();
+    for (int y = TILE_SIZE / 2; y < m_size->height; y += TILE_SIZE) {
+      for (int x = TILE_SIZE / 2; x < m_size->width; x += TILE_SIZE) {
+        if ((x / TILE_SIZE + y / TILE_SIZE * 7) % 3 == 0) {
+          rects.push_back(Rect(x, y, min(x + TILE_SIZE, m_size->width),
+                               min(y + TILE_SIZE, m_size->height)));
+        }
+      }
+    }
+    m_second.clear();
+    m_second.addRects(&rects);
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      if (m_operation == RECTS) {
+        m_rects.clear();
+        m_first.getRectVector(&m_rects);
+        s_sink += (UINT32)m_rects.size();
+        continue;
+      }
+      Region region(m_first);
+      switch (m_operation) {
+      case ADD:
+        region.add(&m_second);
+        break;
+      case SUBTRACT:
+        region.subtract(&m_second);
+        break;
+      case INTERSECT:
+        region.intersect(&m_second);
+        break;
+      }
+      s_sink += region.isEmpty() ? 1 : 0;
+    }
+  }
+
+  virtual void tearDown()
+  {
+    m_first.clear();
+    m_second.clear();
+    std::vector<Rect>().swap(m_rects);
+  }
+
+private:
+  Operation m_operation;
+  const ScreenSize *m_size;
+  Region m_first;
+  Region m_second;
+  std::vector<Rect> m_rects;
+};
+
+//
+// Frame buffer copies, comparison, moves and fills of a whole screen.
+//
+
+class FrameBufferBenchmark : public Benchmark
+{
+public:
+  enum Operation { COPY, COMPARE, MOVE, FILL, FILL_SUBRECTS };
+
+  FrameBufferBenchmark(const TCHAR *name, Operation operation,
+                       const ScreenSize *size)
+  : Benchmark(name, (UINT64)size->width * size->height * 4),
+    m_operation(operation),
+    m_size(size),
+    m_src(0),
+    m_dst(0)
+  {
+  }
+
+  virtual void setUp()
+  {
+    m_src = createContent(m_size->width, m_size->height, BenchmarkContent::TEXT);
+    m_dst = new FrameBuffer;
+    m_dst->clone(m_src);
+    m_rect.setRect(0, 0, m_size->width, m_size->height);
+
+    if (m_operation == FILL_SUBRECTS) {
+      // Hextile tiles: the background and eight subrectangles of up to
+      // 8x8 pixels, the throughput counts the pixels filled.
+      UINT32 random = 0x2545f491;
+      UINT64 filledBytes = 0;
+      for (int y = 0; y + HEXTILE_SIZE <= m_size->height; y += HEXTILE_SIZE) {
+        for (int x = 0; x + HEXTILE_SIZE <= m_size->width; x += HEXTILE_SIZE) {
+          Rect tile(x, y, x + HEXTILE_SIZE, y + HEXTILE_SIZE);
+          m_subrects.push_back(tile);
+          m_colors.push_back(random);
+          filledBytes += tile.area() * 4;
+          for (int i = 0; i < 8; i++) {
+            random = random * 1103515245 + 12345;
+            int left = x + (random >> 8) % 8;
+            int top = y + (random >> 12) % 8;
+            Rect subrect(left, top, left + 1 + (random >> 16) % 8,
+                         top + 1 + (random >> 20) % 8);
+            m_subrects.push_back(subrect);
+            m_colors.push_back(random);
+            filledBytes += subrect.area() * 4;
+          }
+        }
+      }
+      m_bytesPerIteration = filledBytes;
+    }
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    // Scrolls by a line of text.
+    Rect scrolled(0, 0, m_size->width, m_size->height - 16);
+    for (unsigned int i = 0; i < iterations; i++) {
+      switch (m_operation) {
+      case COPY:
+        m_dst->copyFrom(m_src, 0, 0);
+        break;
+      case COMPARE:
+        // The frames are equal, so the whole frame is scanned.
+        s_sink += m_dst->cmpFrom(&m_rect, m_src, 0, 0) ? 1 : 0;
+        break;
+      case MOVE:
+        m_dst->move(&scrolled, 0, 16);
+        break;
+      case FILL:
+        m_dst->fillRect(&m_rect, i);
+        break;
+      case FILL_SUBRECTS:
+        m_dst->fillRects(&m_subrects.front(), &m_colors.front(),
+                         m_subrects.size());
+        break;
+      }
+    }
+  }
+
+  virtual void tearDown()
+  {
+    delete m_src;
+    delete m_dst;
+    m_src = m_dst = 0;
+    std::vector<Rect>().swap(m_subrects);
+    std::vector<UINT32>().swap(m_colors);
+  }
+
+private:
+  Operation m_operation;
+  const ScreenSize *m_size;
+  Rect m_rect;
+  std::vector<Rect> m_subrects;
+  std::vector<UINT32> m_colors;
+  FrameBuffer *m_src;
+  FrameBuffer *m_dst;
+};
+
+//
+// Pixel conversion of a whole screen between the formats of the clients.
+//
+
+struct NamedPixelFormat
+{
+  const TCHAR *name;
+  PixelFormat format;
+};
+
+class PixelConverterBenchmark : public Benchmark
+{
+public:
+  PixelConverterBenchmark(const TCHAR *name, const PixelFormat *dstPf,
+                          const PixelFormat *srcPf, const ScreenSize *size)
+  : Benchmark(name, (UINT64)size->width * size->height * (srcPf->bitsPerPixel / 8)),
+    m_dstPf(*dstPf),
+    m_srcPf(*srcPf),
+    m_size(size),
+    m_src(0),
+    m_dst(0)
+  {
+  }
+
+  virtual void setUp()
+  {
+    Dimension dim(m_size->width, m_size->height);
+    m_rect.setRect(0, 0, m_size->width, m_size->height);
+    FrameBuffer *native = createContent(m_size->width, m_size->height,
+                                        BenchmarkContent::PHOTO);
+    PixelFormat nativePf = BenchmarkContent::getNativeFormat();
+    if (m_srcPf.isEqualTo(&nativePf)) {
+      m_src = native;
+    } else {
+      m_src = new FrameBuffer;
+      m_src->setProperties(&dim, &m_srcPf);
+      PixelConverter converter;
+      converter.setPixelFormats(&m_srcPf, &nativePf);
+      converter.convert(&m_rect, m_src, native);
+      delete native;
+    }
+    m_dst = new FrameBuffer;
+    m_dst->setProperties(&dim, &m_dstPf);
+    m_converter.setPixelFormats(&m_dstPf, &m_srcPf);
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      m_converter.convert(&m_rect, m_dst, m_src);
+    }
+  }
+
+  virtual void tearDown()
+  {
+    delete m_src;
+    delete m_dst;
+    m_src = m_dst = 0;
+  }
+
+private:
+  PixelFormat m_dstPf;
+  PixelFormat m_srcPf;
+  const ScreenSize *m_size;
+  Rect m_rect;
+  PixelConverter m_converter;
+  FrameBuffer *m_src;
+  FrameBuffer *m_dst;
+};
+
+//
+// Compression and decompression of a block of pixels at a zlib level.
+//
+
+class ZlibBenchmark : public Benchmark
+{
+public:
+  ZlibBenchmark(const TCHAR *name, bool inflate, int level,
+                BenchmarkContent::Type type)
+  : Benchmark(name, (UINT64)BLOCK_SIDE * BLOCK_SIDE * 4),
+    m_inflate(inflate),
+    m_level(level),
+    m_type(type),
+    m_block(0),
+    m_deflater(0),
+    m_inflater(0)
+  {
+  }
+
+  virtual void setUp()
+  {
+    m_block = createContent(BLOCK_SIDE, BLOCK_SIDE, m_type);
+    m_deflater = new Deflater;
+    m_deflater->setLevel(m_level);
+    if (m_inflate) {
+      m_deflater->setInput((const char *)m_block->getBuffer(),
+                           m_block->getBufferSize());
+      m_deflater->deflate();
+      m_compressed.assign(m_deflater->getOutput(),
+                          m_deflater->getOutput() + m_deflater->getOutputSize());
+      m_inflater = new Inflater;
+    }
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      if (m_inflate) {
+        // Each iteration decodes the same stream from its start.
+        m_inflater->reset();
+        m_inflater->setInput(&m_compressed.front(), m_compressed.size());
+        m_inflater->setUnpackedSize(m_block->getBufferSize());
+        m_inflater->inflate();
+        s_sink += m_inflater->getOutputSize();
+      } else {
+        m_deflater->setInput((const char *)m_block->getBuffer(),
+                             m_block->getBufferSize());
+        m_deflater->deflate();
+        s_sink += m_deflater->getOutputSize();
+      }
+    }
+  }
+
+  virtual void tearDown()
+  {
+    delete m_block;
+    delete m_deflater;
+    delete m_inflater;
+    m_block = 0;
+    m_deflater = 0;
+    m_inflater = 0;
+    std::vector<char>().swap(m_compressed);
+  }
+
+private:
+  bool m_inflate;
+  int m_level;
+  BenchmarkContent::Type m_type;
+  FrameBuffer *m_block;
+  Deflater *m_deflater;
+  Inflater *m_inflater;
+  std::vector<char> m_compressed;
+};
+
+//
+// Palette of every tile of a screen, as the Tight encoder builds it.
+//
+
+class TightPaletteBenchmark : public Benchmark
+{
+public:
+  TightPaletteBenchmark(const TCHAR *name, BenchmarkContent::Type type,
+                        const ScreenSize *size)
+  : Benchmark(name, (UINT64)size->width * size->height * 4),
+    m_type(type),
+    m_size(size),
+    m_screen(0)
+  {
+  }
+
+  virtual void setUp()
+  {
+    m_screen = createContent(m_size->width, m_size->height, m_type);
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      for (int y = 0; y < m_size->height; y += TILE_SIZE) {
+        for (int x = 0; x < m_size->width; x += TILE_SIZE) {
+          Rect tile(x, y, min(x + TILE_SIZE, m_size->width),
+                    min(y + TILE_SIZE, m_size->height));
+          s_sink += fillPalette(&tile);
+        }
+      }
+    }
+  }
+
+  virtual void tearDown()
+  {
+    delete m_screen;
+    m_screen = 0;
+  }
+
+private:
+  // Inserts the runs of the tile pixels until the palette is full and
+  // returns the number of colors, 0 if it is full.
+  int fillPalette(const Rect *tile)
+  {
+    m_palette.reset();
+    size_t stride = m_screen->getBytesPerRow();
+    const UINT8 *row = (const UINT8 *)m_screen->getBufferPtr(tile->left, tile->top);
+    UINT32 color = *(const UINT32 *)row;
+    int count = 0;
+    for (int y = tile->top; y < tile->bottom; y++, row += stride) {
+      const UINT32 *pixel = (const UINT32 *)row;
+      for (int x = 0; x < tile->getWidth(); x++) {
+        if (pixel[x] == color) {
+          count++;
+        } else {
+          if (m_palette.insert(color, count) == 0) {
+            return 0;
+          }
+          color = pixel[x];
+          count = 1;
+        }
+      }
+    }
+    return m_palette.insert(color, count);
+  }
+
+  BenchmarkContent::Type m_type;
+  const ScreenSize *m_size;
+  FrameBuffer *m_screen;
+  TightPalette m_palette;
+};
+
+//
+// MD5 of a block of pixels.
+//
+
+class Md5Benchmark : public Benchmark
+{
+public:
+  Md5Benchmark(const TCHAR *name)
+  : Benchmark(name, (UINT64)BLOCK_SIDE * BLOCK_SIDE * 4),
+    m_block(0)
+  {
+  }
+
+  virtual void setUp()
+  {
+    m_block = createContent(BLOCK_SIDE, BLOCK_SIDE, BenchmarkContent::PHOTO);
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      MD5 md5;
+      md5.update((const unsigned char *)m_block->getBuffer(),
+                 (UINT32)m_block->getBufferSize());
+      s_sink += md5.finalize().getHash()[0];
+    }
+  }
+
+  virtual void tearDown()
+  {
+    delete m_block;
+    m_block = 0;
+  }
+
+private:
+  FrameBuffer *m_block;
+};
+
+//
+// Write patterns of the update senders through BufferedOutputStream.
+//
+
+// Output stream which drops all the data, so only the buffering is
+// measured.
+class NullOutputStream : public OutputStream
+{
+public:
+  virtual size_t write(const void *buffer, size_t len)
+  {
+    return len;
+  }
+};
+
+class BufferedStreamBenchmark : public Benchmark
+{
+public:
+  // Writes of the given length, or rows of a 1080p screen if it is 0.
+  BufferedStreamBenchmark(const TCHAR *name, size_t writeLength, size_t writeCount)
+  : Benchmark(name, (UINT64)(writeLength != 0 ? writeLength * writeCount
+                                              : (size_t)1920 * 4 * 1080)),
+    m_writeLength(writeLength),
+    m_writeCount(writeCount),
+    m_stream(0)
+  {
+  }
+
+  virtual void setUp()
+  {
+    m_data.resize(m_writeLength != 0 ? m_writeLength : (size_t)1920 * 4 * 1080);
+    m_stream = new BufferedOutputStream(&m_sink);
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      if (m_writeLength != 0) {
+        for (size_t j = 0; j < m_writeCount; j++) {
+          m_stream->write(&m_data.front(), m_writeLength);
+        }
+      } else {
+        m_stream->writeRows(&m_data.front(), 1920 * 4, 1920 * 4, 1080);
+      }
+      m_stream->flush();
+    }
+  }
+
+  virtual void tearDown()
+  {
+    delete m_stream;
+    m_stream = 0;
+    std::vector<char>().swap(m_data);
+  }
+
+private:
+  size_t m_writeLength;
+  size_t m_writeCount;
+  NullOutputStream m_sink;
+  BufferedOutputStream *m_stream;
+  std::vector<char> m_data;
+};
+
+//
+// UTF-8 conversion of 1 MB of clipboard text, by Utf8Transcoder and by the
+// system, for comparison.
+//
+
+class Utf8Benchmark : public Benchmark
+{
+public:
+  enum Operation { DECODE, DECODE_SYSTEM, ENCODE, ENCODE_SYSTEM };
+  // Letters of the text: a-z, a-z with accented letters, cyrillic, CJK.
+  enum Script { ASCII, LATIN, CYRILLIC, CJK };
+
+  // The size of the text in UTF-8 is known after setUp().
+  Utf8Benchmark(const TCHAR *name, Operation operation, Script script)
+  : Benchmark(name, 0),
+    m_operation(operation),
+    m_script(script)
+  {
+  }
+
+  virtual void setUp()
+  {
+    // Words of 2 to 9 letters in lines of about 80 characters.
+    UINT32 random = 0x2545f491;
+    size_t lineLength = 0;
+    m_utf16.clear();
+    while (m_utf16.size() < TEXT_LENGTH) {
+      random = random * 1103515245 + 12345;
+      int wordLength = 2 + (int)((random >> 16) % 8);
+      for (int i = 0; i < wordLength; i++) {
+        random = random * 1103515245 + 12345;
+        m_utf16.push_back(getLetter(random >> 8));
+      }
+      lineLength += wordLength + 1;
+      if (lineLength >= 80) {
+        m_utf16.push_back(L'\r');
+        m_utf16.push_back(L'\n');
+        lineLength = 0;
+      } else {
+        m_utf16.push_back(L' ');
+      }
+    }
+    size_t utf8Length;
+    Utf8Transcoder::utf16ToUtf8(&m_utf16.front(), m_utf16.size(), 0, 0, &utf8Length);
+    m_utf8.resize(utf8Length);
+    Utf8Transcoder::utf16ToUtf8(&m_utf16.front(), m_utf16.size(),
+                                &m_utf8.front(), m_utf8.size(), &utf8Length);
+    m_utf16Out.resize(m_utf16.size());
+    m_utf8Out.resize(m_utf8.size());
+    m_bytesPerIteration = m_utf8.size();
+  }
+
+  virtual void run(unsigned int iterations)
+  {
+    for (unsigned int i = 0; i < iterations; i++) {
+      size_t length = 0;
+      switch (m_operation) {
+      case DECODE:
+        Utf8Transcoder::utf8ToUtf16(&m_utf8.front(), m_utf8.size(),
+                                    &m_utf16Out.front(), m_utf16Out.size(),
+                                    &length);
+        break;
+      case DECODE_SYSTEM:
+        length = MultiByteToWideChar(CP_UTF8, 0, &m_utf8.front(),
+                                     (int)m_utf8.size(), &m_utf16Out.front(),
+                                     (int)m_utf16Out.size());
+        break;
+      case ENCODE:
+        Utf8Transcoder::utf16ToUtf8(&m_utf16.front(), m_utf16.size(),
+                                    &m_utf8Out.front(), m_utf8Out.size(),
+                                    &length);
+        break;
+      case ENCODE_SYSTEM:
+        length = WideCharToMultiByte(CP_UTF8, 0, &m_utf16.front(),
+                                     (int)m_utf16.size(), &m_utf8Out.front(),
+                                     (int)m_utf8Out.size(), 0, 0);
+        break;
+      }
+      s_sink += (UINT32)length;
+    }
+  }
+
+  virtual void tearDown()
+  {
+    std::vector<WCHAR>().swap(m_utf16);
+    std::vector<WCHAR>().swap(m_utf16Out);
+    std::vector<char>().swap(m_utf8);
+    std::vector<char>().swap(m_utf8Out);
+  }
+
+private:
+  // Characters of the text, about 1 MB of ASCII.
+  static const size_t TEXT_LENGTH = 1024 * 1024;
+
+  WCHAR getLetter(UINT32 random) const
+  {
+    switch (m_script) {
+    case LATIN:
+      // One letter of eight is accented.
+      if (random % 8 == 0) {
+        return (WCHAR)(0xE0 + (random >> 3) % 32);
+      }
+      return (WCHAR)(L'a' + random % 26);
+    case CYRILLIC:
+      return (WCHAR)(0x430 + random % 32);
+    case CJK:
+      return (WCHAR)(0x4E00 + random % 2048);
+    default:
+      return (WCHAR)(L'a' + random % 26);
+    }
+  }
+
+  Operation m_operation;
+  Script m_script;
+  std::vector<WCHAR> m_utf16;
+  std::vector<WCHAR> m_utf16Out;
+  std::vector<char> m_utf8;
+  std::vector<char> m_utf8Out;
+};
+
+void PrimitiveBenchmarks::create(std::vector<Benchmark *> *list)
+{
+  StringStorage name;
+
+  static const struct {
+    const TCHAR *name;
+    RegionBenchmark::Operation operation;
+  } regionOperations[] = {
+    { _T("add"), RegionBenchmark::ADD },
+    { _T("subtract"), RegionBenchmark::SUBTRACT },
+    { _T("intersect"), RegionBenchmark::INTERSECT },
+    { _T("rects"), RegionBenchmark::RECTS }
+  };
+  static const struct {
+    const TCHAR *name;
+    FrameBufferBenchmark::Operation operation;
+  } fbOperations[] = {
+    { _T("copyFrom"), FrameBufferBenchmark::COPY },
+    { _T("cmpFrom"), FrameBufferBenchmark::COMPARE },
+    { _T("move"), FrameBufferBenchmark::MOVE },
+    { _T("fillRect"), FrameBufferBenchmark::FILL },
+    { _T("fillRects"), FrameBufferBenchmark::FILL_SUBRECTS }
+  };
+  for (size_t s = 0; s < SCREEN_SIZE_COUNT; s++) {
+    const ScreenSize *size = &SCREEN_SIZES[s];
+    for (size_t i = 0; i < sizeof(regionOperations) / sizeof(regionOperations[0]); i++) {
+      name.format(_T("region.%s/%s"), regionOperations[i].name, size->name);
+      list->push_back(new RegionBenchmark(name.getString(),
+                                          regionOperations[i].operation, size));
+    }
+    for (size_t i = 0; i < sizeof(fbOperations) / sizeof(fbOperations[0]); i++) {
+      name.format(_T("framebuffer.%s/%s"), fbOperations[i].name, size->name);
+      list->push_back(new FrameBufferBenchmark(name.getString(),
+                                               fbOperations[i].operation, size));
+    }
+  }
+
+  // The source formats are the ones of the desktops, the destination ones
+  // are those the viewers ask for.
+  NamedPixelFormat formats[] = {
+    { _T("rgb32"), makePixelFormat(32, 24, 255, 255, 255, 16, 8, 0) },
+    { _T("bgr32"), makePixelFormat(32, 24, 255, 255, 255, 0, 8, 16) },
+    { _T("rgb565"), makePixelFormat(16, 16, 31, 63, 31, 11, 5, 0) },
+    { _T("bgr233"), makePixelFormat(8, 8, 7, 7, 3, 0, 3, 6) }
+  };
+  const size_t formatCount = sizeof(formats) / sizeof(formats[0]);
+  const size_t srcFormatCount = 3;
+  for (size_t s = 0; s < SCREEN_SIZE_COUNT; s++) {
+    for (size_t src = 0; src < srcFormatCount; src++) {
+      for (size_t dst = 0; dst < formatCount; dst++) {
+        if (src == dst) {
+          continue;
+        }
+        name.format(_T("pixelconverter.%s-%s/%s"), formats[src].name,
+                    formats[dst].name, SCREEN_SIZES[s].name);
+        list->push_back(new PixelConverterBenchmark(name.getString(),
+                                                    &formats[dst].format,
+                                                    &formats[src].format,
+                                                    &SCREEN_SIZES[s]));
+      }
+    }
+  }
+
+  for (size_t c = 0; c < CONTENT_TYPE_COUNT; c++) {
+    const TCHAR *contentName = BenchmarkContent::getName(CONTENT_TYPES[c]);
+    for (int level = 0; level <= 9; level++) {
+      name.format(_T("deflate.%d/%s"), level, contentName);
+      list->push_back(new ZlibBenchmark(name.getString(), false, level,
+                                        CONTENT_TYPES[c]));
+    }
+    for (int level = 0; level <= 9; level++) {
+      name.format(_T("inflate.%d/%s"), level, contentName);
+      list->push_back(new ZlibBenchmark(name.getString(), true, level,
+                                        CONTENT_TYPES[c]));
+    }
+    for (size_t s = 0; s < SCREEN_SIZE_COUNT; s++) {
+      name.format(_T("tightpalette.insert/%s/%s"), contentName,
+                  SCREEN_SIZES[s].name);
+      list->push_back(new TightPaletteBenchmark(name.getString(),
+                                                CONTENT_TYPES[c],
+                                                &SCREEN_SIZES[s]));
+    }
+  }
+
+  list->push_back(new Md5Benchmark(_T("md5/1mb")));
+
+  // Message headers, small rectangles, big encoded rectangles and raw rows.
+  list->push_back(new BufferedStreamBenchmark(_T("bufferedstream.write4"), 4, 65536));
+  list->push_back(new BufferedStreamBenchmark(_T("bufferedstream.write256"), 256, 4096));
+  list->push_back(new BufferedStreamBenchmark(_T("bufferedstream.write64k"), 65536, 16));
+  list->push_back(new BufferedStreamBenchmark(_T("bufferedstream.rows/1080p"), 0, 0));
+
+  static const struct {
+    const TCHAR *name;
+    Utf8Benchmark::Operation operation;
+  } utf8Operations[] = {
+    { _T("decode"), Utf8Benchmark::DECODE },
+    { _T("decode.system"), Utf8Benchmark::DECODE_SYSTEM },
+    { _T("encode"), Utf8Benchmark::ENCODE },
+    { _T("encode.system"), Utf8Benchmark::ENCODE_SYSTEM }
+  };
+  static const struct {
+    const TCHAR *name;
+    Utf8Benchmark::Script script;
+  } utf8Scripts[] = {
+    { _T("ascii"), Utf8Benchmark::ASCII },
+    { _T("latin"), Utf8Benchmark::LATIN },
+    { _T("cyrillic"), Utf8Benchmark::CYRILLIC },
+    { _T("cjk"), Utf8Benchmark::CJK }
+  };
+  for (size_t i = 0; i < sizeof(utf8Operations) / sizeof(utf8Operations[0]); i++) {
+    for (size_t s = 0; s < sizeof(utf8Scripts) / sizeof(utf8Scripts[0]); s++) {
+      name.format(_T("utf8.%s/%s"), utf8Operations[i].name, utf8Scripts[s].name);
+      list->push_back(new Utf8Benchmark(name.getString(),
+                                        utf8Operations[i].operation,
+                                        utf8Scripts[s].script));
+    }
+  }
+}
@@ -0,0 +1,42 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __PRIMITIVEBENCHMARKS_H__
+#define __PRIMITIVEBENCHMARKS_H__
+
+#include "Benchmark.h"
+
+#include <vector>
+
+// Benchmarks of the hot primitives of the server and the viewer: region
+// operations, frame buffer copies, pixel conversions, zlib streams, the
+// Tight palette, MD5, buffered output and UTF-8 conversion.
+class PrimitiveBenchmarks
+{
+public:
+  // Appends the benchmarks to the list, the caller deletes them.
+  static void create(std::vector<Benchmark *> *list);
+};
+
+#endif // __PRIMITIVEBENCHMARKS_H__
@@ -0,0 +1,211 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "BenchmarkRunner.h"
+#include "PrimitiveBenchmarks.h"
+
+#include "util/CpuFeatures.h"
+#include "util/Exception.h"
+#include "util/StringParser.h"
+
+#include <stdio.h>
+#include <vector>
+
+struct BenchOptions
+{
+  BenchOptions()
+  : json(false),
+    list(false),
+    pinThread(true)
+  {
+  }
+
+  BenchmarkOptions runner;
+  // Only the benchmarks with the text in the name are run, all if empty.
+  StringStorage filter;
+  StringStorage simdLevel;
+  bool json;
+  bool list;
+  bool pinThread;
+};
+
+static void printUsage()
+{
+  _ftprintf(stderr,
+    _T("Usage: micro-bench [options]\n")
+    _T("  -filter <text>        run the benchmarks with the text in the name\n")
+    _T("  -list                 print the names of the benchmarks\n")
+    _T("  -iterations <count>   fixed iterations of a repetition (calibrated)\n")
+    _T("  -mintime <ms>         calibrated time of a repetition (200)\n")
+    _T("  -repeat <count>       repetitions of a benchmark (5)\n")
+    _T("  -simd <level>         limit of the SIMD kernels: scalar, sse2,\n")
+    _T("                        ssse3, sse4.1 or avx2 (best supported)\n")
+    _T("  -json                 print JSON instead of CSV\n")
+    _T("  -nopin                do not pin the thread to one processor\n"));
+}
+
+static bool parseOptions(int argc, TCHAR *argv[], BenchOptions *options)
+{
+  for (int i = 1; i < argc; i++) {
+    const TCHAR *option = argv[i];
+    if (_tcscmp(option, _T("-json")) == 0) {
+      options->json = true;
+      continue;
+    }
+    if (_tcscmp(option, _T("-list")) == 0) {
+      options->list = true;
+      continue;
+    }
+    if (_tcscmp(option, _T("-nopin")) == 0) {
+      options->pinThread = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const TCHAR *value = argv[++i];
+    if (_tcscmp(option, _T("-filter")) == 0) {
+      options->filter.setString(value);
+    } else if (_tcscmp(option, _T("-simd")) == 0) {
+      options->simdLevel.setString(value);
+    } else {
+      unsigned int number;
+      if (!StringParser::parseUInt(value, &number)) {
+        return false;
+      }
+      if (_tcscmp(option, _T("-iterations")) == 0) {
+        options->runner.iterations = number;
+      } else if (_tcscmp(option, _T("-mintime")) == 0) {
+        options->runner.minTime = number;
+      } else if (_tcscmp(option, _T("-repeat")) == 0 && number != 0) {
+        options->runner.repetitions = number;
+      } else {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Runs the benchmarks on one processor at a high priority, so that they
+// are neither migrated nor preempted by the normal work of the system.
+static void pinThread()
+{
+  DWORD_PTR processMask, systemMask;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) &&
+      processMask != 0) {
+    DWORD_PTR mask = processMask & (~processMask + 1);
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+  }
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+}
+
+static void printResult(const Benchmark *benchmark, const BenchmarkResult *result,
+                        bool json, bool first)
+{
+  if (json) {
+    _tprintf(_T("%s    {\"benchmark\": \"%s\", \"iterations\": %u, ")
+             _T("\"repetitions\": %u, \"min_ns\": %.1f, \"median_ns\": %.1f, ")
+             _T("\"max_ns\": %.1f, \"mb_per_s\": %.1f}"),
+             first ? _T("") : _T(",\n"),
+             benchmark->getName(), result->iterations, result->repetitions,
+             result->minTime, result->medianTime, result->maxTime,
+             result->throughput);
+  } else {
+    _tprintf(_T("%s,%u,%u,%.1f,%.1f,%.1f,%.1f\n"),
+             benchmark->getName(), result->iterations, result->repetitions,
+             result->minTime, result->medianTime, result->maxTime,
+             result->throughput);
+  }
+  fflush(stdout);
+}
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  BenchOptions options;
+  if (!parseOptions(argc, argv, &options)) {
+    printUsage();
+    return 1;
+  }
+  if (!options.simdLevel.isEmpty()) {
+    int level;
+    if (!CpuFeatures::parseLevel(options.simdLevel.getString(), &level)) {
+      _ftprintf(stderr, _T("Unknown SIMD level: %s\n"),
+                options.simdLevel.getString());
+      return 1;
+    }
+    CpuFeatures::setMaxLevel(level);
+  }
+
+  std::vector<Benchmark *> benchmarks;
+  PrimitiveBenchmarks::create(&benchmarks);
+
+  int exitCode = 0;
+  if (options.list) {
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+      _tprintf(_T("%s\n"), benchmarks[i]->getName());
+    }
+  } else {
+    if (options.pinThread) {
+      pinThread();
+    }
+    StringStorage cpuDescription;
+    CpuFeatures::getDescription(&cpuDescription);
+    const TCHAR *simdName = CpuFeatures::getLevelName(CpuFeatures::getLevel());
+    if (options.json) {
+      _tprintf(_T("{\n  \"simd\": \"%s\",\n  \"cpu\": \"%s\",\n  \"results\": [\n"),
+               simdName, cpuDescription.getString());
+    } else {
+      _tprintf(_T("# simd: %s\n# cpu: %s\n"), simdName, cpuDescription.getString());
+      _tprintf(_T("benchmark,iterations,repetitions,min_ns,median_ns,max_ns,mb_per_s\n"));
+    }
+
+    BenchmarkRunner runner(&options.runner);
+    bool first = true;
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+      const TCHAR *name = benchmarks[i]->getName();
+      if (!options.filter.isEmpty() &&
+          _tcsstr(name, options.filter.getString()) == 0) {
+        continue;
+      }
+      try {
+        BenchmarkResult result;
+        runner.measure(benchmarks[i], &result);
+        printResult(benchmarks[i], &result, options.json, first);
+        first = false;
+      } catch (Exception &e) {
+        _ftprintf(stderr, _T("%s failed: %s\n"), name, e.getMessage());
+        exitCode = 1;
+      }
+    }
+    if (options.json) {
+      _tprintf(_T("\n  ]\n}\n"));
+    }
+  }
+
+  for (size_t i = 0; i < benchmarks.size(); i++) {
+    delete benchmarks[i];
+  }
+  return exitCode;
+}
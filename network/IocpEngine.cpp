@@ -0,0 +1,157 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+#include "IocpEngine.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "util/Exception.h"
+
+// State of a socket watched by IocpEngine.
+class IocpSession
+{
+public:
+  // The completion port returns this pointer, so it must go first.
+  OVERLAPPED m_overlapped;
+  SOCKET m_socket;
+  IocpListener *m_listener;
+  // Notified when the listener has returned false.
+  WindowsEvent m_stopEvent;
+};
+
+// A worker thread of IocpEngine.
+class IocpWorker : public Thread
+{
+public:
+  IocpWorker(IocpEngine *engine)
+  : m_engine(engine)
+  {
+    resume();
+  }
+
+  virtual ~IocpWorker()
+  {
+    wait();
+  }
+
+protected:
+  virtual void execute()
+  {
+    m_engine->processCompletions();
+  }
+
+  IocpEngine *m_engine;
+};
+
+IocpEngine::IocpEngine(unsigned int numThreads)
+{
+  if (numThreads == 0) {
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    numThreads = 2 * sysInfo.dwNumberOfProcessors;
+  }
+  m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, numThreads);
+  if (m_port == 0) {
+    throw Exception(_T("Failed to create an I/O completion port"));
+  }
+  for (unsigned int i = 0; i < numThreads; i++) {
+    m_workers.push_back(new IocpWorker(this));
+  }
+}
+
+IocpEngine::~IocpEngine()
+{
+  // A completion without a session tells a worker to exit.
+  for (size_t i = 0; i < m_workers.size(); i++) {
+    PostQueuedCompletionStatus(m_port, 0, 0, 0);
+  }
+  std::vector<IocpWorker *>::iterator i;
+  for (i = m_workers.begin(); i != m_workers.end(); i++) {
+    delete *i;
+  }
+  CloseHandle(m_port);
+}
+
+IocpSession *IocpEngine::addSocket(SocketIPv4 *socket, IocpListener *listener)
+{
+  IocpSession *session = new IocpSession;
+  session->m_socket = socket->m_socket;
+  session->m_listener = listener;
+  if (CreateIoCompletionPort((HANDLE)session->m_socket, m_port,
+                             (ULONG_PTR)session, 0) == 0) {
+    delete session;
+    throw Exception(_T("Failed to add a socket to the I/O completion port"));
+  }
+  postReceive(session);
+  return session;
+}
+
+void IocpEngine::removeSocket(IocpSession *session)
+{
+  session->m_stopEvent.waitForEvent();
+  delete session;
+}
+
+void IocpEngine::postReceive(IocpSession *session)
+{
+  memset(&session->m_overlapped, 0, sizeof(session->m_overlapped));
+  WSABUF buffer;
+  buffer.buf = 0;
+  buffer.len = 0;
+  DWORD received = 0;
+  DWORD flags = 0;
+  if (WSARecv(session->m_socket, &buffer, 1, &received, &flags,
+              &session->m_overlapped, 0) == SOCKET_ERROR &&
+      WSAGetLastError() != WSA_IO_PENDING) {
+    // Nothing will be queued for a failed receive, so queue the completion
+    // here. The listener will see the error by itself.
+    PostQueuedCompletionStatus(m_port, 0, (ULONG_PTR)session,
+                               &session->m_overlapped);
+  }
+}
+
+void IocpEngine::processCompletions()
+{
+  while (true) {
+    DWORD transferred = 0;
+    ULONG_PTR key = 0;
+    OVERLAPPED *overlapped = 0;
+    // Failed receives are reported to the listeners the same way as
+    // arrived data, so the result is not checked.
+    GetQueuedCompletionStatus(m_port, &transferred, &key, &overlapped,
+                              INFINITE);
+    if (overlapped == 0) {
+      return;
+    }
+    IocpSession *session = (IocpSession *)key;
+    bool keepWatching = false;
+    try {
+      keepWatching = session->m_listener->onSocketReadable();
+    } catch (...) {
+    }
+    if (keepWatching) {
+      postReceive(session);
+    } else {
+      session->m_stopEvent.notify();
+    }
+  }
+}
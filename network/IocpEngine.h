@@ -0,0 +1,99 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+#ifndef __IOCPENGINE_H__
+#define __IOCPENGINE_H__
+
+#include "util/CommonHeader.h"
+#include "socket/SocketIPv4.h"
+#include "IocpListener.h"
+
+#include <vector>
+
+class IocpSession;
+class IocpWorker;
+
+/**
+ * Network engine watching a number of sockets with one I/O completion
+ * port and a small pool of worker threads.
+ *
+ * For each watched socket, a zero-byte overlapped WSARecv() is kept
+ * pending, so an idle socket costs neither a thread nor a pinned receive
+ * buffer. When data arrive, a worker calls the listener of the socket,
+ * which reads the data with ordinary blocking calls and returns, and the
+ * receive is posted again.
+ *
+ * @remark a listener blocks its worker while it reads, so a peer sending
+ * a message slowly keeps one worker busy until the message is complete.
+ */
+class IocpEngine
+{
+  friend class IocpWorker;
+
+public:
+  /**
+   * Creates the engine with the given number of worker threads.
+   * @param numThreads number of workers, 0 means twice the number of
+   * processors in the system.
+   * @throws Exception if the completion port cannot be created.
+   */
+  IocpEngine(unsigned int numThreads);
+  /**
+   * Stops the workers. All the sockets must have been removed already.
+   */
+  virtual ~IocpEngine();
+
+  /**
+   * Starts watching the socket.
+   * @param socket socket to watch, must outlive the returned session. A
+   * socket can be added to one engine once in its life.
+   * @param listener listener to be called when data arrive.
+   * @return session to be passed to removeSocket().
+   * @throws Exception if the socket cannot be added.
+   */
+  IocpSession *addSocket(SocketIPv4 *socket, IocpListener *listener);
+
+  /**
+   * Waits until the listener of the session has returned false and
+   * destroys the session.
+   * @remark if the socket is still open and its listener does not stop,
+   * this function will wait for the next data or for socket failure.
+   */
+  void removeSocket(IocpSession *session);
+
+protected:
+  // Posts the zero-byte receive for the session.
+  void postReceive(IocpSession *session);
+  // Waits for completions and calls the listeners, executed by workers.
+  void processCompletions();
+
+  HANDLE m_port;
+  std::vector<IocpWorker *> m_workers;
+
+private:
+  // Do not allow copying objects.
+  IocpEngine(const IocpEngine &other);
+  IocpEngine &operator=(const IocpEngine &other);
+};
+
+#endif // __IOCPENGINE_H__
@@ -0,0 +1,133 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ReadAheadInputStream.h"
+
+#include "thread/AutoLock.h"
+#include "io-lib/IOException.h"
+
+#include <algorithm>
+
+ReadAheadInputStream::ReadAheadInputStream(InputStream *input,
+                                           size_t maxBuffered)
+: m_input(input),
+  m_ring(std::max(maxBuffered, CHUNK_SIZE)),
+  m_start(0),
+  m_size(0),
+  m_closed(false)
+{
+  resume();
+}
+
+ReadAheadInputStream::~ReadAheadInputStream()
+{
+  terminate();
+  wait();
+}
+
+size_t ReadAheadInputStream::read(void *buffer, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+  while (true) {
+    {
+      AutoLock al(&m_lock);
+      if (m_size > 0) {
+        size_t count = get((char *)buffer, len);
+        m_spaceEvent.notify();
+        return count;
+      }
+      if (m_closed) {
+        throw IOException(m_error.getString());
+      }
+    }
+    m_dataEvent.waitForEvent();
+  }
+}
+
+size_t ReadAheadInputStream::available()
+{
+  AutoLock al(&m_lock);
+  return m_size;
+}
+
+void ReadAheadInputStream::execute()
+{
+  std::vector<char> chunk(CHUNK_SIZE);
+  StringStorage error(_T("The stream has been closed"));
+  try {
+    while (!isTerminating()) {
+      size_t space;
+      {
+        AutoLock al(&m_lock);
+        space = m_ring.size() - m_size;
+      }
+      if (space == 0) {
+        m_spaceEvent.waitForEvent();
+        continue;
+      }
+      size_t count = m_input->read(&chunk.front(), std::min(space, chunk.size()));
+      {
+        AutoLock al(&m_lock);
+        put(&chunk.front(), count);
+      }
+      m_dataEvent.notify();
+    }
+  } catch (Exception &e) {
+    error.setString(e.getMessage());
+  }
+  {
+    AutoLock al(&m_lock);
+    m_error = error;
+    m_closed = true;
+  }
+  m_dataEvent.notify();
+}
+
+void ReadAheadInputStream::onTerminate()
+{
+  m_spaceEvent.notify();
+}
+
+void ReadAheadInputStream::put(const char *data, size_t len)
+{
+  _ASSERT(len <= m_ring.size() - m_size);
+  size_t end = (m_start + m_size) % m_ring.size();
+  size_t first = std::min(len, m_ring.size() - end);
+  memcpy(&m_ring[end], data, first);
+  memcpy(&m_ring[0], data + first, len - first);
+  m_size += len;
+}
+
+size_t ReadAheadInputStream::get(char *data, size_t len)
+{
+  len = std::min(len, m_size);
+  size_t first = std::min(len, m_ring.size() - m_start);
+  memcpy(data, &m_ring[m_start], first);
+  memcpy(data + first, &m_ring[0], len - first);
+  m_start = (m_start + len) % m_ring.size();
+  m_size -= len;
+  return len;
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __READAHEADINPUTSTREAM_H__
+#define __READAHEADINPUTSTREAM_H__
+
+#include "io-lib/InputStream.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/StringStorage.h"
+
+#include <vector>
+
+/**
+ * Input stream that drains another stream from its own thread into a
+ * bounded ring buffer.
+ *
+ * While the owner of the stream is busy processing data (e.g. decoding
+ * a big rectangle), the source is kept being read, so the sender is not
+ * throttled by a full receive window.
+ *
+ * @remark the source must be closed or shut down before the destruction
+ * of this object, otherwise the destructor waits for the reading thread
+ * blocked in the source.
+ */
+class ReadAheadInputStream : public InputStream, private Thread
+{
+public:
+  /**
+   * Creates the stream and starts reading from input.
+   * @param input source stream, must outlive this object.
+   * @param maxBuffered maximum number of bytes read ahead.
+   */
+  ReadAheadInputStream(InputStream *input,
+                       size_t maxBuffered = DEFAULT_MAX_BUFFERED);
+  virtual ~ReadAheadInputStream();
+
+  /**
+   * Returns buffered bytes, waiting for some if there are none.
+   * @throws IOException when the source has failed and all its data
+   * have been read.
+   */
+  virtual size_t read(void *buffer, size_t len);
+
+  /**
+   * Returns the number of bytes available without waiting.
+   */
+  virtual size_t available();
+
+  static const size_t DEFAULT_MAX_BUFFERED = 4 * 1024 * 1024;
+
+protected:
+  // Inherited from Thread.
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // Ring buffer operations, must be called with m_lock locked.
+  void put(const char *data, size_t len);
+  size_t get(char *data, size_t len);
+
+  InputStream *m_input;
+
+  LocalMutex m_lock;
+  std::vector<char> m_ring;
+  size_t m_start;
+  size_t m_size;
+  // Set when the reading thread has stopped, m_error tells why.
+  bool m_closed;
+  StringStorage m_error;
+
+  // Notified when data have been added or the source has failed.
+  WindowsEvent m_dataEvent;
+  // Notified when data have been taken from the ring buffer.
+  WindowsEvent m_spaceEvent;
+
+  static const size_t CHUNK_SIZE = 64 * 1024;
+};
+
+#endif // __READAHEADINPUTSTREAM_H__
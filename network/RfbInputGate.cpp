@@ -23,16 +23,27 @@
 //
 
 #include "RfbInputGate.h"
+#include <crtdbg.h>
 
 RfbInputGate::RfbInputGate(Channel *stream)
-: DataInputStream(stream)
+: DataInputStream(stream),
+  m_inflater(0)
 {
 }
 RfbInputGate::RfbInputGate(InputStream *stream)
-: DataInputStream(stream)
+: DataInputStream(stream),
+  m_inflater(0)
 {
 }
 
 RfbInputGate::~RfbInputGate()
 {
+  delete m_inflater;
+}
+
+void RfbInputGate::startDecompression()
+{
+  _ASSERT(m_inflater == 0);
+  m_inflater = new InflatingInputStream(m_inputStream);
+  m_inputStream = m_inflater;
 }
@@ -28,6 +28,7 @@
 #include "io-lib/Channel.h"
 
 #include "io-lib/DataInputStream.h"
+#include "io-lib/InflatingInputStream.h"
 
 class RfbInputGate : public DataInputStream
 {
@@ -35,6 +36,17 @@ public:
   RfbInputGate(Channel *stream);
   RfbInputGate(InputStream *stream);
   virtual ~RfbInputGate();
+
+  /**
+   * Decompresses all the data read from the gate after the call, which
+   * the peer sends as one zlib stream (see RfbOutputGate::startCompression()).
+   * Must be called right after reading the message that announces the
+   * compression.
+   */
+  void startDecompression();
+
+private:
+  InflatingInputStream *m_inflater;
 };
 
 #endif
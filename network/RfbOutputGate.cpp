@@ -24,23 +24,121 @@
 
 #include "RfbOutputGate.h"
 
+#include "thread/Thread.h"
+#include "thread/AutoLock.h"
+
 #include <exception>
 
 RfbOutputGate::RfbOutputGate(OutputStream *stream)
-: DataOutputStream(0)
+: DataOutputStream(0),
+  m_deflater(0),
+  m_pendingInput(0),
+  m_flushHolds(0)
 {
   m_tunnel = new BufferedOutputStream(stream);
+  m_recording = new RecordingOutputStream(m_tunnel);
 
   // Change real output stream for data output stream to our tunnel.
-  m_outStream = m_tunnel;
+  m_outStream = m_recording;
 }
 
 RfbOutputGate::~RfbOutputGate()
 {
+  delete m_recording;
+  delete m_deflater;
   delete m_tunnel;
 }
 
 void RfbOutputGate::flush()
 {
-  m_tunnel->flush();
+  // Writers flush with the gate locked, so the counter is stable here.
+  if (m_flushHolds == 0) {
+    flushTunnel();
+  }
+}
+
+bool RfbOutputGate::isCompressing() const
+{
+  return m_deflater != 0;
+}
+
+void RfbOutputGate::flushThrough()
+{
+  flushTunnel();
+}
+
+void RfbOutputGate::flushTunnel()
+{
+  if (m_deflater != 0) {
+    m_deflater->flush();
+  } else {
+    m_tunnel->flush();
+  }
+}
+
+void RfbOutputGate::holdFlushes()
+{
+  AutoLock al(this);
+  m_flushHolds++;
+}
+
+void RfbOutputGate::releaseFlushes()
+{
+  AutoLock al(this);
+  _ASSERT(m_flushHolds > 0);
+  if (--m_flushHolds == 0) {
+    flushTunnel();
+  }
+}
+
+void RfbOutputGate::startCompression(int level)
+{
+  _ASSERT(m_deflater == 0);
+  // The data already in the tunnel stay uncompressed and leave first.
+  m_deflater = new DeflatingOutputStream(m_tunnel, level);
+  m_recording->setOutputStream(m_deflater);
+}
+
+void RfbOutputGate::getCompressionStats(UINT64 *bytesIn, UINT64 *bytesOut,
+                                        UINT64 *deflateTime)
+{
+  AutoLock al(this);
+  if (m_deflater != 0) {
+    *bytesIn = m_deflater->getBytesIn();
+    *bytesOut = m_deflater->getBytesOut();
+    *deflateTime = m_deflater->getDeflateTime();
+  } else {
+    *bytesIn = *bytesOut = *deflateTime = 0;
+  }
+}
+
+void RfbOutputGate::startRecording()
+{
+  m_recording->startRecording();
+}
+
+void RfbOutputGate::stopRecording()
+{
+  m_recording->stopRecording();
+}
+
+const std::vector<char> *RfbOutputGate::getRecord() const
+{
+  return m_recording->getRecord();
+}
+
+void RfbOutputGate::lockForInput()
+{
+  InterlockedIncrement(&m_pendingInput);
+  lock();
+  InterlockedDecrement(&m_pendingInput);
+}
+
+void RfbOutputGate::yieldToInput()
+{
+  // The input event is written as soon as the current holder of the gate
+  // releases it, we only have to stay out of its way meanwhile.
+  while (m_pendingInput > 0) {
+    Thread::sleep(0);
+  }
 }
@@ -27,6 +27,8 @@
 
 #include "io-lib/DataOutputStream.h"
 #include "io-lib/BufferedOutputStream.h"
+#include "io-lib/RecordingOutputStream.h"
+#include "io-lib/DeflatingOutputStream.h"
 
 #include "thread/LocalMutex.h"
 
@@ -59,11 +61,138 @@ public:
    */
   virtual void flush() throw(IOException);
 
+  /**
+   * Starts keeping a copy of all the data written to the gate, as it is
+   * sent. Should be called with the gate locked, so that the copy has no
+   * data written by other threads.
+   */
+  void startRecording();
+
+  /**
+   * Stops keeping the copy of the data.
+   */
+  void stopRecording();
+
+  /**
+   * Returns data written between the last startRecording() and
+   * stopRecording() calls.
+   */
+  const std::vector<char> *getRecord() const;
+
+  /**
+   * Locks the gate for writing an input event. Until the gate is acquired,
+   * the writers of bulk data waiting in yieldToInput() stand aside, so the
+   * event waits for one message at most.
+   */
+  void lockForInput();
+
+  /**
+   * Must be called by the writers of bulk messages (file data, clipboard,
+   * update requests) before they lock the gate. Returns when no input
+   * event is waiting for the gate.
+   */
+  void yieldToInput();
+
+  /**
+   * Defers flushes until the matching releaseFlushes() call, so that a
+   * series of messages which do not wait for replies leaves in as few
+   * packets as possible. The calls can be nested.
+   * @remark: locks the gate, so it must not be called while holding a lock
+   * that writers take before locking the gate.
+   */
+  void holdFlushes();
+
+  /**
+   * Ends the period started by holdFlushes() and flushes the buffered
+   * data when the outermost hold is released.
+   * @throws IOException on error.
+   */
+  void releaseFlushes() throw(IOException);
+
+  /**
+   * Compresses all the data written to the gate after the call as one zlib
+   * stream, which is sync-flushed by every flush of the gate. Must be called
+   * with the gate locked, right after the message that announces the
+   * compression to the peer; the data written before are sent
+   * uncompressed. There is no way back.
+   * @param level zlib compression level (1..9).
+   * @throws IOException on error.
+   */
+  void startCompression(int level) throw(IOException);
+
+  /**
+   * Gets the counters of the compression: bytes written to the gate, bytes
+   * sent and microseconds spent on compressing. All are zeros if the
+   * compression has not been started.
+   */
+  void getCompressionStats(UINT64 *bytesIn, UINT64 *bytesOut,
+                           UINT64 *deflateTime);
+
+  /**
+   * Returns true if the compression has been started.
+   */
+  bool isCompressing() const;
+
+  /**
+   * Passes all the buffered data to the real output stream, even while
+   * the flushes are held, so that data can be written to the connection
+   * past the gate. Must be called with the gate locked.
+   * @throws IOException on error.
+   */
+  void flushThrough() throw(IOException);
+
 private:
+  /**
+   * Flushes the compressor, if any, and the tunnel.
+   */
+  void flushTunnel() throw(IOException);
+
   /**
    * Tunnel that adds buffering.
    */
   BufferedOutputStream *m_tunnel;
+
+  /**
+   * Keeps the copy of the data passed to the tunnel.
+   */
+  RecordingOutputStream *m_recording;
+
+  /**
+   * Compressor between the recording and the tunnel, 0 until
+   * startCompression() is called.
+   */
+  DeflatingOutputStream *m_deflater;
+
+  /**
+   * Number of input events waiting for the gate.
+   */
+  volatile LONG m_pendingInput;
+
+  /**
+   * Depth of holdFlushes() calls. Accessed with the gate locked.
+   */
+  int m_flushHolds;
+};
+
+/**
+ * Locks the output gate for an input event within the scope.
+ */
+class InputAutoLock
+{
+public:
+  InputAutoLock(RfbOutputGate *gate)
+  : m_gate(gate)
+  {
+    m_gate->lockForInput();
+  }
+
+  virtual ~InputAutoLock()
+  {
+    m_gate->unlock();
+  }
+
+protected:
+  RfbOutputGate *m_gate;
 };
 
 #endif
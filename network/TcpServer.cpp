@@ -26,9 +26,34 @@
 
 #include "network/socket/SocketAddressIPv4.h"
 
+// An extra thread accepting connections of a TcpServer.
+class TcpAcceptThread : public Thread
+{
+public:
+  TcpAcceptThread(TcpServer *server)
+  : m_server(server)
+  {
+  }
+
+  virtual ~TcpAcceptThread()
+  {
+    terminate();
+    wait();
+  }
+
+protected:
+  virtual void execute()
+  {
+    m_server->acceptConnections();
+  }
+
+  TcpServer *m_server;
+};
+
 TcpServer::TcpServer(const TCHAR *bindHost, unsigned short bindPort,
                      bool autoStart,
-                     bool lockAddr)
+                     bool lockAddr,
+                     unsigned int numAcceptThreads)
 : m_bindHost(bindHost), m_bindPort(bindPort)
 {
   SocketAddressIPv4 bindAddr = SocketAddressIPv4::resolve(bindHost, bindPort);
@@ -38,7 +63,14 @@ TcpServer::TcpServer(const TCHAR *bindHost, unsigned short bindPort,
   }
 
   m_listenSocket.bind(bindAddr);
-  m_listenSocket.listen(10);
+  m_listenSocket.listen(LISTEN_BACKLOG);
+
+  if (numAcceptThreads > 1) {
+    m_listenSocket.enableSharedAccept();
+    for (unsigned int i = 1; i < numAcceptThreads; i++) {
+      m_acceptThreads.push_back(new TcpAcceptThread(this));
+    }
+  }
 
   if (autoStart) {
     start();
@@ -54,6 +86,10 @@ TcpServer::~TcpServer()
     Thread::terminate();
     Thread::wait();
   }
+  std::vector<TcpAcceptThread *>::iterator i;
+  for (i = m_acceptThreads.begin(); i != m_acceptThreads.end(); i++) {
+    delete *i;
+  }
 }
 
 const TCHAR *TcpServer::getBindHost() const
@@ -69,9 +105,18 @@ unsigned short TcpServer::getBindPort() const
 void TcpServer::start()
 {
   resume();
+  std::vector<TcpAcceptThread *>::iterator i;
+  for (i = m_acceptThreads.begin(); i != m_acceptThreads.end(); i++) {
+    (*i)->resume();
+  }
 }
 
 void TcpServer::execute()
+{
+  acceptConnections();
+}
+
+void TcpServer::acceptConnections()
 {
   while (!isTerminating()) {
     SocketIPv4 *clientSocket = NULL;
@@ -29,6 +29,10 @@
 #include "util/Exception.h"
 #include "network/socket/SocketIPv4.h"
 
+#include <vector>
+
+class TcpAcceptThread;
+
 /**
  * Abstract multithreaded TCP server class.
  * Bind on specified host and port and listening for connections,
@@ -38,6 +42,8 @@
  */
 class TcpServer : private Thread
 {
+  friend class TcpAcceptThread;
+
 public:
   /**
    * Creates new TcpServer that listens for incoming connection after creation.
@@ -46,12 +52,16 @@ public:
    * @param bool autoStart if true, then server starts listening for incoming connections
    * in it's own thread, if false, then you must call protected start() method later from subclass.
    * @param lockAddr determinates if need to lock adress to other processes cannot reuse it.
+   * @param numAcceptThreads number of threads accepting connections, more
+   * than one lets a burst of connections be accepted in parallel. With more
+   * than one thread, onAcceptConnection() must be thread-safe.
    * @throws Exception if fail to create tcp server.
    */
   TcpServer(const TCHAR *bindHost,
             unsigned short bindPort,
             bool autoStart = false,
-            bool lockAddr = false) throw(Exception);
+            bool lockAddr = false,
+            unsigned int numAcceptThreads = 1) throw(Exception);
   /**
    * Closes listening socket, terminates tcp server thread and
    * deletes tcp server object.
@@ -86,11 +96,21 @@ protected:
    */
   virtual void execute();
 
+  /**
+   * Accepts connections until the listening socket is closed, executed by
+   * all the accepting threads.
+   */
+  void acceptConnections();
+
 private:
   /**
    * Listening socket.
    */
   SocketIPv4 m_listenSocket;
+  /**
+   * Accepting threads in addition to the own thread of the server.
+   */
+  std::vector<TcpAcceptThread *> m_acceptThreads;
   /**
    * Host to bind.
    */
@@ -99,6 +119,11 @@ private:
    * Port to bind.
    */
   unsigned short m_bindPort;
+
+  /**
+   * Maximum length of the queue of connections not accepted yet.
+   */
+  static const int LISTEN_BACKLOG = SOMAXCONN;
 };
 
 #endif
@@ -0,0 +1,545 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TlsStream.h"
+#include "thread/AutoLock.h"
+
+#include <wincrypt.h>
+
+#pragma comment(lib, "secur32.lib")
+#pragma comment(lib, "crypt32.lib")
+
+// Credentials shared by all the streams of the process, SChannel keeps its
+// session cache per credentials.
+class TlsCredentials
+{
+public:
+  // Returns 0 if the server certificate cannot be made.
+  static CredHandle *getServer();
+  // Returns 0 if SChannel is not available.
+  static CredHandle *getClient();
+
+private:
+  // Makes a self-signed certificate with the key kept in the machine key
+  // set, or in the user one if the machine key set is not writable.
+  static PCCERT_CONTEXT createCertificate();
+  static bool acquire(bool isServer, PCCERT_CONTEXT cert, CredHandle *handle);
+
+  static LocalMutex s_lock;
+  static bool s_serverTried;
+  static bool s_clientTried;
+  static bool s_hasServer;
+  static bool s_hasClient;
+  static CredHandle s_server;
+  static CredHandle s_client;
+};
+
+LocalMutex TlsCredentials::s_lock;
+bool TlsCredentials::s_serverTried = false;
+bool TlsCredentials::s_clientTried = false;
+bool TlsCredentials::s_hasServer = false;
+bool TlsCredentials::s_hasClient = false;
+CredHandle TlsCredentials::s_server;
+CredHandle TlsCredentials::s_client;
+
+CredHandle *TlsCredentials::getServer()
+{
+  AutoLock al(&s_lock);
+  if (!s_serverTried) {
+    s_serverTried = true;
+    PCCERT_CONTEXT cert = createCertificate();
+    if (cert != 0) {
+      s_hasServer = acquire(true, cert, &s_server);
+      // The credentials keep their own reference.
+      CertFreeCertificateContext(cert);
+    }
+  }
+  return s_hasServer ? &s_server : 0;
+}
+
+CredHandle *TlsCredentials::getClient()
+{
+  AutoLock al(&s_lock);
+  if (!s_clientTried) {
+    s_clientTried = true;
+    s_hasClient = acquire(false, 0, &s_client);
+  }
+  return s_hasClient ? &s_client : 0;
+}
+
+PCCERT_CONTEXT TlsCredentials::createCertificate()
+{
+  WCHAR containerName[] = L"TightVNC Server TLS";
+  WCHAR providerName[] = MS_ENH_RSA_AES_PROV_W;
+  const DWORD keySetFlags[] = { CRYPT_MACHINE_KEYSET, 0 };
+
+  for (size_t i = 0; i < sizeof(keySetFlags) / sizeof(keySetFlags[0]); i++) {
+    HCRYPTPROV provider;
+    if (!CryptAcquireContextW(&provider, containerName, providerName,
+                              PROV_RSA_AES, keySetFlags[i]) &&
+        !CryptAcquireContextW(&provider, containerName, providerName,
+                              PROV_RSA_AES, keySetFlags[i] | CRYPT_NEWKEYSET)) {
+      continue;
+    }
+    // The key survives the restarts, so does the identity of the server.
+    HCRYPTKEY key;
+    if (!CryptGetUserKey(provider, AT_KEYEXCHANGE, &key) &&
+        !CryptGenKey(provider, AT_KEYEXCHANGE, 2048 << 16, &key)) {
+      CryptReleaseContext(provider, 0);
+      continue;
+    }
+    CryptDestroyKey(key);
+
+    BYTE nameData[256];
+    CERT_NAME_BLOB subject;
+    subject.pbData = nameData;
+    subject.cbData = sizeof(nameData);
+    if (!CertStrToNameW(X509_ASN_ENCODING, L"CN=TightVNC Server",
+                        CERT_X500_NAME_STR, 0,
+                        subject.pbData, &subject.cbData, 0)) {
+      CryptReleaseContext(provider, 0);
+      return 0;
+    }
+
+    CRYPT_KEY_PROV_INFO keyInfo;
+    memset(&keyInfo, 0, sizeof(keyInfo));
+    keyInfo.pwszContainerName = containerName;
+    keyInfo.pwszProvName = providerName;
+    keyInfo.dwProvType = PROV_RSA_AES;
+    keyInfo.dwFlags = keySetFlags[i];
+    keyInfo.dwKeySpec = AT_KEYEXCHANGE;
+
+    CRYPT_ALGORITHM_IDENTIFIER signature;
+    memset(&signature, 0, sizeof(signature));
+    signature.pszObjId = szOID_RSA_SHA256RSA;
+
+    SYSTEMTIME expiry;
+    GetSystemTime(&expiry);
+    expiry.wYear += 10;
+
+    PCCERT_CONTEXT cert = CertCreateSelfSignCertificate(provider, &subject, 0,
+                                                        &keyInfo, &signature,
+                                                        0, &expiry, 0);
+    CryptReleaseContext(provider, 0);
+    if (cert != 0) {
+      return cert;
+    }
+  }
+  return 0;
+}
+
+bool TlsCredentials::acquire(bool isServer, PCCERT_CONTEXT cert,
+                             CredHandle *handle)
+{
+  SCHANNEL_CRED cred;
+  memset(&cred, 0, sizeof(cred));
+  cred.dwVersion = SCHANNEL_CRED_VERSION;
+  cred.dwFlags = SCH_USE_STRONG_CRYPTO;
+  if (isServer) {
+    cred.grbitEnabledProtocols = SP_PROT_TLS1_2_SERVER;
+    cred.cCreds = 1;
+    cred.paCred = &cert;
+  } else {
+    cred.grbitEnabledProtocols = SP_PROT_TLS1_2_CLIENT;
+    // The server certificate is self-signed, its thumbprint is logged
+    // instead of validating it.
+    cred.dwFlags |= SCH_CRED_MANUAL_CRED_VALIDATION | SCH_CRED_NO_DEFAULT_CREDS;
+  }
+  TimeStamp expiry;
+  SECURITY_STATUS status = AcquireCredentialsHandleW(
+    0, UNISP_NAME_W, isServer ? SECPKG_CRED_INBOUND : SECPKG_CRED_OUTBOUND,
+    0, &cred, 0, 0, handle, &expiry);
+  return status == SEC_E_OK;
+}
+
+TlsStream::TlsStream(InputStream *input, OutputStream *output)
+: m_input(input),
+  m_output(output),
+  m_isStarted(false),
+  m_hasContext(false),
+  m_inLength(0),
+  m_plain(0),
+  m_plainLength(0),
+  m_extraLength(0)
+{
+  memset(&m_context, 0, sizeof(m_context));
+  memset(&m_sizes, 0, sizeof(m_sizes));
+}
+
+TlsStream::~TlsStream()
+{
+  if (m_hasContext) {
+    DeleteSecurityContext(&m_context);
+  }
+}
+
+bool TlsStream::isServerAvailable()
+{
+  return TlsCredentials::getServer() != 0;
+}
+
+void TlsStream::startTls(bool isServer, const TCHAR *targetName)
+{
+  CredHandle *credentials = isServer ? TlsCredentials::getServer() :
+                                       TlsCredentials::getClient();
+  if (credentials == 0) {
+    throw IOException(_T("TLS credentials are not available"));
+  }
+  m_inBuffer.resize(HANDSHAKE_BUFFER_SIZE);
+  handshake(credentials, isServer, targetName);
+
+  if (QueryContextAttributes(&m_context, SECPKG_ATTR_STREAM_SIZES,
+                             &m_sizes) != SEC_E_OK) {
+    throw IOException(_T("Cannot get the TLS record sizes"));
+  }
+  size_t recordSize = m_sizes.cbHeader + m_sizes.cbMaximumMessage +
+                      m_sizes.cbTrailer;
+  if (m_inBuffer.size() < recordSize) {
+    m_inBuffer.resize(recordSize);
+  }
+  m_isStarted = true;
+}
+
+bool TlsStream::isStarted() const
+{
+  return m_isStarted;
+}
+
+void TlsStream::handshake(CredHandle *credentials, bool isServer,
+                          const TCHAR *targetName)
+{
+  StringStorage target(targetName != 0 ? targetName : _T(""));
+  DWORD flags = ISC_REQ_SEQUENCE_DETECT | ISC_REQ_REPLAY_DETECT |
+                ISC_REQ_CONFIDENTIALITY | ISC_REQ_ALLOCATE_MEMORY |
+                ISC_REQ_EXTENDED_ERROR | ISC_REQ_STREAM;
+  if (isServer) {
+    flags = ASC_REQ_SEQUENCE_DETECT | ASC_REQ_REPLAY_DETECT |
+            ASC_REQ_CONFIDENTIALITY | ASC_REQ_ALLOCATE_MEMORY |
+            ASC_REQ_EXTENDED_ERROR | ASC_REQ_STREAM;
+    // The client speaks first.
+    readInput(m_inBuffer.size());
+  }
+
+  while (true) {
+    SecBuffer inBuffers[2];
+    inBuffers[0].BufferType = SECBUFFER_TOKEN;
+    inBuffers[0].pvBuffer = &m_inBuffer.front();
+    inBuffers[0].cbBuffer = (unsigned long)m_inLength;
+    inBuffers[1].BufferType = SECBUFFER_EMPTY;
+    inBuffers[1].pvBuffer = 0;
+    inBuffers[1].cbBuffer = 0;
+    SecBufferDesc inDesc = { SECBUFFER_VERSION, 2, inBuffers };
+
+    SecBuffer outBuffer = { 0, SECBUFFER_TOKEN, 0 };
+    SecBufferDesc outDesc = { SECBUFFER_VERSION, 1, &outBuffer };
+
+    DWORD attributes;
+    TimeStamp expiry;
+    SECURITY_STATUS status;
+    if (isServer) {
+      status = AcceptSecurityContext(credentials,
+                                     m_hasContext ? &m_context : 0,
+                                     &inDesc, flags, 0, &m_context,
+                                     &outDesc, &attributes, &expiry);
+    } else {
+      status = InitializeSecurityContext(credentials,
+                                         m_hasContext ? &m_context : 0,
+                                         (TCHAR *)target.getString(),
+                                         flags, 0, 0,
+                                         m_hasContext ? &inDesc : 0, 0,
+                                         &m_context, &outDesc, &attributes,
+                                         &expiry);
+    }
+    if (status == SEC_E_INCOMPLETE_MESSAGE) {
+      readInput(m_inBuffer.size() - m_inLength);
+      continue;
+    }
+    if (status == SEC_E_OK || status == SEC_I_CONTINUE_NEEDED) {
+      m_hasContext = true;
+    }
+    if (outBuffer.cbBuffer != 0 && outBuffer.pvBuffer != 0) {
+      try {
+        writeFully((const char *)outBuffer.pvBuffer, outBuffer.cbBuffer);
+        m_output->flush();
+      } catch (...) {
+        FreeContextBuffer(outBuffer.pvBuffer);
+        throw;
+      }
+      FreeContextBuffer(outBuffer.pvBuffer);
+    }
+    if (status != SEC_E_OK && status != SEC_I_CONTINUE_NEEDED) {
+      StringStorage error;
+      error.format(_T("TLS handshake has failed (0x%08X)"), (unsigned int)status);
+      throw IOException(error.getString());
+    }
+
+    // The data after the handshake message are kept, they may be the next
+    // message or, when the handshake is done, the first record.
+    if (m_hasContext && inBuffers[1].BufferType == SECBUFFER_EXTRA) {
+      size_t extra = inBuffers[1].cbBuffer;
+      memmove(&m_inBuffer.front(), &m_inBuffer[m_inLength - extra], extra);
+      m_inLength = extra;
+    } else {
+      m_inLength = 0;
+    }
+    if (status == SEC_E_OK) {
+      return;
+    }
+    if (m_inLength == 0) {
+      readInput(m_inBuffer.size());
+    }
+  }
+}
+
+void TlsStream::getDescription(StringStorage *desc)
+{
+  SecPkgContext_ConnectionInfo info;
+  memset(&info, 0, sizeof(info));
+  QueryContextAttributes(&m_context, SECPKG_ATTR_CONNECTION_INFO, &info);
+  SecPkgContext_SessionInfo session;
+  memset(&session, 0, sizeof(session));
+  QueryContextAttributes(&m_context, SECPKG_ATTR_SESSION_INFO, &session);
+
+  StringStorage thumbprint(_T("unknown"));
+  PCCERT_CONTEXT cert = 0;
+  if (QueryContextAttributes(&m_context, SECPKG_ATTR_REMOTE_CERT_CONTEXT,
+                             &cert) != SEC_E_OK) {
+    QueryContextAttributes(&m_context, SECPKG_ATTR_LOCAL_CERT_CONTEXT, &cert);
+  }
+  if (cert != 0) {
+    BYTE hash[20];
+    DWORD hashSize = sizeof(hash);
+    if (CertGetCertificateContextProperty(cert, CERT_SHA1_HASH_PROP_ID,
+                                          hash, &hashSize)) {
+      thumbprint.setString(_T(""));
+      for (DWORD i = 0; i < hashSize; i++) {
+        StringStorage byteString;
+        byteString.format(_T("%02X"), (unsigned int)hash[i]);
+        thumbprint.appendString(byteString.getString());
+      }
+    }
+    CertFreeCertificateContext(cert);
+  }
+
+  desc->format(_T("protocol 0x%X, cipher 0x%X (%u bits), %s session, ")
+               _T("server certificate SHA-1 %s"),
+               (unsigned int)info.dwProtocol, (unsigned int)info.aiCipher,
+               (unsigned int)info.dwCipherStrength,
+               (session.dwFlags & SSL_SESSION_RECONNECT) != 0 ?
+                 _T("resumed") : _T("new"),
+               thumbprint.getString());
+}
+
+size_t TlsStream::read(void *buffer, size_t len)
+{
+  if (!m_isStarted) {
+    return m_input->read(buffer, len);
+  }
+  if (len == 0) {
+    return 0;
+  }
+  while (m_plainLength == 0) {
+    if (!decryptRecord()) {
+      readInput(m_inBuffer.size() - m_inLength);
+    }
+  }
+  size_t count = len < m_plainLength ? len : m_plainLength;
+  memcpy(buffer, m_plain, count);
+  m_plain += count;
+  m_plainLength -= count;
+  if (m_plainLength == 0) {
+    dropRecord();
+  }
+  return count;
+}
+
+size_t TlsStream::available()
+{
+  if (!m_isStarted) {
+    return m_input->available();
+  }
+  if (m_plainLength == 0 && !decryptRecord()) {
+    // The records already received must be reported, the transport will
+    // not report them again.
+    size_t count = m_input->available();
+    if (count != 0) {
+      size_t free = m_inBuffer.size() - m_inLength;
+      readInput(count < free ? count : free);
+      decryptRecord();
+    }
+  }
+  return m_plainLength;
+}
+
+void TlsStream::readInput(size_t maxLen)
+{
+  if (maxLen == 0) {
+    throw IOException(_T("TLS record does not fit the buffer"));
+  }
+  m_inLength += m_input->read(&m_inBuffer[m_inLength], maxLen);
+}
+
+bool TlsStream::decryptRecord()
+{
+  // Empty records are skipped.
+  while (m_plainLength == 0 && m_inLength != 0) {
+    SecBuffer buffers[4];
+    buffers[0].BufferType = SECBUFFER_DATA;
+    buffers[0].pvBuffer = &m_inBuffer.front();
+    buffers[0].cbBuffer = (unsigned long)m_inLength;
+    for (int i = 1; i < 4; i++) {
+      buffers[i].BufferType = SECBUFFER_EMPTY;
+      buffers[i].pvBuffer = 0;
+      buffers[i].cbBuffer = 0;
+    }
+    SecBufferDesc desc = { SECBUFFER_VERSION, 4, buffers };
+
+    SECURITY_STATUS status = DecryptMessage(&m_context, &desc, 0, 0);
+    if (status == SEC_E_INCOMPLETE_MESSAGE) {
+      return false;
+    }
+    if (status == SEC_I_CONTEXT_EXPIRED) {
+      throw IOException(_T("TLS session has been closed by the peer"));
+    }
+    if (status != SEC_E_OK) {
+      // Renegotiation included, our peers never ask for it.
+      StringStorage error;
+      error.format(_T("Cannot decrypt TLS record (0x%08X)"), (unsigned int)status);
+      throw IOException(error.getString());
+    }
+    m_extraLength = 0;
+    for (int i = 1; i < 4; i++) {
+      if (buffers[i].BufferType == SECBUFFER_DATA) {
+        m_plain = (char *)buffers[i].pvBuffer;
+        m_plainLength = buffers[i].cbBuffer;
+      } else if (buffers[i].BufferType == SECBUFFER_EXTRA) {
+        m_extraLength = buffers[i].cbBuffer;
+      }
+    }
+    if (m_plainLength == 0) {
+      dropRecord();
+    }
+  }
+  return m_plainLength != 0;
+}
+
+void TlsStream::dropRecord()
+{
+  if (m_extraLength != 0) {
+    memmove(&m_inBuffer.front(), &m_inBuffer[m_inLength - m_extraLength],
+            m_extraLength);
+  }
+  m_inLength = m_extraLength;
+  m_extraLength = 0;
+  m_plain = 0;
+}
+
+size_t TlsStream::write(const void *buffer, size_t len)
+{
+  return writeGather(buffer, len, 0, 0);
+}
+
+size_t TlsStream::writeGather(const void *first, size_t firstLen,
+                              const void *second, size_t secondLen)
+{
+  if (!m_isStarted) {
+    return m_output->writeGather(first, firstLen, second, secondLen);
+  }
+  if (firstLen + secondLen == 0) {
+    return 0;
+  }
+  AutoLock al(&m_writeLock);
+
+  size_t maxMessage = m_sizes.cbMaximumMessage;
+  size_t total = firstLen + secondLen;
+  if (total > maxMessage * MAX_RECORDS_PER_WRITE) {
+    total = maxMessage * MAX_RECORDS_PER_WRITE;
+  }
+  size_t numRecords = (total + maxMessage - 1) / maxMessage;
+  size_t maxRecord = m_sizes.cbHeader + maxMessage + m_sizes.cbTrailer;
+  if (m_outBuffer.size() < numRecords * maxRecord) {
+    m_outBuffer.resize(numRecords * maxRecord);
+  }
+
+  // The records are encrypted in place, one after another. The plain text
+  // copied to them is the only copy of the data.
+  const char *firstData = (const char *)first;
+  const char *secondData = (const char *)second;
+  size_t outLength = 0;
+  size_t done = 0;
+  while (done < total) {
+    size_t length = total - done < maxMessage ? total - done : maxMessage;
+    char *record = &m_outBuffer[outLength];
+    char *data = record + m_sizes.cbHeader;
+    size_t fromFirst = 0;
+    if (done < firstLen) {
+      fromFirst = firstLen - done < length ? firstLen - done : length;
+      memcpy(data, firstData + done, fromFirst);
+    }
+    if (fromFirst < length) {
+      memcpy(data + fromFirst, secondData + (done + fromFirst - firstLen),
+             length - fromFirst);
+    }
+
+    SecBuffer buffers[4];
+    buffers[0].BufferType = SECBUFFER_STREAM_HEADER;
+    buffers[0].pvBuffer = record;
+    buffers[0].cbBuffer = m_sizes.cbHeader;
+    buffers[1].BufferType = SECBUFFER_DATA;
+    buffers[1].pvBuffer = data;
+    buffers[1].cbBuffer = (unsigned long)length;
+    buffers[2].BufferType = SECBUFFER_STREAM_TRAILER;
+    buffers[2].pvBuffer = data + length;
+    buffers[2].cbBuffer = m_sizes.cbTrailer;
+    buffers[3].BufferType = SECBUFFER_EMPTY;
+    buffers[3].pvBuffer = 0;
+    buffers[3].cbBuffer = 0;
+    SecBufferDesc desc = { SECBUFFER_VERSION, 4, buffers };
+
+    SECURITY_STATUS status = EncryptMessage(&m_context, 0, &desc, 0);
+    if (status != SEC_E_OK) {
+      StringStorage error;
+      error.format(_T("Cannot encrypt TLS record (0x%08X)"), (unsigned int)status);
+      throw IOException(error.getString());
+    }
+    outLength += buffers[0].cbBuffer + buffers[1].cbBuffer +
+                 buffers[2].cbBuffer;
+    done += length;
+  }
+  writeFully(&m_outBuffer.front(), outLength);
+  return total;
+}
+
+void TlsStream::close()
+{
+}
+
+void TlsStream::writeFully(const char *data, size_t len)
+{
+  while (len != 0) {
+    size_t written = m_output->write(data, len);
+    data += written;
+    len -= written;
+  }
+}
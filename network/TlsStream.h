@@ -0,0 +1,160 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __TLSSTREAM_H__
+#define __TLSSTREAM_H__
+
+#include "util/CommonHeader.h"
+#include "io-lib/Channel.h"
+#include "thread/LocalMutex.h"
+#include "util/StringStorage.h"
+
+#define SECURITY_WIN32
+#include <security.h>
+#include <schannel.h>
+
+#include <vector>
+
+/**
+ * TLS layer of an RFB connection, made with SChannel.
+ *
+ * The data pass through unchanged until startTls() is called, so the
+ * stream can be set up under the gates before the peers agree on the
+ * encryption. After the handshake, all the data are encrypted; the
+ * algorithms are those of the system (AES-GCM where available, which
+ * SChannel does with AES-NI instructions of the CPU).
+ *
+ * A write is encrypted into as few records as the TLS record size allows
+ * and all of them are sent by one write to the transport. Give it the big
+ * batches of the output gate's buffer, not small messages.
+ *
+ * The credentials are shared by all the streams of the process, so
+ * SChannel resumes the sessions of a peer which reconnects: the server by
+ * itself, the client when it connects to the same target name.
+ *
+ * @remark writes are synchronized, reads must be done by one thread at a
+ * time.
+ */
+class TlsStream : public Channel
+{
+public:
+  /**
+   * Creates the stream over the transport in pass-through mode.
+   * @param input source of the data from the peer, must outlive this object.
+   * @param output destination of the data to the peer, must outlive this
+   * object.
+   */
+  TlsStream(InputStream *input, OutputStream *output);
+  virtual ~TlsStream();
+
+  /**
+   * Returns true if the server side of TLS can be used, i.e. the server
+   * certificate has been made. The certificate is self-signed, it is made
+   * once per process.
+   */
+  static bool isServerAvailable();
+
+  /**
+   * Performs the handshake, the stream is encrypted after it. Must be
+   * called when no data are in flight in either direction.
+   * @param isServer true for the server side of the handshake.
+   * @param targetName name of the server for the client side, the sessions
+   * are resumed by it; ignored by the server side.
+   * @throws IOException on error.
+   */
+  void startTls(bool isServer, const TCHAR *targetName) throw(IOException);
+
+  /**
+   * Returns true after the handshake has been done.
+   */
+  bool isStarted() const;
+
+  /**
+   * Describes the session (protocol, cipher, resumption and the SHA-1
+   * thumbprint of the server certificate) for the log.
+   */
+  void getDescription(StringStorage *desc);
+
+  virtual size_t read(void *buffer, size_t len) throw(IOException);
+
+  virtual size_t write(const void *buffer, size_t len) throw(IOException);
+
+  // Encrypts both buffers into the same records.
+  virtual size_t writeGather(const void *first, size_t firstLen,
+                             const void *second, size_t secondLen)
+    throw(IOException);
+
+  // Does nothing, the transport is closed by its owner.
+  virtual void close();
+
+  // Returns number of decrypted bytes which can be read without blocking.
+  virtual size_t available();
+
+protected:
+  void handshake(CredHandle *credentials, bool isServer,
+                 const TCHAR *targetName) throw(IOException);
+
+  // Appends the data of the input to m_inBuffer, at most maxLen bytes.
+  void readInput(size_t maxLen) throw(IOException);
+  // Decrypts the first record of m_inBuffer. Returns false if the record
+  // is not complete.
+  bool decryptRecord() throw(IOException);
+  // Moves the data left after the decrypted record to the beginning of
+  // m_inBuffer, when the plain text of the record has been read.
+  void dropRecord();
+
+  void writeFully(const char *data, size_t len) throw(IOException);
+
+  // Records written by one write at most, bigger writes are done by parts.
+  static const size_t MAX_RECORDS_PER_WRITE = 64;
+  static const size_t HANDSHAKE_BUFFER_SIZE = 32 * 1024;
+
+  InputStream *m_input;
+  OutputStream *m_output;
+
+  bool m_isStarted;
+  bool m_hasContext;
+  CtxtHandle m_context;
+  SecPkgContext_StreamSizes m_sizes;
+
+  // Encrypted data received, the record being read is decrypted in place.
+  std::vector<char> m_inBuffer;
+  size_t m_inLength;
+  // Plain text of the decrypted record not read yet.
+  char *m_plain;
+  size_t m_plainLength;
+  // Encrypted data received after the decrypted record, at the end of
+  // the first m_inLength bytes. dropRecord() keeps them.
+  size_t m_extraLength;
+
+  std::vector<char> m_outBuffer;
+  LocalMutex m_writeLock;
+
+private:
+  // Do not allow copying objects.
+  TlsStream(const TlsStream &other);
+  TlsStream &operator=(const TlsStream &other);
+};
+
+#endif // __TLSSTREAM_H__
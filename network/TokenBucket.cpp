@@ -0,0 +1,124 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TokenBucket.h"
+
+#include "thread/AutoLock.h"
+#include "thread/Thread.h"
+
+TokenBucket::TokenBucket(unsigned int bytesPerSecond)
+: m_rate(bytesPerSecond),
+  m_tokens(0),
+  m_lastRefill(GetTickCount())
+{
+  m_tokens = getBurst();
+}
+
+TokenBucket::~TokenBucket()
+{
+}
+
+void TokenBucket::setRate(unsigned int bytesPerSecond)
+{
+  AutoLock al(&m_lock);
+  if (m_rate == bytesPerSecond) {
+    return;
+  }
+  if (m_rate != 0) {
+    refill();
+  }
+  m_rate = bytesPerSecond;
+  m_lastRefill = GetTickCount();
+  if (m_tokens > getBurst()) {
+    m_tokens = getBurst();
+  }
+}
+
+unsigned int TokenBucket::getRate()
+{
+  AutoLock al(&m_lock);
+  return m_rate;
+}
+
+size_t TokenBucket::take(size_t wanted, unsigned int *waitMillis)
+{
+  AutoLock al(&m_lock);
+  *waitMillis = 0;
+  if (m_rate == 0) {
+    return wanted;
+  }
+  refill();
+  // Waiting for a few bytes at a time would make tiny writes.
+  INT64 minCount = min((INT64)wanted, getBurst() / 4);
+  if (m_tokens < minCount) {
+    *waitMillis = (unsigned int)((minCount - m_tokens) * 1000 / m_rate) + 1;
+    return 0;
+  }
+  size_t count = (size_t)min((INT64)wanted, m_tokens);
+  m_tokens -= count;
+  return count;
+}
+
+void TokenBucket::giveBack(size_t count)
+{
+  AutoLock al(&m_lock);
+  if (m_rate == 0) {
+    return;
+  }
+  m_tokens = min(m_tokens + (INT64)count, getBurst());
+}
+
+void TokenBucket::consume(size_t count)
+{
+  unsigned int waitMillis;
+  {
+    AutoLock al(&m_lock);
+    if (m_rate == 0) {
+      return;
+    }
+    refill();
+    m_tokens -= count;
+    if (m_tokens >= 0) {
+      return;
+    }
+    waitMillis = (unsigned int)(-m_tokens * 1000 / m_rate);
+  }
+  Thread::sleep(waitMillis);
+}
+
+void TokenBucket::refill()
+{
+  DWORD now = GetTickCount();
+  DWORD elapsed = now - m_lastRefill;
+  if (elapsed == 0) {
+    return;
+  }
+  m_lastRefill = now;
+  m_tokens = min(m_tokens + (INT64)elapsed * m_rate / 1000, getBurst());
+}
+
+INT64 TokenBucket::getBurst() const
+{
+  return max((INT64)m_rate * BURST_MILLIS / 1000, (INT64)MIN_BURST);
+}
@@ -0,0 +1,85 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __TOKENBUCKET_H__
+#define __TOKENBUCKET_H__
+
+#include "util/inttypes.h"
+#include "thread/LocalMutex.h"
+
+/**
+ * Token bucket limiting the rate of data, in bytes per second.
+ *
+ * The bucket fills at the rate and holds the data of BURST_MILLIS
+ * milliseconds at most, so the data leave in small portions at a steady
+ * pace instead of bursts. A bucket may be shared by several writers.
+ *
+ * @remark a bucket with the rate of 0 does not limit anything.
+ */
+class TokenBucket
+{
+public:
+  TokenBucket(unsigned int bytesPerSecond = 0);
+  virtual ~TokenBucket();
+
+  /**
+   * Changes the rate, 0 disables the limit.
+   */
+  void setRate(unsigned int bytesPerSecond);
+  unsigned int getRate();
+
+  /**
+   * Takes up to wanted bytes from the bucket without waiting.
+   * @return number of bytes taken, 0 if the bucket has not got enough of
+   * them yet; waitMillis is then the time to wait before the next try.
+   */
+  size_t take(size_t wanted, unsigned int *waitMillis);
+
+  /**
+   * Returns the bytes taken and not used.
+   */
+  void giveBack(size_t count);
+
+  /**
+   * Takes count bytes, then waits for as long as the bucket is in debt.
+   * For the writers who already have their data at hand and can wait.
+   */
+  void consume(size_t count);
+
+  static const unsigned int BURST_MILLIS = 50;
+  static const size_t MIN_BURST = 4096;
+
+private:
+  // Adds the bytes of the elapsed time, must be called with m_lock locked.
+  void refill();
+  INT64 getBurst() const;
+
+  unsigned int m_rate;
+  // Negative when the bucket is in debt after consume().
+  INT64 m_tokens;
+  DWORD m_lastRefill;
+  LocalMutex m_lock;
+};
+
+#endif // __TOKENBUCKET_H__
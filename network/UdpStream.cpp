@@ -0,0 +1,907 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "UdpStream.h"
+#include "thread/AutoLock.h"
+
+#include <algorithm>
+#include <string.h>
+
+UdpStream::UdpStream(DatagramSocketIPv4 *socket)
+: m_socket(socket),
+  m_isPeerClosed(false),
+  m_isBroken(false),
+  m_sendBase(0),
+  m_sendOffset(0),
+  m_peerMaxOffset(RECEIVE_WINDOW),
+  m_nextPacketNumber(0),
+  m_largestAcked(0),
+  m_hasAcked(false),
+  m_bytesInFlight(0),
+  m_congestionWindow(INITIAL_WINDOW),
+  m_slowStartThreshold((size_t)-1),
+  m_recoveryStart(0),
+  m_smoothedRtt(INITIAL_RTT),
+  m_rttVariance(INITIAL_RTT / 2),
+  m_latestRtt(0),
+  m_hasRtt(false),
+  m_nextSendTime(0),
+  m_lossTime(0),
+  m_probeCount(0),
+  m_isProbeDue(false),
+  m_largestReceivedTime(0),
+  m_unackedCount(0),
+  m_ackDeadline(0),
+  m_isAckDue(false),
+  m_receiveOffset(0),
+  m_consumedOffset(0),
+  m_advertisedOffset(RECEIVE_WINDOW)
+{
+  QueryPerformanceFrequency(&m_frequency);
+  UINT64 now = getTime();
+  m_lastSendTime = now;
+  m_lastAckElicitingTime = now;
+  m_lastReceiveTime = now;
+
+  m_socket->setReadEvent(m_socketEvent.getHandle());
+  resume();
+}
+
+UdpStream::~UdpStream()
+{
+  terminate();
+  wait();
+}
+
+size_t UdpStream::read(void *buffer, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+  while (true) {
+    {
+      AutoLock al(&m_lock);
+      if (!m_readBuffer.empty()) {
+        if (len > m_readBuffer.size()) {
+          len = m_readBuffer.size();
+        }
+        std::copy(m_readBuffer.begin(), m_readBuffer.begin() + len,
+                  (char *)buffer);
+        m_readBuffer.erase(m_readBuffer.begin(), m_readBuffer.begin() + len);
+        m_consumedOffset += len;
+        // Let the peer know that the window has moved before it runs out.
+        if (m_consumedOffset + RECEIVE_WINDOW - m_advertisedOffset >=
+            RECEIVE_WINDOW / 4) {
+          m_isAckDue = true;
+          m_wakeEvent.notify();
+        }
+        return len;
+      }
+      checkOpen();
+    }
+    m_readEvent.waitForEvent();
+  }
+}
+
+size_t UdpStream::write(const void *buffer, size_t len)
+{
+  AutoLock writeLock(&m_writeLock);
+
+  const char *data = (const char *)buffer;
+  size_t written = 0;
+  while (written < len) {
+    {
+      AutoLock al(&m_lock);
+      checkOpen();
+      size_t space = SEND_BUFFER_SIZE - m_sendData.size();
+      if (space > 0) {
+        size_t count = len - written;
+        if (count > space) {
+          count = space;
+        }
+        m_sendData.insert(m_sendData.end(), data + written,
+                          data + written + count);
+        written += count;
+        m_wakeEvent.notify();
+        continue;
+      }
+    }
+    m_writeEvent.waitForEvent();
+  }
+  return len;
+}
+
+void UdpStream::close()
+{
+  AutoLock al(&m_lock);
+  if (!m_isBroken) {
+    if (!m_isPeerClosed) {
+      try {
+        sendClose();
+      } catch (...) {
+      }
+    }
+    setBroken(_T("The stream is closed"));
+  }
+}
+
+size_t UdpStream::available()
+{
+  AutoLock al(&m_lock);
+  return m_readBuffer.size();
+}
+
+void UdpStream::writeMessage(UINT32 key, const void *data, size_t len)
+{
+  if (len > MAX_MESSAGE_SIZE) {
+    throw IOException(_T("The message does not fit in a datagram"));
+  }
+  AutoLock al(&m_lock);
+  checkOpen();
+
+  UINT32 version = ++m_messageVersions[key];
+  const char *bytes = (const char *)data;
+  // The message which has not been sent yet is replaced in its place.
+  std::deque<PendingMessage>::iterator it;
+  for (it = m_pendingMessages.begin(); it != m_pendingMessages.end(); it++) {
+    if (it->key == key) {
+      it->version = version;
+      it->data.assign(bytes, bytes + len);
+      return;
+    }
+  }
+  PendingMessage message;
+  message.key = key;
+  message.version = version;
+  message.data.assign(bytes, bytes + len);
+  m_pendingMessages.push_back(message);
+  m_wakeEvent.notify();
+}
+
+bool UdpStream::readMessage(UINT32 *key, std::vector<char> *data,
+                            DWORD timeoutMillis)
+{
+  while (true) {
+    {
+      AutoLock al(&m_lock);
+      if (!m_messages.empty()) {
+        *key = m_messages.front().first;
+        data->swap(m_messages.front().second);
+        m_messages.pop_front();
+        return true;
+      }
+      checkOpen();
+    }
+    if (timeoutMillis == 0) {
+      return false;
+    }
+    DWORD startTime = GetTickCount();
+    m_messageEvent.waitForEvent(timeoutMillis);
+    if (timeoutMillis != INFINITE) {
+      DWORD elapsed = GetTickCount() - startTime;
+      timeoutMillis = elapsed >= timeoutMillis ? 0 : timeoutMillis - elapsed;
+    }
+  }
+}
+
+unsigned int UdpStream::getRoundTripTime()
+{
+  AutoLock al(&m_lock);
+  return (unsigned int)(m_smoothedRtt / 1000);
+}
+
+size_t UdpStream::getCongestionWindow()
+{
+  AutoLock al(&m_lock);
+  return m_congestionWindow;
+}
+
+void UdpStream::execute()
+{
+  HANDLE events[2] = { m_socketEvent.getHandle(), m_wakeEvent.getHandle() };
+  try {
+    while (!isTerminating()) {
+      DWORD waitTime;
+      {
+        AutoLock al(&m_lock);
+        if (m_isBroken || m_isPeerClosed) {
+          break;
+        }
+        receiveDatagrams();
+        UINT64 now = getTime();
+        onTimers(now);
+        if (m_isBroken || m_isPeerClosed) {
+          break;
+        }
+        sendPackets(now);
+        waitTime = getWaitTime(now);
+      }
+      WaitForMultipleObjects(2, events, FALSE, waitTime);
+    }
+  } catch (Exception &e) {
+    AutoLock al(&m_lock);
+    setBroken(e.getMessage());
+  }
+}
+
+void UdpStream::onTerminate()
+{
+  m_wakeEvent.notify();
+}
+
+void UdpStream::receiveDatagrams()
+{
+  char datagram[MAX_DATAGRAM_SIZE];
+  // Leave some time to the timers and the sending under a flood.
+  for (int i = 0; i < 256; i++) {
+    int size = m_socket->recv(datagram, sizeof(datagram));
+    if (size < 0) {
+      break;
+    }
+    UINT64 now = getTime();
+    m_lastReceiveTime = now;
+    processDatagram(datagram, size, now);
+  }
+}
+
+void UdpStream::processDatagram(const char *datagram, size_t size, UINT64 now)
+{
+  if (size == 0) {
+    return;
+  }
+  switch ((UINT8)datagram[0]) {
+  case PACKET_STREAM:
+    {
+      if (size < STREAM_HEADER_SIZE) {
+        return;
+      }
+      UINT64 offset = getUInt64(datagram + 9);
+      UINT16 length = getUInt16(datagram + 17);
+      if (STREAM_HEADER_SIZE + length > size) {
+        return;
+      }
+      // The data over the window are not acknowledged, so they come again
+      // when the peer learns the window.
+      if (offset + length > m_consumedOffset + RECEIVE_WINDOW) {
+        return;
+      }
+      onPacketReceived(getUInt64(datagram + 1), now);
+      processStreamData(offset, datagram + STREAM_HEADER_SIZE, length);
+    }
+    break;
+  case PACKET_MESSAGE:
+    {
+      if (size < MESSAGE_HEADER_SIZE) {
+        return;
+      }
+      UINT16 length = getUInt16(datagram + 17);
+      if (MESSAGE_HEADER_SIZE + length > size) {
+        return;
+      }
+      onPacketReceived(getUInt64(datagram + 1), now);
+      processMessage(getUInt32(datagram + 9), getUInt32(datagram + 13),
+                     datagram + MESSAGE_HEADER_SIZE, length);
+    }
+    break;
+  case PACKET_PING:
+    if (size >= 9) {
+      onPacketReceived(getUInt64(datagram + 1), now);
+    }
+    break;
+  case PACKET_ACK:
+    processAck(datagram, size, now);
+    break;
+  case PACKET_CLOSE:
+    m_isPeerClosed = true;
+    m_readEvent.notify();
+    m_messageEvent.notify();
+    m_writeEvent.notify();
+    break;
+  }
+}
+
+void UdpStream::processAck(const char *datagram, size_t size, UINT64 now)
+{
+  if (size < ACK_HEADER_SIZE) {
+    return;
+  }
+  UINT64 largest = getUInt64(datagram + 1);
+  UINT64 ackDelay = (UINT64)getUInt16(datagram + 9) * 1000;
+  UINT64 maxOffset = getUInt64(datagram + 11);
+  size_t rangeCount = (UINT8)datagram[19];
+  if (ACK_HEADER_SIZE + rangeCount * 16 > size) {
+    return;
+  }
+
+  if (maxOffset > m_peerMaxOffset) {
+    m_peerMaxOffset = maxOffset;
+  }
+
+  bool hasNewlyAcked = false;
+  const char *range = datagram + ACK_HEADER_SIZE;
+  for (size_t i = 0; i < rangeCount; i++, range += 16) {
+    UINT64 first = getUInt64(range);
+    UINT64 last = getUInt64(range + 8);
+    std::map<UINT64, SentPacket>::iterator it =
+      m_sentPackets.lower_bound(first);
+    while (it != m_sentPackets.end() && it->first <= last) {
+      if (it->first == largest) {
+        updateRoundTrip(now - it->second.sentTime, ackDelay);
+      }
+      onPacketAcked(it->first, &it->second);
+      if (!m_hasAcked || it->first > m_largestAcked) {
+        m_largestAcked = it->first;
+        m_hasAcked = true;
+      }
+      m_sentPackets.erase(it++);
+      hasNewlyAcked = true;
+    }
+  }
+
+  if (hasNewlyAcked) {
+    m_probeCount = 0;
+    detectLosses(now);
+    advanceSendBase();
+  }
+}
+
+void UdpStream::processStreamData(UINT64 offset, const char *data,
+                                  size_t length)
+{
+  UINT64 end = offset + length;
+  if (end <= m_receiveOffset) {
+    return;
+  }
+  if (offset > m_receiveOffset) {
+    std::vector<char> &segment = m_receivedSegments[offset];
+    if (segment.size() < length) {
+      segment.assign(data, data + length);
+    }
+    return;
+  }
+
+  size_t skip = (size_t)(m_receiveOffset - offset);
+  m_readBuffer.insert(m_readBuffer.end(), data + skip, data + length);
+  m_receiveOffset = end;
+
+  // Append the segments which came before their turn.
+  while (!m_receivedSegments.empty() &&
+         m_receivedSegments.begin()->first <= m_receiveOffset) {
+    std::map<UINT64, std::vector<char> >::iterator it =
+      m_receivedSegments.begin();
+    UINT64 segmentEnd = it->first + it->second.size();
+    if (segmentEnd > m_receiveOffset) {
+      skip = (size_t)(m_receiveOffset - it->first);
+      m_readBuffer.insert(m_readBuffer.end(), it->second.begin() + skip,
+                          it->second.end());
+      m_receiveOffset = segmentEnd;
+    }
+    m_receivedSegments.erase(it);
+  }
+  m_readEvent.notify();
+}
+
+void UdpStream::processMessage(UINT32 key, UINT32 version, const char *data,
+                               size_t length)
+{
+  std::map<UINT32, UINT32>::iterator delivered =
+    m_deliveredVersions.find(key);
+  if (delivered != m_deliveredVersions.end()) {
+    // A late copy, or a version older than the delivered one.
+    if ((INT32)(version - delivered->second) <= 0) {
+      return;
+    }
+    delivered->second = version;
+  } else {
+    m_deliveredVersions[key] = version;
+  }
+
+  // The message which has not been read yet is replaced by the newer one.
+  std::deque<std::pair<UINT32, std::vector<char> > >::iterator it;
+  for (it = m_messages.begin(); it != m_messages.end(); it++) {
+    if (it->first == key) {
+      it->second.assign(data, data + length);
+      return;
+    }
+  }
+  m_messages.push_back(std::make_pair(key,
+                                      std::vector<char>(data, data + length)));
+  m_messageEvent.notify();
+}
+
+void UdpStream::onPacketReceived(UINT64 number, UINT64 now)
+{
+  bool isInOrder = m_receivedRanges.empty() ||
+                   number == m_receivedRanges.rbegin()->second + 1;
+  if (m_receivedRanges.empty() || number > m_receivedRanges.rbegin()->second) {
+    m_largestReceivedTime = now;
+  }
+
+  std::map<UINT64, UINT64>::iterator next = m_receivedRanges.upper_bound(number);
+  std::map<UINT64, UINT64>::iterator range = next;
+  if (range != m_receivedRanges.begin()) {
+    range--;
+    if (range->second >= number) {
+      // A copy of a packet, the acknowledgement of which may be lost.
+      m_isAckDue = true;
+      return;
+    }
+    if (range->second + 1 == number) {
+      range->second = number;
+    } else {
+      range = m_receivedRanges.insert(std::make_pair(number, number)).first;
+    }
+  } else {
+    range = m_receivedRanges.insert(std::make_pair(number, number)).first;
+  }
+  if (next != m_receivedRanges.end() && next->first == range->second + 1) {
+    range->second = next->second;
+    m_receivedRanges.erase(next);
+  }
+  // The oldest ranges are not acknowledged any more.
+  while (m_receivedRanges.size() > MAX_ACK_RANGES) {
+    m_receivedRanges.erase(m_receivedRanges.begin());
+  }
+
+  m_unackedCount++;
+  if (!isInOrder || m_unackedCount >= 2) {
+    m_isAckDue = true;
+  } else if (m_ackDeadline == 0) {
+    m_ackDeadline = now + ACK_DELAY;
+  }
+}
+
+void UdpStream::onPacketAcked(UINT64 number, const SentPacket *packet)
+{
+  m_bytesInFlight -= packet->size;
+
+  if (packet->type == PACKET_STREAM) {
+    // The data may be acknowledged in a packet declared lost too early.
+    m_outstanding.erase(packet->offset);
+    m_retransmissions.erase(packet->offset);
+  }
+
+  // The window does not grow with the packets sent before the recovery.
+  if (number < m_recoveryStart) {
+    return;
+  }
+  if (m_congestionWindow < m_slowStartThreshold) {
+    m_congestionWindow += packet->size;
+  } else {
+    m_congestionWindow += MAX_DATAGRAM_SIZE * packet->size / m_congestionWindow;
+  }
+}
+
+void UdpStream::onPacketLost(UINT64 number, const SentPacket *packet)
+{
+  m_bytesInFlight -= packet->size;
+
+  if (packet->type == PACKET_STREAM) {
+    std::map<UINT64, UINT16>::iterator it = m_outstanding.find(packet->offset);
+    if (it != m_outstanding.end()) {
+      m_retransmissions[it->first] = it->second;
+      m_outstanding.erase(it);
+    }
+  } else if (packet->type == PACKET_MESSAGE) {
+    // A message written again with the key supersedes the lost one.
+    bool isLatest = m_messageVersions[packet->key] == packet->version;
+    std::deque<PendingMessage>::iterator it;
+    for (it = m_pendingMessages.begin(); it != m_pendingMessages.end(); it++) {
+      if (it->key == packet->key) {
+        isLatest = false;
+        break;
+      }
+    }
+    if (isLatest) {
+      PendingMessage message;
+      message.key = packet->key;
+      message.version = packet->version;
+      message.data = packet->message;
+      m_pendingMessages.push_front(message);
+    }
+  }
+
+  if (number >= m_recoveryStart) {
+    m_recoveryStart = m_nextPacketNumber;
+    m_congestionWindow /= 2;
+    if (m_congestionWindow < MIN_WINDOW) {
+      m_congestionWindow = MIN_WINDOW;
+    }
+    m_slowStartThreshold = m_congestionWindow;
+  }
+}
+
+void UdpStream::detectLosses(UINT64 now)
+{
+  m_lossTime = 0;
+  if (!m_hasAcked) {
+    return;
+  }
+  UINT64 lossDelay = m_latestRtt > m_smoothedRtt ? m_latestRtt : m_smoothedRtt;
+  lossDelay = lossDelay * 9 / 8;
+  if (lossDelay < 1000) {
+    lossDelay = 1000;
+  }
+
+  // The packets are sent in the order of the numbers, so the ones after
+  // the first packet which is not lost are not lost either.
+  std::map<UINT64, SentPacket>::iterator it = m_sentPackets.begin();
+  while (it != m_sentPackets.end() && it->first < m_largestAcked) {
+    if (m_largestAcked - it->first >= PACKET_THRESHOLD ||
+        it->second.sentTime + lossDelay <= now) {
+      onPacketLost(it->first, &it->second);
+      m_sentPackets.erase(it++);
+    } else {
+      m_lossTime = it->second.sentTime + lossDelay;
+      break;
+    }
+  }
+}
+
+void UdpStream::updateRoundTrip(UINT64 sample, UINT64 ackDelay)
+{
+  m_latestRtt = sample;
+  if (!m_hasRtt) {
+    m_smoothedRtt = sample;
+    m_rttVariance = sample / 2;
+    m_hasRtt = true;
+    return;
+  }
+  // The peer may report a delay longer than it has promised.
+  if (ackDelay > 2 * ACK_DELAY) {
+    ackDelay = 2 * ACK_DELAY;
+  }
+  if (sample > ackDelay) {
+    sample -= ackDelay;
+  }
+  UINT64 deviation = m_smoothedRtt > sample ? m_smoothedRtt - sample
+                                            : sample - m_smoothedRtt;
+  m_rttVariance = (3 * m_rttVariance + deviation) / 4;
+  m_smoothedRtt = (7 * m_smoothedRtt + sample) / 8;
+}
+
+UINT64 UdpStream::getProbeTimeout() const
+{
+  UINT64 variance = 4 * m_rttVariance;
+  if (variance < 1000) {
+    variance = 1000;
+  }
+  unsigned int backoff = m_probeCount < 6 ? m_probeCount : 6;
+  return (m_smoothedRtt + variance + ACK_DELAY) << backoff;
+}
+
+void UdpStream::advanceSendBase()
+{
+  UINT64 base = m_sendOffset;
+  if (!m_outstanding.empty() && m_outstanding.begin()->first < base) {
+    base = m_outstanding.begin()->first;
+  }
+  if (!m_retransmissions.empty() && m_retransmissions.begin()->first < base) {
+    base = m_retransmissions.begin()->first;
+  }
+  if (base > m_sendBase) {
+    m_sendData.erase(m_sendData.begin(),
+                     m_sendData.begin() + (size_t)(base - m_sendBase));
+    m_sendBase = base;
+    m_writeEvent.notify();
+  }
+}
+
+void UdpStream::onTimers(UINT64 now)
+{
+  if (m_lossTime != 0 && now >= m_lossTime) {
+    detectLosses(now);
+  }
+  if (!m_sentPackets.empty() &&
+      now >= m_lastAckElicitingTime + getProbeTimeout()) {
+    m_probeCount++;
+    m_isProbeDue = true;
+    m_lastAckElicitingTime = now;
+  }
+  if (m_ackDeadline != 0 && now >= m_ackDeadline) {
+    m_isAckDue = true;
+  }
+  if (m_sentPackets.empty() && now >= m_lastSendTime + KEEPALIVE_TIME) {
+    sendPing(now);
+  }
+  if (now >= m_lastReceiveTime + IDLE_TIMEOUT) {
+    setBroken(_T("The peer does not respond"));
+  }
+}
+
+void UdpStream::sendPackets(UINT64 now)
+{
+  if (m_isAckDue) {
+    sendAck(now);
+  }
+  // The probe goes out regardless of the window and the pacing.
+  if (m_isProbeDue) {
+    m_isProbeDue = false;
+    if (!sendDataPacket(now)) {
+      sendPing(now);
+    }
+  }
+  while (m_bytesInFlight < m_congestionWindow && now >= m_nextSendTime) {
+    if (!sendDataPacket(now)) {
+      break;
+    }
+  }
+}
+
+bool UdpStream::sendDataPacket(UINT64 now)
+{
+  if (!m_retransmissions.empty()) {
+    std::map<UINT64, UINT16>::iterator it = m_retransmissions.begin();
+    if (!sendStreamPacket(it->first, it->second, now)) {
+      return false;
+    }
+    m_retransmissions.erase(it);
+    return true;
+  }
+  if (!m_pendingMessages.empty()) {
+    if (!sendMessagePacket(&m_pendingMessages.front(), now)) {
+      return false;
+    }
+    m_pendingMessages.pop_front();
+    return true;
+  }
+  UINT64 unsentEnd = m_sendBase + m_sendData.size();
+  if (unsentEnd > m_peerMaxOffset) {
+    unsentEnd = m_peerMaxOffset;
+  }
+  if (m_sendOffset >= unsentEnd) {
+    return false;
+  }
+  UINT64 length = unsentEnd - m_sendOffset;
+  if (length > MAX_DATAGRAM_SIZE - STREAM_HEADER_SIZE) {
+    length = MAX_DATAGRAM_SIZE - STREAM_HEADER_SIZE;
+  }
+  if (!sendStreamPacket(m_sendOffset, (UINT16)length, now)) {
+    return false;
+  }
+  m_sendOffset += length;
+  return true;
+}
+
+bool UdpStream::sendStreamPacket(UINT64 offset, UINT16 length, UINT64 now)
+{
+  char datagram[MAX_DATAGRAM_SIZE];
+  datagram[0] = PACKET_STREAM;
+  putUInt64(datagram + 9, offset);
+  putUInt16(datagram + 17, length);
+  std::deque<char>::iterator data =
+    m_sendData.begin() + (size_t)(offset - m_sendBase);
+  std::copy(data, data + length, datagram + STREAM_HEADER_SIZE);
+
+  SentPacket packet;
+  packet.type = PACKET_STREAM;
+  packet.offset = offset;
+  packet.length = length;
+  packet.key = 0;
+  packet.version = 0;
+  if (!sendPacket(datagram, STREAM_HEADER_SIZE + length, &packet, now)) {
+    return false;
+  }
+  m_outstanding[offset] = length;
+  return true;
+}
+
+bool UdpStream::sendMessagePacket(const PendingMessage *message, UINT64 now)
+{
+  char datagram[MAX_DATAGRAM_SIZE];
+  size_t length = message->data.size();
+  datagram[0] = PACKET_MESSAGE;
+  putUInt32(datagram + 9, message->key);
+  putUInt32(datagram + 13, message->version);
+  putUInt16(datagram + 17, (UINT16)length);
+  if (length > 0) {
+    memcpy(datagram + MESSAGE_HEADER_SIZE, &message->data.front(), length);
+  }
+
+  SentPacket packet;
+  packet.type = PACKET_MESSAGE;
+  packet.offset = 0;
+  packet.length = 0;
+  packet.key = message->key;
+  packet.version = message->version;
+  packet.message = message->data;
+  return sendPacket(datagram, MESSAGE_HEADER_SIZE + length, &packet, now);
+}
+
+void UdpStream::sendPing(UINT64 now)
+{
+  char datagram[9];
+  datagram[0] = PACKET_PING;
+
+  SentPacket packet;
+  packet.type = PACKET_PING;
+  packet.offset = 0;
+  packet.length = 0;
+  packet.key = 0;
+  packet.version = 0;
+  sendPacket(datagram, sizeof(datagram), &packet, now);
+}
+
+void UdpStream::sendAck(UINT64 now)
+{
+  char datagram[ACK_HEADER_SIZE + MAX_ACK_RANGES * 16];
+  UINT64 largest = 0;
+  UINT64 delay = 0;
+  if (!m_receivedRanges.empty()) {
+    largest = m_receivedRanges.rbegin()->second;
+    if (now > m_largestReceivedTime) {
+      delay = (now - m_largestReceivedTime) / 1000;
+    }
+    if (delay > 0xFFFF) {
+      delay = 0xFFFF;
+    }
+  }
+  UINT64 maxOffset = m_consumedOffset + RECEIVE_WINDOW;
+
+  datagram[0] = PACKET_ACK;
+  putUInt64(datagram + 1, largest);
+  putUInt16(datagram + 9, (UINT16)delay);
+  putUInt64(datagram + 11, maxOffset);
+  datagram[19] = (char)m_receivedRanges.size();
+  char *range = datagram + ACK_HEADER_SIZE;
+  std::map<UINT64, UINT64>::reverse_iterator it;
+  for (it = m_receivedRanges.rbegin(); it != m_receivedRanges.rend();
+       it++, range += 16) {
+    putUInt64(range, it->first);
+    putUInt64(range + 8, it->second);
+  }
+
+  if (m_socket->send(datagram, (int)(range - datagram))) {
+    m_advertisedOffset = maxOffset;
+    m_unackedCount = 0;
+    m_ackDeadline = 0;
+    m_isAckDue = false;
+  }
+}
+
+void UdpStream::sendClose()
+{
+  char type = PACKET_CLOSE;
+  m_socket->send(&type, 1);
+}
+
+bool UdpStream::sendPacket(char *datagram, size_t size,
+                           SentPacket *packet, UINT64 now)
+{
+  putUInt64(datagram + 1, m_nextPacketNumber);
+  if (!m_socket->send(datagram, (int)size)) {
+    return false;
+  }
+  packet->sentTime = now;
+  packet->size = size;
+  m_sentPackets[m_nextPacketNumber++] = *packet;
+  m_bytesInFlight += size;
+  m_lastSendTime = now;
+  m_lastAckElicitingTime = now;
+
+  // The next packet is due when the packets sent so far go out at the
+  // pacing rate, but the sending may have fallen behind by a burst.
+  UINT64 interval = size * m_smoothedRtt * 4 / (m_congestionWindow * 5);
+  if (m_nextSendTime + PACING_BURST < now) {
+    m_nextSendTime = now - PACING_BURST;
+  }
+  m_nextSendTime += interval;
+  return true;
+}
+
+DWORD UdpStream::getWaitTime(UINT64 now) const
+{
+  UINT64 deadline = m_lastReceiveTime + IDLE_TIMEOUT;
+  if (m_sentPackets.empty()) {
+    if (m_lastSendTime + KEEPALIVE_TIME < deadline) {
+      deadline = m_lastSendTime + KEEPALIVE_TIME;
+    }
+  } else if (m_lastAckElicitingTime + getProbeTimeout() < deadline) {
+    deadline = m_lastAckElicitingTime + getProbeTimeout();
+  }
+  if (m_lossTime != 0 && m_lossTime < deadline) {
+    deadline = m_lossTime;
+  }
+  if (m_ackDeadline != 0 && m_ackDeadline < deadline) {
+    deadline = m_ackDeadline;
+  }
+  bool hasData = !m_retransmissions.empty() || !m_pendingMessages.empty() ||
+                 (m_sendOffset < m_sendBase + m_sendData.size() &&
+                  m_sendOffset < m_peerMaxOffset);
+  if (m_isAckDue || (hasData && m_bytesInFlight < m_congestionWindow)) {
+    // Waits for the pacing, or for the room in the socket buffer.
+    UINT64 sendTime = m_nextSendTime > now ? m_nextSendTime : now + 1000;
+    if (sendTime < deadline) {
+      deadline = sendTime;
+    }
+  }
+  if (deadline <= now) {
+    return 0;
+  }
+  return (DWORD)((deadline - now + 999) / 1000);
+}
+
+void UdpStream::setBroken(const TCHAR *reason)
+{
+  if (!m_isBroken) {
+    m_isBroken = true;
+    m_error.setString(reason);
+  }
+  m_readEvent.notify();
+  m_messageEvent.notify();
+  m_writeEvent.notify();
+  m_wakeEvent.notify();
+}
+
+void UdpStream::checkOpen()
+{
+  if (m_isBroken) {
+    throw IOException(m_error.getString());
+  }
+  if (m_isPeerClosed) {
+    throw IOException(_T("The stream is closed by the peer"));
+  }
+}
+
+UINT64 UdpStream::getTime() const
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  UINT64 ticks = counter.QuadPart;
+  UINT64 frequency = m_frequency.QuadPart;
+  return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+void UdpStream::putUInt16(char *p, UINT16 value)
+{
+  p[0] = (char)(value >> 8);
+  p[1] = (char)value;
+}
+
+void UdpStream::putUInt32(char *p, UINT32 value)
+{
+  putUInt16(p, (UINT16)(value >> 16));
+  putUInt16(p + 2, (UINT16)value);
+}
+
+void UdpStream::putUInt64(char *p, UINT64 value)
+{
+  putUInt32(p, (UINT32)(value >> 32));
+  putUInt32(p + 4, (UINT32)value);
+}
+
+UINT16 UdpStream::getUInt16(const char *p)
+{
+  return (UINT16)(((UINT8)p[0] << 8) | (UINT8)p[1]);
+}
+
+UINT32 UdpStream::getUInt32(const char *p)
+{
+  return ((UINT32)getUInt16(p) << 16) | getUInt16(p + 2);
+}
+
+UINT64 UdpStream::getUInt64(const char *p)
+{
+  return ((UINT64)getUInt32(p) << 32) | getUInt32(p + 4);
+}
@@ -0,0 +1,282 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __UDPSTREAM_H__
+#define __UDPSTREAM_H__
+
+#include "io-lib/Channel.h"
+#include "network/socket/DatagramSocketIPv4.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "util/inttypes.h"
+#include "util/StringStorage.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+/**
+ * Byte stream and superseding messages over UDP, for the links where a
+ * lost TCP segment holds everything sent after it.
+ *
+ * Every datagram carrying data has a packet number which is never used
+ * again, the peer acknowledges the ranges of the packet numbers it has
+ * received. A packet is lost when PACKET_THRESHOLD later packets have been
+ * acknowledged, or 9/8 of the round trip after a later packet was
+ * acknowledged. The stream data of a lost packet go again in a new packet
+ * and the stream is delivered in order. A message is sent again only if
+ * no newer message with the same key has been written since, so a lost
+ * tile is replaced by its next version instead of being repeated, and it
+ * is delivered unless a newer message with the key has been delivered.
+ *
+ * The congestion window grows by the acknowledged bytes in slow start and
+ * by a datagram per window after the first loss, and it is halved once
+ * per round trip with losses. The packets are paced at 5/4 of the window
+ * per round trip. The peer limits the stream data in flight to
+ * RECEIVE_WINDOW bytes it has not read yet.
+ *
+ * @remark the socket must be connected to the peer, which runs another
+ * UdpStream. Writes are synchronized, reads of the stream and of the
+ * messages must be done by one thread each.
+ */
+class UdpStream : public Channel, private Thread
+{
+public:
+  /**
+   * Starts the stream over the socket.
+   * @param socket socket connected to the peer, must outlive this object.
+   * @throw SocketException if the socket cannot be watched.
+   */
+  UdpStream(DatagramSocketIPv4 *socket);
+  virtual ~UdpStream();
+
+  virtual size_t read(void *buffer, size_t len) throw(IOException);
+  virtual size_t write(const void *buffer, size_t len) throw(IOException);
+  // Sends the close notification to the peer and breaks the reads and
+  // writes.
+  virtual void close();
+  virtual size_t available();
+
+  /**
+   * Sends the data as one message which replaces the message with the
+   * same key if it has not been delivered yet.
+   * @throw IOException if the stream is closed or the data are longer
+   * than MAX_MESSAGE_SIZE.
+   */
+  void writeMessage(UINT32 key, const void *data, size_t len) throw(IOException);
+  /**
+   * Waits for a message up to timeoutMillis milliseconds.
+   * @return false if there is no message after the timeout.
+   * @throw IOException if the stream is closed.
+   */
+  bool readMessage(UINT32 *key, std::vector<char> *data,
+                   DWORD timeoutMillis = INFINITE) throw(IOException);
+
+  // Smoothed round trip time in milliseconds.
+  unsigned int getRoundTripTime();
+  // Congestion window in bytes.
+  size_t getCongestionWindow();
+
+  static const size_t MAX_DATAGRAM_SIZE = 1232;
+  static const size_t MAX_MESSAGE_SIZE = MAX_DATAGRAM_SIZE - 19;
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  struct SentPacket
+  {
+    UINT8 type;
+    UINT64 sentTime;
+    size_t size;
+    // Stream data of the packet.
+    UINT64 offset;
+    UINT16 length;
+    // Message of the packet, kept to be sent again.
+    UINT32 key;
+    UINT32 version;
+    std::vector<char> message;
+  };
+
+  struct PendingMessage
+  {
+    UINT32 key;
+    UINT32 version;
+    std::vector<char> data;
+  };
+
+  // The functions below are called by the thread with m_lock locked.
+  void receiveDatagrams();
+  void processDatagram(const char *datagram, size_t size, UINT64 now);
+  void processAck(const char *datagram, size_t size, UINT64 now);
+  void processStreamData(UINT64 offset, const char *data, size_t length);
+  void processMessage(UINT32 key, UINT32 version, const char *data,
+                      size_t length);
+  // Remembers the number of a received packet to acknowledge.
+  void onPacketReceived(UINT64 number, UINT64 now);
+
+  void onPacketAcked(UINT64 number, const SentPacket *packet);
+  void onPacketLost(UINT64 number, const SentPacket *packet);
+  void detectLosses(UINT64 now);
+  void updateRoundTrip(UINT64 sample, UINT64 ackDelay);
+  UINT64 getProbeTimeout() const;
+  // Drops the sent stream data below the lowest offset not acknowledged.
+  void advanceSendBase();
+
+  void onTimers(UINT64 now);
+  void sendPackets(UINT64 now);
+  // Sends one packet of data, if there are any. Returns false if nothing
+  // has been sent.
+  bool sendDataPacket(UINT64 now);
+  bool sendStreamPacket(UINT64 offset, UINT16 length, UINT64 now);
+  bool sendMessagePacket(const PendingMessage *message, UINT64 now);
+  void sendPing(UINT64 now);
+  void sendAck(UINT64 now);
+  void sendClose();
+  // Sends the datagram of a packet numbered m_nextPacketNumber and keeps
+  // the packet until it is acknowledged or lost.
+  bool sendPacket(char *datagram, size_t size, SentPacket *packet,
+                  UINT64 now);
+  // Returns the time to wait for the next timer in milliseconds.
+  DWORD getWaitTime(UINT64 now) const;
+
+  // Marks the stream broken by an error and wakes the waiting threads.
+  void setBroken(const TCHAR *reason);
+  void checkOpen() throw(IOException);
+
+  // Current time in microseconds.
+  UINT64 getTime() const;
+
+  static void putUInt16(char *p, UINT16 value);
+  static void putUInt32(char *p, UINT32 value);
+  static void putUInt64(char *p, UINT64 value);
+  static UINT16 getUInt16(const char *p);
+  static UINT32 getUInt32(const char *p);
+  static UINT64 getUInt64(const char *p);
+
+  static const UINT8 PACKET_STREAM = 1;
+  static const UINT8 PACKET_MESSAGE = 2;
+  static const UINT8 PACKET_PING = 3;
+  static const UINT8 PACKET_ACK = 4;
+  static const UINT8 PACKET_CLOSE = 5;
+
+  // U8 type, U64 packet number, U64 offset, U16 length.
+  static const size_t STREAM_HEADER_SIZE = 19;
+  // U8 type, U64 packet number, U32 key, U32 version, U16 length.
+  static const size_t MESSAGE_HEADER_SIZE = 19;
+  // U8 type, U64 largest number, U16 delay in ms, U64 stream limit,
+  // U8 number of ranges, then U64 first and U64 last number of each.
+  static const size_t ACK_HEADER_SIZE = 20;
+  static const size_t MAX_ACK_RANGES = 32;
+
+  static const size_t SEND_BUFFER_SIZE = 1024 * 1024;
+  static const size_t RECEIVE_WINDOW = 1024 * 1024;
+  static const size_t INITIAL_WINDOW = 10 * MAX_DATAGRAM_SIZE;
+  static const size_t MIN_WINDOW = 2 * MAX_DATAGRAM_SIZE;
+
+  static const UINT64 PACKET_THRESHOLD = 3;
+  static const UINT64 INITIAL_RTT = 100000;
+  static const UINT64 ACK_DELAY = 10000;
+  // Sending ahead of the pacing, for the timers which fire once in a
+  // system tick.
+  static const UINT64 PACING_BURST = 16000;
+  static const UINT64 KEEPALIVE_TIME = 5000000;
+  static const UINT64 IDLE_TIMEOUT = 30000000;
+
+  DatagramSocketIPv4 *m_socket;
+  LARGE_INTEGER m_frequency;
+
+  LocalMutex m_lock;
+  LocalMutex m_writeLock;
+  WindowsEvent m_socketEvent;
+  WindowsEvent m_wakeEvent;
+  WindowsEvent m_readEvent;
+  WindowsEvent m_messageEvent;
+  WindowsEvent m_writeEvent;
+
+  bool m_isPeerClosed;
+  bool m_isBroken;
+  StringStorage m_error;
+
+  // Sending side. The stream data from m_sendBase are kept until they are
+  // acknowledged, the ones from m_sendOffset have not been sent yet.
+  std::deque<char> m_sendData;
+  UINT64 m_sendBase;
+  UINT64 m_sendOffset;
+  // Limit of the stream offsets set by the peer.
+  UINT64 m_peerMaxOffset;
+  // Offsets and lengths of the stream data in flight and of the lost ones.
+  std::map<UINT64, UINT16> m_outstanding;
+  std::map<UINT64, UINT16> m_retransmissions;
+  std::deque<PendingMessage> m_pendingMessages;
+  std::map<UINT32, UINT32> m_messageVersions;
+
+  std::map<UINT64, SentPacket> m_sentPackets;
+  UINT64 m_nextPacketNumber;
+  UINT64 m_largestAcked;
+  bool m_hasAcked;
+  size_t m_bytesInFlight;
+  size_t m_congestionWindow;
+  size_t m_slowStartThreshold;
+  // Losses of the packets sent before it do not shrink the window again.
+  UINT64 m_recoveryStart;
+
+  UINT64 m_smoothedRtt;
+  UINT64 m_rttVariance;
+  UINT64 m_latestRtt;
+  bool m_hasRtt;
+
+  UINT64 m_nextSendTime;
+  UINT64 m_lastSendTime;
+  UINT64 m_lastAckElicitingTime;
+  UINT64 m_lossTime;
+  unsigned int m_probeCount;
+  bool m_isProbeDue;
+
+  // Receiving side.
+  std::map<UINT64, UINT64> m_receivedRanges;
+  UINT64 m_largestReceivedTime;
+  unsigned int m_unackedCount;
+  UINT64 m_ackDeadline;
+  bool m_isAckDue;
+  UINT64 m_lastReceiveTime;
+
+  std::deque<char> m_readBuffer;
+  // Offset of the first stream byte not received in order yet.
+  UINT64 m_receiveOffset;
+  UINT64 m_consumedOffset;
+  UINT64 m_advertisedOffset;
+  std::map<UINT64, std::vector<char> > m_receivedSegments;
+
+  std::deque<std::pair<UINT32, std::vector<char> > > m_messages;
+  std::map<UINT32, UINT32> m_deliveredVersions;
+
+  // Do not allow copying objects.
+  UdpStream(const UdpStream &other);
+  UdpStream &operator=(const UdpStream &other);
+};
+
+#endif // __UDPSTREAM_H__
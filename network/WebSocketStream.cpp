@@ -0,0 +1,217 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "WebSocketStream.h"
+#include "thread/AutoLock.h"
+
+WebSocketStream::WebSocketStream(Channel *stream)
+: m_stream(stream),
+  m_input(stream),
+  m_payloadLeft(0),
+  m_maskPos(0)
+{
+  memset(m_mask, 0, sizeof(m_mask));
+}
+
+WebSocketStream::~WebSocketStream()
+{
+}
+
+size_t WebSocketStream::read(void *buffer, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+  while (m_payloadLeft == 0) {
+    readFrameHeader();
+  }
+  if (len > m_payloadLeft) {
+    len = (size_t)m_payloadLeft;
+  }
+  size_t count = m_input.read(buffer, len);
+  unmask((UINT8 *)buffer, count);
+  m_payloadLeft -= count;
+  return count;
+}
+
+size_t WebSocketStream::write(const void *buffer, size_t len)
+{
+  sendFrame(OPCODE_BINARY, buffer, len, 0, 0);
+  return len;
+}
+
+size_t WebSocketStream::writeGather(const void *first, size_t firstLen,
+                                    const void *second, size_t secondLen)
+{
+  sendFrame(OPCODE_BINARY, first, firstLen, second, secondLen);
+  return firstLen + secondLen;
+}
+
+void WebSocketStream::close()
+{
+  m_stream->close();
+}
+
+size_t WebSocketStream::available()
+{
+  size_t count = m_input.available();
+  if (m_payloadLeft != 0 && count > m_payloadLeft) {
+    count = (size_t)m_payloadLeft;
+  }
+  return count;
+}
+
+void WebSocketStream::readFrameHeader()
+{
+  while (true) {
+    UINT8 head[2];
+    m_input.readInto(head, sizeof(head));
+
+    UINT8 opcode = head[0] & 0x0F;
+    bool isFinal = (head[0] & FIN_BIT) != 0;
+    // No extension is negotiated, so the reserved bits must be zero.
+    if ((head[0] & 0x70) != 0) {
+      throw IOException(_T("WebSocket frame with reserved bits set"));
+    }
+    if ((head[1] & MASK_BIT) == 0) {
+      throw IOException(_T("WebSocket frame from client is not masked"));
+    }
+
+    UINT64 length = head[1] & 0x7F;
+    if (length == 126) {
+      UINT8 ext[2];
+      m_input.readInto(ext, sizeof(ext));
+      length = ((UINT64)ext[0] << 8) | ext[1];
+    } else if (length == 127) {
+      UINT8 ext[8];
+      m_input.readInto(ext, sizeof(ext));
+      length = 0;
+      for (int i = 0; i < 8; i++) {
+        length = (length << 8) | ext[i];
+      }
+    }
+    if (length > MAX_PAYLOAD) {
+      throw IOException(_T("WebSocket frame is too large"));
+    }
+    m_input.readInto(m_mask, sizeof(m_mask));
+    m_maskPos = 0;
+
+    switch (opcode) {
+    case OPCODE_BINARY:
+    case OPCODE_CONTINUATION:
+      // The stream has no message boundaries, so a fragmented message is
+      // read as the frames come.
+      m_payloadLeft = length;
+      if (length != 0) {
+        return;
+      }
+      break;
+    case OPCODE_PING:
+    case OPCODE_PONG:
+    case OPCODE_CLOSE:
+      {
+        if (!isFinal || length > MAX_CONTROL_PAYLOAD) {
+          throw IOException(_T("Invalid WebSocket control frame"));
+        }
+        UINT8 payload[MAX_CONTROL_PAYLOAD];
+        readControlPayload(payload, (size_t)length);
+        if (opcode == OPCODE_PING) {
+          sendFrame(OPCODE_PONG, payload, (size_t)length, 0, 0);
+        } else if (opcode == OPCODE_CLOSE) {
+          // Echo the status code, then the connection is over.
+          sendFrame(OPCODE_CLOSE, payload, length >= 2 ? 2 : 0, 0, 0);
+          throw IOException(_T("WebSocket connection has been closed by client"));
+        }
+      }
+      break;
+    default:
+      // Text frames carry the base64 encoding of old viewers, it's not
+      // supported.
+      throw IOException(_T("Unsupported WebSocket frame type"));
+    }
+  }
+}
+
+void WebSocketStream::readControlPayload(UINT8 *buffer, size_t len)
+{
+  if (len != 0) {
+    m_input.readInto(buffer, len);
+    unmask(buffer, len);
+  }
+}
+
+void WebSocketStream::sendFrame(UINT8 opcode,
+                                const void *first, size_t firstLen,
+                                const void *second, size_t secondLen)
+{
+  UINT64 length = (UINT64)firstLen + secondLen;
+
+  // Server frames are not masked.
+  char header[10];
+  size_t headerLen = 2;
+  header[0] = (char)(FIN_BIT | opcode);
+  if (length < 126) {
+    header[1] = (char)length;
+  } else if (length <= 0xFFFF) {
+    header[1] = 126;
+    header[2] = (char)(length >> 8);
+    header[3] = (char)length;
+    headerLen = 4;
+  } else {
+    header[1] = 127;
+    for (int i = 0; i < 8; i++) {
+      header[2 + i] = (char)(length >> (56 - 8 * i));
+    }
+    headerLen = 10;
+  }
+
+  AutoLock al(&m_writeLock);
+  writeFully(header, headerLen, (const char *)first, firstLen);
+  writeFully((const char *)second, secondLen, 0, 0);
+}
+
+void WebSocketStream::writeFully(const char *first, size_t firstLen,
+                                 const char *second, size_t secondLen)
+{
+  while (firstLen != 0 || secondLen != 0) {
+    size_t written = m_stream->writeGather(first, firstLen, second, secondLen);
+    if (written <= firstLen) {
+      first += written;
+      firstLen -= written;
+    } else {
+      written -= firstLen;
+      firstLen = 0;
+      second += written;
+      secondLen -= written;
+    }
+  }
+}
+
+void WebSocketStream::unmask(UINT8 *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    data[i] ^= m_mask[(m_maskPos + i) & 3];
+  }
+  m_maskPos = (m_maskPos + len) & 3;
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __WEBSOCKETSTREAM_H__
+#define __WEBSOCKETSTREAM_H__
+
+#include "io-lib/Channel.h"
+#include "io-lib/BufferedInputStream.h"
+#include "thread/LocalMutex.h"
+#include "util/inttypes.h"
+
+/**
+ * Server side of a WebSocket connection (RFC 6455) after the opening
+ * handshake, carrying a byte stream in binary frames.
+ *
+ * Every write goes out as one binary frame. The frame header is sent
+ * together with the data by one gathered write, so the data are not
+ * copied. Frames are never compressed, the handshake does not accept
+ * extensions such as permessage-deflate.
+ *
+ * Reads return the payload of the data frames received from the client,
+ * unmasked in place in the buffer of the caller. Pings are answered and
+ * pongs are skipped inside read(), a close frame is answered and reported
+ * as IOException.
+ *
+ * @remark writes are synchronized, reads must be done by one thread at a
+ * time.
+ */
+class WebSocketStream : public Channel
+{
+public:
+  /**
+   * Creates the stream over the connection.
+   * @param stream stream of the connection, must outlive this object.
+   */
+  WebSocketStream(Channel *stream);
+  virtual ~WebSocketStream();
+
+  virtual size_t read(void *buffer, size_t len) throw(IOException);
+
+  virtual size_t write(const void *buffer, size_t len) throw(IOException);
+
+  // Sends both buffers in one frame.
+  virtual size_t writeGather(const void *first, size_t firstLen,
+                             const void *second, size_t secondLen)
+    throw(IOException);
+
+  virtual void close();
+
+  // Returns number of payload bytes which can be read without blocking.
+  virtual size_t available();
+
+protected:
+  // Reads frame headers until a data frame is met, processes the control
+  // frames on the way.
+  void readFrameHeader() throw(IOException);
+  // Reads the payload of a control frame, it must be small.
+  void readControlPayload(UINT8 *buffer, size_t len) throw(IOException);
+
+  void sendFrame(UINT8 opcode,
+                 const void *first, size_t firstLen,
+                 const void *second, size_t secondLen) throw(IOException);
+  // Writes both buffers fully.
+  void writeFully(const char *first, size_t firstLen,
+                  const char *second, size_t secondLen) throw(IOException);
+
+  void unmask(UINT8 *data, size_t len);
+
+  static const UINT8 OPCODE_CONTINUATION = 0x0;
+  static const UINT8 OPCODE_TEXT = 0x1;
+  static const UINT8 OPCODE_BINARY = 0x2;
+  static const UINT8 OPCODE_CLOSE = 0x8;
+  static const UINT8 OPCODE_PING = 0x9;
+  static const UINT8 OPCODE_PONG = 0xA;
+
+  static const UINT8 FIN_BIT = 0x80;
+  static const UINT8 MASK_BIT = 0x80;
+  static const size_t MAX_CONTROL_PAYLOAD = 125;
+  // Larger frames are refused, no client has a reason to send them.
+  static const UINT64 MAX_PAYLOAD = 0x7FFFFFFF;
+
+  Channel *m_stream;
+  BufferedInputStream m_input;
+
+  // Payload left unread in the current data frame.
+  UINT64 m_payloadLeft;
+  UINT8 m_mask[4];
+  size_t m_maskPos;
+
+  LocalMutex m_writeLock;
+
+private:
+  // Do not allow copying objects.
+  WebSocketStream(const WebSocketStream &other);
+  WebSocketStream &operator=(const WebSocketStream &other);
+};
+
+#endif // __WEBSOCKETSTREAM_H__
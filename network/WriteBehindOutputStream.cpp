@@ -0,0 +1,242 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "WriteBehindOutputStream.h"
+
+#include "thread/AutoLock.h"
+#include "io-lib/IOException.h"
+
+#include <algorithm>
+
+WriteBehindOutputStream::WriteBehindOutputStream(OutputStream *output,
+                                                 size_t maxQueued,
+                                                 TokenBucket *bandwidth,
+                                                 TokenBucket *sharedBandwidth)
+: m_output(output),
+  m_bandwidth(bandwidth),
+  m_sharedBandwidth(sharedBandwidth),
+  m_ring(std::max(maxQueued, (size_t)1)),
+  m_start(0),
+  m_size(0),
+  m_closed(false)
+{
+  resume();
+}
+
+WriteBehindOutputStream::~WriteBehindOutputStream()
+{
+  terminate();
+  wait();
+}
+
+size_t WriteBehindOutputStream::write(const void *buffer, size_t len)
+{
+  return writeGather(buffer, len, 0, 0);
+}
+
+size_t WriteBehindOutputStream::writeGather(const void *first, size_t firstLen,
+                                            const void *second, size_t secondLen)
+{
+  if (firstLen + secondLen == 0) {
+    return 0;
+  }
+  while (true) {
+    size_t count;
+    {
+      AutoLock al(&m_lock);
+      checkClosed();
+      count = put((const char *)first, firstLen);
+      if (count == firstLen) {
+        count += put((const char *)second, secondLen);
+      }
+    }
+    if (count > 0) {
+      m_dataEvent.notify();
+      return count;
+    }
+    m_spaceEvent.waitForEvent();
+  }
+}
+
+size_t WriteBehindOutputStream::writeRows(const void *first, size_t rowLength,
+                                          size_t stride, size_t rowCount)
+{
+  if (rowLength == 0 || rowCount == 0) {
+    return 0;
+  }
+  const char *row = (const char *)first;
+  while (true) {
+    size_t count = 0;
+    {
+      AutoLock al(&m_lock);
+      checkClosed();
+      for (size_t i = 0; i < rowCount; i++, row += stride) {
+        size_t queued = put(row, rowLength);
+        count += queued;
+        if (queued < rowLength) {
+          break;
+        }
+      }
+    }
+    if (count > 0) {
+      m_dataEvent.notify();
+      return count;
+    }
+    m_spaceEvent.waitForEvent();
+  }
+}
+
+size_t WriteBehindOutputStream::getQueuedSize()
+{
+  AutoLock al(&m_lock);
+  return m_size;
+}
+
+size_t WriteBehindOutputStream::getMaxQueuedSize() const
+{
+  return m_ring.size();
+}
+
+bool WriteBehindOutputStream::waitForQueuedSize(size_t maxQueued,
+                                                unsigned int timeoutMillis)
+{
+  {
+    AutoLock al(&m_lock);
+    checkClosed();
+    if (m_size <= maxQueued) {
+      return true;
+    }
+  }
+  m_spaceEvent.waitForEvent(timeoutMillis);
+  AutoLock al(&m_lock);
+  checkClosed();
+  return m_size <= maxQueued;
+}
+
+void WriteBehindOutputStream::execute()
+{
+  StringStorage error(_T("The stream has been closed"));
+  try {
+    while (!isTerminating()) {
+      size_t start, size;
+      {
+        AutoLock al(&m_lock);
+        start = m_start;
+        size = m_size;
+      }
+      if (size == 0) {
+        m_dataEvent.waitForEvent();
+        continue;
+      }
+      unsigned int waitMillis;
+      size = takeTokens(size, &waitMillis);
+      if (size == 0) {
+        m_pacingEvent.waitForEvent(waitMillis);
+        continue;
+      }
+      // The queued data are not moved until they are written, the writer
+      // of the stream only fills the free space of the ring buffer.
+      size_t firstLen = std::min(size, m_ring.size() - start);
+      size_t written = m_output->writeGather(&m_ring[start], firstLen,
+                                             &m_ring[0], size - firstLen);
+      if (written < size) {
+        giveBackTokens(size - written);
+      }
+      bool empty;
+      {
+        AutoLock al(&m_lock);
+        m_start = (m_start + written) % m_ring.size();
+        m_size -= written;
+        empty = m_size == 0;
+      }
+      m_spaceEvent.notify();
+      if (empty) {
+        m_output->flush();
+      }
+    }
+  } catch (Exception &e) {
+    error.setString(e.getMessage());
+  }
+  {
+    AutoLock al(&m_lock);
+    m_error = error;
+    m_closed = true;
+  }
+  m_spaceEvent.notify();
+}
+
+void WriteBehindOutputStream::onTerminate()
+{
+  m_dataEvent.notify();
+  m_pacingEvent.notify();
+}
+
+size_t WriteBehindOutputStream::takeTokens(size_t wanted,
+                                           unsigned int *waitMillis)
+{
+  *waitMillis = 0;
+  size_t count = wanted;
+  if (m_bandwidth != 0) {
+    count = m_bandwidth->take(count, waitMillis);
+    if (count == 0) {
+      return 0;
+    }
+  }
+  if (m_sharedBandwidth != 0) {
+    size_t shared = m_sharedBandwidth->take(count, waitMillis);
+    if (shared < count && m_bandwidth != 0) {
+      m_bandwidth->giveBack(count - shared);
+    }
+    count = shared;
+  }
+  return count;
+}
+
+void WriteBehindOutputStream::giveBackTokens(size_t count)
+{
+  if (m_bandwidth != 0) {
+    m_bandwidth->giveBack(count);
+  }
+  if (m_sharedBandwidth != 0) {
+    m_sharedBandwidth->giveBack(count);
+  }
+}
+
+size_t WriteBehindOutputStream::put(const char *data, size_t len)
+{
+  len = std::min(len, m_ring.size() - m_size);
+  size_t end = (m_start + m_size) % m_ring.size();
+  size_t first = std::min(len, m_ring.size() - end);
+  memcpy(&m_ring[end], data, first);
+  memcpy(&m_ring[0], data + first, len - first);
+  m_size += len;
+  return len;
+}
+
+void WriteBehindOutputStream::checkClosed()
+{
+  if (m_closed) {
+    throw IOException(m_error.getString());
+  }
+}
@@ -0,0 +1,145 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __WRITEBEHINDOUTPUTSTREAM_H__
+#define __WRITEBEHINDOUTPUTSTREAM_H__
+
+#include "io-lib/OutputStream.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/StringStorage.h"
+#include "TokenBucket.h"
+
+#include <vector>
+
+/**
+ * Output stream that queues written data in a bounded ring buffer and
+ * writes them to another stream from its own thread.
+ *
+ * The writer of the stream returns as soon as its data are queued, so it
+ * can prepare the next data (e.g. encode the next update) while the
+ * previous ones are still being sent. A write blocks only while the queue
+ * is full.
+ *
+ * The writing thread may be paced by token buckets, the bandwidth of the
+ * stream and the one shared with other streams. The writer of the stream
+ * is never blocked by them, only the queue fills up.
+ *
+ * @remark the destination must be closed or shut down before the
+ * destruction of this object, otherwise the destructor waits for the
+ * writing thread blocked in the destination. The data still queued then
+ * are lost.
+ */
+class WriteBehindOutputStream : public OutputStream, private Thread
+{
+public:
+  /**
+   * Creates the stream and starts the writing thread.
+   * @param output destination stream, must outlive this object.
+   * @param maxQueued maximum number of bytes queued.
+   * @param bandwidth limit of the stream, may be 0.
+   * @param sharedBandwidth limit shared with other streams, may be 0.
+   * The buckets must outlive this object.
+   */
+  WriteBehindOutputStream(OutputStream *output,
+                          size_t maxQueued = DEFAULT_MAX_QUEUED,
+                          TokenBucket *bandwidth = 0,
+                          TokenBucket *sharedBandwidth = 0);
+  virtual ~WriteBehindOutputStream();
+
+  /**
+   * Queues as many bytes as fit in the queue, waiting for some space if
+   * the queue is full.
+   * @throws IOException when the destination has failed.
+   */
+  virtual size_t write(const void *buffer, size_t len);
+  virtual size_t writeGather(const void *first, size_t firstLen,
+                             const void *second, size_t secondLen);
+  /**
+   * Queues the rows right into the ring buffer, as many as fit there.
+   * @throws IOException when the destination has failed.
+   */
+  virtual size_t writeRows(const void *first, size_t rowLength,
+                           size_t stride, size_t rowCount);
+
+  /**
+   * Returns the number of bytes queued and not written to the destination
+   * yet.
+   */
+  size_t getQueuedSize();
+
+  /**
+   * Returns the maximum number of bytes the queue can hold.
+   */
+  size_t getMaxQueuedSize() const;
+
+  /**
+   * Waits until no more than maxQueued bytes are queued.
+   * @return true if there are no more than maxQueued bytes queued, false
+   * if there are still more after timeoutMillis milliseconds.
+   * @throws IOException when the destination has failed.
+   */
+  bool waitForQueuedSize(size_t maxQueued, unsigned int timeoutMillis);
+
+  static const size_t DEFAULT_MAX_QUEUED = 2 * 1024 * 1024;
+
+protected:
+  // Inherited from Thread.
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // Copies as much of data as fits in the free space of the ring buffer,
+  // must be called with m_lock locked.
+  size_t put(const char *data, size_t len);
+  // Throws the error of the writing thread if it has stopped, must be
+  // called with m_lock locked.
+  void checkClosed();
+  // Takes up to wanted bytes from both buckets. Returns 0 if any of them
+  // is empty, and the time to wait in waitMillis.
+  size_t takeTokens(size_t wanted, unsigned int *waitMillis);
+  void giveBackTokens(size_t count);
+
+  OutputStream *m_output;
+  TokenBucket *m_bandwidth;
+  TokenBucket *m_sharedBandwidth;
+
+  LocalMutex m_lock;
+  std::vector<char> m_ring;
+  size_t m_start;
+  size_t m_size;
+  // Set when the writing thread has stopped, m_error tells why.
+  bool m_closed;
+  StringStorage m_error;
+
+  // Notified when data have been queued.
+  WindowsEvent m_dataEvent;
+  // Notified when data have been written or the destination has failed.
+  WindowsEvent m_spaceEvent;
+  // Wakes the writing thread waiting for the buckets on termination.
+  WindowsEvent m_pacingEvent;
+};
+
+#endif // __WRITEBEHINDOUTPUTSTREAM_H__
@@ -0,0 +1,158 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DatagramSocketIPv4.h"
+
+DatagramSocketIPv4::DatagramSocketIPv4()
+: m_wsaStartup(1, 2)
+{
+  m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+  if (m_socket == INVALID_SOCKET) {
+    throw SocketException();
+  }
+}
+
+DatagramSocketIPv4::~DatagramSocketIPv4()
+{
+  ::closesocket(m_socket);
+}
+
+void DatagramSocketIPv4::bind(const SocketAddressIPv4 &addr)
+{
+  struct sockaddr_in bindSockaddr = addr.getSockAddr();
+
+  if (::bind(m_socket, (const sockaddr *)&bindSockaddr, addr.getAddrLen()) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::connect(const SocketAddressIPv4 &addr)
+{
+  struct sockaddr_in targetSockAddr = addr.getSockAddr();
+
+  if (::connect(m_socket, (const sockaddr *)&targetSockAddr, addr.getAddrLen()) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::setReadEvent(HANDLE event)
+{
+  if (WSAEventSelect(m_socket, event, FD_READ) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+bool DatagramSocketIPv4::send(const char *data, int size)
+{
+  if (::send(m_socket, data, size, 0) == SOCKET_ERROR) {
+    int error = WSAGetLastError();
+    if (error == WSAEWOULDBLOCK || error == WSAENOBUFS) {
+      return false;
+    }
+    throw IOException(_T("Failed to send a datagram."));
+  }
+  return true;
+}
+
+int DatagramSocketIPv4::recv(char *buffer, int size)
+{
+  int result = ::recv(m_socket, buffer, size, 0);
+  if (result == SOCKET_ERROR) {
+    int error = WSAGetLastError();
+    if (error == WSAEWOULDBLOCK) {
+      return -1;
+    }
+    // The rest of the datagram is dropped.
+    if (error == WSAEMSGSIZE) {
+      return size;
+    }
+    if (error == WSAECONNRESET) {
+      throw IOException(_T("The peer does not listen on the port"));
+    }
+    throw IOException(_T("Failed to recv a datagram."));
+  }
+  return result;
+}
+
+bool DatagramSocketIPv4::getLocalAddr(SocketAddressIPv4 *addr)
+{
+  struct sockaddr_in sockAddr;
+  socklen_t len = sizeof(sockAddr);
+  if (getsockname(m_socket, (struct sockaddr *)&sockAddr, &len) == SOCKET_ERROR) {
+    return false;
+  }
+  *addr = SocketAddressIPv4(sockAddr);
+  return true;
+}
+
+void DatagramSocketIPv4::setSendBufferSize(int size)
+{
+  if (setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, (char *)&size, sizeof(size)) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::setReceiveBufferSize(int size)
+{
+  if (setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, (char *)&size, sizeof(size)) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::setReuseAddress(bool enabled)
+{
+  BOOL value = enabled ? TRUE : FALSE;
+  if (setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, (char *)&value, sizeof(value)) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::setMulticastTtl(int ttl)
+{
+  DWORD value = ttl;
+  if (setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, (char *)&value, sizeof(value)) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::joinGroup(const SocketAddressIPv4 &group)
+{
+  struct ip_mreq request;
+  request.imr_multiaddr = group.getSockAddr().sin_addr;
+  request.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *)&request, sizeof(request)) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void DatagramSocketIPv4::leaveGroup(const SocketAddressIPv4 &group)
+{
+  struct ip_mreq request;
+  request.imr_multiaddr = group.getSockAddr().sin_addr;
+  request.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (setsockopt(m_socket, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char *)&request, sizeof(request)) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
@@ -0,0 +1,131 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef DATAGRAM_SOCKET_IPV4_H
+#define DATAGRAM_SOCKET_IPV4_H
+
+#include "sockdefs.h"
+
+#include "SocketAddressIPv4.h"
+#include "SocketException.h"
+
+#include "io-lib/IOException.h"
+#include "win-system/WsaStartup.h"
+
+/**
+ * IPv4 UDP socket.
+ *
+ * The socket is used connected to one peer: the datagrams from other
+ * addresses are dropped by the system, and an ICMP "port unreachable" of
+ * the peer is reported by recv(). A socket connected to a multicast group
+ * sends to the group; a socket bound to a port and joined to a group
+ * receives from all the senders to the group.
+ */
+class DatagramSocketIPv4
+{
+public:
+  /**
+   * Creates new socket.
+   * @throws SocketException on fail.
+   */
+  DatagramSocketIPv4();
+  /**
+   * Deletes and closes socket.
+   */
+  virtual ~DatagramSocketIPv4();
+
+  /**
+   * Binds socket to socket address.
+   * @throws SocketException on fail.
+   */
+  void bind(const SocketAddressIPv4 &addr) throw(SocketException);
+  /**
+   * Sets the peer of the socket.
+   * @throws SocketException on fail.
+   */
+  void connect(const SocketAddressIPv4 &addr) throw(SocketException);
+
+  /**
+   * Makes the socket non-blocking and signals the event when datagrams
+   * can be received.
+   * @throws SocketException on fail.
+   */
+  void setReadEvent(HANDLE event) throw(SocketException);
+
+  /**
+   * Sends one datagram to the peer.
+   * @return false if the send buffer is full and the datagram is not sent.
+   * @throw IOException on error.
+   */
+  bool send(const char *data, int size) throw(IOException);
+  /**
+   * Receives one datagram from the peer.
+   * @return size of the datagram, or -1 if there is none (for a
+   * non-blocking socket). A longer datagram is cut to the size of the
+   * buffer.
+   * @throw IOException on error, or if the peer has no socket.
+   */
+  int recv(char *buffer, int size) throw(IOException);
+
+  /**
+   * Returns local address of socket.
+   * @param addr output parameter that will contain socket address.
+   * @return true on success, false on fail.
+   */
+  bool getLocalAddr(SocketAddressIPv4 *addr);
+
+  // Sizes of the socket buffers in bytes.
+  void setSendBufferSize(int size) throw(SocketException);
+  void setReceiveBufferSize(int size) throw(SocketException);
+
+  /**
+   * Allows other sockets to bind to the same port, must be called before
+   * bind().
+   * @throws SocketException on fail.
+   */
+  void setReuseAddress(bool enabled) throw(SocketException);
+  /**
+   * Sets the number of routers the multicast datagrams may pass, 1 keeps
+   * them in the local network.
+   * @throws SocketException on fail.
+   */
+  void setMulticastTtl(int ttl) throw(SocketException);
+  /**
+   * Receives the datagrams sent to the group (the port of the address is
+   * not used), on the default interface.
+   * @throws SocketException on fail.
+   */
+  void joinGroup(const SocketAddressIPv4 &group) throw(SocketException);
+  void leaveGroup(const SocketAddressIPv4 &group) throw(SocketException);
+
+private:
+  WsaStartup m_wsaStartup;
+  SOCKET m_socket;
+
+  // Do not allow copying objects.
+  DatagramSocketIPv4(const DatagramSocketIPv4 &other);
+  DatagramSocketIPv4 &operator=(const DatagramSocketIPv4 &other);
+};
+
+#endif
@@ -29,10 +29,13 @@
 
 #include "thread/AutoLock.h"
 
+#include <mstcpip.h>
+#include <mswsock.h>
 #include <crtdbg.h>
 
 SocketIPv4::SocketIPv4()
 : m_localAddr(NULL), m_peerAddr(NULL), m_isBound(false),
+  m_sharedAccept(false),
   m_wsaStartup(1, 2)
 {
   m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -97,6 +100,56 @@ int SocketIPv4::available()
   return result;
 }
 
+void SocketIPv4::setReadEvent(HANDLE event)
+{
+  if (WSAEventSelect(m_socket, event, FD_READ | FD_CLOSE) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+void SocketIPv4::clearReadEvent()
+{
+  if (WSAEventSelect(m_socket, 0, 0) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+  u_long nonBlocking = 0;
+  if (ioctlsocket(m_socket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
+int SocketIPv4::recvAvailable(char *buffer, int size)
+{
+  int result = ::recv(m_socket, buffer, size, 0);
+  if (result == 0) {
+    throw IOException(_T("Connection has been gracefully closed"));
+  }
+  if (result == SOCKET_ERROR) {
+    if (WSAGetLastError() == WSAEWOULDBLOCK) {
+      return -1;
+    }
+    throw IOException(_T("Failed to recv data from socket."));
+  }
+  return result;
+}
+
+bool SocketIPv4::waitForWritable(unsigned int timeoutMillis)
+{
+  fd_set wfd;
+  FD_ZERO(&wfd);
+  FD_SET(m_socket, &wfd);
+
+  timeval timeout;
+  timeout.tv_sec = timeoutMillis / 1000;
+  timeout.tv_usec = (timeoutMillis % 1000) * 1000;
+
+  int ret = select((int)m_socket + 1, NULL, &wfd, NULL, &timeout);
+  if (ret == SOCKET_ERROR) {
+    throw SocketException();
+  }
+  return ret > 0;
+}
+
 void SocketIPv4::close()
 {
   m_isClosed = true;
@@ -109,6 +162,33 @@ void SocketIPv4::shutdown(int how)
   }
 }
 
+typedef BOOL (WINAPI *pCancelIoExFunction)(HANDLE file, LPOVERLAPPED overlapped);
+
+// Resolved by the first cancellation, concurrent first cancellations store
+// the same value.
+static volatile bool s_cancelIoExResolved = false;
+static pCancelIoExFunction s_cancelIoEx = 0;
+
+bool SocketIPv4::cancelIo()
+{
+  if (!s_cancelIoExResolved) {
+    HMODULE kernel32 = GetModuleHandle(_T("kernel32.dll"));
+    if (kernel32 != 0) {
+      s_cancelIoEx = (pCancelIoExFunction)GetProcAddress(kernel32, "CancelIoEx");
+    }
+    s_cancelIoExResolved = true;
+  }
+  if (s_cancelIoEx == 0) {
+    return false;
+  }
+  // The blocking winsock calls are overlapped operations internally, so
+  // they are cancelled as the I/O of the socket handle.
+  if (s_cancelIoEx((HANDLE)m_socket, 0) == 0) {
+    return GetLastError() == ERROR_NOT_FOUND;
+  }
+  return true;
+}
+
 void SocketIPv4::bind(const TCHAR *bindHost, unsigned int bindPort)
 {
   SocketAddressIPv4 address(bindHost, bindPort);
@@ -175,6 +255,15 @@ SocketIPv4 *SocketIPv4::accept()
   return accepted; // Valid and initialized
 }
 
+void SocketIPv4::enableSharedAccept()
+{
+  u_long nonBlocking = 1;
+  if (ioctlsocket(m_socket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+  m_sharedAccept = true;
+}
+
 void SocketIPv4::set(SOCKET socket)
 {
   AutoLock l(&m_mutex);
@@ -225,8 +314,20 @@ SOCKET SocketIPv4::getAcceptedSocket(struct sockaddr_in *addr)
       if (FD_ISSET(m_socket, &afd)) {
         result = ::accept(m_socket, (struct sockaddr*)addr, &addrlen);
         if (result == INVALID_SOCKET) {
+          if (m_sharedAccept && WSAGetLastError() == WSAEWOULDBLOCK) {
+            // Another thread has taken the connection.
+            continue;
+          }
           throw SocketException();
         }
+        if (m_sharedAccept) {
+          // The accepted socket inherits the non-blocking mode.
+          u_long nonBlocking = 0;
+          if (ioctlsocket(result, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+            ::closesocket(result);
+            throw SocketException();
+          }
+        }
         break;
       } // if.
     } // if select ret > 0.
@@ -247,6 +348,65 @@ int SocketIPv4::send(const char *data, int size, int flags)
   return result;
 }
 
+int SocketIPv4::send(WSABUF *buffers, DWORD count)
+{
+  DWORD sent = 0;
+
+  if (WSASend(m_socket, buffers, count, &sent, 0, 0, 0) == SOCKET_ERROR) {
+    throw IOException(_T("Failed to send data to socket."));
+  }
+
+  return (int)sent;
+}
+
+bool SocketIPv4::transmitFile(HANDLE file, UINT64 offset, DWORD length,
+                              const void *head, DWORD headLength)
+{
+  // The extension function is looked up, so that mswsock.lib is not
+  // needed.
+  LPFN_TRANSMITFILE transmitFileFunc = 0;
+  GUID guid = WSAID_TRANSMITFILE;
+  DWORD bytes = 0;
+  if (WSAIoctl(m_socket, SIO_GET_EXTENSION_FUNCTION_POINTER,
+               &guid, sizeof(guid), &transmitFileFunc,
+               sizeof(transmitFileFunc), &bytes, 0, 0) == SOCKET_ERROR ||
+      transmitFileFunc == 0) {
+    return false;
+  }
+
+  TRANSMIT_FILE_BUFFERS buffers;
+  memset(&buffers, 0, sizeof(buffers));
+  buffers.Head = (PVOID)head;
+  buffers.HeadLength = headLength;
+
+  HANDLE event = CreateEvent(0, TRUE, FALSE, 0);
+  if (event == 0) {
+    return false;
+  }
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  overlapped.Offset = (DWORD)offset;
+  overlapped.OffsetHigh = (DWORD)(offset >> 32);
+  // The low bit of the event keeps the completion out of the completion
+  // port the socket may be associated with.
+  overlapped.hEvent = (HANDLE)((DWORD_PTR)event | 1);
+
+  bool sent = transmitFileFunc(m_socket, file, length, 0, &overlapped,
+                               headLength != 0 ? &buffers : 0, 0) != FALSE;
+  if (!sent && WSAGetLastError() == WSA_IO_PENDING) {
+    WaitForSingleObject(event, INFINITE);
+    DWORD flags = 0;
+    sent = WSAGetOverlappedResult(m_socket, &overlapped, &bytes, FALSE,
+                                  &flags) != FALSE &&
+           bytes == length + headLength;
+  }
+  CloseHandle(event);
+  if (!sent) {
+    throw IOException(_T("Failed to transmit file to socket."));
+  }
+  return true;
+}
+
 int SocketIPv4::recv(char *buffer, int size, int flags)
 {
   int result;
@@ -314,6 +474,60 @@ void SocketIPv4::enableNaggleAlgorithm(bool enabled)
   setSocketOptions(IPPROTO_TCP, TCP_NODELAY, &disabled, sizeof(disabled));
 }
 
+bool SocketIPv4::isNaggleAlgorithmEnabled()
+{
+  BOOL disabled = 0;
+  socklen_t len = sizeof(disabled);
+
+  getSocketOptions(IPPROTO_TCP, TCP_NODELAY, &disabled, &len);
+
+  return disabled == 0;
+}
+
+void SocketIPv4::setSendBufferSize(int size)
+{
+  setSocketOptions(SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+int SocketIPv4::getSendBufferSize()
+{
+  int size = 0;
+  socklen_t len = sizeof(size);
+
+  getSocketOptions(SOL_SOCKET, SO_SNDBUF, &size, &len);
+
+  return size;
+}
+
+void SocketIPv4::setReceiveBufferSize(int size)
+{
+  setSocketOptions(SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+int SocketIPv4::getReceiveBufferSize()
+{
+  int size = 0;
+  socklen_t len = sizeof(size);
+
+  getSocketOptions(SOL_SOCKET, SO_RCVBUF, &size, &len);
+
+  return size;
+}
+
+void SocketIPv4::setKeepAlive(unsigned int time, unsigned int interval)
+{
+  struct tcp_keepalive keepAlive;
+  keepAlive.onoff = time != 0 ? 1 : 0;
+  keepAlive.keepalivetime = time;
+  keepAlive.keepaliveinterval = interval;
+  DWORD returned = 0;
+
+  if (WSAIoctl(m_socket, SIO_KEEPALIVE_VALS, &keepAlive, sizeof(keepAlive),
+               0, 0, &returned, 0, 0) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
 void SocketIPv4::setExclusiveAddrUse()
 {
   int val = 1;
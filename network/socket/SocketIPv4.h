@@ -77,6 +77,15 @@ public:
    * @throws SocketException on fail.
    */
   void shutdown(int how) throw(SocketException);
+
+  /**
+   * Cancels the send and receive calls blocked on the socket in any
+   * thread, they fail at once instead of waiting for their timeouts.
+   * Is used after shutdown() to unblock the threads using the socket.
+   * @return false if the cancellation is not supported by the system
+   * (before Windows Vista) or has failed.
+   */
+  bool cancelIo();
   /**
    * Binds socket to specified address.
    * @param bindHost host to bind.
@@ -108,6 +117,14 @@ public:
    */
   SocketIPv4 *accept() throw(SocketException);
 
+  /**
+   * Allows several threads to wait in accept() on this socket at the same
+   * time. A thread woken up for a connection taken by another thread goes
+   * on waiting instead of blocking until the next connection.
+   * @throws SocketException on fail.
+   */
+  void enableSharedAccept() throw(SocketException);
+
   /**
    * Sends data to socket.
    *
@@ -118,6 +135,27 @@ public:
    * @throw IOException on error.
    */
   int send(const char *data, int size, int flags = 0) throw(IOException);
+  /**
+   * Sends data from several buffers to socket with one system call.
+   *
+   * @param buffers buffers to send, in order.
+   * @param count count of the buffers.
+   * @return count of sent bytes from all the buffers.
+   * @throw IOException on error.
+   */
+  int send(WSABUF *buffers, DWORD count) throw(IOException);
+  /**
+   * Sends head and then length bytes of the file from offset by
+   * TransmitFile(), which reads the file in the kernel, and waits until
+   * all the data have been sent.
+   *
+   * @param file handle of the file, may be opened for overlapped I/O.
+   * @return false if TransmitFile() is not available, nothing has been
+   * sent then.
+   * @throw IOException on error.
+   */
+  bool transmitFile(HANDLE file, UINT64 offset, DWORD length,
+                    const void *head, DWORD headLength) throw(IOException);
   /**
    * Receives data from socket.
    *
@@ -131,6 +169,35 @@ public:
 
   int available();
 
+  /**
+   * Waits until data can be written to the socket without blocking.
+   *
+   * @param timeoutMillis time to wait in milliseconds.
+   * @return true if there is room in the send buffer, false if the buffer
+   * is still full after the timeout.
+   * @throw SocketException on error.
+   */
+  bool waitForWritable(unsigned int timeoutMillis) throw(SocketException);
+
+  /**
+   * Makes the socket non-blocking and signals the event when data arrive
+   * or the connection is closed. One event may serve many sockets.
+   * @throws SocketException on fail.
+   */
+  void setReadEvent(HANDLE event) throw(SocketException);
+  /**
+   * Stops signalling the event and makes the socket blocking again.
+   * @throws SocketException on fail.
+   */
+  void clearReadEvent() throw(SocketException);
+  /**
+   * Receives the data which have arrived to a non-blocking socket.
+   *
+   * @return count of read bytes, or -1 if there are none yet.
+   * @throws IOException on fail or if the connection has been closed.
+   */
+  int recvAvailable(char *buffer, int size) throw(IOException);
+
   /**
    * Returns local address of socket (for listening socket).
    * @param addr output parameter that will contain socket address.
@@ -150,11 +217,25 @@ public:
 
   /* Socket options */
   void enableNaggleAlgorithm(bool enabled) throw(SocketException);
+  bool isNaggleAlgorithmEnabled() throw(SocketException);
   void setExclusiveAddrUse() throw(SocketException);
 
+  // Sizes of the socket buffers in bytes.
+  void setSendBufferSize(int size) throw(SocketException);
+  int getSendBufferSize() throw(SocketException);
+  void setReceiveBufferSize(int size) throw(SocketException);
+  int getReceiveBufferSize() throw(SocketException);
+
+  // Enables TCP keep-alive probes after time milliseconds of idling, sent
+  // each interval milliseconds. Zero time disables the probes.
+  void setKeepAlive(unsigned int time, unsigned int interval) throw(SocketException);
+
 private:
   WsaStartup m_wsaStartup;
 
+  // IocpEngine needs the WinSock socket for overlapped operations.
+  friend class IocpEngine;
+
 protected:
   // Returns a SOCKET object with performed accept operation.
   // Throws SocketException on an error.
@@ -181,6 +262,11 @@ protected:
    * Flag determinating if socket is server or client socket.
    */
   bool m_isBound;
+
+  /**
+   * Set if the socket is in non-blocking mode for shared accept().
+   */
+  bool m_sharedAccept;
 };
 
 #endif
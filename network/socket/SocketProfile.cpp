@@ -0,0 +1,73 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+#include "SocketProfile.h"
+
+SocketProfile::SocketProfile()
+: sendBufferSize(0),
+  receiveBufferSize(0),
+  noDelay(true),
+  keepAliveTime(0),
+  autoTune(false)
+{
+}
+
+void SocketProfile::apply(SocketIPv4 *socket) const
+{
+  socket->enableNaggleAlgorithm(!noDelay);
+  if (sendBufferSize != 0) {
+    socket->setSendBufferSize(sendBufferSize);
+  }
+  if (receiveBufferSize != 0) {
+    socket->setReceiveBufferSize(receiveBufferSize);
+  }
+  if (keepAliveTime != 0) {
+    socket->setKeepAlive(keepAliveTime, KEEP_ALIVE_INTERVAL);
+  }
+}
+
+void SocketProfile::describe(SocketIPv4 *socket, StringStorage *out)
+{
+  try {
+    out->format(_T("send buffer %d bytes, receive buffer %d bytes, ")
+                _T("Nagle algorithm %s"),
+                socket->getSendBufferSize(),
+                socket->getReceiveBufferSize(),
+                socket->isNaggleAlgorithmEnabled() ? _T("on") : _T("off"));
+  } catch (SocketException &e) {
+    out->format(_T("unknown (%s)"), e.getMessage());
+  }
+}
+
+int SocketProfile::calcSendBufferSize(unsigned int roundTripTime,
+                                      unsigned int throughput)
+{
+  UINT64 product = (UINT64)throughput * roundTripTime / 1000;
+  if (product < MIN_AUTO_BUFFER) {
+    return MIN_AUTO_BUFFER;
+  }
+  if (product > MAX_AUTO_BUFFER) {
+    return MAX_AUTO_BUFFER;
+  }
+  return (int)product;
+}
@@ -0,0 +1,79 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+#ifndef __SOCKETPROFILE_H__
+#define __SOCKETPROFILE_H__
+
+#include "util/StringStorage.h"
+#include "SocketIPv4.h"
+
+/**
+ * Tuning applied to a TCP connection socket.
+ */
+class SocketProfile
+{
+public:
+  /**
+   * Creates the profile with the system defaults and Nagle algorithm
+   * disabled, as the connections were set up without a profile.
+   */
+  SocketProfile();
+
+  /**
+   * Applies the profile to the socket.
+   * @throws SocketException on error.
+   */
+  void apply(SocketIPv4 *socket) const;
+
+  /**
+   * Writes the values in effect for the socket to the string, for the log.
+   */
+  static void describe(SocketIPv4 *socket, StringStorage *out);
+
+  /**
+   * Returns the send buffer size holding the bandwidth-delay product of a
+   * path with the given round trip time in milliseconds and throughput in
+   * bytes per second, within MIN_AUTO_BUFFER and MAX_AUTO_BUFFER.
+   */
+  static int calcSendBufferSize(unsigned int roundTripTime,
+                                unsigned int throughput);
+
+  // Sizes of the socket buffers in bytes, 0 keeps the system default.
+  int sendBufferSize;
+  int receiveBufferSize;
+  // Send small portions of data immediately (TCP_NODELAY) or not.
+  bool noDelay;
+  // Idle time in milliseconds before TCP keep-alive probes, 0 disables
+  // them.
+  unsigned int keepAliveTime;
+  // Resize the send buffer to the bandwidth-delay product measured during
+  // the session or not.
+  bool autoTune;
+
+  static const int MIN_AUTO_BUFFER = 64 * 1024;
+  static const int MAX_AUTO_BUFFER = 16 * 1024 * 1024;
+  // Interval between keep-alive probes in milliseconds.
+  static const unsigned int KEEP_ALIVE_INTERVAL = 1000;
+};
+
+#endif // __SOCKETPROFILE_H__
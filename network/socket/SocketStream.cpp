@@ -57,6 +57,32 @@ size_t SocketStream::write(const void *buf, size_t size)
   return (size_t)m_socket->send((char *)buf, (int)size);
 }
 
+size_t SocketStream::writeGather(const void *first, size_t firstLen,
+                                 const void *second, size_t secondLen)
+{
+  if ((int)firstLen < 0 || (int)secondLen < 0 ||
+      (int)(firstLen + secondLen) < 0) {
+    throw IOException(_T("Size of buffer is too big."));
+  }
+
+  WSABUF buffers[2];
+  DWORD count = 0;
+  if (firstLen != 0) {
+    buffers[count].buf = (char *)first;
+    buffers[count].len = (ULONG)firstLen;
+    count++;
+  }
+  if (secondLen != 0) {
+    buffers[count].buf = (char *)second;
+    buffers[count].len = (ULONG)secondLen;
+    count++;
+  }
+  if (count == 0) {
+    return 0;
+  }
+  return (size_t)m_socket->send(buffers, count);
+}
+
 void SocketStream::close()
 {
   try {
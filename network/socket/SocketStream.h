@@ -47,6 +47,11 @@ public:
 
   virtual size_t write(const void *, size_t) throw(IOException);
 
+  // Sends both buffers with one WSASend() call.
+  virtual size_t writeGather(const void *first, size_t firstLen,
+                             const void *second, size_t secondLen)
+    throw(IOException);
+
   // Closes connection and break all blocked operation.
   // @throw Exception on error.
   virtual void close();
@@ -191,6 +191,16 @@ public:
     }
     return result;
   }
+
+  // Returns the bounds of both rectangles.
+  Rect unionRect(const Rect *other) const {
+    Rect result;
+    result.setRect((left < other->left) ? left : other->left,
+                   (top < other->top) ? top : other->top,
+                   (right > other->right) ? right : other->right,
+                   (bottom > other->bottom) ? bottom : other->bottom);
+    return result;
+  }
 };
 
 #endif // __RECT_H__
@@ -49,3 +49,99 @@ Rect RectSerializer::toRect(const StringStorage *strIn)
   }
   return Rect(x, y, x + width, y + height);
 }
+
+void RectSerializer::toBytes(const std::vector<Rect> *rects,
+                             std::vector<UINT8> *dst)
+{
+  writeVarUInt((UINT32)rects->size(), dst);
+
+  Rect prev;
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = rects->begin(); iRect != rects->end(); iRect++) {
+    // The left edge follows the previous rectangle in the same band and
+    // the left edge of the previous band otherwise.
+    INT32 deltaTop = iRect->top - prev.top;
+    writeVarInt(deltaTop, dst);
+    writeVarInt(iRect->left - (deltaTop == 0 ? prev.right : prev.left), dst);
+    writeVarInt(iRect->getWidth() - prev.getWidth(), dst);
+    writeVarInt(iRect->getHeight() - prev.getHeight(), dst);
+    prev = *iRect;
+  }
+}
+
+void RectSerializer::toBytes(const Region *region, std::vector<UINT8> *dst)
+{
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  toBytes(&rects, dst);
+}
+
+size_t RectSerializer::fromBytes(const UINT8 *data, size_t size,
+                                 std::vector<Rect> *rects)
+{
+  size_t pos = 0;
+  UINT32 count = readVarUInt(data, size, &pos);
+  // Every rectangle takes 4 bytes at least.
+  if (count > (size - pos) / 4) {
+    throw Exception(_T("Wrong number of rectangles in the binary data"));
+  }
+  rects->resize(count);
+
+  // The arithmetic is unsigned to wrap around on malformed data.
+  Rect prev;
+  for (UINT32 i = 0; i < count; i++) {
+    UINT32 deltaTop = (UINT32)readVarInt(data, size, &pos);
+    UINT32 deltaLeft = (UINT32)readVarInt(data, size, &pos);
+    UINT32 deltaWidth = (UINT32)readVarInt(data, size, &pos);
+    UINT32 deltaHeight = (UINT32)readVarInt(data, size, &pos);
+
+    Rect *rect = &(*rects)[i];
+    rect->top = (int)((UINT32)prev.top + deltaTop);
+    rect->left = (int)((UINT32)(deltaTop == 0 ? prev.right : prev.left) +
+                       deltaLeft);
+    rect->right = (int)((UINT32)rect->left + (UINT32)prev.getWidth() +
+                        deltaWidth);
+    rect->bottom = (int)((UINT32)rect->top + (UINT32)prev.getHeight() +
+                         deltaHeight);
+    prev = *rect;
+  }
+  return pos;
+}
+
+void RectSerializer::writeVarUInt(UINT32 value, std::vector<UINT8> *dst)
+{
+  while (value >= 0x80) {
+    dst->push_back((UINT8)(value | 0x80));
+    value >>= 7;
+  }
+  dst->push_back((UINT8)value);
+}
+
+void RectSerializer::writeVarInt(INT32 value, std::vector<UINT8> *dst)
+{
+  // Zigzag encoding keeps small negative values short.
+  writeVarUInt(((UINT32)value << 1) ^ (UINT32)(value >> 31), dst);
+}
+
+UINT32 RectSerializer::readVarUInt(const UINT8 *data, size_t size,
+                                   size_t *pos)
+{
+  UINT32 value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*pos >= size) {
+      throw Exception(_T("Unexpected end of the binary rectangle data"));
+    }
+    UINT8 byte = data[(*pos)++];
+    value |= (UINT32)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw Exception(_T("Too long integer in the binary rectangle data"));
+}
+
+INT32 RectSerializer::readVarInt(const UINT8 *data, size_t size, size_t *pos)
+{
+  UINT32 value = readVarUInt(data, size, pos);
+  return (INT32)((value >> 1) ^ (0 - (value & 1)));
+}
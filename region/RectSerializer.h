@@ -27,6 +27,9 @@
 
 #include "util/CommonHeader.h"
 #include "Rect.h"
+#include "Region.h"
+
+#include <vector>
 
 class RectSerializer
 {
@@ -36,6 +39,26 @@ public:
 
   // Converts to Rect value.
   static Rect toRect(const StringStorage *strIn);
+
+  // Appends the compact binary form of the rectangles to dst: their count
+  // and the differences of each rectangle from the previous one, as
+  // variable length integers. The rectangles of a band differ by the left
+  // edge only, so the rectangles of a region (which go in bands from top to
+  // bottom) take 4 bytes each or so instead of 16. Any order is allowed.
+  static void toBytes(const std::vector<Rect> *rects, std::vector<UINT8> *dst);
+  static void toBytes(const Region *region, std::vector<UINT8> *dst);
+
+  // Decodes the rectangles written by toBytes() from the first size bytes
+  // of data and returns the number of bytes used. Throws Exception if the
+  // data is malformed. Invalid rectangles are not skipped.
+  static size_t fromBytes(const UINT8 *data, size_t size,
+                          std::vector<Rect> *rects);
+
+private:
+  static void writeVarUInt(UINT32 value, std::vector<UINT8> *dst);
+  static void writeVarInt(INT32 value, std::vector<UINT8> *dst);
+  static UINT32 readVarUInt(const UINT8 *data, size_t size, size_t *pos);
+  static INT32 readVarInt(const UINT8 *data, size_t size, size_t *pos);
 };
 
 #endif
@@ -71,10 +71,64 @@ Region & Region::operator=(const Region &src)
   return *this;
 }
 
+void Region::swap(Region *other)
+{
+  // The rectangles are referenced by the data pointer of the structure,
+  // so exchanging the structures exchanges them.
+  RegionRec tmp = m_reg;
+  m_reg = other->m_reg;
+  other->m_reg = tmp;
+}
+
 void Region::addRect(const Rect *rect)
 {
-  if (!rect->isEmpty()) {
-    Region temp(rect);
+  if (rect->isEmpty()) {
+    return;
+  }
+  // Cheap cases that need no band merging: the region is empty or
+  // a single rectangle covering the new one.
+  if (isEmpty()) {
+    BoxRec box;
+    box.x1 = rect->left;
+    box.x2 = rect->right;
+    box.y1 = rect->top;
+    box.y2 = rect->bottom;
+    miRegionReset(&m_reg, &box);
+    return;
+  }
+  if (m_reg.data == 0 &&
+      m_reg.extents.x1 <= rect->left && m_reg.extents.x2 >= rect->right &&
+      m_reg.extents.y1 <= rect->top && m_reg.extents.y2 >= rect->bottom) {
+    return;
+  }
+  Region temp(rect);
+  add(&temp);
+}
+
+void Region::addRects(const std::vector<Rect> *rects)
+{
+  if (rects->empty()) {
+    return;
+  }
+  if (rects->size() == 1) {
+    addRect(&rects->front());
+    return;
+  }
+
+  std::vector<BoxRec> boxes(rects->size());
+  for (size_t i = 0; i < rects->size(); i++) {
+    const Rect &rect = (*rects)[i];
+    boxes[i].x1 = rect.left;
+    boxes[i].x2 = rect.right;
+    boxes[i].y1 = rect.top;
+    boxes[i].y2 = rect.bottom;
+  }
+
+  if (isEmpty()) {
+    miBoxesToRegion(&m_reg, &boxes.front(), (int)boxes.size());
+  } else {
+    Region temp;
+    miBoxesToRegion(&temp.m_reg, &boxes.front(), (int)boxes.size());
     add(&temp);
   }
 }
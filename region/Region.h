@@ -79,12 +79,26 @@ public:
    * @param src a reference to the source region.
    */
   Region & operator=(const Region &src);
+  /**
+   * Exchanges the rectangles of this region with another one. Unlike the
+   * assignment, nothing is copied or allocated, so this is the way to hand
+   * the region over when the source is not needed anymore.
+   * @param other a pointer to the other region.
+   */
+  void swap(Region *other);
 
   /**
    * Adds a rectangle to this region.
    * @param rect rectangle to add.
    */
   void addRect(const Rect *rect);
+  /**
+   * Adds a number of rectangles to this region at once. The rectangles
+   * may be unsorted and may overlap. This is much faster than calling
+   * addRect() for each of them when there are many.
+   * @param rects rectangles to add.
+   */
+  void addRects(const std::vector<Rect> *rects);
   /**
    * Adds offset to all rectangles in region.
    * @param dx horizontal offset to add.
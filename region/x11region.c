@@ -167,9 +167,9 @@ SOFTWARE.
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 
-#define xallocData(n)    (RegDataPtr)malloc(REGION_SZOF(n))
+#define xallocData(n)    (RegDataPtr)xalloc(REGION_SZOF(n))
 #define xfreeData(reg)   if ((reg)->data && (reg)->data->size) \
-                           free((reg)->data)
+                           xfree((reg)->data)
 
 #define RECTALLOC_BAIL(pReg,n,bail) \
 if (!(pReg)->data || (((pReg)->data->numRects + (n)) > (pReg)->data->size)) \
@@ -1728,6 +1728,69 @@ miRectsToRegion(nrects, prect, ctype)
     return pRgn;
 }
 
+/*-
+ *-----------------------------------------------------------------------
+ * miBoxesToRegion --
+ *	Replace the contents of an initialized region with the union of
+ *	an unsorted array of boxes. The boxes are copied into one array
+ *	and sorted and banded by a single miRegionValidate pass, which is
+ *	much cheaper than a union per box when there are many of them.
+ *
+ * Results:
+ *	TRUE if successful.
+ *
+ * Side Effects:
+ *	The previous data of pReg is freed.
+ *
+ *-----------------------------------------------------------------------
+ */
+Bool
+miBoxesToRegion(pReg, pBoxes, nboxes)
+    RegionPtr		pReg;
+    register BoxPtr	pBoxes;
+    int			nboxes;
+{
+    register RegDataPtr	pData;
+    register BoxPtr	pBox;
+    register int	i;
+    Bool		overlap; /* result ignored */
+
+    xfreeData(pReg);
+    pReg->extents.x2 = pReg->extents.x1;
+    pReg->extents.y2 = pReg->extents.y1;
+    pReg->data = &miEmptyData;
+    if (nboxes <= 0)
+	return TRUE;
+    if (nboxes == 1)
+    {
+	if (pBoxes->x1 < pBoxes->x2 && pBoxes->y1 < pBoxes->y2)
+	{
+	    pReg->extents = *pBoxes;
+	    pReg->data = (RegDataPtr)NULL;
+	}
+	return TRUE;
+    }
+    pData = xallocData(nboxes);
+    if (!pData)
+	return miRegionBreak (pReg);
+    pBox = (BoxPtr) (pData + 1);
+    for (i = nboxes; --i >= 0; pBoxes++)
+    {
+	if (pBoxes->x1 < pBoxes->x2 && pBoxes->y1 < pBoxes->y2)
+	    *pBox++ = *pBoxes;
+    }
+    if (pBox == (BoxPtr) (pData + 1))
+    {
+	xfree (pData);
+	return TRUE;
+    }
+    pData->size = nboxes;
+    pData->numRects = pBox - (BoxPtr) (pData + 1);
+    pReg->data = pData;
+    pReg->extents.x1 = pReg->extents.x2 = 0;
+    return miRegionValidate(pReg, &overlap);
+}
+
 /*======================================================================
  * 	    	  Region Subtraction
  *====================================================================*/
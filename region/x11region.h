@@ -50,6 +50,7 @@ SOFTWARE.
 
 #include <stdio.h>
 #include "util/inttypes.h"
+#include "util/MemAccount.h"
 
 /* Return values from RectIn() */
 #define rgnOUT 0
@@ -68,9 +69,12 @@ SOFTWARE.
 
 #define CT_YXBANDED 18
 
-#define xalloc(n)        malloc(n)
-#define xrealloc(ptr, n) realloc((ptr), (n))
-#define xfree(ptr)       free(ptr)
+/*
+ * The memory of the regions is accounted, see util/MemAccount.h.
+ */
+#define xalloc(n)        memAccountAlloc(MEM_REGIONS, (n))
+#define xrealloc(ptr, n) memAccountRealloc(MEM_REGIONS, (ptr), (n))
+#define xfree(ptr)       memAccountFree(MEM_REGIONS, (ptr))
 
 /*
  * X data types
@@ -267,6 +271,7 @@ extern Bool miUnion(RegionPtr newReg, RegionPtr reg1, RegionPtr reg2);
 extern Bool miRegionAppend(RegionPtr dstrgn, RegionPtr rgn);
 extern Bool miRegionValidate(RegionPtr badreg, Bool * pOverlap);
 extern RegionPtr miRectsToRegion(int nrects, xRectanglePtr prect, int ctype);
+extern Bool miBoxesToRegion(RegionPtr pReg, BoxPtr pBoxes, int nboxes);
 extern Bool miSubtract(RegionPtr regD, RegionPtr regM, RegionPtr regS);
 extern Bool miInverse(RegionPtr newReg, RegionPtr reg1, BoxPtr invRect);
 extern int miRectIn(RegionPtr region, BoxPtr prect);
@@ -0,0 +1,86 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "BulkChannelRequestHandler.h"
+#include "RfbClient.h"
+#include "rfb/MsgDefs.h"
+#include "rfb/VendorDefs.h"
+#include "thread/AutoLock.h"
+#include "win-system/SystemException.h"
+
+#include <wincrypt.h>
+
+BulkChannelRequestHandler::BulkChannelRequestHandler(RfbCodeRegistrator *registrator,
+                                                     RfbOutputGate *output,
+                                                     RfbClient *client,
+                                                     LogWriter *log)
+: m_output(output),
+  m_client(client),
+  m_log(log)
+{
+  registrator->addClToSrvCap(ClientMsgDefs::ENABLE_BULK_CHANNEL, VendorDefs::TIGHTVNC, BulkChannelDefs::ENABLE_BULK_CHANNEL_SIG);
+  registrator->addSrvToClCap(ServerMsgDefs::BULK_CHANNEL_TOKEN, VendorDefs::TIGHTVNC, BulkChannelDefs::BULK_CHANNEL_TOKEN_SIG);
+  registrator->regCode(ClientMsgDefs::ENABLE_BULK_CHANNEL, this);
+}
+
+BulkChannelRequestHandler::~BulkChannelRequestHandler()
+{
+}
+
+void BulkChannelRequestHandler::onRequest(UINT32 reqCode, RfbInputGate *backGate)
+{
+  if (reqCode != ClientMsgDefs::ENABLE_BULK_CHANNEL) {
+    return;
+  }
+  UINT8 token[BulkChannelDefs::TOKEN_LENGTH];
+  try {
+    generateToken(token);
+  } catch (Exception &e) {
+    // Without the token the client goes on with the single connection.
+    m_log->error(_T("Cannot make the bulk channel token: %s"), e.getMessage());
+    return;
+  }
+  m_client->setBulkChannelToken(token);
+  m_log->debug(_T("The client requests the bulk channel, the token is sent"));
+
+  AutoLock l(m_output);
+  m_output->writeUInt32(ServerMsgDefs::BULK_CHANNEL_TOKEN);
+  m_output->writeFully(token, sizeof(token));
+  m_output->flush();
+}
+
+void BulkChannelRequestHandler::generateToken(UINT8 *token)
+{
+  HCRYPTPROV provider;
+  if (!CryptAcquireContext(&provider, 0, 0, PROV_RSA_FULL,
+                           CRYPT_VERIFYCONTEXT | CRYPT_SILENT)) {
+    throw SystemException(_T("Cannot acquire the cryptographic provider"));
+  }
+  BOOL result = CryptGenRandom(provider, BulkChannelDefs::TOKEN_LENGTH, token);
+  DWORD errCode = GetLastError();
+  CryptReleaseContext(provider, 0);
+  if (!result) {
+    throw SystemException(_T("Cannot generate random bytes"), errCode);
+  }
+}
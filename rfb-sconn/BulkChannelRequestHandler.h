@@ -0,0 +1,73 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _BULK_CHANNEL_REQUEST_HANDLER_H_
+#define _BULK_CHANNEL_REQUEST_HANDLER_H_
+
+#include "network/RfbInputGate.h"
+#include "network/RfbOutputGate.h"
+#include "rfb-sconn/RfbCodeRegistrator.h"
+#include "rfb-sconn/RfbDispatcherListener.h"
+#include "log-writer/LogWriter.h"
+
+class RfbClient;
+
+/**
+ * Handler of the EnableBulkChannel message. Gives the client a new token
+ * for the second connection, which carries the file transfer and the
+ * clipboard chunks of the client.
+ */
+class BulkChannelRequestHandler : public RfbDispatcherListener
+{
+public:
+  /**
+   * Creates the handler.
+   * @param registrator registrator of the capabilities and the message.
+   * @param output gate for writing the token.
+   * @param client client the token is stored to.
+   */
+  BulkChannelRequestHandler(RfbCodeRegistrator *registrator,
+                            RfbOutputGate *output,
+                            RfbClient *client,
+                            LogWriter *log);
+  virtual ~BulkChannelRequestHandler();
+
+  /**
+   * Inherited from RfbDispatcherListener.
+   */
+  virtual void onRequest(UINT32 reqCode, RfbInputGate *backGate);
+
+protected:
+  /**
+   * Fills token with random bytes of the system cryptographic provider.
+   * @throws SystemException on error.
+   */
+  void generateToken(UINT8 *token);
+
+  RfbOutputGate *m_output;
+  RfbClient *m_client;
+  LogWriter *m_log;
+};
+
+#endif // _BULK_CHANNEL_REQUEST_HANDLER_H_
@@ -44,6 +44,9 @@ public:
   // This function notifies about auth failed of the client.
   virtual void onAuthFailed(RfbClient *client) = 0;
   virtual void onCheckAccessControl(RfbClient *client) throw(AuthException) = 0;
+  // Attaches the client as the bulk channel of the authenticated client
+  // the token has been given to. Returns false if no client has the token.
+  virtual bool onBulkChannelAuth(RfbClient *client, const UINT8 *token) = 0;
 };
 
 #endif // __CLIENTAUTHLISTENER_H__
@@ -32,6 +32,9 @@ class ClientInputEventListener
 public:
   virtual void onKeyboardEvent(UINT32 keySym, bool down) = 0;
   virtual void onMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask) = 0;
+  // The events passed between these calls may be injected together.
+  virtual void onInputBatchBegin() = 0;
+  virtual void onInputBatchEnd() = 0;
 };
 
 #endif // __CLIENTINPUTEVENTLISTENER_H__
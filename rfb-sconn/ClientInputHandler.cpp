@@ -24,6 +24,7 @@
 
 #include "ClientInputHandler.h"
 #include "rfb/MsgDefs.h"
+#include "thread/AutoLock.h"
 
 ClientInputHandler::ClientInputHandler(RfbCodeRegistrator *codeRegtor,
                                        ClientInputEventListener *extEventListener,
@@ -34,14 +35,28 @@ ClientInputHandler::ClientInputHandler(RfbCodeRegistrator *codeRegtor,
   // Request codes
   codeRegtor->regCode(ClientMsgDefs::KEYBOARD_EVENT, this);
   codeRegtor->regCode(ClientMsgDefs::POINTER_EVENT, this);
+
+  // The events are what the user waits for, let them go before the updates.
+  setPriority(PRIORITY_ABOVE_NORMAL);
+  resume();
 }
 
 ClientInputHandler::~ClientInputHandler()
 {
+  terminate();
+  wait();
 }
 
 void ClientInputHandler::onRequest(UINT32 reqCode, RfbInputGate *input)
 {
+  {
+    AutoLock al(&m_eventsMutex);
+    if (!m_errorMessage.isEmpty()) {
+      throw Exception(m_errorMessage.getString());
+    }
+  }
+
+  InputEvent event;
   switch (reqCode) {
   case ClientMsgDefs::KEYBOARD_EVENT:
     {
@@ -49,7 +64,10 @@ void ClientInputHandler::onRequest(UINT32 reqCode, RfbInputGate *input)
       input->readUInt16(); // Pad
       UINT32 keyCode = input->readUInt32();
       if (!m_viewOnly) {
-        m_extEventListener->onKeyboardEvent(keyCode, down);
+        event.isKeyboard = true;
+        event.keySym = keyCode;
+        event.down = down;
+        postEvent(&event);
       }
     }
     break;
@@ -59,7 +77,11 @@ void ClientInputHandler::onRequest(UINT32 reqCode, RfbInputGate *input)
       UINT16 x = input->readUInt16();
       UINT16 y = input->readUInt16();
       if (!m_viewOnly) {
-        m_extEventListener->onMouseEvent(x, y, buttonMask);
+        event.isKeyboard = false;
+        event.x = x;
+        event.y = y;
+        event.buttonMask = buttonMask;
+        postEvent(&event);
       }
     }
     break;
@@ -70,3 +92,75 @@ void ClientInputHandler::onRequest(UINT32 reqCode, RfbInputGate *input)
     break;
   }
 }
+
+void ClientInputHandler::postEvent(const InputEvent *event)
+{
+  {
+    AutoLock al(&m_eventsMutex);
+    if (!event->isKeyboard && !m_events.empty() &&
+        !m_events.back().isKeyboard &&
+        m_events.back().buttonMask == event->buttonMask) {
+      m_events.back() = *event;
+    } else {
+      m_events.push_back(*event);
+    }
+  }
+  m_newEventWaiter.notify();
+}
+
+void ClientInputHandler::onTerminate()
+{
+  m_newEventWaiter.notify();
+}
+
+void ClientInputHandler::execute()
+{
+  while (!isTerminating()) {
+    m_newEventWaiter.waitForEvent();
+
+    while (!isTerminating()) {
+      // All the events received by now are passed as one batch.
+      std::deque<InputEvent> events;
+      {
+        AutoLock al(&m_eventsMutex);
+        if (m_events.empty()) {
+          break;
+        }
+        events.swap(m_events);
+      }
+
+      try {
+        bool isBatch = events.size() > 1;
+        if (isBatch) {
+          m_extEventListener->onInputBatchBegin();
+        }
+        try {
+          for (size_t i = 0; i < events.size(); i++) {
+            const InputEvent *event = &events[i];
+            if (event->isKeyboard) {
+              m_extEventListener->onKeyboardEvent(event->keySym, event->down);
+            } else {
+              m_extEventListener->onMouseEvent(event->x, event->y,
+                                               event->buttonMask);
+            }
+          }
+        } catch (...) {
+          if (isBatch) {
+            m_extEventListener->onInputBatchEnd();
+          }
+          throw;
+        }
+        if (isBatch) {
+          m_extEventListener->onInputBatchEnd();
+        }
+      } catch (Exception &e) {
+        // Let the dispatcher close the connection on the next event, as it
+        // did when the events were passed on its own thread.
+        AutoLock al(&m_eventsMutex);
+        m_errorMessage.setString(e.getMessage());
+        m_events.clear();
+        terminate();
+      }
+    }
+  }
+}
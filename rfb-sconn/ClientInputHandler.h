@@ -28,8 +28,22 @@
 #include "RfbDispatcherListener.h"
 #include "RfbCodeRegistrator.h"
 #include "ClientInputEventListener.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/StringStorage.h"
 
-class ClientInputHandler : public RfbDispatcherListener
+#include <deque>
+
+/**
+ * Reads the keyboard and pointer events on the dispatcher thread and passes
+ * them to the listener on a thread of its own, so that a slow injection of
+ * the events never stops reading of other messages, and a long request
+ * handled by the dispatcher never delays the events already received.
+ * The events queued while the previous ones were injected are passed as
+ * one batch.
+ */
+class ClientInputHandler : public RfbDispatcherListener, public Thread
 {
 public:
   ClientInputHandler(RfbCodeRegistrator *codeRegtor,
@@ -42,9 +56,32 @@ public:
 protected:
   // Listen function
   virtual void onRequest(UINT32 reqCode, RfbInputGate *input);
+  virtual void execute();
+  virtual void onTerminate();
+
+  struct InputEvent
+  {
+    bool isKeyboard;
+    UINT32 keySym;
+    bool down;
+    UINT16 x;
+    UINT16 y;
+    UINT8 buttonMask;
+  };
+
+  // Queues the event for the thread. A pointer move replaces a queued move
+  // with the same buttons, so that a stalled desktop gets the latest
+  // position rather than the whole path.
+  void postEvent(const InputEvent *event);
 
   ClientInputEventListener *m_extEventListener;
   bool m_viewOnly;
+
+  std::deque<InputEvent> m_events;
+  // Message of an error caught by the thread, empty if there was none.
+  StringStorage m_errorMessage;
+  LocalMutex m_eventsMutex;
+  WindowsEvent m_newEventWaiter;
 };
 
 #endif // __CLIENTINPUTHANDLER_H__
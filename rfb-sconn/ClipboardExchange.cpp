@@ -28,19 +28,35 @@
 #include "util/AnsiStringStorage.h"
 #include "thread/AutoLock.h"
 #include "rfb/VendorDefs.h"
+#include "server-config-lib/Configurator.h"
+#include "zlib/zlib.h"
 
 ClipboardExchange::ClipboardExchange(RfbCodeRegistrator *codeRegtor,
                                      Desktop *desktop,
                                      RfbOutputGate *output,
                                      bool viewOnly,
+                                     TaskScheduler *scheduler,
                                      LogWriter *log)
 : m_desktop(desktop),
   m_output(output),
+  m_bulkOutput(0),
+  m_scheduler(scheduler),
+  m_isStopped(false),
   m_viewOnly(viewOnly),
   m_hasNewClip(false),
+  m_hasRequest(false),
+  m_requestedSerial(0),
+  m_requestFlags(0),
+  m_hasOffer(false),
+  m_offerSerial(0),
   m_isUtf8ClipboardEnabled(false),
+  m_isLazyClipboardEnabled(false),
   m_log(log)
 {
+  ServerConfig *config = Configurator::getInstance()->getServerConfig();
+  m_maxSentLength = config->getMaxClipboardToClients();
+  m_maxReceivedLength = config->getMaxClipboardFromClients();
+
   // Request code
   codeRegtor->regCode(ClientMsgDefs::CLIENT_CUT_TEXT, this);
 
@@ -50,13 +66,18 @@ ClipboardExchange::ClipboardExchange(RfbCodeRegistrator *codeRegtor,
   codeRegtor->regCode(ClientMsgDefs::CLIENT_CUT_TEXT_UTF8, this);
   codeRegtor->regCode(ClientMsgDefs::ENABLE_CUT_TEXT_UTF8, this);
 
-  resume();
+  codeRegtor->addClToSrvCap(ClientMsgDefs::ENABLE_CUT_TEXT_OFFERS, VendorDefs::TIGHTVNC, LazyCutTextDefs::ENABLE_CUT_TEXT_OFFERS_SIG);
+  codeRegtor->addClToSrvCap(ClientMsgDefs::CUT_TEXT_REQUEST, VendorDefs::TIGHTVNC, LazyCutTextDefs::CUT_TEXT_REQUEST_SIG);
+  codeRegtor->addSrvToClCap(ServerMsgDefs::CUT_TEXT_OFFER, VendorDefs::TIGHTVNC, LazyCutTextDefs::CUT_TEXT_OFFER_SIG);
+  codeRegtor->addSrvToClCap(ServerMsgDefs::CUT_TEXT_CHUNK, VendorDefs::TIGHTVNC, LazyCutTextDefs::CUT_TEXT_CHUNK_SIG);
+  codeRegtor->regCode(ClientMsgDefs::ENABLE_CUT_TEXT_OFFERS, this);
+  codeRegtor->regCode(ClientMsgDefs::CUT_TEXT_REQUEST, this);
 }
 
 ClipboardExchange::~ClipboardExchange()
 {
-  terminate();
-  wait();
+  m_isStopped = true;
+  m_scheduler->cancel(this);
 }
 
 void ClipboardExchange::onRequest(UINT32 reqCode, RfbInputGate *input)
@@ -74,6 +95,13 @@ void ClipboardExchange::onRequest(UINT32 reqCode, RfbInputGate *input)
   case ClientMsgDefs::ENABLE_CUT_TEXT_UTF8:
     m_isUtf8ClipboardEnabled = true;
     break;
+  case ClientMsgDefs::ENABLE_CUT_TEXT_OFFERS:
+    m_log->debug(_T("The client fetches the clipboard lazily"));
+    m_isLazyClipboardEnabled = true;
+    break;
+  case ClientMsgDefs::CUT_TEXT_REQUEST:
+    onCutTextRequest(input);
+    break;
   default:
     StringStorage errMess;
     errMess.format(_T("Unknown %d protocol code received"), (int)reqCode);
@@ -85,6 +113,13 @@ void ClipboardExchange::onRequestWorker(bool utf8flag, RfbInputGate *input)
 {
   UINT32 length = input->readUInt32();
 
+  if (isTooLarge(length, m_maxReceivedLength)) {
+    m_log->info(_T("Dropping the client clipboard of %u bytes, the limit is %u"),
+                (unsigned int)length, m_maxReceivedLength);
+    skipClipboard(input, length);
+    return;
+  }
+
   std::vector<char> charBuff(length + 1);
 
   input->readFully(&charBuff.front(), length);
@@ -108,66 +143,229 @@ void ClipboardExchange::onRequestWorker(bool utf8flag, RfbInputGate *input)
   m_desktop->setNewClipText(&clipText);
 }
 
+void ClipboardExchange::onCutTextRequest(RfbInputGate *input)
+{
+  UINT32 serial = input->readUInt32();
+  UINT8 flags = input->readUInt8();
+
+  AutoLock al(&m_storedClipMut);
+  m_requestedSerial = serial;
+  m_requestFlags = flags;
+  m_hasRequest = true;
+  m_scheduler->post(this);
+}
+
+void ClipboardExchange::skipClipboard(RfbInputGate *input, UINT32 length)
+{
+  std::vector<char> buffer(length < SKIP_BUFFER_SIZE ? length : SKIP_BUFFER_SIZE);
+  while (length > 0) {
+    size_t portion = length < buffer.size() ? length : buffer.size();
+    input->readFully(&buffer.front(), portion);
+    length -= (UINT32)portion;
+  }
+}
+
+bool ClipboardExchange::isTooLarge(size_t length, unsigned int maxLength)
+{
+  return maxLength != 0 && length > maxLength;
+}
+
 void ClipboardExchange::sendClipboard(const StringStorage *newClipboard)
 {
   AutoLock al(&m_storedClipMut);
   m_storedClip = *newClipboard;
   m_hasNewClip = true;
-  m_newClipWaiter.notify();
+  m_scheduler->post(this);
 }
 
-void ClipboardExchange::onTerminate()
+void ClipboardExchange::setBulkOutput(RfbOutputGate *bulkOutput)
 {
-  m_newClipWaiter.notify();
+  AutoLock al(&m_bulkOutputMut);
+  // The sending could have been stopped by an error of the closed
+  // channel, the main connection is still there.
+  if (m_bulkOutput != 0 && bulkOutput == 0) {
+    m_isStopped = false;
+  }
+  m_bulkOutput = bulkOutput;
 }
 
-void ClipboardExchange::execute()
+void ClipboardExchange::run()
 {
-  while (!isTerminating()) {
-    m_newClipWaiter.waitForEvent();
-
-    if (m_hasNewClip && !isTerminating() && !m_viewOnly) {
-
-      try {
-        const char * data;
-        size_t length;
-        AutoLock al(m_output);
-        if (m_isUtf8ClipboardEnabled) {
-          m_output->writeUInt32(ServerMsgDefs::SERVER_CUT_TEXT_UTF8); // type
-          Utf8StringStorage charBuff;
-          {
-            AutoLock al(&m_storedClipMut);
-            charBuff.fromStringStorage(&m_storedClip);
-            m_hasNewClip = false;
-          }
-          data = charBuff.getString();
-          length = charBuff.getLength();
-		      m_log->debug(_T("Sending Utf8 Clipboard, payload length %d"), length);
-          m_output->writeUInt32((UINT32)length);
-          m_output->writeFully(data, length);
-        }
-        else {
-          m_output->writeUInt8(ServerMsgDefs::SERVER_CUT_TEXT); // type
-          m_output->writeUInt8(0); // pad
-          m_output->writeUInt16(0); // pad
-          AnsiStringStorage charBuff;
-          {
-            AutoLock al(&m_storedClipMut);
-            charBuff.fromStringStorage(&m_storedClip);
-            m_hasNewClip = false;
-          }
-          data = charBuff.getString();
-          length = charBuff.getLength();
-		      m_log->debug(_T("Sending Clipboard, payload length %d"), length);
-          m_output->writeUInt32((UINT32)length);
-          m_output->writeFully(data, length);
-        }
-        m_output->flush();
-      } catch (Exception &e) {
-        m_log->error(_T("The clipboard thread force to terminate because")
-                   _T(" it caught the error: %s"), e.getMessage());
-        terminate();
+  try {
+    if (m_hasNewClip && !m_isStopped && !m_viewOnly) {
+      sendNewClipboard();
+    }
+    if (m_hasRequest && !m_isStopped && !m_viewOnly) {
+      sendRequestedClipboard();
+    }
+  } catch (Exception &e) {
+    m_log->error(_T("The clipboard sending is stopped because")
+               _T(" it caught the error: %s"), e.getMessage());
+    m_isStopped = true;
+  }
+}
+
+void ClipboardExchange::sendNewClipboard()
+{
+  if (m_isLazyClipboardEnabled) {
+    sendOffer();
+    return;
+  }
+
+  const char * data;
+  size_t length;
+  if (m_isUtf8ClipboardEnabled) {
+    Utf8StringStorage charBuff;
+    {
+      AutoLock al(&m_storedClipMut);
+      charBuff.fromStringStorage(&m_storedClip);
+      m_hasNewClip = false;
+    }
+    data = charBuff.getString();
+    length = charBuff.getLength();
+    if (isTooLarge(length, m_maxSentLength)) {
+      m_log->info(_T("Not sending the clipboard of %u bytes, the limit is %u"),
+                  (unsigned int)length, m_maxSentLength);
+      return;
+    }
+    m_log->debug(_T("Sending Utf8 Clipboard, payload length %d"), length);
+    AutoLock al(m_output);
+    m_output->writeUInt32(ServerMsgDefs::SERVER_CUT_TEXT_UTF8); // type
+    m_output->writeUInt32((UINT32)length);
+    m_output->writeFully(data, length);
+    m_output->flush();
+  }
+  else {
+    AnsiStringStorage charBuff;
+    {
+      AutoLock al(&m_storedClipMut);
+      charBuff.fromStringStorage(&m_storedClip);
+      m_hasNewClip = false;
+    }
+    data = charBuff.getString();
+    length = charBuff.getLength();
+    if (isTooLarge(length, m_maxSentLength)) {
+      m_log->info(_T("Not sending the clipboard of %u bytes, the limit is %u"),
+                  (unsigned int)length, m_maxSentLength);
+      return;
+    }
+    m_log->debug(_T("Sending Clipboard, payload length %d"), length);
+    AutoLock al(m_output);
+    m_output->writeUInt8(ServerMsgDefs::SERVER_CUT_TEXT); // type
+    m_output->writeUInt8(0); // pad
+    m_output->writeUInt16(0); // pad
+    m_output->writeUInt32((UINT32)length);
+    m_output->writeFully(data, length);
+    m_output->flush();
+  }
+}
+
+void ClipboardExchange::sendOffer()
+{
+  Utf8StringStorage charBuff;
+  {
+    AutoLock al(&m_storedClipMut);
+    charBuff.fromStringStorage(&m_storedClip);
+    m_hasNewClip = false;
+  }
+  size_t length = charBuff.getLength();
+
+  // A dropped clipboard replaces the offered one all the same, so that the
+  // client cannot fetch an outdated text.
+  m_offerSerial++;
+  m_hasOffer = !isTooLarge(length, m_maxSentLength);
+  if (!m_hasOffer) {
+    m_offeredClip.clear();
+    m_log->info(_T("Not offering the clipboard of %u bytes, the limit is %u"),
+                (unsigned int)length, m_maxSentLength);
+    return;
+  }
+  m_offeredClip.assign(charBuff.getString(), charBuff.getString() + length);
+
+  m_log->debug(_T("Offering the clipboard %u, payload length %u"),
+               (unsigned int)m_offerSerial, (unsigned int)length);
+  AutoLock al(m_output);
+  m_output->writeUInt32(ServerMsgDefs::CUT_TEXT_OFFER);
+  m_output->writeUInt32(m_offerSerial);
+  m_output->writeUInt32((UINT32)length);
+  m_output->flush();
+}
+
+void ClipboardExchange::sendRequestedClipboard()
+{
+  UINT32 serial;
+  UINT8 flags;
+  {
+    AutoLock al(&m_storedClipMut);
+    serial = m_requestedSerial;
+    flags = m_requestFlags;
+    m_hasRequest = false;
+  }
+
+  AutoLock al(&m_bulkOutputMut);
+  RfbOutputGate *output = m_bulkOutput != 0 ? m_bulkOutput : m_output;
+
+  if (!m_hasOffer || serial != m_offerSerial) {
+    m_log->debug(_T("The requested clipboard %u is not offered"),
+                 (unsigned int)serial);
+    sendChunk(output, serial,
+              LazyCutTextDefs::CHUNK_LAST | LazyCutTextDefs::CHUNK_CANCELLED,
+              0, 0, 0);
+    return;
+  }
+
+  m_log->debug(_T("Sending the clipboard %u, payload length %u"),
+               (unsigned int)serial, (unsigned int)m_offeredClip.size());
+  const size_t length = m_offeredClip.size();
+  size_t offset = 0;
+  do {
+    // The new clipboard is offered after the loop.
+    if (m_hasNewClip || m_isStopped) {
+      sendChunk(output, serial,
+                LazyCutTextDefs::CHUNK_LAST | LazyCutTextDefs::CHUNK_CANCELLED,
+                0, 0, 0);
+      return;
+    }
+
+    size_t chunkLength = length - offset;
+    if (chunkLength > LazyCutTextDefs::MAX_CHUNK_LENGTH) {
+      chunkLength = LazyCutTextDefs::MAX_CHUNK_LENGTH;
+    }
+    UINT8 chunkFlags = offset + chunkLength == length ? LazyCutTextDefs::CHUNK_LAST : 0;
+    const char *data = chunkLength != 0 ? &m_offeredClip[offset] : 0;
+    size_t dataLength = chunkLength;
+
+    if ((flags & LazyCutTextDefs::ACCEPT_ZLIB) != 0 &&
+        chunkLength >= MIN_COMPRESSED_LENGTH) {
+      uLongf compressedLength = compressBound((uLong)chunkLength);
+      m_compressedChunk.resize(compressedLength);
+      int result = compress2((Bytef *)&m_compressedChunk.front(), &compressedLength,
+                             (const Bytef *)data, (uLong)chunkLength,
+                             Z_BEST_SPEED);
+      if (result == Z_OK && compressedLength < chunkLength) {
+        data = &m_compressedChunk.front();
+        dataLength = compressedLength;
+        chunkFlags |= LazyCutTextDefs::CHUNK_ZLIB;
       }
     }
+
+    sendChunk(output, serial, chunkFlags, chunkLength, data, dataLength);
+    offset += chunkLength;
+  } while (offset < length);
+}
+
+void ClipboardExchange::sendChunk(RfbOutputGate *output, UINT32 serial,
+                                  UINT8 flags, size_t length,
+                                  const char *data, size_t dataLength)
+{
+  AutoLock al(output);
+  output->writeUInt32(ServerMsgDefs::CUT_TEXT_CHUNK);
+  output->writeUInt32(serial);
+  output->writeUInt8(flags);
+  output->writeUInt32((UINT32)length);
+  output->writeUInt32((UINT32)dataLength);
+  if (dataLength != 0) {
+    output->writeFully(data, dataLength);
   }
+  output->flush();
 }
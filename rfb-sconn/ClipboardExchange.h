@@ -30,36 +30,88 @@
 #include "desktop/Desktop.h"
 #include "network/RfbOutputGate.h"
 #include "log-writer/LogWriter.h"
+#include "thread/TaskScheduler.h"
 
-class ClipboardExchange : public RfbDispatcherListener, public Thread
+#include <vector>
+
+// Sends the clipboard to the client as a task of a scheduler shared by the
+// clients, since a clipboard change is rare.
+class ClipboardExchange : public RfbDispatcherListener, public Task
 {
 public:
   ClipboardExchange(RfbCodeRegistrator *codeRegtor, Desktop *desktop,
-                    RfbOutputGate *output, bool viewOnly, LogWriter *log);
+                    RfbOutputGate *output, bool viewOnly,
+                    TaskScheduler *scheduler, LogWriter *log);
   virtual ~ClipboardExchange();
 
   void sendClipboard(const StringStorage *newClipboard);
+  // Sets the gate of the bulk channel of the client, which carries the
+  // requested clipboards from then on, or 0 when the channel is closed.
+  // Waits until the gate is no longer used by a transfer.
+  void setBulkOutput(RfbOutputGate *bulkOutput);
 
 protected:
   // Listen function
   virtual void onRequest(UINT32 reqCode, RfbInputGate *input);
-  virtual void execute();
-  virtual void onTerminate();
+  virtual void run();
 
 private:
   void onRequestWorker(bool utf8data, RfbInputGate *input);
+  void onCutTextRequest(RfbInputGate *input);
+
+  // Reads and drops length bytes of a clipboard exceeding the limit.
+  void skipClipboard(RfbInputGate *input, UINT32 length);
+
+  // Sends the new clipboard to the client, or only an offer of it if the
+  // client fetches the clipboard lazily.
+  void sendNewClipboard();
+  void sendOffer();
+  // Sends the offered clipboard in chunks, releasing the output gate
+  // between them, so that the updates are not stopped by a large
+  // clipboard. Stops the transfer if a new clipboard appears.
+  void sendRequestedClipboard();
+  void sendChunk(RfbOutputGate *output, UINT32 serial, UINT8 flags,
+                 size_t length, const char *data, size_t dataLength);
+
+  bool isTooLarge(size_t length, unsigned int maxLength);
 
   bool m_viewOnly;
   bool m_isUtf8ClipboardEnabled;
+  bool m_isLazyClipboardEnabled;
   Desktop *m_desktop;
   RfbOutputGate *m_output;
+  // A transfer goes on one gate from the first chunk to the last, the
+  // mutex is held for the whole transfer.
+  RfbOutputGate *m_bulkOutput;
+  LocalMutex m_bulkOutputMut;
 
-  WindowsEvent m_newClipWaiter;
+  TaskScheduler *m_scheduler;
+  // Set when the exchange is destroyed or has failed to send.
+  volatile bool m_isStopped;
 
   StringStorage m_storedClip;
   bool m_hasNewClip;
+  // The last request of the offered clipboard.
+  bool m_hasRequest;
+  UINT32 m_requestedSerial;
+  UINT8 m_requestFlags;
   LocalMutex m_storedClipMut;
 
+  // The offered clipboard in UTF-8 and its serial number, used by the
+  // thread only.
+  std::vector<char> m_offeredClip;
+  bool m_hasOffer;
+  UINT32 m_offerSerial;
+  std::vector<char> m_compressedChunk;
+
+  // Clipboard size limits from the server configuration, 0 if not limited.
+  unsigned int m_maxSentLength;
+  unsigned int m_maxReceivedLength;
+
+  // Chunks shorter than this number of bytes are never compressed.
+  static const size_t MIN_COMPRESSED_LENGTH = 256;
+  static const size_t SKIP_BUFFER_SIZE = 65536;
+
   LogWriter *m_log;
 };
 
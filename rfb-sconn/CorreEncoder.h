@@ -0,0 +1,44 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_CORRE_ENCODER_H_INCLUDED__
+#define __RFB_CORRE_ENCODER_H_INCLUDED__
+
+#include "RreEncoder.h"
+
+//
+// CoRRE is RRE with 8-bit coordinates of subrectangles, the tiles made by
+// RreEncoder::splitRectangle() always fit them.
+//
+
+class CorreEncoder : public RreEncoder
+{
+public:
+  CorreEncoder(PixelConverter *conv, DataOutputStream *output);
+  virtual ~CorreEncoder();
+
+  virtual int getCode() const;
+};
+
+#endif // __RFB_CORRE_ENCODER_H_INCLUDED__
@@ -0,0 +1,166 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DeflateTuner.h"
+
+#include "zlib/zlib.h"
+
+#include <string.h>
+
+DeflateTuner::DeflateTuner()
+: m_maxLevel(-1),
+  m_current(CANDIDATE_CONFIGURED),
+  m_chosen(CANDIDATE_CONFIGURED),
+  m_blockCount(0),
+  m_nextTrial(0),
+  m_switchCount(0)
+{
+  memset(m_candidates, 0, sizeof(m_candidates));
+  m_candidates[CANDIDATE_CONFIGURED].strategy = Z_DEFAULT_STRATEGY;
+  m_candidates[CANDIDATE_FILTERED].strategy = Z_FILTERED;
+  m_candidates[CANDIDATE_FAST].strategy = Z_DEFAULT_STRATEGY;
+  m_candidates[CANDIDATE_FAST].level = 1;
+  m_candidates[CANDIDATE_RLE].strategy = Z_RLE;
+  m_candidates[CANDIDATE_RLE].level = 1;
+}
+
+DeflateTuner::~DeflateTuner()
+{
+}
+
+void DeflateTuner::choose(int maxLevel, int *level, int *strategy)
+{
+  if (maxLevel != m_maxLevel) {
+    // The measurements were made with the other levels.
+    for (int i = 0; i < NUM_CANDIDATES; i++) {
+      m_candidates[i].bytesIn = 0;
+      m_candidates[i].bytesSaved = 0;
+      m_candidates[i].ticks = 0;
+    }
+    m_candidates[CANDIDATE_CONFIGURED].level = maxLevel;
+    m_candidates[CANDIDATE_FILTERED].level = maxLevel;
+    m_maxLevel = maxLevel;
+    if (m_chosen != CANDIDATE_CONFIGURED) {
+      m_chosen = CANDIDATE_CONFIGURED;
+      m_switchCount++;
+    }
+  }
+
+  m_current = m_chosen;
+  if (++m_blockCount % TRIAL_INTERVAL == 0) {
+    for (int i = 0; i < NUM_CANDIDATES; i++) {
+      int trial = (m_nextTrial + i) % NUM_CANDIDATES;
+      if (trial != m_chosen && isUsable(trial, maxLevel)) {
+        m_current = trial;
+        m_nextTrial = trial + 1;
+        break;
+      }
+    }
+  }
+  *level = m_candidates[m_current].level;
+  *strategy = m_candidates[m_current].strategy;
+}
+
+void DeflateTuner::onCompressed(size_t dataLen, size_t compressedLen,
+                                INT64 ticks)
+{
+  Candidate *c = &m_candidates[m_current];
+  c->bytesIn += dataLen;
+  if (compressedLen < dataLen) {
+    c->bytesSaved += dataLen - compressedLen;
+  }
+  c->ticks += ticks;
+  if (c->bytesIn >= WINDOW_SIZE) {
+    c->bytesIn /= 2;
+    c->bytesSaved /= 2;
+    c->ticks /= 2;
+  }
+
+  int best = findBest(m_maxLevel);
+  if (best != m_chosen) {
+    m_chosen = best;
+    m_switchCount++;
+  }
+}
+
+int DeflateTuner::getLevel() const
+{
+  return m_candidates[m_chosen].level;
+}
+
+int DeflateTuner::getStrategy() const
+{
+  return m_candidates[m_chosen].strategy;
+}
+
+UINT32 DeflateTuner::getSwitchCount() const
+{
+  return m_switchCount;
+}
+
+bool DeflateTuner::isUsable(int index, int maxLevel) const
+{
+  switch (index) {
+  case CANDIDATE_CONFIGURED:
+    return true;
+  case CANDIDATE_FAST:
+    return maxLevel > 1;
+  default:
+    // Level 0 stores the data, there is nothing to tune.
+    return maxLevel > 0;
+  }
+}
+
+int DeflateTuner::findBest(int maxLevel) const
+{
+  double bestRatio = 0;
+  for (int i = 0; i < NUM_CANDIDATES; i++) {
+    const Candidate *c = &m_candidates[i];
+    if (isUsable(i, maxLevel) && c->bytesIn >= MIN_MEASURED_SIZE) {
+      double ratio = (double)c->bytesSaved / c->bytesIn;
+      if (ratio > bestRatio) {
+        bestRatio = ratio;
+      }
+    }
+  }
+
+  int best = CANDIDATE_CONFIGURED;
+  double bestRate = -1;
+  for (int i = 0; i < NUM_CANDIDATES; i++) {
+    const Candidate *c = &m_candidates[i];
+    if (!isUsable(i, maxLevel) || c->bytesIn < MIN_MEASURED_SIZE) {
+      continue;
+    }
+    double ratio = (double)c->bytesSaved / c->bytesIn;
+    if (ratio < bestRatio - 1.0 / MAX_RATIO_LOSS) {
+      continue;
+    }
+    double rate = (double)c->bytesSaved / (c->ticks > 0 ? c->ticks : 1);
+    if (rate > bestRate) {
+      bestRate = rate;
+      best = i;
+    }
+  }
+  return best;
+}
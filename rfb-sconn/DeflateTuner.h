@@ -0,0 +1,109 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_DEFLATE_TUNER_H_INCLUDED__
+#define __RFB_DEFLATE_TUNER_H_INCLUDED__
+
+#include "util/inttypes.h"
+
+//
+// DeflateTuner chooses the zlib level and strategy of one compression
+// stream by measuring them on the live data. Each of a few candidate
+// settings, none of which costs more than the configured level, keeps the
+// bytes it has saved and the time it has spent over a window of recent
+// input. The candidate saving the most bytes per unit of time is used,
+// unless its compression is noticeably worse than the best one seen; the
+// others are tried now and then to keep their measurements current.
+//
+// The settings may only be switched between two blocks of the stream, after
+// a flush and before the next input, where deflateParams() emits nothing.
+//
+
+class DeflateTuner
+{
+public:
+  DeflateTuner();
+  virtual ~DeflateTuner();
+
+  // Chooses the level and the strategy for the next block compressed by a
+  // stream configured for maxLevel.
+  void choose(int maxLevel, int *level, int *strategy);
+
+  // Accounts the block compressed with the last chosen settings: dataLen
+  // bytes in, compressedLen bytes out, in ticks of the performance counter.
+  void onCompressed(size_t dataLen, size_t compressedLen, INT64 ticks);
+
+  // Return the settings chosen last, and the number of times they have
+  // changed, for statistics.
+  int getLevel() const;
+  int getStrategy() const;
+  UINT32 getSwitchCount() const;
+
+protected:
+  struct Candidate
+  {
+    int level;
+    int strategy;
+    UINT64 bytesIn;
+    UINT64 bytesSaved;
+    INT64 ticks;
+  };
+
+  // Indexes of the candidates. The first one is the configured level with
+  // the default strategy.
+  static const int CANDIDATE_CONFIGURED = 0;
+  static const int CANDIDATE_FILTERED = 1;
+  static const int CANDIDATE_FAST = 2;
+  static const int CANDIDATE_RLE = 3;
+  static const int NUM_CANDIDATES = 4;
+
+  // The measurements of a candidate are halved once it has compressed
+  // WINDOW_SIZE bytes, so that old data fades out.
+  static const UINT64 WINDOW_SIZE = 4 * 1024 * 1024;
+  // A candidate is measured on at least MIN_MEASURED_SIZE bytes before it
+  // can be chosen.
+  static const UINT64 MIN_MEASURED_SIZE = 64 * 1024;
+  // Every TRIAL_INTERVAL-th block is compressed by another candidate.
+  static const UINT32 TRIAL_INTERVAL = 32;
+  // The chosen candidate may save at most 1/MAX_RATIO_LOSS of the input
+  // less than the best compressing one, the configured level is a request
+  // for bandwidth too.
+  static const int MAX_RATIO_LOSS = 16;
+
+  // Returns true if the candidate can be used with maxLevel, the ones
+  // equal to another candidate are not.
+  bool isUsable(int index, int maxLevel) const;
+  // Returns the usable candidate with the best measurements.
+  int findBest(int maxLevel) const;
+
+  Candidate m_candidates[NUM_CANDIDATES];
+  int m_maxLevel;
+  int m_current;
+  int m_chosen;
+  UINT32 m_blockCount;
+  int m_nextTrial;
+  UINT32 m_switchCount;
+};
+
+#endif // __RFB_DEFLATE_TUNER_H_INCLUDED__
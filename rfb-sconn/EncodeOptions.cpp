@@ -40,17 +40,33 @@ void EncodeOptions::reset()
 
   m_compressionLevel = EO_DEFAULT;
   m_jpegQualityLevel = EO_DEFAULT;
+  m_jpegSubsampling = EO_DEFAULT;
+
+  m_enableRoi = false;
+  m_roiQualityDrop = 0;
 
   m_enableRRE = false;
+  m_enableCoRRE = false;
   m_enableHextile = false;
   m_enableZrle = false;
   m_enableTight = false;
+  m_enableH264 = false;
+  m_enableTileCache = false;
 
   m_enableCopyRect = false;
   m_enableRichCursor = false;
+  m_enableCursorCache = false;
   m_enablePointerPos = false;
   m_enableDesktopSize = false;
   m_enableDesktopConfiguration = false;
+  m_enableContinuousUpdates = false;
+  m_enableFence = false;
+  m_enableTransportZlib = false;
+  m_enableKeepFbOnResize = false;
+  m_enableLastRect = false;
+  m_enableLatencyProbe = false;
+
+  m_scaleFactor = 1;
 }
 
 void EncodeOptions::setEncodings(std::vector<int> *list)
@@ -70,20 +86,43 @@ void EncodeOptions::setEncodings(std::vector<int> *list)
       m_enableTight = true;
     } else if (code == EncodingDefs::ZRLE) {
       m_enableZrle = true;
+    } else if (code == EncodingDefs::H264) {
+      m_enableH264 = true;
+    } else if (code == EncodingDefs::TILE_CACHE) {
+      m_enableTileCache = true;
     } else if (code == EncodingDefs::HEXTILE) {
       m_enableHextile = true;
     } else if (code == EncodingDefs::RRE) {
       m_enableRRE = true;
+    } else if (code == EncodingDefs::CORRE) {
+      m_enableCoRRE = true;
     } else if (code == EncodingDefs::COPYRECT) {
       m_enableCopyRect = true;
     } else if (code == PseudoEncDefs::RICH_CURSOR) {
       m_enableRichCursor = true;
+    } else if (code == PseudoEncDefs::CURSOR_CACHE) {
+      m_enableCursorCache = true;
     } else if (code == PseudoEncDefs::POINTER_POS) {
       m_enablePointerPos = true;
     } else if (code == PseudoEncDefs::DESKTOP_SIZE) {
       m_enableDesktopSize = true;
     } else if (code == PseudoEncDefs::DESKTOP_CONFIGURATION) {
       m_enableDesktopConfiguration = true;
+    } else if (code == PseudoEncDefs::CONTINUOUS_UPDATES) {
+      m_enableContinuousUpdates = true;
+    } else if (code == PseudoEncDefs::FENCE) {
+      m_enableFence = true;
+    } else if (code == PseudoEncDefs::TRANSPORT_ZLIB) {
+      m_enableTransportZlib = true;
+    } else if (code == PseudoEncDefs::KEEP_FB_ON_RESIZE) {
+      m_enableKeepFbOnResize = true;
+    } else if (code == PseudoEncDefs::LAST_RECT) {
+      m_enableLastRect = true;
+    } else if (code == PseudoEncDefs::LATENCY_PROBE) {
+      m_enableLatencyProbe = true;
+    } else if (code >= PseudoEncDefs::SERVER_SCALE_1_2 &&
+               code <= PseudoEncDefs::SERVER_SCALE_1_8) {
+      m_scaleFactor = 2 << (code - PseudoEncDefs::SERVER_SCALE_1_2);
     } else if (code >= PseudoEncDefs::COMPR_LEVEL_0 &&
                code <= PseudoEncDefs::COMPR_LEVEL_9) {
       int level = code - PseudoEncDefs::COMPR_LEVEL_0;
@@ -101,6 +140,11 @@ int EncodeOptions::getPreferredEncoding() const
   return m_preferredEncoding;
 }
 
+void EncodeOptions::setPreferredEncoding(int code)
+{
+  m_preferredEncoding = code;
+}
+
 bool EncodeOptions::encodingEnabled(int code) const
 {
   switch (code) {
@@ -108,12 +152,18 @@ bool EncodeOptions::encodingEnabled(int code) const
     return true;
   case EncodingDefs::RRE:
     return m_enableRRE;
+  case EncodingDefs::CORRE:
+    return m_enableCoRRE;
   case EncodingDefs::HEXTILE:
     return m_enableHextile;
   case EncodingDefs::ZRLE:
     return m_enableZrle;
   case EncodingDefs::TIGHT:
     return m_enableTight;
+  case EncodingDefs::H264:
+    return m_enableH264;
+  case EncodingDefs::TILE_CACHE:
+    return m_enableTileCache;
   }
   return false;
 }
@@ -139,6 +189,43 @@ void EncodeOptions::disableJpeg()
   m_jpegQualityLevel = EO_DEFAULT;
 }
 
+void EncodeOptions::setCompressionLevel(int level)
+{
+  m_compressionLevel = level;
+}
+
+void EncodeOptions::setJpegQualityLevel(int level)
+{
+  m_jpegQualityLevel = level;
+}
+
+int EncodeOptions::getJpegSubsampling(int defaultValue) const
+{
+  int wasSet = (m_jpegSubsampling != EO_DEFAULT);
+  return wasSet ? m_jpegSubsampling : defaultValue;
+}
+
+void EncodeOptions::setJpegSubsampling(int subsampling)
+{
+  m_jpegSubsampling = subsampling;
+}
+
+void EncodeOptions::setRoi(bool enabled, int qualityDrop)
+{
+  m_enableRoi = enabled;
+  m_roiQualityDrop = qualityDrop;
+}
+
+bool EncodeOptions::roiEnabled() const
+{
+  return m_enableRoi;
+}
+
+int EncodeOptions::getRoiQualityDrop() const
+{
+  return m_roiQualityDrop;
+}
+
 bool EncodeOptions::copyRectEnabled() const
 {
   return m_enableCopyRect;
@@ -149,6 +236,11 @@ bool EncodeOptions::richCursorEnabled() const
   return m_enableRichCursor;
 }
 
+bool EncodeOptions::cursorCacheEnabled() const
+{
+  return m_enableRichCursor && m_enableCursorCache;
+}
+
 bool EncodeOptions::pointerPosEnabled() const
 {
   return m_enablePointerPos;
@@ -164,10 +256,46 @@ bool EncodeOptions::desktopConfigurationEnabled() const
   return m_enableDesktopConfiguration;
 }
 
+bool EncodeOptions::continuousUpdatesEnabled() const
+{
+  return m_enableContinuousUpdates;
+}
+
+bool EncodeOptions::fenceEnabled() const
+{
+  return m_enableFence;
+}
+
+bool EncodeOptions::transportZlibEnabled() const
+{
+  return m_enableTransportZlib;
+}
+
+bool EncodeOptions::keepFbOnResizeEnabled() const
+{
+  return m_enableKeepFbOnResize;
+}
+
+bool EncodeOptions::lastRectEnabled() const
+{
+  return m_enableLastRect;
+}
+
+bool EncodeOptions::latencyProbeEnabled() const
+{
+  return m_enableLatencyProbe;
+}
+
+int EncodeOptions::getScaleFactor() const
+{
+  return m_scaleFactor;
+}
+
 bool EncodeOptions::normalEncoding(int code)
 {
   return (code == EncodingDefs::RAW ||
           code == EncodingDefs::RRE ||
+          code == EncodingDefs::CORRE ||
           code == EncodingDefs::HEXTILE ||
           code == EncodingDefs::ZRLE ||
           code == EncodingDefs::TIGHT);
@@ -49,6 +49,10 @@ public:
   // most recent setEncodings() call, EncodingDefs::RAW will be returned.
   int getPreferredEncoding() const;
 
+  // Override the preferred encoding, e.g. by one chosen on our side among
+  // the encodings enabled by the client.
+  void setPreferredEncoding(int code);
+
   // Return true is a particular encoding was enabled via setEncodings(),
   // false otherwise. This function always returns true for the Raw encoding.
   // It should be used only for "normal" encodings (currently, that's Raw,
@@ -73,15 +77,46 @@ public:
   // Disable JPEG for lossless compression
   void disableJpeg();
 
+  // Override the levels set via setEncodings(), the level must be in the
+  // range 0..9.
+  void setCompressionLevel(int level);
+  void setJpegQualityLevel(int level);
+
+  // Chroma subsampling of JPEG data, one of JpegCompressor::SUBSAMPLING_*
+  // values. It is chosen on our side, clients do not request it. If it
+  // was not set, return the value of the defaultValue argument.
+  int getJpegSubsampling(int defaultValue = EO_DEFAULT) const;
+  void setJpegSubsampling(int subsampling);
+
+  // Region of interest ordering: the rectangles around the pointer and the
+  // foreground window are sent first, the other ones after them with the
+  // JPEG quality lowered by qualityDrop levels (the refinement restores
+  // them later). It is chosen on our side, clients do not request it.
+  void setRoi(bool enabled, int qualityDrop);
+  bool roiEnabled() const;
+  int getRoiQualityDrop() const;
+
   //
   // Accessor functions to boolean values.
   //
 
   bool copyRectEnabled() const;
   bool richCursorEnabled() const;
+  // Cursor cache is used for rich cursor shapes only.
+  bool cursorCacheEnabled() const;
   bool pointerPosEnabled() const;
   bool desktopSizeEnabled() const;
   bool desktopConfigurationEnabled() const;
+  bool continuousUpdatesEnabled() const;
+  bool fenceEnabled() const;
+  bool transportZlibEnabled() const;
+  bool keepFbOnResizeEnabled() const;
+  bool lastRectEnabled() const;
+  bool latencyProbeEnabled() const;
+
+  // Returns the factor the client wants the screen to be scaled down by,
+  // 1 if it has not asked for server-side scaling.
+  int getScaleFactor() const;
 
 protected:
 
@@ -97,18 +132,38 @@ protected:
 
   // FIXME: Use something like std::map instead of individual variables.
   bool m_enableRRE;
+  bool m_enableCoRRE;
   bool m_enableHextile;
   bool m_enableZrle;
   bool m_enableTight;
+  // H.264 is used for video regions only, it never becomes the preferred
+  // encoding.
+  bool m_enableH264;
+  // Tile cache encoding is used along with the preferred encoding, it never
+  // becomes the preferred one either.
+  bool m_enableTileCache;
 
   int m_compressionLevel;
   int m_jpegQualityLevel;
+  int m_jpegSubsampling;
+
+  bool m_enableRoi;
+  int m_roiQualityDrop;
 
   bool m_enableCopyRect;
   bool m_enableRichCursor;
+  bool m_enableCursorCache;
   bool m_enablePointerPos;
   bool m_enableDesktopSize;
   bool m_enableDesktopConfiguration;
+  bool m_enableContinuousUpdates;
+  bool m_enableFence;
+  bool m_enableTransportZlib;
+  bool m_enableKeepFbOnResize;
+  bool m_enableLastRect;
+  bool m_enableLatencyProbe;
+
+  int m_scaleFactor;
 };
 
 #endif // __RFB_ENCODE_OPTIONS_H_INCLUDED__
@@ -0,0 +1,183 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncodedRectCache.h"
+
+#include "thread/AutoLock.h"
+#include "zlib/zlib.h"
+
+EncodedRectCache::Key::Key(const Rect *rect, const FrameBuffer *serverFb,
+                           const PixelFormat *clientPf, int encoding,
+                           bool lossy, int compressionLevel,
+                           int jpegQualityLevel, int jpegSubsampling)
+: m_left(rect->left),
+  m_top(rect->top),
+  m_right(rect->right),
+  m_bottom(rect->bottom),
+  m_encoding(encoding),
+  m_lossy(lossy),
+  m_compressionLevel(compressionLevel),
+  m_jpegQualityLevel(jpegQualityLevel),
+  m_jpegSubsampling(jpegSubsampling),
+  m_clientPf(*clientPf)
+{
+  // Two independent checksums make accidental collisions negligible.
+  uLong crc = crc32(0L, Z_NULL, 0);
+  uLong adler = adler32(0L, Z_NULL, 0);
+
+  size_t lineSize = rect->getWidth() * serverFb->getBytesPerPixel();
+  int stride = serverFb->getBytesPerRow();
+  const Bytef *line = (const Bytef *)serverFb->getBufferPtr(rect->left,
+                                                            rect->top);
+  for (int y = rect->top; y < rect->bottom; y++, line += stride) {
+    crc = crc32(crc, line, (uInt)lineSize);
+    adler = adler32(adler, line, (uInt)lineSize);
+  }
+  m_crc = (UINT32)crc;
+  m_adler = (UINT32)adler;
+}
+
+bool EncodedRectCache::Key::operator<(const Key &other) const
+{
+  if (m_crc != other.m_crc) return m_crc < other.m_crc;
+  if (m_adler != other.m_adler) return m_adler < other.m_adler;
+  if (m_left != other.m_left) return m_left < other.m_left;
+  if (m_top != other.m_top) return m_top < other.m_top;
+  if (m_right != other.m_right) return m_right < other.m_right;
+  if (m_bottom != other.m_bottom) return m_bottom < other.m_bottom;
+  if (m_encoding != other.m_encoding) return m_encoding < other.m_encoding;
+  if (m_lossy != other.m_lossy) return m_lossy < other.m_lossy;
+  if (m_compressionLevel != other.m_compressionLevel) {
+    return m_compressionLevel < other.m_compressionLevel;
+  }
+  if (m_jpegQualityLevel != other.m_jpegQualityLevel) {
+    return m_jpegQualityLevel < other.m_jpegQualityLevel;
+  }
+  if (m_jpegSubsampling != other.m_jpegSubsampling) {
+    return m_jpegSubsampling < other.m_jpegSubsampling;
+  }
+
+  const PixelFormat &a = m_clientPf;
+  const PixelFormat &b = other.m_clientPf;
+  if (a.bitsPerPixel != b.bitsPerPixel) return a.bitsPerPixel < b.bitsPerPixel;
+  if (a.colorDepth != b.colorDepth) return a.colorDepth < b.colorDepth;
+  if (a.redMax != b.redMax) return a.redMax < b.redMax;
+  if (a.greenMax != b.greenMax) return a.greenMax < b.greenMax;
+  if (a.blueMax != b.blueMax) return a.blueMax < b.blueMax;
+  if (a.redShift != b.redShift) return a.redShift < b.redShift;
+  if (a.greenShift != b.greenShift) return a.greenShift < b.greenShift;
+  if (a.blueShift != b.blueShift) return a.blueShift < b.blueShift;
+  return a.bigEndian < b.bigEndian;
+}
+
+EncodedRectCache::EncodedRectCache(size_t maxSize)
+: m_size(0),
+  m_maxSize(maxSize),
+  m_generation(0),
+  m_enabled(false)
+{
+}
+
+EncodedRectCache::~EncodedRectCache()
+{
+}
+
+void EncodedRectCache::setEnabled(bool enabled)
+{
+  AutoLock al(&m_lock);
+  if (m_enabled && !enabled) {
+    m_entries.clear();
+    m_size = 0;
+  }
+  m_enabled = enabled;
+}
+
+void EncodedRectCache::clear()
+{
+  AutoLock al(&m_lock);
+  m_entries.clear();
+  m_size = 0;
+}
+
+bool EncodedRectCache::isEnabled()
+{
+  AutoLock al(&m_lock);
+  return m_enabled;
+}
+
+void EncodedRectCache::nextGeneration()
+{
+  AutoLock al(&m_lock);
+  m_generation++;
+  if (m_generation > MAX_AGE) {
+    dropOlderThan(m_generation - MAX_AGE);
+  }
+}
+
+bool EncodedRectCache::lookup(const Key *key, std::vector<char> *data)
+{
+  AutoLock al(&m_lock);
+  EntryMap::iterator i = m_entries.find(*key);
+  if (i == m_entries.end()) {
+    return false;
+  }
+  i->second.generation = m_generation;
+  if (data != 0) {
+    *data = i->second.data;
+  }
+  return true;
+}
+
+void EncodedRectCache::store(const Key *key, const char *data, size_t size)
+{
+  AutoLock al(&m_lock);
+  if (!m_enabled || size == 0 || size > m_maxSize) {
+    return;
+  }
+  if (m_size + size > m_maxSize) {
+    dropOlderThan(m_generation);
+    if (m_size + size > m_maxSize) {
+      return;
+    }
+  }
+
+  Entry &entry = m_entries[*key];
+  m_size -= entry.data.size();
+  entry.data.assign(data, data + size);
+  entry.generation = m_generation;
+  m_size += size;
+}
+
+void EncodedRectCache::dropOlderThan(unsigned int minGeneration)
+{
+  EntryMap::iterator i = m_entries.begin();
+  while (i != m_entries.end()) {
+    if (i->second.generation < minGeneration) {
+      m_size -= i->second.data.size();
+      m_entries.erase(i++);
+    } else {
+      i++;
+    }
+  }
+}
@@ -0,0 +1,137 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_ENCODED_RECT_CACHE_H_INCLUDED__
+#define __RFB_ENCODED_RECT_CACHE_H_INCLUDED__
+
+#include <map>
+#include <vector>
+
+#include "region/Rect.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelFormat.h"
+#include "thread/LocalMutex.h"
+
+//
+// EncodedRectCache keeps encoded representations of recently sent rectangles
+// so that a rectangle changed on the desktop is encoded only once and the
+// result is reused by every RFB client requesting the same encoding with the
+// same parameters. One object is shared by all the UpdateSender threads.
+//
+// Entries are looked up by a Key which includes the rectangle coordinates,
+// a checksum of the server-side pixels the rectangle covers, the encoding
+// type, the client pixel format and the encoding levels. Each UpdateSender
+// takes its own snapshot of the framebuffer at its own moment, so the pixel
+// checksum is used to guarantee that cached data is reused only for the same
+// pixels. The framebuffer generation (incremented by nextGeneration() for
+// each update from the desktop) is used to age entries out.
+//
+// Only the output of stateless encoders may be stored here, see
+// Encoder::isStateless().
+//
+
+class EncodedRectCache
+{
+public:
+  class Key
+  {
+  public:
+    // Computes the key for the rectangle `rect' taken from `serverFb' and
+    // encoded for a client with the pixel format `clientPf'. `lossy' should
+    // be true if the data was produced by the JPEG encoder. Levels and the
+    // subsampling that do not affect the encoding should be passed as -1.
+    Key(const Rect *rect, const FrameBuffer *serverFb,
+        const PixelFormat *clientPf, int encoding, bool lossy,
+        int compressionLevel, int jpegQualityLevel, int jpegSubsampling);
+
+    bool operator<(const Key &other) const;
+
+  private:
+    int m_left, m_top, m_right, m_bottom;
+    UINT32 m_crc;
+    UINT32 m_adler;
+    int m_encoding;
+    bool m_lossy;
+    int m_compressionLevel;
+    int m_jpegQualityLevel;
+    int m_jpegSubsampling;
+    PixelFormat m_clientPf;
+  };
+
+  EncodedRectCache(size_t maxSize = DEFAULT_MAX_SIZE);
+  virtual ~EncodedRectCache();
+
+  // The cache is disabled by default. RfbClientManager enables it while
+  // there are at least two clients which can share encoded data. Disabling
+  // the cache drops all the entries.
+  void setEnabled(bool enabled);
+  bool isEnabled();
+
+  // Starts a new framebuffer generation. Entries which were not used during
+  // the last MAX_AGE generations are discarded.
+  void nextGeneration();
+
+  // If an entry for the key exists, copies its data to `data' (unless it is
+  // 0) and returns true. Otherwise, returns false.
+  bool lookup(const Key *key, std::vector<char> *data);
+
+  // Stores encoded data for the key. Data will not be stored if the cache is
+  // disabled or the size limit would be exceeded even after discarding all
+  // the entries from previous generations.
+  void store(const Key *key, const char *data, size_t size);
+
+  // Drops all the entries, the cache stays enabled or disabled.
+  void clear();
+
+  // The default limit for the total size of the encoded data, in bytes.
+  static const size_t DEFAULT_MAX_SIZE = 32 * 1024 * 1024;
+  // The number of generations an unused entry survives.
+  static const unsigned int MAX_AGE = 2;
+
+protected:
+  struct Entry
+  {
+    std::vector<char> data;
+    unsigned int generation;
+  };
+  typedef std::map<Key, Entry> EntryMap;
+
+  // Discards entries which were last used before `minGeneration'. Should be
+  // called with m_lock locked.
+  void dropOlderThan(unsigned int minGeneration);
+
+  EntryMap m_entries;
+  size_t m_size;
+  size_t m_maxSize;
+  unsigned int m_generation;
+  bool m_enabled;
+  LocalMutex m_lock;
+
+private:
+  // Do not allow copying objects.
+  EncodedRectCache(const EncodedRectCache &other);
+  EncodedRectCache &operator=(const EncodedRectCache &other);
+};
+
+#endif // __RFB_ENCODED_RECT_CACHE_H_INCLUDED__
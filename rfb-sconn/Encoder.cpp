@@ -55,15 +55,41 @@ void Encoder::sendRectangle(const Rect *rect,
   int pixelSize = (int)fb->getBytesPerPixel();
   _ASSERT(pixelSize == fb->getBytesPerPixel());
 
-  UINT8 *buffer = (UINT8 *)fb->getBuffer();
   int lineWidth = rect->getWidth();
-  int fbWidth = fb->getDimension().width;
   int lineSizeInBytes = lineWidth * pixelSize;
-  int stride = fbWidth * pixelSize;
-  UINT8 *lineP = &buffer[(rect->top * fbWidth + rect->left) * pixelSize];
+  int stride = fb->getBytesPerRow();
+  UINT8 *lineP = (UINT8 *)fb->getBufferPtr(rect->left, rect->top);
 
-  // Send the rectangle as is, line by line.
-  for (int i = rect->top; i < rect->bottom; i++, lineP += stride) {
-    m_output->writeFully((char *)lineP, lineSizeInBytes);
-  }
+  // Send the rectangle as is, the lines go to the output stream straight
+  // from the frame buffer (the server one if no conversion is needed).
+  m_output->writeRowsFully(lineP, lineSizeInBytes, stride, rect->getHeight());
+}
+
+bool Encoder::isStateless() const
+{
+  return true;
+}
+
+void Encoder::setStateless(bool stateless)
+{
+}
+
+bool Encoder::restartStream()
+{
+  return isStateless();
+}
+
+size_t Encoder::getRectOverhead(const EncodeOptions *options) const
+{
+  size_t pixelSize = m_pixelConverter->getDstBitsPerPixel() / 8;
+  return RECT_HEADER_SIZE / max(pixelSize, (size_t)1);
+}
+
+size_t Encoder::getScratchSize() const
+{
+  return 0;
+}
+
+void Encoder::releaseScratch()
+{
 }
@@ -96,8 +96,46 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options) throw(IOException);
 
+  // Return true if the data produced by sendRectangle() depends only on the
+  // pixels of the rectangle, the client pixel format and the encode options,
+  // so that it may be sent to any other client with the same parameters
+  // (see EncodedRectCache). The default implementation returns true.
+  virtual bool isStateless() const;
+
+  // Ask the encoder to make its output stateless (or to return to the normal
+  // mode) if it supports that. Encoders which are always stateless, or never
+  // can be, ignore this call. This is what the default implementation does.
+  virtual void setStateless(bool stateless);
+
+  // Make the data sent after this call decodable without the data sent
+  // before it, so that a recorded session can be played from that point.
+  // Returns false if the encoder cannot do that. The default implementation
+  // returns what isStateless() does.
+  virtual bool restartStream();
+
+  // Return the number of unchanged pixels that is worth sending along with
+  // the changed ones to save one rectangle, its header and the encoder
+  // setup (see RectMerger). 0 means that the rectangles are not merged,
+  // which lossy encoders return so that only the changed pixels go lossy.
+  // The default implementation returns the size of the rectangle header
+  // in raw pixels of the client.
+  virtual size_t getRectOverhead(const EncodeOptions *options) const;
+
+  // Return the number of bytes in the buffers which the encoder keeps
+  // between rectangles so as not to allocate them again. The default
+  // implementation returns 0.
+  virtual size_t getScratchSize() const;
+
+  // Free the buffers counted by getScratchSize(), they grow again with the
+  // next rectangles. The state of the encoded stream is not affected. The
+  // default implementation does nothing.
+  virtual void releaseScratch();
+
 protected:
 
+  // Size of the rectangle header of the FramebufferUpdate message.
+  static const size_t RECT_HEADER_SIZE = 12;
+
   // PixelConverter is used for converting pixels from the given framebuffer
   // to some other pixel format (typically, the pixel format using by an RFB
   // client). Encoders may assume it will be properly configured at the moment
@@ -0,0 +1,144 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "EncoderContextPool.h"
+#include "thread/AutoLock.h"
+#include "util/MemAccount.h"
+
+EncoderContextPool EncoderContextPool::s_instance;
+
+EncoderContextPool::EncoderContextPool()
+{
+}
+
+EncoderContextPool::~EncoderContextPool()
+{
+  for (size_t i = 0; i < m_idleStreams.size(); i++) {
+    destroyDeflateStream(m_idleStreams[i].stream);
+  }
+  for (size_t i = 0; i < m_idleCompressors.size(); i++) {
+    delete m_idleCompressors[i];
+  }
+}
+
+EncoderContextPool *EncoderContextPool::getInstance()
+{
+  return &s_instance;
+}
+
+void EncoderContextPool::warmUp()
+{
+  AutoLock al(&m_lock);
+  while (m_idleStreams.size() < WARM_DEFLATE_STREAMS) {
+    IdleStream idle;
+    idle.stream = createDeflateStream();
+    idle.level = DEFAULT_ZLIB_LEVEL;
+    m_idleStreams.push_back(idle);
+  }
+  while (m_idleCompressors.size() < WARM_JPEG_COMPRESSORS) {
+    m_idleCompressors.push_back(new StandardJpegCompressor);
+  }
+}
+
+z_stream *EncoderContextPool::leaseDeflateStream(int *level)
+{
+  {
+    AutoLock al(&m_lock);
+    if (!m_idleStreams.empty()) {
+      IdleStream idle = m_idleStreams.back();
+      m_idleStreams.pop_back();
+      *level = idle.level;
+      return idle.stream;
+    }
+  }
+  *level = DEFAULT_ZLIB_LEVEL;
+  return createDeflateStream();
+}
+
+void EncoderContextPool::returnDeflateStream(z_stream *stream, int level)
+{
+  // The strategy may have been changed by DeflateTuner. Right after the
+  // reset, deflateParams() has nothing to flush.
+  if (deflateReset(stream) == Z_OK &&
+      deflateParams(stream, level, Z_DEFAULT_STRATEGY) == Z_OK) {
+    AutoLock al(&m_lock);
+    if (m_idleStreams.size() < MAX_IDLE_DEFLATE_STREAMS) {
+      IdleStream idle;
+      idle.stream = stream;
+      idle.level = level;
+      m_idleStreams.push_back(idle);
+      return;
+    }
+  }
+  destroyDeflateStream(stream);
+}
+
+StandardJpegCompressor *EncoderContextPool::leaseJpegCompressor()
+{
+  {
+    AutoLock al(&m_lock);
+    if (!m_idleCompressors.empty()) {
+      StandardJpegCompressor *compressor = m_idleCompressors.back();
+      m_idleCompressors.pop_back();
+      return compressor;
+    }
+  }
+  return new StandardJpegCompressor;
+}
+
+void EncoderContextPool::returnJpegCompressor(StandardJpegCompressor *compressor)
+{
+  compressor->resetQuality();
+  compressor->setSubsampling(JpegCompressor::SUBSAMPLING_420);
+  {
+    AutoLock al(&m_lock);
+    if (m_idleCompressors.size() < MAX_IDLE_JPEG_COMPRESSORS) {
+      m_idleCompressors.push_back(compressor);
+      return;
+    }
+  }
+  delete compressor;
+}
+
+z_stream *EncoderContextPool::createDeflateStream()
+{
+  z_stream *stream = new z_stream;
+  stream->zalloc = MemAccount::zlibAlloc;
+  stream->zfree = MemAccount::zlibFree;
+  stream->opaque = Z_NULL;
+
+  int err = deflateInit2(stream, DEFAULT_ZLIB_LEVEL, Z_DEFLATED, MAX_WBITS,
+                         MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+  if (err != Z_OK) {
+    delete stream;
+    throw IOException(_T("Zlib stream initialization failed in Tight encoder"));
+  }
+  return stream;
+}
+
+void EncoderContextPool::destroyDeflateStream(z_stream *stream)
+{
+  deflateEnd(stream);
+  delete stream;
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_ENCODER_CONTEXT_POOL_H_INCLUDED__
+#define __RFB_ENCODER_CONTEXT_POOL_H_INCLUDED__
+
+#include <vector>
+
+#include "util/CommonHeader.h"
+#include "thread/LocalMutex.h"
+#include "io-lib/IOException.h"
+#include "JpegCompressor.h"
+
+#include "zlib/zlib.h"
+
+// Process-wide pool of initialized compression contexts: the zlib streams
+// and the JPEG compressors of the Tight encoders. A new encoder leases
+// ready contexts instead of allocating and initializing its own, and
+// returns them when it is destroyed, so that a burst of connections does
+// not spend its time in deflateInit2() and jpeg_create_compress().
+//
+// A returned context is reset to the state of a newly initialized one: a
+// zlib stream with deflateReset() and the default strategy, a compressor to the default quality and
+// subsampling. The pool keeps a limited number of idle contexts, the rest
+// are freed on return.
+class EncoderContextPool
+{
+public:
+  static EncoderContextPool *getInstance();
+
+  // Initializes the idle contexts up to the warm counts below.
+  void warmUp() throw(IOException);
+
+  // Returns a zlib stream for deflating with the Tight parameters and sets
+  // *level to its current compression level.
+  z_stream *leaseDeflateStream(int *level) throw(IOException);
+  // Takes back a leased stream with its current compression level.
+  void returnDeflateStream(z_stream *stream, int level);
+
+  StandardJpegCompressor *leaseJpegCompressor();
+  void returnJpegCompressor(StandardJpegCompressor *compressor);
+
+  // Contexts initialized by warmUp(), enough for a few Tight clients.
+  static const size_t WARM_DEFLATE_STREAMS = 16;
+  static const size_t WARM_JPEG_COMPRESSORS = 4;
+  // Returned contexts over these counts are freed.
+  static const size_t MAX_IDLE_DEFLATE_STREAMS = 64;
+  static const size_t MAX_IDLE_JPEG_COMPRESSORS = 16;
+  // Compression level of the new streams.
+  static const int DEFAULT_ZLIB_LEVEL = 6;
+
+private:
+  EncoderContextPool();
+  ~EncoderContextPool();
+
+  z_stream *createDeflateStream() throw(IOException);
+  static void destroyDeflateStream(z_stream *stream);
+
+  struct IdleStream
+  {
+    z_stream *stream;
+    int level;
+  };
+
+  std::vector<IdleStream> m_idleStreams;
+  std::vector<StandardJpegCompressor *> m_idleCompressors;
+  LocalMutex m_lock;
+
+  static EncoderContextPool s_instance;
+};
+
+#endif // __RFB_ENCODER_CONTEXT_POOL_H_INCLUDED__
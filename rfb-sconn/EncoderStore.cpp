@@ -25,6 +25,7 @@
 #include "EncoderStore.h"
 
 #include "RreEncoder.h"
+#include "CorreEncoder.h"
 #include "HextileEncoder.h"
 #include "ZrleEncoder.h"
 #include "TightEncoder.h"
@@ -32,6 +33,9 @@
 EncoderStore::EncoderStore(PixelConverter *pixelConverter, DataOutputStream *output)
 : m_encoder(0),
   m_jpegEncoder(0),
+  m_h264Encoder(0),
+  m_h264Failed(false),
+  m_tileCacheEncoder(0),
   m_pixelConverter(pixelConverter),
   m_output(output)
 {
@@ -43,6 +47,12 @@ EncoderStore::~EncoderStore()
   if (m_jpegEncoder != 0) {
     delete m_jpegEncoder;
   }
+  if (m_h264Encoder != 0) {
+    delete m_h264Encoder;
+  }
+  if (m_tileCacheEncoder != 0) {
+    delete m_tileCacheEncoder;
+  }
   // Remove all allocated encoders referenced in m_map.
   std::map<int, Encoder *>::iterator it;
   for (it = m_map.begin(); it != m_map.end(); it++) {
@@ -60,6 +70,16 @@ JpegEncoder *EncoderStore::getJpegEncoder() const
   return m_jpegEncoder;
 }
 
+H264Encoder *EncoderStore::getH264Encoder() const
+{
+  return m_h264Encoder;
+}
+
+TileCacheEncoder *EncoderStore::getTileCacheEncoder() const
+{
+  return m_tileCacheEncoder;
+}
+
 void EncoderStore::selectEncoder(int encType)
 {
   m_encoder = validateEncoder(encType);
@@ -73,6 +93,66 @@ void EncoderStore::validateJpegEncoder()
   }
 }
 
+void EncoderStore::validateH264Encoder()
+{
+  if (m_h264Encoder == 0 && !m_h264Failed) {
+    try {
+      m_h264Encoder = new H264Encoder(m_pixelConverter, m_output);
+    } catch (Exception &) {
+      m_h264Failed = true;
+    }
+  }
+}
+
+void EncoderStore::validateTileCacheEncoder()
+{
+  if (m_tileCacheEncoder == 0) {
+    m_tileCacheEncoder = new TileCacheEncoder(m_pixelConverter, m_output);
+  }
+}
+
+bool EncoderStore::restartStreams()
+{
+  bool restarted = true;
+  // JpegEncoder uses TightEncoder from m_map, it is restarted along with it.
+  std::map<int, Encoder *>::iterator it;
+  for (it = m_map.begin(); it != m_map.end(); it++) {
+    restarted = it->second->restartStream() && restarted;
+  }
+  if (m_h264Encoder != 0) {
+    restarted = m_h264Encoder->restartStream() && restarted;
+  }
+  if (m_tileCacheEncoder != 0) {
+    restarted = m_tileCacheEncoder->restartStream() && restarted;
+  }
+  return restarted;
+}
+
+size_t EncoderStore::getScratchSize() const
+{
+  // JpegEncoder encodes with TightEncoder from m_map.
+  size_t size = 0;
+  std::map<int, Encoder *>::const_iterator it;
+  for (it = m_map.begin(); it != m_map.end(); it++) {
+    size += it->second->getScratchSize();
+  }
+  if (m_h264Encoder != 0) {
+    size += m_h264Encoder->getScratchSize();
+  }
+  return size;
+}
+
+void EncoderStore::releaseScratch()
+{
+  std::map<int, Encoder *>::iterator it;
+  for (it = m_map.begin(); it != m_map.end(); it++) {
+    it->second->releaseScratch();
+  }
+  if (m_h264Encoder != 0) {
+    m_h264Encoder->releaseScratch();
+  }
+}
+
 //---------------------------- Internal methods ----------------------------//
 
 Encoder *EncoderStore::validateEncoder(int encType)
@@ -106,6 +186,7 @@ bool EncoderStore::encodingSupported(int encType)
 {
   return (encType == EncodingDefs::RAW ||
           encType == EncodingDefs::RRE ||
+          encType == EncodingDefs::CORRE ||
           encType == EncodingDefs::HEXTILE ||
           encType == EncodingDefs::ZRLE ||
           encType == EncodingDefs::TIGHT);
@@ -122,6 +203,8 @@ Encoder *EncoderStore::allocateEncoder(int encType) const
     return new HextileEncoder(m_pixelConverter, m_output);
   case EncodingDefs::RRE:
     return new RreEncoder(m_pixelConverter, m_output);
+  case EncodingDefs::CORRE:
+    return new CorreEncoder(m_pixelConverter, m_output);
   case EncodingDefs::RAW:
     return new Encoder(m_pixelConverter, m_output);
   default:
@@ -29,6 +29,8 @@
 
 #include "Encoder.h"
 #include "JpegEncoder.h"
+#include "H264Encoder.h"
+#include "TileCacheEncoder.h"
 
 // EncoderStore is an object which allocates encoders on demand and serves
 // callers with a pointer to currectly selected encoder. The goal of
@@ -40,7 +42,10 @@
 //
 // In addition to normal encoders, JPEG encoder is maintained as well. JPEG
 // encoder works via an existing Tight encoder and forces it to use lossy JPEG
-// compression whenever possible.
+// compression whenever possible. H.264 encoder is maintained the same way,
+// it is used for video regions when the client supports it. The tile cache
+// encoder is maintained the same way too, it is used along with the
+// preferred encoder.
 
 class EncoderStore
 {
@@ -59,9 +64,28 @@ public:
   // Get a pointer to JpegEncoder if it was previously allocated by
   // validateJpegEncoder().
   JpegEncoder *getJpegEncoder() const;
+  // Get a pointer to H264Encoder if it was successfully allocated by
+  // validateH264Encoder().
+  H264Encoder *getH264Encoder() const;
+  // Get a pointer to TileCacheEncoder if it was previously allocated by
+  // validateTileCacheEncoder().
+  TileCacheEncoder *getTileCacheEncoder() const;
 
   void selectEncoder(int encType);
   void validateJpegEncoder();
+  // Allocates H264Encoder. The allocation fails if H.264 encoding is not
+  // available on this system, it is not retried then.
+  void validateH264Encoder();
+  void validateTileCacheEncoder();
+
+  // Restarts the streams of all the allocated encoders, see
+  // Encoder::restartStream(). Returns false if any of them cannot restart.
+  bool restartStreams();
+
+  // Returns the total scratch size of the allocated encoders and frees
+  // their scratch buffers, see Encoder::releaseScratch().
+  size_t getScratchSize() const;
+  void releaseScratch();
 
 protected:
   // This function makes sure the specified encoder is allocated and stored in
@@ -96,6 +120,11 @@ protected:
   // JpegEncoder, there is no record in m_map for it, so this pointer should
   // be used to delete JpegEncoder on destruction.
   JpegEncoder *m_jpegEncoder;
+  // Video-specific H.264 encoder, maintained like m_jpegEncoder.
+  H264Encoder *m_h264Encoder;
+  bool m_h264Failed;
+  // Tile cache encoder, maintained like m_jpegEncoder.
+  TileCacheEncoder *m_tileCacheEncoder;
 
   // This pointer to PixelConverter will be used to construct encoders.
   PixelConverter *m_pixelConverter;
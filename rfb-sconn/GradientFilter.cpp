@@ -0,0 +1,101 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "GradientFilter.h"
+#include "util/CpuFeatures.h"
+
+#include <emmintrin.h>
+
+void GradientFilter::filter24(const UINT8 *src, UINT8 *dst,
+                              int width, int height)
+{
+  const int length = width * 3;
+  if (length == 0) {
+    return;
+  }
+  const bool sse2 = CpuFeatures::hasSse2();
+
+  // The first row is predicted by the left neighbours only.
+  int x = 0;
+  for (; x < 3; x++) {
+    dst[x] = src[x];
+  }
+  for (; x < length; x++) {
+    dst[x] = (UINT8)(src[x] - src[x - 3]);
+  }
+
+  for (int y = 1; y < height; y++) {
+    const UINT8 *row = src + y * length;
+    const UINT8 *upperRow = row - length;
+    UINT8 *dstRow = dst + y * length;
+
+    // The first pixel of a row is predicted by the upper one only.
+    for (x = 0; x < 3; x++) {
+      dstRow[x] = (UINT8)(row[x] - upperRow[x]);
+    }
+    if (sse2) {
+      x = filterRowSse2(row, upperRow, dstRow, x, length);
+    }
+    filterRowPlain(row, upperRow, dstRow, x, length);
+  }
+}
+
+int GradientFilter::filterRowPlain(const UINT8 *row, const UINT8 *upperRow,
+                                   UINT8 *dst, int begin, int length)
+{
+  int x = begin;
+  for (; x < length; x++) {
+    int prediction = row[x - 3] + upperRow[x] - upperRow[x - 3];
+    prediction = prediction < 0 ? 0 : prediction > 0xFF ? 0xFF : prediction;
+    dst[x] = (UINT8)(row[x] - prediction);
+  }
+  return x;
+}
+
+int GradientFilter::filterRowSse2(const UINT8 *row, const UINT8 *upperRow,
+                                  UINT8 *dst, int begin, int length)
+{
+  // The prediction uses the original values only, so 16 bytes of a row are
+  // filtered at once. It is computed in 16-bit lanes, and the unsigned
+  // saturation of _mm_packus_epi16() clamps it to [0, 255].
+  const __m128i zero = _mm_setzero_si128();
+  int x = begin;
+  for (; x + 16 <= length; x += 16) {
+    __m128i value = _mm_loadu_si128((const __m128i *)(row + x));
+    __m128i left = _mm_loadu_si128((const __m128i *)(row + x - 3));
+    __m128i upper = _mm_loadu_si128((const __m128i *)(upperRow + x));
+    __m128i upperLeft = _mm_loadu_si128((const __m128i *)(upperRow + x - 3));
+
+    __m128i low = _mm_sub_epi16(_mm_add_epi16(_mm_unpacklo_epi8(left, zero),
+                                              _mm_unpacklo_epi8(upper, zero)),
+                                _mm_unpacklo_epi8(upperLeft, zero));
+    __m128i high = _mm_sub_epi16(_mm_add_epi16(_mm_unpackhi_epi8(left, zero),
+                                               _mm_unpackhi_epi8(upper, zero)),
+                                 _mm_unpackhi_epi8(upperLeft, zero));
+    __m128i prediction = _mm_packus_epi16(low, high);
+
+    _mm_storeu_si128((__m128i *)(dst + x), _mm_sub_epi8(value, prediction));
+  }
+  return x;
+}
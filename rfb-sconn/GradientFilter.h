@@ -0,0 +1,55 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_GRADIENT_FILTER_H_INCLUDED__
+#define __RFB_GRADIENT_FILTER_H_INCLUDED__
+
+#include "util/inttypes.h"
+
+//
+// GradientFilter implements the "gradient" filter of the Tight encoding for
+// pixels packed into 24-bit samples, with SSE2 if the processor supports it.
+// Each byte is replaced with its difference from the prediction
+// clamp(left + upper - upper left) made from the same color component of
+// the neighbouring pixels.
+//
+class GradientFilter
+{
+public:
+  //
+  // Filters width x height pixels of 3 bytes each, stored row by row without
+  // gaps, from src to dst. The buffers must not overlap.
+  //
+  static void filter24(const UINT8 *src, UINT8 *dst, int width, int height);
+
+private:
+  // Filter the bytes of a row starting from the offset begin (which is at
+  // least 3), return the offset of the first byte left unfiltered.
+  static int filterRowPlain(const UINT8 *row, const UINT8 *upperRow,
+                            UINT8 *dst, int begin, int length);
+  static int filterRowSse2(const UINT8 *row, const UINT8 *upperRow,
+                           UINT8 *dst, int begin, int length);
+};
+
+#endif // __RFB_GRADIENT_FILTER_H_INCLUDED__
@@ -0,0 +1,455 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "H264Compressor.h"
+
+#include "util/Exception.h"
+#include "thread/Thread.h"
+
+H264Compressor::H264Compressor(MediaFoundation *mf, int width, int height)
+: m_mf(mf),
+  m_transform(0),
+  m_codecApi(0),
+  m_eventGenerator(0),
+  m_async(false),
+  m_inputStreamId(0),
+  m_outputStreamId(0),
+  m_inputRequests(0),
+  m_width(width),
+  m_height(height),
+  m_quality(-1), // make sure (m_quality != m_newQuality)
+  m_newQuality(DEFAULT_QUALITY),
+  m_keyFrameRequested(false),
+  m_startTime(DateTime::now()),
+  m_lastSampleTime(-1)
+{
+  _ASSERT(width % 2 == 0 && height % 2 == 0);
+
+  m_transform = m_mf->createTransform(MFT_CATEGORY_VIDEO_ENCODER,
+                                      MFVideoFormat_NV12,
+                                      MFVideoFormat_H264, true);
+  try {
+    IMFAttributes *attributes;
+    if (SUCCEEDED(m_transform->GetAttributes(&attributes))) {
+      if (MFGetAttributeUINT32(attributes, MF_TRANSFORM_ASYNC, FALSE)) {
+        // Asynchronous transforms refuse to work until being unlocked.
+        attributes->SetUINT32(MF_TRANSFORM_ASYNC_UNLOCK, TRUE);
+        m_async = true;
+      }
+      attributes->Release();
+    }
+    if (m_async) {
+      HRESULT hr = m_transform->QueryInterface(__uuidof(IMFMediaEventGenerator),
+                                               (void **)&m_eventGenerator);
+      if (FAILED(hr)) {
+        throw Exception(_T("Asynchronous H.264 encoder without events"));
+      }
+    }
+    if (FAILED(m_transform->QueryInterface(__uuidof(ICodecAPI),
+                                           (void **)&m_codecApi))) {
+      m_codecApi = 0;
+    }
+
+    // Transforms with a fixed number of streams do not implement
+    // GetStreamIDs(), their stream identifiers are zeros.
+    HRESULT hr = m_transform->GetStreamIDs(1, &m_inputStreamId,
+                                           1, &m_outputStreamId);
+    if (hr == E_NOTIMPL) {
+      m_inputStreamId = m_outputStreamId = 0;
+    } else if (FAILED(hr)) {
+      throw Exception(_T("Cannot get H.264 encoder streams, error code = %x"),
+                      (unsigned)hr);
+    }
+
+    // Screen content needs each frame right away, so no B-frames and no
+    // frame reordering.
+    setCodecBoolValue(&CODECAPI_AVLowLatencyMode, true);
+    setCodecValue(&CODECAPI_AVEncMPVDefaultBPictureCount, 0);
+    setCodecValue(&CODECAPI_AVEncMPVGOPSize, GOP_SIZE);
+    setCodecValue(&CODECAPI_AVEncCommonRateControlMode,
+                  eAVEncCommonRateControlMode_Quality);
+
+    // Encoders need the output type to be set before the input type.
+    setOutputType();
+    setInputType();
+
+    m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0);
+    m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0);
+  } catch (...) {
+    if (m_eventGenerator != 0) {
+      m_eventGenerator->Release();
+    }
+    if (m_codecApi != 0) {
+      m_codecApi->Release();
+    }
+    m_transform->Release();
+    throw;
+  }
+}
+
+H264Compressor::~H264Compressor()
+{
+  m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, 0);
+  m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0);
+  if (m_eventGenerator != 0) {
+    m_eventGenerator->Release();
+  }
+  if (m_codecApi != 0) {
+    m_codecApi->Release();
+  }
+  // Asynchronous transforms must be shut down explicitly.
+  IMFShutdown *shutdown;
+  if (SUCCEEDED(m_transform->QueryInterface(__uuidof(IMFShutdown),
+                                            (void **)&shutdown))) {
+    shutdown->Shutdown();
+    shutdown->Release();
+  }
+  m_transform->Release();
+}
+
+int H264Compressor::getWidth() const
+{
+  return m_width;
+}
+
+int H264Compressor::getHeight() const
+{
+  return m_height;
+}
+
+void H264Compressor::setQuality(int quality)
+{
+  if (quality < 0) {
+    quality = 0;
+  } else if (quality > 100) {
+    quality = 100;
+  }
+  m_newQuality = quality;
+}
+
+void H264Compressor::requestKeyFrame()
+{
+  m_keyFrameRequested = true;
+}
+
+void H264Compressor::compress(const FrameBuffer *fb, const Rect *rect)
+{
+  _ASSERT(rect->getWidth() == m_width && rect->getHeight() == m_height);
+
+  m_output.clear();
+
+  if (m_async && m_inputRequests == 0) {
+    if (!processEvents(false, INPUT_TIMEOUT)) {
+      throw Exception(_T("H.264 encoder does not accept input"));
+    }
+  }
+
+  if (m_newQuality != m_quality) {
+    setCodecValue(&CODECAPI_AVEncCommonQuality, m_newQuality);
+    m_quality = m_newQuality;
+  }
+  if (m_keyFrameRequested) {
+    setCodecValue(&CODECAPI_AVEncVideoForceKeyFrame, 1);
+    m_keyFrameRequested = false;
+  }
+
+  // Sample times are in 100-nanosecond units and must grow.
+  LONGLONG sampleTime =
+    (LONGLONG)(DateTime::now() - m_startTime).getTime() * 10000;
+  if (sampleTime <= m_lastSampleTime) {
+    sampleTime = m_lastSampleTime + 1;
+  }
+  m_lastSampleTime = sampleTime;
+
+  DWORD frameLength = (DWORD)(m_width * m_height * 3 / 2);
+  IMFMediaBuffer *buffer = m_mf->createMemoryBuffer(frameLength);
+  IMFSample *sample = 0;
+  try {
+    BYTE *data;
+    HRESULT hr = buffer->Lock(&data, 0, 0);
+    if (FAILED(hr)) {
+      throw Exception(_T("Cannot lock H.264 input buffer, error code = %x"),
+                      (unsigned)hr);
+    }
+    convertToNv12(data, fb, rect);
+    buffer->Unlock();
+    buffer->SetCurrentLength(frameLength);
+
+    sample = m_mf->createSample();
+    sample->AddBuffer(buffer);
+    sample->SetSampleTime(sampleTime);
+    sample->SetSampleDuration(10000000 / FRAME_RATE);
+
+    hr = m_transform->ProcessInput(m_inputStreamId, sample, 0);
+    if (FAILED(hr)) {
+      throw Exception(_T("H.264 encoder rejected the frame, error code = %x"),
+                      (unsigned)hr);
+    }
+  } catch (...) {
+    if (sample != 0) {
+      sample->Release();
+    }
+    buffer->Release();
+    throw;
+  }
+  sample->Release();
+  buffer->Release();
+
+  if (m_async) {
+    m_inputRequests--;
+    processEvents(true, OUTPUT_TIMEOUT);
+  } else {
+    drainOutput();
+  }
+}
+
+size_t H264Compressor::getOutputLength() const
+{
+  return m_output.size();
+}
+
+const char *H264Compressor::getOutputData() const
+{
+  return m_output.empty() ? 0 : &m_output.front();
+}
+
+void H264Compressor::setOutputType()
+{
+  IMFMediaType *type = m_mf->createMediaType();
+  type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+  type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264);
+  // Encoders require the bit rate even in the quality-based rate control
+  // mode. Two bits per pixel per second is a fair rate for desktop video.
+  type->SetUINT32(MF_MT_AVG_BITRATE, (UINT32)(m_width * m_height * 2));
+  type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+  type->SetUINT32(MF_MT_MPEG2_PROFILE, eAVEncH264VProfile_Base);
+  MFSetAttributeSize(type, MF_MT_FRAME_SIZE, m_width, m_height);
+  MFSetAttributeRatio(type, MF_MT_FRAME_RATE, FRAME_RATE, 1);
+  MFSetAttributeRatio(type, MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+
+  HRESULT hr = m_transform->SetOutputType(m_outputStreamId, type, 0);
+  type->Release();
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot set H.264 encoder output type, error code = %x"),
+                    (unsigned)hr);
+  }
+}
+
+void H264Compressor::setInputType()
+{
+  IMFMediaType *type = m_mf->createMediaType();
+  type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+  type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
+  type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+  MFSetAttributeSize(type, MF_MT_FRAME_SIZE, m_width, m_height);
+  MFSetAttributeRatio(type, MF_MT_FRAME_RATE, FRAME_RATE, 1);
+  MFSetAttributeRatio(type, MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+
+  HRESULT hr = m_transform->SetInputType(m_inputStreamId, type, 0);
+  type->Release();
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot set H.264 encoder input type, error code = %x"),
+                    (unsigned)hr);
+  }
+}
+
+void H264Compressor::setCodecValue(const GUID *api, UINT32 value)
+{
+  // Not all encoders support all of the properties, that is not an error.
+  if (m_codecApi != 0) {
+    VARIANT var;
+    VariantInit(&var);
+    var.vt = VT_UI4;
+    var.ulVal = value;
+    m_codecApi->SetValue(api, &var);
+  }
+}
+
+void H264Compressor::setCodecBoolValue(const GUID *api, bool value)
+{
+  if (m_codecApi != 0) {
+    VARIANT var;
+    VariantInit(&var);
+    var.vt = VT_BOOL;
+    var.boolVal = value ? VARIANT_TRUE : VARIANT_FALSE;
+    m_codecApi->SetValue(api, &var);
+  }
+}
+
+void H264Compressor::convertToNv12(UINT8 *dst, const FrameBuffer *fb,
+                                   const Rect *rect)
+{
+  PixelFormat pf = fb->getPixelFormat();
+  _ASSERT(pf.bitsPerPixel == 32);
+  int srcStride = fb->getBytesPerRow() / 4;
+  const UINT32 *src = (const UINT32 *)fb->getBufferPtr(rect->left, rect->top);
+
+  UINT8 *dstY = dst;
+  UINT8 *dstUV = dst + m_width * m_height;
+
+  for (int y = 0; y < m_height; y += 2) {
+    const UINT32 *row0 = src + y * srcStride;
+    const UINT32 *row1 = row0 + srcStride;
+    UINT8 *y0 = dstY + y * m_width;
+    UINT8 *y1 = y0 + m_width;
+    UINT8 *uv = dstUV + (y / 2) * m_width;
+    for (int x = 0; x < m_width; x += 2) {
+      int sumR = 0, sumG = 0, sumB = 0;
+      for (int i = 0; i < 4; i++) {
+        UINT32 pixel = (i < 2 ? row0 : row1)[x + (i & 1)];
+        int r = pixel >> pf.redShift & 0xFF;
+        int g = pixel >> pf.greenShift & 0xFF;
+        int b = pixel >> pf.blueShift & 0xFF;
+        UINT8 luma = (UINT8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        (i < 2 ? y0 : y1)[x + (i & 1)] = luma;
+        sumR += r;
+        sumG += g;
+        sumB += b;
+      }
+      // Chroma is taken from the average of the 2x2 block.
+      int r = sumR / 4, g = sumG / 4, b = sumB / 4;
+      uv[x] = (UINT8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+      uv[x + 1] = (UINT8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+  }
+}
+
+void H264Compressor::drainOutput()
+{
+  MFT_OUTPUT_STREAM_INFO info;
+  HRESULT hr = m_transform->GetOutputStreamInfo(m_outputStreamId, &info);
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot get H.264 encoder output info, error code = %x"),
+                    (unsigned)hr);
+  }
+  bool providesSamples = (info.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES |
+                                          MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES)) != 0;
+  DWORD bufferSize = info.cbSize;
+  if (bufferSize < (DWORD)(m_width * m_height * 3 / 2)) {
+    bufferSize = (DWORD)(m_width * m_height * 3 / 2);
+  }
+
+  while (true) {
+    MFT_OUTPUT_DATA_BUFFER output;
+    memset(&output, 0, sizeof(output));
+    output.dwStreamID = m_outputStreamId;
+    if (!providesSamples) {
+      IMFMediaBuffer *buffer = m_mf->createMemoryBuffer(bufferSize);
+      try {
+        output.pSample = m_mf->createSample();
+      } catch (...) {
+        buffer->Release();
+        throw;
+      }
+      output.pSample->AddBuffer(buffer);
+      buffer->Release();
+    }
+
+    DWORD status = 0;
+    hr = m_transform->ProcessOutput(0, 1, &output, &status);
+    if (output.pEvents != 0) {
+      output.pEvents->Release();
+    }
+    if (SUCCEEDED(hr) && output.pSample != 0) {
+      try {
+        appendOutput(output.pSample);
+      } catch (...) {
+        output.pSample->Release();
+        throw;
+      }
+    }
+    if (output.pSample != 0) {
+      output.pSample->Release();
+    }
+
+    if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT) {
+      return;
+    } else if (hr == MF_E_TRANSFORM_STREAM_CHANGE) {
+      setOutputType();
+    } else if (FAILED(hr)) {
+      throw Exception(_T("H.264 encoding failed, error code = %x"),
+                      (unsigned)hr);
+    } else if (m_async) {
+      // Each METransformHaveOutput event stands for one output sample.
+      return;
+    }
+  }
+}
+
+void H264Compressor::appendOutput(IMFSample *sample)
+{
+  IMFMediaBuffer *buffer;
+  HRESULT hr = sample->ConvertToContiguousBuffer(&buffer);
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot get H.264 output buffer, error code = %x"),
+                    (unsigned)hr);
+  }
+  BYTE *data;
+  DWORD length;
+  hr = buffer->Lock(&data, 0, &length);
+  if (SUCCEEDED(hr)) {
+    m_output.insert(m_output.end(), (const char *)data,
+                    (const char *)data + length);
+    buffer->Unlock();
+  }
+  buffer->Release();
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot lock H.264 output buffer, error code = %x"),
+                    (unsigned)hr);
+  }
+}
+
+bool H264Compressor::processEvents(bool waitForOutput, unsigned int timeout)
+{
+  DateTime startTime = DateTime::now();
+  bool gotOutput = false;
+  while (true) {
+    IMFMediaEvent *event;
+    HRESULT hr = m_eventGenerator->GetEvent(MF_EVENT_FLAG_NO_WAIT, &event);
+    if (hr == MF_E_NO_EVENTS_AVAILABLE) {
+      if (waitForOutput ? gotOutput : m_inputRequests > 0) {
+        return true;
+      }
+      if ((unsigned int)(DateTime::now() - startTime).getTime() >= timeout) {
+        return false;
+      }
+      Thread::sleep(1);
+      continue;
+    }
+    if (FAILED(hr)) {
+      throw Exception(_T("Cannot get H.264 encoder event, error code = %x"),
+                      (unsigned)hr);
+    }
+    MediaEventType type = MEUnknown;
+    event->GetType(&type);
+    event->Release();
+
+    if (type == METransformNeedInput) {
+      m_inputRequests++;
+    } else if (type == METransformHaveOutput) {
+      drainOutput();
+      gotOutput = true;
+    }
+  }
+}
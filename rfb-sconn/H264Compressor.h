@@ -0,0 +1,126 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_H264_COMPRESSOR_H_INCLUDED__
+#define __RFB_H264_COMPRESSOR_H_INCLUDED__
+
+#include <vector>
+
+#include "util/CommonHeader.h"
+#include "util/DateTime.h"
+#include "win-system/MediaFoundation.h"
+#include "rfb/FrameBuffer.h"
+
+//
+// H264Compressor encodes a sequence of same-sized frames into an H.264
+// elementary stream (Annex B byte stream, baseline profile, no B-frames)
+// with a Media Foundation encoder transform. Hardware encoders (NVENC, QSV,
+// AMF), which are exposed as asynchronous transforms, are preferred over
+// the software encoder.
+//
+// Every frame passed to compress() produces the NAL units of that frame
+// (the encoder is switched to the low latency mode), with the exception of
+// hardware encoders that are late with output. Output that appears late is
+// returned together with the output of the next frame.
+//
+
+class H264Compressor
+{
+public:
+  // Creates an encoder for frames of width x height pixels. Both values
+  // must be even. Throws Exception if no usable encoder is available.
+  H264Compressor(MediaFoundation *mf, int width, int height);
+  virtual ~H264Compressor();
+
+  int getWidth() const;
+  int getHeight() const;
+
+  // Set quality level (0..100) of the following frames.
+  void setQuality(int quality);
+
+  // Make the next frame an IDR frame.
+  void requestKeyFrame();
+
+  // Encode the rect area of the frame buffer, its size must be equal to the
+  // compressor frame size. The frame buffer must contain 32-bit pixels with
+  // 8 bits per color component. Throws Exception on errors.
+  void compress(const FrameBuffer *fb, const Rect *rect);
+
+  // Access the output of the last compress() call.
+  size_t getOutputLength() const;
+  const char *getOutputData() const;
+
+protected:
+  static const int FRAME_RATE = 30;
+  static const int GOP_SIZE = 300;
+  static const int DEFAULT_QUALITY = 70;
+  // Time limits of waiting for asynchronous encoder events, in milliseconds.
+  static const unsigned int INPUT_TIMEOUT = 1000;
+  static const unsigned int OUTPUT_TIMEOUT = 100;
+
+  void setOutputType();
+  void setInputType();
+  void setCodecValue(const GUID *api, UINT32 value);
+  void setCodecBoolValue(const GUID *api, bool value);
+
+  // Convert the pixels to the NV12 format (BT.601, limited range).
+  void convertToNv12(UINT8 *dst, const FrameBuffer *fb, const Rect *rect);
+
+  // Retrieve all output pending in a synchronous transform, or one output
+  // sample of an asynchronous one.
+  void drainOutput();
+  void appendOutput(IMFSample *sample);
+
+  // Process events of an asynchronous transform until it accepts input
+  // (waitForOutput is false) or produces output (waitForOutput is true),
+  // or until the timeout expires. Returns true on success.
+  bool processEvents(bool waitForOutput, unsigned int timeout);
+
+  MediaFoundation *m_mf;
+  IMFTransform *m_transform;
+  ICodecAPI *m_codecApi;
+  IMFMediaEventGenerator *m_eventGenerator;
+  bool m_async;
+  DWORD m_inputStreamId;
+  DWORD m_outputStreamId;
+  int m_inputRequests;
+
+  int m_width;
+  int m_height;
+  int m_quality;
+  int m_newQuality;
+  bool m_keyFrameRequested;
+
+  DateTime m_startTime;
+  LONGLONG m_lastSampleTime;
+
+  std::vector<char> m_output;
+
+private:
+  // Do not allow copying objects.
+  H264Compressor(const H264Compressor &other);
+  H264Compressor &operator=(const H264Compressor &other);
+};
+
+#endif // __RFB_H264_COMPRESSOR_H_INCLUDED__
@@ -0,0 +1,148 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "H264Encoder.h"
+
+H264Encoder::H264Encoder(PixelConverter *conv, DataOutputStream *output)
+: Encoder(conv, output),
+  m_compressor(0),
+  m_resetContext(true)
+{
+}
+
+H264Encoder::~H264Encoder()
+{
+  if (m_compressor != 0) {
+    delete m_compressor;
+  }
+}
+
+int H264Encoder::getCode() const
+{
+  return EncodingDefs::H264;
+}
+
+bool H264Encoder::isStateless() const
+{
+  return false;
+}
+
+bool H264Encoder::restartStream()
+{
+  if (m_compressor != 0) {
+    delete m_compressor;
+    m_compressor = 0;
+  }
+  m_frameRect.setRect(0, 0, 0, 0);
+  return true;
+}
+
+bool H264Encoder::prepare(const Rect *rect, const FrameBuffer *serverFb)
+{
+  // 4:2:0 chroma subsampling needs even frame dimensions.
+  Rect frameRect(rect->left, rect->top,
+                 rect->left + (rect->getWidth() & ~1),
+                 rect->top + (rect->getHeight() & ~1));
+  if (frameRect.getWidth() < MIN_FRAME_SIZE ||
+      frameRect.getHeight() < MIN_FRAME_SIZE ||
+      frameRect.getWidth() > MAX_FRAME_SIZE ||
+      frameRect.getHeight() > MAX_FRAME_SIZE) {
+    return false;
+  }
+
+  PixelFormat pf = serverFb->getPixelFormat();
+  if (pf.bitsPerPixel != 32 ||
+      pf.redMax != 255 || pf.greenMax != 255 || pf.blueMax != 255) {
+    return false;
+  }
+
+  if (m_compressor != 0 && frameRect.isEqualTo(&m_frameRect)) {
+    return true;
+  }
+  if (frameRect.isEqualTo(&m_failedRect)) {
+    return false;
+  }
+
+  if (m_compressor != 0) {
+    delete m_compressor;
+    m_compressor = 0;
+  }
+  try {
+    m_compressor = new H264Compressor(&m_mf, frameRect.getWidth(),
+                                      frameRect.getHeight());
+  } catch (Exception &) {
+    m_failedRect = frameRect;
+    return false;
+  }
+  m_frameRect = frameRect;
+  m_resetContext = true;
+  return true;
+}
+
+Rect H264Encoder::getFrameRect() const
+{
+  return m_frameRect;
+}
+
+void H264Encoder::splitRectangle(const Rect *rect,
+                                 std::vector<Rect> *rectList,
+                                 const FrameBuffer *serverFb,
+                                 const EncodeOptions *options)
+{
+  rectList->push_back(*rect);
+}
+
+void H264Encoder::sendRectangle(const Rect *rect,
+                                const FrameBuffer *serverFb,
+                                const EncodeOptions *options)
+{
+  _ASSERT(m_compressor != 0 && rect->isEqualTo(&m_frameRect));
+
+  // Map JPEG quality levels 0..9 to the encoder quality 10..100.
+  int quality = DEFAULT_QUALITY;
+  if (options->jpegEnabled()) {
+    quality = (options->getJpegQualityLevel() + 1) * 10;
+  }
+  m_compressor->setQuality(quality);
+
+  UINT32 flags = m_resetContext ? RESET_CONTEXT : 0;
+  size_t length = 0;
+  try {
+    m_compressor->compress(serverFb, rect);
+    length = m_compressor->getOutputLength();
+  } catch (Exception &) {
+    // The rectangle header has been sent already, so send no data for this
+    // frame and start a new stream next time.
+    delete m_compressor;
+    m_compressor = 0;
+    m_frameRect.setRect(0, 0, 0, 0);
+  }
+
+  m_output->writeUInt32((UINT32)length);
+  m_output->writeUInt32(flags);
+  if (length != 0) {
+    m_output->writeFully(m_compressor->getOutputData(), length);
+    m_resetContext = false;
+  }
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_H264_ENCODER_H_INCLUDED__
+#define __RFB_H264_ENCODER_H_INCLUDED__
+
+#include "Encoder.h"
+#include "H264Compressor.h"
+
+//
+// H264Encoder implements the Open H.264 encoding. It is used for video
+// regions only: the whole video area is sent as one rectangle, which is
+// encoded as the next frame of one H.264 stream, so that each frame is
+// predicted from the previous ones.
+//
+// Each rectangle is sent as a 32-bit length of the data, 32-bit flags and
+// the H.264 data itself (Annex B byte stream). The RESET_CONTEXT flag tells
+// the client to discard its decoder state before decoding the data, that is
+// the case for the first frame of a new stream.
+//
+
+class H264Encoder : public Encoder
+{
+public:
+  // Throws Exception if Media Foundation is not available.
+  H264Encoder(PixelConverter *conv, DataOutputStream *output);
+  virtual ~H264Encoder();
+
+  virtual int getCode() const;
+
+  // Get ready to send the rect area of serverFb as the next video frame.
+  // The frame rectangle is rect shrunk to even width and height, see
+  // getFrameRect(). A new H.264 stream is started when the frame rectangle
+  // changes. Returns false if H.264 cannot be used for this rectangle, the
+  // caller should use another encoding in that case.
+  bool prepare(const Rect *rect, const FrameBuffer *serverFb);
+
+  // Return the frame rectangle set by the last successful prepare() call.
+  Rect getFrameRect() const;
+
+  // H264Encoder sends rectangles prepared by prepare() as is.
+  virtual void splitRectangle(const Rect *rect,
+                              std::vector<Rect> *rectList,
+                              const FrameBuffer *serverFb,
+                              const EncodeOptions *options);
+
+  // Encode the frame rectangle as the next frame of the stream. The quality
+  // follows the JPEG quality level requested by the client.
+  virtual void sendRectangle(const Rect *rect,
+                             const FrameBuffer *serverFb,
+                             const EncodeOptions *options) throw(IOException);
+
+  // Every frame depends on the previous ones.
+  virtual bool isStateless() const;
+
+  // Starts a new H.264 stream with the next frame.
+  virtual bool restartStream();
+
+protected:
+  static const UINT32 RESET_CONTEXT = 1;
+  static const UINT32 RESET_ALL_CONTEXTS = 2;
+
+  static const int MIN_FRAME_SIZE = 16;
+  static const int MAX_FRAME_SIZE = 4096;
+  static const int DEFAULT_QUALITY = 70;
+
+  MediaFoundation m_mf;
+  H264Compressor *m_compressor;
+  Rect m_frameRect;
+  // The frame rectangle compressor creation failed for, not to retry it on
+  // every update.
+  Rect m_failedRect;
+  bool m_resetContext;
+};
+
+#endif // __RFB_H264_ENCODER_H_INCLUDED__
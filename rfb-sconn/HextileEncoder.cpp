@@ -49,6 +49,11 @@ int HextileEncoder::getCode() const
   return EncodingDefs::HEXTILE;
 }
 
+size_t HextileEncoder::getRectOverhead(const EncodeOptions *options) const
+{
+  return MERGE_OVERHEAD;
+}
+
 void HextileEncoder::sendRectangle(const Rect *rect,
                                    const FrameBuffer *serverFb,
                                    const EncodeOptions *options)
@@ -72,8 +77,8 @@ void HextileEncoder::hextileFunction(const Rect &r,
                                      const FrameBuffer *frameBuffer)
 {
   Rect t;
-  PIXEL_T *buf;
-  FrameBuffer fb;
+  // Pixels of the current tile, copied row by row from the frame buffer.
+  PIXEL_T buf[16 * 16];
   PIXEL_T oldBg = 0, oldFg = 0;
   bool oldBgValid = false;
   bool oldFgValid = false;
@@ -89,9 +94,11 @@ void HextileEncoder::hextileFunction(const Rect &r,
 
       t.right = min(r.right, t.left + 16);
 
-      fb.setProperties(&t, &frameBuffer->getPixelFormat());
-      fb.copyFrom(frameBuffer, t.left, t.top);
-      buf = (PIXEL_T *)fb.getBuffer();
+      const size_t tileRowSize = t.getWidth() * sizeof(PIXEL_T);
+      for (int y = 0; y < t.getHeight(); y++) {
+        memcpy(&buf[y * t.getWidth()],
+               frameBuffer->getBufferPtr(t.left, t.top + y), tileRowSize);
+      }
 
       tile.newTile(buf, t.getWidth(), t.getHeight());
       int tileType = tile.getFlags();
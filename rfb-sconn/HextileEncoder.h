@@ -39,10 +39,16 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options) throw(IOException);
 
+  // Each rectangle starts a new grid of tiles with their own backgrounds.
+  virtual size_t getRectOverhead(const EncodeOptions *options) const;
+
 private:
   template <class PIXEL_T>
     void hextileFunction(const Rect &r,
                          const FrameBuffer *frameBuffer) throw(IOException);
+
+  // Unchanged pixels worth saving a rectangle, see getRectOverhead().
+  static const size_t MERGE_OVERHEAD = 32;
 };
 
 #endif // __RFB_HEXTILE_ENCODER_H_INCLUDED__
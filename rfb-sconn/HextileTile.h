@@ -26,6 +26,7 @@
 #define __RFB_HEXTILE_TILE_H_INCLUDED__
 
 #include "TightPalette.h"
+#include "PixelRunScanner.h"
 #include "util/inttypes.h"
 #include <crtdbg.h>
 
@@ -123,14 +124,13 @@ template<class PIXEL_T> void HextileTile<PIXEL_T>::analyze()
 {
   _ASSERT(m_tile && m_width && m_height);
 
-  const PIXEL_T *ptr = m_tile;
-  const PIXEL_T *end = &m_tile[m_width * m_height];
-  PIXEL_T color = *ptr++;
-  while (ptr != end && *ptr == color)
-    ptr++;
+  const int numPixels = m_width * m_height;
+  PIXEL_T color = m_tile[0];
+  int run = (int)PixelRunScanner::getRunLength(m_tile, numPixels,
+                                               sizeof(PIXEL_T));
 
   // Handle solid tile
-  if (ptr == end) {
+  if (run == numPixels) {
     m_background = m_tile[0];
     m_flags = 0;
     m_size = 0;
@@ -138,7 +138,7 @@ template<class PIXEL_T> void HextileTile<PIXEL_T>::analyze()
   }
 
   // Compute number of complete rows of the same color, at the top
-  int y = (int)(ptr - m_tile) / m_width;
+  int y = run / m_width;
 
   PIXEL_T *colorsPtr = m_colors;
   UINT8 *coordsPtr = m_coords;
@@ -156,7 +156,7 @@ template<class PIXEL_T> void HextileTile<PIXEL_T>::analyze()
 
   memset(m_processed, 0, 16 * 16 * sizeof(bool));
 
-  int x, sx, sy, sw, sh, max_x;
+  int x, sx, sy, sw, sh;
 
   for (; y < m_height; y++) {
     for (x = 0; x < m_width; x++) {
@@ -165,20 +165,17 @@ template<class PIXEL_T> void HextileTile<PIXEL_T>::analyze()
         continue;
       }
       // Determine dimensions of the horizontal subrect
-      color = m_tile[y * m_width + x];
-      for (sx = x + 1; sx < m_width; sx++) {
-        if (m_tile[y * m_width + sx] != color)
-          break;
-      }
-      sw = sx - x;
-      max_x = sx;
+      const PIXEL_T *row = &m_tile[y * m_width + x];
+      color = *row;
+      sw = (int)PixelRunScanner::getRunLength(row, m_width - x,
+                                              sizeof(PIXEL_T));
       for (sy = y + 1; sy < m_height; sy++) {
-        for (sx = x; sx < max_x; sx++) {
-          if (m_tile[sy * m_width + sx] != color)
-            goto done;
+        row += m_width;
+        if (*row != color ||
+            (int)PixelRunScanner::getRunLength(row, sw, sizeof(PIXEL_T)) < sw) {
+          break;
         }
       }
-    done:
       sh = sy - y;
 
       // Save properties of this subrect
@@ -73,6 +73,8 @@ term_destination (j_compress_ptr cinfo)
 StandardJpegCompressor::StandardJpegCompressor()
   : m_quality(-1), // make sure (m_quality != n_newQuality)
     m_newQuality(DEFAULT_JPEG_QUALITY),
+    m_subsampling(SUBSAMPLING_420), // as set by jpeg_set_defaults()
+    m_newSubsampling(SUBSAMPLING_420),
     m_outputBuffer(0),
     m_numBytesAllocated(0),
     m_numBytesReady(0)
@@ -205,6 +207,16 @@ StandardJpegCompressor::resetQuality()
   m_newQuality = DEFAULT_JPEG_QUALITY;
 }
 
+void
+StandardJpegCompressor::setSubsampling(int subsampling)
+{
+  if (subsampling == SUBSAMPLING_444 || subsampling == SUBSAMPLING_422) {
+    m_newSubsampling = subsampling;
+  } else {
+    m_newSubsampling = SUBSAMPLING_420;
+  }
+}
+
 void
 StandardJpegCompressor::compress(const void *buf,
                                  const PixelFormat *fmt,
@@ -214,18 +226,53 @@ StandardJpegCompressor::compress(const void *buf,
     (fmt->bitsPerPixel == 32 && fmt->colorDepth == 24 &&
      fmt->redMax == 255 && fmt->greenMax == 255 && fmt->blueMax == 255);
 
+  J_COLOR_SPACE directColorSpace = JCS_RGB;
+  bool useDirectInput = getDirectColorSpace(fmt, &directColorSpace);
+
   m_jpeg.cinfo.image_width = w;
   m_jpeg.cinfo.image_height = h;
 
+  // The JPEG color space (YCbCr) stays the same for all of the input color
+  // spaces used here, so switching them does not need jpeg_set_defaults().
+  m_jpeg.cinfo.in_color_space = directColorSpace;
+  m_jpeg.cinfo.input_components = useDirectInput ? 4 : 3;
+
   if (m_newQuality != m_quality) {
     jpeg_set_quality(&m_jpeg.cinfo, m_newQuality, true);
     m_quality = m_newQuality;
   }
 
+  // The chroma components are never scaled, subsampling is set by the
+  // sampling factors of the luminance.
+  if (m_newSubsampling != m_subsampling) {
+    jpeg_component_info *luminance = &m_jpeg.cinfo.comp_info[0];
+    luminance->h_samp_factor = m_newSubsampling == SUBSAMPLING_444 ? 1 : 2;
+    luminance->v_samp_factor = m_newSubsampling == SUBSAMPLING_420 ? 2 : 1;
+    m_subsampling = m_newSubsampling;
+  }
+
   jpeg_start_compress(&m_jpeg.cinfo, TRUE);
 
   const char *src = (const char *)buf;
 
+  if (useDirectInput) {
+    // Let the library read the rows right from the source buffer.
+    JSAMPROW rowPointer[8];
+    while (m_jpeg.cinfo.next_scanline < m_jpeg.cinfo.image_height) {
+      int maxRows = m_jpeg.cinfo.image_height - m_jpeg.cinfo.next_scanline;
+      if (maxRows > 8) {
+        maxRows = 8;
+      }
+      for (int dy = 0; dy < maxRows; dy++) {
+        rowPointer[dy] = (JSAMPROW)src;
+        src += stride;
+      }
+      jpeg_write_scanlines(&m_jpeg.cinfo, rowPointer, maxRows);
+    }
+    jpeg_finish_compress(&m_jpeg.cinfo);
+    return;
+  }
+
   // We'll pass up to 8 rows to jpeg_write_scanlines().
   JSAMPLE *rgb = new JSAMPLE[w * 3 * 8];
   JSAMPROW rowPointer[8];
@@ -264,6 +311,36 @@ const char *StandardJpegCompressor::getOutputData()
   return (const char *)m_outputBuffer;
 }
 
+bool
+StandardJpegCompressor::getDirectColorSpace(const PixelFormat *fmt,
+                                            J_COLOR_SPACE *colorSpace)
+{
+#ifdef JCS_EXTENSIONS
+  if (fmt->bitsPerPixel != 32 || fmt->bigEndian ||
+      fmt->redMax != 255 || fmt->greenMax != 255 || fmt->blueMax != 255) {
+    return false;
+  }
+  // Byte order in memory corresponds to little-endian pixel values.
+  if (fmt->redShift == 16 && fmt->greenShift == 8 && fmt->blueShift == 0) {
+    *colorSpace = JCS_EXT_BGRX;
+  } else if (fmt->redShift == 0 && fmt->greenShift == 8 &&
+             fmt->blueShift == 16) {
+    *colorSpace = JCS_EXT_RGBX;
+  } else if (fmt->redShift == 24 && fmt->greenShift == 16 &&
+             fmt->blueShift == 8) {
+    *colorSpace = JCS_EXT_XBGR;
+  } else if (fmt->redShift == 8 && fmt->greenShift == 16 &&
+             fmt->blueShift == 24) {
+    *colorSpace = JCS_EXT_XRGB;
+  } else {
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 void
 StandardJpegCompressor::convertRow24(JSAMPLE *dst, const void *src,
                                      const PixelFormat *fmt, int numPixels)
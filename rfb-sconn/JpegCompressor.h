@@ -56,6 +56,15 @@ public:
   virtual void setQuality(int level) = 0;
   virtual void resetQuality() = 0;
 
+  // Chroma subsampling modes: full chroma resolution, chroma halved
+  // horizontally, and halved both horizontally and vertically.
+  static const int SUBSAMPLING_444 = 0;
+  static const int SUBSAMPLING_422 = 1;
+  static const int SUBSAMPLING_420 = 2;
+
+  // Set chroma subsampling (SUBSAMPLING_420 by default).
+  virtual void setSubsampling(int subsampling) = 0;
+
   // Actually compress a rectangle of a given pixel buffer referenced by buf.
   // The pixel format as specified by fmt must meet the following
   // requirements: bitsPerPixel must be either 32 or 16, and the bigEndian
@@ -88,6 +97,7 @@ public:
 
   virtual void setQuality(int level);
   virtual void resetQuality();
+  virtual void setSubsampling(int subsampling);
 
   virtual void compress(const void *buf, const PixelFormat *fmt,
                         int w, int h, int stride);
@@ -111,10 +121,20 @@ protected:
   int m_quality;
   int m_newQuality;
 
+  int m_subsampling;
+  int m_newSubsampling;
+
   unsigned char *m_outputBuffer;
   size_t m_numBytesAllocated;
   size_t m_numBytesReady;
 
+  // Return true and set *colorSpace if the JPEG library can read pixels of
+  // the specified format directly, with no convertRow() step. That is only
+  // possible with libjpeg-turbo, which accepts 32-bit RGBX/BGRX/XRGB/XBGR
+  // input via its JCS_EXT_* color spaces and converts them with SIMD code.
+  static bool getDirectColorSpace(const PixelFormat *fmt,
+                                  J_COLOR_SPACE *colorSpace);
+
   // Convert one row (scanline) from the specified pixel format to the format
   // supported by the IJG JPEG library (one byte per one color component).
   void convertRow(JSAMPLE *dst, const void *src,
@@ -39,6 +39,26 @@ int JpegEncoder::getCode() const
   return m_tightEncoder->getCode();
 }
 
+bool JpegEncoder::isStateless() const
+{
+  return m_tightEncoder->isStateless();
+}
+
+void JpegEncoder::setStateless(bool stateless)
+{
+  m_tightEncoder->setStateless(stateless);
+}
+
+bool JpegEncoder::restartStream()
+{
+  return m_tightEncoder->restartStream();
+}
+
+size_t JpegEncoder::getRectOverhead(const EncodeOptions *options) const
+{
+  return 0;
+}
+
 void JpegEncoder::splitRectangle(const Rect *rect,
                                  std::vector<Rect> *rectList,
                                  const FrameBuffer *serverFb,
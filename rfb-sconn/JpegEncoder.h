@@ -53,6 +53,15 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options);
 
+  // Overloaded functions call corresponding TightEncoder functions, since
+  // JpegEncoder falls back to TightEncoder when JPEG cannot be used.
+  virtual bool isStateless() const;
+  virtual void setStateless(bool stateless);
+  virtual bool restartStream();
+
+  // The rectangles are never merged, see Encoder::getRectOverhead().
+  virtual size_t getRectOverhead(const EncodeOptions *options) const;
+
 protected:
   TightEncoder *m_tightEncoder;
 };
@@ -0,0 +1,70 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PaletteCache.h"
+
+PaletteCache::PaletteCache()
+: m_keyLength(0),
+  m_hitCount(0),
+  m_missCount(0)
+{
+  memset(m_entries, 0, sizeof(m_entries));
+}
+
+void PaletteCache::store(const TightPalette *pal)
+{
+  int numColors = pal->getNumColors();
+  if (m_keyLength == 0 || numColors == 0 || numColors > MAX_COLORS) {
+    return;
+  }
+
+  Entry *entry = &m_entries[getSlot(m_key, m_keyLength)];
+  entry->keyLength = m_keyLength;
+  memcpy(entry->key, m_key, m_keyLength * sizeof(UINT32));
+  entry->numColors = numColors;
+  for (int i = 0; i < numColors; i++) {
+    entry->colors[i] = pal->getEntry(i);
+  }
+  m_keyLength = 0;
+}
+
+UINT32 PaletteCache::getHitCount() const
+{
+  return m_hitCount;
+}
+
+UINT32 PaletteCache::getMissCount() const
+{
+  return m_missCount;
+}
+
+int PaletteCache::getSlot(const UINT32 *key, int keyLength)
+{
+  UINT32 hash = keyLength;
+  for (int i = 0; i < keyLength; i++) {
+    hash = hash * 31 + key[i];
+  }
+  hash ^= hash >> 13;
+  return hash % NUM_ENTRIES;
+}
@@ -0,0 +1,151 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_PALETTE_CACHE_H_INCLUDED__
+#define __RFB_PALETTE_CACHE_H_INCLUDED__
+
+#include "region/Rect.h"
+#include "TightPalette.h"
+
+//
+// PaletteCache remembers small palettes of recently encoded rectangles, so
+// that a rectangle using one of them can be checked against the known
+// colors instead of building its palette from scratch. The palettes are
+// keyed by the first distinct colors of the first row of a rectangle.
+//
+class PaletteCache
+{
+public:
+  PaletteCache();
+
+  //
+  // Fills pal, which must be empty, if the rectangle of the pixel array
+  // (of the given stride in pixels) is keyed to a cached palette and all of
+  // its pixels are in this palette. In that case pal ends up as if all the
+  // pixels were inserted into it, though colors of the same pixel counts
+  // may be ordered differently, and true is returned. Otherwise pal is not
+  // changed and false is returned.
+  //
+  template <class PIXEL_T>
+    bool fill(TightPalette *pal, const Rect *r,
+              const PIXEL_T *pixels, int stride);
+
+  //
+  // Remembers the palette filled for the rectangle of the last fill() call
+  // that returned false. Full palettes and palettes of more than
+  // MAX_COLORS colors are not remembered.
+  //
+  void store(const TightPalette *pal);
+
+  // Return the number of fill() calls which found and did not find a
+  // palette.
+  UINT32 getHitCount() const;
+  UINT32 getMissCount() const;
+
+  static const int KEY_LENGTH = 4;
+  static const int MAX_COLORS = 32;
+  static const int NUM_ENTRIES = 16;
+
+private:
+  struct Entry {
+    int keyLength;
+    UINT32 key[KEY_LENGTH];
+    int numColors;
+    UINT32 colors[MAX_COLORS];
+  };
+
+  // Return the index of the entry for the key in m_entries.
+  static int getSlot(const UINT32 *key, int keyLength);
+
+  Entry m_entries[NUM_ENTRIES];
+
+  // The key of the last fill() call, zero length if there was a hit.
+  UINT32 m_key[KEY_LENGTH];
+  int m_keyLength;
+
+  UINT32 m_hitCount;
+  UINT32 m_missCount;
+};
+
+template <class PIXEL_T>
+bool PaletteCache::fill(TightPalette *pal, const Rect *r,
+                        const PIXEL_T *pixels, int stride)
+{
+  const int width = r->getWidth();
+  const PIXEL_T *row = pixels + r->top * stride + r->left;
+
+  m_keyLength = 0;
+  for (int x = 0; x < width && m_keyLength < KEY_LENGTH; x++) {
+    UINT32 color = row[x];
+    int i = 0;
+    while (i < m_keyLength && m_key[i] != color) {
+      i++;
+    }
+    if (i == m_keyLength) {
+      m_key[m_keyLength++] = color;
+    }
+  }
+
+  const Entry *entry = &m_entries[getSlot(m_key, m_keyLength)];
+  if (m_keyLength == 0 || entry->keyLength != m_keyLength ||
+      memcmp(entry->key, m_key, m_keyLength * sizeof(UINT32)) != 0) {
+    m_missCount++;
+    return false;
+  }
+
+  // Count the pixels of each color. Runs of the same color are common, so
+  // the color of the previous pixel is checked first.
+  int counts[MAX_COLORS];
+  memset(counts, 0, sizeof(counts));
+  int index = 0;
+  UINT32 indexColor = entry->colors[0];
+  for (int y = r->top; y < r->bottom; y++, row += stride) {
+    for (int x = 0; x < width; x++) {
+      UINT32 color = row[x];
+      if (color != indexColor) {
+        index = 0;
+        while (index < entry->numColors && entry->colors[index] != color) {
+          index++;
+        }
+        if (index == entry->numColors) {
+          m_missCount++;
+          return false;
+        }
+        indexColor = color;
+      }
+      counts[index]++;
+    }
+  }
+
+  for (int i = 0; i < entry->numColors; i++) {
+    if (counts[i] != 0 && pal->insert(entry->colors[i], counts[i]) == 0) {
+      break;
+    }
+  }
+  m_keyLength = 0;
+  m_hitCount++;
+  return true;
+}
+
+#endif // __RFB_PALETTE_CACHE_H_INCLUDED__
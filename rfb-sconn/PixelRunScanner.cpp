@@ -0,0 +1,103 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PixelRunScanner.h"
+#include "util/CpuFeatures.h"
+
+#include <emmintrin.h>
+
+size_t PixelRunScanner::getRunLength(const void *pixels, size_t count,
+                                     size_t bytesPerPixel)
+{
+  if (count * bytesPerPixel >= MIN_SSE2_LENGTH && CpuFeatures::hasSse2()) {
+    return getRunLengthSse2((const UINT8 *)pixels, count, bytesPerPixel);
+  }
+  if (bytesPerPixel == 1) {
+    const UINT8 *p = (const UINT8 *)pixels;
+    return getRunLengthPlain(p, count, p[0]);
+  } else if (bytesPerPixel == 2) {
+    const UINT16 *p = (const UINT16 *)pixels;
+    return getRunLengthPlain(p, count, p[0]);
+  } else {
+    const UINT32 *p = (const UINT32 *)pixels;
+    return getRunLengthPlain(p, count, p[0]);
+  }
+}
+
+template<class PIXEL_T>
+size_t PixelRunScanner::getRunLengthPlain(const PIXEL_T *pixels, size_t count,
+                                          PIXEL_T color)
+{
+  size_t i = 0;
+  while (i < count && pixels[i] == color) {
+    i++;
+  }
+  return i;
+}
+
+size_t PixelRunScanner::getRunLengthSse2(const UINT8 *pixels, size_t count,
+                                         size_t bytesPerPixel)
+{
+  __m128i pattern;
+  if (bytesPerPixel == 1) {
+    pattern = _mm_set1_epi8(*(const char *)pixels);
+  } else if (bytesPerPixel == 2) {
+    pattern = _mm_set1_epi16(*(const short *)pixels);
+  } else {
+    pattern = _mm_set1_epi32(*(const int *)pixels);
+  }
+
+  // 16 bytes hold a whole number of pixels, so the pattern stays aligned
+  // to the pixels from block to block.
+  const size_t length = count * bytesPerPixel;
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(pixels + i));
+    int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+    if (equal != 0xFFFF) {
+      int firstDiffering = 0;
+      while (equal & 1) {
+        equal >>= 1;
+        firstDiffering++;
+      }
+      return (i + firstDiffering) / bytesPerPixel;
+    }
+  }
+
+  size_t run = i / bytesPerPixel;
+  size_t rest = count - run;
+  if (rest == 0) {
+    return run;
+  }
+  if (bytesPerPixel == 1) {
+    const UINT8 *p = (const UINT8 *)pixels;
+    return run + getRunLengthPlain(p + run, rest, p[0]);
+  } else if (bytesPerPixel == 2) {
+    const UINT16 *p = (const UINT16 *)pixels;
+    return run + getRunLengthPlain(p + run, rest, p[0]);
+  } else {
+    const UINT32 *p = (const UINT32 *)pixels;
+    return run + getRunLengthPlain(p + run, rest, p[0]);
+  }
+}
@@ -0,0 +1,57 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_PIXEL_RUN_SCANNER_H_INCLUDED__
+#define __RFB_PIXEL_RUN_SCANNER_H_INCLUDED__
+
+#include <stddef.h>
+
+#include "util/inttypes.h"
+
+//
+// PixelRunScanner finds runs of pixels of the same color, with SSE2 if the
+// processor supports it. It is used to detect solid tiles and subrects.
+//
+class PixelRunScanner
+{
+public:
+  //
+  // Returns the number of the leading pixels equal to the first one. The
+  // pixels are 1, 2 or 4 bytes long, count must be positive.
+  //
+  static size_t getRunLength(const void *pixels, size_t count,
+                             size_t bytesPerPixel);
+
+private:
+  template<class PIXEL_T>
+  static size_t getRunLengthPlain(const PIXEL_T *pixels, size_t count,
+                                  PIXEL_T color);
+  static size_t getRunLengthSse2(const UINT8 *pixels, size_t count,
+                                 size_t bytesPerPixel);
+
+  // Runs shorter than this number of bytes are compared without SSE2.
+  static const size_t MIN_SSE2_LENGTH = 16;
+};
+
+#endif // __RFB_PIXEL_RUN_SCANNER_H_INCLUDED__
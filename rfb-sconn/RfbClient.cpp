@@ -27,26 +27,51 @@
 #include "RfbCodeRegistrator.h"
 #include "ft-server-lib/FileTransferRequestHandler.h"
 #include "EchoExtensionRequestHandler.h"
+#include "BulkChannelRequestHandler.h"
 #include "network/socket/SocketStream.h"
+#include "network/WebSocketStream.h"
+#include "network/TlsStream.h"
 #include "RfbInitializer.h"
 #include "ClientAuthListener.h"
 #include "server-config-lib/Configurator.h"
 #include "io-lib/BufferedInputStream.h"
 #include "util/MemUsage.h"
+#include "log-writer/FrameTrace.h"
+#include "desktop/VisualEffectsUtil.h"
+
+#include <memory>
 
 RfbClient::RfbClient(NewConnectionEvents *newConnectionEvents,
                      SocketIPv4 *socket,
                      ClientTerminationListener *extTermListener,
                      ClientAuthListener *extAuthListener, bool viewOnly,
-                     bool isOutgoing, unsigned int id,
+                     bool isOutgoing, bool isWebSocket,
+                     const char *clientVersion, unsigned int id,
                      const ViewPortState *constViewPort,
                      const ViewPortState *dynViewPort,
                      int idleTimeout,
+                     EncodedRectCache *rectCache,
+                     DirtyTileMap *dirtyTiles,
+                     SharedFrameStore *frameStore,
+                     MulticastSender *multicast,
+                     IocpEngine *iocpEngine,
+                     TaskScheduler *taskScheduler,
+                     TokenBucket *serverBandwidth,
+                     TokenBucket *fileTransferBandwidth,
                      LogWriter *log)
 : m_socket(socket), // now we own the socket
+  m_outputQueue(0),
+  m_tlsStream(0),
+  m_serverBandwidth(serverBandwidth),
+  m_fileTransferBandwidth(fileTransferBandwidth),
+  m_autoTuneSendBuffer(false),
+  m_sendBufferSize(0),
+  m_visualEffectsLevel(VisualEffectsUtil::LEVEL_FULL),
   m_newConnectionEvents(newConnectionEvents),
   m_viewOnly(viewOnly),
   m_isOutgoing(isOutgoing),
+  m_isWebSocket(isWebSocket),
+  m_versionExchanged(clientVersion != 0),
   m_shared(false),
   m_viewOnlyAuth(true),
   m_clientState(IN_NONAUTH),
@@ -54,15 +79,30 @@ RfbClient::RfbClient(NewConnectionEvents *newConnectionEvents,
   m_extTermListener(extTermListener),
   m_extAuthListener(extAuthListener),
   m_updateSender(0),
+  m_rectCache(rectCache),
+  m_dirtyTiles(dirtyTiles),
+  m_frameStore(frameStore),
+  m_multicast(multicast),
+  m_iocpEngine(iocpEngine),
+  m_taskScheduler(taskScheduler),
   m_clipboardExchange(0),
   m_clientInputHandler(0),
   m_id(id),
   m_desktop(0),
+  m_isInputBatch(false),
   m_constViewPort(constViewPort, log),
   m_dynamicViewPort(dynViewPort, log),
   m_idleTimer(idleTimeout), m_idleTimeout(idleTimeout),
+  m_bulkClient(0),
+  m_hasBulkToken(false),
+  m_isBulkClosing(false),
+  m_bulkPrimary(0),
   m_log(log)
 {
+  memset(m_clientVersion, 0, sizeof(m_clientVersion));
+  if (clientVersion != 0) {
+    memcpy(m_clientVersion, clientVersion, RfbInitializer::VERSION_MSG_LENGTH);
+  }
   resume();
 }
 
@@ -80,6 +120,11 @@ void RfbClient::disconnect()
   // Shutdown and close socket.
   try { m_socket->shutdown(SD_BOTH); } catch (...) { }
   try { m_socket->close(); } catch (...) { }
+  // A send blocked by a stuck viewer would otherwise hold the teardown of
+  // the client until the send timeout.
+  if (!m_socket->cancelIo()) {
+    m_log->debug(_T("Cannot cancel the blocked I/O of client #%d"), m_id);
+  }
   m_log->message(_T("Connection from %s has been closed for client #%d"), peerStr.getString(), m_id);
 }
 
@@ -93,6 +138,13 @@ bool RfbClient::isOutgoing() const
   return m_isOutgoing;
 }
 
+void RfbClient::getStatistics(UpdateStatistics *stats)
+{
+  if (m_updateSender != 0) {
+    m_updateSender->getStatistics(stats);
+  }
+}
+
 void RfbClient::getPeerHost(StringStorage *host)
 {
   SocketAddressIPv4 addr;
@@ -177,18 +229,43 @@ void RfbClient::execute()
                        peerStr.getString());
 
   ServerConfig *config = Configurator::getInstance()->getServerConfig();
+  SocketProfile socketProfile;
+  config->getSocketProfile(&socketProfile);
+  m_autoTuneSendBuffer = socketProfile.autoTune;
+  bool frameTrace = config->isFrameTraceEnabled();
+  FrameTrace::getInstance()->setEnabled(frameTrace);
 
   SocketStream sockStream(m_socket);
-
-  RfbOutputGate output(&sockStream);
-  BufferedInputStream bufInput(&sockStream);
+  Channel *stream = &sockStream;
+  std::auto_ptr<WebSocketStream> webSocketStream;
+  if (m_isWebSocket) {
+    webSocketStream.reset(new WebSocketStream(&sockStream));
+    stream = webSocketStream.get();
+  }
+  // Stays in pass-through mode unless the client chooses the TLS tunnel.
+  TlsStream tlsStream(stream, stream);
+  stream = &tlsStream;
+  m_tlsStream = &tlsStream;
+
+  // The socket writes are done by a thread of their own, the update
+  // sender goes on encoding while the previous update is being sent. The
+  // same thread paces the data to the bandwidth limits.
+  m_bandwidth.setRate(config->getMaxClientBandwidth() * 1024);
+  WriteBehindOutputStream outputQueue(stream,
+                                      WriteBehindOutputStream::DEFAULT_MAX_QUEUED,
+                                      &m_bandwidth, m_serverBandwidth);
+  m_outputQueue = &outputQueue;
+  RfbOutputGate output(&outputQueue);
+  BufferedInputStream bufInput(stream);
   RfbInputGate input(&bufInput);
 
   FileTransferRequestHandler *fileTransfer = 0;
   EchoExtensionRequestHandler *echoExtension = 0;
+  BulkChannelRequestHandler *bulkChannel = 0;
 
-  RfbInitializer rfbInitializer(&sockStream, m_extAuthListener, this,
-                                !m_isOutgoing);
+  RfbInitializer rfbInitializer(stream, &tlsStream, m_extAuthListener, this,
+                                !m_isOutgoing,
+                                m_versionExchanged ? m_clientVersion : 0);
 
   try {
     // First initialization phase
@@ -197,82 +274,130 @@ void RfbClient::execute()
       rfbInitializer.authPhase();
       setClientState(IN_AUTH);
       m_log->debug(_T("RFB initialization phase 1 completed"));
-
-      m_shared = rfbInitializer.getSharedFlag();
-      m_log->debug(_T("Shared flag = %d"), (int)m_shared);
-      m_viewOnlyAuth = rfbInitializer.getViewOnlyAuth();
-      m_log->debug(_T("Initial view-only state = %d"), (int)m_viewOnly);
-      m_log->debug(_T("Authenticated with view-only password = %d"), (int)m_viewOnlyAuth);
-      m_viewOnly = m_viewOnly || m_viewOnlyAuth;
-
-      // Let RfbClientManager handle new authenticated connection.
-      m_desktop = m_extAuthListener->onClientAuth(this);
-
-      m_log->info(_T("View only = %d"), (int)m_viewOnly);
+      if (tlsStream.isStarted()) {
+        StringStorage tlsInfo;
+        tlsStream.getDescription(&tlsInfo);
+        m_log->info(_T("TLS tunnel: %s"), tlsInfo.getString());
+      }
+
+      if (!rfbInitializer.isBulkChannel()) {
+        m_shared = rfbInitializer.getSharedFlag();
+        m_log->debug(_T("Shared flag = %d"), (int)m_shared);
+        m_viewOnlyAuth = rfbInitializer.getViewOnlyAuth();
+        m_log->debug(_T("Initial view-only state = %d"), (int)m_viewOnly);
+        m_log->debug(_T("Authenticated with view-only password = %d"), (int)m_viewOnlyAuth);
+        m_viewOnly = m_viewOnly || m_viewOnlyAuth;
+
+        // Let RfbClientManager handle new authenticated connection.
+        m_desktop = m_extAuthListener->onClientAuth(this);
+
+        m_log->info(_T("View only = %d"), (int)m_viewOnly);
+      }
     } catch (Exception &e) {
       m_log->error(_T("Error during RFB initialization: %s"), e.getMessage());
       throw;
     }
-    _ASSERT(m_desktop != 0);
-
-    m_constViewPort.initDesktopInterface(m_desktop);
-    m_dynamicViewPort.initDesktopInterface(m_desktop);
-
-    RfbDispatcher dispatcher(&input, &m_connClosingEvent);
-    m_log->debug(_T("Dispatcher has been created"));
-    CapContainer srvToClCaps, clToSrvCaps, encCaps;
-    RfbCodeRegistrator codeRegtor(&dispatcher, &srvToClCaps, &clToSrvCaps,
-                                  &encCaps);
-    // Init modules
-    // UpdateSender initialization
-    m_updateSender = new UpdateSender(&codeRegtor, m_desktop, this,
-                                      &output, m_id, m_desktop, m_log);
-    m_log->debug(_T("UpdateSender has been created for client #%d"), m_id);
-    PixelFormat pf;
-    Dimension fbDim;
-    m_desktop->getFrameBufferProperties(&fbDim, &pf);
-    Rect viewPort = getViewPortRect(&fbDim);
-    m_updateSender->init(&Dimension(&viewPort), &pf);
-    m_log->debug(_T("UpdateSender has been initialized"));
-    // ClientInputHandler initialization
-    m_clientInputHandler = new ClientInputHandler(&codeRegtor, this,
-                                                  m_viewOnly);
-    m_log->debug(_T("ClientInputHandler has been created"));
-    // ClipboardExchange initialization
-    m_clipboardExchange = new ClipboardExchange(&codeRegtor, m_desktop, &output,
-                                                m_viewOnly, m_log);
-    m_log->debug(_T("ClipboardExchange has been created"));
-
-    // FileTransfers initialization
-    if (config->isFileTransfersEnabled() &&
-        rfbInitializer.getTightEnabledFlag()) {
-      fileTransfer = new FileTransferRequestHandler(&codeRegtor, &output, m_desktop, m_log, !m_viewOnly);
-      m_log->debug(_T("File transfer has been created"));
+    if (rfbInitializer.isBulkChannel()) {
+      serveBulkChannel(&input, &output);
     } else {
-      m_log->info(_T("File transfer is not allowed"));
+      _ASSERT(m_desktop != 0);
+
+      m_constViewPort.initDesktopInterface(m_desktop);
+      m_dynamicViewPort.initDesktopInterface(m_desktop);
+
+      RfbDispatcher dispatcher(&input, &m_connClosingEvent);
+      m_log->debug(_T("Dispatcher has been created"));
+      CapContainer srvToClCaps, clToSrvCaps, encCaps;
+      RfbCodeRegistrator codeRegtor(&dispatcher, &srvToClCaps, &clToSrvCaps,
+                                    &encCaps);
+      // Init modules
+      // UpdateSender initialization
+      StringStorage logDir;
+      config->getLogFileDir(&logDir);
+      StringStorage traceFileName;
+      if (config->isUpdateTraceEnabled()) {
+        traceFileName.format(_T("%s\\updates-%u-%d.trace"), logDir.getString(),
+                             (unsigned int)GetCurrentProcessId(), m_id);
+      }
+      StringStorage recordingFileName;
+      if (config->isSessionRecordingEnabled()) {
+        recordingFileName.format(_T("%s\\session-%u-%d.rec"), logDir.getString(),
+                                 (unsigned int)GetCurrentProcessId(), m_id);
+      }
+      m_updateSender = new UpdateSender(&codeRegtor, m_desktop, this,
+                                        &output, m_rectCache, m_dirtyTiles,
+                                        m_frameStore,
+                                        m_multicast,
+                                        config->getEncoderThreadCount(),
+                                        config->isAdaptiveQualityEnabled(),
+                                        config->isInteractiveFirstEnabled(),
+                                        config->isPreviewFirstFrameEnabled(),
+                                        config->isAutoEncodingEnabled(),
+                                        traceFileName.isEmpty() ?
+                                          0 : traceFileName.getString(),
+                                        recordingFileName.isEmpty() ?
+                                          0 : recordingFileName.getString(),
+                                        m_id, m_desktop, m_log);
+      m_log->debug(_T("UpdateSender has been created for client #%d"), m_id);
+      PixelFormat pf;
+      Dimension fbDim;
+      m_desktop->getFrameBufferProperties(&fbDim, &pf);
+      Rect viewPort = getViewPortRect(&fbDim);
+      m_updateSender->init(&Dimension(&viewPort), &pf);
+      m_log->debug(_T("UpdateSender has been initialized"));
+      // ClientInputHandler initialization
+      m_clientInputHandler = new ClientInputHandler(&codeRegtor, this,
+                                                    m_viewOnly);
+      m_log->debug(_T("ClientInputHandler has been created"));
+      // ClipboardExchange initialization
+      m_clipboardExchange = new ClipboardExchange(&codeRegtor, m_desktop, &output,
+                                                  m_viewOnly, m_taskScheduler,
+                                                  m_log);
+      m_log->debug(_T("ClipboardExchange has been created"));
+
+      // FileTransfers initialization
+      if (config->isFileTransfersEnabled() &&
+          rfbInitializer.getTightEnabledFlag()) {
+        fileTransfer = new FileTransferRequestHandler(&codeRegtor, &output, m_desktop, m_log, !m_viewOnly,
+                                                      m_fileTransferBandwidth, this);
+        m_log->debug(_T("File transfer has been created"));
+      } else {
+        m_log->info(_T("File transfer is not allowed"));
+      }
+      // echo extension initialization
+      echoExtension = new EchoExtensionRequestHandler(&codeRegtor, &output, m_log);
+      m_log->debug(_T("Echo extension handler has been created"));
+      // The bulk channel carries the file transfer, it is offered along
+      // with it when the client can open a second connection to us.
+      if (fileTransfer != 0 && !m_isOutgoing && !m_isWebSocket) {
+        bulkChannel = new BulkChannelRequestHandler(&codeRegtor, &output,
+                                                    this, m_log);
+        m_log->debug(_T("Bulk channel handler has been created"));
+      }
+
+      // Second initialization phase
+      // Send and receive initialization information between server and viewer
+      m_log->debug(_T("View port: (%d,%d) (%dx%d)"), viewPort.left,
+                                                   viewPort.top,
+                                                   viewPort.getWidth(),
+                                                   viewPort.getHeight());
+      m_log->info(_T("Entering RFB initialization phase 2"));
+      rfbInitializer.afterAuthPhase(&srvToClCaps, &clToSrvCaps,
+                                    &encCaps, &Dimension(&viewPort), &pf);
+      m_log->debug(_T("RFB initialization phase 2 completed"));
+
+      // Start normal phase
+      setClientState(IN_NORMAL_PHASE);
+
+      m_log->info(_T("Entering normal phase of the RFB protocol"));
+      if (m_iocpEngine != 0) {
+        dispatcher.resumeOnEngine(m_iocpEngine, m_socket);
+      } else {
+        dispatcher.resume();
+      }
+
+      m_connClosingEvent.waitForEvent();
     }
-    // echo extension initialization
-    echoExtension = new EchoExtensionRequestHandler(&codeRegtor, &output, m_log);
-    m_log->debug(_T("Echo extension handler has been created"));
-
-    // Second initialization phase
-    // Send and receive initialization information between server and viewer
-    m_log->debug(_T("View port: (%d,%d) (%dx%d)"), viewPort.left,
-                                                 viewPort.top,
-                                                 viewPort.getWidth(),
-                                                 viewPort.getHeight());
-    m_log->info(_T("Entering RFB initialization phase 2"));
-    rfbInitializer.afterAuthPhase(&srvToClCaps, &clToSrvCaps,
-                                  &encCaps, &Dimension(&viewPort), &pf);
-    m_log->debug(_T("RFB initialization phase 2 completed"));
-
-    // Start normal phase
-    setClientState(IN_NORMAL_PHASE);
-
-    m_log->info(_T("Entering normal phase of the RFB protocol"));
-    dispatcher.resume();
-
-    m_connClosingEvent.waitForEvent();
   } catch (Exception &e) {
     m_log->error(_T("Connection will be closed: %s"), e.getMessage());
     sysLogMessage.format(_T("The client %s #%d has been")
@@ -281,16 +406,39 @@ void RfbClient::execute()
   }
 
   disconnect();
+  // The bulk channel works with the objects of this client destroyed
+  // below, and the bulk channel itself is destroyed already.
+  closeBulkChannel();
+  if (m_bulkPrimary != 0) {
+    m_bulkPrimary->detachBulkChannel();
+  }
   m_newConnectionEvents->onDisconnect(&sysLogMessage);
 
+  // Stop injecting the queued input before other threads release us.
+  if (m_clientInputHandler) {
+    m_clientInputHandler->terminate();
+    m_clientInputHandler->wait();
+  }
+
   // After this call, we are guaranteed not to be used by other threads.
   notifyAbStateChanging(IN_PENDING_TO_REMOVE);
 
   if (fileTransfer)         delete fileTransfer;
   if (echoExtension)        delete echoExtension;
+  if (bulkChannel)          delete bulkChannel;
   if (m_clipboardExchange)  delete m_clipboardExchange;
   if (m_clientInputHandler) delete m_clientInputHandler;
   if (m_updateSender)       delete m_updateSender;
+  m_outputQueue = 0;
+  m_tlsStream = 0;
+
+  if (frameTrace) {
+    StringStorage logDir;
+    config->getLogFileDir(&logDir);
+    if (!FrameTrace::getInstance()->exportToDir(logDir.getString())) {
+      m_log->error(_T("Cannot export the frame trace to %s"), logDir.getString());
+    }
+  }
 
   // Let the client manager remove us from the client lists.
   notifyAbStateChanging(IN_READY_TO_REMOVE);
@@ -313,6 +461,104 @@ void RfbClient::sendClipboard(const StringStorage *newClipboard)
   m_clipboardExchange->sendClipboard(newClipboard);
 }
 
+void RfbClient::setBulkChannelToken(const UINT8 *token)
+{
+  AutoLock al(&m_bulkLock);
+  memcpy(m_bulkToken, token, sizeof(m_bulkToken));
+  m_hasBulkToken = true;
+}
+
+bool RfbClient::attachBulkChannel(RfbClient *bulkClient, const UINT8 *token)
+{
+  AutoLock al(&m_bulkLock);
+  if (!m_hasBulkToken || m_isBulkClosing || m_bulkClient != 0 ||
+      memcmp(m_bulkToken, token, sizeof(m_bulkToken)) != 0) {
+    return false;
+  }
+  // The token is given once, whatever the result.
+  m_hasBulkToken = false;
+
+  SocketAddressIPv4 addr, bulkAddr;
+  if (!m_socket->getPeerAddr(&addr) ||
+      !bulkClient->m_socket->getPeerAddr(&bulkAddr) ||
+      addr.getSockAddr().sin_addr.S_un.S_addr !=
+      bulkAddr.getSockAddr().sin_addr.S_un.S_addr) {
+    m_log->error(_T("The bulk channel token of client #%d comes from")
+                 _T(" another address"), m_id);
+    return false;
+  }
+  m_bulkClient = bulkClient;
+  bulkClient->m_bulkPrimary = this;
+  m_log->info(_T("Connection #%d is the bulk channel of client #%d"),
+              bulkClient->m_id, m_id);
+  return true;
+}
+
+void RfbClient::serveBulkChannel(RfbInputGate *input, RfbOutputGate *output)
+{
+  RfbClient *primary = m_bulkPrimary;
+  _ASSERT(primary != 0);
+
+  FileTransferRequestHandler *fileTransfer = 0;
+  {
+    RfbDispatcher dispatcher(input, &m_connClosingEvent);
+    // The capabilities have been sent on the main connection.
+    CapContainer srvToClCaps, clToSrvCaps, encCaps;
+    RfbCodeRegistrator codeRegtor(&dispatcher, &srvToClCaps, &clToSrvCaps,
+                                  &encCaps);
+    fileTransfer = new FileTransferRequestHandler(&codeRegtor, output,
+                                                  primary->m_desktop, m_log,
+                                                  !primary->m_viewOnly,
+                                                  primary->m_fileTransferBandwidth,
+                                                  this);
+    primary->m_clipboardExchange->setBulkOutput(output);
+
+    setClientState(IN_NORMAL_PHASE);
+    if (m_iocpEngine != 0) {
+      dispatcher.resumeOnEngine(m_iocpEngine, m_socket);
+    } else {
+      dispatcher.resume();
+    }
+    m_connClosingEvent.waitForEvent();
+
+    primary->m_clipboardExchange->setBulkOutput(0);
+    // Let the dispatcher leave the reading.
+    try { m_socket->shutdown(SD_BOTH); } catch (...) { }
+  }
+  delete fileTransfer;
+}
+
+void RfbClient::detachBulkChannel()
+{
+  {
+    AutoLock al(&m_bulkLock);
+    m_bulkClient = 0;
+  }
+  m_bulkDetachedEvent.notify();
+}
+
+void RfbClient::closeBulkChannel()
+{
+  {
+    // The bulk channel is not destroyed while it is attached.
+    AutoLock al(&m_bulkLock);
+    m_isBulkClosing = true;
+    if (m_bulkClient != 0) {
+      m_bulkClient->disconnect();
+    }
+  }
+  // The event may have been left notified by a previous bulk channel.
+  while (true) {
+    {
+      AutoLock al(&m_bulkLock);
+      if (m_bulkClient == 0) {
+        break;
+      }
+    }
+    m_bulkDetachedEvent.waitForEvent();
+  }
+}
+
 void RfbClient::onKeyboardEvent(UINT32 keySym, bool down)
 {
   // FIXME: How to deal with the situations when we inject a "key down" event, then foreground
@@ -350,15 +596,38 @@ void RfbClient::onMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask)
     sharedRegion.clear();
     sharedRegion.addRect(&vp);
   }
-  bool pointInside = sharedRegion.isPointInside(x + vp.left, y + vp.top);
+  // The pointer of a client with a scaled frame buffer is in its scaled
+  // coordinates.
+  int scale = m_updateSender->getScale();
+  int desktopX = x * scale + vp.left;
+  int desktopY = y * scale + vp.top;
+  bool pointInside = sharedRegion.isPointInside(desktopX, desktopY);
 
   if (pointInside) {
     m_updateSender->blockCursorPosSending();
-    m_desktop->setMouseEvent(x + vp.left, y + vp.top, buttonMask);
+    m_desktop->setMouseEvent(desktopX, desktopY, buttonMask);
     m_idleTimer.reset();
   }
 }
 
+void RfbClient::onInputBatchBegin()
+{
+  // Sharing of an application checks the focus on each key event, so
+  // the events before it must be injected.
+  if (!m_dynamicViewPort.getOnlyApplication()) {
+    m_desktop->beginInputBatch();
+    m_isInputBatch = true;
+  }
+}
+
+void RfbClient::onInputBatchEnd()
+{
+  if (m_isInputBatch) {
+    m_isInputBatch = false;
+    m_desktop->endInputBatch();
+  }
+}
+
 Rect RfbClient::getViewPortRect(const Dimension *fbDimension)
 {
   AutoLock al(&m_viewPortMutex);
@@ -381,6 +650,119 @@ void RfbClient::getViewPortInfo(const Dimension *fbDimension, Rect *resultRect,
   }
 }
 
+void RfbClient::getVisibleRegion(const Dimension *fbDimension, Region *region)
+{
+  Rect viewPort;
+  bool shareApp;
+  Region shareAppRegion;
+  getViewPortInfo(fbDimension, &viewPort, &shareApp, &shareAppRegion);
+
+  region->clear();
+  region->addRect(&viewPort);
+  if (shareApp) {
+    region->intersect(&shareAppRegion);
+  }
+}
+
+void RfbClient::onNetworkEstimate(unsigned int roundTripTime,
+                                  unsigned int throughput)
+{
+  // Below these throughputs, in bytes per second, the visual effects are
+  // reduced and minimal. The effects come back only when the throughput
+  // is twice as high, so that they don't flap with the estimates.
+  const unsigned int REDUCED_EFFECTS_THROUGHPUT = 1250000;
+  const unsigned int MINIMAL_EFFECTS_THROUGHPUT = 125000;
+  int level = m_visualEffectsLevel;
+  unsigned int hysteresis = level >= VisualEffectsUtil::LEVEL_MINIMAL ? 2 : 1;
+  if (throughput < MINIMAL_EFFECTS_THROUGHPUT * hysteresis) {
+    level = VisualEffectsUtil::LEVEL_MINIMAL;
+  } else {
+    hysteresis = level >= VisualEffectsUtil::LEVEL_REDUCED ? 2 : 1;
+    if (throughput < REDUCED_EFFECTS_THROUGHPUT * hysteresis) {
+      level = VisualEffectsUtil::LEVEL_REDUCED;
+    } else {
+      level = VisualEffectsUtil::LEVEL_FULL;
+    }
+  }
+  if (level != m_visualEffectsLevel) {
+    m_log->info(_T("Visual effects level of client #%d is %d")
+                _T(" (throughput %u bytes per second)"),
+                m_id, level, throughput);
+    m_visualEffectsLevel = level;
+  }
+
+  if (!m_autoTuneSendBuffer) {
+    return;
+  }
+  int size = SocketProfile::calcSendBufferSize(roundTripTime, throughput);
+  // Follow significant changes only, the estimates vary all the time.
+  int margin = m_sendBufferSize / 4;
+  if (size > m_sendBufferSize - margin && size < m_sendBufferSize + margin) {
+    return;
+  }
+  try {
+    m_socket->setSendBufferSize(size);
+    m_sendBufferSize = size;
+    m_log->info(_T("Send buffer of client #%d set to %d bytes")
+                _T(" (round trip time %u ms, throughput %u bytes per second)"),
+                m_id, size, roundTripTime, throughput);
+  } catch (SocketException &e) {
+    m_log->error(_T("Can't set the send buffer size of client #%d: %s"),
+                 m_id, e.getMessage());
+    m_autoTuneSendBuffer = false;
+  }
+}
+
+bool RfbClient::waitForOutputSpace(unsigned int timeoutMillis)
+{
+  if (m_outputQueue == 0) {
+    return m_socket->waitForWritable(timeoutMillis);
+  }
+  size_t maxQueued = m_outputQueue->getMaxQueuedSize() / 4;
+  // A limited client must not get seconds of updates queued, the next
+  // update is encoded when the queue can leave in a short while.
+  unsigned int rateLimit = getRateLimit();
+  if (rateLimit != 0) {
+    maxQueued = min(maxQueued, (size_t)rateLimit * LIMITED_QUEUE_MILLIS / 1000);
+  }
+  return m_outputQueue->waitForQueuedSize(maxQueued, timeoutMillis);
+}
+
+size_t RfbClient::getOutputQueueSize()
+{
+  return m_outputQueue != 0 ? m_outputQueue->getQueuedSize() : 0;
+}
+
+unsigned int RfbClient::getRateLimit()
+{
+  unsigned int rate = m_bandwidth.getRate();
+  unsigned int serverRate = m_serverBandwidth != 0 ? m_serverBandwidth->getRate() : 0;
+  if (rate == 0 || (serverRate != 0 && serverRate < rate)) {
+    rate = serverRate;
+  }
+  return rate;
+}
+
+bool RfbClient::canTransmitFiles()
+{
+  return m_outputQueue != 0 && !m_isWebSocket &&
+         m_tlsStream != 0 && !m_tlsStream->isStarted() &&
+         getRateLimit() == 0;
+}
+
+bool RfbClient::transmitFile(HANDLE file, UINT64 offset, UINT32 length,
+                             const void *head, size_t headLength)
+{
+  if (!canTransmitFiles()) {
+    return false;
+  }
+  // The gate is locked, the queue only drains. Its space event may be
+  // taken by the update sender, so the size is checked again on timeouts.
+  while (!m_outputQueue->waitForQueuedSize(0, 100)) {
+  }
+  return m_socket->transmitFile(file, offset, length, head, (DWORD)headLength);
+}
+
 void RfbClient::onGetViewPort(Rect *viewRect, bool *shareApp, Region *shareAppRegion)
 {
   PixelFormat pfStub;
@@ -30,6 +30,8 @@
 #include "win-system/WindowsEvent.h"
 #include "thread/Thread.h"
 #include "network/RfbOutputGate.h"
+#include "network/WriteBehindOutputStream.h"
+#include "network/TokenBucket.h"
 #include "desktop/Desktop.h"
 #include "fb-update-sender/UpdateSender.h"
 #include "log-writer/LogWriter.h"
@@ -41,6 +43,8 @@
 #include "ClientInputEventListener.h"
 #include "tvnserver-app/NewConnectionEvents.h"
 #include "util/DemandTimer.h"
+#include "rfb/MsgDefs.h"
+#include "ft-server-lib/FileTransmitter.h"
 
 class ClientAuthListener;
 
@@ -55,16 +59,28 @@ enum ClientState
 };
 
 // FIXME: Document it, i understand nothing from such kind of description.
-class RfbClient: public Thread, ClientInputEventListener, private SenderControlInformationInterface
+class TlsStream;
+
+class RfbClient: public Thread, ClientInputEventListener, private SenderControlInformationInterface,
+                 private FileTransmitter
 {
 public:
   RfbClient(NewConnectionEvents *newConnectionEvents, SocketIPv4 *socket,
             ClientTerminationListener *extTermListener,
             ClientAuthListener *extAuthListener, bool viewOnly,
-            bool isOutgoing, unsigned int id,
+            bool isOutgoing, bool isWebSocket,
+            const char *clientVersion, unsigned int id,
             const ViewPortState *constViewPort,
             const ViewPortState *dynViewPort,
             int idleTimeout,
+            EncodedRectCache *rectCache,
+            DirtyTileMap *dirtyTiles,
+            SharedFrameStore *frameStore,
+            MulticastSender *multicast,
+            IocpEngine *iocpEngine,
+            TaskScheduler *taskScheduler,
+            TokenBucket *serverBandwidth,
+            TokenBucket *fileTransferBandwidth,
             LogWriter *log);
   virtual ~RfbClient();
 
@@ -74,6 +90,9 @@ public:
 
   unsigned int getId() const;
   void getPeerHost(StringStorage *address);
+  // Fills stats with the update sending counters of the connection. Must be
+  // called in the normal phase only.
+  void getStatistics(UpdateStatistics *stats);
   void getLocalIpAddress(StringStorage *address);
   void getSocketAddr(SocketAddressIPv4 *addr) const;
 
@@ -90,10 +109,24 @@ public:
   void changeDynViewPort(const ViewPortState *dynViewPort);
 
   bool clientIsReady() const { return m_updateSender->clientIsReady(); }
+  // Puts to region the part of the frame buffer the client can see: its
+  // view port or the shared application windows in it.
+  void getVisibleRegion(const Dimension *fbDimension, Region *region);
+  // Returns the VisualEffectsUtil level suiting the estimated throughput of
+  // the client connection, LEVEL_FULL until it is estimated.
+  int getVisualEffectsLevel() const { return m_visualEffectsLevel; }
   void sendUpdate(const UpdateContainer *updateContainer,
                   const CursorShape *cursorShape);
   void sendClipboard(const StringStorage *newClipboard);
 
+  // Stores the token the client is given for its bulk channel, replacing
+  // the previous one.
+  void setBulkChannelToken(const UINT8 *token);
+  // Makes bulkClient the bulk channel of this client, if the token is the
+  // one given to the client and the connections come from the same
+  // address. The token is not valid after that.
+  bool attachBulkChannel(RfbClient *bulkClient, const UINT8 *token);
+
 protected:
   virtual void execute();
   virtual void onTerminate();
@@ -111,14 +144,41 @@ private:
   // This class is layer between WinDesktop and ClientInputHandler.
   virtual void onKeyboardEvent(UINT32 keySym, bool down);
   virtual void onMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask);
+  virtual void onInputBatchBegin();
+  virtual void onInputBatchEnd();
 
   void setClientState(ClientState newState);
 
   Rect getViewPortRect(const Dimension *fbDimension);
   virtual void onGetViewPort(Rect *viewRect, bool *shareApp, Region *shareAppRegion);
+  // Resizes the socket send buffer to the bandwidth-delay product if
+  // auto-tuning is enabled.
+  virtual void onNetworkEstimate(unsigned int roundTripTime,
+                                 unsigned int throughput);
+  // Waits for the output queue to drain below a quarter of its size, so
+  // that the next update is encoded while the previous one is being sent.
+  virtual bool waitForOutputSpace(unsigned int timeoutMillis);
+  virtual size_t getOutputQueueSize();
+  // Returns the lower of the client and server bandwidth limits.
+  virtual unsigned int getRateLimit();
+
+  // Inherited from FileTransmitter. The file data go to the socket by
+  // TransmitFile() after the output queue has drained, when the connection
+  // is plain TCP without bandwidth limits.
+  virtual bool canTransmitFiles();
+  virtual bool transmitFile(HANDLE file, UINT64 offset, UINT32 length,
+                            const void *head, size_t headLength);
   void getViewPortInfo(const Dimension *fbDimension, Rect *resultRect,
                        bool *shareApp, Region *shareAppRegion);
 
+  // Serves the file transfer of the client this connection is the bulk
+  // channel of, until the connection is closed.
+  void serveBulkChannel(RfbInputGate *input, RfbOutputGate *output);
+  // Called by the bulk channel when it stops using this client.
+  void detachBulkChannel();
+  // Closes the bulk channel and waits until it is detached.
+  void closeBulkChannel();
+
   ClientState m_clientState;
   bool m_isMarkedOk;
   LocalMutex m_clientStateMut;
@@ -126,6 +186,24 @@ private:
   WindowsEvent m_connClosingEvent;
 
   SocketIPv4 *m_socket;
+  // Queue of the data written to the client, exists while the connection
+  // thread runs.
+  WriteBehindOutputStream *m_outputQueue;
+  // TLS tunnel of the connection, exists while the connection thread runs.
+  TlsStream *m_tlsStream;
+  // Bandwidth limits of the client and of all the clients, paced by the
+  // output queue, and of the file transfers of all the clients.
+  TokenBucket m_bandwidth;
+  TokenBucket *m_serverBandwidth;
+  TokenBucket *m_fileTransferBandwidth;
+  // Time in milliseconds the data queued for a limited client may take to
+  // leave before the next update is encoded.
+  static const unsigned int LIMITED_QUEUE_MILLIS = 100;
+  // Auto-tuning of the send buffer, used by the sender thread only.
+  bool m_autoTuneSendBuffer;
+  int m_sendBufferSize;
+  // Bandwidth class of the connection, set by the sender thread.
+  volatile int m_visualEffectsLevel;
 
   ClientAuthListener *m_extAuthListener;
 
@@ -134,12 +212,35 @@ private:
   LocalMutex m_viewPortMutex;
 
   UpdateSender *m_updateSender;
+  // Encoded rectangle cache shared between clients, passed to UpdateSender.
+  EncodedRectCache *m_rectCache;
+  // Changed tile map shared between clients, passed to UpdateSender.
+  DirtyTileMap *m_dirtyTiles;
+  // Frame buffers shared between clients, passed to UpdateSender, may be 0.
+  SharedFrameStore *m_frameStore;
+  // Multicast stream of the screen, passed to UpdateSender, may be 0.
+  MulticastSender *m_multicast;
+  // Engine reading the client messages, 0 if they are read by the
+  // dispatcher thread.
+  IocpEngine *m_iocpEngine;
+  // Scheduler shared between clients, runs the clipboard sending.
+  TaskScheduler *m_taskScheduler;
   ClipboardExchange *m_clipboardExchange;
   ClientInputHandler *m_clientInputHandler;
   Desktop *m_desktop;
+  // Flag is set while the input events are batched, used by the thread of
+  // ClientInputHandler only.
+  bool m_isInputBatch;
 
   bool m_viewOnly;
   bool m_isOutgoing;
+  // The protocol goes in WebSocket frames, the opening handshake has been
+  // done by the HTTP server.
+  bool m_isWebSocket;
+  // The protocol version message of the client, if it has been read before
+  // the client was made.
+  bool m_versionExchanged;
+  char m_clientVersion[12];
   bool m_viewOnlyAuth;
   bool m_shared;
 
@@ -149,6 +250,16 @@ private:
   unsigned int m_id;
 
   NewConnectionEvents *m_newConnectionEvents;
+
+  // Bulk channel of the client and the token it is opened with.
+  RfbClient *m_bulkClient;
+  UINT8 m_bulkToken[BulkChannelDefs::TOKEN_LENGTH];
+  bool m_hasBulkToken;
+  bool m_isBulkClosing;
+  LocalMutex m_bulkLock;
+  WindowsEvent m_bulkDetachedEvent;
+  // The client this connection is the bulk channel of, or 0.
+  RfbClient *m_bulkPrimary;
   // This timer sets by IdleTimeout value from server config 
   // and resets on mouse or keyboard event
   DemandTimer m_idleTimer;
@@ -28,7 +28,9 @@ RfbDispatcher::RfbDispatcher(RfbInputGate *gate,
                              AnEventListener *extTerminationListener)
 : m_gate(gate),
   m_extTerminationListener(extTerminationListener),
-  m_terminationEvent(0)
+  m_terminationEvent(0),
+  m_engine(0),
+  m_session(0)
 {
 }
 
@@ -36,16 +38,29 @@ RfbDispatcher::RfbDispatcher(RfbInputGate *gate,
                              WindowsEvent *terminationEvent)
 : m_gate(gate),
   m_extTerminationListener(0),
-  m_terminationEvent(terminationEvent)
+  m_terminationEvent(terminationEvent),
+  m_engine(0),
+  m_session(0)
 {
 }
 
 RfbDispatcher::~RfbDispatcher()
 {
   terminate();
+  if (m_session != 0) {
+    m_engine->removeSocket(m_session);
+  }
   wait();
 }
 
+void RfbDispatcher::resumeOnEngine(IocpEngine *engine, SocketIPv4 *socket)
+{
+  m_engine = engine;
+  m_session = m_engine->addSocket(socket, this);
+  // Let the own thread exit, a thread never resumed would be left behind.
+  resume();
+}
+
 void RfbDispatcher::notifyAbTermination()
 {
   if (m_extTerminationListener) {
@@ -58,27 +73,55 @@ void RfbDispatcher::notifyAbTermination()
 
 void RfbDispatcher::execute()
 {
+  if (m_engine != 0) {
+    return;
+  }
   try {
     while (!isTerminating()) {
-      UINT32 code = m_gate->readUInt8();
-      if (code == 0xfc) { // special TightVNC code
-        code = code << 24;
-        code += m_gate->readUInt8() << 16;
-        code += m_gate->readUInt8() << 8;
-        code += m_gate->readUInt8();
-      }
-      std::map<UINT32, RfbDispatcherListener *>::iterator iter = m_handlers.find(code);
-      if (iter == m_handlers.end()) {
-        StringStorage errMess;
-        errMess.format(_T("unhandled %d code has been received from a client"),
-                       (int)code);
-        throw Exception(errMess.getString());
+      dispatchMessage();
+    }
+  } catch (...) {
+  }
+  notifyAbTermination();
+}
+
+bool RfbDispatcher::onSocketReadable()
+{
+  try {
+    // Dispatch everything received, the messages already in the input
+    // buffer will not be reported by the socket again.
+    do {
+      if (isTerminating()) {
+        break;
       }
-      (*iter).second->onRequest(code, m_gate);
+      dispatchMessage();
+    } while (m_gate->available() != 0);
+    if (!isTerminating()) {
+      return true;
     }
   } catch (...) {
   }
   notifyAbTermination();
+  return false;
+}
+
+void RfbDispatcher::dispatchMessage()
+{
+  UINT32 code = m_gate->readUInt8();
+  if (code == 0xfc) { // special TightVNC code
+    code = code << 24;
+    code += m_gate->readUInt8() << 16;
+    code += m_gate->readUInt8() << 8;
+    code += m_gate->readUInt8();
+  }
+  std::map<UINT32, RfbDispatcherListener *>::iterator iter = m_handlers.find(code);
+  if (iter == m_handlers.end()) {
+    StringStorage errMess;
+    errMess.format(_T("unhandled %d code has been received from a client"),
+                   (int)code);
+    throw Exception(errMess.getString());
+  }
+  (*iter).second->onRequest(code, m_gate);
 }
 
 void RfbDispatcher::registerNewHandle(UINT32 code, RfbDispatcherListener *listener)
@@ -29,9 +29,10 @@
 #include "RfbDispatcherListener.h"
 #include "util/AnEventListener.h"
 #include "win-system/WindowsEvent.h"
+#include "network/IocpEngine.h"
 #include <map>
 
-class RfbDispatcher : public Thread
+class RfbDispatcher : public Thread, private IocpListener
 {
 public:
   RfbDispatcher(RfbInputGate *gate,
@@ -43,16 +44,31 @@ public:
 
   void registerNewHandle(UINT32 code, RfbDispatcherListener *listener);
 
+  // Starts dispatching messages from the workers of the engine as they
+  // arrive to the socket, instead of the own thread of the dispatcher.
+  // Should be called instead of resume().
+  void resumeOnEngine(IocpEngine *engine, SocketIPv4 *socket);
+
 protected:
   virtual void execute();
   void notifyAbTermination();
 
+  // Reads one message and passes it to its handler.
+  void dispatchMessage();
+
+  // Inherited from IocpListener.
+  virtual bool onSocketReadable();
+
   RfbInputGate *m_gate;
 
   std::map<UINT32, RfbDispatcherListener *> m_handlers;
 
   AnEventListener *m_extTerminationListener;
   WindowsEvent *m_terminationEvent;
+
+  // Set if messages are dispatched from the engine.
+  IocpEngine *m_engine;
+  IocpSession *m_session;
 };
 
 #endif // __RFBDISPATCHER_H__
@@ -26,6 +26,8 @@
 #include "thread/AutoLock.h"
 #include "rfb/VendorDefs.h"
 #include "rfb/AuthDefs.h"
+#include "rfb/TunnelDefs.h"
+#include "rfb/MsgDefs.h"
 #include "CapContainer.h"
 #include "server-config-lib/Configurator.h"
 #include "AuthException.h"
@@ -35,21 +37,32 @@
 #include "tvnserver-app/NamingDefs.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-RfbInitializer::RfbInitializer(Channel *stream,
+const char RfbInitializer::SERVER_VERSION_MSG[] = "RFB 003.008\n";
+
+RfbInitializer::RfbInitializer(Channel *stream, TlsStream *tlsStream,
                                ClientAuthListener *extAuthListener,
-                               RfbClient *client, bool authAllowed)
+                               RfbClient *client, bool authAllowed,
+                               const char *clientVersion)
 : m_shared(false),
   m_tightEnabled(false),
   m_minorVerNum(0),
   m_extAuthListener(extAuthListener),
   m_client(client),
   m_authAllowed(authAllowed),
-  m_viewOnlyAuth(false)
+  m_isBulkChannel(false),
+  m_versionExchanged(clientVersion != 0),
+  m_viewOnlyAuth(false),
+  m_tlsStream(tlsStream)
 {
   m_output = new DataOutputStream(stream);
   m_input = new DataInputStream(stream);
+  memset(m_clientVersionMsg, 0, sizeof(m_clientVersionMsg));
+  if (clientVersion != 0) {
+    memcpy(m_clientVersionMsg, clientVersion, VERSION_MSG_LENGTH);
+  }
 }
 
 RfbInitializer::~RfbInitializer()
@@ -61,6 +74,10 @@ RfbInitializer::~RfbInitializer()
 void RfbInitializer::authPhase()
 {
   initVersion();
+  if (m_isBulkChannel) {
+    authBulkChannel();
+    return;
+  }
   initAuthenticate();
   readClientInit();
 }
@@ -80,20 +97,26 @@ void RfbInitializer::afterAuthPhase(const CapContainer *srvToClCaps,
 
 void RfbInitializer::initVersion()
 {
-  char initVersionMsg[] = "RFB 003.008\n";
-  char clientVersionMsg[13];
-  size_t msgLen = 12;
-  m_output->writeFully(initVersionMsg, msgLen);
-  m_input->readFully(clientVersionMsg, msgLen);
-  clientVersionMsg[12] = 0;
-  m_minorVerNum = getProtocolMinorVersion(clientVersionMsg);
+  char *clientVersionMsg = m_clientVersionMsg;
+  if (!m_versionExchanged) {
+    m_output->writeFully(SERVER_VERSION_MSG, VERSION_MSG_LENGTH);
+    m_input->readFully(clientVersionMsg, VERSION_MSG_LENGTH);
+  }
+  m_isBulkChannel = m_authAllowed &&
+    memcmp(clientVersionMsg, BulkChannelDefs::GREETING,
+           BulkChannelDefs::GREETING_LENGTH) == 0;
+  if (!m_isBulkChannel) {
+    m_minorVerNum = getProtocolMinorVersion(clientVersionMsg);
+  }
 
   try {
     checkForLoopback();
     // Checking for a ban before auth and then after.
     checkForBan();
   } catch (Exception &e) {
-    if (m_minorVerNum == 3) {
+    if (m_isBulkChannel) {
+      m_output->writeUInt32(BulkChannelDefs::RESULT_FAILED);
+    } else if (m_minorVerNum == 3) {
       m_output->writeUInt32(0);
     } else {
       m_output->writeUInt8(0);
@@ -107,6 +130,9 @@ void RfbInitializer::initVersion()
 
     throw;
   }
+  if (m_isBulkChannel) {
+    m_output->writeUInt32(BulkChannelDefs::RESULT_OK);
+  }
 }
 
 void RfbInitializer::checkForLoopback()
@@ -128,8 +154,7 @@ void RfbInitializer::checkForLoopback()
 
 void RfbInitializer::doTightAuth()
 {
-  // Negotiate tunneling.
-  m_output->writeUInt32(0);
+  negotiateTunnel();
   // Negotiate authentication.
   // FIXME: Recognize authentication types.
   if (Configurator::getInstance()->getServerConfig()->isUsingAuthentication()
@@ -150,6 +175,29 @@ void RfbInitializer::doTightAuth()
   }
 }
 
+void RfbInitializer::negotiateTunnel()
+{
+  // TLS is offered along with no tunneling, when the server certificate
+  // is there.
+  if (m_tlsStream == 0 || !TlsStream::isServerAvailable()) {
+    m_output->writeUInt32(0);
+    return;
+  }
+  CapContainer tunnelInfo;
+  tunnelInfo.addCap(TunnelDefs::TLS, VendorDefs::TIGHTVNC, TunnelDefs::SIG_TLS);
+  tunnelInfo.addCap(TunnelDefs::NOTUNNEL, VendorDefs::TIGHTVNC,
+                    TunnelDefs::SIG_NONE);
+  m_output->writeUInt32(tunnelInfo.getCapCount());
+  tunnelInfo.sendCaps(m_output);
+  UINT32 tunnelType = m_input->readUInt32();
+  if (!tunnelInfo.includes(tunnelType)) {
+    throw Exception(_T("Tunnel type is not supported"));
+  }
+  if (tunnelType == TunnelDefs::TLS) {
+    m_tlsStream->startTls(true, 0);
+  }
+}
+
 void RfbInitializer::doAuth(UINT32 authType)
 {
   if (authType == AuthDefs::VNC) {
@@ -224,6 +272,37 @@ void RfbInitializer::doAuthNone()
 {
 }
 
+void RfbInitializer::authBulkChannel()
+{
+  negotiateTunnel();
+  UINT8 token[BulkChannelDefs::TOKEN_LENGTH];
+  m_input->readFully(token, sizeof(token));
+  try {
+    // Checking for a ban after auth, as with a password.
+    checkForBan();
+    if (!m_extAuthListener->onBulkChannelAuth(m_client, token)) {
+      m_extAuthListener->onAuthFailed(m_client);
+
+      StringStorage clientAddressStorage;
+      m_client->getPeerHost(&clientAddressStorage);
+      StringStorage errMess;
+      errMess.format(_T("Invalid bulk channel token from %s"),
+                     clientAddressStorage.getString());
+      throw AuthException(errMess.getString());
+    }
+  } catch (AuthException &e) {
+    AnsiStringStorage reason(&StringStorage(e.getMessage()));
+    unsigned int reasonLen = (unsigned int)reason.getLength();
+    _ASSERT(reasonLen == reason.getLength());
+
+    m_output->writeUInt32(BulkChannelDefs::RESULT_FAILED);
+    m_output->writeUInt32(reasonLen);
+    m_output->writeFully(reason.getString(), reasonLen);
+    throw;
+  }
+  m_output->writeUInt32(BulkChannelDefs::RESULT_OK);
+}
+
 void RfbInitializer::initAuthenticate()
 {
   try {
@@ -31,15 +31,22 @@
 #include "CapContainer.h"
 #include "region/Dimension.h"
 #include "rfb/PixelFormat.h"
+#include "network/TlsStream.h"
 // External listeners
 #include "ClientAuthListener.h"
 
 class RfbInitializer
 {
 public:
-  RfbInitializer(Channel *stream,
+  // The tlsStream is the stream (in pass-through mode) which gets
+  // encrypted if the client chooses the TLS tunnel, or 0 if TLS must not be
+  // offered. The clientVersion is the protocol version message of the
+  // client if the versions have been exchanged already (by
+  // ConnectionAdmission), 0 otherwise.
+  RfbInitializer(Channel *stream, TlsStream *tlsStream,
                  ClientAuthListener *extAuthListener,
-                 RfbClient *client, bool authAllowed);
+                 RfbClient *client, bool authAllowed,
+                 const char *clientVersion);
   virtual ~RfbInitializer();
 
   void authPhase();
@@ -56,6 +63,15 @@ public:
 
   bool getTightEnabledFlag() const { return m_tightEnabled; }
 
+  // Returns true if the connection is the bulk channel of another client,
+  // valid after the authPhase() function calling. Nothing goes after the
+  // authentication in this case.
+  bool isBulkChannel() const { return m_isBulkChannel; }
+
+  // The protocol version message of the server, sent first.
+  static const char SERVER_VERSION_MSG[];
+  static const size_t VERSION_MSG_LENGTH = 12;
+
 protected:
   void initVersion();
   // @throw Exception if loopback isn't allowed.
@@ -71,8 +87,12 @@ protected:
 
   void doAuth(UINT32 authType);
   void doTightAuth();
+  void negotiateTunnel();
   void doVncAuth();
   void doAuthNone();
+  // Negotiates the tunnel and checks the token of the bulk channel.
+  // @throw AuthException if the token is not valid.
+  void authBulkChannel();
 
   // Calls the onCheckForBan() function by the external listener
   // @throw AuthException if current is banned.
@@ -92,9 +112,13 @@ protected:
   bool m_viewOnlyAuth;
   bool m_tightEnabled;
   bool m_authAllowed;
+  bool m_isBulkChannel;
+  bool m_versionExchanged;
+  char m_clientVersionMsg[VERSION_MSG_LENGTH + 1];
 
   ClientAuthListener *m_extAuthListener;
   RfbClient *m_client;
+  TlsStream *m_tlsStream;
 };
 
 #endif // __RFBINITIALIZER_H__
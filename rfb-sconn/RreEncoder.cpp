@@ -23,11 +23,23 @@
 //
 
 #include "RreEncoder.h"
+#include "rfb/FrameBufferAccessor.h"
 
 RreEncoder::RreEncoder(PixelConverter *conv, DataOutputStream *output)
-: Encoder(conv, output)
+: Encoder(conv, output),
+  m_compact(false)
 {
   m_rects.reserve(4096);
+  m_colors.reserve(4096);
+}
+
+RreEncoder::RreEncoder(PixelConverter *conv, DataOutputStream *output,
+                       bool compact)
+: Encoder(conv, output),
+  m_compact(compact)
+{
+  m_rects.reserve(4096);
+  m_colors.reserve(4096);
 }
 
 RreEncoder::~RreEncoder()
@@ -44,10 +56,18 @@ void RreEncoder::splitRectangle(const Rect *rect,
                                 const FrameBuffer *serverFb,
                                 const EncodeOptions *options)
 {
-  for (int y0 = rect->top; y0 < rect->bottom; y0 += RECT_SIZE) {
-    for (int x0 = rect->left; x0 < rect->right; x0 += RECT_SIZE) {
-      int x1 = min(x0 + RECT_SIZE, rect->right);
-      int y1 = min(y0 + RECT_SIZE, rect->bottom);
+  // The tiles are made of equal size so that there are no thin strips
+  // at the right and bottom edges, each costing a rectangle header.
+  int width = rect->getWidth();
+  int height = rect->getHeight();
+  int numColumns = (width + RECT_SIZE - 1) / RECT_SIZE;
+  int numRows = (height + RECT_SIZE - 1) / RECT_SIZE;
+  for (int row = 0; row < numRows; row++) {
+    int y0 = rect->top + height * row / numRows;
+    int y1 = rect->top + height * (row + 1) / numRows;
+    for (int column = 0; column < numColumns; column++) {
+      int x0 = rect->left + width * column / numColumns;
+      int x1 = rect->left + width * (column + 1) / numColumns;
       rectList->push_back(Rect(x0, y0, x1, y1));
     }
   }
@@ -72,53 +92,137 @@ void RreEncoder::sendRectangle(const Rect *rect,
   }
 }
 
+size_t RreEncoder::getScratchSize() const
+{
+  return m_rects.capacity() * sizeof(Rect) +
+         m_colors.capacity() * sizeof(UINT32) +
+         (m_prevRow.capacity() + m_curRow.capacity()) * sizeof(size_t) +
+         m_buffer.capacity();
+}
+
+void RreEncoder::releaseScratch()
+{
+  std::vector<Rect>().swap(m_rects);
+  std::vector<UINT32>().swap(m_colors);
+  std::vector<size_t>().swap(m_prevRow);
+  std::vector<size_t>().swap(m_curRow);
+  std::vector<UINT8>().swap(m_buffer);
+}
+
+size_t RreEncoder::putCoordinate(size_t pos, int value)
+{
+  if (m_compact) {
+    m_buffer[pos] = (UINT8)value;
+    return pos + 1;
+  }
+  m_buffer[pos] = (UINT8)(value >> 8);
+  m_buffer[pos + 1] = (UINT8)value;
+  return pos + 2;
+}
+
+template <class PIXEL_T>
+void RreEncoder::findSubrects(const Rect *r,
+                              const FrameBuffer *frameBuffer,
+                              PIXEL_T background,
+                              PIXEL_T mask)
+{
+  FrameBufferAccessor<PIXEL_T> pixels(frameBuffer);
+
+  // Past this number of subrectangles the encoded data is bigger than
+  // the raw pixels. Such a rectangle is noise where runs hardly ever
+  // repeat, so the rest of it is not searched for vertical matches.
+  size_t subrectSize = sizeof(PIXEL_T) + (m_compact ? 4 : 8);
+  size_t breakEven = r->area() * sizeof(PIXEL_T) / subrectSize;
+
+  m_rects.resize(0);
+  m_colors.resize(0);
+  m_prevRow.resize(0);
+
+  for (int y = r->top; y < r->bottom; y++) {
+    const PIXEL_T *row = pixels.getRow(y);
+    int top = y - r->top;
+    bool merging = m_rects.size() <= breakEven;
+    size_t above = 0;
+    m_curRow.resize(0);
+
+    int x = r->left;
+    while (x < r->right) {
+      PIXEL_T value = row[x] & mask;
+      if (value == background) {
+        x++;
+        continue;
+      }
+      int start = x;
+      while (x < r->right && (row[x] & mask) == value) {
+        x++;
+      }
+      int left = start - r->left;
+      int right = x - r->left;
+
+      if (merging) {
+        while (above < m_prevRow.size() &&
+               m_rects[m_prevRow[above]].right <= left) {
+          above++;
+        }
+        if (above < m_prevRow.size()) {
+          size_t index = m_prevRow[above];
+          Rect *candidate = &m_rects[index];
+          if (candidate->left == left && candidate->right == right &&
+              m_colors[index] == value) {
+            candidate->bottom++;
+            m_curRow.push_back(index);
+            above++;
+            continue;
+          }
+        }
+      }
+      m_curRow.push_back(m_rects.size());
+      m_rects.push_back(Rect(left, top, right, top + 1));
+      m_colors.push_back(value);
+    }
+    m_prevRow.swap(m_curRow);
+  }
+}
+
 template <class PIXEL_T>
 void RreEncoder::rreEncode(const Rect *r,
                            const FrameBuffer *frameBuffer)
 {
-  PIXEL_T *buffer = (PIXEL_T *)frameBuffer->getBuffer();
-  int fbWidth = frameBuffer->getDimension().width;
+  FrameBufferAccessor<PIXEL_T> pixels(frameBuffer);
   PixelFormat pxFormat = frameBuffer->getPixelFormat();
   // Mask for cutting rubbish bits.
   PIXEL_T mask = pxFormat.redMax << pxFormat.redShift |
                  pxFormat.greenMax << pxFormat.greenShift |
                  pxFormat.blueMax << pxFormat.blueShift;
-  
-  PIXEL_T backgroundPixelValue = buffer[r->top * fbWidth + r->left] & mask;
-  
-  // Clear the cache with m_rects.
-  m_rects.resize(0);
 
-  vector<PIXEL_T> subrectPixelValue;
-
-  // Find lines with the same pixel values.
-  for (int i = r->top; i < r->bottom; i++) {
-    for (int j = r->left; j < r->right; j++) {
-      if ((buffer[i * fbWidth + j] & mask) != backgroundPixelValue) {
-        if (subrectPixelValue.empty() ||
-            (buffer[i * fbWidth + j] & mask) != (buffer[i * fbWidth + j - 1] & mask) ||
-            m_rects.back().top != (i - r->top)) {
-          subrectPixelValue.push_back(buffer[i * fbWidth + j] & mask);
-          Rect rect(1, 1);
-          rect.setLocation(j - r->left, i - r->top);
-          m_rects.push_back(rect);
-        } else {
-          ++m_rects.back().right;
-        }
-      }
-    }
-  }
-  
-  // Send header.
-  m_output->writeUInt32(static_cast<UINT32>(subrectPixelValue.size()));
-  m_output->writeFully(&backgroundPixelValue, sizeof(PIXEL_T));
-  
-  // Send subrectangles.
-  for (size_t i = 0; i < subrectPixelValue.size(); i++) {
-    m_output->writeFully(&subrectPixelValue[i], sizeof(PIXEL_T));
-    m_output->writeUInt16(m_rects[i].left);
-    m_output->writeUInt16(m_rects[i].top);
-    m_output->writeUInt16(m_rects[i].getWidth());
-    m_output->writeUInt16(m_rects[i].getHeight());
+  PIXEL_T backgroundPixelValue = pixels.getPixel(r->left, r->top) & mask;
+
+  findSubrects<PIXEL_T>(r, frameBuffer, backgroundPixelValue, mask);
+
+  // The whole rectangle goes to the stream by one write instead of five
+  // writes per subrectangle.
+  size_t numSubrects = m_rects.size();
+  size_t subrectSize = sizeof(PIXEL_T) + (m_compact ? 4 : 8);
+  m_buffer.resize(4 + sizeof(PIXEL_T) + numSubrects * subrectSize);
+
+  UINT8 *header = &m_buffer.front();
+  header[0] = (UINT8)(numSubrects >> 24);
+  header[1] = (UINT8)(numSubrects >> 16);
+  header[2] = (UINT8)(numSubrects >> 8);
+  header[3] = (UINT8)numSubrects;
+  memcpy(header + 4, &backgroundPixelValue, sizeof(PIXEL_T));
+
+  size_t pos = 4 + sizeof(PIXEL_T);
+  for (size_t i = 0; i < numSubrects; i++) {
+    PIXEL_T color = (PIXEL_T)m_colors[i];
+    memcpy(&m_buffer[pos], &color, sizeof(PIXEL_T));
+    pos += sizeof(PIXEL_T);
+    const Rect *subrect = &m_rects[i];
+    pos = putCoordinate(pos, subrect->left);
+    pos = putCoordinate(pos, subrect->top);
+    pos = putCoordinate(pos, subrect->getWidth());
+    pos = putCoordinate(pos, subrect->getHeight());
   }
+
+  m_output->writeFully(&m_buffer.front(), m_buffer.size());
 }
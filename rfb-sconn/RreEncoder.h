@@ -45,17 +45,51 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options) throw(IOException);
 
+  virtual size_t getScratchSize() const;
+  virtual void releaseScratch();
+
+protected:
+  // If `compact' is true, the subrectangles are sent in the CoRRE format,
+  // with 8-bit coordinates, instead of the RRE one.
+  RreEncoder(PixelConverter *conv, DataOutputStream *output, bool compact);
+
 private:
+  // Fills m_rects and m_colors with the subrectangles of the rectangle
+  // which differ from the background. Runs of equal pixels found in a row
+  // are merged with the runs of the same span and color in the row above,
+  // so the cost is linear in the number of pixels.
+  template <class PIXEL_T>
+    void findSubrects(const Rect *r,
+                      const FrameBuffer *frameBuffer,
+                      PIXEL_T background,
+                      PIXEL_T mask);
+
   template <class PIXEL_T>
     void rreEncode(const Rect *r,
                    const FrameBuffer *frameBuffer) throw(IOException);
 
-  // Coordinates of subrectangles.
+  // Writes a coordinate of a subrectangle to m_buffer at `pos' in the
+  // format chosen by m_compact and returns the position after it.
+  size_t putCoordinate(size_t pos, int value);
+
+  bool m_compact;
+
+  // Coordinates and colors of subrectangles.
   std::vector<Rect> m_rects;
-  
+  std::vector<UINT32> m_colors;
+
+  // Indices of the subrectangles which end at the previous row and at the
+  // current one, in the order of their x coordinates.
+  std::vector<size_t> m_prevRow;
+  std::vector<size_t> m_curRow;
+
+  // The encoded rectangle, sent by one write.
+  std::vector<UINT8> m_buffer;
+
   // All rectangles are devided (in splitRectangle() function)
   // into new rectangles with maximum size == 64.
   // Rect size == 64 for a better performance and less memory consumption.
+  // It also keeps the coordinates within the 8 bits of CoRRE.
   static const int RECT_SIZE = 64;
 };
 
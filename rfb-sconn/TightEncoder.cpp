@@ -23,14 +23,25 @@
 //
 
 #include "TightEncoder.h"
-
-#include "io-lib/ByteArrayOutputStream.h"
+#include "GradientFilter.h"
+#include "EncoderContextPool.h"
+#include "rfb/FrameBufferAccessor.h"
+#include "PixelRunScanner.h"
 
 TightEncoder::TightEncoder(PixelConverter *conv, DataOutputStream *output)
-: Encoder(conv, output)
+: Encoder(conv, output),
+  m_stateless(false),
+  m_solidAreaSearch(true),
+  m_compressor(0)
 {
   for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+    m_zsStruct[i] = 0;
     m_zsActive[i] = false;
+    m_zsStrategy[i] = Z_DEFAULT_STRATEGY;
+    m_zsNeedsReset[i] = false;
+  }
+  for (int i = 0; i < NUM_PATHS; i++) {
+    m_pathCounts[i] = 0;
   }
 }
 
@@ -38,9 +49,13 @@ TightEncoder::~TightEncoder()
 {
   for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
     if (m_zsActive[i]) {
-      deflateEnd(&m_zsStruct[i]);
+      EncoderContextPool::getInstance()->returnDeflateStream(m_zsStruct[i],
+                                                             m_zsLevel[i]);
     }
   }
+  if (m_compressor != 0) {
+    EncoderContextPool::getInstance()->returnJpegCompressor(m_compressor);
+  }
 }
 
 int TightEncoder::getCode() const
@@ -48,10 +63,312 @@ int TightEncoder::getCode() const
   return EncodingDefs::TIGHT;
 }
 
+bool TightEncoder::isStateless() const
+{
+  return m_stateless;
+}
+
+void TightEncoder::setStateless(bool stateless)
+{
+  if (m_stateless && !stateless) {
+    // The client may have received data compressed by other encoders into
+    // its zlib streams, so our streams are not in sync with it any more.
+    for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+      m_zsNeedsReset[i] = true;
+    }
+  }
+  m_stateless = stateless;
+}
+
+bool TightEncoder::restartStream()
+{
+  for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+    m_zsNeedsReset[i] = true;
+  }
+  return true;
+}
+
+size_t TightEncoder::getRectOverhead(const EncodeOptions *options) const
+{
+  if (options->jpegEnabled()) {
+    return 0;
+  }
+  return getConf(options).mergeOverhead;
+}
+
+size_t TightEncoder::getScratchSize() const
+{
+  size_t size = m_pixelData.capacity() + m_filteredData.capacity() +
+                m_gradientRows.capacity() * sizeof(int);
+  for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+    size += m_zsBuffer[i].capacity();
+  }
+  return size;
+}
+
+void TightEncoder::releaseScratch()
+{
+  for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+    std::vector<char>().swap(m_zsBuffer[i]);
+  }
+  std::vector<UINT8>().swap(m_pixelData);
+  std::vector<UINT8>().swap(m_filteredData);
+  std::vector<int>().swap(m_gradientRows);
+}
+
+UINT32 TightEncoder::getPathCount(int path) const
+{
+  return m_pathCounts[path];
+}
+
+void TightEncoder::setSolidAreaSearch(bool enabled)
+{
+  m_solidAreaSearch = enabled;
+}
+
+UINT32 TightEncoder::getTileCount(int tileClass) const
+{
+  return m_classifier.getTileCount(tileClass);
+}
+
+UINT32 TightEncoder::getPaletteHitCount() const
+{
+  return m_paletteCache.getHitCount();
+}
+
+UINT32 TightEncoder::getPaletteMissCount() const
+{
+  return m_paletteCache.getMissCount();
+}
+
+int TightEncoder::getStreamLevel(int streamId) const
+{
+  return m_zsTuner[streamId].getLevel();
+}
+
+int TightEncoder::getStreamStrategy(int streamId) const
+{
+  return m_zsTuner[streamId].getStrategy();
+}
+
+UINT32 TightEncoder::getStreamSwitchCount() const
+{
+  UINT32 count = 0;
+  for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+    count += m_zsTuner[i].getSwitchCount();
+  }
+  return count;
+}
+
 void TightEncoder::splitRectangle(const Rect *rect,
                                   std::vector<Rect> *rectList,
                                   const FrameBuffer *serverFb,
                                   const EncodeOptions *options)
+{
+  if (m_solidAreaSearch && rect->area() >= MIN_SOLID_SPLIT_SIZE) {
+    splitBySolidAreas(rect, rectList, serverFb, options);
+  } else {
+    splitByContent(rect, rectList, serverFb, options);
+  }
+}
+
+void TightEncoder::splitBySolidAreas(const Rect *rect,
+                                     std::vector<Rect> *rectList,
+                                     const FrameBuffer *serverFb,
+                                     const EncodeOptions *options)
+{
+  // The parts above, left and right of a solid area are done, the search
+  // goes on below it.
+  Rect rest = *rect;
+  Rect solid;
+  while (rest.area() >= MIN_SOLID_SPLIT_SIZE &&
+         findSolidArea(&rest, serverFb, &solid)) {
+    if (solid.top != rest.top) {
+      Rect above(rest.left, rest.top, rest.right, solid.top);
+      splitByContent(&above, rectList, serverFb, options);
+    }
+    if (solid.left != rest.left) {
+      Rect left(rest.left, solid.top, solid.left, solid.bottom);
+      splitByContent(&left, rectList, serverFb, options);
+    }
+    for (int x0 = solid.left; x0 < solid.right; x0 += MAX_FILL_RECT_WIDTH) {
+      int x1 = min(x0 + MAX_FILL_RECT_WIDTH, solid.right);
+      rectList->push_back(Rect(x0, solid.top, x1, solid.bottom));
+    }
+    if (solid.right != rest.right) {
+      Rect right(solid.right, solid.top, rest.right, solid.bottom);
+      splitByContent(&right, rectList, serverFb, options);
+    }
+    rest.top = solid.bottom;
+  }
+  if (!rest.isEmpty()) {
+    splitByContent(&rest, rectList, serverFb, options);
+  }
+}
+
+bool TightEncoder::findSolidArea(const Rect *rect, const FrameBuffer *fb,
+                                 Rect *solidRect)
+{
+  size_t pixelSize = fb->getBytesPerPixel();
+  for (int y = rect->top; y < rect->bottom; y += SOLID_TILE_SIZE) {
+    int y1 = min(y + SOLID_TILE_SIZE, rect->bottom);
+    for (int x = rect->left; x < rect->right; x += SOLID_TILE_SIZE) {
+      int x1 = min(x + SOLID_TILE_SIZE, rect->right);
+      UINT32 color = 0;
+      memcpy(&color, fb->getBufferPtr(x, y), pixelSize);
+      Rect tile(x, y, x1, y1);
+      if (!isSolidArea(&tile, fb, color)) {
+        continue;
+      }
+      Rect bounds(x, y, rect->right, rect->bottom);
+      Rect best;
+      findBestSolidArea(&bounds, fb, color, &best);
+      // A small area is not worth the extra rectangles around it.
+      if (!best.isEqualTo(rect) && best.area() < MIN_SOLID_AREA_SIZE) {
+        continue;
+      }
+      extendSolidArea(rect, fb, color, &best);
+      *solidRect = best;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TightEncoder::findBestSolidArea(const Rect *bounds, const FrameBuffer *fb,
+                                     UINT32 color, Rect *solidRect)
+{
+  // Every row of tiles is followed while it is solid as far as the previous
+  // one, the widest-by-tallest product wins.
+  *solidRect = Rect(bounds->left, bounds->top, bounds->left, bounds->top);
+  int right = bounds->right;
+  for (int y = bounds->top; y < bounds->bottom; y += SOLID_TILE_SIZE) {
+    int y1 = min(y + SOLID_TILE_SIZE, bounds->bottom);
+    int x = bounds->left;
+    while (x < right) {
+      int x1 = min(x + SOLID_TILE_SIZE, right);
+      Rect tile(x, y, x1, y1);
+      if (!isSolidArea(&tile, fb, color)) {
+        break;
+      }
+      x = x1;
+    }
+    if (x == bounds->left) {
+      break;
+    }
+    right = x;
+    Rect area(bounds->left, bounds->top, right, y1);
+    if (area.area() > solidRect->area()) {
+      *solidRect = area;
+    }
+  }
+}
+
+void TightEncoder::extendSolidArea(const Rect *bounds, const FrameBuffer *fb,
+                                   UINT32 color, Rect *solidRect)
+{
+  Rect line;
+  while (solidRect->top > bounds->top) {
+    line = Rect(solidRect->left, solidRect->top - 1,
+                solidRect->right, solidRect->top);
+    if (!isSolidArea(&line, fb, color)) {
+      break;
+    }
+    solidRect->top--;
+  }
+  while (solidRect->bottom < bounds->bottom) {
+    line = Rect(solidRect->left, solidRect->bottom,
+                solidRect->right, solidRect->bottom + 1);
+    if (!isSolidArea(&line, fb, color)) {
+      break;
+    }
+    solidRect->bottom++;
+  }
+  while (solidRect->left > bounds->left) {
+    line = Rect(solidRect->left - 1, solidRect->top,
+                solidRect->left, solidRect->bottom);
+    if (!isSolidArea(&line, fb, color)) {
+      break;
+    }
+    solidRect->left--;
+  }
+  while (solidRect->right < bounds->right) {
+    line = Rect(solidRect->right, solidRect->top,
+                solidRect->right + 1, solidRect->bottom);
+    if (!isSolidArea(&line, fb, color)) {
+      break;
+    }
+    solidRect->right++;
+  }
+}
+
+bool TightEncoder::isSolidArea(const Rect *rect, const FrameBuffer *fb,
+                               UINT32 color)
+{
+  size_t pixelSize = fb->getBytesPerPixel();
+  size_t width = (size_t)rect->getWidth();
+  for (int y = rect->top; y < rect->bottom; y++) {
+    const void *row = fb->getBufferPtr(rect->left, y);
+    if (memcmp(row, &color, pixelSize) != 0 ||
+        PixelRunScanner::getRunLength(row, width, pixelSize) != width) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TightEncoder::splitByContent(const Rect *rect,
+                                  std::vector<Rect> *rectList,
+                                  const FrameBuffer *serverFb,
+                                  const EncodeOptions *options)
+{
+  // Content classification matters only if JPEG may be used.
+  bool classify = options->jpegEnabled() &&
+                  serverFb->getBitsPerPixel() >= 16 &&
+                  m_pixelConverter->getDstBitsPerPixel() >= 16;
+  if (!classify) {
+    splitBySize(rect, rectList, options);
+    return;
+  }
+
+  std::vector<Rect> sizedRects;
+  splitBySize(rect, &sizedRects, options);
+
+  if (m_rectClasses.size() > MAX_RECT_CLASSES) {
+    m_rectClasses.clear();
+  }
+  for (size_t i = 0; i < sizedRects.size(); i++) {
+    m_classifiedRects.clear();
+    m_classes.clear();
+    m_classifier.classify(&sizedRects[i], serverFb,
+                          &m_classifiedRects, &m_classes);
+    for (size_t j = 0; j < m_classifiedRects.size(); j++) {
+      const Rect *r = &m_classifiedRects[j];
+      rectList->push_back(*r);
+      m_rectClasses[std::make_pair(r->left, r->top)] =
+        std::make_pair(*r, m_classes[j]);
+    }
+  }
+}
+
+int TightEncoder::takeRectClass(const Rect *rect)
+{
+  std::map<std::pair<int, int>, std::pair<Rect, int> >::iterator it =
+    m_rectClasses.find(std::make_pair(rect->left, rect->top));
+  if (it == m_rectClasses.end()) {
+    return -1;
+  }
+  int rectClass = -1;
+  if (it->second.first.isEqualTo(rect)) {
+    rectClass = it->second.second;
+  }
+  m_rectClasses.erase(it);
+  return rectClass;
+}
+
+void TightEncoder::splitBySize(const Rect *rect,
+                               std::vector<Rect> *rectList,
+                               const EncodeOptions *options)
 {
   int maxSize = getConf(options).maxRectSize;
   int rectWidth = rect->getWidth();
@@ -127,22 +444,49 @@ void TightEncoder::sendAnyRect(const Rect *rect,
   // Fill in the palette (m_pal).
   fillPalette<PIXEL_T>(rect, clientFb, maxColors);
 
+  bool jpegAllowed = sizeof(PIXEL_T) > 1 &&
+                     options->jpegEnabled() &&
+                     serverFb->getBitsPerPixel() >= 16 &&
+                     rect->area() >= JPEG_MIN_RECT_SIZE &&
+                     rect->getWidth() >= JPEG_MIN_RECT_WIDTH &&
+                     rect->getHeight() >= JPEG_MIN_RECT_HEIGHT;
+
+  // Photo-like parts go to JPEG even if their colors fit the palette, text
+  // and UI parts are never sent with JPEG. Rectangles of unknown class use
+  // JPEG only when there are too many colors for the palette.
+  int rectClass = takeRectClass(rect);
+  bool preferJpeg = rectClass == TileClassifier::TILE_PHOTO ||
+                    rectClass == TileClassifier::TILE_STATIC;
+  if (rectClass == TileClassifier::TILE_TEXT) {
+    jpegAllowed = false;
+  }
+
   // If that was a solid-color rectangle, sent it.
   int numColors = m_pal.getNumColors();
   if (numColors == 1) {
+    m_pathCounts[PATH_SOLID]++;
     sendSolidRect(rect, clientFb);
+  } else if (jpegAllowed && preferJpeg) {
+    m_pathCounts[PATH_JPEG]++;
+    sendJpegRect(rect, serverFb, options,
+                 rectClass == TileClassifier::TILE_STATIC ?
+                 STATIC_JPEG_QUALITY_BOOST : 0);
   } else if (numColors == 2) {
+    m_pathCounts[PATH_MONO]++;
     sendMonoRect<PIXEL_T>(rect, clientFb, options);
   } else if (sizeof(PIXEL_T) > 1 && numColors != 0) {
+    m_pathCounts[PATH_INDEXED]++;
     sendIndexedRect<PIXEL_T>(rect, clientFb, options);
-  } else if (sizeof(PIXEL_T) > 1 &&
-             options->jpegEnabled() &&
-             serverFb->getBitsPerPixel() >= 16 &&
-             rect->area() >= JPEG_MIN_RECT_SIZE &&
-             rect->getWidth() >= JPEG_MIN_RECT_WIDTH &&
-             rect->getHeight() >= JPEG_MIN_RECT_HEIGHT) {
+  } else if (jpegAllowed) {
+    m_pathCounts[PATH_JPEG]++;
     sendJpegRect(rect, serverFb, options);
+  } else if (sizeof(PIXEL_T) > 1 &&
+             isSmoothImage<PIXEL_T>(rect, clientFb,
+                                    getConf(options).gradientThreshold)) {
+    m_pathCounts[PATH_GRADIENT]++;
+    sendGradientRect<PIXEL_T>(rect, clientFb, options);
   } else {
+    m_pathCounts[PATH_FULL_COLOR]++;
     sendFullColorRect<PIXEL_T>(rect, clientFb, options);
   }
 }
@@ -172,16 +516,15 @@ void TightEncoder::sendMonoRect(const Rect *rect,
 {
   // Send control info.
   const int zlibStreamId = ZLIB_STREAM_MONO;
-  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4);
+  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4 |
+                       resetStreamIfNeeded(zlibStreamId));
   m_output->writeUInt8(FILTER_PALETTE);
   m_output->writeUInt8(1); // the number of colors minus 1
 
   // Prepare output buffer.
   int dataLen = (rect->getWidth() + 7) / 8;
   dataLen *= rect->getHeight();
-  // FIXME: Optimize, use char[] instead of ByteArrayOutputStream.
-  ByteArrayOutputStream encoded(dataLen);
-  DataOutputStream encodedData(&encoded);
+  m_pixelData.resize(dataLen);
 
   // Send the palette.
   PIXEL_T palette[2] = {
@@ -197,12 +540,13 @@ void TightEncoder::sendMonoRect(const Rect *rect,
   m_output->writeFully(palette, pixelSize * 2);
 
   // Convert image to indexed colors.
-  encodeMonoRect<PIXEL_T>(rect, fb, &encodedData);
-  _ASSERT(encoded.size() == dataLen);
+  UINT8 *end = encodeMonoRect<PIXEL_T>(rect, fb, &m_pixelData.front());
+  _ASSERT(end - &m_pixelData.front() == dataLen);
 
   // Compress and send.
   int zlibLevel = getConf(options).monoZlibLevel;
-  sendCompressed(encoded.toByteArray(), dataLen, zlibStreamId, zlibLevel);
+  sendCompressed((const char *)&m_pixelData.front(), dataLen,
+                 zlibStreamId, zlibLevel);
 }
 
 template <class PIXEL_T>
@@ -212,16 +556,15 @@ void TightEncoder::sendIndexedRect(const Rect *rect,
 {
   // Send control info.
   const int zlibStreamId = ZLIB_STREAM_IDX;
-  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4);
+  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4 |
+                       resetStreamIfNeeded(zlibStreamId));
   m_output->writeUInt8(FILTER_PALETTE);
   int numColors = m_pal.getNumColors();
   m_output->writeUInt8((UINT8)(numColors - 1));
 
   // Prepare output buffer.
   int dataLen = rect->getWidth() * rect->getHeight();
-  // FIXME: Optimize, use char[] instead of ByteArrayOutputStream.
-  ByteArrayOutputStream encoded(dataLen);
-  DataOutputStream encodedData(&encoded);
+  m_pixelData.resize(dataLen);
 
   // Send the palette.
   PIXEL_T palette[256];
@@ -237,12 +580,13 @@ void TightEncoder::sendIndexedRect(const Rect *rect,
   m_output->writeFully(palette, pixelSize * numColors);
 
   // Convert image to indexed colors.
-  encodeIndexedRect<PIXEL_T>(rect, fb, &encodedData);
-  _ASSERT(encoded.size() == dataLen);
+  UINT8 *end = encodeIndexedRect<PIXEL_T>(rect, fb, &m_pixelData.front());
+  _ASSERT(end - &m_pixelData.front() == dataLen);
 
   // Compress and send.
   int zlibLevel = getConf(options).idxZlibLevel;
-  sendCompressed(encoded.toByteArray(), dataLen, zlibStreamId, zlibLevel);
+  sendCompressed((const char *)&m_pixelData.front(), dataLen,
+                 zlibStreamId, zlibLevel);
 }
 
 template <class PIXEL_T>
@@ -252,42 +596,81 @@ void TightEncoder::sendFullColorRect(const Rect *rect,
 {
   // Send control info.
   const int zlibStreamId = ZLIB_STREAM_RAW;
-  m_output->writeUInt8(zlibStreamId << 4);
+  m_output->writeUInt8(zlibStreamId << 4 | resetStreamIfNeeded(zlibStreamId));
 
   // Prepare output buffer.
-  int dataLen = rect->area() * sizeof(PIXEL_T);
-  // FIXME: Use char[] instead?
-  std::vector<UINT8> rgbData(dataLen);
+  size_t dataLen = rect->area() * sizeof(PIXEL_T);
+  m_pixelData.resize(dataLen);
 
   // Get pixels from the frame buffer.
-  copyPixels<PIXEL_T>(rect, fb, &rgbData.front());
-  _ASSERT(rgbData.size() == dataLen);
+  copyPixels<PIXEL_T>(rect, fb, &m_pixelData.front());
 
   // Pack pixels into 24-bit samples if necessary.
   PixelFormat pf = fb->getPixelFormat();
   if (shouldPackPixels(&pf)) {
-    packPixels(&rgbData.front(), rect->area(), &pf);
-    rgbData.resize(rect->area() * 3);
+    packPixels(&m_pixelData.front(), rect->area(), &pf);
+    dataLen = rect->area() * 3;
   }
 
   // Compress and send.
   int zlibLevel = getConf(options).rawZlibLevel;
   // FIXME: Get rid of explicit conversions between chars and bytes.
-  sendCompressed((const char *)&rgbData.front(), rgbData.size(),
+  sendCompressed((const char *)&m_pixelData.front(), dataLen,
+                 zlibStreamId, zlibLevel);
+}
+
+template <class PIXEL_T>
+void TightEncoder::sendGradientRect(const Rect *rect,
+                                    const FrameBuffer *fb,
+                                    const EncodeOptions *options)
+{
+  // Send control info.
+  const int zlibStreamId = ZLIB_STREAM_GRADIENT;
+  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4 |
+                       resetStreamIfNeeded(zlibStreamId));
+  m_output->writeUInt8(FILTER_GRADIENT);
+
+  // Filter the pixels. Packed samples have 8-bit color components, so they
+  // are filtered byte by byte.
+  size_t dataLen;
+  PixelFormat pf = fb->getPixelFormat();
+  if (shouldPackPixels(&pf)) {
+    m_pixelData.resize(rect->area() * sizeof(PIXEL_T));
+    copyPixels<PIXEL_T>(rect, fb, &m_pixelData.front());
+    packPixels(&m_pixelData.front(), rect->area(), &pf);
+    dataLen = rect->area() * 3;
+    m_filteredData.resize(dataLen);
+    GradientFilter::filter24(&m_pixelData.front(), &m_filteredData.front(),
+                             rect->getWidth(), rect->getHeight());
+  } else {
+    dataLen = rect->area() * sizeof(PIXEL_T);
+    m_filteredData.resize(dataLen);
+    filterGradient<PIXEL_T>(rect, fb, (PIXEL_T *)&m_filteredData.front());
+  }
+
+  // Compress and send.
+  int zlibLevel = getConf(options).rawZlibLevel;
+  sendCompressed((const char *)&m_filteredData.front(), dataLen,
                  zlibStreamId, zlibLevel);
 }
 
 void TightEncoder::sendJpegRect(const Rect *rect,
                                 const FrameBuffer *serverFb,
-                                const EncodeOptions *options)
+                                const EncodeOptions *options,
+                                int qualityBoost)
 {
   _ASSERT(options->jpegEnabled());
 
   // Set proper JPEG quality level in the compressor. The default value 6
   // below does not mean anything, it will not be used because we assume
   // valid JPEG quality level was set in the options object.
-  int quality = options->getJpegQualityLevel(6);
-  m_compressor.setQuality(quality * 10 + 5);
+  int quality = min(options->getJpegQualityLevel(6) + qualityBoost, 9);
+  if (m_compressor == 0) {
+    m_compressor = EncoderContextPool::getInstance()->leaseJpegCompressor();
+  }
+  m_compressor->setQuality(quality * 10 + 5);
+  m_compressor->setSubsampling(
+    options->getJpegSubsampling(JpegCompressor::SUBSAMPLING_420));
 
   // Shortcuts.
   const void *ptr = serverFb->getBufferPtr(rect->left, rect->top);
@@ -297,13 +680,13 @@ void TightEncoder::sendJpegRect(const Rect *rect,
   int stride = serverFb->getBytesPerRow();
 
   // Compress pixels.
-  m_compressor.compress(ptr, &fmt, width, height, stride);
-  size_t dataLength = m_compressor.getOutputLength();
+  m_compressor->compress(ptr, &fmt, width, height, stride);
+  size_t dataLength = m_compressor->getOutputLength();
 
   // Actually send the encoded data.
   m_output->writeUInt8(SUBENCODING_JPEG);
   sendCompactLength(dataLength);
-  m_output->writeFully(m_compressor.getOutputData(), dataLength);
+  m_output->writeFully(m_compressor->getOutputData(), dataLength);
 }
 
 //--------------------------------------------------------------------------//
@@ -318,12 +701,25 @@ bool TightEncoder::shouldPackPixels(const PixelFormat *pf) const
 }
 
 void TightEncoder::packPixels(UINT8 *buf, int count, const PixelFormat *pf)
+{
+  if (pf->bigEndian) {
+    packPixelsT<true>(buf, count, pf);
+  } else {
+    packPixelsT<false>(buf, count, pf);
+  }
+}
+
+template <bool BIG_ENDIAN_T>
+void TightEncoder::packPixelsT(UINT8 *buf, int count, const PixelFormat *pf)
 {
   UINT8 *dst = buf;
   UINT32 pix;
+  const int redShift = pf->redShift;
+  const int greenShift = pf->greenShift;
+  const int blueShift = pf->blueShift;
 
   while (count--) {
-    if (!pf->bigEndian) {
+    if (!BIG_ENDIAN_T) {
       pix = (UINT32)buf[3] << 24 |
             (UINT32)buf[2] << 16 |
             (UINT32)buf[1] << 8 |
@@ -335,9 +731,93 @@ void TightEncoder::packPixels(UINT8 *buf, int count, const PixelFormat *pf)
             (UINT32)buf[3];
     }
     buf += 4;
-    *dst++ = (UINT8)(pix >> pf->redShift);
-    *dst++ = (UINT8)(pix >> pf->greenShift);
-    *dst++ = (UINT8)(pix >> pf->blueShift);
+    *dst++ = (UINT8)(pix >> redShift);
+    *dst++ = (UINT8)(pix >> greenShift);
+    *dst++ = (UINT8)(pix >> blueShift);
+  }
+}
+
+template <class PIXEL_T>
+bool TightEncoder::isSmoothImage(const Rect *rect, const FrameBuffer *fb,
+                                 int threshold) const
+{
+  // The components of big endian pixels can't be taken with shifts on our
+  // side, don't bother with such clients.
+  PixelFormat pf = fb->getPixelFormat();
+  if (threshold <= 0 || pf.bigEndian ||
+      rect->area() < GRADIENT_MIN_RECT_SIZE ||
+      rect->getWidth() < 2 || rect->getHeight() < 2) {
+    return false;
+  }
+
+  const int max[3] = { pf.redMax, pf.greenMax, pf.blueMax };
+  const int shift[3] = { pf.redShift, pf.greenShift, pf.blueShift };
+  const FrameBufferAccessor<PIXEL_T> pixels(fb);
+  const int stride = pixels.getStride();
+
+  UINT32 errorSum = 0;
+  UINT32 numSamples = 0;
+  for (int y = rect->top + 1; y < rect->bottom; y += GRADIENT_SAMPLE_STEP) {
+    const PIXEL_T *row = pixels.getRow(y);
+    const PIXEL_T *upperRow = row - stride;
+    for (int x = rect->left + 1; x < rect->right; x += GRADIENT_SAMPLE_STEP) {
+      for (int c = 0; c < 3; c++) {
+        int value = row[x] >> shift[c] & max[c];
+        int prediction = (row[x - 1] >> shift[c] & max[c]) +
+                         (upperRow[x] >> shift[c] & max[c]) -
+                         (upperRow[x - 1] >> shift[c] & max[c]);
+        prediction = prediction < 0 ? 0 :
+                     prediction > max[c] ? max[c] : prediction;
+        int error = value > prediction ? value - prediction :
+                                         prediction - value;
+        errorSum += error * 256 / (max[c] + 1);
+      }
+      numSamples += 3;
+    }
+  }
+  return errorSum < (UINT32)threshold * numSamples;
+}
+
+template <class PIXEL_T>
+void TightEncoder::filterGradient(const Rect *rect, const FrameBuffer *fb,
+                                  PIXEL_T *dst)
+{
+  PixelFormat pf = fb->getPixelFormat();
+  const int max[3] = { pf.redMax, pf.greenMax, pf.blueMax };
+  const int shift[3] = { pf.redShift, pf.greenShift, pf.blueShift };
+
+  const int width = rect->getWidth();
+  const int height = rect->getHeight();
+  const FrameBufferAccessor<PIXEL_T> pixels(fb);
+  const PIXEL_T *src = pixels.getPtr(rect->left, rect->top);
+  const int fbStride = pixels.getStride();
+
+  // The components of the previous and the current rows, each preceded by
+  // a zero pixel, so that the first column needs no special care.
+  const size_t rowLength = (width + 1) * 3;
+  m_gradientRows.assign(rowLength * 2, 0);
+  int *prevRow = &m_gradientRows[0];
+  int *thisRow = &m_gradientRows[rowLength];
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const int j = (x + 1) * 3;
+      PIXEL_T diff = 0;
+      for (int c = 0; c < 3; c++) {
+        int value = src[x] >> shift[c] & max[c];
+        int prediction = thisRow[j + c - 3] + prevRow[j + c] -
+                         prevRow[j + c - 3];
+        prediction = prediction < 0 ? 0 :
+                     prediction > max[c] ? max[c] : prediction;
+        thisRow[j + c] = value;
+        diff |= (PIXEL_T)(((value - prediction) & max[c]) << shift[c]);
+      }
+      *dst++ = diff;
+    }
+    int *swap = prevRow;
+    prevRow = thisRow;
+    thisRow = swap;
+    src += fbStride;
   }
 }
 
@@ -349,10 +829,19 @@ void TightEncoder::fillPalette(const Rect *r, const FrameBuffer *fb, int maxColo
   m_pal.setMaxColors(maxColors);
 
   // Shortcuts.
-  const PIXEL_T *pixels = (const PIXEL_T *)fb->getBuffer();
-  int stride = fb->getDimension().width;
+  const FrameBufferAccessor<PIXEL_T> accessor(fb);
+  const PIXEL_T *pixels = accessor.getRow(0);
+  int stride = accessor.getStride();
+
+  // Palettes of UI and text parts recur, try the recent ones first.
+  if (m_paletteCache.fill(&m_pal, r, pixels, stride)) {
+    return;
+  }
+
+  // The run starts with the first pixel, so that no phantom color of zero
+  // pixels gets into the palette.
   UINT32 pixel = pixels[r->top * stride + r->left];
-  UINT32 oldPixel = 0;
+  UINT32 oldPixel = pixel;
   UINT32 runLength = 0;
 
   for (int y = r->top; y < r->bottom; y++) {
@@ -371,8 +860,9 @@ void TightEncoder::fillPalette(const Rect *r, const FrameBuffer *fb, int maxColo
     }
   }
   if (m_pal.insert(oldPixel, runLength) == 0) {
-			return;
-	}
+    return;
+  }
+  m_paletteCache.store(&m_pal);
 }
 
 template <class PIXEL_T>
@@ -382,8 +872,9 @@ void TightEncoder::copyPixels(const Rect *rect, const FrameBuffer *fb,
   const int rectWidth = rect->getWidth();
   const int rectHeight = rect->getHeight();
 
-  const PIXEL_T *src = (const PIXEL_T *)fb->getBufferPtr(rect->left, rect->top);
-  const int fbStride = fb->getDimension().width;
+  const FrameBufferAccessor<PIXEL_T> pixels(fb);
+  const PIXEL_T *src = pixels.getPtr(rect->left, rect->top);
+  const int fbStride = pixels.getStride();
   const int bytesPerRow = rectWidth * sizeof(PIXEL_T);
 
   for (int y = 0; y < rectHeight; y++) {
@@ -394,10 +885,11 @@ void TightEncoder::copyPixels(const Rect *rect, const FrameBuffer *fb,
 }
 
 template <class PIXEL_T>
-void TightEncoder::encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
-                                  DataOutputStream *out)
+UINT8 *TightEncoder::encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
+                                    UINT8 *dst)
 {
-  const PIXEL_T *src = (const PIXEL_T *)fb->getBufferPtr(rect->left, rect->top);
+  const FrameBufferAccessor<PIXEL_T> pixels(fb);
+  const PIXEL_T *src = pixels.getPtr(rect->left, rect->top);
   const int w = rect->getWidth();
   const int h = rect->getHeight();
   const PIXEL_T bg = (PIXEL_T)m_pal.getEntry(0);
@@ -405,7 +897,7 @@ void TightEncoder::encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
   unsigned int value, mask;
   int x, y, bits;
   const int alignedWidth = w - w % 8;
-  const int skipPixels = fb->getDimension().width - w;
+  const int skipPixels = pixels.getStride() - w;
 
   for (y = 0; y < h; y++) {
     for (x = 0; x < alignedWidth; x += 8) {
@@ -414,7 +906,7 @@ void TightEncoder::encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
           break;
       }
       if (bits == 8) {
-        out->writeUInt8(0);
+        *dst++ = 0;
         continue;
       }
       mask = 0x80 >> bits;
@@ -425,7 +917,7 @@ void TightEncoder::encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
           value |= mask;
         }
       }
-      out->writeUInt8((UINT8)value);
+      *dst++ = (UINT8)value;
     }
     if (x < w) {
       mask = 0x80;
@@ -436,20 +928,22 @@ void TightEncoder::encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
         }
         mask >>= 1;
       } while (++x < w);
-      out->writeUInt8((UINT8)value);
+      *dst++ = (UINT8)value;
     }
     src += skipPixels;
   }
+  return dst;
 }
 
 template <class PIXEL_T>
-void TightEncoder::encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
-                                     DataOutputStream *out)
+UINT8 *TightEncoder::encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
+                                       UINT8 *dst)
 {
-  const PIXEL_T *src = (const PIXEL_T *)fb->getBufferPtr(rect->left, rect->top);
+  const FrameBufferAccessor<PIXEL_T> pixels(fb);
+  const PIXEL_T *src = pixels.getPtr(rect->left, rect->top);
   const int w = rect->getWidth();
   const int h = rect->getHeight();
-  const int skipPixels = fb->getDimension().width - w;
+  const int skipPixels = pixels.getStride() - w;
 
   UINT8 index = m_pal.getIndex(*src);
   PIXEL_T oldColor = 0;
@@ -459,11 +953,27 @@ void TightEncoder::encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
         index = m_pal.getIndex(*src);
         oldColor = *src;
       }
-      *src++;
-      out->writeUInt8(index);
+      src++;
+      *dst++ = index;
     }
     src += skipPixels;
   }
+  return dst;
+}
+
+UINT8 TightEncoder::resetStreamIfNeeded(int streamId)
+{
+  if (!m_stateless && !m_zsNeedsReset[streamId]) {
+    return 0;
+  }
+  m_zsNeedsReset[streamId] = false;
+
+  if (m_zsActive[streamId]) {
+    if (deflateReset(m_zsStruct[streamId]) != Z_OK) {
+      throw IOException(_T("Error resetting Zlib stream in Tight encoder"));
+    }
+  }
+  return (UINT8)(1 << streamId);
 }
 
 void TightEncoder::sendCompressed(const char *data, size_t dataLen,
@@ -474,28 +984,40 @@ void TightEncoder::sendCompressed(const char *data, size_t dataLen,
     return;
   }
 
-  z_streamp pz = &m_zsStruct[streamId];
-
-  // Initialize compression stream if needed.
+  // Lease an initialized compression stream if needed. Its level is
+  // changed below if it differs.
   if (!m_zsActive[streamId]) {
-    pz->zalloc = Z_NULL;
-    pz->zfree = Z_NULL;
-    pz->opaque = Z_NULL;
-
-    int err = deflateInit2(pz, zlibLevel, Z_DEFLATED, MAX_WBITS,
-                           MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    m_zsStruct[streamId] =
+      EncoderContextPool::getInstance()->leaseDeflateStream(&m_zsLevel[streamId]);
+    m_zsStrategy[streamId] = Z_DEFAULT_STRATEGY;
+    m_zsActive[streamId] = true;
+  }
+  z_streamp pz = m_zsStruct[streamId];
+
+  // Change compression parameters if needed. The previous data has been
+  // flushed and the new one is not given yet, so the switch emits nothing.
+  int strategy;
+  m_zsTuner[streamId].choose(zlibLevel, &zlibLevel, &strategy);
+  if (zlibLevel != m_zsLevel[streamId] || strategy != m_zsStrategy[streamId]) {
+    pz->next_in = Z_NULL;
+    pz->avail_in = 0;
+    int err = deflateParams(pz, zlibLevel, strategy);
     if (err != Z_OK) {
-      throw IOException(_T("Zlib stream initialization failed in Tight encoder"));
+      throw IOException(_T("Error configuring Zlib stream in Tight encoder"));
     }
-
-    m_zsActive[streamId] = true;
     m_zsLevel[streamId] = zlibLevel;
+    m_zsStrategy[streamId] = strategy;
   }
 
-  // Prepare buffers.
+  // Prepare buffers. Each stream keeps its own output buffer which only
+  // grows up to the size needed by the largest rectangle seen so far.
   size_t compressedBufferSize = dataLen + dataLen / 100 + 16;
 
-  std::vector<char> charBuff(compressedBufferSize);
+  std::vector<char> &charBuff = m_zsBuffer[streamId];
+  if (charBuff.size() < compressedBufferSize) {
+    charBuff.resize(compressedBufferSize);
+  }
+  compressedBufferSize = charBuff.size();
   char *compressedData = &charBuff.front();
 
   _ASSERT((unsigned int)dataLen == dataLen);
@@ -505,23 +1027,19 @@ void TightEncoder::sendCompressed(const char *data, size_t dataLen,
   pz->next_out = (Bytef *)compressedData;
   pz->avail_out = (unsigned int)compressedBufferSize;
 
-  // Change compression parameters if needed.
-  if (zlibLevel != m_zsLevel[streamId]) {
-    int err = deflateParams(pz, zlibLevel, Z_DEFAULT_STRATEGY);
-    if (err != Z_OK) {
-      throw IOException(_T("Error configuring Zlib stream in Tight encoder"));
-    }
-    m_zsLevel[streamId] = zlibLevel;
-  }
-
   // Actual compression.
+  LARGE_INTEGER start, stop;
+  QueryPerformanceCounter(&start);
   int err = deflate(pz, Z_SYNC_FLUSH);
+  QueryPerformanceCounter(&stop);
   if (err != Z_OK || pz->avail_in != 0 || pz->avail_out == 0) {
       throw IOException(_T("Zlib compression failed in Tight encoder"));
   }
+  size_t compressedLength = compressedBufferSize - pz->avail_out;
+  m_zsTuner[streamId].onCompressed(dataLen, compressedLength,
+                                   stop.QuadPart - start.QuadPart);
 
   try {
-    size_t compressedLength = compressedBufferSize - pz->avail_out;
     sendCompactLength(compressedLength);
     m_output->writeFully(compressedData, compressedLength);
   } catch (...) {
@@ -555,16 +1073,16 @@ void TightEncoder::sendCompactLength(size_t dataLen)
 //        detect areas to be compressed with JPEG yet and thus we would like
 //        to divide areas to avoid compressing too much with JPEG.
 const TightEncoder::Conf TightEncoder::m_conf[10] = {
-  {   512,   32,   6, 0, 0, 0,  4 },
-  {  2048,   64,   6, 1, 1, 1,  8 },
-  {  6144,  128,   8, 3, 3, 2, 24 },
-  {  8192,  128,  12, 5, 5, 3, 32 },
-  {  8192,  128,  12, 6, 6, 4, 32 },
-  {  8192,  128,  12, 7, 7, 5, 32 },
-  {  8192,  128,  16, 7, 7, 6, 48 },
-  { 16384,  256,  16, 8, 8, 7, 64 },
-  { 16384,  256,  32, 9, 9, 8, 64 },
-  { 32768,  256,  32, 9, 9, 9, 96 }
+  {   512,   32,   6, 0, 0, 0,  4,  0,  32 },
+  {  2048,   64,   6, 1, 1, 1,  8,  0,  64 },
+  {  6144,  128,   8, 3, 3, 2, 24,  6,  96 },
+  {  8192,  128,  12, 5, 5, 3, 32,  8, 128 },
+  {  8192,  128,  12, 6, 6, 4, 32, 10, 192 },
+  {  8192,  128,  12, 7, 7, 5, 32, 12, 192 },
+  {  8192,  128,  16, 7, 7, 6, 48, 14, 192 },
+  { 16384,  256,  16, 8, 8, 7, 64, 16, 256 },
+  { 16384,  256,  32, 9, 9, 8, 64, 18, 256 },
+  { 32768,  256,  32, 9, 9, 9, 96, 20, 384 }
 };
 
 const TightEncoder::Conf &
@@ -30,7 +30,12 @@
 
 #include "Encoder.h"
 #include "TightPalette.h"
+#include "PaletteCache.h"
+#include "TileClassifier.h"
 #include "JpegCompressor.h"
+#include "DeflateTuner.h"
+
+#include <map>
 
 class TightEncoder : public Encoder
 {
@@ -43,7 +48,12 @@ public:
   virtual int getCode() const;
 
   // Splits big rectangles according to the configuration setings (m_conf)
-  // corresponding to the compression level set in EncodeOptions.
+  // corresponding to the compression level set in EncodeOptions. If JPEG is
+  // enabled, the rectangles are split further into parts of the same tile
+  // class (see TileClassifier), and sendRectangle() later chooses lossless
+  // or JPEG compression for each part by its class. Large single-color
+  // areas are cut out first to be sent as fills, unless the solid area
+  // search is off (see setSolidAreaSearch()).
   virtual void splitRectangle(const Rect *rect,
                               std::vector<Rect> *rectList,
                               const FrameBuffer *serverFb,
@@ -53,7 +63,105 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options) throw(IOException);
 
+  // In the stateless mode, each rectangle compressed with zlib resets its
+  // zlib stream (using the stream reset bits of the compression control
+  // byte), so that encoded rectangles do not depend on each other and can be
+  // shared between clients. Compression is less efficient in this mode.
+  virtual bool isStateless() const;
+  virtual void setStateless(bool stateless);
+
+  // Resets all the zlib streams with their next use.
+  virtual bool restartStream();
+
+  // Unchanged pixels cost little in palette and zlib data, so the
+  // rectangles are merged by the level of the configuration table, unless
+  // JPEG may be used.
+  virtual size_t getRectOverhead(const EncodeOptions *options) const;
+
+  // The zlib output buffers and the pixel data of the largest rectangle.
+  virtual size_t getScratchSize() const;
+  virtual void releaseScratch();
+
+  // Subencoding paths chosen by sendRectangle(), for statistics.
+  static const int PATH_SOLID = 0;
+  static const int PATH_MONO = 1;
+  static const int PATH_INDEXED = 2;
+  static const int PATH_FULL_COLOR = 3;
+  static const int PATH_JPEG = 4;
+  static const int PATH_GRADIENT = 5;
+  static const int NUM_PATHS = 6;
+
+  // Return the number of rectangles sent with the specified path.
+  UINT32 getPathCount(int path) const;
+
+  // Turns the search for single-color areas in splitRectangle() on or off.
+  // With it off, the rectangles are cut by the size limits only, as a
+  // fallback. It is on by default.
+  void setSolidAreaSearch(bool enabled);
+
+  // Return the number of tiles classified as tileClass (see TileClassifier).
+  UINT32 getTileCount(int tileClass) const;
+
+  // Return the number of palettes taken from and not found in the palette
+  // cache (see PaletteCache).
+  UINT32 getPaletteHitCount() const;
+  UINT32 getPaletteMissCount() const;
+
+  // Return the zlib level and strategy chosen for a stream (see
+  // DeflateTuner), and the number of times the choices have changed.
+  int getStreamLevel(int streamId) const;
+  int getStreamStrategy(int streamId) const;
+  UINT32 getStreamSwitchCount() const;
+
+  // Indexes of individual zlib streams.
+  static const int ZLIB_STREAM_RAW = 0;
+  static const int ZLIB_STREAM_MONO = 1;
+  static const int ZLIB_STREAM_IDX = 2;
+  static const int ZLIB_STREAM_GRADIENT = 3;
+
 protected:
+  // Split rect by the size limits of the configuration table.
+  void splitBySize(const Rect *rect, std::vector<Rect> *rectList,
+                   const EncodeOptions *options);
+
+  // Split rect by size and, if JPEG may be used, by the tile classes.
+  void splitByContent(const Rect *rect, std::vector<Rect> *rectList,
+                      const FrameBuffer *serverFb,
+                      const EncodeOptions *options);
+
+  // Cut the single-color areas of at least MIN_SOLID_AREA_SIZE pixels out
+  // of rect, the rest is split by splitByContent().
+  void splitBySolidAreas(const Rect *rect, std::vector<Rect> *rectList,
+                         const FrameBuffer *serverFb,
+                         const EncodeOptions *options);
+
+  // Find the first SOLID_TILE_SIZE tile of rect, in the row order, that
+  // starts a single-color area big enough to be sent apart and return the
+  // area, extended to its maximum, in solidRect. Returns false if there is
+  // no such area.
+  static bool findSolidArea(const Rect *rect, const FrameBuffer *fb,
+                            Rect *solidRect);
+
+  // Find the biggest single-color area of the color going right and down
+  // from the top-left corner of the bounds, tile by tile.
+  static void findBestSolidArea(const Rect *bounds, const FrameBuffer *fb,
+                                UINT32 color, Rect *solidRect);
+
+  // Grow the area up, down, left and right within the bounds while it
+  // stays of the same color.
+  static void extendSolidArea(const Rect *bounds, const FrameBuffer *fb,
+                              UINT32 color, Rect *solidRect);
+
+  // Return true if all pixels of rect are of the color, which holds the
+  // pixel bytes of the frame buffer in the memory order.
+  static bool isSolidArea(const Rect *rect, const FrameBuffer *fb,
+                          UINT32 color);
+
+  // Find the tile class remembered by splitRectangle() for the rectangle
+  // and forget it. Returns -1 if the rectangle is unknown (e.g. it was
+  // split by another encoder).
+  int takeRectClass(const Rect *rect);
+
   // An implementation of sendRectangle() for the given pixel size.
   template <class PIXEL_T>
     void sendAnyRect(const Rect *rect,
@@ -82,10 +190,18 @@ protected:
                            const FrameBuffer *fb,
                            const EncodeOptions *options) throw(IOException);
 
-  // Send a rectangle encoded with JPEG.
+  // Send a true color rectangle pre-processed with the "gradient" filter.
+  template <class PIXEL_T>
+    void sendGradientRect(const Rect *rect,
+                          const FrameBuffer *fb,
+                          const EncodeOptions *options) throw(IOException);
+
+  // Send a rectangle encoded with JPEG. The quality level requested by the
+  // client is raised by qualityBoost levels (up to the maximum).
   void sendJpegRect(const Rect *rect,
                     const FrameBuffer *serverFb,
-                    const EncodeOptions *options) throw(IOException);
+                    const EncodeOptions *options,
+                    int qualityBoost = 0) throw(IOException);
 
   // Return true if 32-bit pixels should be packed into 24-bit representation,
   // false otherwise. This function should be given the client's pixel format.
@@ -96,6 +212,26 @@ protected:
   // and blueMax are all 255.
   static void packPixels(UINT8 *buf, int count, const PixelFormat *pf);
 
+  // packPixels() for the byte order of the samples known at compile time,
+  // so that the loop has no branches.
+  template <bool BIG_ENDIAN_T>
+    static void packPixelsT(UINT8 *buf, int count, const PixelFormat *pf);
+
+  // Return true if the gradient filter should be used for a true color
+  // rectangle: the mean error of its prediction, estimated on a sample of
+  // pixels and scaled to 8-bit color components, is under the threshold.
+  // Zero threshold disables the filter.
+  template <class PIXEL_T>
+    bool isSmoothImage(const Rect *rect, const FrameBuffer *fb,
+                       int threshold) const;
+
+  // Apply the gradient filter to the color components of the pixels of the
+  // rectangle, write one filtered pixel per source pixel to dst. It is used
+  // when the pixels are not packed into 24-bit samples.
+  template <class PIXEL_T>
+    void filterGradient(const Rect *rect, const FrameBuffer *fb,
+                        PIXEL_T *dst);
+
   // Fill in the palette (m_pal) assuming that pixels have the type PIXEL_T
   // (where PIXEL_T can be UINT8, UINT16 or UINT32). Do not allow more than
   // maxColors in the palette, reset the palette size to 0 if actual number of
@@ -109,18 +245,22 @@ protected:
 
   // Encode a two-color rectangle using m_pal as a palette, produce a bitmap
   // where one pixel is represented by one bit. Each line is padded with
-  // zeroes to the byte boundary.
-  // FIXME: Do not use DataOutputStream, do not throw IOException.
+  // zeroes to the byte boundary. Returns the end of the data written to dst.
   template <class PIXEL_T>
-    void encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
-                        DataOutputStream *out) throw(IOException);
+    UINT8 *encodeMonoRect(const Rect *rect, const FrameBuffer *fb,
+                          UINT8 *dst);
 
   // Encode a rectangle using m_pal as a palette, produce a pixmap where one
   // pixel is represented by one byte which is its index in the palette.
-  // FIXME: Do not use DataOutputStream, do not throw IOException.
+  // Returns the end of the data written to dst.
   template <class PIXEL_T>
-    void encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
-                           DataOutputStream *out) throw(IOException);
+    UINT8 *encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
+                             UINT8 *dst);
+
+  // Return the bit to be set in the compression control byte if the zlib
+  // stream streamId should be reset before compressing the next rectangle,
+  // 0 otherwise. If the stream is to be reset, it's reset on our side here.
+  UINT8 resetStreamIfNeeded(int streamId) throw(IOException);
 
   // FIXME: Throw ZlibException instead.
   void sendCompressed(const char *data, size_t dataLen,
@@ -140,6 +280,8 @@ protected:
     int monoZlibLevel;
     int rawZlibLevel;
     int idxMaxColorsDivisor;
+    int gradientThreshold;
+    int mergeOverhead;
   } m_conf[10];
 
   // Select a record from the m_conf array which corresponds to the
@@ -151,6 +293,7 @@ protected:
   static const UINT8 SUBENCODING_JPEG = 0x90;
   static const UINT8 EXPLICIT_FILTER = 0x40;
   static const UINT8 FILTER_PALETTE = 0x01;
+  static const UINT8 FILTER_GRADIENT = 0x02;
 
   // Changing this will break compatibility with Tight decoders.
   static const int TIGHT_MIN_TO_COMPRESS = 12;
@@ -160,29 +303,83 @@ protected:
   static const int JPEG_MIN_RECT_SIZE = 4096;
   static const int JPEG_MIN_RECT_WIDTH = 8;
   static const int JPEG_MIN_RECT_HEIGHT = 8;
+  static const int GRADIENT_MIN_RECT_SIZE = 1024;
+  // Every n-th pixel of every n-th row is sampled by isSmoothImage().
+  static const int GRADIENT_SAMPLE_STEP = 3;
+  // Quality levels added for photo-like content that changes seldom.
+  static const int STATIC_JPEG_QUALITY_BOOST = 2;
+  // Limit of remembered rectangle classes, in case rectangles split by
+  // splitRectangle() were never sent.
+  static const size_t MAX_RECT_CLASSES = 16384;
+  // Single-color areas are looked for in rectangles of at least
+  // MIN_SOLID_SPLIT_SIZE pixels, tile by tile, and cut out if they have at
+  // least MIN_SOLID_AREA_SIZE pixels. The fills are not wider than
+  // MAX_FILL_RECT_WIDTH, the limit of all Tight rectangles.
+  static const int MIN_SOLID_SPLIT_SIZE = 4096;
+  static const int MIN_SOLID_AREA_SIZE = 2048;
+  static const int SOLID_TILE_SIZE = 16;
+  static const int MAX_FILL_RECT_WIDTH = 2048;
 
   // The number of zlib streams used by TightEncoder (it cannot exceed 4).
-  static const int NUM_ZLIB_STREAMS = 3;
+  static const int NUM_ZLIB_STREAMS = 4;
 
-  // Indexes of individual zlib streams.
-  static const int ZLIB_STREAM_RAW = 0;
-  static const int ZLIB_STREAM_MONO = 1;
-  static const int ZLIB_STREAM_IDX = 2;
-
-  // The array of zlib stream structures.
-  z_stream m_zsStruct[NUM_ZLIB_STREAMS];
+  // The array of zlib streams leased from EncoderContextPool on their
+  // first use.
+  z_stream *m_zsStruct[NUM_ZLIB_STREAMS];
 
   // The array of flags indicating if corresponding zlib streams were
-  // initialized.
+  // leased.
   bool m_zsActive[NUM_ZLIB_STREAMS];
   int m_zsLevel[NUM_ZLIB_STREAMS];
+  int m_zsStrategy[NUM_ZLIB_STREAMS];
+
+  // The level and the strategy of each stream, chosen by the bytes saved
+  // per unit of time on its recent data.
+  DeflateTuner m_zsTuner[NUM_ZLIB_STREAMS];
+
+  // Flags indicating that corresponding zlib streams must be reset before
+  // their next use (set on leaving the stateless mode).
+  bool m_zsNeedsReset[NUM_ZLIB_STREAMS];
+
+  // Output buffers of the zlib streams. They are kept between rectangles
+  // and never shrink, so steady-state compression does not allocate.
+  std::vector<char> m_zsBuffer[NUM_ZLIB_STREAMS];
+
+  // Pixel data of the rectangle being encoded, before the compression. It
+  // grows to the largest rectangle and is reused.
+  std::vector<UINT8> m_pixelData;
+
+  // Output of the gradient filter, and the color components of two rows of
+  // pixels used by filterGradient().
+  std::vector<UINT8> m_filteredData;
+  std::vector<int> m_gradientRows;
+
+  // True if the stateless mode is on, see setStateless().
+  bool m_stateless;
+
+  // True if splitRectangle() cuts the single-color areas out.
+  bool m_solidAreaSearch;
 
   // Color palette which maps color samples to color indexes and keeps track
   // of the number of colors allocated.
   TightPalette m_pal;
 
-  // JPEG compressor working via the IJG JPEG library.
-  StandardJpegCompressor m_compressor;
+  // Recently used palettes.
+  PaletteCache m_paletteCache;
+
+  // JPEG compressor working via the IJG JPEG library, leased from
+  // EncoderContextPool on the first JPEG rectangle, 0 before that.
+  StandardJpegCompressor *m_compressor;
+
+  // Tile classifier and the classes of the rectangles produced by
+  // splitRectangle(), keyed by the top-left corner (rectangles of one
+  // update never overlap).
+  TileClassifier m_classifier;
+  std::vector<Rect> m_classifiedRects;
+  std::vector<int> m_classes;
+  std::map<std::pair<int, int>, std::pair<Rect, int> > m_rectClasses;
+
+  UINT32 m_pathCounts[NUM_PATHS];
 };
 
 #endif // __RFB_TIGHT_ENCODER_H_INCLUDED__
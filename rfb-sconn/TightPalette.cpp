@@ -29,15 +29,24 @@
 #include "TightPalette.h"
 
 TightPalette::TightPalette(int maxColors)
+: m_numUsedKeys(0)
 {
   setMaxColors(maxColors);
+  memset(m_hash, 0, 256 * sizeof(TightColorList *));
   reset();
 }
 
 void TightPalette::reset()
 {
   m_numColors = 0;
-  memset(m_hash, 0, 256 * sizeof(TightColorList *));
+  if (m_numUsedKeys > 256) {
+    memset(m_hash, 0, 256 * sizeof(TightColorList *));
+  } else {
+    for (int i = 0; i < m_numUsedKeys; i++) {
+      m_hash[m_usedKeys[i]] = NULL;
+    }
+  }
+  m_numUsedKeys = 0;
 }
 
 void TightPalette::setMaxColors(int maxColors)
@@ -103,6 +112,10 @@ int TightPalette::insert(UINT32 rgb, int numPixels)
     prev_pnode->next = pnode;
   } else {
     m_hash[hash_key] = pnode;
+    if (m_numUsedKeys < 256) {
+      m_usedKeys[m_numUsedKeys] = hash_key;
+    }
+    m_numUsedKeys++;
   }
   pnode->next = NULL;
   pnode->idx = idx;
@@ -61,7 +61,8 @@ public:
 
   //
   // Re-initialize the object. This does not change maximum number
-  // of colors.
+  // of colors. Only the hash buckets used since the previous reset are
+  // cleared, so resetting a palette of a few colors is cheap.
   //
   void reset();
 
@@ -125,6 +126,12 @@ protected:
   TightColorList *m_hash[256];
   TightColorList m_list[256];
 
+  // Keys of the hash buckets which are not empty, in the order of their
+  // first use. If more keys are used (a full palette may be filled on),
+  // the whole hash is cleared on reset.
+  int m_usedKeys[256];
+  int m_numUsedKeys;
+
 };
 
 #endif // __RFB_TIGHTPALETTE_H_INCLUDED__
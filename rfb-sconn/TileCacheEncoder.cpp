@@ -0,0 +1,207 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TileCacheEncoder.h"
+
+#include <set>
+
+#include "zlib/zlib.h"
+
+TileCacheEncoder::TileCacheEncoder(PixelConverter *conv,
+                                   DataOutputStream *output)
+: Encoder(conv, output),
+  m_slots(NUM_SLOTS),
+  m_resetClient(true)
+{
+}
+
+TileCacheEncoder::~TileCacheEncoder()
+{
+}
+
+int TileCacheEncoder::getCode() const
+{
+  return EncodingDefs::TILE_CACHE;
+}
+
+bool TileCacheEncoder::isStateless() const
+{
+  return false;
+}
+
+bool TileCacheEncoder::restartStream()
+{
+  reset();
+  return true;
+}
+
+void TileCacheEncoder::reset()
+{
+  if (m_lru.empty() && m_operations.empty()) {
+    return;
+  }
+  m_lru.clear();
+  m_slotsByChecksum.clear();
+  m_operations.clear();
+  m_resetClient = true;
+}
+
+void TileCacheEncoder::lookUp(Region *region, const FrameBuffer *serverFb,
+                              bool lossless,
+                              std::vector<Rect> *hits,
+                              std::vector<Rect> *stores)
+{
+  // Slots keep pixels in the client format.
+  PixelFormat clientPf = m_pixelConverter->getDstPixelFormat();
+  if (!clientPf.isEqualTo(&m_clientPf)) {
+    reset();
+    m_clientPf = clientPf;
+  }
+
+  // Collect the tiles touched by the region, in the row order.
+  Dimension fbDim = serverFb->getDimension();
+  std::set<std::pair<int, int> > tiles;
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  for (size_t i = 0; i < rects.size(); i++) {
+    const Rect *r = &rects[i];
+    for (int y = r->top / TILE_SIZE; y <= (r->bottom - 1) / TILE_SIZE; y++) {
+      for (int x = r->left / TILE_SIZE; x <= (r->right - 1) / TILE_SIZE; x++) {
+        if ((x + 1) * TILE_SIZE <= fbDim.width &&
+            (y + 1) * TILE_SIZE <= fbDim.height) {
+          tiles.insert(std::make_pair(y * TILE_SIZE, x * TILE_SIZE));
+        }
+      }
+    }
+  }
+
+  std::vector<Rect> hitTiles;
+  std::set<std::pair<int, int> >::const_iterator it;
+  for (it = tiles.begin(); it != tiles.end(); it++) {
+    Rect tile(it->second, it->first,
+              it->second + TILE_SIZE, it->first + TILE_SIZE);
+    // Only tiles fully covered by the region are cached.
+    Region uncovered(tile);
+    uncovered.subtract(region);
+    if (!uncovered.isEmpty()) {
+      continue;
+    }
+
+    UINT64 checksum = calcChecksum(&tile, serverFb);
+    Operation op;
+    std::map<UINT64, int>::iterator found = m_slotsByChecksum.find(checksum);
+    if (found != m_slotsByChecksum.end()) {
+      Slot *slot = &m_slots[found->second];
+      if (slot->pending) {
+        // The same tile is stored in this update already.
+        continue;
+      }
+      op.slot = (UINT16)found->second;
+      touch(found->second);
+      if (slot->lossless || !lossless) {
+        op.code = OP_HIT;
+        hits->push_back(tile);
+        hitTiles.push_back(tile);
+      } else {
+        op.code = OP_STORE;
+        slot->lossless = true;
+        slot->pending = true;
+        stores->push_back(tile);
+      }
+    } else {
+      int slot = allocateSlot(checksum);
+      m_slots[slot].lossless = lossless;
+      m_slots[slot].pending = true;
+      op.code = OP_STORE;
+      op.slot = (UINT16)slot;
+      stores->push_back(tile);
+    }
+    m_operations[std::make_pair(tile.left, tile.top)] = op;
+  }
+  Region hitRegion;
+  hitRegion.addRects(&hitTiles);
+  region->subtract(&hitRegion);
+}
+
+void TileCacheEncoder::sendRectangle(const Rect *rect,
+                                     const FrameBuffer *serverFb,
+                                     const EncodeOptions *options)
+{
+  std::map<std::pair<int, int>, Operation>::iterator it =
+    m_operations.find(std::make_pair(rect->left, rect->top));
+  _ASSERT(it != m_operations.end());
+  Operation op = it->second;
+  m_operations.erase(it);
+
+  if (op.code == OP_STORE) {
+    m_slots[op.slot].pending = false;
+  }
+  if (m_resetClient) {
+    op.code |= RESET_CACHE;
+    m_resetClient = false;
+  }
+  m_output->writeUInt8(op.code);
+  m_output->writeUInt16(op.slot);
+}
+
+UINT64 TileCacheEncoder::calcChecksum(const Rect *tile,
+                                      const FrameBuffer *serverFb)
+{
+  // Two independent checksums make accidental collisions negligible, like
+  // in EncodedRectCache.
+  uLong crc = crc32(0L, Z_NULL, 0);
+  uLong adler = adler32(0L, Z_NULL, 0);
+
+  size_t lineSize = tile->getWidth() * serverFb->getBytesPerPixel();
+  int stride = serverFb->getBytesPerRow();
+  const Bytef *line = (const Bytef *)serverFb->getBufferPtr(tile->left,
+                                                            tile->top);
+  for (int y = tile->top; y < tile->bottom; y++, line += stride) {
+    crc = crc32(crc, line, (uInt)lineSize);
+    adler = adler32(adler, line, (uInt)lineSize);
+  }
+  return ((UINT64)(UINT32)crc << 32) | (UINT32)adler;
+}
+
+void TileCacheEncoder::touch(int slot)
+{
+  m_lru.splice(m_lru.begin(), m_lru, m_slots[slot].lruPos);
+}
+
+int TileCacheEncoder::allocateSlot(UINT64 checksum)
+{
+  int slot;
+  if (m_lru.size() < (size_t)NUM_SLOTS) {
+    slot = (int)m_lru.size();
+    m_lru.push_front(slot);
+  } else {
+    slot = m_lru.back();
+    m_slotsByChecksum.erase(m_slots[slot].checksum);
+    m_lru.splice(m_lru.begin(), m_lru, --m_lru.end());
+  }
+  m_slots[slot].checksum = checksum;
+  m_slots[slot].lruPos = m_lru.begin();
+  m_slotsByChecksum[checksum] = slot;
+  return slot;
+}
@@ -0,0 +1,126 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_TILE_CACHE_ENCODER_H_INCLUDED__
+#define __RFB_TILE_CACHE_ENCODER_H_INCLUDED__
+
+#include <list>
+#include <map>
+
+#include "Encoder.h"
+#include "region/Region.h"
+
+//
+// TileCacheEncoder implements the tile cache encoding. The client keeps
+// NUM_SLOTS slots for tiles of TILE_SIZE x TILE_SIZE pixels. The server
+// decides which tile goes to which slot, keeping track of the contents of
+// the client slots by checksums of the server-side pixels and replacing the
+// least recently used slots, so a tile the client has seen recently is sent
+// as a short reference to its slot.
+//
+// Each rectangle is one tile aligned to the tile grid and carries an 8-bit
+// operation code and a 16-bit slot number. OP_HIT tells the client to copy
+// the slot contents to the rectangle. OP_STORE tells it to save the pixels
+// it has in the rectangle to the slot, so it follows the rectangles which
+// sent those pixels with other encodings. The RESET_CACHE flag tells the
+// client to empty all the slots before the operation.
+//
+
+class TileCacheEncoder : public Encoder
+{
+public:
+  TileCacheEncoder(PixelConverter *conv, DataOutputStream *output);
+  virtual ~TileCacheEncoder();
+
+  virtual int getCode() const;
+
+  // Finds the full tiles of the region. Tiles cached by the client are
+  // removed from the region and added to hits. Other tiles are added to
+  // stores: they should be sent as usual and then stored by the client.
+  // `lossless' tells if the region will be sent losslessly. Tiles cached
+  // lossy are not hits for lossless regions, they are stored again.
+  // Rectangles of hits and stores are to be passed to sendRectangle() in the
+  // same update, all the hits before any of the stores.
+  void lookUp(Region *region, const FrameBuffer *serverFb, bool lossless,
+              std::vector<Rect> *hits, std::vector<Rect> *stores);
+
+  // Forgets all the cached tiles and makes the client do the same with the
+  // next rectangle. Should be called if the tile cache is not in use.
+  void reset();
+
+  // Sends the operation found for the rectangle by lookUp().
+  virtual void sendRectangle(const Rect *rect,
+                             const FrameBuffer *serverFb,
+                             const EncodeOptions *options) throw(IOException);
+
+  // The output refers to the client slots.
+  virtual bool isStateless() const;
+
+  // Same as reset().
+  virtual bool restartStream();
+
+  static const int TILE_SIZE = 64;
+  static const int NUM_SLOTS = 1024;
+
+  static const UINT8 OP_HIT = 0;
+  static const UINT8 OP_STORE = 1;
+  static const UINT8 RESET_CACHE = 0x80;
+
+protected:
+  struct Slot
+  {
+    UINT64 checksum;
+    bool lossless;
+    // The store operation for the slot has been found but not sent yet, so
+    // the slot cannot be referred to.
+    bool pending;
+    std::list<int>::iterator lruPos;
+  };
+
+  struct Operation
+  {
+    UINT8 code;
+    UINT16 slot;
+  };
+
+  static UINT64 calcChecksum(const Rect *tile, const FrameBuffer *serverFb);
+
+  // Moves the slot to the front of m_lru.
+  void touch(int slot);
+  // Returns a free slot or the least recently used one, which is forgotten.
+  int allocateSlot(UINT64 checksum);
+
+  std::vector<Slot> m_slots;
+  // Used slots from the most recently used one.
+  std::list<int> m_lru;
+  std::map<UINT64, int> m_slotsByChecksum;
+  // Operations found by lookUp(), keyed by the top-left tile corner.
+  std::map<std::pair<int, int>, Operation> m_operations;
+
+  // The client pixel format the slots are cached in.
+  PixelFormat m_clientPf;
+  bool m_resetClient;
+};
+
+#endif // __RFB_TILE_CACHE_ENCODER_H_INCLUDED__
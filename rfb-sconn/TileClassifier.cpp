@@ -0,0 +1,207 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TileClassifier.h"
+
+#include <stdlib.h>
+
+#include "util/DateTime.h"
+
+TileClassifier::TileClassifier()
+: m_historyWidth(0),
+  m_historyHeight(0),
+  m_pal(MAX_TEXT_COLORS)
+{
+  for (int i = 0; i < NUM_TILE_CLASSES; i++) {
+    m_tileCounts[i] = 0;
+  }
+}
+
+TileClassifier::~TileClassifier()
+{
+}
+
+UINT32 TileClassifier::getTileCount(int tileClass) const
+{
+  return m_tileCounts[tileClass];
+}
+
+void TileClassifier::classify(const Rect *rect, const FrameBuffer *fb,
+                              std::vector<Rect> *rects,
+                              std::vector<int> *classes)
+{
+  validateHistory(fb);
+  UINT64 now = DateTime::now().getTime();
+
+  m_prevRowRects.clear();
+
+  for (int y0 = rect->top; y0 < rect->bottom; ) {
+    int y1 = min((y0 / TILE_SIZE + 1) * TILE_SIZE, rect->bottom);
+
+    // Classify the tiles of this row.
+    m_rowClasses.clear();
+    for (int x0 = rect->left; x0 < rect->right; ) {
+      int x1 = min((x0 / TILE_SIZE + 1) * TILE_SIZE, rect->right);
+      Rect tile(x0, y0, x1, y1);
+      int tileClass = TILE_TEXT;
+      bool live = registerChange(x0 / TILE_SIZE, y0 / TILE_SIZE, now);
+      if (isPhotoLike(&tile, fb)) {
+        tileClass = live ? TILE_PHOTO : TILE_STATIC;
+      }
+      m_tileCounts[tileClass]++;
+      m_rowClasses.push_back(tileClass);
+      x0 = x1;
+    }
+
+    // Merge adjacent tiles of the same class into runs, then extend
+    // the rectangles of the previous row which have the same extent.
+    m_rowRects.clear();
+    int runLeft = rect->left;
+    for (size_t i = 0; i < m_rowClasses.size(); i++) {
+      bool lastInRun = i + 1 == m_rowClasses.size() ||
+                       m_rowClasses[i + 1] != m_rowClasses[i];
+      if (!lastInRun) {
+        continue;
+      }
+      int runRight = min((int)((rect->left / TILE_SIZE + i + 1) * TILE_SIZE),
+                         rect->right);
+      size_t index = rects->size();
+      for (size_t j = 0; j < m_prevRowRects.size(); j++) {
+        Rect *prev = &rects->at(m_prevRowRects[j]);
+        if (prev->left == runLeft && prev->right == runRight &&
+            classes->at(m_prevRowRects[j]) == m_rowClasses[i]) {
+          prev->bottom = y1;
+          index = m_prevRowRects[j];
+          break;
+        }
+      }
+      if (index == rects->size()) {
+        rects->push_back(Rect(runLeft, y0, runRight, y1));
+        classes->push_back(m_rowClasses[i]);
+      }
+      m_rowRects.push_back(index);
+      runLeft = runRight;
+    }
+    m_prevRowRects.swap(m_rowRects);
+    y0 = y1;
+  }
+}
+
+bool TileClassifier::isPhotoLike(const Rect *tile, const FrameBuffer *fb)
+{
+  if (fb->getBitsPerPixel() == 32) {
+    return isPhotoLikeT<UINT32>(tile, fb);
+  } else {
+    return isPhotoLikeT<UINT16>(tile, fb);
+  }
+}
+
+template <class PIXEL_T>
+bool TileClassifier::isPhotoLikeT(const Rect *tile, const FrameBuffer *fb)
+{
+  PixelFormat pf = fb->getPixelFormat();
+  int stride = fb->getBytesPerRow() / sizeof(PIXEL_T);
+  const PIXEL_T *row = (const PIXEL_T *)fb->getBufferPtr(tile->left, tile->top);
+  int width = tile->getWidth();
+  int height = tile->getHeight();
+
+  // Color components are scaled to 0..255 for the smoothness check.
+  int maxDiff[3] = {
+    SMOOTH_DIFF * pf.redMax / 255,
+    SMOOTH_DIFF * pf.greenMax / 255,
+    SMOOTH_DIFF * pf.blueMax / 255
+  };
+
+  m_pal.reset();
+  bool manyColors = false;
+  int numDiffering = 0;
+  int numSmooth = 0;
+
+  for (int y = 0; y < height; y++, row += stride) {
+    PIXEL_T prev = row[0];
+    int runLength = 1;
+    for (int x = 1; x < width; x++) {
+      PIXEL_T pixel = row[x];
+      if (pixel == prev) {
+        runLength++;
+        continue;
+      }
+      if (!manyColors && m_pal.insert(prev, runLength) == 0) {
+        manyColors = true;
+      }
+      runLength = 1;
+
+      numDiffering++;
+      int dr = abs((int)(pixel >> pf.redShift & pf.redMax) -
+                   (int)(prev >> pf.redShift & pf.redMax));
+      int dg = abs((int)(pixel >> pf.greenShift & pf.greenMax) -
+                   (int)(prev >> pf.greenShift & pf.greenMax));
+      int db = abs((int)(pixel >> pf.blueShift & pf.blueMax) -
+                   (int)(prev >> pf.blueShift & pf.blueMax));
+      if (dr <= maxDiff[0] && dg <= maxDiff[1] && db <= maxDiff[2]) {
+        numSmooth++;
+      }
+      prev = pixel;
+    }
+    if (!manyColors && m_pal.insert(prev, runLength) == 0) {
+      manyColors = true;
+    }
+  }
+
+  // Photos have many colors, and most of the neighbouring pixels differ
+  // a little. Anti-aliased text also has many colors, but sharp edges.
+  int numPairs = (width - 1) * height;
+  return manyColors &&
+         numDiffering * 4 >= numPairs &&
+         numSmooth * 4 >= numDiffering * 3;
+}
+
+bool TileClassifier::registerChange(int tileX, int tileY, UINT64 now)
+{
+  TileHistory *history = &m_history[tileY * m_historyWidth + tileX];
+  UINT64 pause = now - history->lastChange;
+  if (pause >= MIN_CHANGE_PAUSE) {
+    if (pause > MAX_CHANGE_PAUSE) {
+      history->numChanges = 0;
+    }
+    if (history->numChanges < MIN_LIVE_CHANGES) {
+      history->numChanges++;
+    }
+    history->lastChange = now;
+  }
+  return history->numChanges >= MIN_LIVE_CHANGES;
+}
+
+void TileClassifier::validateHistory(const FrameBuffer *fb)
+{
+  Dimension dim = fb->getDimension();
+  int width = (dim.width + TILE_SIZE - 1) / TILE_SIZE;
+  int height = (dim.height + TILE_SIZE - 1) / TILE_SIZE;
+  if (width != m_historyWidth || height != m_historyHeight) {
+    TileHistory empty = { 0, 0 };
+    m_history.assign(width * height, empty);
+    m_historyWidth = width;
+    m_historyHeight = height;
+  }
+}
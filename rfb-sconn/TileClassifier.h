@@ -0,0 +1,117 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_TILE_CLASSIFIER_H_INCLUDED__
+#define __RFB_TILE_CLASSIFIER_H_INCLUDED__
+
+#include <vector>
+
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+#include "util/inttypes.h"
+#include "TightPalette.h"
+
+//
+// TileClassifier sorts frame buffer tiles by their content, so that
+// TightEncoder could choose a lossless or a lossy representation for each
+// part of an update instead of one for the whole rectangle:
+//
+//   TILE_TEXT   - text, UI elements and other content with few colors or
+//                 sharp edges, it should be sent lossless;
+//   TILE_PHOTO  - photo-like content (many colors, smooth transitions) that
+//                 keeps changing, like animations and slide shows;
+//   TILE_STATIC - photo-like content that changes seldom, it stays on the
+//                 screen and deserves better JPEG quality.
+//
+// Tiles are aligned to the frame buffer grid. The classifier remembers when
+// each tile changed, passing an area to classify() counts as its change.
+//
+
+class TileClassifier
+{
+public:
+  static const int TILE_TEXT = 0;
+  static const int TILE_PHOTO = 1;
+  static const int TILE_STATIC = 2;
+  static const int NUM_TILE_CLASSES = 3;
+
+  TileClassifier();
+  virtual ~TileClassifier();
+
+  // Split the changed rect of the frame buffer into rectangles of the
+  // same tile class. The rectangles and their classes are appended to
+  // rects and classes. The frame buffer must be at least 16 bits per pixel.
+  void classify(const Rect *rect, const FrameBuffer *fb,
+                std::vector<Rect> *rects, std::vector<int> *classes);
+
+  // Return the number of tiles classified as tileClass so far.
+  UINT32 getTileCount(int tileClass) const;
+
+protected:
+  static const int TILE_SIZE = 64;
+  // Tiles with no more colors than that are never photo-like.
+  static const int MAX_TEXT_COLORS = 24;
+  // The largest difference of a color component (out of 255) between
+  // adjacent pixels that still counts as a smooth transition.
+  static const int SMOOTH_DIFF = 32;
+  // A tile is live if it changed at least MIN_LIVE_CHANGES times in a row
+  // with pauses no longer than MAX_CHANGE_PAUSE milliseconds. Changes closer
+  // than MIN_CHANGE_PAUSE belong to the same update.
+  static const int MIN_LIVE_CHANGES = 3;
+  static const unsigned int MAX_CHANGE_PAUSE = 1000;
+  static const unsigned int MIN_CHANGE_PAUSE = 15;
+
+  // Return true if the pixels of the tile look like a photo.
+  bool isPhotoLike(const Rect *tile, const FrameBuffer *fb);
+  template <class PIXEL_T>
+    bool isPhotoLikeT(const Rect *tile, const FrameBuffer *fb);
+
+  // Register a change of the tile and return true if it is live.
+  bool registerChange(int tileX, int tileY, UINT64 now);
+
+  // Make sure the change history matches the frame buffer size.
+  void validateHistory(const FrameBuffer *fb);
+
+  struct TileHistory {
+    UINT64 lastChange;
+    int numChanges;
+  };
+
+  std::vector<TileHistory> m_history;
+  int m_historyWidth;
+  int m_historyHeight;
+
+  TightPalette m_pal;
+
+  UINT32 m_tileCounts[NUM_TILE_CLASSES];
+
+  // Classes of the tiles of the current tile row.
+  std::vector<int> m_rowClasses;
+  // Indexes (in the output list) of the rectangles touching the bottom of
+  // the current and the previous tile rows.
+  std::vector<size_t> m_rowRects;
+  std::vector<size_t> m_prevRowRects;
+};
+
+#endif // __RFB_TILE_CLASSIFIER_H_INCLUDED__
@@ -23,6 +23,7 @@
 //
 
 #include "ZrleEncoder.h"
+#include "rfb/FrameBufferAccessor.h"
 
 ZrleEncoder::ZrleEncoder(PixelConverter *conv, DataOutputStream *output)
 : Encoder(conv, output),
@@ -33,19 +34,92 @@ ZrleEncoder::ZrleEncoder(PixelConverter *conv, DataOutputStream *output)
   m_monoZlibLevel(ZLIB_MONO_LEVEL_DEFAULT),
   m_rawZlibLevel(ZLIB_RAW_LEVEL_DEFAULT),
   m_bytesPerPixel(0),
-  m_numberFirstByte(0)
+  m_numberFirstByte(0),
+  m_bandRunner(0)
 {
 }
 
 ZrleEncoder::~ZrleEncoder()
 {
+  delete m_bandRunner;
+  std::vector<ZrleEncoder *>::iterator i;
+  for (i = m_bandEncoders.begin(); i != m_bandEncoders.end(); i++) {
+    delete *i;
+  }
 }
 
+// Encodes one band of tile rows of the rectangle per part, with the band
+// encoder of the same index.
+template <class PIXEL_T>
+class ZrleEncoder::TileBandJob : public ParallelJob
+{
+public:
+  TileBandJob(ZrleEncoder *encoder, const Rect *rect,
+              const FrameBuffer *clientFb, size_t numBands)
+  : m_encoder(encoder),
+    m_rect(*rect),
+    m_clientFb(clientFb),
+    m_numBands(numBands)
+  {
+  }
+
+  virtual void runPart(size_t index)
+  {
+    int numTileRows = (m_rect.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+    int firstRow = (int)(numTileRows * index / m_numBands);
+    int lastRow = (int)(numTileRows * (index + 1) / m_numBands);
+    Rect band(m_rect.left, m_rect.top + firstRow * TILE_SIZE,
+              m_rect.right, min(m_rect.bottom, m_rect.top + lastRow * TILE_SIZE));
+
+    ZrleEncoder *bandEncoder = m_encoder->m_bandEncoders[index];
+    bandEncoder->m_rgbData.resize(0);
+    if (!band.isEmpty()) {
+      bandEncoder->encodeTiles<PIXEL_T>(&band, m_clientFb);
+    }
+  }
+
+private:
+  ZrleEncoder *m_encoder;
+  Rect m_rect;
+  const FrameBuffer *m_clientFb;
+  size_t m_numBands;
+};
+
 int ZrleEncoder::getCode() const
 {
   return EncodingDefs::ZRLE;
 }
 
+bool ZrleEncoder::isStateless() const
+{
+  return false;
+}
+
+size_t ZrleEncoder::getRectOverhead(const EncodeOptions *options) const
+{
+  return MERGE_OVERHEAD;
+}
+
+size_t ZrleEncoder::getScratchSize() const
+{
+  size_t size = m_rgbData.capacity() + m_plainRleTile.capacity();
+  std::vector<ZrleEncoder *>::const_iterator i;
+  for (i = m_bandEncoders.begin(); i != m_bandEncoders.end(); i++) {
+    size += (*i)->getScratchSize();
+  }
+  return size;
+}
+
+void ZrleEncoder::releaseScratch()
+{
+  std::vector<UINT8>().swap(m_rgbData);
+  std::vector<UINT8>().swap(m_plainRleTile);
+  std::vector<ZrleEncoder *>::iterator i;
+  for (i = m_bandEncoders.begin(); i != m_bandEncoders.end(); i++) {
+    (*i)->releaseScratch();
+  }
+}
+
 void ZrleEncoder::splitRectangle(const Rect *rect,
                                  std::vector<Rect> *rectList,
                                  const FrameBuffer *serverFb,
@@ -100,7 +174,7 @@ void ZrleEncoder::sendRectangle(const Rect *rect,
   // If vector will be small it will be resized automatically.
   m_rgbData.reserve(rect->area() * 3);
   
-  m_fbWidth = clientFb->getDimension().width;
+  m_fbStride = clientFb->getBytesPerRow() / clientFb->getBytesPerPixel();
   size_t bpp = clientFb->getBitsPerPixel();
   if (bpp == 8) {
     sendRect<UINT8>(rect, serverFb, clientFb, options);
@@ -120,8 +194,63 @@ void ZrleEncoder::sendRect(const Rect *rect,
                            const EncodeOptions *options)
 {
   m_rgbData.resize(0);
-  const PIXEL_T *buffer = static_cast<const PIXEL_T *>(clientFb->getBuffer());
+  if (rect->area() >= MIN_PARALLEL_AREA && rect->getHeight() > TILE_SIZE) {
+    encodeTilesInParallel<PIXEL_T>(rect, clientFb);
+  } else {
+    encodeTiles<PIXEL_T>(rect, clientFb);
+  }
+
+  // If area of rect == 0, send length of zlib data == 0.
+  if (m_rgbData.empty()) {
+    m_output->writeUInt32(0);
+  } else {
+    m_deflater.setInput(reinterpret_cast<const char *>(&m_rgbData.front()),
+                        m_rgbData.size());
+    m_deflater.deflate();
   
+    m_output->writeUInt32(m_deflater.getOutputSize());
+    m_output->writeFully(m_deflater.getOutput(),
+                         m_deflater.getOutputSize());
+  }
+}
+
+template <class PIXEL_T>
+void ZrleEncoder::encodeTilesInParallel(const Rect *rect,
+                                        const FrameBuffer *clientFb)
+{
+  if (m_bandRunner == 0) {
+    m_bandRunner = new ParallelJobRunner(0);
+    for (size_t i = 0; i < m_bandRunner->getNumThreads(); i++) {
+      m_bandEncoders.push_back(new ZrleEncoder(m_pixelConverter, m_output));
+    }
+  }
+  size_t numTileRows = (rect->getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+  size_t numBands = min(m_bandEncoders.size(), numTileRows);
+  if (numBands < 2) {
+    encodeTiles<PIXEL_T>(rect, clientFb);
+    return;
+  }
+
+  for (size_t i = 0; i < numBands; i++) {
+    ZrleEncoder *bandEncoder = m_bandEncoders[i];
+    bandEncoder->m_pxFormat = m_pxFormat;
+    bandEncoder->m_bytesPerPixel = m_bytesPerPixel;
+    bandEncoder->m_numberFirstByte = m_numberFirstByte;
+    bandEncoder->m_fbStride = m_fbStride;
+  }
+  TileBandJob<PIXEL_T> job(this, rect, clientFb, numBands);
+  m_bandRunner->run(&job, numBands);
+
+  // The tiles go to the zlib stream in the usual order.
+  for (size_t i = 0; i < numBands; i++) {
+    const std::vector<UINT8> *bandData = &m_bandEncoders[i]->m_rgbData;
+    m_rgbData.insert(m_rgbData.end(), bandData->begin(), bandData->end());
+  }
+}
+
+template <class PIXEL_T>
+void ZrleEncoder::encodeTiles(const Rect *rect, const FrameBuffer *clientFb)
+{
   Rect tileRect;
   for (tileRect.top = rect->top; tileRect.top < rect->bottom; tileRect.top += TILE_SIZE) {
 
@@ -199,19 +328,6 @@ void ZrleEncoder::sendRect(const Rect *rect,
       }
     }
   }
-
-  // If area of rect == 0, send length of zlib data == 0.
-  if (m_rgbData.empty()) {
-    m_output->writeUInt32(0);
-  } else {
-    m_deflater.setInput(reinterpret_cast<const char *>(&m_rgbData.front()),
-                        m_rgbData.size());
-    m_deflater.deflate();
-  
-    m_output->writeUInt32(m_deflater.getOutputSize());
-    m_output->writeFully(m_deflater.getOutput(),
-                         m_deflater.getOutputSize());
-  }
 }
 
 template <class PIXEL_T>
@@ -276,7 +392,7 @@ void ZrleEncoder::writePackedPaletteTile(const Rect *tileRect,
   Rect rect;
   for (rect.top = tileRect->top; rect.top < tileRect->bottom; rect.top++) {
     for (rect.left = tileRect->left; rect.left < tileRect->right; rect.left++) {
-      PIXEL_T px = buffer[rect.top * m_fbWidth + rect.left];
+      PIXEL_T px = buffer[rect.top * m_fbStride + rect.left];
       UINT8 indexOfColor = m_pal.getIndex(px);
       if (offset != 0) {
         packedByte = packedByte << deltaOffset;
@@ -343,7 +459,7 @@ void ZrleEncoder::writePaletteRleTile(const Rect *tileRect,
   PixelFormat pxFormat = fb->getPixelFormat();
 
   // There is the first iteration of loop below.
-  PIXEL_T px = buffer[tileRect->top * m_fbWidth + tileRect->left];
+  PIXEL_T px = buffer[tileRect->top * m_fbStride + tileRect->left];
   UINT8 indexOfColor = m_pal.getIndex(px);
 
   // Processing of the first pixel.
@@ -357,7 +473,7 @@ void ZrleEncoder::writePaletteRleTile(const Rect *tileRect,
     int x = tileRect->left + i % tileRect->getWidth();
     int y = tileRect->top + i / tileRect->getWidth();
 
-    px = buffer[y * m_fbWidth + x];
+    px = buffer[y * m_fbStride + x];
 
     indexOfColor = m_pal.getIndex(px);
     if (indexOfColor != previousIndexOfColor) {
@@ -426,7 +542,7 @@ void ZrleEncoder::fillPalette(const Rect *tileRect,
   // There is the first iteration of loop below.
   // Pixel for adding to plainRleTile
   PIXEL_T previousPx;
-  PIXEL_T px = buffer[tileRect->top * m_fbWidth + tileRect->left];
+  PIXEL_T px = buffer[tileRect->top * m_fbStride + tileRect->left];
 
   // Pixel for adding to palette
   PIXEL_T oldPixel = px;
@@ -451,7 +567,7 @@ void ZrleEncoder::fillPalette(const Rect *tileRect,
     int x = tileRect->left + i % tileRect->getWidth();
     int y = tileRect->top + i / tileRect->getWidth();
 
-    px = buffer[y * m_fbWidth + x];
+    px = buffer[y * m_fbStride + x];
     
     // Fill palette
     if (tryInsertPx && oldPixel != px) {
@@ -485,8 +601,9 @@ void ZrleEncoder::copyPixels(const Rect *rect,
 {
   const int rectHeight = rect->getHeight();
   const int rectWidth = rect->getWidth();
-  const PIXEL_T *src = static_cast<const PIXEL_T *>(fb->getBufferPtr(rect->left, rect->top));
-  const int fbStride = fb->getDimension().width;
+  const FrameBufferAccessor<PIXEL_T> pixels(fb);
+  const PIXEL_T *src = pixels.getPtr(rect->left, rect->top);
+  const int fbStride = pixels.getStride();
   const size_t bytesPerRow = rect->getWidth() * m_bytesPerPixel;
 
   for (int y = 0; y < rectHeight; y++) {
@@ -503,7 +620,7 @@ void ZrleEncoder::copyCPixels(const Rect *rect,
   const int rectHeight = rect->getHeight();
   const int rectWidth = rect->getWidth();
   const UINT8 *src = static_cast<const UINT8 *>(fb->getBufferPtr(rect->left, rect->top));
-  const int fbStride = fb->getDimension().width;
+  const int skipBytes = fb->getBytesPerRow() - rectWidth * 4;
   
   for (int y = 0; y < rectHeight; y++) {
     for (int x = 0; x < rectWidth; x++) {
@@ -511,6 +628,6 @@ void ZrleEncoder::copyCPixels(const Rect *rect,
       src += 4;
       dst += 3;
     }
-    src += ((fbStride - rectWidth) * 4);
+    src += skipBytes;
   }
 }
@@ -28,6 +28,7 @@
 #include "Encoder.h"
 #include "TightPalette.h"
 #include "util/Deflater.h"
+#include "thread/ParallelJobRunner.h"
 
 class ZrleEncoder : public Encoder
 {
@@ -47,7 +48,21 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options) throw(IOException);
 
+  // ZRLE uses a single zlib stream for the whole connection, so its output
+  // always depends on the data sent before.
+  virtual bool isStateless() const;
+
+  // Each rectangle flushes the zlib stream and starts a new tile grid.
+  virtual size_t getRectOverhead(const EncodeOptions *options) const;
+
+  // The tile data of the largest rectangle, along with that of the band
+  // encoders.
+  virtual size_t getScratchSize() const;
+  virtual void releaseScratch();
+
 private:
+  template <class PIXEL_T> class TileBandJob;
+
   // Determine the class of rectangle and call necessary function for this type.
   template <class PIXEL_T>
     void sendRect(const Rect *rect,
@@ -55,6 +70,15 @@ private:
                   const FrameBuffer *clientFb,
                   const EncodeOptions *options) throw(IOException);
 
+  // Appends the tiles of rect to m_rgbData.
+  template <class PIXEL_T>
+    void encodeTiles(const Rect *rect, const FrameBuffer *clientFb);
+
+  // Does the same as encodeTiles() with bands of tile rows encoded by
+  // m_bandEncoders in parallel.
+  template <class PIXEL_T>
+    void encodeTilesInParallel(const Rect *rect, const FrameBuffer *clientFb);
+
   // Send raw tile.
   template <class PIXEL_T>
     void writeRawTile(const Rect *tileRect,
@@ -106,8 +130,8 @@ private:
   // Size of m_rgbData before writing information in it.
   size_t m_oldSize;
 
-  // Size of stride.
-  int m_fbWidth;
+  // Row stride of the client frame buffer in pixels.
+  int m_fbStride;
 
   // Size of packed pixels in palette.
   int m_mSize;
@@ -136,6 +160,12 @@ private:
   // vector for storing plain RLE tile data
   std::vector<UINT8> m_plainRleTile;
 
+  // Threads and encoders of tile bands for big rectangles, created on the
+  // first use. The band encoders only use their tile state and output,
+  // their zlib streams are never used.
+  ParallelJobRunner *m_bandRunner;
+  std::vector<ZrleEncoder *> m_bandEncoders;
+
 private:
   // Tile size in ZRLE encoding by default.
   static const int TILE_SIZE = 64;
@@ -151,6 +181,13 @@ private:
 
   // Max possible colors in palette (127 is max for RLE palette type encoding).
   static const UINT8 MAX_NUMBER_OF_COLORS_IN_PALETTE = 127;
+
+  // Rectangles of at least this area are split into bands of tile rows
+  // encoded in parallel. Only the deflate stage is serial.
+  static const int MIN_PARALLEL_AREA = 256 * 256;
+
+  // Unchanged pixels worth saving a rectangle, see getRectOverhead().
+  static const size_t MERGE_OVERHEAD = 128;
 };
 
 #endif // __RFB_ZRLE_ENCODER_H_INCLUDED__
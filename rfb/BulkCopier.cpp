@@ -0,0 +1,172 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "BulkCopier.h"
+#include "util/CpuFeatures.h"
+#include "util/Exception.h"
+
+#include <string.h>
+#include <emmintrin.h>
+
+// Copies a band of rows of a bulk copy.
+class BulkCopyJob : public ParallelJob
+{
+public:
+  BulkCopyJob(UINT8 *dst, int dstStride, const UINT8 *src, int srcStride,
+              size_t rowBytes, int numRows, size_t numParts)
+  : m_dst(dst), m_dstStride(dstStride),
+    m_src(src), m_srcStride(srcStride),
+    m_rowBytes(rowBytes), m_numRows(numRows), m_numParts(numParts)
+  {
+  }
+
+  virtual void runPart(size_t index)
+  {
+    int first = (int)(m_numRows * index / m_numParts);
+    int last = (int)(m_numRows * (index + 1) / m_numParts);
+    BulkCopier::copyRows(m_dst + (ptrdiff_t)first * m_dstStride, m_dstStride,
+                         m_src + (ptrdiff_t)first * m_srcStride, m_srcStride,
+                         m_rowBytes, last - first, false);
+  }
+
+private:
+  UINT8 *m_dst;
+  int m_dstStride;
+  const UINT8 *m_src;
+  int m_srcStride;
+  size_t m_rowBytes;
+  int m_numRows;
+  size_t m_numParts;
+};
+
+BulkCopier BulkCopier::s_instance;
+
+BulkCopier::BulkCopier()
+: m_runner(0),
+  m_busy(0)
+{
+}
+
+BulkCopier::~BulkCopier()
+{
+  delete m_runner;
+}
+
+void BulkCopier::copyRows(UINT8 *dst, int dstStride,
+                          const UINT8 *src, int srcStride,
+                          size_t rowBytes, int numRows, bool parallel)
+{
+  if (numRows <= 0 || rowBytes == 0) {
+    return;
+  }
+  size_t totalBytes = rowBytes * numRows;
+  if (totalBytes < STREAMING_MIN_BYTES) {
+    for (int i = 0; i < numRows; i++, dst += dstStride, src += srcStride) {
+      memcpy(dst, src, rowBytes);
+    }
+    return;
+  }
+  if (parallel && totalBytes >= PARALLEL_MIN_BYTES &&
+      s_instance.copyInParallel(dst, dstStride, src, srcStride,
+                                rowBytes, numRows)) {
+    return;
+  }
+  streamRows(dst, dstStride, src, srcStride, rowBytes, numRows);
+}
+
+void BulkCopier::streamRows(UINT8 *dst, int dstStride,
+                            const UINT8 *src, int srcStride,
+                            size_t rowBytes, int numRows)
+{
+  if (!CpuFeatures::hasSse2()) {
+    for (int i = 0; i < numRows; i++, dst += dstStride, src += srcStride) {
+      memcpy(dst, src, rowBytes);
+    }
+    return;
+  }
+  for (int i = 0; i < numRows; i++, dst += dstStride, src += srcStride) {
+    streamRow(dst, src, rowBytes);
+  }
+  // Non-temporal stores are weakly ordered, make them visible to other
+  // threads before the copy is reported as done.
+  _mm_sfence();
+}
+
+void BulkCopier::streamRow(UINT8 *dst, const UINT8 *src, size_t bytes)
+{
+  // The stores need a 16-byte aligned destination.
+  size_t head = (16 - ((size_t)dst & 15)) & 15;
+  if (head > bytes) {
+    head = bytes;
+  }
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  bytes -= head;
+
+  for (; bytes >= 64; bytes -= 64, dst += 64, src += 64) {
+    __m128i a = _mm_loadu_si128((const __m128i *)src);
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+    __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+    _mm_stream_si128((__m128i *)dst, a);
+    _mm_stream_si128((__m128i *)(dst + 16), b);
+    _mm_stream_si128((__m128i *)(dst + 32), c);
+    _mm_stream_si128((__m128i *)(dst + 48), d);
+  }
+  for (; bytes >= 16; bytes -= 16, dst += 16, src += 16) {
+    _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+  }
+  memcpy(dst, src, bytes);
+}
+
+bool BulkCopier::copyInParallel(UINT8 *dst, int dstStride,
+                                const UINT8 *src, int srcStride,
+                                size_t rowBytes, int numRows)
+{
+  // Another copy owns the runner, the caller copies on its own.
+  if (InterlockedCompareExchange(&m_busy, 1, 0) != 0) {
+    return false;
+  }
+  bool done = false;
+  try {
+    if (m_runner == 0) {
+      SYSTEM_INFO sysInfo;
+      GetSystemInfo(&sysInfo);
+      unsigned int numThreads = min((unsigned int)sysInfo.dwNumberOfProcessors,
+                                    MAX_THREADS);
+      m_runner = new ParallelJobRunner(numThreads);
+    }
+    size_t numParts = m_runner->getNumThreads();
+    if (numParts > 1) {
+      BulkCopyJob job(dst, dstStride, src, srcStride, rowBytes, numRows,
+                      numParts);
+      m_runner->run(&job, numParts);
+      done = true;
+    }
+  } catch (Exception &) {
+  }
+  InterlockedExchange(&m_busy, 0);
+  return done;
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __BULKCOPIER_H__
+#define __BULKCOPIER_H__
+
+#include "util/inttypes.h"
+#include "thread/ParallelJobRunner.h"
+
+//
+// BulkCopier copies rows of pixels between frame buffers. Small copies are
+// done with memcpy(), as they always were. Copies of several megabytes
+// (full frames of large screens) are done with non-temporal stores, which
+// write around the caches, so that the copied frame does not evict the data
+// of the encoders from the last level cache. The largest copies are split
+// into bands copied by several threads at the same time.
+//
+
+class BulkCopier
+{
+public:
+  BulkCopier();
+  virtual ~BulkCopier();
+
+  // Copies rows of rowBytes bytes from src to dst. The strides may be
+  // negative to copy bottom-up. The rows of src and dst must not overlap,
+  // except when parallel is false and the direction of the copy is such
+  // that every source row is read before it is overwritten.
+  static void copyRows(UINT8 *dst, int dstStride,
+                       const UINT8 *src, int srcStride,
+                       size_t rowBytes, int numRows, bool parallel = true);
+
+  // Copies are done with non-temporal stores from this total size, see
+  // the class comment.
+  static const size_t STREAMING_MIN_BYTES = 2 * 1024 * 1024;
+  // Copies are split between threads from this total size.
+  static const size_t PARALLEL_MIN_BYTES = 8 * 1024 * 1024;
+  // Memory bandwidth gets saturated by a few threads.
+  static const unsigned int MAX_THREADS = 4;
+
+protected:
+  // Copies the rows with non-temporal stores if supported by the processor.
+  static void streamRows(UINT8 *dst, int dstStride,
+                         const UINT8 *src, int srcStride,
+                         size_t rowBytes, int numRows);
+  static void streamRow(UINT8 *dst, const UINT8 *src, size_t bytes);
+
+  // Tries to copy the rows in parallel, returns false if the runner is busy
+  // with a copy requested by another thread or cannot be created.
+  bool copyInParallel(UINT8 *dst, int dstStride,
+                      const UINT8 *src, int srcStride,
+                      size_t rowBytes, int numRows);
+
+  // The runner is created on the first parallel copy and used by one copy
+  // at a time, the one that has set m_busy.
+  ParallelJobRunner *m_runner;
+  volatile LONG m_busy;
+
+  static BulkCopier s_instance;
+
+private:
+  // Do not allow copying objects.
+  BulkCopier(const BulkCopier &other);
+  BulkCopier &operator=(const BulkCopier &other);
+};
+
+#endif // __BULKCOPIER_H__
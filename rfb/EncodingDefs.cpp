@@ -27,16 +27,24 @@
 const char *const EncodingDefs::SIG_RAW = "RAW_____";
 const char *const EncodingDefs::SIG_COPYRECT = "COPYRECT";
 const char *const EncodingDefs::SIG_RRE = "RRE_____";
+const char *const EncodingDefs::SIG_CORRE = "CORRE___";
 const char *const EncodingDefs::SIG_HEXTILE = "HEXTILE_";
 const char *const EncodingDefs::SIG_TIGHT = "TIGHT___";
 const char *const EncodingDefs::SIG_ZRLE = "ZRLE____";
+const char *const EncodingDefs::SIG_H264 = "OPENH264";
+const char *const EncodingDefs::SIG_TILE_CACHE = "TILECACH";
 
 const char *const PseudoEncDefs::SIG_COMPR_LEVEL = "COMPRLVL";
 const char *const PseudoEncDefs::SIG_X_CURSOR = "X11CURSR";
 const char *const PseudoEncDefs::SIG_RICH_CURSOR = "RCHCURSR";
 const char *const PseudoEncDefs::SIG_POINTER_POS = "POINTPOS";
+const char *const PseudoEncDefs::SIG_CURSOR_CACHE = "CURSCACH";
 const char *const PseudoEncDefs::SIG_LAST_RECT = "LASTRECT";
 const char *const PseudoEncDefs::SIG_DESKTOP_SIZE = "NEWFBSIZ";
 const char *const PseudoEncDefs::SIG_QUALITY_LEVEL = "JPEGQLVL";
 const char* const PseudoEncDefs::SIG_DESKTOP_CONFIGURATION = "NEWFBCNF";
+const char *const PseudoEncDefs::SIG_SERVER_SCALE = "SRVSCALE";
+const char *const PseudoEncDefs::SIG_TRANSPORT_ZLIB = "TRNSZLIB";
+const char *const PseudoEncDefs::SIG_KEEP_FB_ON_RESIZE = "KEEPFBRS";
+const char *const PseudoEncDefs::SIG_LATENCY_PROBE = "LATPROBE";
 
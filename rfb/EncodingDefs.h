@@ -35,16 +35,24 @@ public:
   static const int RAW = 0;
   static const int COPYRECT = 1;
   static const int RRE = 2;
+  static const int CORRE = 4;
   static const int HEXTILE = 5;
   static const int TIGHT = 7;
   static const int ZRLE = 16;
+  // Open H.264 encoding, used for video regions only.
+  static const int H264 = 50;
+  // Tile cache encoding, refers to tiles cached by the client.
+  static const int TILE_CACHE = 51;
 
   static const char *const SIG_RAW;
   static const char *const SIG_COPYRECT;
   static const char *const SIG_RRE;
+  static const char *const SIG_CORRE;
   static const char *const SIG_HEXTILE;
   static const char *const SIG_TIGHT;
   static const char *const SIG_ZRLE;
+  static const char *const SIG_H264;
+  static const char *const SIG_TILE_CACHE;
 };
 
 //
@@ -68,11 +76,39 @@ public:
   static const int X_CURSOR = -240;
   static const int RICH_CURSOR = -239;
   static const int POINTER_POS = -232;
+  // Cursor shapes referred to by the slots of the client cursor cache.
+  static const int CURSOR_CACHE = -238;
 
+  // Ends the rectangles of a FramebufferUpdate whose header has
+  // LAST_RECT_COUNT as the number of rectangles, so that the server can
+  // send them as they are encoded.
   static const int LAST_RECT = -224;
+  static const unsigned short LAST_RECT_COUNT = 0xFFFF;
   static const int DESKTOP_SIZE = -223;
   static const int DESKTOP_CONFIGURATION = -222;
 
+  static const int FENCE = -312;
+  static const int CONTINUOUS_UPDATES = -313;
+
+  // Server-side scaling: the client gets the screen scaled down by 2, 4 or
+  // 8, its frame buffer size is changed with a desktop size update.
+  static const int SERVER_SCALE_1_2 = -410;
+  static const int SERVER_SCALE_1_4 = -409;
+  static const int SERVER_SCALE_1_8 = -408;
+
+  // Transport compression: the server answers with a TransportZlib message
+  // and compresses all the data it sends after it as one zlib stream.
+  static const int TRANSPORT_ZLIB = -420;
+
+  // The client keeps the pixels of its frame buffer which are still within
+  // it after a desktop size change, the server sends only the changed and
+  // the newly exposed ones. Announced by the server as a capability.
+  static const int KEEP_FB_ON_RESIZE = -421;
+
+  // Diagnostic end-to-end latency measurement, see LatencyProbeDefs.
+  // Announced by the server as a capability.
+  static const int LATENCY_PROBE = -422;
+
   static const int QUALITY_LEVEL_0 = -32;
   static const int QUALITY_LEVEL_1 = -31;
   static const int QUALITY_LEVEL_2 = -30;
@@ -88,10 +124,15 @@ public:
   static const char *const SIG_X_CURSOR;
   static const char *const SIG_RICH_CURSOR;
   static const char *const SIG_POINTER_POS;
+  static const char *const SIG_CURSOR_CACHE;
   static const char *const SIG_LAST_RECT;
   static const char *const SIG_DESKTOP_SIZE;
   static const char *const SIG_QUALITY_LEVEL;
   static const char* const SIG_DESKTOP_CONFIGURATION;
+  static const char *const SIG_SERVER_SCALE;
+  static const char *const SIG_TRANSPORT_ZLIB;
+  static const char *const SIG_KEEP_FB_ON_RESIZE;
+  static const char *const SIG_LATENCY_PROBE;
 };
 
 #endif // __RFB_ENCODING_DEFS_H_INCLUDED__
@@ -23,19 +23,27 @@
 //
 
 #include "FrameBuffer.h"
+#include "BulkCopier.h"
+#include "PixelFiller.h"
+#include "PixelRotator.h"
 #include <string.h>
+#include <malloc.h>
+
+#include "util/LargePages.h"
 
 FrameBuffer::FrameBuffer(void)
-: m_buffer(0)
+: m_buffer(0),
+  m_rowAlignment(1),
+  m_alignedAllocation(false),
+  m_largePageAllocation(false),
+  m_allocatedSize(0)
 {
   memset(&m_pixelFormat, 0, sizeof(m_pixelFormat));
 }
 
 FrameBuffer::~FrameBuffer(void)
 {
-  if (m_buffer != 0) {
-    delete []m_buffer;
-  }
+  releaseBuffer();
 }
 
 bool FrameBuffer::assignProperties(const FrameBuffer *srcFrameBuffer)
@@ -59,7 +67,6 @@ bool FrameBuffer::clone(const FrameBuffer *srcFrameBuffer)
 
 void FrameBuffer::setColor(UINT8 red, UINT8 green, UINT8 blue)
 {
-  size_t sizeInPixels = m_dimension.area();
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
   UINT32 redPix = (red * m_pixelFormat.redMax / 255) <<
                   m_pixelFormat.redShift;
@@ -69,33 +76,32 @@ void FrameBuffer::setColor(UINT8 red, UINT8 green, UINT8 blue)
                    m_pixelFormat.blueShift;
   UINT32 color = redPix | greenPix | bluePix;
 
-  UINT8 *endPixPtr = (UINT8 *)m_buffer + getBufferSize();
-  UINT8 *pixPtr = (UINT8 *)m_buffer;
-  for (; pixPtr <= endPixPtr - pixelSize; pixPtr += pixelSize) {
-    memcpy(pixPtr, &color, pixelSize);
-  }
+  PixelFiller::fillRows(m_buffer, getBytesPerRow(), color, m_dimension.width,
+                        m_dimension.height, pixelSize);
 }
 
 void FrameBuffer::fillRect(const Rect *dstRect, UINT32 color)
 {
-  Rect clipRect = m_dimension.getRect().intersection(dstRect);
+  fillRects(dstRect, &color, 1);
+}
 
+void FrameBuffer::fillRects(const Rect *dstRects, const UINT32 *colors,
+                            size_t count)
+{
+  Rect fbRect = m_dimension.getRect();
   int pixelSize = getBytesPerPixel();
-  size_t sizeLineFb = getBytesPerRow();
-  size_t sizeLineRect = clipRect.getWidth() * pixelSize;
+  int stride = getBytesPerRow();
 
-  // it's pointer to first line of rect
-  UINT8 *srcLinePtr = reinterpret_cast<UINT8 *>(getBufferPtr(clipRect.left, clipRect.top));
-
-  // it's pointer to pixel in first line
-  UINT8 *pixPtr = srcLinePtr;
-  for (int x = clipRect.left; x < clipRect.right; x++, pixPtr += pixelSize)
-    memcpy(pixPtr, &color, pixelSize);
-
-  // it's pointer to next line of rect
-  UINT8 *dstLinePtr = srcLinePtr + sizeLineFb;
-  for (int y = clipRect.top + 1; y < clipRect.bottom; y++, dstLinePtr += sizeLineFb)
-    memcpy(dstLinePtr, srcLinePtr, sizeLineRect);
+  for (size_t i = 0; i < count; i++) {
+    Rect clipRect = fbRect.intersection(&dstRects[i]);
+    if (clipRect.area() <= 0) {
+      continue;
+    }
+    UINT8 *dst = (UINT8 *)m_buffer + clipRect.top * stride +
+                 clipRect.left * pixelSize;
+    PixelFiller::fillRows(dst, stride, colors[i], clipRect.getWidth(),
+                          clipRect.getHeight(), pixelSize);
+  }
 }
 
 bool FrameBuffer::isEqualTo(const FrameBuffer *frameBuffer)
@@ -177,7 +183,8 @@ template<class PIXEL_T> bool FrameBuffer::overlayT(const Rect *dstRect,
   PIXEL_T *dstPixels = (PIXEL_T *)getBuffer();
   PIXEL_T *srcPixels = (PIXEL_T *)srcFrameBuffer->getBuffer();
   int srcWidth = srcFrameBuffer->getDimension().width;
-  int dstWidth = getDimension().width;
+  int srcStride = srcFrameBuffer->getBytesPerRow() / sizeof(PIXEL_T);
+  int dstStride = getBytesPerRow() / sizeof(PIXEL_T);
   size_t bytesPerRow = (srcWidth + 7) / 8;
   for (int iRow = srcClippedRect.top; iRow < srcClippedRect.bottom; iRow++) {
     for (int iCol = srcClippedRect.left; iCol < srcClippedRect.right; iCol++) {
@@ -186,7 +193,7 @@ template<class PIXEL_T> bool FrameBuffer::overlayT(const Rect *dstRect,
       if (andBit) {
         int iDstRow = dstClippedRect.top + iRow - srcY - srcClippedRect.top;
         int iDstCol = dstClippedRect.left + iCol - srcX - srcClippedRect.left;
-        dstPixels[iDstRow * dstWidth + iDstCol] = srcPixels[iRow * srcWidth + iCol];
+        dstPixels[iDstRow * dstStride + iDstCol] = srcPixels[iRow * srcStride + iCol];
       }
     }
   }
@@ -209,8 +216,8 @@ bool FrameBuffer::copyFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffe
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytes = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytes = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   int resultHeight = dstClippedRect.getHeight();
   int resultWidthBytes = dstClippedRect.getWidth() * pixelSize;
@@ -223,9 +230,8 @@ bool FrameBuffer::copyFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffe
                 + srcClippedRect.top * srcStrideBytes
                 + pixelSize * srcClippedRect.left;
 
-  for (int i = 0; i < resultHeight; i++, pdst += dstStrideBytes, psrc += srcStrideBytes) {
-    memcpy(pdst, psrc, resultWidthBytes);
-  }
+  BulkCopier::copyRows(pdst, dstStrideBytes, psrc, srcStrideBytes,
+                       resultWidthBytes, resultHeight);
 
   return true;
 }
@@ -245,8 +251,8 @@ bool FrameBuffer::copyFromRotated90(const Rect *dstRect, const FrameBuffer *srcF
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytesByX = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytesByX = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   Rect srcClippedRect, dstClippedRect;
 
@@ -274,13 +280,8 @@ bool FrameBuffer::copyFromRotated90(const Rect *dstRect, const FrameBuffer *srcF
                     + srcClippedRect.top * srcStrideBytes
                     + pixelSize * srcClippedRect.left;
 
-  for (int iRow = 0; iRow < resultHeight; iRow++, pBaseDst -= pixelSize, pBaseSrc += srcStrideBytes) {
-    UINT32 *pSrc = (UINT32 *)pBaseSrc;
-    UINT8 *pDst = pBaseDst;
-    for (int iCol = 0; iCol < resultWidth; iCol++, pSrc++, pDst += dstStrideBytesByX) {
-      *(UINT32 *)pDst = *pSrc;
-    }
-  }
+  PixelRotator::rotate90(pBaseSrc, srcStrideBytes, pBaseDst, dstStrideBytesByX,
+                         resultWidth, resultHeight);
 
   return true;
 }
@@ -294,8 +295,8 @@ bool FrameBuffer::copyFromRotated180(const Rect *dstRect, const FrameBuffer *src
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytesByX = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytesByX = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   Rect srcClippedRect, dstClippedRect;
 
@@ -325,13 +326,8 @@ bool FrameBuffer::copyFromRotated180(const Rect *dstRect, const FrameBuffer *src
     + srcClippedRect.top * srcStrideBytes
     + pixelSize * srcClippedRect.left;
 
-  for (int iRow = 0; iRow < resultHeight; iRow++, pBaseDst -= dstStrideBytesByX , pBaseSrc += srcStrideBytes) {
-    UINT32 *pSrc = (UINT32 *)pBaseSrc;
-    UINT32 *pDst = (UINT32 *)pBaseDst;
-    for (int iCol = 0; iCol < resultWidth; iCol++, pSrc++, pDst--) {
-      *(UINT32 *)pDst = *pSrc;
-    }
-  }
+  PixelRotator::rotate180(pBaseSrc, srcStrideBytes, pBaseDst, dstStrideBytesByX,
+                          resultWidth, resultHeight);
 
   return true;
 }
@@ -345,8 +341,8 @@ bool FrameBuffer::copyFromRotated270(const Rect *dstRect, const FrameBuffer *src
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytesByX = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytesByX = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   Rect srcClippedRect, dstClippedRect;
 
@@ -374,13 +370,8 @@ bool FrameBuffer::copyFromRotated270(const Rect *dstRect, const FrameBuffer *src
     + srcClippedRect.top * srcStrideBytes
     + pixelSize * srcClippedRect.left;
 
-  for (int iRow = 0; iRow < resultHeight; iRow++, pBaseDst += pixelSize, pBaseSrc += srcStrideBytes) {
-    UINT32 *pSrc = (UINT32 *)pBaseSrc;
-    UINT8 *pDst = pBaseDst;
-    for (int iCol = 0; iCol < resultWidth; iCol++, pSrc++, pDst -= dstStrideBytesByX) {
-      *(UINT32 *)pDst = *pSrc;
-    }
-  }
+  PixelRotator::rotate270(pBaseSrc, srcStrideBytes, pBaseDst, dstStrideBytesByX,
+                          resultWidth, resultHeight);
 
   return true;
 }
@@ -401,8 +392,8 @@ bool FrameBuffer::cmpFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffer
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytes = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytes = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   int resultHeight = dstClippedRect.getHeight();
   int resultWidthBytes = dstClippedRect.getWidth() * pixelSize;
@@ -435,7 +426,7 @@ void FrameBuffer::move(const Rect *dstRect, const int srcX, const int srcY)
 
   // Data copy
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int strideBytes = m_dimension.width * pixelSize;
+  int strideBytes = getBytesPerRow();
 
   int resultHeight = dstClippedRect.getHeight();
   int resultWidthBytes = dstClippedRect.getWidth() * pixelSize;
@@ -449,9 +440,20 @@ void FrameBuffer::move(const Rect *dstRect, const int srcX, const int srcY)
     psrc = (UINT8 *)m_buffer + srcClippedRect.top * strideBytes
            + pixelSize * srcClippedRect.left;
 
-    for (int i = 0; i < resultHeight; i++, pdst += strideBytes, psrc += strideBytes) {
-      memcpy(pdst, psrc, resultWidthBytes);
-    }
+    // Every source row is read before it is overwritten, so the rows may
+    // be copied in order but not in parallel.
+    BulkCopier::copyRows(pdst, strideBytes, psrc, strideBytes,
+                         resultWidthBytes, resultHeight, false);
+
+  } else if (srcClippedRect.top != dstClippedRect.top) {
+    // The same bottom-up.
+    pdst = (UINT8 *)m_buffer + (dstClippedRect.bottom - 1) * strideBytes
+           + pixelSize * dstClippedRect.left;
+    psrc = (UINT8 *)m_buffer + (srcClippedRect.bottom - 1) * strideBytes
+           + pixelSize * srcClippedRect.left;
+
+    BulkCopier::copyRows(pdst, -strideBytes, psrc, -strideBytes,
+                         resultWidthBytes, resultHeight, false);
 
   } else {
     // Pointers set to last string of the rectanles
@@ -478,6 +480,21 @@ bool FrameBuffer::setDimension(const Dimension *newDim)
   return resizeBuffer();
 }
 
+bool FrameBuffer::resizeKeepingContents(const Dimension *newDim)
+{
+  if (m_dimension.isEqualTo(newDim)) {
+    return true;
+  }
+  FrameBuffer oldFrameBuffer;
+  if (!oldFrameBuffer.clone(this) || !setDimension(newDim)) {
+    return false;
+  }
+  setColor(0, 0, 0);
+  Rect oldRect = oldFrameBuffer.getDimension().getRect();
+  Rect keptRect = oldRect.intersection(&m_dimension.getRect());
+  return copyFrom(&keptRect, &oldFrameBuffer, keptRect.left, keptRect.top);
+}
+
 void FrameBuffer::setEmptyDimension(const Rect *dimByRect)
 {
   m_dimension.setDim(dimByRect);
@@ -524,23 +541,69 @@ UINT8 FrameBuffer::getBytesPerPixel() const
 void *FrameBuffer::getBufferPtr(int x, int y) const
 {
   char *ptr = (char *)m_buffer;
-  ptr += (y * m_dimension.width + x) * getBytesPerPixel();
+  ptr += y * getBytesPerRow() + x * getBytesPerPixel();
 
   return (void *)ptr;
 }
 
 int FrameBuffer::getBufferSize() const
 { 
-  return (int)((UINT64)m_dimension.area() * m_pixelFormat.bitsPerPixel / 8);
+  return (int)((UINT64)m_dimension.height * getBytesPerRow());
 }
 
-bool FrameBuffer::resizeBuffer()
+bool FrameBuffer::setRowAlignment(int alignment)
+{
+  _ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+  if (alignment == m_rowAlignment) {
+    return true;
+  }
+  m_rowAlignment = alignment;
+  return resizeBuffer();
+}
+
+void FrameBuffer::releaseBuffer()
 {
   if (m_buffer != 0) {
-    delete []m_buffer;
+    MemAccount::resized(MEM_FRAME_BUFFERS, m_allocatedSize, 0);
+    if (m_largePageAllocation) {
+      LargePages::free(m_buffer);
+    } else if (m_alignedAllocation) {
+      _aligned_free(m_buffer);
+    } else {
+      delete [](UINT8 *)m_buffer;
+    }
+    m_buffer = 0;
+  }
+  m_allocatedSize = 0;
+  m_alignedAllocation = false;
+  m_largePageAllocation = false;
+}
+
+bool FrameBuffer::resizeBuffer()
+{
+  releaseBuffer();
+  // The buffers of at least one large page, the ones of big screens, go to
+  // large pages if they are enabled, the others would waste most of it.
+  size_t largePageSize = LargePages::getPageSize();
+  if (largePageSize != 0 && (size_t)getBufferSize() >= largePageSize) {
+    m_buffer = LargePages::alloc(getBufferSize());
+    m_largePageAllocation = m_buffer != 0;
+  }
+  if (m_largePageAllocation) {
+    // The pages are aligned far beyond any row alignment.
+  } else if (m_rowAlignment > 1) {
+    // Align the start of the buffer the same way as the rows so that every
+    // row starts on the boundary.
+    size_t size = getBufferSize() > 0 ? getBufferSize() : 1;
+    m_buffer = _aligned_malloc(size, m_rowAlignment);
+    m_alignedAllocation = m_buffer != 0;
+  } else {
+    m_buffer = new UINT8[getBufferSize()];
   }
-  if ((m_buffer = new UINT8[getBufferSize()]) == 0) {
+  if (m_buffer == 0) {
     return false;
   }
+  m_allocatedSize = getBufferSize();
+  MemAccount::resized(MEM_FRAME_BUFFERS, 0, m_allocatedSize);
   return true;
 }
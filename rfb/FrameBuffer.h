@@ -27,12 +27,17 @@
 
 #include "region/Dimension.h"
 #include "rfb/PixelFormat.h"
+#include "util/MemAccount.h"
 
 // FIXME: Move implementation to the .cpp file.
 
 class FrameBuffer
 {
 public:
+  // Row alignment suitable for buffers that are read by the encoders: every
+  // row starts on a cache line.
+  static const int CACHE_LINE_ALIGNMENT = 64;
+
   FrameBuffer(void);
   virtual ~FrameBuffer(void);
 
@@ -40,6 +45,11 @@ public:
   virtual bool clone(const FrameBuffer *srcFrameBuffer);
   virtual void setColor(UINT8 red, UINT8 green, UINT8 blue);
   virtual void fillRect(const Rect *dstRect, UINT32 color);
+  // Fills each of the count rectangles with its color, in order, as
+  // fillRect() does. The decoders fill all the subrectangles of a tile with
+  // one call.
+  virtual void fillRects(const Rect *dstRects, const UINT32 *colors,
+                         size_t count);
 
   // Return value: true - if equal
   //               false - if PixelFormats or size differs
@@ -89,6 +99,11 @@ public:
     return setDimension(&dim);
   }
 
+  // Changes the dimension keeping the pixels which are within both the old
+  // and the new one, at the same coordinates. The newly exposed pixels are
+  // black.
+  virtual bool resizeKeepingContents(const Dimension *newDim);
+
   // Sets dimension to the frame buffer without buffer resizing
   virtual void setEmptyDimension(const Rect *dimByRect);
 
@@ -112,7 +127,32 @@ public:
   // Return the number of bytes occupied by one pixel (can be 1, 2 or 4).
   virtual UINT8 getBytesPerPixel() const;
 
-  virtual void setBuffer(void *newBuffer) { m_buffer = newBuffer; }
+  // Sets the row alignment in bytes used for buffers allocated by this
+  // object from now on. The default of 1 keeps rows packed; any other value
+  // must be a power of two and pads every row so that each starts on such a
+  // boundary (64 matches a cache line). The buffer is reallocated if it is
+  // owned by this object, its content is lost.
+  // External code must not assume that the row stride equals the width:
+  // getBytesPerRow() and getBufferPtr() account for the padding.
+  virtual bool setRowAlignment(int alignment);
+  virtual inline int getRowAlignment() const { return m_rowAlignment; }
+
+  // Returns true if rows follow each other without padding, so the buffer
+  // may be treated as one contiguous image of getBufferSize() bytes.
+  virtual inline bool isPacked() const
+  {
+    return getBytesPerRow() == m_dimension.width * getBytesPerPixel();
+  }
+
+  virtual void setBuffer(void *newBuffer)
+  {
+    // The buffer is not owned and so not accounted.
+    MemAccount::resized(MEM_FRAME_BUFFERS, m_allocatedSize, 0);
+    m_allocatedSize = 0;
+    m_buffer = newBuffer;
+    m_alignedAllocation = false;
+    m_largePageAllocation = false;
+  }
   virtual inline void *getBuffer() const { return m_buffer; }
 
   // Return a pointer to the pixel data specified by the coordinates of that
@@ -122,11 +162,15 @@ public:
   virtual void *getBufferPtr(int x, int y) const;
 
   virtual inline int getBufferSize() const;
-  virtual inline int getBytesPerRow() const { return m_dimension.width *
-                                             m_pixelFormat.bitsPerPixel / 8; }
+  virtual inline int getBytesPerRow() const
+  {
+    int packed = m_dimension.width * m_pixelFormat.bitsPerPixel / 8;
+    return (packed + m_rowAlignment - 1) & ~(m_rowAlignment - 1);
+  }
 
 protected:
   bool resizeBuffer();
+  void releaseBuffer();
   void clipRect(const Rect *dstRect, const FrameBuffer *srcFrameBuffer,
                 const int srcX, const int srcY,
                 Rect *dstClippedRect, Rect *srcClippedRect);
@@ -143,6 +187,16 @@ protected:
 
   PixelFormat m_pixelFormat;
   void *m_buffer;
+
+  int m_rowAlignment;
+  // True if m_buffer came from _aligned_malloc() and must be released with
+  // _aligned_free().
+  bool m_alignedAllocation;
+  // True if m_buffer came from LargePages::alloc().
+  bool m_largePageAllocation;
+  // Size of the owned buffer accounted in MemAccount, 0 if the buffer is
+  // not owned.
+  size_t m_allocatedSize;
 };
 
 #endif // __FRAMEBUFFER_H__
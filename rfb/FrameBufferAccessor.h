@@ -0,0 +1,56 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __FRAMEBUFFERACCESSOR_H__
+#define __FRAMEBUFFERACCESSOR_H__
+
+#include "FrameBuffer.h"
+
+// Typed read access to the pixels of a frame buffer for code that walks
+// pixels of a known size. Hides the row stride, which is not necessarily
+// equal to the width (see FrameBuffer::setRowAlignment()).
+template<class PIXEL_T> class FrameBufferAccessor
+{
+public:
+  FrameBufferAccessor(const FrameBuffer *fb)
+  : m_pixels(static_cast<const PIXEL_T *>(fb->getBuffer())),
+    m_stride(fb->getBytesPerRow() / sizeof(PIXEL_T))
+  {
+    _ASSERT(fb->getBytesPerPixel() == sizeof(PIXEL_T));
+    _ASSERT(fb->getBytesPerRow() % sizeof(PIXEL_T) == 0);
+  }
+
+  // Returns the distance between two vertically adjacent pixels, in pixels.
+  inline int getStride() const { return m_stride; }
+
+  inline const PIXEL_T *getRow(int y) const { return m_pixels + y * m_stride; }
+  inline const PIXEL_T *getPtr(int x, int y) const { return getRow(y) + x; }
+  inline PIXEL_T getPixel(int x, int y) const { return getRow(y)[x]; }
+
+private:
+  const PIXEL_T *m_pixels;
+  int m_stride;
+};
+
+#endif // __FRAMEBUFFERACCESSOR_H__
@@ -28,5 +28,24 @@ const char *const Utf8CutTextDefs::CLIENT_CUT_TEXT_UTF8_SIG = "UTF8CUTC";
 const char *const Utf8CutTextDefs::SERVER_CUT_TEXT_UTF8_SIG = "UTF8CUTS";
 const char *const Utf8CutTextDefs::ENABLE_CUT_TEXT_UTF8_SIG = "UTF8CUTE";
 
+const char *const LazyCutTextDefs::ENABLE_CUT_TEXT_OFFERS_SIG = "LAZYCUTE";
+const char *const LazyCutTextDefs::CUT_TEXT_REQUEST_SIG = "LAZYCUTR";
+const char *const LazyCutTextDefs::CUT_TEXT_OFFER_SIG = "LAZYCUTO";
+const char *const LazyCutTextDefs::CUT_TEXT_CHUNK_SIG = "LAZYCUTC";
+
 const char *const EchoExtensionDefs::ECHO_REQUEST_SIG = "ECHOCREQ";
 const char *const EchoExtensionDefs::ECHO_RESPONSE_SIG = "ECHOSRES";
+
+const char *const TileHashesDefs::TILE_HASHES_SIG = "TILEHASH";
+
+const char *const DecodeFeedbackDefs::DECODE_FEEDBACK_SIG = "DECFEEDB";
+const char *const LatencyProbeDefs::LATENCY_REPORT_SIG = "LATREPRT";
+
+const char *const BulkChannelDefs::ENABLE_BULK_CHANNEL_SIG = "BULKCHEN";
+const char *const BulkChannelDefs::BULK_CHANNEL_TOKEN_SIG = "BULKCHTK";
+const char *const BulkChannelDefs::GREETING = "TVNBULK 001\n";
+
+const char *const MulticastDefs::ENABLE_MULTICAST_SIG = "MCASTENA";
+const char *const MulticastDefs::MULTICAST_RECEPTION_SIG = "MCASTREC";
+const char *const MulticastDefs::MULTICAST_REPAIR_SIG = "MCASTREP";
+const char *const MulticastDefs::MULTICAST_GROUP_SIG = "MCASTGRP";
@@ -37,9 +37,20 @@ public:
   static const UINT32 KEYBOARD_EVENT = 4;
   static const UINT32 POINTER_EVENT = 5;
   static const UINT32 CLIENT_CUT_TEXT = 6;
+  static const UINT32 ENABLE_CONTINUOUS_UPDATES = 150;
+  static const UINT32 CLIENT_FENCE = 248;
   static const UINT32 CLIENT_CUT_TEXT_UTF8 = 0xFC000200;
   static const UINT32 ENABLE_CUT_TEXT_UTF8 = 0xFC000201;
+  static const UINT32 ENABLE_CUT_TEXT_OFFERS = 0xFC000202;
+  static const UINT32 CUT_TEXT_REQUEST = 0xFC000203;
   static const UINT32 ECHO_REQUEST = 0xFC000300;
+  static const UINT32 TILE_HASHES = 0xFC000400;
+  static const UINT32 DECODE_FEEDBACK = 0xFC000600;
+  static const UINT32 ENABLE_BULK_CHANNEL = 0xFC000700;
+  static const UINT32 ENABLE_MULTICAST = 0xFC000800;
+  static const UINT32 MULTICAST_RECEPTION = 0xFC000801;
+  static const UINT32 MULTICAST_REPAIR = 0xFC000802;
+  static const UINT32 LATENCY_REPORT = 0xFC000900;
 };
 
 class ServerMsgDefs
@@ -49,8 +60,15 @@ public:
   static const UINT32 SET_COLOR_MAP_ENTRIES = 1;
   static const UINT32 BELL = 2;
   static const UINT32 SERVER_CUT_TEXT = 3;
+  static const UINT32 END_OF_CONTINUOUS_UPDATES = 150;
+  static const UINT32 SERVER_FENCE = 248;
   static const UINT32 SERVER_CUT_TEXT_UTF8 = 0xFC000200;
+  static const UINT32 CUT_TEXT_OFFER = 0xFC000201;
+  static const UINT32 CUT_TEXT_CHUNK = 0xFC000202;
   static const UINT32 ECHO_RESPONSE = 0xFC000300;
+  static const UINT32 TRANSPORT_ZLIB = 0xFC000500;
+  static const UINT32 BULK_CHANNEL_TOKEN = 0xFC000700;
+  static const UINT32 MULTICAST_GROUP = 0xFC000800;
 };
 
 class Utf8CutTextDefs
@@ -60,10 +78,201 @@ public:
     static const char *const SERVER_CUT_TEXT_UTF8_SIG;
     static const char *const ENABLE_CUT_TEXT_UTF8_SIG;
 };
+
+// Lazy delivery of the server clipboard. After the client has sent
+// EnableCutTextOffers (U32 type), the server announces each new clipboard
+// with CutTextOffer (U32 type, U32 serial, U32 length of the UTF-8 text)
+// instead of sending it. The client fetches the text when it needs it with
+// CutTextRequest (U32 type, U32 serial, U8 flags), and the server sends the
+// text in CutTextChunk messages (U32 type, U32 serial, U8 flags, U32 length
+// of the UTF-8 data, U32 length of the chunk data, data), which may be
+// interleaved with the other server messages.
+class LazyCutTextDefs
+{
+public:
+  static const char *const ENABLE_CUT_TEXT_OFFERS_SIG;
+  static const char *const CUT_TEXT_REQUEST_SIG;
+  static const char *const CUT_TEXT_OFFER_SIG;
+  static const char *const CUT_TEXT_CHUNK_SIG;
+
+  // Flag of CutTextRequest: the chunks may be compressed.
+  static const UINT8 ACCEPT_ZLIB = 1 << 0;
+
+  // Flags of CutTextChunk. Each compressed chunk is a complete zlib stream.
+  // A cancelled transfer (the clipboard has changed since the offer) ends
+  // with an empty chunk and is followed by a new offer.
+  static const UINT8 CHUNK_ZLIB = 1 << 0;
+  static const UINT8 CHUNK_LAST = 1 << 1;
+  static const UINT8 CHUNK_CANCELLED = 1 << 2;
+
+  // Maximal length of the UTF-8 data of a chunk.
+  static const UINT32 MAX_CHUNK_LENGTH = 65536;
+};
+// Flags and limits of the Fence message, which is the same in both
+// directions.
+class FenceDefs
+{
+public:
+  static const UINT32 BLOCK_BEFORE = 1 << 0;
+  static const UINT32 BLOCK_AFTER = 1 << 1;
+  static const UINT32 SYNC_NEXT = 1 << 2;
+  static const UINT32 REQUEST = 0x80000000;
+
+  static const UINT8 MAX_PAYLOAD_LENGTH = 64;
+};
+
 class EchoExtensionDefs
 {
 public:
   static const char *const ECHO_REQUEST_SIG;
   static const char *const ECHO_RESPONSE_SIG;
 };
+
+// Resynchronization of a reconnected client. Before its first update
+// request, the client which still has the pixels of a previous session
+// sends TileHashes (U32 type, U16 tile size, U16 width, U16 height,
+// U32 number of tiles, U64 hash of each tile). The tiles cover the frame
+// buffer row by row, the ones at the right and bottom edges are cut; each
+// hash is made by TileHasher from the pixels in the client pixel format.
+// The server then sends the whole screen except the tiles which have the
+// same hashes on its side.
+class TileHashesDefs
+{
+public:
+  static const char *const TILE_HASHES_SIG;
+
+  static const UINT16 MIN_TILE_SIZE = 16;
+  static const UINT16 MAX_TILE_SIZE = 256;
+  static const UINT32 MAX_TILES = 65536;
+};
+
+// Cost of the updates for the client. About once in REPORT_INTERVAL ms, the
+// client which receives updates sends DecodeFeedback (U32 type, U32 length
+// of the period in ms, U32 CPU time of the decoding thread in us, U32 time
+// spent presenting the updates in us, U32 number of frames presented,
+// U32 number of decoded frames never presented, U8 number of encodings,
+// then for each encoding S32 encoding type, U32 number of rectangles,
+// U32 number of pixels in thousands, U32 time spent in the decoder in us).
+// The time spent in a decoder includes waiting for the data of the
+// rectangle, so it only compares the encodings on the same connection.
+class DecodeFeedbackDefs
+{
+public:
+  static const char *const DECODE_FEEDBACK_SIG;
+
+  static const UINT32 REPORT_INTERVAL = 1000;
+  static const UINT8 MAX_ENCODINGS = 32;
+};
+
+// Second connection for the file transfer and the clipboard chunks, so
+// that they do not hold the updates and the input behind them. The client
+// sends EnableBulkChannel (U32 type) and the server answers with
+// BulkChannelToken (U32 type, TOKEN_LENGTH bytes of the token). The client
+// then opens a new connection to the same port and answers the version of
+// the server with GREETING instead of its own version. The server sends
+// U32 status (RESULT_OK, or RESULT_FAILED followed by U32 length and the
+// reason), the tunnel is negotiated as in the Tight security type, the
+// client sends the token and the server sends the status again. From then
+// on the connection carries the file transfer messages in both directions
+// and CutTextChunk from the server. A token is accepted once, from the
+// address of the client it was given to.
+class BulkChannelDefs
+{
+public:
+  static const char *const ENABLE_BULK_CHANNEL_SIG;
+  static const char *const BULK_CHANNEL_TOKEN_SIG;
+  static const char *const GREETING;
+
+  static const UINT32 GREETING_LENGTH = 12;
+  static const UINT32 TOKEN_LENGTH = 16;
+
+  static const UINT32 RESULT_OK = 0;
+  static const UINT32 RESULT_FAILED = 1;
+};
+
+// Distribution of the screen by UDP multicast to many clients at once. The
+// client sends EnableMulticast (U32 type) and the server answers with
+// MulticastGroup (U32 type, U32 IPv4 address of the group, U16 port). The
+// server then sends datagrams to the group while any client is interested,
+// that is from its EnableMulticast to the end of its connection; each starts with U32 MAGIC, U32 stream id, U32 sequence number, U16 width
+// and U16 height of the frame buffer, and U8 kind:
+// - TILE is followed by U16 x, y, width and height of a rectangle and one
+//   complete zlib stream of its pixels, row by row, in the format of
+//   StandardPixelFormatFactory::create32bppPixelFormat() (little endian);
+// - HEARTBEAT, sent every HEARTBEAT_INTERVAL ms when there are no tiles,
+//   has nothing more, its sequence number is the one of the next tile.
+// The tiles are numbered one by one; the stream id changes with the size
+// of the frame buffer. The client which receives the stream sends
+// MulticastReception (U32 type, U8 1), and the server stops sending it the
+// changed pixels, which come by the group. A client which has not got a
+// datagram for RECEPTION_TIMEOUT ms sends MulticastReception (U32 type,
+// U8 0), and the server sends it the whole screen and the changes again.
+// The lost tiles are asked for with MulticastRepair (U32 type, U32 stream
+// id, U32 first sequence number, U16 number of tiles, 0 for the whole
+// screen), the server sends their rectangles as normal updates.
+class MulticastDefs
+{
+public:
+  static const char *const ENABLE_MULTICAST_SIG;
+  static const char *const MULTICAST_RECEPTION_SIG;
+  static const char *const MULTICAST_REPAIR_SIG;
+  static const char *const MULTICAST_GROUP_SIG;
+
+  static const UINT32 MAGIC = 0x54564D43; // "TVMC"
+  static const UINT8 TILE = 0;
+  static const UINT8 HEARTBEAT = 1;
+
+  static const size_t HEADER_SIZE = 17;
+  static const size_t TILE_HEADER_SIZE = 8;
+  // Datagrams fit into an Ethernet frame, a lost fragment would lose all.
+  static const size_t MAX_DATAGRAM_SIZE = 1400;
+
+  static const unsigned int HEARTBEAT_INTERVAL = 500;
+  static const unsigned int RECEPTION_TIMEOUT = 3000;
+};
+
+// End-to-end latency measurement. When the client has the LatencyProbe
+// pseudo-encoding in SetEncodings, the server ends each FramebufferUpdate
+// (before LastRect, if used) with a LatencyProbe pseudo-rectangle (all
+// zeros) followed by U32 sequence number, U32 capture time, U32 encode time
+// and U32 network time. The capture time is from the capture of the oldest
+// change of the update to the start of the update, 0 if unknown; the encode
+// time is from the start of the update to the probe; the network time is
+// the latest one-way estimate, 0 if unknown. After presenting the update,
+// the client sends LatencyReport (U32 type, U32 sequence number of the
+// probe, U32 decode time from the update header to the probe, U32 present
+// time from the probe to the end of drawing). The server estimates the
+// network time as half of the time from sending the probe to receiving the
+// report, less the present time. All times are in microseconds.
+class LatencyProbeDefs
+{
+public:
+  static const char *const LATENCY_REPORT_SIG;
+
+  // Stages of the latency, in the order of the frame pipeline.
+  static const int STAGE_CAPTURE = 0;
+  static const int STAGE_ENCODE = 1;
+  static const int STAGE_NETWORK = 2;
+  static const int STAGE_DECODE = 3;
+  static const int STAGE_PRESENT = 4;
+  static const int STAGE_COUNT = 5;
+
+  // Maximal number of probes waiting for the reports on the server.
+  static const size_t MAX_PENDING_PROBES = 64;
+};
+
+// Compression of the whole server to client stream, for the clients which
+// use encodings without compression of their own (Raw, RRE, Hextile). When
+// the client has the TransportZlib pseudo-encoding in SetEncodings, the
+// server sends TransportZlib (U32 type) once, and every byte it sends after
+// the message is a part of one zlib stream which never ends. The stream is
+// sync-flushed at the end of each batch of messages, so the client can
+// inflate whatever it has received without waiting for more data.
+class TransportZlibDefs
+{
+public:
+  // zlib level used when the client has not asked for a compression level
+  // with the CompressionLevel pseudo-encoding. Level 0 is raised to 1.
+  static const int DEFAULT_LEVEL = 1;
+};
 #endif // __RFB_MSG_DEFS_H_INCLUDED__
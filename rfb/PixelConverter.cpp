@@ -28,6 +28,8 @@
 
 PixelConverter::PixelConverter(void)
 : m_convertMode(NO_CONVERT),
+  m_tables(0),
+  m_simdRowFunc(0),
   m_dstFrameBuffer(0)
 {
 }
@@ -35,6 +37,33 @@ PixelConverter::PixelConverter(void)
 PixelConverter::~PixelConverter(void)
 {
   reset();
+  releaseTables();
+}
+
+PixelConverter::PixelConverter(const PixelConverter &other)
+: m_convertMode(NO_CONVERT),
+  m_tables(0),
+  m_simdRowFunc(0),
+  m_dstFrameBuffer(0)
+{
+  *this = other;
+}
+
+PixelConverter &PixelConverter::operator=(const PixelConverter &other)
+{
+  if (this != &other) {
+    reset();
+    releaseTables();
+    m_convertMode = other.m_convertMode;
+    m_simdRowFunc = other.m_simdRowFunc;
+    m_simdParams = other.m_simdParams;
+    m_srcFormat = other.m_srcFormat;
+    m_dstFormat = other.m_dstFormat;
+    if (other.m_tables != 0) {
+      acquireTables(&m_dstFormat, &m_srcFormat);
+    }
+  }
+  return *this;
 }
 
 void PixelConverter::convert(const Rect *rect, FrameBuffer *dstFb,
@@ -45,26 +74,29 @@ void PixelConverter::convert(const Rect *rect, FrameBuffer *dstFb,
   } else {
     int rectHeight = rect->getHeight();
     int rectWidth = rect->getWidth();
-    int fbWidth = dstFb->getDimension().width;
     PixelFormat dstPf = dstFb->getPixelFormat();
     PixelFormat srcPf = srcFb->getPixelFormat();
 
     UINT32 dstPixelSize = dstPf.bitsPerPixel / 8;
     UINT32 srcPixelSize = srcPf.bitsPerPixel / 8;
 
-    // FIXME: Make FrameBuffer do the math.
-    UINT8 *dstPixP = (UINT8 *)dstFb->getBuffer() +
-                     (fbWidth * rect->top + rect->left) * dstPixelSize;
-    UINT8 *srcPixP = (UINT8 *)srcFb->getBuffer() +
-                     (fbWidth * rect->top + rect->left) * srcPixelSize;
+    // The frame buffers may have different row strides (one of them can be
+    // padded), so each side steps by its own stride.
+    int dstStride = dstFb->getBytesPerRow();
+    int srcStride = srcFb->getBytesPerRow();
+    int dstSkip = dstStride - rectWidth * dstPixelSize;
+    int srcSkip = srcStride - rectWidth * srcPixelSize;
+
+    UINT8 *dstPixP = (UINT8 *)dstFb->getBufferPtr(rect->left, rect->top);
+    UINT8 *srcPixP = (UINT8 *)srcFb->getBufferPtr(rect->left, rect->top);
     if (m_convertMode == CONVERT_FROM_16) {
       for (int i = 0; i < rectHeight; i++,
-           dstPixP += (fbWidth - rectWidth) * dstPixelSize,
-           srcPixP += (fbWidth - rectWidth) * srcPixelSize) {
+           dstPixP += dstSkip,
+           srcPixP += srcSkip) {
         for (int j = 0; j < rectWidth; j++,
                                        dstPixP += dstPixelSize,
                                        srcPixP += srcPixelSize) {
-          UINT32 dstPixel = m_hexBitsTable[*(UINT16 *)srcPixP];
+          UINT32 dstPixel = m_tables->hexBitsTable[*(UINT16 *)srcPixP];
           if (dstPixelSize == 4) {
             *(UINT32 *)dstPixP = (UINT32)dstPixel;
           } else if (dstPixelSize == 2) {
@@ -74,24 +106,33 @@ void PixelConverter::convert(const Rect *rect, FrameBuffer *dstFb,
           }
         }
       }
+    } else if (m_convertMode == CONVERT_FROM_32 && m_simdRowFunc != 0) {
+      for (int i = 0; i < rectHeight; i++,
+           dstPixP += dstStride,
+           srcPixP += srcStride) {
+        m_simdRowFunc(srcPixP, dstPixP, rectWidth, &m_simdParams);
+      }
     } else if (m_convertMode == CONVERT_FROM_32) {
       bool bigEndianDiffs = dstPf.bigEndian != srcPf.bigEndian;
+      const UINT32 *redTable = &m_tables->redTable.front();
+      const UINT32 *grnTable = &m_tables->grnTable.front();
+      const UINT32 *bluTable = &m_tables->bluTable.front();
       UINT32 srcRedMax = srcPf.redMax;
       UINT32 srcGrnMax = srcPf.greenMax;
       UINT32 srcBluMax = srcPf.blueMax;
 
       for (int i = 0; i < rectHeight; i++,
-           dstPixP += (fbWidth - rectWidth) * dstPixelSize,
-           srcPixP += (fbWidth - rectWidth) * srcPixelSize) {
+           dstPixP += dstSkip,
+           srcPixP += srcSkip) {
         for (int j = 0; j < rectWidth; j++,
                                        dstPixP += dstPixelSize,
                                        srcPixP += srcPixelSize) {
-          UINT32 dstPixel = m_redTable[*(UINT32 *)srcPixP >>
-                                       srcPf.redShift & srcRedMax] |
-                            m_grnTable[*(UINT32 *)srcPixP >>
-                                       srcPf.greenShift & srcGrnMax] |
-                            m_bluTable[*(UINT32 *)srcPixP >>
-                                       srcPf.blueShift & srcBluMax];
+          UINT32 dstPixel = redTable[*(UINT32 *)srcPixP >>
+                                     srcPf.redShift & srcRedMax] |
+                            grnTable[*(UINT32 *)srcPixP >>
+                                     srcPf.greenShift & srcGrnMax] |
+                            bluTable[*(UINT32 *)srcPixP >>
+                                     srcPf.blueShift & srcBluMax];
           if (dstPixelSize == 4) {
             *(UINT32 *)dstPixP = dstPixel;
             if (bigEndianDiffs) {
@@ -125,6 +166,7 @@ PixelConverter::convert(const Rect *rect, const FrameBuffer *srcFb)
   if (m_dstFrameBuffer == 0) {
     // No frame buffer allocated - construct new one from the scratch.
     m_dstFrameBuffer = new FrameBuffer;
+    m_dstFrameBuffer->setRowAlignment(FrameBuffer::CACHE_LINE_ALIGNMENT);
     m_dstFrameBuffer->setProperties(&fbSize, &m_dstFormat);
   } else if (!m_dstFrameBuffer->getDimension().isEqualTo(&fbSize)) {
     // Frame buffer is allocated but its size it wrong - just resize it.
@@ -139,6 +181,16 @@ PixelConverter::convert(const Rect *rect, const FrameBuffer *srcFb)
   return m_dstFrameBuffer;
 }
 
+size_t PixelConverter::getBufferSize() const
+{
+  return m_dstFrameBuffer != 0 ? m_dstFrameBuffer->getBufferSize() : 0;
+}
+
+void PixelConverter::releaseBuffer()
+{
+  reset();
+}
+
 void PixelConverter::reset()
 {
   // Deallocate the framebuffer.
@@ -154,15 +206,21 @@ void PixelConverter::setPixelFormats(const PixelFormat *dstPf,
   if (!srcPf->isEqualTo(&m_srcFormat) || !dstPf->isEqualTo(&m_dstFormat)) {
     // Reset both translation tables and the internal frame buffer.
     reset();
+    releaseTables();
+    m_simdRowFunc = 0;
 
     if (srcPf->isEqualTo(dstPf)) {
       m_convertMode = NO_CONVERT;
     } else if (srcPf->bitsPerPixel == 16) { // 16 bit -> N
       m_convertMode = CONVERT_FROM_16;
-      fillHexBitsTable(dstPf, srcPf);
+      acquireTables(dstPf, srcPf);
     } else if (srcPf->bitsPerPixel == 32) { // 32 bit -> N
       m_convertMode = CONVERT_FROM_32;
-      fill32BitsTable(dstPf, srcPf);
+      // The tables are only needed where there is no SIMD converter.
+      m_simdRowFunc = SimdPixelConverter::select(dstPf, srcPf, &m_simdParams);
+      if (m_simdRowFunc == 0) {
+        acquireTables(dstPf, srcPf);
+      }
     }
 
     m_srcFormat = *srcPf;
@@ -180,75 +238,22 @@ size_t PixelConverter::getDstBitsPerPixel() const
   return m_dstFormat.bitsPerPixel;
 }
 
-void PixelConverter::fillHexBitsTable(const PixelFormat *dstPf,
-                                      const PixelFormat *srcPf)
+PixelFormat PixelConverter::getDstPixelFormat() const
 {
-  m_hexBitsTable.resize(65536);
-
-  UINT32 dstRedMax = dstPf->redMax;
-  UINT32 dstGrnMax = dstPf->greenMax;
-  UINT32 dstBluMax = dstPf->blueMax;
-
-  UINT32 dstRedShift = dstPf->redShift;
-  UINT32 dstGrnShift = dstPf->greenShift;
-  UINT32 dstBluShift = dstPf->blueShift;
-
-  UINT32 srcRedMax = srcPf->redMax;
-  UINT32 srcGrnMax = srcPf->greenMax;
-  UINT32 srcBluMax = srcPf->blueMax;
-
-  UINT32 srcRedMask = srcRedMax << srcPf->redShift;
-  UINT32 srcGrnMask = srcGrnMax << srcPf->greenShift;
-  UINT32 srcBluMask = srcBluMax << srcPf->blueShift;
-
-  for (UINT32 i = 0; i < 65536; i++) {
-    // Get source color component
-    UINT32 srcRed = (i & srcRedMask) >> srcPf->redShift;
-    UINT32 srcGrn = (i & srcGrnMask) >> srcPf->greenShift;
-    UINT32 srcBlu = (i & srcBluMask) >> srcPf->blueShift;
-
-    UINT32 dstRed = (srcRed * dstRedMax / srcRedMax) << dstRedShift;
-    UINT32 dstGrn = (srcGrn * dstGrnMax / srcGrnMax) << dstGrnShift;
-    UINT32 dstBlu = (srcBlu * dstBluMax / srcBluMax) << dstBluShift;
-    m_hexBitsTable[i] = dstRed | dstGrn | dstBlu;
-    if (dstPf->bigEndian != srcPf->bigEndian) {
-      if (dstPf->bitsPerPixel == 32) {
-        m_hexBitsTable[i] = rotateUint32(m_hexBitsTable[i]);
-      }
-      else if (dstPf->bitsPerPixel == 16) {
-        m_hexBitsTable[i] = (m_hexBitsTable[i] & 0xff) << 8 | (m_hexBitsTable[i] & 0xff00) >> 8;
-      }
-    }
-  }
+  return m_dstFormat;
 }
 
-void PixelConverter::fill32BitsTable(const PixelFormat *dstPf,
-                                     const PixelFormat *srcPf)
+void PixelConverter::acquireTables(const PixelFormat *dstPf,
+                                   const PixelFormat *srcPf)
 {
-  UINT32 dstRedMax = dstPf->redMax;
-  UINT32 dstGrnMax = dstPf->greenMax;
-  UINT32 dstBluMax = dstPf->blueMax;
-
-  UINT32 dstRedShift = dstPf->redShift;
-  UINT32 dstGrnShift = dstPf->greenShift;
-  UINT32 dstBluShift = dstPf->blueShift;
-
-  UINT32 srcRedMax = srcPf->redMax;
-  UINT32 srcGrnMax = srcPf->greenMax;
-  UINT32 srcBluMax = srcPf->blueMax;
-
-  m_redTable.resize(srcRedMax + 1);
-  m_grnTable.resize(srcGrnMax + 1);
-  m_bluTable.resize(srcBluMax + 1);
+  m_tables = PixelTableCache::getInstance()->acquire(dstPf, srcPf);
+}
 
-  for (UINT32 i = 0; i <= srcRedMax; i++) {
-    m_redTable[i] = ((i * dstRedMax + srcRedMax / 2) / srcRedMax) << dstRedShift;
-  }
-  for (UINT32 i = 0; i <= srcGrnMax; i++) {
-    m_grnTable[i] = ((i * dstGrnMax + srcGrnMax / 2) / srcGrnMax) << dstGrnShift;
-  }
-  for (UINT32 i = 0; i <= srcBluMax; i++) {
-    m_bluTable[i] = ((i * dstBluMax + srcBluMax / 2) / srcBluMax) << dstBluShift;
+void PixelConverter::releaseTables()
+{
+  if (m_tables != 0) {
+    PixelTableCache::getInstance()->release(m_tables);
+    m_tables = 0;
   }
 }
 
@@ -26,6 +26,8 @@
 #define __RFB_PIXEL_CONVERTER_H_INCLUDED__
 
 #include "FrameBuffer.h"
+#include "SimdPixelConverter.h"
+#include "PixelTableCache.h"
 #include "region/Point.h"
 
 class PixelConverter
@@ -34,6 +36,11 @@ public:
   PixelConverter(void);
   virtual ~PixelConverter(void);
 
+  // A copy shares the conversion tables of the original, the internal
+  // frame buffer is not copied.
+  PixelConverter(const PixelConverter &other);
+  PixelConverter &operator=(const PixelConverter &other);
+
   // Convert pixels for the specified `rect' from `srcFb' to `dstFb'.
   // The pixel formats of `srcFb' and `dstFb' must be identical to the formats
   // set by the most recent setPixelFormats() call. The source and destination
@@ -67,11 +74,23 @@ public:
   // Return the number of bits per pixel from the destination pixel format.
   virtual size_t getDstBitsPerPixel() const;
 
+  // Return the destination pixel format.
+  virtual PixelFormat getDstPixelFormat() const;
+
+  // Return the size in bytes of the internal frame buffer used by the
+  // two-argument version of convert(), and free it. It is allocated again
+  // by the next call to that function.
+  size_t getBufferSize() const;
+  void releaseBuffer();
+
 protected:
   void reset();
 
-  void fillHexBitsTable(const PixelFormat *dstPf, const PixelFormat *srcPf);
-  void fill32BitsTable(const PixelFormat *dstPf, const PixelFormat *srcPf);
+  // Takes the tables for the formats from PixelTableCache, or gives them
+  // back.
+  void acquireTables(const PixelFormat *dstPf, const PixelFormat *srcPf);
+  void releaseTables();
+
   UINT32 rotateUint32(UINT32 value) const;
 
   enum ConvertMode
@@ -82,10 +101,15 @@ protected:
   };
 
   ConvertMode m_convertMode;
-  std::vector<UINT32> m_hexBitsTable;
-  std::vector<UINT32> m_redTable;
-  std::vector<UINT32> m_grnTable;
-  std::vector<UINT32> m_bluTable;
+  // Translation tables shared with the other converters of the same
+  // formats, 0 if no conversion is needed or the SIMD converter is used.
+  const PixelTableCache::Tables *m_tables;
+
+  // SIMD row converter selected by setPixelFormats() for the most common
+  // CONVERT_FROM_32 cases (0 if the table-based conversion should be used),
+  // and its parameters.
+  SimdPixelConverter::RowFunc m_simdRowFunc;
+  SimdConvertParams m_simdParams;
 
   PixelFormat m_srcFormat;
   PixelFormat m_dstFormat;
@@ -0,0 +1,142 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PixelDownscaler.h"
+#include "util/CpuFeatures.h"
+
+#include <crtdbg.h>
+#include <stddef.h>
+#include <string.h>
+#include <emmintrin.h>
+
+bool PixelDownscaler::isValidFactor(int factor)
+{
+  return factor == 2 || factor == 4 || factor == 8;
+}
+
+void PixelDownscaler::downscale(const FrameBuffer *src, FrameBuffer *dst,
+                                const Rect *dstRect, int factor)
+{
+  _ASSERT(isValidFactor(factor));
+  _ASSERT(src->getBytesPerPixel() == dst->getBytesPerPixel());
+  if (dstRect->isEmpty()) {
+    return;
+  }
+  const UINT8 *srcPtr = (const UINT8 *)src->getBufferPtr(dstRect->left * factor,
+                                                         dstRect->top * factor);
+  UINT8 *dstPtr = (UINT8 *)dst->getBufferPtr(dstRect->left, dstRect->top);
+  int srcStride = (int)src->getBytesPerRow();
+  int dstStride = (int)dst->getBytesPerRow();
+  int width = dstRect->getWidth();
+  int height = dstRect->getHeight();
+
+  size_t bytesPerPixel = dst->getBytesPerPixel();
+  if (bytesPerPixel != 4) {
+    sample(srcPtr, srcStride, dstPtr, dstStride, width, height, factor,
+           bytesPerPixel);
+  } else if (CpuFeatures::hasSse2()) {
+    boxFilterSse2(srcPtr, srcStride, dstPtr, dstStride, width, height, factor);
+  } else {
+    boxFilterScalar(srcPtr, srcStride, dstPtr, dstStride, width, height, factor);
+  }
+}
+
+void PixelDownscaler::boxFilterScalar(const UINT8 *src, int srcStride,
+                                      UINT8 *dst, int dstStride,
+                                      int dstWidth, int dstHeight, int factor)
+{
+  int shift = getShift(factor) * 2;
+  unsigned int round = 1 << (shift - 1);
+  for (int y = 0; y < dstHeight; y++) {
+    const UINT8 *srcRow = src + (ptrdiff_t)y * factor * srcStride;
+    UINT8 *dstRow = dst + (ptrdiff_t)y * dstStride;
+    for (int x = 0; x < dstWidth; x++) {
+      const UINT8 *block = srcRow + x * factor * 4;
+      for (int c = 0; c < 4; c++) {
+        unsigned int sum = 0;
+        for (int r = 0; r < factor; r++) {
+          const UINT8 *p = block + (ptrdiff_t)r * srcStride + c;
+          for (int k = 0; k < factor; k++) {
+            sum += p[k * 4];
+          }
+        }
+        dstRow[x * 4 + c] = (UINT8)((sum + round) >> shift);
+      }
+    }
+  }
+}
+
+void PixelDownscaler::boxFilterSse2(const UINT8 *src, int srcStride,
+                                    UINT8 *dst, int dstStride,
+                                    int dstWidth, int dstHeight, int factor)
+{
+  int shift = getShift(factor) * 2;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16((short)(1 << (shift - 1)));
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  for (int y = 0; y < dstHeight; y++) {
+    const UINT8 *srcRow = src + (ptrdiff_t)y * factor * srcStride;
+    UINT32 *dstRow = (UINT32 *)(dst + (ptrdiff_t)y * dstStride);
+    for (int x = 0; x < dstWidth; x++) {
+      const UINT8 *block = srcRow + x * factor * 4;
+      // Pairs of pixels are summed in 16-bit lanes, the two halves are
+      // added at the end. 8 x 8 x 255 still fits in them.
+      __m128i acc = zero;
+      for (int r = 0; r < factor; r++) {
+        const UINT8 *p = block + (ptrdiff_t)r * srcStride;
+        for (int k = 0; k < factor; k += 2) {
+          __m128i pair = _mm_loadl_epi64((const __m128i *)(p + k * 4));
+          acc = _mm_add_epi16(acc, _mm_unpacklo_epi8(pair, zero));
+        }
+      }
+      acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 8));
+      acc = _mm_srl_epi16(_mm_add_epi16(acc, round), count);
+      dstRow[x] = (UINT32)_mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+    }
+  }
+}
+
+void PixelDownscaler::sample(const UINT8 *src, int srcStride,
+                             UINT8 *dst, int dstStride,
+                             int dstWidth, int dstHeight, int factor,
+                             size_t bytesPerPixel)
+{
+  for (int y = 0; y < dstHeight; y++) {
+    const UINT8 *srcRow = src + (ptrdiff_t)y * factor * srcStride;
+    UINT8 *dstRow = dst + (ptrdiff_t)y * dstStride;
+    for (int x = 0; x < dstWidth; x++) {
+      memcpy(dstRow + x * bytesPerPixel,
+             srcRow + x * factor * bytesPerPixel, bytesPerPixel);
+    }
+  }
+}
+
+int PixelDownscaler::getShift(int factor)
+{
+  int shift = 0;
+  while ((1 << shift) < factor) {
+    shift++;
+  }
+  return shift;
+}
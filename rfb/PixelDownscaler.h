@@ -0,0 +1,72 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_PIXEL_DOWNSCALER_H_INCLUDED__
+#define __RFB_PIXEL_DOWNSCALER_H_INCLUDED__
+
+#include "util/inttypes.h"
+#include "rfb/FrameBuffer.h"
+
+//
+// PixelDownscaler shrinks frame buffers by 2, 4 or 8 for the clients that
+// ask the server to scale the screen down. Each destination pixel of the
+// 32-bit formats is the rounded average of its factor x factor source
+// block, channel by channel (a box filter), that is computed in SSE2
+// registers four channels at a time. Pixels of other sizes cannot be
+// averaged bytewise, the top left pixel of each block is taken for them.
+//
+
+class PixelDownscaler
+{
+public:
+  // Returns true if the factor is one of the supported ones.
+  static bool isValidFactor(int factor);
+
+  // Fills the rectangle of dst (in dst coordinates) from the rectangle of
+  // src that is factor times larger. Both frame buffers must have the same
+  // pixel format, the source rectangle must be inside src.
+  static void downscale(const FrameBuffer *src, FrameBuffer *dst,
+                        const Rect *dstRect, int factor);
+
+private:
+  // Box filter of 32-bit pixels, dstWidth x dstHeight pixels of the
+  // destination are made. Strides are in bytes.
+  static void boxFilterScalar(const UINT8 *src, int srcStride,
+                              UINT8 *dst, int dstStride,
+                              int dstWidth, int dstHeight, int factor);
+  static void boxFilterSse2(const UINT8 *src, int srcStride,
+                            UINT8 *dst, int dstStride,
+                            int dstWidth, int dstHeight, int factor);
+
+  // Takes the top left pixel of every block.
+  static void sample(const UINT8 *src, int srcStride,
+                     UINT8 *dst, int dstStride,
+                     int dstWidth, int dstHeight, int factor,
+                     size_t bytesPerPixel);
+
+  // log2 of the factor.
+  static int getShift(int factor);
+};
+
+#endif // __RFB_PIXEL_DOWNSCALER_H_INCLUDED__
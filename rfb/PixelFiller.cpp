@@ -0,0 +1,154 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PixelFiller.h"
+#include "util/CpuFeatures.h"
+
+#include <string.h>
+#include <emmintrin.h>
+
+void PixelFiller::fillSpan(void *dst, UINT32 color, size_t count,
+                           size_t bytesPerPixel)
+{
+  fillRows(dst, 0, color, count, 1, bytesPerPixel);
+}
+
+void PixelFiller::fillRows(void *dst, int stride, UINT32 color, size_t width,
+                           int numRows, size_t bytesPerPixel)
+{
+  if (width == 0 || numRows <= 0) {
+    return;
+  }
+  UINT8 *dstBytes = (UINT8 *)dst;
+  UINT32 pattern = replicate(color, bytesPerPixel);
+  size_t length = width * bytesPerPixel;
+  bool sse2 = CpuFeatures::hasSse2();
+
+  if (sse2 && length * numRows >= STREAMING_MIN_BYTES &&
+      ((size_t)dstBytes % bytesPerPixel) == 0 && stride % bytesPerPixel == 0) {
+    streamRows(dstBytes, stride, pattern, length, numRows);
+    return;
+  }
+  if (pattern == (pattern & 0xFF) * 0x01010101) {
+    fillRowsMemset(dstBytes, stride, (UINT8)pattern, length, numRows);
+    return;
+  }
+  if (sse2 && length >= MIN_SSE2_LENGTH) {
+    fillRowsSse2(dstBytes, stride, pattern, length, numRows);
+    return;
+  }
+  if (bytesPerPixel == 2) {
+    fillRowsPlain<UINT16>(dstBytes, stride, (UINT16)pattern, width, numRows);
+  } else {
+    fillRowsPlain<UINT32>(dstBytes, stride, pattern, width, numRows);
+  }
+}
+
+UINT32 PixelFiller::replicate(UINT32 color, size_t bytesPerPixel)
+{
+  if (bytesPerPixel == 1) {
+    return (color & 0xFF) * 0x01010101;
+  } else if (bytesPerPixel == 2) {
+    return (color & 0xFFFF) * 0x00010001;
+  }
+  return color;
+}
+
+template<class PIXEL_T> void PixelFiller::fillRowsPlain(UINT8 *dst, int stride,
+                                                        PIXEL_T color,
+                                                        size_t width,
+                                                        int numRows)
+{
+  for (int y = 0; y < numRows; y++, dst += stride) {
+    PIXEL_T *p = (PIXEL_T *)dst;
+    for (size_t x = 0; x < width; x++) {
+      p[x] = color;
+    }
+  }
+}
+
+void PixelFiller::fillRowsMemset(UINT8 *dst, int stride, UINT8 value,
+                                 size_t length, int numRows)
+{
+  // Adjacent rows are one block.
+  if ((size_t)stride == length) {
+    memset(dst, value, length * numRows);
+    return;
+  }
+  for (int y = 0; y < numRows; y++, dst += stride) {
+    memset(dst, value, length);
+  }
+}
+
+void PixelFiller::fillRowsSse2(UINT8 *dst, int stride, UINT32 pattern,
+                               size_t length, int numRows)
+{
+  // 16 bytes hold a whole number of pixels, so the last store, which ends
+  // at the end of the row, starts with the first byte of a pixel too.
+  __m128i value = _mm_set1_epi32((int)pattern);
+  for (int y = 0; y < numRows; y++, dst += stride) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      _mm_storeu_si128((__m128i *)(dst + i), value);
+    }
+    if (i < length) {
+      _mm_storeu_si128((__m128i *)(dst + length - 16), value);
+    }
+  }
+}
+
+void PixelFiller::streamRows(UINT8 *dst, int stride, UINT32 pattern,
+                             size_t length, int numRows)
+{
+  // The rows start on pixel boundaries, so the aligned part of a row
+  // starts on one too and takes the pattern as it is.
+  __m128i value = _mm_set1_epi32((int)pattern);
+  UINT8 bytes[16];
+  _mm_storeu_si128((__m128i *)bytes, value);
+
+  for (int y = 0; y < numRows; y++, dst += stride) {
+    UINT8 *p = dst;
+    size_t left = length;
+    size_t head = (16 - ((size_t)p & 15)) & 15;
+    if (head > left) {
+      head = left;
+    }
+    memcpy(p, bytes, head);
+    p += head;
+    left -= head;
+    for (; left >= 64; left -= 64, p += 64) {
+      _mm_stream_si128((__m128i *)p, value);
+      _mm_stream_si128((__m128i *)(p + 16), value);
+      _mm_stream_si128((__m128i *)(p + 32), value);
+      _mm_stream_si128((__m128i *)(p + 48), value);
+    }
+    for (; left >= 16; left -= 16, p += 16) {
+      _mm_stream_si128((__m128i *)p, value);
+    }
+    memcpy(p, bytes, left);
+  }
+  // Non-temporal stores are weakly ordered, make them visible to other
+  // threads before the fill is reported as done.
+  _mm_sfence();
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __PIXELFILLER_H__
+#define __PIXELFILLER_H__
+
+#include <stddef.h>
+
+#include "util/inttypes.h"
+
+//
+// PixelFiller fills spans and rectangles of 1, 2 or 4-byte pixels with a
+// color. Spans shorter than 16 bytes are stored pixel by pixel, longer ones
+// 16 bytes at a time with SSE2, the last store overlapping the previous one
+// instead of a tail loop. Colors made of one repeated byte go to memset().
+// Areas of several megabytes are filled with non-temporal stores, as the
+// large copies of BulkCopier are.
+//
+
+class PixelFiller
+{
+public:
+  // Fills count pixels at dst with the color.
+  static void fillSpan(void *dst, UINT32 color, size_t count,
+                       size_t bytesPerPixel);
+
+  // Fills numRows rows of width pixels, the first one at dst and each next
+  // one stride bytes after the previous one.
+  static void fillRows(void *dst, int stride, UINT32 color, size_t width,
+                       int numRows, size_t bytesPerPixel);
+
+  // Spans shorter than this number of bytes are filled without SSE2.
+  static const size_t MIN_SSE2_LENGTH = 16;
+  // Areas from this size are filled with non-temporal stores.
+  static const size_t STREAMING_MIN_BYTES = 2 * 1024 * 1024;
+
+protected:
+  // Returns the color repeated over 32 bits.
+  static UINT32 replicate(UINT32 color, size_t bytesPerPixel);
+
+  template<class PIXEL_T> static void fillRowsPlain(UINT8 *dst, int stride,
+                                                    PIXEL_T color,
+                                                    size_t width,
+                                                    int numRows);
+  static void fillRowsMemset(UINT8 *dst, int stride, UINT8 value,
+                             size_t length, int numRows);
+  // Length is in bytes, at least MIN_SSE2_LENGTH. The pattern is the
+  // replicated color.
+  static void fillRowsSse2(UINT8 *dst, int stride, UINT32 pattern,
+                           size_t length, int numRows);
+  // The rows must start on pixel boundaries.
+  static void streamRows(UINT8 *dst, int stride, UINT32 pattern,
+                         size_t length, int numRows);
+};
+
+#endif // __PIXELFILLER_H__
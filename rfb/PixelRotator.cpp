@@ -0,0 +1,162 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PixelRotator.h"
+#include "util/CpuFeatures.h"
+
+#include <stddef.h>
+#include <emmintrin.h>
+
+void PixelRotator::rotate90(const UINT8 *src, int srcStride,
+                            UINT8 *dst, int dstStride, int width, int height)
+{
+  int blockWidth = 0;
+  int blockHeight = 0;
+  if (CpuFeatures::hasSse2()) {
+    blockWidth = width & ~3;
+    blockHeight = height & ~3;
+    rotateQuarterSse2(src, srcStride, dst, dstStride,
+                      blockWidth, blockHeight, true);
+  }
+  // Columns on the right of the blocks.
+  copyScalar(src + blockWidth * 4, srcStride,
+             dst + (ptrdiff_t)blockWidth * dstStride, -4, dstStride,
+             width - blockWidth, blockHeight);
+  // Rows below the blocks.
+  copyScalar(src + (ptrdiff_t)blockHeight * srcStride, srcStride,
+             dst - blockHeight * 4, -4, dstStride,
+             width, height - blockHeight);
+}
+
+void PixelRotator::rotate180(const UINT8 *src, int srcStride,
+                             UINT8 *dst, int dstStride, int width, int height)
+{
+  int blockWidth = 0;
+  if (CpuFeatures::hasSse2()) {
+    blockWidth = width & ~3;
+    rotate180Sse2(src, srcStride, dst, dstStride, blockWidth, height);
+  }
+  copyScalar(src + blockWidth * 4, srcStride,
+             dst - blockWidth * 4, -dstStride, -4,
+             width - blockWidth, height);
+}
+
+void PixelRotator::rotate270(const UINT8 *src, int srcStride,
+                             UINT8 *dst, int dstStride, int width, int height)
+{
+  int blockWidth = 0;
+  int blockHeight = 0;
+  if (CpuFeatures::hasSse2()) {
+    blockWidth = width & ~3;
+    blockHeight = height & ~3;
+    rotateQuarterSse2(src, srcStride, dst, dstStride,
+                      blockWidth, blockHeight, false);
+  }
+  copyScalar(src + blockWidth * 4, srcStride,
+             dst - (ptrdiff_t)blockWidth * dstStride, 4, -dstStride,
+             width - blockWidth, blockHeight);
+  copyScalar(src + (ptrdiff_t)blockHeight * srcStride, srcStride,
+             dst + blockHeight * 4, 4, -dstStride,
+             width, height - blockHeight);
+}
+
+void PixelRotator::copyScalar(const UINT8 *src, int srcStride,
+                              UINT8 *dst, int rowStep, int colStep,
+                              int width, int height)
+{
+  for (int r = 0; r < height; r++, src += srcStride, dst += rowStep) {
+    const UINT32 *pSrc = (const UINT32 *)src;
+    UINT8 *pDst = dst;
+    for (int c = 0; c < width; c++, pSrc++, pDst += colStep) {
+      *(UINT32 *)pDst = *pSrc;
+    }
+  }
+}
+
+void PixelRotator::rotateQuarterSse2(const UINT8 *src, int srcStride,
+                                     UINT8 *dst, int dstStride,
+                                     int width, int height, bool clockwise)
+{
+  // A source pixel in row r and column c goes to the destination row
+  // c (clockwise) or -c (counterclockwise), in the column -r or r.
+  int colStep = clockwise ? dstStride : -dstStride;
+
+  for (int tileTop = 0; tileTop < height; tileTop += TILE_SIZE) {
+    int tileBottom = tileTop + TILE_SIZE < height ? tileTop + TILE_SIZE : height;
+    for (int tileLeft = 0; tileLeft < width; tileLeft += TILE_SIZE) {
+      int tileRight = tileLeft + TILE_SIZE < width ? tileLeft + TILE_SIZE : width;
+      for (int r = tileTop; r < tileBottom; r += 4) {
+        const UINT8 *pSrc = src + (ptrdiff_t)r * srcStride + tileLeft * 4;
+        // Address of the destination pixel of the source pixel (r, c), for
+        // clockwise turns of the pixel (r + 3, c) as the lanes are reversed.
+        UINT8 *pDst = dst + (ptrdiff_t)tileLeft * colStep +
+                      (clockwise ? -(r + 3) * 4 : r * 4);
+        for (int c = tileLeft; c < tileRight; c += 4,
+             pSrc += 16, pDst += 4 * colStep) {
+          __m128i v0 = _mm_loadu_si128((const __m128i *)pSrc);
+          __m128i v1 = _mm_loadu_si128((const __m128i *)(pSrc + srcStride));
+          __m128i v2 = _mm_loadu_si128((const __m128i *)(pSrc + 2 * srcStride));
+          __m128i v3 = _mm_loadu_si128((const __m128i *)(pSrc + 3 * srcStride));
+
+          // Transpose the block, tK gets column K of the source rows.
+          __m128i a0 = _mm_unpacklo_epi32(v0, v1);
+          __m128i a1 = _mm_unpacklo_epi32(v2, v3);
+          __m128i a2 = _mm_unpackhi_epi32(v0, v1);
+          __m128i a3 = _mm_unpackhi_epi32(v2, v3);
+          __m128i t0 = _mm_unpacklo_epi64(a0, a1);
+          __m128i t1 = _mm_unpackhi_epi64(a0, a1);
+          __m128i t2 = _mm_unpacklo_epi64(a2, a3);
+          __m128i t3 = _mm_unpackhi_epi64(a2, a3);
+          if (clockwise) {
+            t0 = _mm_shuffle_epi32(t0, _MM_SHUFFLE(0, 1, 2, 3));
+            t1 = _mm_shuffle_epi32(t1, _MM_SHUFFLE(0, 1, 2, 3));
+            t2 = _mm_shuffle_epi32(t2, _MM_SHUFFLE(0, 1, 2, 3));
+            t3 = _mm_shuffle_epi32(t3, _MM_SHUFFLE(0, 1, 2, 3));
+          }
+          _mm_storeu_si128((__m128i *)pDst, t0);
+          _mm_storeu_si128((__m128i *)(pDst + colStep), t1);
+          _mm_storeu_si128((__m128i *)(pDst + 2 * colStep), t2);
+          _mm_storeu_si128((__m128i *)(pDst + 3 * colStep), t3);
+        }
+      }
+    }
+  }
+}
+
+void PixelRotator::rotate180Sse2(const UINT8 *src, int srcStride,
+                                 UINT8 *dst, int dstStride,
+                                 int width, int height)
+{
+  // Both sides are walked row by row, so there is nothing to tile.
+  for (int r = 0; r < height; r++, src += srcStride, dst -= dstStride) {
+    const UINT8 *pSrc = src;
+    // The block of the last source pixel of four.
+    UINT8 *pDst = dst - 12;
+    for (int c = 0; c < width; c += 4, pSrc += 16, pDst -= 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)pSrc);
+      v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+      _mm_storeu_si128((__m128i *)pDst, v);
+    }
+  }
+}
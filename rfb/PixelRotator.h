@@ -0,0 +1,74 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_PIXEL_ROTATOR_H_INCLUDED__
+#define __RFB_PIXEL_ROTATOR_H_INCLUDED__
+
+#include "util/inttypes.h"
+
+//
+// PixelRotator copies rectangles of 32-bit pixels turning them by 90, 180
+// or 270 degrees, for the capture of rotated displays. The quarter turns
+// transpose 4x4 pixel blocks in SSE2 registers and walk the rectangle in
+// square tiles small enough for the first level cache, so that neither the
+// reads nor the writes go through memory one scattered pixel at a time.
+//
+// The source is width x height pixels starting at src. dst points to the
+// destination pixel that receives the first source pixel, which is the top
+// right corner of the destination rectangle for 90 degrees, the bottom right
+// one for 180 degrees and the bottom left one for 270 degrees. Strides are
+// in bytes.
+//
+
+class PixelRotator
+{
+public:
+  static void rotate90(const UINT8 *src, int srcStride,
+                       UINT8 *dst, int dstStride, int width, int height);
+  static void rotate180(const UINT8 *src, int srcStride,
+                        UINT8 *dst, int dstStride, int width, int height);
+  static void rotate270(const UINT8 *src, int srcStride,
+                        UINT8 *dst, int dstStride, int width, int height);
+
+private:
+  // Copies the pixels one by one. The source pixel in row r and column c
+  // goes to dst + r * rowStep + c * colStep.
+  static void copyScalar(const UINT8 *src, int srcStride,
+                         UINT8 *dst, int rowStep, int colStep,
+                         int width, int height);
+
+  // Quarter turn of the part of the rectangle made of whole 4x4 blocks.
+  // clockwise selects 90 degrees, otherwise 270.
+  static void rotateQuarterSse2(const UINT8 *src, int srcStride,
+                                UINT8 *dst, int dstStride,
+                                int width, int height, bool clockwise);
+  static void rotate180Sse2(const UINT8 *src, int srcStride,
+                            UINT8 *dst, int dstStride,
+                            int width, int height);
+
+  // Side of the square tiles in pixels.
+  static const int TILE_SIZE = 32;
+};
+
+#endif // __RFB_PIXEL_ROTATOR_H_INCLUDED__
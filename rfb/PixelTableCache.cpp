@@ -0,0 +1,178 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PixelTableCache.h"
+#include "thread/AutoLock.h"
+
+#include <crtdbg.h>
+
+PixelTableCache PixelTableCache::s_instance;
+
+PixelTableCache::PixelTableCache()
+{
+}
+
+PixelTableCache::~PixelTableCache()
+{
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    delete m_entries[i].tables;
+  }
+}
+
+PixelTableCache *PixelTableCache::getInstance()
+{
+  return &s_instance;
+}
+
+const PixelTableCache::Tables *
+PixelTableCache::acquire(const PixelFormat *dstPf, const PixelFormat *srcPf)
+{
+  AutoLock al(&m_lock);
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    Entry *entry = &m_entries[i];
+    if (entry->dstPf.isEqualTo(dstPf) && entry->srcPf.isEqualTo(srcPf)) {
+      entry->refCount++;
+      return entry->tables;
+    }
+  }
+
+  // The tables are built under the lock, the other users of the same
+  // formats would wait for them anyway.
+  Entry entry;
+  entry.dstPf = *dstPf;
+  entry.srcPf = *srcPf;
+  entry.tables = new Tables;
+  entry.refCount = 1;
+  if (srcPf->bitsPerPixel == 16) {
+    fillHexBitsTable(entry.tables, dstPf, srcPf);
+  } else {
+    _ASSERT(srcPf->bitsPerPixel == 32);
+    fill32BitsTable(entry.tables, dstPf, srcPf);
+  }
+  m_entries.push_back(entry);
+  return entry.tables;
+}
+
+void PixelTableCache::release(const Tables *tables)
+{
+  AutoLock al(&m_lock);
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    if (m_entries[i].tables == tables) {
+      if (--m_entries[i].refCount == 0) {
+        delete m_entries[i].tables;
+        m_entries.erase(m_entries.begin() + i);
+      }
+      return;
+    }
+  }
+  _ASSERT(false);
+}
+
+void PixelTableCache::fillHexBitsTable(Tables *tables,
+                                       const PixelFormat *dstPf,
+                                       const PixelFormat *srcPf)
+{
+  std::vector<UINT32> &hexBitsTable = tables->hexBitsTable;
+  hexBitsTable.resize(65536);
+
+  UINT32 dstRedMax = dstPf->redMax;
+  UINT32 dstGrnMax = dstPf->greenMax;
+  UINT32 dstBluMax = dstPf->blueMax;
+
+  UINT32 dstRedShift = dstPf->redShift;
+  UINT32 dstGrnShift = dstPf->greenShift;
+  UINT32 dstBluShift = dstPf->blueShift;
+
+  UINT32 srcRedMax = srcPf->redMax;
+  UINT32 srcGrnMax = srcPf->greenMax;
+  UINT32 srcBluMax = srcPf->blueMax;
+
+  UINT32 srcRedMask = srcRedMax << srcPf->redShift;
+  UINT32 srcGrnMask = srcGrnMax << srcPf->greenShift;
+  UINT32 srcBluMask = srcBluMax << srcPf->blueShift;
+
+  for (UINT32 i = 0; i < 65536; i++) {
+    // Get source color component
+    UINT32 srcRed = (i & srcRedMask) >> srcPf->redShift;
+    UINT32 srcGrn = (i & srcGrnMask) >> srcPf->greenShift;
+    UINT32 srcBlu = (i & srcBluMask) >> srcPf->blueShift;
+
+    UINT32 dstRed = (srcRed * dstRedMax / srcRedMax) << dstRedShift;
+    UINT32 dstGrn = (srcGrn * dstGrnMax / srcGrnMax) << dstGrnShift;
+    UINT32 dstBlu = (srcBlu * dstBluMax / srcBluMax) << dstBluShift;
+    hexBitsTable[i] = dstRed | dstGrn | dstBlu;
+    if (dstPf->bigEndian != srcPf->bigEndian) {
+      if (dstPf->bitsPerPixel == 32) {
+        hexBitsTable[i] = rotateUint32(hexBitsTable[i]);
+      }
+      else if (dstPf->bitsPerPixel == 16) {
+        hexBitsTable[i] = (hexBitsTable[i] & 0xff) << 8 | (hexBitsTable[i] & 0xff00) >> 8;
+      }
+    }
+  }
+}
+
+void PixelTableCache::fill32BitsTable(Tables *tables,
+                                      const PixelFormat *dstPf,
+                                      const PixelFormat *srcPf)
+{
+  UINT32 dstRedMax = dstPf->redMax;
+  UINT32 dstGrnMax = dstPf->greenMax;
+  UINT32 dstBluMax = dstPf->blueMax;
+
+  UINT32 dstRedShift = dstPf->redShift;
+  UINT32 dstGrnShift = dstPf->greenShift;
+  UINT32 dstBluShift = dstPf->blueShift;
+
+  UINT32 srcRedMax = srcPf->redMax;
+  UINT32 srcGrnMax = srcPf->greenMax;
+  UINT32 srcBluMax = srcPf->blueMax;
+
+  tables->redTable.resize(srcRedMax + 1);
+  tables->grnTable.resize(srcGrnMax + 1);
+  tables->bluTable.resize(srcBluMax + 1);
+
+  for (UINT32 i = 0; i <= srcRedMax; i++) {
+    tables->redTable[i] = ((i * dstRedMax + srcRedMax / 2) / srcRedMax) << dstRedShift;
+  }
+  for (UINT32 i = 0; i <= srcGrnMax; i++) {
+    tables->grnTable[i] = ((i * dstGrnMax + srcGrnMax / 2) / srcGrnMax) << dstGrnShift;
+  }
+  for (UINT32 i = 0; i <= srcBluMax; i++) {
+    tables->bluTable[i] = ((i * dstBluMax + srcBluMax / 2) / srcBluMax) << dstBluShift;
+  }
+}
+
+UINT32 PixelTableCache::rotateUint32(UINT32 value)
+{
+  UINT32 result;
+  char *src = (char *)&value;
+  char *dst = (char *)&result;
+  dst[0] = src[3];
+  dst[1] = src[2];
+  dst[2] = src[1];
+  dst[3] = src[0];
+
+  return result;
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_PIXEL_TABLE_CACHE_H_INCLUDED__
+#define __RFB_PIXEL_TABLE_CACHE_H_INCLUDED__
+
+#include <vector>
+
+#include "util/inttypes.h"
+#include "thread/LocalMutex.h"
+#include "PixelFormat.h"
+
+// Process-wide cache of the tables PixelConverter translates pixels by.
+// The tables depend on the source and the destination pixel formats only,
+// so all the converters of the same pair of formats (the clients of one
+// desktop with the same pixel format) share one copy of them instead of
+// each building its own. The 16-bit table alone takes 256 KB.
+//
+// The tables are built by the first acquire() of their formats and freed
+// by the release() of the last user. They are never changed in between,
+// so the users read them without locking.
+class PixelTableCache
+{
+public:
+  struct Tables
+  {
+    // Destination pixels by the 16-bit source pixels.
+    std::vector<UINT32> hexBitsTable;
+    // Destination color components by the 32-bit source ones.
+    std::vector<UINT32> redTable;
+    std::vector<UINT32> grnTable;
+    std::vector<UINT32> bluTable;
+  };
+
+  static PixelTableCache *getInstance();
+
+  // Returns the tables converting pixels of srcPf to dstPf. The source
+  // must be 16 or 32 bits per pixel. Each acquire() must be paired with
+  // release().
+  const Tables *acquire(const PixelFormat *dstPf, const PixelFormat *srcPf);
+  void release(const Tables *tables);
+
+private:
+  PixelTableCache();
+  ~PixelTableCache();
+
+  static void fillHexBitsTable(Tables *tables, const PixelFormat *dstPf,
+                               const PixelFormat *srcPf);
+  static void fill32BitsTable(Tables *tables, const PixelFormat *dstPf,
+                              const PixelFormat *srcPf);
+  static UINT32 rotateUint32(UINT32 value);
+
+  struct Entry
+  {
+    PixelFormat dstPf;
+    PixelFormat srcPf;
+    Tables *tables;
+    int refCount;
+  };
+
+  std::vector<Entry> m_entries;
+  LocalMutex m_lock;
+
+  static PixelTableCache s_instance;
+};
+
+#endif // __RFB_PIXEL_TABLE_CACHE_H_INCLUDED__
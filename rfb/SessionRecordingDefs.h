@@ -0,0 +1,66 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_SESSION_RECORDING_DEFS_H_INCLUDED__
+#define __RFB_SESSION_RECORDING_DEFS_H_INCLUDED__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+
+// Layout of the session recordings made by the server from the RFB stream
+// sent to a client.
+//
+// The recording starts with MAGIC and VERSION, followed by records appended
+// one after another. A record has a header of RECORD_HEADER_SIZE bytes: the
+// UINT8 type, the UINT32 length of the data following the header and the
+// UINT64 time in milliseconds since the recording start. All the numbers are
+// big endian, as in RFB. The record data are:
+//   FORMAT   - UINT16 width and height of the framebuffer, then the pixel
+//              format as in the SetPixelFormat message (16 bytes);
+//   UPDATE   - server messages exactly as sent to the client;
+//   KEYFRAME - UINT16 width and height, then the framebuffer pixels in the
+//              current pixel format, row by row. The server encoders are
+//              restarted right after the keyframe, so that the updates
+//              following it can be decoded from the keyframe alone.
+//
+// Each keyframe gets an entry in the index file, named as the recording
+// with INDEX_SUFFIX: the UINT64 time and the UINT64 offset of the keyframe
+// record in the recording, INDEX_ENTRY_SIZE bytes per entry.
+class SessionRecordingDefs
+{
+public:
+  static const UINT32 MAGIC = 0x54564e52; // "TVNR"
+  static const UINT32 VERSION = 1;
+  static const size_t FILE_HEADER_SIZE = 8;
+
+  static const UINT8 FORMAT = 1;
+  static const UINT8 UPDATE = 2;
+  static const UINT8 KEYFRAME = 3;
+  static const size_t RECORD_HEADER_SIZE = 13;
+
+  static const size_t INDEX_ENTRY_SIZE = 16;
+  static const TCHAR *const INDEX_SUFFIX;
+};
+
+#endif // __RFB_SESSION_RECORDING_DEFS_H_INCLUDED__
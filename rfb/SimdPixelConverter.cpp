@@ -0,0 +1,258 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SimdPixelConverter.h"
+#include "util/CpuFeatures.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+SimdPixelConverter::RowFunc
+SimdPixelConverter::select(const PixelFormat *dstPf,
+                           const PixelFormat *srcPf,
+                           SimdConvertParams *params)
+{
+  if (srcPf->bitsPerPixel != 32 ||
+      srcPf->redMax != 255 || srcPf->greenMax != 255 ||
+      srcPf->blueMax != 255) {
+    return 0;
+  }
+  if (dstPf->bitsPerPixel != 8 && dstPf->bitsPerPixel != 16 &&
+      dstPf->bitsPerPixel != 32) {
+    return 0;
+  }
+  // Products of 8-bit components and maximum values must fit in 16 bits.
+  if (dstPf->redMax == 0 || dstPf->redMax > 255 ||
+      dstPf->greenMax == 0 || dstPf->greenMax > 255 ||
+      dstPf->blueMax == 0 || dstPf->blueMax > 255) {
+    return 0;
+  }
+
+  params->srcShift[0] = srcPf->redShift;
+  params->srcShift[1] = srcPf->greenShift;
+  params->srcShift[2] = srcPf->blueShift;
+  params->dstMax[0] = dstPf->redMax;
+  params->dstMax[1] = dstPf->greenMax;
+  params->dstMax[2] = dstPf->blueMax;
+  params->dstShift[0] = dstPf->redShift;
+  params->dstShift[1] = dstPf->greenShift;
+  params->dstShift[2] = dstPf->blueShift;
+  params->dstPixelSize = dstPf->bitsPerPixel / 8;
+  params->swapBytes = dstPf->bitsPerPixel != 8 &&
+                      dstPf->bigEndian != srcPf->bigEndian;
+
+  if (CpuFeatures::hasAvx2()) {
+    return convertRowAvx2;
+  }
+  if (CpuFeatures::hasSse2()) {
+    return convertRowSse2;
+  }
+  return 0;
+}
+
+void SimdPixelConverter::convertRowScalar(const UINT8 *src, UINT8 *dst,
+                                          int count,
+                                          const SimdConvertParams *params)
+{
+  for (int i = 0; i < count; i++, src += 4, dst += params->dstPixelSize) {
+    UINT32 srcPixel = *(const UINT32 *)src;
+    UINT32 dstPixel = 0;
+    for (int c = 0; c < 3; c++) {
+      UINT32 comp = srcPixel >> params->srcShift[c] & 0xFF;
+      dstPixel |= (comp * params->dstMax[c] + 127) / 255 << params->dstShift[c];
+    }
+    if (params->dstPixelSize == 4) {
+      if (params->swapBytes) {
+        dstPixel = dstPixel >> 24 | (dstPixel >> 8 & 0xFF00) |
+                   (dstPixel << 8 & 0xFF0000) | dstPixel << 24;
+      }
+      *(UINT32 *)dst = dstPixel;
+    } else if (params->dstPixelSize == 2) {
+      if (params->swapBytes) {
+        dstPixel = (dstPixel & 0xFF) << 8 | (dstPixel >> 8 & 0xFF);
+      }
+      *(UINT16 *)dst = (UINT16)dstPixel;
+    } else {
+      *dst = (UINT8)dstPixel;
+    }
+  }
+}
+
+//
+// Convert four 32-bit pixels. Each component is extracted, scaled as
+// (comp * dstMax + 127) / 255 and moved to its destination position. The
+// division by 255 is computed exactly as (x + 1 + (x >> 8)) >> 8, which is
+// valid for all x below 65536.
+//
+static inline __m128i convert4Sse2(__m128i pixels, const __m128i *srcShift,
+                                   const __m128i *dstMax,
+                                   const __m128i *dstShift)
+{
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  const __m128i round = _mm_set1_epi32(127);
+  const __m128i one = _mm_set1_epi32(1);
+
+  __m128i result = _mm_setzero_si128();
+  for (int c = 0; c < 3; c++) {
+    __m128i comp = _mm_and_si128(_mm_srl_epi32(pixels, srcShift[c]), mask);
+    __m128i x = _mm_add_epi32(_mm_mullo_epi16(comp, dstMax[c]), round);
+    x = _mm_add_epi32(_mm_add_epi32(x, one), _mm_srli_epi32(x, 8));
+    x = _mm_srli_epi32(x, 8);
+    result = _mm_or_si128(result, _mm_sll_epi32(x, dstShift[c]));
+  }
+  return result;
+}
+
+static inline __m128i swap16Sse2(__m128i v)
+{
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i swap32Sse2(__m128i v)
+{
+  v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+  return swap16Sse2(v);
+}
+
+// Pack 32-bit values below 65536 to unsigned 16-bit ones (SSE2 has signed
+// saturation only, so the values are sign-extended from 16 bits first).
+static inline __m128i pack16Sse2(__m128i a, __m128i b)
+{
+  a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+  b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+  return _mm_packs_epi32(a, b);
+}
+
+void SimdPixelConverter::convertRowSse2(const UINT8 *src, UINT8 *dst,
+                                        int count,
+                                        const SimdConvertParams *params)
+{
+  __m128i srcShift[3], dstMax[3], dstShift[3];
+  for (int c = 0; c < 3; c++) {
+    srcShift[c] = _mm_cvtsi32_si128(params->srcShift[c]);
+    dstMax[c] = _mm_set1_epi32(params->dstMax[c]);
+    dstShift[c] = _mm_cvtsi32_si128(params->dstShift[c]);
+  }
+
+  int pixelSize = params->dstPixelSize;
+  bool swap = params->swapBytes;
+  int i = 0;
+  for (; i + 8 <= count; i += 8, src += 32, dst += 8 * pixelSize) {
+    __m128i a = convert4Sse2(_mm_loadu_si128((const __m128i *)src),
+                             srcShift, dstMax, dstShift);
+    __m128i b = convert4Sse2(_mm_loadu_si128((const __m128i *)(src + 16)),
+                             srcShift, dstMax, dstShift);
+    if (pixelSize == 4) {
+      if (swap) {
+        a = swap32Sse2(a);
+        b = swap32Sse2(b);
+      }
+      _mm_storeu_si128((__m128i *)dst, a);
+      _mm_storeu_si128((__m128i *)(dst + 16), b);
+    } else if (pixelSize == 2) {
+      __m128i v = pack16Sse2(a, b);
+      if (swap) {
+        v = swap16Sse2(v);
+      }
+      _mm_storeu_si128((__m128i *)dst, v);
+    } else {
+      __m128i v = _mm_packs_epi32(a, b);
+      _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(v, v));
+    }
+  }
+  convertRowScalar(src, dst, count - i, params);
+}
+
+static inline __m256i convert8Avx2(__m256i pixels, const __m128i *srcShift,
+                                   const __m256i *dstMax,
+                                   const __m128i *dstShift)
+{
+  const __m256i mask = _mm256_set1_epi32(0xFF);
+  const __m256i round = _mm256_set1_epi32(127);
+  const __m256i one = _mm256_set1_epi32(1);
+
+  __m256i result = _mm256_setzero_si256();
+  for (int c = 0; c < 3; c++) {
+    __m256i comp = _mm256_and_si256(_mm256_srl_epi32(pixels, srcShift[c]),
+                                    mask);
+    __m256i x = _mm256_add_epi32(_mm256_mullo_epi16(comp, dstMax[c]), round);
+    x = _mm256_add_epi32(_mm256_add_epi32(x, one), _mm256_srli_epi32(x, 8));
+    x = _mm256_srli_epi32(x, 8);
+    result = _mm256_or_si256(result, _mm256_sll_epi32(x, dstShift[c]));
+  }
+  return result;
+}
+
+void SimdPixelConverter::convertRowAvx2(const UINT8 *src, UINT8 *dst,
+                                        int count,
+                                        const SimdConvertParams *params)
+{
+  __m128i srcShift[3], dstShift[3];
+  __m256i dstMax[3];
+  for (int c = 0; c < 3; c++) {
+    srcShift[c] = _mm_cvtsi32_si128(params->srcShift[c]);
+    dstMax[c] = _mm256_set1_epi32(params->dstMax[c]);
+    dstShift[c] = _mm_cvtsi32_si128(params->dstShift[c]);
+  }
+  const __m256i swap32Mask = _mm256_setr_epi8(
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m256i swap16Mask = _mm256_setr_epi8(
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+  int pixelSize = params->dstPixelSize;
+  bool swap = params->swapBytes;
+  int i = 0;
+  for (; i + 16 <= count; i += 16, src += 64, dst += 16 * pixelSize) {
+    __m256i a = convert8Avx2(_mm256_loadu_si256((const __m256i *)src),
+                             srcShift, dstMax, dstShift);
+    __m256i b = convert8Avx2(_mm256_loadu_si256((const __m256i *)(src + 32)),
+                             srcShift, dstMax, dstShift);
+    if (pixelSize == 4) {
+      if (swap) {
+        a = _mm256_shuffle_epi8(a, swap32Mask);
+        b = _mm256_shuffle_epi8(b, swap32Mask);
+      }
+      _mm256_storeu_si256((__m256i *)dst, a);
+      _mm256_storeu_si256((__m256i *)(dst + 32), b);
+    } else {
+      // Pack within 128-bit lanes, then restore the pixel order.
+      __m256i v = _mm256_packus_epi32(a, b);
+      v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+      if (pixelSize == 2) {
+        if (swap) {
+          v = _mm256_shuffle_epi8(v, swap16Mask);
+        }
+        _mm256_storeu_si256((__m256i *)dst, v);
+      } else {
+        v = _mm256_packus_epi16(v, v);
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(v));
+      }
+    }
+  }
+  _mm256_zeroupper();
+  convertRowScalar(src, dst, count - i, params);
+}
@@ -0,0 +1,78 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_SIMD_PIXEL_CONVERTER_H_INCLUDED__
+#define __RFB_SIMD_PIXEL_CONVERTER_H_INCLUDED__
+
+#include "util/inttypes.h"
+#include "PixelFormat.h"
+
+// Parameters of a conversion from 32-bit pixels with 8-bit color components
+// to some other pixel format, for the SimdPixelConverter row functions.
+struct SimdConvertParams
+{
+  // Shifts of the red, green and blue components in source pixels.
+  int srcShift[3];
+  // Maximum values and shifts of the components in destination pixels.
+  UINT32 dstMax[3];
+  int dstShift[3];
+  // Destination pixel size in bytes (1, 2 or 4).
+  int dstPixelSize;
+  // True if bytes of destination pixels must be swapped.
+  bool swapBytes;
+};
+
+//
+// SimdPixelConverter implements the most common conversions done by
+// PixelConverter (32-bit pixels with 8-bit color components to 16-bit,
+// 8-bit and byte-swapped 32-bit pixels) with SSE2 and AVX2 instructions.
+// The results are exactly the same as of the table-based conversion of
+// PixelConverter, including the rounding of color components.
+//
+
+class SimdPixelConverter
+{
+public:
+  // Converts count pixels from src to dst.
+  typedef void (*RowFunc)(const UINT8 *src, UINT8 *dst, int count,
+                          const SimdConvertParams *params);
+
+  // Returns the fastest row function supported by the processor for the
+  // given conversion and fills in params for it, or returns 0 if there is
+  // no SIMD implementation for this pair of pixel formats.
+  static RowFunc select(const PixelFormat *dstPf, const PixelFormat *srcPf,
+                        SimdConvertParams *params);
+
+  // Converts count pixels without SIMD instructions, used for the pixels
+  // left after processing whole SIMD blocks.
+  static void convertRowScalar(const UINT8 *src, UINT8 *dst, int count,
+                               const SimdConvertParams *params);
+
+  static void convertRowSse2(const UINT8 *src, UINT8 *dst, int count,
+                             const SimdConvertParams *params);
+  static void convertRowAvx2(const UINT8 *src, UINT8 *dst, int count,
+                             const SimdConvertParams *params);
+};
+
+#endif // __RFB_SIMD_PIXEL_CONVERTER_H_INCLUDED__
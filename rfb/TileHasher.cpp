@@ -0,0 +1,79 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TileHasher.h"
+#include "util/XXHash64.h"
+
+#include <crtdbg.h>
+
+size_t TileHasher::getNumTiles(const Dimension *dim, int tileSize)
+{
+  _ASSERT(tileSize > 0);
+  size_t cols = (dim->width + tileSize - 1) / tileSize;
+  size_t rows = (dim->height + tileSize - 1) / tileSize;
+  return cols * rows;
+}
+
+Rect TileHasher::getTileRect(const Dimension *dim, int tileSize, size_t index)
+{
+  int cols = (dim->width + tileSize - 1) / tileSize;
+  int left = (int)(index % cols) * tileSize;
+  int top = (int)(index / cols) * tileSize;
+  Rect rect(left, top, left + tileSize, top + tileSize);
+  Rect fbRect = dim->getRect();
+  return rect.intersection(&fbRect);
+}
+
+UINT64 TileHasher::hashRect(const FrameBuffer *fb, const Rect *rect)
+{
+  _ASSERT(fb->getDimension().getRect().intersection(rect).isEqualTo(rect));
+
+  XXHash64 hash;
+  size_t rowLength = rect->getWidth() * fb->getBytesPerPixel();
+  int stride = fb->getBytesPerRow();
+  const UINT8 *row = (const UINT8 *)fb->getBufferPtr(rect->left, rect->top);
+  for (int y = rect->top; y < rect->bottom; y++, row += stride) {
+    hash.update(row, rowLength);
+  }
+
+  // The hash is in the big endian form.
+  const UINT8 *bytes = hash.finalize().getHash();
+  UINT64 value = 0;
+  for (size_t i = 0; i < XXHash64::HASH_SIZE; i++) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+void TileHasher::hashTiles(const FrameBuffer *fb, int tileSize,
+                           std::vector<UINT64> *hashes)
+{
+  Dimension dim = fb->getDimension();
+  size_t numTiles = getNumTiles(&dim, tileSize);
+  hashes->resize(numTiles);
+  for (size_t i = 0; i < numTiles; i++) {
+    Rect tileRect = getTileRect(&dim, tileSize, i);
+    (*hashes)[i] = hashRect(fb, &tileRect);
+  }
+}
@@ -0,0 +1,60 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RFB_TILE_HASHER_H_INCLUDED__
+#define __RFB_TILE_HASHER_H_INCLUDED__
+
+#include "util/inttypes.h"
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+
+#include <vector>
+
+//
+// TileHasher hashes the square tiles of a frame buffer, so that a client and
+// the server can find out which tiles of their frame buffers differ without
+// sending the pixels. Each hash is XXH64 (seed 0) of the tile pixels taken
+// row after row, with no row padding; the tiles go row by row starting at
+// the top left corner, the ones at the right and bottom edges are cut.
+//
+
+class TileHasher
+{
+public:
+  // Returns the number of tiles covering a frame buffer of the dimension.
+  static size_t getNumTiles(const Dimension *dim, int tileSize);
+
+  // Returns the rectangle of the tile with the index.
+  static Rect getTileRect(const Dimension *dim, int tileSize, size_t index);
+
+  // Returns the hash of the pixels of the rectangle, which must be inside
+  // the frame buffer.
+  static UINT64 hashRect(const FrameBuffer *fb, const Rect *rect);
+
+  // Replaces the content of hashes with the hashes of all the tiles of fb.
+  static void hashTiles(const FrameBuffer *fb, int tileSize,
+                        std::vector<UINT64> *hashes);
+};
+
+#endif // __RFB_TILE_HASHER_H_INCLUDED__
@@ -25,3 +25,4 @@
 #include "TunnelDefs.h"
 
 const char *const TunnelDefs::SIG_NONE = "NOTUNNEL";
+const char *const TunnelDefs::SIG_TLS = "TLSTUNNL";
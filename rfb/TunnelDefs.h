@@ -31,7 +31,13 @@ class TunnelDefs
 {
 public:
   static const UINT32 NOTUNNEL = 0;
+  // TLS 1.2 over the connection: right after the client has chosen it,
+  // the client starts the TLS handshake, and all the following data of
+  // both directions, authentication included, are TLS records.
+  static const UINT32 TLS = 0xFC000600;
+
   static const char *const SIG_NONE;
+  static const char *const SIG_TLS;
 private:
 };
 
@@ -0,0 +1,168 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __HOOKRECTRING_H__
+#define __HOOKRECTRING_H__
+
+#include "util/CommonHeader.h"
+
+// One slot of the HookRectRing. The sequence field tells the state of the
+// slot relative to the ring indices: it equals the write position when the
+// slot is free, write position + 1 when a rectangle has been published to it.
+struct HookRectRingSlot
+{
+  volatile LONG sequence;
+  INT16 left;
+  INT16 top;
+  INT16 right;
+  INT16 bottom;
+};
+
+// Ring of dirty rectangles placed into a named file mapping shared between
+// the hooks update detector (the only reader) and every process that has
+// the screen hooks library loaded (the writers).
+//
+// Writers push rectangles without any kernel transition and post a single
+// wake-up message to the detector window per batch: the wakeUpPending flag
+// is raised by the first writer that finds it clear and is dropped by the
+// reader right before it drains the ring, so a rectangle published during
+// a drain always produces a new wake-up.
+//
+// All the fields have fixed sizes, so the 32-bit hook library loaded by the
+// 32-bit hook loader sees the same layout as the 64-bit server.
+struct HookRectRing
+{
+  // Must be a power of two.
+  static const LONG CAPACITY = 4096;
+
+  volatile LONG writeIndex;
+  volatile LONG readIndex;
+  volatile LONG wakeUpPending;
+  HookRectRingSlot slots[CAPACITY];
+
+  // Called by the reader before the ring is exposed to writers.
+  void init()
+  {
+    writeIndex = 0;
+    readIndex = 0;
+    wakeUpPending = 0;
+    for (LONG i = 0; i < CAPACITY; i++) {
+      slots[i].sequence = i;
+    }
+  }
+
+  // Writer side. Returns false if the ring is full.
+  bool push(INT16 left, INT16 top, INT16 right, INT16 bottom)
+  {
+    LONG pos = writeIndex;
+    for (;;) {
+      HookRectRingSlot *slot = &slots[pos & (CAPACITY - 1)];
+      LONG diff = distance(slot->sequence, pos);
+      if (diff == 0) {
+        LONG prev = InterlockedCompareExchange(&writeIndex, advance(pos, 1),
+                                               pos);
+        if (prev == pos) {
+          slot->left = left;
+          slot->top = top;
+          slot->right = right;
+          slot->bottom = bottom;
+          InterlockedExchange(&slot->sequence, advance(pos, 1));
+          return true;
+        }
+        pos = prev;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = writeIndex;
+      }
+    }
+  }
+
+  // Writer side. Returns true if the caller must post the wake-up message.
+  bool requestWakeUp()
+  {
+    return InterlockedExchange(&wakeUpPending, 1) == 0;
+  }
+
+  // Writer side. Called when the wake-up message cannot be posted to let
+  // the next writer try again.
+  void cancelWakeUp()
+  {
+    InterlockedExchange(&wakeUpPending, 0);
+  }
+
+  // Reader side. Must be called before draining the ring.
+  void clearWakeUp()
+  {
+    InterlockedExchange(&wakeUpPending, 0);
+  }
+
+  // Reader side. Returns false if there is no published rectangle at the
+  // head of the ring.
+  bool pop(INT16 *left, INT16 *top, INT16 *right, INT16 *bottom)
+  {
+    LONG pos = readIndex;
+    HookRectRingSlot *slot = &slots[pos & (CAPACITY - 1)];
+    if (distance(slot->sequence, advance(pos, 1)) != 0) {
+      return false;
+    }
+    *left = slot->left;
+    *top = slot->top;
+    *right = slot->right;
+    *bottom = slot->bottom;
+    InterlockedExchange(&slot->sequence, advance(pos, CAPACITY));
+    readIndex = advance(pos, 1);
+    return true;
+  }
+
+  // Reader side. A writer that died between reserving a slot and publishing
+  // it blocks the head of the ring forever. Once the ring has filled up
+  // behind such a slot the slot is released without being read.
+  // Returns true if a slot has been skipped.
+  bool skipAbandonedSlot()
+  {
+    LONG pos = readIndex;
+    if (distance(writeIndex, pos) < CAPACITY) {
+      return false;
+    }
+    HookRectRingSlot *slot = &slots[pos & (CAPACITY - 1)];
+    InterlockedExchange(&slot->sequence, advance(pos, CAPACITY));
+    readIndex = advance(pos, 1);
+    return true;
+  }
+
+private:
+  // Indices wrap around, so they are compared through unsigned arithmetic.
+  static LONG distance(LONG a, LONG b)
+  {
+    return (LONG)((ULONG)a - (ULONG)b);
+  }
+
+  static LONG advance(LONG pos, LONG count)
+  {
+    return (LONG)((ULONG)pos + (ULONG)count);
+  }
+};
+
+#endif // __HOOKRECTRING_H__
@@ -27,6 +27,7 @@
 #include "tvnserver-app/NamingDefs.h"
 #include "region/Point.h"
 #include "region/Region.h"
+#include "HookRectRing.h"
 
 // Pre-definition:
 LRESULT CALLBACK callWndRetProc(int nCode, WPARAM wParam, LPARAM lParam);
@@ -38,10 +39,20 @@ void sendClientRect(HWND hwnd);
 void sendNClientRegion(HWND hwnd);
 Rect getWindowRect(HWND hwnd);
 Rect getClientRect(HWND hwnd);
+HookRectRing *getRectRing();
 
 // Per-instance variables:
 HMODULE g_hModule = 0;
 
+// The rectangle ring of the current target window. It is opened on the
+// first rectangle and reopened when the target window changes. Zero
+// g_rectRing with g_rectRingTarget equal to the target means that the ring
+// is not accessible from this process and rectangles are sent by messages.
+CRITICAL_SECTION g_rectRingLock;
+HookRectRing * volatile g_rectRing = 0;
+HANDLE g_rectRingMapping = 0;
+HWND volatile g_rectRingTarget = 0;
+
 #pragma comment(linker, "/section:.shared,RWS")
 #pragma data_seg(".shared")
 HHOOK g_callWndProcH = 0;
@@ -58,10 +69,19 @@ BOOL APIENTRY DllMain(HMODULE hModule,
   {
   case DLL_PROCESS_ATTACH:
     g_hModule = hModule;
+    InitializeCriticalSection(&g_rectRingLock);
+    break;
+  case DLL_PROCESS_DETACH:
+    if (g_rectRing != 0) {
+      UnmapViewOfFile(g_rectRing);
+    }
+    if (g_rectRingMapping != 0) {
+      CloseHandle(g_rectRingMapping);
+    }
+    DeleteCriticalSection(&g_rectRingLock);
     break;
   case DLL_THREAD_ATTACH:
   case DLL_THREAD_DETACH:
-  case DLL_PROCESS_DETACH:
     break;
   }
   return TRUE;
@@ -161,11 +181,61 @@ void sendRect(const Rect *rect)
   INT16 top    = (INT16)rect->top;
   INT16 right  = (INT16)rect->right;
   INT16 bottom = (INT16)rect->bottom;
+
+  // Put the rectangle to the shared ring and wake up the detector once per
+  // batch. Fall back to a message per rectangle if the ring cannot be used.
+  HookRectRing *ring = getRectRing();
+  if (ring != 0 && ring->push(left, top, right, bottom)) {
+    if (ring->requestWakeUp()) {
+      if (PostMessage(g_targetWinHwnd, HookDefinitions::BATCH_IPC_CODE,
+                      0, 0) == 0) {
+        ring->cancelWakeUp();
+      }
+    }
+    return;
+  }
   PostMessage(g_targetWinHwnd, HookDefinitions::SPEC_IPC_CODE,
               MAKEWPARAM(top, left),
               MAKELPARAM(bottom, right));
 }
 
+HookRectRing *getRectRing()
+{
+  HWND target = g_targetWinHwnd;
+  if (g_rectRingTarget == target) {
+    return g_rectRing;
+  }
+
+  EnterCriticalSection(&g_rectRingLock);
+  if (g_rectRingTarget != target) {
+    // The view of the previous target is left mapped because other threads
+    // of this process can still be writing to it. This happens only when
+    // the hooks are reinstalled while the library stays loaded.
+    HookRectRing *ring = 0;
+    TCHAR name[64];
+    _stprintf_s(name, sizeof(name) / sizeof(TCHAR),
+                HookDefinitions::HOOK_RECT_RING_NAME_FORMAT,
+                (unsigned int)(size_t)target);
+    HANDLE mapping = OpenFileMapping(FILE_MAP_WRITE, FALSE, name);
+    if (mapping != 0) {
+      ring = (HookRectRing *)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0,
+                                           sizeof(HookRectRing));
+      if (ring == 0) {
+        CloseHandle(mapping);
+        mapping = 0;
+      }
+    }
+    if (ring != 0) {
+      g_rectRingMapping = mapping;
+    }
+    g_rectRing = ring;
+    g_rectRingTarget = target;
+  }
+  HookRectRing *result = g_rectRing;
+  LeaveCriticalSection(&g_rectRingLock);
+  return result;
+}
+
 void sendClientRect(HWND hwnd)
 {
   Rect clientRect = getClientRect(hwnd);
@@ -37,8 +37,10 @@ LocalMutex Configurator::m_instanceMutex;
 
 Configurator::Configurator(bool isConfiguringService)
 : m_isConfiguringService(isConfiguringService), m_isConfigLoadedPartly(false),
-  m_isFirstLoad(true), m_regSA(0)
+  m_isFirstLoad(true), m_regSA(0), m_snapshot(0)
 {
+  m_snapshot = new ServerConfigSnapshot(&m_serverConfig);
+
   AutoLock al(&m_instanceMutex);
   if (s_instance != 0) {
     throw Exception(_T("Configurator instance already exists"));
@@ -54,6 +56,11 @@ Configurator::Configurator(bool isConfiguringService)
 Configurator::~Configurator()
 {
   if (m_regSA != 0) delete m_regSA;
+
+  delete m_snapshot;
+  for (size_t i = 0; i < m_retiredSnapshots.size(); i++) {
+    delete m_retiredSnapshots[i];
+  }
 }
 
 Configurator *Configurator::getInstance()
@@ -68,8 +75,28 @@ void Configurator::setInstance(Configurator *conf)
   s_instance = conf;
 }
 
+const ServerConfigSnapshot *Configurator::getConfigSnapshot()
+{
+  // The instance is set once at startup, so it's read without the mutex.
+  _ASSERT(s_instance != NULL);
+  return s_instance->m_snapshot;
+}
+
+void Configurator::publishSnapshot()
+{
+  ServerConfigSnapshot *snapshot = new ServerConfigSnapshot(&m_serverConfig);
+
+  AutoLock al(&m_snapshotLock);
+  ServerConfigSnapshot *old = (ServerConfigSnapshot *)
+    InterlockedExchangePointer((PVOID volatile *)&m_snapshot, snapshot);
+  m_retiredSnapshots.push_back(old);
+}
+
 void Configurator::notifyReload()
 {
+  // Hot paths see new settings before the listeners are notified.
+  publishSnapshot();
+
   AutoLock l(&m_listeners);
 
   for (size_t i = 0; i < m_listeners.size(); i++) {
@@ -641,6 +668,144 @@ bool Configurator::saveServerConfig(SettingsManager *sm)
   if (!sm->setUINT(_T("IdleTimeout"), (UINT)m_serverConfig.getIdleTimeout())) {
     saveResult = false;
   }
+  if (!sm->setUINT(_T("EncoderThreads"), m_serverConfig.getEncoderThreadCount())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("DirtyTileSize"), m_serverConfig.getDirtyTileSize())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("GpuChangeDetection"), m_serverConfig.isGpuChangeDetectionEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("VblankPacedCapture"), m_serverConfig.isVblankPacedCaptureEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("AutoVideoDetection"), m_serverConfig.isAutoVideoDetectionEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("AdaptiveQuality"), m_serverConfig.isAdaptiveQualityEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("InteractiveFirst"), m_serverConfig.isInteractiveFirstEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("PreviewFirstFrame"), m_serverConfig.isPreviewFirstFrameEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("AutoEncoding"), m_serverConfig.isAutoEncodingEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MemoryBudget"), m_serverConfig.getMemoryBudget())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MaxBandwidth"), m_serverConfig.getMaxBandwidth())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MaxClientBandwidth"), m_serverConfig.getMaxClientBandwidth())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MaxFileTransferBandwidth"), m_serverConfig.getMaxFileTransferBandwidth())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("SharedFrameBuffer"), m_serverConfig.isSharedFrameBufferEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("IoCompletionPort"), m_serverConfig.isIoCompletionPortEnabled())) {
+    saveResult = false;
+  }
+  SocketProfile socketProfile;
+  m_serverConfig.getSocketProfile(&socketProfile);
+  if (!sm->setUINT(_T("SocketSendBuffer"), socketProfile.sendBufferSize)) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("SocketReceiveBuffer"), socketProfile.receiveBufferSize)) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("SocketNoDelay"), socketProfile.noDelay)) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("SocketKeepAlive"), socketProfile.keepAliveTime)) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("SocketBufferAutoTune"), socketProfile.autoTune)) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("FrameTrace"), m_serverConfig.isFrameTraceEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("UpdateTrace"), m_serverConfig.isUpdateTraceEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("SessionRecording"), m_serverConfig.isSessionRecordingEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MaxClipboardToClients"), m_serverConfig.getMaxClipboardToClients())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MaxClipboardFromClients"), m_serverConfig.getMaxClipboardFromClients())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("ReduceVisualEffects"), m_serverConfig.isReducingVisualEffectsEnabled())) {
+    saveResult = false;
+  }
+  StringStorage relayHost;
+  m_serverConfig.getRelayHost(&relayHost);
+  if (!sm->setString(_T("RelayHost"), relayHost.getString())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("RelayPort"), m_serverConfig.getRelayPort())) {
+    saveResult = false;
+  }
+  if (m_serverConfig.hasRelayPassword()) {
+    unsigned char password[ServerConfig::VNC_PASSWORD_SIZE];
+
+    m_serverConfig.getRelayPassword(&password[0]);
+
+    if (!sm->setBinaryData(_T("RelayPassword"), &password[0], ServerConfig::VNC_PASSWORD_SIZE)) {
+      saveResult = false;
+    }
+  } else {
+    sm->deleteKey(_T("RelayPassword"));
+  }
+  StringStorage multicastGroup;
+  m_serverConfig.getMulticastGroup(&multicastGroup);
+  if (!sm->setString(_T("MulticastGroup"), multicastGroup.getString())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MulticastPort"), m_serverConfig.getMulticastPort())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("MulticastBandwidth"), m_serverConfig.getMulticastBandwidth())) {
+    saveResult = false;
+  }
+  StringStorage simdLevel;
+  m_serverConfig.getSimdLevel(&simdLevel);
+  if (!sm->setString(_T("SimdLevel"), simdLevel.getString())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("LargePageFrameBuffers"), m_serverConfig.isLargePageFrameBuffersEnabled())) {
+    saveResult = false;
+  }
+  if (!sm->setInt(_T("CaptureThreadPriority"), m_serverConfig.getCaptureThreadPriority())) {
+    saveResult = false;
+  }
+  if (!sm->setInt(_T("SenderThreadPriority"), m_serverConfig.getSenderThreadPriority())) {
+    saveResult = false;
+  }
+  if (!sm->setInt(_T("EncoderThreadPriority"), m_serverConfig.getEncoderThreadPriority())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("EncoderAffinity"), m_serverConfig.isEncoderAffinityEnabled())) {
+    saveResult = false;
+  }
+  StringStorage syntheticWorkload;
+  m_serverConfig.getSyntheticWorkload(&syntheticWorkload);
+  if (!sm->setString(_T("SyntheticWorkload"), syntheticWorkload.getString())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("SyntheticWorkloadSeed"), m_serverConfig.getSyntheticWorkloadSeed())) {
+    saveResult = false;
+  }
   return saveResult;
 }
 
@@ -815,6 +980,256 @@ bool Configurator::loadServerConfig(SettingsManager *sm, ServerConfig *config)
     m_isConfigLoadedPartly = true;
     m_serverConfig.setIdleTimeout((int)uintVal);
   }
+  if (!sm->getUINT(_T("EncoderThreads"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setEncoderThreadCount(uintVal);
+  }
+  if (!sm->getUINT(_T("DirtyTileSize"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setDirtyTileSize(uintVal);
+  }
+  if (!sm->getBoolean(_T("GpuChangeDetection"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableGpuChangeDetection(boolVal);
+  }
+  if (!sm->getBoolean(_T("VblankPacedCapture"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableVblankPacedCapture(boolVal);
+  }
+  if (!sm->getBoolean(_T("AutoVideoDetection"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableAutoVideoDetection(boolVal);
+  }
+  if (!sm->getBoolean(_T("AdaptiveQuality"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableAdaptiveQuality(boolVal);
+  }
+  if (!sm->getBoolean(_T("InteractiveFirst"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableInteractiveFirst(boolVal);
+  }
+  if (!sm->getBoolean(_T("PreviewFirstFrame"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enablePreviewFirstFrame(boolVal);
+  }
+  if (!sm->getBoolean(_T("AutoEncoding"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableAutoEncoding(boolVal);
+  }
+  if (!sm->getUINT(_T("MemoryBudget"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMemoryBudget(uintVal);
+  }
+  if (!sm->getUINT(_T("MaxBandwidth"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMaxBandwidth(uintVal);
+  }
+  if (!sm->getUINT(_T("MaxClientBandwidth"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMaxClientBandwidth(uintVal);
+  }
+  if (!sm->getUINT(_T("MaxFileTransferBandwidth"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMaxFileTransferBandwidth(uintVal);
+  }
+  if (!sm->getBoolean(_T("SharedFrameBuffer"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableSharedFrameBuffer(boolVal);
+  }
+  if (!sm->getBoolean(_T("IoCompletionPort"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableIoCompletionPort(boolVal);
+  }
+  SocketProfile socketProfile;
+  m_serverConfig.getSocketProfile(&socketProfile);
+  if (!sm->getUINT(_T("SocketSendBuffer"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    socketProfile.sendBufferSize = (int)uintVal;
+  }
+  if (!sm->getUINT(_T("SocketReceiveBuffer"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    socketProfile.receiveBufferSize = (int)uintVal;
+  }
+  if (!sm->getBoolean(_T("SocketNoDelay"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    socketProfile.noDelay = boolVal;
+  }
+  if (!sm->getUINT(_T("SocketKeepAlive"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    socketProfile.keepAliveTime = uintVal;
+  }
+  if (!sm->getBoolean(_T("SocketBufferAutoTune"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    socketProfile.autoTune = boolVal;
+  }
+  m_serverConfig.setSocketProfile(&socketProfile);
+  if (!sm->getBoolean(_T("FrameTrace"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableFrameTrace(boolVal);
+  }
+  if (!sm->getBoolean(_T("UpdateTrace"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableUpdateTrace(boolVal);
+  }
+  if (!sm->getBoolean(_T("SessionRecording"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableSessionRecording(boolVal);
+  }
+  if (!sm->getUINT(_T("MaxClipboardToClients"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMaxClipboardToClients(uintVal);
+  }
+  if (!sm->getUINT(_T("MaxClipboardFromClients"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMaxClipboardFromClients(uintVal);
+  }
+  if (!sm->getBoolean(_T("ReduceVisualEffects"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableReducingVisualEffects(boolVal);
+  }
+  StringStorage relayHost;
+  if (!sm->getString(_T("RelayHost"), &relayHost)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setRelayHost(relayHost.getString());
+  }
+  if (!sm->getUINT(_T("RelayPort"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setRelayPort(uintVal);
+  }
+  passSize = 8;
+  if (!sm->getBinaryData(_T("RelayPassword"), (void *)&buffer, &passSize)) {
+    loadResult = false;
+    m_serverConfig.deleteRelayPassword();
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setRelayPassword(&buffer[0]);
+  }
+  StringStorage multicastGroup;
+  if (!sm->getString(_T("MulticastGroup"), &multicastGroup)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMulticastGroup(multicastGroup.getString());
+  }
+  if (!sm->getUINT(_T("MulticastPort"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMulticastPort(uintVal);
+  }
+  if (!sm->getUINT(_T("MulticastBandwidth"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setMulticastBandwidth(uintVal);
+  }
+  StringStorage simdLevel;
+  if (!sm->getString(_T("SimdLevel"), &simdLevel)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setSimdLevel(simdLevel.getString());
+  }
+  if (!sm->getBoolean(_T("LargePageFrameBuffers"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableLargePageFrameBuffers(boolVal);
+  }
+  int priority;
+  if (!sm->getInt(_T("CaptureThreadPriority"), &priority)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setCaptureThreadPriority(priority);
+  }
+  if (!sm->getInt(_T("SenderThreadPriority"), &priority)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setSenderThreadPriority(priority);
+  }
+  if (!sm->getInt(_T("EncoderThreadPriority"), &priority)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setEncoderThreadPriority(priority);
+  }
+  if (!sm->getBoolean(_T("EncoderAffinity"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.enableEncoderAffinity(boolVal);
+  }
+  StringStorage syntheticWorkload;
+  if (!sm->getString(_T("SyntheticWorkload"), &syntheticWorkload)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setSyntheticWorkload(syntheticWorkload.getString());
+  }
+  if (!sm->getUINT(_T("SyntheticWorkloadSeed"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setSyntheticWorkloadSeed(uintVal);
+  }
   if (!sm->getBoolean(_T("GrabTransparentWindows"), &boolVal)) {
     loadResult = false;
   } else {
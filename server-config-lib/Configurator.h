@@ -30,11 +30,14 @@
 #include "PortMappingContainer.h"
 #include "IpAccessControl.h"
 #include "ServerConfig.h"
+#include "ServerConfigSnapshot.h"
 #include "ConfigReloadListener.h"
 #include "RegistrySecurityAttributes.h"
 
 #include "util/ListenerContainer.h"
 
+#include <vector>
+
 class Configurator : public ListenerContainer<ConfigReloadListener *>
 {
 public:
@@ -66,8 +69,18 @@ public:
 
   ServerConfig *getServerConfig() { return &m_serverConfig; }
 
+  //
+  // Returns the settings as of the last reload, without any locks,
+  // for hot paths. The snapshot stays valid until the configurator
+  // is destroyed.
+  //
+  static const ServerConfigSnapshot *getConfigSnapshot();
+
 private:
 
+  // Replaces current snapshot with the copy of m_serverConfig.
+  void publishSnapshot();
+
   //
   // Serialize and deserialize methods
   //
@@ -105,6 +118,15 @@ protected:
 
   ServerConfig m_serverConfig;
 
+  //
+  // Current snapshot of m_serverConfig, it's replaced atomically.
+  // Readers may still hold replaced snapshots, so they are deleted only
+  // with the configurator (the config is reloaded rarely).
+  //
+  ServerConfigSnapshot * volatile m_snapshot;
+  std::vector<ServerConfigSnapshot *> m_retiredSnapshots;
+  LocalMutex m_snapshotLock;
+
   //
   // Is this flag is set configurator think than application run as service
   //
@@ -0,0 +1,123 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "IpAccessTable.h"
+
+#include <algorithm>
+
+#include "util/AnsiStringStorage.h"
+
+IpAccessTable::IpAccessTable(const IpAccessControl *rules)
+{
+  std::vector<std::vector<std::pair<UINT32, UINT32> > > ruleRanges(rules->size());
+  std::vector<UINT64> bounds;
+  for (size_t i = 0; i < rules->size(); i++) {
+    getRuleRanges(rules->at(i), &ruleRanges[i]);
+    for (size_t j = 0; j < ruleRanges[i].size(); j++) {
+      bounds.push_back(ruleRanges[i][j].first);
+      bounds.push_back((UINT64)ruleRanges[i][j].second + 1);
+    }
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+  // Between two neighbouring bounds all the addresses match the same rules.
+  for (size_t b = 0; b + 1 < bounds.size(); b++) {
+    UINT32 first = (UINT32)bounds[b];
+    UINT32 last = (UINT32)(bounds[b + 1] - 1);
+    IpAccessRule::ActionType action = IpAccessRule::ACTION_TYPE_ALLOW;
+    bool found = false;
+    for (size_t i = 0; i < ruleRanges.size() && !found; i++) {
+      for (size_t j = 0; j < ruleRanges[i].size(); j++) {
+        if (ruleRanges[i][j].first <= first && first <= ruleRanges[i][j].second) {
+          action = rules->at(i)->getAction();
+          found = true;
+          break;
+        }
+      }
+    }
+    if (action == IpAccessRule::ACTION_TYPE_ALLOW) {
+      continue;
+    }
+    if (!m_ranges.empty() && m_ranges.back().action == action &&
+        m_ranges.back().last + 1 == first) {
+      m_ranges.back().last = last;
+    } else {
+      Range range;
+      range.first = first;
+      range.last = last;
+      range.action = action;
+      m_ranges.push_back(range);
+    }
+  }
+}
+
+IpAccessTable::~IpAccessTable()
+{
+}
+
+IpAccessRule::ActionType IpAccessTable::getAction(unsigned long ip) const
+{
+  UINT32 address = ntohl(ip);
+  // The last range starting at or before the address.
+  size_t low = 0;
+  size_t high = m_ranges.size();
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (m_ranges[middle].first <= address) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low > 0 && address <= m_ranges[low - 1].last) {
+    return m_ranges[low - 1].action;
+  }
+  return IpAccessRule::ACTION_TYPE_ALLOW;
+}
+
+void IpAccessTable::getRuleRanges(const IpAccessRule *rule,
+                                  std::vector<std::pair<UINT32, UINT32> > *ranges)
+{
+  StringStorage firstIpString;
+  StringStorage lastIpString;
+  rule->getFirstIp(&firstIpString);
+  rule->getLastIp(&lastIpString);
+  AnsiStringStorage firstIpAnsi(&firstIpString);
+  AnsiStringStorage lastIpAnsi(&lastIpString);
+
+  // The same addresses as IpAccessRule::isIncludingAddress() takes.
+  UINT32 firstIp = ntohl(inet_addr(firstIpAnsi.getString()));
+  UINT32 lastIp = firstIp;
+  if (!lastIpString.isEmpty()) {
+    lastIp = ntohl(inet_addr(lastIpAnsi.getString()));
+  }
+  if (firstIp <= lastIp) {
+    ranges->push_back(std::make_pair(firstIp, lastIp));
+  } else {
+    // Only the ends of a reversed range match.
+    ranges->push_back(std::make_pair(lastIp, lastIp));
+    ranges->push_back(std::make_pair(firstIp, firstIp));
+  }
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _IP_ACCESS_TABLE_H_
+#define _IP_ACCESS_TABLE_H_
+
+#include <vector>
+
+#include "util/inttypes.h"
+
+#include "IpAccessControl.h"
+#include "IpAccessRule.h"
+
+//
+// Access control rules compiled for lookups by address. The first matching
+// rule of the list wins, so the ranges of the rules are cut into disjoint
+// ranges, each with the action of the first rule covering it, and a lookup
+// is a binary search over them instead of a scan of the rules.
+//
+// The table is immutable, see ServerConfigSnapshot.
+//
+
+class IpAccessTable
+{
+public:
+  // Compiles the rules, the caller must hold the lock of their config.
+  IpAccessTable(const IpAccessControl *rules);
+  virtual ~IpAccessTable();
+
+  // Returns the action for the address in network byte order, the same
+  // as ServerConfig::getActionByAddress() for the rules of the table.
+  IpAccessRule::ActionType getAction(unsigned long ip) const;
+
+private:
+  struct Range
+  {
+    // Addresses in host byte order.
+    UINT32 first;
+    UINT32 last;
+    IpAccessRule::ActionType action;
+  };
+
+  // Puts the ranges of addresses included by the rule, in host byte order.
+  static void getRuleRanges(const IpAccessRule *rule,
+                            std::vector<std::pair<UINT32, UINT32> > *ranges);
+
+  // Sorted disjoint ranges which are not allowed by default.
+  std::vector<Range> m_ranges;
+};
+
+#endif
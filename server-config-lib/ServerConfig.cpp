@@ -48,11 +48,43 @@ ServerConfig::ServerConfig()
   m_saveLogToAllUsersPath(false), m_hasControlPassword(false),
   m_showTrayIcon(true),
   m_connectToRdp(false),
-  m_idleTimeout(0)
+  m_idleTimeout(0),
+  m_encoderThreadCount(1),
+  m_dirtyTileSize(64),
+  m_gpuChangeDetection(false),
+  m_vblankPacedCapture(false),
+  m_autoVideoDetection(true),
+  m_adaptiveQuality(false),
+  m_interactiveFirst(false),
+  m_previewFirstFrame(false),
+  m_autoEncoding(false),
+  m_memoryBudget(0),
+  m_maxBandwidth(0),
+  m_maxClientBandwidth(0),
+  m_maxFileTransferBandwidth(0),
+  m_sharedFrameBuffer(false),
+  m_ioCompletionPort(false),
+  m_frameTrace(false),
+  m_updateTrace(false),
+  m_sessionRecording(false),
+  m_maxClipboardToClients(0),
+  m_maxClipboardFromClients(0),
+  m_reduceVisualEffects(false),
+  m_relayPort(5900),
+  m_multicastPort(5950),
+  m_multicastBandwidth(10240),
+  m_largePageFrameBuffers(false),
+  m_captureThreadPriority(0),
+  m_senderThreadPriority(0),
+  m_encoderThreadPriority(0),
+  m_encoderAffinity(false),
+  m_syntheticWorkloadSeed(1),
+  m_hasRelayPassword(false)
 {
   memset(m_primaryPassword,  0, sizeof(m_primaryPassword));
   memset(m_readonlyPassword, 0, sizeof(m_readonlyPassword));
   memset(m_controlPassword,  0, sizeof(m_controlPassword));
+  memset(m_relayPassword,  0, sizeof(m_relayPassword));
 }
 
 ServerConfig::~ServerConfig()
@@ -147,6 +179,48 @@ void ServerConfig::serialize(DataOutputStream *output)
   output->writeInt8(m_showTrayIcon ? 1 : 0);
 
   output->writeUTF8(m_logFilePath.getString());
+
+  output->writeUInt32(m_encoderThreadCount);
+  output->writeUInt32(m_dirtyTileSize);
+  output->writeInt8(m_gpuChangeDetection ? 1 : 0);
+  output->writeInt8(m_vblankPacedCapture ? 1 : 0);
+  output->writeInt8(m_autoVideoDetection ? 1 : 0);
+  output->writeInt8(m_adaptiveQuality ? 1 : 0);
+  output->writeInt8(m_interactiveFirst ? 1 : 0);
+  output->writeInt8(m_previewFirstFrame ? 1 : 0);
+  output->writeInt8(m_autoEncoding ? 1 : 0);
+  output->writeUInt32(m_memoryBudget);
+  output->writeUInt32(m_maxBandwidth);
+  output->writeUInt32(m_maxClientBandwidth);
+  output->writeUInt32(m_maxFileTransferBandwidth);
+  output->writeInt8(m_sharedFrameBuffer ? 1 : 0);
+  output->writeInt8(m_ioCompletionPort ? 1 : 0);
+  output->writeInt32(m_socketProfile.sendBufferSize);
+  output->writeInt32(m_socketProfile.receiveBufferSize);
+  output->writeInt8(m_socketProfile.noDelay ? 1 : 0);
+  output->writeUInt32(m_socketProfile.keepAliveTime);
+  output->writeInt8(m_socketProfile.autoTune ? 1 : 0);
+  output->writeInt8(m_frameTrace ? 1 : 0);
+  output->writeInt8(m_updateTrace ? 1 : 0);
+  output->writeInt8(m_sessionRecording ? 1 : 0);
+  output->writeUInt32(m_maxClipboardToClients);
+  output->writeUInt32(m_maxClipboardFromClients);
+  output->writeInt8(m_reduceVisualEffects ? 1 : 0);
+  output->writeUTF8(m_relayHost.getString());
+  output->writeUInt32(m_relayPort);
+  output->writeInt8(m_hasRelayPassword ? 1 : 0);
+  output->writeFully(m_relayPassword, VNC_PASSWORD_SIZE);
+  output->writeUTF8(m_multicastGroup.getString());
+  output->writeUInt32(m_multicastPort);
+  output->writeUInt32(m_multicastBandwidth);
+  output->writeUTF8(m_simdLevel.getString());
+  output->writeInt8(m_largePageFrameBuffers ? 1 : 0);
+  output->writeInt32(m_captureThreadPriority);
+  output->writeInt32(m_senderThreadPriority);
+  output->writeInt32(m_encoderThreadPriority);
+  output->writeInt8(m_encoderAffinity ? 1 : 0);
+  output->writeUTF8(m_syntheticWorkload.getString());
+  output->writeUInt32(m_syntheticWorkloadSeed);
 }
 
 void ServerConfig::deserialize(DataInputStream *input)
@@ -223,6 +297,48 @@ void ServerConfig::deserialize(DataInputStream *input)
   m_showTrayIcon = input->readInt8() == 1;
 
   input->readUTF8(&m_logFilePath);
+
+  m_encoderThreadCount = input->readUInt32();
+  m_dirtyTileSize = input->readUInt32();
+  m_gpuChangeDetection = input->readInt8() == 1;
+  m_vblankPacedCapture = input->readInt8() == 1;
+  m_autoVideoDetection = input->readInt8() == 1;
+  m_adaptiveQuality = input->readInt8() == 1;
+  m_interactiveFirst = input->readInt8() == 1;
+  m_previewFirstFrame = input->readInt8() == 1;
+  m_autoEncoding = input->readInt8() == 1;
+  m_memoryBudget = input->readUInt32();
+  m_maxBandwidth = input->readUInt32();
+  m_maxClientBandwidth = input->readUInt32();
+  m_maxFileTransferBandwidth = input->readUInt32();
+  m_sharedFrameBuffer = input->readInt8() == 1;
+  m_ioCompletionPort = input->readInt8() == 1;
+  m_socketProfile.sendBufferSize = input->readInt32();
+  m_socketProfile.receiveBufferSize = input->readInt32();
+  m_socketProfile.noDelay = input->readInt8() == 1;
+  m_socketProfile.keepAliveTime = input->readUInt32();
+  m_socketProfile.autoTune = input->readInt8() == 1;
+  m_frameTrace = input->readInt8() == 1;
+  m_updateTrace = input->readInt8() == 1;
+  m_sessionRecording = input->readInt8() == 1;
+  m_maxClipboardToClients = input->readUInt32();
+  m_maxClipboardFromClients = input->readUInt32();
+  m_reduceVisualEffects = input->readInt8() == 1;
+  input->readUTF8(&m_relayHost);
+  m_relayPort = input->readUInt32();
+  m_hasRelayPassword = input->readInt8() == 1;
+  input->readFully(m_relayPassword, VNC_PASSWORD_SIZE);
+  input->readUTF8(&m_multicastGroup);
+  m_multicastPort = input->readUInt32();
+  m_multicastBandwidth = input->readUInt32();
+  input->readUTF8(&m_simdLevel);
+  m_largePageFrameBuffers = input->readInt8() == 1;
+  m_captureThreadPriority = input->readInt32();
+  m_senderThreadPriority = input->readInt32();
+  m_encoderThreadPriority = input->readInt32();
+  m_encoderAffinity = input->readInt8() == 1;
+  input->readUTF8(&m_syntheticWorkload);
+  m_syntheticWorkloadSeed = input->readUInt32();
 }
 
 bool ServerConfig::getShowTrayIconFlag()
@@ -771,6 +887,451 @@ void ServerConfig::setIdleTimeout(int timeout)
   m_idleTimeout = timeout;
 }
 
+unsigned int ServerConfig::getEncoderThreadCount()
+{
+  AutoLock lock(&m_objectCS);
+  return m_encoderThreadCount;
+}
+
+void ServerConfig::setEncoderThreadCount(unsigned int count)
+{
+  AutoLock lock(&m_objectCS);
+  m_encoderThreadCount = count;
+}
+
+unsigned int ServerConfig::getDirtyTileSize()
+{
+  AutoLock lock(&m_objectCS);
+  return m_dirtyTileSize;
+}
+
+void ServerConfig::setDirtyTileSize(unsigned int size)
+{
+  AutoLock lock(&m_objectCS);
+  m_dirtyTileSize = size;
+}
+
+void ServerConfig::enableGpuChangeDetection(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_gpuChangeDetection = enabled;
+}
+
+bool ServerConfig::isGpuChangeDetectionEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_gpuChangeDetection;
+}
+
+void ServerConfig::enableVblankPacedCapture(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_vblankPacedCapture = enabled;
+}
+
+bool ServerConfig::isVblankPacedCaptureEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_vblankPacedCapture;
+}
+
+void ServerConfig::enableAutoVideoDetection(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_autoVideoDetection = enabled;
+}
+
+bool ServerConfig::isAutoVideoDetectionEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_autoVideoDetection;
+}
+
+void ServerConfig::enableAdaptiveQuality(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_adaptiveQuality = enabled;
+}
+
+bool ServerConfig::isAdaptiveQualityEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_adaptiveQuality;
+}
+
+void ServerConfig::enableInteractiveFirst(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_interactiveFirst = enabled;
+}
+
+bool ServerConfig::isInteractiveFirstEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_interactiveFirst;
+}
+
+void ServerConfig::enablePreviewFirstFrame(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_previewFirstFrame = enabled;
+}
+
+bool ServerConfig::isPreviewFirstFrameEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_previewFirstFrame;
+}
+
+void ServerConfig::enableAutoEncoding(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_autoEncoding = enabled;
+}
+
+bool ServerConfig::isAutoEncodingEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_autoEncoding;
+}
+
+unsigned int ServerConfig::getMemoryBudget()
+{
+  AutoLock lock(&m_objectCS);
+  return m_memoryBudget;
+}
+
+void ServerConfig::setMemoryBudget(unsigned int megabytes)
+{
+  AutoLock lock(&m_objectCS);
+  m_memoryBudget = megabytes;
+}
+
+unsigned int ServerConfig::getMaxBandwidth()
+{
+  AutoLock lock(&m_objectCS);
+  return m_maxBandwidth;
+}
+
+void ServerConfig::setMaxBandwidth(unsigned int kilobytesPerSecond)
+{
+  AutoLock lock(&m_objectCS);
+  m_maxBandwidth = kilobytesPerSecond;
+}
+
+unsigned int ServerConfig::getMaxClientBandwidth()
+{
+  AutoLock lock(&m_objectCS);
+  return m_maxClientBandwidth;
+}
+
+void ServerConfig::setMaxClientBandwidth(unsigned int kilobytesPerSecond)
+{
+  AutoLock lock(&m_objectCS);
+  m_maxClientBandwidth = kilobytesPerSecond;
+}
+
+unsigned int ServerConfig::getMaxFileTransferBandwidth()
+{
+  AutoLock lock(&m_objectCS);
+  return m_maxFileTransferBandwidth;
+}
+
+void ServerConfig::setMaxFileTransferBandwidth(unsigned int kilobytesPerSecond)
+{
+  AutoLock lock(&m_objectCS);
+  m_maxFileTransferBandwidth = kilobytesPerSecond;
+}
+
+void ServerConfig::enableSharedFrameBuffer(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_sharedFrameBuffer = enabled;
+}
+
+bool ServerConfig::isSharedFrameBufferEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_sharedFrameBuffer;
+}
+
+void ServerConfig::enableIoCompletionPort(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_ioCompletionPort = enabled;
+}
+
+bool ServerConfig::isIoCompletionPortEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_ioCompletionPort;
+}
+
+void ServerConfig::getSocketProfile(SocketProfile *profile)
+{
+  AutoLock lock(&m_objectCS);
+  *profile = m_socketProfile;
+}
+
+void ServerConfig::setSocketProfile(const SocketProfile *profile)
+{
+  AutoLock lock(&m_objectCS);
+  m_socketProfile = *profile;
+}
+
+void ServerConfig::enableFrameTrace(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_frameTrace = enabled;
+}
+
+bool ServerConfig::isFrameTraceEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_frameTrace;
+}
+
+void ServerConfig::enableUpdateTrace(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_updateTrace = enabled;
+}
+
+bool ServerConfig::isUpdateTraceEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_updateTrace;
+}
+
+void ServerConfig::enableSessionRecording(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_sessionRecording = enabled;
+}
+
+bool ServerConfig::isSessionRecordingEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_sessionRecording;
+}
+
+unsigned int ServerConfig::getMaxClipboardToClients()
+{
+  AutoLock lock(&m_objectCS);
+  return m_maxClipboardToClients;
+}
+
+void ServerConfig::setMaxClipboardToClients(unsigned int size)
+{
+  AutoLock lock(&m_objectCS);
+  m_maxClipboardToClients = size;
+}
+
+unsigned int ServerConfig::getMaxClipboardFromClients()
+{
+  AutoLock lock(&m_objectCS);
+  return m_maxClipboardFromClients;
+}
+
+void ServerConfig::setMaxClipboardFromClients(unsigned int size)
+{
+  AutoLock lock(&m_objectCS);
+  m_maxClipboardFromClients = size;
+}
+
+void ServerConfig::enableReducingVisualEffects(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_reduceVisualEffects = enabled;
+}
+
+bool ServerConfig::isReducingVisualEffectsEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_reduceVisualEffects;
+}
+
+void ServerConfig::getRelayHost(StringStorage *host)
+{
+  AutoLock lock(&m_objectCS);
+  *host = m_relayHost;
+}
+
+void ServerConfig::setRelayHost(const TCHAR *host)
+{
+  AutoLock lock(&m_objectCS);
+  m_relayHost.setString(host);
+}
+
+unsigned int ServerConfig::getRelayPort()
+{
+  AutoLock lock(&m_objectCS);
+  return m_relayPort;
+}
+
+void ServerConfig::setRelayPort(unsigned int port)
+{
+  AutoLock lock(&m_objectCS);
+  m_relayPort = port;
+}
+
+void ServerConfig::getRelayPassword(unsigned char *password)
+{
+  AutoLock lock(&m_objectCS);
+  memcpy(password, m_relayPassword, VNC_PASSWORD_SIZE);
+}
+
+void ServerConfig::setRelayPassword(const unsigned char *value)
+{
+  AutoLock lock(&m_objectCS);
+  m_hasRelayPassword = true;
+  memcpy(m_relayPassword, value, VNC_PASSWORD_SIZE);
+}
+
+bool ServerConfig::hasRelayPassword()
+{
+  AutoLock lock(&m_objectCS);
+  return m_hasRelayPassword;
+}
+
+void ServerConfig::deleteRelayPassword()
+{
+  AutoLock lock(&m_objectCS);
+  m_hasRelayPassword = false;
+}
+
+void ServerConfig::getMulticastGroup(StringStorage *group)
+{
+  AutoLock lock(&m_objectCS);
+  *group = m_multicastGroup;
+}
+
+void ServerConfig::setMulticastGroup(const TCHAR *group)
+{
+  AutoLock lock(&m_objectCS);
+  m_multicastGroup.setString(group);
+}
+
+unsigned int ServerConfig::getMulticastPort()
+{
+  AutoLock lock(&m_objectCS);
+  return m_multicastPort;
+}
+
+void ServerConfig::setMulticastPort(unsigned int port)
+{
+  AutoLock lock(&m_objectCS);
+  m_multicastPort = port;
+}
+
+unsigned int ServerConfig::getMulticastBandwidth()
+{
+  AutoLock lock(&m_objectCS);
+  return m_multicastBandwidth;
+}
+
+void ServerConfig::setMulticastBandwidth(unsigned int kbytesPerSecond)
+{
+  AutoLock lock(&m_objectCS);
+  m_multicastBandwidth = kbytesPerSecond;
+}
+
+void ServerConfig::getSimdLevel(StringStorage *level)
+{
+  AutoLock lock(&m_objectCS);
+  *level = m_simdLevel;
+}
+
+void ServerConfig::setSimdLevel(const TCHAR *level)
+{
+  AutoLock lock(&m_objectCS);
+  m_simdLevel.setString(level);
+}
+
+bool ServerConfig::isLargePageFrameBuffersEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_largePageFrameBuffers;
+}
+
+void ServerConfig::enableLargePageFrameBuffers(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_largePageFrameBuffers = enabled;
+}
+
+int ServerConfig::getCaptureThreadPriority()
+{
+  AutoLock lock(&m_objectCS);
+  return m_captureThreadPriority;
+}
+
+void ServerConfig::setCaptureThreadPriority(int priority)
+{
+  AutoLock lock(&m_objectCS);
+  m_captureThreadPriority = priority;
+}
+
+int ServerConfig::getSenderThreadPriority()
+{
+  AutoLock lock(&m_objectCS);
+  return m_senderThreadPriority;
+}
+
+void ServerConfig::setSenderThreadPriority(int priority)
+{
+  AutoLock lock(&m_objectCS);
+  m_senderThreadPriority = priority;
+}
+
+int ServerConfig::getEncoderThreadPriority()
+{
+  AutoLock lock(&m_objectCS);
+  return m_encoderThreadPriority;
+}
+
+void ServerConfig::setEncoderThreadPriority(int priority)
+{
+  AutoLock lock(&m_objectCS);
+  m_encoderThreadPriority = priority;
+}
+
+bool ServerConfig::isEncoderAffinityEnabled()
+{
+  AutoLock lock(&m_objectCS);
+  return m_encoderAffinity;
+}
+
+void ServerConfig::enableEncoderAffinity(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_encoderAffinity = enabled;
+}
+
+void ServerConfig::getSyntheticWorkload(StringStorage *scenario)
+{
+  AutoLock lock(&m_objectCS);
+  *scenario = m_syntheticWorkload;
+}
+
+void ServerConfig::setSyntheticWorkload(const TCHAR *scenario)
+{
+  AutoLock lock(&m_objectCS);
+  m_syntheticWorkload.setString(scenario);
+}
+
+UINT32 ServerConfig::getSyntheticWorkloadSeed()
+{
+  AutoLock lock(&m_objectCS);
+  return m_syntheticWorkloadSeed;
+}
+
+void ServerConfig::setSyntheticWorkloadSeed(UINT32 seed)
+{
+  AutoLock lock(&m_objectCS);
+  m_syntheticWorkloadSeed = seed;
+}
+
 void ServerConfig::saveLogToAllUsersPath(bool enabled)
 {
   AutoLock lock(&m_objectCS);
@@ -36,6 +36,7 @@
 #include "io-lib/DataOutputStream.h"
 #include "io-lib/IOException.h"
 #include "region/RectSerializer.h"
+#include "network/socket/SocketProfile.h"
 
 #include <shlobj.h>
 
@@ -272,6 +273,176 @@ public:
   int  getIdleTimeout();
   void setIdleTimeout(int timeout);
 
+  // Number of threads used to encode rectangles of one framebuffer update
+  // for each client. 1 means encoding on the sender thread, 0 means the
+  // number of processors in the system.
+  unsigned int getEncoderThreadCount();
+  void setEncoderThreadCount(unsigned int count);
+
+  // Edge length in pixels of the tiles compared to find changed parts
+  // of the screen.
+  unsigned int getDirtyTileSize();
+  void setDirtyTileSize(unsigned int size);
+
+  // Detection of changed screen areas on the GPU for the desktop
+  // duplication screen driver.
+  void enableGpuChangeDetection(bool enabled);
+  bool isGpuChangeDetectionEnabled();
+
+  // Pacing of the desktop duplication capture by the vertical blank of
+  // the outputs, one frame per refresh at most.
+  void enableVblankPacedCapture(bool enabled);
+  bool isVblankPacedCaptureEnabled();
+
+  // Detection of video regions by the change frequency of the screen areas,
+  // in addition to the configured video classes and rectangles.
+  void enableAutoVideoDetection(bool enabled);
+  bool isAutoVideoDetectionEnabled();
+
+  // Adaptation of frame rate and encoding levels to the network congestion.
+  // If disabled, updates are sent as the clients request them.
+  void enableAdaptiveQuality(bool enabled);
+  bool isAdaptiveQualityEnabled();
+
+  // Sending of the changes around the pointer and the foreground window
+  // before the other changes, which go at a lower quality, or with the
+  // next updates when the output to a client is congested.
+  void enableInteractiveFirst(bool enabled);
+  bool isInteractiveFirstEnabled();
+
+  // Sending of the first full update to a client as a coarse JPEG preview,
+  // which is then resent at the normal quality starting around the pointer.
+  // Works with the clients which accept JPEG only.
+  void enablePreviewFirstFrame(bool enabled);
+  bool isPreviewFirstFrameEnabled();
+
+  // Choosing the encoding of each client among the ones it supports by
+  // trial encoding of its updates, instead of taking its preferred one.
+  void enableAutoEncoding(bool enabled);
+  bool isAutoEncodingEnabled();
+
+  // Memory in megabytes for the frame buffers and the encoder scratch
+  // buffers of all the clients. If it is not 0, the clients share their
+  // frame buffers and free the idle scratch buffers while it is exceeded.
+  unsigned int getMemoryBudget();
+  void setMemoryBudget(unsigned int megabytes);
+
+  // Limits of the data sent to the clients in kilobytes per second, 0 means
+  // no limit: for all the clients together, for each client, and for the
+  // file transfers of all the clients, which are limited apart from the
+  // other data (in both directions).
+  unsigned int getMaxBandwidth();
+  void setMaxBandwidth(unsigned int kilobytesPerSecond);
+  unsigned int getMaxClientBandwidth();
+  void setMaxClientBandwidth(unsigned int kilobytesPerSecond);
+  unsigned int getMaxFileTransferBandwidth();
+  void setMaxFileTransferBandwidth(unsigned int kilobytesPerSecond);
+
+  // Passing of pixels from the desktop server process to the service via
+  // shared memory instead of the pipe. The shared memory object is
+  // accessible to everyone who knows its (random) name.
+  void enableSharedFrameBuffer(bool enabled);
+  bool isSharedFrameBufferEnabled();
+
+  // Reading of client messages by a shared pool of threads waiting on an
+  // I/O completion port, instead of a dedicated thread for each client.
+  // Takes effect for new connections.
+  void enableIoCompletionPort(bool enabled);
+  bool isIoCompletionPortEnabled();
+
+  // Tuning of the sockets of all the client connections, incoming and
+  // outgoing.
+  void getSocketProfile(SocketProfile *profile);
+  void setSocketProfile(const SocketProfile *profile);
+
+  // Recording of the frame pipeline timing (capture, encode, send) to
+  // a Chrome trace file in the log directory when a client disconnects.
+  void enableFrameTrace(bool enabled);
+  bool isFrameTraceEnabled();
+
+  // Recording of the updates sent to every client to a trace file in the
+  // log directory, to be replayed by the encoder benchmark.
+  void enableUpdateTrace(bool enabled);
+  bool isUpdateTraceEnabled();
+
+  // Recording of the sessions as they are sent to the clients, with
+  // keyframes for seeking, to files in the log directory.
+  void enableSessionRecording(bool enabled);
+  bool isSessionRecordingEnabled();
+
+  // Limits of the clipboard text sent to and received from the clients,
+  // in bytes of the message payload, 0 if not limited. Larger clipboards
+  // are dropped.
+  unsigned int getMaxClipboardToClients();
+  void setMaxClipboardToClients(unsigned int size);
+  unsigned int getMaxClipboardFromClients();
+  void setMaxClipboardFromClients(unsigned int size);
+
+  // Turning off of the animations, the window contents while dragging, the
+  // shadows and on the slowest links the font smoothing while clients are
+  // connected, depending on the throughput to the slowest client.
+  void enableReducingVisualEffects(bool enabled);
+  bool isReducingVisualEffectsEnabled();
+
+  // Upstream server of the relay mode, in which the clients are shown the
+  // screen of that server, received by one connection, instead of the local
+  // one. An empty host turns the relay mode off. The relay mode is chosen
+  // when the server starts.
+  void getRelayHost(StringStorage *host);
+  void setRelayHost(const TCHAR *host);
+  unsigned int getRelayPort();
+  void setRelayPort(unsigned int port);
+  // Password for the upstream server, encrypted as the other passwords.
+  void getRelayPassword(unsigned char *password);
+  void setRelayPassword(const unsigned char *value);
+  bool hasRelayPassword();
+  void deleteRelayPassword();
+
+  // Multicast group the screen is sent to for the clients in the local
+  // network, which then receive only the lost rectangles by their own
+  // connections. An empty group turns the multicast off. The group is
+  // chosen when the server starts. The bandwidth of the stream is in KB/s,
+  // 0 means no limit.
+  void getMulticastGroup(StringStorage *group);
+  void setMulticastGroup(const TCHAR *group);
+  unsigned int getMulticastPort();
+  void setMulticastPort(unsigned int port);
+  unsigned int getMulticastBandwidth();
+  void setMulticastBandwidth(unsigned int kbytesPerSecond);
+
+  // Highest instruction set extension the SIMD kernels may use, one of
+  // the names of CpuFeatures::parseLevel(). Empty means the best supported
+  // one. Allows to compare the kernels, applied when the server starts.
+  void getSimdLevel(StringStorage *level);
+  void setSimdLevel(const TCHAR *level);
+
+  // Puts the big frame buffers on large pages, which needs the "Lock pages
+  // in memory" privilege. Applied when the server starts.
+  bool isLargePageFrameBuffersEnabled();
+  void enableLargePageFrameBuffers(bool enabled);
+
+  // Priorities of the capture, update sender and encoder threads relative
+  // to the normal one, from -2 to 2, and keeping the encoder threads of a
+  // client on the processors of one cache or NUMA node. See
+  // SchedulingPolicy, applied when the server starts.
+  int getCaptureThreadPriority();
+  void setCaptureThreadPriority(int priority);
+  int getSenderThreadPriority();
+  void setSenderThreadPriority(int priority);
+  int getEncoderThreadPriority();
+  void setEncoderThreadPriority(int priority);
+  bool isEncoderAffinityEnabled();
+  void enableEncoderAffinity(bool enabled);
+
+  // Scenario of the synthetic screen drawn instead of the real one, one of
+  // the names of SyntheticWorkload::parseScenario(), and the seed of its
+  // generator. Empty means the real screen. The same scenario and seed
+  // give the same frames, which makes the benchmark runs comparable.
+  void getSyntheticWorkload(StringStorage *scenario);
+  void setSyntheticWorkload(const TCHAR *scenario);
+  UINT32 getSyntheticWorkloadSeed();
+  void setSyntheticWorkloadSeed(UINT32 seed);
+
   void saveLogToAllUsersPath(bool enabled);
   bool isSaveLogToAllUsersPathFlagEnabled();
 
@@ -412,6 +583,90 @@ protected:
   // Socket timeout to disconnect inactive clients, in seconds
   int m_idleTimeout;
 
+  // Number of encoding threads per client (0 means the number of processors).
+  unsigned int m_encoderThreadCount;
+
+  // Tile size for detection of changed screen areas, in pixels.
+  unsigned int m_dirtyTileSize;
+
+  // Compare duplicated frames on the GPU or not.
+  bool m_gpuChangeDetection;
+
+  // Pace duplicated frames by the vertical blank or not.
+  bool m_vblankPacedCapture;
+
+  // Detect video regions automatically or not.
+  bool m_autoVideoDetection;
+
+  // Adapt updates to the network congestion or not.
+  bool m_adaptiveQuality;
+
+  // Send the interactive area first on congested connections or not.
+  bool m_interactiveFirst;
+
+  // Send a preview as the first full update or not.
+  bool m_previewFirstFrame;
+
+  // Choose the encodings of the clients by trial encoding or not.
+  bool m_autoEncoding;
+
+  // Memory budget of the clients in megabytes, 0 means no limit.
+  unsigned int m_memoryBudget;
+
+  // Bandwidth limits in kilobytes per second, 0 means no limit.
+  unsigned int m_maxBandwidth;
+  unsigned int m_maxClientBandwidth;
+  unsigned int m_maxFileTransferBandwidth;
+
+  // Use shared memory to pass pixels from the desktop server or not.
+  bool m_sharedFrameBuffer;
+
+  // Read client messages via an I/O completion port or not.
+  bool m_ioCompletionPort;
+
+  // Tuning of the client connection sockets.
+  SocketProfile m_socketProfile;
+
+  // Record the frame pipeline timing or not.
+  bool m_frameTrace;
+
+  // Record the sent updates or not.
+  bool m_updateTrace;
+
+  // Record the sessions or not.
+  bool m_sessionRecording;
+
+  // Clipboard size limits for each direction, 0 if not limited.
+  unsigned int m_maxClipboardToClients;
+  unsigned int m_maxClipboardFromClients;
+
+  // Reduce the visual effects for slow clients or not.
+  bool m_reduceVisualEffects;
+
+  // Upstream server of the relay mode, no relay if the host is empty.
+  StringStorage m_relayHost;
+  unsigned int m_relayPort;
+  unsigned char m_relayPassword[VNC_PASSWORD_SIZE];
+
+  // Multicast distribution of the screen, none if the group is empty.
+  StringStorage m_multicastGroup;
+  unsigned int m_multicastPort;
+  unsigned int m_multicastBandwidth;
+
+  // Limit of the SIMD kernels, none if empty.
+  StringStorage m_simdLevel;
+  bool m_largePageFrameBuffers;
+
+  // Scheduling of the pipeline threads.
+  int m_captureThreadPriority;
+  int m_senderThreadPriority;
+  int m_encoderThreadPriority;
+  bool m_encoderAffinity;
+
+  // Synthetic screen, the real one if the scenario is empty.
+  StringStorage m_syntheticWorkload;
+  UINT32 m_syntheticWorkloadSeed;
+
   // Flag that determiates where log file directory will be.
   bool m_saveLogToAllUsersPath;
   // Run control interface with TightVNC server or not.
@@ -429,6 +684,7 @@ private:
   bool m_hasPrimaryPassword;
   bool m_hasReadOnlyPassword;
   bool m_hasControlPassword;
+  bool m_hasRelayPassword;
 
   //
   // Critical section
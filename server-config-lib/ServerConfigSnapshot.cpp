@@ -0,0 +1,52 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ServerConfigSnapshot.h"
+
+#include "thread/AutoLock.h"
+
+ServerConfigSnapshot::ServerConfigSnapshot(ServerConfig *config)
+{
+  AutoLock al(config);
+
+  m_enableFileTransfers = config->isFileTransfersEnabled();
+  m_blockRemoteInput = config->isBlockingRemoteInput();
+  m_blockLocalInput = config->isBlockingLocalInput();
+  m_localInputPriority = config->isLocalInputPriorityEnabled();
+  m_localInputPriorityTimeout = config->getLocalInputPriorityTimeout();
+  m_pollingInterval = config->getPollingInterval();
+  m_videoRecognitionInterval = config->getVideoRecognitionInterval();
+  m_autoVideoDetection = config->isAutoVideoDetectionEnabled();
+  m_grabTransparentWindows = config->getGrabTransparentWindowsFlag();
+  m_alwaysShared = config->isAlwaysShared();
+  m_neverShared = config->isNeverShared();
+  m_idleTimeout = config->getIdleTimeout();
+  m_connectToRdp = config->getConnectToRdpFlag();
+  m_accessTable = new IpAccessTable(config->getAccessControl());
+}
+
+ServerConfigSnapshot::~ServerConfigSnapshot()
+{
+  delete m_accessTable;
+}
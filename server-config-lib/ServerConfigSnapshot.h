@@ -0,0 +1,93 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _SERVER_CONFIG_SNAPSHOT_H_
+#define _SERVER_CONFIG_SNAPSHOT_H_
+
+#include "ServerConfig.h"
+#include "IpAccessTable.h"
+
+/**
+ * Immutable copy of the server settings that are read on hot paths
+ * (polling, input, screen grabbing, file transfer requests, accepting
+ * connections).
+ *
+ * Getters of the snapshot take no locks. The current snapshot is published
+ * by Configurator on every config reload, see
+ * Configurator::getConfigSnapshot().
+ */
+class ServerConfigSnapshot
+{
+public:
+  /**
+   * Copies the settings from config (under its lock).
+   */
+  ServerConfigSnapshot(ServerConfig *config);
+  virtual ~ServerConfigSnapshot();
+
+  bool isFileTransfersEnabled() const { return m_enableFileTransfers; }
+  bool isBlockingRemoteInput() const { return m_blockRemoteInput; }
+  bool isBlockingLocalInput() const { return m_blockLocalInput; }
+  bool isLocalInputPriorityEnabled() const { return m_localInputPriority; }
+  unsigned int getLocalInputPriorityTimeout() const { return m_localInputPriorityTimeout; }
+  unsigned int getPollingInterval() const { return m_pollingInterval; }
+  unsigned int getVideoRecognitionInterval() const { return m_videoRecognitionInterval; }
+  bool isAutoVideoDetectionEnabled() const { return m_autoVideoDetection; }
+  bool getGrabTransparentWindowsFlag() const { return m_grabTransparentWindows; }
+  bool isAlwaysShared() const { return m_alwaysShared; }
+  bool isNeverShared() const { return m_neverShared; }
+  int getIdleTimeout() const { return m_idleTimeout; }
+  bool getConnectToRdpFlag() const { return m_connectToRdp; }
+
+  /**
+   * Returns the action of the access control rules for the address in
+   * network byte order.
+   */
+  IpAccessRule::ActionType getActionByAddress(unsigned long ip) const
+  {
+    return m_accessTable->getAction(ip);
+  }
+
+private:
+  // Not copyable.
+  ServerConfigSnapshot(const ServerConfigSnapshot &);
+  ServerConfigSnapshot &operator=(const ServerConfigSnapshot &);
+
+  bool m_enableFileTransfers;
+  bool m_blockRemoteInput;
+  bool m_blockLocalInput;
+  bool m_localInputPriority;
+  unsigned int m_localInputPriorityTimeout;
+  unsigned int m_pollingInterval;
+  unsigned int m_videoRecognitionInterval;
+  bool m_autoVideoDetection;
+  bool m_grabTransparentWindows;
+  bool m_alwaysShared;
+  bool m_neverShared;
+  int m_idleTimeout;
+  bool m_connectToRdp;
+  IpAccessTable *m_accessTable;
+};
+
+#endif
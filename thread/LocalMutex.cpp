@@ -23,12 +23,26 @@
 //
 
 #include "LocalMutex.h"
+#include "LockProfiler.h"
 
 LocalMutex::LocalMutex(void)
+: m_lockName(0)
 {
   InitializeCriticalSection(&m_criticalSection);
 }
 
+LocalMutex::LocalMutex(const TCHAR *lockName)
+: m_lockName(lockName)
+{
+  InitializeCriticalSection(&m_criticalSection);
+}
+
+LocalMutex::LocalMutex(DWORD spinCount, const TCHAR *lockName)
+: m_lockName(lockName)
+{
+  InitializeCriticalSectionAndSpinCount(&m_criticalSection, spinCount);
+}
+
 LocalMutex::~LocalMutex(void)
 {
   DeleteCriticalSection(&m_criticalSection);
@@ -36,10 +50,24 @@ LocalMutex::~LocalMutex(void)
 
 void LocalMutex::lock()
 {
-  EnterCriticalSection(&m_criticalSection);
+  if (m_lockName != 0 && LockProfiler::isEnabled()) {
+    profiledLock();
+  } else {
+    EnterCriticalSection(&m_criticalSection);
+  }
 }
 
 void LocalMutex::unlock()
 {
   LeaveCriticalSection(&m_criticalSection);
 }
+
+void LocalMutex::profiledLock()
+{
+  if (TryEnterCriticalSection(&m_criticalSection)) {
+    return;
+  }
+  INT64 waitStart = LockProfiler::getWaitStart();
+  EnterCriticalSection(&m_criticalSection);
+  LockProfiler::onContendedAcquire(m_lockName, waitStart);
+}
@@ -34,6 +34,9 @@
  *
  * @remark local mutex uses Windows critical sections to implement
  * lockable interface..
+ *
+ * A mutex created with a name reports its contention to LockProfiler
+ * while the profiler is enabled.
  */
 class LocalMutex : public Lockable
 {
@@ -43,6 +46,12 @@ public:
    */
   LocalMutex();
 
+  /**
+   * Creates new local mutex profiled under the lockName name.
+   * @param lockName static string that must outlive the mutex.
+   */
+  LocalMutex(const TCHAR *lockName);
+
   /**
    * Deletes local mutex.
    */
@@ -58,11 +67,25 @@ public:
    */
   virtual void unlock();
 
+protected:
+  /**
+   * Creates new local mutex spinning spinCount times on contention before
+   * waiting in the kernel.
+   */
+  LocalMutex(DWORD spinCount, const TCHAR *lockName);
+
 private:
+  void profiledLock();
+
   /**
    * Windows critical section.
    */
   CRITICAL_SECTION m_criticalSection;
+
+  /**
+   * Name in the lock profiler or 0 if the mutex is not profiled.
+   */
+  const TCHAR *m_lockName;
 };
 
 #endif // __LOCALMUTEX_H__
@@ -0,0 +1,106 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LockProfiler.h"
+#include "LocalMutex.h"
+#include "AutoLock.h"
+
+#include <map>
+#include <algorithm>
+
+typedef std::map<StringStorage, LockContention> ContentionMap;
+
+volatile bool LockProfiler::s_isEnabled = false;
+
+// The lock of the map is not named, so it is never profiled itself.
+static LocalMutex s_contentionLock;
+static ContentionMap s_contentions;
+static INT64 s_timerFrequency = 0;
+
+static bool moreWaited(const LockContention &a, const LockContention &b)
+{
+  return a.totalWaitTime > b.totalWaitTime;
+}
+
+void LockProfiler::setEnabled(bool enabled)
+{
+  if (enabled && s_timerFrequency == 0) {
+    LARGE_INTEGER frequency;
+    if (!QueryPerformanceFrequency(&frequency)) {
+      return;
+    }
+    s_timerFrequency = frequency.QuadPart;
+  }
+  s_isEnabled = enabled;
+}
+
+INT64 LockProfiler::getWaitStart()
+{
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
+
+void LockProfiler::onContendedAcquire(const TCHAR *lockName, INT64 waitStart)
+{
+  UINT64 waitTime = (UINT64)(getWaitStart() - waitStart) * 1000000 /
+                    s_timerFrequency;
+
+  AutoLock al(&s_contentionLock);
+  StringStorage key(lockName);
+  ContentionMap::iterator it = s_contentions.find(key);
+  if (it == s_contentions.end()) {
+    LockContention contention;
+    contention.lockName = key;
+    contention.contentions = 0;
+    contention.totalWaitTime = 0;
+    contention.maxWaitTime = 0;
+    it = s_contentions.insert(ContentionMap::value_type(key, contention)).first;
+  }
+  LockContention *contention = &it->second;
+  contention->contentions++;
+  contention->totalWaitTime += waitTime;
+  if (waitTime > contention->maxWaitTime) {
+    contention->maxWaitTime = waitTime;
+  }
+}
+
+void LockProfiler::getContentions(std::vector<LockContention> *contentions)
+{
+  contentions->clear();
+  {
+    AutoLock al(&s_contentionLock);
+    for (ContentionMap::iterator it = s_contentions.begin();
+         it != s_contentions.end(); it++) {
+      contentions->push_back(it->second);
+    }
+  }
+  std::sort(contentions->begin(), contentions->end(), moreWaited);
+}
+
+void LockProfiler::reset()
+{
+  AutoLock al(&s_contentionLock);
+  s_contentions.clear();
+}
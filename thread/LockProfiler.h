@@ -0,0 +1,88 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __LOCKPROFILER_H__
+#define __LOCKPROFILER_H__
+
+#include "util/CommonHeader.h"
+#include "util/inttypes.h"
+
+#include <vector>
+
+/**
+ * Contention counters of the locks sharing one name.
+ */
+struct LockContention
+{
+  StringStorage lockName;
+  // Number of acquisitions that had to wait for another thread.
+  UINT64 contentions;
+  // Total and maximum wait time, in microseconds.
+  UINT64 totalWaitTime;
+  UINT64 maxWaitTime;
+};
+
+/**
+ * Process-wide profiler of lock contention.
+ *
+ * Named locks (LocalMutex, ReadWriteMutex) report here every acquisition
+ * that could not be taken at once, with the time spent waiting. Uncontended
+ * acquisitions are not recorded, so the profiler costs next to nothing for
+ * locks that are not a problem. The profiler is disabled by default, then
+ * the named locks only test one flag.
+ */
+class LockProfiler
+{
+public:
+  static void setEnabled(bool enabled);
+  static bool isEnabled() { return s_isEnabled; }
+
+  /**
+   * Returns the current value of the wait timer, to pass it to
+   * onContendedAcquire() after the lock has been taken.
+   */
+  static INT64 getWaitStart();
+
+  /**
+   * Records that a lock with the given name has been acquired after waiting
+   * since waitStart.
+   */
+  static void onContendedAcquire(const TCHAR *lockName, INT64 waitStart);
+
+  /**
+   * Returns counters of all the lock names that have been contended,
+   * the most waited ones first.
+   */
+  static void getContentions(std::vector<LockContention> *contentions);
+
+  /**
+   * Forgets all the recorded counters.
+   */
+  static void reset();
+
+private:
+  static volatile bool s_isEnabled;
+};
+
+#endif // __LOCKPROFILER_H__
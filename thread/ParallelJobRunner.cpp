@@ -0,0 +1,167 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ParallelJobRunner.h"
+#include "AutoLock.h"
+#include "util/Exception.h"
+
+// A thread of ParallelJobRunner, it waits for a job and processes its parts
+// along with the other threads.
+class ParallelJobThread : public Thread
+{
+public:
+  ParallelJobThread(ParallelJobRunner *runner)
+  : m_runner(runner)
+  {
+    resume();
+  }
+
+  virtual ~ParallelJobThread()
+  {
+    terminate();
+    wait();
+  }
+
+  void startJob()
+  {
+    m_startEvent.notify();
+  }
+
+protected:
+  virtual void execute()
+  {
+    while (!isTerminating()) {
+      m_startEvent.waitForEvent();
+      if (!isTerminating()) {
+        m_runner->processParts();
+        m_runner->onThreadDone();
+      }
+    }
+  }
+
+  virtual void onTerminate()
+  {
+    m_startEvent.notify();
+  }
+
+  ParallelJobRunner *m_runner;
+  WindowsEvent m_startEvent;
+};
+
+ParallelJobRunner::ParallelJobRunner(unsigned int numThreads)
+: m_job(0),
+  m_numParts(0),
+  m_nextPart(0),
+  m_numRunning(0),
+  m_failed(false)
+{
+  if (numThreads == 0) {
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    numThreads = sysInfo.dwNumberOfProcessors;
+  }
+  // The calling thread is one of them.
+  for (unsigned int i = 1; i < numThreads; i++) {
+    m_threads.push_back(new ParallelJobThread(this));
+  }
+}
+
+ParallelJobRunner::~ParallelJobRunner()
+{
+  std::vector<ParallelJobThread *>::iterator i;
+  for (i = m_threads.begin(); i != m_threads.end(); i++) {
+    delete *i;
+  }
+}
+
+size_t ParallelJobRunner::getNumThreads() const
+{
+  return m_threads.size() + 1;
+}
+
+void ParallelJobRunner::run(ParallelJob *job, size_t numParts)
+{
+  if (numParts == 0) {
+    return;
+  }
+  size_t numExtraThreads = min(m_threads.size(), numParts - 1);
+  {
+    AutoLock al(&m_lock);
+    m_job = job;
+    m_numParts = numParts;
+    m_nextPart = 0;
+    m_numRunning = numExtraThreads;
+    m_failed = false;
+    m_errorMessage.setString(_T(""));
+  }
+  for (size_t i = 0; i < numExtraThreads; i++) {
+    m_threads[i]->startJob();
+  }
+
+  processParts();
+  if (numExtraThreads != 0) {
+    m_doneEvent.waitForEvent();
+  }
+
+  AutoLock al(&m_lock);
+  m_job = 0;
+  if (m_failed) {
+    throw Exception(m_errorMessage.getString());
+  }
+}
+
+void ParallelJobRunner::processParts()
+{
+  while (true) {
+    size_t index;
+    {
+      AutoLock al(&m_lock);
+      if (m_failed || m_nextPart >= m_numParts) {
+        return;
+      }
+      index = m_nextPart++;
+    }
+    try {
+      m_job->runPart(index);
+    } catch (Exception &e) {
+      AutoLock al(&m_lock);
+      if (!m_failed) {
+        m_failed = true;
+        m_errorMessage.setString(e.getMessage());
+      }
+    }
+  }
+}
+
+void ParallelJobRunner::onThreadDone()
+{
+  bool isLast;
+  {
+    AutoLock al(&m_lock);
+    isLast = --m_numRunning == 0;
+  }
+  if (isLast) {
+    m_doneEvent.notify();
+  }
+}
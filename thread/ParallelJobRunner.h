@@ -0,0 +1,94 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __PARALLELJOBRUNNER_H__
+#define __PARALLELJOBRUNNER_H__
+
+#include "Thread.h"
+#include "LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/StringStorage.h"
+
+#include <vector>
+
+// A job consisting of independent parts, see ParallelJobRunner.
+class ParallelJob
+{
+public:
+  virtual ~ParallelJob() {}
+
+  // Processes the part with the given index. Different parts are processed
+  // by different threads at the same time. May throw Exception.
+  virtual void runPart(size_t index) = 0;
+};
+
+class ParallelJobThread;
+
+// ParallelJobRunner processes the parts of a ParallelJob with a set of
+// threads kept between the jobs. The calling thread processes parts as
+// well, so a runner with one thread works without any extra threads.
+class ParallelJobRunner
+{
+  friend class ParallelJobThread;
+
+public:
+  // Creates a runner for numThreads threads including the calling one. If
+  // numThreads is 0, the number of processors in the system will be used.
+  ParallelJobRunner(unsigned int numThreads);
+  virtual ~ParallelJobRunner();
+
+  size_t getNumThreads() const;
+
+  // Processes numParts parts of the job and returns when all of them are
+  // done. It must not be called from different threads at the same time.
+  // Throws Exception if any of the parts failed.
+  void run(ParallelJob *job, size_t numParts);
+
+protected:
+  // Processes parts of the current job until there are none left.
+  void processParts();
+  // Called by each extra thread when it has finished the current job.
+  void onThreadDone();
+
+  std::vector<ParallelJobThread *> m_threads;
+
+  // State of the current job, protected by m_lock.
+  ParallelJob *m_job;
+  size_t m_numParts;
+  size_t m_nextPart;
+  size_t m_numRunning;
+  bool m_failed;
+  StringStorage m_errorMessage;
+  LocalMutex m_lock;
+
+  // Notified when the last extra thread has finished the job.
+  WindowsEvent m_doneEvent;
+
+private:
+  // Do not allow copying objects.
+  ParallelJobRunner(const ParallelJobRunner &other);
+  ParallelJobRunner &operator=(const ParallelJobRunner &other);
+};
+
+#endif // __PARALLELJOBRUNNER_H__
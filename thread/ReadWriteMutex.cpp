@@ -0,0 +1,168 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ReadWriteMutex.h"
+#include "LockProfiler.h"
+
+typedef VOID (WINAPI *pSrwLockFunction)(void **srwLock);
+typedef BOOLEAN (WINAPI *pSrwTryLockFunction)(void **srwLock);
+
+// The functions are resolved by the first mutex. Concurrent first mutexes
+// store the same values, so no synchronization is needed.
+static volatile bool s_srwResolved = false;
+static pSrwLockFunction s_initializeSRWLock = 0;
+static pSrwLockFunction s_acquireSRWLockExclusive = 0;
+static pSrwLockFunction s_releaseSRWLockExclusive = 0;
+static pSrwLockFunction s_acquireSRWLockShared = 0;
+static pSrwLockFunction s_releaseSRWLockShared = 0;
+// Windows 7 and later.
+static pSrwTryLockFunction s_tryAcquireSRWLockExclusive = 0;
+static pSrwTryLockFunction s_tryAcquireSRWLockShared = 0;
+
+static void resolveSrwFunctions()
+{
+  HMODULE kernel32 = GetModuleHandle(_T("kernel32.dll"));
+  if (kernel32 != 0) {
+    pSrwLockFunction acquireExclusive =
+      (pSrwLockFunction)GetProcAddress(kernel32, "AcquireSRWLockExclusive");
+    pSrwLockFunction releaseExclusive =
+      (pSrwLockFunction)GetProcAddress(kernel32, "ReleaseSRWLockExclusive");
+    pSrwLockFunction acquireShared =
+      (pSrwLockFunction)GetProcAddress(kernel32, "AcquireSRWLockShared");
+    pSrwLockFunction releaseShared =
+      (pSrwLockFunction)GetProcAddress(kernel32, "ReleaseSRWLockShared");
+    s_tryAcquireSRWLockExclusive =
+      (pSrwTryLockFunction)GetProcAddress(kernel32, "TryAcquireSRWLockExclusive");
+    s_tryAcquireSRWLockShared =
+      (pSrwTryLockFunction)GetProcAddress(kernel32, "TryAcquireSRWLockShared");
+    if (acquireExclusive != 0 && releaseExclusive != 0 &&
+        acquireShared != 0 && releaseShared != 0) {
+      s_acquireSRWLockExclusive = acquireExclusive;
+      s_releaseSRWLockExclusive = releaseExclusive;
+      s_acquireSRWLockShared = acquireShared;
+      s_releaseSRWLockShared = releaseShared;
+      s_initializeSRWLock =
+        (pSrwLockFunction)GetProcAddress(kernel32, "InitializeSRWLock");
+    }
+  }
+  s_srwResolved = true;
+}
+
+ReadWriteMutex::ReadWriteMutex()
+: m_srwLock(0),
+  m_lockName(0)
+{
+  init();
+}
+
+ReadWriteMutex::ReadWriteMutex(const TCHAR *lockName)
+: m_srwLock(0),
+  m_lockName(lockName)
+{
+  init();
+}
+
+void ReadWriteMutex::init()
+{
+  if (!s_srwResolved) {
+    resolveSrwFunctions();
+  }
+  if (s_acquireSRWLockExclusive != 0) {
+    // A zeroed SRWLOCK is an initialized one.
+    if (s_initializeSRWLock != 0) {
+      s_initializeSRWLock(&m_srwLock);
+    }
+  } else {
+    InitializeCriticalSection(&m_criticalSection);
+  }
+}
+
+ReadWriteMutex::~ReadWriteMutex()
+{
+  if (s_acquireSRWLockExclusive == 0) {
+    DeleteCriticalSection(&m_criticalSection);
+  }
+}
+
+void ReadWriteMutex::lock()
+{
+  bool profiled = m_lockName != 0 && LockProfiler::isEnabled();
+
+  if (s_acquireSRWLockExclusive == 0) {
+    if (!profiled) {
+      EnterCriticalSection(&m_criticalSection);
+    } else if (!TryEnterCriticalSection(&m_criticalSection)) {
+      INT64 waitStart = LockProfiler::getWaitStart();
+      EnterCriticalSection(&m_criticalSection);
+      LockProfiler::onContendedAcquire(m_lockName, waitStart);
+    }
+    return;
+  }
+
+  if (!profiled) {
+    s_acquireSRWLockExclusive(&m_srwLock);
+  } else if (s_tryAcquireSRWLockExclusive == 0 ||
+             !s_tryAcquireSRWLockExclusive(&m_srwLock)) {
+    INT64 waitStart = LockProfiler::getWaitStart();
+    s_acquireSRWLockExclusive(&m_srwLock);
+    // Without the try function uncontended acquisitions are recorded too,
+    // with a wait time close to zero.
+    LockProfiler::onContendedAcquire(m_lockName, waitStart);
+  }
+}
+
+void ReadWriteMutex::unlock()
+{
+  if (s_releaseSRWLockExclusive != 0) {
+    s_releaseSRWLockExclusive(&m_srwLock);
+  } else {
+    LeaveCriticalSection(&m_criticalSection);
+  }
+}
+
+void ReadWriteMutex::lockShared()
+{
+  if (s_acquireSRWLockShared == 0) {
+    lock();
+    return;
+  }
+
+  if (m_lockName == 0 || !LockProfiler::isEnabled()) {
+    s_acquireSRWLockShared(&m_srwLock);
+  } else if (s_tryAcquireSRWLockShared == 0 ||
+             !s_tryAcquireSRWLockShared(&m_srwLock)) {
+    INT64 waitStart = LockProfiler::getWaitStart();
+    s_acquireSRWLockShared(&m_srwLock);
+    LockProfiler::onContendedAcquire(m_lockName, waitStart);
+  }
+}
+
+void ReadWriteMutex::unlockShared()
+{
+  if (s_releaseSRWLockShared != 0) {
+    s_releaseSRWLockShared(&m_srwLock);
+  } else {
+    unlock();
+  }
+}
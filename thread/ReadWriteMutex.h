@@ -0,0 +1,89 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __READWRITEMUTEX_H__
+#define __READWRITEMUTEX_H__
+
+#include "util/CommonHeader.h"
+
+#include "Lockable.h"
+
+/**
+ * Local mutex that can be held by many readers at once or by one writer.
+ *
+ * The Lockable interface (and so AutoLock) takes it exclusively, use
+ * AutoReadLock and AutoWriteLock to show the intention.
+ *
+ * @remark the mutex is built on Windows slim reader/writer locks, which are
+ * resolved at run time. On Windows XP it falls back to a critical section,
+ * the readers then exclude each other.
+ * @remark unlike LocalMutex the mutex is not recursive: a thread must not
+ * take it again, even for reading, while it holds it.
+ * @remark a mutex created with a name reports its contention to
+ * LockProfiler while the profiler is enabled.
+ */
+class ReadWriteMutex : public Lockable
+{
+public:
+  ReadWriteMutex();
+
+  /**
+   * @param lockName static string that must outlive the mutex.
+   */
+  ReadWriteMutex(const TCHAR *lockName);
+
+  virtual ~ReadWriteMutex();
+
+  /**
+   * Takes the mutex exclusively.
+   */
+  virtual void lock();
+
+  /**
+   * Releases the exclusive ownership.
+   */
+  virtual void unlock();
+
+  /**
+   * Takes the mutex shared with other readers.
+   */
+  void lockShared();
+
+  /**
+   * Releases the shared ownership.
+   */
+  void unlockShared();
+
+private:
+  void init();
+
+  // SRWLOCK, which is not declared for the Windows XP target.
+  void *m_srwLock;
+  // Used when slim reader/writer locks are not available.
+  CRITICAL_SECTION m_criticalSection;
+
+  const TCHAR *m_lockName;
+};
+
+#endif // __READWRITEMUTEX_H__
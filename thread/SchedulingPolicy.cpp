@@ -0,0 +1,202 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SchedulingPolicy.h"
+#include "AutoLock.h"
+
+typedef BOOL (WINAPI *pGetLogicalProcessorInformation)(
+  PSYSTEM_LOGICAL_PROCESSOR_INFORMATION buffer, PDWORD returnedLength);
+
+int SchedulingPolicy::m_priorities[ROLE_COUNT] = { 0, 0, 0, 0, 1 };
+bool SchedulingPolicy::m_encoderAffinity = false;
+std::vector<DWORD_PTR> SchedulingPolicy::m_cacheDomains;
+std::vector<DWORD_PTR> SchedulingPolicy::m_numaNodes;
+size_t SchedulingPolicy::m_nextCacheDomain = 0;
+size_t SchedulingPolicy::m_nextNumaNode = 0;
+LocalMutex SchedulingPolicy::m_lock;
+
+static const TCHAR *const ROLE_NAMES[] = {
+  _T("capture"), _T("sender"), _T("encoder"), _T("render"), _T("decode")
+};
+
+void SchedulingPolicy::setPriority(int role, int relativePriority)
+{
+  if (role < 0 || role >= ROLE_COUNT) {
+    return;
+  }
+  m_priorities[role] = max(-2, min(2, relativePriority));
+}
+
+int SchedulingPolicy::getPriority(int role)
+{
+  if (role < 0 || role >= ROLE_COUNT) {
+    return 0;
+  }
+  return m_priorities[role];
+}
+
+void SchedulingPolicy::setEncoderAffinity(bool enabled)
+{
+  AutoLock al(&m_lock);
+  m_encoderAffinity = enabled;
+  if (enabled) {
+    detectTopology();
+  }
+}
+
+void SchedulingPolicy::apply(Thread *thread, int role)
+{
+  if (role == ROLE_CAPTURE) {
+    thread->setMmcssTask(_T("Capture"));
+  } else if (role == ROLE_RENDER) {
+    thread->setMmcssTask(_T("Playback"));
+  }
+  switch (getPriority(role)) {
+  case -2:
+    thread->setPriority(PRIORITY_LOWEST);
+    break;
+  case -1:
+    thread->setPriority(PRIORITY_BELOW_NORMAL);
+    break;
+  case 1:
+    thread->setPriority(PRIORITY_ABOVE_NORMAL);
+    break;
+  case 2:
+    thread->setPriority(PRIORITY_HIGHEST);
+    break;
+  }
+}
+
+DWORD_PTR SchedulingPolicy::takeEncoderAffinity(size_t numThreads)
+{
+  AutoLock al(&m_lock);
+  if (!m_encoderAffinity) {
+    return 0;
+  }
+  DWORD_PTR mask = takeDomain(&m_cacheDomains, &m_nextCacheDomain, numThreads);
+  if (mask == 0) {
+    mask = takeDomain(&m_numaNodes, &m_nextNumaNode, numThreads);
+  }
+  return mask;
+}
+
+void SchedulingPolicy::getDescription(StringStorage *desc)
+{
+  desc->setString(_T("priorities"));
+  for (int i = 0; i < ROLE_COUNT; i++) {
+    StringStorage item;
+    item.format(_T("%s %s %d"), i == 0 ? _T("") : _T(","), ROLE_NAMES[i],
+                m_priorities[i]);
+    desc->appendString(item.getString());
+  }
+  AutoLock al(&m_lock);
+  if (!m_encoderAffinity) {
+    desc->appendString(_T("; encoder affinity off"));
+  } else {
+    StringStorage affinity;
+    affinity.format(_T("; encoder affinity over %u caches, %u NUMA nodes"),
+                    (unsigned int)m_cacheDomains.size(),
+                    (unsigned int)m_numaNodes.size());
+    desc->appendString(affinity.getString());
+  }
+}
+
+void SchedulingPolicy::detectTopology()
+{
+  m_cacheDomains.clear();
+  m_numaNodes.clear();
+  m_nextCacheDomain = 0;
+  m_nextNumaNode = 0;
+
+  // Windows XP SP3 and later.
+  HMODULE kernel32 = GetModuleHandle(_T("kernel32.dll"));
+  if (kernel32 == 0) {
+    return;
+  }
+  pGetLogicalProcessorInformation getInformation =
+    (pGetLogicalProcessorInformation)GetProcAddress(kernel32,
+                                                    "GetLogicalProcessorInformation");
+  DWORD_PTR processMask, systemMask;
+  if (getInformation == 0 ||
+      GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) == 0) {
+    return;
+  }
+  DWORD length = 0;
+  getInformation(0, &length);
+  if (length == 0) {
+    return;
+  }
+  std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info;
+  info.resize(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+  length = (DWORD)(info.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+  if (getInformation(&info.front(), &length) == 0) {
+    return;
+  }
+  size_t count = length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+
+  // The last level cache is the unified cache of the highest level.
+  BYTE lastLevel = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (info[i].Relationship == RelationCache &&
+        info[i].Cache.Type == CacheUnified &&
+        info[i].Cache.Level > lastLevel) {
+      lastLevel = info[i].Cache.Level;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    DWORD_PTR mask = info[i].ProcessorMask & processMask;
+    if (mask == 0) {
+      continue;
+    }
+    if (info[i].Relationship == RelationNumaNode) {
+      m_numaNodes.push_back(mask);
+    } else if (info[i].Relationship == RelationCache &&
+               info[i].Cache.Type == CacheUnified &&
+               info[i].Cache.Level == lastLevel) {
+      m_cacheDomains.push_back(mask);
+    }
+  }
+}
+
+DWORD_PTR SchedulingPolicy::takeDomain(const std::vector<DWORD_PTR> *domains,
+                                       size_t *next, size_t numThreads)
+{
+  for (size_t i = 0; i < domains->size(); i++) {
+    size_t index = (*next + i) % domains->size();
+    if (countProcessors((*domains)[index]) >= numThreads) {
+      *next = index + 1;
+      return (*domains)[index];
+    }
+  }
+  return 0;
+}
+
+size_t SchedulingPolicy::countProcessors(DWORD_PTR mask)
+{
+  size_t count = 0;
+  for (; mask != 0; mask &= mask - 1) {
+    count++;
+  }
+  return count;
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SCHEDULINGPOLICY_H__
+#define __SCHEDULINGPOLICY_H__
+
+#include "Thread.h"
+#include "LocalMutex.h"
+
+#include <vector>
+
+// SchedulingPolicy keeps the scheduling of the threads of the capture and
+// encoding pipeline for the whole process: the priority of each thread
+// role, the MMCSS task the capture and render threads are registered with
+// and the processors the encoder threads are kept on. It is set up when
+// the process starts and applied by the threads before they are resumed.
+class SchedulingPolicy
+{
+public:
+  enum Role
+  {
+    // The screen capture thread, registered as the "Capture" MMCSS task.
+    ROLE_CAPTURE,
+    // The update sender thread of a client.
+    ROLE_SENDER,
+    // The encoding threads of a client.
+    ROLE_ENCODER,
+    // The viewer thread presenting the updates, registered as the
+    // "Playback" MMCSS task.
+    ROLE_RENDER,
+    // The viewer thread reading and decoding the updates, above normal
+    // by default.
+    ROLE_DECODE,
+    ROLE_COUNT
+  };
+
+  // Sets the priority of the role relative to the normal one, from -2
+  // (lowest) to 2 (highest) as THREAD_PRIORITY_* values, others are
+  // clamped. The threads registered with MMCSS get the priority of the
+  // task instead while MMCSS is available.
+  static void setPriority(int role, int relativePriority);
+  static int getPriority(int role);
+
+  // Keeps the threads of each encoder pool on the processors sharing
+  // their last level cache, or on one NUMA node if there are too few of
+  // them. The pools are spread between the caches and nodes in turn.
+  static void setEncoderAffinity(bool enabled);
+
+  // Applies the priority and the MMCSS task of the role to the thread.
+  static void apply(Thread *thread, int role);
+
+  // Returns the processors for the next pool of numThreads encoder
+  // threads, 0 if they are not restricted.
+  static DWORD_PTR takeEncoderAffinity(size_t numThreads);
+
+  // Returns a description of the policy for the log.
+  static void getDescription(StringStorage *desc);
+
+private:
+  // Fills the processor masks of the last level caches and of the NUMA
+  // nodes available to the process.
+  static void detectTopology();
+  // Returns the first mask of at least numThreads processors starting from
+  // *next, which is moved past it, or 0 if there is none.
+  static DWORD_PTR takeDomain(const std::vector<DWORD_PTR> *domains,
+                              size_t *next, size_t numThreads);
+  static size_t countProcessors(DWORD_PTR mask);
+
+  static int m_priorities[ROLE_COUNT];
+  static bool m_encoderAffinity;
+  static std::vector<DWORD_PTR> m_cacheDomains;
+  static std::vector<DWORD_PTR> m_numaNodes;
+  static size_t m_nextCacheDomain;
+  static size_t m_nextNumaNode;
+  static LocalMutex m_lock;
+};
+
+#endif // __SCHEDULINGPOLICY_H__
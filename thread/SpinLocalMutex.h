@@ -0,0 +1,47 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SPINLOCALMUTEX_H__
+#define __SPINLOCALMUTEX_H__
+
+#include "LocalMutex.h"
+
+/**
+ * Local mutex that spins for a while on contention before the thread is
+ * parked in the kernel.
+ *
+ * @remark use it for locks held for a few hundreds of instructions, where a
+ * context switch costs more than the wait. The spinning is skipped on single
+ * processor machines by Windows.
+ */
+class SpinLocalMutex : public LocalMutex
+{
+public:
+  static const DWORD DEFAULT_SPIN_COUNT = 4000;
+
+  SpinLocalMutex(DWORD spinCount = DEFAULT_SPIN_COUNT);
+  SpinLocalMutex(const TCHAR *lockName, DWORD spinCount = DEFAULT_SPIN_COUNT);
+};
+
+#endif // __SPINLOCALMUTEX_H__
@@ -0,0 +1,65 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __TASK_H__
+#define __TASK_H__
+
+#include "util/CommonHeader.h"
+
+/**
+ * Unit of work run by a TaskScheduler.
+ *
+ * A task object is not owned by the scheduler. It runs on one thread at a
+ * time: posting it while it runs makes it run once more afterwards, and
+ * posting it while it is queued does nothing. The owner must cancel the
+ * task by TaskScheduler::cancel() before destroying it.
+ */
+class Task
+{
+  friend class TaskScheduler;
+
+public:
+  Task();
+  virtual ~Task();
+
+protected:
+  /**
+   * Does the work. It must not block for long, because the threads of the
+   * scheduler are shared by all its tasks. Exceptions are caught and
+   * dropped by the scheduler.
+   */
+  virtual void run() = 0;
+
+private:
+  // Scheduling state, see TaskScheduler.
+  volatile LONG m_state;
+  // Number of scheduler threads that have taken the task and have not left
+  // it yet.
+  volatile LONG m_takenCount;
+  // True while the task is in the timer queue, protected by the timer lock
+  // of the scheduler.
+  bool m_hasTimer;
+};
+
+#endif // __TASK_H__
@@ -0,0 +1,298 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TaskScheduler.h"
+#include "Thread.h"
+#include "AutoLock.h"
+#include "util/Exception.h"
+
+// A thread of TaskScheduler, it processes the tasks of its queue and
+// steals the tasks of the other ones.
+class TaskSchedulerThread : public Thread
+{
+public:
+  TaskSchedulerThread(TaskScheduler *scheduler, size_t index,
+                      bool attachToInputDesktop)
+  : m_scheduler(scheduler),
+    m_index(index),
+    m_hDesk(0)
+  {
+    if (attachToInputDesktop) {
+      m_hDesk = DesktopSelector::getInputDesktop();
+    }
+  }
+
+  virtual ~TaskSchedulerThread()
+  {
+    wait();
+    if (m_hDesk) {
+      DesktopSelector::closeDesktop(m_hDesk);
+    }
+  }
+
+protected:
+  virtual void execute()
+  {
+    if (m_hDesk) {
+      DesktopSelector::setDesktopToCurrentThread(m_hDesk);
+      if (DesktopSelector::closeDesktop(m_hDesk)) {
+        m_hDesk = 0;
+      }
+    }
+    m_scheduler->processTasks(m_index);
+  }
+
+  TaskScheduler *m_scheduler;
+  size_t m_index;
+  HDESK m_hDesk;
+};
+
+TaskScheduler::TaskScheduler(unsigned int numThreads,
+                             bool attachToInputDesktop)
+: m_nextQueue(0),
+  m_wakeUpSemaphore(0),
+  m_isTerminating(false),
+  m_lastTick(GetTickCount()),
+  m_time(0)
+{
+  if (numThreads == 0) {
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    numThreads = sysInfo.dwNumberOfProcessors;
+  }
+  m_wakeUpSemaphore = CreateSemaphore(0, 0, MAXLONG, 0);
+  if (m_wakeUpSemaphore == 0) {
+    StringStorage errMess;
+    errMess.format(_T("Cannot create semaphore of the task scheduler")
+                   _T(" with error = %d"), (int)GetLastError());
+    throw Exception(errMess.getString());
+  }
+  for (unsigned int i = 0; i < numThreads; i++) {
+    m_queues.push_back(new TaskQueue);
+  }
+  // The threads are started when all the queues exist.
+  for (unsigned int i = 0; i < numThreads; i++) {
+    m_threads.push_back(new TaskSchedulerThread(this, i,
+                                                attachToInputDesktop));
+  }
+  for (size_t i = 0; i < m_threads.size(); i++) {
+    m_threads[i]->resume();
+  }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+  m_isTerminating = true;
+  ReleaseSemaphore(m_wakeUpSemaphore, (LONG)m_threads.size(), 0);
+  for (size_t i = 0; i < m_threads.size(); i++) {
+    delete m_threads[i];
+  }
+  for (size_t i = 0; i < m_queues.size(); i++) {
+    delete m_queues[i];
+  }
+  CloseHandle(m_wakeUpSemaphore);
+}
+
+void TaskScheduler::post(Task *task)
+{
+  enqueue(task, getPostQueueIndex());
+}
+
+void TaskScheduler::postDelayed(Task *task, unsigned int delayMillis)
+{
+  AutoLock al(&m_timerLock);
+  if (task->m_state == TASK_CANCELED || task->m_hasTimer) {
+    return;
+  }
+  UINT64 dueTime = getTime() + delayMillis;
+  bool isEarliest = m_timers.empty() || dueTime < m_timers.begin()->first;
+  m_timers.insert(TimerQueue::value_type(dueTime, task));
+  task->m_hasTimer = true;
+  if (isEarliest) {
+    // A sleeping thread has to shorten its wait.
+    ReleaseSemaphore(m_wakeUpSemaphore, 1, 0);
+  }
+}
+
+void TaskScheduler::cancel(Task *task)
+{
+  // From now on the task is neither queued nor gets a timer.
+  InterlockedExchange(&task->m_state, TASK_CANCELED);
+
+  {
+    AutoLock al(&m_timerLock);
+    TimerQueue::iterator it = m_timers.begin();
+    while (it != m_timers.end()) {
+      if (it->second == task) {
+        m_timers.erase(it++);
+      } else {
+        it++;
+      }
+    }
+    task->m_hasTimer = false;
+  }
+
+  for (size_t i = 0; i < m_queues.size(); i++) {
+    TaskQueue *queue = m_queues[i];
+    AutoLock al(&queue->lock);
+    std::deque<Task *>::iterator it = queue->tasks.begin();
+    while (it != queue->tasks.end()) {
+      if (*it == task) {
+        it = queue->tasks.erase(it);
+      } else {
+        it++;
+      }
+    }
+  }
+
+  // A thread may have taken the task before it was canceled.
+  while (task->m_takenCount != 0) {
+    m_taskLeftEvent.waitForEvent(10);
+  }
+
+  InterlockedExchange(&task->m_state, TASK_IDLE);
+}
+
+void TaskScheduler::enqueue(Task *task, size_t queueIndex)
+{
+  TaskQueue *queue = m_queues[queueIndex];
+  // The state is changed under the queue lock, so cancel() cannot miss the
+  // task between the change and the push.
+  AutoLock al(&queue->lock);
+  while (true) {
+    LONG state = task->m_state;
+    if (state == TASK_IDLE) {
+      if (InterlockedCompareExchange(&task->m_state, TASK_QUEUED,
+                                     TASK_IDLE) == TASK_IDLE) {
+        queue->tasks.push_back(task);
+        ReleaseSemaphore(m_wakeUpSemaphore, 1, 0);
+        return;
+      }
+    } else if (state == TASK_RUNNING) {
+      if (InterlockedCompareExchange(&task->m_state, TASK_RUNNING_AGAIN,
+                                     TASK_RUNNING) == TASK_RUNNING) {
+        return;
+      }
+    } else {
+      // Queued already, will run again already or canceled.
+      return;
+    }
+  }
+}
+
+Task *TaskScheduler::takeTask(size_t threadIndex)
+{
+  size_t numQueues = m_queues.size();
+  for (size_t i = 0; i < numQueues; i++) {
+    TaskQueue *queue = m_queues[(threadIndex + i) % numQueues];
+    AutoLock al(&queue->lock);
+    if (!queue->tasks.empty()) {
+      Task *task;
+      if (i == 0) {
+        task = queue->tasks.back();
+        queue->tasks.pop_back();
+      } else {
+        task = queue->tasks.front();
+        queue->tasks.pop_front();
+      }
+      // Taken under the queue lock, so cancel() waits for it.
+      InterlockedIncrement(&task->m_takenCount);
+      return task;
+    }
+  }
+  return 0;
+}
+
+void TaskScheduler::runTask(Task *task, size_t threadIndex)
+{
+  if (InterlockedCompareExchange(&task->m_state, TASK_RUNNING,
+                                 TASK_QUEUED) == TASK_QUEUED) {
+    try {
+      task->run();
+    } catch (...) {
+    }
+
+    TaskQueue *queue = m_queues[threadIndex];
+    AutoLock al(&queue->lock);
+    if (InterlockedCompareExchange(&task->m_state, TASK_IDLE,
+                                   TASK_RUNNING) == TASK_RUNNING_AGAIN) {
+      if (InterlockedCompareExchange(&task->m_state, TASK_QUEUED,
+                                     TASK_RUNNING_AGAIN) == TASK_RUNNING_AGAIN) {
+        queue->tasks.push_back(task);
+        ReleaseSemaphore(m_wakeUpSemaphore, 1, 0);
+      }
+    }
+  }
+  InterlockedDecrement(&task->m_takenCount);
+  m_taskLeftEvent.notify();
+}
+
+DWORD TaskScheduler::fireTimers(size_t threadIndex)
+{
+  AutoLock al(&m_timerLock);
+  UINT64 now = getTime();
+  while (!m_timers.empty() && m_timers.begin()->first <= now) {
+    Task *task = m_timers.begin()->second;
+    m_timers.erase(m_timers.begin());
+    task->m_hasTimer = false;
+    enqueue(task, threadIndex);
+  }
+  if (m_timers.empty()) {
+    return INFINITE;
+  }
+  return (DWORD)(m_timers.begin()->first - now);
+}
+
+size_t TaskScheduler::getPostQueueIndex()
+{
+  DWORD threadId = GetCurrentThreadId();
+  for (size_t i = 0; i < m_threads.size(); i++) {
+    if (m_threads[i]->getThreadId() == threadId) {
+      return i;
+    }
+  }
+  return (size_t)InterlockedIncrement(&m_nextQueue) % m_queues.size();
+}
+
+UINT64 TaskScheduler::getTime()
+{
+  // GetTickCount() wraps around every 49 days.
+  DWORD tick = GetTickCount();
+  m_time += (DWORD)(tick - m_lastTick);
+  m_lastTick = tick;
+  return m_time;
+}
+
+void TaskScheduler::processTasks(size_t threadIndex)
+{
+  while (!m_isTerminating) {
+    DWORD waitTime = fireTimers(threadIndex);
+    Task *task = takeTask(threadIndex);
+    if (task != 0) {
+      runTask(task, threadIndex);
+    } else {
+      WaitForSingleObject(m_wakeUpSemaphore, waitTime);
+    }
+  }
+}
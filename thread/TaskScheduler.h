@@ -0,0 +1,134 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __TASKSCHEDULER_H__
+#define __TASKSCHEDULER_H__
+
+#include "Task.h"
+#include "LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+#include "util/inttypes.h"
+
+#include <vector>
+#include <deque>
+#include <map>
+
+class TaskSchedulerThread;
+
+// TaskScheduler runs tasks and timers on a small set of threads shared by
+// many objects, instead of a sleeping thread per object.
+//
+// Each thread has its own queue. Tasks posted from a scheduler thread go to
+// its own queue and are taken from its back, so the data of a task
+// rescheduling itself stays in the cache of the same processor. A thread
+// that has nothing to do steals tasks from the front of the other queues.
+// Timers are kept in one queue and fired by the first thread to notice
+// them.
+class TaskScheduler
+{
+  friend class TaskSchedulerThread;
+
+public:
+  // Creates a scheduler with numThreads threads. If numThreads is 0, the
+  // number of processors in the system will be used. If
+  // attachToInputDesktop is true, the threads work on the input desktop,
+  // as GuiThread does.
+  TaskScheduler(unsigned int numThreads, bool attachToInputDesktop);
+  // The tasks must be canceled before.
+  virtual ~TaskScheduler();
+
+  // Runs the task as soon as a thread is free.
+  void post(Task *task);
+
+  // Runs the task after delayMillis milliseconds. If the task has a timer
+  // already, the earlier one is kept.
+  void postDelayed(Task *task, unsigned int delayMillis);
+
+  // Removes the task from the queues and waits for it to complete if it is
+  // running. Then the task can be posted again or destroyed. It must not be
+  // called by the task itself.
+  void cancel(Task *task);
+
+protected:
+  // States of a task.
+  static const LONG TASK_IDLE = 0;
+  static const LONG TASK_QUEUED = 1;
+  static const LONG TASK_RUNNING = 2;
+  // Posted while running, it is queued again when it completes.
+  static const LONG TASK_RUNNING_AGAIN = 3;
+  static const LONG TASK_CANCELED = 4;
+
+  struct TaskQueue
+  {
+    LocalMutex lock;
+    std::deque<Task *> tasks;
+  };
+
+  // Processes tasks by the thread with the given index until the scheduler
+  // is destroyed.
+  void processTasks(size_t threadIndex);
+
+  // Queues the task to the queue with the given index if it is idle.
+  void enqueue(Task *task, size_t queueIndex);
+  // Takes a task from the own queue or steals one from the other queues.
+  // Returns 0 if all the queues are empty.
+  Task *takeTask(size_t threadIndex);
+  void runTask(Task *task, size_t threadIndex);
+
+  // Moves due timers to the queue of the calling thread. Returns the time
+  // to the next timer, INFINITE if there is none.
+  DWORD fireTimers(size_t threadIndex);
+
+  // Returns index of the queue where a task posted by the current thread
+  // goes.
+  size_t getPostQueueIndex();
+
+  // Returns milliseconds since the scheduler start, it must be called with
+  // m_timerLock locked.
+  UINT64 getTime();
+
+  std::vector<TaskQueue *> m_queues;
+  std::vector<TaskSchedulerThread *> m_threads;
+  volatile LONG m_nextQueue;
+
+  // Released once for every queued task and new earliest timer.
+  HANDLE m_wakeUpSemaphore;
+  volatile bool m_isTerminating;
+
+  typedef std::multimap<UINT64, Task *> TimerQueue;
+  TimerQueue m_timers;
+  DWORD m_lastTick;
+  UINT64 m_time;
+  LocalMutex m_timerLock;
+
+  // Notified when a thread leaves a task, for cancel().
+  WindowsEvent m_taskLeftEvent;
+
+private:
+  // Do not allow copying objects.
+  TaskScheduler(const TaskScheduler &other);
+  TaskScheduler &operator=(const TaskScheduler &other);
+};
+
+#endif // __TASKSCHEDULER_H__
@@ -26,6 +26,37 @@
 #include "AutoLock.h"
 #include "util/Exception.h"
 
+typedef HANDLE (WINAPI *pAvSetMmThreadCharacteristics)(LPCTSTR taskName,
+                                                       LPDWORD taskIndex);
+typedef BOOL (WINAPI *pAvRevertMmThreadCharacteristics)(HANDLE avrtHandle);
+
+// The functions are resolved by the first thread registered with MMCSS.
+// Concurrent first threads store the same values.
+static volatile bool s_avrtResolved = false;
+static pAvSetMmThreadCharacteristics s_avSetMmThreadCharacteristics = 0;
+static pAvRevertMmThreadCharacteristics s_avRevertMmThreadCharacteristics = 0;
+
+static void resolveAvrtFunctions()
+{
+  HMODULE avrt = LoadLibrary(_T("avrt.dll"));
+  if (avrt != 0) {
+#ifdef _UNICODE
+    const char *setName = "AvSetMmThreadCharacteristicsW";
+#else
+    const char *setName = "AvSetMmThreadCharacteristicsA";
+#endif
+    pAvRevertMmThreadCharacteristics revert = (pAvRevertMmThreadCharacteristics)
+      GetProcAddress(avrt, "AvRevertMmThreadCharacteristics");
+    pAvSetMmThreadCharacteristics set = (pAvSetMmThreadCharacteristics)
+      GetProcAddress(avrt, setName);
+    if (set != 0 && revert != 0) {
+      s_avRevertMmThreadCharacteristics = revert;
+      s_avSetMmThreadCharacteristics = set;
+    }
+  }
+  s_avrtResolved = true;
+}
+
 Thread::Thread()
 : m_terminated(false), m_active(false)
 {
@@ -41,6 +72,17 @@ Thread::~Thread()
 DWORD WINAPI Thread::threadProc(LPVOID pThread)
 {
   Thread *_this = ((Thread *)pThread);
+  HANDLE avrtHandle = 0;
+  if (!_this->m_mmcssTask.isEmpty()) {
+    if (!s_avrtResolved) {
+      resolveAvrtFunctions();
+    }
+    if (s_avSetMmThreadCharacteristics != 0) {
+      DWORD taskIndex = 0;
+      avrtHandle = s_avSetMmThreadCharacteristics(_this->m_mmcssTask.getString(),
+                                                  &taskIndex);
+    }
+  }
   try {
     _this->initByDerived();
     _this->execute();
@@ -51,6 +93,9 @@ DWORD WINAPI Thread::threadProc(LPVOID pThread)
 
     */
   }
+  if (avrtHandle != 0) {
+    s_avRevertMmThreadCharacteristics(avrtHandle);
+  }
   _this->m_active = false;
   return 0;
 }
@@ -136,6 +181,22 @@ bool Thread::setPriority(THREAD_PRIORITY value)
   return SetThreadPriority(m_hThread, priority) != 0;
 }
 
+bool Thread::setAffinity(DWORD_PTR mask)
+{
+  if (mask == 0) {
+    DWORD_PTR systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask) == 0) {
+      return false;
+    }
+  }
+  return SetThreadAffinityMask(m_hThread, mask) != 0;
+}
+
+void Thread::setMmcssTask(const TCHAR *taskName)
+{
+  m_mmcssTask.setString(taskName);
+}
+
 void Thread::sleep(DWORD millis)
 {
   Sleep(millis);
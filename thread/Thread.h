@@ -102,6 +102,21 @@ public:
    */
   bool setPriority(THREAD_PRIORITY value);
 
+  /**
+   * Restricts the thread to the processors of the mask.
+   * @param mask affinity mask, 0 allows all processors of the process.
+   * @return false on error.
+   */
+  bool setAffinity(DWORD_PTR mask);
+
+  /**
+   * Registers the thread with the Multimedia Class Scheduler Service as a
+   * task of the given name ("Capture", "Playback", ...) when it starts.
+   * @remark must be called before the thread is resumed, does nothing
+   * on systems without MMCSS (before Vista).
+   */
+  void setMmcssTask(const TCHAR *taskName);
+
   /**
    * Suspends the execution of the current thread until the time-out interval elapses.
    * @param millis time to sleep.
@@ -159,6 +174,10 @@ private:
    * Terminating flag.
    */
   volatile bool m_terminated;
+  /**
+   * MMCSS task of the thread, none if empty.
+   */
+  StringStorage m_mmcssTask;
 };
 
 #endif // __THREAD_H__
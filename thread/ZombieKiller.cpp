@@ -57,31 +57,41 @@ void ZombieKiller::addZombie(Thread *zombie)
 
 void ZombieKiller::deleteDeadZombies()
 {
-  AutoLock l(&m_lockObj);
+  ThreadList deadZombies;
+  {
+    AutoLock l(&m_lockObj);
 
-  ThreadList::iterator iter = m_zombies.begin();
-  while (iter != m_zombies.end()) {
-    Thread *thread = *iter;
-    if (!thread->isActive()) {
-      delete thread;
-      iter = m_zombies.erase(iter);
-    } else {
-      iter++;
+    ThreadList::iterator iter = m_zombies.begin();
+    while (iter != m_zombies.end()) {
+      if (!(*iter)->isActive()) {
+        ThreadList::iterator dead = iter++;
+        deadZombies.splice(deadZombies.end(), m_zombies, dead);
+      } else {
+        iter++;
+      }
     }
   }
+
+  for (ThreadList::iterator iter = deadZombies.begin();
+       iter != deadZombies.end(); iter++) {
+    delete *iter;
+  }
 }
 
 void ZombieKiller::killAllZombies()
 {
-  AutoLock l(&m_lockObj);
+  ThreadList zombies;
+  {
+    AutoLock l(&m_lockObj);
+    zombies.swap(m_zombies);
+  }
 
   ThreadList::iterator iter;
-  for (iter = m_zombies.begin(); iter != m_zombies.end(); iter++) {
+  for (iter = zombies.begin(); iter != zombies.end(); iter++) {
     (*iter)->terminate();
   }
-  for (iter = m_zombies.begin(); iter != m_zombies.end(); iter++) {
+  for (iter = zombies.begin(); iter != zombies.end(); iter++) {
     (*iter)->wait();
+    delete *iter;
   }
-
-  deleteDeadZombies();
 }
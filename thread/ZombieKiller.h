@@ -62,6 +62,10 @@ public:
   /**
    * Forces terminates all threads, waits until they dies and than
    * delete them from memory and thread list.
+   * @remark all the threads are terminated before any of them is waited
+   * for, so they unwind in parallel. The zombies are waited for outside
+   * of the lock, so the threads adding new zombies are not blocked
+   * meanwhile.
    */
   void killAllZombies();
 
@@ -73,6 +77,7 @@ protected:
 
   /**
    * Deletes all dead zombie threads from memory and removes them from zombies list.
+   * The threads are deleted outside of the lock.
    */
   void deleteDeadZombies();
 
@@ -35,6 +35,7 @@
 #include "ShareRectCommand.h"
 #include "ShareFullCommand.h"
 #include "ShareAppCommand.h"
+#include "StatisticsCommand.h"
 #include "ControlAuth.h"
 #include "ConnectCommand.h"
 #include "ShutdownCommand.h"
@@ -209,6 +210,10 @@ int ControlApplication::run()
       command = new ShareFullCommand(m_serverControl);
     } else if (cmdLineParser.hasShareApp()) {
       command = new ShareAppCommand(m_serverControl, cmdLineParser.getSharedAppProcessId());
+    } else if (cmdLineParser.hasStatisticsFlag()) {
+      StringStorage fileName;
+      cmdLineParser.getStatisticsFile(&fileName);
+      command = new StatisticsCommand(m_serverControl, fileName.getString());
     }
 
     retCode = runControlCommand(command);
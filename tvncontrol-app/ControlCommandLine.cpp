@@ -48,6 +48,7 @@ const TCHAR ControlCommandLine::SHARE_DISPLAY[] = _T("-sharedisplay");
 const TCHAR ControlCommandLine::SHARE_WINDOW[] = _T("-sharewindow");
 const TCHAR ControlCommandLine::SHARE_FULL[] = _T("-sharefull");
 const TCHAR ControlCommandLine::SHARE_APP[] = _T("-shareapp");
+const TCHAR ControlCommandLine::STATISTICS[] = _T("-stats");
 
 const TCHAR ControlCommandLine::CONFIG_APPLICATION[] = _T("-configapp");
 const TCHAR ControlCommandLine::CONFIG_SERVICE[] = _T("-configservice");
@@ -83,6 +84,7 @@ void ControlCommandLine::parse(const CommandLineArgs *cmdArgs)
     { SHARE_WINDOW, NEEDS_ARG },
     { SHARE_FULL, NO_ARG },
     { SHARE_APP, NEEDS_ARG },
+    { STATISTICS, NEEDS_ARG },
     { CONTROL_SERVICE, NO_ARG },
     { CONTROL_APPLICATION, NO_ARG },
     { CONFIG_APPLICATION, NO_ARG },
@@ -138,6 +140,10 @@ void ControlCommandLine::parse(const CommandLineArgs *cmdArgs)
     optionSpecified(CONNECT, &m_connectHostName);
   }
 
+  if (hasStatisticsFlag()) {
+    optionSpecified(STATISTICS, &m_statisticsFile);
+  }
+
   if ((hasSetVncPasswordFlag() || hasSetControlPasswordFlag()) && m_foundKeys.size() > 1) {
     throw CommandLineFormatException();
   } else {
@@ -265,6 +271,16 @@ bool ControlCommandLine::hasShareApp()
   return optionSpecified(SHARE_APP);
 }
 
+bool ControlCommandLine::hasStatisticsFlag()
+{
+  return optionSpecified(STATISTICS);
+}
+
+void ControlCommandLine::getStatisticsFile(StringStorage *fileName) const
+{
+  *fileName = m_statisticsFile;
+}
+
 unsigned char ControlCommandLine::getShareDisplayNumber()
 {
   return m_displayNumber;
@@ -305,7 +321,8 @@ bool ControlCommandLine::isCommandSpecified()
   return hasKillAllFlag() || hasReloadFlag() || hasSetControlPasswordFlag() ||
          hasSetVncPasswordFlag() || hasConnectFlag() || hasShutdownFlag() ||
          hasSharePrimaryFlag() || hasShareDisplay() || hasShareWindow() ||
-         hasShareRect() || hasShareFull() || hasShareApp();
+         hasShareRect() || hasShareFull() || hasShareApp() ||
+         hasStatisticsFlag();
 }
 
 void ControlCommandLine::parseRectCoordinates(const StringStorage *strCoord)
@@ -49,6 +49,7 @@ public:
   static const TCHAR SHARE_WINDOW[];
   static const TCHAR SHARE_FULL[];
   static const TCHAR SHARE_APP[];
+  static const TCHAR STATISTICS[];
 
   static const TCHAR SET_CONTROL_PASSWORD[];
   static const TCHAR SET_PRIMARY_VNC_PASSWORD[];
@@ -86,6 +87,8 @@ public:
   bool hasShareWindow();
   bool hasShareFull();
   bool hasShareApp();
+  bool hasStatisticsFlag();
+  void getStatisticsFile(StringStorage *fileName) const;
   unsigned char getShareDisplayNumber();
   void getShareWindowName(StringStorage *out);
   Rect getShareRect();
@@ -107,6 +110,7 @@ private:
   StringStorage m_connectHostName;
   StringStorage m_dispatcherSpec;
   StringStorage m_passwordFile;
+  StringStorage m_statisticsFile;
 
   Rect m_shareRect;
   unsigned char m_displayNumber;
@@ -179,6 +179,34 @@ public:
    */
   static const UINT32 UPDATE_TVNCONTROL_PROCESS_ID_MSG_ID = 0x15;
 
+  /**
+   * Get performance counters of the screen capture and of the rfb clients.
+   * Counters are totals since the desktop or the connection has been
+   * created, rates are computed from two replies.
+   *
+   * Request body: [empty].
+   * Reply body:
+   *   UINT8 hasCaptureStatistics (0 if no client is connected).
+   *   CaptureStatistics captureStats (if hasCaptureStatistics).
+   *   UINT32 clientsCount.
+   *   struct {
+   *     UINT32 clientId.
+   *     StringUTF8 peerAddr.
+   *     UpdateStatistics updateStats.
+   *   } clientsStats[clientsCount].
+   *   UINT64 processMemory (bytes).
+   *   UINT32 processId.
+   *   UINT64 processCpuTime (user and kernel, microseconds).
+   *   UINT32 memoryTagsCount.
+   *   struct {
+   *     StringUTF8 tag.
+   *     UINT64 bytes.
+   *     UINT64 peakBytes.
+   *     UINT64 blocks.
+   *   } memoryStats[memoryTagsCount].
+   */
+  static const UINT32 GET_STATISTICS_MSG_ID = 0x16;
+
   // Send to server a command that to share only a primary desktop.
   static const UINT32 SHARE_PRIMARY_MSG_ID = 0x20;
 
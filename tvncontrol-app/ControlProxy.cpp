@@ -107,6 +107,55 @@ void ControlProxy::getClientsList(list<RfbClientInfo *> *clients)
   }
 }
 
+bool ControlProxy::getStatistics(CaptureStatistics *captureStats,
+                                 RfbClientStatisticsList *clients,
+                                 UINT64 *processMemory,
+                                 UINT32 *processId,
+                                 UINT64 *processCpuTime,
+                                 MemoryStatisticsList *memory)
+{
+  AutoLock l(m_gate);
+
+  createMessage(ControlProto::GET_STATISTICS_MSG_ID)->send();
+
+  bool hasCaptureStats = m_gate->readUInt8() != 0;
+  if (hasCaptureStats) {
+    captureStats->deserialize(m_gate);
+  }
+
+  UINT32 count = m_gate->readUInt32();
+
+  for (UINT32 i = 0; i < count; i++) {
+    StringStorage peerAddr;
+
+    UINT32 id = m_gate->readUInt32();
+
+    m_gate->readUTF8(&peerAddr);
+
+    RfbClientStatistics clientStats(id, peerAddr.getString());
+    clientStats.m_stats.deserialize(m_gate);
+
+    clients->push_back(clientStats);
+  }
+
+  *processMemory = m_gate->readUInt64();
+  *processId = m_gate->readUInt32();
+  *processCpuTime = m_gate->readUInt64();
+  UINT32 tagsCount = m_gate->readUInt32();
+  for (UINT32 i = 0; i < tagsCount; i++) {
+    StringStorage tag;
+    m_gate->readUTF8(&tag);
+
+    MemoryStatistics memoryStats(tag.getString());
+    memoryStats.m_bytes = m_gate->readUInt64();
+    memoryStats.m_peakBytes = m_gate->readUInt64();
+    memoryStats.m_blocks = m_gate->readUInt64();
+
+    memory->push_back(memoryStats);
+  }
+  return hasCaptureStats;
+}
+
 void ControlProxy::makeOutgoingConnection(const TCHAR *connectString, bool viewOnly)
 {
   AutoLock l(m_gate);
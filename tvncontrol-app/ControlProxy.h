@@ -27,6 +27,9 @@
 
 #include "tvncontrol-app/ControlGate.h"
 #include "tvncontrol-app/RfbClientInfo.h"
+#include "tvncontrol-app/RfbClientStatistics.h"
+#include "tvncontrol-app/MemoryStatistics.h"
+#include "desktop/CaptureStatistics.h"
 #include "tvncontrol-app/TvnServerInfo.h"
 
 #include "server-config-lib/ServerConfig.h"
@@ -80,6 +83,28 @@ public:
    */
   void getClientsList(list<RfbClientInfo *> *clients) throw(IOException, RemoteException);
 
+  /**
+   * Gets performance counters of the screen capture and of the rfb clients.
+   * @param captureStats [out] screen capture counters.
+   * @param clients [out] counters of the clients.
+   * @param processMemory [out] memory usage of the server process in bytes.
+   * @param processId [out] identifier of the server process.
+   * @param processCpuTime [out] CPU time consumed by the server process,
+   * user and kernel, in microseconds. The screen may be captured by another
+   * process, see CaptureStatistics::processId.
+   * @param memory [out] memory counters of the subsystems of the server.
+   * @return false if no client is connected and so there are no screen
+   * capture counters.
+   * @throws RemoteException on error on server.
+   * @throws IOException on io error.
+   */
+  bool getStatistics(CaptureStatistics *captureStats,
+                     RfbClientStatisticsList *clients,
+                     UINT64 *processMemory,
+                     UINT32 *processId,
+                     UINT64 *processCpuTime,
+                     MemoryStatisticsList *memory) throw(IOException, RemoteException);
+
   /**
    * Reloads rfb server configuration.
    * @throws RemoteException on error on server.
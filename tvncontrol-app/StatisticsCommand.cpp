@@ -0,0 +1,246 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "StatisticsCommand.h"
+#include "file-lib/WinFile.h"
+#include "util/AnsiStringStorage.h"
+
+#include <math.h>
+
+StatisticsCommand::StatisticsCommand(ControlProxy *serverControl,
+                                     const TCHAR *fileName)
+: m_proxy(serverControl),
+  m_fileName(fileName)
+{
+}
+
+StatisticsCommand::~StatisticsCommand()
+{
+}
+
+UINT64 StatisticsCommand::perSecond(UINT64 count, UINT64 uptime)
+{
+  return uptime != 0 ? count * 1000 / uptime : 0;
+}
+
+void StatisticsCommand::execute()
+{
+  CaptureStatistics capture;
+  RfbClientStatisticsList clients;
+  UINT64 processMemory;
+  UINT32 processId;
+  UINT64 processCpuTime;
+  MemoryStatisticsList memory;
+  bool hasCapture = m_proxy->getStatistics(&capture, &clients,
+                                           &processMemory, &processId,
+                                           &processCpuTime, &memory);
+
+  StringStorage report;
+  StringStorage line;
+  if (hasCapture) {
+    line.format(_T("capture.driver=%s\r\n")
+                _T("capture.uptime_ms=%llu\r\n")
+                _T("capture.frames_acquired=%llu\r\n")
+                _T("capture.frames_per_sec=%llu\r\n")
+                _T("capture.dirty_pixels=%llu\r\n")
+                _T("capture.dirty_pixels_per_sec=%llu\r\n")
+                _T("capture.timeouts=%llu\r\n")
+                _T("capture.grabs=%llu\r\n")
+                _T("capture.grab_rects_requested=%llu\r\n")
+                _T("capture.grab_rects_grabbed=%llu\r\n")
+                _T("capture.grabbed_pixels=%llu\r\n")
+                _T("capture.recoveries=%llu\r\n")
+                _T("capture.recovery_ms=%llu\r\n")
+                _T("capture.max_recovery_ms=%llu\r\n")
+                _T("capture.process_id=%u\r\n")
+                _T("capture.process_cpu_us=%llu\r\n"),
+                capture.driverName.getString(),
+                capture.uptime,
+                capture.framesAcquired,
+                perSecond(capture.framesAcquired, capture.uptime),
+                capture.dirtyArea,
+                perSecond(capture.dirtyArea, capture.uptime),
+                capture.timeouts,
+                capture.grabs,
+                capture.grabRectsRequested,
+                capture.grabRectsGrabbed,
+                capture.grabbedArea,
+                capture.recoveries,
+                capture.recoveryTime,
+                capture.maxRecoveryTime,
+                (unsigned int)capture.processId,
+                capture.processCpuTime);
+    report.appendString(line.getString());
+    for (size_t i = 0; i < capture.outputs.size(); i++) {
+      const CaptureStatistics::OutputStatistics *output = &capture.outputs[i];
+      unsigned int index = (unsigned int)i;
+      UINT64 captureUsPerFrame = output->frames != 0 ?
+                                 output->captureTime / output->frames : 0;
+      line.format(_T("capture.output.%u.adapter=%u\r\n")
+                  _T("capture.output.%u.frames=%llu\r\n")
+                  _T("capture.output.%u.capture_us=%llu\r\n")
+                  _T("capture.output.%u.capture_us_per_frame=%llu\r\n"),
+                  index, (unsigned int)output->adapter,
+                  index, output->frames,
+                  index, output->captureTime,
+                  index, captureUsPerFrame);
+      report.appendString(line.getString());
+    }
+  }
+  line.format(_T("clients=%u\r\n"), (unsigned int)clients.size());
+  report.appendString(line.getString());
+
+  for (RfbClientStatisticsList::iterator it = clients.begin(); it != clients.end(); it++) {
+    const UpdateStatistics *stats = &(*it).m_stats;
+    unsigned int id = (*it).m_id;
+    UINT64 encodeUsPerUpdate = stats->updatesSent != 0 ?
+                               stats->encodeTime / stats->updatesSent : 0;
+    // The spread of the frame times shows how much the threads of the
+    // pipeline are held up by the other work of the host.
+    UINT64 frameUsMean = 0;
+    UINT64 frameUsStdDev = 0;
+    if (stats->updatesSent != 0) {
+      double mean = (double)stats->frameTime / (double)stats->updatesSent;
+      double variance = (double)stats->frameTimeSquares /
+                        (double)stats->updatesSent - mean * mean;
+      frameUsMean = (UINT64)mean;
+      frameUsStdDev = variance > 0.0 ? (UINT64)sqrt(variance) : 0;
+    }
+    UINT64 copyRectPercent = stats->rectsSent != 0 ?
+                             stats->copyRectsSent * 100 / stats->rectsSent : 0;
+    // Nanoseconds per byte, to compare with the time Tight spends encoding.
+    UINT64 transportNsPerByte = stats->transportBytesIn != 0 ?
+                                stats->transportDeflateTime * 1000 /
+                                stats->transportBytesIn : 0;
+    UINT64 transportRatioPercent = stats->transportBytesIn != 0 ?
+                                   stats->transportBytesOut * 100 /
+                                   stats->transportBytesIn : 0;
+    line.format(_T("client.%u.peer=%s\r\n")
+                _T("client.%u.uptime_ms=%llu\r\n")
+                _T("client.%u.updates_sent=%llu\r\n")
+                _T("client.%u.updates_per_sec=%llu\r\n")
+                _T("client.%u.bytes_sent=%llu\r\n")
+                _T("client.%u.bytes_per_sec=%llu\r\n")
+                _T("client.%u.encode_us_per_update=%llu\r\n")
+                _T("client.%u.frame_time_us_mean=%llu\r\n")
+                _T("client.%u.frame_time_us_stddev=%llu\r\n")
+                _T("client.%u.rects_sent=%llu\r\n")
+                _T("client.%u.copyrect_rects=%llu\r\n")
+                _T("client.%u.copyrect_percent=%llu\r\n")
+                _T("client.%u.rects_merged=%llu\r\n")
+                _T("client.%u.merged_pixels=%llu\r\n")
+                _T("client.%u.mcus_skipped=%llu\r\n")
+                _T("client.%u.coalesced_updates=%llu\r\n")
+                _T("client.%u.round_trip_ms=%u\r\n")
+                _T("client.%u.queueing_delay_ms=%u\r\n")
+                _T("client.%u.throughput_bytes_per_sec=%u\r\n")
+                _T("client.%u.transport_bytes_in=%llu\r\n")
+                _T("client.%u.transport_bytes_out=%llu\r\n")
+                _T("client.%u.transport_ratio_percent=%llu\r\n")
+                _T("client.%u.transport_ns_per_byte=%llu\r\n")
+                _T("client.%u.rects_pre_encoded=%llu\r\n")
+                _T("client.%u.pre_encoded_rects_sent=%llu\r\n"),
+                id, (*it).m_peerAddr.getString(),
+                id, stats->uptime,
+                id, stats->updatesSent,
+                id, perSecond(stats->updatesSent, stats->uptime),
+                id, stats->bytesSent,
+                id, perSecond(stats->bytesSent, stats->uptime),
+                id, encodeUsPerUpdate,
+                id, frameUsMean,
+                id, frameUsStdDev,
+                id, stats->rectsSent,
+                id, stats->copyRectsSent,
+                id, copyRectPercent,
+                id, stats->rectsMerged,
+                id, stats->mergedPixels,
+                id, stats->mcusSkipped,
+                id, stats->coalescedUpdates,
+                id, stats->roundTripTime,
+                id, stats->queueingDelay,
+                id, stats->throughput,
+                id, stats->transportBytesIn,
+                id, stats->transportBytesOut,
+                id, transportRatioPercent,
+                id, transportNsPerByte,
+                id, stats->rectsPreEncoded,
+                id, stats->preEncodedRectsSent);
+    report.appendString(line.getString());
+    // The spread of the latencies shows how evenly the frames are paced.
+    if (stats->latencyUpdates != 0) {
+      double mean = (double)stats->captureLatency / (double)stats->latencyUpdates;
+      double variance = (double)stats->captureLatencySquares /
+                        (double)stats->latencyUpdates - mean * mean;
+      line.format(_T("client.%u.capture_latency_us_mean=%llu\r\n")
+                  _T("client.%u.capture_latency_us_stddev=%llu\r\n"),
+                  id, (UINT64)mean,
+                  id, variance > 0.0 ? (UINT64)sqrt(variance) : (UINT64)0);
+      report.appendString(line.getString());
+    }
+    if (stats->latencyReports != 0) {
+      static const TCHAR *const stageNames[LatencyProbeDefs::STAGE_COUNT] = {
+        _T("capture"), _T("encode"), _T("network"), _T("decode"), _T("present")
+      };
+      line.format(_T("client.%u.latency_reports=%llu\r\n"),
+                  id, stats->latencyReports);
+      report.appendString(line.getString());
+      for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+        for (size_t i = 0; i < UpdateStatistics::LATENCY_PERCENTILE_COUNT; i++) {
+          line.format(_T("client.%u.latency.%s.p%u_us=%u\r\n"),
+                      id, stageNames[stage],
+                      UpdateStatistics::LATENCY_PERCENTILES[i],
+                      (unsigned int)stats->stageLatency[stage][i]);
+          report.appendString(line.getString());
+        }
+      }
+    }
+    std::map<INT32, UINT64>::const_iterator enc;
+    for (enc = stats->bytesPerEncoding.begin();
+         enc != stats->bytesPerEncoding.end(); enc++) {
+      line.format(_T("client.%u.encoding.%d.bytes=%llu\r\n"),
+                  id, (int)enc->first, enc->second);
+      report.appendString(line.getString());
+    }
+  }
+
+  line.format(_T("process.id=%u\r\n")
+              _T("process.cpu_us=%llu\r\n")
+              _T("memory.process_bytes=%llu\r\n"),
+              (unsigned int)processId, processCpuTime, processMemory);
+  report.appendString(line.getString());
+  for (MemoryStatisticsList::iterator it = memory.begin(); it != memory.end(); it++) {
+    const TCHAR *tag = (*it).m_tag.getString();
+    line.format(_T("memory.%s.bytes=%llu\r\n")
+                _T("memory.%s.peak_bytes=%llu\r\n")
+                _T("memory.%s.blocks=%llu\r\n"),
+                tag, (*it).m_bytes,
+                tag, (*it).m_peakBytes,
+                tag, (*it).m_blocks);
+    report.appendString(line.getString());
+  }
+
+  AnsiStringStorage ansiReport(&report);
+  WinFile file(m_fileName.getString(), F_WRITE, FM_CREATE);
+  file.write(ansiReport.getString(), ansiReport.getLength());
+}
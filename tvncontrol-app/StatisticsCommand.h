@@ -0,0 +1,70 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __STATISTICSCOMMAND_H__
+#define __STATISTICSCOMMAND_H__
+
+#include "util/Command.h"
+
+#include "ControlProxy.h"
+
+/**
+ * Command that gets the performance counters of TightVNC server using
+ * control transport and writes them to a file, one "name=value" line per
+ * counter, for monitoring tools.
+ */
+class StatisticsCommand : public Command
+{
+public:
+  /**
+   * Creates command.
+   * @param serverControl proxy.
+   * @param fileName file to write the counters to.
+   */
+  StatisticsCommand(ControlProxy *serverControl, const TCHAR *fileName);
+  /**
+   * Destroys command.
+   */
+  virtual ~StatisticsCommand();
+
+  /**
+   * Executes command.
+   *
+   * Inhrited from Command abstract class.
+   *
+   * @throws IOException on io error, RemoteException on server side error.
+   */
+  virtual void execute() throw(IOException, RemoteException);
+private:
+  // Returns the number of events per second.
+  static UINT64 perSecond(UINT64 count, UINT64 uptime);
+
+  /**
+   * Proxy to some of TightVNC server control methods.
+   */
+  ControlProxy *m_proxy;
+  StringStorage m_fileName;
+};
+
+#endif // __STATISTICSCOMMAND_H__
@@ -0,0 +1,198 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ConnectionAdmission.h"
+#include "thread/AutoLock.h"
+
+ConnectionAdmission::ConnectionAdmission(ConnectionAdmissionListener *listener,
+                                         LogWriter *log)
+: m_listener(listener),
+  m_numPending(0),
+  m_log(log)
+{
+  resume();
+}
+
+ConnectionAdmission::~ConnectionAdmission()
+{
+  stop();
+}
+
+void ConnectionAdmission::admit(SocketIPv4 *socket,
+                                const ViewPortState *constViewPort)
+{
+  SocketAddressIPv4 peerAddr;
+  if (!socket->getPeerAddr(&peerAddr) ||
+      m_listener->isAddressBanned((unsigned long)peerAddr.getSockAddr().sin_addr.S_un.S_addr)) {
+    m_log->message(_T("Connection rejected, the address is banned"));
+    delete socket;
+    return;
+  }
+
+  PendingConnection *connection = new PendingConnection;
+  connection->socket = socket;
+  connection->constViewPort = *constViewPort;
+  connection->received = 0;
+  connection->startTime = GetTickCount();
+  {
+    AutoLock al(&m_lock);
+    if (!isTerminating() && m_numPending < MAX_PENDING) {
+      m_newConnections.push_back(connection);
+      m_numPending++;
+      connection = 0;
+    }
+  }
+  if (connection != 0) {
+    m_log->message(_T("Connection rejected, too many connections are")
+                   _T(" in the handshake"));
+    closeConnection(connection);
+    return;
+  }
+  m_wakeEvent.notify();
+}
+
+void ConnectionAdmission::stop()
+{
+  terminate();
+  wait();
+
+  AutoLock al(&m_lock);
+  for (PendingList::iterator it = m_newConnections.begin();
+       it != m_newConnections.end(); it++) {
+    closeConnection(*it);
+  }
+  m_newConnections.clear();
+  for (PendingList::iterator it = m_pending.begin();
+       it != m_pending.end(); it++) {
+    closeConnection(*it);
+  }
+  m_pending.clear();
+  m_numPending = 0;
+}
+
+void ConnectionAdmission::onTerminate()
+{
+  m_wakeEvent.notify();
+}
+
+void ConnectionAdmission::execute()
+{
+  HANDLE events[2] = { m_socketEvent.getHandle(), m_wakeEvent.getHandle() };
+  while (!isTerminating()) {
+    PendingList newConnections;
+    {
+      AutoLock al(&m_lock);
+      newConnections.swap(m_newConnections);
+    }
+    for (PendingList::iterator it = newConnections.begin();
+         it != newConnections.end(); it++) {
+      if (startHandshake(*it)) {
+        m_pending.push_back(*it);
+      } else {
+        closeConnection(*it);
+        AutoLock al(&m_lock);
+        m_numPending--;
+      }
+    }
+
+    // One event serves all the sockets, so each of them is tried.
+    DWORD now = GetTickCount();
+    DWORD waitTime = INFINITE;
+    PendingList::iterator it = m_pending.begin();
+    while (it != m_pending.end() && !isTerminating()) {
+      PendingConnection *connection = *it;
+      bool isDone = readClientVersion(connection);
+      DWORD elapsed = now - connection->startTime;
+      if (!isDone && elapsed >= HANDSHAKE_TIMEOUT) {
+        m_log->message(_T("Connection closed, no protocol version has come")
+                       _T(" in %u ms"), (unsigned int)HANDSHAKE_TIMEOUT);
+        closeConnection(connection);
+        isDone = true;
+      }
+      if (isDone) {
+        it = m_pending.erase(it);
+        AutoLock al(&m_lock);
+        m_numPending--;
+      } else {
+        waitTime = min(waitTime, HANDSHAKE_TIMEOUT - elapsed);
+        it++;
+      }
+    }
+    if (isTerminating()) {
+      break;
+    }
+    WaitForMultipleObjects(2, events, FALSE, waitTime);
+  }
+}
+
+bool ConnectionAdmission::startHandshake(PendingConnection *connection)
+{
+  try {
+    // The message fits into the send buffer of a new connection.
+    connection->socket->send(RfbInitializer::SERVER_VERSION_MSG,
+                             (int)RfbInitializer::VERSION_MSG_LENGTH);
+    connection->socket->setReadEvent(m_socketEvent.getHandle());
+  } catch (Exception &e) {
+    m_log->info(_T("Connection failed before the handshake: %s"), e.getMessage());
+    return false;
+  }
+  return true;
+}
+
+bool ConnectionAdmission::readClientVersion(PendingConnection *connection)
+{
+  try {
+    while (connection->received < RfbInitializer::VERSION_MSG_LENGTH) {
+      int size = connection->socket->recvAvailable(
+        connection->clientVersion + connection->received,
+        (int)(RfbInitializer::VERSION_MSG_LENGTH - connection->received));
+      if (size < 0) {
+        return false;
+      }
+      connection->received += size;
+    }
+    connection->socket->clearReadEvent();
+  } catch (Exception &e) {
+    m_log->info(_T("Connection failed in the handshake: %s"), e.getMessage());
+    closeConnection(connection);
+    return true;
+  }
+
+  try {
+    m_listener->onConnectionAdmitted(connection->socket,
+                                     &connection->constViewPort,
+                                     connection->clientVersion);
+  } catch (Exception &e) {
+    m_log->error(_T("Failed to add the admitted connection: %s"), e.getMessage());
+  }
+  // The socket belongs to the listener now.
+  delete connection;
+  return true;
+}
+
+void ConnectionAdmission::closeConnection(PendingConnection *connection)
+{
+  delete connection->socket;
+  delete connection;
+}
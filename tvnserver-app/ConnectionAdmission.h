@@ -0,0 +1,121 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CONNECTIONADMISSION_H__
+#define __CONNECTIONADMISSION_H__
+
+#include "util/CommonHeader.h"
+#include "network/socket/SocketIPv4.h"
+#include "fb-update-sender/ViewPortState.h"
+#include "rfb-sconn/RfbInitializer.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "log-writer/LogWriter.h"
+
+#include <list>
+
+// Receiver of the connections passed by ConnectionAdmission.
+class ConnectionAdmissionListener
+{
+public:
+  virtual ~ConnectionAdmissionListener() {}
+
+  // Returns true if the address, in network byte order, is banned.
+  virtual bool isAddressBanned(unsigned long ip) = 0;
+  // The client has sent its protocol version message, the socket is
+  // passed to the listener with it.
+  virtual void onConnectionAdmitted(SocketIPv4 *socket,
+                                    const ViewPortState *constViewPort,
+                                    const char *clientVersion) = 0;
+};
+
+//
+// First stage of the incoming connections, before a thread is made for
+// each of them. The banned addresses are turned away, and one thread for
+// all the connections sends the protocol version and waits for the one of
+// the client, so that the scanners and the half-open connections cost
+// neither a thread nor a client of their own. A connection which does not
+// answer in HANDSHAKE_TIMEOUT ms, or which comes with MAX_PENDING others
+// waiting, is closed.
+//
+class ConnectionAdmission : private Thread
+{
+public:
+  ConnectionAdmission(ConnectionAdmissionListener *listener, LogWriter *log);
+  virtual ~ConnectionAdmission();
+
+  // Takes the socket, it is either passed to the listener or closed.
+  void admit(SocketIPv4 *socket, const ViewPortState *constViewPort);
+
+  // Closes the waiting connections, no connections are passed after it.
+  void stop();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  struct PendingConnection
+  {
+    SocketIPv4 *socket;
+    ViewPortState constViewPort;
+    char clientVersion[RfbInitializer::VERSION_MSG_LENGTH];
+    size_t received;
+    DWORD startTime;
+  };
+  typedef std::list<PendingConnection *> PendingList;
+
+  // Sends the version of the server and starts waiting for the client.
+  // Returns false if the connection has failed.
+  bool startHandshake(PendingConnection *connection);
+  // Reads what the client has sent. Returns true when the connection is
+  // done with, passed to the listener or failed.
+  bool readClientVersion(PendingConnection *connection);
+  static void closeConnection(PendingConnection *connection);
+
+  ConnectionAdmissionListener *m_listener;
+
+  // Connections passed to admit() and not taken by the thread yet, and the
+  // number of all the waiting ones, protected by m_lock.
+  LocalMutex m_lock;
+  PendingList m_newConnections;
+  size_t m_numPending;
+
+  // Used by the thread only.
+  PendingList m_pending;
+  WindowsEvent m_socketEvent;
+  WindowsEvent m_wakeEvent;
+
+  LogWriter *m_log;
+
+  static const size_t MAX_PENDING = 256;
+  static const DWORD HANDSHAKE_TIMEOUT = 10000;
+
+  // Do not allow copying objects.
+  ConnectionAdmission(const ConnectionAdmission &other);
+  ConnectionAdmission &operator=(const ConnectionAdmission &other);
+};
+
+#endif // __CONNECTIONADMISSION_H__
@@ -43,6 +43,8 @@
 #include <time.h>
 #include "util/AnsiStringStorage.h"
 #include "util/MemUsage.h"
+#include "util/MemAccount.h"
+#include "util/GetCPUtime.h"
 
 
 const UINT32 ControlClient::REQUIRES_AUTH[] = { ControlProto::ADD_CLIENT_MSG_ID,
@@ -63,6 +65,7 @@ const UINT32 ControlClient::WITHOUT_AUTH[] = {
   ControlProto::RELOAD_CONFIG_MSG_ID,
   ControlProto::GET_SERVER_INFO_MSG_ID,
   ControlProto::GET_CLIENT_LIST_MSG_ID,
+  ControlProto::GET_STATISTICS_MSG_ID,
   ControlProto::GET_SHOW_TRAY_ICON_FLAG,
   ControlProto::UPDATE_TVNCONTROL_PROCESS_ID_MSG_ID
 };
@@ -176,6 +179,10 @@ void ControlClient::execute()
           m_log->detail(_T("Control client requests client list"));
           getClientsListMsgRcvd();
           break;
+        case ControlProto::GET_STATISTICS_MSG_ID:
+          m_log->detail(_T("Control client requests statistics"));
+          getStatisticsMsgRcvd();
+          break;
         case ControlProto::SET_CONFIG_MSG_ID:
           m_log->detail(_T("Control client sends new server config"));
           setServerConfigMsgRcvd();
@@ -300,6 +307,40 @@ void ControlClient::getClientsListMsgRcvd()
   }
 }
 
+void ControlClient::getStatisticsMsgRcvd()
+{
+  CaptureStatistics captureStats;
+  bool hasCaptureStats = m_rfbClientManager->getCaptureStatistics(&captureStats);
+
+  RfbClientStatisticsList clients;
+  m_rfbClientManager->getClientsStatistics(&clients);
+
+  m_gate->writeUInt32(ControlProto::REPLY_OK);
+  m_gate->writeUInt8(hasCaptureStats ? 1 : 0);
+  if (hasCaptureStats) {
+    captureStats.serialize(m_gate);
+  }
+  m_gate->writeUInt32((UINT32)clients.size());
+  for (RfbClientStatisticsList::iterator it = clients.begin(); it != clients.end(); it++) {
+    m_gate->writeUInt32((*it).m_id);
+    m_gate->writeUTF8((*it).m_peerAddr.getString());
+    (*it).m_stats.serialize(m_gate);
+  }
+
+  m_gate->writeUInt64((UINT64)MemUsage::getCurrentMemUsage());
+  m_gate->writeUInt32(GetCurrentProcessId());
+  m_gate->writeUInt64((UINT64)((getCPUTime() + getKernelTime()) * 1000000.0));
+  m_gate->writeUInt32(MEM_TAG_COUNT);
+  for (int tag = 0; tag < MEM_TAG_COUNT; tag++) {
+    MemAccount::Counters counters;
+    MemAccount::getCounters(tag, &counters);
+    m_gate->writeUTF8(MemAccount::getTagName(tag));
+    m_gate->writeUInt64(counters.bytes);
+    m_gate->writeUInt64(counters.peakBytes);
+    m_gate->writeUInt64(counters.blocks);
+  }
+}
+
 void ControlClient::getServerInfoMsgRcvd()
 {
   bool acceptFlag = false;
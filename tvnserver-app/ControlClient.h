@@ -115,6 +115,11 @@ private:
    * @throws IOException on io error.
    */
   void getClientsListMsgRcvd() throw(IOException);
+  /**
+   * Called when get statistics message recieved.
+   * @throws IOException on io error.
+   */
+  void getStatisticsMsgRcvd() throw(IOException);
   /**
    * Called when get server info message reciveved.
    * @throws IOException on io error.
@@ -25,10 +25,14 @@
 #include "DesktopServerApplication.h"
 #include "DesktopServerCommandLine.h"
 #include "util/ResourceLoader.h"
+#include "util/CpuFeatures.h"
+#include "util/LargePages.h"
+#include "thread/SchedulingPolicy.h"
 #include "desktop/WallpaperUtil.h"
 #include "win-system/WTS.h"
 #include "win-system/Environment.h"
 #include "win-system/SharedMemory.h"
+#include "win-system/ProcessHandle.h"
 #include "tvnserver-app/NamingDefs.h"
 #include "TimeAPI.h"
 
@@ -50,7 +54,9 @@ DesktopServerApplication::DesktopServerApplication(HINSTANCE appInstance,
   m_clientLogger(LogNames::LOG_PIPE_PUBLIC_NAME,
                 LogNames::SERVER_LOG_FILE_STUB_NAME),
   m_contextSwitchResolution(1),
-  m_log(&m_clientLogger)
+  m_log(&m_clientLogger),
+  m_zoneReporter(&m_log),
+  m_stallWatchdog(&m_log)
 {
   try {
     m_clientLogger.connect();
@@ -65,6 +71,43 @@ DesktopServerApplication::DesktopServerApplication(HINSTANCE appInstance,
   DWORD baseSessionId = WTS::getActiveConsoleSessionId(&m_log);
   m_configurator.addListener(this);
   m_configurator.load();
+  onConfigReload(m_configurator.getServerConfig());
+
+  // The screen is captured and compared here, so the kernels of this
+  // process follow the same limit as the service.
+  StringStorage simdLevelName;
+  m_configurator.getServerConfig()->getSimdLevel(&simdLevelName);
+  int simdLevel;
+  if (!CpuFeatures::parseLevel(simdLevelName.getString(), &simdLevel)) {
+    simdLevel = CpuFeatures::LEVEL_AVX2;
+  }
+  CpuFeatures::setMaxLevel(simdLevel);
+  StringStorage cpuDesc;
+  CpuFeatures::getDescription(&cpuDesc);
+  m_log.message(_T("SIMD kernels, %s"), cpuDesc.getString());
+
+  if (m_configurator.getServerConfig()->isLargePageFrameBuffersEnabled()) {
+    StringStorage error;
+    if (LargePages::enable(&error)) {
+      m_log.message(_T("Frame buffers use large pages of %u KB"),
+                    (unsigned int)(LargePages::getPageSize() / 1024));
+    } else {
+      m_log.error(_T("Frame buffers cannot use large pages: %s"),
+                  error.getString());
+    }
+  }
+
+  ServerConfig *srvConfig = m_configurator.getServerConfig();
+  SchedulingPolicy::setPriority(SchedulingPolicy::ROLE_CAPTURE,
+                                srvConfig->getCaptureThreadPriority());
+  SchedulingPolicy::setPriority(SchedulingPolicy::ROLE_SENDER,
+                                srvConfig->getSenderThreadPriority());
+  SchedulingPolicy::setPriority(SchedulingPolicy::ROLE_ENCODER,
+                                srvConfig->getEncoderThreadPriority());
+  SchedulingPolicy::setEncoderAffinity(srvConfig->isEncoderAffinityEnabled());
+  StringStorage schedulingDesc;
+  SchedulingPolicy::getDescription(&schedulingDesc);
+  m_log.message(_T("Thread scheduling, %s"), schedulingDesc.getString());
 
   try {
     // Transport initialization
@@ -76,8 +119,23 @@ DesktopServerApplication::DesktopServerApplication(HINSTANCE appInstance,
 
     DateTime startTime = DateTime::now();
 
+    // A standby desktop server waits for the handles until the service
+    // process exits, the desktop is captured only after that.
+    ProcessHandle serviceProcessHandle;
+    if (mem[7] != 0) {
+      serviceProcessHandle.openProcess(SYNCHRONIZE, FALSE, (DWORD)mem[7]);
+      m_log.info(_T("Desktop server is started as standby"));
+    }
+    HANDLE serviceProcess = serviceProcessHandle.getHandle();
+
     WindowsEvent m_sleepInterval;
     while (mem[0] == 0) {
+      if (serviceProcess != 0) {
+        if (WaitForSingleObject(serviceProcess, 10) != WAIT_TIMEOUT) {
+          throw Exception(_T("The service process has exited"));
+        }
+        continue;
+      }
       unsigned int timeForWait = max((int)10000 - 
                                      (int)(DateTime::now() -
                                            startTime).getTime(),
@@ -87,6 +145,10 @@ DesktopServerApplication::DesktopServerApplication(HINSTANCE appInstance,
       }
       m_sleepInterval.waitForEvent(10);
     }
+    if (serviceProcess != 0) {
+      m_log.info(_T("Standby desktop server is attached after %u ms"),
+                 (unsigned int)(DateTime::now() - startTime).getTime());
+    }
 
     HANDLE readPipeHandle, writePipeHandle;
     unsigned int maxPortionSize;
@@ -174,6 +236,9 @@ void DesktopServerApplication::onAnObjectEvent()
 
 void DesktopServerApplication::onConfigReload(ServerConfig *serverConfig)
 {
+  StringStorage logDir;
+  serverConfig->getLogFileDir(&logDir);
+  m_stallWatchdog.setDumpDir(logDir.getString());
 }
 
 int DesktopServerApplication::run()
@@ -38,6 +38,8 @@
 #include "win-system/LocalWindowsApplication.h"
 #include "log-server/ClientLogger.h"
 #include "log-writer/LogWriter.h"
+#include "log-writer/ZoneReporter.h"
+#include "log-writer/StallWatchdog.h"
 #include "server-config-lib/ConfigReloadListener.h"
 #include "util/CommandLineArgs.h"
 
@@ -76,6 +78,8 @@ private:
   Configurator m_configurator;
   ClientLogger m_clientLogger;
   LogWriter m_log;
+  ZoneReporter m_zoneReporter;
+  StallWatchdog m_stallWatchdog;
 
   // Transport
   AnonymousPipe *m_clToSrvChan;
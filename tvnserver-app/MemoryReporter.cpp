@@ -0,0 +1,63 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "MemoryReporter.h"
+#include "util/MemAccount.h"
+#include "util/MemUsage.h"
+
+MemoryReporter::MemoryReporter(LogWriter *log)
+: m_log(log)
+{
+  resume();
+}
+
+MemoryReporter::~MemoryReporter()
+{
+  terminate();
+  wait();
+  report();
+}
+
+void MemoryReporter::execute()
+{
+  while (!isTerminating()) {
+    m_timer.waitForEvent(REPORT_INTERVAL);
+    if (!isTerminating()) {
+      report();
+    }
+  }
+}
+
+void MemoryReporter::onTerminate()
+{
+  m_timer.notify();
+}
+
+void MemoryReporter::report()
+{
+  StringStorage desc;
+  MemAccount::getDescription(&desc);
+  m_log->info(_T("%s, process usage: %u KB"), desc.getString(),
+              (unsigned int)(MemUsage::getCurrentMemUsage() / 1024));
+}
@@ -0,0 +1,54 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __MEMORYREPORTER_H__
+#define __MEMORYREPORTER_H__
+
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "log-writer/LogWriter.h"
+
+// Writes the memory counters of the subsystems (see util/MemAccount.h) and
+// the memory usage of the process to the log every REPORT_INTERVAL ms, and
+// once more when it is destroyed.
+class MemoryReporter : private Thread
+{
+public:
+  MemoryReporter(LogWriter *log);
+  virtual ~MemoryReporter();
+
+  static const unsigned int REPORT_INTERVAL = 5 * 60 * 1000;
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  void report();
+
+  WindowsEvent m_timer;
+  LogWriter *m_log;
+};
+
+#endif // __MEMORYREPORTER_H__
@@ -26,6 +26,8 @@
 
 const TCHAR NamingDefs::MIRROR_DRIVER_MESSAGE_WINDOW_CLASS_NAME[] =
   _T("MIRROR_DRIVER_MESSAGE_WINDOW_CLASS_NAME");
+const TCHAR NamingDefs::DISPLAY_CHANGE_WINDOW_CLASS_NAME[] =
+  _T("Tvnserver.DisplayChange.MessageWindow");
 
 const TCHAR ProductNames::PRODUCT_NAME[] = _T("TightVNC");
 const TCHAR ProductNames::SERVER_PRODUCT_NAME[] = _T("TightVNC Server");
@@ -72,6 +74,10 @@ const UINT HookDefinitions::LOADER_CLOSE_CODE =
   RegisterWindowMessage(_T("TVN.HOOK.LOADER.CLOSE.CODE"));
 const UINT HookDefinitions::SPEC_IPC_CODE =
   RegisterWindowMessage(_T("TVN.HOOK.MESSAGE.CODE"));
+const UINT HookDefinitions::BATCH_IPC_CODE =
+  RegisterWindowMessage(_T("TVN.HOOK.BATCH.CODE"));
+const TCHAR HookDefinitions::HOOK_RECT_RING_NAME_FORMAT[] =
+  _T("TightVNC_Hook_Rects_%u");
 
 const TCHAR DefaultNames::DEFAULT_COMPUTER_NAME[] = _T("TightVNC Server");
 
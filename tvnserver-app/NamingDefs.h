@@ -32,6 +32,7 @@ class NamingDefs
 {
 public:
   static const TCHAR MIRROR_DRIVER_MESSAGE_WINDOW_CLASS_NAME[];
+  static const TCHAR DISPLAY_CHANGE_WINDOW_CLASS_NAME[];
 };
 
 class ProductNames
@@ -96,6 +97,8 @@ public:
   static const TCHAR HOOK_LOADER_NAME[];
   static const UINT LOADER_CLOSE_CODE;
   static const UINT SPEC_IPC_CODE;
+  static const UINT BATCH_IPC_CODE;
+  static const TCHAR HOOK_RECT_RING_NAME_FORMAT[];
 };
 
 class DefaultNames
@@ -55,5 +55,5 @@ void OutgoingRfbConnectionThread::execute()
 
   m_clientManager->addNewConnection(socket,
                                     &ViewPortState(), // with a default view port
-                                    m_viewOnly, true);
+                                    m_viewOnly, true, false);
 }
@@ -0,0 +1,58 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RelayAuthHandler.h"
+#include "util/AnsiStringStorage.h"
+
+RelayAuthHandler::RelayAuthHandler()
+: m_hasPassword(false)
+{
+  memset(m_encryptedPassword, 0, sizeof(m_encryptedPassword));
+}
+
+RelayAuthHandler::~RelayAuthHandler()
+{
+}
+
+void RelayAuthHandler::setEncryptedPassword(const UINT8 password[VncPassCrypt::VNC_PASSWORD_SIZE])
+{
+  memcpy(m_encryptedPassword, password, sizeof(m_encryptedPassword));
+  m_hasPassword = true;
+}
+
+void RelayAuthHandler::getPassword(StringStorage *passString)
+{
+  if (!m_hasPassword) {
+    throw AuthException(_T("The upstream server asks for a password,")
+                        _T(" but no relay password is set"));
+  }
+  // One more byte ends the password of the full length.
+  char plainPassword[VncPassCrypt::VNC_PASSWORD_SIZE + 1];
+  VncPassCrypt::getPlainPass((UINT8 *)plainPassword, m_encryptedPassword);
+  plainPassword[VncPassCrypt::VNC_PASSWORD_SIZE] = 0;
+
+  AnsiStringStorage ansiPassword(plainPassword);
+  ansiPassword.toStringStorage(passString);
+  memset(plainPassword, 0, sizeof(plainPassword));
+}
@@ -0,0 +1,51 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RELAYAUTHHANDLER_H__
+#define __RELAYAUTHHANDLER_H__
+
+#include "viewer-core/VncAuthenticationHandler.h"
+#include "util/VncPassCrypt.h"
+
+// Answers the VNC authentication of the upstream server in the relay mode
+// with the relay password from the configuration.
+class RelayAuthHandler : public VncAuthenticationHandler
+{
+public:
+  RelayAuthHandler();
+  virtual ~RelayAuthHandler();
+
+  // Sets the password encrypted as in the configuration.
+  void setEncryptedPassword(const UINT8 password[VncPassCrypt::VNC_PASSWORD_SIZE]);
+
+protected:
+  // Throws AuthException if the password is not set.
+  virtual void getPassword(StringStorage *passString);
+
+private:
+  UINT8 m_encryptedPassword[VncPassCrypt::VNC_PASSWORD_SIZE];
+  bool m_hasPassword;
+};
+
+#endif // __RELAYAUTHHANDLER_H__
@@ -0,0 +1,227 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RelayDesktop.h"
+#include "RelayUserInput.h"
+#include "server-config-lib/Configurator.h"
+
+RelayDesktop::RelayDesktop(ClipboardListener *extClipListener,
+                           UpdateSendingListener *extUpdSendingListener,
+                           AbnormDeskTermListener *extDeskTermListener,
+                           LogWriter *log)
+: DesktopBaseImpl(extClipListener, extUpdSendingListener, extDeskTermListener, log),
+  m_upstreamPort(0),
+  m_viewerCore(0),
+  m_relayUpdateHandler(0),
+  m_log(log)
+{
+  ServerConfig *config = Configurator::getInstance()->getServerConfig();
+  config->getRelayHost(&m_upstreamHost);
+  m_upstreamPort = (UINT16)config->getRelayPort();
+  if (config->hasRelayPassword()) {
+    UINT8 password[ServerConfig::VNC_PASSWORD_SIZE];
+    config->getRelayPassword(password);
+    m_authHandler.setEncryptedPassword(password);
+    memset(password, 0, sizeof(password));
+  }
+  m_log->info(_T("Creating RelayDesktop of %s::%u"),
+              m_upstreamHost.getString(), (unsigned int)m_upstreamPort);
+
+  try {
+    m_relayUpdateHandler = new RelayUpdateHandler(this);
+    m_updateHandler = m_relayUpdateHandler;
+    m_userInput = new RelayUserInput(m_updateHandler);
+  } catch (Exception &ex) {
+    m_log->error(_T("exception during RelayDesktop creation: %s"), ex.getMessage());
+    freeResource();
+    throw;
+  }
+  resume();
+
+  // The clients need the size of the frame buffer as soon as they have
+  // this desktop.
+  m_frameBufferEvent.waitForEvent(CONNECT_TIMEOUT);
+  if (m_relayUpdateHandler->getFrameBufferDimension().isEmpty()) {
+    terminate();
+    wait();
+    freeResource();
+    throw Exception(_T("No frame buffer from the upstream server %s::%u"),
+                    m_upstreamHost.getString(), (unsigned int)m_upstreamPort);
+  }
+}
+
+RelayDesktop::~RelayDesktop()
+{
+  m_log->info(_T("Deleting RelayDesktop"));
+  terminate();
+  wait();
+  freeResource();
+  m_log->info(_T("RelayDesktop deleted"));
+}
+
+void RelayDesktop::freeResource()
+{
+  if (m_userInput) {
+    delete m_userInput;
+    m_userInput = 0;
+  }
+  if (m_updateHandler) {
+    delete m_updateHandler;
+    m_updateHandler = 0;
+    m_relayUpdateHandler = 0;
+  }
+}
+
+void RelayDesktop::getCurrentUserInfo(StringStorage *desktopName,
+                                      StringStorage *userName)
+{
+  AutoLock al(&m_desktopNameLock);
+  *desktopName = m_desktopName;
+  userName->setString(_T(""));
+}
+
+void RelayDesktop::onTerminate()
+{
+  m_newUpdateEvent.notify();
+}
+
+void RelayDesktop::execute()
+{
+  m_log->info(_T("RelayDesktop thread started"));
+
+  HANDLE events[2] = { m_newUpdateEvent.getHandle(),
+                       m_upstreamClosedEvent.getHandle() };
+  bool firstConnection = true;
+  DWORD closeTime = 0;
+  while (!isTerminating()) {
+    DWORD timeout = INFINITE;
+    if (m_viewerCore == 0) {
+      DWORD elapsed = GetTickCount() - closeTime;
+      if (firstConnection || elapsed >= RECONNECT_DELAY) {
+        firstConnection = false;
+        connectUpstream();
+      } else {
+        timeout = RECONNECT_DELAY - elapsed;
+      }
+    }
+    DWORD result = WaitForMultipleObjects(2, events, FALSE, timeout);
+    if (isTerminating()) {
+      break;
+    }
+    if (result == WAIT_OBJECT_0) {
+      sendUpdate();
+    } else if (result == WAIT_OBJECT_0 + 1) {
+      closeUpstream();
+      // Both onError() and onDisconnect() may have notified the event.
+      m_upstreamClosedEvent.waitForEvent(0);
+      closeTime = GetTickCount();
+    }
+  }
+  closeUpstream();
+
+  m_log->info(_T("RelayDesktop thread stopped"));
+}
+
+void RelayDesktop::connectUpstream()
+{
+  m_log->info(_T("Connecting to the upstream server %s::%u"),
+              m_upstreamHost.getString(), (unsigned int)m_upstreamPort);
+  m_viewerCore = new RemoteViewerCore();
+  m_authHandler.addAuthCapability(m_viewerCore);
+  // The upstream server sends one stream only, so it can be lossless. The
+  // cursor is painted by it, the clients of the relay get it with pixels.
+  m_viewerCore->setJpegQualityLevel(-1);
+  m_viewerCore->enableCursorShapeUpdates(false);
+  try {
+    m_viewerCore->start(m_upstreamHost.getString(), m_upstreamPort, this, true);
+  } catch (Exception &e) {
+    m_log->error(_T("Cannot start the upstream connection: %s"), e.getMessage());
+    m_upstreamClosedEvent.notify();
+  }
+}
+
+void RelayDesktop::closeUpstream()
+{
+  if (m_viewerCore != 0) {
+    try {
+      m_viewerCore->stop();
+      m_viewerCore->waitTermination();
+    } catch (Exception &e) {
+      m_log->error(_T("Error while closing the upstream connection: %s"),
+                   e.getMessage());
+    }
+    delete m_viewerCore;
+    m_viewerCore = 0;
+  }
+}
+
+bool RelayDesktop::isRemoteInputTempBlocked()
+{
+  return true;
+}
+
+void RelayDesktop::applyNewConfiguration()
+{
+}
+
+void RelayDesktop::onConnected(RfbOutputGate *output)
+{
+  StringStorage desktopName = m_viewerCore->getRemoteDesktopName();
+  m_log->message(_T("Relaying the desktop \"%s\" of %s::%u"),
+                 desktopName.getString(), m_upstreamHost.getString(),
+                 (unsigned int)m_upstreamPort);
+  AutoLock al(&m_desktopNameLock);
+  m_desktopName = desktopName;
+}
+
+void RelayDesktop::onDisconnect(const StringStorage *message)
+{
+  m_log->message(_T("The upstream connection is closed: %s"),
+                 message->getString());
+  m_upstreamClosedEvent.notify();
+}
+
+void RelayDesktop::onError(const Exception *exception)
+{
+  m_log->error(_T("The upstream connection failed: %s"),
+               exception->getMessage());
+  m_upstreamClosedEvent.notify();
+}
+
+void RelayDesktop::onCutText(const StringStorage *cutText)
+{
+  DesktopBaseImpl::onClipboardUpdate(cutText);
+}
+
+void RelayDesktop::onFrameBufferUpdates(const FrameBuffer *fb,
+                                        const std::vector<Rect> *updates)
+{
+  m_relayUpdateHandler->onUpstreamUpdates(fb, updates);
+}
+
+void RelayDesktop::onFrameBufferPropChange(const FrameBuffer *fb)
+{
+  m_relayUpdateHandler->onUpstreamResize(fb);
+  m_frameBufferEvent.notify();
+}
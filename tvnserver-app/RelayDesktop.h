@@ -0,0 +1,115 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RELAYDESKTOP_H__
+#define __RELAYDESKTOP_H__
+
+#include "desktop/DesktopBaseImpl.h"
+#include "viewer-core/CoreEventsAdapter.h"
+#include "viewer-core/RemoteViewerCore.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "log-writer/LogWriter.h"
+#include "RelayAuthHandler.h"
+#include "RelayUpdateHandler.h"
+
+// Desktop of the relay mode: the screen of an upstream server, received by
+// one viewer connection, is served to all the clients of this server.
+//
+// The upstream updates are decoded into a copy of the upstream frame buffer
+// (see RelayUpdateHandler), which the clients get their updates from as
+// from the local screen. So every change is encoded once for all the
+// clients with the same encoding parameters, and the clients joining late
+// get their full updates from the copy instead of from the upstream server.
+//
+// The input of the clients is not passed upstream. If the upstream
+// connection is lost, the clients keep the last picture while it is made
+// again every RECONNECT_DELAY milliseconds.
+class RelayDesktop : public DesktopBaseImpl,
+                     public CoreEventsAdapter,
+                     private Thread
+{
+public:
+  // Connects to the upstream server of the configuration and waits for
+  // its frame buffer up to CONNECT_TIMEOUT milliseconds.
+  // @throw Exception if there is no frame buffer in time.
+  RelayDesktop(ClipboardListener *extClipListener,
+               UpdateSendingListener *extUpdSendingListener,
+               AbnormDeskTermListener *extDeskTermListener,
+               LogWriter *log);
+  virtual ~RelayDesktop();
+
+  // Returns the name of the upstream desktop.
+  virtual void getCurrentUserInfo(StringStorage *desktopName,
+                                  StringStorage *userName);
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+  virtual bool isRemoteInputTempBlocked();
+  virtual void applyNewConfiguration();
+
+  // Inherited from CoreEventsAdapter, called by the threads of the
+  // upstream connection.
+  virtual void onConnected(RfbOutputGate *output);
+  virtual void onDisconnect(const StringStorage *message);
+  virtual void onError(const Exception *exception);
+  virtual void onCutText(const StringStorage *cutText);
+  virtual void onFrameBufferUpdates(const FrameBuffer *fb,
+                                    const std::vector<Rect> *updates);
+  virtual void onFrameBufferPropChange(const FrameBuffer *fb);
+
+private:
+  // Makes the upstream connection, the result comes by the callbacks.
+  void connectUpstream();
+  // Stops and deletes the upstream connection, if there is one.
+  void closeUpstream();
+
+  void freeResource();
+
+  StringStorage m_upstreamHost;
+  UINT16 m_upstreamPort;
+  RelayAuthHandler m_authHandler;
+
+  // Used only by the thread of the desktop.
+  RemoteViewerCore *m_viewerCore;
+
+  RelayUpdateHandler *m_relayUpdateHandler;
+
+  // Set when the upstream connection is lost.
+  WindowsEvent m_upstreamClosedEvent;
+  // Set when the first upstream frame buffer comes.
+  WindowsEvent m_frameBufferEvent;
+
+  StringStorage m_desktopName;
+  LocalMutex m_desktopNameLock;
+
+  LogWriter *m_log;
+
+  static const DWORD CONNECT_TIMEOUT = 10000;
+  static const DWORD RECONNECT_DELAY = 5000;
+};
+
+#endif // __RELAYDESKTOP_H__
@@ -0,0 +1,145 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RelayUpdateHandler.h"
+
+RelayUpdateHandler::RelayUpdateHandler(UpdateListener *externalUpdateListener)
+: m_externalUpdateListener(externalUpdateListener),
+  m_screenSizeChanged(false),
+  m_updateCount(0),
+  m_updatedArea(0)
+{
+}
+
+RelayUpdateHandler::~RelayUpdateHandler()
+{
+}
+
+void RelayUpdateHandler::extract(UpdateContainer *updateContainer)
+{
+  updateContainer->clear();
+
+  AutoLock al(&m_regionLock);
+  updateContainer->screenSizeChanged = m_screenSizeChanged;
+  updateContainer->changedRegion = m_changedRegion;
+  updateContainer->changedRegion.subtract(&m_excludedRegion);
+  m_screenSizeChanged = false;
+  m_changedRegion.clear();
+}
+
+void RelayUpdateHandler::setFullUpdateRequested(const Region *region)
+{
+  AutoLock al(&m_regionLock);
+  m_changedRegion.add(region);
+}
+
+bool RelayUpdateHandler::checkForUpdates(Region *region)
+{
+  AutoLock al(&m_regionLock);
+  Region changes = m_changedRegion;
+  changes.intersect(region);
+  return !changes.isEmpty();
+}
+
+void RelayUpdateHandler::setExcludedRegion(const Region *excludedRegion)
+{
+  AutoLock al(&m_regionLock);
+  if (excludedRegion == 0) {
+    m_excludedRegion.clear();
+  } else {
+    m_excludedRegion = *excludedRegion;
+  }
+}
+
+void RelayUpdateHandler::setCaptureRegion(const Region *captureRegion)
+{
+}
+
+void RelayUpdateHandler::setVisualEffectsLevel(int level)
+{
+}
+
+void RelayUpdateHandler::setCaptureDemand(bool demanded)
+{
+}
+
+void RelayUpdateHandler::getCaptureStatistics(CaptureStatistics *stats)
+{
+  *stats = CaptureStatistics();
+  stats->driverName.setString(_T("Relay"));
+  AutoLock al(&m_regionLock);
+  stats->framesAcquired = m_updateCount;
+  stats->dirtyArea = m_updatedArea;
+}
+
+void RelayUpdateHandler::onUpstreamUpdates(const FrameBuffer *fb,
+                                           const std::vector<Rect> *rects)
+{
+  Region updated;
+  {
+    AutoLock al(&m_fbLocMut);
+    Rect fbRect = m_backupFrameBuffer.getDimension().getRect();
+    std::vector<Rect>::const_iterator it;
+    for (it = rects->begin(); it != rects->end(); it++) {
+      Rect rect = it->intersection(&fbRect);
+      if (!rect.isEmpty()) {
+        m_backupFrameBuffer.copyFrom(&rect, fb, rect.left, rect.top);
+        updated.addRect(&rect);
+      }
+    }
+  }
+  if (updated.isEmpty()) {
+    return;
+  }
+  {
+    AutoLock al(&m_regionLock);
+    m_changedRegion.add(&updated);
+    m_updateCount++;
+    std::vector<Rect> rectVector;
+    updated.getRectVector(&rectVector);
+    for (size_t i = 0; i < rectVector.size(); i++) {
+      m_updatedArea += rectVector[i].area();
+    }
+  }
+  m_externalUpdateListener->onUpdate();
+}
+
+void RelayUpdateHandler::onUpstreamResize(const FrameBuffer *fb)
+{
+  Dimension dim = fb->getDimension();
+  PixelFormat pf = fb->getPixelFormat();
+  {
+    AutoLock al(&m_fbLocMut);
+    m_backupFrameBuffer.setProperties(&dim, &pf);
+    m_backupFrameBuffer.copyFrom(fb, 0, 0);
+  }
+  {
+    AutoLock al(&m_regionLock);
+    m_screenSizeChanged = true;
+    m_changedRegion.clear();
+    Rect fbRect = dim.getRect();
+    m_changedRegion.addRect(&fbRect);
+  }
+  m_externalUpdateListener->onUpdate();
+}
@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RELAYUPDATEHANDLER_H__
+#define __RELAYUPDATEHANDLER_H__
+
+#include "desktop/UpdateHandler.h"
+#include "desktop/UpdateListener.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
+
+// Update handler of the relay mode. Instead of grabbing the screen, it
+// keeps a copy of the frame buffer received from the upstream server and
+// the region changed by the upstream updates since the last extract().
+//
+// A full update requested by a client is served from the copy, so a client
+// joining late costs the upstream server nothing.
+class RelayUpdateHandler : public UpdateHandler
+{
+public:
+  RelayUpdateHandler(UpdateListener *externalUpdateListener);
+  virtual ~RelayUpdateHandler();
+
+  virtual void extract(UpdateContainer *updateContainer);
+  virtual void setFullUpdateRequested(const Region *region);
+  virtual bool checkForUpdates(Region *region);
+  virtual void setExcludedRegion(const Region *excludedRegion);
+  // The whole frame buffer comes from the upstream server anyway, so the
+  // capture region, the visual effects and the demand are ignored.
+  virtual void setCaptureRegion(const Region *captureRegion);
+  virtual void setVisualEffectsLevel(int level);
+  virtual void setCaptureDemand(bool demanded);
+  virtual void getCaptureStatistics(CaptureStatistics *stats);
+
+  // Copies the rectangles updated by the upstream server from its frame
+  // buffer. Called by the thread of the upstream connection.
+  void onUpstreamUpdates(const FrameBuffer *fb, const std::vector<Rect> *rects);
+  // Takes the new size and pixel format of the upstream frame buffer.
+  void onUpstreamResize(const FrameBuffer *fb);
+
+private:
+  UpdateListener *m_externalUpdateListener;
+
+  Region m_changedRegion;
+  Region m_excludedRegion;
+  bool m_screenSizeChanged;
+  // Counters of the upstream updates reported as the capture statistics.
+  UINT64 m_updateCount;
+  UINT64 m_updatedArea;
+  LocalMutex m_regionLock;
+};
+
+#endif // __RELAYUPDATEHANDLER_H__
@@ -0,0 +1,105 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RelayUserInput.h"
+
+RelayUserInput::RelayUserInput(UpdateHandler *updateHandler)
+: m_updateHandler(updateHandler)
+{
+}
+
+RelayUserInput::~RelayUserInput()
+{
+}
+
+void RelayUserInput::setNewClipboard(const StringStorage *newClipboard)
+{
+}
+
+void RelayUserInput::setMouseEvent(const Point newPos, UINT8 keyFlag)
+{
+}
+
+void RelayUserInput::setKeyboardEvent(UINT32 keySym, bool down)
+{
+}
+
+void RelayUserInput::getCurrentUserInfo(StringStorage *desktopName,
+                                        StringStorage *userName)
+{
+  desktopName->setString(_T(""));
+  userName->setString(_T(""));
+}
+
+void RelayUserInput::getPrimaryDisplayCoords(Rect *rect)
+{
+  *rect = m_updateHandler->getFrameBufferDimension().getRect();
+}
+
+void RelayUserInput::getDisplayNumberCoords(Rect *rect,
+                                            unsigned char dispNumber)
+{
+  if (dispNumber == 1) {
+    getPrimaryDisplayCoords(rect);
+  } else {
+    rect->clear();
+  }
+}
+
+std::vector<Rect> RelayUserInput::getDisplaysCoords()
+{
+  std::vector<Rect> displays;
+  displays.push_back(m_updateHandler->getFrameBufferDimension().getRect());
+  return displays;
+}
+
+void RelayUserInput::getNormalizedRect(Rect *rect)
+{
+  // The coordinates are the ones of the frame buffer already.
+}
+
+void RelayUserInput::getWindowCoords(HWND hwnd, Rect *rect)
+{
+  rect->clear();
+}
+
+void RelayUserInput::getForegroundWindowCoords(Rect *rect)
+{
+  rect->clear();
+}
+
+HWND RelayUserInput::getWindowHandleByName(const StringStorage *windowName)
+{
+  return 0;
+}
+
+void RelayUserInput::getApplicationRegion(unsigned int procId, Region *region)
+{
+  region->clear();
+}
+
+bool RelayUserInput::isApplicationInFocus(unsigned int procId)
+{
+  return false;
+}
@@ -27,6 +27,8 @@
 #include "QueryConnectionApplication.h"
 #include "server-config-lib/Configurator.h"
 #include "util/MemUsage.h"
+#include "rfb-sconn/EncoderContextPool.h"
+#include "desktop/VisualEffectsUtil.h"
 
 RfbClientManager::RfbClientManager(const TCHAR *serverName,
                                    NewConnectionEvents *newConnectionEvents,
@@ -34,18 +36,47 @@ RfbClientManager::RfbClientManager(const TCHAR *serverName,
                                    DesktopFactory *desktopFactory)
 : m_nextClientId(0),
   m_desktop(0),
+  m_clientListLocker(_T("RfbClientManager::m_clientListLocker")),
+  m_iocpEngine(0),
+  m_clientScheduler(CLIENT_SCHEDULER_THREADS, false),
   m_newConnectionEvents(newConnectionEvents),
+  m_multicast(log),
+  m_admission(this, log),
   m_log(log),
   m_desktopFactory(desktopFactory)
 {
   m_log->info(_T("Starting rfb client manager"));
+  // Compression contexts are made before the clients come, so that many
+  // connections at once do not all initialize their own.
+  try {
+    EncoderContextPool::getInstance()->warmUp();
+  } catch (Exception &e) {
+    m_log->error(_T("Can't prepare the encoder contexts: %s"), e.getMessage());
+  }
+
+  ServerConfig *config = Configurator::getInstance()->getServerConfig();
+  StringStorage multicastGroup;
+  config->getMulticastGroup(&multicastGroup);
+  if (!multicastGroup.isEmpty()) {
+    try {
+      m_multicast.start(multicastGroup.getString(),
+                        (unsigned short)config->getMulticastPort(),
+                        config->getMulticastBandwidth() * 1024);
+    } catch (Exception &e) {
+      m_log->error(_T("Can't start the multicast stream: %s"), e.getMessage());
+    }
+  }
 }
 
 RfbClientManager::~RfbClientManager()
 {
   m_log->info(_T("~RfbClientManager() has been called"));
+  m_admission.stop();
   disconnectAllClients();
   waitUntilAllClientAreBeenDestroyed();
+  if (m_iocpEngine != 0) {
+    delete m_iocpEngine;
+  }
   m_log->info(_T("~RfbClientManager() has been completed"));
 }
 
@@ -59,11 +90,11 @@ Desktop *RfbClientManager::onClientAuth(RfbClient *client)
   // The client is now authenticated, so remove its IP from the ban list.
   StringStorage ip;
   client->getPeerHost(&ip);
-  updateIpInBan(&ip, true);
+  updateIpInBan(getClientAddress(client), true);
 
   m_newConnectionEvents->onSuccAuth(&ip);
 
-  AutoLock al(&m_clientListLocker);
+  AutoWriteLock al(&m_clientListLocker);
 
   // Checking if this client is allowed to connect, depending on its "shared"
   // flag and the server's configuration.
@@ -85,7 +116,7 @@ Desktop *RfbClientManager::onClientAuth(RfbClient *client)
     // Which client takes priority, existing or incoming?
     if (servConf->isDisconnectingExistingClients()) {
       // Incoming
-      disconnectAuthClients();
+      disconnectClients(&m_clientList);
     } else {
       // Existing
       if (!m_clientList.empty()) {
@@ -122,10 +153,7 @@ Desktop *RfbClientManager::onClientAuth(RfbClient *client)
 
 bool RfbClientManager::onCheckForBan(RfbClient *client)
 {
-  StringStorage ip;
-  client->getPeerHost(&ip);
-
-  return checkForBan(&ip);
+  return checkForBan(getClientAddress(client));
 }
 
 void RfbClientManager::onAuthFailed(RfbClient *client)
@@ -133,7 +161,7 @@ void RfbClientManager::onAuthFailed(RfbClient *client)
   StringStorage ip;
   client->getPeerHost(&ip);
 
-  updateIpInBan(&ip, false);
+  updateIpInBan(getClientAddress(client), false);
 
   m_newConnectionEvents->onAuthFailed(&ip);
 }
@@ -155,7 +183,8 @@ void RfbClientManager::onCheckAccessControl(RfbClient *client)
   IpAccessRule::ActionType action;
 
   if (!client->isOutgoing()) {
-    action = config->getActionByAddress((unsigned long)addr_in.sin_addr.S_un.S_addr);
+    action = Configurator::getConfigSnapshot()->
+      getActionByAddress((unsigned long)addr_in.sin_addr.S_un.S_addr);
   } else {
     action = IpAccessRule::ACTION_TYPE_ALLOW;
   }
@@ -176,9 +205,24 @@ void RfbClientManager::onCheckAccessControl(RfbClient *client)
   }
 }
 
+bool RfbClientManager::onBulkChannelAuth(RfbClient *client, const UINT8 *token)
+{
+  // The bulk channel itself stays in the non-authorized clients list, it
+  // does not count as a client.
+  AutoReadLock al(&m_clientListLocker);
+  for (ClientListIter iter = m_clientList.begin();
+       iter != m_clientList.end(); iter++) {
+    if ((*iter)->getClientState() == IN_NORMAL_PHASE &&
+        (*iter)->attachBulkChannel(client, token)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void RfbClientManager::onClipboardUpdate(const StringStorage *newClipboard)
 {
-  AutoLock al(&m_clientListLocker);
+  AutoWriteLock al(&m_clientListLocker);
   for (ClientListIter iter = m_clientList.begin();
        iter != m_clientList.end(); iter++) {
     if ((*iter)->getClientState() == IN_NORMAL_PHASE) {
@@ -190,18 +234,56 @@ void RfbClientManager::onClipboardUpdate(const StringStorage *newClipboard)
 void RfbClientManager::onSendUpdate(const UpdateContainer *updateContainer,
                                     const CursorShape *cursorShape)
 {
-  AutoLock al(&m_clientListLocker);
+  AutoWriteLock al(&m_clientListLocker);
+
+  // Sharing encoded data makes sense only for two or more clients, and it
+  // costs some compression efficiency (Tight has to reset its zlib streams
+  // for each rectangle), so the cache is enabled only in that case.
+  int numClients = 0;
   for (ClientListIter iter = m_clientList.begin();
        iter != m_clientList.end(); iter++) {
     if ((*iter)->getClientState() == IN_NORMAL_PHASE) {
-      (*iter)->sendUpdate(updateContainer, cursorShape);
+      numClients++;
+    }
+  }
+  m_rectCache.setEnabled(numClients > 1);
+  m_rectCache.nextGeneration();
+
+  // The changed region is recorded once in the shared tile map rather than
+  // merged into every client. The moves are applied by each client to its
+  // own pending changes, so an update with moves is passed as a whole after
+  // the clients have taken the tiles changed before it.
+  m_frameStore.markChanged(updateContainer);
+
+  const UpdateContainer *clientUpdate = updateContainer;
+  UpdateContainer updateWithoutChanges;
+  if (updateContainer->copies.empty()) {
+    m_dirtyTiles.markChanged(&updateContainer->changedRegion);
+    // Everything but the changed region, which is not copied at all.
+    updateWithoutChanges.videoRegion = updateContainer->videoRegion;
+    updateWithoutChanges.screenSizeChanged = updateContainer->screenSizeChanged;
+    updateWithoutChanges.cursorPosChanged = updateContainer->cursorPosChanged;
+    updateWithoutChanges.cursorShapeChanged = updateContainer->cursorShapeChanged;
+    updateWithoutChanges.cursorPos = updateContainer->cursorPos;
+    clientUpdate = &updateWithoutChanges;
+  }
+
+  // The stream copies the changes before the clients drop them.
+  if (m_multicast.isStarted() && m_desktop != 0) {
+    m_multicast.onUpdate(m_desktop, updateContainer);
+  }
+
+  for (ClientListIter iter = m_clientList.begin();
+       iter != m_clientList.end(); iter++) {
+    if ((*iter)->getClientState() == IN_NORMAL_PHASE) {
+      (*iter)->sendUpdate(clientUpdate, cursorShape);
     }
   }
 }
 
 bool RfbClientManager::isReadyToSend()
 {
-  AutoLock al(&m_clientListLocker);
+  AutoReadLock al(&m_clientListLocker);
   bool isReady = false;
   for (ClientListIter iter = m_clientList.begin();
        iter != m_clientList.end(); iter++) {
@@ -212,6 +294,49 @@ bool RfbClientManager::isReadyToSend()
   return isReady;
 }
 
+bool RfbClientManager::getCaptureRegion(const Dimension *fbDimension,
+                                        Region *captureRegion)
+{
+  AutoReadLock al(&m_clientListLocker);
+  captureRegion->clear();
+  bool hasClients = false;
+  for (ClientListIter iter = m_clientList.begin();
+       iter != m_clientList.end(); iter++) {
+    if ((*iter)->getClientState() == IN_NORMAL_PHASE) {
+      Region visibleRegion;
+      (*iter)->getVisibleRegion(fbDimension, &visibleRegion);
+      captureRegion->add(&visibleRegion);
+      hasClients = true;
+    }
+  }
+  if (!hasClients) {
+    return false;
+  }
+  // Limit the capture only if some pixels are watched by nobody.
+  Rect fbRect = fbDimension->getRect();
+  captureRegion->crop(&fbRect);
+  Region unwatched(fbRect);
+  unwatched.subtract(captureRegion);
+  return !unwatched.isEmpty();
+}
+
+int RfbClientManager::getVisualEffectsLevel()
+{
+  int level = VisualEffectsUtil::LEVEL_FULL;
+  ServerConfig *config = Configurator::getInstance()->getServerConfig();
+  if (!config->isReducingVisualEffectsEnabled()) {
+    return level;
+  }
+  AutoReadLock al(&m_clientListLocker);
+  for (ClientListIter iter = m_clientList.begin();
+       iter != m_clientList.end(); iter++) {
+    if ((*iter)->getClientState() == IN_NORMAL_PHASE) {
+      level = max(level, (*iter)->getVisualEffectsLevel());
+    }
+  }
+  return level;
+}
+
 void RfbClientManager::onAbnormalDesktopTerminate()
 {
   m_log->error(_T("onAbnormalDesktopTerminate() called"));
@@ -220,25 +345,32 @@ void RfbClientManager::onAbnormalDesktopTerminate()
 
 void RfbClientManager::disconnectAllClients()
 {
-  AutoLock al(&m_clientListLocker);
-  disconnectNonAuthClients();
-  disconnectAuthClients();
+  // The mutex is not recursive, so the clients are disconnected under
+  // one lock.
+  AutoReadLock al(&m_clientListLocker);
+  disconnectClients(&m_nonAuthClientList);
+  disconnectClients(&m_clientList);
 }
 
 void RfbClientManager::disconnectNonAuthClients()
 {
-  AutoLock al(&m_clientListLocker);
-  for (ClientListIter iter = m_nonAuthClientList.begin();
-       iter != m_nonAuthClientList.end(); iter++) {
-    (*iter)->disconnect();
-  }
+  AutoReadLock al(&m_clientListLocker);
+  disconnectClients(&m_nonAuthClientList);
 }
 
 void RfbClientManager::disconnectAuthClients()
 {
-  AutoLock al(&m_clientListLocker);
-  for (ClientListIter iter = m_clientList.begin();
-       iter != m_clientList.end(); iter++) {
+  AutoReadLock al(&m_clientListLocker);
+  disconnectClients(&m_clientList);
+}
+
+void RfbClientManager::disconnectClients(ClientList *clientList)
+{
+  // Disconnecting only cancels the I/O of the clients, their threads
+  // unwind in parallel and remove themselves from the lists later, so
+  // the read lock is enough and does not hold the updates of the others.
+  for (ClientListIter iter = clientList->begin();
+       iter != clientList->end(); iter++) {
     (*iter)->disconnect();
   }
 }
@@ -247,7 +379,7 @@ void RfbClientManager::waitUntilAllClientAreBeenDestroyed()
 {
   while (true) {
     {
-      AutoLock al(&m_clientListLocker);
+      AutoReadLock al(&m_clientListLocker);
       if (m_clientList.empty() && m_nonAuthClientList.empty()) {
         break;
       }
@@ -261,7 +393,7 @@ void RfbClientManager::validateClientList()
 {
   Desktop *objectToDestroy = 0;
   {
-    AutoLock al(&m_clientListLocker);
+    AutoWriteLock al(&m_clientListLocker);
     // If clients are in the IN_READY_TO_REMOVE phase, remove them from the
     // non-authorized clients list.
     ClientListIter iter = m_nonAuthClientList.begin();
@@ -302,18 +434,38 @@ void RfbClientManager::validateClientList()
     }
   }
 
-  AutoLock al(&m_clientListLocker);
+  AutoReadLock al(&m_clientListLocker);
   if (m_clientList.empty() && m_nonAuthClientList.empty()) {
     m_listUnderflowingEvent.notify();
   }
 }
 
-bool RfbClientManager::checkForBan(const StringStorage *ip)
+unsigned long RfbClientManager::getClientAddress(RfbClient *client)
+{
+  SocketAddressIPv4 peerAddr;
+  try {
+    client->getSocketAddr(&peerAddr);
+  } catch (...) {
+    return 0;
+  }
+  return (unsigned long)peerAddr.getSockAddr().sin_addr.S_un.S_addr;
+}
+
+RfbClientManager::BanShard *RfbClientManager::getBanShard(unsigned long ip)
+{
+  // The last byte of the address varies the most between the hosts of a
+  // network.
+  UINT32 hostIp = ntohl(ip);
+  return &m_banShards[(hostIp ^ (hostIp >> 8)) % BAN_SHARDS];
+}
+
+bool RfbClientManager::checkForBan(unsigned long ip)
 {
-  AutoLock al(&m_banListMutex);
+  BanShard *shard = getBanShard(ip);
+  AutoLock al(&shard->lock);
 
-  BanListIter it = m_banList.find(*ip);
-  if (it != m_banList.end()) {
+  BanListIter it = shard->list.find(ip);
+  if (it != shard->list.end()) {
     unsigned int count = (*it).second.count;
     DateTime lastTime = (*it).second.banLastTime;
     DateTime now = DateTime::now();
@@ -330,18 +482,19 @@ bool RfbClientManager::checkForBan(const StringStorage *ip)
   }
 }
 
-void RfbClientManager::updateIpInBan(const StringStorage *ip, bool success)
+void RfbClientManager::updateIpInBan(unsigned long ip, bool success)
 {
-  AutoLock al(&m_banListMutex);
+  BanShard *shard = getBanShard(ip);
+  AutoLock al(&shard->lock);
 
-  BanListIter it = m_banList.find(*ip);
+  BanListIter it = shard->list.find(ip);
   if (success) {
-    if (it != m_banList.end()) {
+    if (it != shard->list.end()) {
       // Even if client is already banned!
-      m_banList.erase(it);
+      shard->list.erase(it);
     }
   } else {
-    if (it != m_banList.end()) {
+    if (it != shard->list.end()) {
       // Increase ban count
       (*it).second.count += 1;
       (*it).second.banLastTime = DateTime::now();
@@ -350,16 +503,32 @@ void RfbClientManager::updateIpInBan(const StringStorage *ip, bool success)
       BanProp banProp;
       banProp.banLastTime = DateTime::now();
       banProp.count = 0;
-      m_banList[*ip] = banProp;
+      shard->list[ip] = banProp;
     }
   }
 }
 
+BanList RfbClientManager::getBanList()
+{
+  BanList banList;
+  for (size_t i = 0; i < BAN_SHARDS; i++) {
+    AutoLock al(&m_banShards[i].lock);
+    banList.insert(m_banShards[i].list.begin(), m_banShards[i].list.end());
+  }
+  return banList;
+}
+
 StringStorage RfbClientManager::getBanListString()
 {
   StringStorage str;
-  for (BanListIter it = m_banList.begin(); it != m_banList.end(); it++) {
-    StringStorage ip = (*it).first;
+  BanList banList = getBanList();
+  for (BanListIter it = banList.begin(); it != banList.end(); it++) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.S_un.S_addr = (*it).first;
+    StringStorage ip;
+    SocketAddressIPv4(addr).toString(&ip);
     StringStorage s;
     unsigned int count = (*it).second.count;
     DateTime lastTime = (*it).second.banLastTime;
@@ -371,11 +540,96 @@ StringStorage RfbClientManager::getBanListString()
   return str;
 }
 
+IocpEngine *RfbClientManager::getIocpEngine()
+{
+  if (!Configurator::getInstance()->getServerConfig()->isIoCompletionPortEnabled()) {
+    return 0;
+  }
+  // The engine is created with the first client which needs it and is kept
+  // for the following ones.
+  AutoLock al(&m_iocpEngineLock);
+  try {
+    if (m_iocpEngine == 0) {
+      m_iocpEngine = new IocpEngine(0);
+    }
+  } catch (Exception &e) {
+    m_log->error(_T("Can't start the I/O completion port engine: %s"),
+                 e.getMessage());
+  }
+  return m_iocpEngine;
+}
+
+void RfbClientManager::onWebSocketConnection(SocketIPv4 *socket)
+{
+  try {
+    SocketAddressIPv4 peerAddr;
+    socket->getPeerAddr(&peerAddr);
+    StringStorage peerIpString;
+    peerAddr.toString(&peerIpString);
+
+    m_log->message(_T("Incoming WebSocket rfb connection from %s"),
+                   peerIpString.getString());
+
+    // The same checks as for the connections to the rfb port. The HTTP port
+    // is not bound to localhost, so the loopback restriction is checked here.
+    ServerConfig *config = Configurator::getInstance()->getServerConfig();
+    struct sockaddr_in addr_in = peerAddr.getSockAddr();
+    IpAccessRule::ActionType action = Configurator::getConfigSnapshot()->
+      getActionByAddress((unsigned long)addr_in.sin_addr.S_un.S_addr);
+    bool isLoopback = (ntohl(addr_in.sin_addr.S_un.S_addr) >> 24) == 127;
+    if (!config->isAcceptingRfbConnections() ||
+        (config->isOnlyLoopbackConnectionsAllowed() && !isLoopback) ||
+        action == IpAccessRule::ACTION_TYPE_DENY) {
+      m_log->message(_T("WebSocket connection rejected"));
+      delete socket;
+      return;
+    }
+
+    socket->enableNaggleAlgorithm(false);
+
+    addNewConnection(socket, &ViewPortState(), false, false, true);
+  } catch (Exception &ex) {
+    m_log->error(_T("Failed to process WebSocket connection with following reason: \"%s\""), ex.getMessage());
+  }
+}
+
+void RfbClientManager::admitConnection(SocketIPv4 *socket,
+                                       const ViewPortState *constViewPort)
+{
+  m_admission.admit(socket, constViewPort);
+}
+
+bool RfbClientManager::isAddressBanned(unsigned long ip)
+{
+  return checkForBan(ip);
+}
+
+void RfbClientManager::onConnectionAdmitted(SocketIPv4 *socket,
+                                            const ViewPortState *constViewPort,
+                                            const char *clientVersion)
+{
+  addNewConnection(socket, constViewPort, false, false, false, clientVersion);
+}
+
 void RfbClientManager::addNewConnection(SocketIPv4 *socket,
-                                        ViewPortState *constViewPort,
-                                        bool viewOnly, bool isOutgoing)
+                                        const ViewPortState *constViewPort,
+                                        bool viewOnly, bool isOutgoing,
+                                        bool isWebSocket,
+                                        const char *clientVersion)
 {
-  AutoLock al(&m_clientListLocker);
+  // A banned address is turned away before a thread is made for it, the
+  // handshake checks the ban again.
+  if (!isOutgoing) {
+    SocketAddressIPv4 peerAddr;
+    if (socket->getPeerAddr(&peerAddr) &&
+        checkForBan((unsigned long)peerAddr.getSockAddr().sin_addr.S_un.S_addr)) {
+      m_log->message(_T("Connection rejected, the address is banned"));
+      delete socket;
+      return;
+    }
+  }
+
+  AutoWriteLock al(&m_clientListLocker);
 
   ServerConfig *config = Configurator::getInstance()->getServerConfig();
   int timeout = 1000 * config->getIdleTimeout();
@@ -389,25 +643,63 @@ void RfbClientManager::addNewConnection(SocketIPv4 *socket,
     m_log->error(_T("Can't set socket timeout, error: %d"), WSAGetLastError());
   }
 
+  SocketProfile socketProfile;
+  config->getSocketProfile(&socketProfile);
+  try {
+    socketProfile.apply(socket);
+  } catch (SocketException &e) {
+    m_log->error(_T("Can't apply the socket profile: %s"), e.getMessage());
+  }
+  StringStorage socketValues;
+  SocketProfile::describe(socket, &socketValues);
+  m_log->info(_T("Socket of client #%d: %s"), m_nextClientId,
+              socketValues.getString());
+
   _ASSERT(constViewPort != 0);
 
+  // With a memory budget, the clients share their frame buffers and give
+  // back the idle scratch buffers of their encoders.
+  UINT64 memoryBudget = (UINT64)config->getMemoryBudget() * 1024 * 1024;
+  m_frameStore.setBudget(memoryBudget);
+  SharedFrameStore *frameStore = memoryBudget != 0 ? &m_frameStore : 0;
+
+  // The limits shared by all the clients follow the configuration as the
+  // clients connect.
+  m_serverBandwidth.setRate(config->getMaxBandwidth() * 1024);
+  m_fileTransferBandwidth.setRate(config->getMaxFileTransferBandwidth() * 1024);
+
+  // A WebSocket connection may have been watched by the engine for the
+  // HTTP server, and a socket can't be added to the engine twice.
+  IocpEngine *iocpEngine = isWebSocket ? 0 : getIocpEngine();
+
   m_log->error(_T("Client #%d connected"), m_nextClientId);
   m_log->debug(_T("new client, process memory usage: %d "), MemUsage::getCurrentMemUsage());
 
   m_nonAuthClientList.push_back(new RfbClient(m_newConnectionEvents,
                                               socket, this, this, viewOnly,
                                               isOutgoing,
+                                              isWebSocket,
+                                              clientVersion,
                                               m_nextClientId,
                                               constViewPort,
                                               &m_dynViewPort,
                                               timeout,
+                                              &m_rectCache,
+                                              &m_dirtyTiles,
+                                              frameStore,
+                                              m_multicast.isStarted() ?
+                                                &m_multicast : 0,
+                                              iocpEngine,
+                                              &m_clientScheduler,
+                                              &m_serverBandwidth,
+                                              &m_fileTransferBandwidth,
                                               m_log));
   m_nextClientId++;
 }
 
 void RfbClientManager::getClientsInfo(RfbClientInfoList *list)
 {
-  AutoLock al(&m_clientListLocker);
+  AutoReadLock al(&m_clientListLocker);
 
   for (ClientListIter it = m_clientList.begin(); it != m_clientList.end(); it++) {
     RfbClient *each = *it;
@@ -421,9 +713,40 @@ void RfbClientManager::getClientsInfo(RfbClientInfoList *list)
   }
 }
 
+void RfbClientManager::getClientsStatistics(RfbClientStatisticsList *list)
+{
+  AutoReadLock al(&m_clientListLocker);
+
+  for (ClientListIter it = m_clientList.begin(); it != m_clientList.end(); it++) {
+    RfbClient *each = *it;
+    if (each->getClientState() == IN_NORMAL_PHASE) {
+      StringStorage peerHost;
+
+      each->getPeerHost(&peerHost);
+
+      RfbClientStatistics clientStats(each->getId(), peerHost.getString());
+      each->getStatistics(&clientStats.m_stats);
+      list->push_back(clientStats);
+    }
+  }
+}
+
+bool RfbClientManager::getCaptureStatistics(CaptureStatistics *stats)
+{
+  // The desktop is not destroyed while the lock is held: it is detached
+  // from m_desktop under the lock first.
+  AutoReadLock al(&m_clientListLocker);
+
+  if (m_desktop == 0) {
+    return false;
+  }
+  m_desktop->getCaptureStatistics(stats);
+  return true;
+}
+
 void RfbClientManager::setDynViewPort(const ViewPortState *dynViewPort)
 {
-  AutoLock al(&m_clientListLocker);
+  AutoWriteLock al(&m_clientListLocker);
   m_dynViewPort = *dynViewPort;
 
   // Assign the dynViewPort value for all already run clients too.
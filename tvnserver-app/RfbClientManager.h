@@ -27,9 +27,17 @@
 
 #include "util/ListenerContainer.h"
 #include "rfb-sconn/RfbClient.h"
+#include "rfb-sconn/EncodedRectCache.h"
+#include "fb-update-sender/DirtyTileMap.h"
+#include "fb-update-sender/SharedFrameStore.h"
+#include "fb-update-sender/MulticastSender.h"
+#include "network/TokenBucket.h"
 #include "thread/AutoLock.h"
 #include "thread/Thread.h"
 #include "thread/LocalMutex.h"
+#include "thread/AutoReadLock.h"
+#include "thread/AutoWriteLock.h"
+#include "thread/TaskScheduler.h"
 #include "win-system/WindowsEvent.h"
 #include "desktop/Desktop.h"
 #include "desktop/DesktopFactory.h"
@@ -43,8 +51,11 @@
 #include "desktop/AbnormDeskTermListener.h"
 #include "desktop/UpdateSendingListener.h"
 #include "rfb-sconn/ClientAuthListener.h"
+#include "http-server-lib/WebSocketListener.h"
 #include "tvncontrol-app/RfbClientInfo.h"
+#include "tvncontrol-app/RfbClientStatistics.h"
 #include "NewConnectionEvents.h"
+#include "ConnectionAdmission.h"
 
 typedef std::list<RfbClient *> ClientList;
 typedef std::list<RfbClient *>::iterator ClientListIter;
@@ -54,7 +65,8 @@ struct BanProp
   unsigned int count;
   DateTime banLastTime;
 };
-typedef std::map<StringStorage, BanProp> BanList;
+// Keyed by the address in network byte order.
+typedef std::map<unsigned long, BanProp> BanList;
 typedef BanList::iterator BanListIter;
 
 //
@@ -67,6 +79,8 @@ class RfbClientManager: public ClientTerminationListener,
                         public UpdateSendingListener,
                         public ClientAuthListener,
                         public AbnormDeskTermListener,
+                        public WebSocketListener,
+                        public ConnectionAdmissionListener,
                         public ListenerContainer<RfbClientManagerEventListener *>
 {
 public:
@@ -81,6 +95,13 @@ public:
   // FIXME: This method needed only for control server.
   void getClientsInfo(RfbClientInfoList *list);
 
+  // Adds the counters of the rfb clients to the list.
+  void getClientsStatistics(RfbClientStatisticsList *list);
+
+  // Fills stats with the screen capture counters.
+  // Returns false if there is no desktop, i.e. no client is connected.
+  bool getCaptureStatistics(CaptureStatistics *stats);
+
   // Disconnects all connected clients.
   virtual void disconnectAllClients();
   virtual void disconnectNonAuthClients();
@@ -91,11 +112,25 @@ public:
   void setDynViewPort(const ViewPortState *dynViewPort);
 
   // FIXME: Place comment for this method here.
-  void addNewConnection(SocketIPv4 *socket, ViewPortState *constViewPort,
-                        bool viewOnly, bool isOutgoing);
+  // With isWebSocket set, the socket carries the protocol in WebSocket
+  // frames, its opening handshake must have been done. The clientVersion
+  // is the protocol version message read from the client already, if any.
+  void addNewConnection(SocketIPv4 *socket, const ViewPortState *constViewPort,
+                        bool viewOnly, bool isOutgoing, bool isWebSocket,
+                        const char *clientVersion = 0);
+
+  // Passes an incoming connection through the admission (see
+  // ConnectionAdmission), which adds it if the client goes on to the
+  // handshake.
+  void admitConnection(SocketIPv4 *socket, const ViewPortState *constViewPort);
+
+  // Returns the network engine shared by the clients and the HTTP server,
+  // creates it the first time. Returns 0 if the I/O completion port is
+  // disabled or the engine can't be started.
+  IocpEngine *getIocpEngine();
 
   // returns list of bans.
-  BanList getBanList() { AutoLock al(&m_banListMutex); return m_banList; };
+  BanList getBanList();
   StringStorage getBanListString();
 
 protected:
@@ -106,40 +141,100 @@ protected:
   // This function only adds the client to the ban list.
   virtual void onAuthFailed(RfbClient *client);
   virtual void onCheckAccessControl(RfbClient *client) throw(AuthException);
+  // Looks for the authenticated client having the token.
+  virtual bool onBulkChannelAuth(RfbClient *client, const UINT8 *token);
   virtual void onClipboardUpdate(const StringStorage *newClipboard);
   virtual void onSendUpdate(const UpdateContainer *updateContainer,
                             const CursorShape *cursorShape);
   virtual bool isReadyToSend();
+  virtual bool getCaptureRegion(const Dimension *fbDimension,
+                                Region *captureRegion);
+  // Returns the most reducing level of the clients if the reduction of the
+  // visual effects is enabled.
+  virtual int getVisualEffectsLevel();
   // If an error occured RfbClientManager closes all current connections
   // (authorized and not authorized) that bring to closing the belonged desktop
   // object.
   virtual void onAbnormalDesktopTerminate();
+  // Adds the connection upgraded by the HTTP server as a new client.
+  virtual void onWebSocketConnection(SocketIPv4 *socket);
 
   void waitUntilAllClientAreBeenDestroyed();
 
 private:
   void validateClientList();
 
-  // Checks the ip to ban.
+  // Disconnects the clients of the list.
+  // Must be called with the m_clientListLocker mutex held for writing.
+  void disconnectClients(ClientList *clientList);
+
+  // Inherited from ConnectionAdmissionListener.
+  virtual bool isAddressBanned(unsigned long ip);
+  virtual void onConnectionAdmitted(SocketIPv4 *socket,
+                                    const ViewPortState *constViewPort,
+                                    const char *clientVersion);
+
+  // Checks the ip (in network byte order) to ban.
   // Returns true if client is banned.
-  bool checkForBan(const StringStorage *ip);
+  bool checkForBan(unsigned long ip);
   // If the success param is true the belonged ip entry will be removed
   // from the ban list. Else the ip will be added to the ban or will be
   // increased it count.
-  void updateIpInBan(const StringStorage *ip, bool success);
+  void updateIpInBan(unsigned long ip, bool success);
+  // Returns the address of the client in network byte order.
+  static unsigned long getClientAddress(RfbClient *client);
 
   ClientList m_nonAuthClientList;
   ClientList m_clientList;
-  LocalMutex m_clientListLocker;
+  // Read for each update, written only when clients come and go.
+  ReadWriteMutex m_clientListLocker;
   // m_dynViewPort is a client view port that can be changed during a
   // client work. Now, the dynViewPort has the same value for all clients.
   // By this field initilizes new clients.
   // Acces to the viewport must be covered by the m_clientListLocker mutex.
   ViewPortState m_dynViewPort;
 
-  BanList m_banList;
+  // Encoded rectangles shared between all the clients in normal phase, so
+  // that each changed rectangle is encoded once for all the clients that
+  // use the same encoding parameters.
+  EncodedRectCache m_rectCache;
+  // Changed tiles of the frame buffer shared between the clients.
+  DirtyTileMap m_dirtyTiles;
+  // Frame buffers shared between the clients connected while a memory
+  // budget was set, and the budget.
+  SharedFrameStore m_frameStore;
+  // Bandwidth limits of all the clients together, of their updates and
+  // other messages and of their file transfers.
+  TokenBucket m_serverBandwidth;
+  TokenBucket m_fileTransferBandwidth;
+  // Stream of the screen to the multicast group of the configuration, not
+  // started if there is no group.
+  MulticastSender m_multicast;
+
+  // Engine reading messages of the clients connected while the I/O
+  // completion port was enabled, 0 until the first such client.
+  IocpEngine *m_iocpEngine;
+  LocalMutex m_iocpEngineLock;
+
+  // Runs the rare per-client work, such as clipboard sending, on a few
+  // threads instead of a sleeping thread per client.
+  static const unsigned int CLIENT_SCHEDULER_THREADS = 2;
+  TaskScheduler m_clientScheduler;
+
+  // The bans are spread over the shards by the address, so that the
+  // connections from different addresses do not wait for each other.
+  struct BanShard
+  {
+    BanList list;
+    LocalMutex lock;
+  };
+  static const size_t BAN_SHARDS = 16;
+  BanShard m_banShards[BAN_SHARDS];
+  BanShard *getBanShard(unsigned long ip);
   WindowsEvent m_banTimer;
-  LocalMutex m_banListMutex;
+
+  // Handshake of the incoming connections before they get client threads.
+  ConnectionAdmission m_admission;
 
   WindowsEvent m_listUnderflowingEvent;
 
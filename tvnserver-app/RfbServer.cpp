@@ -30,7 +30,7 @@ RfbServer::RfbServer(const TCHAR *bindHost, unsigned short bindPort,
                      bool lockAddr,
                      LogWriter *log,
                      const Rect *viewPort)
-: TcpServer(bindHost, bindPort, false, lockAddr),
+: TcpServer(bindHost, bindPort, false, lockAddr, NUM_ACCEPT_THREADS),
   m_clientManager(clientManager),
   m_log(log)
 {
@@ -69,8 +69,8 @@ void RfbServer::onAcceptConnection(SocketIPv4 *socket)
 
     // Check access control rules for the IP address of the peer.
     // FIXME: Check loopback-related rules separately, report differently.
-    ServerConfig *config = Configurator::getInstance()->getServerConfig();
-    IpAccessRule::ActionType action = config->getActionByAddress((unsigned long)addr_in.sin_addr.S_un.S_addr);
+    IpAccessRule::ActionType action = Configurator::getConfigSnapshot()->
+      getActionByAddress((unsigned long)addr_in.sin_addr.S_un.S_addr);
 
     if (action == IpAccessRule::ACTION_TYPE_DENY) {
       m_log->message(_T("Connection rejected due to access control rules"));
@@ -78,12 +78,12 @@ void RfbServer::onAcceptConnection(SocketIPv4 *socket)
       return;
     }
 
-    // Access granted, add new RFB client. One more check will follow later in
-    // RfbClientManager::onCheckAccessControl().
+    // Access granted, the client is added after the admission. One more
+    // check will follow later in RfbClientManager::onCheckAccessControl().
 
     socket->enableNaggleAlgorithm(false);
 
-    m_clientManager->addNewConnection(socket, &m_viewPort, false, false);
+    m_clientManager->admitConnection(socket, &m_viewPort);
 
   } catch (Exception &ex) {
     m_log->error(_T("Failed to process incoming rfb connection with following reason: \"%s\""), ex.getMessage());
@@ -80,6 +80,12 @@ protected:
 
 private:
   LogWriter *m_log;
+
+  /**
+   * Number of threads accepting incoming connections, so a burst of
+   * connecting viewers is not serialized on a single accept() loop.
+   */
+  static const unsigned int NUM_ACCEPT_THREADS = 4;
 };
 
 #endif // __LISTENTCPSOCKET_H__
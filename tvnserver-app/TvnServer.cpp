@@ -31,6 +31,7 @@
 #include "server-config-lib/Configurator.h"
 
 #include "thread/GlobalMutex.h"
+#include "thread/LockProfiler.h"
 
 #include "tvnserver/resource.h"
 
@@ -40,6 +41,9 @@
 
 #include "util/StringTable.h"
 #include "util/AnsiStringStorage.h"
+#include "util/CpuFeatures.h"
+#include "util/LargePages.h"
+#include "thread/SchedulingPolicy.h"
 #include "tvnserver-app/NamingDefs.h"
 
 #include "file-lib/File.h"
@@ -68,17 +72,26 @@ TvnServer::TvnServer(bool runsInServiceContext,
   m_config(runsInServiceContext),
   m_log(logger),
   m_contextSwitchResolution(1),
-  m_extraRfbServers(&m_log)
+  m_startTime(GetTickCount()),
+  m_secondaryStarter(0),
+  m_extraRfbServers(&m_log),
+  m_memoryReporter(&m_log),
+  m_zoneReporter(&m_log),
+  m_stallWatchdog(&m_log)
 {
   m_log.message(_T("%s Build on %s"),
                  ProductNames::SERVER_PRODUCT_NAME,
                  BuildTime::DATE);
 
+  StringStorage timeline;
+  DWORD phaseStart = m_startTime;
+
   // Initialize configuration.
   // FIXME: It looks like configurator may be created as a member object.
   Configurator *configurator = Configurator::getInstance();
   configurator->load();
   m_srvConfig = Configurator::getInstance()->getServerConfig();
+  addStartupPhase(&timeline, _T("config"), &phaseStart);
 
   try {
     StringStorage logDir;
@@ -86,10 +99,54 @@ TvnServer::TvnServer(bool runsInServiceContext,
     unsigned char logLevel = m_srvConfig->getLogLevel();
     // FIXME: Use correct log name.
     m_logInitListener->onLogInit(logDir.getString(), LogNames::SERVER_LOG_FILE_STUB_NAME, logLevel);
+    m_stallWatchdog.setDumpDir(logDir.getString());
+    // Lock contention is profiled at the debug log level only.
+    LockProfiler::setEnabled(logLevel >= LogWriter::LOG_DEBUG);
 
   } catch (...) {
     // A log error must not be a reason that stop the server.
   }
+  addStartupPhase(&timeline, _T("log"), &phaseStart);
+
+  // The SIMD kernels are chosen as they are created, so the limit is set
+  // before any of them.
+  StringStorage simdLevelName;
+  m_srvConfig->getSimdLevel(&simdLevelName);
+  int simdLevel;
+  if (!CpuFeatures::parseLevel(simdLevelName.getString(), &simdLevel)) {
+    m_log.error(_T("Unknown SIMD level \"%s\", the kernels are not limited"),
+                simdLevelName.getString());
+    simdLevel = CpuFeatures::LEVEL_AVX2;
+  }
+  CpuFeatures::setMaxLevel(simdLevel);
+  StringStorage cpuDesc;
+  CpuFeatures::getDescription(&cpuDesc);
+  m_log.message(_T("SIMD kernels, %s"), cpuDesc.getString());
+
+  // Likewise, the frame buffers allocated later go to large pages.
+  if (m_srvConfig->isLargePageFrameBuffersEnabled()) {
+    StringStorage error;
+    if (LargePages::enable(&error)) {
+      m_log.message(_T("Frame buffers use large pages of %u KB"),
+                    (unsigned int)(LargePages::getPageSize() / 1024));
+    } else {
+      m_log.error(_T("Frame buffers cannot use large pages: %s"),
+                  error.getString());
+    }
+  }
+
+  // The pipeline threads take the policy as they are created.
+  SchedulingPolicy::setPriority(SchedulingPolicy::ROLE_CAPTURE,
+                                m_srvConfig->getCaptureThreadPriority());
+  SchedulingPolicy::setPriority(SchedulingPolicy::ROLE_SENDER,
+                                m_srvConfig->getSenderThreadPriority());
+  SchedulingPolicy::setPriority(SchedulingPolicy::ROLE_ENCODER,
+                                m_srvConfig->getEncoderThreadPriority());
+  SchedulingPolicy::setEncoderAffinity(m_srvConfig->isEncoderAffinityEnabled());
+  StringStorage schedulingDesc;
+  SchedulingPolicy::getDescription(&schedulingDesc);
+  m_log.message(_T("Thread scheduling, %s"), schedulingDesc.getString());
+  addStartupPhase(&timeline, _T("tuning"), &phaseStart);
 
   // Initialize windows sockets.
 
@@ -100,9 +157,17 @@ TvnServer::TvnServer(bool runsInServiceContext,
   } catch (Exception &ex) {
     m_log.interror(_T("%s"), ex.getMessage());
   }
+  addStartupPhase(&timeline, _T("winsock"), &phaseStart);
 
+  // The desktop (capture drivers, hooks, the desktop server process) is
+  // created by the client manager when the first client is authorized.
   DesktopFactory *desktopFactory = 0;
-  if (runsInServiceContext) {
+  StringStorage relayHost;
+  m_srvConfig->getRelayHost(&relayHost);
+  if (!relayHost.isEmpty()) {
+    m_log.message(_T("Relaying the desktop of %s"), relayHost.getString());
+    desktopFactory = &m_relayDesktopFactory;
+  } else if (runsInServiceContext) {
     desktopFactory = &m_serviceDesktopFactory;
   } else {
     desktopFactory = &m_applicationDesktopFactory;
@@ -111,6 +176,7 @@ TvnServer::TvnServer(bool runsInServiceContext,
   m_rfbClientManager = new RfbClientManager(0, newConnectionEvents, &m_log, desktopFactory);
 
   m_rfbClientManager->addListener(this);
+  addStartupPhase(&timeline, _T("client manager"), &phaseStart);
 
   // FIXME: No good to act as a listener before completing the object
   //        construction.
@@ -123,13 +189,50 @@ TvnServer::TvnServer(bool runsInServiceContext,
 
     restartMainRfbServer();
     (void)m_extraRfbServers.reload(m_runAsService, m_rfbClientManager);
+  }
+  addStartupPhase(&timeline, _T("rfb servers"), &phaseStart);
+  m_log.message(_T("Startup timeline: %s, total %u ms"), timeline.getString(),
+                (unsigned int)(GetTickCount() - m_startTime));
+
+  // Nothing above depends on the http and control servers, and the clients
+  // of both retry, so they do not delay the service start.
+  m_secondaryStarter = new SecondaryServerStarter(this);
+}
+
+void TvnServer::startSecondaryServers()
+{
+  StringStorage timeline;
+  DWORD phaseStart = GetTickCount();
+  {
+    AutoLock l(&m_mutex);
     restartHttpServer();
+  }
+  addStartupPhase(&timeline, _T("http server"), &phaseStart);
+  {
+    AutoLock l(&m_mutex);
     restartControlServer();
   }
+  addStartupPhase(&timeline, _T("control server"), &phaseStart);
+  m_log.message(_T("Startup timeline: %s, total %u ms"), timeline.getString(),
+                (unsigned int)(GetTickCount() - m_startTime));
+}
+
+void TvnServer::addStartupPhase(StringStorage *timeline, const TCHAR *name,
+                                DWORD *phaseStart)
+{
+  DWORD now = GetTickCount();
+  StringStorage phase;
+  phase.format(_T("%s%s %u ms"), timeline->isEmpty() ? _T("") : _T(", "),
+               name, (unsigned int)(now - *phaseStart));
+  timeline->appendString(phase.getString());
+  *phaseStart = now;
 }
 
 TvnServer::~TvnServer()
 {
+  // Waits until the http and control servers are started.
+  delete m_secondaryStarter;
+
   Configurator::getInstance()->removeListener(this);
 
   stopControlServer();
@@ -147,6 +250,8 @@ TvnServer::~TvnServer()
 
   delete m_rfbClientManager;
 
+  logLockContentions();
+
   m_log.info(_T("Shutdown WinSock"));
 
   try {
@@ -335,7 +440,11 @@ void TvnServer::restartHttpServer()
     try {
       // FIXME: HTTP server should bind to localhost if only loopback
       //        connections are allowed.
-      m_httpServer = new HttpServer(_T("0.0.0.0"), m_srvConfig->getHttpPort(), m_runAsService, &m_log);
+      // The WebSocket connections come to the rfb clients through the
+      // HTTP port, and the HTTP requests share the engine of the clients.
+      m_httpServer = new HttpServer(_T("0.0.0.0"), m_srvConfig->getHttpPort(), m_runAsService,
+                                    m_rfbClientManager->getIocpEngine(),
+                                    m_rfbClientManager, &m_log);
     } catch (Exception &ex) {
       m_log.error(_T("Failed to start HTTP server: \"%s\""), ex.getMessage());
     }
@@ -445,4 +554,21 @@ void TvnServer::changeLogProps()
     logLevel = m_srvConfig->getLogLevel();
   }
   m_logInitListener->onChangeLogProps(logDir.getString(), logLevel);
+  m_stallWatchdog.setDumpDir(logDir.getString());
+  LockProfiler::setEnabled(logLevel >= LogWriter::LOG_DEBUG);
+}
+
+void TvnServer::logLockContentions()
+{
+  std::vector<LockContention> contentions;
+  LockProfiler::getContentions(&contentions);
+  for (size_t i = 0; i < contentions.size(); i++) {
+    LockContention *contention = &contentions[i];
+    m_log.info(_T("Lock %s: %I64u contended acquisitions, waited %I64u us")
+               _T(" in total, %I64u us at most"),
+               contention->lockName.getString(),
+               contention->contentions,
+               contention->totalWaitTime,
+               contention->maxWaitTime);
+  }
 }
@@ -29,10 +29,13 @@
 
 #include "desktop/WinServiceDesktopFactory.h"
 #include "desktop/ApplicationDesktopFactory.h"
+#include "RelayDesktopFactory.h"
 #include "RfbClientManager.h"
 #include "RfbServer.h"
 #include "ExtraRfbServers.h"
 #include "ControlServer.h"
+#include "MemoryReporter.h"
+#include "SecondaryServerStarter.h"
 #include "TvnServerListener.h"
 
 #include "http-server-lib/HttpServer.h"
@@ -40,6 +43,8 @@
 #include "thread/ZombieKiller.h"
 #include "thread/LocalMutex.h"
 #include "log-writer/LogWriter.h"
+#include "log-writer/ZoneReporter.h"
+#include "log-writer/StallWatchdog.h"
 #include "util/Singleton.h"
 #include "util/ListenerContainer.h"
 #include "NewConnectionEvents.h"
@@ -73,7 +78,8 @@ public:
    *  1) Instanizes zombie killer.
    *  2) Instanizes configurator and load configuration.
    *  3) Instanizes log.
-   *  4) Starts all servers.
+   *  4) Starts the rfb servers, then the http and control servers in a
+   *     separate thread.
    *
    * @param runsInServiceContext must be set to true if TvnServer is running in service context,
    * false, if in context of single application. Parameter determinates control client behavour and
@@ -142,6 +148,16 @@ public:
   virtual void afterLastClientDisconnect();
 
 protected:
+  friend class SecondaryServerStarter;
+
+  // Starts the http and control servers, called by m_secondaryStarter.
+  void startSecondaryServers();
+
+  // Appends the time since *phaseStart to the startup timeline and moves
+  // *phaseStart to the current time.
+  static void addStartupPhase(StringStorage *timeline, const TCHAR *name,
+                              DWORD *phaseStart);
+
   void restartHttpServer();
   void restartControlServer();
   void restartMainRfbServer();
@@ -153,6 +169,9 @@ protected:
   // Calls a callback function to change update log properties.
   void changeLogProps();
 
+  // Writes the counters of the lock profiler to the log.
+  void logLockContentions();
+
 protected:
   LogWriter m_log;
   ZombieKiller m_zombieKiller;
@@ -176,6 +195,7 @@ protected:
 
   WinServiceDesktopFactory m_serviceDesktopFactory;
   ApplicationDesktopFactory m_applicationDesktopFactory;
+  RelayDesktopFactory m_relayDesktopFactory;
   /**
    * Rfb client manager (for all rfb servers), used by rfb servers
    * rfb clients, control server and control clients.
@@ -208,6 +228,16 @@ protected:
   LogInitListener *m_logInitListener;
 
   UINT m_contextSwitchResolution; // in ms
+
+  // GetTickCount() at the beginning of the constructor.
+  DWORD m_startTime;
+  SecondaryServerStarter *m_secondaryStarter;
+
+  // The last report is written after the destructor has deleted the
+  // servers and the clients, so it shows what they have left.
+  MemoryReporter m_memoryReporter;
+  ZoneReporter m_zoneReporter;
+  StallWatchdog m_stallWatchdog;
 };
 
 #endif
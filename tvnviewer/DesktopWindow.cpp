@@ -31,10 +31,15 @@
 #endif
 
 #include "DesktopWindow.h"
+#include "region/Region.h"
+#include "log-writer/ZoneProfiler.h"
+#include "log-writer/StallWatchdog.h"
 
 DesktopWindow::DesktopWindow(LogWriter *logWriter, ConnectionConfig *conConf)
 : m_logWriter(logWriter),
   m_clipboard(0),
+  m_isRendering(false),
+  m_hasRenderedText(false),
   m_showVert(false),
   m_showHorz(false),
   m_fbWidth(1),
@@ -82,11 +87,17 @@ void DesktopWindow::onPaint(DeviceContext *dc, PAINTSTRUCT *paintStruct)
       AutoLock al(&m_bufferLock);
       m_framebuffer.setTargetDC(paintStruct->hdc);
       if (!m_clientArea.isEmpty()) {
-        doDraw(dc);
+        ZoneProfiler::Scope presentZone(ZoneProfiler::PRESENT);
+        StallWatchdog::Activity presentActivity(StallWatchdog::PRESENT);
+        doDraw(dc, paintStruct);
       }
     } catch (const Exception &ex) {
       m_logWriter->error(_T("Error in onPaint: %s"), ex.getMessage());
     }
+    // The drawing has ended (EndDraw() with Direct2D), the frame is shown.
+    if (m_viewerCore != 0) {
+      m_viewerCore->onFramePresented();
+    }
   }
 }
 
@@ -109,6 +120,11 @@ bool DesktopWindow::onMessage(UINT message, WPARAM wParam, LPARAM lParam)
         SendMessage(m_hwndNextViewer, message, wParam, lParam);
       }
       return true;
+    case WM_RENDERFORMAT:
+      return onRenderClipboard();
+    case WM_RENDERALLFORMATS:
+      // The offered clipboard is lost with the connection.
+      return true;
     case WM_DRAWCLIPBOARD:
     {
       bool ok = onDrawClipboard();
@@ -325,6 +341,14 @@ bool DesktopWindow::onDrawClipboard()
   if (!IsWindowVisible(getHWnd()) || !m_conConf->isClipboardEnabled()) {
     return false;
   }
+  // The clipboard offered by the server is announced without the text, it
+  // must not be fetched only to be sent back.
+  if (GetClipboardOwner() == getHWnd()) {
+    AutoLock al(&m_renderLock);
+    if (m_strClipboard.isEmpty()) {
+      return true;
+    }
+  }
   StringStorage clipboardString;
   if (m_clipboard.getString(&clipboardString)) {
 
@@ -341,13 +365,74 @@ bool DesktopWindow::onDrawClipboard()
 
 void DesktopWindow::setClipboardData(const StringStorage * strText)
 {
+  {
+    AutoLock al(&m_renderLock);
+    if (m_isRendering) {
+      m_renderedText = *strText;
+      m_hasRenderedText = true;
+      m_renderEvent.notify();
+      return;
+    }
+  }
   if (m_conConf->isClipboardEnabled()) {
     m_clipboard.setString(strText);
     m_strClipboard.setString(strText->getString());
   }
 }
 
-void DesktopWindow::doDraw(DeviceContext *dc)
+bool DesktopWindow::setClipboardOffer()
+{
+  if (!m_conConf->isClipboardEnabled()) {
+    return false;
+  }
+  AutoLock al(&m_renderLock);
+  if (!m_clipboard.setDelayedString()) {
+    return true;
+  }
+  m_strClipboard = _T("");
+  return false;
+}
+
+bool DesktopWindow::onRenderClipboard()
+{
+  {
+    AutoLock al(&m_renderLock);
+    m_isRendering = true;
+    m_hasRenderedText = false;
+  }
+  bool requested = false;
+  try {
+    requested = m_viewerCore != 0 && m_viewerCore->requestCutText();
+  } catch (const Exception &exception) {
+    m_logWriter->detail(_T("Error in DesktopWindow::onRenderClipboard(): %s"),
+                        exception.getMessage());
+  }
+
+  // The text comes to setClipboardData() from the thread of the viewer
+  // core. A notification left from a previous timeout is skipped.
+  DWORD start = GetTickCount();
+  DWORD elapsed = 0;
+  while (requested && elapsed < RENDER_TIMEOUT) {
+    m_renderEvent.waitForEvent(RENDER_TIMEOUT - elapsed);
+    AutoLock al(&m_renderLock);
+    if (m_hasRenderedText) {
+      break;
+    }
+    elapsed = GetTickCount() - start;
+  }
+
+  AutoLock al(&m_renderLock);
+  m_isRendering = false;
+  if (!m_hasRenderedText) {
+    m_logWriter->detail(_T("The offered clipboard has not been received"));
+    return true;
+  }
+  m_clipboard.renderString(&m_renderedText);
+  m_strClipboard = m_renderedText;
+  return true;
+}
+
+void DesktopWindow::doDraw(DeviceContext *dc, const PAINTSTRUCT *paintStruct)
 {
   AutoLock al(&m_bufferLock);
   int fbWidth  = m_framebuffer.getDimension().width;
@@ -394,7 +479,7 @@ void DesktopWindow::doDraw(DeviceContext *dc)
     drawBackground(dc, &m_clientArea.toWindowsRect(), &dst.toWindowsRect());
   }
 
-  drawImage(&src.toWindowsRect(), &dst.toWindowsRect());
+  drawImage(&src.toWindowsRect(), &dst.toWindowsRect(), paintStruct);
 }
 
 void DesktopWindow::applyScrollbarChanges(bool isChanged, bool isVert, bool isHorz, int wndWidth, int wndHeight)
@@ -502,7 +587,8 @@ void DesktopWindow::calcClientArea() {
   }
 }
 
-void DesktopWindow::drawImage(const RECT *src, const RECT *dst)
+void DesktopWindow::drawImage(const RECT *src, const RECT *dst,
+                              const PAINTSTRUCT *paintStruct)
 {
   // Add debug logging to trace drawing
   LOG_DW("drawImage: src=(%d,%d,%d,%d), dst=(%d,%d,%d,%d)", 
@@ -513,7 +599,25 @@ void DesktopWindow::drawImage(const RECT *src, const RECT *dst)
   Rect rc_dest(dst);
 
   AutoLock al(&m_bufferLock);
-  
+
+  // GDI draws to the paint DC, clipped by the update region. At 1:1, only
+  // the bounds of the region are set from the bits.
+  if (m_framebuffer.getRenderMode() == RENDER_MODE_GDI) {
+    if (rc_src.getWidth() == rc_dest.getWidth() &&
+        rc_src.getHeight() == rc_dest.getHeight()) {
+      Rect paintRect(&paintStruct->rcPaint);
+      paintRect = paintRect.intersection(&rc_dest);
+      if (!paintRect.isEmpty()) {
+        Rect srcPaint = paintRect;
+        srcPaint.move(rc_src.left - rc_dest.left, rc_src.top - rc_dest.top);
+        m_framebuffer.drawToDC(paintStruct->hdc, &paintRect, &srcPaint);
+      }
+    } else {
+      m_framebuffer.drawToDC(paintStruct->hdc, &rc_dest, &rc_src);
+    }
+    return;
+  }
+
   if ((src->right - src->left) == (dst->right - dst->left) &&
      (src->bottom - src->top) == (dst->bottom - dst->top) &&
      src->left == dst->left &&
@@ -566,6 +670,93 @@ void DesktopWindow::updateFramebuffer(const FrameBuffer *framebuffer,
   repaint(dstRect);
 }
 
+void DesktopWindow::updateFramebuffer(const FrameBuffer *framebuffer,
+                                      const std::vector<Rect> *dstRects)
+{
+  LOG_DW("updateFramebuffer: %u rects", (unsigned int)dstRects->size());
+
+  // Copy everything first, so that the window is painted once for the
+  // whole update. In Direct2D mode, the pixels go straight from the core's
+  // frame buffer to the bitmap. That must be done now, while the cursor is
+  // painted on it, and under the lock to be serialized with drawing.
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = dstRects->begin(); iRect != dstRects->end(); iRect++) {
+    const Rect *dstRect = &(*iRect);
+    {
+      AutoLock al(&m_bufferLock);
+      if (m_framebuffer.uploadFrom(dstRect, framebuffer)) {
+        continue;
+      }
+    }
+    if (!m_framebuffer.copyFrom(dstRect, framebuffer, dstRect->left, dstRect->top)) {
+      m_logWriter->error(_T("Possible invalide region. (%d, %d), (%d, %d)"),
+                         dstRect->left, dstRect->top, dstRect->right, dstRect->bottom);
+      m_logWriter->interror(_T("Error in updateFramebuffer (ViewerWindow)"));
+    }
+  }
+  repaint(dstRects);
+}
+
+bool DesktopWindow::copyFramebuffer(const Rect *dstRect, int srcX, int srcY)
+{
+  LOG_DW("copyFramebuffer: rect=(%d,%d,%d,%d) from (%d,%d)",
+          dstRect->left, dstRect->top, dstRect->right, dstRect->bottom,
+          srcX, srcY);
+  {
+    // Serialized with drawing the same way as uploads.
+    AutoLock al(&m_bufferLock);
+    if (!m_framebuffer.moveShown(dstRect, srcX, srcY)) {
+      return false;
+    }
+  }
+  repaint(dstRect);
+  return true;
+}
+
+bool DesktopWindow::setOverlay(const FrameBuffer *image, const Rect *rect)
+{
+  // Serialized with drawing the same way as uploads.
+  AutoLock al(&m_bufferLock);
+  return m_framebuffer.setOverlay(WATERMARK_LAYER, image, rect);
+}
+
+bool DesktopWindow::setCursorOverlay(const FrameBuffer *image, const Rect *rect,
+                                     bool imageChanged)
+{
+  Rect oldRect;
+  {
+    AutoLock al(&m_bufferLock);
+    if (m_framebuffer.getRenderMode() != RENDER_MODE_DIRECT2D) {
+      m_cursorRect.clear();
+      return false;
+    }
+    if (rect->isEmpty()) {
+      m_framebuffer.clearOverlay(CURSOR_LAYER);
+    } else if (imageChanged ||
+               !m_framebuffer.moveOverlay(CURSOR_LAYER, rect->left, rect->top)) {
+      // The layer may also be lost with the bitmap on resizing.
+      m_framebuffer.clearOverlay(CURSOR_LAYER);
+      if (!m_framebuffer.setOverlay(CURSOR_LAYER, image, rect)) {
+        m_cursorRect.clear();
+        return false;
+      }
+    }
+    oldRect = m_cursorRect;
+    m_cursorRect = *rect;
+  }
+  if (!oldRect.isEqualTo(rect)) {
+    if (!oldRect.isEmpty()) {
+      repaint(&oldRect);
+    }
+    if (!rect->isEmpty()) {
+      repaint(rect);
+    }
+  } else if (imageChanged && !rect->isEmpty()) {
+    repaint(rect);
+  }
+  return true;
+}
+
 void DesktopWindow::setNewFramebuffer(const FrameBuffer *framebuffer)
 {
   Dimension dimension = framebuffer->getDimension();
@@ -606,11 +797,63 @@ void DesktopWindow::setNewFramebuffer(const FrameBuffer *framebuffer)
 
 void DesktopWindow::repaint(const Rect *repaintRect)
 {
-  if (!repaintRect) {
+  Rect wnd;
+  if (!repaintRect || !getRepaintRect(repaintRect, &wnd)) {
     m_isBackgroundDirty = false;
     redraw();
     return;
   }
+  redraw(&wnd.toWindowsRect());
+}
+
+void DesktopWindow::repaint(const std::vector<Rect> *repaintRects)
+{
+  if (repaintRects->size() == 1) {
+    repaint(&repaintRects->front());
+    return;
+  }
+  Region region;
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = repaintRects->begin(); iRect != repaintRects->end(); iRect++) {
+    Rect wnd;
+    if (!getRepaintRect(&(*iRect), &wnd)) {
+      m_isBackgroundDirty = false;
+      redraw();
+      return;
+    }
+    region.addRect(&wnd);
+  }
+  if (region.isEmpty()) {
+    return;
+  }
+
+  // One call for the whole region.
+  std::vector<RECT> rects;
+  std::vector<Rect> wndRects;
+  region.getRectVector(&wndRects);
+  for (iRect = wndRects.begin(); iRect != wndRects.end(); iRect++) {
+    rects.push_back(iRect->toWindowsRect());
+  }
+  std::vector<char> data(sizeof(RGNDATAHEADER) + rects.size() * sizeof(RECT));
+  RGNDATA *rgnData = reinterpret_cast<RGNDATA *>(&data.front());
+  rgnData->rdh.dwSize = sizeof(RGNDATAHEADER);
+  rgnData->rdh.iType = RDH_RECTANGLES;
+  rgnData->rdh.nCount = (DWORD)rects.size();
+  rgnData->rdh.nRgnSize = (DWORD)(rects.size() * sizeof(RECT));
+  rgnData->rdh.rcBound = region.getBounds().toWindowsRect();
+  memcpy(rgnData->Buffer, &rects.front(), rects.size() * sizeof(RECT));
+  HRGN rgn = ExtCreateRegion(0, (DWORD)data.size(), rgnData);
+  if (rgn == 0) {
+    Rect bounds = region.getBounds();
+    redraw(&bounds.toWindowsRect());
+    return;
+  }
+  InvalidateRgn(getHWnd(), rgn, FALSE);
+  DeleteObject(rgn);
+}
+
+bool DesktopWindow::getRepaintRect(const Rect *repaintRect, Rect *wnd)
+{
   Rect rect;
   m_scManager.getSourceRect(&rect);
   Rect paint = repaintRect;
@@ -618,27 +861,24 @@ void DesktopWindow::repaint(const Rect *repaintRect)
 
   // checks what we getted a valid rectangle
   if (paint.getWidth() <= 1 || paint.getHeight() <= 1 || m_isBackgroundDirty) {
-    m_isBackgroundDirty = false;
-    redraw();
-    return;
+    return false;
   }
-  Rect wnd;
-  m_scManager.getWndFromScreen(&paint, &wnd);
+  m_scManager.getWndFromScreen(&paint, wnd);
   m_scManager.getDestinationRect(&rect);
-  if (wnd.left) {
-    --wnd.left;
+  if (wnd->left) {
+    --wnd->left;
   }
-  if (wnd.top) {
-    --wnd.top;
+  if (wnd->top) {
+    --wnd->top;
   }
-  if (wnd.right < rect.right) {
-    ++wnd.right;
+  if (wnd->right < rect.right) {
+    ++wnd->right;
   }
-  if (wnd.bottom < rect.bottom) {
-    ++wnd.bottom;
+  if (wnd->bottom < rect.bottom) {
+    ++wnd->bottom;
   }
-  wnd.intersection(&rect);
-  redraw(&wnd.toWindowsRect());
+  wnd->intersection(&rect);
+  return true;
 }
 
 void DesktopWindow::setScale(int scale)
@@ -792,6 +1032,12 @@ void DesktopWindow::sendCutTextEvent(const StringStorage *cutText)
   }
 }
 
+void DesktopWindow::setQualityScaling(bool enabled)
+{
+  AutoLock al(&m_bufferLock);
+  m_framebuffer.setQualityScaling(enabled);
+}
+
 bool DesktopWindow::setRenderMode(RenderMode mode)
 {
   // Add debug logging
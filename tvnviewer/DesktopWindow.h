@@ -38,6 +38,8 @@
 #include "rfb/RfbKeySym.h"
 #include "viewer-core/RemoteViewerCore.h"
 #include "win-system/RenderManager.h"
+#include "win-system/WindowsEvent.h"
+#include "thread/LocalMutex.h"
 
 class DesktopWindow : public PaintWindow,
                       protected RfbKeySymListener
@@ -47,11 +49,34 @@ public:
   virtual ~DesktopWindow();
 
   void setClipboardData(const StringStorage *strText);
+  // Puts the clipboard offered by the server to the local clipboard without
+  // its contents, which are fetched when an application pastes it. Returns
+  // false if it has been done, true if the clipboard must be fetched at
+  // once.
+  bool setClipboardOffer();
   void updateFramebuffer(const FrameBuffer *framebuffer,
                          const Rect *dstRect);
+  // Copies all the rectangles and then repaints them together, as one
+  // region.
+  void updateFramebuffer(const FrameBuffer *framebuffer,
+                         const std::vector<Rect> *dstRects);
+  // Moves the rectangle of the shown image from (srcX, srcY) to dstRect
+  // (Direct2D only), like CopyRect did in the frame buffer of the core.
+  // Returns false if it cannot be done, then dstRect must be updated.
+  bool copyFramebuffer(const Rect *dstRect, int srcX, int srcY);
   // this function must be called if size of image was changed
   // or the number of bits per pixel
   void setNewFramebuffer(const FrameBuffer *framebuffer);
+  // Blends the image over the rectangle of the frame buffer on painting
+  // (Direct2D only). Returns false if it cannot be done, see
+  // DibFrameBuffer::setOverlay().
+  bool setOverlay(const FrameBuffer *image, const Rect *rect);
+  // Draws the cursor image over the frame buffer at the rectangle on
+  // painting (Direct2D only), an empty rectangle hides it. The image is
+  // uploaded again only if imageChanged is true. Returns false if it cannot
+  // be done, then the cursor must be painted into the frame buffer.
+  bool setCursorOverlay(const FrameBuffer *image, const Rect *rect,
+                        bool imageChanged);
 
   // set scale of image, can -1 = Auto, in percent
   void setScale(int scale);
@@ -84,6 +109,10 @@ public:
   // Set function for m_winKeyIgnore.
   void setWinKeyIgnore(bool winKeyIgnore) { m_rfbKeySym->setWinKeyIgnore(winKeyIgnore); }
 
+  // Sets the filtering of the scaled image in GDI mode (HALFTONE), off by
+  // default for speed.
+  void setQualityScaling(bool enabled);
+
   // NEW FUNCTION: Set rendering mode to GDI or Direct2D
   // Returns true if mode changed successfully, false otherwise
   bool setRenderMode(RenderMode mode);
@@ -108,6 +137,7 @@ protected:
   void onPaint(DeviceContext *dc, PAINTSTRUCT *paintStruct);
   bool onCreate(LPCREATESTRUCT pcs);
   bool onDrawClipboard();
+  bool onRenderClipboard();
   bool onEraseBackground(HDC hdc);
   bool onDeadChar(WPARAM wParam, LPARAM lParam);
   bool onHScroll(WPARAM wParam, LPARAM lParam);
@@ -162,12 +192,26 @@ protected:
   // This variable save server dimension.
   // Dimension of m_framebuffer can be large m_serverDimension.
   Dimension m_serverDimension;
+  // Overlay layers of m_framebuffer, the watermark is drawn over the cursor.
+  static const size_t CURSOR_LAYER = 0;
+  static const size_t WATERMARK_LAYER = 1;
+  // Place of the cursor overlay, to repaint it when the cursor moves.
+  Rect m_cursorRect;
 
   // clipboard
   WinClipboard m_clipboard;
   StringStorage m_strClipboard;
   HWND m_hwndNextViewer;
 
+  // The offered clipboard being fetched to render it.
+  LocalMutex m_renderLock;
+  WindowsEvent m_renderEvent;
+  bool m_isRendering;
+  bool m_hasRenderedText;
+  StringStorage m_renderedText;
+  // Time to wait for the offered clipboard, in milliseconds.
+  static const DWORD RENDER_TIMEOUT = 30000;
+
   bool m_ctrlDown;
   bool m_altDown;
 
@@ -176,11 +220,19 @@ protected:
   bool m_isBackgroundDirty;
 
 private:
-  void doDraw(DeviceContext *dc);
+  void doDraw(DeviceContext *dc, const PAINTSTRUCT *paintStruct);
   void scrollProcessing(int fbWidth, int fbHeight);
   void drawBackground(DeviceContext *dc, const RECT *rcMain, const RECT *rcImage);
-  void drawImage(const RECT *src, const RECT *dst);
+  // In GDI mode, draws only the painted part of the image, one blit for
+  // the whole update region.
+  void drawImage(const RECT *src, const RECT *dst, const PAINTSTRUCT *paintStruct);
   void repaint(const Rect *repaintRect);
+  // Invalidates the rectangles of the frame buffer as one region, so that
+  // they are painted together.
+  void repaint(const std::vector<Rect> *repaintRects);
+  // Sets wnd to the window rectangle to invalidate for the rectangle of the
+  // frame buffer. Returns false if the whole window must be redrawn.
+  bool getRepaintRect(const Rect *repaintRect, Rect *wnd);
   void calcClientArea();
 };
 
@@ -28,6 +28,7 @@
 #include "util/ResourceLoader.h"
 #include <crtdbg.h>
 #include <stdio.h>
+#include <algorithm>
 
 FileInfoListView::FileInfoListView()
 : m_smallImageList(0)
@@ -66,81 +67,166 @@ void FileInfoListView::setWindow(HWND hwnd)
 
 void FileInfoListView::addItem(int index, FileInfo *fileInfo)
 {
-  const TCHAR *filename = fileInfo->getFileName();
+  index = min(max(index, 0), (int)m_files.size());
 
-  int imageIndex = IMAGE_FILE_INDEX;
+  m_files.insert(m_files.begin() + index, fileInfo);
 
-  if (_tcscmp(fileInfo->getFileName(), _T("..")) == 0) {
-    imageIndex = IMAGE_FOLDER_UP_INDEX;
-  } else if (fileInfo->isDirectory()) {
-    imageIndex = IMAGE_FOLDER_INDEX;
-  }
+  updateItemCount();
+}
 
-  ListView::addItem(index, filename, (LPARAM)fileInfo, imageIndex);
+void FileInfoListView::addRange(FileInfo **filesInfo, size_t count)
+{
+  FileInfo *arr = *filesInfo;
 
-  StringStorage sizeString(_T("<Folder>"));
-  StringStorage modTimeString(_T(""));
+  m_files.reserve(m_files.size() + count);
+  for (size_t i = 0; i < count; i++) {
+    m_files.push_back(&arr[i]);
+  } // for all files info
 
-  if (!fileInfo->isDirectory()) {
-    //
-    // Prepare size string
-    //
+  // Folders are placed before files by sorting.
+  ListView::sort();
 
-    UINT64 fileSize = fileInfo->getSize();
+  updateItemCount();
+} // void
 
-    if (fileSize <= 1024) {
-      sizeString.format(_T("%ld B"), fileSize);
-    } else if ((fileSize > 1024) && (fileSize <= 1024 * 1024)) {
-      sizeString.format(_T("%4.2f KB"), static_cast<double>(fileSize) / 1024.0);
-    } else if (fileSize > 1024 * 1024) {
-      sizeString.format(_T("%4.2f MB"), static_cast<double>(fileSize) / (1024.0 * 1024));
-    }
+void FileInfoListView::clear()
+{
+  m_files.clear();
+
+  ListView::clear();
+}
+
+FileInfo *FileInfoListView::getFileInfo(int index)
+{
+  if (index < 0 || index >= (int)m_files.size()) {
+    return NULL;
+  }
+  return m_files[index];
+}
 
-    //
-    // Prepare modification time string
-    //
+FileInfo *FileInfoListView::getSelectedFileInfo()
+{
+  return getFileInfo(getSelectedIndex());
+}
 
-    DateTime dateTime(fileInfo->lastModified());
+void FileInfoListView::onGetDispInfo(NMLVDISPINFO *dispInfo)
+{
+  LVITEM *item = &dispInfo->item;
+
+  FileInfo *fileInfo = getFileInfo(item->iItem);
+  if (fileInfo == NULL) {
+    return;
+  }
 
-    dateTime.toString(&modTimeString);
+  if ((item->mask & LVIF_IMAGE) != 0) {
+    item->iImage = getImageIndex(fileInfo);
   }
 
-  ListView::setSubItemText(index, 1, sizeString.getString());
-  ListView::setSubItemText(index, 2, modTimeString.getString());
+  if ((item->mask & LVIF_TEXT) != 0 && item->cchTextMax > 0) {
+    StringStorage text;
+    getItemText(fileInfo, item->iSubItem, &text);
+    _tcsncpy_s(item->pszText, item->cchTextMax, text.getString(), _TRUNCATE);
+  }
 }
 
-void FileInfoListView::addRange(FileInfo **filesInfo, size_t count)
+int FileInfoListView::onFindItem(NMLVFINDITEM *findItem)
 {
-  int index = max(0, (getCount() - 1));
-  size_t i = 0;
-  FileInfo *arr = *filesInfo;
+  LVFINDINFO *findInfo = &findItem->lvfi;
 
-  // Add folders first
-  for (i = 0; i < count; i++) {
-    FileInfo *fi = &arr[i];
-    if (fi->isDirectory()) {
-      addItem(index++, fi);
-    } // if directory
-  } // for all files info
+  if ((findInfo->flags & LVFI_STRING) == 0) {
+    return -1;
+  }
 
-  // Add files
-  for (i = 0; i < count; i++) {
-    FileInfo *fi = &arr[i];
-    if (!fi->isDirectory()) {
-      addItem(index++, fi);
-    } // if not directory
-  } // for all files info
+  bool partial = (findInfo->flags & LVFI_PARTIAL) != 0;
+  size_t length = _tcslen(findInfo->psz);
+  int count = (int)m_files.size();
 
-  ListView::sort();
-} // void
+  // Search from the start item to the end and then from the beginning.
+  for (int i = 0; i < count; i++) {
+    int index = (max(findItem->iStart, 0) + i) % count;
+    const TCHAR *fileName = m_files[index]->getFileName();
 
-FileInfo *FileInfoListView::getSelectedFileInfo()
+    int result = partial ? _tcsnicmp(fileName, findInfo->psz, length)
+                         : _tcsicmp(fileName, findInfo->psz);
+    if (result == 0) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+void FileInfoListView::sortItems(PFNLVCOMPARE compareItem, LPARAM lParamSort)
 {
-  int si = getSelectedIndex();
-  if (si == -1) {
-    return NULL;
+  std::sort(m_files.begin(), m_files.end(),
+            ItemComparator(compareItem, lParamSort));
+
+  if (m_hwnd != NULL) {
+    // Selection is kept by indexes, it has no sense after reordering.
+    ListView_SetItemState(m_hwnd, -1, 0, LVIS_SELECTED | LVIS_FOCUSED);
+    InvalidateRect(m_hwnd, NULL, FALSE);
+  }
+}
+
+void FileInfoListView::updateItemCount()
+{
+  ListView_SetItemCountEx(m_hwnd, (int)m_files.size(), LVSICF_NOSCROLL);
+}
+
+int FileInfoListView::getImageIndex(const FileInfo *fileInfo)
+{
+  if (_tcscmp(fileInfo->getFileName(), _T("..")) == 0) {
+    return IMAGE_FOLDER_UP_INDEX;
+  } else if (fileInfo->isDirectory()) {
+    return IMAGE_FOLDER_INDEX;
+  }
+  return IMAGE_FILE_INDEX;
+}
+
+void FileInfoListView::getItemText(const FileInfo *fileInfo, int subItem,
+                                   StringStorage *out)
+{
+  switch (subItem) {
+  case 0:
+    out->setString(fileInfo->getFileName());
+    break;
+  case 1:
+    {
+      if (fileInfo->isDirectory()) {
+        out->setString(_T("<Folder>"));
+        break;
+      }
+
+      //
+      // Prepare size string
+      //
+
+      UINT64 fileSize = fileInfo->getSize();
+
+      if (fileSize <= 1024) {
+        out->format(_T("%ld B"), fileSize);
+      } else if ((fileSize > 1024) && (fileSize <= 1024 * 1024)) {
+        out->format(_T("%4.2f KB"), static_cast<double>(fileSize) / 1024.0);
+      } else if (fileSize > 1024 * 1024) {
+        out->format(_T("%4.2f MB"), static_cast<double>(fileSize) / (1024.0 * 1024));
+      }
+    }
+    break;
+  case 2:
+    if (fileInfo->isDirectory()) {
+      out->setString(_T(""));
+    } else {
+      //
+      // Prepare modification time string
+      //
+
+      DateTime dateTime(fileInfo->lastModified());
+
+      dateTime.toString(out);
+    }
+    break;
+  default:
+    out->setString(_T(""));
   }
-  return reinterpret_cast<FileInfo *>(getSelectedItem().tag);
 }
 
 void FileInfoListView::loadImages()
@@ -28,6 +28,17 @@
 #include "gui/ListView.h"
 #include "ft-common/FileInfo.h"
 
+#include <vector>
+
+//
+// Virtual (LVS_OWNERDATA) list view of files info. List view control
+// keeps no copies of items, it only asks the texts of the visible ones,
+// so folders with many thousands of files are shown and sorted quickly.
+//
+// Files info objects are not owned by list view and must stay alive
+// until the list is cleared.
+//
+
 class FileInfoListView : public ListView
 {
 public:
@@ -48,6 +59,19 @@ public:
 
   void addRange(FileInfo **filesInfo, size_t count);
 
+  //
+  // Removes all items from list view
+  //
+
+  void clear();
+
+  //
+  // Returns file info notated by list view item with specified index,
+  // or NULL if there is no such item.
+  //
+
+  FileInfo *getFileInfo(int index);
+
   //
   // Returns file info notated by first selected list view item
   //
@@ -55,8 +79,47 @@ public:
   FileInfo *getSelectedFileInfo();
 
   void sort(int columnIndex);
+
+  //
+  // Handler of LVN_GETDISPINFO notification, fills text and image
+  // of requested item.
+  //
+
+  void onGetDispInfo(NMLVDISPINFO *dispInfo);
+
+  //
+  // Handler of LVN_ODFINDITEM notification (searching item by typed
+  // file name), returns index of found item or -1.
+  //
+
+  int onFindItem(NMLVFINDITEM *findItem);
+
 protected:
 
+  //
+  // Inherited from ListView.
+  //
+
+  virtual void sortItems(PFNLVCOMPARE compareItem, LPARAM lParamSort);
+
+  //
+  // Tells count of items to list view control.
+  //
+
+  void updateItemCount();
+
+  //
+  // Returns index of item icon in image list.
+  //
+
+  int getImageIndex(const FileInfo *fileInfo);
+
+  //
+  // Sets text of specified column of file info to out.
+  //
+
+  void getItemText(const FileInfo *fileInfo, int subItem, StringStorage *out);
+
   //
   // Loads file list view icons from application resources
   //
@@ -78,7 +141,30 @@ protected:
 
   HIMAGELIST m_smallImageList;
 
+  // Items of the list in display order.
+  std::vector<FileInfo *> m_files;
+
 private:
+  //
+  // Adapter of list view compare function to std::sort.
+  //
+  class ItemComparator
+  {
+  public:
+    ItemComparator(PFNLVCOMPARE compareItem, LPARAM lParamSort)
+    : m_compareItem(compareItem), m_lParamSort(lParamSort) { }
+
+    bool operator()(FileInfo *first, FileInfo *second) const
+    {
+      return first != second &&
+             m_compareItem((LPARAM)first, (LPARAM)second, m_lParamSort) < 0;
+    }
+
+  private:
+    PFNLVCOMPARE m_compareItem;
+    LPARAM m_lParamSort;
+  };
+
   static LRESULT CALLBACK s_newWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
   static const int IMAGE_FOLDER_UP_INDEX = 0;
@@ -98,6 +98,13 @@ BOOL FileTransferMainDialog::onNotify(UINT controlID, LPARAM data)
   switch (controlID) {
   case IDC_REMOTE_FILE_LIST:
     switch (nmhdr->code) {
+    case LVN_GETDISPINFO:
+      m_remoteFileListView.onGetDispInfo(reinterpret_cast<NMLVDISPINFO *>(data));
+      return TRUE;
+    case LVN_ODFINDITEM:
+      SetWindowLongPtr(m_ctrlThis.getWindow(), DWLP_MSGRESULT,
+                       m_remoteFileListView.onFindItem(reinterpret_cast<NMLVFINDITEM *>(data)));
+      return TRUE;
     case NM_DBLCLK:
       onRemoteListViewDoubleClick();
       break;
@@ -125,6 +132,13 @@ BOOL FileTransferMainDialog::onNotify(UINT controlID, LPARAM data)
     break;
   case IDC_LOCAL_FILE_LIST:
     switch (nmhdr->code) {
+    case LVN_GETDISPINFO:
+      m_localFileListView.onGetDispInfo(reinterpret_cast<NMLVDISPINFO *>(data));
+      return TRUE;
+    case LVN_ODFINDITEM:
+      SetWindowLongPtr(m_ctrlThis.getWindow(), DWLP_MSGRESULT,
+                       m_localFileListView.onFindItem(reinterpret_cast<NMLVFINDITEM *>(data)));
+      return TRUE;
     case NM_DBLCLK:
       onLocalListViewDoubleClick();
       break;
@@ -205,6 +219,9 @@ BOOL FileTransferMainDialog::onDestroy()
 void FileTransferMainDialog::onMessageReceived(UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
   switch (uMsg) {
+  case WM_FILE_LIST_PAGE:
+    onRemoteFileListPage();
+    break;
   case WM_OPERATION_FINISHED:
     m_ftCore->onOperationFinished();
 
@@ -213,6 +230,12 @@ void FileTransferMainDialog::onMessageReceived(UINT uMsg, WPARAM wParam, LPARAM
       int result = static_cast<int>(lParam);
       m_ftCore->onUpdateState(state, result);
 
+      // The list failed after some pages were shown.
+      if (!m_remoteFilesPages.empty()) {
+        m_remoteFileListView.clear();
+        m_remoteFilesPages.clear();
+      }
+
       setProgress(0.0);
       enableControls(true);
       break;
@@ -326,7 +349,7 @@ void FileTransferMainDialog::onRemoveRemoteButtonClick()
 
   m_remoteFileListView.getSelectedItemsIndexes(indexes);
   for (unsigned int i = 0; i < siCount; i++) {
-    FileInfo *fileInfo = reinterpret_cast<FileInfo *>(m_remoteFileListView.getItemData(indexes[i]));
+    FileInfo *fileInfo = m_remoteFileListView.getFileInfo(indexes[i]);
     filesInfo[i] = *fileInfo;
   }
 
@@ -475,7 +498,7 @@ void FileTransferMainDialog::onRemoveLocalButtonClick()
 
   m_localFileListView.getSelectedItemsIndexes(indexes);
   for (unsigned int i = 0; i < siCount; i++) {
-    FileInfo *fileInfo = reinterpret_cast<FileInfo *>(m_localFileListView.getItemData(indexes[i]));
+    FileInfo *fileInfo = m_localFileListView.getFileInfo(indexes[i]);
     filesInfo[i] = *fileInfo;
   }
 
@@ -519,7 +542,7 @@ void FileTransferMainDialog::onUploadButtonClick()
 
   m_localFileListView.getSelectedItemsIndexes(indexes);
   for (unsigned int i = 0; i < siCount; i++) {
-    FileInfo *fileInfo = reinterpret_cast<FileInfo *>(m_localFileListView.getItemData(indexes[i]));
+    FileInfo *fileInfo = m_localFileListView.getFileInfo(indexes[i]);
     filesInfo[i] = *fileInfo;
   }
 
@@ -564,7 +587,7 @@ void FileTransferMainDialog::onDownloadButtonClick()
 
   m_remoteFileListView.getSelectedItemsIndexes(indexes);
   for (unsigned int i = 0; i < siCount; i++) {
-    FileInfo *fileInfo = reinterpret_cast<FileInfo *>(m_remoteFileListView.getItemData(indexes[i]));
+    FileInfo *fileInfo = m_remoteFileListView.getFileInfo(indexes[i]);
     filesInfo[i] = *fileInfo;
   }
 
@@ -941,6 +964,9 @@ void FileTransferMainDialog::setNothingState()
   if (!isRoot) {
     m_remoteFileListView.addItem(0, m_fakeMoveUpFolder);
   }
+
+  // Whole list is shown, pages are not needed anymore.
+  m_remoteFilesPages.clear();
 }
 
 void FileTransferMainDialog::onFtOpError(const TCHAR *message)
@@ -963,6 +989,31 @@ void FileTransferMainDialog::onFtOpFinished(int state, int result)
   PostMessage(m_ctrlThis.getWindow(), WM_OPERATION_FINISHED, state, result);
 }
 
+void FileTransferMainDialog::onFtFileListPage()
+{
+  PostMessage(m_ctrlThis.getWindow(), WM_FILE_LIST_PAGE, 0, 0);
+}
+
+void FileTransferMainDialog::onRemoteFileListPage()
+{
+  vector<FileInfo> page;
+  m_ftCore->takeRemoteFileListPage(&page);
+  if (page.empty()) {
+    return;
+  }
+
+  // First page of new list replaces the shown list.
+  if (m_remoteFilesPages.empty()) {
+    m_remoteFileListView.clear();
+  }
+
+  m_remoteFilesPages.push_back(vector<FileInfo>());
+  m_remoteFilesPages.back().swap(page);
+
+  FileInfo *filesInfo = &m_remoteFilesPages.back().front();
+  m_remoteFileListView.addRange(&filesInfo, m_remoteFilesPages.back().size());
+}
+
 void FileTransferMainDialog::onRefreshLocalFileList()
 {
   refreshLocalFileList();
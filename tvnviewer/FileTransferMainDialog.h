@@ -42,6 +42,7 @@
 #include "ft-client-lib/FileTransferInterface.h"
 
 #include <vector>
+#include <list>
 
 using namespace std;
 
@@ -70,6 +71,7 @@ public:
   void onFtOpInfo(const TCHAR *message);
   void onFtOpStarted();
   void onFtOpFinished(int state, int result);
+  void onFtFileListPage();
 
   //
   // filetransfer's operation is finished. Need update of control
@@ -136,6 +138,13 @@ protected:
   void onRemoteListViewKeyDown(UINT key);
   void onLocalListViewKeyDown(UINT key);
 
+  //
+  // Shows the received pages of remote file list before the whole
+  // list is received.
+  //
+
+  void onRemoteFileListPage();
+
   //
   // Enables or disables rename and delete buttons
   // depending of file list views selected items count.
@@ -276,9 +285,18 @@ protected:
 
   FileInfo *m_fakeMoveUpFolder;
 
+  //
+  // Pages of remote file list shown in remote list view while the list
+  // is receiving. Every page is kept in its own vector, so the files
+  // are not moved when next pages come.
+  //
+
+  list<vector<FileInfo> > m_remoteFilesPages;
+
 private:
 
   static const UINT WM_OPERATION_FINISHED = WM_USER + 2;
+  static const UINT WM_FILE_LIST_PAGE = WM_USER + 3;
 };
 
 #endif
@@ -34,8 +34,14 @@ TvnViewer::TvnViewer(HINSTANCE appInstance, const TCHAR *windowClassName,
   m_conListener(0),
   m_hAccelTable(0),
   m_logWriter(ViewerConfig::getInstance()->getLogger()),
+  m_zoneReporter(&m_logWriter),
+  m_stallWatchdog(&m_logWriter),
   m_isListening(false)
 {
+  StringStorage logDir;
+  ViewerConfig::getInstance()->getLogDir(&logDir);
+  m_stallWatchdog.setDumpDir(logDir.getString());
+
   m_logWriter.info(_T("Init WinSock 2.1"));
   WindowsSocket::startup(2, 1);
   registerViewerWindowClass();
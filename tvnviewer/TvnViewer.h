@@ -35,6 +35,8 @@
 #include "win-system/WindowsApplication.h"
 
 #include "log-writer/LogWriter.h"
+#include "log-writer/ZoneReporter.h"
+#include "log-writer/StallWatchdog.h"
 #include "thread/AutoLock.h"
 
 #include <map>
@@ -141,6 +143,8 @@ private:
   bool m_isListening;
   
   LogWriter m_logWriter;
+  ZoneReporter m_zoneReporter;
+  StallWatchdog m_stallWatchdog;
 
   AboutDialog m_aboutDialog;
   ConfigurationDialog m_configurationDialog;
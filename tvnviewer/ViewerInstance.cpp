@@ -107,6 +107,10 @@ void ViewerInstance::start()
 
   m_fileTransfer.addCapabilities(&m_viewerCore);
 
+  SocketProfile socketProfile;
+  m_conConf.getSocketProfile(&socketProfile);
+  m_viewerCore.setSocketProfile(&socketProfile);
+
   if (m_socket) {
     m_viewerCore.start(m_socket,
                        &m_viewerWnd, m_conConf.getSharedFlag());
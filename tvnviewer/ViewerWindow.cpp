@@ -25,6 +25,7 @@
 #include "config-lib/IniFileSettingsManager.h"
 #include "util/Exception.h"
 #include "util/ResourceLoader.h"
+#include "rfb/MsgDefs.h"
 #include "rfb/StandardPixelFormatFactory.h"
 
 #include "FsWarningDialog.h"
@@ -227,6 +228,7 @@ void ViewerWindow::applySettings()
     m_dsktWnd.setScale(m_scale);
     doSize();
   }
+  m_dsktWnd.setQualityScaling(ViewerConfig::getInstance()->isQualityScalingEnabled());
   if (m_isConnected) {
     if (m_conConf->isFullscreenEnabled()) {
       doFullScr();
@@ -399,6 +401,22 @@ void ViewerWindow::dialogConnectionInfo()
              geometry.getHeight(),
              pixelSize,
              &kbdName[0]);
+  // Latency percentiles of the updates presented so far, if the server
+  // sends the probes.
+  if (m_viewerCore->getLatencyReports() != 0) {
+    static const TCHAR *const stageNames[LatencyProbeDefs::STAGE_COUNT] = {
+      _T("Capture"), _T("Encode"), _T("Network"), _T("Decode"), _T("Present")
+    };
+    for (int stage = 0; stage < LatencyProbeDefs::STAGE_COUNT; stage++) {
+      StringStorage line;
+      line.format(StringTable::getString(IDS_CONNECTION_INFO_LATENCY_FORMAT),
+                  stageNames[stage],
+                  (unsigned int)m_viewerCore->getStageLatency(stage, 50),
+                  (unsigned int)m_viewerCore->getStageLatency(stage, 95),
+                  (unsigned int)m_viewerCore->getStageLatency(stage, 99));
+      str.appendString(line.getString());
+    }
+  }
   MessageBox(getHWnd(),
              str.getString(),
              StringTable::getString(IDS_CONNECTION_INFO_CAPTION),
@@ -958,6 +976,13 @@ bool ViewerWindow::onSize(WPARAM wParam, LPARAM lParam)
   RECT rc;
   int x, y;
 
+  // A minimized session costs nothing: the server is asked for the changes
+  // only when the window is restored. WM_SIZE is also posted by the viewer
+  // itself, so the state is checked instead of wParam.
+  if (m_viewerCore != 0) {
+    m_viewerCore->setHidden(IsIconic(getHWnd()) != FALSE);
+  }
+
   getClientRect(&rc);
   m_logWriter.debug(_T("client rect: %d, %d; %d, %d"),
                     rc.left, rc.top, rc.right, rc.bottom);
@@ -1136,6 +1161,12 @@ void ViewerWindow::onConnected(RfbOutputGate *output)
   applySettings();
 }
 
+void ViewerWindow::onBulkChannel(RfbOutputGate *output)
+{
+  // The replies come on the same connection as the requests.
+  m_fileTransfer->setOutput(output);
+}
+
 void ViewerWindow::onDisconnect(const StringStorage *message)
 {
   m_logWriter.info(_T("onDisconnect: %s"), message->getString());
@@ -1165,16 +1196,47 @@ void ViewerWindow::onFrameBufferUpdate(const FrameBuffer *fb, const Rect *rect)
   m_dsktWnd.updateFramebuffer(fb, rect);
 }
 
+void ViewerWindow::onFrameBufferUpdates(const FrameBuffer *fb, const std::vector<Rect> *updates)
+{
+  m_dsktWnd.updateFramebuffer(fb, updates);
+}
+
 void ViewerWindow::onFrameBufferPropChange(const FrameBuffer *fb)
 {
   m_dsktWnd.setNewFramebuffer(fb);
 }
 
+bool ViewerWindow::onFrameBufferCopy(const FrameBuffer *fb, const Rect *dstRect,
+                                     int srcX, int srcY)
+{
+  return m_dsktWnd.copyFramebuffer(dstRect, srcX, srcY);
+}
+
+bool ViewerWindow::onFrameBufferOverlay(const FrameBuffer *image, const Rect *rect)
+{
+  return m_dsktWnd.setOverlay(image, rect);
+}
+
+bool ViewerWindow::onCursorOverlay(const FrameBuffer *image, const Rect *rect,
+                                   bool imageChanged)
+{
+  return m_dsktWnd.setCursorOverlay(image, rect, imageChanged);
+}
+
 void ViewerWindow::onCutText(const StringStorage *cutText)
 {
   m_dsktWnd.setClipboardData(cutText);
 }
 
+bool ViewerWindow::onCutTextOffer(UINT32 length)
+{
+  // Small clipboards are cheaper to fetch than to wait for on pasting.
+  if (length <= EAGER_CUT_TEXT_LENGTH) {
+    return true;
+  }
+  return m_dsktWnd.setClipboardOffer();
+}
+
 void ViewerWindow::doCommand(int iCommand)
 {
   postMessage(WM_COMMAND, iCommand);
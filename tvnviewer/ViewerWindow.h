@@ -75,6 +75,9 @@ protected:
   static const int TIMER_DESKTOP_STATE = 1;
   static const int TIMER_DESKTOP_STATE_DELAY = 50;
 
+  // Offered clipboards up to this length (in bytes) are fetched at once.
+  static const UINT32 EAGER_CUT_TEXT_LENGTH = 65536;
+
   bool onMessage(UINT message, WPARAM wParam, LPARAM lParam);
   bool onEraseBackground(HDC hdc);
   
@@ -115,12 +118,20 @@ protected:
   //
   void onBell();
   void onConnected(RfbOutputGate *output);
+  void onBulkChannel(RfbOutputGate *output);
   void onDisconnect(const StringStorage *message);
   void onAuthError(const AuthException *exception);
   void onError(const Exception *exception);
   void onFrameBufferUpdate(const FrameBuffer *fb, const Rect *rect);
+  void onFrameBufferUpdates(const FrameBuffer *fb, const std::vector<Rect> *updates);
   void onFrameBufferPropChange(const FrameBuffer *fb);
+  bool onFrameBufferCopy(const FrameBuffer *fb, const Rect *dstRect,
+                         int srcX, int srcY);
+  bool onFrameBufferOverlay(const FrameBuffer *image, const Rect *rect);
+  bool onCursorOverlay(const FrameBuffer *image, const Rect *rect,
+                       bool imageChanged);
   void onCutText(const StringStorage *cutText);
+  bool onCutTextOffer(UINT32 length);
 
   int translateAccelToTB(int val);
   void applyScreenChanges(bool isFullScreen);
@@ -57,6 +57,7 @@
 #define IDS_ERROR_START_LISTENING       152
 #define IDS_ERROR_COMMAND_LINE          153
 #define IDS_ERROR_PARSE_OPTIONS_FILE    154
+#define IDS_CONNECTION_INFO_LATENCY_FORMAT 155
 #define IDS_TB_NEWCONNECTION            200
 #define IDS_TB_SAVESESSION              201
 #define IDS_TB_CONNOPTIONS              202
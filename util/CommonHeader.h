@@ -39,7 +39,9 @@
 
 #ifdef WIN32
 #include "winhdr.h"
-// LIBJPEG_TURBO was disbled only for SDK.
+// LIBJPEG_TURBO was disbled only for SDK. With it defined, JPEG encoding
+// and decoding read and write 32-bit pixels directly (JCS_EXT_* color
+// spaces) and use the SIMD code of libjpeg-turbo.
 //#define LIBJPEG_TURBO
 #endif // WIN32
 
@@ -0,0 +1,165 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CpuFeatures.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+volatile bool CpuFeatures::m_detected = false;
+bool CpuFeatures::m_sse2 = false;
+bool CpuFeatures::m_ssse3 = false;
+bool CpuFeatures::m_sse41 = false;
+bool CpuFeatures::m_avx2 = false;
+int CpuFeatures::m_maxLevel = CpuFeatures::LEVEL_AVX2;
+
+static const TCHAR *const LEVEL_NAMES[] = {
+  _T("scalar"), _T("sse2"), _T("ssse3"), _T("sse4.1"), _T("avx2")
+};
+static const int LEVEL_COUNT = sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]);
+
+bool CpuFeatures::hasSse2()
+{
+  detect();
+  return m_sse2 && m_maxLevel >= LEVEL_SSE2;
+}
+
+bool CpuFeatures::hasSsse3()
+{
+  detect();
+  return m_ssse3 && m_maxLevel >= LEVEL_SSSE3;
+}
+
+bool CpuFeatures::hasSse41()
+{
+  detect();
+  return m_sse41 && m_maxLevel >= LEVEL_SSE41;
+}
+
+bool CpuFeatures::hasAvx2()
+{
+  detect();
+  return m_avx2 && m_maxLevel >= LEVEL_AVX2;
+}
+
+void CpuFeatures::setMaxLevel(int level)
+{
+  if (level < LEVEL_SCALAR) {
+    level = LEVEL_SCALAR;
+  } else if (level > LEVEL_AVX2) {
+    level = LEVEL_AVX2;
+  }
+  m_maxLevel = level;
+}
+
+int CpuFeatures::getLevel()
+{
+  // The levels are checked from the top, the kernels use the highest one
+  // they have a variant for.
+  if (hasAvx2()) {
+    return LEVEL_AVX2;
+  }
+  if (hasSse41()) {
+    return LEVEL_SSE41;
+  }
+  if (hasSsse3()) {
+    return LEVEL_SSSE3;
+  }
+  if (hasSse2()) {
+    return LEVEL_SSE2;
+  }
+  return LEVEL_SCALAR;
+}
+
+bool CpuFeatures::parseLevel(const TCHAR *name, int *level)
+{
+  if (name == 0 || name[0] == _T('\0')) {
+    *level = LEVEL_AVX2;
+    return true;
+  }
+  for (int i = 0; i < LEVEL_COUNT; i++) {
+    if (_tcsicmp(name, LEVEL_NAMES[i]) == 0) {
+      *level = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const TCHAR *CpuFeatures::getLevelName(int level)
+{
+  if (level < LEVEL_SCALAR || level >= LEVEL_COUNT) {
+    return _T("unknown");
+  }
+  return LEVEL_NAMES[level];
+}
+
+void CpuFeatures::getDescription(StringStorage *desc)
+{
+  detect();
+  desc->format(_T("supported:%s%s%s%s, used: %s"),
+               m_sse2 ? _T(" sse2") : _T(""),
+               m_ssse3 ? _T(" ssse3") : _T(""),
+               m_sse41 ? _T(" sse4.1") : _T(""),
+               m_avx2 ? _T(" avx2") : _T(""),
+               getLevelName(getLevel()));
+  if (m_maxLevel < LEVEL_AVX2) {
+    StringStorage limit;
+    limit.format(_T(" (limited to %s)"), getLevelName(m_maxLevel));
+    desc->appendString(limit.getString());
+  }
+}
+
+void CpuFeatures::detect()
+{
+  // Detection is idempotent, so there is no harm if two threads happen to
+  // run it at the same time.
+  if (m_detected) {
+    return;
+  }
+
+  int info[4];
+  __cpuid(info, 0);
+  int maxLeaf = info[0];
+
+  if (maxLeaf >= 1) {
+    __cpuid(info, 1);
+    m_sse2 = (info[3] & (1 << 26)) != 0;
+    m_ssse3 = (info[2] & (1 << 9)) != 0;
+    m_sse41 = (info[2] & (1 << 19)) != 0;
+
+    // AVX2 also requires the OS to save YMM registers (OSXSAVE and XCR0).
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7 && osxsave && avx) {
+      unsigned long long xcr0 = _xgetbv(0);
+      if ((xcr0 & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        m_avx2 = (info[1] & (1 << 5)) != 0;
+      }
+    }
+  }
+
+  m_detected = true;
+}
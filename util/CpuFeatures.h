@@ -0,0 +1,81 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __CPUFEATURES_H__
+#define __CPUFEATURES_H__
+
+#include "StringStorage.h"
+
+// CpuFeatures reports instruction set extensions supported by the processor
+// (and by the operating system, for extensions requiring OS support to save
+// extended registers). The information is detected once, on the first call.
+//
+// All the SIMD kernels choose their variants by these functions, so the
+// extensions reported can be limited to compare the kernels, see
+// setMaxLevel().
+class CpuFeatures
+{
+public:
+  // Instruction set levels, each one includes the previous ones.
+  enum Level {
+    LEVEL_SCALAR = 0,
+    LEVEL_SSE2 = 1,
+    LEVEL_SSSE3 = 2,
+    LEVEL_SSE41 = 3,
+    LEVEL_AVX2 = 4
+  };
+
+  static bool hasSse2();
+  static bool hasSsse3();
+  static bool hasSse41();
+  static bool hasAvx2();
+
+  // Reports no extensions above the level even if they are supported. Must
+  // be called at start-up, before any kernel is chosen, because most of
+  // the kernels are chosen once.
+  static void setMaxLevel(int level);
+  // Returns the highest level reported by the functions above.
+  static int getLevel();
+
+  // Parses a level name ("scalar", "sse2", "ssse3", "sse4.1", "avx2"),
+  // case-insensitive. An empty name means no limit, LEVEL_AVX2.
+  // @return false if the name is unknown.
+  static bool parseLevel(const TCHAR *name, int *level);
+  static const TCHAR *getLevelName(int level);
+
+  // Describes the supported and the used extensions, for the log.
+  static void getDescription(StringStorage *desc);
+
+private:
+  static void detect();
+
+  static volatile bool m_detected;
+  static bool m_sse2;
+  static bool m_ssse3;
+  static bool m_sse41;
+  static bool m_avx2;
+  static int m_maxLevel;
+};
+
+#endif // __CPUFEATURES_H__
@@ -23,12 +23,16 @@
 //
 
 #include "Deflater.h"
+#include "MemAccount.h"
 #include <crtdbg.h>
 
 Deflater::Deflater()
+: m_level(Z_DEFAULT_COMPRESSION),
+  m_levelChanged(false)
 {
-  m_zlibStream.zalloc = Z_NULL;
-  m_zlibStream.zfree = Z_NULL;
+  m_zlibStream.zalloc = MemAccount::zlibAlloc;
+  m_zlibStream.zfree = MemAccount::zlibFree;
+  m_zlibStream.opaque = Z_NULL;
 
   deflateInit(&m_zlibStream, Z_DEFAULT_COMPRESSION);
 
@@ -50,17 +54,31 @@ void Deflater::deflate()
   size_t avaliableOutput = m_inputSize + reserve;
   unsigned long prevTotalOut = m_zlibStream.total_out;
 
+  // The output buffer only grows, so repeated calls with inputs of similar
+  // size do not reallocate it.
+  if (m_output.size() < avaliableOutput) {
+    m_output.resize(avaliableOutput);
+  }
+  avaliableOutput = m_output.size();
+
+  m_zlibStream.next_out = (Bytef *)&m_output.front();
   unsigned int constrainedValue = (unsigned int)avaliableOutput;
   _ASSERT(avaliableOutput == constrainedValue);
+  m_zlibStream.avail_out = constrainedValue;
 
-  m_output.resize(avaliableOutput);
+  // The level is changed before the new input is given, when there is
+  // room for the output deflateParams() may flush.
+  if (m_levelChanged) {
+    m_zlibStream.avail_in = 0;
+    if (deflateParams(&m_zlibStream, m_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw ZLibException(_T("Cannot change compression level"));
+    }
+    m_levelChanged = false;
+  }
 
   m_zlibStream.next_in = (Bytef *)m_input;
   m_zlibStream.avail_in = (unsigned int)m_inputSize;
 
-  m_zlibStream.next_out = (Bytef *)&m_output.front();
-  m_zlibStream.avail_out = (unsigned int)avaliableOutput;
-
   if (::deflate(&m_zlibStream, Z_SYNC_FLUSH) != Z_OK) {
     throw ZLibException(_T("Deflate method return error"));
   }
@@ -71,3 +89,16 @@ void Deflater::deflate()
  
   m_outputSize = m_zlibStream.total_out - prevTotalOut;
 }
+
+void Deflater::setLevel(int level)
+{
+  if (level != m_level) {
+    m_level = level;
+    m_levelChanged = true;
+  }
+}
+
+int Deflater::getLevel() const
+{
+  return m_level;
+}
@@ -35,8 +35,20 @@ public:
   ~Deflater();
 
   void deflate() throw(ZLibException);
+
+  /**
+   * Changes compression level for next calls of deflate(). The stream is
+   * not restarted, so the peer's inflater is not affected.
+   * @param level zlib compression level (1..9 or Z_DEFAULT_COMPRESSION).
+   */
+  void setLevel(int level);
+  int getLevel() const;
+
 protected:
   z_stream m_zlibStream;
+
+  int m_level;
+  bool m_levelChanged;
 };
 
 #endif
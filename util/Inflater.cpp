@@ -23,13 +23,15 @@
 //
 
 #include "Inflater.h"
+#include "MemAccount.h"
 #include <crtdbg.h>
 
 Inflater::Inflater()
 : m_unpackedSize(0)
 {
-  m_zlibStream.zalloc = Z_NULL;
-  m_zlibStream.zfree = Z_NULL;
+  m_zlibStream.zalloc = MemAccount::zlibAlloc;
+  m_zlibStream.zfree = MemAccount::zlibFree;
+  m_zlibStream.opaque = Z_NULL;
 
   inflateInit(&m_zlibStream);
 
@@ -50,6 +52,11 @@ void Inflater::setUnpackedSize(size_t size)
   m_unpackedSize = size;
 }
 
+void Inflater::reset()
+{
+  inflateReset(&m_zlibStream);
+}
+
 void Inflater::inflate()
 {
   size_t avaliableOutput = m_unpackedSize + m_unpackedSize / 100 + 1024;
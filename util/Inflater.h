@@ -40,6 +40,10 @@ public:
 
   void setUnpackedSize(size_t size);
 
+  // Start a new stream, keeping the memory allocated by zlib and the
+  // output buffer.
+  void reset();
+
   void inflate() throw(ZLibException);
 
 protected:
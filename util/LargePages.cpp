@@ -0,0 +1,105 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LargePages.h"
+
+#ifndef MEM_LARGE_PAGES
+#define MEM_LARGE_PAGES 0x20000000
+#endif
+
+typedef SIZE_T (WINAPI *pGetLargePageMinimum)();
+
+volatile bool LargePages::m_enabled = false;
+size_t LargePages::m_pageSize = 0;
+
+bool LargePages::enable(StringStorage *error)
+{
+  if (m_enabled) {
+    return true;
+  }
+
+  HMODULE kernel32 = GetModuleHandle(_T("kernel32.dll"));
+  pGetLargePageMinimum getLargePageMinimum = kernel32 == 0 ? 0 :
+    (pGetLargePageMinimum)GetProcAddress(kernel32, "GetLargePageMinimum");
+  size_t pageSize = getLargePageMinimum != 0 ? getLargePageMinimum() : 0;
+  if (pageSize == 0) {
+    error->setString(_T("Large pages are not supported by the system"));
+    return false;
+  }
+
+  HANDLE token;
+  if (!OpenProcessToken(GetCurrentProcess(),
+                        TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+    error->format(_T("Cannot open the process token, error %u"),
+                  (unsigned int)GetLastError());
+    return false;
+  }
+  TOKEN_PRIVILEGES privileges;
+  privileges.PrivilegeCount = 1;
+  privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+  bool enabled = LookupPrivilegeValue(0, SE_LOCK_MEMORY_NAME,
+                                      &privileges.Privileges[0].Luid) != 0 &&
+                 AdjustTokenPrivileges(token, FALSE, &privileges, 0, 0, 0) != 0;
+  // The call succeeds without assigning a privilege the process does not
+  // hold, this is told by the last error.
+  DWORD errCode = GetLastError();
+  CloseHandle(token);
+  if (!enabled || errCode != ERROR_SUCCESS) {
+    error->format(_T("The \"Lock pages in memory\" privilege is not granted,")
+                  _T(" error %u"), (unsigned int)errCode);
+    return false;
+  }
+
+  m_pageSize = pageSize;
+  m_enabled = true;
+  return true;
+}
+
+bool LargePages::isEnabled()
+{
+  return m_enabled;
+}
+
+size_t LargePages::getPageSize()
+{
+  return m_enabled ? m_pageSize : 0;
+}
+
+void *LargePages::alloc(size_t size)
+{
+  if (!m_enabled || size == 0) {
+    return 0;
+  }
+  size_t roundedSize = (size + m_pageSize - 1) & ~(m_pageSize - 1);
+  return VirtualAlloc(0, roundedSize,
+                      MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                      PAGE_READWRITE);
+}
+
+void LargePages::free(void *buffer)
+{
+  if (buffer != 0) {
+    VirtualFree(buffer, 0, MEM_RELEASE);
+  }
+}
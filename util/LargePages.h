@@ -0,0 +1,64 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __LARGEPAGES_H__
+#define __LARGEPAGES_H__
+
+#include "CommonHeader.h"
+
+// LargePages allocates memory on large pages (usually 2 MB instead of
+// 4 KB), which spares the TLB misses of the code streaming through big
+// buffers like the frame buffers. The pages are locked in the physical
+// memory, so the process needs the "Lock pages in memory" privilege and
+// the allocation may fail when the memory is fragmented, the callers fall
+// back to the normal allocation then.
+//
+// Large pages are not used until enable() succeeds.
+class LargePages
+{
+public:
+  // Enables the privilege of the process and the allocations. Is called at
+  // start-up, before the allocations.
+  // @return false if large pages are not supported by the system (before
+  // Windows Server 2003) or the privilege is not granted, the error is
+  // described in error then.
+  static bool enable(StringStorage *error);
+  static bool isEnabled();
+
+  // Returns the size of a large page, 0 if they are not enabled.
+  static size_t getPageSize();
+
+  // Allocates size bytes rounded up to whole large pages, the buffer is
+  // aligned to the page size.
+  // @return 0 if large pages are not enabled or there are not enough free
+  // ones.
+  static void *alloc(size_t size);
+  static void free(void *buffer);
+
+private:
+  static volatile bool m_enabled;
+  static size_t m_pageSize;
+};
+
+#endif // __LARGEPAGES_H__
@@ -0,0 +1,99 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "LatencyHistogram.h"
+#include <string.h>
+
+LatencyHistogram::LatencyHistogram()
+{
+  clear();
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+void LatencyHistogram::add(UINT32 micros)
+{
+  m_buckets[getBucketIndex(micros)]++;
+  m_count++;
+}
+
+void LatencyHistogram::clear()
+{
+  memset(m_buckets, 0, sizeof(m_buckets));
+  m_count = 0;
+}
+
+UINT32 LatencyHistogram::getCount() const
+{
+  return m_count;
+}
+
+UINT32 LatencyHistogram::getPercentile(unsigned int percent) const
+{
+  if (m_count == 0) {
+    return 0;
+  }
+  if (percent > 100) {
+    percent = 100;
+  }
+  // Rank of the value, rounded up and at least one.
+  UINT64 rank = ((UINT64)m_count * percent + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+  UINT64 seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    seen += m_buckets[i];
+    if (seen >= rank) {
+      return getBucketLowerBound(i);
+    }
+  }
+  return getBucketLowerBound(BUCKET_COUNT - 1);
+}
+
+size_t LatencyHistogram::getBucketIndex(UINT32 micros)
+{
+  if (micros < SUB_BUCKET_COUNT) {
+    return micros;
+  }
+  size_t exponent = 0;
+  for (UINT32 v = micros; v > 1; v >>= 1) {
+    exponent++;
+  }
+  size_t shift = exponent - SUB_BUCKET_BITS;
+  size_t sub = (micros >> shift) & (SUB_BUCKET_COUNT - 1);
+  return SUB_BUCKET_COUNT + shift * SUB_BUCKET_COUNT + sub;
+}
+
+UINT32 LatencyHistogram::getBucketLowerBound(size_t index)
+{
+  if (index < SUB_BUCKET_COUNT) {
+    return (UINT32)index;
+  }
+  size_t shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+  size_t sub = (index - SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+  return (UINT32)((SUB_BUCKET_COUNT + sub) << shift);
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __LATENCYHISTOGRAM_H__
+#define __LATENCYHISTOGRAM_H__
+
+#include "inttypes.h"
+
+// Histogram of time intervals in microseconds for estimating percentiles.
+// The buckets are logarithmic with eight buckets for each power of two, so
+// a percentile is reported with an error below 12.5 percent in constant
+// memory. The class is not thread-safe.
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+  ~LatencyHistogram();
+
+  void add(UINT32 micros);
+  void clear();
+
+  UINT32 getCount() const;
+
+  // Returns the lower bound of the bucket at which the given percent of
+  // the added values is reached, 0 if no value was added.
+  UINT32 getPercentile(unsigned int percent) const;
+
+private:
+  static size_t getBucketIndex(UINT32 micros);
+  static UINT32 getBucketLowerBound(size_t index);
+
+  static const size_t SUB_BUCKET_BITS = 3;
+  static const size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  static const size_t BUCKET_COUNT =
+    SUB_BUCKET_COUNT + (32 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
+
+  UINT32 m_buckets[BUCKET_COUNT];
+  UINT32 m_count;
+};
+
+#endif // __LATENCYHISTOGRAM_H__
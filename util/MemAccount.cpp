@@ -0,0 +1,177 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "MemAccount.h"
+
+#include <intrin.h>
+#include <stdlib.h>
+
+volatile INT64 MemAccount::m_bytes[MEM_TAG_COUNT] = { 0 };
+volatile INT64 MemAccount::m_peakBytes[MEM_TAG_COUNT] = { 0 };
+volatile INT64 MemAccount::m_blocks[MEM_TAG_COUNT] = { 0 };
+
+static const TCHAR *const TAG_NAMES[MEM_TAG_COUNT] = {
+  _T("frame_buffers"),
+  _T("encoder_scratch"),
+  _T("zlib_streams"),
+  _T("regions"),
+  _T("file_transfer")
+};
+
+// Kept before the blocks of memAccountAlloc(), the size keeps the
+// alignment of malloc().
+union BlockHeader
+{
+  size_t size;
+  char alignment[16];
+};
+
+INT64 MemAccount::add(volatile INT64 *counter, INT64 delta)
+{
+  // The 64-bit interlocked functions are not there on 32-bit XP, the
+  // compare exchange intrinsic is.
+  INT64 old;
+  do {
+    old = *counter;
+  } while (_InterlockedCompareExchange64(counter, old + delta, old) != old);
+  return old + delta;
+}
+
+INT64 MemAccount::read(volatile INT64 *counter)
+{
+  return _InterlockedCompareExchange64(counter, 0, 0);
+}
+
+void MemAccount::allocated(int tag, size_t size)
+{
+  INT64 bytes = add(&m_bytes[tag], (INT64)size);
+  add(&m_blocks[tag], 1);
+  INT64 peak = read(&m_peakBytes[tag]);
+  while (bytes > peak) {
+    INT64 prev = _InterlockedCompareExchange64(&m_peakBytes[tag], bytes, peak);
+    if (prev == peak) {
+      break;
+    }
+    peak = prev;
+  }
+}
+
+void MemAccount::freed(int tag, size_t size)
+{
+  add(&m_bytes[tag], -(INT64)size);
+  add(&m_blocks[tag], -1);
+}
+
+void MemAccount::resized(int tag, size_t oldSize, size_t newSize)
+{
+  if (oldSize == newSize) {
+    return;
+  }
+  // A buffer counts as a block while it holds memory.
+  if (oldSize != 0) {
+    freed(tag, oldSize);
+  }
+  if (newSize != 0) {
+    allocated(tag, newSize);
+  }
+}
+
+void MemAccount::getCounters(int tag, Counters *counters)
+{
+  counters->bytes = (UINT64)read(&m_bytes[tag]);
+  counters->peakBytes = (UINT64)read(&m_peakBytes[tag]);
+  counters->blocks = (UINT64)read(&m_blocks[tag]);
+}
+
+const TCHAR *MemAccount::getTagName(int tag)
+{
+  if (tag < 0 || tag >= MEM_TAG_COUNT) {
+    return _T("unknown");
+  }
+  return TAG_NAMES[tag];
+}
+
+void MemAccount::getDescription(StringStorage *desc)
+{
+  desc->setString(_T("Memory (KB now/peak, blocks):"));
+  for (int tag = 0; tag < MEM_TAG_COUNT; tag++) {
+    Counters counters;
+    getCounters(tag, &counters);
+    StringStorage part;
+    part.format(_T(" %s=%llu/%llu,%llu"), getTagName(tag),
+                counters.bytes / 1024, counters.peakBytes / 1024,
+                counters.blocks);
+    desc->appendString(part.getString());
+  }
+}
+
+void *MemAccount::zlibAlloc(void *opaque, unsigned int items, unsigned int size)
+{
+  return memAccountAlloc(MEM_ZLIB_STREAMS, (size_t)items * size);
+}
+
+void MemAccount::zlibFree(void *opaque, void *address)
+{
+  memAccountFree(MEM_ZLIB_STREAMS, address);
+}
+
+void *memAccountAlloc(int tag, size_t size)
+{
+  BlockHeader *header = (BlockHeader *)malloc(sizeof(BlockHeader) + size);
+  if (header == 0) {
+    return 0;
+  }
+  header->size = size;
+  MemAccount::allocated(tag, size);
+  return header + 1;
+}
+
+void *memAccountRealloc(int tag, void *ptr, size_t size)
+{
+  if (ptr == 0) {
+    return memAccountAlloc(tag, size);
+  }
+  BlockHeader *header = (BlockHeader *)ptr - 1;
+  size_t oldSize = header->size;
+  BlockHeader *newHeader = (BlockHeader *)realloc(header,
+                                                  sizeof(BlockHeader) + size);
+  if (newHeader == 0) {
+    // The old block stays as it was.
+    return 0;
+  }
+  newHeader->size = size;
+  MemAccount::freed(tag, oldSize);
+  MemAccount::allocated(tag, size);
+  return newHeader + 1;
+}
+
+void memAccountFree(int tag, void *ptr)
+{
+  if (ptr == 0) {
+    return;
+  }
+  BlockHeader *header = (BlockHeader *)ptr - 1;
+  MemAccount::freed(tag, header->size);
+  free(header);
+}
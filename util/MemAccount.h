@@ -0,0 +1,103 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __MEMACCOUNT_H__
+#define __MEMACCOUNT_H__
+
+#include <stddef.h>
+
+// Subsystems the memory is accounted to. The values are visible to the C
+// code too (see the functions below).
+enum MemAccountTag {
+  MEM_FRAME_BUFFERS = 0,
+  MEM_ENCODER_SCRATCH = 1,
+  MEM_ZLIB_STREAMS = 2,
+  MEM_REGIONS = 3,
+  MEM_FILE_TRANSFER = 4,
+  MEM_TAG_COUNT = 5
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// malloc(), realloc() and free() accounting the blocks to a tag. The size
+// of a block is kept before it, so the blocks must be freed and
+// reallocated by these functions only, with the same tag.
+void *memAccountAlloc(int tag, size_t size);
+void *memAccountRealloc(int tag, void *ptr, size_t size);
+void memAccountFree(int tag, void *ptr);
+
+#ifdef __cplusplus
+}
+
+#include "StringStorage.h"
+#include "inttypes.h"
+
+// MemAccount counts the memory held by the subsystems, to tell which of
+// them a grown process owes its size to. The subsystems report their
+// allocations and deallocations explicitly, or allocate by the functions
+// above. The counters are updated without locks and may be read from any
+// thread.
+class MemAccount
+{
+public:
+  // Counters of one tag.
+  struct Counters
+  {
+    // Bytes held now and the most held since the start.
+    UINT64 bytes;
+    UINT64 peakBytes;
+    // Number of blocks held now.
+    UINT64 blocks;
+  };
+
+  static void allocated(int tag, size_t size);
+  static void freed(int tag, size_t size);
+  // Accounts a buffer which has changed its size from oldSize to newSize.
+  static void resized(int tag, size_t oldSize, size_t newSize);
+
+  static void getCounters(int tag, Counters *counters);
+  static const TCHAR *getTagName(int tag);
+
+  // Describes all the counters in one line, for the log.
+  static void getDescription(StringStorage *desc);
+
+  // Allocation functions for the zlib streams (alloc_func and free_func),
+  // accounted to MEM_ZLIB_STREAMS.
+  static void *zlibAlloc(void *opaque, unsigned int items, unsigned int size);
+  static void zlibFree(void *opaque, void *address);
+
+private:
+  static INT64 add(volatile INT64 *counter, INT64 delta);
+  static INT64 read(volatile INT64 *counter);
+
+  static volatile INT64 m_bytes[MEM_TAG_COUNT];
+  static volatile INT64 m_peakBytes[MEM_TAG_COUNT];
+  static volatile INT64 m_blocks[MEM_TAG_COUNT];
+};
+
+#endif // __cplusplus
+
+#endif // __MEMACCOUNT_H__
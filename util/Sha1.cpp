@@ -0,0 +1,167 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "Sha1.h"
+
+#include <string.h>
+
+Sha1::Sha1()
+: m_totalLength(0),
+  m_bufferSize(0),
+  m_finalized(false)
+{
+  m_state[0] = 0x67452301;
+  m_state[1] = 0xEFCDAB89;
+  m_state[2] = 0x98BADCFE;
+  m_state[3] = 0x10325476;
+  m_state[4] = 0xC3D2E1F0;
+  memset(m_hash, 0, sizeof(m_hash));
+}
+
+void Sha1::update(const void *buf, size_t length)
+{
+  if (m_finalized) {
+    return;
+  }
+
+  const UINT8 *input = (const UINT8 *)buf;
+  m_totalLength += length;
+
+  // Complete the block started by previous update.
+  if (m_bufferSize != 0) {
+    size_t fill = BLOCK_SIZE - m_bufferSize;
+    if (fill > length) {
+      fill = length;
+    }
+    memcpy(m_buffer + m_bufferSize, input, fill);
+    m_bufferSize += fill;
+    input += fill;
+    length -= fill;
+
+    if (m_bufferSize < BLOCK_SIZE) {
+      return;
+    }
+    processBlock(m_buffer);
+    m_bufferSize = 0;
+  }
+
+  while (length >= BLOCK_SIZE) {
+    processBlock(input);
+    input += BLOCK_SIZE;
+    length -= BLOCK_SIZE;
+  }
+
+  if (length != 0) {
+    memcpy(m_buffer, input, length);
+    m_bufferSize = length;
+  }
+}
+
+Sha1 &Sha1::finalize()
+{
+  if (m_finalized) {
+    return *this;
+  }
+
+  UINT64 bitLength = m_totalLength * 8;
+
+  // Padding: one bit, zeros up to 8 bytes before the end of a block, and
+  // the message length in bits.
+  UINT8 padding[BLOCK_SIZE * 2];
+  memset(padding, 0, sizeof(padding));
+  padding[0] = 0x80;
+  size_t padLength = (m_bufferSize < BLOCK_SIZE - 8) ?
+                     BLOCK_SIZE - 8 - m_bufferSize :
+                     2 * BLOCK_SIZE - 8 - m_bufferSize;
+  for (int i = 0; i < 8; i++) {
+    padding[padLength + i] = (UINT8)(bitLength >> (56 - 8 * i));
+  }
+  update(padding, padLength + 8);
+
+  for (int i = 0; i < 5; i++) {
+    m_hash[4 * i] = (UINT8)(m_state[i] >> 24);
+    m_hash[4 * i + 1] = (UINT8)(m_state[i] >> 16);
+    m_hash[4 * i + 2] = (UINT8)(m_state[i] >> 8);
+    m_hash[4 * i + 3] = (UINT8)m_state[i];
+  }
+  m_finalized = true;
+  return *this;
+}
+
+const UINT8 *Sha1::getHash() const
+{
+  return m_hash;
+}
+
+UINT32 Sha1::rotateLeft(UINT32 x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+void Sha1::processBlock(const UINT8 *block)
+{
+  UINT32 w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((UINT32)block[4 * i] << 24) | ((UINT32)block[4 * i + 1] << 16) |
+           ((UINT32)block[4 * i + 2] << 8) | (UINT32)block[4 * i + 3];
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+
+  UINT32 a = m_state[0];
+  UINT32 b = m_state[1];
+  UINT32 c = m_state[2];
+  UINT32 d = m_state[3];
+  UINT32 e = m_state[4];
+
+  for (int i = 0; i < 80; i++) {
+    UINT32 f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    UINT32 temp = rotateLeft(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotateLeft(b, 30);
+    b = a;
+    a = temp;
+  }
+
+  m_state[0] += a;
+  m_state[1] += b;
+  m_state[2] += c;
+  m_state[3] += d;
+  m_state[4] += e;
+}
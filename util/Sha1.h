@@ -0,0 +1,67 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __SHA1_H__
+#define __SHA1_H__
+
+#include "util/inttypes.h"
+
+/**
+ * Streaming SHA-1 hash (RFC 3174). It's not secure any more, it's here for
+ * the protocols which require it (e.g. the WebSocket opening handshake).
+ */
+class Sha1
+{
+public:
+  Sha1();
+
+  void update(const void *buf, size_t length);
+  Sha1 &finalize();
+
+  /**
+   * Returns 20 byte hash.
+   */
+  const UINT8 *getHash() const;
+
+  static const size_t HASH_SIZE = 20;
+
+private:
+  static UINT32 rotateLeft(UINT32 x, int n);
+
+  void processBlock(const UINT8 *block);
+
+  static const size_t BLOCK_SIZE = 64;
+
+  UINT32 m_state[5];
+  UINT64 m_totalLength;
+
+  // Tail of input shorter than block.
+  UINT8 m_buffer[BLOCK_SIZE];
+  size_t m_bufferSize;
+
+  UINT8 m_hash[HASH_SIZE];
+  bool m_finalized;
+};
+
+#endif
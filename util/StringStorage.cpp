@@ -359,6 +359,15 @@ void StringStorage::operator= (const StringStorage &other)
   setString(other.getString());
 }
 
+void StringStorage::swap(StringStorage *other)
+{
+  m_buffer.swap(other->m_buffer);
+#ifdef _DEBUG
+  m_readableString = &m_buffer.front();
+  other->m_readableString = &other->m_buffer.front();
+#endif
+}
+
 bool StringStorage::operator == (const StringStorage &str) const
 {
   return isEqualTo(&str);
@@ -213,6 +213,10 @@ public:
 
   void operator = (const StringStorage &other);
 
+  // Exchanges the strings of this and the other storage, nothing is
+  // copied or allocated.
+  void swap(StringStorage *other);
+
   bool operator == (const StringStorage &str) const;
   bool operator < (const StringStorage &str) const;
   void operator += (const TCHAR* str);
@@ -26,6 +26,7 @@
 #include "CommonHeader.h"
 #include "util/Exception.h"
 #include "UnicodeStringStorage.h"
+#include "Utf8Transcoder.h"
 #include <crtdbg.h>
 
 Utf8StringStorage::Utf8StringStorage()
@@ -84,10 +85,21 @@ void Utf8StringStorage::fromStringStorage(const StringStorage *src)
   const WCHAR *uniString = src->getString();
   size_t uniLength = src->getLength();
 #endif
+  // From UNICODE to UTF8, the length is counted first so that the buffer
+  // gets its exact size.
+  size_t utf8Length;
+  if (Utf8Transcoder::utf16ToUtf8(uniString, uniLength + 1, 0, 0, &utf8Length)) {
+    m_buffer.resize(utf8Length);
+    Utf8Transcoder::utf16ToUtf8(uniString, uniLength + 1,
+                                &m_buffer.front(), utf8Length, &utf8Length);
+    return;
+  }
+
+  // Strings with unpaired surrogates are left to the system, which
+  // replaces them.
   int constrSrcSize = (int)uniLength + 1;
   _ASSERT(constrSrcSize == uniLength + 1);
 
-  // From UNICODE to UTF8
   int dstRequiredSize = WideCharToMultiByte(CP_UTF8, 0, uniString,
                                             constrSrcSize, NULL, 0,
                                             0, 0);
@@ -103,7 +115,19 @@ void Utf8StringStorage::fromStringStorage(const StringStorage *src)
 
 void Utf8StringStorage::toStringStorage(StringStorage *dst)
 {
-  // 1) From UTF8 to UNICODE
+  // 1) From UTF8 to UNICODE. Each UTF-16 unit takes at least one byte, so
+  // a buffer of getSize() units is large enough.
+  std::vector<WCHAR> uniBuff(getSize() + 1);
+  size_t uniLength;
+  if (Utf8Transcoder::utf8ToUtf16(&m_buffer.front(), getSize(),
+                                  &uniBuff.front(), getSize(), &uniLength)) {
+    uniBuff[uniLength] = L'\0';
+    storeUnicode(&uniBuff.front(), dst);
+    return;
+  }
+
+  // Malformed strings are left to the system, which replaces or drops the
+  // invalid sequences.
   int constrSize = (int)getSize();
   _ASSERT(constrSize == getSize());
   int dstReqSizeInSym = MultiByteToWideChar(CP_UTF8, 0, &m_buffer.front(),
@@ -111,14 +135,23 @@ void Utf8StringStorage::toStringStorage(StringStorage *dst)
   if (dstReqSizeInSym == 0) {
     throw Exception(_T("Cannot convert a string from the UTF8 format"));
   }
-  std::vector<WCHAR> uniBuff(dstReqSizeInSym + 1);
+  uniBuff.resize(dstReqSizeInSym + 1);
   MultiByteToWideChar(CP_UTF8, 0, &m_buffer.front(),
                       constrSize, &uniBuff.front(), dstReqSizeInSym);
   // Add termination symbol to the unicode buffer because the source string
   // may be without it.
   uniBuff[dstReqSizeInSym] = L'\0';
 
+  storeUnicode(&uniBuff.front(), dst);
+}
+
+void Utf8StringStorage::storeUnicode(const WCHAR *uniString, StringStorage *dst)
+{
   // 2) From UNICODE to StringStorage
-  UnicodeStringStorage uniString(&uniBuff.front());
-  uniString.toStringStorage(dst);
+#ifdef _UNICODE
+  dst->setString(uniString);
+#else
+  UnicodeStringStorage ansiString(uniString);
+  ansiString.toStringStorage(dst);
+#endif
 }
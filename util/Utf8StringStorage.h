@@ -53,6 +53,9 @@ public:
   void toStringStorage(StringStorage *dst);
 
 private:
+  // Sets dst to the null-terminated unicode string.
+  static void storeUnicode(const WCHAR *uniString, StringStorage *dst);
+
   std::vector<char> m_buffer;
 };
 
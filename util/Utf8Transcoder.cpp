@@ -0,0 +1,215 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "Utf8Transcoder.h"
+#include "CpuFeatures.h"
+
+#include <emmintrin.h>
+
+// Bytes, or UTF-16 units, converted by one step of the SSE2 loops.
+static const size_t SIMD_BLOCK = 16;
+
+bool Utf8Transcoder::utf8ToUtf16(const char *src, size_t srcLength,
+                                 WCHAR *dst, size_t dstCapacity,
+                                 size_t *dstLength)
+{
+  return decode((const UINT8 *)src, srcLength, CpuFeatures::hasSse2(),
+                dst, dstCapacity, dstLength);
+}
+
+bool Utf8Transcoder::utf16ToUtf8(const WCHAR *src, size_t srcLength,
+                                 char *dst, size_t dstCapacity,
+                                 size_t *dstLength)
+{
+  return encode((const UINT16 *)src, srcLength, CpuFeatures::hasSse2(),
+                (UINT8 *)dst, dstCapacity, dstLength);
+}
+
+bool Utf8Transcoder::decode(const UINT8 *src, size_t srcLength, bool useSse2,
+                            WCHAR *dst, size_t dstCapacity, size_t *dstLength)
+{
+  const UINT8 *end = src + srcLength;
+  size_t out = 0;
+  const __m128i zero = _mm_setzero_si128();
+
+  while (src < end) {
+    const UINT8 *scalarEnd = end;
+    if (useSse2) {
+      for (; (size_t)(end - src) >= SIMD_BLOCK; src += SIMD_BLOCK, out += SIMD_BLOCK) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)src);
+        if (_mm_movemask_epi8(bytes) != 0) {
+          break;
+        }
+        if (dst != 0) {
+          if (dstCapacity - out < SIMD_BLOCK) {
+            return false;
+          }
+          _mm_storeu_si128((__m128i *)(dst + out), _mm_unpacklo_epi8(bytes, zero));
+          _mm_storeu_si128((__m128i *)(dst + out + 8), _mm_unpackhi_epi8(bytes, zero));
+        }
+      }
+      // The block with a non-ASCII byte is converted one by one, then the
+      // vector loop is tried again.
+      if ((size_t)(end - src) > SIMD_BLOCK) {
+        scalarEnd = src + SIMD_BLOCK;
+      }
+    }
+
+    while (src < scalarEnd) {
+      UINT32 c = *src;
+      size_t length;
+      if (c < 0x80) {
+        length = 1;
+      } else if (c < 0xC2) {
+        // A continuation byte or the lead of an overlong 2-byte form.
+        return false;
+      } else if (c < 0xE0) {
+        length = 2;
+        c &= 0x1F;
+      } else if (c < 0xF0) {
+        length = 3;
+        c &= 0x0F;
+      } else if (c < 0xF5) {
+        length = 4;
+        c &= 0x07;
+      } else {
+        return false;
+      }
+      if ((size_t)(end - src) < length) {
+        return false;
+      }
+      for (size_t i = 1; i < length; i++) {
+        UINT8 next = src[i];
+        if ((next & 0xC0) != 0x80) {
+          return false;
+        }
+        c = (c << 6) | (next & 0x3F);
+      }
+      if ((length == 3 && (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF))) ||
+          (length == 4 && (c < 0x10000 || c > 0x10FFFF))) {
+        return false;
+      }
+      src += length;
+
+      size_t units = c >= 0x10000 ? 2 : 1;
+      if (dst != 0) {
+        if (dstCapacity - out < units) {
+          return false;
+        }
+        if (units == 2) {
+          c -= 0x10000;
+          dst[out] = (WCHAR)(0xD800 + (c >> 10));
+          dst[out + 1] = (WCHAR)(0xDC00 + (c & 0x3FF));
+        } else {
+          dst[out] = (WCHAR)c;
+        }
+      }
+      out += units;
+    }
+  }
+
+  *dstLength = out;
+  return true;
+}
+
+bool Utf8Transcoder::encode(const UINT16 *src, size_t srcLength, bool useSse2,
+                            UINT8 *dst, size_t dstCapacity, size_t *dstLength)
+{
+  const UINT16 *end = src + srcLength;
+  size_t out = 0;
+  const __m128i nonAsciiMask = _mm_set1_epi16((short)0xFF80);
+  const __m128i zero = _mm_setzero_si128();
+
+  while (src < end) {
+    const UINT16 *scalarEnd = end;
+    if (useSse2) {
+      for (; (size_t)(end - src) >= SIMD_BLOCK; src += SIMD_BLOCK, out += SIMD_BLOCK) {
+        __m128i low = _mm_loadu_si128((const __m128i *)src);
+        __m128i high = _mm_loadu_si128((const __m128i *)(src + 8));
+        __m128i nonAscii = _mm_and_si128(_mm_or_si128(low, high), nonAsciiMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, zero)) != 0xFFFF) {
+          break;
+        }
+        if (dst != 0) {
+          if (dstCapacity - out < SIMD_BLOCK) {
+            return false;
+          }
+          _mm_storeu_si128((__m128i *)(dst + out), _mm_packus_epi16(low, high));
+        }
+      }
+      if ((size_t)(end - src) > SIMD_BLOCK) {
+        scalarEnd = src + SIMD_BLOCK;
+      }
+    }
+
+    while (src < scalarEnd) {
+      UINT32 c = *src++;
+      size_t length;
+      if (c < 0x80) {
+        length = 1;
+      } else if (c < 0x800) {
+        length = 2;
+      } else if (c >= 0xD800 && c <= 0xDFFF) {
+        if (c >= 0xDC00 || src == end || *src < 0xDC00 || *src > 0xDFFF) {
+          return false;
+        }
+        c = 0x10000 + ((c - 0xD800) << 10) + (*src++ - 0xDC00);
+        length = 4;
+      } else {
+        length = 3;
+      }
+
+      if (dst != 0) {
+        if (dstCapacity - out < length) {
+          return false;
+        }
+        UINT8 *p = dst + out;
+        switch (length) {
+        case 1:
+          p[0] = (UINT8)c;
+          break;
+        case 2:
+          p[0] = (UINT8)(0xC0 | (c >> 6));
+          p[1] = (UINT8)(0x80 | (c & 0x3F));
+          break;
+        case 3:
+          p[0] = (UINT8)(0xE0 | (c >> 12));
+          p[1] = (UINT8)(0x80 | ((c >> 6) & 0x3F));
+          p[2] = (UINT8)(0x80 | (c & 0x3F));
+          break;
+        default:
+          p[0] = (UINT8)(0xF0 | (c >> 18));
+          p[1] = (UINT8)(0x80 | ((c >> 12) & 0x3F));
+          p[2] = (UINT8)(0x80 | ((c >> 6) & 0x3F));
+          p[3] = (UINT8)(0x80 | (c & 0x3F));
+          break;
+        }
+      }
+      out += length;
+    }
+  }
+
+  *dstLength = out;
+  return true;
+}
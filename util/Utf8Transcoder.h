@@ -0,0 +1,73 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __UTF8TRANSCODER_H__
+#define __UTF8TRANSCODER_H__
+
+#include "CommonHeader.h"
+
+//
+// Utf8Transcoder converts between UTF-8 and UTF-16 into buffers given by
+// the caller, so that no memory has to be allocated. The input is
+// validated: malformed or truncated UTF-8 sequences, overlong forms,
+// encoded surrogates, code points above U+10FFFF and unpaired UTF-16
+// surrogates make the conversion fail. Runs of ASCII are converted 16
+// characters at a time with SSE2, the other characters one by one.
+//
+// Like the Win32 conversion functions, with dst set to 0 the source is only
+// validated and the length of the result is computed.
+//
+
+class Utf8Transcoder
+{
+public:
+  // Converts srcLength bytes of UTF-8 to UTF-16. Terminating null
+  // characters are converted like any other character.
+  // @param dstCapacity size of dst in UTF-16 units, ignored if dst is 0.
+  // @param dstLength receives the length of the result in UTF-16 units.
+  // @return false if the source is not valid UTF-8 or dst is too small.
+  static bool utf8ToUtf16(const char *src, size_t srcLength,
+                          WCHAR *dst, size_t dstCapacity, size_t *dstLength);
+
+  // Converts srcLength UTF-16 units to UTF-8.
+  // @param dstCapacity size of dst in bytes, ignored if dst is 0.
+  // @param dstLength receives the length of the result in bytes.
+  // @return false if the source has an unpaired surrogate or dst is too
+  // small.
+  static bool utf16ToUtf8(const WCHAR *src, size_t srcLength,
+                          char *dst, size_t dstCapacity, size_t *dstLength);
+
+  // Upper bounds of the lengths of the results, for sizing buffers without
+  // a counting pass.
+  static size_t getMaxUtf16Length(size_t utf8Length) { return utf8Length; }
+  static size_t getMaxUtf8Length(size_t utf16Length) { return utf16Length * 3; }
+
+protected:
+  static bool decode(const UINT8 *src, size_t srcLength, bool useSse2,
+                     WCHAR *dst, size_t dstCapacity, size_t *dstLength);
+  static bool encode(const UINT16 *src, size_t srcLength, bool useSse2,
+                     UINT8 *dst, size_t dstCapacity, size_t *dstLength);
+};
+
+#endif // __UTF8TRANSCODER_H__
@@ -0,0 +1,182 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "XXHash64.h"
+
+#include <string.h>
+
+static const UINT64 PRIME1 = 0x9E3779B185EBCA87ULL;
+static const UINT64 PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const UINT64 PRIME3 = 0x165667B19E3779F9ULL;
+static const UINT64 PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const UINT64 PRIME5 = 0x27D4EB2F165667C5ULL;
+
+XXHash64::XXHash64(UINT64 seed)
+: m_seed(seed),
+  m_totalLength(0),
+  m_bufferSize(0),
+  m_finalized(false)
+{
+  m_acc[0] = seed + PRIME1 + PRIME2;
+  m_acc[1] = seed + PRIME2;
+  m_acc[2] = seed;
+  m_acc[3] = seed - PRIME1;
+  memset(m_hash, 0, sizeof(m_hash));
+}
+
+void XXHash64::update(const void *buf, size_t length)
+{
+  if (m_finalized) {
+    return;
+  }
+
+  const UINT8 *input = (const UINT8 *)buf;
+  m_totalLength += length;
+
+  // Complete the stripe started by previous update.
+  if (m_bufferSize != 0) {
+    size_t fill = STRIPE_SIZE - m_bufferSize;
+    if (fill > length) {
+      fill = length;
+    }
+    memcpy(m_buffer + m_bufferSize, input, fill);
+    m_bufferSize += fill;
+    input += fill;
+    length -= fill;
+
+    if (m_bufferSize < STRIPE_SIZE) {
+      return;
+    }
+    processStripe(m_buffer);
+    m_bufferSize = 0;
+  }
+
+  while (length >= STRIPE_SIZE) {
+    processStripe(input);
+    input += STRIPE_SIZE;
+    length -= STRIPE_SIZE;
+  }
+
+  if (length != 0) {
+    memcpy(m_buffer, input, length);
+    m_bufferSize = length;
+  }
+}
+
+XXHash64 &XXHash64::finalize()
+{
+  if (m_finalized) {
+    return *this;
+  }
+
+  UINT64 h;
+  if (m_totalLength >= STRIPE_SIZE) {
+    h = rotateLeft(m_acc[0], 1) + rotateLeft(m_acc[1], 7) +
+        rotateLeft(m_acc[2], 12) + rotateLeft(m_acc[3], 18);
+    for (int i = 0; i < 4; i++) {
+      h = mergeRound(h, m_acc[i]);
+    }
+  } else {
+    h = m_seed + PRIME5;
+  }
+
+  h += m_totalLength;
+
+  const UINT8 *p = m_buffer;
+  size_t left = m_bufferSize;
+
+  while (left >= 8) {
+    h ^= round(0, readUInt64(p));
+    h = rotateLeft(h, 27) * PRIME1 + PRIME4;
+    p += 8;
+    left -= 8;
+  }
+  if (left >= 4) {
+    h ^= (UINT64)readUInt32(p) * PRIME1;
+    h = rotateLeft(h, 23) * PRIME2 + PRIME3;
+    p += 4;
+    left -= 4;
+  }
+  while (left > 0) {
+    h ^= (UINT64)*p * PRIME5;
+    h = rotateLeft(h, 11) * PRIME1;
+    p++;
+    left--;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+
+  for (size_t i = 0; i < HASH_SIZE; i++) {
+    m_hash[i] = (UINT8)(h >> (8 * (HASH_SIZE - 1 - i)));
+  }
+
+  m_finalized = true;
+  return *this;
+}
+
+const UINT8 *XXHash64::getHash() const
+{
+  return m_hash;
+}
+
+void XXHash64::processStripe(const UINT8 *stripe)
+{
+  for (int i = 0; i < 4; i++) {
+    m_acc[i] = round(m_acc[i], readUInt64(stripe + 8 * i));
+  }
+}
+
+UINT64 XXHash64::round(UINT64 acc, UINT64 input)
+{
+  acc += input * PRIME2;
+  acc = rotateLeft(acc, 31);
+  return acc * PRIME1;
+}
+
+UINT64 XXHash64::mergeRound(UINT64 acc, UINT64 value)
+{
+  acc ^= round(0, value);
+  return acc * PRIME1 + PRIME4;
+}
+
+UINT64 XXHash64::readUInt64(const UINT8 *p)
+{
+  // Input is little endian.
+  return (UINT64)readUInt32(p) | ((UINT64)readUInt32(p + 4) << 32);
+}
+
+UINT32 XXHash64::readUInt32(const UINT8 *p)
+{
+  return (UINT32)p[0] | ((UINT32)p[1] << 8) |
+         ((UINT32)p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+UINT64 XXHash64::rotateLeft(UINT64 x, int n)
+{
+  return (x << n) | (x >> (64 - n));
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __XXHASH64_H__
+#define __XXHASH64_H__
+
+#include "util/inttypes.h"
+
+/**
+ * Streaming XXH64 hash, much faster than MD5 and good enough to compare
+ * file blocks (it's not a cryptographic hash).
+ */
+class XXHash64
+{
+public:
+  XXHash64(UINT64 seed = 0);
+
+  void update(const void *buf, size_t length);
+  XXHash64 &finalize();
+
+  /**
+   * Returns 8 byte hash in canonical (big endian) form.
+   */
+  const UINT8 *getHash() const;
+
+  static const size_t HASH_SIZE = 8;
+
+private:
+  static UINT64 round(UINT64 acc, UINT64 input);
+  static UINT64 mergeRound(UINT64 acc, UINT64 value);
+  static UINT64 readUInt64(const UINT8 *p);
+  static UINT32 readUInt32(const UINT8 *p);
+  static UINT64 rotateLeft(UINT64 x, int n);
+
+  void processStripe(const UINT8 *stripe);
+
+  static const size_t STRIPE_SIZE = 32;
+
+  UINT64 m_seed;
+  UINT64 m_acc[4];
+  UINT64 m_totalLength;
+
+  // Tail of input shorter than stripe.
+  UINT8 m_buffer[STRIPE_SIZE];
+  size_t m_bufferSize;
+
+  UINT8 m_hash[HASH_SIZE];
+  bool m_finalized;
+};
+
+#endif
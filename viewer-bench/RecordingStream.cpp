@@ -0,0 +1,242 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RecordingStream.h"
+
+#include "file-lib/EOFException.h"
+#include "file-lib/File.h"
+#include "file-lib/WinFileChannel.h"
+#include "io-lib/ByteArrayInputStream.h"
+#include "rfb/AuthDefs.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/MsgDefs.h"
+#include "rfb/SessionRecordingDefs.h"
+#include "util/Exception.h"
+
+#include <string.h>
+
+static const char DESKTOP_NAME[] = "viewer-bench";
+// A converted record takes fewer bytes than the record with its header, so
+// the stream fits in the size of the recording plus the handshake.
+static const size_t HANDSHAKE_RESERVE = 256;
+
+static size_t getStreamCapacity(const TCHAR *fileName)
+{
+  File file(fileName);
+  return (size_t)file.length() + HANDSHAKE_RESERVE;
+}
+
+RecordingStream::RecordingStream(const TCHAR *fileName)
+: m_buffer(getStreamCapacity(fileName)),
+  m_output(&m_buffer),
+  m_hasFormat(false),
+  m_updateRecords(0),
+  m_keyFrames(0),
+  m_duration(0),
+  m_isTruncated(false)
+{
+  memset(m_pixelFormat, 0, sizeof(m_pixelFormat));
+
+  WinFileChannel file(fileName, F_READ, FM_OPEN);
+  DataInputStream input(&file);
+  if (input.readUInt32() != SessionRecordingDefs::MAGIC) {
+    throw Exception(_T("The file is not a session recording"));
+  }
+  if (input.readUInt32() != SessionRecordingDefs::VERSION) {
+    throw Exception(_T("Unsupported version of the session recording"));
+  }
+  while (convertRecord(&input)) {
+  }
+  if (!m_hasFormat) {
+    throw Exception(_T("The session recording is empty"));
+  }
+}
+
+RecordingStream::~RecordingStream()
+{
+}
+
+const char *RecordingStream::getData() const
+{
+  return m_buffer.toByteArray();
+}
+
+size_t RecordingStream::getSize() const
+{
+  return m_buffer.size();
+}
+
+Dimension RecordingStream::getDimension() const
+{
+  return m_initialDim;
+}
+
+unsigned int RecordingStream::getUpdateRecords() const
+{
+  return m_updateRecords;
+}
+
+unsigned int RecordingStream::getKeyFrames() const
+{
+  return m_keyFrames;
+}
+
+UINT64 RecordingStream::getDuration() const
+{
+  return m_duration;
+}
+
+bool RecordingStream::isTruncated() const
+{
+  return m_isTruncated;
+}
+
+bool RecordingStream::convertRecord(DataInputStream *input)
+{
+  char header[SessionRecordingDefs::RECORD_HEADER_SIZE];
+  try {
+    input->readFully(header, sizeof(header));
+  } catch (EOFException &) {
+    return false;
+  }
+  ByteArrayInputStream headerStream(header, sizeof(header));
+  DataInputStream headerInput(&headerStream);
+  UINT8 type = headerInput.readUInt8();
+  UINT32 length = headerInput.readUInt32();
+  UINT64 time = headerInput.readUInt64();
+
+  m_record.resize(length);
+  try {
+    if (length != 0) {
+      input->readFully(&m_record.front(), length);
+    }
+  } catch (EOFException &) {
+    // The recording of a killed server ends with a partial record.
+    return false;
+  }
+  ByteArrayInputStream recordStream(length != 0 ? &m_record.front() : 0,
+                                    length);
+  DataInputStream record(&recordStream);
+
+  if (!m_hasFormat && (type == SessionRecordingDefs::UPDATE ||
+                       type == SessionRecordingDefs::KEYFRAME)) {
+    throw Exception(_T("The session recording does not start with a format"));
+  }
+  switch (type) {
+  case SessionRecordingDefs::FORMAT:
+    {
+      Dimension dim;
+      dim.width = record.readUInt16();
+      dim.height = record.readUInt16();
+      char pixelFormat[sizeof(m_pixelFormat)];
+      record.readFully(pixelFormat, sizeof(pixelFormat));
+      if (!m_hasFormat) {
+        memcpy(m_pixelFormat, pixelFormat, sizeof(m_pixelFormat));
+        m_initialDim = dim;
+        m_dim = dim;
+        m_hasFormat = true;
+        writeHandshake(pixelFormat);
+      } else if (memcmp(m_pixelFormat, pixelFormat,
+                        sizeof(m_pixelFormat)) != 0) {
+        m_isTruncated = true;
+        return false;
+      } else if (!m_dim.isEqualTo(&dim)) {
+        writeDesktopSize(&dim);
+      }
+    }
+    break;
+  case SessionRecordingDefs::UPDATE:
+    if (length != 0) {
+      m_output.writeFully(&m_record.front(), length);
+    }
+    m_updateRecords++;
+    break;
+  case SessionRecordingDefs::KEYFRAME:
+    writeKeyFrame(&record, length);
+    m_keyFrames++;
+    break;
+  default:
+    // Records of later versions may be skipped.
+    break;
+  }
+  m_duration = time;
+  return true;
+}
+
+void RecordingStream::writeHandshake(const char *format)
+{
+  m_output.writeFully("RFB 003.008\n", 12);
+  // One security type, None, and its result.
+  m_output.writeUInt8(1);
+  m_output.writeUInt8((UINT8)SecurityDefs::NONE);
+  m_output.writeUInt32(0);
+
+  // ServerInit.
+  m_output.writeUInt16((UINT16)m_dim.width);
+  m_output.writeUInt16((UINT16)m_dim.height);
+  m_output.writeFully(format, sizeof(m_pixelFormat));
+  m_output.writeUInt32((UINT32)strlen(DESKTOP_NAME));
+  m_output.writeFully(DESKTOP_NAME, strlen(DESKTOP_NAME));
+}
+
+void RecordingStream::writeKeyFrame(DataInputStream *input, UINT32 length)
+{
+  Dimension dim;
+  dim.width = input->readUInt16();
+  dim.height = input->readUInt16();
+  // The first byte of the pixel format is the number of bits per pixel.
+  size_t pixelSize = (UINT8)m_pixelFormat[0] / 8;
+  if ((size_t)dim.area() * pixelSize != length - 4) {
+    throw Exception(_T("Wrong keyframe size in the session recording"));
+  }
+  if (!m_dim.isEqualTo(&dim)) {
+    writeDesktopSize(&dim);
+  }
+
+  m_output.writeUInt8((UINT8)ServerMsgDefs::FB_UPDATE);
+  m_output.writeUInt8(0); // padding
+  m_output.writeUInt16(1);
+  m_output.writeUInt16(0);
+  m_output.writeUInt16(0);
+  m_output.writeUInt16((UINT16)dim.width);
+  m_output.writeUInt16((UINT16)dim.height);
+  m_output.writeUInt32((UINT32)EncodingDefs::RAW);
+  // The pixels follow the dimension in the record.
+  if (length > 4) {
+    m_output.writeFully(&m_record[4], length - 4);
+  }
+}
+
+void RecordingStream::writeDesktopSize(const Dimension *dim)
+{
+  m_dim = *dim;
+  m_output.writeUInt8((UINT8)ServerMsgDefs::FB_UPDATE);
+  m_output.writeUInt8(0); // padding
+  m_output.writeUInt16(1);
+  m_output.writeUInt16(0);
+  m_output.writeUInt16(0);
+  m_output.writeUInt16((UINT16)dim->width);
+  m_output.writeUInt16((UINT16)dim->height);
+  m_output.writeUInt32((UINT32)PseudoEncDefs::DESKTOP_SIZE);
+}
@@ -0,0 +1,87 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RECORDINGSTREAM_H__
+#define __RECORDINGSTREAM_H__
+
+#include "io-lib/ByteArrayOutputStream.h"
+#include "io-lib/DataInputStream.h"
+#include "io-lib/DataOutputStream.h"
+#include "region/Dimension.h"
+#include "util/StringStorage.h"
+
+#include <vector>
+
+// Converts a session recording (see SessionRecordingDefs) to the stream a
+// server would have sent to a viewer which connected at the start of the
+// recording with the None security type, so that RemoteViewerCore can read
+// it from memory. The updates are taken as recorded, a keyframe becomes an
+// update with a Raw rectangle of the whole frame buffer, and a change of the
+// size becomes a DesktopSize rectangle. The core cannot follow a change of
+// the pixel format it has not asked for, so the conversion stops there.
+class RecordingStream
+{
+public:
+  // Reads and converts the whole recording.
+  // Throws Exception if it cannot be read or does not start with a format.
+  RecordingStream(const TCHAR *fileName);
+  virtual ~RecordingStream();
+
+  const char *getData() const;
+  size_t getSize() const;
+
+  // Size of the frame buffer at the start.
+  Dimension getDimension() const;
+  // Number of the update and keyframe records converted.
+  unsigned int getUpdateRecords() const;
+  unsigned int getKeyFrames() const;
+  // Time of the last converted record in milliseconds.
+  UINT64 getDuration() const;
+  // Returns true if the conversion has stopped at a change of the pixel
+  // format before the end of the recording.
+  bool isTruncated() const;
+
+private:
+  // Returns false at the end of the recording or at a pixel format change.
+  bool convertRecord(DataInputStream *input);
+  void writeHandshake(const char *format);
+  void writeKeyFrame(DataInputStream *input, UINT32 length);
+  void writeDesktopSize(const Dimension *dim);
+
+  ByteArrayOutputStream m_buffer;
+  DataOutputStream m_output;
+  std::vector<char> m_record;
+
+  bool m_hasFormat;
+  // The pixel format of the first format record, as written in it.
+  char m_pixelFormat[16];
+  Dimension m_initialDim;
+  Dimension m_dim;
+  unsigned int m_updateRecords;
+  unsigned int m_keyFrames;
+  UINT64 m_duration;
+  bool m_isTruncated;
+};
+
+#endif // __RECORDINGSTREAM_H__
@@ -0,0 +1,220 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RenderBenchAdapter.h"
+
+#include "thread/AutoLock.h"
+
+RenderBenchAdapter::RenderBenchAdapter(HWND window, RenderMode mode)
+: m_window(window),
+  m_mode(mode),
+  m_core(0),
+  m_copyTime(0),
+  m_isModeApplied(mode == RENDER_MODE_GDI),
+  m_hasFailed(false),
+  m_frames(0),
+  m_uploadTime(0),
+  m_presentTime(0)
+{
+  QueryPerformanceFrequency(&m_perfFrequency);
+}
+
+RenderBenchAdapter::~RenderBenchAdapter()
+{
+}
+
+void RenderBenchAdapter::setCore(RemoteViewerCore *core)
+{
+  m_core = core;
+}
+
+WindowsEvent *RenderBenchAdapter::getEndEvent()
+{
+  return &m_endEvent;
+}
+
+bool RenderBenchAdapter::hasFailed(StringStorage *error)
+{
+  AutoLock al(&m_statsLock);
+  if (m_hasFailed) {
+    *error = m_error;
+  }
+  return m_hasFailed;
+}
+
+bool RenderBenchAdapter::isModeApplied()
+{
+  AutoLock al(&m_statsLock);
+  return m_isModeApplied;
+}
+
+UINT32 RenderBenchAdapter::getFrames()
+{
+  AutoLock al(&m_statsLock);
+  return m_frames;
+}
+
+UINT64 RenderBenchAdapter::getUploadTime()
+{
+  AutoLock al(&m_statsLock);
+  return m_uploadTime;
+}
+
+UINT64 RenderBenchAdapter::getPresentTime()
+{
+  AutoLock al(&m_statsLock);
+  return m_presentTime;
+}
+
+UINT32 RenderBenchAdapter::getUploadPercentile(unsigned int percent)
+{
+  AutoLock al(&m_statsLock);
+  return m_uploadLatency.getPercentile(percent);
+}
+
+UINT32 RenderBenchAdapter::getPresentPercentile(unsigned int percent)
+{
+  AutoLock al(&m_statsLock);
+  return m_presentLatency.getPercentile(percent);
+}
+
+void RenderBenchAdapter::onDisconnect(const StringStorage *message)
+{
+  // The end of the stream is reported as a lost connection.
+  m_endEvent.notify();
+}
+
+void RenderBenchAdapter::onError(const Exception *exception)
+{
+  setFailed(exception->getMessage());
+}
+
+void RenderBenchAdapter::onFrameBufferPropChange(const FrameBuffer *fb)
+{
+  Dimension dimension = fb->getDimension();
+  if (dimension.isEmpty()) {
+    return;
+  }
+  // Aligned the same way as the frame buffer of DesktopWindow.
+  dimension.width = (dimension.width + 3) / 4 * 4;
+  dimension.height = (dimension.height + 3) / 4 * 4;
+  try {
+    m_framebuffer.setProperties(&dimension, &fb->getPixelFormat(), m_window);
+    m_framebuffer.setColor(0, 0, 0);
+    if (m_mode != RENDER_MODE_GDI) {
+      bool isApplied = m_framebuffer.setRenderMode(m_mode);
+      AutoLock al(&m_statsLock);
+      m_isModeApplied = isApplied;
+    }
+  } catch (const Exception &ex) {
+    setFailed(ex.getMessage());
+  }
+  m_copiedRect.clear();
+  m_copyTime = 0;
+}
+
+bool RenderBenchAdapter::onFrameBufferCopy(const FrameBuffer *fb,
+                                           const Rect *dstRect,
+                                           int srcX, int srcY)
+{
+  LARGE_INTEGER start, end;
+  QueryPerformanceCounter(&start);
+  bool isMoved = false;
+  try {
+    isMoved = m_framebuffer.moveShown(dstRect, srcX, srcY);
+  } catch (const Exception &ex) {
+    setFailed(ex.getMessage());
+  }
+  QueryPerformanceCounter(&end);
+  if (isMoved) {
+    m_copiedRect = m_copiedRect.isEmpty() ? *dstRect
+                                          : m_copiedRect.unionRect(dstRect);
+    m_copyTime += getMicros(&start, &end);
+  }
+  return isMoved;
+}
+
+void RenderBenchAdapter::onFrameBufferUpdates(const FrameBuffer *fb,
+                                              const std::vector<Rect> *updates)
+{
+  // The upload is done as in DesktopWindow::updateFramebuffer(), and the
+  // bounds of the changes are then presented at once, as WM_PAINT would do
+  // for the invalidated rectangles.
+  LARGE_INTEGER start, uploaded, presented;
+  QueryPerformanceCounter(&start);
+  Rect bounds(&m_copiedRect);
+  try {
+    std::vector<Rect>::const_iterator iRect;
+    for (iRect = updates->begin(); iRect != updates->end(); iRect++) {
+      const Rect *rect = &(*iRect);
+      if (!m_framebuffer.uploadFrom(rect, fb)) {
+        m_framebuffer.copyFrom(rect, fb, rect->left, rect->top);
+      }
+      bounds = bounds.isEmpty() ? *rect : bounds.unionRect(rect);
+    }
+    QueryPerformanceCounter(&uploaded);
+    if (bounds.isEmpty()) {
+      return;
+    }
+    m_framebuffer.blitFromDibSection(&bounds);
+    QueryPerformanceCounter(&presented);
+  } catch (const Exception &ex) {
+    setFailed(ex.getMessage());
+    return;
+  }
+  if (m_core != 0) {
+    m_core->onFramePresented();
+  }
+
+  UINT64 uploadTime = getMicros(&start, &uploaded) + m_copyTime;
+  UINT64 presentTime = getMicros(&uploaded, &presented);
+  m_copiedRect.clear();
+  m_copyTime = 0;
+
+  AutoLock al(&m_statsLock);
+  m_frames++;
+  m_uploadTime += uploadTime;
+  m_presentTime += presentTime;
+  m_uploadLatency.add(uploadTime > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)uploadTime);
+  m_presentLatency.add(presentTime > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)presentTime);
+}
+
+UINT64 RenderBenchAdapter::getMicros(const LARGE_INTEGER *start,
+                                     const LARGE_INTEGER *end) const
+{
+  return (UINT64)(end->QuadPart - start->QuadPart) * 1000000 /
+         (UINT64)m_perfFrequency.QuadPart;
+}
+
+void RenderBenchAdapter::setFailed(const TCHAR *error)
+{
+  {
+    AutoLock al(&m_statsLock);
+    if (!m_hasFailed) {
+      m_hasFailed = true;
+      m_error.setString(error);
+    }
+  }
+  m_endEvent.notify();
+}
@@ -0,0 +1,103 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __RENDERBENCHADAPTER_H__
+#define __RENDERBENCHADAPTER_H__
+
+#include "gui/DibFrameBuffer.h"
+#include "thread/LocalMutex.h"
+#include "util/LatencyHistogram.h"
+#include "viewer-core/CoreEventsAdapter.h"
+#include "viewer-core/RemoteViewerCore.h"
+#include "win-system/WindowsEvent.h"
+
+// Shows the updates of RemoteViewerCore in a window the way DesktopWindow
+// does, through a DibFrameBuffer in the given render mode, but right in the
+// thread of the notifications instead of on WM_PAINT, and times the upload
+// of the pixels to the renderer and the presenting of them to the window.
+class RenderBenchAdapter : public CoreEventsAdapter
+{
+public:
+  // The window must stay until the core is stopped.
+  RenderBenchAdapter(HWND window, RenderMode mode);
+  virtual ~RenderBenchAdapter();
+
+  // Sets the core to be told about the presented frames.
+  void setCore(RemoteViewerCore *core);
+
+  // Signalled when the core has read all the stream or has failed.
+  WindowsEvent *getEndEvent();
+  // Returns true and the reason if the core or the renderer has failed.
+  bool hasFailed(StringStorage *error);
+  // Returns false if the render mode could not be set, then the frames are
+  // rendered with GDI.
+  bool isModeApplied();
+
+  // Number of the update notifications presented, and the sums and the
+  // percentiles of the upload and present time per notification, in
+  // microseconds.
+  UINT32 getFrames();
+  UINT64 getUploadTime();
+  UINT64 getPresentTime();
+  UINT32 getUploadPercentile(unsigned int percent);
+  UINT32 getPresentPercentile(unsigned int percent);
+
+protected:
+  virtual void onDisconnect(const StringStorage *message);
+  virtual void onError(const Exception *exception);
+  virtual void onFrameBufferPropChange(const FrameBuffer *fb);
+  virtual bool onFrameBufferCopy(const FrameBuffer *fb, const Rect *dstRect,
+                                 int srcX, int srcY);
+  virtual void onFrameBufferUpdates(const FrameBuffer *fb,
+                                    const std::vector<Rect> *updates);
+
+private:
+  UINT64 getMicros(const LARGE_INTEGER *start, const LARGE_INTEGER *end) const;
+  void setFailed(const TCHAR *error);
+
+  HWND m_window;
+  RenderMode m_mode;
+  RemoteViewerCore *m_core;
+  LARGE_INTEGER m_perfFrequency;
+  WindowsEvent m_endEvent;
+
+  // Used by the notification thread only.
+  DibFrameBuffer m_framebuffer;
+  // Copies moved by the renderer since the last presented frame, and the
+  // time spent on them.
+  Rect m_copiedRect;
+  UINT64 m_copyTime;
+
+  LocalMutex m_statsLock;
+  bool m_isModeApplied;
+  bool m_hasFailed;
+  StringStorage m_error;
+  UINT32 m_frames;
+  UINT64 m_uploadTime;
+  UINT64 m_presentTime;
+  LatencyHistogram m_uploadLatency;
+  LatencyHistogram m_presentLatency;
+};
+
+#endif // __RENDERBENCHADAPTER_H__
@@ -0,0 +1,232 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RecordingStream.h"
+#include "RenderBenchAdapter.h"
+
+#include "io-lib/ByteArrayInputStream.h"
+#include "io-lib/OutputStream.h"
+#include "network/RfbInputGate.h"
+#include "network/RfbOutputGate.h"
+#include "util/Exception.h"
+#include "viewer-core/RemoteViewerCore.h"
+#include "win-system/SystemException.h"
+
+#include <stdio.h>
+#include <vector>
+
+struct BenchOptions
+{
+  BenchOptions()
+  : isOffscreen(false)
+  {
+  }
+
+  StringStorage fileName;
+  std::vector<RenderMode> modes;
+  bool isOffscreen;
+};
+
+// The core sends the update requests to the server as usual, there is no
+// one to read them.
+class NullOutputStream : public OutputStream
+{
+public:
+  virtual size_t write(const void *buffer, size_t len)
+  {
+    return len;
+  }
+};
+
+static void printUsage()
+{
+  _ftprintf(stderr,
+    _T("Usage: viewer-bench <recording> [options]\n")
+    _T("  -mode <mode>  renderer: gdi, d2d or both (both)\n")
+    _T("  -offscreen    render to a hidden window\n"));
+}
+
+static bool parseOptions(int argc, TCHAR *argv[], BenchOptions *options)
+{
+  if (argc < 2 || argv[1][0] == _T('-')) {
+    return false;
+  }
+  options->fileName.setString(argv[1]);
+  bool hasMode = false;
+  for (int i = 2; i < argc; i++) {
+    const TCHAR *option = argv[i];
+    if (_tcscmp(option, _T("-offscreen")) == 0) {
+      options->isOffscreen = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const TCHAR *value = argv[++i];
+    if (_tcscmp(option, _T("-mode")) == 0) {
+      hasMode = true;
+      if (_tcsicmp(value, _T("gdi")) == 0) {
+        options->modes.push_back(RENDER_MODE_GDI);
+      } else if (_tcsicmp(value, _T("d2d")) == 0) {
+        options->modes.push_back(RENDER_MODE_DIRECT2D);
+      } else if (_tcsicmp(value, _T("both")) == 0) {
+        options->modes.push_back(RENDER_MODE_GDI);
+        options->modes.push_back(RENDER_MODE_DIRECT2D);
+      } else {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (!hasMode) {
+    options->modes.push_back(RENDER_MODE_GDI);
+    options->modes.push_back(RENDER_MODE_DIRECT2D);
+  }
+  return true;
+}
+
+static double perSecond(double count, UINT64 micros)
+{
+  return micros != 0 ? count * 1000000.0 / (double)micros : 0.0;
+}
+
+static double average(UINT64 total, UINT32 count)
+{
+  return count != 0 ? (double)total / (double)count : 0.0;
+}
+
+// Processes the messages of the window of this thread until the event is
+// signalled.
+static void waitWithMessages(WindowsEvent *event)
+{
+  HANDLE handle = event->getHandle();
+  while (MsgWaitForMultipleObjects(1, &handle, FALSE, INFINITE,
+                                   QS_ALLINPUT) != WAIT_OBJECT_0) {
+    MSG msg;
+    while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+      TranslateMessage(&msg);
+      DispatchMessage(&msg);
+    }
+  }
+}
+
+// Decodes and renders the whole stream in the mode with a new core and
+// prints a line of the results.
+static void runMode(const RecordingStream *recording, RenderMode mode,
+                    bool isOffscreen)
+{
+  const TCHAR *modeName = mode == RENDER_MODE_DIRECT2D ? _T("d2d") : _T("gdi");
+  Dimension dim = recording->getDimension();
+  HWND window = CreateWindowEx(WS_EX_TOOLWINDOW, _T("STATIC"),
+                               _T("viewer-bench"),
+                               WS_POPUP | (isOffscreen ? 0 : WS_VISIBLE),
+                               0, 0, dim.width, dim.height,
+                               0, 0, GetModuleHandle(0), 0);
+  if (window == 0) {
+    throw SystemException(_T("Cannot create the window"));
+  }
+
+  ByteArrayInputStream stream(recording->getData(), recording->getSize());
+  NullOutputStream sink;
+  RfbInputGate input(&stream);
+  RfbOutputGate output(&sink);
+  RenderBenchAdapter adapter(window, mode);
+
+  UINT32 fbUpdates;
+  UINT64 pixels;
+  UINT64 decodeTime;
+  LARGE_INTEGER frequency, start, end;
+  QueryPerformanceFrequency(&frequency);
+  {
+    RemoteViewerCore core;
+    adapter.setCore(&core);
+    QueryPerformanceCounter(&start);
+    core.start(&input, &output, &adapter, true);
+    waitWithMessages(adapter.getEndEvent());
+    QueryPerformanceCounter(&end);
+    fbUpdates = core.getFbUpdatesReceived();
+    core.getDecodeTotals(&pixels, &decodeTime);
+    core.stop();
+    core.waitTermination();
+  }
+  DestroyWindow(window);
+
+  UINT64 wallTime = (UINT64)(end.QuadPart - start.QuadPart) * 1000000 /
+                    (UINT64)frequency.QuadPart;
+  UINT32 frames = adapter.getFrames();
+  _tprintf(_T("%-5s %8u %8u %9.1f %9.1f %9.1f %8.1f %6u/%6u %8.1f %6u/%6u"),
+           modeName, fbUpdates, frames,
+           (double)wallTime / 1000.0,
+           perSecond((double)pixels / 1000000.0, wallTime),
+           perSecond((double)pixels / 1000000.0, decodeTime),
+           average(adapter.getUploadTime(), frames),
+           adapter.getUploadPercentile(50), adapter.getUploadPercentile(95),
+           average(adapter.getPresentTime(), frames),
+           adapter.getPresentPercentile(50), adapter.getPresentPercentile(95));
+  StringStorage error;
+  if (adapter.hasFailed(&error)) {
+    _tprintf(_T("  failed: %s\n"), error.getString());
+  } else if (!adapter.isModeApplied()) {
+    _tprintf(_T("  %s is not available, rendered with gdi\n"), modeName);
+  } else {
+    _tprintf(_T("\n"));
+  }
+}
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  BenchOptions options;
+  if (!parseOptions(argc, argv, &options)) {
+    printUsage();
+    return 1;
+  }
+
+  try {
+    RecordingStream recording(options.fileName.getString());
+    Dimension dim = recording.getDimension();
+    _tprintf(_T("# %dx%d, %.1f s, %u updates, %u keyframes, %.1f MB\n"),
+             dim.width, dim.height,
+             (double)recording.getDuration() / 1000.0,
+             recording.getUpdateRecords(), recording.getKeyFrames(),
+             (double)recording.getSize() / (1024.0 * 1024.0));
+    if (recording.isTruncated()) {
+      _tprintf(_T("# the pixel format changes, played up to the change\n"));
+    }
+
+    // Upload and present are per presented notification, in microseconds,
+    // the decoding rate counts the time spent in the decoders only.
+    _tprintf(_T("%-5s %8s %8s %9s %9s %9s %8s %13s %8s %13s\n"),
+             _T("mode"), _T("updates"), _T("frames"), _T("wall_ms"),
+             _T("MP/s"), _T("dec_MP/s"), _T("upload"), _T("p50/p95"),
+             _T("present"), _T("p50/p95"));
+    for (size_t i = 0; i < options.modes.size(); i++) {
+      runMode(&recording, options.modes[i], options.isOffscreen);
+    }
+  } catch (Exception &e) {
+    _ftprintf(stderr, _T("Error: %s\n"), e.getMessage());
+    return 1;
+  }
+  return 0;
+}
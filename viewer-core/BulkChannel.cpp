@@ -0,0 +1,149 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "BulkChannel.h"
+
+#include "rfb/TunnelDefs.h"
+#include "rfb/VendorDefs.h"
+
+#include "AuthHandler.h"
+#include "CapsContainer.h"
+
+BulkChannel::BulkChannel(const TCHAR *host, UINT16 port,
+                         const SocketProfile *socketProfile,
+                         const UINT8 *token,
+                         BulkChannelListener *listener,
+                         LogWriter *logWriter)
+: m_connection(logWriter),
+  m_listener(listener),
+  m_logWriter(logWriter)
+{
+  memcpy(m_token, token, sizeof(m_token));
+  m_connection.bind(host, port);
+  m_connection.setSocketProfile(socketProfile);
+}
+
+BulkChannel::~BulkChannel()
+{
+  terminate();
+  wait();
+}
+
+void BulkChannel::close()
+{
+  m_connection.close();
+}
+
+void BulkChannel::onTerminate()
+{
+  close();
+}
+
+void BulkChannel::execute()
+{
+  try {
+    m_logWriter->detail(_T("Opening the bulk channel..."));
+    m_connection.connect();
+    RfbInputGate *input = m_connection.getInput();
+    RfbOutputGate *output = m_connection.getOutput();
+    handshake(input, output);
+    m_logWriter->info(_T("Bulk channel is open"));
+
+    m_listener->onBulkChannelConnected(output);
+    while (!isTerminating()) {
+      UINT32 msgType = readMessageType(input);
+      m_listener->onBulkChannelMessage(msgType, input);
+    }
+    m_listener->onBulkChannelClosed(_T("The bulk channel is closed"));
+  } catch (const Exception &ex) {
+    m_logWriter->info(_T("Bulk channel is closed: %s"), ex.getMessage());
+    m_listener->onBulkChannelClosed(ex.getMessage());
+  }
+}
+
+void BulkChannel::handshake(RfbInputGate *input, RfbOutputGate *output)
+{
+  // The version of the server is known from the main connection.
+  char serverVersion[12];
+  input->readFully(serverVersion, sizeof(serverVersion));
+  output->writeFully(BulkChannelDefs::GREETING, BulkChannelDefs::GREETING_LENGTH);
+  output->flush();
+  readResult(input);
+
+  // The tunnel is negotiated as in the Tight security type.
+  UINT32 tunnelCount = input->readUInt32();
+  if (tunnelCount > 0) {
+    bool hasTls = false;
+    for (UINT32 i = 0; i < tunnelCount; i++) {
+      RfbCapabilityInfo cap;
+      cap.code = input->readUInt32();
+      input->readFully(cap.vendorSignature, RfbCapabilityInfo::vendorSigSize);
+      input->readFully(cap.nameSignature, RfbCapabilityInfo::nameSigSize);
+      if (cap.isEqual(VendorDefs::TIGHTVNC, TunnelDefs::SIG_TLS)) {
+        hasTls = true;
+      }
+    }
+    if (hasTls) {
+      output->writeUInt32(TunnelDefs::TLS);
+      output->flush();
+      m_connection.startTls();
+    } else {
+      output->writeUInt32(TunnelDefs::NOTUNNEL);
+      output->flush();
+    }
+  }
+
+  output->writeFully(m_token, sizeof(m_token));
+  output->flush();
+  readResult(input);
+}
+
+void BulkChannel::readResult(RfbInputGate *input)
+{
+  UINT32 result = input->readUInt32();
+  if (result != BulkChannelDefs::RESULT_OK) {
+    StringStorage reason;
+    input->readUTF8(&reason);
+    StringStorage errorMessage;
+    errorMessage.format(_T("The server refuses the bulk channel: %s"),
+                        reason.getString());
+    throw AuthException(errorMessage.getString());
+  }
+}
+
+UINT32 BulkChannel::readMessageType(RfbInputGate *input)
+{
+  // Messages of the extensions have the 0xFC prefix and four bytes of the
+  // type, see RemoteViewerCore::receiveServerMessageType().
+  static const UINT16 SERVER_MSG_SPECIAL_TIGHT_CODE = 0xFC;
+
+  UINT32 msgType = input->readUInt8();
+  if (msgType == SERVER_MSG_SPECIAL_TIGHT_CODE) {
+    for (int i = 0; i < 3; i++) {
+      msgType <<= 8;
+      msgType += input->readUInt8();
+    }
+  }
+  return msgType;
+}
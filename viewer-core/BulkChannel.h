@@ -0,0 +1,91 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _BULK_CHANNEL_H_
+#define _BULK_CHANNEL_H_
+
+#include "log-writer/LogWriter.h"
+#include "network/RfbInputGate.h"
+#include "network/RfbOutputGate.h"
+#include "network/socket/SocketProfile.h"
+#include "rfb/MsgDefs.h"
+#include "thread/Thread.h"
+
+#include "TcpConnection.h"
+
+// Receiver of the events of BulkChannel, called by its thread.
+class BulkChannelListener
+{
+public:
+  virtual ~BulkChannelListener() {}
+
+  // The channel is ready, messages can be sent to output.
+  virtual void onBulkChannelConnected(RfbOutputGate *output) = 0;
+  // A message of the server has been received, its body is to be read
+  // from input.
+  virtual void onBulkChannelMessage(UINT32 msgType, RfbInputGate *input) = 0;
+  // The channel is closed or could not be made.
+  virtual void onBulkChannelClosed(const TCHAR *reason) = 0;
+};
+
+//
+// Second connection to the server, carrying the file transfer and the
+// clipboard chunks besides the main connection (see BulkChannelDefs).
+// The thread connects to the server, passes the token and then reads the
+// messages of the server until the connection is closed.
+//
+class BulkChannel : public Thread
+{
+public:
+  BulkChannel(const TCHAR *host, UINT16 port,
+              const SocketProfile *socketProfile,
+              const UINT8 *token,
+              BulkChannelListener *listener,
+              LogWriter *logWriter);
+  virtual ~BulkChannel();
+
+  // Closes the connection, the thread exits then.
+  void close();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // Passes the greeting, the tunnel and the token to the server.
+  // @throws Exception if the server refuses the channel.
+  void handshake(RfbInputGate *input, RfbOutputGate *output);
+  // Reads the status of the server and throws an AuthException with the
+  // reason if it is an error.
+  void readResult(RfbInputGate *input);
+  UINT32 readMessageType(RfbInputGate *input);
+
+  TcpConnection m_connection;
+  UINT8 m_token[BulkChannelDefs::TOKEN_LENGTH];
+
+  BulkChannelListener *m_listener;
+  LogWriter *m_logWriter;
+};
+
+#endif
@@ -24,6 +24,8 @@
 
 #include "CopyRectDecoder.h"
 
+#include "FbUpdateNotifier.h"
+
 CopyRectDecoder::CopyRectDecoder(LogWriter *logWriter)
 : DecoderOfRectangle(logWriter)
 {
@@ -34,6 +36,19 @@ CopyRectDecoder::~CopyRectDecoder()
 {
 }
 
+void CopyRectDecoder::process(RfbInputGate *input,
+                              FrameBuffer *frameBuffer,
+                              FrameBuffer *secondFrameBuffer,
+                              const Rect *rect,
+                              LocalMutex *fbLock,
+                              FbUpdateNotifier *fbNotifier)
+{
+  decode(input, secondFrameBuffer, rect);
+  AutoLock al(fbLock);
+  copy(frameBuffer, secondFrameBuffer, rect, fbLock);
+  fbNotifier->onCopy(rect, &m_sourcePosition);
+}
+
 void CopyRectDecoder::decode(RfbInputGate *input,
                              FrameBuffer *frameBuffer,
                              const Rect *dstRect)
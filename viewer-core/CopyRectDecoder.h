@@ -35,6 +35,18 @@ public:
   CopyRectDecoder(LogWriter *logWriter);
   virtual ~CopyRectDecoder();
 
+  //
+  // This method inherited by DecoderOfRectangle. The rectangle is moved and
+  // fbNotifier is told about the copy under the same lock, so that the
+  // application can move the image it presents the same way.
+  //
+  virtual void process(RfbInputGate *input,
+                       FrameBuffer *frameBuffer,
+                       FrameBuffer *secondFrameBuffer,
+                       const Rect *rect,
+                       LocalMutex *fbLock,
+                       FbUpdateNotifier *fbNotifier);
+
 protected:
   //
   // This method inherited by DecoderOfRectangle.
@@ -38,6 +38,11 @@ void CoreEventsAdapter::onCutText(const StringStorage *cutText)
 {
 }
 
+bool CoreEventsAdapter::onCutTextOffer(UINT32 length)
+{
+  return true;
+}
+
 void CoreEventsAdapter::onEstablished()
 {
 }
@@ -46,6 +51,10 @@ void CoreEventsAdapter::onConnected(RfbOutputGate *output)
 {
 }
 
+void CoreEventsAdapter::onBulkChannel(RfbOutputGate *output)
+{
+}
+
 void CoreEventsAdapter::onDisconnect(const StringStorage *message)
 {
 }
@@ -64,6 +73,35 @@ void CoreEventsAdapter::onFrameBufferUpdate(const FrameBuffer *fb,
 {
 }
 
+void CoreEventsAdapter::onFrameBufferUpdates(const FrameBuffer *fb,
+                                             const std::vector<Rect> *updates)
+{
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = updates->begin(); iRect != updates->end(); iRect++) {
+    onFrameBufferUpdate(fb, &(*iRect));
+  }
+}
+
 void CoreEventsAdapter::onFrameBufferPropChange(const FrameBuffer *fb)
 {
 }
+
+bool CoreEventsAdapter::onFrameBufferCopy(const FrameBuffer *fb,
+                                          const Rect *dstRect,
+                                          int srcX, int srcY)
+{
+  return false;
+}
+
+bool CoreEventsAdapter::onFrameBufferOverlay(const FrameBuffer *image,
+                                             const Rect *rect)
+{
+  return false;
+}
+
+bool CoreEventsAdapter::onCursorOverlay(const FrameBuffer *image,
+                                        const Rect *rect,
+                                        bool imageChanged)
+{
+  return false;
+}
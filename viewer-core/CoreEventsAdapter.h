@@ -33,6 +33,8 @@
 #include "region/Rect.h"
 #include "util/Exception.h"
 
+#include <vector>
+
 #include "AuthHandler.h"
 
 //
@@ -63,6 +65,14 @@ public:
   //
   virtual void onCutText(const StringStorage *cutText);
 
+  //
+  // The server has a new clipboard of length bytes (in UTF-8) and sends it
+  // on demand. Return true to fetch it at once, or false to fetch it later
+  // with RemoteViewerCore::requestCutText(). By default, it is fetched at
+  // once.
+  //
+  virtual bool onCutTextOffer(UINT32 length);
+
   //
   // Connection has been established.
   //
@@ -76,6 +86,13 @@ public:
   // Output need for capability, e.g. FT.
   virtual void onConnected(RfbOutputGate *output);
 
+  //
+  // The file transfer messages must be sent to output from now on: the
+  // output of the bulk channel once it is open, the one of onConnected()
+  // again if the bulk channel is lost. Called by another thread.
+  //
+  virtual void onBulkChannel(RfbOutputGate *output);
+
   //
   // RemoteViewerCore has been disconnected by calling stop()
   // or connection with server is disconnected.
@@ -104,6 +121,15 @@ public:
   //
   virtual void onFrameBufferUpdate(const FrameBuffer *fb, const Rect *update);
 
+  // All the rectangles changed since the previous notification are passed
+  // at once, so that the application can present them together. The frame
+  // buffer is locked during this callback as well.
+  //
+  // By default, calls onFrameBufferUpdate() for each of the rectangles.
+  //
+  virtual void onFrameBufferUpdates(const FrameBuffer *fb,
+                                    const std::vector<Rect> *updates);
+
   // changed properties of frame buffer.
   // In this moment frame buffer area is dirty and may be contained incorrect data
   //
@@ -112,6 +138,49 @@ public:
   // notification will be called on initial frame buffer allocation as well.
   //
   virtual void onFrameBufferPropChange(const FrameBuffer *fb);
+
+  //
+  // The rectangle dstRect of the frame buffer has been copied from the one
+  // with the top-left corner at (srcX, srcY) (CopyRect encoding). Return
+  // true if the application has moved the image it presents the same way,
+  // which is only possible if it is up to date there; onFrameBufferCopy()
+  // is called only if the source has not changed since the last update
+  // notification. The copies are passed in order, before the update
+  // notification of the rectangles changed after them. The frame buffer
+  // is locked during this callback.
+  //
+  // By default, returns false and dstRect is passed to the update
+  // notification.
+  //
+  virtual bool onFrameBufferCopy(const FrameBuffer *fb, const Rect *dstRect,
+                                 int srcX, int srcY);
+
+  //
+  // The image (in the standard 32-bit format, with alpha) must be shown over
+  // the rectangle of the frame buffer. Return true if the application blends
+  // it on its own when presenting the frame buffer, then the frame buffer is
+  // left unchanged. The same image is passed again before each update
+  // notification, it only changes together with the rectangle.
+  //
+  // By default, returns false and the image is drawn into the frame buffer
+  // for the time of every update notification that it intersects.
+  //
+  virtual bool onFrameBufferOverlay(const FrameBuffer *image, const Rect *rect);
+
+  //
+  // The cursor (in the standard 32-bit format, with premultiplied alpha) must
+  // be shown at the rectangle of the frame buffer, an empty rectangle hides
+  // it. imageChanged is false if the image is the same as in the previous
+  // call. Return true if the application draws the cursor on its own over
+  // the frame buffer when presenting it, then the frame buffer is left
+  // unchanged and the application must repaint the old and the new place of
+  // the cursor itself. Called before each update notification.
+  //
+  // By default, returns false and the cursor is painted into the frame buffer
+  // for the time of every update notification.
+  //
+  virtual bool onCursorOverlay(const FrameBuffer *image, const Rect *rect,
+                               bool imageChanged);
 };
 
 #endif
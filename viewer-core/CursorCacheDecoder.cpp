@@ -0,0 +1,86 @@
+// Copyright (C) 2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "CursorCacheDecoder.h"
+#include "RichCursorDecoder.h"
+
+CursorCacheDecoder::CursorCacheDecoder(LogWriter *logWriter)
+: PseudoDecoder(logWriter),
+  m_slots(NUM_SLOTS)
+{
+  m_encoding = PseudoEncDefs::CURSOR_CACHE;
+}
+
+CursorCacheDecoder::~CursorCacheDecoder()
+{
+}
+
+void CursorCacheDecoder::clearSlots()
+{
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    m_slots[i] = Slot();
+  }
+}
+
+void CursorCacheDecoder::readShape(RfbInputGate *input, const Rect *rect,
+                                   UINT8 bytesPerPixel,
+                                   std::vector<UINT8> *cursor,
+                                   std::vector<UINT8> *bitmask)
+{
+  UINT8 operation = input->readUInt8();
+  UINT16 slotNumber = input->readUInt16();
+
+  if ((operation & RESET_CACHE) != 0) {
+    clearSlots();
+  }
+  operation &= ~RESET_CACHE;
+
+  if (operation != OP_HIT && operation != OP_STORE) {
+    throw Exception(_T("Error in protocol: unknown operation %d (cursor-cache-decoder)"),
+                    (int)operation);
+  }
+  if (slotNumber >= NUM_SLOTS) {
+    throw Exception(_T("Error in protocol: incorrect slot %d (cursor-cache-decoder)"),
+                    (int)slotNumber);
+  }
+
+  UINT16 width = rect->getWidth();
+  UINT16 height = rect->getHeight();
+  Slot *slot = &m_slots[slotNumber];
+  if (operation == OP_STORE) {
+    RichCursorDecoder::readShape(input, width, height, bytesPerPixel,
+                                 &slot->cursor, &slot->bitmask);
+    slot->used = true;
+    slot->width = width;
+    slot->height = height;
+  } else if (!slot->used || slot->width != width || slot->height != height) {
+    throw Exception(_T("Error in protocol: empty slot %d (cursor-cache-decoder)"),
+                    (int)slotNumber);
+  } else {
+    m_logWriter->debug(_T("Cursor shape is taken from the cache slot %d"),
+                       (int)slotNumber);
+  }
+  *cursor = slot->cursor;
+  *bitmask = slot->bitmask;
+}
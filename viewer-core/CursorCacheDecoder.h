@@ -0,0 +1,74 @@
+// Copyright (C) 2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _CURSOR_CACHE_DECODER_H_
+#define _CURSOR_CACHE_DECODER_H_
+
+#include "PseudoDecoder.h"
+
+#include <vector>
+
+//
+// CursorCacheDecoder reads cursor cache pseudo-rectangles. It keeps
+// NUM_SLOTS cursor shapes the server asks to store, so a shape the
+// viewer has already seen is referred to by its slot number instead of
+// being sent again. The server decides which slot to replace.
+//
+class CursorCacheDecoder : public PseudoDecoder
+{
+public:
+  CursorCacheDecoder(LogWriter *logWriter);
+  virtual ~CursorCacheDecoder();
+
+  //
+  // Reads the pseudo-rectangle data following its header and fills cursor
+  // and bitmask with the shape to show, like a rich cursor one.
+  //
+  void readShape(RfbInputGate *input, const Rect *rect, UINT8 bytesPerPixel,
+                 std::vector<UINT8> *cursor, std::vector<UINT8> *bitmask);
+
+protected:
+  static const int NUM_SLOTS = 32;
+
+  static const UINT8 OP_HIT = 0;
+  static const UINT8 OP_STORE = 1;
+  static const UINT8 RESET_CACHE = 0x80;
+
+  struct Slot
+  {
+    Slot() : used(false), width(0), height(0) {}
+
+    bool used;
+    UINT16 width;
+    UINT16 height;
+    std::vector<UINT8> cursor;
+    std::vector<UINT8> bitmask;
+  };
+
+  void clearSlots();
+
+  std::vector<Slot> m_slots;
+};
+
+#endif
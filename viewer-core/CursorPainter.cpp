@@ -24,6 +24,8 @@
 
 #include "CursorPainter.h"
 
+#include "rfb/PixelConverter.h"
+#include "rfb/StandardPixelFormatFactory.h"
 #include "thread/AutoLock.h"
 
 CursorPainter::CursorPainter(FrameBuffer *fb, LogWriter *logWriter)
@@ -31,7 +33,9 @@ CursorPainter::CursorPainter(FrameBuffer *fb, LogWriter *logWriter)
   m_logWriter(logWriter),
   m_cursorIsMoveable(false),
   m_ignoreShapeUpdates(false),
-  m_isExist(false)
+  m_isExist(false),
+  m_isPredicted(false),
+  m_shapeId(1)
 {
 }
 
@@ -42,12 +46,33 @@ CursorPainter::~CursorPainter()
 void CursorPainter::updatePointerPos(const Point *position)
 {
   AutoLock al(&m_lock);
+  if (m_isPredicted) {
+    if (position->isEqualTo(&m_pointerPosition)) {
+      // The server has caught up.
+      m_isPredicted = false;
+      return;
+    }
+    if ((DateTime::now() - m_lastPredictionTime).getTime() <
+        PREDICTION_TIMEOUT) {
+      return;
+    }
+    m_isPredicted = false;
+  }
   m_pointerPosition = *position;
   m_cursorIsMoveable = true;
 
   // Now, cursor is ready for painting.
 }
 
+void CursorPainter::predictPointerPos(const Point *position)
+{
+  AutoLock al(&m_lock);
+  m_pointerPosition = *position;
+  m_cursorIsMoveable = true;
+  m_isPredicted = true;
+  m_lastPredictionTime = DateTime::now();
+}
+
 void CursorPainter::setNewCursor(const Point *hotSpot,
                                  UINT16 width, UINT16 height,
                                  const vector<UINT8> *cursor,
@@ -63,6 +88,9 @@ void CursorPainter::setNewCursor(const Point *hotSpot,
 
   m_cursor.setProperties(&cursorDimension, &pixelFormat);
   m_cursorOverlay.setProperties(&cursorDimension, &pixelFormat);
+  if (++m_shapeId == 0) {
+    m_shapeId = 1;
+  }
 
   size_t pixelSize = m_fb->getBytesPerPixel();
   size_t cursorSize = width * height * pixelSize;
@@ -140,6 +168,44 @@ Rect CursorPainter::showCursor()
   return Rect();
 }
 
+Rect CursorPainter::getOverlay(FrameBuffer *image, UINT32 *shapeId)
+{
+  AutoLock al(&m_lock);
+
+  Dimension dim = m_cursor.getDimension();
+  if (*shapeId != m_shapeId) {
+    PixelFormat imagePf = StandardPixelFormatFactory::create32bppPixelFormat();
+    image->setProperties(&dim, &imagePf);
+    if (dim.area() != 0) {
+      Rect rect = dim.getRect();
+      PixelConverter converter;
+      PixelFormat cursorPf = m_cursor.getPixelFormat();
+      converter.setPixelFormats(&imagePf, &cursorPf);
+      converter.convert(&rect, image, m_cursor.getPixels());
+
+      const char *mask = m_cursor.getMask();
+      int maskBytesPerRow = m_cursor.getMaskWidthInBytes();
+      for (int iRow = 0; iRow < dim.height; iRow++) {
+        UINT32 *pixels = (UINT32 *)image->getBufferPtr(0, iRow);
+        const char *maskRow = mask + iRow * maskBytesPerRow;
+        for (int iCol = 0; iCol < dim.width; iCol++) {
+          bool andBit = (maskRow[iCol / 8] & 128 >> iCol % 8) != 0;
+          pixels[iCol] = andBit ? pixels[iCol] | 0xFF000000 : 0;
+        }
+      }
+    }
+    *shapeId = m_shapeId;
+  }
+
+  if (m_ignoreShapeUpdates || !m_cursorIsMoveable || dim.area() == 0) {
+    return Rect();
+  }
+  Point corner = getUpperLeftPoint(&m_pointerPosition);
+  Rect overlayRect = dim.getRect();
+  overlayRect.move(corner.x, corner.y);
+  return overlayRect;
+}
+
 Point CursorPainter::getUpperLeftPoint(const Point *position) const
 {
   Point upperLeftPoint = *position;
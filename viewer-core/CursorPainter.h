@@ -28,6 +28,7 @@
 #include "log-writer/LogWriter.h"
 #include "rfb/CursorShape.h"
 #include "thread/LocalMutex.h"
+#include "util/DateTime.h"
 
 class CursorPainter
 {
@@ -39,9 +40,25 @@ public:
   Rect hideCursor();
   Rect showCursor();
 
+  // Gives the cursor for drawing it over the frame buffer by the application,
+  // instead of painting it into the frame buffer. If the shape has changed
+  // since *shapeId, copies it to image in the standard 32-bit format with
+  // premultiplied alpha (the pixels out of the mask are fully transparent)
+  // and updates *shapeId. Returns the rectangle of the cursor in the frame
+  // buffer, empty if the cursor must not be shown.
+  // This function is thread-safe and doesn't access the frame buffer.
+  Rect getOverlay(FrameBuffer *image, UINT32 *shapeId);
+
   // this functions is thread-safe
   void setIgnoreShapeUpdates(bool ignore);
+  // Sets the position of the pointer reported by the server. The position
+  // is ignored while the local prediction holds.
   void updatePointerPos(const Point *position);
+  // Moves the pointer to the position sent by the viewer, before the server
+  // reports it. The prediction holds until the server reports the same
+  // position or for PREDICTION_TIMEOUT after the last local move, so stale
+  // positions of a slow server don't pull the cursor back.
+  void predictPointerPos(const Point *position);
   void setNewCursor(const Point *hotSpot,
                     UINT16 width, UINT16 height,
                     const vector<UINT8> *cursor, 
@@ -74,6 +91,15 @@ private:
 
   bool m_ignoreShapeUpdates;
 
+  // Changes on every setNewCursor(), never zero.
+  UINT32 m_shapeId;
+
+  // Flag is set while the local prediction holds.
+  bool m_isPredicted;
+  DateTime m_lastPredictionTime;
+
+  static const unsigned int PREDICTION_TIMEOUT = 500;
+
 private:
   // Do not allow copying objects.
   CursorPainter(const CursorPainter &);
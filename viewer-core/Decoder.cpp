@@ -52,6 +52,8 @@ bool Decoder::isPseudo(int encoding)
   case EncodingDefs::HEXTILE:
   case EncodingDefs::TIGHT:
   case EncodingDefs::ZRLE:
+  case EncodingDefs::H264:
+  case EncodingDefs::TILE_CACHE:
     return false;
 
   case PseudoEncDefs::COMPR_LEVEL_0:
@@ -27,7 +27,8 @@
 #include "FbUpdateNotifier.h"
 
 DecoderOfRectangle::DecoderOfRectangle(LogWriter *logWriter)
-: Decoder(logWriter)
+: Decoder(logWriter),
+  m_isDrawingSkipped(false)
 {
 }
 
@@ -43,7 +44,9 @@ void DecoderOfRectangle::process(RfbInputGate *input,
                      FbUpdateNotifier *fbNotifier)
 {
   decode(input, secondFrameBuffer, rect);
-  copy(frameBuffer, secondFrameBuffer, rect, fbLock);
+  if (!m_isDrawingSkipped) {
+    copy(frameBuffer, secondFrameBuffer, rect, fbLock);
+  }
   notify(fbNotifier, rect);
 }
 
@@ -62,6 +65,11 @@ void DecoderOfRectangle::notify(FbUpdateNotifier *fbNotifier,
   fbNotifier->onUpdate(rect);
 }
 
+void DecoderOfRectangle::setDrawingSkipped(bool skipped)
+{
+  m_isDrawingSkipped = skipped;
+}
+
 bool DecoderOfRectangle::isPseudo() const
 {
   return false;
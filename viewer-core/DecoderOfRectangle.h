@@ -57,6 +57,17 @@ public:
   //
   virtual bool isPseudo() const;
 
+  //
+  // When drawing is skipped, the rectangles are still read completely from
+  // the input and the compression streams are kept in sync, but the costly
+  // work of producing pixels (JPEG and H.264 decompression, copying to the
+  // visible frame buffer) is left out. Used by headless clients that only
+  // need to consume the stream, such as the load generator.
+  //
+  // Must be called before the first rectangle is processed.
+  //
+  void setDrawingSkipped(bool skipped);
+
 protected:
   //
   // This method read rectangle-update from input and decode on frameBuffer.
@@ -79,6 +90,8 @@ protected:
   //
   virtual void notify(FbUpdateNotifier *fbNotifier,
                       const Rect *rect);
+
+  bool m_isDrawingSkipped;
 };
 
 #endif
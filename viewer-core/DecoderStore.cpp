@@ -27,11 +27,17 @@
 
 #include "DecoderStore.h"
 
+#include "thread/AutoLock.h"
+
 DecoderStore::DecoderStore(LogWriter *logWriter)
 : m_logWriter(logWriter),
   m_preferredEncoding(EncodingDefs::TIGHT),
-  m_allowCopyRect(true)
+  m_allowCopyRect(true),
+  m_isDrawingSkipped(false)
 {
+  for (INT32 i = 0; i < RECT_TABLE_SIZE; i++) {
+    m_rectDecoders[i] = 0;
+  }
 }
 
 DecoderStore::~DecoderStore()
@@ -46,22 +52,41 @@ DecoderStore::~DecoderStore()
       } catch (...) {
       }
     }
+    for (size_t i = 0; i < m_removedDecoders.size(); i++) {
+      delete m_removedDecoders[i];
+    }
   } catch (...) {
   }
 }
 
 Decoder *DecoderStore::getDecoder(INT32 decoderId)
 {
-  if (m_decoders.count(decoderId))
-    return m_decoders[decoderId].second;
+  AutoLock al(&m_lock);
+  map<INT32, pair<int, Decoder *> >::iterator i = m_decoders.find(decoderId);
+  if (i != m_decoders.end())
+    return i->second.second;
   else
     return 0;
 }
 
+DecoderOfRectangle *DecoderStore::getRectangleDecoder(INT32 encoding)
+{
+  if (encoding >= 0 && encoding < RECT_TABLE_SIZE) {
+    return m_rectDecoders[encoding];
+  }
+  // Encodings of external decoders.
+  Decoder *decoder = getDecoder(encoding);
+  if (decoder == 0 || decoder->isPseudo()) {
+    return 0;
+  }
+  return dynamic_cast<DecoderOfRectangle *>(decoder);
+}
+
 vector<INT32> DecoderStore::getDecoderIds()
 {
   // this method returned list of decoders, sorted by priority.
   // in first position is preffered encoding.
+  AutoLock al(&m_lock);
   vector<pair<int, INT32> > decoders;
 
   for (map<INT32, pair <int, Decoder *> >::iterator i = m_decoders.begin();
@@ -92,21 +117,38 @@ vector<INT32> DecoderStore::getDecoderIds()
 bool DecoderStore::addDecoder(Decoder *decoder, int priority)
 {
   m_logWriter->detail(_T("Decoder %d added"), decoder->getCode());
-  if (m_decoders.count(decoder->getCode()) == 0) {
-    m_decoders[decoder->getCode()] = make_pair(priority, decoder);
+  AutoLock al(&m_lock);
+  INT32 code = decoder->getCode();
+  if (m_decoders.count(code) == 0) {
+    m_decoders[code] = make_pair(priority, decoder);
+    if (!decoder->isPseudo()) {
+      DecoderOfRectangle *rectDecoder =
+        dynamic_cast<DecoderOfRectangle *>(decoder);
+      if (rectDecoder != 0) {
+        rectDecoder->setDrawingSkipped(m_isDrawingSkipped);
+      }
+      if (code >= 0 && code < RECT_TABLE_SIZE) {
+        m_rectDecoders[code] = rectDecoder;
+      }
+    }
     return true;
   }
-  delete[] decoder;
+  delete decoder;
   return false;
 }
 
 bool DecoderStore::removeDecoder(INT32 decoderId)
 {
-  if (m_decoders.count(decoderId)) {
-    m_logWriter->detail(_T("Decoder '%d' destroyed (removed from list)"),
-                        m_decoders[decoderId].second->getCode());
-    delete m_decoders[decoderId].second;
-    m_decoders.erase(decoderId);
+  AutoLock al(&m_lock);
+  map<INT32, pair<int, Decoder *> >::iterator i = m_decoders.find(decoderId);
+  if (i != m_decoders.end()) {
+    m_logWriter->detail(_T("Decoder '%d' removed from list"),
+                        i->second.second->getCode());
+    if (decoderId >= 0 && decoderId < RECT_TABLE_SIZE) {
+      m_rectDecoders[decoderId] = 0;
+    }
+    m_removedDecoders.push_back(i->second.second);
+    m_decoders.erase(i);
     return true;
   }
   return false;
@@ -127,3 +169,20 @@ void DecoderStore::allowCopyRect(bool allow)
   }
   m_allowCopyRect = allow;
 }
+
+void DecoderStore::setDrawingSkipped(bool skipped)
+{
+  AutoLock al(&m_lock);
+  m_isDrawingSkipped = skipped;
+  for (map<INT32, pair<int, Decoder *> >::iterator i = m_decoders.begin();
+       i != m_decoders.end();
+       i++) {
+    if (!i->second.second->isPseudo()) {
+      DecoderOfRectangle *rectDecoder =
+        dynamic_cast<DecoderOfRectangle *>(i->second.second);
+      if (rectDecoder != 0) {
+        rectDecoder->setDrawingSkipped(skipped);
+      }
+    }
+  }
+}
@@ -29,8 +29,10 @@
 #include <vector>
 
 #include "Decoder.h"
+#include "DecoderOfRectangle.h"
 
 #include "log-writer/LogWriter.h"
+#include "thread/LocalMutex.h"
 
 class DecoderStore
 {
@@ -39,6 +41,11 @@ public:
   ~DecoderStore();
 
   Decoder *getDecoder(INT32 decoderId);
+  // Returns the decoder of the rectangles of the encoding, or 0. For the
+  // standard encodings it is a lookup in a flat table without locking, so
+  // the decoding thread can call it for every rectangle while the decoders
+  // are being changed by other threads.
+  DecoderOfRectangle *getRectangleDecoder(INT32 encoding);
   vector<INT32> getDecoderIds();
   
   // return true, if adding is complete
@@ -50,13 +57,26 @@ public:
 
   void setPreferredEncoding(INT32 encodingType);
   void allowCopyRect(bool allow);
+  // Applies DecoderOfRectangle::setDrawingSkipped() to the decoders added
+  // so far and to the ones added later.
+  void setDrawingSkipped(bool skipped);
 
 private:
+  // Encodings with lower codes are in the flat table, it covers the
+  // standard ones.
+  static const INT32 RECT_TABLE_SIZE = 64;
+
   LogWriter *m_logWriter;
 
+  LocalMutex m_lock;
   map<INT32, pair<int, Decoder*> > m_decoders;
+  DecoderOfRectangle *volatile m_rectDecoders[RECT_TABLE_SIZE];
+  // Removed decoders are deleted with the store, the decoding thread may
+  // still be using them.
+  vector<Decoder *> m_removedDecoders;
   INT32 m_preferredEncoding;
   bool m_allowCopyRect;
+  bool m_isDrawingSkipped;
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include "FbupdateNotifier.h"
 
 #include "thread/AutoLock.h"
+#include "thread/SchedulingPolicy.h"
 
 #include "CoreEventsAdapter.h"
 
@@ -36,10 +37,22 @@ FbUpdateNotifier::FbUpdateNotifier(FrameBuffer *fb, LocalMutex *fbLock, LogWrite
   m_isNewSize(false),
   m_isCursorChange(false),
   m_adapter(0),
-  m_watermarksController(wmController)
+  m_watermarksController(wmController),
+  m_cursorShapeId(0),
+  m_isCursorComposited(false),
+  m_isBatching(false),
+  m_isBatchCopied(false),
+  m_batchStart(0),
+  m_renderTime(0),
+  m_framesShown(0),
+  m_framesDropped(0),
+  m_batchesFlushed(0),
+  m_batchesNotified(0)
 {
+  QueryPerformanceFrequency(&m_perfFrequency);
   m_oldPosition = m_cursorPainter.hideCursor();
 
+  SchedulingPolicy::apply(this, SchedulingPolicy::ROLE_RENDER);
   resume();
 }
 
@@ -78,55 +91,90 @@ void FbUpdateNotifier::execute()
 
   // Send event to adapter, while tread isn't terminated.
   while (!isTerminating()) {
-    // If flag is set, then thread going to sleep (wait event).
-    bool noUpdates = true;
+    // Pause this thread, if there are no updates (cursor, frame buffer).
+    if (!sendUpdates()) {
+      m_eventUpdate.waitForEvent();
+    }
+  }
+}
 
-    // Move updates to local variable with blocking notifier mutex "m_updateLock".
-    bool isNewSize;
-    bool isCursorChange;
-    Region update;
-    {
-      AutoLock al(&m_updateLock);
-      isNewSize = m_isNewSize;
-      m_isNewSize = false;
+bool FbUpdateNotifier::sendUpdates()
+{
+  // If flag is set, then thread going to sleep (wait event).
+  bool noUpdates = true;
 
-      isCursorChange = m_isCursorChange;
-      m_isCursorChange = false;
+  // The frame buffer is locked from taking the updates until they are
+  // passed to the adapter, so that onCopy() knows which rectangles of the
+  // presented image are not up to date.
+  AutoLock fbLock(m_fbLock);
 
-      update = m_update;
-      m_update.clear();
-    }
+  // Move updates to local variable with blocking notifier mutex "m_updateLock".
+  bool isNewSize;
+  bool isCursorChange;
+  Region update;
+  vector<FbCopy> copies;
+  UINT32 batches;
+  {
+    AutoLock al(&m_updateLock);
+    batches = m_batchesFlushed;
+    isNewSize = m_isNewSize;
+    m_isNewSize = false;
 
-    // Send event "Change properties of frame buffer" to adapter
-    // with blocking frame buffer mutex "m_fbLock".
-    if (isNewSize) {
-      noUpdates = false;
-      m_logWriter->debug(_T("FbUpdateNotifier (event): new size of frame buffer"));
-      try {
-        AutoLock al(m_fbLock);
-        m_adapter->onFrameBufferPropChange(m_frameBuffer);
-        // FIXME: it's bad code. Must work without one next line, but not it.
-        m_adapter->onFrameBufferUpdate(m_frameBuffer, &m_frameBuffer->getDimension().getRect());
-      } catch (...) {
-        m_logWriter->error(_T("FbUpdateNotifier (event): error in set new size"));
-      }
+    isCursorChange = m_isCursorChange;
+    m_isCursorChange = false;
+
+    update = m_update;
+    m_update.clear();
+    copies.swap(m_copies);
+  }
+
+  // Send event "Change properties of frame buffer" to adapter
+  // with blocking frame buffer mutex "m_fbLock".
+  if (isNewSize) {
+    noUpdates = false;
+    m_logWriter->debug(_T("FbUpdateNotifier (event): new size of frame buffer"));
+    // The whole frame buffer is presented again.
+    copies.clear();
+    try {
+      m_adapter->onFrameBufferPropChange(m_frameBuffer);
+      // FIXME: it's bad code. Must work without one next line, but not it.
+      m_adapter->onFrameBufferUpdate(m_frameBuffer, &m_frameBuffer->getDimension().getRect());
+    } catch (...) {
+      m_logWriter->error(_T("FbUpdateNotifier (event): error in set new size"));
     }
+  }
 
-    // Update position on cursor and send frame buffer update event to adapter
-    // with blocking frame buffer mutex "m_fbLock".
-    if (isCursorChange || !update.isEmpty()) {
-      noUpdates = false;
+  // Update position on cursor and send frame buffer update event to adapter
+  // with blocking frame buffer mutex "m_fbLock".
+  if (isCursorChange || !update.isEmpty() || !copies.empty()) {
+    noUpdates = false;
 
-      AutoLock al(m_fbLock);
-	  Rect cursor = m_cursorPainter.showCursor();
-	  update.addRect(&cursor);
+	  // When the application draws the cursor on presenting, it is never
+	  // painted into the frame buffer. The old place is still added to the
+	  // updates, in case it was painted there before.
+	  UINT32 shapeId = m_cursorShapeId;
+	  Rect cursorOverlay = m_cursorPainter.getOverlay(&m_cursorImage,
+	                                                  &m_cursorShapeId);
+	  bool isImageChanged = !m_isCursorComposited || shapeId != m_cursorShapeId;
+	  m_isCursorComposited = m_adapter->onCursorOverlay(&m_cursorImage,
+	                                                    &cursorOverlay,
+	                                                    isImageChanged);
+	  if (!m_isCursorComposited) {
+	    Rect cursor = m_cursorPainter.showCursor();
+	    update.addRect(&cursor);
+	  }
 	  update.addRect(&m_oldPosition);
 
 #ifdef _DEMO_VERSION_
 	  Rect curWmRect = m_watermarksController->CurrentRect();
+	  // When the application blends the watermark on presenting, the frame
+	  // buffer is not touched at all.
+	  const FrameBuffer *wmImage = m_watermarksController->getImage();
+	  bool isComposited = wmImage != 0 &&
+	                      m_adapter->onFrameBufferOverlay(wmImage, &curWmRect);
 	  Region reg(curWmRect);
 	  reg.intersect(&update);
-	  bool isIntersect = !reg.isEmpty();
+	  bool isIntersect = !isComposited && !reg.isEmpty();
 	  if (isIntersect)
 	  {
 		m_watermarksController->showWaterMarks(m_frameBuffer, m_fbLock);
@@ -134,18 +182,48 @@ void FbUpdateNotifier::execute()
 	  }
 #endif
 
-      vector<Rect> updateList;
-      update.getRectVector(&updateList);
-      m_logWriter->detail(_T("FbUpdateNotifier (event): %u updates"), updateList.size());
+    LARGE_INTEGER renderStart;
+    QueryPerformanceCounter(&renderStart);
 
-      try {
-        for (vector<Rect>::iterator i = updateList.begin(); i != updateList.end(); ++i) {
-			m_adapter->onFrameBufferUpdate(m_frameBuffer, &*i);
+    // The copies go first, the updated rectangles are taken from the frame
+    // buffer after them. Once a copy fails, the next ones may read its
+    // destination, so they are all updated instead.
+    bool isCopied = true;
+    for (vector<FbCopy>::iterator iCopy = copies.begin(); iCopy != copies.end(); iCopy++) {
+      if (isCopied) {
+        try {
+          isCopied = m_adapter->onFrameBufferCopy(m_frameBuffer, &iCopy->dstRect,
+                                                  iCopy->src.x, iCopy->src.y);
+        } catch (...) {
+          m_logWriter->error(_T("FbUpdateNotifier (event): error in copy"));
+          isCopied = false;
         }
-      } catch (...) {
-        m_logWriter->error(_T("FbUpdateNotifier (event): error in update"));
       }
-      
+      if (!isCopied) {
+        update.addRect(&iCopy->dstRect);
+      }
+    }
+
+    vector<Rect> updateList;
+    update.getRectVector(&updateList);
+    m_logWriter->detail(_T("FbUpdateNotifier (event): %u copies, %u updates"),
+                        copies.size(), updateList.size());
+
+    try {
+      m_adapter->onFrameBufferUpdates(m_frameBuffer, &updateList);
+    } catch (...) {
+      m_logWriter->error(_T("FbUpdateNotifier (event): error in update"));
+    }
+    LARGE_INTEGER renderEnd;
+    QueryPerformanceCounter(&renderEnd);
+    {
+      AutoLock al(&m_updateLock);
+      m_renderTime += (UINT64)(renderEnd.QuadPart - renderStart.QuadPart) *
+                      1000000 / (UINT64)m_perfFrequency.QuadPart;
+      m_framesShown++;
+      m_batchesNotified = batches;
+    }
+    
 
 #ifdef _DEMO_VERSION_
 	  if (isIntersect)
@@ -154,13 +232,8 @@ void FbUpdateNotifier::execute()
 
 	  m_oldPosition = m_cursorPainter.hideCursor();
 
-    }
-
-    // Pause this thread, if there are no updates (cursor, frame buffer).
-    if (noUpdates) {
-      m_eventUpdate.waitForEvent();
-    }
   }
+  return !noUpdates;
 }
 
 void FbUpdateNotifier::onTerminate()
@@ -170,6 +243,13 @@ void FbUpdateNotifier::onTerminate()
 
 void FbUpdateNotifier::onUpdate(const Rect *update)
 {
+  if (m_isBatching) {
+    m_batch.addRect(update);
+    if (GetTickCount() - m_batchStart >= BATCH_INTERVAL) {
+      flushBatch();
+    }
+    return;
+  }
   {
     AutoLock al(&m_updateLock);
     m_update.addRect(update);
@@ -178,6 +258,118 @@ void FbUpdateNotifier::onUpdate(const Rect *update)
   m_logWriter->debug(_T("FbUpdateNotifier: added rectangle"));
 }
 
+void FbUpdateNotifier::beginBatch()
+{
+  m_isBatching = true;
+  m_batchStart = GetTickCount();
+}
+
+void FbUpdateNotifier::endBatch()
+{
+  flushBatch();
+  m_isBatching = false;
+}
+
+void FbUpdateNotifier::flushBatch()
+{
+  m_batchStart = GetTickCount();
+  if (m_batch.isEmpty() && !m_isBatchCopied) {
+    return;
+  }
+  m_isBatchCopied = false;
+  {
+    AutoLock al(&m_updateLock);
+    // The previous batch has not been presented yet, it never will be on
+    // its own.
+    if (!m_update.isEmpty()) {
+      m_framesDropped++;
+    }
+    m_update.add(&m_batch);
+    m_batchesFlushed++;
+  }
+  m_batch.clear();
+  m_eventUpdate.notify();
+}
+
+void FbUpdateNotifier::onRegionUpdate(const Region *update)
+{
+  {
+    AutoLock al(&m_updateLock);
+    m_update.add(update);
+  }
+  m_eventUpdate.notify();
+}
+
+void FbUpdateNotifier::takeRenderStats(UINT32 *renderTime,
+                                       UINT32 *framesShown,
+                                       UINT32 *framesDropped)
+{
+  AutoLock al(&m_updateLock);
+  *renderTime = m_renderTime > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)m_renderTime;
+  *framesShown = m_framesShown;
+  *framesDropped = m_framesDropped;
+  m_renderTime = 0;
+  m_framesShown = 0;
+  m_framesDropped = 0;
+}
+
+UINT32 FbUpdateNotifier::getBatchesFlushed()
+{
+  AutoLock al(&m_updateLock);
+  return m_batchesFlushed;
+}
+
+UINT32 FbUpdateNotifier::getBatchesNotified()
+{
+  AutoLock al(&m_updateLock);
+  return m_batchesNotified;
+}
+
+void FbUpdateNotifier::onCopy(const Rect *dstRect, const Point *src)
+{
+  Rect srcRect(dstRect);
+  srcRect.setLocation(src->x, src->y);
+  {
+    AutoLock al(&m_updateLock);
+    // The presented image is up to date except for the rectangles changed
+    // since the last notification and the cursor painted there.
+    Region changed(m_update);
+    changed.add(&m_batch);
+    if (!m_isCursorComposited) {
+      changed.addRect(&m_oldPosition);
+    }
+    Region source(srcRect);
+    changed.intersect(&source);
+    bool isCopied = !m_isNewSize && changed.isEmpty() &&
+                    m_copies.size() < MAX_COPIES;
+#ifdef _DEMO_VERSION_
+    // The watermark could be painted there as well.
+    isCopied = false;
+#endif
+    if (isCopied) {
+      FbCopy copy;
+      copy.dstRect = *dstRect;
+      copy.src = *src;
+      m_copies.push_back(copy);
+      Region copied(*dstRect);
+      m_update.subtract(&copied);
+      m_batch.subtract(&copied);
+    } else if (m_isBatching) {
+      m_batch.addRect(dstRect);
+    } else {
+      m_update.addRect(dstRect);
+    }
+  }
+  if (m_isBatching) {
+    m_isBatchCopied = true;
+    if (GetTickCount() - m_batchStart >= BATCH_INTERVAL) {
+      flushBatch();
+    }
+    return;
+  }
+  m_eventUpdate.notify();
+}
+
 void FbUpdateNotifier::onPropertiesFb()
 {
   {
@@ -198,6 +390,15 @@ void FbUpdateNotifier::updatePointerPos(const Point *position)
   m_eventUpdate.notify();
 }
 
+void FbUpdateNotifier::predictPointerPos(const Point *position)
+{
+  m_cursorPainter.predictPointerPos(position);
+
+  AutoLock al(&m_updateLock);
+  m_isCursorChange = true;
+  m_eventUpdate.notify();
+}
+
 void FbUpdateNotifier::setNewCursor(const Point *hotSpot,
                                     UINT16 width, UINT16 height,
                                     const vector<UINT8> *cursor, 
@@ -50,18 +50,58 @@ public:
   void onUpdate(const Rect *rect);
   void onPropertiesFb();
 
+  // Between the calls, onUpdate() collects the rectangles without locking
+  // and waking the notifier thread, which is done by endBatch() for the
+  // whole framebuffer update (and by onUpdate() every BATCH_INTERVAL ms of a
+  // long update, so a big update is still shown as it comes). Must be
+  // called by the thread which decodes the updates.
+  void beginBatch();
+  void endBatch();
+  // Passes the collected rectangles to the notifier thread now.
+  void flushBatch();
+
+  // Unlike onUpdate(), may be called by any thread, the region is passed to
+  // the notifier thread at once.
+  void onRegionUpdate(const Region *update);
+
+  // dstRect of the frame buffer has been copied from the rectangle at src.
+  // The copy is passed to the adapter (CoreEventsAdapter::onFrameBufferCopy())
+  // instead of updating dstRect, if the source has not changed since the
+  // last notification. Must be called by the thread which decodes the
+  // updates, with the frame buffer locked since it has been changed, so
+  // that no notification comes in between.
+  void onCopy(const Rect *dstRect, const Point *src);
+
   void updatePointerPos(const Point *position);
+  void predictPointerPos(const Point *position);
   void setNewCursor(const Point *hotSpot,
                     UINT16 width, UINT16 height,
                     const vector<UINT8> *cursor, 
                     const vector<UINT8> *bitmask);
 
   void setIgnoreShapeUpdates(bool ignore);
+
+  // Returns the time in microseconds the adapter has spent presenting the
+  // updates, the number of presented frames and the number of batches
+  // replaced by the next ones before they were presented, since the
+  // previous call.
+  void takeRenderStats(UINT32 *renderTime, UINT32 *framesShown,
+                       UINT32 *framesDropped);
+
+  // Returns the number of the batches passed to the notifier thread so far
+  // and the number of them passed to the adapter. May be called by any
+  // thread.
+  UINT32 getBatchesFlushed();
+  UINT32 getBatchesNotified();
 protected:
   // Inherited from Thread
   void execute();
   void onTerminate();
 
+  // Passes the updates collected since the previous call to the adapter.
+  // Returns false if there were none.
+  bool sendUpdates();
+
   LocalMutex *m_fbLock;
   FrameBuffer *m_frameBuffer;
   CursorPainter m_cursorPainter;
@@ -82,15 +122,52 @@ protected:
   // In this region added all updates of frame buffer and cursor updates.
   Region m_update;
 
+  static const DWORD BATCH_INTERVAL = 40;
+
+  // Rectangles of the current batch, used by the decoding thread only.
+  bool m_isBatching;
+  Region m_batch;
+  // The batch has copies, which must be notified even without rectangles.
+  bool m_isBatchCopied;
+  DWORD m_batchStart;
+
+  // Copies to pass to the adapter before the update, in order, protected by
+  // both m_fbLock and m_updateLock. Their destinations are not in m_update.
+  struct FbCopy
+  {
+    Rect dstRect;
+    Point src;
+  };
+  vector<FbCopy> m_copies;
+  // More copies than that are passed as updated rectangles.
+  static const size_t MAX_COPIES = 64;
+
   // This rectangle save position of cursor.
   Rect m_oldPosition;
 
+  // Cursor image for the adapter to draw it over the frame buffer and the
+  // id of its shape (see CursorPainter::getOverlay()).
+  FrameBuffer m_cursorImage;
+  UINT32 m_cursorShapeId;
+  // This flag is true if the adapter drew the cursor on the last update.
+  bool m_isCursorComposited;
+
   // This flag is true after call onPropertiesFb().
   bool m_isNewSize;
 
   // This flag is true after set new cursor or update position.
   bool m_isCursorChange;
 
+  // Counters of takeRenderStats(), protected by m_updateLock.
+  LARGE_INTEGER m_perfFrequency;
+  UINT64 m_renderTime;
+  UINT32 m_framesShown;
+  UINT32 m_framesDropped;
+  // Counters of getBatchesFlushed() and getBatchesNotified(), protected by
+  // m_updateLock.
+  UINT32 m_batchesFlushed;
+  UINT32 m_batchesNotified;
+
 private:
   // Do not allow copying objects.
   FbUpdateNotifier(const FbUpdateNotifier &);
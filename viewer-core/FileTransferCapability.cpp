@@ -87,11 +87,36 @@ void FileTransferCapability::addCapabilities(CapabilitiesManager *capabilities)
                                   FTMessage::FILE_LIST_REQUEST_SIG,
                                   _T("File list request"));
 
+  capabilities->addClientMsgCapability(FTMessage::FILE_LIST_PAGED_REQUEST,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::FILE_LIST_PAGED_REQUEST_SIG,
+                                  _T("Paged file list request"));
+
+  capabilities->addClientMsgCapability(FTMessage::FILE_BATCH_DOWNLOAD_REQUEST,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::FILE_BATCH_DOWNLOAD_REQUEST_SIG,
+                                  _T("Batch download request"));
+
   capabilities->addClientMsgCapability(FTMessage::MD5_REQUEST,
                                   VendorDefs::TIGHTVNC,
                                   FTMessage::MD5_REQUEST_SIG,
                                   _T("File md5 sum request"));
 
+  capabilities->addClientMsgCapability(FTMessage::CHECKSUM_REQUEST,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::CHECKSUM_REQUEST_SIG,
+                                  _T("File checksum request"));
+
+  capabilities->addClientMsgCapability(FTMessage::TREE_OPERATION_REQUEST,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::TREE_OPERATION_REQUEST_SIG,
+                                  _T("Tree operation request"));
+
+  capabilities->addClientMsgCapability(FTMessage::TREE_OPERATION_CANCEL_REQUEST,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::TREE_OPERATION_CANCEL_REQUEST_SIG,
+                                  _T("Tree operation cancel request"));
+
   capabilities->addClientMsgCapability(FTMessage::DIRSIZE_REQUEST,
                                   VendorDefs::TIGHTVNC,
                                   FTMessage::DIRSIZE_REQUEST_SIG,
@@ -150,6 +175,18 @@ void FileTransferCapability::addCapabilities(CapabilitiesManager *capabilities)
                                   FTMessage::FILE_LIST_REPLY_SIG,
                                   _T("File list reply"));
 
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::FILE_LIST_PAGE_REPLY,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::FILE_LIST_PAGE_REPLY_SIG,
+                                  _T("File list page reply"));
+
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::FILE_BATCH_DOWNLOAD_REPLY,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::FILE_BATCH_DOWNLOAD_REPLY_SIG,
+                                  _T("Batch download reply"));
+
   capabilities->addServerMsgCapability(this,
                                   FTMessage::LAST_REQUEST_FAILED_REPLY,
                                   VendorDefs::TIGHTVNC,
@@ -162,6 +199,30 @@ void FileTransferCapability::addCapabilities(CapabilitiesManager *capabilities)
                                   FTMessage::MD5_REPLY_SIG,
                                   _T("File md5 sum reply"));
 
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::CHECKSUM_REPLY,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::CHECKSUM_REPLY_SIG,
+                                  _T("File checksum reply"));
+
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::CHECKSUM_PROGRESS_REPLY,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::CHECKSUM_PROGRESS_REPLY_SIG,
+                                  _T("File checksum progress reply"));
+
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::TREE_OPERATION_REPLY,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::TREE_OPERATION_REPLY_SIG,
+                                  _T("Tree operation reply"));
+
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::TREE_OPERATION_PROGRESS_REPLY,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::TREE_OPERATION_PROGRESS_REPLY_SIG,
+                                  _T("Tree operation progress reply"));
+
   capabilities->addServerMsgCapability(this,
                                   FTMessage::DIRSIZE_REPLY,
                                   VendorDefs::TIGHTVNC,
@@ -221,4 +282,10 @@ void FileTransferCapability::addCapabilities(CapabilitiesManager *capabilities)
                                   VendorDefs::TIGHTVNC,
                                   FTMessage::UPLOAD_END_REPLY_SIG,
                                   _T("File upload end reply"));
+
+  capabilities->addServerMsgCapability(this,
+                                  FTMessage::WINDOWED_TRANSFER,
+                                  VendorDefs::TIGHTVNC,
+                                  FTMessage::WINDOWED_TRANSFER_SIG,
+                                  _T("Windowed file transfer"));
 }
@@ -0,0 +1,298 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "H264Decoder.h"
+
+H264Decoder::H264Decoder(LogWriter *logWriter)
+: DecoderOfRectangle(logWriter),
+  m_transform(0),
+  m_sampleTime(0),
+  m_frameWidth(0),
+  m_frameHeight(0),
+  m_frameStride(0)
+{
+  m_encoding = EncodingDefs::H264;
+}
+
+H264Decoder::~H264Decoder()
+{
+  releaseContext();
+}
+
+void H264Decoder::decode(RfbInputGate *input,
+                         FrameBuffer *frameBuffer,
+                         const Rect *dstRect)
+{
+  UINT32 length = input->readUInt32();
+  UINT32 flags = input->readUInt32();
+  vector<UINT8> data(length);
+  if (length != 0) {
+    input->readFully(&data.front(), length);
+  }
+
+  if ((flags & (RESET_CONTEXT | RESET_ALL_CONTEXTS)) != 0 ||
+      !dstRect->isEqualTo(&m_contextRect)) {
+    releaseContext();
+  }
+  if (length == 0 || dstRect->area() == 0 || m_isDrawingSkipped) {
+    return;
+  }
+
+  try {
+    if (m_transform == 0) {
+      createContext(dstRect);
+    }
+    processData(&data, frameBuffer, dstRect);
+  } catch (const Exception &ex) {
+    // The stream cannot be continued from here, start a new context with
+    // the next rectangle.
+    releaseContext();
+    m_logWriter->error(_T("Error in h264-decoder: %s"), ex.getMessage());
+  }
+}
+
+void H264Decoder::createContext(const Rect *rect)
+{
+  m_transform = m_mf.createTransform(MFT_CATEGORY_VIDEO_DECODER,
+                                     MFVideoFormat_H264,
+                                     MFVideoFormat_NV12, false);
+  m_contextRect = *rect;
+  m_sampleTime = 0;
+
+  // Output frames right away instead of collecting them for reordering.
+  IMFAttributes *attributes;
+  if (SUCCEEDED(m_transform->GetAttributes(&attributes))) {
+    attributes->SetUINT32(CODECAPI_AVLowLatencyMode, TRUE);
+    attributes->Release();
+  }
+
+  IMFMediaType *type = m_mf.createMediaType();
+  type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+  type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264);
+  type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+  MFSetAttributeSize(type, MF_MT_FRAME_SIZE,
+                     rect->getWidth(), rect->getHeight());
+  HRESULT hr = m_transform->SetInputType(0, type, 0);
+  type->Release();
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot set H.264 decoder input type, error code = %x"),
+                    (unsigned)hr);
+  }
+  setOutputType();
+
+  m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0);
+  m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0);
+  m_logWriter->detail(_T("H.264 decoder context created for %dx%d frames"),
+                      rect->getWidth(), rect->getHeight());
+}
+
+void H264Decoder::releaseContext()
+{
+  if (m_transform != 0) {
+    m_transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0);
+    m_transform->Release();
+    m_transform = 0;
+  }
+  m_contextRect.setRect(0, 0, 0, 0);
+}
+
+void H264Decoder::setOutputType()
+{
+  for (DWORD i = 0; ; i++) {
+    IMFMediaType *type;
+    HRESULT hr = m_transform->GetOutputAvailableType(0, i, &type);
+    if (FAILED(hr)) {
+      throw Exception(_T("H.264 decoder does not produce NV12 frames"));
+    }
+    GUID subtype;
+    if (SUCCEEDED(type->GetGUID(MF_MT_SUBTYPE, &subtype)) &&
+        subtype == MFVideoFormat_NV12) {
+      hr = m_transform->SetOutputType(0, type, 0);
+      if (SUCCEEDED(hr)) {
+        MFGetAttributeSize(type, MF_MT_FRAME_SIZE,
+                           &m_frameWidth, &m_frameHeight);
+        m_frameStride = MFGetAttributeUINT32(type, MF_MT_DEFAULT_STRIDE,
+                                             m_frameWidth);
+      }
+      type->Release();
+      if (FAILED(hr)) {
+        throw Exception(_T("Cannot set H.264 decoder output type, error code = %x"),
+                        (unsigned)hr);
+      }
+      return;
+    }
+    type->Release();
+  }
+}
+
+void H264Decoder::processData(vector<UINT8> *data, FrameBuffer *fb,
+                              const Rect *rect)
+{
+  DWORD length = (DWORD)data->size();
+  IMFMediaBuffer *buffer = m_mf.createMemoryBuffer(length);
+  IMFSample *sample = 0;
+  try {
+    BYTE *bufferData;
+    HRESULT hr = buffer->Lock(&bufferData, 0, 0);
+    if (FAILED(hr)) {
+      throw Exception(_T("Cannot lock H.264 input buffer, error code = %x"),
+                      (unsigned)hr);
+    }
+    memcpy(bufferData, &data->front(), length);
+    buffer->Unlock();
+    buffer->SetCurrentLength(length);
+
+    sample = m_mf.createSample();
+    sample->AddBuffer(buffer);
+    sample->SetSampleTime(m_sampleTime++);
+
+    hr = m_transform->ProcessInput(0, sample, 0);
+    if (hr == MF_E_NOTACCEPTING) {
+      // Take the pending frames first.
+      drainOutput(fb, rect);
+      hr = m_transform->ProcessInput(0, sample, 0);
+    }
+    if (FAILED(hr)) {
+      throw Exception(_T("H.264 decoder rejected the data, error code = %x"),
+                      (unsigned)hr);
+    }
+  } catch (...) {
+    if (sample != 0) {
+      sample->Release();
+    }
+    buffer->Release();
+    throw;
+  }
+  sample->Release();
+  buffer->Release();
+
+  drainOutput(fb, rect);
+}
+
+void H264Decoder::drainOutput(FrameBuffer *fb, const Rect *rect)
+{
+  while (true) {
+    MFT_OUTPUT_STREAM_INFO info;
+    HRESULT hr = m_transform->GetOutputStreamInfo(0, &info);
+    if (FAILED(hr)) {
+      throw Exception(_T("Cannot get H.264 decoder output info, error code = %x"),
+                      (unsigned)hr);
+    }
+
+    MFT_OUTPUT_DATA_BUFFER output;
+    memset(&output, 0, sizeof(output));
+    if ((info.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES |
+                         MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES)) == 0) {
+      IMFMediaBuffer *buffer = m_mf.createMemoryBuffer(info.cbSize);
+      try {
+        output.pSample = m_mf.createSample();
+      } catch (...) {
+        buffer->Release();
+        throw;
+      }
+      output.pSample->AddBuffer(buffer);
+      buffer->Release();
+    }
+
+    DWORD status = 0;
+    hr = m_transform->ProcessOutput(0, 1, &output, &status);
+    if (output.pEvents != 0) {
+      output.pEvents->Release();
+    }
+    if (SUCCEEDED(hr) && output.pSample != 0) {
+      try {
+        drawFrame(output.pSample, fb, rect);
+      } catch (...) {
+        output.pSample->Release();
+        throw;
+      }
+    }
+    if (output.pSample != 0) {
+      output.pSample->Release();
+    }
+
+    if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT) {
+      return;
+    } else if (hr == MF_E_TRANSFORM_STREAM_CHANGE) {
+      setOutputType();
+    } else if (FAILED(hr)) {
+      throw Exception(_T("H.264 decoding failed, error code = %x"),
+                      (unsigned)hr);
+    }
+  }
+}
+
+void H264Decoder::drawFrame(IMFSample *sample, FrameBuffer *fb,
+                            const Rect *rect)
+{
+  IMFMediaBuffer *buffer;
+  HRESULT hr = sample->ConvertToContiguousBuffer(&buffer);
+  if (FAILED(hr)) {
+    throw Exception(_T("Cannot get H.264 output buffer, error code = %x"),
+                    (unsigned)hr);
+  }
+  BYTE *data;
+  DWORD length;
+  hr = buffer->Lock(&data, 0, &length);
+  if (FAILED(hr)) {
+    buffer->Release();
+    throw Exception(_T("Cannot lock H.264 output buffer, error code = %x"),
+                    (unsigned)hr);
+  }
+
+  // Decoders may align the frame size, the visible part is at the top-left.
+  int width = min(rect->getWidth(), (int)m_frameWidth);
+  int height = min(rect->getHeight(), (int)m_frameHeight);
+  size_t uvOffset = (size_t)m_frameStride * m_frameHeight;
+  if (length < uvOffset + (size_t)m_frameStride * ((height + 1) / 2)) {
+    height = 0;
+  }
+
+  PixelFormat pf = fb->getPixelFormat();
+  int bytesPerPixel = fb->getBytesPerPixel();
+  for (int y = 0; y < height; y++) {
+    const UINT8 *lumaRow = data + (size_t)y * m_frameStride;
+    const UINT8 *chromaRow = data + uvOffset + (size_t)(y / 2) * m_frameStride;
+    UINT8 *dst = (UINT8 *)fb->getBufferPtr(rect->left, rect->top + y);
+    for (int x = 0; x < width; x++) {
+      int c = lumaRow[x] - 16;
+      int d = chromaRow[x & ~1] - 128;
+      int e = chromaRow[(x & ~1) + 1] - 128;
+      int r = (298 * c + 409 * e + 128) >> 8;
+      int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
+      int b = (298 * c + 516 * d + 128) >> 8;
+      r = r < 0 ? 0 : (r > 255 ? 255 : r);
+      g = g < 0 ? 0 : (g > 255 ? 255 : g);
+      b = b < 0 ? 0 : (b > 255 ? 255 : b);
+      UINT32 pixel = ((UINT32)r * pf.redMax + 127) / 255 << pf.redShift |
+                     ((UINT32)g * pf.greenMax + 127) / 255 << pf.greenShift |
+                     ((UINT32)b * pf.blueMax + 127) / 255 << pf.blueShift;
+      memcpy(dst, &pixel, bytesPerPixel);
+      dst += bytesPerPixel;
+    }
+  }
+
+  buffer->Unlock();
+  buffer->Release();
+}
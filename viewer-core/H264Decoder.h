@@ -0,0 +1,81 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _H264_DECODER_H_
+#define _H264_DECODER_H_
+
+#include "DecoderOfRectangle.h"
+
+#include "win-system/MediaFoundation.h"
+
+//
+// H264Decoder decodes rectangles of the Open H.264 encoding with the Media
+// Foundation H.264 decoder. Each rectangle carries the next frame of an
+// H.264 stream of the same area, so the decoder keeps its state (context)
+// between rectangles. A new context is started when the server asks for it
+// or when the rectangle changes.
+//
+
+class H264Decoder : public DecoderOfRectangle
+{
+public:
+  // Throws Exception if Media Foundation is not available.
+  H264Decoder(LogWriter *logWriter);
+  virtual ~H264Decoder();
+
+protected:
+  virtual void decode(RfbInputGate *input,
+                      FrameBuffer *frameBuffer,
+                      const Rect *dstRect);
+
+  static const UINT32 RESET_CONTEXT = 1;
+  static const UINT32 RESET_ALL_CONTEXTS = 2;
+
+  // Create the decoder transform for frames of the rect size.
+  void createContext(const Rect *rect);
+  void releaseContext();
+
+  // Select NV12 output and read the frame layout of the decoder.
+  void setOutputType();
+
+  // Feed the data of one frame to the decoder and draw decoded frames.
+  void processData(vector<UINT8> *data, FrameBuffer *fb, const Rect *rect);
+  void drainOutput(FrameBuffer *fb, const Rect *rect);
+
+  // Convert an NV12 frame to the frame buffer pixels (BT.601, limited
+  // range).
+  void drawFrame(IMFSample *sample, FrameBuffer *fb, const Rect *rect);
+
+  MediaFoundation m_mf;
+  IMFTransform *m_transform;
+  Rect m_contextRect;
+  LONGLONG m_sampleTime;
+
+  // Layout of the decoded NV12 frames.
+  UINT32 m_frameWidth;
+  UINT32 m_frameHeight;
+  UINT32 m_frameStride;
+};
+
+#endif
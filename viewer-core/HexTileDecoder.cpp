@@ -25,6 +25,7 @@
 #include "HexTileDecoder.h"
 
 #include <algorithm>
+#include <string.h>
 
 HexTileDecoder::HexTileDecoder(LogWriter *logWriter)
 : DecoderOfRectangle(logWriter)
@@ -70,8 +71,11 @@ void HexTileDecoder::decode(RfbInputGate *input,
           backgroundAccepted = true;
         }
 
-        if (backgroundAccepted)
-          framebuffer->fillRect(&tileRect, background);
+        int fillCount = 0;
+        if (backgroundAccepted) {
+          m_fillRects[fillCount] = tileRect;
+          m_fillColors[fillCount++] = background;
+        }
 
         if (flags & 0x4)
           input->readFully(&foreground, bytesPerPixel);
@@ -79,26 +83,37 @@ void HexTileDecoder::decode(RfbInputGate *input,
         if (flags & 0x8) {
           UINT8 numberOfSubrectangles = input->readUInt8();
 
-          for (int i = 0; i < numberOfSubrectangles; i++) {
+          // All the subrectangles of the tile are read at once.
+          bool isColored = (flags & 0x10) && !(flags & 0x4);
+          size_t subrectSize = isColored ? bytesPerPixel + 2 : 2;
+          if (numberOfSubrectangles > 0) {
+            input->readFully(m_subrectData, numberOfSubrectangles * subrectSize);
+          }
+
+          const UINT8 *subrect = m_subrectData;
+          for (int i = 0; i < numberOfSubrectangles; i++, subrect += subrectSize) {
 
-            if (flags & 0x10 && !(flags & 0x4))
-              input->readFully(&foreground, bytesPerPixel);
+            if (isColored)
+              memcpy(&foreground, subrect, bytesPerPixel);
 
-            UINT8 xy = input->readUInt8();
-            UINT8 wh = input->readUInt8();
+            UINT8 xy = subrect[subrectSize - 2];
+            UINT8 wh = subrect[subrectSize - 1];
             int x = (xy >> 4) & 0xF;
             int y = xy & 0xF;
             int w = ((wh >> 4) & 0xF) + 1;
             int h = (wh & 0xF) + 1;
-            Rect subRect(x, y, x + w, y + h);
+            Rect *subRect = &m_fillRects[fillCount];
+            subRect->setRect(x, y, x + w, y + h);
 
-            subRect.move(tileRect.left, tileRect.top);
-            framebuffer->fillRect(&subRect, foreground);
+            subRect->move(tileRect.left, tileRect.top);
+            m_fillColors[fillCount++] = foreground;
           }
         } else { // exist subrect
           if (!backgroundAccepted)
             throw Exception(_T("Server error in HexTile encoding: background color not accepted"));
         }
+
+        framebuffer->fillRects(m_fillRects, m_fillColors, fillCount);
       } // it tile is not RAW
     } // for each tiles in line
   } // for each line of tile
@@ -39,6 +39,15 @@ protected:
                       const Rect *dstRect);
 private:
   static const int TILE_SIZE = 16;
+  // The background and up to 255 subrectangles.
+  static const int MAX_FILLS = 256;
+  // Largest subrectangle: a 4-byte pixel, the position and the size.
+  static const size_t MAX_SUBRECT_SIZE = 4 + 2;
+
+  // The fills of a tile, done with one call.
+  Rect m_fillRects[MAX_FILLS];
+  UINT32 m_fillColors[MAX_FILLS];
+  UINT8 m_subrectData[(MAX_FILLS - 1) * MAX_SUBRECT_SIZE];
 };
 
 #endif
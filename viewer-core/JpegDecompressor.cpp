@@ -73,17 +73,84 @@ void JpegDecompressor::decompress(vector<UINT8> &buffer,
   if (!dstRect->isValid())
     throw Exception(_T("invalid destination rectangle in jpeg-decompressor"));
 
-  if (buffer.size() == 0 || buffer.size() < jpegBufLen)
-    throw Exception(_T("incorrect size of buffer in jpeg-decompressor"));
-  UINT8 *src_buf = &buffer.front();
-  size_t src_buf_size = jpegBufLen;
-
   size_t width = dstRect->getWidth();
   size_t height = dstRect->getHeight();
   size_t pixelBufferCount =  width * height * BYTES_PER_PIXEL;
   if (pixels.size() == 0 || pixels.size() < pixelBufferCount)
     throw Exception(_T("incorrect size of pixels-buffer in jpeg-decompressor"));
-  UINT8 *dst_buf = &pixels.front();
+
+  decompressRows(buffer, jpegBufLen, dstRect, &pixels.front(),
+                 width * BYTES_PER_PIXEL, JCS_RGB);
+}
+
+bool JpegDecompressor::canDecompressTo(const PixelFormat *pf)
+{
+  J_COLOR_SPACE colorSpace;
+  return getDirectColorSpace(pf, &colorSpace);
+}
+
+void JpegDecompressor::decompress(vector<UINT8> &buffer,
+                                  size_t jpegBufLen,
+                                  FrameBuffer *fb,
+                                  const Rect *dstRect)
+{
+  if (!dstRect->isValid())
+    throw Exception(_T("invalid destination rectangle in jpeg-decompressor"));
+
+  PixelFormat pf = fb->getPixelFormat();
+  J_COLOR_SPACE colorSpace;
+  if (!getDirectColorSpace(&pf, &colorSpace))
+    throw Exception(_T("unsupported pixel format in jpeg-decompressor"));
+
+  Rect fbRect = fb->getDimension().getRect();
+  if (!fbRect.isFullyContainRect(dstRect))
+    throw Exception(_T("destination rectangle is out of frame buffer"));
+
+  UINT8 *dstBuf = (UINT8 *)fb->getBufferPtr(dstRect->left, dstRect->top);
+  decompressRows(buffer, jpegBufLen, dstRect, dstBuf,
+                 fb->getBytesPerRow(), colorSpace);
+}
+
+bool JpegDecompressor::getDirectColorSpace(const PixelFormat *pf,
+                                           J_COLOR_SPACE *colorSpace)
+{
+#ifdef JCS_EXTENSIONS
+  if (pf->bitsPerPixel != 32 || pf->bigEndian ||
+      pf->redMax != 255 || pf->greenMax != 255 || pf->blueMax != 255) {
+    return false;
+  }
+  // Byte order in memory corresponds to little-endian pixel values.
+  if (pf->redShift == 16 && pf->greenShift == 8 && pf->blueShift == 0) {
+    *colorSpace = JCS_EXT_BGRX;
+  } else if (pf->redShift == 0 && pf->greenShift == 8 &&
+             pf->blueShift == 16) {
+    *colorSpace = JCS_EXT_RGBX;
+  } else if (pf->redShift == 24 && pf->greenShift == 16 &&
+             pf->blueShift == 8) {
+    *colorSpace = JCS_EXT_XBGR;
+  } else if (pf->redShift == 8 && pf->greenShift == 16 &&
+             pf->blueShift == 24) {
+    *colorSpace = JCS_EXT_XRGB;
+  } else {
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void JpegDecompressor::decompressRows(vector<UINT8> &buffer,
+                                      size_t jpegBufLen,
+                                      const Rect *dstRect,
+                                      UINT8 *dst_buf,
+                                      size_t rowStride,
+                                      J_COLOR_SPACE colorSpace)
+{
+  if (buffer.size() == 0 || buffer.size() < jpegBufLen)
+    throw Exception(_T("incorrect size of buffer in jpeg-decompressor"));
+  UINT8 *src_buf = &buffer.front();
+  size_t src_buf_size = jpegBufLen;
 
   try {
     /* Initialize data source and read the header. */
@@ -101,7 +168,7 @@ void JpegDecompressor::decompress(vector<UINT8> &buffer,
     }
 
     /* Configure and start decompression. */
-    m_jpeg.cinfo.out_color_space = JCS_RGB;
+    m_jpeg.cinfo.out_color_space = colorSpace;
     jpeg_start_decompress(&m_jpeg.cinfo);
     if (m_jpeg.cinfo.output_width != jpegWidth ||
         m_jpeg.cinfo.output_height != jpegHeight ) {
@@ -112,7 +179,7 @@ void JpegDecompressor::decompress(vector<UINT8> &buffer,
     /* Consume decompressed data. */
     while (m_jpeg.cinfo.output_scanline < m_jpeg.cinfo.output_height) {
       size_t bufferIndex = m_jpeg.cinfo.output_scanline;
-      size_t bufferOffset = bufferIndex * width * BYTES_PER_PIXEL;
+      size_t bufferOffset = bufferIndex * rowStride;
 
       JSAMPROW row_ptr[1];
       row_ptr[0] = &dst_buf[bufferOffset];
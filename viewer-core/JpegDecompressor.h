@@ -28,6 +28,7 @@
 #include <cstdio>
 
 #include "region/Rect.h"
+#include "rfb/FrameBuffer.h"
 
 // More help of jpeg-lib in /usr/share/doc/jpeg-8c-r1/example.c.bz2
 
@@ -63,7 +64,38 @@ public:
                   vector<UINT8> &pixels,
                   const Rect *dstRect);
 
+  /*
+   * Return true if the JPEG library can write pixels of the given format
+   * directly. That is only possible with libjpeg-turbo, which produces
+   * 32-bit RGBX/BGRX/XRGB/XBGR output via its JCS_EXT_* color spaces.
+   */
+  static bool canDecompressTo(const PixelFormat *pf);
+
+  /*
+   * Decompress JPEG data right into the dstRect area of the frame buffer,
+   * skipping the intermediate RGB buffer. The pixel format of the frame
+   * buffer must be accepted by canDecompressTo().
+   */
+  void decompress(vector<UINT8> &buffer,
+                  size_t jpegBufLen,
+                  FrameBuffer *fb,
+                  const Rect *dstRect);
+
 private:
+  static bool getDirectColorSpace(const PixelFormat *pf,
+                                  J_COLOR_SPACE *colorSpace);
+
+  /*
+   * Decompress the image into rows of rowStride bytes starting at dstBuf,
+   * using the specified output color space.
+   */
+  void decompressRows(vector<UINT8> &buffer,
+                      size_t jpegBufLen,
+                      const Rect *dstRect,
+                      UINT8 *dstBuf,
+                      size_t rowStride,
+                      J_COLOR_SPACE colorSpace);
+
   /*
    * Initialize JPEG decoder. This function initializes the TD_JPEG_DECOMPRESSOR
    * structure. 
@@ -0,0 +1,282 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "MulticastReceiver.h"
+
+#include "rfb/MsgDefs.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+#include "zlib/zlib.h"
+
+MulticastReceiver::MulticastReceiver(UINT32 address, UINT16 port,
+                                     FrameBuffer *fb, LocalMutex *fbLock,
+                                     FbUpdateNotifier *fbUpdateNotifier,
+                                     MulticastReceiverListener *listener,
+                                     LogWriter *logWriter)
+: m_socket(0),
+  m_frameBuffer(fb),
+  m_fbLock(fbLock),
+  m_fbUpdateNotifier(fbUpdateNotifier),
+  m_hasStream(false),
+  m_streamId(0),
+  m_nextSeq(0),
+  m_isReceiving(false),
+  m_isReported(false),
+  m_lastReceiveTime(0),
+  m_listener(listener),
+  m_logWriter(logWriter)
+{
+  struct sockaddr_in groupAddr;
+  memset(&groupAddr, 0, sizeof(groupAddr));
+  groupAddr.sin_family = AF_INET;
+  groupAddr.sin_addr.s_addr = address;
+  groupAddr.sin_port = htons(port);
+  m_groupAddress = SocketAddressIPv4(groupAddr);
+}
+
+MulticastReceiver::~MulticastReceiver()
+{
+  terminate();
+  wait();
+  delete m_socket;
+}
+
+void MulticastReceiver::onTerminate()
+{
+  m_wakeEvent.notify();
+}
+
+void MulticastReceiver::open()
+{
+  struct sockaddr_in localAddr;
+  memset(&localAddr, 0, sizeof(localAddr));
+  localAddr.sin_family = AF_INET;
+  localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  localAddr.sin_port = htons(m_groupAddress.getPort());
+
+  m_socket = new DatagramSocketIPv4();
+  // Other viewers on the same computer receive the same group.
+  m_socket->setReuseAddress(true);
+  m_socket->bind(SocketAddressIPv4(localAddr));
+  m_socket->joinGroup(m_groupAddress);
+  try {
+    m_socket->setReceiveBufferSize(RECEIVE_BUFFER_SIZE);
+  } catch (...) {
+    // The small buffer loses more datagrams, which are repaired.
+  }
+  m_socket->setReadEvent(m_socketEvent.getHandle());
+}
+
+void MulticastReceiver::execute()
+{
+  StringStorage group;
+  m_groupAddress.toString(&group);
+  try {
+    open();
+    m_logWriter->info(_T("Joined the multicast group %s:%u"),
+                      group.getString(), (unsigned int)m_groupAddress.getPort());
+  } catch (Exception &e) {
+    m_logWriter->error(_T("Cannot join the multicast group %s: %s"),
+                       group.getString(), e.getMessage());
+    return;
+  }
+
+  HANDLE events[2] = { m_socketEvent.getHandle(), m_wakeEvent.getHandle() };
+  DWORD startTime = GetTickCount();
+  try {
+    while (!isTerminating()) {
+      receiveDatagrams();
+
+      DWORD now = GetTickCount();
+      if (m_isReceiving &&
+          now - m_lastReceiveTime >= MulticastDefs::RECEPTION_TIMEOUT) {
+        m_logWriter->info(_T("Nothing has come from the multicast group for %u ms"),
+                          MulticastDefs::RECEPTION_TIMEOUT);
+        setReceiving(false);
+      } else if (!m_isReceiving && !m_isReported &&
+                 now - startTime >= MulticastDefs::RECEPTION_TIMEOUT) {
+        m_logWriter->info(_T("Nothing comes from the multicast group, the screen")
+                          _T(" goes by the connection"));
+        setReceiving(false);
+      }
+      WaitForMultipleObjects(2, events, FALSE, MulticastDefs::HEARTBEAT_INTERVAL);
+    }
+  } catch (Exception &e) {
+    m_logWriter->error(_T("Multicast reception has failed: %s"), e.getMessage());
+    if (m_isReceiving) {
+      setReceiving(false);
+    }
+  }
+  try {
+    m_socket->leaveGroup(m_groupAddress);
+  } catch (...) {
+  }
+}
+
+void MulticastReceiver::receiveDatagrams()
+{
+  char datagram[MulticastDefs::MAX_DATAGRAM_SIZE];
+  while (!isTerminating()) {
+    int size;
+    try {
+      size = m_socket->recv(datagram, sizeof(datagram));
+    } catch (IOException &e) {
+      // An error of one datagram, such as a too long one, loses it only.
+      m_logWriter->debug(_T("Cannot receive a multicast datagram: %s"),
+                         e.getMessage());
+      continue;
+    }
+    if (size < 0) {
+      break;
+    }
+    processDatagram(datagram, size);
+  }
+}
+
+void MulticastReceiver::processDatagram(const char *datagram, size_t size)
+{
+  if (size < MulticastDefs::HEADER_SIZE ||
+      getUInt32(datagram) != MulticastDefs::MAGIC) {
+    return;
+  }
+  UINT32 streamId = getUInt32(datagram + 4);
+  UINT32 seq = getUInt32(datagram + 8);
+  Dimension dim(getUInt16(datagram + 12), getUInt16(datagram + 14));
+  UINT8 kind = (UINT8)datagram[16];
+  {
+    AutoLock al(m_fbLock);
+    if (!m_frameBuffer->getDimension().isEqualTo(&dim)) {
+      return;
+    }
+  }
+
+  m_lastReceiveTime = GetTickCount();
+  if (!m_isReceiving) {
+    m_logWriter->info(_T("Receiving the screen from the multicast group"));
+    setReceiving(true);
+  }
+
+  if (kind == MulticastDefs::HEARTBEAT) {
+    checkSequence(streamId, seq);
+    return;
+  }
+  if (kind != MulticastDefs::TILE ||
+      size < MulticastDefs::HEADER_SIZE + MulticastDefs::TILE_HEADER_SIZE) {
+    return;
+  }
+  // A tile older than the expected one was reported lost, its repair
+  // brings newer pixels.
+  if (m_hasStream && streamId == m_streamId && (INT32)(seq - m_nextSeq) < 0) {
+    return;
+  }
+  checkSequence(streamId, seq);
+  m_nextSeq = seq + 1;
+
+  const char *tileHeader = datagram + MulticastDefs::HEADER_SIZE;
+  int x = getUInt16(tileHeader);
+  int y = getUInt16(tileHeader + 2);
+  Rect rect(x, y, x + getUInt16(tileHeader + 4), y + getUInt16(tileHeader + 6));
+  const size_t dataOffset = MulticastDefs::HEADER_SIZE + MulticastDefs::TILE_HEADER_SIZE;
+  if (rect.isEmpty() || !dim.getRect().isFullyContainRect(&rect)) {
+    return;
+  }
+  processTile(&rect, datagram + dataOffset, size - dataOffset);
+}
+
+void MulticastReceiver::checkSequence(UINT32 streamId, UINT32 seq)
+{
+  if (!m_hasStream || streamId != m_streamId) {
+    // The stream is new, the earlier screen has come by the connection.
+    m_hasStream = true;
+    m_streamId = streamId;
+    m_nextSeq = seq;
+    return;
+  }
+  if ((INT32)(seq - m_nextSeq) <= 0) {
+    return;
+  }
+  UINT32 lost = seq - m_nextSeq;
+  m_logWriter->debug(_T("%u multicast tiles from %u have been lost"),
+                     (unsigned int)lost, (unsigned int)m_nextSeq);
+  m_listener->onMulticastLoss(streamId, m_nextSeq,
+                              lost > MAX_REPAIR_TILES ? 0 : (UINT16)lost);
+  m_nextSeq = seq;
+}
+
+void MulticastReceiver::processTile(const Rect *rect, const char *data,
+                                    size_t size)
+{
+  int width = rect->getWidth();
+  int height = rect->getHeight();
+  size_t rowSize = width * 4;
+  m_pixels.resize(rowSize * height);
+  uLongf pixelsSize = (uLongf)m_pixels.size();
+  if (uncompress((Bytef *)&m_pixels.front(), &pixelsSize,
+                 (const Bytef *)data, (uLong)size) != Z_OK ||
+      pixelsSize != m_pixels.size()) {
+    m_logWriter->debug(_T("Invalid multicast tile"));
+    return;
+  }
+
+  PixelFormat wirePf = StandardPixelFormatFactory::create32bppPixelFormat();
+  Dimension tileDim(width, height);
+  m_tileFb.setProperties(&tileDim, &wirePf);
+  for (int row = 0; row < height; row++) {
+    memcpy(m_tileFb.getBufferPtr(0, row), &m_pixels[row * rowSize], rowSize);
+  }
+
+  {
+    AutoLock al(m_fbLock);
+    PixelFormat fbPf = m_frameBuffer->getPixelFormat();
+    if (!fbPf.isEqualTo(&m_fbPf)) {
+      m_pixelConverter.setPixelFormats(&fbPf, &wirePf);
+      m_fbPf = fbPf;
+    }
+    Rect tileRect(width, height);
+    const FrameBuffer *converted = m_pixelConverter.convert(&tileRect, &m_tileFb);
+    m_frameBuffer->copyFrom(rect, converted, 0, 0);
+    // Reported under the lock, so that a CopyRect from the decoding thread
+    // never reads the tile before it is known to be changed.
+    Region changed(*rect);
+    m_fbUpdateNotifier->onRegionUpdate(&changed);
+  }
+}
+
+void MulticastReceiver::setReceiving(bool receiving)
+{
+  m_isReceiving = receiving;
+  m_isReported = true;
+  m_listener->onMulticastReception(receiving);
+}
+
+UINT16 MulticastReceiver::getUInt16(const char *p)
+{
+  return (UINT16)(((UINT8)p[0] << 8) | (UINT8)p[1]);
+}
+
+UINT32 MulticastReceiver::getUInt32(const char *p)
+{
+  return ((UINT32)getUInt16(p) << 16) | getUInt16(p + 2);
+}
@@ -0,0 +1,126 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _MULTICAST_RECEIVER_H_
+#define _MULTICAST_RECEIVER_H_
+
+#include "log-writer/LogWriter.h"
+#include "network/socket/DatagramSocketIPv4.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelConverter.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+
+#include "FbUpdateNotifier.h"
+
+#include <vector>
+
+// Receiver of the events of MulticastReceiver, called by its thread.
+class MulticastReceiverListener
+{
+public:
+  virtual ~MulticastReceiverListener() {}
+
+  // The stream is received, or not any more.
+  virtual void onMulticastReception(bool receiving) = 0;
+  // The count tiles from firstSeq have been lost, 0 tiles if too many have
+  // been lost to name them.
+  virtual void onMulticastLoss(UINT32 streamId, UINT32 firstSeq,
+                               UINT16 count) = 0;
+};
+
+//
+// Receives the screen from the multicast group of the server (see
+// MulticastDefs) into the frame buffer. The datagrams of a frame buffer of
+// another size are of no use and ignored, the connection brings the screen
+// then.
+//
+class MulticastReceiver : public Thread
+{
+public:
+  // The address of the group is in network byte order.
+  MulticastReceiver(UINT32 address, UINT16 port,
+                    FrameBuffer *fb, LocalMutex *fbLock,
+                    FbUpdateNotifier *fbUpdateNotifier,
+                    MulticastReceiverListener *listener,
+                    LogWriter *logWriter);
+  virtual ~MulticastReceiver();
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // Joins the group.
+  // @throws Exception on fail.
+  void open();
+  void receiveDatagrams();
+  void processDatagram(const char *datagram, size_t size);
+  void processTile(const Rect *rect, const char *data, size_t size);
+  // Reports the tiles missed before seq.
+  void checkSequence(UINT32 streamId, UINT32 seq);
+  void setReceiving(bool receiving);
+
+  static UINT16 getUInt16(const char *p);
+  static UINT32 getUInt32(const char *p);
+
+  SocketAddressIPv4 m_groupAddress;
+  DatagramSocketIPv4 *m_socket;
+  WindowsEvent m_socketEvent;
+  WindowsEvent m_wakeEvent;
+
+  FrameBuffer *m_frameBuffer;
+  LocalMutex *m_fbLock;
+  FbUpdateNotifier *m_fbUpdateNotifier;
+
+  // The stream and the next tile expected from it.
+  bool m_hasStream;
+  UINT32 m_streamId;
+  UINT32 m_nextSeq;
+
+  // m_isReceiving is set by the first datagram and reset when none has
+  // come for RECEPTION_TIMEOUT ms.
+  bool m_isReceiving;
+  bool m_isReported;
+  DWORD m_lastReceiveTime;
+
+  FrameBuffer m_tileFb;
+  PixelFormat m_fbPf;
+  PixelConverter m_pixelConverter;
+  std::vector<char> m_pixels;
+
+  MulticastReceiverListener *m_listener;
+  LogWriter *m_logWriter;
+
+  // More lost tiles are repaired by the whole screen.
+  static const UINT32 MAX_REPAIR_TILES = 1024;
+  static const int RECEIVE_BUFFER_SIZE = 1024 * 1024;
+
+  // Do not allow copying objects.
+  MulticastReceiver(const MulticastReceiver &);
+  MulticastReceiver &operator=(const MulticastReceiver &);
+};
+
+#endif
@@ -0,0 +1,242 @@
+// Copyright (C) 2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "PixelUnpacker.h"
+#include "util/CpuFeatures.h"
+#include "rfb/PixelFiller.h"
+
+#include <string.h>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+void PixelUnpacker::fill(void *dst, UINT32 color, size_t count,
+                         size_t bytesPerPixel)
+{
+  PixelFiller::fillSpan(dst, color, count, bytesPerPixel);
+}
+
+void PixelUnpacker::expandIndexes(const UINT8 *src, size_t bitsPerIndex,
+                                  const UINT32 *palette, void *dst,
+                                  size_t count, size_t bytesPerPixel)
+{
+  size_t done = 0;
+  if (bytesPerPixel == 4) {
+    if (CpuFeatures::hasAvx2()) {
+      done = expandIndexesAvx2(src, bitsPerIndex, palette, (UINT32 *)dst,
+                               count);
+    } else if (bitsPerIndex == 1 && CpuFeatures::hasSse2()) {
+      done = expandMonoSse2(src, palette, (UINT32 *)dst, count);
+    }
+  }
+  // The vector versions stop at a byte boundary of the indexes.
+  expandIndexesPlain(src + done * bitsPerIndex / 8, bitsPerIndex, palette,
+                     (UINT8 *)dst + done * bytesPerPixel, count - done,
+                     bytesPerPixel);
+}
+
+void PixelUnpacker::expandIndexesPlain(const UINT8 *src, size_t bitsPerIndex,
+                                       const UINT32 *palette, UINT8 *dst,
+                                       size_t count, size_t bytesPerPixel)
+{
+  const unsigned int mask = (1 << bitsPerIndex) - 1;
+  size_t shift = 8;
+  for (size_t i = 0; i < count; i++, dst += bytesPerPixel) {
+    shift -= bitsPerIndex;
+    UINT32 color = palette[(*src >> shift) & mask];
+    if (shift == 0) {
+      shift = 8;
+      src++;
+    }
+    memcpy(dst, &color, bytesPerPixel);
+  }
+}
+
+size_t PixelUnpacker::expandMonoSse2(const UINT8 *src, const UINT32 *palette,
+                                     UINT32 *dst, size_t count)
+{
+  const __m128i background = _mm_set1_epi32((int)palette[0]);
+  const __m128i foreground = _mm_set1_epi32((int)palette[1]);
+  // The bits of the first and the last four pixels of a byte.
+  const __m128i highBits = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+  const __m128i lowBits = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8, src++) {
+    __m128i bits = _mm_set1_epi32(*src);
+    __m128i high = _mm_cmpeq_epi32(_mm_and_si128(bits, highBits), highBits);
+    __m128i low = _mm_cmpeq_epi32(_mm_and_si128(bits, lowBits), lowBits);
+    _mm_storeu_si128((__m128i *)(dst + i),
+                     _mm_or_si128(_mm_and_si128(high, foreground),
+                                  _mm_andnot_si128(high, background)));
+    _mm_storeu_si128((__m128i *)(dst + i + 4),
+                     _mm_or_si128(_mm_and_si128(low, foreground),
+                                  _mm_andnot_si128(low, background)));
+  }
+  return i;
+}
+
+size_t PixelUnpacker::expandIndexesAvx2(const UINT8 *src, size_t bitsPerIndex,
+                                        const UINT32 *palette, UINT32 *dst,
+                                        size_t count)
+{
+  // vpermd looks up eight entries, the 4-bit indexes use two halves of
+  // the palette and choose between them.
+  const int entries = 1 << bitsPerIndex;
+  UINT32 table[16] = {0};
+  memcpy(table, palette, entries * sizeof(UINT32));
+  const __m256i lowHalf = _mm256_loadu_si256((const __m256i *)table);
+  const __m256i highHalf = _mm256_loadu_si256((const __m256i *)(table + 8));
+  const __m256i mask = _mm256_set1_epi32(entries - 1);
+  const __m256i lastLowIndex = _mm256_set1_epi32(7);
+
+  // A group of eight indexes takes bitsPerIndex bytes, the first index is
+  // in the most significant bits.
+  const int b = (int)bitsPerIndex;
+  const __m256i shifts = _mm256_set_epi32(0, b, 2 * b, 3 * b,
+                                          4 * b, 5 * b, 6 * b, 7 * b);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8, src += bitsPerIndex) {
+    UINT32 group = 0;
+    for (size_t j = 0; j < bitsPerIndex; j++) {
+      group = group << 8 | src[j];
+    }
+    __m256i indexes = _mm256_and_si256(
+      _mm256_srlv_epi32(_mm256_set1_epi32((int)group), shifts), mask);
+    __m256i pixels = _mm256_permutevar8x32_epi32(lowHalf, indexes);
+    if (bitsPerIndex == 4) {
+      __m256i isHigh = _mm256_cmpgt_epi32(indexes, lastLowIndex);
+      pixels = _mm256_blendv_epi8(pixels,
+                                  _mm256_permutevar8x32_epi32(highHalf, indexes),
+                                  isHigh);
+    }
+    _mm256_storeu_si256((__m256i *)(dst + i), pixels);
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+void PixelUnpacker::expandCPixels(const UINT8 *src, UINT32 *dst, size_t count,
+                                  int layout)
+{
+  size_t done = 0;
+  if (CpuFeatures::hasSsse3()) {
+    done = expandCPixelsSsse3(src, dst, count, layout);
+  }
+  src += done * 3;
+  for (size_t i = done; i < count; i++, src += 3) {
+    dst[i] = getCPixel(src, layout);
+  }
+}
+
+size_t PixelUnpacker::expandCPixelsSsse3(const UINT8 *src, UINT32 *dst,
+                                         size_t count, int layout)
+{
+  // pshufb places the bytes of four pixels, the negative positions are
+  // zeroed.
+  __m128i shuffle;
+  if (layout == CPIXEL_RGB) {
+    shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1,
+                            8, 7, 6, -1, 11, 10, 9, -1);
+  } else if (layout == CPIXEL_LOW) {
+    shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                            6, 7, 8, -1, 9, 10, 11, -1);
+  } else {
+    shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                            -1, 6, 7, 8, -1, 9, 10, 11);
+  }
+
+  // A load takes 16 bytes to convert 12 of them, so it must not start
+  // within the last five pixels.
+  size_t i = 0;
+  for (; i + 6 <= count; i += 4, src += 12) {
+    __m128i data = _mm_loadu_si128((const __m128i *)src);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(data, shuffle));
+  }
+  return i;
+}
+
+void PixelUnpacker::decodeGradientRow(const UINT8 *src,
+                                      const UINT32 *upperRow,
+                                      UINT32 *dst, size_t count)
+{
+  if (CpuFeatures::hasSse2()) {
+    decodeGradientRowSse2(src, upperRow, dst, count);
+    return;
+  }
+  UINT32 left = 0;
+  UINT32 upperLeft = 0;
+  for (size_t i = 0; i < count; i++, src += 3) {
+    UINT32 upper = upperRow != 0 ? upperRow[i] : 0;
+    UINT32 difference = getCPixel(src, CPIXEL_RGB);
+    UINT32 pixel = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+      int prediction = (int)(left >> shift & 0xFF) +
+                       (int)(upper >> shift & 0xFF) -
+                       (int)(upperLeft >> shift & 0xFF);
+      prediction = prediction < 0 ? 0 : prediction > 0xFF ? 0xFF : prediction;
+      pixel |= ((prediction + (difference >> shift)) & 0xFF) << shift;
+    }
+    dst[i] = pixel;
+    left = pixel;
+    upperLeft = upper;
+  }
+}
+
+void PixelUnpacker::decodeGradientRowSse2(const UINT8 *src,
+                                          const UINT32 *upperRow,
+                                          UINT32 *dst, size_t count)
+{
+  // The components of a pixel are kept in 16-bit lanes, the prediction is
+  // clamped by packing them back to bytes with unsigned saturation. The
+  // fourth byte stays zero.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i left = zero;
+  __m128i upperLeft = zero;
+  for (size_t i = 0; i < count; i++, src += 3) {
+    __m128i upper = zero;
+    if (upperRow != 0) {
+      upper = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)upperRow[i]), zero);
+    }
+    __m128i prediction = _mm_sub_epi16(_mm_add_epi16(left, upper), upperLeft);
+    __m128i pixel = _mm_add_epi8(_mm_packus_epi16(prediction, zero),
+                                 _mm_cvtsi32_si128((int)getCPixel(src, CPIXEL_RGB)));
+    dst[i] = (UINT32)_mm_cvtsi128_si32(pixel);
+    left = _mm_unpacklo_epi8(pixel, zero);
+    upperLeft = upper;
+  }
+}
+
+UINT32 PixelUnpacker::getCPixel(const UINT8 *src, int layout)
+{
+  if (layout == CPIXEL_RGB) {
+    return (UINT32)src[0] << 16 | (UINT32)src[1] << 8 | src[2];
+  } else if (layout == CPIXEL_LOW) {
+    return (UINT32)src[2] << 16 | (UINT32)src[1] << 8 | src[0];
+  }
+  return (UINT32)src[2] << 24 | (UINT32)src[1] << 16 | (UINT32)src[0] << 8;
+}
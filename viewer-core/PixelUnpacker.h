@@ -0,0 +1,106 @@
+// Copyright (C) 2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _PIXEL_UNPACKER_H_
+#define _PIXEL_UNPACKER_H_
+
+#include <stddef.h>
+
+#include "util/inttypes.h"
+
+//
+// PixelUnpacker holds the inner loops of the Tight and ZRLE decoders: span
+// fills, palette index expansion, conversion of 3-byte pixels to 32-bit ones
+// and the reconstruction of the gradient filter. Each function uses SSE2,
+// SSSE3 or AVX2 if the processor supports them and plain C++ otherwise.
+//
+class PixelUnpacker
+{
+public:
+  // Byte order of 3-byte pixels (CPIXELs).
+  // Tight sends red, green and blue bytes, placed to the bits 16-23, 8-15
+  // and 0-7 of the pixel.
+  static const int CPIXEL_RGB = 0;
+  // ZRLE sends the pixel bytes in the memory order, taken from the three
+  // least significant bytes of a little-endian pixel...
+  static const int CPIXEL_LOW = 1;
+  // ...or from the three most significant ones.
+  static const int CPIXEL_HIGH = 2;
+
+  //
+  // Fills count pixels of 1, 2 or 4 bytes at dst with the color, see
+  // PixelFiller.
+  //
+  static void fill(void *dst, UINT32 color, size_t count,
+                   size_t bytesPerPixel);
+
+  //
+  // Writes count pixels of 1, 2 or 4 bytes to dst, looking up the palette
+  // with the indexes packed 1, 2 or 4 bits per index into src, starting
+  // from the most significant bits of the first byte. The palette must
+  // have an entry for each value of the index.
+  //
+  static void expandIndexes(const UINT8 *src, size_t bitsPerIndex,
+                            const UINT32 *palette, void *dst, size_t count,
+                            size_t bytesPerPixel);
+
+  //
+  // Converts count 3-byte pixels of the layout (one of the CPIXEL_*
+  // constants) from src to 32-bit pixels at dst.
+  //
+  static void expandCPixels(const UINT8 *src, UINT32 *dst, size_t count,
+                            int layout);
+
+  //
+  // Reconstructs a row of count 32-bit pixels filtered with the Tight
+  // "gradient" filter from the CPIXEL_RGB differences at src. The pixel
+  // format must have 8-bit components at the bit offsets 0, 8 and 16 in
+  // any order. upperRow is the reconstructed previous row or 0 for the
+  // first row of the rectangle.
+  //
+  static void decodeGradientRow(const UINT8 *src, const UINT32 *upperRow,
+                                UINT32 *dst, size_t count);
+
+private:
+  static void expandIndexesPlain(const UINT8 *src, size_t bitsPerIndex,
+                                 const UINT32 *palette, UINT8 *dst,
+                                 size_t count, size_t bytesPerPixel);
+  // Expand the indexes of the leading groups of complete bytes, return
+  // the number of the pixels written.
+  static size_t expandMonoSse2(const UINT8 *src, const UINT32 *palette,
+                               UINT32 *dst, size_t count);
+  static size_t expandIndexesAvx2(const UINT8 *src, size_t bitsPerIndex,
+                                  const UINT32 *palette, UINT32 *dst,
+                                  size_t count);
+  // Convert the leading pixels, return the number of the pixels converted.
+  static size_t expandCPixelsSsse3(const UINT8 *src, UINT32 *dst,
+                                   size_t count, int layout);
+  static void decodeGradientRowSse2(const UINT8 *src, const UINT32 *upperRow,
+                                    UINT32 *dst, size_t count);
+
+  static UINT32 getCPixel(const UINT8 *src, int layout);
+};
+
+#endif
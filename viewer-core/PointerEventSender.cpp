@@ -0,0 +1,137 @@
+// Copyright (C) 2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PointerEventSender.h"
+
+#include "thread/AutoLock.h"
+
+#include "RfbPointerEventClientMessage.h"
+
+PointerEventSender::PointerEventSender(LogWriter *logWriter)
+: m_output(0),
+  m_interval(DEFAULT_INTERVAL),
+  m_wasSent(false),
+  m_lastButtonMask(0),
+  m_hasPendingMotion(false),
+  m_logWriter(logWriter)
+{
+}
+
+PointerEventSender::~PointerEventSender()
+{
+  try {
+    terminate();
+    wait();
+  } catch (...) {
+  }
+}
+
+void PointerEventSender::setOutput(RfbOutputGate *output)
+{
+  {
+    AutoLock al(&m_sendLock);
+    m_output = output;
+  }
+  resume();
+}
+
+void PointerEventSender::setInterval(int milliseconds)
+{
+  {
+    AutoLock al(&m_sendLock);
+    m_interval = milliseconds > 0 ? milliseconds : 0;
+  }
+  m_pendingChanged.notify();
+}
+
+void PointerEventSender::sendPointerEvent(UINT8 buttonMask,
+                                          const Point *position)
+{
+  AutoLock al(&m_sendLock);
+
+  bool isMotion = m_wasSent && buttonMask == m_lastButtonMask;
+  if (isMotion && m_interval > 0) {
+    UINT64 elapsed = (DateTime::now() - m_lastSendTime).getTime();
+    if (elapsed < (UINT64)m_interval) {
+      m_pendingPosition = *position;
+      if (!m_hasPendingMotion) {
+        m_hasPendingMotion = true;
+        m_pendingChanged.notify();
+      }
+      return;
+    }
+  }
+
+  if (!isMotion && m_hasPendingMotion) {
+    send(m_lastButtonMask, &m_pendingPosition);
+  }
+  send(buttonMask, position);
+}
+
+void PointerEventSender::execute()
+{
+  try {
+    while (!isTerminating()) {
+      DWORD waitTime = sendPendingMotion();
+      m_pendingChanged.waitForEvent(waitTime);
+    }
+  } catch (const Exception &ex) {
+    m_logWriter->message(_T("PointerEventSender. Exception: %s"),
+                         ex.getMessage());
+  }
+}
+
+void PointerEventSender::onTerminate()
+{
+  m_pendingChanged.notify();
+}
+
+DWORD PointerEventSender::sendPendingMotion()
+{
+  AutoLock al(&m_sendLock);
+
+  if (!m_hasPendingMotion) {
+    return INFINITE;
+  }
+  UINT64 elapsed = (DateTime::now() - m_lastSendTime).getTime();
+  if (elapsed < (UINT64)m_interval) {
+    return (DWORD)(m_interval - elapsed);
+  }
+  send(m_lastButtonMask, &m_pendingPosition);
+  return INFINITE;
+}
+
+void PointerEventSender::send(UINT8 buttonMask, const Point *position)
+{
+  m_hasPendingMotion = false;
+  if (m_output == 0) {
+    return;
+  }
+
+  RfbPointerEventClientMessage pointerMessage(buttonMask, position);
+  pointerMessage.send(m_output);
+  m_wasSent = true;
+  m_lastButtonMask = buttonMask;
+  m_lastSendTime = DateTime::now();
+}
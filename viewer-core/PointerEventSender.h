@@ -0,0 +1,101 @@
+// Copyright (C) 2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _POINTER_EVENT_SENDER_H_
+#define _POINTER_EVENT_SENDER_H_
+
+#include "log-writer/LogWriter.h"
+#include "network/RfbOutputGate.h"
+#include "region/Point.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "util/DateTime.h"
+#include "win-system/WindowsEvent.h"
+
+//
+// Sends the pointer events of the viewer, coalescing motion.
+//
+// A mouse with a high polling rate reports a move every few milliseconds,
+// many more than the server is able to show. A motion event that follows
+// the previous sent event sooner than the interval is kept instead, and only
+// the latest kept motion is sent when the interval expires. A change of the
+// buttons is never delayed: the kept motion is sent right before it, so the
+// server sees the same sequence of buttons at the same positions.
+//
+class PointerEventSender : public Thread
+{
+public:
+  // About one frame at 60 Hz.
+  static const int DEFAULT_INTERVAL = 16;
+
+  PointerEventSender(LogWriter *logWriter);
+  virtual ~PointerEventSender();
+
+  // Sets the output and starts the thread.
+  void setOutput(RfbOutputGate *output);
+
+  // Sets the minimal interval between motion events, in milliseconds.
+  // Zero disables coalescing.
+  void setInterval(int milliseconds);
+
+  // Sends the event now or keeps it, if it is a motion too close to the
+  // previous event.
+  void sendPointerEvent(UINT8 buttonMask, const Point *position);
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+private:
+  // Sends the kept motion if its time has come. Returns the time to wait,
+  // in milliseconds, before it may be sent.
+  DWORD sendPendingMotion();
+
+  // Must be called with m_sendLock locked.
+  void send(UINT8 buttonMask, const Point *position);
+
+  // Protects the state below and keeps the events in order.
+  LocalMutex m_sendLock;
+
+  RfbOutputGate *m_output;
+  int m_interval;
+
+  bool m_wasSent;
+  UINT8 m_lastButtonMask;
+  DateTime m_lastSendTime;
+
+  bool m_hasPendingMotion;
+  Point m_pendingPosition;
+
+  WindowsEvent m_pendingChanged;
+
+  LogWriter *m_logWriter;
+
+private:
+  // Do not allow copying objects.
+  PointerEventSender(const PointerEventSender &);
+  PointerEventSender &operator=(const PointerEventSender &);
+};
+
+#endif
@@ -60,9 +60,8 @@ void RawDecoder::process(RfbInputGate *input,
   // Process all rectangle without last part of rectangle or 
   // two last part, if area of last part is less half of AREA_OF_ONE_PART.
   while (deltaRect.bottom + deltaHeight / 2 < rect->bottom) {
-    DecoderOfRectangle::process(input,
-                                frameBuffer, secondFrameBuffer, &deltaRect, fbLock,
-                                fbNotifier);
+    processPart(input, frameBuffer, secondFrameBuffer, &deltaRect, fbLock,
+                fbNotifier);
 
     // Increment position of rectangle.
     deltaRect.move(0, deltaHeight);
@@ -71,9 +70,31 @@ void RawDecoder::process(RfbInputGate *input,
   // And process remainder parts of rectangle.
   deltaRect.top = std::max(rect->top, deltaRect.bottom - deltaHeight);
   deltaRect.bottom = rect->bottom;
-  DecoderOfRectangle::process(input,
-                              frameBuffer, secondFrameBuffer, &deltaRect, fbLock,
-                              fbNotifier);
+  processPart(input, frameBuffer, secondFrameBuffer, &deltaRect, fbLock,
+              fbNotifier);
+}
+
+void RawDecoder::processPart(RfbInputGate *input,
+                             FrameBuffer *frameBuffer,
+                             FrameBuffer *secondFrameBuffer,
+                             const Rect *rect,
+                             LocalMutex *fbLock,
+                             FbUpdateNotifier *fbNotifier)
+{
+  size_t bytesPerPixel = frameBuffer->getPixelFormat().bitsPerPixel / 8;
+  size_t partSize = bytesPerPixel * rect->area();
+  if (m_isDrawingSkipped || input->available() < partSize) {
+    DecoderOfRectangle::process(input, frameBuffer, secondFrameBuffer, rect,
+                                fbLock, fbNotifier);
+    return;
+  }
+  // The pixels have been received already, reading them does not wait for
+  // the network, so they are read right into the frame buffer.
+  {
+    AutoLock al(fbLock);
+    decode(input, frameBuffer, rect);
+  }
+  notify(fbNotifier, rect);
 }
 
 void RawDecoder::decode(RfbInputGate *input,
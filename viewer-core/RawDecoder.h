@@ -49,6 +49,17 @@ protected:
                       const Rect *rect);
 
 private:
+  // Decodes one part of the rectangle. A part which has been received
+  // completely is read straight into frameBuffer, the others go through
+  // secondFrameBuffer, so that the frame buffer is not locked while
+  // waiting for the network.
+  void processPart(RfbInputGate *input,
+                   FrameBuffer *frameBuffer,
+                   FrameBuffer *secondFrameBuffer,
+                   const Rect *rect,
+                   LocalMutex *fbLock,
+                   FbUpdateNotifier *fbNotifier);
+
   static const size_t AREA_OF_ONE_PART = 1024 * 64;
 };
 
@@ -32,15 +32,22 @@
 #include "rfb/VendorDefs.h"
 #include "util/AnsiStringStorage.h"
 #include "util/Utf8StringStorage.h"
+#include "thread/SchedulingPolicy.h"
+#include "log-writer/ZoneProfiler.h"
+#include "log-writer/StallWatchdog.h"
+#include "zlib/zlib.h"
 
 #include "AuthHandler.h"
 #include "RichCursorDecoder.h"
+#include "RfbFenceClientMessage.h"
 #include "RfbFramebufferUpdateRequestClientMessage.h"
 #include "RfbCutTextEventClientMessage.h"
 #include "RfbKeyEventClientMessage.h"
-#include "RfbPointerEventClientMessage.h"
 #include "RfbSetEncodingsClientMessage.h"
 #include "RfbSetPixelFormatClientMessage.h"
+#include "RfbTileHashesClientMessage.h"
+#include "RfbDecodeFeedbackClientMessage.h"
+#include "RfbLatencyReportClientMessage.h"
 #include "WatermarksController.h"
 
 #include "RawDecoder.h"
@@ -49,16 +56,26 @@
 #include "HexTileDecoder.h"
 #include "TightDecoder.h"
 #include "ZrleDecoder.h"
+#include "H264Decoder.h"
+#include "TileCacheDecoder.h"
 
 #include "JpegQualityLevel.h"
+#include "ServerScale.h"
+#include "TransportZlib.h"
+#include "KeepFbOnResize.h"
+#include "LatencyProbe.h"
 #include "CompressionLevel.h"
 
 #include "DesktopSizeDecoder.h"
 #include "LastRectDecoder.h"
+#include "ContinuousUpdatesDecoder.h"
+#include "CursorCacheDecoder.h"
+#include "FenceDecoder.h"
 #include "PointerPosDecoder.h"
 #include "RichCursorDecoder.h"
 
 #include <algorithm>
+#include <memory>
 
 RemoteViewerCore::RemoteViewerCore(Logger *logger)
 : m_logWriter(logger),
@@ -66,6 +83,7 @@ RemoteViewerCore::RemoteViewerCore(Logger *logger)
   m_fbUpdateNotifier(&m_frameBuffer, &m_fbLock, &m_logWriter, &m_watermarksController),
   m_decoderStore(&m_logWriter),
   m_updateRequestSender(&m_fbLock, &m_frameBuffer, &m_logWriter),
+  m_pointerEventSender(&m_logWriter),
   m_dispatchDataProvider(0),
   m_isTightEnabled(true),
   m_isUtf8ClipboardEnabled(false)
@@ -82,6 +100,7 @@ RemoteViewerCore::RemoteViewerCore(const TCHAR *host, UINT16 port,
   m_fbUpdateNotifier(&m_frameBuffer, &m_fbLock, &m_logWriter, &m_watermarksController),
   m_decoderStore(&m_logWriter),
   m_updateRequestSender(&m_fbLock, &m_frameBuffer, &m_logWriter),
+  m_pointerEventSender(&m_logWriter),
   m_dispatchDataProvider(0),
   m_isTightEnabled(true),
   m_isUtf8ClipboardEnabled(false)
@@ -100,6 +119,7 @@ RemoteViewerCore::RemoteViewerCore(SocketIPv4 *socket,
   m_fbUpdateNotifier(&m_frameBuffer, &m_fbLock, &m_logWriter, &m_watermarksController),
   m_decoderStore(&m_logWriter),
   m_updateRequestSender(&m_fbLock, &m_frameBuffer, &m_logWriter),
+  m_pointerEventSender(&m_logWriter),
   m_dispatchDataProvider(0),
   m_isTightEnabled(true),
   m_isUtf8ClipboardEnabled(false)
@@ -118,6 +138,7 @@ RemoteViewerCore::RemoteViewerCore(RfbInputGate *input, RfbOutputGate *output,
   m_fbUpdateNotifier(&m_frameBuffer, &m_fbLock, &m_logWriter, &m_watermarksController),
   m_decoderStore(&m_logWriter),
   m_updateRequestSender(&m_fbLock, &m_frameBuffer, &m_logWriter),
+  m_pointerEventSender(&m_logWriter),
   m_dispatchDataProvider(0),
   m_isTightEnabled(true),
   m_isUtf8ClipboardEnabled(false)
@@ -135,11 +156,23 @@ void RemoteViewerCore::init()
   m_decoderStore.addDecoder(new HexTileDecoder(&m_logWriter), 4);
   m_decoderStore.addDecoder(new TightDecoder(&m_logWriter), 9);
   m_decoderStore.addDecoder(new ZrleDecoder(&m_logWriter), 9);
+  // H.264 is used by servers for video regions only. It is not available
+  // on systems without Media Foundation.
+  try {
+    m_decoderStore.addDecoder(new H264Decoder(&m_logWriter), 8);
+  } catch (const Exception &ex) {
+    m_logWriter.info(_T("H.264 decoding is not available: %s"), ex.getMessage());
+  }
+  // Tile cache is used by servers along with the preferred encoding.
+  m_decoderStore.addDecoder(new TileCacheDecoder(&m_logWriter), 7);
 
   m_decoderStore.addDecoder(new DesktopSizeDecoder(&m_logWriter), -1);
   m_decoderStore.addDecoder(new LastRectDecoder(&m_logWriter), -1);
   m_decoderStore.addDecoder(new PointerPosDecoder(&m_logWriter), -1);
   m_decoderStore.addDecoder(new RichCursorDecoder(&m_logWriter), -1);
+  m_decoderStore.addDecoder(new CursorCacheDecoder(&m_logWriter), -1);
+  m_decoderStore.addDecoder(new ContinuousUpdatesDecoder(&m_logWriter), -1);
+  m_decoderStore.addDecoder(new FenceDecoder(&m_logWriter), -1);
   m_input = 0;
   m_output = 0;
 
@@ -147,11 +180,27 @@ void RemoteViewerCore::init()
   m_wasConnected = false;
   m_isNewPixelFormat = false;
   m_isFreeze = false;
-  m_isNeedRequestUpdate = true;
+  m_isHidden = false;
+  m_resyncFrameBuffer = 0;
   m_forceFullUpdate = false;
 
   m_updateTimeout = 0;
 
+  m_isLazyClipboardEnabled = false;
+  m_hasCutTextOffer = false;
+  m_cutTextOfferSerial = 0;
+  m_cutTextOfferLength = 0;
+
+  QueryPerformanceFrequency(&m_perfFrequency);
+  m_feedbackStart = 0;
+  m_feedbackThreadTime = 0;
+  m_fbUpdateStart.QuadPart = 0;
+  m_isProbeReceived = false;
+  m_isProbePending = false;
+  m_fbUpdatesReceived = 0;
+  m_decodedPixels = 0;
+  m_decodeTime = 0;
+
   addClientMsgCapability(ClientMsgDefs::CLIENT_CUT_TEXT_UTF8,
     VendorDefs::TIGHTVNC,
     Utf8CutTextDefs::CLIENT_CUT_TEXT_UTF8_SIG, 
@@ -161,6 +210,65 @@ void RemoteViewerCore::init()
     VendorDefs::TIGHTVNC,
     Utf8CutTextDefs::ENABLE_CUT_TEXT_UTF8_SIG,
     _T("enable UTF-8 clipboard"));
+
+  addClientMsgCapability(ClientMsgDefs::ENABLE_CUT_TEXT_OFFERS,
+    VendorDefs::TIGHTVNC,
+    LazyCutTextDefs::ENABLE_CUT_TEXT_OFFERS_SIG,
+    _T("enable clipboard offers"));
+
+  addClientMsgCapability(ClientMsgDefs::CUT_TEXT_REQUEST,
+    VendorDefs::TIGHTVNC,
+    LazyCutTextDefs::CUT_TEXT_REQUEST_SIG,
+    _T("clipboard request"));
+
+  addClientMsgCapability(ClientMsgDefs::TILE_HASHES,
+    VendorDefs::TIGHTVNC,
+    TileHashesDefs::TILE_HASHES_SIG,
+    _T("tile hashes"));
+
+  addClientMsgCapability(ClientMsgDefs::DECODE_FEEDBACK,
+    VendorDefs::TIGHTVNC,
+    DecodeFeedbackDefs::DECODE_FEEDBACK_SIG,
+    _T("decode feedback"));
+
+  addClientMsgCapability(ClientMsgDefs::LATENCY_REPORT,
+    VendorDefs::TIGHTVNC,
+    LatencyProbeDefs::LATENCY_REPORT_SIG,
+    _T("latency report"));
+
+  addClientMsgCapability(ClientMsgDefs::ENABLE_BULK_CHANNEL,
+    VendorDefs::TIGHTVNC,
+    BulkChannelDefs::ENABLE_BULK_CHANNEL_SIG,
+    _T("bulk channel"));
+
+  addClientMsgCapability(ClientMsgDefs::ENABLE_MULTICAST,
+    VendorDefs::TIGHTVNC,
+    MulticastDefs::ENABLE_MULTICAST_SIG,
+    _T("multicast"));
+
+  addClientMsgCapability(ClientMsgDefs::MULTICAST_RECEPTION,
+    VendorDefs::TIGHTVNC,
+    MulticastDefs::MULTICAST_RECEPTION_SIG,
+    _T("multicast reception"));
+
+  addClientMsgCapability(ClientMsgDefs::MULTICAST_REPAIR,
+    VendorDefs::TIGHTVNC,
+    MulticastDefs::MULTICAST_REPAIR_SIG,
+    _T("multicast repair"));
+
+  // Only the servers announcing it stop resending the whole frame buffer
+  // after a desktop size change.
+  addEncodingCapability(new KeepFbOnResize(&m_logWriter), -1,
+    PseudoEncDefs::KEEP_FB_ON_RESIZE,
+    VendorDefs::TIGHTVNC,
+    PseudoEncDefs::SIG_KEEP_FB_ON_RESIZE,
+    _T("keep frame buffer on resize"));
+
+  addEncodingCapability(new LatencyProbe(&m_logWriter), -1,
+    PseudoEncDefs::LATENCY_PROBE,
+    VendorDefs::TIGHTVNC,
+    PseudoEncDefs::SIG_LATENCY_PROBE,
+    _T("latency probe"));
 }
 
 RemoteViewerCore::~RemoteViewerCore()
@@ -176,9 +284,11 @@ RemoteViewerCore::~RemoteViewerCore()
     } else {
       m_fbUpdateNotifier.wait();
 	  m_updateRequestSender.wait();
+      m_pointerEventSender.wait();
     }
   } catch (...) {
   }
+  delete m_resyncFrameBuffer;
 }
 
 void RemoteViewerCore::start(CoreEventsAdapter *adapter,
@@ -206,6 +316,7 @@ void RemoteViewerCore::start(CoreEventsAdapter *adapter,
   m_fbUpdateNotifier.setAdapter(adapter);
 
   // Start thread.
+  SchedulingPolicy::apply(this, SchedulingPolicy::ROLE_DECODE);
   resume();
   m_logWriter.debug(_T("Remote viewer core is started"));
 }
@@ -256,8 +367,21 @@ void RemoteViewerCore::stop()
   }
 
   m_updateRequestSender.terminate();
+  m_pointerEventSender.terminate();
 
   m_tcpConnection.close();
+  {
+    AutoLock al(&m_bulkChannelLock);
+    if (m_bulkChannel.get() != 0) {
+      m_bulkChannel->close();
+    }
+  }
+  {
+    AutoLock al(&m_multicastLock);
+    if (m_multicastReceiver.get() != 0) {
+      m_multicastReceiver->terminate();
+    }
+  }
   m_fbUpdateNotifier.terminate();
   terminate();
 }
@@ -266,7 +390,15 @@ void RemoteViewerCore::waitTermination()
 {
   m_fbUpdateNotifier.wait();
   m_updateRequestSender.wait();
+  m_pointerEventSender.wait();
   wait();
+  // The input thread which makes the channel has exited.
+  if (m_bulkChannel.get() != 0) {
+    m_bulkChannel->wait();
+  }
+  if (m_multicastReceiver.get() != 0) {
+    m_multicastReceiver->wait();
+  }
 }
 
 void RemoteViewerCore::setPixelFormat(const PixelFormat *pixelFormat)
@@ -288,6 +420,64 @@ void RemoteViewerCore::enableDispatching(DispatchDataProvider *src)
   }
 }
 
+void RemoteViewerCore::setResyncFrameBuffer(const FrameBuffer *frameBuffer)
+{
+  AutoLock al(&m_startLock);
+  if (!m_wasStarted) {
+    // As in enableDispatching(), the core thread does not exist yet.
+    if (m_resyncFrameBuffer == 0) {
+      m_resyncFrameBuffer = new FrameBuffer;
+    }
+    if (!m_resyncFrameBuffer->clone(frameBuffer)) {
+      delete m_resyncFrameBuffer;
+      m_resyncFrameBuffer = 0;
+    }
+  }
+}
+
+bool RemoteViewerCore::resyncFrameBuffer()
+{
+  if (m_resyncFrameBuffer == 0) {
+    return false;
+  }
+  // The pixels of the previous session are used once.
+  std::auto_ptr<FrameBuffer> resyncFb(m_resyncFrameBuffer);
+  m_resyncFrameBuffer = 0;
+
+  if (!m_clientMsgCaps.isEnabled(ClientMsgDefs::TILE_HASHES)) {
+    m_logWriter.debug(_T("Server does not support tile hashes, the whole screen is requested."));
+    return false;
+  }
+
+  // The server compares the pixels in the final pixel format.
+  updatePixelFormat();
+
+  Rect fbRect;
+  {
+    AutoLock al(&m_fbLock);
+    PixelFormat resyncPf = resyncFb->getPixelFormat();
+    PixelFormat fbPf = m_frameBuffer.getPixelFormat();
+    if (m_frameBuffer.getDimension() != resyncFb->getDimension() ||
+        !fbPf.isEqualTo(&resyncPf)) {
+      m_logWriter.info(_T("Frame buffer has changed since the previous session, the whole screen is requested."));
+      return false;
+    }
+    m_frameBuffer.copyFrom(resyncFb.get(), 0, 0);
+    fbRect = m_frameBuffer.getDimension().getRect();
+  }
+  m_logWriter.info(_T("Sending tile hashes of the previous session..."));
+  RfbTileHashesClientMessage hashesMessage(resyncFb.get(), RESYNC_TILE_SIZE);
+  hashesMessage.send(m_output);
+
+  // The frame buffer is up to date, except for the tiles the server sends.
+  {
+    AutoLock al(&m_refreshingLock);
+    m_isRefreshing = false;
+  }
+  m_fbUpdateNotifier.onUpdate(&fbRect);
+  return true;
+}
+
 bool RemoteViewerCore::updatePixelFormat()
 {
   PixelFormat pxFormat;
@@ -341,55 +531,55 @@ void RemoteViewerCore::deferUpdateRequests(const int& milliseconds)
 	m_updateRequestSender.setTimeout(milliseconds);
 }
 
+void RemoteViewerCore::setUpdateRequestPipeline(const int& depth)
+{
+  m_updateRequestSender.setPipelineDepth(depth);
+}
+
+void RemoteViewerCore::setPointerEventInterval(int milliseconds)
+{
+  m_pointerEventSender.setInterval(milliseconds);
+}
+
 void RemoteViewerCore::sendFbUpdateRequest(bool incremental)
 {
+  AutoLock al(&m_requestUpdateLock);
+
+  bool isNewPixelFormat;
   {
-    AutoLock al(&m_requestUpdateLock);
-    bool requestUpdate = m_isNeedRequestUpdate;
-    m_isNeedRequestUpdate = false;
-    if (!requestUpdate)
-      return;
+    AutoLock al(&m_pixelFormatLock);
+    isNewPixelFormat = m_isNewPixelFormat;
   }
-
-  bool isRefresh = false;
-  bool isUpdateFbProperties = false;
-  if (updatePixelFormat()) {
-    isUpdateFbProperties = true;
+  if (isNewPixelFormat) {
+    // Updates in flight are encoded in the old pixel format, so the format
+    // is changed when all of them are received.
+    m_updateRequestSender.setPaused(true);
+    if (m_updateRequestSender.getRequestsInFlight() != 0) {
+      return;
+    }
+    if (updatePixelFormat()) {
+      incremental = false;
+    }
   }
 
   {
     AutoLock al(&m_refreshingLock);
     if (m_isRefreshing) {
       m_isRefreshing= false;
-      isRefresh = true;
+      incremental = false;
     }
   }
 
-  if (isRefresh || isUpdateFbProperties || m_updateRequestSender.getTimeout() <= 0)
-  {
-	bool isIncremental = incremental && !isRefresh && !isUpdateFbProperties;
-	Rect updateRect;
-	{
-	  AutoLock al(&m_fbLock);
-	  updateRect = m_frameBuffer.getDimension().getRect();
-	}
-
-	if (isIncremental) {
-	  m_logWriter.debug(_T("Sending frame buffer incremental update request [%dx%d]..."),
-	                    updateRect.getWidth(), updateRect.getHeight());
-	} else {
-	  m_logWriter.debug(_T("Sending frame buffer full update request [%dx%d]..."),
-	                    updateRect.getWidth(), updateRect.getHeight());
-  }
-
-	RfbFramebufferUpdateRequestClientMessage fbUpdReq(isIncremental, updateRect);
-	fbUpdReq.send(m_output);
-	m_logWriter.debug(_T("Frame buffer update request is sent"));
-  }
-  else
+  if (!incremental) {
+    m_updateRequestSender.sendFullUpdateRequest();
+  }
+
+  bool isPaused;
   {
-	  m_updateRequestSender.setWasUpdated();
+    AutoLock al(&m_freezeLock);
+    isPaused = m_isFreeze || m_isHidden;
   }
+  m_updateRequestSender.setPaused(isPaused);
 }
 
 void RemoteViewerCore::sendKeyboardEvent(bool downFlag, UINT32 key)
@@ -417,11 +607,10 @@ void RemoteViewerCore::sendPointerEvent(UINT8 buttonMask,
 
   m_logWriter.detail(_T("Sending pointer event 0x%X, (%d, %d)..."),
                      static_cast<int>(buttonMask), position->x, position->y);
+  // Move the local cursor at once, the server may show the move much later.
+  m_fbUpdateNotifier.predictPointerPos(position);
   // send position to server
-  RfbPointerEventClientMessage pointerMessage(buttonMask, position);
-  pointerMessage.send(m_output);
-  // update position
-  m_fbUpdateNotifier.updatePointerPos(position);
+  m_pointerEventSender.sendPointerEvent(buttonMask, position);
 
   m_logWriter.debug(_T("Pointer event: 0x%X, (%d, %d) is sent"),
                     static_cast<int>(buttonMask), position->x, position->y);
@@ -448,9 +637,41 @@ void RemoteViewerCore::sendCutTextEvent(const StringStorage *cutText)
   m_logWriter.debug(_T("Clipboard cut text: \"%s\" is sent"), cutText->getString());
 }
 
+bool RemoteViewerCore::requestCutText()
+{
+  if (!wasConnected()) {
+    return false;
+  }
+
+  UINT32 serial;
+  {
+    AutoLock al(&m_cutTextLock);
+    if (!m_hasCutTextOffer) {
+      return false;
+    }
+    serial = m_cutTextOfferSerial;
+    m_cutTextChunks.clear();
+  }
+
+  m_logWriter.debug(_T("Requesting the offered clipboard %u"), (unsigned int)serial);
+  AutoLock al(m_output);
+  m_output->writeUInt32(ClientMsgDefs::CUT_TEXT_REQUEST);
+  m_output->writeUInt32(serial);
+  m_output->writeUInt8(LazyCutTextDefs::ACCEPT_ZLIB);
+  m_output->flush();
+  return true;
+}
+
 void RemoteViewerCore::setPreferredEncoding(INT32 encodingType)
 {
   m_decoderStore.setPreferredEncoding(encodingType);
+  if (encodingType == EncodingDefs::RAW ||
+      encodingType == EncodingDefs::RRE ||
+      encodingType == EncodingDefs::HEXTILE) {
+    m_decoderStore.addDecoder(new TransportZlib(&m_logWriter), -1);
+  } else {
+    m_decoderStore.removeDecoder(PseudoEncDefs::TRANSPORT_ZLIB);
+  }
   sendEncodings();
 }
 
@@ -460,6 +681,16 @@ void RemoteViewerCore::allowCopyRect(bool allow)
   sendEncodings();
 }
 
+void RemoteViewerCore::skipDrawing(bool skip)
+{
+  m_decoderStore.setDrawingSkipped(skip);
+}
+
+void RemoteViewerCore::setSocketProfile(const SocketProfile *profile)
+{
+  m_tcpConnection.setSocketProfile(profile);
+}
+
 void RemoteViewerCore::allowUtf8Clipboard()
 {
   m_isUtf8ClipboardEnabled = m_clientMsgCaps.isEnabled(ClientMsgDefs::CLIENT_CUT_TEXT_UTF8);
@@ -477,6 +708,19 @@ void RemoteViewerCore::allowUtf8Clipboard()
   }
 }
 
+void RemoteViewerCore::allowLazyClipboard()
+{
+  m_isLazyClipboardEnabled =
+    m_clientMsgCaps.isEnabled(ClientMsgDefs::ENABLE_CUT_TEXT_OFFERS) &&
+    m_clientMsgCaps.isEnabled(ClientMsgDefs::CUT_TEXT_REQUEST);
+  if (m_isLazyClipboardEnabled) {
+    m_logWriter.debug(_T("Sending EnableCutTextOffers message."));
+    AutoLock al(m_output);
+    m_output->writeUInt32(ClientMsgDefs::ENABLE_CUT_TEXT_OFFERS);
+    m_output->flush();
+  }
+}
+
 void RemoteViewerCore::setCompressionLevel(int newLevel)
 {
   bool needUpdate = false;
@@ -497,6 +741,21 @@ void RemoteViewerCore::setCompressionLevel(int newLevel)
   }
 }
 
+void RemoteViewerCore::setServerScale(int factor)
+{
+  bool needUpdate = false;
+  for (int i = ServerScale::SERVER_SCALE_MIN; i <= ServerScale::SERVER_SCALE_MAX; i *= 2)
+    if (i != factor)
+      needUpdate |= m_decoderStore.removeDecoder(ServerScale(&m_logWriter, i).getCode());
+
+  if (factor == 2 || factor == 4 || factor == 8) {
+    needUpdate |= m_decoderStore.addDecoder(new ServerScale(&m_logWriter, factor), -1);
+  }
+  if (needUpdate) {
+    sendEncodings();
+  }
+}
+
 void RemoteViewerCore::setJpegQualityLevel(int newLevel)
 {
   bool needUpdate = false;
@@ -522,9 +781,11 @@ void RemoteViewerCore::enableCursorShapeUpdates(bool enabled)
   bool needUpdate = false;
   if (enabled) {
     needUpdate |= m_decoderStore.addDecoder(new RichCursorDecoder(&m_logWriter), -1);
+    needUpdate |= m_decoderStore.addDecoder(new CursorCacheDecoder(&m_logWriter), -1);
     needUpdate |= m_decoderStore.addDecoder(new PointerPosDecoder(&m_logWriter), -1);
   } else {
     needUpdate |= m_decoderStore.removeDecoder(PseudoEncDefs::RICH_CURSOR);
+    needUpdate |= m_decoderStore.removeDecoder(PseudoEncDefs::CURSOR_CACHE);
     needUpdate |= m_decoderStore.removeDecoder(PseudoEncDefs::POINTER_POS);
   }
   
@@ -540,15 +801,37 @@ void RemoteViewerCore::ignoreCursorShapeUpdates(bool ignored)
 
 void RemoteViewerCore::stopUpdating(bool isStopped)
 {
+  bool isPaused;
   {
     AutoLock al(&m_freezeLock);
     if (isStopped == m_isFreeze)
       return;
     m_isFreeze = isStopped;
+    isPaused = m_isFreeze || m_isHidden;
+  }
+  m_updateRequestSender.setPaused(isPaused);
+  if (!isPaused) {
+    m_logWriter.detail(_T("Sending of frame buffer update request..."));
+    sendFbUpdateRequest();
+  }
+}
+
+void RemoteViewerCore::setHidden(bool isHidden)
+{
+  bool isPaused;
+  {
+    AutoLock al(&m_freezeLock);
+    if (isHidden == m_isHidden)
+      return;
+    m_isHidden = isHidden;
+    isPaused = m_isFreeze || m_isHidden;
   }
-  if (!isStopped) {
+  m_logWriter.detail(isHidden ? _T("Frame buffer is hidden, updates are paused")
+                              : _T("Frame buffer is visible again"));
+  m_updateRequestSender.setPaused(isPaused);
+  if (!isPaused && wasConnected()) {
     m_logWriter.detail(_T("Sending of frame buffer update request..."));
-    sendFbUpdateRequest(!m_forceFullUpdate);
+    sendFbUpdateRequest();
   }
 }
 
@@ -582,6 +865,7 @@ void RemoteViewerCore::connectToHost()
   m_output = m_tcpConnection.getOutput();
 
   m_updateRequestSender.setOutput(m_output);
+  m_pointerEventSender.setOutput(m_output);
 
   m_logWriter.detail(_T("Connection is established"));
   try {
@@ -616,6 +900,12 @@ void RemoteViewerCore::authenticate()
     }
   }
 
+  // The server reads ClientInit only after sending the result, so it is
+  // written right behind the authentication response, saving a round trip.
+  if (authenticationType != 0) {
+    sendClientInit();
+  }
+
   // get authentication result, if version 3.8 or authentication isn't None
   if (m_minor >= 8 || authenticationType != SecurityDefs::NONE) {
     UINT32 authResult = 0;
@@ -769,17 +1059,27 @@ void RemoteViewerCore::initTunnelling()
   UINT32 tunnelCount = m_input->readUInt32();
   if (tunnelCount > 0) {
     bool hasNoTunnel = false;
+    bool hasTls = false;
     for (UINT32 i = 0; i < tunnelCount; i++) {
       RfbCapabilityInfo cap = readCapability();
       if (cap.code == TunnelDefs::NOTUNNEL) {
         hasNoTunnel = true;
       }
+      if (cap.isEqual(VendorDefs::TIGHTVNC, TunnelDefs::SIG_TLS)) {
+        hasTls = true;
+      }
       // Special case for VNC server of Siemense PLC . It supports NOTUNNEL while there is no it in the list.
 	  if (cap.isEqual("SICR", "SCHANNEL")) {
         hasNoTunnel = true;
       }
     }
-    if (hasNoTunnel) {
+    // Connections over gates given by the application are left as they are.
+    if (hasTls && m_tcpConnection.isTlsPossible()) {
+      m_logWriter.info(_T("Starting TLS tunnel..."));
+      m_output->writeUInt32(TunnelDefs::TLS);
+      m_output->flush();
+      m_tcpConnection.startTls();
+    } else if (hasNoTunnel) {
       m_output->writeUInt32(TunnelDefs::NOTUNNEL);
       m_output->flush();
     } else {
@@ -866,6 +1166,30 @@ void RemoteViewerCore::setFbProperties(const Dimension *fbDimension,
   m_logWriter.debug(_T("Frame buffer properties set"));
 }
 
+void RemoteViewerCore::resizeFrameBuffer(const Dimension *fbDimension)
+{
+#ifdef _DEMO_VERSION_
+  m_watermarksController.setNewFbProperties(&fbDimension->getRect(),
+                                            &m_frameBuffer.getPixelFormat());
+#endif
+
+  m_logWriter.info(_T("Frame buffer dimension: (%d, %d), the pixels are kept"),
+                   fbDimension->width, fbDimension->height);
+
+  if (!m_frameBuffer.resizeKeepingContents(fbDimension) ||
+      !m_rectangleFb.setDimension(fbDimension)) {
+    StringStorage error;
+    error.format(_T("Failed to resize frame buffer to (%d, %d)"),
+                 fbDimension->width, fbDimension->height);
+    throw Exception(error.getString());
+  }
+  m_rectangleFb.setColor(0, 0, 0);
+  // No refresh is requested, the server sends the changed and the newly
+  // exposed pixels. The adapter copies the whole frame buffer on the
+  // change of its properties, so it shows the kept pixels at once.
+  m_fbUpdateNotifier.onPropertiesFb();
+}
+
 StringStorage RemoteViewerCore::getProtocolString() const
 {
   StringStorage protocolString;
@@ -878,6 +1202,79 @@ StringStorage RemoteViewerCore::getRemoteDesktopName() const
   return m_remoteDesktopName;
 }
 
+void RemoteViewerCore::onFramePresented()
+{
+  LatencyProbeInfo probe;
+  {
+    AutoLock al(&m_latencyLock);
+    // The update of the probe may still be on the way to the adapter.
+    if (!m_isProbePending ||
+        (INT32)(m_fbUpdateNotifier.getBatchesNotified() - m_pendingProbe.batch) < 0) {
+      return;
+    }
+    m_isProbePending = false;
+    probe = m_pendingProbe;
+  }
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  UINT64 presentTime = (UINT64)(now.QuadPart - probe.receiveTime) * 1000000 /
+                       (UINT64)m_perfFrequency.QuadPart;
+  if (presentTime > 0xFFFFFFFF) {
+    presentTime = 0xFFFFFFFF;
+  }
+  {
+    AutoLock al(&m_latencyLock);
+    if (probe.captureTime != 0) {
+      m_stageLatency[LatencyProbeDefs::STAGE_CAPTURE].add(probe.captureTime);
+    }
+    m_stageLatency[LatencyProbeDefs::STAGE_ENCODE].add(probe.encodeTime);
+    if (probe.networkTime != 0) {
+      m_stageLatency[LatencyProbeDefs::STAGE_NETWORK].add(probe.networkTime);
+    }
+    m_stageLatency[LatencyProbeDefs::STAGE_DECODE].add(probe.decodeTime);
+    m_stageLatency[LatencyProbeDefs::STAGE_PRESENT].add((UINT32)presentTime);
+  }
+
+  if (!wasConnected() ||
+      !m_clientMsgCaps.isEnabled(ClientMsgDefs::LATENCY_REPORT)) {
+    return;
+  }
+  try {
+    RfbLatencyReportClientMessage report(probe.seq, probe.decodeTime,
+                                         (UINT32)presentTime);
+    report.send(m_output);
+  } catch (const Exception &ex) {
+    m_logWriter.debug(_T("Cannot send latency report: %s"), ex.getMessage());
+  }
+}
+
+UINT32 RemoteViewerCore::getLatencyReports() const
+{
+  AutoLock al(&m_latencyLock);
+  return m_stageLatency[LatencyProbeDefs::STAGE_PRESENT].getCount();
+}
+
+UINT32 RemoteViewerCore::getStageLatency(int stage, unsigned int percent) const
+{
+  if (stage < 0 || stage >= LatencyProbeDefs::STAGE_COUNT) {
+    return 0;
+  }
+  AutoLock al(&m_latencyLock);
+  return m_stageLatency[stage].getPercentile(percent);
+}
+
+UINT32 RemoteViewerCore::getFbUpdatesReceived() const
+{
+  return (UINT32)m_fbUpdatesReceived;
+}
+
+void RemoteViewerCore::getDecodeTotals(UINT64 *pixels, UINT64 *decodeTime) const
+{
+  AutoLock al(&m_decodeTotalsLock);
+  *pixels = m_decodedPixels;
+  *decodeTime = m_decodeTime;
+}
+
 void RemoteViewerCore::execute()
 {
   try {
@@ -894,8 +1291,8 @@ void RemoteViewerCore::execute()
     m_logWriter.info(_T("Protocol stage is \"Authentication\"."));
     authenticate();
 
-    // set shared flag, get server dimension, pixel format and hostname
-    // send client pixel format and set him.
+    // get server dimension, pixel format and hostname (the shared flag is
+    // already sent by authenticate())
     m_logWriter.info(_T("Protocol stage is \"Initialization\"."));
     clientAndServerInit();
 
@@ -915,16 +1312,30 @@ void RemoteViewerCore::execute()
       m_wasConnected = true;
     }
 
+    // None of the messages below waits for a reply, so they are flushed
+    // together and reach the server in one packet instead of one per
+    // message.
+    m_output->holdFlushes();
+
     // send supporting encoding
     m_logWriter.info(_T("Protocol stage is \"Encoding select\"."));
     sendEncodings();
 
     // send ENABLE_CUT_TEXT_UTF8 if server has the capability
     allowUtf8Clipboard();
-
-    // send request of frame buffer update
+    // send ENABLE_CUT_TEXT_OFFERS if server has the capability
+    allowLazyClipboard();
+    // send ENABLE_BULK_CHANNEL if server has the capability
+    enableBulkChannel();
+    // send ENABLE_MULTICAST if server has the capability
+    enableMulticast();
+
+    // send request of frame buffer update, only the changes are requested
+    // if the pixels of the previous session are restored
     m_logWriter.info(_T("Protocol stage is \"Working phase\"."));
-    sendFbUpdateRequest(false);
+    sendFbUpdateRequest(resyncFrameBuffer());
+
+    m_output->releaseFlushes();
 
     // received server messages
     while (!isTerminating()) {
@@ -954,6 +1365,37 @@ void RemoteViewerCore::execute()
         m_logWriter.detail(_T("Received message: SERVER_CUT_TEXT_UTF8"));
         receiveServerCutTextUtf8();
         break;
+      case ServerMsgDefs::CUT_TEXT_OFFER:
+        m_logWriter.detail(_T("Received message: CUT_TEXT_OFFER"));
+        receiveCutTextOffer();
+        break;
+      case ServerMsgDefs::CUT_TEXT_CHUNK:
+        m_logWriter.detail(_T("Received message: CUT_TEXT_CHUNK"));
+        receiveCutTextChunk(m_input);
+        break;
+      case ServerMsgDefs::BULK_CHANNEL_TOKEN:
+        m_logWriter.detail(_T("Received message: BULK_CHANNEL_TOKEN"));
+        receiveBulkChannelToken();
+        break;
+      case ServerMsgDefs::MULTICAST_GROUP:
+        m_logWriter.detail(_T("Received message: MULTICAST_GROUP"));
+        receiveMulticastGroup();
+        break;
+
+      case ServerMsgDefs::END_OF_CONTINUOUS_UPDATES:
+        m_logWriter.detail(_T("Received message: END_OF_CONTINUOUS_UPDATES"));
+        receiveEndOfContinuousUpdates();
+        break;
+
+      case ServerMsgDefs::SERVER_FENCE:
+        m_logWriter.detail(_T("Received message: SERVER_FENCE"));
+        receiveFence();
+        break;
+
+      case ServerMsgDefs::TRANSPORT_ZLIB:
+        m_logWriter.detail(_T("Received message: TRANSPORT_ZLIB"));
+        receiveTransportZlib();
+        break;
 
       default:
         if (m_serverMsgHandlers.find(msgType) != m_serverMsgHandlers.end()) {
@@ -1044,27 +1486,42 @@ void RemoteViewerCore::receiveFbUpdate()
 
   UINT16 numberOfRectangles = m_input->readUInt16();
   m_logWriter.debug(_T("number of rectangles: %d"), numberOfRectangles);
-
+  QueryPerformanceCounter(&m_fbUpdateStart);
+  m_isProbeReceived = false;
+
+  // Updates of tiny rectangles come by thousands, the log level is checked
+  // once per update and the adapter is notified of the whole update.
+  bool debugLog = m_logWriter.isDebug();
+  m_fbUpdateNotifier.beginBatch();
+  // The rectangles of a streamed update are counted by nobody, they go on
+  // until the LastRect pseudo-rectangle.
+  bool isStreamed = numberOfRectangles == PseudoEncDefs::LAST_RECT_COUNT;
   bool isLastRect = false;
-  for (int rectangle = 0; rectangle < numberOfRectangles && !isLastRect; rectangle++) {
-    m_logWriter.debug(_T("Receiving rectangle #%d..."), rectangle);
-    isLastRect = receiveFbUpdateRectangle();
+  for (int rectangle = 0;
+       (isStreamed || rectangle < numberOfRectangles) && !isLastRect;
+       rectangle++) {
+    if (debugLog) {
+      m_logWriter.debug(_T("Receiving rectangle #%d..."), rectangle);
+    }
+    isLastRect = receiveFbUpdateRectangle(debugLog);
   }
-
-  {
-    AutoLock al(&m_requestUpdateLock);
-    m_isNeedRequestUpdate = true;
+  m_fbUpdateNotifier.endBatch();
+  InterlockedIncrement(&m_fbUpdatesReceived);
+  // The probe is reported when the batch with the update is presented. A
+  // probe not presented yet is replaced, the server forgets it.
+  if (m_isProbeReceived) {
+    m_receivedProbe.batch = m_fbUpdateNotifier.getBatchesFlushed();
+    AutoLock al(&m_latencyLock);
+    m_pendingProbe = m_receivedProbe;
+    m_isProbePending = true;
   }
-  {
-    AutoLock al(&m_freezeLock);
-    if (m_isFreeze)
-      return;
-  }
-  m_logWriter.detail(_T("Sending of frame buffer update request..."));
-  sendFbUpdateRequest(!m_forceFullUpdate);
+
+  m_updateRequestSender.setWasUpdated();
+  sendFbUpdateRequest();
+  sendDecodeFeedback();
 }
 
-bool RemoteViewerCore::receiveFbUpdateRectangle()
+bool RemoteViewerCore::receiveFbUpdateRectangle(bool debugLog)
 {
   Rect rect;
   rect.left = m_input->readUInt16();
@@ -1074,8 +1531,10 @@ bool RemoteViewerCore::receiveFbUpdateRectangle()
 
   int encodingType = m_input->readInt32();
 
-  m_logWriter.debug(_T("Rectangle: (%d, %d), (%d, %d). Type is %d"), 
-                    rect.left, rect.top, rect.right, rect.bottom, encodingType);
+  if (debugLog) {
+    m_logWriter.debug(_T("Rectangle: (%d, %d), (%d, %d). Type is %d"),
+                      rect.left, rect.top, rect.right, rect.bottom, encodingType);
+  }
 
   if (encodingType == PseudoEncDefs::LAST_RECT)
     return true;
@@ -1084,16 +1543,22 @@ bool RemoteViewerCore::receiveFbUpdateRectangle()
       throw Exception(_T("Error in protocol: incorrect size of rectangle"));
     }
 
-    Decoder *decoder = m_decoderStore.getDecoder(encodingType);
-    if (decoder != 0) {
-      m_logWriter.debug(_T("Decoding..."));
-
-      DecoderOfRectangle *rectangleDecoder = dynamic_cast<DecoderOfRectangle *>(decoder);
+    DecoderOfRectangle *rectangleDecoder =
+      m_decoderStore.getRectangleDecoder(encodingType);
+    if (rectangleDecoder != 0) {
+      StallWatchdog::Activity decodeActivity(StallWatchdog::DECODE);
+      LARGE_INTEGER decodeStart;
+      QueryPerformanceCounter(&decodeStart);
       rectangleDecoder->process(m_input,
                                 &m_frameBuffer, &m_rectangleFb, &rect, &m_fbLock,
                                 &m_fbUpdateNotifier);
-
-      m_logWriter.debug(_T("Decoded"));
+      LARGE_INTEGER decodeEnd;
+      QueryPerformanceCounter(&decodeEnd);
+      ZoneProfiler::getInstance()->record(ZoneProfiler::DECODE,
+                                          decodeEnd.QuadPart - decodeStart.QuadPart);
+      addDecodeCost(encodingType, &rect,
+                    (UINT64)(decodeEnd.QuadPart - decodeStart.QuadPart) *
+                    1000000 / (UINT64)m_perfFrequency.QuadPart);
     } else { // decoder is 0
       StringStorage errorString;
       errorString.format(_T("Decoder \"%d\" isn't exist"), encodingType);
@@ -1101,21 +1566,92 @@ bool RemoteViewerCore::receiveFbUpdateRectangle()
       throw Exception(errorString.getString());
     } 
   } else { // it's pseudo encoding
-    m_logWriter.debug(_T("It's pseudo encoding"));
     processPseudoEncoding(&rect, encodingType);
   }
   return false;
 }
 
+void RemoteViewerCore::addDecodeCost(int encodingType, const Rect *rect,
+                                     UINT64 decodeTime)
+{
+  std::map<int, DecodeCost>::iterator it = m_decodeCosts.find(encodingType);
+  if (it == m_decodeCosts.end()) {
+    DecodeCost cost = { 0, 0, 0 };
+    it = m_decodeCosts.insert(std::make_pair(encodingType, cost)).first;
+  }
+  it->second.rectangles++;
+  it->second.pixels += (UINT64)rect->area();
+  it->second.decodeTime += decodeTime;
+
+  AutoLock al(&m_decodeTotalsLock);
+  m_decodedPixels += (UINT64)rect->area();
+  m_decodeTime += decodeTime;
+}
+
+void RemoteViewerCore::sendDecodeFeedback()
+{
+  if (!m_clientMsgCaps.isEnabled(ClientMsgDefs::DECODE_FEEDBACK)) {
+    return;
+  }
+  // The CPU time of this thread leaves out the waiting for the data, unlike
+  // the time spent in the decoders.
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if (GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime,
+                     &kernelTime, &userTime) == 0) {
+    return;
+  }
+  ULARGE_INTEGER kernel = {{ kernelTime.dwLowDateTime, kernelTime.dwHighDateTime }};
+  ULARGE_INTEGER user = {{ userTime.dwLowDateTime, userTime.dwHighDateTime }};
+  UINT64 threadTime = (kernel.QuadPart + user.QuadPart) / 10;
+
+  DWORD now = GetTickCount();
+  if (m_feedbackStart == 0) {
+    m_feedbackStart = now;
+    m_feedbackThreadTime = threadTime;
+    m_decodeCosts.clear();
+    return;
+  }
+  DWORD period = now - m_feedbackStart;
+  if (period < DecodeFeedbackDefs::REPORT_INTERVAL) {
+    return;
+  }
+
+  UINT32 renderTime, framesShown, framesDropped;
+  m_fbUpdateNotifier.takeRenderStats(&renderTime, &framesShown, &framesDropped);
+  UINT64 decodeTime = threadTime - m_feedbackThreadTime;
+  RfbDecodeFeedbackClientMessage feedback(period,
+    decodeTime > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)decodeTime,
+    renderTime, framesShown, framesDropped);
+  for (std::map<int, DecodeCost>::const_iterator it = m_decodeCosts.begin();
+       it != m_decodeCosts.end(); it++) {
+    const DecodeCost *cost = &it->second;
+    UINT64 kiloPixels = cost->pixels / 1000;
+    feedback.addEncoding(it->first, cost->rectangles,
+      kiloPixels > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)kiloPixels,
+      cost->decodeTime > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)cost->decodeTime);
+  }
+  feedback.send(m_output);
+
+  m_feedbackStart = now;
+  m_feedbackThreadTime = threadTime;
+  m_decodeCosts.clear();
+}
+
 void RemoteViewerCore::processPseudoEncoding(const Rect *rect,
                                              int encodingType)
 {
   switch (encodingType) {
   case PseudoEncDefs::DESKTOP_SIZE:
     m_logWriter.info(_T("Changed size of desktop"));
+    // Report the rectangles received so far before the frame buffer changes.
+    m_fbUpdateNotifier.flushBatch();
     {
       AutoLock al(&m_fbLock);
-      setFbProperties(&Dimension(rect), &m_frameBuffer.getPixelFormat());
+      if (m_decoderStore.getDecoder(PseudoEncDefs::KEEP_FB_ON_RESIZE) != 0) {
+        resizeFrameBuffer(&Dimension(rect));
+      } else {
+        setFbProperties(&Dimension(rect), &m_frameBuffer.getPixelFormat());
+      }
     }
     break;
     
@@ -1129,20 +1665,35 @@ void RemoteViewerCore::processPseudoEncoding(const Rect *rect,
 
       vector<UINT8> cursor;
       vector<UINT8> bitmask;
+      RichCursorDecoder::readShape(m_input, width, height, bytesPerPixel,
+                                   &cursor, &bitmask);
+      Point hotSpot(rect->left, rect->top);
+
+      m_logWriter.debug(_T("Setting new rich cursor..."));
+      m_fbUpdateNotifier.setNewCursor(&hotSpot, width, height,
+                                      &cursor, &bitmask);
+    }
+    break;
 
-      size_t cursorLen = width * height * bytesPerPixel;
-      if (cursorLen != 0) {
-        cursor.resize(cursorLen);
-        m_input->readFully(&cursor.front(), cursorLen);
+  case PseudoEncDefs::CURSOR_CACHE:
+    {
+      m_logWriter.detail(_T("New cached cursor"));
 
-        size_t bitmaskLen = ((width + 7) / 8) * height;
-        bitmask.resize(bitmaskLen);
-        m_input->readFully(&bitmask.front(), bitmaskLen);
+      CursorCacheDecoder *decoder = dynamic_cast<CursorCacheDecoder *>(
+        m_decoderStore.getDecoder(PseudoEncDefs::CURSOR_CACHE));
+      if (decoder == 0) {
+        throw Exception(_T("Error in protocol: cursor cache is not enabled"));
       }
+      vector<UINT8> cursor;
+      vector<UINT8> bitmask;
+      decoder->readShape(m_input, rect, m_frameBuffer.getBytesPerPixel(),
+                         &cursor, &bitmask);
       Point hotSpot(rect->left, rect->top);
 
-      m_logWriter.debug(_T("Setting new rich cursor..."));
-      m_fbUpdateNotifier.setNewCursor(&hotSpot, width, height,
+      m_logWriter.debug(_T("Setting new cached cursor..."));
+      m_fbUpdateNotifier.setNewCursor(&hotSpot,
+                                      (UINT16)rect->getWidth(),
+                                      (UINT16)rect->getHeight(),
                                       &cursor, &bitmask);
     }
     break;
@@ -1155,6 +1706,10 @@ void RemoteViewerCore::processPseudoEncoding(const Rect *rect,
     }
     break;
 
+  case PseudoEncDefs::LATENCY_PROBE:
+    receiveLatencyProbe();
+    break;
+
   default:
     StringStorage errorString;
     errorString.format(_T("Pseudo encoding %d is not supported"), encodingType);
@@ -1163,6 +1718,28 @@ void RemoteViewerCore::processPseudoEncoding(const Rect *rect,
   }
 }
 
+void RemoteViewerCore::receiveLatencyProbe()
+{
+  m_receivedProbe.seq = m_input->readUInt32();
+  m_receivedProbe.captureTime = m_input->readUInt32();
+  m_receivedProbe.encodeTime = m_input->readUInt32();
+  m_receivedProbe.networkTime = m_input->readUInt32();
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  UINT64 decodeTime = (UINT64)(now.QuadPart - m_fbUpdateStart.QuadPart) *
+                      1000000 / (UINT64)m_perfFrequency.QuadPart;
+  m_receivedProbe.decodeTime = decodeTime > 0xFFFFFFFF ?
+                               0xFFFFFFFF : (UINT32)decodeTime;
+  m_receivedProbe.receiveTime = now.QuadPart;
+  m_isProbeReceived = true;
+  m_logWriter.debug(_T("Latency probe #%u: capture %u us, encode %u us,")
+                    _T(" decode %u us"),
+                    (unsigned int)m_receivedProbe.seq,
+                    (unsigned int)m_receivedProbe.captureTime,
+                    (unsigned int)m_receivedProbe.encodeTime,
+                    (unsigned int)m_receivedProbe.decodeTime);
+}
+
 void RemoteViewerCore::receiveSetColorMapEntries()
 {
   // message type is already known: 1
@@ -1179,6 +1756,52 @@ void RemoteViewerCore::receiveSetColorMapEntries()
   }
 }
 
+void RemoteViewerCore::receiveEndOfContinuousUpdates()
+{
+  // message is already readed. Message type: 150
+
+  m_updateRequestSender.onEndOfContinuousUpdates();
+  // Continuous updates may be disabled to change the pixel format.
+  sendFbUpdateRequest();
+}
+
+void RemoteViewerCore::receiveTransportZlib()
+{
+  // message is already readed. Message type: 0xFC000500
+
+  m_input->startDecompression();
+  m_logWriter.info(_T("Transport compression is on"));
+}
+
+void RemoteViewerCore::receiveFence()
+{
+  // message type is already known: 248
+
+  // read padding: three bytes
+  m_input->readUInt16();
+  m_input->readUInt8();
+
+  UINT32 flags = m_input->readUInt32();
+  UINT8 length = m_input->readUInt8();
+  if (length > FenceDefs::MAX_PAYLOAD_LENGTH) {
+    throw Exception(_T("Fence payload is too long"));
+  }
+  std::vector<char> payload(length);
+  if (length != 0) {
+    m_input->readFully(&payload.front(), length);
+  }
+
+  // The viewer never sends fence requests itself.
+  if ((flags & FenceDefs::REQUEST) == 0) {
+    return;
+  }
+  // Messages are decoded in order on this thread, so BlockBefore and
+  // BlockAfter are already satisfied. SyncNext is not supported.
+  RfbFenceClientMessage fence(flags & (FenceDefs::BLOCK_BEFORE | FenceDefs::BLOCK_AFTER),
+                              &payload);
+  fence.send(m_output);
+}
+
 void RemoteViewerCore::receiveBell()
 {
   // message is already readed. Message type: 2
@@ -1241,6 +1864,247 @@ void RemoteViewerCore::receiveServerCutTextUtf8()
   }
 }
 
+void RemoteViewerCore::receiveCutTextOffer()
+{
+  UINT32 serial = m_input->readUInt32();
+  UINT32 length = m_input->readUInt32();
+  {
+    AutoLock al(&m_cutTextLock);
+    m_hasCutTextOffer = true;
+    m_cutTextOfferSerial = serial;
+    m_cutTextOfferLength = length;
+    m_cutTextChunks.clear();
+  }
+
+  m_logWriter.debug(_T("Clipboard %u of %u bytes is offered"),
+                    (unsigned int)serial, (unsigned int)length);
+  bool fetchNow = true;
+  try {
+    fetchNow = m_adapter->onCutTextOffer(length);
+  } catch (const Exception &ex) {
+    m_logWriter.error(_T("Error in CoreEventsAdapter::onCutTextOffer(): %s"), ex.getMessage());
+  } catch (...) {
+    m_logWriter.error(_T("Unknown error in CoreEventsAdapter::onCutTextOffer()"));
+  }
+  if (fetchNow) {
+    requestCutText();
+  }
+}
+
+void RemoteViewerCore::receiveCutTextChunk(RfbInputGate *input)
+{
+  // The server sends a whole clipboard on one connection, so the chunks
+  // come from one thread at a time.
+  UINT32 serial = input->readUInt32();
+  UINT8 flags = input->readUInt8();
+  UINT32 length = input->readUInt32();
+  UINT32 dataLength = input->readUInt32();
+
+  // Incompressible data are sent as they are, so compressed data are never
+  // longer than the chunk.
+  if (length > LazyCutTextDefs::MAX_CHUNK_LENGTH || dataLength > length ||
+      ((flags & LazyCutTextDefs::CHUNK_ZLIB) == 0 && dataLength != length)) {
+    throw Exception(_T("Error in protocol: wrong length of a clipboard chunk"));
+  }
+  m_cutTextChunkData.resize(dataLength + 1);
+  input->readFully(&m_cutTextChunkData.front(), dataLength);
+
+  StringStorage cutText;
+  {
+    AutoLock al(&m_cutTextLock);
+    if (!m_hasCutTextOffer || serial != m_cutTextOfferSerial) {
+      // The chunks of a replaced clipboard.
+      return;
+    }
+    if ((flags & LazyCutTextDefs::CHUNK_CANCELLED) != 0) {
+      m_logWriter.debug(_T("Transfer of the clipboard %u is cancelled"),
+                        (unsigned int)serial);
+      m_cutTextChunks.clear();
+      return;
+    }
+    size_t offset = m_cutTextChunks.size();
+    if (offset + length > m_cutTextOfferLength) {
+      throw Exception(_T("Error in protocol: the clipboard is longer than offered"));
+    }
+    m_cutTextChunks.resize(offset + length);
+    if (length != 0) {
+      if ((flags & LazyCutTextDefs::CHUNK_ZLIB) != 0) {
+        uLongf unpackedLength = length;
+        int result = uncompress((Bytef *)&m_cutTextChunks[offset], &unpackedLength,
+                                (const Bytef *)&m_cutTextChunkData.front(),
+                                dataLength);
+        if (result != Z_OK || unpackedLength != length) {
+          throw Exception(_T("Error in protocol: wrong compressed clipboard chunk"));
+        }
+      } else {
+        memcpy(&m_cutTextChunks[offset], &m_cutTextChunkData.front(), length);
+      }
+    }
+    if ((flags & LazyCutTextDefs::CHUNK_LAST) == 0) {
+      return;
+    }
+    m_cutTextChunks.push_back('\0');
+    Utf8StringStorage cutTextUtf8(&m_cutTextChunks);
+    cutTextUtf8.toStringStorage(&cutText);
+    m_cutTextChunks.clear();
+  }
+
+  m_logWriter.debug(_T("Cut text: %s"), cutText.getString());
+  try {
+    m_adapter->onCutText(&cutText);
+  } catch (const Exception &ex) {
+    m_logWriter.error(_T("Error in CoreEventsAdapter::onCutText(): %s"), ex.getMessage());
+  } catch (...) {
+    m_logWriter.error(_T("Unknown error in CoreEventsAdapter::onCutText()"));
+  }
+}
+
+void RemoteViewerCore::enableBulkChannel()
+{
+  StringStorage host;
+  UINT16 port;
+  if (m_clientMsgCaps.isEnabled(ClientMsgDefs::ENABLE_BULK_CHANNEL) &&
+      m_tcpConnection.getHostAddress(&host, &port)) {
+    m_logWriter.debug(_T("Sending EnableBulkChannel message."));
+    AutoLock al(m_output);
+    m_output->writeUInt32(ClientMsgDefs::ENABLE_BULK_CHANNEL);
+    m_output->flush();
+  }
+}
+
+void RemoteViewerCore::receiveBulkChannelToken()
+{
+  UINT8 token[BulkChannelDefs::TOKEN_LENGTH];
+  m_input->readFully(token, sizeof(token));
+
+  StringStorage host;
+  UINT16 port;
+  if (!m_tcpConnection.getHostAddress(&host, &port)) {
+    return;
+  }
+  SocketProfile socketProfile;
+  m_tcpConnection.getSocketProfile(&socketProfile);
+
+  AutoLock al(&m_bulkChannelLock);
+  // One channel is opened per connection, stop() may be closing it.
+  if (m_bulkChannel.get() != 0 || isTerminating()) {
+    return;
+  }
+  m_bulkChannel.reset(new BulkChannel(host.getString(), port, &socketProfile,
+                                      token, this, &m_logWriter));
+  m_bulkChannel->resume();
+}
+
+void RemoteViewerCore::onBulkChannelConnected(RfbOutputGate *output)
+{
+  try {
+    m_adapter->onBulkChannel(output);
+  } catch (const Exception &ex) {
+    m_logWriter.error(_T("Error in CoreEventsAdapter::onBulkChannel(): %s"), ex.getMessage());
+  } catch (...) {
+    m_logWriter.error(_T("Unknown error in CoreEventsAdapter::onBulkChannel()"));
+  }
+}
+
+void RemoteViewerCore::onBulkChannelMessage(UINT32 msgType, RfbInputGate *input)
+{
+  if (msgType == ServerMsgDefs::CUT_TEXT_CHUNK) {
+    m_logWriter.detail(_T("Received message on the bulk channel: CUT_TEXT_CHUNK"));
+    receiveCutTextChunk(input);
+    return;
+  }
+  if (m_serverMsgHandlers.find(msgType) == m_serverMsgHandlers.end()) {
+    // The rest of the message cannot be skipped.
+    StringStorage error;
+    error.format(_T("Server to client message: %d is not supported on the bulk channel"),
+                 msgType);
+    throw Exception(error.getString());
+  }
+  m_logWriter.detail(_T("Received message (%d) on the bulk channel transmit to capability handler"),
+                     msgType);
+  try {
+    m_serverMsgHandlers[msgType]->onServerMessage(msgType, input);
+  } catch (const Exception &ex) {
+    m_logWriter.error(_T("Error in onServerMessage(): %s"), ex.getMessage());
+  } catch (...) {
+    m_logWriter.error(_T("Unknown error in onServerMessage()"));
+  }
+}
+
+void RemoteViewerCore::onBulkChannelClosed(const TCHAR *reason)
+{
+  if (isTerminating()) {
+    return;
+  }
+  m_logWriter.info(_T("File transfer goes on the main connection: %s"), reason);
+  try {
+    m_adapter->onBulkChannel(m_output);
+  } catch (const Exception &ex) {
+    m_logWriter.error(_T("Error in CoreEventsAdapter::onBulkChannel(): %s"), ex.getMessage());
+  } catch (...) {
+    m_logWriter.error(_T("Unknown error in CoreEventsAdapter::onBulkChannel()"));
+  }
+}
+
+void RemoteViewerCore::enableMulticast()
+{
+  if (m_clientMsgCaps.isEnabled(ClientMsgDefs::ENABLE_MULTICAST) &&
+      m_clientMsgCaps.isEnabled(ClientMsgDefs::MULTICAST_RECEPTION) &&
+      m_clientMsgCaps.isEnabled(ClientMsgDefs::MULTICAST_REPAIR)) {
+    m_logWriter.debug(_T("Sending EnableMulticast message."));
+    AutoLock al(m_output);
+    m_output->writeUInt32(ClientMsgDefs::ENABLE_MULTICAST);
+    m_output->flush();
+  }
+}
+
+void RemoteViewerCore::receiveMulticastGroup()
+{
+  UINT32 address = m_input->readUInt32();
+  UINT16 port = m_input->readUInt16();
+
+  AutoLock al(&m_multicastLock);
+  // One group is joined per connection, stop() may be ending it.
+  if (m_multicastReceiver.get() != 0 || isTerminating()) {
+    return;
+  }
+  m_multicastReceiver.reset(new MulticastReceiver(address, port,
+                                                  &m_frameBuffer, &m_fbLock,
+                                                  &m_fbUpdateNotifier,
+                                                  this, &m_logWriter));
+  m_multicastReceiver->resume();
+}
+
+void RemoteViewerCore::onMulticastReception(bool receiving)
+{
+  m_logWriter.debug(_T("Sending MulticastReception message."));
+  try {
+    AutoLock al(m_output);
+    m_output->writeUInt32(ClientMsgDefs::MULTICAST_RECEPTION);
+    m_output->writeUInt8(receiving ? 1 : 0);
+    m_output->flush();
+  } catch (const Exception &ex) {
+    // The connection is closing, its input thread tells about it.
+    m_logWriter.debug(_T("Cannot send MulticastReception: %s"), ex.getMessage());
+  }
+}
+
+void RemoteViewerCore::onMulticastLoss(UINT32 streamId, UINT32 firstSeq,
+                                       UINT16 count)
+{
+  m_logWriter.debug(_T("Sending MulticastRepair message."));
+  try {
+    AutoLock al(m_output);
+    m_output->writeUInt32(ClientMsgDefs::MULTICAST_REPAIR);
+    m_output->writeUInt32(streamId);
+    m_output->writeUInt32(firstSeq);
+    m_output->writeUInt16(count);
+    m_output->flush();
+  } catch (const Exception &ex) {
+    m_logWriter.debug(_T("Cannot send MulticastRepair: %s"), ex.getMessage());
+  }
+}
+
 bool RemoteViewerCore::isRfbProtocolString(const char protocol[12]) const
 {
   // Format protocol version "RFB XXX.YYY\n"
@@ -1312,26 +2176,31 @@ void RemoteViewerCore::handshake()
 
 /**
  * Client send:
- * 2           - U8          - shared flag
- *
- * Server send:
- * 2           - U16         - framebuffer-width
- * 2           - U16         - framebuffer-height
- * 16          - PixelFormat - server-pixel-format
- * 4           - U32         - name-length
- * name-length - U8 array    - name-string
+ * 1           - U8          - shared flag
  */
-void RemoteViewerCore::clientAndServerInit()
+void RemoteViewerCore::sendClientInit()
 {
   if (m_sharedFlag) {
     m_logWriter.info(_T("Setting share flag in on..."));
   } else {
     m_logWriter.info(_T("Setting share flag is off..."));
   }
+  AutoLock al(m_output);
   m_output->writeUInt8(m_sharedFlag);
   m_output->flush();
   m_logWriter.debug(_T("Shared flag is set"));
+}
 
+/**
+ * Server send, after the ClientInit message sent by authenticate():
+ * 2           - U16         - framebuffer-width
+ * 2           - U16         - framebuffer-height
+ * 16          - PixelFormat - server-pixel-format
+ * 4           - U32         - name-length
+ * name-length - U8 array    - name-string
+ */
+void RemoteViewerCore::clientAndServerInit()
+{
   UINT16 width = m_input->readUInt16();
   UINT16 height = m_input->readUInt16();
   Dimension screenDimension(width, height);
@@ -31,12 +31,16 @@
 #include "network/socket/SocketStream.h"
 #include "network/socket/SocketIPv4.h"
 #include "rfb/FrameBuffer.h"
+#include "rfb/MsgDefs.h"
 #include "region/Dimension.h"
 #include "region/Point.h"
 #include "thread/Thread.h"
+#include "util/LatencyHistogram.h"
 
+#include "BulkChannel.h"
 #include "CapsContainer.h"
 #include "CoreEventsAdapter.h"
+#include "MulticastReceiver.h"
 #include "DispatchDataProvider.h"
 #include "DecoderStore.h"
 #include "FbUpdateNotifier.h"
@@ -45,7 +49,9 @@
 #include "WatermarksController.h"
 
 #include <map>
+#include <memory>
 #include "UpdateRequestSender.h"
+#include "PointerEventSender.h"
 
 //
 // RemoteViewerCore implements a local representation of a live remote screen
@@ -71,7 +77,9 @@
 // explicitly stated that it will never do so.
 //
 class RemoteViewerCore : public CapabilitiesManager,
-                         protected Thread
+                         protected Thread,
+                         private BulkChannelListener,
+                         private MulticastReceiverListener
 {
 public:
   //
@@ -283,6 +291,35 @@ public:
   //
   StringStorage getRemoteDesktopName() const;
 
+  //
+  // Tells that the application has drawn the frame buffer on the screen.
+  // If the last update passed to the adapter had a LatencyProbe, it is
+  // reported to the server. Should be called right after drawing, from the
+  // thread which draws.
+  //
+  void onFramePresented();
+
+  //
+  // Informational functions which return the number of presented updates
+  // with LatencyProbe and the given percentile of a latency stage (one of
+  // LatencyProbeDefs::STAGE_*) of them, in microseconds, 0 if unknown.
+  //
+  UINT32 getLatencyReports() const;
+  UINT32 getStageLatency(int stage, unsigned int percent) const;
+
+  //
+  // Informational function which returns the number of frame buffer updates
+  // received from the server so far. Can be called from any thread.
+  //
+  UINT32 getFbUpdatesReceived() const;
+
+  //
+  // Informational function which returns the number of pixels of the
+  // rectangles decoded so far and the time spent in the rectangle decoders,
+  // in microseconds. Can be called from any thread.
+  //
+  void getDecodeTotals(UINT64 *pixels, UINT64 *decodeTime) const;
+
   //
   // Set the specified pixel format. The viewer will request that pixel format
   // from the server, as well as a full screen update. The pixel format is not
@@ -314,11 +351,30 @@ public:
   //
   void enableDispatching(DispatchDataProvider *src = 0);
 
+  //
+  // Gives the pixels kept from a previous session with the same server,
+  // e.g. when reconnecting after the connection has been lost. If the
+  // server supports tile hashes and the frame buffer keeps its size and
+  // pixel format, the session starts from these pixels and the server sends
+  // only the tiles which differ instead of the whole screen. Must be called
+  // prior to start().
+  //
+  void setResyncFrameBuffer(const FrameBuffer *frameBuffer);
+
   //
   // Pause/resume updating the frame buffer.
   //
   void stopUpdating(bool isStopped);
 
+  //
+  // Tells whether the frame buffer is out of the user's sight at all, e.g.
+  // the window is minimized. No update requests are sent meanwhile, so the
+  // server sends nothing to decode. The changes made in the meantime are
+  // requested at once when the frame buffer becomes visible again.
+  // Independent of stopUpdating().
+  //
+  void setHidden(bool isHidden);
+
   //
   // Request full refresh of the framebuffer, so that the whole screen will be
   // re-sent from the server. The refresh is not guaranteed to happen
@@ -342,6 +398,21 @@ public:
   //
   void deferUpdateRequests(const int& milliseconds);
 
+  //
+  // Sets the number of incremental update requests kept in flight. The next
+  // request is sent as soon as an update is decoded, so with more than one
+  // request the server does not wait for the round trip between updates.
+  // Does not matter if the server supports continuous updates.
+  //
+  void setUpdateRequestPipeline(const int& depth);
+
+  //
+  // Sets the minimal interval between pointer motion events, in
+  // milliseconds. The moves within the interval are merged into one, the
+  // changes of the buttons are sent at once. Zero sends every move.
+  //
+  void setPointerEventInterval(int milliseconds);
+
   //
   // Send a keyboard event. Arguments specify the event as defined in the
   // RFB v.3 protocol specification.
@@ -359,10 +430,20 @@ public:
   //
   void sendCutTextEvent(const StringStorage *cutText);
 
+  //
+  // Fetch the clipboard last offered by the server (see
+  // CoreEventsAdapter::onCutTextOffer()). The text is passed to
+  // CoreEventsAdapter::onCutText() when it is received. Returns false if
+  // there is no offered clipboard.
+  //
+  bool requestCutText();
+
   //
   // Set the preferred encoding type. Note that the server is not guaranteed
   // to use this encoding, this is only a recommendation for the server.
   // By default, Tight encoding (EncodingDefs::TIGHT) is the preferred one.
+  // With Raw, RRE or Hextile, the transport compression is asked for as
+  // well: the server compresses all its data as one zlib stream then.
   //
   void setPreferredEncoding(INT32 encodingType);
 
@@ -374,12 +455,34 @@ public:
   //
   void allowCopyRect(bool allow);
 
+  //
+  // Read the updates without drawing them: the rectangles are consumed and
+  // the compression streams are kept in sync, but JPEG and H.264 pictures
+  // are not decompressed and the frame buffer is not updated. It's meant
+  // for headless clients like the load generator and should be called
+  // before start().
+  //
+  void skipDrawing(bool skip);
+
+  //
+  // Set tuning of the TCP socket: buffer sizes, Nagle algorithm and
+  // keep-alive. It's applied when the connection is established, so it
+  // should be called before start().
+  //
+  void setSocketProfile(const SocketProfile *profile);
+
   //
   // If the server anounced UTF8CUTT capability allow sending ClientCutTextUtf8 messages.
   // If the server anounced UTF8CUTT and UTF8CUTE capabilities sends EnableCutTextUtf8 message.
   //
   void allowUtf8Clipboard();
 
+  //
+  // If the server anounced LAZYCUTE and LAZYCUTR capabilities sends
+  // EnableCutTextOffers message, so that the clipboard is fetched on demand.
+  //
+  void allowLazyClipboard();
+
   //
   // Set JPEG image quality level for Tight encoding (in theory, it can apply
   // to other encodings if they use JPEG, but currently, only Tight encoding
@@ -389,6 +492,15 @@ public:
   //
   void setJpegQualityLevel(int newJpegQualityLevel);
 
+  //
+  // Asks the server to scale its screen down by the factor (2, 4 or 8)
+  // before encoding it, e.g. for thumbnails. Any other value, 1 for one,
+  // turns server-side scaling off. The server changes the size of the frame
+  // buffer (it must support desktop size updates) and keeps the pointer out
+  // of the scaled screen, the pointer events are in its scaled coordinates.
+  //
+  void setServerScale(int factor);
+
   //
   // Set the compression level for Tight encoging (in theory, it can apply to
   // other encodings as well, and in fact old experimental encoders such as
@@ -502,9 +614,23 @@ private:
   //
   // Returns true if this rectangle should be the last one in this update,
   // false otherwise. This is needed to support LastRect pseudo-encoding
-  // (code -224).
+  // (code -224). The debugLog flag tells if the rectangle should be logged
+  // at the debug level.
+  //
+  bool receiveFbUpdateRectangle(bool debugLog);
+
+  //
+  // Adds the time spent decoding a rectangle to the costs reported to the
+  // server.
+  //
+  void addDecodeCost(int encodingType, const Rect *rect, UINT64 decodeTime);
+
+  //
+  // Send DecodeFeedback client message if the server supports it and the
+  // reporting period is over. Called by the decoding thread after each
+  // update.
   //
-  bool receiveFbUpdateRectangle();
+  void sendDecodeFeedback();
 
   //
   // Process a fake rectangle which represents a pseudo-encoding.
@@ -512,11 +638,36 @@ private:
   void processPseudoEncoding(const Rect *rect, int encType);
 
   //
-  // Send FramebufferUpdateRequest client message (code 3).
-  // This method updates pixel format if needed.
+  // Reads the LatencyProbe pseudo-rectangle of the current update.
+  //
+  void receiveLatencyProbe();
+
+  //
+  // Send FramebufferUpdateRequest client message (code 3) if a full update
+  // is needed and let m_updateRequestSender keep the pipeline of incremental
+  // requests. This method updates pixel format if needed, after all the
+  // updates in the old pixel format are received.
   //
   void sendFbUpdateRequest(bool incremental = true);
 
+  //
+  // Receive EndOfContinuousUpdates server message (code 150).
+  //
+  void receiveEndOfContinuousUpdates();
+
+  //
+  // Receive Fence server message (code 248) and answer it. The answer is
+  // sent after all the previous updates have been decoded, which lets the
+  // server measure the round trip of its updates.
+  //
+  void receiveFence();
+
+  //
+  // Receive TransportZlib server message (code 0xFC000500): all the data
+  // after it are decompressed.
+  //
+  void receiveTransportZlib();
+
   //
   // Receive Bell server message (code 2) and send event to the adapter.
   //
@@ -529,6 +680,40 @@ private:
   void receiveServerCutText();
   // code 0xfc000200
   void receiveServerCutTextUtf8();
+  // code 0xfc000201
+  void receiveCutTextOffer();
+  // code 0xfc000202, received on the main connection or the bulk channel
+  void receiveCutTextChunk(RfbInputGate *input);
+
+  //
+  // Asks for the bulk channel if the server has it and the connection is
+  // made to a host, so that a second one can be made.
+  //
+  void enableBulkChannel();
+  //
+  // Receive BulkChannelToken server message (code 0xFC000700) and open the
+  // bulk channel with the token.
+  //
+  void receiveBulkChannelToken();
+
+  // Inherited from BulkChannelListener.
+  virtual void onBulkChannelConnected(RfbOutputGate *output);
+  virtual void onBulkChannelMessage(UINT32 msgType, RfbInputGate *input);
+  virtual void onBulkChannelClosed(const TCHAR *reason);
+
+  //
+  // Asks for the multicast stream of the screen if the server has it.
+  //
+  void enableMulticast();
+  //
+  // Receive MulticastGroup server message (code 0xFC000800) and join the
+  // group.
+  //
+  void receiveMulticastGroup();
+
+  // Inherited from MulticastReceiverListener.
+  virtual void onMulticastReception(bool receiving);
+  virtual void onMulticastLoss(UINT32 streamId, UINT32 firstSeq, UINT16 count);
 
   //
   // Receive SetColourMapEntries server message (code 1) and forget it:
@@ -541,7 +726,12 @@ private:
   void handshake();
   int negotiateSecurityType();
   void authenticate();
+  void sendClientInit();
   void clientAndServerInit();
+  // Puts the pixels given to setResyncFrameBuffer() to the frame buffer
+  // and sends their tile hashes. Returns false if the pixels cannot be
+  // used, then the whole screen has to be requested.
+  bool resyncFrameBuffer();
   void readSecurityTypeList(vector<UINT32> *secTypes);
   StringStorage getSecurityTypeName(UINT32 securityType) const;
   StringStorage getAuthenticationTypeName(UINT32 authenticationType) const;
@@ -566,6 +756,12 @@ private:
   void setFbProperties(const Dimension *fbDimension,
                        const PixelFormat *fbPixelFormat);
 
+  //
+  // Change the dimension of m_frameBuffer keeping the pixels which are still
+  // within it, for the servers supporting KeepFbOnResize.
+  //
+  void resizeFrameBuffer(const Dimension *fbDimension);
+
   //
   // If m_isNewPixelFormat flag is set to true, then pixel format of the frame buffer
   // will be updated to m_viewerPixelFormat.
@@ -656,6 +852,55 @@ private:
   // This buffer is not need to blocking: read information is one-thread.
   FrameBuffer m_rectangleFb;
 
+  // Pixels of the previous session, or 0. Used once at the session start.
+  FrameBuffer *m_resyncFrameBuffer;
+  // Side of the tiles hashed for resynchronization, in pixels.
+  static const UINT16 RESYNC_TILE_SIZE = 64;
+
+  // Costs of the rectangles decoded since the last DecodeFeedback message
+  // by encoding, used by the decoding thread only.
+  struct DecodeCost
+  {
+    UINT32 rectangles;
+    UINT64 pixels;
+    UINT64 decodeTime;
+  };
+  std::map<int, DecodeCost> m_decodeCosts;
+  LARGE_INTEGER m_perfFrequency;
+  DWORD m_feedbackStart;
+  UINT64 m_feedbackThreadTime;
+
+  // LatencyProbe of an update. The times are in microseconds, except the
+  // receive time, which is a performance counter value.
+  struct LatencyProbeInfo
+  {
+    UINT32 seq;
+    UINT32 captureTime;
+    UINT32 encodeTime;
+    UINT32 networkTime;
+    UINT32 decodeTime;
+    INT64 receiveTime;
+    // Number of the notifier batch the update has ended with.
+    UINT32 batch;
+  };
+  // Start of the update being received and its probe, if any, used by the
+  // decoding thread only.
+  LARGE_INTEGER m_fbUpdateStart;
+  bool m_isProbeReceived;
+  LatencyProbeInfo m_receivedProbe;
+  // Probe of the latest update waiting to be presented and the latencies
+  // of the presented ones, protected by m_latencyLock.
+  mutable LocalMutex m_latencyLock;
+  bool m_isProbePending;
+  LatencyProbeInfo m_pendingProbe;
+  LatencyHistogram m_stageLatency[LatencyProbeDefs::STAGE_COUNT];
+  // Incremented by the decoding thread, read by anyone.
+  volatile LONG m_fbUpdatesReceived;
+  // Unlike m_decodeCosts, never reset; updated by the decoding thread.
+  mutable LocalMutex m_decodeTotalsLock;
+  UINT64 m_decodedPixels;
+  UINT64 m_decodeTime;
+
   LocalMutex m_pixelFormatLock;
   bool m_isNewPixelFormat;
   PixelFormat m_viewerPixelFormat;
@@ -665,9 +910,9 @@ private:
 
   LocalMutex m_freezeLock;
   bool m_isFreeze;
+  bool m_isHidden;
 
   LocalMutex m_requestUpdateLock;
-  bool m_isNeedRequestUpdate;
 
   bool m_sharedFlag;
   int m_major;
@@ -677,12 +922,34 @@ private:
   StringStorage m_remoteDesktopName;
   bool m_isUtf8ClipboardEnabled;
 
+  // The clipboard offered by the server and the chunks of it received so
+  // far, in UTF-8.
+  LocalMutex m_cutTextLock;
+  bool m_isLazyClipboardEnabled;
+  bool m_hasCutTextOffer;
+  UINT32 m_cutTextOfferSerial;
+  UINT32 m_cutTextOfferLength;
+  std::vector<char> m_cutTextChunks;
+  std::vector<char> m_cutTextChunkData;
+
+  // Second connection for the file transfer and the clipboard chunks, made
+  // by the input thread.
+  LocalMutex m_bulkChannelLock;
+  std::auto_ptr<BulkChannel> m_bulkChannel;
+
+  // Receiver of the multicast stream of the screen, made by the input
+  // thread.
+  LocalMutex m_multicastLock;
+  std::auto_ptr<MulticastReceiver> m_multicastReceiver;
+
   bool m_forceFullUpdate;
   
   int m_updateTimeout;
 
   UpdateRequestSender m_updateRequestSender;
 
+  PointerEventSender m_pointerEventSender;
+
 private:
   // Do not allow copying objects.
   RemoteViewerCore(const RemoteViewerCore &);
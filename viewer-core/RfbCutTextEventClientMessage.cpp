@@ -43,6 +43,7 @@ void RfbCutTextEventClientMessage::send(RfbOutputGate *output)
   cutTextAnsi.fromStringStorage(&m_cutText);
   UINT32 length = static_cast<UINT32>(cutTextAnsi.getLength());
 
+  output->yieldToInput();
   AutoLock al(output);
   output->writeUInt8(ClientMsgDefs::CLIENT_CUT_TEXT);
   output->writeUInt8(0); // padding 3 bytes
@@ -59,6 +60,7 @@ void RfbCutTextEventClientMessage::sendUtf8(RfbOutputGate *output)
   cutTextUtf.fromStringStorage(&m_cutText);
   UINT32 length = static_cast<UINT32>(cutTextUtf.getLength());
 
+  output->yieldToInput();
   AutoLock al(output);
   output->writeUInt32(ClientMsgDefs::CLIENT_CUT_TEXT_UTF8);
   output->writeUInt32(length);
@@ -0,0 +1,77 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RfbDecodeFeedbackClientMessage.h"
+
+RfbDecodeFeedbackClientMessage::RfbDecodeFeedbackClientMessage(UINT32 period,
+                                                               UINT32 decodeTime,
+                                                               UINT32 renderTime,
+                                                               UINT32 framesShown,
+                                                               UINT32 framesDropped)
+: m_period(period),
+  m_decodeTime(decodeTime),
+  m_renderTime(renderTime),
+  m_framesShown(framesShown),
+  m_framesDropped(framesDropped)
+{
+}
+
+RfbDecodeFeedbackClientMessage::~RfbDecodeFeedbackClientMessage()
+{
+}
+
+void RfbDecodeFeedbackClientMessage::addEncoding(INT32 encodingType,
+                                                 UINT32 rectangles,
+                                                 UINT32 kiloPixels,
+                                                 UINT32 decodeTime)
+{
+  if (m_encodings.size() >= DecodeFeedbackDefs::MAX_ENCODINGS) {
+    return;
+  }
+  EncodingCost cost;
+  cost.encodingType = encodingType;
+  cost.rectangles = rectangles;
+  cost.kiloPixels = kiloPixels;
+  cost.decodeTime = decodeTime;
+  m_encodings.push_back(cost);
+}
+
+void RfbDecodeFeedbackClientMessage::send(RfbOutputGate *output)
+{
+  AutoLock al(output);
+  output->writeUInt32(ClientMsgDefs::DECODE_FEEDBACK);
+  output->writeUInt32(m_period);
+  output->writeUInt32(m_decodeTime);
+  output->writeUInt32(m_renderTime);
+  output->writeUInt32(m_framesShown);
+  output->writeUInt32(m_framesDropped);
+  output->writeUInt8(static_cast<UINT8>(m_encodings.size()));
+  for (size_t i = 0; i < m_encodings.size(); i++) {
+    output->writeInt32(m_encodings[i].encodingType);
+    output->writeUInt32(m_encodings[i].rectangles);
+    output->writeUInt32(m_encodings[i].kiloPixels);
+    output->writeUInt32(m_encodings[i].decodeTime);
+  }
+  output->flush();
+}
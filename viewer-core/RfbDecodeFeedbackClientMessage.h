@@ -0,0 +1,66 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _RFB_DECODE_FEEDBACK_CLIENT_MESSAGE_H_
+#define _RFB_DECODE_FEEDBACK_CLIENT_MESSAGE_H_
+
+#include "RfbClientToServerMessage.h"
+
+#include <vector>
+
+class RfbDecodeFeedbackClientMessage :
+  public RfbClientToServerMessage
+{
+public:
+  // All times are in microseconds, except the period (in milliseconds).
+  RfbDecodeFeedbackClientMessage(UINT32 period, UINT32 decodeTime,
+                                 UINT32 renderTime, UINT32 framesShown,
+                                 UINT32 framesDropped);
+  ~RfbDecodeFeedbackClientMessage();
+
+  // Adds the cost of the rectangles of one encoding. The encodings over
+  // DecodeFeedbackDefs::MAX_ENCODINGS are not sent.
+  void addEncoding(INT32 encodingType, UINT32 rectangles, UINT32 kiloPixels,
+                   UINT32 decodeTime);
+
+  void send(RfbOutputGate *output);
+
+private:
+  struct EncodingCost
+  {
+    INT32 encodingType;
+    UINT32 rectangles;
+    UINT32 kiloPixels;
+    UINT32 decodeTime;
+  };
+
+  UINT32 m_period;
+  UINT32 m_decodeTime;
+  UINT32 m_renderTime;
+  UINT32 m_framesShown;
+  UINT32 m_framesDropped;
+  std::vector<EncodingCost> m_encodings;
+};
+
+#endif
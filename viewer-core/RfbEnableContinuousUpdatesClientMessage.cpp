@@ -0,0 +1,49 @@
+// Copyright (C) 2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RfbEnableContinuousUpdatesClientMessage.h"
+
+RfbEnableContinuousUpdatesClientMessage::RfbEnableContinuousUpdatesClientMessage
+  (bool enable, Rect updateRect)
+: m_enable(enable),
+  m_rect(updateRect)
+{
+}
+
+RfbEnableContinuousUpdatesClientMessage::~RfbEnableContinuousUpdatesClientMessage()
+{
+}
+
+void RfbEnableContinuousUpdatesClientMessage::send(RfbOutputGate * output)
+{
+  AutoLock al(output);
+  output->writeUInt8(ClientMsgDefs::ENABLE_CONTINUOUS_UPDATES);
+  output->writeUInt8(m_enable);
+  output->writeUInt16(static_cast<UINT16>(m_rect.left));
+  output->writeUInt16(static_cast<UINT16>(m_rect.top));
+  output->writeUInt16(static_cast<UINT16>(m_rect.getWidth()));
+  output->writeUInt16(static_cast<UINT16>(m_rect.getHeight()));
+  output->flush();
+}
@@ -0,0 +1,51 @@
+// Copyright (C) 2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RfbFenceClientMessage.h"
+
+RfbFenceClientMessage::RfbFenceClientMessage(UINT32 flags,
+                                             const std::vector<char> *payload)
+: m_flags(flags),
+  m_payload(*payload)
+{
+}
+
+RfbFenceClientMessage::~RfbFenceClientMessage()
+{
+}
+
+void RfbFenceClientMessage::send(RfbOutputGate *output)
+{
+  AutoLock al(output);
+  output->writeUInt8(ClientMsgDefs::CLIENT_FENCE);
+  output->writeUInt16(0); // padding
+  output->writeUInt8(0);
+  output->writeUInt32(m_flags);
+  output->writeUInt8(static_cast<UINT8>(m_payload.size()));
+  if (!m_payload.empty()) {
+    output->writeFully(&m_payload.front(), m_payload.size());
+  }
+  output->flush();
+}
@@ -37,6 +37,7 @@ RfbFramebufferUpdateRequestClientMessage::~RfbFramebufferUpdateRequestClientMess
 
 void RfbFramebufferUpdateRequestClientMessage::send(RfbOutputGate * output)
 {
+  output->yieldToInput();
   AutoLock al(output);
   output->writeUInt8(ClientMsgDefs::FB_UPDATE_REQUEST);
   output->writeUInt8(m_incremental);
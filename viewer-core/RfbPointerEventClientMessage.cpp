@@ -38,7 +38,7 @@ RfbPointerEventClientMessage::~RfbPointerEventClientMessage()
 
 void RfbPointerEventClientMessage::send(RfbOutputGate *output)
 {
-  AutoLock al(output);
+  InputAutoLock al(output);
   output->writeUInt8(ClientMsgDefs::POINTER_EVENT);
   output->writeUInt8(m_buttonMask);
   output->writeUInt16(m_xPos);
@@ -0,0 +1,52 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RfbTileHashesClientMessage.h"
+#include "rfb/TileHasher.h"
+
+RfbTileHashesClientMessage::RfbTileHashesClientMessage(const FrameBuffer *frameBuffer,
+                                                       UINT16 tileSize)
+: m_tileSize(tileSize),
+  m_dimension(frameBuffer->getDimension())
+{
+  TileHasher::hashTiles(frameBuffer, tileSize, &m_hashes);
+}
+
+RfbTileHashesClientMessage::~RfbTileHashesClientMessage()
+{
+}
+
+void RfbTileHashesClientMessage::send(RfbOutputGate *output)
+{
+  AutoLock al(output);
+  output->writeUInt32(ClientMsgDefs::TILE_HASHES);
+  output->writeUInt16(m_tileSize);
+  output->writeUInt16(static_cast<UINT16>(m_dimension.width));
+  output->writeUInt16(static_cast<UINT16>(m_dimension.height));
+  output->writeUInt32(static_cast<UINT32>(m_hashes.size()));
+  for (size_t i = 0; i < m_hashes.size(); i++) {
+    output->writeUInt64(m_hashes[i]);
+  }
+  output->flush();
+}
@@ -33,3 +33,21 @@ RichCursorDecoder::RichCursorDecoder(LogWriter *logWriter)
 RichCursorDecoder::~RichCursorDecoder()
 {
 }
+
+void RichCursorDecoder::readShape(RfbInputGate *input,
+                                  UINT16 width, UINT16 height, UINT8 bytesPerPixel,
+                                  std::vector<UINT8> *cursor,
+                                  std::vector<UINT8> *bitmask)
+{
+  cursor->clear();
+  bitmask->clear();
+  size_t cursorLen = width * height * bytesPerPixel;
+  if (cursorLen != 0) {
+    cursor->resize(cursorLen);
+    input->readFully(&cursor->front(), cursorLen);
+
+    size_t bitmaskLen = ((width + 7) / 8) * height;
+    bitmask->resize(bitmaskLen);
+    input->readFully(&bitmask->front(), bitmaskLen);
+  }
+}
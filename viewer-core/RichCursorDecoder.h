@@ -27,11 +27,22 @@
 
 #include "PseudoDecoder.h"
 
+#include <vector>
+
 class RichCursorDecoder : public PseudoDecoder
 {
 public:
   RichCursorDecoder(LogWriter *logWriter);
   virtual ~RichCursorDecoder();
+
+  //
+  // Reads the pixels and the bitmask of the rich cursor shape of the
+  // dimension. Both are left empty for an empty shape.
+  //
+  static void readShape(RfbInputGate *input,
+                        UINT16 width, UINT16 height, UINT8 bytesPerPixel,
+                        std::vector<UINT8> *cursor,
+                        std::vector<UINT8> *bitmask);
 };
 
 #endif
@@ -24,6 +24,8 @@
 
 #include "RreDecoder.h"
 
+#include <string.h>
+
 RreDecoder::RreDecoder(LogWriter *logWriter)
 : DecoderOfRectangle(logWriter)
 {
@@ -41,20 +43,34 @@ void RreDecoder::decode(RfbInputGate *input,
   UINT32 numberRectangle = input->readUInt32();
   size_t bytesPerPixel = frameBuffer->getBytesPerPixel();
 
-  UINT32 backgroundColor;
+  UINT32 backgroundColor = 0;
   input->readFully(&backgroundColor, bytesPerPixel);
   frameBuffer->fillRect(dstRect, backgroundColor);
 
-  while (numberRectangle--) {
-    UINT32 color;
-    input->readFully(&color, bytesPerPixel);
-    UINT32 x = input->readUInt16();
-    UINT32 y = input->readUInt16();
-    UINT32 w = input->readUInt16();
-    UINT32 h = input->readUInt16();
-
-    Rect rect(x, y, x + w, y + h);
-    rect.move(dstRect->left, dstRect->top);
-    frameBuffer->fillRect(&rect, color);
+  // Subrectangles are read and filled in batches.
+  const size_t subrectSize = bytesPerPixel + 8;
+  while (numberRectangle > 0) {
+    UINT32 count = BATCH_SIZE;
+    if (numberRectangle < count) {
+      count = numberRectangle;
+    }
+    numberRectangle -= count;
+    input->readFully(m_subrectData, count * subrectSize);
+
+    const UINT8 *subrect = m_subrectData;
+    for (UINT32 i = 0; i < count; i++, subrect += subrectSize) {
+      UINT32 color = 0;
+      memcpy(&color, subrect, bytesPerPixel);
+      const UINT8 *coords = subrect + bytesPerPixel;
+      int x = (coords[0] << 8) | coords[1];
+      int y = (coords[2] << 8) | coords[3];
+      int w = (coords[4] << 8) | coords[5];
+      int h = (coords[6] << 8) | coords[7];
+
+      m_fillRects[i].setRect(x, y, x + w, y + h);
+      m_fillRects[i].move(dstRect->left, dstRect->top);
+      m_fillColors[i] = color;
+    }
+    frameBuffer->fillRects(m_fillRects, m_fillColors, count);
   }
 }
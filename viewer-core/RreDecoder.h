@@ -37,6 +37,16 @@ protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *framebuffer,
                       const Rect *dstRect);
+
+private:
+  // Subrectangles read and filled at a time.
+  static const UINT32 BATCH_SIZE = 256;
+  // Largest subrectangle: a 4-byte pixel and four 16-bit numbers.
+  static const size_t MAX_SUBRECT_SIZE = 4 + 8;
+
+  UINT8 m_subrectData[BATCH_SIZE * MAX_SUBRECT_SIZE];
+  Rect m_fillRects[BATCH_SIZE];
+  UINT32 m_fillColors[BATCH_SIZE];
 };
 
 #endif
@@ -0,0 +1,48 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "ServerScale.h"
+
+ServerScale::ServerScale(LogWriter *logWriter, int factor)
+: PseudoDecoder(logWriter)
+{
+  m_encoding = factorToEncoding(factor);
+}
+
+ServerScale::~ServerScale()
+{
+}
+
+int ServerScale::factorToEncoding(int factor)
+{
+  switch (factor) {
+  case 2: return PseudoEncDefs::SERVER_SCALE_1_2;
+  case 4: return PseudoEncDefs::SERVER_SCALE_1_4;
+  case 8: return PseudoEncDefs::SERVER_SCALE_1_8;
+  default:
+    StringStorage error;
+    error.format(_T("Server scale \"1/%d\" is not valid"), factor);
+    throw Exception(error.getString());
+  }
+}
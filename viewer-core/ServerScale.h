@@ -0,0 +1,45 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _SERVER_SCALE_H_
+#define _SERVER_SCALE_H_
+
+#include "PseudoDecoder.h"
+
+// Asks the server to scale the screen down by the factor (2, 4 or 8) before
+// sending it. The frame buffer is resized by the server then.
+class ServerScale : public PseudoDecoder
+{
+public:
+  ServerScale(LogWriter *logWriter, int factor);
+  virtual ~ServerScale();
+
+public:
+  static int factorToEncoding(int factor);
+
+  static const int SERVER_SCALE_MIN = 2;
+  static const int SERVER_SCALE_MAX = 8;
+};
+
+#endif
@@ -0,0 +1,437 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SessionPlayer.h"
+
+#include "file-lib/EOFException.h"
+#include "io-lib/ByteArrayInputStream.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/MsgDefs.h"
+#include "util/Exception.h"
+
+#include "CopyRectDecoder.h"
+#include "CursorCacheDecoder.h"
+#include "DecoderOfRectangle.h"
+#include "H264Decoder.h"
+#include "HexTileDecoder.h"
+#include "RawDecoder.h"
+#include "RichCursorDecoder.h"
+#include "RreDecoder.h"
+#include "TightDecoder.h"
+#include "TileCacheDecoder.h"
+#include "ZrleDecoder.h"
+
+SessionPlayer::SessionPlayer(const TCHAR *fileName, LogWriter *logWriter)
+: m_logWriter(logWriter),
+  m_file(fileName, F_READ, FM_OPEN),
+  m_input(&m_file),
+  m_offset(SessionRecordingDefs::FILE_HEADER_SIZE),
+  m_time(0),
+  m_fbUpdateNotifier(&m_frameBuffer, &m_fbLock, logWriter,
+                     &m_watermarksController),
+  m_decoderStore(0)
+{
+  if (m_input.readUInt32() != SessionRecordingDefs::MAGIC) {
+    throw Exception(_T("The file is not a session recording"));
+  }
+  if (m_input.readUInt32() != SessionRecordingDefs::VERSION) {
+    throw Exception(_T("Unsupported version of the session recording"));
+  }
+  createDecoders();
+
+  StringStorage indexFileName(fileName);
+  indexFileName.appendString(SessionRecordingDefs::INDEX_SUFFIX);
+  readIndex(indexFileName.getString());
+}
+
+SessionPlayer::~SessionPlayer()
+{
+  delete m_decoderStore;
+}
+
+void SessionPlayer::setAdapter(CoreEventsAdapter *adapter)
+{
+  m_fbUpdateNotifier.setAdapter(adapter);
+}
+
+bool SessionPlayer::playNext()
+{
+  UINT8 type;
+  UINT32 length;
+  UINT64 time;
+  if (!readRecordHeader(&type, &length, &time)) {
+    return false;
+  }
+  m_time = time;
+  playRecord(type, length);
+  return true;
+}
+
+void SessionPlayer::seek(UINT64 time)
+{
+  UINT64 offset = SessionRecordingDefs::FILE_HEADER_SIZE;
+  std::vector<IndexEntry>::const_iterator iEntry;
+  for (iEntry = m_index.begin(); iEntry != m_index.end(); iEntry++) {
+    if (iEntry->time > time) {
+      break;
+    }
+    offset = iEntry->offset;
+  }
+  // Playing forward from the current record is faster if there is no
+  // keyframe between it and the time.
+  if (offset > m_offset || time < m_time) {
+    rewind(offset);
+  }
+
+  UINT8 type;
+  UINT32 length;
+  UINT64 recordTime;
+  UINT64 recordOffset = m_offset;
+  while (readRecordHeader(&type, &length, &recordTime)) {
+    if (recordTime > time) {
+      // Leave the record for the next playNext() call.
+      m_file.seek(recordOffset);
+      m_offset = recordOffset;
+      break;
+    }
+    m_time = recordTime;
+    playRecord(type, length);
+    recordOffset = m_offset;
+  }
+}
+
+UINT64 SessionPlayer::getTime() const
+{
+  return m_time;
+}
+
+const FrameBuffer *SessionPlayer::getFrameBuffer() const
+{
+  return &m_frameBuffer;
+}
+
+LocalMutex *SessionPlayer::getFbLock()
+{
+  return &m_fbLock;
+}
+
+void SessionPlayer::readIndex(const TCHAR *fileName)
+{
+  try {
+    WinFileChannel indexFile(fileName, F_READ, FM_OPEN);
+    DataInputStream input(&indexFile);
+    while (true) {
+      IndexEntry entry;
+      entry.time = input.readUInt64();
+      entry.offset = input.readUInt64();
+      m_index.push_back(entry);
+    }
+  } catch (EOFException &) {
+  } catch (Exception &e) {
+    m_logWriter->error(_T("Cannot read the index of the session recording: %s"),
+                       e.getMessage());
+  }
+  m_logWriter->info(_T("Session recording has %u keyframes"),
+                    (unsigned int)m_index.size());
+}
+
+bool SessionPlayer::readRecordHeader(UINT8 *type, UINT32 *length,
+                                     UINT64 *time)
+{
+  char header[SessionRecordingDefs::RECORD_HEADER_SIZE];
+  try {
+    m_input.readFully(header, sizeof(header));
+  } catch (EOFException &) {
+    return false;
+  }
+  ByteArrayInputStream headerStream(header, sizeof(header));
+  DataInputStream headerInput(&headerStream);
+  *type = headerInput.readUInt8();
+  *length = headerInput.readUInt32();
+  *time = headerInput.readUInt64();
+  m_offset += SessionRecordingDefs::RECORD_HEADER_SIZE + *length;
+  return true;
+}
+
+void SessionPlayer::playRecord(UINT8 type, UINT32 length)
+{
+  m_record.resize(length);
+  if (length != 0) {
+    m_input.readFully(&m_record.front(), length);
+  }
+  ByteArrayInputStream recordStream(length != 0 ? &m_record.front() : 0,
+                                    length);
+  switch (type) {
+  case SessionRecordingDefs::FORMAT:
+    {
+      DataInputStream input(&recordStream);
+      playFormat(&input);
+    }
+    break;
+  case SessionRecordingDefs::KEYFRAME:
+    {
+      DataInputStream input(&recordStream);
+      playKeyFrame(&input, length);
+    }
+    break;
+  case SessionRecordingDefs::UPDATE:
+    {
+      RfbInputGate input(&recordStream);
+      playUpdate(&input);
+    }
+    break;
+  default:
+    // Records of later versions may be skipped.
+    m_logWriter->debug(_T("Skipping session record of type %d"), (int)type);
+    break;
+  }
+}
+
+void SessionPlayer::playFormat(DataInputStream *input)
+{
+  Dimension dim;
+  dim.width = input->readUInt16();
+  dim.height = input->readUInt16();
+  PixelFormat pf;
+  pf.bitsPerPixel = input->readUInt8();
+  pf.colorDepth = input->readUInt8();
+  pf.bigEndian = input->readUInt8() != 0;
+  input->readUInt8(); // true color
+  pf.redMax = input->readUInt16();
+  pf.greenMax = input->readUInt16();
+  pf.blueMax = input->readUInt16();
+  pf.redShift = input->readUInt8();
+  pf.greenShift = input->readUInt8();
+  pf.blueShift = input->readUInt8();
+  if (pf.bitsPerPixel != 8 && pf.bitsPerPixel != 16 &&
+      pf.bitsPerPixel != 32) {
+    throw Exception(_T("Wrong pixel format in the session recording"));
+  }
+
+  AutoLock al(&m_fbLock);
+  if (!m_frameBuffer.getDimension().isEqualTo(&dim) ||
+      !m_frameBuffer.getPixelFormat().isEqualTo(&pf)) {
+    setFbProperties(&dim, &pf);
+  }
+}
+
+void SessionPlayer::playKeyFrame(DataInputStream *input, UINT32 length)
+{
+  Dimension dim;
+  dim.width = input->readUInt16();
+  dim.height = input->readUInt16();
+
+  AutoLock al(&m_fbLock);
+  if (!m_frameBuffer.getDimension().isEqualTo(&dim)) {
+    PixelFormat pf = m_frameBuffer.getPixelFormat();
+    setFbProperties(&dim, &pf);
+  }
+  if ((size_t)m_frameBuffer.getBufferSize() != length - 4) {
+    throw Exception(_T("Wrong keyframe size in the session recording"));
+  }
+  input->readFully(m_frameBuffer.getBuffer(), m_frameBuffer.getBufferSize());
+  memcpy(m_rectangleFb.getBuffer(), m_frameBuffer.getBuffer(),
+         m_frameBuffer.getBufferSize());
+  Rect fbRect = dim.getRect();
+  m_fbUpdateNotifier.onUpdate(&fbRect);
+}
+
+void SessionPlayer::playUpdate(RfbInputGate *input)
+{
+  while (input->available() != 0) {
+    UINT8 messageType = input->readUInt8();
+    switch (messageType) {
+    case ServerMsgDefs::FB_UPDATE:
+      playFbUpdate(input);
+      break;
+    case ServerMsgDefs::SET_COLOR_MAP_ENTRIES:
+      {
+        // Colour maps are not supported by the viewer, see
+        // RemoteViewerCore::receiveSetColorMapEntries().
+        input->readUInt8();
+        input->readUInt16();
+        UINT16 numberOfColours = input->readUInt16();
+        for (size_t i = 0; i < (size_t)numberOfColours * 3; i++) {
+          input->readUInt16();
+        }
+      }
+      break;
+    default:
+      {
+        StringStorage errorString;
+        errorString.format(_T("Unexpected server message %d in the session recording"),
+                           (int)messageType);
+        throw Exception(errorString.getString());
+      }
+    }
+  }
+}
+
+void SessionPlayer::playFbUpdate(RfbInputGate *input)
+{
+  input->readUInt8(); // padding
+  UINT16 numberOfRectangles = input->readUInt16();
+  bool isStreamed = numberOfRectangles == PseudoEncDefs::LAST_RECT_COUNT;
+  for (int i = 0; isStreamed || i < numberOfRectangles; i++) {
+    Rect rect;
+    rect.left = input->readUInt16();
+    rect.top = input->readUInt16();
+    rect.setWidth(input->readUInt16());
+    rect.setHeight(input->readUInt16());
+    int encodingType = input->readInt32();
+
+    if (encodingType == PseudoEncDefs::LAST_RECT) {
+      break;
+    }
+    if (Decoder::isPseudo(encodingType)) {
+      playPseudoEncoding(input, &rect, encodingType);
+      continue;
+    }
+    Rect fbRect = m_frameBuffer.getDimension().getRect();
+    if (!fbRect.intersection(&rect).isEqualTo(&rect)) {
+      throw Exception(_T("Incorrect size of rectangle in the session recording"));
+    }
+    DecoderOfRectangle *decoder =
+      dynamic_cast<DecoderOfRectangle *>(m_decoderStore->getDecoder(encodingType));
+    if (decoder == 0) {
+      StringStorage errorString;
+      errorString.format(_T("Decoder \"%d\" isn't exist"), encodingType);
+      throw Exception(errorString.getString());
+    }
+    decoder->process(input, &m_frameBuffer, &m_rectangleFb, &rect, &m_fbLock,
+                     &m_fbUpdateNotifier);
+  }
+}
+
+void SessionPlayer::playPseudoEncoding(RfbInputGate *input,
+                                       const Rect *rect,
+                                       int encodingType)
+{
+  switch (encodingType) {
+  case PseudoEncDefs::DESKTOP_SIZE:
+  case PseudoEncDefs::DESKTOP_CONFIGURATION:
+    if (encodingType == PseudoEncDefs::DESKTOP_CONFIGURATION) {
+      UINT8 numberOfScreens = input->readUInt8();
+      input->readUInt8();
+      input->readUInt16();
+      for (int i = 0; i < numberOfScreens; i++) {
+        // id, position, size and flags of the screen
+        input->readUInt32();
+        input->readUInt32();
+        input->readUInt32();
+        input->readUInt32();
+      }
+    }
+    {
+      AutoLock al(&m_fbLock);
+      Dimension dim(rect);
+      PixelFormat pf = m_frameBuffer.getPixelFormat();
+      setFbProperties(&dim, &pf);
+    }
+    break;
+
+  case PseudoEncDefs::RICH_CURSOR:
+    {
+      UINT16 width = rect->getWidth();
+      UINT16 height = rect->getHeight();
+      std::vector<UINT8> cursor;
+      std::vector<UINT8> bitmask;
+      RichCursorDecoder::readShape(input, width, height,
+                                   m_frameBuffer.getBytesPerPixel(),
+                                   &cursor, &bitmask);
+      Point hotSpot(rect->left, rect->top);
+      m_fbUpdateNotifier.setNewCursor(&hotSpot, width, height,
+                                      &cursor, &bitmask);
+    }
+    break;
+
+  case PseudoEncDefs::CURSOR_CACHE:
+    {
+      CursorCacheDecoder *decoder = dynamic_cast<CursorCacheDecoder *>(
+        m_decoderStore->getDecoder(PseudoEncDefs::CURSOR_CACHE));
+      std::vector<UINT8> cursor;
+      std::vector<UINT8> bitmask;
+      decoder->readShape(input, rect, m_frameBuffer.getBytesPerPixel(),
+                         &cursor, &bitmask);
+      Point hotSpot(rect->left, rect->top);
+      m_fbUpdateNotifier.setNewCursor(&hotSpot,
+                                      (UINT16)rect->getWidth(),
+                                      (UINT16)rect->getHeight(),
+                                      &cursor, &bitmask);
+    }
+    break;
+
+  case PseudoEncDefs::POINTER_POS:
+    {
+      Point position(rect->left, rect->top);
+      m_fbUpdateNotifier.updatePointerPos(&position);
+    }
+    break;
+
+  default:
+    StringStorage errorString;
+    errorString.format(_T("Pseudo encoding %d is not supported"), encodingType);
+    throw Exception(errorString.getString());
+  }
+}
+
+void SessionPlayer::rewind(UINT64 offset)
+{
+  m_file.seek(offset);
+  m_offset = offset;
+  m_time = 0;
+  createDecoders();
+}
+
+void SessionPlayer::createDecoders()
+{
+  delete m_decoderStore;
+  m_decoderStore = new DecoderStore(m_logWriter);
+  m_decoderStore->addDecoder(new RawDecoder(m_logWriter), 0);
+  m_decoderStore->addDecoder(new CopyRectDecoder(m_logWriter), 10);
+  m_decoderStore->addDecoder(new RreDecoder(m_logWriter), 1);
+  m_decoderStore->addDecoder(new HexTileDecoder(m_logWriter), 4);
+  m_decoderStore->addDecoder(new TightDecoder(m_logWriter), 9);
+  m_decoderStore->addDecoder(new ZrleDecoder(m_logWriter), 9);
+  try {
+    m_decoderStore->addDecoder(new H264Decoder(m_logWriter), 8);
+  } catch (const Exception &ex) {
+    m_logWriter->info(_T("H.264 decoding is not available: %s"), ex.getMessage());
+  }
+  m_decoderStore->addDecoder(new TileCacheDecoder(m_logWriter), 7);
+  // Cached cursor shapes are stored in the decoder too.
+  m_decoderStore->addDecoder(new CursorCacheDecoder(m_logWriter), -1);
+}
+
+void SessionPlayer::setFbProperties(const Dimension *dim,
+                                    const PixelFormat *pf)
+{
+  if (!m_frameBuffer.setProperties(dim, pf) ||
+      !m_rectangleFb.setProperties(dim, pf)) {
+    throw Exception(_T("Cannot allocate the framebuffer for the session recording"));
+  }
+  m_rectangleFb.setColor(0, 0, 0);
+  m_frameBuffer.setColor(0, 0, 0);
+  m_fbUpdateNotifier.onPropertiesFb();
+}
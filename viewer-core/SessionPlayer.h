@@ -0,0 +1,127 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _SESSION_PLAYER_H_
+#define _SESSION_PLAYER_H_
+
+#include "file-lib/WinFileChannel.h"
+#include "io-lib/DataInputStream.h"
+#include "log-writer/LogWriter.h"
+#include "network/RfbInputGate.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/SessionRecordingDefs.h"
+#include "thread/LocalMutex.h"
+
+#include "CoreEventsAdapter.h"
+#include "DecoderStore.h"
+#include "FbUpdateNotifier.h"
+#include "WatermarksController.h"
+
+#include <vector>
+
+//
+// SessionPlayer plays the session recordings made by the server (see
+// SessionRecordingDefs) through the same decoders as RemoteViewerCore uses
+// for a live connection. The index of keyframes lets it seek without
+// decoding the recording from the start.
+//
+class SessionPlayer
+{
+public:
+  // Opens the recording and reads its index. A missing or damaged index
+  // makes seeking slow but does not prevent playing.
+  // Throws Exception if the recording cannot be opened.
+  SessionPlayer(const TCHAR *fileName, LogWriter *logWriter);
+  virtual ~SessionPlayer();
+
+  // Sets the adapter to be notified about the framebuffer changes, as
+  // RemoteViewerCore does it. May be 0.
+  void setAdapter(CoreEventsAdapter *adapter);
+
+  // Plays the next record of the recording. Returns false at the end of
+  // the recording, which may be truncated by a killed server.
+  bool playNext();
+
+  // Shows the session as it was at the time, in milliseconds since the
+  // recording start: starts from the last keyframe before it and plays the
+  // records up to the time.
+  void seek(UINT64 time);
+
+  // Returns the time of the last played record.
+  UINT64 getTime() const;
+
+  // The framebuffer is changed by playNext() and seek(), so it must be
+  // accessed with the lock held.
+  const FrameBuffer *getFrameBuffer() const;
+  LocalMutex *getFbLock();
+
+private:
+  struct IndexEntry
+  {
+    UINT64 time;
+    UINT64 offset;
+  };
+
+  void readIndex(const TCHAR *fileName);
+
+  // Reads the header of the next record. Returns false at the end of the
+  // recording.
+  bool readRecordHeader(UINT8 *type, UINT32 *length, UINT64 *time);
+  void playRecord(UINT8 type, UINT32 length);
+
+  void playFormat(DataInputStream *input);
+  void playKeyFrame(DataInputStream *input, UINT32 length);
+  void playUpdate(RfbInputGate *input);
+  void playFbUpdate(RfbInputGate *input);
+  void playPseudoEncoding(RfbInputGate *input, const Rect *rect,
+                          int encodingType);
+
+  // Moves to the record at the offset with all the decoders reset.
+  void rewind(UINT64 offset);
+  void createDecoders();
+  void setFbProperties(const Dimension *dim, const PixelFormat *pf);
+
+  LogWriter *m_logWriter;
+
+  WinFileChannel m_file;
+  DataInputStream m_input;
+  // Offset of the next record.
+  UINT64 m_offset;
+  UINT64 m_time;
+  std::vector<char> m_record;
+
+  std::vector<IndexEntry> m_index;
+
+  FrameBuffer m_frameBuffer;
+  FrameBuffer m_rectangleFb;
+  LocalMutex m_fbLock;
+
+  WatermarksController m_watermarksController;
+  FbUpdateNotifier m_fbUpdateNotifier;
+  // Decoders keep the state of compression streams, so they are recreated
+  // on seeking.
+  DecoderStore *m_decoderStore;
+};
+
+#endif
@@ -29,7 +29,9 @@
 TcpConnection::TcpConnection(LogWriter *logWriter)
 : m_logWriter(logWriter),
 m_socketOwner(false),
+m_readAhead(0),
 m_bufInput(0),
+m_tlsStream(0),
 m_RfbGatesOwner(false)
 {
   m_port = 0;
@@ -84,6 +86,29 @@ void TcpConnection::bind(RfbInputGate *input, RfbOutputGate *output)
   m_wasBound = true;
 }
 
+void TcpConnection::setSocketProfile(const SocketProfile *profile)
+{
+  AutoLock al(&m_connectLock);
+  m_socketProfile = *profile;
+}
+
+void TcpConnection::getSocketProfile(SocketProfile *profile) const
+{
+  AutoLock al(&m_connectLock);
+  *profile = m_socketProfile;
+}
+
+bool TcpConnection::getHostAddress(StringStorage *host, UINT16 *port) const
+{
+  AutoLock al(&m_connectLock);
+  if (m_host.isEmpty() || m_port == 0) {
+    return false;
+  }
+  *host = m_host;
+  *port = m_port;
+  return true;
+}
+
 void TcpConnection::connect()
 {
   // if connection is already established, then method do nothing.
@@ -107,17 +132,32 @@ void TcpConnection::connect()
         m_socket = new SocketIPv4;
         m_socketOwner = true;
         m_socket->connect(ipAddress);
-        m_socket->enableNaggleAlgorithm(false);
       } else {
         throw Exception(_T("Connection parameters (host, port, socket, gates) is empty."));
       }
     }
 
+    SocketProfile socketProfile;
+    {
+      AutoLock al(&m_connectLock);
+      socketProfile = m_socketProfile;
+    }
+    try {
+      socketProfile.apply(m_socket);
+    } catch (SocketException &e) {
+      m_logWriter->error(_T("Can't apply the socket profile: %s"), e.getMessage());
+    }
+    StringStorage socketValues;
+    SocketProfile::describe(m_socket, &socketValues);
+    m_logWriter->info(_T("Socket: %s"), socketValues.getString());
+
     m_logWriter->detail(_T("Initialization of socket stream and input/output gates..."));
     m_socketStream = new SocketStream(m_socket);
-    m_bufInput = new BufferedInputStream(m_socketStream);
-    m_input = new RfbInputGate(m_bufInput);
-    m_output = new RfbOutputGate(m_socketStream);
+    m_readAhead = new ReadAheadInputStream(m_socketStream);
+    m_bufInput = new BufferedInputStream(m_readAhead);
+    m_tlsStream = new TlsStream(m_bufInput, m_socketStream);
+    m_input = new RfbInputGate(m_tlsStream);
+    m_output = new RfbOutputGate(m_tlsStream);
     m_RfbGatesOwner = true;
   } else {
     _ASSERT(m_input != 0 && m_output != 0);
@@ -159,6 +199,23 @@ RfbOutputGate *TcpConnection::getOutput() const
   return m_output;
 }
 
+bool TcpConnection::isTlsPossible() const
+{
+  return m_tlsStream != 0;
+}
+
+void TcpConnection::startTls()
+{
+  _ASSERT(m_tlsStream != 0);
+  // The sessions are resumed by the name of the host.
+  StringStorage target;
+  target.format(_T("%s:%hu"), m_host.getString(), m_port);
+  m_tlsStream->startTls(false, target.getString());
+  StringStorage tlsInfo;
+  m_tlsStream->getDescription(&tlsInfo);
+  m_logWriter->info(_T("TLS tunnel: %s"), tlsInfo.getString());
+}
+
 TcpConnection::~TcpConnection()
 {
   // if socket is defined, then need delete gates and socket stream
@@ -177,6 +234,18 @@ TcpConnection::~TcpConnection()
       }
     }
 
+    // The reading thread of m_readAhead exits when the socket is shut down.
+    if (m_readAhead != 0) {
+      try {
+        m_socket->shutdown(SD_BOTH);
+      } catch (...) {
+      }
+      try {
+        delete m_readAhead;
+      } catch (...) {
+      }
+    }
+
     if (m_socketStream != 0) {
       try {
         delete m_socketStream;
@@ -184,6 +253,9 @@ TcpConnection::~TcpConnection()
       catch (...) {
       }
     }
+    if (m_tlsStream != 0) {
+      delete m_tlsStream;
+    }
     if (m_bufInput != 0) {
       try {
         delete m_bufInput;
@@ -30,8 +30,11 @@
 #include "network/RfbOutputGate.h"
 #include "network/socket/SocketIPv4.h"
 #include "network/socket/SocketStream.h"
+#include "network/socket/SocketProfile.h"
 #include "thread/LocalMutex.h"
 #include "io-lib/BufferedInputStream.h"
+#include "network/ReadAheadInputStream.h"
+#include "network/TlsStream.h"
 
 class TcpConnection
 {
@@ -43,21 +46,43 @@ public:
   void bind(SocketIPv4 *socket);
   void bind(RfbInputGate *input, RfbOutputGate *output);
 
+  // Sets tuning applied to the socket on connect(). Does not apply to
+  // connections bound to gates.
+  void setSocketProfile(const SocketProfile *profile);
+  void getSocketProfile(SocketProfile *profile) const;
+
+  // Puts the address the connection is made to. Returns false if it is
+  // bound to a socket or gates given by the application.
+  bool getHostAddress(StringStorage *host, UINT16 *port) const;
+
   void connect();
   void close();
 
   RfbInputGate *getInput() const;
   RfbOutputGate *getOutput() const;
+
+  // Returns true if the connection has been made by us over a socket, so
+  // it can be encrypted by startTls().
+  bool isTlsPossible() const;
+  // Performs the client side of the TLS handshake, the gates are encrypted
+  // after it. Nothing must be buffered in the gates then.
+  // @throws IOException on error.
+  void startTls();
 private:
   StringStorage m_host;
   UINT16 m_port;
   SocketIPv4 *m_socket;
   bool m_socketOwner;
   SocketStream *m_socketStream;
+  // Keeps the socket drained while the core is decoding.
+  ReadAheadInputStream *m_readAhead;
   BufferedInputStream *m_bufInput;
+  // The gates work over it, it passes the data through until startTls().
+  TlsStream *m_tlsStream;
   RfbInputGate *m_input;
   RfbOutputGate *m_output;
   bool m_RfbGatesOwner;
+  SocketProfile m_socketProfile;
 
   bool m_wasBound;
   bool m_wasConnected;
@@ -23,11 +23,13 @@
 //
 
 #include "TightDecoder.h"
+#include "PixelUnpacker.h"
 
 #include "rfb/StandardPixelFormatFactory.h"
 
 TightDecoder::TightDecoder(LogWriter *logWriter)
 : DecoderOfRectangle(logWriter),
+  m_bufferGrowthCount(0),
   m_isCPixel(false)
 {
   m_encoding = EncodingDefs::TIGHT;
@@ -35,7 +37,6 @@ TightDecoder::TightDecoder(LogWriter *logWriter)
   m_inflater.resize(DECODERS_NUM);
   for (int i = 0; i < DECODERS_NUM; i++)
     m_inflater[i] = new Inflater;
-  reset();
 }
 
 TightDecoder::~TightDecoder()
@@ -48,6 +49,11 @@ TightDecoder::~TightDecoder()
   }
 }
 
+unsigned int TightDecoder::getBufferGrowthCount() const
+{
+  return m_bufferGrowthCount;
+}
+
 void TightDecoder::decode(RfbInputGate *input,
                           FrameBuffer *fb,
                           const Rect *dstRect)
@@ -85,27 +91,6 @@ void TightDecoder::decode(RfbInputGate *input,
     processBasicTypes(input, fb, dstRect, compressionControl);
 }
 
-UINT32 TightDecoder::transformPixelToTight(UINT32 color)
-{
-  UINT32 result = 0;
-  result |= (color & 0xFF) << 16;
-  result |= color & 0xFF00;
-  result |= (color >> 16);
-  return result;
-}
-
-vector<UINT8> TightDecoder::transformArray(const vector<UINT8> &buffer)
-{
-  vector<UINT8> result(buffer.size() * 4 / 3);
-  for (size_t bi = 0, ri = 0; bi < buffer.size(); bi += 3, ri += 4) {
-    result[ri] = buffer[bi + 2];
-    result[ri + 1] = buffer[bi + 1];
-    result[ri + 2] = buffer[bi];
-    result[ri + 3] = 0;
-  }
-  return result;
-}
-
 UINT32 TightDecoder::readTightPixel(RfbInputGate *input, int bytesPerCPixel)
 {
   UINT32 color = 0;
@@ -126,8 +111,7 @@ UINT32 TightDecoder::readTightPixel(RfbInputGate *input, int bytesPerCPixel)
 void TightDecoder::reset()
 {
   for (int i = 0; i < DECODERS_NUM; i++) {
-    delete m_inflater[i];
-    m_inflater[i] = new Inflater;
+    m_inflater[i]->reset();
   }
 }
 
@@ -135,8 +119,7 @@ void TightDecoder::resetDecoders(UINT8 compressionControl)
 {
   for (int i = 0; i < DECODERS_NUM; i++)
     if (compressionControl & (0x01 << i)) {
-        delete m_inflater[i];
-        m_inflater[i] = new Inflater;
+        m_inflater[i]->reset();
     }
 }
 
@@ -154,6 +137,15 @@ int TightDecoder::readCompactSize(RfbInputGate *input)
   return size;
 }
 
+UINT8 *TightDecoder::prepareBuffer(vector<UINT8> *buffer, size_t size)
+{
+  if (buffer->capacity() < size) {
+    m_bufferGrowthCount++;
+  }
+  buffer->resize(size);
+  return size != 0 ? &buffer->front() : 0;
+}
+
 void TightDecoder::processJpeg(RfbInputGate *input,
                                FrameBuffer *frameBuffer,
                                const Rect *dstRect)
@@ -161,21 +153,39 @@ void TightDecoder::processJpeg(RfbInputGate *input,
   UINT32 jpegBufLen = readCompactSize(input);
   if (jpegBufLen == 0)
     throw Exception(_T("Error in protocol: empty byffer of jpeg (tight-decoder)"));
-  vector<UINT8> buffer;
-  buffer.resize(jpegBufLen);
-  input->readFully(&buffer.front(), jpegBufLen);
+  input->readFully(prepareBuffer(&m_jpegData, jpegBufLen), jpegBufLen);
 
-  if (dstRect->area() != 0) {
-    vector<UINT8> pixels;
-    pixels.resize(dstRect->area() * JpegDecompressor::BYTES_PER_PIXEL);
+  if (dstRect->area() != 0 && !m_isDrawingSkipped) {
+    if (m_wicJpeg.isSuitable(dstRect)) {
+      if (processWicJpeg(frameBuffer, jpegBufLen, dstRect)) {
+        return;
+      }
+      m_logWriter->debug(_T("The system JPEG codec failed, using libjpeg"));
+    }
+    PixelFormat pf = frameBuffer->getPixelFormat();
+    if (JpegDecompressor::canDecompressTo(&pf)) {
+      // The JPEG library writes the frame buffer pixels by itself.
+      try {
+        m_jpeg.decompress(m_jpegData, jpegBufLen, frameBuffer, dstRect);
+      } catch (const Exception &ex) {
+        StringStorage error;
+        error.format(_T("Error in tight-decoder, subencoding \"jpeg\": %s"),
+                     ex.getMessage());
+        m_logWriter->error(error.getString());
+      }
+      return;
+    }
+
+    prepareBuffer(&m_jpegPixels,
+                  dstRect->area() * JpegDecompressor::BYTES_PER_PIXEL);
 
     try {
-      m_jpeg.decompress(buffer, jpegBufLen, pixels, dstRect);
+      m_jpeg.decompress(m_jpegData, jpegBufLen, m_jpegPixels, dstRect);
+      // The decompressed pixels are in the CPixel format.
       if (m_isCPixel) {
-        pixels = transformArray(pixels);
-        drawTightBytes(frameBuffer, &pixels, dstRect);
+        drawTightBytes(frameBuffer, &m_jpegPixels.front(), dstRect);
       } else {
-        drawJpegBytes(frameBuffer, &pixels, dstRect);
+        drawJpegBytes(frameBuffer, &m_jpegPixels.front(), dstRect);
       }
     } catch (const Exception &ex) {
       StringStorage error;
@@ -186,6 +196,29 @@ void TightDecoder::processJpeg(RfbInputGate *input,
   }
 }
 
+bool TightDecoder::processWicJpeg(FrameBuffer *frameBuffer,
+                                  size_t jpegBufLen,
+                                  const Rect *dstRect)
+{
+  PixelFormat pf = frameBuffer->getPixelFormat();
+  if (WicJpegDecompressor::canDecompressTo(&pf)) {
+    return m_wicJpeg.decompress(m_jpegData, jpegBufLen, frameBuffer, dstRect);
+  }
+
+  prepareBuffer(&m_jpegPixels,
+                dstRect->area() * WicJpegDecompressor::BYTES_PER_PIXEL);
+  if (!m_wicJpeg.decompress(m_jpegData, jpegBufLen, m_jpegPixels, dstRect)) {
+    return false;
+  }
+  // The decompressed pixels are in the CPixel format.
+  if (m_isCPixel) {
+    drawTightBytes(frameBuffer, &m_jpegPixels.front(), dstRect);
+  } else {
+    drawJpegBytes(frameBuffer, &m_jpegPixels.front(), dstRect);
+  }
+  return true;
+}
+
 void TightDecoder::processBasicTypes(RfbInputGate *input,
                                      FrameBuffer *fb,
                                      const Rect *dstRect,
@@ -203,15 +236,12 @@ void TightDecoder::processBasicTypes(RfbInputGate *input,
     lengthCurrentBpp = dstRect->area() * 3;
   }
 
-  vector<UINT8> buffer;
-
   switch (filterId) {
   case COPY_FILTER:
-    readTightData(input, buffer, lengthCurrentBpp, decoderId);
-    if (m_isCPixel) {
-      buffer = transformArray(buffer);
+    {
+      const UINT8 *data = readTightData(input, lengthCurrentBpp, decoderId);
+      drawTightBytes(fb, data, dstRect);
     }
-    drawTightBytes(fb, &buffer, dstRect);
     break;
 
   // The "gradient" filter and "jpeg" compression may be used only
@@ -219,19 +249,21 @@ void TightDecoder::processBasicTypes(RfbInputGate *input,
   case PALETTE_FILTER:
     {
       int paletteSize = input->readUInt8() + 1;
-      vector<UINT32> palette = readPalette(input, paletteSize, bytesPerCPixel);
+      readPalette(input, paletteSize, bytesPerCPixel);
       size_t dataLength = dstRect->area();
       if (paletteSize == 2) {
         dataLength = (dstRect->getWidth() + 7) / 8 * dstRect->getHeight();
       }
-      readTightData(input, buffer, dataLength, decoderId);
-      drawPalette(fb, palette, buffer, dstRect);
+      const UINT8 *data = readTightData(input, dataLength, decoderId);
+      drawPalette(fb, paletteSize, data, dstRect);
     }
     break;
 
   case GRADIENT_FILTER:
-    readTightData(input, buffer, lengthCurrentBpp, decoderId);
-    drawGradient(fb, buffer, dstRect);
+    {
+      const UINT8 *data = readTightData(input, lengthCurrentBpp, decoderId);
+      drawGradient(fb, data, dstRect);
+    }
     break;
 
   default:
@@ -239,147 +271,131 @@ void TightDecoder::processBasicTypes(RfbInputGate *input,
   }
 }
 
-vector<UINT32> TightDecoder::readPalette(RfbInputGate *input,
-                                      int paletteSize,
-                                      int bytesPerCPixel)
+void TightDecoder::readPalette(RfbInputGate *input,
+                               int paletteSize,
+                               int bytesPerCPixel)
 {
-  vector<UINT32> palette(paletteSize);
   for (int i = 0; i < paletteSize; i++) {
-    palette[i] = readTightPixel(input, bytesPerCPixel);
+    m_palette[i] = readTightPixel(input, bytesPerCPixel);
   }
-  return palette;
 }
 
-void TightDecoder::readTightData(RfbInputGate *input,
-                                 vector<UINT8> &buffer,
-                                 size_t expectedLength,
-                                 const int decoderId)
+const UINT8 *TightDecoder::readTightData(RfbInputGate *input,
+                                         size_t expectedLength,
+                                         const int decoderId)
 {
   if (expectedLength < MIN_SIZE_TO_COMPRESS) {
-    buffer.resize(expectedLength);
+    UINT8 *data = prepareBuffer(&m_rawData, expectedLength);
     if (expectedLength != 0) {
-      input->readFully(&buffer.front(), expectedLength);
+      input->readFully(data, expectedLength);
     }
-  } else {
-    readCompressedData(input, buffer, expectedLength, decoderId);
+    return data;
   }
+  return readCompressedData(input, expectedLength, decoderId);
 }
 
-void TightDecoder::readCompressedData(RfbInputGate *input,
-                                      vector<UINT8> &buffer,
-                                      size_t expectedLength,
-                                      const int decoderId)
+const UINT8 *TightDecoder::readCompressedData(RfbInputGate *input,
+                                              size_t expectedLength,
+                                              const int decoderId)
 {
   size_t rawDataLength = readCompactSize(input);
+  if (rawDataLength == 0) {
+    throw Exception(_T("Error in protocol: empty compressed data (tight-decoder)"));
+  }
 
-  vector<char> compressed(rawDataLength);
-
-  // read compressed (raw) data behind space allocated for decompressed data
-  if (rawDataLength != 0) {
-    input->readFully(&compressed.front(), rawDataLength);
+  UINT8 *compressed = prepareBuffer(&m_compressedData, rawDataLength);
+  input->readFully(compressed, rawDataLength);
 
-    Inflater *decoder = m_inflater[decoderId];
-    decoder->setInput(&compressed.front(), rawDataLength);
-    decoder->setUnpackedSize(expectedLength);
-    decoder->inflate();
+  // The output of the decoder is used right where it is.
+  Inflater *decoder = m_inflater[decoderId];
+  decoder->setInput((const char *)compressed, rawDataLength);
+  decoder->setUnpackedSize(expectedLength);
+  decoder->inflate();
 
-    size_t size = decoder->getOutputSize();
-    const char *output = decoder->getOutput();
-    buffer.resize(size);
-    buffer.assign(output, output + size);
-  } else {
-    _ASSERT(rawDataLength != 0);
-    m_logWriter->debug(_T("Tight decoder: Length of Raw compressed data is 0"));
-    buffer.resize(0);
+  if (decoder->getOutputSize() < expectedLength) {
+    throw Exception(_T("Error in protocol: not enough compressed data (tight-decoder)"));
   }
+  return (const UINT8 *)decoder->getOutput();
 }
 
 void TightDecoder::drawPalette(FrameBuffer *fb,
-                               const vector<UINT32> &palette,
-                               const vector<UINT8> &pixels,
+                               int paletteSize,
+                               const UINT8 *pixels,
                                const Rect *dstRect)
 {
-  // TODO: removed duplicate code (draw Tight bytes)
-  int width = dstRect->getWidth();
-  int height = dstRect->getHeight();
-
-  int bytesPerPixel = fb->getBytesPerPixel();
-
-  int dstLength = dstRect->area();
-
-  int x = dstRect->left;
-  int y = dstRect->top;
-  int stride = fb->getBytesPerRow();
-  char *basePtr = (char*)fb->getBufferPtr(x, y);
-  if (palette.size() == 2) {
-    int offset = 8;
-    int index = -1;
-    for (int i = 0; i < dstLength; i++) {
-      void *pixelPtr = basePtr + bytesPerPixel * (i % width) + stride * (i / width);
-      if (offset == 0 || i % width == 0) {
-        offset = 8;
-        index++;
-      }
-      offset--;
-      memcpy(pixelPtr, &palette[(pixels[index] >> offset) & 0x01], bytesPerPixel);
+  const int width = dstRect->getWidth();
+  const int height = dstRect->getHeight();
+  const int bytesPerPixel = fb->getBytesPerPixel();
+  const int stride = fb->getBytesPerRow();
+  UINT8 *dstRow = (UINT8 *)fb->getBufferPtr(dstRect->left, dstRect->top);
+
+  if (paletteSize == 2) {
+    // Each row of the bitmap is padded to the byte boundary.
+    for (int y = 0; y < height; y++, dstRow += stride) {
+      PixelUnpacker::expandIndexes(pixels, 1, m_palette, dstRow, width,
+                                   bytesPerPixel);
+      pixels += (width + 7) / 8;
     }
   } else { // size of palette != 2
-    for (int i = 0; i < dstLength; i++) {
-      void *pixelPtr = basePtr + bytesPerPixel * (i % width) + stride * (i / width);
-      if (pixels[i] < palette.size()) {
-        memcpy(pixelPtr, &palette[pixels[i]], bytesPerPixel);
-      } else {
-        m_logWriter->error(_T("Tight decoder: Invalid index in palette."));
+    for (int y = 0; y < height; y++, dstRow += stride) {
+      UINT8 *dst = dstRow;
+      for (int x = 0; x < width; x++, dst += bytesPerPixel) {
+        UINT8 index = *pixels++;
+        if (index < paletteSize) {
+          memcpy(dst, &m_palette[index], bytesPerPixel);
+        } else {
+          m_logWriter->error(_T("Tight decoder: Invalid index in palette."));
+        }
       }
     }
   }
 }
 
 void TightDecoder::drawTightBytes(FrameBuffer *fb,
-                                  const vector<UINT8> *pixels,
+                                  const UINT8 *pixels,
                                   const Rect *dstRect)
 {
-  // TODO: removed duplicate code (zrle)
-  int width = dstRect->getWidth();
-  int height = dstRect->getHeight();
+  const int width = dstRect->getWidth();
+  const int height = dstRect->getHeight();
+  const int bytesPerPixel = fb->getBytesPerPixel();
+  const int stride = fb->getBytesPerRow();
+  UINT8 *dstRow = (UINT8 *)fb->getBufferPtr(dstRect->left, dstRect->top);
 
-  int bytesPerPixel = fb->getBytesPerPixel();
-
-  int dstLength = dstRect->area();
+  if (!m_isCPixel) {
+    const size_t rowLength = width * bytesPerPixel;
+    for (int y = 0; y < height; y++, dstRow += stride) {
+      memcpy(dstRow, pixels, rowLength);
+      pixels += rowLength;
+    }
+    return;
+  }
 
-  int x = dstRect->left;
-  int y = dstRect->top;
-  for (int i = 0; i < dstLength; i++) {
-    void *pixelPtr = fb->getBufferPtr(x + i % width, y + i / width);
-    memcpy(pixelPtr, &pixels->operator [](i * bytesPerPixel), bytesPerPixel);
+  // CPixels are the red, green and blue bytes of 32-bit pixels.
+  for (int y = 0; y < height; y++, dstRow += stride, pixels += width * 3) {
+    PixelUnpacker::expandCPixels(pixels, (UINT32 *)dstRow, width,
+                                 PixelUnpacker::CPIXEL_RGB);
   }
 }
 
 void TightDecoder::drawJpegBytes(FrameBuffer *fb,
-                                 const vector<UINT8> *pixels,
+                                 const UINT8 *pixels,
                                  const Rect *dstRect)
 {
-  // TODO: removed duplicate code (draw tight bytes)
-  int width = dstRect->getWidth();
-  int height = dstRect->getHeight();
-
-  int fbBytesPerPixel = fb->getBytesPerPixel();
-  int bytesPerCPixel = 3;
+  const int width = dstRect->getWidth();
+  const int height = dstRect->getHeight();
+  const int fbBytesPerPixel = fb->getBytesPerPixel();
+  const int stride = fb->getBytesPerRow();
   PixelFormat pxFormat = fb->getPixelFormat();
-
-  int dstLength = dstRect->area();
-
-  int x = dstRect->left;
-  int y = dstRect->top;
-  for (int i = 0; i < dstLength; i++) {
-    UINT8 color[4] = {0, 0, 0, 0};
-    memcpy(&color, &pixels->operator [](i * bytesPerCPixel), bytesPerCPixel);
-    UINT32 pixel = (((UINT32)color[0] * pxFormat.redMax + 127) / 255 << pxFormat.redShift | 
-                   ((UINT32)color[1] * pxFormat.greenMax + 127) / 255 << pxFormat.greenShift |
-                   ((UINT32)color[2] * pxFormat.blueMax + 127) / 255 << pxFormat.blueShift);
-
-    void *pixelPtr = fb->getBufferPtr(x + i % width, y + i / width);
-    memcpy(pixelPtr, &pixel, fbBytesPerPixel);
+  UINT8 *dstRow = (UINT8 *)fb->getBufferPtr(dstRect->left, dstRect->top);
+
+  for (int y = 0; y < height; y++, dstRow += stride) {
+    UINT8 *dst = dstRow;
+    for (int x = 0; x < width; x++, pixels += 3, dst += fbBytesPerPixel) {
+      UINT32 pixel = (((UINT32)pixels[0] * pxFormat.redMax + 127) / 255 << pxFormat.redShift |
+                     ((UINT32)pixels[1] * pxFormat.greenMax + 127) / 255 << pxFormat.greenShift |
+                     ((UINT32)pixels[2] * pxFormat.blueMax + 127) / 255 << pxFormat.blueShift);
+      memcpy(dst, &pixel, fbBytesPerPixel);
+    }
   }
 }
 
@@ -401,76 +417,81 @@ void TightDecoder::drawJpegBytes(FrameBuffer *fb,
  */
 
 void TightDecoder::drawGradient(FrameBuffer *fb,
-                                const vector<UINT8> &pixels,
+                                const UINT8 *pixels,
                                 const Rect *dstRect)
 {
-  typedef vector<UINT16> RowType;
-  size_t opRowLength = dstRect->getWidth() * 3 + 3;
-
-  vector<RowType> opRows(2);
-  opRows[0].resize(opRowLength);
-  opRows[1].resize(opRowLength);
+  const int width = dstRect->getWidth();
+  const int height = dstRect->getHeight();
+  if (width <= 0 || height <= 0) {
+    return;
+  }
 
-  memset(&opRows[0].front(), 0, opRowLength * sizeof(UINT16));
-  memset(&opRows[1].front(), 0, opRowLength * sizeof(UINT16));
-  
   PixelFormat pxFormat = fb->getPixelFormat();
-  int fbBytesPerPixel = fb->getBytesPerPixel();
-  int bytesPerCPixel = fbBytesPerPixel;
-  if (m_isCPixel) {
-    bytesPerCPixel = 3;
+  const int stride = fb->getBytesPerRow();
+  UINT8 *dstRow = (UINT8 *)fb->getBufferPtr(dstRect->left, dstRect->top);
+
+  // With the components in separate bytes, the prediction can be made for
+  // the bytes of the pixels each on its own, the upper row is taken from
+  // the frame buffer.
+  const UINT32 componentBytes = 1 << 16 | 1 << 8 | 1;
+  if (m_isCPixel &&
+      (1 << pxFormat.redShift | 1 << pxFormat.greenShift |
+       1 << pxFormat.blueShift) == componentBytes) {
+    const UINT32 *upperRow = 0;
+    for (int i = 0; i < height; i++, dstRow += stride, pixels += width * 3) {
+      PixelUnpacker::decodeGradientRow(pixels, upperRow, (UINT32 *)dstRow,
+                                       width);
+      upperRow = (const UINT32 *)dstRow;
+    }
+    return;
   }
 
-  int opRowIndex = 0;
-  UINT16 max[3] = {pxFormat.redMax, pxFormat.greenMax, pxFormat.blueMax};
-  UINT16 shift[3] = {pxFormat.redShift, pxFormat.greenShift, pxFormat.blueShift};
-  size_t pixelOffset = 0;
+  const int fbBytesPerPixel = fb->getBytesPerPixel();
+  const int bytesPerCPixel = m_isCPixel ? 3 : fbBytesPerPixel;
+  const int max[3] = {pxFormat.redMax, pxFormat.greenMax, pxFormat.blueMax};
+  const int shift[3] = {pxFormat.redShift, pxFormat.greenShift, pxFormat.blueShift};
 
-  for (int i = 0; i < dstRect->getHeight(); ++i) {
-    // exchange thisRow and prevRow:
-    RowType &thisRow = opRows[opRowIndex];
-    RowType &prevRow = opRows[opRowIndex = (opRowIndex + 1) % 2];
+  // The components of the previous and the current rows, each preceded by
+  // a zero pixel, so that the first column needs no special care.
+  const size_t rowLength = (width + 1) * 3;
+  if (m_gradientRows.capacity() < rowLength * 2) {
+    m_bufferGrowthCount++;
+  }
+  m_gradientRows.assign(rowLength * 2, 0);
+  int *prevRow = &m_gradientRows[0];
+  int *thisRow = &m_gradientRows[rowLength];
+
+  const UINT8 *src = pixels;
+
+  for (int i = 0; i < height; i++) {
+    UINT8 *dst = dstRow;
+    for (int j = 3; j < (int)rowLength; j += 3) {
+      UINT32 rawColor = 0;
+      if (m_isCPixel) {
+        rawColor = src[0] << 16 | src[1] << 8 | src[2];
+      } else {
+        memcpy(&rawColor, src, bytesPerCPixel);
+      }
+      src += bytesPerCPixel;
 
-    for (size_t j = 3; j < opRowLength; j += 3, pixelOffset += bytesPerCPixel) {
-      UINT8 rawColor[3];
-      fillRawComponents(&pxFormat, rawColor, pixels, pixelOffset);
       UINT32 color = 0;
       for (int index = 0; index < 3; index++) {
-        INT32 d = prevRow[j + index] +      // "upper" pixel (from prev row)
-                  thisRow[j + index - 3] -  // prev pixel
-                  prevRow[j + index - 3];   // "diagonal" prev pixel
-        UINT16 converted = d < 0 ? 0 : d > max[index] ? max[index] : d;
-        thisRow[j + index] = (converted + rawColor[index]) & max[index];
-        color |= (thisRow[j + index] & max[index]) << shift[index];
+        int d = prevRow[j + index] +      // "upper" pixel (from prev row)
+                thisRow[j + index - 3] -  // prev pixel
+                prevRow[j + index - 3];   // "diagonal" prev pixel
+        int converted = d < 0 ? 0 : d > max[index] ? max[index] : d;
+        int value = (converted + (rawColor >> shift[index] & max[index])) &
+                    max[index];
+        thisRow[j + index] = value;
+        color |= (UINT32)value << shift[index];
       }
-      void *pixelPtr = fb->getBufferPtr(static_cast<int>(dstRect->left + j/3 - 1),
-                                        dstRect->top + i);
-      memcpy(pixelPtr, &color, fbBytesPerPixel);
+      memcpy(dst, &color, fbBytesPerPixel);
+      dst += fbBytesPerPixel;
     }
+    // exchange thisRow and prevRow:
+    int *swap = prevRow;
+    prevRow = thisRow;
+    thisRow = swap;
+    dstRow += stride;
   }
 }
-
-UINT32 TightDecoder::getRawTightColor(const PixelFormat *pxFormat,
-                                      const vector<UINT8> &pixels,
-                                      const size_t offset)
-{
-  if (m_isCPixel) {
-    return pixels[offset] << 16 |
-           pixels[offset + 1] << 8 |
-           pixels[offset + 2];
-  }
-  UINT32 rawColor = 0;
-  memcpy(&rawColor, &pixels[offset], pxFormat->bitsPerPixel / 8);
-  return rawColor;
-}
-
-void TightDecoder::fillRawComponents(const PixelFormat *pxFormat,
-                                     UINT8 components[],
-                                     const vector<UINT8> &pixels,
-                                     const size_t pixelOffset)
-{
-  int rawColor = getRawTightColor(pxFormat, pixels, pixelOffset);
-  components[0] = rawColor >> pxFormat->redShift & pxFormat->redMax;
-  components[1] = rawColor >> pxFormat->greenShift & pxFormat->greenMax;
-  components[2] = rawColor >> pxFormat->blueShift & pxFormat->blueMax;
-}
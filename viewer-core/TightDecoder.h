@@ -31,6 +31,7 @@
 
 #include "DecoderOfRectangle.h"
 #include "JpegDecompressor.h"
+#include "WicJpegDecompressor.h"
 
 class TightDecoder : public DecoderOfRectangle
 {
@@ -38,6 +39,12 @@ public:
   TightDecoder(LogWriter *logWriter);
   virtual ~TightDecoder();
 
+  // Return the number of times the scratch buffers had to grow. The
+  // buffers never shrink, so once the largest rectangles of a session have
+  // been seen, the number stays the same: decoding in the steady state
+  // allocates no memory. Resetting a zlib stream does not allocate either.
+  unsigned int getBufferGrowthCount() const;
+
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
@@ -48,51 +55,63 @@ private:
   void resetDecoders(UINT8 compControl);
   UINT32 readTightPixel(RfbInputGate *input, int bytesPerCPixel);
   int readCompactSize(RfbInputGate *input);
-  vector<UINT32> readPalette(RfbInputGate *input,
-                          int paletteSize,
-                          int bytesPerCPixel);
+  // Reads paletteSize colors into m_palette.
+  void readPalette(RfbInputGate *input,
+                   int paletteSize,
+                   int bytesPerCPixel);
   void processJpeg(RfbInputGate *input,
                    FrameBuffer *frameBuffer,
                    const Rect *dstRect);
+  // Decompress the JPEG data of a big rectangle with the system codec.
+  // Return false if it fails, then libjpeg must be used.
+  bool processWicJpeg(FrameBuffer *frameBuffer,
+                      size_t jpegBufLen,
+                      const Rect *dstRect);
   void processBasicTypes(RfbInputGate *input,
                          FrameBuffer *frameBuffer,
                          const Rect *dstRect,
                          UINT8 compControl);
-  void readTightData(RfbInputGate *input,
-                     vector<UINT8> &buffer,
-                     size_t expectedLength,
-                     const int decoderId);
-  void readCompressedData(RfbInputGate *input,
-                          vector<UINT8> &buffer,
-                          size_t expectedLength,
-                          const int decoderId);
+  // Return expectedLength bytes of data, read as is or decompressed with
+  // the zlib stream decoderId. The data is valid until the next call.
+  const UINT8 *readTightData(RfbInputGate *input,
+                             size_t expectedLength,
+                             const int decoderId);
+  const UINT8 *readCompressedData(RfbInputGate *input,
+                                  size_t expectedLength,
+                                  const int decoderId);
+  // The functions below draw right into the frame buffer, row by row.
   void drawPalette(FrameBuffer *fb,
-                   const vector<UINT32> &palette,
-                   const vector<UINT8> &pixels,
+                   int paletteSize,
+                   const UINT8 *pixels,
                    const Rect *dstRect);
   void drawGradient(FrameBuffer *fb,
-                    const vector<UINT8> &pixels,
+                    const UINT8 *pixels,
                     const Rect *dstRect);
   void drawTightBytes(FrameBuffer *fb,
-                     const vector<UINT8> *pixels,
-                     const Rect *dstRect);
+                      const UINT8 *pixels,
+                      const Rect *dstRect);
   void drawJpegBytes(FrameBuffer *fb,
-                     const vector<UINT8> *pixels,
+                     const UINT8 *pixels,
                      const Rect *dstRect);
 
-  UINT32 getRawTightColor(const PixelFormat *pxFormat,
-                          const vector<UINT8> &pixels,
-                          size_t offset);
-  void fillRawComponents(const PixelFormat *pxFormat,
-                         UINT8 components[],
-                         const vector<UINT8> &pixels,
-                         size_t pixelOffset);
+  // Resize a scratch buffer, counting the cases when it has to grow.
+  UINT8 *prepareBuffer(vector<UINT8> *buffer, size_t size);
+
+  // Scratch buffers, kept between rectangles: data read as is, compressed
+  // data, JPEG data, pixels decompressed from JPEG and the color
+  // components of two rows for the gradient filter.
+  vector<UINT8> m_rawData;
+  vector<UINT8> m_compressedData;
+  vector<UINT8> m_jpegData;
+  vector<UINT8> m_jpegPixels;
+  vector<int> m_gradientRows;
+  unsigned int m_bufferGrowthCount;
 
-  UINT32 transformPixelToTight(UINT32 color);
-  vector<UINT8> TightDecoder::transformArray(const vector<UINT8> &buffer);
+  UINT32 m_palette[256];
 
   vector<Inflater *> m_inflater;
   JpegDecompressor m_jpeg;
+  WicJpegDecompressor m_wicJpeg;
 
   bool m_isCPixel;
 private:
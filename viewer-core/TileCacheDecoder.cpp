@@ -0,0 +1,112 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TileCacheDecoder.h"
+
+TileCacheDecoder::TileCacheDecoder(LogWriter *logWriter)
+: DecoderOfRectangle(logWriter),
+  m_slots(NUM_SLOTS, (FrameBuffer *)0),
+  m_operation(OP_HIT),
+  m_slot(0)
+{
+  m_encoding = EncodingDefs::TILE_CACHE;
+}
+
+TileCacheDecoder::~TileCacheDecoder()
+{
+  clearSlots();
+}
+
+void TileCacheDecoder::clearSlots()
+{
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    if (m_slots[i] != 0) {
+      delete m_slots[i];
+      m_slots[i] = 0;
+    }
+  }
+}
+
+void TileCacheDecoder::decode(RfbInputGate *input,
+                              FrameBuffer *frameBuffer,
+                              const Rect *dstRect)
+{
+  UINT8 operation = input->readUInt8();
+  m_slot = input->readUInt16();
+
+  if ((operation & RESET_CACHE) != 0) {
+    clearSlots();
+  }
+  m_operation = operation & ~RESET_CACHE;
+
+  if (m_operation != OP_HIT && m_operation != OP_STORE) {
+    throw Exception(_T("Error in protocol: unknown operation %d (tile-cache-decoder)"),
+                    (int)m_operation);
+  }
+  if (m_slot >= NUM_SLOTS ||
+      dstRect->getWidth() != TILE_SIZE || dstRect->getHeight() != TILE_SIZE) {
+    throw Exception(_T("Error in protocol: incorrect tile (tile-cache-decoder)"));
+  }
+  if (m_operation == OP_HIT && m_slots[m_slot] == 0) {
+    throw Exception(_T("Error in protocol: empty slot %d (tile-cache-decoder)"),
+                    (int)m_slot);
+  }
+}
+
+void TileCacheDecoder::copy(FrameBuffer *dstFrameBuffer,
+                            const FrameBuffer *srcFrameBuffer,
+                            const Rect *rect,
+                            LocalMutex *fbLock)
+{
+  AutoLock al(fbLock);
+  Rect tileRect(TILE_SIZE, TILE_SIZE);
+  if (m_operation == OP_STORE) {
+    if (m_slots[m_slot] == 0) {
+      m_slots[m_slot] = new FrameBuffer;
+    }
+    FrameBuffer *slot = m_slots[m_slot];
+    Dimension tileDim(TILE_SIZE, TILE_SIZE);
+    PixelFormat pf = dstFrameBuffer->getPixelFormat();
+    if (!slot->getPixelFormat().isEqualTo(&pf) ||
+        !slot->getDimension().isEqualTo(&tileDim)) {
+      slot->setProperties(&tileDim, &pf);
+    }
+    slot->copyFrom(&tileRect, dstFrameBuffer, rect->left, rect->top);
+  } else {
+    // Pixels of another format would be garbage, the server starts a new
+    // cache after the pixel format change, so this is not expected.
+    if (!dstFrameBuffer->copyFrom(rect, m_slots[m_slot], 0, 0)) {
+      m_logWriter->error(_T("Tile cache slot %d has incompatible pixel format"),
+                         (int)m_slot);
+    }
+  }
+}
+
+void TileCacheDecoder::notify(FbUpdateNotifier *fbNotifier,
+                              const Rect *rect)
+{
+  if (m_operation == OP_HIT) {
+    DecoderOfRectangle::notify(fbNotifier, rect);
+  }
+}
@@ -0,0 +1,86 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _TILE_CACHE_DECODER_H_
+#define _TILE_CACHE_DECODER_H_
+
+#include "DecoderOfRectangle.h"
+
+#include <vector>
+
+//
+// TileCacheDecoder decodes rectangles of the tile cache encoding. It keeps
+// NUM_SLOTS tiles the server asks to store, and copies them back to the
+// frame buffer when the server refers to them. The server decides which
+// slot to replace, so the slots work as the least recently used cache
+// maintained by the server.
+//
+
+class TileCacheDecoder : public DecoderOfRectangle
+{
+public:
+  TileCacheDecoder(LogWriter *logWriter);
+  virtual ~TileCacheDecoder();
+
+protected:
+  //
+  // This method inherited by DecoderOfRectangle.
+  //
+  virtual void decode(RfbInputGate *input,
+                      FrameBuffer *frameBuffer,
+                      const Rect *dstRect);
+
+  //
+  // Copies the slot to the frame buffer, or the frame buffer to the slot.
+  //
+  virtual void copy(FrameBuffer *dstFrameBuffer,
+                    const FrameBuffer *srcFrameBuffer,
+                    const Rect *rect,
+                    LocalMutex *fbLock);
+
+  //
+  // Storing a tile does not change the frame buffer, so there is nothing to
+  // notify about.
+  //
+  virtual void notify(FbUpdateNotifier *fbNotifier,
+                      const Rect *rect);
+
+  void clearSlots();
+
+  static const int TILE_SIZE = 64;
+  static const int NUM_SLOTS = 1024;
+
+  static const UINT8 OP_HIT = 0;
+  static const UINT8 OP_STORE = 1;
+  static const UINT8 RESET_CACHE = 0x80;
+
+  // Slots with tiles, allocated on the first use.
+  std::vector<FrameBuffer *> m_slots;
+
+  // The operation of the current rectangle.
+  UINT8 m_operation;
+  UINT16 m_slot;
+};
+
+#endif
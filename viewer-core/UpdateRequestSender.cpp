@@ -1,11 +1,17 @@
 ﻿#include "UpdateRequestSender.h"
 #include <thread/AutoLock.h>
+#include "RfbEnableContinuousUpdatesClientMessage.h"
 #include "RfbFramebufferUpdateRequestClientMessage.h"
 
 UpdateRequestSender::UpdateRequestSender(Lockable* m_fb_lock, FrameBuffer* m_frame_buffer, LogWriter* m_log_writer):
-	m_wasUpdateRecieved(false),
+	m_requestsInFlight(0),
+	m_pipelineDepth(DEFAULT_PIPELINE_DEPTH),
 	m_timeOut(0),
 	m_isIncrimental(true),
+	m_isPaused(true),
+	m_isContinuousSupported(false),
+	m_isContinuousEnabled(false),
+	m_isWaitingContinuousEnd(false),
     m_fbLock(m_fb_lock),
     m_frameBuffer(m_frame_buffer),
     m_logWriter(m_log_writer),
@@ -28,20 +34,41 @@ UpdateRequestSender::~UpdateRequestSender()
 
 void UpdateRequestSender::setWasUpdated()
 {
-	AutoLock al(&m_wasUpdatedLock);
-	m_wasUpdateRecieved = true;
+	{
+		AutoLock al(&m_stateLock);
+		if (m_requestsInFlight > 0)
+		{
+			m_requestsInFlight--;
+		}
+	}
+	m_stateChanged.notify();
 }
 
 void UpdateRequestSender::setTimeout(int miliseconds)
 {
-	AutoLock al(&m_timeOutLock);
-	m_timeOut = miliseconds;
+	{
+		AutoLock al(&m_stateLock);
+		m_timeOut = miliseconds;
+	}
+	m_stateChanged.notify();
 }
 
 void UpdateRequestSender::setIsIncremental(bool isIncremental)
 {
-	AutoLock al(&m_isIncrimentalLock);
-	m_isIncrimental = isIncremental;
+	{
+		AutoLock al(&m_stateLock);
+		m_isIncrimental = isIncremental;
+	}
+	m_stateChanged.notify();
+}
+
+void UpdateRequestSender::setPipelineDepth(int depth)
+{
+	{
+		AutoLock al(&m_stateLock);
+		m_pipelineDepth = depth > 0 ? depth : 1;
+	}
+	m_stateChanged.notify();
 }
 
 void UpdateRequestSender::setOutput(RfbOutputGate* output)
@@ -56,21 +83,58 @@ void UpdateRequestSender::setOutput(RfbOutputGate* output)
 	m_logWriter->debug(_T("UpdateRequestServer is started"));
 }
 
+void UpdateRequestSender::setPaused(bool isPaused)
+{
+	{
+		AutoLock al(&m_stateLock);
+		m_isPaused = isPaused;
+		// Disable continuous updates right now, so that the caller may rely
+		// on getRequestsInFlight().
+		if (isPaused && m_isContinuousEnabled)
+		{
+			Rect fbRect = getFbRect();
+			sendEnableContinuousUpdates(false, &fbRect);
+			m_isContinuousEnabled = false;
+			m_isWaitingContinuousEnd = true;
+		}
+	}
+	m_stateChanged.notify();
+}
+
+int UpdateRequestSender::getRequestsInFlight()
+{
+	AutoLock al(&m_stateLock);
+	return m_requestsInFlight + (m_isWaitingContinuousEnd ? 1 : 0);
+}
+
+void UpdateRequestSender::sendFullUpdateRequest()
+{
+	AutoLock al(&m_stateLock);
+	sendFbUpdateRequest(false);
+}
+
+void UpdateRequestSender::onEndOfContinuousUpdates()
+{
+	{
+		AutoLock al(&m_stateLock);
+		if (!m_isContinuousSupported)
+		{
+			m_logWriter->info(_T("Server supports continuous updates"));
+			m_isContinuousSupported = true;
+		}
+		m_isWaitingContinuousEnd = false;
+	}
+	m_stateChanged.notify();
+}
+
 void UpdateRequestSender::execute()
 {
 	try
 	{
 		while(!isTerminating())
 		{
-			if (isUpdated())
-			{
-				sendFbUpdateRequest();
-			}
-
-			int timeout = getTimeout();
-			timeout = timeout > 0 ? timeout : 500;
-			//todo: check if it is best approoach?
-			Thread::sleep(timeout);
+			DWORD waitTime = sendRequests();
+			m_stateChanged.waitForEvent(waitTime);
 		}
 	}
 	catch(const Exception &ex)
@@ -83,20 +147,66 @@ void UpdateRequestSender::execute()
 	}
 }
 
-void UpdateRequestSender::sendFbUpdateRequest()
+void UpdateRequestSender::onTerminate()
 {
-	RfbOutputGate* output = getOutput();
+	m_stateChanged.notify();
+}
 
-	if(output == 0)
-		return;
+DWORD UpdateRequestSender::sendRequests()
+{
+	if (getOutput() == 0)
+		return INFINITE;
+
+	AutoLock al(&m_stateLock);
+
+	bool useContinuous = m_isContinuousSupported && !m_isPaused &&
+	                     m_isIncrimental && m_timeOut <= 0;
+	Rect fbRect = getFbRect();
+	if (useContinuous && !m_isWaitingContinuousEnd)
+	{
+		// The area is refreshed on every wake-up, as the desktop may
+		// be resized.
+		if (!m_isContinuousEnabled || !m_continuousRect.isEqualTo(&fbRect))
+		{
+			sendEnableContinuousUpdates(true, &fbRect);
+			m_isContinuousEnabled = true;
+			m_continuousRect = fbRect;
+		}
+		return INFINITE;
+	}
+	if (m_isContinuousEnabled)
+	{
+		sendEnableContinuousUpdates(false, &fbRect);
+		m_isContinuousEnabled = false;
+		m_isWaitingContinuousEnd = true;
+	}
+	if (m_isPaused || m_isWaitingContinuousEnd)
+		return INFINITE;
 
-	Rect updateRect;
+	int pipelineDepth = m_timeOut > 0 ? 1 : m_pipelineDepth;
+	while (m_requestsInFlight < pipelineDepth)
 	{
-		AutoLock al(m_fbLock);
-		updateRect = m_frameBuffer->getDimension().getRect();
+		if (m_timeOut > 0)
+		{
+			UINT64 elapsed = (DateTime::now() - m_lastRequestTime).getTime();
+			if (elapsed < (UINT64)m_timeOut)
+			{
+				return (DWORD)(m_timeOut - elapsed);
+			}
+		}
+		sendFbUpdateRequest(m_isIncrimental);
 	}
+	return INFINITE;
+}
+
+void UpdateRequestSender::sendFbUpdateRequest(bool isIncremental)
+{
+	RfbOutputGate* output = getOutput();
+
+	if(output == 0)
+		return;
 
-	bool isIncremental = this->isIncremental();
+	Rect updateRect = getFbRect();
 
 	if (isIncremental)
 	{
@@ -110,28 +220,31 @@ void UpdateRequestSender::sendFbUpdateRequest()
 	}
 
 	RfbFramebufferUpdateRequestClientMessage fbUpdReq(isIncremental, updateRect);
-	fbUpdReq.send(m_output);
+	fbUpdReq.send(output);
+	m_requestsInFlight++;
+	m_lastRequestTime = DateTime::now();
 	m_logWriter->debug(_T("Frame buffer update request is sent"));
 }
 
-bool UpdateRequestSender::isUpdated()
+void UpdateRequestSender::sendEnableContinuousUpdates(bool enable, const Rect *rect)
 {
-	AutoLock al(&m_wasUpdatedLock);
-	bool result = m_wasUpdateRecieved;
-	m_wasUpdateRecieved = false;
-	return result;
+	m_logWriter->debug(_T("%s continuous updates [%dx%d]"),
+	                   enable ? _T("Enabling") : _T("Disabling"),
+	                   rect->getWidth(), rect->getHeight());
+	RfbEnableContinuousUpdatesClientMessage message(enable, *rect);
+	message.send(getOutput());
 }
 
-int UpdateRequestSender::getTimeout()
+Rect UpdateRequestSender::getFbRect()
 {
-	AutoLock al(&m_timeOutLock);
-	return m_timeOut;
+	AutoLock al(m_fbLock);
+	return m_frameBuffer->getDimension().getRect();
 }
 
-bool UpdateRequestSender::isIncremental()
+int UpdateRequestSender::getTimeout()
 {
-	AutoLock al(&m_isIncrimentalLock);
-	return m_isIncrimental;
+	AutoLock al(&m_stateLock);
+	return m_timeOut;
 }
 
 RfbOutputGate* UpdateRequestSender::getOutput()
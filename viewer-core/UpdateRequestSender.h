@@ -2,43 +2,91 @@
 #define _UPDATE_REQUEST_SENDER_
 
 #include <thread/Thread.h>
+#include <thread/LocalMutex.h>
 #include <rfb/FrameBuffer.h>
 #include <log-writer/LogWriter.h>
 #include <network/RfbOutputGate.h>
-
+#include <util/DateTime.h>
+#include <win-system/WindowsEvent.h>
+
+//
+// Schedules the framebuffer update requests of the viewer.
+//
+// The sender keeps a number of incremental requests in flight and sends the
+// next one as soon as an update is decoded, so the server always has
+// a pending request when the screen changes. If the server supports the
+// continuous updates extension, the requests are not sent at all: the server
+// is asked to send updates of the whole framebuffer on itself.
+//
 class UpdateRequestSender : public Thread
 {
 public:
+	static const int DEFAULT_PIPELINE_DEPTH = 2;
+
 	UpdateRequestSender(Lockable* m_fb_lock, FrameBuffer* m_frame_buffer, LogWriter* m_log_writer);
 
 	~UpdateRequestSender();
 
+	// Called when an update is decoded. Frees a place for the next request.
 	void setWasUpdated();
+
+	// Sets the minimal interval between requests. If it is positive, only one
+	// request is kept in flight and continuous updates are not used.
 	void setTimeout(int miliseconds);
 	void setIsIncremental(bool isIncremental);
+	// Sets the number of requests kept in flight.
+	void setPipelineDepth(int depth);
 	void setOutput(RfbOutputGate* output);
 
+	// Stops sending of requests and disables continuous updates, e.g. when
+	// the viewer is frozen or the pixel format is to be changed. The sender
+	// is paused until the first update request of the protocol.
+	void setPaused(bool isPaused);
+
+	// Returns the number of requests sent but not answered yet. Disabled but
+	// not confirmed continuous updates count as one.
+	int getRequestsInFlight();
+
+	// Sends a non-incremental request from the calling thread.
+	void sendFullUpdateRequest();
+
+	// Must be called on the EndOfContinuousUpdates server message, which is
+	// sent the first time to tell that the server supports the extension and
+	// later to confirm that continuous updates are disabled.
+	void onEndOfContinuousUpdates();
+
 	int getTimeout();
 
 protected:
 	virtual void execute() override;
-
+	virtual void onTerminate() override;
 
 private:
-	void sendFbUpdateRequest();
+	// Sends as many requests as the pipeline allows. Returns the time to wait,
+	// in milliseconds, before the next request may be sent.
+	DWORD sendRequests();
+	void sendFbUpdateRequest(bool isIncremental);
+	void sendEnableContinuousUpdates(bool enable, const Rect *rect);
 
-	bool isUpdated();
-	bool isIncremental();
+	Rect getFbRect();
 	RfbOutputGate* getOutput();
 
-	bool m_wasUpdateRecieved;
-	LocalMutex m_wasUpdatedLock;
+	// Protects all the scheduling state below.
+	LocalMutex m_stateLock;
 
+	int m_requestsInFlight;
+	int m_pipelineDepth;
 	int m_timeOut;
-	LocalMutex m_timeOutLock;
-
 	bool m_isIncrimental;
-	LocalMutex m_isIncrimentalLock;
+	bool m_isPaused;
+	DateTime m_lastRequestTime;
+
+	bool m_isContinuousSupported;
+	bool m_isContinuousEnabled;
+	bool m_isWaitingContinuousEnd;
+	Rect m_continuousRect;
+
+	WindowsEvent m_stateChanged;
 
 	Lockable *m_fbLock;
 	FrameBuffer *m_frameBuffer;
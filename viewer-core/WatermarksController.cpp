@@ -58,6 +58,7 @@ void WatermarksController::setNewPixelFormat(const PixelFormat *pf)
 	{
 		FrameBuffer temp;
 		FrameBuffer& fb = frameBuffer(true);
+		m_image.clone(&fb);
 
 		m_overlay.setPixelFormat(pf);
 
@@ -94,6 +95,11 @@ const Rect WatermarksController::CurrentRect()
 	return m_currentRect;
 }
 
+const FrameBuffer *WatermarksController::getImage()
+{
+	return m_image.getBuffer() != 0 ? &m_image : 0;
+}
+
 FrameBuffer& WatermarksController::frameBuffer(bool fromFile)
 {
 	if (m_frameBuffer.getBuffer() == 0 || fromFile)
@@ -48,6 +48,10 @@ public:
 
 	const Rect CurrentRect();
 
+	// Returns the watermark in its original 32-bit format, or 0 if the
+	// frame buffer properties have not been set yet.
+	const FrameBuffer *getImage();
+
 private:
 	Rect m_currentRect;
 	Rect m_currentFrameBufferRect;
@@ -64,6 +68,10 @@ private:
 
 	FrameBuffer m_overlay;
 
+	// Unconverted copy of the watermark, for applications composing it on
+	// their own.
+	FrameBuffer m_image;
+
 	int m_height;
 	int m_width;
 };
@@ -0,0 +1,201 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "WicJpegDecompressor.h"
+
+// Only the identifiers are taken from the library, the codec itself is
+// created through COM.
+#pragma comment(lib, "windowscodecs.lib")
+
+WicJpegDecompressor::WicJpegDecompressor()
+: m_coDecrementMTAUsage(0),
+  m_mtaCookie(0),
+  m_factory(0),
+  m_isInitialized(false),
+  m_failures(0)
+{
+}
+
+WicJpegDecompressor::~WicJpegDecompressor()
+{
+  if (m_factory != 0) {
+    m_factory->Release();
+  }
+  if (m_coDecrementMTAUsage != 0) {
+    m_coDecrementMTAUsage(m_mtaCookie);
+  }
+}
+
+void WicJpegDecompressor::init()
+{
+  m_isInitialized = true;
+  m_failures = MAX_FAILURES;
+  try {
+    m_ole32Lib.init(_T("ole32.dll"));
+  } catch (...) {
+    return;
+  }
+  CoIncrementMTAUsageFunType coIncrementMTAUsage = (CoIncrementMTAUsageFunType)
+    m_ole32Lib.getProcAddress("CoIncrementMTAUsage");
+  CoDecrementMTAUsageFunType coDecrementMTAUsage = (CoDecrementMTAUsageFunType)
+    m_ole32Lib.getProcAddress("CoDecrementMTAUsage");
+  if (coIncrementMTAUsage == 0 || coDecrementMTAUsage == 0 ||
+      FAILED(coIncrementMTAUsage(&m_mtaCookie))) {
+    return;
+  }
+  m_coDecrementMTAUsage = coDecrementMTAUsage;
+
+  HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, 0,
+                                CLSCTX_INPROC_SERVER,
+                                __uuidof(IWICImagingFactory),
+                                (void **)&m_factory);
+  if (FAILED(hr)) {
+    m_factory = 0;
+    return;
+  }
+  m_failures = 0;
+}
+
+bool WicJpegDecompressor::isSuitable(const Rect *dstRect)
+{
+  if (dstRect->area() < MIN_AREA) {
+    return false;
+  }
+  if (!m_isInitialized) {
+    init();
+  }
+  return m_failures < MAX_FAILURES;
+}
+
+bool WicJpegDecompressor::canDecompressTo(const PixelFormat *pf)
+{
+  return pf->bitsPerPixel == 32 && !pf->bigEndian &&
+         pf->redMax == 255 && pf->greenMax == 255 && pf->blueMax == 255 &&
+         pf->redShift == 16 && pf->greenShift == 8 && pf->blueShift == 0;
+}
+
+bool WicJpegDecompressor::decompress(const vector<UINT8> &buffer,
+                                     size_t jpegBufLen,
+                                     FrameBuffer *fb,
+                                     const Rect *dstRect)
+{
+  PixelFormat pf = fb->getPixelFormat();
+  Rect fbRect = fb->getDimension().getRect();
+  if (!canDecompressTo(&pf) || !fbRect.isFullyContainRect(dstRect)) {
+    return false;
+  }
+  UINT8 *dstBuf = (UINT8 *)fb->getBufferPtr(dstRect->left, dstRect->top);
+  return decompressRows(buffer, jpegBufLen, dstRect,
+                        GUID_WICPixelFormat32bppBGR, dstBuf,
+                        fb->getBytesPerRow(), 4);
+}
+
+bool WicJpegDecompressor::decompress(const vector<UINT8> &buffer,
+                                     size_t jpegBufLen,
+                                     vector<UINT8> &pixels,
+                                     const Rect *dstRect)
+{
+  UINT width = dstRect->getWidth();
+  size_t pixelBufferCount = dstRect->area() * BYTES_PER_PIXEL;
+  if (pixels.size() == 0 || pixels.size() < pixelBufferCount) {
+    return false;
+  }
+  return decompressRows(buffer, jpegBufLen, dstRect,
+                        GUID_WICPixelFormat24bppRGB, &pixels.front(),
+                        width * BYTES_PER_PIXEL, BYTES_PER_PIXEL);
+}
+
+bool WicJpegDecompressor::decompressRows(const vector<UINT8> &buffer,
+                                         size_t jpegBufLen,
+                                         const Rect *dstRect,
+                                         REFWICPixelFormatGUID format,
+                                         UINT8 *dstBuf,
+                                         UINT rowStride,
+                                         UINT bytesPerPixel)
+{
+  if (m_factory == 0 || !dstRect->isValid() || dstRect->area() == 0 ||
+      buffer.size() == 0 || buffer.size() < jpegBufLen) {
+    return false;
+  }
+  UINT width = dstRect->getWidth();
+  UINT height = dstRect->getHeight();
+
+  IWICStream *stream = 0;
+  IWICBitmapDecoder *decoder = 0;
+  IWICBitmapFrameDecode *frame = 0;
+  IWICFormatConverter *converter = 0;
+
+  HRESULT hr = m_factory->CreateStream(&stream);
+  if (SUCCEEDED(hr)) {
+    hr = stream->InitializeFromMemory(const_cast<BYTE *>(&buffer.front()),
+                                      (DWORD)jpegBufLen);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = m_factory->CreateDecoderFromStream(stream, 0,
+                                            WICDecodeMetadataCacheOnDemand,
+                                            &decoder);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, &frame);
+  }
+  if (SUCCEEDED(hr)) {
+    UINT frameWidth, frameHeight;
+    hr = frame->GetSize(&frameWidth, &frameHeight);
+    if (SUCCEEDED(hr) && (frameWidth != width || frameHeight != height)) {
+      hr = E_FAIL;
+    }
+  }
+  if (SUCCEEDED(hr)) {
+    hr = m_factory->CreateFormatConverter(&converter);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(frame, format, WICBitmapDitherTypeNone, 0,
+                               0.0, WICBitmapPaletteTypeCustom);
+  }
+  if (SUCCEEDED(hr)) {
+    // The last row may end right at the end of the destination.
+    UINT bufferSize = rowStride * (height - 1) + width * bytesPerPixel;
+    hr = converter->CopyPixels(0, rowStride, bufferSize, dstBuf);
+  }
+
+  if (converter != 0) {
+    converter->Release();
+  }
+  if (frame != 0) {
+    frame->Release();
+  }
+  if (decoder != 0) {
+    decoder->Release();
+  }
+  if (stream != 0) {
+    stream->Release();
+  }
+
+  if (FAILED(hr)) {
+    m_failures++;
+    return false;
+  }
+  m_failures = 0;
+  return true;
+}
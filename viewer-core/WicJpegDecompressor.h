@@ -0,0 +1,111 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _WIC_JPEG_DECOMPRESSOR_H_
+#define _WIC_JPEG_DECOMPRESSOR_H_
+
+#include "util/CommonHeader.h"
+#include "region/Rect.h"
+#include "rfb/FrameBuffer.h"
+#include "win-system/DynamicLibrary.h"
+
+#include <wincodec.h>
+
+//
+// WicJpegDecompressor decompresses JPEG images with the codec of the
+// Windows Imaging Component, which uses the decoders installed in the
+// system, including the ones provided with the graphics drivers. It saves
+// the CPU time of libjpeg on big rectangles, for small ones the set up of
+// the codec costs more than it saves.
+//
+// The codec is only used in the multithreaded COM apartment kept alive
+// by the object (Windows 8 and later), so any thread may use it without
+// initializing COM. Elsewhere isSuitable() is always false, as well as
+// after repeated failures, and the callers must use JpegDecompressor.
+//
+class WicJpegDecompressor
+{
+public:
+  static const size_t BYTES_PER_PIXEL = 3;
+
+  // The smallest rectangle area given to the system codec.
+  static const int MIN_AREA = 128 * 128;
+
+  WicJpegDecompressor();
+  virtual ~WicJpegDecompressor();
+
+  // Returns true if the rectangle should be decompressed here. The codec
+  // is loaded on the first call.
+  bool isSuitable(const Rect *dstRect);
+
+  // Return true if the pixels of the format can be written directly, that
+  // is 32-bit pixels with blue in the lowest byte.
+  static bool canDecompressTo(const PixelFormat *pf);
+
+  // Decompress the image right into the dstRect area of the frame buffer,
+  // which pixel format is accepted by canDecompressTo().
+  // Return false on a failure.
+  bool decompress(const vector<UINT8> &buffer,
+                  size_t jpegBufLen,
+                  FrameBuffer *fb,
+                  const Rect *dstRect);
+
+  // Decompress the image to three bytes per pixel, red, green and blue, the
+  // same way as JpegDecompressor does. Return false on a failure.
+  bool decompress(const vector<UINT8> &buffer,
+                  size_t jpegBufLen,
+                  vector<UINT8> &pixels,
+                  const Rect *dstRect);
+
+private:
+  void init();
+
+  bool decompressRows(const vector<UINT8> &buffer,
+                      size_t jpegBufLen,
+                      const Rect *dstRect,
+                      REFWICPixelFormatGUID format,
+                      UINT8 *dstBuf,
+                      UINT rowStride,
+                      UINT bytesPerPixel);
+
+  // After that many failures in a row the codec is not used any more.
+  static const int MAX_FAILURES = 3;
+
+  typedef HRESULT (WINAPI *CoIncrementMTAUsageFunType)(void **);
+  typedef HRESULT (WINAPI *CoDecrementMTAUsageFunType)(void *);
+
+  DynamicLibrary m_ole32Lib;
+  CoDecrementMTAUsageFunType m_coDecrementMTAUsage;
+  void *m_mtaCookie;
+
+  IWICImagingFactory *m_factory;
+  bool m_isInitialized;
+  int m_failures;
+
+  // Do not allow copying objects.
+  WicJpegDecompressor(const WicJpegDecompressor &other);
+  WicJpegDecompressor &operator=(const WicJpegDecompressor &other);
+};
+
+#endif
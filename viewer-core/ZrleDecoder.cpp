@@ -23,6 +23,7 @@
 //
 
 #include "ZrleDecoder.h"
+#include "PixelUnpacker.h"
 
 #include "io-lib/ByteArrayInputStream.h"
 
@@ -30,9 +31,13 @@
 #include <algorithm>
 
 ZrleDecoder::ZrleDecoder(LogWriter *logWriter)
-: DecoderOfRectangle(logWriter)
+: DecoderOfRectangle(logWriter),
+  m_bytesPerPixel(0),
+  m_numberFirstByte(0),
+  m_fbBytesPerPixel(0)
 {
   m_encoding = EncodingDefs::ZRLE;
+  memset(m_palette, 0, sizeof(m_palette));
 }
 
 ZrleDecoder::~ZrleDecoder()
@@ -55,15 +60,14 @@ void ZrleDecoder::decode(RfbInputGate *input,
     return;
   }
 
-  vector<unsigned char> unpackedData;
-  unpackedData.resize(unpackedDataSize);
-  unpackedData.assign(m_inflater.getOutput(), m_inflater.getOutput() + unpackedDataSize);
-  ByteArrayInputStream unpackedByteArrayStream(reinterpret_cast<char *>(&unpackedData.front()),
-                                               unpackedData.size());
+  // The tiles are read right from the output of the inflater.
+  ByteArrayInputStream unpackedByteArrayStream(m_inflater.getOutput(),
+                                               unpackedDataSize);
   DataInputStream unpackedDataStream(&unpackedByteArrayStream);
 
   m_numberFirstByte = 0;
   PixelFormat pxFormat = frameBuffer->getPixelFormat();
+  m_fbBytesPerPixel = frameBuffer->getBytesPerPixel();
 
   if (pxFormat.bitsPerPixel == 8) {
     m_bytesPerPixel = 1;
@@ -86,6 +90,8 @@ void ZrleDecoder::decode(RfbInputGate *input,
     }
   }
 
+  m_tilePixels.resize(TILE_SIZE * TILE_SIZE * m_fbBytesPerPixel);
+
   for (int y = dstRect->top; y < dstRect->bottom; y += TILE_SIZE) {
     for (int x = dstRect->left; x < dstRect->right; x += TILE_SIZE) {
       Rect tileRect(x, y, 
@@ -100,38 +106,37 @@ void ZrleDecoder::decode(RfbInputGate *input,
       if (!frameBuffer->getDimension().getRect().intersection(&tileRect).isEqualTo(&tileRect)) {
         throw Exception(_T("Incorrect size of ZRLE tile."));
       }
-      size_t tileLength = tileRect.area();
-      size_t tileBytesLength = tileLength * m_bytesPerPixel;
-      vector<char> pixels;
-      pixels.resize(tileBytesLength);
 
       int type = readType(&unpackedDataStream);
 
       if (type == 0) {
         // raw pixel data
-        readRawTile(&unpackedDataStream, pixels, &tileRect);
+        readRawTile(&unpackedDataStream, &tileRect);
       } else if (type == 1) {
-        // a solid tile consisting of a single colour
-        readSolidTile(&unpackedDataStream, pixels, &tileRect);
+        // a solid tile consisting of a single colour, filled in place
+        frameBuffer->fillRect(&tileRect, readPixel(&unpackedDataStream));
+        continue;
       } else if (type >= 2 && type <= 16) {
         // packed palette
-        readPackedPaletteTile(&unpackedDataStream, pixels, &tileRect, type);
+        readPackedPaletteTile(&unpackedDataStream, &tileRect, type);
       } else if (type >= 17 && type <= 127) {
         // unused (no advantage over palette RLE)
-      } if (type == 128) {
+        PixelUnpacker::fill(&m_tilePixels.front(), 0, tileRect.area(),
+                            m_fbBytesPerPixel);
+      } else if (type == 128) {
         // plain rle
-        readPlainRleTile(&unpackedDataStream, pixels, &tileRect);
-      } if (type == 129) {
+        readPlainRleTile(&unpackedDataStream, &tileRect);
+      } else if (type == 129) {
         // invalid type
         StringStorage error;
         error.format(_T("Bad data received from the server: Unused ZRLE subencoding type (%d)."), type);
         throw Exception(error.getString());
-      } if (type >= 130 && type <= 255) {
+      } else {
         // palette rle
-        readPaletteRleTile(&unpackedDataStream, pixels, &tileRect, type);
+        readPaletteRleTile(&unpackedDataStream, &tileRect, type);
       }
 
-      drawTile(frameBuffer, &tileRect, &pixels);
+      drawTile(frameBuffer, &tileRect);
     } // tile(x, y)
   } // tile(..., y)
 }
@@ -139,14 +144,13 @@ void ZrleDecoder::decode(RfbInputGate *input,
 void ZrleDecoder::readAndInflate(RfbInputGate *input, size_t maximalUnpackedSize)
 {
   UINT32 length = input->readUInt32();
-  std::vector<char> zlibData;
-  zlibData.resize(length);
+  m_zlibData.resize(length);
   if (length == 0) {
-    zlibData.resize(1);
+    m_zlibData.resize(1);
   }
-  input->readFully(&zlibData.front(), length);
+  input->readFully(&m_zlibData.front(), length);
 
-  m_inflater.setInput(&zlibData.front(), length);
+  m_inflater.setInput(&m_zlibData.front(), length);
   m_inflater.setUnpackedSize(maximalUnpackedSize);
   m_inflater.inflate();
 }
@@ -176,44 +180,42 @@ size_t ZrleDecoder::readRunLength(DataInputStream *input)
   return runLength + 1; // the length is one more than the sum
 }
 
-void ZrleDecoder::readPalette(DataInputStream *input,
-                              const int paletteSize,
-                              Palette *palette)
+UINT32 ZrleDecoder::readPixel(DataInputStream *input)
 {
-  palette->resize(paletteSize);
+  // The bytes of a CPIXEL are the least or the most significant bytes of
+  // the (little-endian) pixel.
+  UINT32 pixel = 0;
+  input->readFully((UINT8 *)&pixel + m_numberFirstByte, m_bytesPerPixel);
+  return pixel;
+}
 
+void ZrleDecoder::readPalette(DataInputStream *input,
+                              const int paletteSize)
+{
   for (int i = 0; i < paletteSize; i++) {
-    input->readFully(&(*palette)[i] + m_numberFirstByte, m_bytesPerPixel);
+    m_palette[i] = readPixel(input);
   }
 }
 
 void ZrleDecoder::readRawTile(DataInputStream *input,
-                              vector<char> &pixels,
                               const Rect *tileRect)
-{
-  size_t tileBytesLength = tileRect->area() * m_bytesPerPixel;
-  input->readFully(&pixels.front(), tileBytesLength);
-}
-
-void ZrleDecoder::readSolidTile(DataInputStream *input,
-                                vector<char> &pixels,
-                                const Rect *tileRect)
 {
   size_t tileLength = tileRect->area();
-  char solid[4] = {0, 0, 0, 0};
-
-  input->readFully(solid + m_numberFirstByte, m_bytesPerPixel);
-  
-  char *pixelsPtr = &pixels.front();
-  // TODO: Can we optimize this?
-  for (size_t i = 0; i < tileLength; i++) {
-    memcpy(pixelsPtr + m_numberFirstByte, solid, m_bytesPerPixel); 
-    pixelsPtr += m_bytesPerPixel;
+  if (m_bytesPerPixel != 3) {
+    input->readFully(&m_tilePixels.front(), tileLength * m_bytesPerPixel);
+    return;
   }
+
+  m_cpixels.resize(tileLength * 3);
+  input->readFully(&m_cpixels.front(), tileLength * 3);
+  int layout = m_numberFirstByte == 0 ? PixelUnpacker::CPIXEL_LOW
+                                      : PixelUnpacker::CPIXEL_HIGH;
+  PixelUnpacker::expandCPixels(&m_cpixels.front(),
+                               (UINT32 *)&m_tilePixels.front(),
+                               tileLength, layout);
 }
 
 void ZrleDecoder::readPackedPaletteTile(DataInputStream *input,
-                                        vector<char> &pixels,
                                         const Rect *tileRect,
                                         const int type)
 {
@@ -222,82 +224,56 @@ void ZrleDecoder::readPackedPaletteTile(DataInputStream *input,
 
   // type and palette size is equal
   int paletteSize = type;
-  Palette palette;
-  readPalette(input, paletteSize, &palette);
+  readPalette(input, paletteSize);
 
-  int m = 0;
-  unsigned char mask = 0;
-  unsigned char deltaOffset = 0;
+  size_t bitsPerIndex = 4;
   if (paletteSize == 2) {
-    m = (width + 7) / 8;
-    mask = 0x01;
-    deltaOffset = 1;
+    bitsPerIndex = 1;
   } else if (paletteSize == 3 || paletteSize == 4) {
-    m = (width + 3) / 4;
-    mask = 0x03;
-    deltaOffset = 2;
-  } else if (paletteSize >= 5 && paletteSize <= 16) {
-    m = (width + 1) / 2;
-    mask = 0x0F;
-    deltaOffset = 4;
+    bitsPerIndex = 2;
   }
-
-  for (int y = 0; y < height; y++) {
-    // bit lenght of UINT8
-    unsigned char offset = 8;
-    int index = 0;
-    // FIXME: optimization. Read by line.
-    int entryByIndex = input->readUInt8();
-
-    for (int x = 0; x < width; x++) {
-      offset -= deltaOffset;
-      int color = (entryByIndex >> offset) & mask;
-      if (offset == 0) {
-        offset = 8;
-        // Don't read next entry, if it's last pixel in tile.
-        if (x != width - 1) {
-          entryByIndex = input->readUInt8();
-        }
-      }
-
-      size_t count = y * width + x;
-      memcpy(&pixels[count * m_bytesPerPixel], &palette[color], m_bytesPerPixel);
-    }
+  // Each row of the indexes is padded to the byte boundary.
+  size_t m = (width * bitsPerIndex + 7) / 8;
+
+  UINT8 indexes[TILE_SIZE / 2];
+  UINT8 *row = &m_tilePixels.front();
+  const size_t rowLength = width * m_fbBytesPerPixel;
+  for (int y = 0; y < height; y++, row += rowLength) {
+    input->readFully(indexes, m);
+    PixelUnpacker::expandIndexes(indexes, bitsPerIndex, m_palette, row, width,
+                                 m_fbBytesPerPixel);
   }
 }
 
 void ZrleDecoder::readPlainRleTile(DataInputStream *input,
-                                   vector<char> &pixels,
                                    const Rect *tileRect)
 {
   size_t tileLength = tileRect->area();
-  for (size_t indexByte = 0; indexByte < tileLength * m_bytesPerPixel;) {
-    char color[4] = {0, 0, 0, 0};
-    input->readFully(color + m_numberFirstByte, m_bytesPerPixel);
+  UINT8 *pixels = &m_tilePixels.front();
+  for (size_t indexPixel = 0; indexPixel < tileLength;) {
+    UINT32 color = readPixel(input);
 
     size_t runLength = readRunLength(input);
-    if (indexByte + runLength * m_bytesPerPixel > pixels.size()) {
+    if (runLength > tileLength - indexPixel) {
       throw Exception(_T("Bad data received from the server: ZRLE run length is too long in plain RLE tile."));
     }
 
-    for (size_t i = 0; i < runLength; i++) {
-      memcpy(&pixels[indexByte], color, m_bytesPerPixel);
-      indexByte += m_bytesPerPixel; 
-    }
+    PixelUnpacker::fill(pixels + indexPixel * m_fbBytesPerPixel, color,
+                        runLength, m_fbBytesPerPixel);
+    indexPixel += runLength;
   }
 }
 
 void ZrleDecoder::readPaletteRleTile(DataInputStream *input,
-                                     vector<char> &pixels,
                                      const Rect *tileRect,
                                      const int type)
 {
   size_t tileLength = tileRect->area();
 
   int paletteSize = type - 128;
-  Palette palette;
-  readPalette(input, paletteSize, &palette);
+  readPalette(input, paletteSize);
 
+  UINT8 *pixels = &m_tilePixels.front();
   for (size_t indexPixel = 0; indexPixel < tileLength;) {
     UINT8 color = input->readUInt8();
 
@@ -305,42 +281,27 @@ void ZrleDecoder::readPaletteRleTile(DataInputStream *input,
     if (color >= 128) {
       color -= 128;
       runLength = readRunLength(input);
-      if (indexPixel + runLength > tileLength) {
+      if (runLength > tileLength - indexPixel) {
         throw Exception(_T("Bad data received from the server: ZRLE run length is too long in palette RLE tile."));
       }
     }
     
-    char * pixelsPtr = &pixels[indexPixel * m_bytesPerPixel];
-    for(size_t i = 0; i < runLength; i++) {
-      memcpy(pixelsPtr, &palette[color], m_bytesPerPixel);
-      pixelsPtr += m_bytesPerPixel;
-    }
+    PixelUnpacker::fill(pixels + indexPixel * m_fbBytesPerPixel,
+                        m_palette[color], runLength, m_fbBytesPerPixel);
     indexPixel += runLength;
   }
 }
 
 void ZrleDecoder::drawTile(FrameBuffer *fb,
-                           const Rect *tileRect,
-                           const vector<char> *pixels)
+                           const Rect *tileRect)
 {
-  int width = tileRect->getWidth();
-  size_t fbBytesPerPixel = m_bytesPerPixel;
-
-  if (fbBytesPerPixel == 3) {
-    fbBytesPerPixel = 4;
-  }
-
-  int tileLength = tileRect->area();
-
-  int x = tileRect->left;
-  int y = tileRect->top;
-   
-  const char *pixelsPtr = &pixels->front();
-  char *bufferPtr = 0;
-  for (int i = 0; i < tileLength; i++) {
-    bufferPtr = (char*)fb->getBufferPtr(x + i % width, y + i / width);
-    memset(bufferPtr, 0, fbBytesPerPixel);
-    memcpy(bufferPtr, pixelsPtr, m_bytesPerPixel);
-    pixelsPtr+=m_bytesPerPixel;
+  const size_t rowLength = tileRect->getWidth() * m_fbBytesPerPixel;
+  const int stride = fb->getBytesPerRow();
+  const UINT8 *src = &m_tilePixels.front();
+  UINT8 *dst = (UINT8 *)fb->getBufferPtr(tileRect->left, tileRect->top);
+  for (int y = 0; y < tileRect->getHeight(); y++) {
+    memcpy(dst, src, rowLength);
+    src += rowLength;
+    dst += stride;
   }
 }
@@ -36,9 +36,6 @@ public:
   ZrleDecoder(LogWriter *logWriter);
   virtual ~ZrleDecoder();
 
-protected:
-  typedef vector<unsigned int> Palette;
-
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
@@ -51,40 +48,47 @@ protected:
 
   size_t readRunLength(DataInputStream *input);
 
+  // Reads a pixel (or a CPIXEL) and returns it in the frame buffer format.
+  UINT32 readPixel(DataInputStream *input);
+
+  // Reads paletteSize colors into m_palette.
   void readPalette(DataInputStream *input,
-                   const int paletteSize,
-                   Palette *palette);
+                   const int paletteSize);
 
+  // The tile readers decode the tile into m_tilePixels, in the format of
+  // the frame buffer, row by row without gaps.
   void readRawTile(DataInputStream *input,
-                   vector<char> &pixels,
                    const Rect *tileRect);
 
-  void readSolidTile(DataInputStream *input,
-                     vector<char> &pixels,
-                     const Rect *tileRect);
-
   void readPackedPaletteTile(DataInputStream *input,
-                             vector<char> &pixels,
                              const Rect *tileRect,
                              const int type);
 
   void readPlainRleTile(DataInputStream *input,
-                        vector<char> &pixels,
                         const Rect *tileRect);
 
   void readPaletteRleTile(DataInputStream *input,
-                          vector<char> &pixels,
                           const Rect *tileRect,
                           const int type);
 
 
   void drawTile(FrameBuffer *fb,
-                const Rect *tileRect,
-                const vector<char> *pixels);
+                const Rect *tileRect);
 
   Inflater m_inflater;
   size_t m_bytesPerPixel;
   size_t m_numberFirstByte;
+  size_t m_fbBytesPerPixel;
+
+  // Scratch buffers, kept between rectangles: compressed data, the pixels
+  // of a tile and the CPIXELs of a raw tile.
+  vector<char> m_zlibData;
+  vector<UINT8> m_tilePixels;
+  vector<UINT8> m_cpixels;
+
+  // Large enough for the palette RLE tiles and for any index of a packed
+  // palette tile.
+  UINT32 m_palette[128];
 
 private:
   static const int TILE_SIZE = 64;
@@ -33,7 +33,10 @@ DibSection::DibSection(const PixelFormat *pf, const Dimension *dim, HWND compati
   m_hbmDIB(0),
   m_srcOffsetX(0),
   m_srcOffsetY(0),
-  m_buffer(0)
+  m_buffer(0),
+  m_bmi(0),
+  m_height(0),
+  m_qualityScaling(false)
 {
   try {
     openDIBSection(pf, dim, compatibleWin);
@@ -101,9 +104,47 @@ void DibSection::blitFromDibSection(const Rect *rect, DWORD flags)
   }
 }
 
+void DibSection::setBitsToDevice(HDC dc, const Rect *dstRect, int srcX, int srcY)
+{
+  // The DIB is top-down, so the source origin is its upper-left corner.
+  if (SetDIBitsToDevice(dc, dstRect->left, dstRect->top,
+                        dstRect->getWidth(), dstRect->getHeight(),
+                        srcX, srcY, 0, m_height,
+                        m_buffer, m_bmi, DIB_RGB_COLORS) == 0) {
+    throw Exception(_T("Can't set bits to a device from DIB section."));
+  }
+}
+
+void DibSection::stretchToDevice(HDC dc, const Rect *dstRect, const Rect *srcRect)
+{
+  applyStretchMode(dc);
+  if (StretchBlt(dc, dstRect->left, dstRect->top,
+                 dstRect->getWidth(), dstRect->getHeight(),
+                 m_memDC, srcRect->left, srcRect->top,
+                 srcRect->getWidth(), srcRect->getHeight(), SRCCOPY) == 0) {
+    throw Exception(_T("Can't strech blit from DIB section."));
+  }
+}
+
+void DibSection::setQualityScaling(bool enabled)
+{
+  m_qualityScaling = enabled;
+}
+
+void DibSection::applyStretchMode(HDC dc) const
+{
+  if (m_qualityScaling) {
+    SetStretchBltMode(dc, HALFTONE);
+    // Required after setting HALFTONE.
+    SetBrushOrgEx(dc, 0, 0, 0);
+  } else {
+    SetStretchBltMode(dc, COLORONCOLOR);
+  }
+}
+
 void DibSection::stretchFromDibSection(const Rect *srcRect, const Rect *dstRect, DWORD flags)
 {
-  SetStretchBltMode(m_targetDC, HALFTONE);
+  applyStretchMode(m_targetDC);
   if (StretchBlt(m_targetDC, srcRect->left + m_srcOffsetX, srcRect->top + m_srcOffsetY,
                  srcRect->getWidth(), srcRect->getHeight(),
                  m_memDC, dstRect->left, dstRect->top, dstRect->getWidth(), dstRect->getHeight(),
@@ -161,16 +202,16 @@ void DibSection::openDIBSection(const PixelFormat *pf, const Dimension *dim, HWN
     m_srcOffsetY = deskRect.top;
   }
 
-  Screen::BMI bitFieldBmi;
-  Screen::Palette8bitBMI paletteBMI;
   BITMAPINFO *pBmi = 0;
 
   if (pf->bitsPerPixel == 8) {
-    pBmi = reinterpret_cast<BITMAPINFO *>(&paletteBMI);
+    pBmi = reinterpret_cast<BITMAPINFO *>(&m_paletteBmi);
   } else {
-    pBmi = reinterpret_cast<BITMAPINFO *>(&bitFieldBmi);
+    pBmi = reinterpret_cast<BITMAPINFO *>(&m_bitFieldBmi);
   }
   setupBMIStruct(pBmi, pf, dim);
+  m_bmi = pBmi;
+  m_height = dim->height;
 
   m_memDC = CreateCompatibleDC(m_targetDC);
   if (m_memDC == NULL) {
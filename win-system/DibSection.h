@@ -74,6 +74,22 @@ public:
   // This function throwing an exception on a failure.
   void stretchFromDibSection(const Rect *srcRect, const Rect *dstRect);
 
+  // Copies the rectangle of the DIB section at (srcX, srcY) to dstRect of
+  // the dc straight from the bits, with SetDIBitsToDevice(). The output is
+  // clipped by the clip region of the dc, e.g. the update region of a
+  // window being painted.
+  // This function throwing an exception on a failure.
+  void setBitsToDevice(HDC dc, const Rect *dstRect, int srcX, int srcY);
+
+  // Stretches srcRect of the DIB section to dstRect of the dc, clipped by
+  // the clip region of the dc. The HALFTONE mode is used only with quality
+  // scaling (see setQualityScaling()), COLORONCOLOR otherwise.
+  // This function throwing an exception on a failure.
+  void stretchToDevice(HDC dc, const Rect *dstRect, const Rect *srcRect);
+
+  // Sets the filtering of the stretched images, off by default.
+  void setQualityScaling(bool enabled);
+
 private:
   // Opens a new DIB section.
   // If targetDC == 0 the function will use a current desktop DC.
@@ -90,6 +106,9 @@ private:
 
   void setupBMIStruct(BITMAPINFO *pBmi, const PixelFormat *pf, const Dimension *dim);
 
+  // Sets the stretch mode of the dc, see stretchToDevice().
+  void applyStretchMode(HDC dc) const;
+
   bool m_isOwnTargetDC;
   HDC m_targetDC;
   HDC m_memDC;
@@ -101,6 +120,15 @@ private:
 
   void *m_buffer;
 
+  // Description of the bits for SetDIBitsToDevice(), m_bmi points to one of
+  // the structures.
+  Screen::BMI m_bitFieldBmi;
+  Screen::Palette8bitBMI m_paletteBmi;
+  BITMAPINFO *m_bmi;
+  int m_height;
+
+  bool m_qualityScaling;
+
   Screen m_screen;
 };
 
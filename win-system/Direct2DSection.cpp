@@ -25,8 +25,10 @@
 #include "win-system/Direct2DSection.h"
 #include "win-system/SystemException.h"
 #include "rfb/PixelFormat.h"
+#include "rfb/StandardPixelFormatFactory.h"
 #include "region/Rect.h"
 #include "region/Dimension.h"
+#include "thread/AutoLock.h"
 #include <algorithm>
 #include <stdio.h>
 // Add DWrite header for text rendering
@@ -41,29 +43,53 @@
 #define DEBUG_LOG(msg, ...)
 #endif
 
+// Factory shared by all the sections of the process. It is created on the
+// first use and kept until the process exits, so opening one more viewer
+// window does not initialize Direct2D again.
+static LocalMutex s_factoryLock;
+static ID2D1Factory* s_sharedFactory = NULL;
+
 /**
- * Helper function to create a Direct2D factory.
- * This is a standalone function to encapsulate the creation logic
- * and uses the Direct2D API from Windows 7 SDK.
+ * Helper function to get the shared Direct2D factory.
+ * The caller gets its own reference and must release it.
+ * The factory is multithreaded, because the sections of different viewer
+ * windows are updated from their own threads, so Direct2D serializes the
+ * access to the resources it shares between them.
  */
 HRESULT CreateD2DFactory(ID2D1Factory** ppD2DFactory)
 {
-    // Create Direct2D factory with defaults for Windows 7 compatibility
-    HRESULT hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, ppD2DFactory);
-    return hr;
+    AutoLock al(&s_factoryLock);
+    if (s_sharedFactory == NULL) {
+        HRESULT hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_MULTI_THREADED, &s_sharedFactory);
+        if (FAILED(hr)) {
+            s_sharedFactory = NULL;
+            return hr;
+        }
+    }
+    s_sharedFactory->AddRef();
+    *ppD2DFactory = s_sharedFactory;
+    return S_OK;
 }
 
 Direct2DSection::Direct2DSection(const PixelFormat *pf, const Dimension *dim, HWND compatibleWin)
 : m_pD2DFactory(NULL),
   m_pRenderTarget(NULL),
   m_pBitmap(NULL),
+  m_pScratchBitmap(NULL),
   m_width(dim->width),
   m_height(dim->height),
   m_bitmapBits(NULL),
   m_pDCRenderTarget(NULL),
-  m_pHwndRenderTarget(NULL)
+  m_pHwndRenderTarget(NULL),
+  m_bufferCapacity(0),
+  m_needsConversion(false)
 {
+  m_scratchSize = D2D1::SizeU(0, 0);
+  m_bitmapSize = D2D1::SizeU(0, 0);
   DEBUG_LOG("Creating Direct2DSection, dimensions: %dx%d", dim->width, dim->height);
+  for (size_t i = 0; i < OVERLAY_LAYERS; i++) {
+    m_pOverlayBitmaps[i] = NULL;
+  }
   try {
     initDirect2D(pf, dim, compatibleWin);
     DEBUG_LOG("Direct2DSection initialized successfully");
@@ -112,7 +138,7 @@ void Direct2DSection::blitFromDibSection(const Rect *rect, DWORD flags)
   DEBUG_LOG("blitFromDibSection called with rect=(%d,%d,%d,%d), flags=%lu",
           rect->left, rect->top, rect->right, rect->bottom, flags);
 
-  if (m_pRenderTarget == nullptr || m_pBitmap == nullptr) {
+  if (!restoreTarget()) {
     DEBUG_LOG("Error: Render target or bitmap is null");
     return;
   }
@@ -135,23 +161,19 @@ void Direct2DSection::blitFromDibSection(const Rect *rect, DWORD flags)
   sourceArea.right = rect->right;
   sourceArea.bottom = rect->bottom;
   
-  // Adjust source area to fit within bitmap bounds
-  if (sourceArea.right > (int)bitmapSize.width) sourceArea.right = bitmapSize.width;
-  if (sourceArea.bottom > (int)bitmapSize.height) sourceArea.bottom = bitmapSize.height;
+  // Adjust source area to fit within the buffer, the bitmap may be larger
+  Rect bufferRect = getBufferRect();
+  if (sourceArea.right > bufferRect.right) sourceArea.right = bufferRect.right;
+  if (sourceArea.bottom > bufferRect.bottom) sourceArea.bottom = bufferRect.bottom;
   
   DEBUG_LOG("Adjusted source area to bitmap bounds: (%d,%d,%d,%d)",
           sourceArea.left, sourceArea.top, sourceArea.right, sourceArea.bottom);
 
-  // Update the bitmap from the buffer
-  HRESULT hr = m_pBitmap->CopyFromMemory(
-      nullptr,  // Copy the entire bitmap
-      m_bitmapBits,
-      m_width * 4
-  );
-  
-  if (FAILED(hr)) {
-    DEBUG_LOG("Failed to update bitmap data: 0x%08x", hr);
-    m_pRenderTarget->EndDraw();
+  // Update the changed parts of the bitmap from the buffer
+  if (!uploadDirtyRects()) {
+    if (m_pRenderTarget->EndDraw() == D2DERR_RECREATE_TARGET) {
+      onTargetLost();
+    }
     return;
   }
 
@@ -199,8 +221,13 @@ void Direct2DSection::blitFromDibSection(const Rect *rect, DWORD flags)
     D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, // No interpolation for 1:1 blitting
     d2dSrcRect
   );
+  drawOverlays(&d2dSrcRect, &d2dDstRect);
 
-  hr = m_pRenderTarget->EndDraw();
+  HRESULT hr = m_pRenderTarget->EndDraw();
+  if (hr == D2DERR_RECREATE_TARGET) {
+    onTargetLost();
+    return;
+  }
   if (FAILED(hr)) {
     DEBUG_LOG("EndDraw failed with error: 0x%08x", hr);
     return;
@@ -209,6 +236,228 @@ void Direct2DSection::blitFromDibSection(const Rect *rect, DWORD flags)
   DEBUG_LOG("blitFromDibSection completed successfully");
 }
 
+void Direct2DSection::invalidate(const Rect *rect)
+{
+  AutoLock al(&m_dirtyLock);
+  m_dirtyRegion.addRect(rect);
+  // The buffer is up to date there again.
+  Region changed(rect);
+  m_staleRegion.subtract(&changed);
+  m_lostRegion.subtract(&changed);
+}
+
+bool Direct2DSection::uploadFrom(const Rect *rect, const void *bits, UINT32 stride)
+{
+  if (!restoreTarget() || m_needsConversion) {
+    return false;
+  }
+  Rect bufferRect = getBufferRect();
+  if (!bufferRect.intersection(rect).isEqualTo(rect)) {
+    return false;
+  }
+  D2D1_RECT_U dstRect = D2D1::RectU(rect->left, rect->top, rect->right, rect->bottom);
+  HRESULT hr = m_pBitmap->CopyFromMemory(&dstRect, bits, stride);
+  if (FAILED(hr)) {
+    DEBUG_LOG("Failed to upload bitmap data: 0x%08x", hr);
+    return false;
+  }
+  // Stale pixels of the buffer must not overwrite the uploaded ones.
+  AutoLock al(&m_dirtyLock);
+  Region uploaded(rect);
+  m_dirtyRegion.subtract(&uploaded);
+  m_staleRegion.add(&uploaded);
+  m_lostRegion.subtract(&uploaded);
+  return true;
+}
+
+bool Direct2DSection::copyRect(const Rect *dstRect, int srcX, int srcY)
+{
+  if (dstRect->isEmpty() || !restoreTarget()) {
+    return false;
+  }
+  Rect srcRect(dstRect);
+  srcRect.setLocation(srcX, srcY);
+  Rect bufferRect = getBufferRect();
+  if (!bufferRect.intersection(dstRect).isEqualTo(dstRect) ||
+      !bufferRect.intersection(&srcRect).isEqualTo(&srcRect)) {
+    return false;
+  }
+  {
+    // The changed pixels of the source are still in the buffer only, and
+    // the lost ones are nowhere.
+    AutoLock al(&m_dirtyLock);
+    Region dirtySource(srcRect);
+    Region missing(m_dirtyRegion);
+    missing.add(&m_lostRegion);
+    dirtySource.intersect(&missing);
+    if (!dirtySource.isEmpty()) {
+      return false;
+    }
+  }
+
+  UINT32 width = dstRect->getWidth();
+  UINT32 height = dstRect->getHeight();
+  if (m_pScratchBitmap == nullptr ||
+      m_scratchSize.width < width || m_scratchSize.height < height) {
+    if (m_pScratchBitmap != nullptr) {
+      m_pScratchBitmap->Release();
+      m_pScratchBitmap = NULL;
+    }
+    D2D1_SIZE_U scratchSize = D2D1::SizeU(std::max(width, m_scratchSize.width),
+                                          std::max(height, m_scratchSize.height));
+    D2D1_BITMAP_PROPERTIES bitmapProps = D2D1::BitmapProperties(
+      D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE));
+    HRESULT hr = m_pRenderTarget->CreateBitmap(scratchSize, NULL, 0,
+                                               bitmapProps, &m_pScratchBitmap);
+    if (FAILED(hr)) {
+      DEBUG_LOG("Failed to create the scratch bitmap: 0x%08x", hr);
+      m_pScratchBitmap = NULL;
+      m_scratchSize = D2D1::SizeU(0, 0);
+      return false;
+    }
+    m_scratchSize = scratchSize;
+  }
+
+  D2D1_POINT_2U origin = D2D1::Point2U(0, 0);
+  D2D1_RECT_U srcArea = D2D1::RectU(srcRect.left, srcRect.top,
+                                    srcRect.right, srcRect.bottom);
+  HRESULT hr = m_pScratchBitmap->CopyFromBitmap(&origin, m_pBitmap, &srcArea);
+  if (SUCCEEDED(hr)) {
+    D2D1_POINT_2U dstPoint = D2D1::Point2U(dstRect->left, dstRect->top);
+    D2D1_RECT_U scratchArea = D2D1::RectU(0, 0, width, height);
+    hr = m_pBitmap->CopyFromBitmap(&dstPoint, m_pScratchBitmap, &scratchArea);
+  }
+  if (FAILED(hr)) {
+    DEBUG_LOG("Failed to copy the bitmap rectangle: 0x%08x", hr);
+    return false;
+  }
+  // Stale pixels of the buffer must not overwrite the copied ones.
+  AutoLock al(&m_dirtyLock);
+  Region copied(dstRect);
+  m_dirtyRegion.subtract(&copied);
+  m_staleRegion.add(&copied);
+  m_lostRegion.subtract(&copied);
+  return true;
+}
+
+bool Direct2DSection::setOverlay(size_t layer, const FrameBuffer *image, const Rect *rect)
+{
+  if (m_pRenderTarget == nullptr || layer >= OVERLAY_LAYERS) {
+    return false;
+  }
+  if (m_pOverlayBitmaps[layer] != nullptr && m_overlayRects[layer].isEqualTo(rect)) {
+    return true;
+  }
+  PixelFormat imagePf = image->getPixelFormat();
+  PixelFormat bitmapPf = StandardPixelFormatFactory::create32bppPixelFormat();
+  if (!imagePf.isEqualTo(&bitmapPf)) {
+    return false;
+  }
+  clearOverlay(layer);
+
+  Dimension imageDim = image->getDimension();
+  D2D1_BITMAP_PROPERTIES bitmapProps = D2D1::BitmapProperties(
+    D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+  HRESULT hr = m_pRenderTarget->CreateBitmap(
+    D2D1::SizeU(imageDim.width, imageDim.height),
+    image->getBuffer(),
+    image->getBytesPerRow(),
+    bitmapProps,
+    &m_pOverlayBitmaps[layer]);
+  if (FAILED(hr)) {
+    DEBUG_LOG("Failed to create the overlay bitmap: 0x%08x", hr);
+    m_pOverlayBitmaps[layer] = NULL;
+    return false;
+  }
+  m_overlayRects[layer] = *rect;
+  return true;
+}
+
+bool Direct2DSection::moveOverlay(size_t layer, int x, int y)
+{
+  if (layer >= OVERLAY_LAYERS || m_pOverlayBitmaps[layer] == nullptr) {
+    return false;
+  }
+  m_overlayRects[layer].setLocation(x, y);
+  return true;
+}
+
+void Direct2DSection::clearOverlay(size_t layer)
+{
+  if (layer < OVERLAY_LAYERS && m_pOverlayBitmaps[layer]) {
+    m_pOverlayBitmaps[layer]->Release();
+    m_pOverlayBitmaps[layer] = NULL;
+  }
+}
+
+void Direct2DSection::drawOverlays(const D2D1_RECT_F *srcArea,
+                                   const D2D1_RECT_F *dstArea)
+{
+  if (srcArea->right <= srcArea->left || srcArea->bottom <= srcArea->top) {
+    return;
+  }
+  // Place the overlay the same way as the buffer area, with its scale.
+  FLOAT scaleX = (dstArea->right - dstArea->left) / (srcArea->right - srcArea->left);
+  FLOAT scaleY = (dstArea->bottom - dstArea->top) / (srcArea->bottom - srcArea->top);
+
+  // Only the part inside the drawn area may be changed.
+  m_pRenderTarget->PushAxisAlignedClip(*dstArea, D2D1_ANTIALIAS_MODE_ALIASED);
+  for (size_t i = 0; i < OVERLAY_LAYERS; i++) {
+    if (m_pOverlayBitmaps[i] == nullptr) {
+      continue;
+    }
+    const Rect *overlayRect = &m_overlayRects[i];
+    D2D1_RECT_F overlayDst = D2D1::RectF(
+      dstArea->left + (overlayRect->left - srcArea->left) * scaleX,
+      dstArea->top + (overlayRect->top - srcArea->top) * scaleY,
+      dstArea->left + (overlayRect->right - srcArea->left) * scaleX,
+      dstArea->top + (overlayRect->bottom - srcArea->top) * scaleY);
+    m_pRenderTarget->DrawBitmap(m_pOverlayBitmaps[i], overlayDst, 1.0f,
+                                D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+  }
+  m_pRenderTarget->PopAxisAlignedClip();
+}
+
+bool Direct2DSection::uploadDirtyRects()
+{
+  std::vector<Rect> rects;
+  {
+    AutoLock al(&m_dirtyLock);
+    m_dirtyRegion.getRectVector(&rects);
+    m_dirtyRegion.clear();
+  }
+  DEBUG_LOG("Uploading %u changed rectangles", (unsigned int)rects.size());
+
+  D2D1_SIZE_U bitmapSize = m_pBitmap->GetPixelSize();
+  Rect bitmapRect(bitmapSize.width, bitmapSize.height);
+  Rect bufferRect = m_bufferFb.getDimension().getRect();
+  bitmapRect = bitmapRect.intersection(&bufferRect);
+  for (std::vector<Rect>::iterator iRect = rects.begin(); iRect != rects.end(); iRect++) {
+    Rect rect = iRect->intersection(&bitmapRect);
+    if (rect.isEmpty()) {
+      continue;
+    }
+    const FrameBuffer *srcFb = &m_bufferFb;
+    if (m_needsConversion) {
+      srcFb = m_converter.convert(&rect, &m_bufferFb);
+    }
+    D2D1_RECT_U dstRect = D2D1::RectU(rect.left, rect.top, rect.right, rect.bottom);
+    HRESULT hr = m_pBitmap->CopyFromMemory(&dstRect,
+                                           srcFb->getBufferPtr(rect.left, rect.top),
+                                           srcFb->getBytesPerRow());
+    if (FAILED(hr)) {
+      DEBUG_LOG("Failed to update bitmap data: 0x%08x", hr);
+      // Try the not uploaded rectangles again on the next rendering.
+      AutoLock al(&m_dirtyLock);
+      for (; iRect != rects.end(); iRect++) {
+        m_dirtyRegion.addRect(&(*iRect));
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
 void Direct2DSection::stretchFromDibSection(const Rect *dstRect, const Rect *srcRect)
 {
   // tightvnc made me do this...
@@ -221,7 +470,7 @@ void Direct2DSection::stretchFromDibSection(const Rect *srcRect, const Rect *dst
          srcRect->left, srcRect->top, srcRect->right, srcRect->bottom,
          dstRect->left, dstRect->top, dstRect->right, dstRect->bottom, flags);
 
-  if (m_pRenderTarget == nullptr || m_pBitmap == nullptr) {
+  if (!restoreTarget()) {
     DEBUG_LOG("Error: Render target or bitmap is null");
     return;
   }
@@ -237,16 +486,11 @@ void Direct2DSection::stretchFromDibSection(const Rect *srcRect, const Rect *dst
   // BeginDraw returns void
   m_pRenderTarget->BeginDraw();
   
-  // Update the bitmap from the buffer (always use the full bitmap)
-  HRESULT hr = m_pBitmap->CopyFromMemory(
-      nullptr,  // Copy the entire bitmap
-      m_bitmapBits,
-      m_width * 4
-  );
-  
-  if (FAILED(hr)) {
-    DEBUG_LOG("Failed to update bitmap data: 0x%08x", hr);
-    m_pRenderTarget->EndDraw();
+  // Update the changed parts of the bitmap from the buffer
+  if (!uploadDirtyRects()) {
+    if (m_pRenderTarget->EndDraw() == D2DERR_RECREATE_TARGET) {
+      onTargetLost();
+    }
     return;
   }
 
@@ -299,8 +543,13 @@ void Direct2DSection::stretchFromDibSection(const Rect *srcRect, const Rect *dst
     D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, // Use nearest neighbor for exact pixel mapping
     d2dSrcRect      // Source rectangle from the bitmap
   );
+  drawOverlays(&d2dSrcRect, &d2dDstRect);
 
-  hr = m_pRenderTarget->EndDraw();
+  HRESULT hr = m_pRenderTarget->EndDraw();
+  if (hr == D2DERR_RECREATE_TARGET) {
+    onTargetLost();
+    return;
+  }
   if (FAILED(hr)) {
     DEBUG_LOG("EndDraw failed with error: 0x%08x", hr);
     return;
@@ -343,14 +592,56 @@ void Direct2DSection::initDirect2D(const PixelFormat *pf, const Dimension *dim,
   }
   DEBUG_LOG("Direct2D factory created successfully");
 
-  // Create render target with Windows 7 compatible settings
   // Make sure dimensions are at least 1x1 to avoid D2D errors
   UINT width = std::max(1, dim->width);
   UINT height = std::max(1, dim->height);
+
+  createRenderTarget();
+
+  // Create bitmap with the same size as dim (not the window size)
+  D2D1_SIZE_U bitmapSize = D2D1::SizeU(width, height);
+  createBitmap(&bitmapSize);
+
+  // Allocate memory for bitmap data in the pixel format of the frame buffer
+  size_t bufferSize = width * height * (pf->bitsPerPixel / 8);
+  m_bitmapBits = malloc(bufferSize);
+  if (m_bitmapBits == NULL) {
+    DEBUG_LOG("Failed to allocate bitmap data buffer");
+    throw SystemException(_T("Failed to allocate bitmap data buffer"));
+  }
+  m_bufferCapacity = bufferSize;
+  m_bufferFb.setPropertiesWithoutResize(dim, pf);
+  m_bufferFb.setBuffer(m_bitmapBits);
+
+  PixelFormat bitmapPf = StandardPixelFormatFactory::create32bppPixelFormat();
+  m_needsConversion = !pf->isEqualTo(&bitmapPf);
+  if (m_needsConversion) {
+    DEBUG_LOG("Converting %d bpp pixels to 32 bpp on upload", (int)pf->bitsPerPixel);
+    m_converter.setPixelFormats(&bitmapPf, pf);
+  }
+
+  // Initialize the bitmap buffer with black
+  memset(m_bitmapBits, 0, bufferSize);
+  Rect bitmapRect(width, height);
+  invalidate(&bitmapRect);
+  
+  // Draw a test pattern to the Direct2D render target to make sure it works
+  m_pRenderTarget->BeginDraw();
+  m_pRenderTarget->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 1.0f)); // Black
+  HRESULT testResult = m_pRenderTarget->EndDraw();
+  DEBUG_LOG("Test pattern draw result: 0x%lx", testResult);
+}
+
+void Direct2DSection::createRenderTarget()
+{
+  // Create render target with Windows 7 compatible settings
+  // Make sure dimensions are at least 1x1 to avoid D2D errors
+  UINT width = std::max(1, m_width);
+  UINT height = std::max(1, m_height);
   
   // Get actual window client size for better rendering
   RECT clientRect;
-  GetClientRect(compatibleWin, &clientRect);
+  GetClientRect(m_hwnd, &clientRect);
   UINT winWidth = clientRect.right - clientRect.left;
   UINT winHeight = clientRect.bottom - clientRect.top;
   
@@ -374,16 +665,16 @@ void Direct2DSection::initDirect2D(const PixelFormat *pf, const Dimension *dim,
   
   // Use D2D1_PRESENT_OPTIONS_NONE for better compatibility
   D2D1_HWND_RENDER_TARGET_PROPERTIES hwndProps = D2D1::HwndRenderTargetProperties(
-    compatibleWin,
+    m_hwnd,
     renderSize,
     D2D1_PRESENT_OPTIONS_NONE  // Changed from IMMEDIATELY to NONE for better rendering
   );
 
-  DEBUG_LOG("Attempting to create HwndRenderTarget for window %p with size %ux%u", compatibleWin, renderSize.width, renderSize.height);
+  DEBUG_LOG("Attempting to create HwndRenderTarget for window %p with size %ux%u", m_hwnd, renderSize.width, renderSize.height);
   
   // Try to create the render target (as ID2D1RenderTarget interface)
   ID2D1HwndRenderTarget* pHwndRT = NULL;
-  hr = m_pD2DFactory->CreateHwndRenderTarget(
+  HRESULT hr = m_pD2DFactory->CreateHwndRenderTarget(
     rtProps,
     hwndProps,
     &pHwndRT
@@ -417,7 +708,7 @@ void Direct2DSection::initDirect2D(const PixelFormat *pf, const Dimension *dim,
     if (SUCCEEDED(hr) && pDCRT) {
       DEBUG_LOG("DCRenderTarget created successfully");
       // If we created a DC render target successfully, bind it to the window DC temporarily
-      HDC hdc = GetDC(compatibleWin);
+      HDC hdc = GetDC(m_hwnd);
       if (hdc) {
         RECT rc = {0, 0, static_cast<LONG>(width), static_cast<LONG>(height)};
         if (winWidth > 0 && winHeight > 0) {
@@ -428,9 +719,9 @@ void Direct2DSection::initDirect2D(const PixelFormat *pf, const Dimension *dim,
         hr = pDCRT->BindDC(hdc, &rc);
         DEBUG_LOG("BindDC result: 0x%lx, rect: (%d,%d,%d,%d)", 
                  hr, rc.left, rc.top, rc.right, rc.bottom);
-        ReleaseDC(compatibleWin, hdc);
+        ReleaseDC(m_hwnd, hdc);
       } else {
-        DEBUG_LOG("Failed to get HDC for window %p", compatibleWin);
+        DEBUG_LOG("Failed to get HDC for window %p", m_hwnd);
       }
       
       m_pRenderTarget = pDCRT;
@@ -440,20 +731,20 @@ void Direct2DSection::initDirect2D(const PixelFormat *pf, const Dimension *dim,
       throw SystemException(_T("Failed to create any compatible Direct2D render target"));
     }
   }
+}
 
+void Direct2DSection::createBitmap(const D2D1_SIZE_U *size)
+{
   // Create bitmap format - Use DXGI_FORMAT_B8G8R8A8_UNORM which is supported in Windows 7
   D2D1_PIXEL_FORMAT pixelFormat = D2D1::PixelFormat(
     DXGI_FORMAT_B8G8R8A8_UNORM,  // Windows 7 compatible format
     D2D1_ALPHA_MODE_IGNORE       // Ignore alpha
   );
-
-  // Create bitmap with the same size as dim (not the window size)
-  D2D1_SIZE_U bitmapSize = D2D1::SizeU(width, height);
   D2D1_BITMAP_PROPERTIES bitmapProps = D2D1::BitmapProperties(pixelFormat);
-  
+
   // Create an empty bitmap initially
-  hr = m_pRenderTarget->CreateBitmap(
-    bitmapSize,
+  HRESULT hr = m_pRenderTarget->CreateBitmap(
+    *size,
     NULL,
     0,
     bitmapProps,
@@ -462,25 +753,11 @@ void Direct2DSection::initDirect2D(const PixelFormat *pf, const Dimension *dim,
 
   if (FAILED(hr)) {
     DEBUG_LOG("Failed to create Direct2D bitmap, HRESULT: 0x%lx", hr);
+    m_pBitmap = NULL;
     throw SystemException(_T("Failed to create Direct2D bitmap"));
   }
-  DEBUG_LOG("Direct2D bitmap created successfully");
-
-  // Allocate memory for bitmap data
-  m_bitmapBits = malloc(width * height * 4);
-  if (m_bitmapBits == NULL) {
-    DEBUG_LOG("Failed to allocate bitmap data buffer");
-    throw SystemException(_T("Failed to allocate bitmap data buffer"));
-  }
-  
-  // Initialize the bitmap buffer with black
-  memset(m_bitmapBits, 0, width * height * 4);
-  
-  // Draw a test pattern to the Direct2D render target to make sure it works
-  m_pRenderTarget->BeginDraw();
-  m_pRenderTarget->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 1.0f)); // Black
-  HRESULT testResult = m_pRenderTarget->EndDraw();
-  DEBUG_LOG("Test pattern draw result: 0x%lx", testResult);
+  m_bitmapSize = *size;
+  DEBUG_LOG("Direct2D bitmap %ux%u created successfully", size->width, size->height);
 }
 
 /**
@@ -491,17 +768,39 @@ void Direct2DSection::releaseDirect2D()
   DEBUG_LOG("releaseDirect2D called");
   
   // Free bitmap data buffer
+  m_bufferFb.setBuffer(0);
   if (m_bitmapBits) {
     free(m_bitmapBits);
     m_bitmapBits = NULL;
   }
 
+  m_bufferCapacity = 0;
+
   // Release Direct2D resources
+  releaseTarget();
+
+  if (m_pD2DFactory) {
+    m_pD2DFactory->Release();
+    m_pD2DFactory = NULL;
+  }
+  DEBUG_LOG("All Direct2D resources released");
+}
+
+void Direct2DSection::releaseTarget()
+{
+  for (size_t i = 0; i < OVERLAY_LAYERS; i++) {
+    clearOverlay(i);
+  }
+  if (m_pScratchBitmap) {
+    m_pScratchBitmap->Release();
+    m_pScratchBitmap = NULL;
+    m_scratchSize = D2D1::SizeU(0, 0);
+  }
   if (m_pBitmap) {
     m_pBitmap->Release();
     m_pBitmap = NULL;
   }
-  
+
   // Release the render target (works for both HwndRenderTarget and DCRenderTarget)
   if (m_pRenderTarget) {
     m_pRenderTarget->Release();
@@ -509,15 +808,127 @@ void Direct2DSection::releaseDirect2D()
     m_pDCRenderTarget = NULL;
     m_pHwndRenderTarget = NULL;
   }
-  
-  if (m_pD2DFactory) {
-    m_pD2DFactory->Release();
-    m_pD2DFactory = NULL;
+}
+
+void Direct2DSection::onTargetLost()
+{
+  DEBUG_LOG("The render target has been lost, it will be recreated");
+  releaseTarget();
+  {
+    AutoLock al(&m_dirtyLock);
+    // The buffer has all the pixels but the stale ones, they are taken from
+    // the caller again. The rest is restored by one upload of the whole
+    // buffer to the new bitmap.
+    m_lostRegion.add(&m_staleRegion);
+    m_staleRegion.clear();
+    Rect bufferRect = getBufferRect();
+    m_dirtyRegion.clear();
+    m_dirtyRegion.addRect(&bufferRect);
   }
-  DEBUG_LOG("All Direct2D resources released");
+  restoreTarget();
+  // The frame that has failed is drawn again.
+  InvalidateRect(m_hwnd, NULL, FALSE);
+}
+
+bool Direct2DSection::restoreTarget()
+{
+  if (m_pRenderTarget != NULL && m_pBitmap != NULL) {
+    return true;
+  }
+  if (m_pD2DFactory == NULL || m_bitmapBits == NULL) {
+    return false;
+  }
+  try {
+    if (m_pRenderTarget == NULL) {
+      createRenderTarget();
+    }
+    // The bitmap keeps its size, which may be larger than the buffer.
+    createBitmap(&m_bitmapSize);
+  } catch (SystemException &e) {
+    DEBUG_LOG("Cannot restore the render target: %s", e.getMessage());
+    releaseTarget();
+    return false;
+  }
+  return true;
+}
+
+void Direct2DSection::setBufferProperties(const PixelFormat *pf, const Dimension *dim)
+{
+  DEBUG_LOG("setBufferProperties: %dx%d, %d bpp", dim->width, dim->height,
+            (int)pf->bitsPerPixel);
+  UINT width = std::max(1, dim->width);
+  UINT height = std::max(1, dim->height);
+
+  for (size_t i = 0; i < OVERLAY_LAYERS; i++) {
+    clearOverlay(i);
+  }
+
+  // The bitmap only grows, so that shrinking and growing the desktop back
+  // does not allocate it every time.
+  if (width > m_bitmapSize.width || height > m_bitmapSize.height) {
+    if (m_pBitmap) {
+      m_pBitmap->Release();
+      m_pBitmap = NULL;
+    }
+    m_bitmapSize = D2D1::SizeU(std::max(width, m_bitmapSize.width),
+                               std::max(height, m_bitmapSize.height));
+    if (m_pRenderTarget != NULL) {
+      createBitmap(&m_bitmapSize);
+    }
+  }
+
+  size_t bufferSize = width * height * (pf->bitsPerPixel / 8);
+  if (bufferSize > m_bufferCapacity) {
+    m_bufferFb.setBuffer(0);
+    free(m_bitmapBits);
+    m_bitmapBits = malloc(bufferSize);
+    m_bufferCapacity = bufferSize;
+    if (m_bitmapBits == NULL) {
+      DEBUG_LOG("Failed to allocate bitmap data buffer");
+      m_bufferCapacity = 0;
+      throw SystemException(_T("Failed to allocate bitmap data buffer"));
+    }
+  }
+  m_width = dim->width;
+  m_height = dim->height;
+  m_bufferFb.setPropertiesWithoutResize(dim, pf);
+  m_bufferFb.setBuffer(m_bitmapBits);
+
+  PixelFormat bitmapPf = StandardPixelFormatFactory::create32bppPixelFormat();
+  m_needsConversion = !pf->isEqualTo(&bitmapPf);
+  if (m_needsConversion) {
+    m_converter.setPixelFormats(&bitmapPf, pf);
+  }
+
+  memset(m_bitmapBits, 0, bufferSize);
+  AutoLock al(&m_dirtyLock);
+  Rect bufferRect = getBufferRect();
+  m_dirtyRegion.clear();
+  m_dirtyRegion.addRect(&bufferRect);
+  m_staleRegion.clear();
+  m_lostRegion.clear();
+}
+
+void Direct2DSection::takeLostRegion(Region *lost)
+{
+  AutoLock al(&m_dirtyLock);
+  lost->swap(&m_lostRegion);
+  m_lostRegion.clear();
+}
+
+Rect Direct2DSection::getBufferRect() const
+{
+  Dimension dim = m_bufferFb.getDimension();
+  Rect bufferRect(std::min((int)m_bitmapSize.width, dim.width),
+                  std::min((int)m_bitmapSize.height, dim.height));
+  return bufferRect;
 }
 
 void Direct2DSection::resize(const Rect* newSize) {
+  if (!restoreTarget()) {
+    // The new target gets the size of the window when it is created.
+    return;
+  }
   RECT rect = newSize->toWindowsRect();
 
   UINT newWidth = rect.right - rect.left;
@@ -32,6 +32,10 @@
 #include <d2d1helper.h>
 // No need for newer D2D headers that aren't in Windows 7 SDK
 #include "win-system/Screen.h"
+#include "region/Region.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelConverter.h"
+#include "thread/LocalMutex.h"
 
 // Link with Windows 7 SDK compatible Direct2D libraries
 #pragma comment(lib, "d2d1.lib")
@@ -66,6 +70,58 @@ public:
 
   void resize(const Rect* rect);
 
+  // Changes the buffer to the new pixel format and dimension, black, for a
+  // new frame buffer of the server. The render target is kept, and the
+  // bitmap and the memory of the buffer are only reallocated when they are
+  // too small for the new dimension. The overlays are cleared.
+  void setBufferProperties(const PixelFormat *pf, const Dimension *dim);
+
+  // Moves to lost the parts of the picture that were uploaded or copied
+  // past the buffer (see uploadFrom() and copyRect()) and then lost with
+  // the render target, so the buffer is stale there and the caller has to
+  // supply the pixels again. The rest of the picture is restored from the
+  // buffer by itself.
+  void takeLostRegion(Region *lost);
+
+  // Marks the rectangle of the buffer as changed. Only the changed parts
+  // are uploaded to the Direct2D bitmap on the next rendering, all of them
+  // at once. May be called from any thread.
+  void invalidate(const Rect *rect);
+
+  // Uploads the rectangle straight from other memory of the same pixel
+  // format to the Direct2D bitmap, bypassing the buffer, which is left
+  // stale there. bits points to the first pixel of the rectangle. Not
+  // supported for pixel formats that need conversion.
+  // Must be serialized with the rendering by the caller.
+  // Returns false if the bitmap could not be updated.
+  bool uploadFrom(const Rect *rect, const void *bits, UINT32 stride);
+
+  // Copies the rectangle of the Direct2D bitmap whose top-left corner is
+  // (srcX, srcY) to dstRect on the GPU, the way CopyRect moves it, so a
+  // scroll needs no upload. The buffer is left stale at dstRect, as by
+  // uploadFrom(). Fails if the source has changed parts not uploaded yet.
+  // Must be serialized with the rendering by the caller.
+  // Returns false if the bitmap could not be updated.
+  bool copyRect(const Rect *dstRect, int srcX, int srcY);
+
+  // Number of independent overlays. They are drawn in the order of their
+  // layers, so a higher layer covers a lower one.
+  static const size_t OVERLAY_LAYERS = 2;
+
+  // Draws the image over the buffer at the rectangle (in buffer
+  // coordinates) on every rendering, without changing the buffer. The image
+  // must be in the standard 32-bit format with premultiplied alpha, which is
+  // used for blending. The image is uploaded to the GPU only when the
+  // overlay is set for a new rectangle, so it must not change while the
+  // rectangle stays the same (call clearOverlay() to replace it).
+  // Must be serialized with the rendering by the caller.
+  // Returns false if the overlay could not be set.
+  bool setOverlay(size_t layer, const FrameBuffer *image, const Rect *rect);
+  // Moves the uploaded image of the layer to the new top-left corner
+  // without uploading it again. Returns false if the layer has no image.
+  bool moveOverlay(size_t layer, int x, int y);
+  void clearOverlay(size_t layer);
+
 private:
   // Initialize Direct2D factory and resources
   void initDirect2D(const PixelFormat *pf, const Dimension *dim, HWND compatibleWin);
@@ -73,8 +129,29 @@ private:
   // Release Direct2D resources
   void releaseDirect2D();
 
-  // Creates a Direct2D bitmap compatible with the screen format
-  void createBitmap(const PixelFormat *pf, const Dimension *dim);
+  // Creates the render target for m_hwnd. Throws SystemException on a
+  // failure.
+  void createRenderTarget();
+
+  // Creates m_pBitmap of the size in the 32-bit format of the render
+  // target. Throws SystemException on a failure.
+  void createBitmap(const D2D1_SIZE_U *size);
+
+  // Releases the resources of the render target: the overlays, the scratch
+  // bitmap, the bitmap and the target itself.
+  void releaseTarget();
+
+  // Called when the render target has been lost (D2DERR_RECREATE_TARGET).
+  // Releases it and marks the whole buffer to be uploaded to the new one.
+  void onTargetLost();
+
+  // Creates the render target and the bitmap again after they have been
+  // lost. Returns false if they cannot be created yet.
+  bool restoreTarget();
+
+  // Returns the part of the bitmap which holds the buffer. The bitmap may
+  // be larger.
+  Rect getBufferRect() const;
 
   // Captures screen content to the Direct2D bitmap with specified flags
   void blitToDibSection(const Rect *rect, DWORD flags);
@@ -88,18 +165,59 @@ private:
   // Helper function to update a Direct2D bitmap from DIB section memory
   bool UpdateBitmapFromDIB(ID2D1Bitmap* pBitmap, const Rect* rect, void* dibBits, UINT dibStride);
 
+  // Copies the invalidated parts of the buffer to the Direct2D bitmap.
+  // Returns false if the bitmap could not be updated.
+  bool uploadDirtyRects();
+
+  // Draws the overlays, if any, for the buffer area srcArea drawn to dstArea
+  // of the render target. Must be called between BeginDraw() and EndDraw().
+  void drawOverlays(const D2D1_RECT_F *srcArea, const D2D1_RECT_F *dstArea);
+
   // Direct2D resources
   ID2D1Factory* m_pD2DFactory;
   ID2D1RenderTarget* m_pRenderTarget;  // Use base interface to support different render target types
   ID2D1HwndRenderTarget* m_pHwndRenderTarget;
   ID2D1DCRenderTarget* m_pDCRenderTarget;
   ID2D1Bitmap* m_pBitmap;
+  // The source of copyRect() is copied here first, because the bitmap
+  // cannot be copied to itself when the rectangles overlap. It is grown on
+  // demand.
+  ID2D1Bitmap* m_pScratchBitmap;
+  D2D1_SIZE_U m_scratchSize;
+
+  // Images blended over the buffer on rendering and their places in the
+  // buffer, by layer.
+  ID2D1Bitmap* m_pOverlayBitmaps[OVERLAY_LAYERS];
+  Rect m_overlayRects[OVERLAY_LAYERS];
 
   HWND m_hwnd;
   
   // Direct bitmap buffer (replaces GDI resources)
   void* m_bitmapBits;
 
+  // Number of bytes allocated for m_bitmapBits, it may be more than the
+  // buffer needs.
+  size_t m_bufferCapacity;
+  // Size of m_pBitmap, also kept while the bitmap is lost with the render
+  // target.
+  D2D1_SIZE_U m_bitmapSize;
+
+  // Parts of m_bitmapBits changed since the last upload to m_pBitmap.
+  Region m_dirtyRegion;
+  // Parts of m_pBitmap newer than m_bitmapBits and parts of them lost with
+  // the render target.
+  Region m_staleRegion;
+  Region m_lostRegion;
+  // Guards the regions.
+  LocalMutex m_dirtyLock;
+
+  // m_bitmapBits holds pixels of the frame buffer's own format. Formats
+  // other than the 32-bit one of the bitmap are converted when uploading,
+  // only for the changed rectangles.
+  FrameBuffer m_bufferFb;
+  PixelConverter m_converter;
+  bool m_needsConversion;
+
   // render information
   int m_width;
   int m_height;
@@ -36,6 +36,8 @@ InputInjector::InputInjector(bool ctrlAltDelEnabled, LogWriter *log)
   m_shiftIsPressed(false),
   m_winIsPressed(false),
   m_ctrlAltDelEnabled(ctrlAltDelEnabled),
+  m_batchDepth(0),
+  m_batchChangesLayout(false),
   m_log(log)
 {
   // FIXME: Better to call this function from an owner (Now, its
@@ -69,6 +71,22 @@ void InputInjector::injectKeyRelease(BYTE vkCode)
 }
 
 void InputInjector::injectKeyEvent(BYTE vkCode, bool release, bool extended)
+{
+  // Layouts are switched on releasing of the modifiers.
+  if (m_batchDepth > 0 &&
+      (vkCode == VK_CAPITAL ||
+       release && (vkCode == VK_MENU || vkCode == VK_LMENU ||
+                   vkCode == VK_RMENU || vkCode == VK_SHIFT ||
+                   vkCode == VK_LSHIFT || vkCode == VK_RSHIFT ||
+                   vkCode == VK_CONTROL || vkCode == VK_LCONTROL ||
+                   vkCode == VK_RCONTROL || vkCode == VK_LWIN ||
+                   vkCode == VK_RWIN))) {
+    m_batchChangesLayout = true;
+  }
+  injectKey(vkCode, release, extended);
+}
+
+void InputInjector::injectKey(BYTE vkCode, bool release, bool extended)
 {
   m_log->debug(_T("Prepare to inject the key event:")
              _T(" vkCode = %d, release = %d, extended = %d"),
@@ -118,6 +136,8 @@ void InputInjector::injectKeyEvent(BYTE vkCode, bool release, bool extended)
       !m_winIsPressed && !m_shiftIsPressed) {
     if (m_ctrlAltDelEnabled) {
       m_log->debug(_T("Try simulate the Ctrl+Alt+Del combination"));
+      // The combination must follow the events held back.
+      flushBatch();
       if (Environment::isVistaOrLater()) {
         Environment::simulateCtrlAltDelUnderVista(m_log);
       }
@@ -142,15 +162,60 @@ void InputInjector::injectKeyEvent(BYTE vkCode, bool release, bool extended)
       keyEvent.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
     }
 
-    if (SendInput(1, &keyEvent, sizeof(keyEvent)) == 0) {
-      DWORD errCode = GetLastError();
-      if (errCode != ERROR_SUCCESS) {
-        throw SystemException(_T("SendInput() function failed:"), errCode);
-      } else {
-        // Under Vista or later the SendInput() function doesn't return error
-        // code if inputs blocked by UIPI.
-        throw Exception(_T("SendInput() function failed"));
-      }
+    injectInput(&keyEvent);
+  }
+}
+
+void InputInjector::injectInput(const INPUT *input)
+{
+  if (m_batchDepth == 0) {
+    sendInputs(input, 1);
+    return;
+  }
+  m_batch.push_back(*input);
+  if (m_batch.size() >= MAX_BATCH_SIZE) {
+    flushBatch();
+  }
+}
+
+void InputInjector::beginBatch()
+{
+  m_batchDepth++;
+}
+
+void InputInjector::endBatch()
+{
+  if (m_batchDepth > 0) {
+    m_batchDepth--;
+  }
+  if (m_batchDepth == 0) {
+    flushBatch();
+  }
+}
+
+void InputInjector::flushBatch()
+{
+  m_batchChangesLayout = false;
+  if (m_batch.empty()) {
+    return;
+  }
+  // The batch is dropped even if it fails, as after a failed single event.
+  std::vector<INPUT> batch;
+  batch.swap(m_batch);
+  m_log->debug(_T("Injecting %u input events"), (unsigned int)batch.size());
+  sendInputs(&batch.front(), (UINT)batch.size());
+}
+
+void InputInjector::sendInputs(const INPUT *inputs, UINT count)
+{
+  if (SendInput(count, const_cast<INPUT *>(inputs), sizeof(INPUT)) != count) {
+    DWORD errCode = GetLastError();
+    if (errCode != ERROR_SUCCESS) {
+      throw SystemException(_T("SendInput() function failed:"), errCode);
+    } else {
+      // Under Vista or later the SendInput() function doesn't return error
+      // code if inputs blocked by UIPI.
+      throw Exception(_T("SendInput() function failed"));
     }
   }
 }
@@ -160,6 +225,12 @@ void InputInjector::injectCharEvent(WCHAR ch, bool release)
   m_log->debug(_T("Try insert a char event: char = %d, release = %d"),
              (int)ch, (int)release);
 
+  // The layout and the caps lock state must be read after the events
+  // that may change them.
+  if (m_batchChangesLayout) {
+    flushBatch();
+  }
+
   bool ctrlOrAltPressed = m_controlIsPressed || m_menuIsPressed;
   SHORT vkKeyScanResult = 0;
   HKL hklCurrent = (HKL)0x04090409;
@@ -187,9 +258,7 @@ void InputInjector::injectCharEvent(WCHAR ch, bool release)
       keyEvent.ki.dwFlags |= KEYEVENTF_KEYUP;
     }
 
-    if (SendInput(1, &keyEvent, sizeof(keyEvent)) == 0) {
-      throw SystemException();
-    }
+    injectInput(&keyEvent);
     return;
   }
   bool controlSym;
@@ -242,27 +311,27 @@ void InputInjector::injectCharEvent(WCHAR ch, bool release)
              (int)altPressNeeded);
 
   if (ctrlPressNeeded) {
-    injectKeyEvent(VK_CONTROL, false);
+    injectKey(VK_CONTROL, false, false);
   }
   if (altPressNeeded) {
-    injectKeyEvent(VK_MENU, false);
+    injectKey(VK_MENU, false, false);
   }
   if (shiftPressNeeded) {
-    injectKeyEvent(VK_SHIFT, false);
+    injectKey(VK_SHIFT, false, false);
   } else if (shiftUpNeeded) {
-    injectKeyEvent(VK_SHIFT, true);
+    injectKey(VK_SHIFT, true, false);
   }
-  injectKeyEvent(vkKeyScanResult & 255, release);
+  injectKey(vkKeyScanResult & 255, release, false);
   if (shiftPressNeeded) {
-    injectKeyEvent(VK_SHIFT, true);
+    injectKey(VK_SHIFT, true, false);
   } else if (shiftUpNeeded) {
-    injectKeyEvent(VK_SHIFT, false);
+    injectKey(VK_SHIFT, false, false);
   }
   if (altPressNeeded) {
-    injectKeyEvent(VK_MENU, true);
+    injectKey(VK_MENU, true, false);
   }
   if (ctrlPressNeeded) {
-    injectKeyEvent(VK_CONTROL, true);
+    injectKey(VK_CONTROL, true, false);
   }
 }
 
@@ -29,6 +29,8 @@
 #include "log-writer/LogWriter.h"
 #include "SystemException.h"
 
+#include <vector>
+
 /**
  * Wrapper of WinAPI methods that can inject input events into system
  * (mouse, keyboard etc) and get information about input device states.
@@ -75,7 +77,35 @@ public:
    */
   void injectCharEvent(WCHAR ch, bool release) throw(SystemException);
 
+  /**
+   * Injects an input event prepared by the caller, e.g. a mouse event.
+   * @throws SystemException on fail.
+   */
+  void injectInput(const INPUT *input);
+
+  /**
+   * Starts holding the injected events back, to pass them to the system
+   * by one SendInput() call in endBatch(). The events keep their order.
+   * Batches may overlap, the events are injected when the last one ends.
+   */
+  void beginBatch();
+
+  /**
+   * Injects the events held back since beginBatch() and stops holding them.
+   * @throws SystemException on fail.
+   */
+  void endBatch();
+
 private:
+  // Injects the key event without noting its effect on the batch.
+  void injectKey(BYTE vkCode, bool release, bool extended);
+
+  // Passes the held events to the system.
+  void flushBatch();
+
+  // Calls SendInput() for the events.
+  void sendInputs(const INPUT *inputs, UINT count);
+
   // Return true if CapsLock toggled on.
   bool capsToggled();
 
@@ -116,6 +146,9 @@ private:
    */
   static const BYTE EXTENDED_KEYS[];
 
+  // The batch is passed to the system when it grows to this number of events.
+  static const size_t MAX_BATCH_SIZE = 256;
+
   bool m_controlIsPressed;
   bool m_menuIsPressed;
   bool m_deleteIsPressed;
@@ -123,6 +156,13 @@ private:
   bool m_winIsPressed;
   bool m_ctrlAltDelEnabled;
 
+  // Number of the batches begun and not ended.
+  int m_batchDepth;
+  std::vector<INPUT> m_batch;
+  // Flag is set when a held event may change the caps lock state or the
+  // keyboard layout, which are read to translate characters.
+  bool m_batchChangesLayout;
+
   LogWriter *m_log;
 };
 
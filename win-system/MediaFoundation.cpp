@@ -0,0 +1,165 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "MediaFoundation.h"
+
+#pragma comment(lib, "mfuuid.lib")
+
+MediaFoundation::MediaFoundation()
+: m_mfplatLib(_T("mfplat.dll")),
+  m_ole32Lib(_T("ole32.dll")),
+  m_coDecrementMTAUsage(0),
+  m_mtaCookie(0)
+{
+  MFStartupFunType mfStartup =
+    (MFStartupFunType)m_mfplatLib.getProcAddress("MFStartup");
+  m_mfShutdown = (MFShutdownFunType)m_mfplatLib.getProcAddress("MFShutdown");
+  m_mftEnumEx = (MFTEnumExFunType)m_mfplatLib.getProcAddress("MFTEnumEx");
+  m_mfCreateMediaType =
+    (MFCreateMediaTypeFunType)m_mfplatLib.getProcAddress("MFCreateMediaType");
+  m_mfCreateSample =
+    (MFCreateSampleFunType)m_mfplatLib.getProcAddress("MFCreateSample");
+  m_mfCreateMemoryBuffer = (MFCreateMemoryBufferFunType)
+    m_mfplatLib.getProcAddress("MFCreateMemoryBuffer");
+  if (mfStartup == 0 || m_mfShutdown == 0 || m_mftEnumEx == 0 ||
+      m_mfCreateMediaType == 0 || m_mfCreateSample == 0 ||
+      m_mfCreateMemoryBuffer == 0) {
+    throw Exception(_T("Unable to load the Media Foundation functions"));
+  }
+
+  HRESULT hr = mfStartup(MF_VERSION, MFSTARTUP_LITE);
+  if (FAILED(hr)) {
+    throw Exception(_T("MFStartup() failed, error code = %x"), (unsigned)hr);
+  }
+
+  // Windows 8 and later do not keep the multithreaded apartment without
+  // an explicit request. On Windows 7 the Media Foundation work queue
+  // threads hold it.
+  CoIncrementMTAUsageFunType coIncrementMTAUsage = (CoIncrementMTAUsageFunType)
+    m_ole32Lib.getProcAddress("CoIncrementMTAUsage");
+  CoDecrementMTAUsageFunType coDecrementMTAUsage = (CoDecrementMTAUsageFunType)
+    m_ole32Lib.getProcAddress("CoDecrementMTAUsage");
+  if (coIncrementMTAUsage != 0 && coDecrementMTAUsage != 0 &&
+      SUCCEEDED(coIncrementMTAUsage(&m_mtaCookie))) {
+    m_coDecrementMTAUsage = coDecrementMTAUsage;
+  }
+}
+
+MediaFoundation::~MediaFoundation()
+{
+  m_mfShutdown();
+  if (m_coDecrementMTAUsage != 0) {
+    m_coDecrementMTAUsage(m_mtaCookie);
+  }
+}
+
+IMFTransform *MediaFoundation::createTransform(const GUID &category,
+                                               const GUID &inputSubtype,
+                                               const GUID &outputSubtype,
+                                               bool hardware)
+{
+  IMFTransform *transform = 0;
+  if (hardware) {
+    transform = activateTransform(category,
+                                  MFT_ENUM_FLAG_HARDWARE |
+                                  MFT_ENUM_FLAG_SORTANDFILTER,
+                                  inputSubtype, outputSubtype);
+  }
+  if (transform == 0) {
+    transform = activateTransform(category,
+                                  MFT_ENUM_FLAG_SYNCMFT |
+                                  MFT_ENUM_FLAG_LOCALMFT |
+                                  MFT_ENUM_FLAG_SORTANDFILTER,
+                                  inputSubtype, outputSubtype);
+  }
+  if (transform == 0) {
+    throw Exception(_T("No suitable Media Foundation transform found"));
+  }
+  return transform;
+}
+
+IMFTransform *MediaFoundation::activateTransform(const GUID &category,
+                                                 UINT32 flags,
+                                                 const GUID &inputSubtype,
+                                                 const GUID &outputSubtype)
+{
+  MFT_REGISTER_TYPE_INFO inputType = { MFMediaType_Video, inputSubtype };
+  MFT_REGISTER_TYPE_INFO outputType = { MFMediaType_Video, outputSubtype };
+
+  IMFActivate **activates = 0;
+  UINT32 count = 0;
+  HRESULT hr = m_mftEnumEx(category, flags, &inputType, &outputType,
+                           &activates, &count);
+  if (FAILED(hr)) {
+    return 0;
+  }
+
+  // Take the first transform that can be activated.
+  IMFTransform *transform = 0;
+  for (UINT32 i = 0; i < count; i++) {
+    if (transform == 0) {
+      hr = activates[i]->ActivateObject(__uuidof(IMFTransform),
+                                        (void **)&transform);
+      if (FAILED(hr)) {
+        transform = 0;
+      }
+    }
+    activates[i]->Release();
+  }
+  CoTaskMemFree(activates);
+  return transform;
+}
+
+IMFMediaType *MediaFoundation::createMediaType()
+{
+  IMFMediaType *mediaType;
+  HRESULT hr = m_mfCreateMediaType(&mediaType);
+  if (FAILED(hr)) {
+    throw Exception(_T("MFCreateMediaType() failed, error code = %x"),
+                    (unsigned)hr);
+  }
+  return mediaType;
+}
+
+IMFSample *MediaFoundation::createSample()
+{
+  IMFSample *sample;
+  HRESULT hr = m_mfCreateSample(&sample);
+  if (FAILED(hr)) {
+    throw Exception(_T("MFCreateSample() failed, error code = %x"),
+                    (unsigned)hr);
+  }
+  return sample;
+}
+
+IMFMediaBuffer *MediaFoundation::createMemoryBuffer(DWORD maxLength)
+{
+  IMFMediaBuffer *buffer;
+  HRESULT hr = m_mfCreateMemoryBuffer(maxLength, &buffer);
+  if (FAILED(hr)) {
+    throw Exception(_T("MFCreateMemoryBuffer() failed, error code = %x"),
+                    (unsigned)hr);
+  }
+  return buffer;
+}
@@ -0,0 +1,114 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the TightVNC software.  Please visit our Web site:
+//
+//                       http://www.tightvnc.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef __MEDIAFOUNDATION_H__
+#define __MEDIAFOUNDATION_H__
+
+#include "util/CommonHeader.h"
+#include "win-system/DynamicLibrary.h"
+
+// The Media Foundation declarations used here are only visible when
+// targeting Windows 7 or 8 (the codec properties), while the rest of the
+// code targets Windows XP. All of the functions are loaded at run time and
+// unsupported codec properties are ignored, so that is safe.
+#pragma push_macro("WINVER")
+#pragma push_macro("_WIN32_WINNT")
+#undef WINVER
+#undef _WIN32_WINNT
+#define WINVER 0x0602
+#define _WIN32_WINNT 0x0602
+#include <mfapi.h>
+#include <mftransform.h>
+#include <mferror.h>
+#include <strmif.h>
+#include <codecapi.h>
+#pragma pop_macro("_WIN32_WINNT")
+#pragma pop_macro("WINVER")
+
+// MediaFoundation loads the Media Foundation platform (mfplat.dll) at run
+// time and keeps it started for the object life time. Loading it dynamically
+// lets the programs work on systems without Media Foundation (Windows XP,
+// "N" editions): the constructor throws an Exception there, and the callers
+// fall back to other encodings.
+//
+// Transforms created by the object are free-threaded. The object keeps
+// the multithreaded COM apartment alive, so they can be used and released
+// from any thread without calling CoInitializeEx() there.
+class MediaFoundation
+{
+public:
+  MediaFoundation();
+  virtual ~MediaFoundation();
+
+  // Creates the first transform of the category that converts inputSubtype
+  // to outputSubtype. Hardware transforms are preferred if hardware is true.
+  // The caller must release the returned object.
+  // Throws Exception if there is no suitable transform.
+  IMFTransform *createTransform(const GUID &category,
+                                const GUID &inputSubtype,
+                                const GUID &outputSubtype,
+                                bool hardware);
+
+  // The functions below throw Exception on failure, the caller must release
+  // the returned objects.
+  IMFMediaType *createMediaType();
+  IMFSample *createSample();
+  IMFMediaBuffer *createMemoryBuffer(DWORD maxLength);
+
+private:
+  IMFTransform *activateTransform(const GUID &category, UINT32 flags,
+                                  const GUID &inputSubtype,
+                                  const GUID &outputSubtype);
+
+  typedef HRESULT (WINAPI *MFStartupFunType)(ULONG, DWORD);
+  typedef HRESULT (WINAPI *MFShutdownFunType)();
+  typedef HRESULT (WINAPI *MFTEnumExFunType)(GUID, UINT32,
+                                              const MFT_REGISTER_TYPE_INFO *,
+                                              const MFT_REGISTER_TYPE_INFO *,
+                                              IMFActivate ***, UINT32 *);
+  typedef HRESULT (WINAPI *MFCreateMediaTypeFunType)(IMFMediaType **);
+  typedef HRESULT (WINAPI *MFCreateSampleFunType)(IMFSample **);
+  typedef HRESULT (WINAPI *MFCreateMemoryBufferFunType)(DWORD,
+                                                         IMFMediaBuffer **);
+  typedef HRESULT (WINAPI *CoIncrementMTAUsageFunType)(void **);
+  typedef HRESULT (WINAPI *CoDecrementMTAUsageFunType)(void *);
+
+  DynamicLibrary m_mfplatLib;
+  DynamicLibrary m_ole32Lib;
+
+  MFShutdownFunType m_mfShutdown;
+  MFTEnumExFunType m_mftEnumEx;
+  MFCreateMediaTypeFunType m_mfCreateMediaType;
+  MFCreateSampleFunType m_mfCreateSample;
+  MFCreateMemoryBufferFunType m_mfCreateMemoryBuffer;
+  CoDecrementMTAUsageFunType m_coDecrementMTAUsage;
+
+  void *m_mtaCookie;
+
+  // Do not allow copying objects.
+  MediaFoundation(const MediaFoundation &other);
+  MediaFoundation &operator=(const MediaFoundation &other);
+};
+
+#endif // __MEDIAFOUNDATION_H__
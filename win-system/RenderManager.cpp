@@ -48,7 +48,8 @@ RenderManager::RenderManager(const PixelFormat *pf, const Dimension *dim,
     m_direct2DSection(NULL),
     m_pixelFormat(*pf),
     m_dimension(*dim),
-    m_window(compatibleWin)
+    m_window(compatibleWin),
+    m_qualityScaling(false)
 {
   DEBUG_LOG("RenderManager constructor - mode: %s, window: %p, dimensions: %dx%d", 
            (mode == RENDER_MODE_DIRECT2D ? "Direct2D" : "GDI"), 
@@ -146,6 +147,74 @@ void RenderManager::stretchFromDibSection(const Rect *srcRect, const Rect *dstRe
   }
 }
 
+bool RenderManager::drawToDC(HDC dc, const Rect *dstRect, const Rect *srcRect)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D || m_dibSection == NULL) {
+    return false;
+  }
+  if (dstRect->getWidth() == srcRect->getWidth() &&
+      dstRect->getHeight() == srcRect->getHeight()) {
+    m_dibSection->setBitsToDevice(dc, dstRect, srcRect->left, srcRect->top);
+  } else {
+    m_dibSection->stretchToDevice(dc, dstRect, srcRect);
+  }
+  return true;
+}
+
+void RenderManager::setQualityScaling(bool enabled)
+{
+  m_qualityScaling = enabled;
+  if (m_dibSection) {
+    m_dibSection->setQualityScaling(enabled);
+  }
+}
+
+void RenderManager::invalidate(const Rect *rect)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    m_direct2DSection->invalidate(rect);
+  }
+}
+
+bool RenderManager::uploadFrom(const Rect *rect, const void *bits, UINT32 stride)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    return m_direct2DSection->uploadFrom(rect, bits, stride);
+  }
+  return false;
+}
+
+bool RenderManager::copyRect(const Rect *dstRect, int srcX, int srcY)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    return m_direct2DSection->copyRect(dstRect, srcX, srcY);
+  }
+  return false;
+}
+
+bool RenderManager::setOverlay(size_t layer, const FrameBuffer *image, const Rect *rect)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    return m_direct2DSection->setOverlay(layer, image, rect);
+  }
+  return false;
+}
+
+bool RenderManager::moveOverlay(size_t layer, int x, int y)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    return m_direct2DSection->moveOverlay(layer, x, y);
+  }
+  return false;
+}
+
+void RenderManager::clearOverlay(size_t layer)
+{
+  if (m_direct2DSection) {
+    m_direct2DSection->clearOverlay(layer);
+  }
+}
+
 /**
  * Changes the rendering mode between GDI and Direct2D
  * 
@@ -256,6 +325,9 @@ void RenderManager::createRenderer()
       throw; // Re-throw for GDI failures
     }
   }
+  if (m_dibSection) {
+    m_dibSection->setQualityScaling(m_qualityScaling);
+  }
 }
 
 /**
@@ -314,6 +386,39 @@ bool RenderManager::isD2DAvailable()
   return false;
 }
 
+bool RenderManager::setBufferProperties(const PixelFormat *pf, const Dimension *dim,
+                                        HWND compatibleWin)
+{
+  if (compatibleWin != m_window) {
+    return false;
+  }
+  DEBUG_LOG("setBufferProperties: %dx%d, mode=%s", dim->width, dim->height,
+           (m_mode == RENDER_MODE_DIRECT2D ? "Direct2D" : "GDI"));
+  m_pixelFormat = *pf;
+  m_dimension = *dim;
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    try {
+      m_direct2DSection->setBufferProperties(pf, dim);
+      return true;
+    } catch (SystemException &e) {
+      DEBUG_LOG("Cannot change the Direct2D buffer: %s, creating it again",
+                e.getMessage());
+    }
+  }
+  destroyRenderer();
+  createRenderer();
+  return true;
+}
+
+void RenderManager::takeLostRegion(Region *lost)
+{
+  if (m_mode == RENDER_MODE_DIRECT2D && m_direct2DSection) {
+    m_direct2DSection->takeLostRegion(lost);
+  } else {
+    lost->clear();
+  }
+}
+
 void RenderManager::resize(const Rect* newSize) {
   if (m_mode == RENDER_MODE_DIRECT2D) {
     m_direct2DSection->resize(newSize);
@@ -64,6 +64,40 @@ public:
   // Renders with stretching
   void stretchFromDibSection(const Rect *srcRect, const Rect *dstRect);
 
+  // Draws srcRect of the buffer to dstRect of the dc of a window being
+  // painted, clipped by its update region: straight from the bits if the
+  // rectangles are of the same size, stretched otherwise (see
+  // DibSection::setBitsToDevice() and DibSection::stretchToDevice()).
+  // Returns false in Direct2D mode, which draws to the window on its own.
+  bool drawToDC(HDC dc, const Rect *dstRect, const Rect *srcRect);
+
+  // Sets the filtering of the stretched images in GDI mode, see
+  // DibSection::setQualityScaling(). Kept across the renderer changes.
+  void setQualityScaling(bool enabled);
+
+  // Marks the rectangle of the buffer as changed since the last rendering.
+  // Direct2D uploads only the changed parts, GDI ignores this.
+  void invalidate(const Rect *rect);
+
+  // Uploads the rectangle from other memory of the buffer's pixel format
+  // straight to Direct2D. Returns false in GDI mode or on a failure, then
+  // the pixels must be copied to the buffer instead.
+  bool uploadFrom(const Rect *rect, const void *bits, UINT32 stride);
+
+  // Moves the rectangle of the rendered picture from (srcX, srcY) to
+  // dstRect without touching the buffer, see Direct2DSection::copyRect().
+  // Returns false in GDI mode or on a failure, then the buffer must be
+  // moved instead.
+  bool copyRect(const Rect *dstRect, int srcX, int srcY);
+
+  // Blends the image over the buffer at the rectangle on rendering, without
+  // changing the buffer, see Direct2DSection::setOverlay(). Returns false in
+  // GDI mode or on a failure, then the overlay must be drawn into the
+  // buffer instead.
+  bool setOverlay(size_t layer, const FrameBuffer *image, const Rect *rect);
+  bool moveOverlay(size_t layer, int x, int y);
+  void clearOverlay(size_t layer);
+
   // Get current render mode
   RenderMode getRenderMode() const { return m_mode; }
 
@@ -80,6 +114,19 @@ public:
   // NEW FUNCTION: handle resize
   void resize(const Rect* rect);
 
+  // Changes the buffer to the new pixel format and dimension, keeping the
+  // mode. Direct2D keeps its render target and reuses the bitmap and the
+  // memory if they are large enough, GDI creates a new DIB section.
+  // Returns false if the renderer is for another window, then nothing is
+  // changed.
+  bool setBufferProperties(const PixelFormat *pf, const Dimension *dim,
+                           HWND compatibleWin);
+
+  // Moves to lost the parts of the picture lost with the Direct2D render
+  // target that cannot be restored from the buffer, see
+  // Direct2DSection::takeLostRegion(). Leaves it empty in GDI mode.
+  void takeLostRegion(Region *lost);
+
 private:
   // Create/destroy render implementations
   void createRenderer();
@@ -96,6 +143,7 @@ private:
   PixelFormat m_pixelFormat;
   Dimension m_dimension;
   HWND m_window;
+  bool m_qualityScaling;
 };
 
 #endif // __RENDERMANAGER_H__ 
\ No newline at end of file
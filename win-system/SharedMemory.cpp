@@ -42,6 +42,18 @@ SharedMemory::SharedMemory(const TCHAR *name, size_t size)
   }
 }
 
+SharedMemory::SharedMemory(HANDLE hToMap)
+: m_hToMap(hToMap),
+  m_memory(0)
+{
+  try {
+    mapViewOfFile();
+  } catch (...) {
+    freeRes();
+    throw;
+  }
+}
+
 SharedMemory::~SharedMemory()
 {
   freeRes();
@@ -79,7 +91,8 @@ bool SharedMemory::createFile(const TCHAR *name, size_t size)
   // The first process to attach initializes memory
   bool needToInit = GetLastError() != ERROR_ALREADY_EXISTS;
 
-  if (needToInit) {
+  // An unnamed object is not reachable by name, so its access is left as is.
+  if (needToInit && name != 0) {
     setAllAccess(m_hToMap);
   }
 
@@ -32,10 +32,18 @@ class SharedMemory
 public:
   // @throw Exception
   SharedMemory(const TCHAR *name, size_t size);
+  // Maps the file mapping object by a handle assigned to this process and
+  // takes the ownership of the handle.
+  // @throw Exception
+  SharedMemory(HANDLE hToMap);
   virtual ~SharedMemory();
 
   void *getMemPointer() { return m_memory; }
 
+  // An unnamed object can be reached by other processes only by a handle
+  // assigned for them.
+  HANDLE getHandle() const { return m_hToMap; }
+
 protected:
   // Return true if need to init
   bool createFile(const TCHAR *name, size_t size);
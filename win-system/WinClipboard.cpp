@@ -100,6 +100,45 @@ bool WinClipboard::setString(const StringStorage *serverClipboard)
   return false;
 }
 
+bool WinClipboard::setDelayedString()
+{
+  if (!OpenClipboard(m_hWnd)) {
+    return false;
+  }
+  EmptyClipboard();
+  if (m_hndClipboard) {
+    GlobalFree(m_hndClipboard);
+    m_hndClipboard = 0;
+  }
+  SetClipboardData(getStringFormat(), NULL);
+  CloseClipboard();
+  return true;
+}
+
+bool WinClipboard::renderString(const StringStorage *str)
+{
+  StringStorage nativeClipboard = addCR(str);
+  size_t dataSize = (nativeClipboard.getLength() + 1) * sizeof(TCHAR);
+
+  // The system owns the rendered data.
+  HANDLE hndData = GlobalAlloc(GMEM_MOVEABLE, dataSize);
+  if (hndData == 0) {
+    return false;
+  }
+  CopyMemory(GlobalLock(hndData), nativeClipboard.getString(), dataSize);
+  GlobalUnlock(hndData);
+  if (SetClipboardData(getStringFormat(), hndData) == 0) {
+    GlobalFree(hndData);
+    return false;
+  }
+  return true;
+}
+
+UINT WinClipboard::getStringFormat() const
+{
+  return sizeof(TCHAR) == 1 ? CF_TEXT : CF_UNICODETEXT;
+}
+
 StringStorage WinClipboard::addCR(const StringStorage *str)
 {
   const TCHAR *beginString = str->getString();
@@ -42,6 +42,15 @@ public:
   // update windows clipboard
   bool setString(const StringStorage *str);
 
+  // Announces a string in the clipboard without its contents. The owner
+  // window gets WM_RENDERFORMAT when an application asks for it and then
+  // it must call renderString().
+  bool setDelayedString();
+
+  // Places the string announced with setDelayedString(), must be called
+  // on WM_RENDERFORMAT, when the clipboard is already opened.
+  bool renderString(const StringStorage *str);
+
 protected:
   static const TCHAR CR = _T('\r');
   static const TCHAR LF = _T('\n');
@@ -53,6 +62,9 @@ protected:
   // function replaced LF to CR+LF. If before LF already is CR, this not added second
   StringStorage addCR(const StringStorage *str);
 
+  // Returns the clipboard format of the native strings.
+  UINT getStringFormat() const;
+
   HANDLE m_hndClipboard;
   HWND m_hWnd;
 };
@@ -25,7 +25,13 @@
 #include "WindowsDisplays.h"
 #include "thread/AutoLock.h"
 
+volatile LONG WindowsDisplays::s_generation = 0;
+volatile bool WindowsDisplays::s_changeReported = false;
+
 WindowsDisplays::WindowsDisplays()
+: m_xVirtualScreen(0),
+  m_yVirtualScreen(0),
+  m_generation(-1)
 {
 }
 
@@ -50,9 +56,15 @@ BOOL CALLBACK WindowsDisplays::monitorEnumProc(HMONITOR hMonitor,
 void WindowsDisplays::update()
 {
   if (!isAlreadyUpdated()) {
+    // A change reported during the enumeration makes the result stale at
+    // once.
+    m_generation = s_generation;
     m_displayRects.clear();
     m_xVirtualScreen = GetSystemMetrics(SM_XVIRTUALSCREEN);
     m_yVirtualScreen = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    m_primaryRect.setRect(-m_xVirtualScreen, -m_yVirtualScreen,
+                          GetSystemMetrics(SM_CXSCREEN) - m_xVirtualScreen,
+                          GetSystemMetrics(SM_CYSCREEN) - m_yVirtualScreen);
 
     // Enumerate only desktop's displays. Skip mirror driver desktops.
     HDC hdc = GetDC(0);
@@ -85,6 +97,12 @@ std::vector<Rect> WindowsDisplays::getDisplaysCoords()
 
 bool WindowsDisplays::isAlreadyUpdated()
 {
+  if (m_generation != s_generation) {
+    return false;
+  }
+  if (s_changeReported) {
+    return true;
+  }
   if ((DateTime::now() - m_latestUpdateTime).getTime() > UPDATE_INTERVAL) {
     return false;
   } else {
@@ -94,6 +112,31 @@ bool WindowsDisplays::isAlreadyUpdated()
 
 std::vector<Rect> WindowsDisplays::getDisplays()
 {
+  AutoLock al(&m_displayRectsMutex);
   update();
   return m_displayRects;
 }
+
+void WindowsDisplays::getPrimaryDisplayCoords(Rect *rect)
+{
+  AutoLock al(&m_displayRectsMutex);
+  update();
+  *rect = m_primaryRect;
+}
+
+void WindowsDisplays::toFbCoordinates(Rect *rect)
+{
+  AutoLock al(&m_displayRectsMutex);
+  update();
+  rect->move(-m_xVirtualScreen, -m_yVirtualScreen);
+}
+
+void WindowsDisplays::invalidate()
+{
+  InterlockedIncrement(&s_generation);
+}
+
+void WindowsDisplays::setChangeReported(bool reported)
+{
+  s_changeReported = reported;
+}
@@ -30,6 +30,14 @@
 #include <vector>
 #include "thread/LocalMutex.h"
 
+// Keeps the display layout: the rectangles of the displays and of the
+// primary one, in the frame buffer coordinates, and the position of the
+// frame buffer on the virtual screen.
+//
+// The layout is enumerated again after invalidate() has been called, by
+// the watcher of WM_DISPLAYCHANGE or by a screen driver which has found a
+// changed output. In a process where the changes are not reported, see
+// setChangeReported(), it is enumerated again after UPDATE_INTERVAL.
 class WindowsDisplays
 {
 public:
@@ -44,6 +52,18 @@ public:
   // Returns a vector that contain dispalys coordinates at the current time.
   std::vector<Rect> getDisplays();
 
+  void getPrimaryDisplayCoords(Rect *rect);
+
+  // Moves a rectangle of the virtual screen to the frame buffer
+  // coordinates.
+  void toFbCoordinates(Rect *rect);
+
+  // Makes all the instances enumerate the displays on the next query.
+  static void invalidate();
+  // Tells whether the display changes are reported by invalidate() calls,
+  // so that the layout may be kept until the next one.
+  static void setChangeReported(bool reported);
+
 private:
   // Updates internal information to a current state.
   void update();
@@ -58,12 +78,19 @@ private:
 
   int m_xVirtualScreen;
   int m_yVirtualScreen;
+  Rect m_primaryRect;
 
   std::vector<Rect> m_displayRects;
   LocalMutex m_displayRectsMutex;
   
   static const unsigned int UPDATE_INTERVAL = 3000;
   DateTime m_latestUpdateTime;
+  // Value of s_generation when the layout was enumerated.
+  LONG m_generation;
+
+  // Incremented by invalidate().
+  static volatile LONG s_generation;
+  static volatile bool s_changeReported;
 };
 
 #endif // __WINDOWSDISPLAYS_H__